@@ -7,11 +7,17 @@ import sys
 helpMessage="""
 This uses the LowHash method to find alignment candidates.
 
-Invoke without arguments.
+Invoke without arguments, or with one argument oldReadCount
+to only find alignment candidates that involve at least one
+read with ReadId oldReadCount or greater (incremental mode).
 """
 
-# Check that there are no arguments.
-if not len(sys.argv)==1:
+# Check the arguments.
+if len(sys.argv)==1:
+    oldReadCount = 0
+elif len(sys.argv)==2:
+    oldReadCount = int(sys.argv[1])
+else:
     print(helpMessage)
     exit(1)
     
@@ -31,5 +37,6 @@ a.findAlignmentCandidatesLowHash0(
     alignmentCandidatesPerRead = float(config['MinHash']['alignmentCandidatesPerRead']), 
     minBucketSize = int(config['MinHash']['minBucketSize']),
     maxBucketSize = int(config['MinHash']['maxBucketSize']),
-    minFrequency = int(config['MinHash']['minFrequency']))
+    minFrequency = int(config['MinHash']['minFrequency']),
+    oldReadCount = oldReadCount)
 
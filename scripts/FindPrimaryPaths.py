@@ -0,0 +1,18 @@
+#!/usr/bin/python3
+
+import shasta
+import argparse
+
+parser = argparse.ArgumentParser(description=
+    'Find paths in the complete marker graph in parallel, '
+    'using as seeds all edges suitable to become primary edges.')
+parser.add_argument('--threads', type=int, default=0,
+    help='Number of threads (default uses all available hardware threads)')
+        
+arguments = parser.parse_args()   
+
+a = shasta.Assembler()
+a.accessMarkers()
+a.accessMarkerGraphVertices()
+a.accessMarkerGraphEdges()
+a.findCompleteMarkerGraphPrimaryPaths(arguments.threads)
@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+
+import argparse
+import os
+import subprocess
+import sys
+
+
+helpMessage = """
+Performance regression gate for Shasta upgrades.
+
+Assembles the same reads with a baseline Shasta executable and
+a candidate Shasta executable, on the same machine and with the same
+options, then runs --command comparePerformance of the candidate
+to compare the resources used by each assembly stage,
+as recorded in performance.jsonl in each assembly directory.
+
+The reads are tests/TinyTest.fasta.gz or, if --scale is greater than 1,
+reads simulated by SimulateReads.py with --scale times as many bases
+as TinyTest. SimulateReads.py must be in the same directory as this script.
+TinyTest stages complete in well under a second, so use a larger scale
+to gate on times rather than only on memory.
+
+The comparison is written to the standard output and to
+PerformanceComparison.csv in the working directory.
+The exit status is 0 if no regressions were found.
+"""
+
+
+
+def runAssembly(shasta, inputFileName, config, threadCount, assemblyDirectory, shastaOptions):
+    if os.path.exists(assemblyDirectory):
+        subprocess.run('%s --command cleanupBinaryData --assemblyDirectory %s > /dev/null 2>&1' %
+            (shasta, assemblyDirectory), shell=True)
+        subprocess.run(['rm', '-rf', assemblyDirectory], check=True)
+    command = '%s --input %s --config %s --threads %i --assemblyDirectory %s %s > /dev/null' % (
+        shasta, inputFileName, config, threadCount, assemblyDirectory, shastaOptions)
+    print(command, flush=True)
+    returnCode = subprocess.run(command, shell=True).returncode
+    if returnCode != 0:
+        print('Assembly failed with return code %i.' % returnCode, flush=True)
+        exit(returnCode)
+
+    # The binary data are not needed for the comparison.
+    subprocess.run('%s --command cleanupBinaryData --assemblyDirectory %s > /dev/null 2>&1' %
+        (shasta, assemblyDirectory), shell=True)
+
+
+
+def main():
+    parser = argparse.ArgumentParser(description = helpMessage,
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    scriptDirectory = os.path.dirname(os.path.abspath(sys.argv[0]))
+    parser.add_argument('--baselineShasta', required=True,
+        help='The Shasta executable of the baseline release.')
+    parser.add_argument('--shasta', default=os.path.join(scriptDirectory, 'shasta'),
+        help='The Shasta executable being checked.')
+    parser.add_argument('--config', default='Nanopore-May2022',
+        help='Configuration file or name of a built-in configuration.')
+    parser.add_argument('--scale', type=float, default=1.,
+        help='The size of the read set, as a multiple of the size of TinyTest.')
+    parser.add_argument('--seed', type=int, default=231,
+        help='The seed for SimulateReads.py.')
+    parser.add_argument('--threads', type=int, default=8)
+    parser.add_argument('--shastaOptions', default='',
+        help='Additional options for both assemblies.')
+    parser.add_argument('--compareOptions', default='',
+        help='Additional options for --command comparePerformance, '
+        'for example "--performanceTimeTolerance 0.1".')
+    parser.add_argument('--reuseBaseline', action='store_true',
+        help='Reuse the baseline assembly directory from a previous run, if it exists.')
+    arguments = parser.parse_args()
+
+
+
+    # Get the reads.
+    if arguments.scale > 1.:
+        inputFileName = os.path.abspath('PerformanceGateReads-%g.fasta' % arguments.scale)
+        if not os.path.exists(inputFileName):
+            command = '%s %s --output %s --scale %g --seed %i' % (
+                sys.executable, os.path.join(scriptDirectory, 'SimulateReads.py'),
+                inputFileName, arguments.scale, arguments.seed)
+            print(command, flush=True)
+            subprocess.run(command, shell=True, check=True)
+    else:
+        inputFileName = os.path.abspath(os.path.join(scriptDirectory, '..', 'tests', 'TinyTest.fasta.gz'))
+
+
+
+    # Run the assemblies.
+    baselineDirectory = os.path.abspath('PerformanceGate-Baseline')
+    candidateDirectory = os.path.abspath('PerformanceGate-Candidate')
+    if not (arguments.reuseBaseline and
+        os.path.exists(os.path.join(baselineDirectory, 'performance.jsonl'))):
+        runAssembly(arguments.baselineShasta, inputFileName, arguments.config,
+            arguments.threads, baselineDirectory, arguments.shastaOptions)
+    runAssembly(arguments.shasta, inputFileName, arguments.config,
+        arguments.threads, candidateDirectory, arguments.shastaOptions)
+
+
+
+    # Compare them.
+    command = '%s --command comparePerformance --assemblyDirectory %s --performanceBaseline %s %s' % (
+        arguments.shasta, candidateDirectory, baselineDirectory, arguments.compareOptions)
+    print(command, flush=True)
+    exit(subprocess.run(command, shell=True).returncode)
+
+
+
+if __name__ == '__main__':
+    main()
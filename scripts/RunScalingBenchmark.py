@@ -0,0 +1,193 @@
+#!/usr/bin/python3
+
+import argparse
+import csv
+import glob
+import json
+import os
+import subprocess
+import sys
+
+
+helpMessage = """
+Runs Shasta assemblies of simulated reads at several sizes,
+thread counts, and configurations, and reports per-stage
+elapsed times, throughput, and strong and weak scaling.
+
+The reads are created by SimulateReads.py, which must be in the
+same directory as this script. The per-stage times are taken from
+performance.jsonl in each assembly directory.
+
+Output files, in the working directory:
+- ScalingRuns.csv: elapsed seconds and throughput (read bases per second)
+  for each run and stage.
+- StrongScaling.csv: for each configuration, scale, and stage,
+  speedup and efficiency relative to the smallest thread count.
+- WeakScaling.csv: for each configuration and stage, efficiency of runs
+  where the scale is proportional to the number of threads, relative
+  to the run with the smallest scale and thread count.
+"""
+
+
+
+# Get the elapsed seconds of each stage from performance.jsonl.
+# The stages are the spans nested directly in the "assemble" span.
+def getStageSeconds(assemblyDirectory):
+    stageSeconds = {}
+    with open(os.path.join(assemblyDirectory, 'performance.jsonl')) as f:
+        for line in f:
+            span = json.loads(line)
+            name = span['name']
+            if span['depth'] == 1 and name.startswith('assemble/'):
+                stageName = name[len('assemble/'):]
+                stageSeconds[stageName] = stageSeconds.get(stageName, 0.) + span['wallSeconds']
+            elif span['depth'] == 0 and name == 'assemble':
+                stageSeconds['total'] = stageSeconds.get('total', 0.) + span['wallSeconds']
+    return stageSeconds
+
+
+
+def getReadBaseCount(assemblyDirectory):
+    with open(os.path.join(assemblyDirectory, 'AssemblySummary.json')) as f:
+        summary = json.load(f)
+    return summary['Reads used in this assembly']['Number of read bases']
+
+
+
+def main():
+    parser = argparse.ArgumentParser(description = helpMessage,
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    scriptDirectory = os.path.dirname(os.path.abspath(sys.argv[0]))
+    parser.add_argument('--shasta', default=os.path.join(scriptDirectory, 'shasta'),
+        help='The Shasta executable.')
+    parser.add_argument('--configs', nargs='+', default=[],
+        help='Configuration files or names of built-in configurations. '
+        'The default is all the .conf files in the conf directory next to the directory of this script.')
+    parser.add_argument('--scales', nargs='+', type=float, default=[1., 10., 100.],
+        help='The sizes of the simulated read sets, as multiples of the size of TinyTest.')
+    parser.add_argument('--threads', nargs='+', type=int, default=[1, 2, 4, 8])
+    parser.add_argument('--seed', type=int, default=231,
+        help='The seed for SimulateReads.py. The same reads are used for all runs at a given scale.')
+    parser.add_argument('--simulateOptions', default='',
+        help='Additional options for SimulateReads.py.')
+    parser.add_argument('--shastaOptions', default='',
+        help='Additional options for Shasta, for example "--memoryMode filesystem --memoryBacking 2M".')
+    parser.add_argument('--keepAssemblies', action='store_true',
+        help='Keep the assembly directories. Otherwise, each one is removed after its results are collected.')
+    arguments = parser.parse_args()
+
+    configs = arguments.configs
+    if not configs:
+        configs = sorted(glob.glob(os.path.join(scriptDirectory, '..', 'conf', '*.conf')))
+    if not configs:
+        print('No configurations found. Use --configs.')
+        exit(1)
+
+
+
+    # Generate the reads for each scale.
+    readsFileNames = {}
+    for scale in arguments.scales:
+        fileName = os.path.abspath('SimulatedReads-%g.fasta' % scale)
+        readsFileNames[scale] = fileName
+        if os.path.exists(fileName):
+            continue
+        command = '%s %s --output %s --scale %g --seed %i %s' % (
+            sys.executable, os.path.join(scriptDirectory, 'SimulateReads.py'),
+            fileName, scale, arguments.seed, arguments.simulateOptions)
+        print(command, flush=True)
+        subprocess.run(command, shell=True, check=True)
+
+
+
+    # Run the assemblies.
+    # results[(configName, scale, threadCount)] = (readBaseCount, stageSeconds)
+    results = {}
+    stageNames = []
+    for config in configs:
+        configName = os.path.splitext(os.path.basename(config))[0]
+        for scale in arguments.scales:
+            for threadCount in arguments.threads:
+                assemblyDirectory = os.path.abspath('Scaling-%s-%g-%i' % (configName, scale, threadCount))
+                if os.path.exists(assemblyDirectory):
+                    subprocess.run('%s --command cleanupBinaryData --assemblyDirectory %s > /dev/null 2>&1' %
+                        (arguments.shasta, assemblyDirectory), shell=True)
+                    subprocess.run(['rm', '-rf', assemblyDirectory], check=True)
+                command = '%s --input %s --config %s --threads %i --assemblyDirectory %s %s > /dev/null' % (
+                    arguments.shasta, readsFileNames[scale], config, threadCount,
+                    assemblyDirectory, arguments.shastaOptions)
+                print(command, flush=True)
+                returnCode = subprocess.run(command, shell=True).returncode
+                if returnCode != 0:
+                    print('Assembly failed with return code %i.' % returnCode, flush=True)
+                    continue
+
+                stageSeconds = getStageSeconds(assemblyDirectory)
+                readBaseCount = getReadBaseCount(assemblyDirectory)
+                results[(configName, scale, threadCount)] = (readBaseCount, stageSeconds)
+                for stageName in stageSeconds:
+                    if stageName not in stageNames:
+                        stageNames.append(stageName)
+                print('Total elapsed seconds %g.' % stageSeconds.get('total', 0.), flush=True)
+
+                if not arguments.keepAssemblies:
+                    subprocess.run('%s --command cleanupBinaryData --assemblyDirectory %s > /dev/null 2>&1' %
+                        (arguments.shasta, assemblyDirectory), shell=True)
+                    subprocess.run(['rm', '-rf', assemblyDirectory], check=True)
+
+
+
+    # Per-run results.
+    with open('ScalingRuns.csv', 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['Configuration', 'Scale', 'Threads', 'Stage', 'Seconds', 'Read bases per second'])
+        for (configName, scale, threadCount), (readBaseCount, stageSeconds) in results.items():
+            for stageName in stageNames:
+                if stageName in stageSeconds:
+                    seconds = stageSeconds[stageName]
+                    throughput = readBaseCount / seconds if seconds > 0. else 0.
+                    writer.writerow([configName, scale, threadCount, stageName, '%.3f' % seconds, '%.0f' % throughput])
+
+
+
+    # Strong scaling: fixed scale, increasing thread count.
+    minThreadCount = min(arguments.threads)
+    with open('StrongScaling.csv', 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['Configuration', 'Scale', 'Threads', 'Stage', 'Speedup', 'Efficiency'])
+        for (configName, scale, threadCount), (readBaseCount, stageSeconds) in results.items():
+            base = results.get((configName, scale, minThreadCount))
+            if base is None:
+                continue
+            for stageName in stageNames:
+                if stageName in stageSeconds and stageName in base[1] and stageSeconds[stageName] > 0.:
+                    speedup = base[1][stageName] / stageSeconds[stageName]
+                    efficiency = speedup * minThreadCount / threadCount
+                    writer.writerow([configName, scale, threadCount, stageName, '%.3f' % speedup, '%.3f' % efficiency])
+
+
+
+    # Weak scaling: scale proportional to thread count.
+    # The efficiency is the ratio of the elapsed time of the base run
+    # to the elapsed time of each run.
+    minScale = min(arguments.scales)
+    with open('WeakScaling.csv', 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['Configuration', 'Scale', 'Threads', 'Stage', 'Efficiency'])
+        for (configName, scale, threadCount), (readBaseCount, stageSeconds) in results.items():
+            if abs(scale / minScale - threadCount / minThreadCount) > 1.e-6:
+                continue
+            base = results.get((configName, minScale, minThreadCount))
+            if base is None:
+                continue
+            for stageName in stageNames:
+                if stageName in stageSeconds and stageName in base[1] and stageSeconds[stageName] > 0.:
+                    efficiency = base[1][stageName] / stageSeconds[stageName]
+                    writer.writerow([configName, scale, threadCount, stageName, '%.3f' % efficiency])
+
+    print('Wrote ScalingRuns.csv, StrongScaling.csv, and WeakScaling.csv.')
+
+
+
+if __name__ == '__main__':
+    main()
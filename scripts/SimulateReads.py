@@ -0,0 +1,210 @@
+#!/usr/bin/python3
+
+import argparse
+import math
+import random
+import re
+
+
+helpMessage = """
+Creates a synthetic reference and simulated reads with
+Nanopore-like read length and error profiles, for use in
+reproducible performance testing without real data.
+
+The reference is random, with optional copies of a repeat element,
+each diverged from the original by random substitutions.
+Read lengths follow a log-normal distribution.
+Reads are taken from both strands with equal probability.
+Errors are substitutions, insertions, and deletions,
+plus length changes of homopolymer runs.
+
+All results are determined by the seed, so the same
+command generates the same reads.
+By default the total number of read bases is --scale times
+the number of bases in tests/TinyTest.fasta.gz.
+"""
+
+# The number of bases in tests/TinyTest.fasta.gz.
+tinyTestBaseCount = 891443
+
+bases = 'ACGT'
+complementTable = str.maketrans('ACGT', 'TGCA')
+
+
+
+def reverseComplement(s):
+    return s.translate(complementTable)[::-1]
+
+
+
+def randomSequence(generator, n):
+    return ''.join(generator.choices(bases, k=n))
+
+
+
+# Apply random substitutions to a sequence.
+def mutate(generator, s, rate):
+    s = list(s)
+    i = -1
+    while True:
+        i += 1 + int(generator.expovariate(rate)) if rate > 0. else len(s)
+        if i >= len(s):
+            break
+        s[i] = generator.choice(bases.replace(s[i], ''))
+    return ''.join(s)
+
+
+
+def createReference(generator, arguments):
+    n = arguments.referenceLength
+    repeatCount = arguments.repeatCount
+    repeatLength = arguments.repeatLength
+    uniqueLength = n - repeatCount * repeatLength
+    if uniqueLength < 0:
+        raise Exception('The repeats are longer than the reference.')
+
+    # Insert the repeat copies at random positions of a random sequence.
+    unique = randomSequence(generator, uniqueLength)
+    if repeatCount == 0:
+        return unique
+    repeat = randomSequence(generator, repeatLength)
+    positions = sorted(generator.randrange(uniqueLength + 1) for i in range(repeatCount))
+    pieces = []
+    begin = 0
+    for position in positions:
+        pieces.append(unique[begin:position])
+        copy = mutate(generator, repeat, arguments.repeatDivergence)
+        if generator.random() < 0.5:
+            copy = reverseComplement(copy)
+        pieces.append(copy)
+        begin = position
+    pieces.append(unique[begin:])
+    return ''.join(pieces)
+
+
+
+# Add sequencing errors to a read.
+# Error positions are generated with exponentially distributed gaps,
+# so the time is proportional to the number of errors, not the read length.
+def addErrors(generator, read, arguments):
+    errorRate = arguments.errorRate
+    substitutionFraction = arguments.substitutionFraction
+    insertionFraction = arguments.insertionFraction
+
+    # Homopolymer run length errors.
+    if arguments.homopolymerErrorRate > 0.:
+        pieces = []
+        begin = 0
+        for match in re.finditer(r'A{3,}|C{3,}|G{3,}|T{3,}', read):
+            if generator.random() < arguments.homopolymerErrorRate:
+                pieces.append(read[begin:match.start()])
+                runLength = match.end() - match.start()
+                runLength += -1 if generator.random() < 0.7 else 1
+                pieces.append(match.group()[0] * runLength)
+                begin = match.end()
+        pieces.append(read[begin:])
+        read = ''.join(pieces)
+
+    if errorRate <= 0.:
+        return read
+
+    pieces = []
+    begin = 0
+    position = -1
+    while True:
+        position += 1 + int(generator.expovariate(errorRate))
+        if position >= len(read):
+            break
+        pieces.append(read[begin:position])
+        r = generator.random()
+        if r < substitutionFraction:
+            pieces.append(generator.choice(bases.replace(read[position], '')))
+            begin = position + 1
+        elif r < substitutionFraction + insertionFraction:
+            pieces.append(generator.choice(bases))
+            begin = position
+        else:
+            begin = position + 1
+    pieces.append(read[begin:])
+    return ''.join(pieces)
+
+
+
+def main():
+    parser = argparse.ArgumentParser(description = helpMessage,
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument('--output', default='SimulatedReads.fasta',
+        help='The FASTA file to write the reads to.')
+    parser.add_argument('--referenceOutput', default='',
+        help='If not empty, a FASTA file to write the reference to.')
+    parser.add_argument('--seed', type=int, default=231)
+    parser.add_argument('--scale', type=float, default=1.,
+        help='The total number of read bases, as a multiple of the bases in TinyTest. '
+        'Ignored if --readBaseCount is specified.')
+    parser.add_argument('--readBaseCount', type=int, default=0,
+        help='The total number of read bases.')
+    parser.add_argument('--coverage', type=float, default=20.,
+        help='The coverage. The reference length is the number of read bases divided by the coverage, '
+        'unless --referenceLength is specified.')
+    parser.add_argument('--referenceLength', type=int, default=0)
+    parser.add_argument('--repeatCount', type=int, default=-1,
+        help='The number of copies of the repeat element. '
+        'The default is one for every 100 Kb of reference.')
+    parser.add_argument('--repeatLength', type=int, default=5000)
+    parser.add_argument('--repeatDivergence', type=float, default=0.01,
+        help='The substitution rate of each repeat copy relative to the repeat element.')
+    parser.add_argument('--meanReadLength', type=float, default=20000.)
+    parser.add_argument('--readLengthSigma', type=float, default=0.8,
+        help='The sigma of the log-normal read length distribution.')
+    parser.add_argument('--minReadLength', type=int, default=1000)
+    parser.add_argument('--errorRate', type=float, default=0.06,
+        help='The rate of substitutions, insertions, and deletions.')
+    parser.add_argument('--substitutionFraction', type=float, default=0.3)
+    parser.add_argument('--insertionFraction', type=float, default=0.2)
+    parser.add_argument('--homopolymerErrorRate', type=float, default=0.2,
+        help='The probability that the length of a homopolymer run of at least 3 bases is wrong.')
+    arguments = parser.parse_args()
+
+    generator = random.Random(arguments.seed)
+
+    readBaseCount = arguments.readBaseCount
+    if readBaseCount == 0:
+        readBaseCount = int(arguments.scale * tinyTestBaseCount)
+    if arguments.referenceLength == 0:
+        arguments.referenceLength = max(int(readBaseCount / arguments.coverage), 2 * arguments.minReadLength)
+    if arguments.repeatCount < 0:
+        arguments.repeatCount = arguments.referenceLength // 100000
+
+    reference = createReference(generator, arguments)
+    if arguments.referenceOutput:
+        with open(arguments.referenceOutput, 'w') as out:
+            out.write('>SimulatedReference\n%s\n' % reference)
+
+    # The mu of the log-normal distribution that gives the requested mean.
+    sigma = arguments.readLengthSigma
+    mu = math.log(arguments.meanReadLength) - 0.5 * sigma * sigma
+
+    readCount = 0
+    generatedBaseCount = 0
+    with open(arguments.output, 'w') as out:
+        while generatedBaseCount < readBaseCount:
+            length = int(generator.lognormvariate(mu, sigma))
+            length = max(arguments.minReadLength, min(length, len(reference)))
+            begin = generator.randrange(len(reference) - length + 1)
+            read = reference[begin:begin + length]
+            strand = 0
+            if generator.random() < 0.5:
+                read = reverseComplement(read)
+                strand = 1
+            read = addErrors(generator, read, arguments)
+            out.write('>%i position=%i length=%i strand=%i\n%s\n' % (readCount, begin, length, strand, read))
+            readCount += 1
+            generatedBaseCount += len(read)
+
+    print('Generated %i reads with %i bases from a reference of length %i with %i repeat copies.' %
+        (readCount, generatedBaseCount, len(reference), arguments.repeatCount))
+
+
+
+if __name__ == '__main__':
+    main()
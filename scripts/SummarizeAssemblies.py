@@ -43,6 +43,11 @@ for sectionName in firstAssemblyJson:
     if sectionName == 'Comment':
         continue
     firstAssemblySection = firstAssemblyJson[sectionName]
+
+    # Skip sections that are not a set of items,
+    # such as the optional "Thread load balance" section.
+    if not isinstance(firstAssemblySection, dict):
+        continue
     
     # Special treatment of section "Reads discarded on input"
     # which contains reads and bases for each item.
@@ -1,8 +1,9 @@
 // Shasta
 #include "Align4.hpp"
 #include "Alignment.hpp"
-#include "countingSort.hpp"
+#include "AlignmentMatrixRenderer.hpp"
 #include "hashArray.hpp"
+#include "KmerMask.hpp"
 #include "Marker.hpp"
 #include "orderPairs.hpp"
 #include "PngImage.hpp"
@@ -21,7 +22,6 @@ using namespace Align4;
 #include "chrono.hpp"
 #include "fstream.hpp"
 #include <map>
-#include <stack>
 #include "tuple.hpp"
 #include <unordered_map>
 
@@ -31,13 +31,13 @@ void shasta::Align4::align(
     const array< span<KmerId>, 2>& kmerIds,
     const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkers,
     const Options& options,
-    MemoryMapped::ByteAllocator& byteAllocator,
+    Workspace& workspace,
     Alignment& alignment,
     AlignmentInfo& alignmentInfo,
     bool debug)
 {
     Align4::Aligner graph(kmerIds, sortedMarkers,
-        options, byteAllocator, alignment, alignmentInfo,
+        options, workspace, alignment, alignmentInfo,
         debug);
 }
 
@@ -47,15 +47,17 @@ Aligner::Aligner(
     const array<span<KmerId>, 2>& kmerIds,
     const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkers,
     const Options& options,
-    MemoryMapped::ByteAllocator& byteAllocator,
+    Workspace& workspace,
     Alignment& alignment,
     AlignmentInfo& alignmentInfo,
     bool debug) :
+    workspace(workspace),
     nx(uint32_t(kmerIds[0].size())),
     ny(uint32_t(kmerIds[1].size())),
     deltaX(int32_t(options.deltaX)),
     deltaY(int32_t(options.deltaY)),
-    byteAllocator(byteAllocator)
+    nativeBandedAlignment(options.nativeBandedAlignment),
+    kmerMask(options.kmerMask)
 {
     if(debug) {
         cout << timestamp << "Align4 begins." << endl;
@@ -194,7 +196,10 @@ SignedCoordinates Aligner::getxy(Coordinates XY) const
 
 void Aligner::createAlignmentMatrix(const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkers)
 {
-    alignmentMatrix.clear();
+    vector<StagedAlignmentMatrixEntry>& stagedEntries = workspace.stagedAlignmentMatrixEntries;
+    stagedEntries.clear();
+    uint32_t iXCount = 0;
+    uint32_t iYCount = 0;
 
     // Joint loop over the sorted markers, looking for common markers.
     auto begin0 = sortedMarkers[0].begin();
@@ -228,6 +233,15 @@ void Aligner::createAlignmentMatrix(const array<span< pair<KmerId, uint32_t> >,
                 ++it1End;
             }
 
+            // Skip masked KmerIds. This is done before generating
+            // any entries, so high frequency KmerIds don't
+            // generate a quadratic number of entries.
+            if(kmerMask and kmerMask->contains(kmerId)) {
+                it0 = it0End;
+                it1 = it1End;
+                continue;
+            }
+
             // Loop over pairs in the streaks.
             for(auto jt0=it0Begin; jt0!=it0End; ++jt0) {
                 const uint32_t x = jt0->second;
@@ -235,13 +249,11 @@ void Aligner::createAlignmentMatrix(const array<span< pair<KmerId, uint32_t> >,
                     const uint32_t y = jt1->second;
                     const Coordinates xy(x, y);
                     const Coordinates iXY = getCellIndexesFromxy(xy);
-                    const uint32_t iY = iXY.second;
-                    if(alignmentMatrix.size() <= iY) {
-                        alignmentMatrix.resize(iY+1,
-                            AlignmentMatrixEntryVector(0, AlignmentMatrixAllocator(byteAllocator)));
-                    }
                     const uint32_t iX = iXY.first;
-                    alignmentMatrix[iY].push_back(make_pair(iX, xy));
+                    const uint32_t iY = iXY.second;
+                    stagedEntries.push_back({iX, iY, xy});
+                    iXCount = max(iXCount, iX + 1);
+                    iYCount = max(iYCount, iY + 1);
                 }
             }
 
@@ -252,18 +264,62 @@ void Aligner::createAlignmentMatrix(const array<span< pair<KmerId, uint32_t> >,
 
     }
 
-    // For each iY value, sort by iX.
-    // Except for short vectors, counting sort is faster.
-    vector<uint32_t> count;
-    AlignmentMatrixEntryVector w(byteAllocator);
-    for(auto& v: alignmentMatrix) {
-        if(false /*v.size() < 5*/) {
-            sort(v.begin(), v.end(), OrderPairsByFirstOnly<uint32_t, Coordinates>());
-        } else {
-            countingSort(v, count, w);
-        }
+
+
+    // Sort by (iY, iX) using two counting sort passes,
+    // first by iX and then by iY.
+    // The second pass also generates the row boundaries.
+    const uint64_t n = stagedEntries.size();
+    vector<uint64_t>& count = workspace.count;
+    vector<StagedAlignmentMatrixEntry>& work = workspace.stagedAlignmentMatrixEntriesWork;
+    work.resize(n);
+
+    // Counting sort by iX, from stagedEntries to work.
+    count.assign(iXCount + 1, 0);
+    for(const StagedAlignmentMatrixEntry& entry: stagedEntries) {
+        ++count[entry.iX + 1];
+    }
+    for(uint32_t iX=0; iX<iXCount; iX++) {
+        count[iX + 1] += count[iX];
+    }
+    for(const StagedAlignmentMatrixEntry& entry: stagedEntries) {
+        work[count[entry.iX]++] = entry;
     }
 
+    // Counting sort by iY, from work to the alignment matrix.
+    vector<uint64_t>& rowBegin = workspace.alignmentMatrixRowBegin;
+    rowBegin.assign(iYCount + 1, 0);
+    for(const StagedAlignmentMatrixEntry& entry: work) {
+        ++rowBegin[entry.iY + 1];
+    }
+    for(uint32_t iY=0; iY<iYCount; iY++) {
+        rowBegin[iY + 1] += rowBegin[iY];
+    }
+    count.assign(rowBegin.begin(), rowBegin.end());
+    vector<AlignmentMatrixEntry>& entries = workspace.alignmentMatrixEntries;
+    entries.resize(n);
+    for(const StagedAlignmentMatrixEntry& entry: work) {
+        entries[count[entry.iY]++] = make_pair(entry.iX, entry.xy);
+    }
+}
+
+
+
+uint32_t Aligner::alignmentMatrixRowCount() const
+{
+    const vector<uint64_t>& rowBegin = workspace.alignmentMatrixRowBegin;
+    return rowBegin.empty() ? 0 : uint32_t(rowBegin.size() - 1);
+}
+
+
+
+span<const Aligner::AlignmentMatrixEntry> Aligner::alignmentMatrixRow(uint32_t iY) const
+{
+    const vector<uint64_t>& rowBegin = workspace.alignmentMatrixRowBegin;
+    const AlignmentMatrixEntry* entries = workspace.alignmentMatrixEntries.data();
+    return span<const AlignmentMatrixEntry>(
+        entries + rowBegin[iY],
+        entries + rowBegin[iY + 1]);
 }
 
 
@@ -273,8 +329,8 @@ void Aligner::writeAlignmentMatrixCsv(const string& fileName) const
     uint64_t entryCount = 0;
     ofstream csv(fileName);
     csv << "iX,iY,X,Y,x,y\n";
-    for(uint32_t iY=0; iY<alignmentMatrix.size(); iY++) {
-        for(const auto& v: alignmentMatrix[iY]) {
+    for(uint32_t iY=0; iY<alignmentMatrixRowCount(); iY++) {
+        for(const auto& v: alignmentMatrixRow(iY)) {
             const uint32_t iX = v.first;
             const Coordinates& xy = v.second;
             const Coordinates XY = getXY(xy);
@@ -298,81 +354,81 @@ void Aligner::writeAlignmentMatrixPng(
     const string& fileName,
     uint64_t maxDistanceFromBoundary) const
 {
-    PngImage image(nx, ny);
-
-    writeCheckerboard(image, maxDistanceFromBoundary);
-
-    image.writeGrid(   10,  15,  15,  15);      // Grey
-    image.writeGrid(   50,  30,  30,  30);      // Grey
-    image.writeGrid(  100,  90,  90,  90);      // Grey
-    image.writeGrid(  500, 160, 160, 160);      // Grey
-    image.writeGrid( 1000, 255, 255, 255);      // White
-    image.writeGrid( 5000, 255, 120, 255);      // Purple
-    image.writeGrid(10000, 255, 255,  60);      // Yellow
-    image.writeGrid(50000, 255, 255, 120);      // Yellow
-
-    for(uint32_t iY=0; iY<alignmentMatrix.size(); iY++) {
-        for(const auto& v: alignmentMatrix[iY]) {
-            const Coordinates& xy = v.second;
-            const uint32_t x = xy.first;
-            const uint32_t y = xy.second;
-            image.setPixel(x, y, 255, 0, 0);
+    // Downsample as necessary to keep the image size under control.
+    const uint32_t maxImageSize = 8192;
+    const uint32_t markersPerPixel = (max(nx, ny) - 1) / maxImageSize + 1;
+
+    AlignmentMatrixRenderer renderer(nx, ny);
+
+    renderer.setBackground(
+        [this, maxDistanceFromBoundary](uint32_t x, uint32_t y)
+        {
+            return checkerboardRgb(Coordinates(x, y), maxDistanceFromBoundary);
+        });
+
+    renderer.addGrid(   10, { 15,  15,  15});      // Grey
+    renderer.addGrid(   50, { 30,  30,  30});      // Grey
+    renderer.addGrid(  100, { 90,  90,  90});      // Grey
+    renderer.addGrid(  500, {160, 160, 160});      // Grey
+    renderer.addGrid( 1000, {255, 255, 255});      // White
+    renderer.addGrid( 5000, {255, 120, 255});      // Purple
+    renderer.addGrid(10000, {255, 255,  60});      // Yellow
+    renderer.addGrid(50000, {255, 255, 120});      // Yellow
+
+    vector< pair<uint32_t, uint32_t> > entries;
+    for(uint32_t iY=0; iY<alignmentMatrixRowCount(); iY++) {
+        for(const auto& v: alignmentMatrixRow(iY)) {
+            entries.push_back(v.second);
         }
     }
+    renderer.addLayer(entries, {255, 0, 0});
 
-    image.write(fileName);
+    // This runs during alignment computation, so use a single thread.
+    renderer.render(markersPerPixel, 1, 1).write(fileName);
 }
 
 
 
-void Aligner::writeCheckerboard(
-    PngImage& image,
-    uint64_t maxDistanceFromBoundary) const
+// The color of the checkerboard at a given point of the alignment matrix.
+array<uint8_t, 3> Aligner::checkerboardRgb(
+    const Coordinates& xy,
+    uint64_t /* maxDistanceFromBoundary */) const
 {
-    Coordinates xy;
-    uint32_t& x = xy.first;
-    uint32_t& y = xy.second;
-
-    Coordinates iXY;
-    uint32_t& iX = iXY.first;
-    uint32_t& iY = iXY.second;
-
-    for(y=0; y<ny; y++) {
-        for(x=0; x<nx; x++) {
-            iXY = getCellIndexesFromxy(xy);
-            /*
-            const bool isNearLeftOrTop =
-                (cellDistanceFromLeft(iXY) < maxDistanceFromBoundary) or
-                (cellDistanceFromTop(iXY)  < maxDistanceFromBoundary);
-            const bool isNearRightOrBottom =
-                (cellDistanceFromRight(iXY)  < maxDistanceFromBoundary) or
-                (cellDistanceFromBottom(iXY) < maxDistanceFromBoundary);
-            */
-            const Cell* cell = findCell(iXY);
-            const bool isEvenCell = (((iX + iY) % 2) == 0);
-
-            int r = 0;
-            int g = 0;
-            int b = 0;
-            if(cell) {
-                if(cell->isActive()) {
-                    g = 255;
-                } else if(cell->isForwardAccessible) {
-                    b = 255;
-                } else {
-                    r = 128;
-                    g = 128;
-                    b = 128;
-                }
-            } else {
-                if(isEvenCell) {
-                    r = 64;
-                }
-            }
+    const Coordinates iXY = getCellIndexesFromxy(xy);
+    const uint32_t iX = iXY.first;
+    const uint32_t iY = iXY.second;
 
-            image.setPixel(x, y, r, g, b);
+    /*
+    const bool isNearLeftOrTop =
+        (cellDistanceFromLeft(iXY) < maxDistanceFromBoundary) or
+        (cellDistanceFromTop(iXY)  < maxDistanceFromBoundary);
+    const bool isNearRightOrBottom =
+        (cellDistanceFromRight(iXY)  < maxDistanceFromBoundary) or
+        (cellDistanceFromBottom(iXY) < maxDistanceFromBoundary);
+    */
+    const Cell* cell = findCell(iXY);
+    const bool isEvenCell = (((iX + iY) % 2) == 0);
+
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    if(cell) {
+        if(cell->isActive()) {
+            g = 255;
+        } else if(cell->isForwardAccessible) {
+            b = 255;
+        } else {
+            r = 128;
+            g = 128;
+            b = 128;
+        }
+    } else {
+        if(isEvenCell) {
+            r = 64;
         }
     }
+
+    return {r, g, b};
 }
 
 
@@ -382,15 +438,18 @@ void Aligner::createCells(
     uint64_t maxDistanceFromBoundary)
 {
     // Start with nothing.
-    cells.clear();
-    cells.resize(alignmentMatrix.size());
+    vector<CellEntry>& cellEntries = workspace.cellEntries;
+    vector<uint64_t>& cellRowBegin = workspace.cellRowBegin;
+    const uint32_t rowCount = alignmentMatrixRowCount();
+    cellEntries.clear();
+    cellRowBegin.resize(rowCount + 1);
+    cellRowBegin[0] = 0;
 
     // Loop over iY values.
-    for(uint32_t iY=0; iY<alignmentMatrix.size(); iY++) {
+    for(uint32_t iY=0; iY<rowCount; iY++) {
 
-        // Access the vectors for this value of iY.
-        const auto& iYAlignmentMatrix = alignmentMatrix[iY];
-        vector< pair<uint32_t, Cell> >& iYCells = cells[iY];
+        // Access the alignment matrix entries for this value of iY.
+        const span<const AlignmentMatrixEntry> iYAlignmentMatrix = alignmentMatrixRow(iY);
 
         // Each vector in the alignment matrix is sorted by iX, so we can scan it,
         // creating a new cell each time we encounter a new value of iX
@@ -429,22 +488,53 @@ void Aligner::createCells(
                 (cellDistanceFromBottom(iXY) < maxDistanceFromBoundary);
 
             // Store this cell.
-            iYCells.push_back(make_pair(iX, cell));
+            cellEntries.push_back(make_pair(iX, cell));
         }
+        cellRowBegin[iY + 1] = cellEntries.size();
 
     }
 }
 
 
 
+uint32_t Aligner::cellRowCount() const
+{
+    const vector<uint64_t>& cellRowBegin = workspace.cellRowBegin;
+    return cellRowBegin.empty() ? 0 : uint32_t(cellRowBegin.size() - 1);
+}
+
+
+
+span<Aligner::CellEntry> Aligner::cellRow(uint32_t iY)
+{
+    const vector<uint64_t>& cellRowBegin = workspace.cellRowBegin;
+    CellEntry* cellEntries = workspace.cellEntries.data();
+    return span<CellEntry>(
+        cellEntries + cellRowBegin[iY],
+        cellEntries + cellRowBegin[iY + 1]);
+}
+
+
+
+span<const Aligner::CellEntry> Aligner::cellRow(uint32_t iY) const
+{
+    const vector<uint64_t>& cellRowBegin = workspace.cellRowBegin;
+    const CellEntry* cellEntries = workspace.cellEntries.data();
+    return span<const CellEntry>(
+        cellEntries + cellRowBegin[iY],
+        cellEntries + cellRowBegin[iY + 1]);
+}
+
+
+
 void Aligner::writeCellsCsv(
     const string& fileName) const
 {
     uint64_t cellCount = 0;
     ofstream csv(fileName);
     csv << "iX,iY,minX,maxX,minY,maxY,sizeX,sizeY\n";
-    for(uint32_t iY=0; iY<cells.size(); iY++) {
-        for(const auto& p: cells[iY]) {
+    for(uint32_t iY=0; iY<cellRowCount(); iY++) {
+        for(const auto& p: cellRow(iY)) {
             const uint32_t iX = p.first;
             csv << iX << ",";
             csv << iY << "\n";
@@ -463,7 +553,9 @@ void Aligner::writeCellsPng(
     const uint32_t sizeXY = nx + ny -1;
 
     // Number of markers per pixel - to control the size of the picture.
-    const uint32_t markersPerPixel = 5;
+    // Increase it as necessary to keep the image size under control.
+    const uint32_t maxImageSize = 8192;
+    const uint32_t markersPerPixel = max(5U, (sizeXY - 1) / maxImageSize + 1);
 
     // Create the image.
     const uint32_t imageSize = sizeXY / markersPerPixel;
@@ -484,8 +576,8 @@ void Aligner::writeCellsPng(
     }
 
     // Write the cells.
-    for(uint32_t iY=0; iY<cells.size(); iY++) {
-        for(const auto& p: cells[iY]) {
+    for(uint32_t iY=0; iY<cellRowCount(); iY++) {
+        for(const auto& p: cellRow(iY)) {
             const uint32_t iX = p.first;
             const Cell& cell = p.second;
             SHASTA_ASSERT(iX < sizeXY);
@@ -632,10 +724,10 @@ Aligner::Cell* Aligner::findCell(const Coordinates& iXY)
 {
     const uint32_t iX = iXY.first;
     const uint32_t iY = iXY.second;
-    if(iY >= cells.size()) {
+    if(iY >= cellRowCount()) {
         return 0;
     }
-    vector< pair<uint32_t, Cell> >& v = cells[iY];
+    const span<CellEntry> v = cellRow(iY);
 
     // Look for a cell with this iX.
     auto it = std::lower_bound(v.begin(), v.end(),
@@ -657,10 +749,10 @@ const Aligner::Cell* Aligner::findCell(const Coordinates& iXY) const
 {
     const uint32_t iX = iXY.first;
     const uint32_t iY = iXY.second;
-    if(iY >= cells.size()) {
+    if(iY >= cellRowCount()) {
         return 0;
     }
-    const vector< pair<uint32_t, Cell> >& v = cells[iY];
+    const span<const CellEntry> v = cellRow(iY);
 
     // Look for a cell with this iX.
     auto it = std::lower_bound(v.begin(), v.end(),
@@ -684,16 +776,16 @@ void Aligner::forwardSearch()
     uint64_t n = 0;
 
     // Initialize the stack of undiscovered iXY.
-    std::stack<Coordinates> s;
-    for(uint32_t iY=0; iY<cells.size(); iY++) {
-        vector< pair<uint32_t, Cell> >& v = cells[iY];
-        for(auto& p: v) {
+    vector<Coordinates>& s = workspace.stack;
+    s.clear();
+    for(uint32_t iY=0; iY<cellRowCount(); iY++) {
+        for(auto& p: cellRow(iY)) {
             Cell& cell = p.second;
             if(cell.isNearLeftOrTop) {
                 cell.isForwardAccessible = 1;
                 ++n;
                 const uint32_t iX = p.first;
-                s.push(Coordinates(iX, iY));
+                s.push_back(Coordinates(iX, iY));
             }
         }
     }
@@ -701,10 +793,10 @@ void Aligner::forwardSearch()
     // DFS.
     vector<Coordinates> children;
     while(not s.empty()) {
-        const Coordinates& iXY0 = s.top();
+        const Coordinates iXY0 = s.back();
         const uint32_t iX0 = iXY0.first;
         const uint32_t iY0 = iXY0.second;
-        s.pop();
+        s.pop_back();
 
         // Loop over possible children.
         for(int32_t dY=-1; dY<=1; dY++) {
@@ -720,7 +812,7 @@ void Aligner::forwardSearch()
                 if(cell1 and not cell1->isForwardAccessible) {
                     cell1->isForwardAccessible = 1;
                     ++n;
-                    s.push(iXY1);
+                    s.push_back(iXY1);
                 }
             }
         }
@@ -738,16 +830,16 @@ void Aligner::backwardSearch()
     uint64_t n = 0;
 
     // Initialize the stack of undiscovered iXY.
-    std::stack<Coordinates> s;
-    for(uint32_t iY=0; iY<cells.size(); iY++) {
-        vector< pair<uint32_t, Cell> >& v = cells[iY];
-        for(auto& p: v) {
+    vector<Coordinates>& s = workspace.stack;
+    s.clear();
+    for(uint32_t iY=0; iY<cellRowCount(); iY++) {
+        for(auto& p: cellRow(iY)) {
             Cell& cell = p.second;
             if(cell.isNearRightOrBottom and cell.isForwardAccessible) {
                 cell.isBackwardAccessible = 1;
                 ++n;
                 const uint32_t iX = p.first;
-                s.push(Coordinates(iX, iY));
+                s.push_back(Coordinates(iX, iY));
             }
         }
     }
@@ -755,10 +847,10 @@ void Aligner::backwardSearch()
     // DFS.
     vector<Coordinates> children;
     while(not s.empty()) {
-        const Coordinates& iXY0 = s.top();
+        const Coordinates iXY0 = s.back();
         const uint32_t iX0 = iXY0.first;
         const uint32_t iY0 = iXY0.second;
-        s.pop();
+        s.pop_back();
 
         // Loop over possible parents.
         for(int32_t dY=-1; dY<=1; dY++) {
@@ -778,7 +870,7 @@ void Aligner::backwardSearch()
                 if(cell1 and not cell1->isBackwardAccessible) {
                     cell1->isBackwardAccessible = 1;
                     ++n;
-                    s.push(iXY1);
+                    s.push_back(iXY1);
                 }
             }
         }
@@ -796,9 +888,8 @@ void Aligner::findActiveCellsConnectedComponents()
     // The id will be used for the connected component computation below.
     uint32_t nextCellId = 0;
     std::unordered_map<Coordinates, uint32_t, HashTuple<Coordinates> > activeCells;
-    for(uint32_t iY=0; iY<cells.size(); iY++) {
-        const vector< pair<uint32_t, Cell> >& iYCells = cells[iY];
-        for(const pair<uint32_t, Cell>& p: iYCells) {
+    for(uint32_t iY=0; iY<cellRowCount(); iY++) {
+        for(const CellEntry& p: cellRow(iY)) {
             const Cell& cell = p.second;
             if(cell.isActive()) {
                 const uint32_t iX = p.first;
@@ -936,8 +1027,13 @@ void Aligner::computeBandedAlignments(
         // Compute an alignment with this band.
         Alignment alignment;
         AlignmentInfo alignmentInfo;
-        computeBandedAlignment(kmerIds, bandMin, bandMax,
-            alignment, alignmentInfo, debug);
+        if(nativeBandedAlignment) {
+            computeBandedAlignmentNative(kmerIds, bandMin, bandMax,
+                alignment, alignmentInfo, debug);
+        } else {
+            computeBandedAlignment(kmerIds, bandMin, bandMax,
+                alignment, alignmentInfo, debug);
+        }
 
         // Skip it, if it does not satisfy the requirements on
         // minAlignedMarkerCount, minAlignedFraction, maxSkip, maxDrift, maxTrim.
@@ -1086,3 +1182,206 @@ bool Aligner::computeBandedAlignment(
     return true;
 }
 
+
+
+
+// Same as computeBandedAlignment, but without using SeqAn.
+// Like the SeqAn version, this uses linear gaps and free end gaps
+// on both sequences, so the alignment can start on the
+// first row or column of the alignment matrix and end on
+// the last row or column.
+// The dynamic programming matrix is stored by rows (iy = ordinal1)
+// and, within each row, by diagonal in the band,
+// k = ix - iy - bandMin, where ix = ordinal0.
+// With this layout the diagonal and vertical contributions to
+// a row only depend on the previous row, and are computed
+// in a branch-free loop that the compiler can vectorize.
+// The horizontal contributions are then added in a separate scan.
+bool Aligner::computeBandedAlignmentNative(
+    const array<span<KmerId>, 2>& kmerIds,
+    int32_t bandMin,
+    int32_t bandMax,
+    Alignment& alignment,
+    AlignmentInfo& alignmentInfo,
+    bool debug) const
+{
+    if(debug) {
+        cout << timestamp << "Native banded alignment computation begins." << endl;
+    }
+    alignment.clear();
+
+    const span<KmerId>& x = kmerIds[0];
+    const span<KmerId>& y = kmerIds[1];
+    const int32_t n0 = int32_t(x.size());
+    const int32_t n1 = int32_t(y.size());
+    SHASTA_ASSERT(bandMax >= bandMin);
+    const int32_t w = bandMax - bandMin + 1;
+
+    // Value used for cells outside the alignment matrix.
+    // It is low enough that it can never contribute to a maximum,
+    // and high enough that adding scores to it cannot overflow.
+    const int32_t invalidScore = std::numeric_limits<int32_t>::min() / 2;
+
+    // Traceback bits. When there are ties, more than one is set.
+    const uint8_t diagonalBit   = 1;
+    const uint8_t verticalBit   = 2;
+    const uint8_t horizontalBit = 4;
+
+    // Scores for the previous and current row.
+    // The extra entry at the end is never valid and simplifies
+    // the vertical contribution at the edge of the band.
+    vector<int32_t> previousRow(w + 1, invalidScore);
+    vector<int32_t> currentRow(w + 1, invalidScore);
+
+    // The traceback bits for all cells in the band, stored by row.
+    vector<uint8_t> traceback(uint64_t(n1 + 1) * uint64_t(w), 0);
+
+    // Range of k for which ix is in [0, n0] on row iy.
+    auto kBegin = [&](int32_t iy) {return max(0, -iy - bandMin);};
+    auto kEnd = [&](int32_t iy) {return min(w, n0 - iy - bandMin + 1);};
+
+    // Keep track of the best cell on the last row or column.
+    // Cells are considered in the order in which they would be
+    // encountered by a computation by columns (increasing ix, then iy),
+    // and the first one with the best score is kept.
+    int32_t bestScore = invalidScore;
+    int32_t bestIx = -1;
+    int32_t bestIy = -1;
+    vector<int32_t> lastColumnScores(n1 + 1, invalidScore);
+
+    for(int32_t iy=0; iy<=n1; iy++) {
+        const int32_t k0 = kBegin(iy);
+        const int32_t k1 = kEnd(iy);
+        uint8_t* rowTraceback = traceback.data() + uint64_t(iy) * uint64_t(w);
+        std::fill(currentRow.begin(), currentRow.end(), invalidScore);
+
+        if(iy == 0) {
+            // First row. Free begin gap on y.
+            for(int32_t k=k0; k<k1; k++) {
+                currentRow[k] = 0;
+            }
+        } else if(k0 < k1) {
+
+            // Free begin gap on x.
+            int32_t kFirst = k0;
+            if(iy + bandMin + k0 == 0) {
+                currentRow[k0] = 0;
+                ++kFirst;
+            }
+
+            // Diagonal and vertical contributions.
+            // This loop is branch free and can be vectorized.
+            const KmerId yKmerId = y[iy - 1];
+            const int32_t ixOffset = iy + bandMin - 1;
+            const int32_t* p = previousRow.data();
+            int32_t* c = currentRow.data();
+            for(int32_t k=kFirst; k<k1; k++) {
+                const int32_t diagonalScore = p[k] +
+                    ((x[ixOffset + k] == yKmerId) ? matchScore : mismatchScore);
+                const int32_t verticalScore = p[k + 1] + gapScore;
+                const int32_t score = max(diagonalScore, verticalScore);
+                c[k] = score;
+                rowTraceback[k] = uint8_t(
+                    ((diagonalScore == score) ? diagonalBit : 0) |
+                    ((verticalScore == score) ? verticalBit : 0));
+            }
+
+            // Horizontal contributions.
+            for(int32_t k=k0+1; k<k1; k++) {
+                const int32_t horizontalScore = c[k - 1] + gapScore;
+                if(horizontalScore > c[k]) {
+                    c[k] = horizontalScore;
+                    rowTraceback[k] = horizontalBit;
+                } else if(horizontalScore == c[k]) {
+                    rowTraceback[k] |= horizontalBit;
+                }
+            }
+        }
+
+        // Store the score of the cell on the last column, if in the band.
+        const int32_t kLast = n0 - iy - bandMin;
+        if(kLast >= 0 and kLast < w) {
+            lastColumnScores[iy] = currentRow[kLast];
+        }
+
+        // On the last row, look for the best cell except for the last column.
+        if(iy == n1) {
+            for(int32_t k=k0; k<k1; k++) {
+                const int32_t ix = iy + bandMin + k;
+                if(ix < n0 and currentRow[k] > bestScore) {
+                    bestScore = currentRow[k];
+                    bestIx = ix;
+                    bestIy = iy;
+                }
+            }
+        }
+
+        swap(previousRow, currentRow);
+    }
+
+    // Now look at the last column.
+    for(int32_t iy=0; iy<=n1; iy++) {
+        if(lastColumnScores[iy] > bestScore) {
+            bestScore = lastColumnScores[iy];
+            bestIx = n0;
+            bestIy = iy;
+        }
+    }
+
+    if(bestScore == invalidScore) {
+        cout << "Native banded alignment computation failed." << endl;
+        return false;
+    } else if(debug) {
+        cout << "Alignment score is " << bestScore << endl;
+    }
+
+    // Traceback. With ties, prefer the diagonal, then the vertical direction.
+    int32_t ix = bestIx;
+    int32_t iy = bestIy;
+    while(ix > 0 and iy > 0) {
+        const uint8_t t = traceback[uint64_t(iy) * uint64_t(w) + uint64_t(ix - iy - bandMin)];
+        if(t & diagonalBit) {
+            --ix;
+            --iy;
+            if(x[ix] == y[iy]) {
+                alignment.ordinals.push_back(array<uint32_t, 2>{uint32_t(ix), uint32_t(iy)});
+            }
+        } else if(t & verticalBit) {
+            --iy;
+        } else {
+            SHASTA_ASSERT(t & horizontalBit);
+            --ix;
+        }
+    }
+    reverse(alignment.ordinals.begin(), alignment.ordinals.end());
+
+    // Create the AlignmentInfo.
+    alignmentInfo.create(alignment, nx, ny);
+    if(debug) {
+        const pair<uint32_t, uint32_t> trim = alignmentInfo.computeTrim();
+        cout << "Aligned marker count " << alignmentInfo.markerCount << endl;
+        cout << "Aligned marker fraction " <<
+            alignmentInfo.alignedFraction(0) << " " <<
+            alignmentInfo.alignedFraction(1) << endl;
+        cout << "maxSkip " << alignmentInfo.maxSkip << endl;
+        cout << "maxDrift " << alignmentInfo.maxDrift << endl;
+        cout << "Trim " << trim.first << " " << trim.second << endl;
+        cout << timestamp << "Native banded alignment computation ends." << endl;
+    }
+    return true;
+}
+
+
+
+uint64_t Workspace::allocatedByteCount() const
+{
+    return
+        alignmentMatrixEntries.capacity() * sizeof(Aligner::AlignmentMatrixEntry) +
+        alignmentMatrixRowBegin.capacity() * sizeof(uint64_t) +
+        stagedAlignmentMatrixEntries.capacity() * sizeof(Aligner::StagedAlignmentMatrixEntry) +
+        stagedAlignmentMatrixEntriesWork.capacity() * sizeof(Aligner::StagedAlignmentMatrixEntry) +
+        count.capacity() * sizeof(uint64_t) +
+        cellEntries.capacity() * sizeof(Aligner::CellEntry) +
+        cellRowBegin.capacity() * sizeof(uint64_t) +
+        stack.capacity() * sizeof(Coordinates);
+}
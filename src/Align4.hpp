@@ -50,9 +50,15 @@ in which non-zero alignment matrix entries are stored
 organized by cell in a rectangular arrangement if cells
 of size (deltaX, deltaY) in (X,Y) space.
 
+The alignment matrix entries and the cells are stored
+in a flat, compressed sparse row layout (one row for each iY),
+in vectors owned by an Align4::Workspace.
+The Workspace can be reused for many alignments, so
+in the common case no memory allocation takes place
+when computing an alignment.
+
 *******************************************************************************/
 
-#include "MemoryMappedAllocator.hpp"
 #include "shastaTypes.hpp"
 #include "span.hpp"
 
@@ -66,12 +72,13 @@ namespace shasta {
     class Alignment;
     class AlignmentInfo;
     class CompressedMarker;
-    class PngImage;
+    class KmerMask;
 
     namespace Align4 {
         class Aligner;
         class MatrixEntry;
         class Options;
+        class Workspace;
 
         // This is used to store (x,y), (X,Y), or (iX, iY).
         using Coordinates = pair<uint32_t, uint32_t>;
@@ -87,16 +94,12 @@ namespace shasta {
             const array< span<KmerId>, 2>& kmerIds,
             const array<span<pair<KmerId, uint32_t> >, 2> sortedMarkers,
             const Align4::Options&,
-            MemoryMapped::ByteAllocator&,
+            Workspace&,
             Alignment&,
             AlignmentInfo&,
             bool debug);
     }
 
-    namespace MemoryMapped {
-        class ByteAllocator;
-    }
-
 }
 
 
@@ -116,6 +119,14 @@ public:
     int64_t matchScore;
     int64_t mismatchScore;
     int64_t gapScore;
+
+    // If set, the banded alignments are computed with
+    // computeBandedAlignmentNative instead of SeqAn.
+    bool nativeBandedAlignment = false;
+
+    // If not null, KmerIds in this mask are not used
+    // to create the alignment matrix.
+    const KmerMask* kmerMask = nullptr;
 };
 
 
@@ -139,12 +150,16 @@ public:
         const array< span<KmerId>, 2>& kmerIds,
         const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkers,
         const Options&,
-        MemoryMapped::ByteAllocator&,
+        Workspace&,
         Alignment&,
         AlignmentInfo&,
         bool debug);
 
 private:
+    friend class Workspace;
+
+    // The Workspace that owns the vectors used by this Aligner.
+    Workspace& workspace;
 
     // Number of markers (not features) in the two sequences being aligned.
     uint32_t nx;
@@ -159,6 +174,12 @@ private:
     int32_t mismatchScore = -1;
     int32_t gapScore = -1;
 
+    // If set, use computeBandedAlignmentNative instead of SeqAn.
+    bool nativeBandedAlignment;
+
+    // KmerIds not used to create the alignment matrix, or null.
+    const KmerMask* kmerMask;
+
 
     // Vector of markers for each sequence.
     // array<vector<KmerId>, 2> markers;
@@ -168,24 +189,32 @@ private:
     // For each iY, we store pairs(iX, xy) sorted by iX.
     // Even though this requires sorting, it is more efficient
     // than using a hash table, due to the better memory access pattern.
+    // The entries for all iY are stored contiguously in the Workspace.
     using AlignmentMatrixEntry = pair<uint32_t, Coordinates>; // (iX, xy)
-    using AlignmentMatrixAllocator = MemoryMapped::Allocator<AlignmentMatrixEntry>;
-    using AlignmentMatrixEntryVector = vector<AlignmentMatrixEntry, AlignmentMatrixAllocator>; // For one iY
-    using AlignmentMatrix = vector<AlignmentMatrixEntryVector>; // Indexed by iY.
-    AlignmentMatrix alignmentMatrix;
+    uint32_t alignmentMatrixRowCount() const;
+    span<const AlignmentMatrixEntry> alignmentMatrixRow(uint32_t iY) const;
+
+    // Alignment matrix entries before sorting by (iY, iX).
+    class StagedAlignmentMatrixEntry {
+    public:
+        uint32_t iX;
+        uint32_t iY;
+        Coordinates xy;
+    };
+
     void createAlignmentMatrix(const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkers);
     void writeAlignmentMatrixCsv(const string& fileName) const;
     void writeAlignmentMatrixPng(
         const string& fileName,
         uint64_t maxDistanceFromBoundary) const;
-    void writeCheckerboard(
-        PngImage&,
+    array<uint8_t, 3> checkerboardRgb(
+        const Coordinates&,
         uint64_t maxDistanceFromBoundary) const;
 
 
 
     // Cells in (X,Y) space.
-    // Stored similarly to alignmentMatrix above: for each iY,
+    // Stored similarly to the alignment matrix above: for each iY,
     // we store pairs (iX, Cell) sorted by iX.
     class Cell {
     public:
@@ -203,7 +232,10 @@ private:
         }
     };
     static_assert(sizeof(Cell)==1, "Unexpected size of Align5::Aligner::Cell.");
-    vector< vector< pair<uint32_t, Cell> > > cells;
+    using CellEntry = pair<uint32_t, Cell>; // (iX, Cell)
+    uint32_t cellRowCount() const;
+    span<CellEntry> cellRow(uint32_t iY);
+    span<const CellEntry> cellRow(uint32_t iY) const;
     void createCells(
         uint64_t minEntryCountPerCell,
         uint64_t maxDistanceFromBoundary);
@@ -298,9 +330,54 @@ private:
         AlignmentInfo&,
         bool debug) const;
 
-    MemoryMapped::ByteAllocator& byteAllocator;
+    // Same as computeBandedAlignment, but without using SeqAn.
+    // This uses a dynamic programming matrix stored by rows (iy)
+    // and diagonals within the band, so the inner loop over each
+    // row is a contiguous scan the compiler can vectorize.
+    bool computeBandedAlignmentNative(
+        const array<span<KmerId>, 2>& kmerIds,
+        int32_t bandMin,
+        int32_t bandMax,
+        Alignment&,
+        AlignmentInfo&,
+        bool debug) const;
+
+};
+
+
 
+// Data structures used by Align4::Aligner.
+// They are kept here so they can be reused when computing
+// many alignments, for example one Workspace for each thread.
+// This avoids memory allocation for each alignment, as the
+// vectors keep their capacity from one alignment to the next.
+class shasta::Align4::Workspace {
+public:
+
+    // Approximate number of bytes allocated by this Workspace.
+    uint64_t allocatedByteCount() const;
 
+private:
+    friend class Aligner;
+
+    // The alignment matrix in compressed sparse row layout.
+    // The entries for row iY are in positions
+    // [alignmentMatrixRowBegin[iY], alignmentMatrixRowBegin[iY+1])
+    // of alignmentMatrixEntries.
+    vector<Aligner::AlignmentMatrixEntry> alignmentMatrixEntries;
+    vector<uint64_t> alignmentMatrixRowBegin;
+
+    // Work areas used to create the alignment matrix.
+    vector<Aligner::StagedAlignmentMatrixEntry> stagedAlignmentMatrixEntries;
+    vector<Aligner::StagedAlignmentMatrixEntry> stagedAlignmentMatrixEntriesWork;
+    vector<uint64_t> count;
+
+    // The cells, stored in the same way as the alignment matrix.
+    vector<Aligner::CellEntry> cellEntries;
+    vector<uint64_t> cellRowBegin;
+
+    // The stack used by forwardSearch and backwardSearch.
+    vector<Coordinates> stack;
 };
 
 
@@ -16,6 +16,7 @@ namespace shasta {
     class Alignment;
     class AlignmentData;
     class AlignmentInfo;
+    class CompactAlignmentData;
     enum class AlignmentType;
     void reverse(AlignmentType&);
 
@@ -448,6 +449,35 @@ public:
 
 
 
+// The compact part of an AlignmentData, containing only the information
+// used by most stages after the alignments are computed.
+// The assembler stores the alignments it finds as a vector
+// of CompactAlignmentData and a parallel vector of AlignmentInfo,
+// so stages that only need the read ids, the relative orientation,
+// and the number of aligned markers don't have to touch the AlignmentInfo.
+class shasta::CompactAlignmentData :
+    public shasta::OrientedReadPair {
+public:
+
+    // Flag that is set if this alignment is used in the read graph.
+    // This is the stored value of the flag.
+    // The one in the AlignmentInfo stored in parallel is not used.
+    uint8_t isInReadGraph = 0;
+
+    // The number of markers in the alignment.
+    uint32_t markerCount = 0;
+
+    CompactAlignmentData() {}
+    CompactAlignmentData(const AlignmentData& ad) :
+        OrientedReadPair(ad),
+        isInReadGraph(ad.info.isInReadGraph),
+        markerCount(ad.info.markerCount)
+    {}
+};
+static_assert(sizeof(shasta::CompactAlignmentData) == 16);
+
+
+
 // Compute the number of overlapping markers between two
 // oriented reads with given number of markers
 // and ordinal offset.
@@ -0,0 +1,178 @@
+// Shasta.
+#include "AlignmentCache.hpp"
+#include "MurmurHash2.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cstring>
+#include <filesystem>
+#include "fstream.hpp"
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+
+
+
+AlignmentCache::AlignmentCache(const string& fileName, uint64_t threadCount) :
+    fileName(fileName),
+    threadData(threadCount)
+{
+    if(not std::filesystem::exists(fileName)) {
+        cout << "Alignment cache " << fileName << " does not exist and will be created." << endl;
+        return;
+    }
+
+    ifstream file(fileName, std::ios::binary);
+    if(not file) {
+        throw runtime_error("Error opening alignment cache " + fileName);
+    }
+
+    // Check the header.
+    array<char, 8> fileMagic;
+    uint64_t fileVersion = 0;
+    file.read(fileMagic.data(), fileMagic.size());
+    file.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+    if(not file or std::memcmp(fileMagic.data(), magic, sizeof(magic)) != 0) {
+        throw runtime_error(fileName + " is not a Shasta alignment cache.");
+    }
+    if(fileVersion != version) {
+        throw runtime_error("Alignment cache " + fileName + " has unsupported version " +
+            to_string(fileVersion) + ".");
+    }
+
+    // Read the records.
+    FileRecord record;
+    while(file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        Entry entry;
+        entry.key = record.key;
+        entry.info = record.info;
+        entry.isGood = (record.isGood != 0);
+        entry.compressedAlignmentBegin = compressedAlignments.size();
+        entry.compressedAlignmentSize = record.compressedAlignmentSize;
+        compressedAlignments.resize(compressedAlignments.size() + record.compressedAlignmentSize);
+        file.read(compressedAlignments.data() + entry.compressedAlignmentBegin,
+            std::streamsize(record.compressedAlignmentSize));
+        if(not file) {
+            // A truncated record, possibly because a previous run was interrupted.
+            compressedAlignments.resize(entry.compressedAlignmentBegin);
+            cout << "Ignoring a truncated record at the end of alignment cache " << fileName << endl;
+            break;
+        }
+        entries.push_back(entry);
+    }
+
+    // Sort by key to allow binary search.
+    // The sort is stable so, for duplicate keys, find uses the oldest entry.
+    std::stable_sort(entries.begin(), entries.end());
+    cout << "Loaded " << entries.size() << " entries from alignment cache " << fileName << endl;
+}
+
+
+
+uint64_t AlignmentCache::computeKey(
+    uint64_t optionsHash,
+    span<const KmerId> kmerIds0,
+    span<const KmerId> kmerIds1)
+{
+    const array<uint64_t, 5> hashes = {
+        optionsHash,
+        kmerIds0.size(),
+        MurmurHash64A(kmerIds0.data(), int(kmerIds0.size() * sizeof(KmerId)), 231),
+        kmerIds1.size(),
+        MurmurHash64A(kmerIds1.data(), int(kmerIds1.size() * sizeof(KmerId)), 759)
+    };
+    return MurmurHash64A(hashes.data(), int(sizeof(hashes)), 1357);
+}
+
+
+
+bool AlignmentCache::find(
+    uint64_t key,
+    bool& isGood,
+    AlignmentInfo& info,
+    span<const char>& compressedAlignment) const
+{
+    Entry target;
+    target.key = key;
+    const auto it = std::lower_bound(entries.begin(), entries.end(), target);
+    if(it == entries.end() or it->key != key) {
+        return false;
+    }
+
+    isGood = it->isGood;
+    info = it->info;
+    const char* begin = compressedAlignments.data() + it->compressedAlignmentBegin;
+    compressedAlignment = span<const char>(begin, begin + it->compressedAlignmentSize);
+    return true;
+}
+
+
+
+void AlignmentCache::add(
+    uint64_t threadId,
+    uint64_t key,
+    const AlignmentInfo& info)
+{
+    ThreadData& data = threadData[threadId];
+    Entry entry;
+    entry.key = key;
+    entry.info = info;
+    entry.isGood = false;
+    entry.compressedAlignmentBegin = data.compressedAlignments.size();
+    entry.compressedAlignmentSize = 0;
+    data.entries.push_back(entry);
+}
+
+
+
+void AlignmentCache::setLastGood(
+    uint64_t threadId,
+    const string& compressedAlignment)
+{
+    ThreadData& data = threadData[threadId];
+    SHASTA_ASSERT(not data.entries.empty());
+    Entry& entry = data.entries.back();
+    SHASTA_ASSERT(not entry.isGood);
+    entry.isGood = true;
+    entry.compressedAlignmentBegin = data.compressedAlignments.size();
+    entry.compressedAlignmentSize = uint32_t(compressedAlignment.size());
+    data.compressedAlignments.insert(data.compressedAlignments.end(),
+        compressedAlignment.begin(), compressedAlignment.end());
+}
+
+
+
+void AlignmentCache::writeNewEntries()
+{
+    const bool exists = std::filesystem::exists(fileName);
+    ofstream file(fileName, std::ios::binary | std::ios::app);
+    if(not file) {
+        throw runtime_error("Error opening alignment cache " + fileName + " for writing.");
+    }
+    if(not exists) {
+        file.write(magic, sizeof(magic));
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+
+    uint64_t count = 0;
+    for(ThreadData& data: threadData) {
+        for(const Entry& entry: data.entries) {
+            FileRecord record;
+            record.key = entry.key;
+            record.info = entry.info;
+            record.compressedAlignmentSize = entry.compressedAlignmentSize;
+            record.isGood = entry.isGood ? 1 : 0;
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            file.write(data.compressedAlignments.data() + entry.compressedAlignmentBegin,
+                std::streamsize(entry.compressedAlignmentSize));
+            ++count;
+        }
+        data.entries.clear();
+        data.compressedAlignments.clear();
+    }
+    if(not file) {
+        throw runtime_error("Error writing alignment cache " + fileName);
+    }
+    cout << "Added " << count << " entries to alignment cache " << fileName << endl;
+}
@@ -0,0 +1,119 @@
+#ifndef SHASTA_ALIGNMENT_CACHE_HPP
+#define SHASTA_ALIGNMENT_CACHE_HPP
+
+// Shasta.
+#include "Alignment.hpp"
+#include "shastaTypes.hpp"
+
+// Standard library.
+#include "span.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class AlignmentCache;
+}
+
+
+
+// A cache of alignment results that persists across runs,
+// stored in a binary file that can be shared by many assemblies.
+// Each entry is keyed by a hash of the options that affect
+// the alignment computation and of the marker KmerIds of the two
+// oriented reads, so the cache is content-addressed:
+// a hit only requires the two oriented reads to have the same markers.
+// Alignments that did not satisfy the alignment criteria
+// are also stored, so they are not recomputed.
+//
+// File format: a header (magic string and version), followed by records,
+// each consisting of a FileRecord followed by the compressed alignment
+// (only present for good alignments).
+// New entries are appended at the end of the file.
+class shasta::AlignmentCache {
+public:
+
+    // Load the cache from the given file, if it exists.
+    AlignmentCache(const string& fileName, uint64_t threadCount);
+
+    // Compute the key for a pair of oriented reads.
+    // The optionsHash must include all options that affect the alignment.
+    static uint64_t computeKey(
+        uint64_t optionsHash,
+        span<const KmerId> kmerIds0,
+        span<const KmerId> kmerIds1);
+
+    // Look up a key. Return true if found and, in that case,
+    // fill in isGood, the AlignmentInfo and, for good alignments,
+    // the compressed alignment.
+    bool find(
+        uint64_t key,
+        bool& isGood,
+        AlignmentInfo&,
+        span<const char>& compressedAlignment) const;
+
+    // Add an entry computed by a given thread, initially flagged as
+    // an alignment that does not satisfy the alignment criteria.
+    // This is thread safe as long as each thread uses its own threadId.
+    // The entries are not visible to find, and are not written
+    // to the file, until writeNewEntries is called.
+    void add(
+        uint64_t threadId,
+        uint64_t key,
+        const AlignmentInfo&);
+
+    // Flag as good the last entry added by a given thread,
+    // and store its compressed alignment.
+    void setLastGood(
+        uint64_t threadId,
+        const string& compressedAlignment);
+
+    // Append to the file the entries added by all threads.
+    void writeNewEntries();
+
+    uint64_t size() const
+    {
+        return entries.size();
+    }
+
+private:
+    string fileName;
+
+    class FileRecord {
+    public:
+        uint64_t key;
+        AlignmentInfo info;
+        uint32_t compressedAlignmentSize;
+        uint32_t isGood;
+    };
+
+    class Entry {
+    public:
+        uint64_t key;
+        uint64_t compressedAlignmentBegin;
+        uint32_t compressedAlignmentSize;
+        bool isGood;
+        AlignmentInfo info;
+        bool operator<(const Entry& that) const
+        {
+            return key < that.key;
+        }
+    };
+
+    // The entries loaded from the file, sorted by key,
+    // and the compressed alignments they refer to.
+    vector<Entry> entries;
+    vector<char> compressedAlignments;
+
+    // The entries added by each thread, not yet written.
+    class ThreadData {
+    public:
+        vector<Entry> entries;
+        vector<char> compressedAlignments;
+    };
+    vector<ThreadData> threadData;
+
+    static constexpr char magic[8] = {'S', 'h', 'a', 's', 't', 'a', 'A', 'C'};
+    static constexpr uint64_t version = 1;
+};
+
+#endif
@@ -22,6 +22,13 @@ class shasta::AlignmentCandidates {
 public:
     MemoryMapped::Vector<OrientedReadPair> candidates;
 
+    // For each alignment candidate, the number of times it was found
+    // by the LowHash0 algorithm. This is only created by LowHash0
+    // and is indexed in the same way as the candidates vector above.
+    // It is used by computeAlignments to align the most
+    // promising candidates first.
+    MemoryMapped::Vector<uint16_t> frequencies;
+
     // For each alignment candidate, we also store a vector of
     // pairs (ordinal0, ordinal1), each containing
     // ordinals in the two oriented reads where identical
@@ -39,16 +46,22 @@ public:
 
     // Method to perform the indexing that fills candidateTable. Allocation of the memory mapped vector requires
     // knowing the number of reads participating in the candidate pairs, and a name + page size to initialize with.
-    void computeCandidateTable(ReadId readCount, string largeDataName, size_t largeDataPageSize);
+    void computeCandidateTable(
+        ReadId readCount,
+        string largeDataName,
+        size_t largeDataPageSize,
+        size_t threadCount);
 
     void unreserve() {
         candidates.unreserve();
+        if(frequencies.isOpenWithWriteAccess) frequencies.unreserve();
         // featureOrdinals is not used by LowHash0
         if (featureOrdinals.isOpenWithWriteAccess()) featureOrdinals.unreserve();
     }
 
     void clear() {
         candidates.clear();
+        if(frequencies.isOpenWithWriteAccess) frequencies.clear();
         // featureOrdinals is not used by LowHash0
         if (featureOrdinals.isOpenWithWriteAccess()) featureOrdinals.clear();
         unreserve();
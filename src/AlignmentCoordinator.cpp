@@ -0,0 +1,389 @@
+// Implementation of distributed alignment computation.
+// See AlignmentCoordinator.hpp for more information.
+
+// Shasta.
+#include "AlignmentCoordinator.hpp"
+#include "performanceLog.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/v6_only.hpp>
+
+// Standard library.
+#include "algorithm.hpp"
+#include "chrono.hpp"
+#include <filesystem>
+#include "fstream.hpp"
+#include <sstream>
+#include "stdexcept.hpp"
+
+// Linux.
+#include <unistd.h>
+
+const string AlignmentCoordinator::shardDirectory = "AlignmentShards";
+
+
+
+AlignmentCoordinator::AlignmentCoordinator(
+    uint16_t port,
+    uint64_t candidateCount,
+    uint64_t optionsHash) :
+    state(make_shared<State>())
+{
+    using boost::asio::io_service;
+    using boost::asio::ip::tcp;
+
+    state->candidateCount = candidateCount;
+    state->optionsHash = optionsHash;
+
+    // Large ranges for the workers keep the number of messages
+    // and shard files low.
+    state->remoteRangeSize = max(uint64_t(1000), candidateCount / 1000);
+
+    std::filesystem::remove_all(shardDirectory);
+    std::filesystem::create_directory(shardDirectory);
+
+    // Create the acceptor, accepting both ipv4 and ipv6 ip addresses.
+    // This is done here rather than in the accept thread,
+    // so errors are reported to the caller.
+    const auto service = make_shared<io_service>();
+    const auto acceptor = make_shared<tcp::acceptor>(*service);
+    const tcp::endpoint endpoint(tcp::v6(), port);
+    try {
+        acceptor->open(endpoint.protocol());
+        acceptor->set_option(boost::asio::ip::v6_only(false));
+        acceptor->set_option(tcp::acceptor::reuse_address(true));
+        acceptor->bind(endpoint);
+        acceptor->listen();
+        acceptor->non_blocking(true);
+    } catch(const std::exception& e) {
+        throw runtime_error("Unable to use port " + to_string(port) + " for alignment workers: " + e.what());
+    }
+
+    // The accept thread polls the acceptor, so it can be stopped
+    // by the destructor. Each worker is served by a detached thread.
+    acceptThread = std::thread([this, service, acceptor]()
+    {
+        while(not stopping) {
+            const auto s = make_shared<tcp::iostream>();
+            boost::system::error_code errorCode;
+            acceptor->accept(*s->rdbuf(), errorCode);
+            if(errorCode) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            const shared_ptr<State> workerState = state;
+            std::thread([workerState, s]()
+            {
+                try {
+                    workerState->serveWorker(*s);
+                } catch(...) {
+                    // Ignore errors in the connection.
+                }
+            }).detach();
+        }
+    });
+
+    cout << timestamp << "Alignment workers can connect to port " << port << "." << endl;
+}
+
+
+
+AlignmentCoordinator::~AlignmentCoordinator()
+{
+    stopping = true;
+    acceptThread.join();
+}
+
+
+
+// Get a range of at most maxSize candidates that were not yet dispensed.
+// The mutex must be locked.
+bool AlignmentCoordinator::State::getRange(uint64_t maxSize, uint64_t& begin, uint64_t& end)
+{
+    if(not returnedRanges.empty()) {
+        pair<uint64_t, uint64_t>& range = returnedRanges.back();
+        begin = range.first;
+        end = min(range.second, begin + maxSize);
+        range.first = end;
+        if(range.first == range.second) {
+            returnedRanges.pop_back();
+        }
+        return true;
+    }
+
+    if(nextCandidate < candidateCount) {
+        begin = nextCandidate;
+        end = min(candidateCount, begin + maxSize);
+        nextCandidate = end;
+        return true;
+    }
+
+    return false;
+}
+
+
+
+bool AlignmentCoordinator::getLocalBatch(uint64_t batchSize, uint64_t& begin, uint64_t& end)
+{
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(state->getRange(batchSize, begin, end)) {
+                return true;
+            }
+            if(state->outstandingRangeCount == 0) {
+                return false;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+
+
+vector<AlignmentCoordinator::Shard> AlignmentCoordinator::getShards() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    SHASTA_ASSERT(state->outstandingRangeCount == 0);
+    vector<Shard> shards = state->shards;
+    sort(shards.begin(), shards.end());
+    return shards;
+}
+
+
+
+// Serve one worker until it disconnects or there are no more ranges.
+void AlignmentCoordinator::State::serveWorker(std::iostream& s)
+{
+    string line;
+    string keyword;
+    string workerName;
+    if(not std::getline(s, line)) {
+        return;
+    }
+    std::istringstream(line) >> keyword >> workerName;
+    if(keyword != "hello") {
+        return;
+    }
+    s << "options " << optionsHash << " " << candidateCount << "\n" << std::flush;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        performanceLog << timestamp << "Alignment worker " << workerName << " connected." << endl;
+    }
+
+    bool hasRange = false;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    while(std::getline(s, line)) {
+        std::istringstream lineStream(line);
+        lineStream >> keyword;
+
+        if(keyword == "next" and not hasRange) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(getRange(remoteRangeSize, begin, end)) {
+                hasRange = true;
+                ++outstandingRangeCount;
+                s << "range " << begin << " " << end << "\n" << std::flush;
+            } else {
+                s << "done\n" << std::flush;
+                break;
+            }
+        }
+
+        else if(keyword == "completed" and hasRange) {
+            uint64_t completedBegin = 0;
+            uint64_t completedEnd = 0;
+            uint64_t alignmentCount = 0;
+            lineStream >> completedBegin >> completedEnd >> alignmentCount;
+            if(completedBegin != begin or completedEnd != end) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            shards.push_back({begin, end, alignmentCount});
+            --outstandingRangeCount;
+            hasRange = false;
+        }
+
+        else {
+            break;
+        }
+    }
+
+    // If the worker was lost while working on a range,
+    // the range will be dispensed again.
+    std::lock_guard<std::mutex> lock(mutex);
+    if(hasRange) {
+        returnedRanges.push_back({begin, end});
+        --outstandingRangeCount;
+        performanceLog << timestamp << "Alignment worker " << workerName <<
+            " was lost. Candidates " << begin << " to " << end <<
+            " will be dispensed again." << endl;
+    } else {
+        performanceLog << timestamp << "Alignment worker " << workerName << " disconnected." << endl;
+    }
+}
+
+
+
+string AlignmentCoordinator::shardFileName(uint64_t begin, uint64_t end)
+{
+    return shardDirectory + "/Shard-" + to_string(begin) + "-" + to_string(end);
+}
+
+
+
+// The shard file contains the number of alignments n,
+// followed by n AlignmentData, n sizes of the compressed alignments,
+// and the compressed alignments.
+// It is written to a temporary file and renamed,
+// so a partially written shard is never used.
+void AlignmentCoordinator::writeShard(
+    const string& fileName,
+    const vector< vector<AlignmentData> >& threadAlignmentData,
+    const vector< shared_ptr< MemoryMapped::VectorOfVectors<char, uint64_t> > >& threadCompressedAlignments)
+{
+    uint64_t n = 0;
+    for(const vector<AlignmentData>& v: threadAlignmentData) {
+        n += v.size();
+    }
+
+    const string temporaryFileName = fileName + ".tmp-" + to_string(::getpid());
+    {
+        ofstream file(temporaryFileName, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        for(const vector<AlignmentData>& v: threadAlignmentData) {
+            file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(AlignmentData));
+        }
+        for(const auto& p: threadCompressedAlignments) {
+            for(uint64_t i=0; i<p->size(); i++) {
+                const uint64_t size = p->size(i);
+                file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            }
+        }
+        for(const auto& p: threadCompressedAlignments) {
+            file.write(p->begin(), p->totalSize());
+        }
+        if(not file) {
+            throw runtime_error("Error writing " + temporaryFileName);
+        }
+    }
+    std::filesystem::rename(temporaryFileName, fileName);
+}
+
+
+
+uint64_t AlignmentCoordinator::readShard(
+    const string& fileName,
+    vector<AlignmentData>& alignmentData,
+    MemoryMapped::VectorOfVectors<char, uint64_t>& compressedAlignments)
+{
+    ifstream file(fileName, std::ios::binary);
+    uint64_t n = 0;
+    file.read(reinterpret_cast<char*>(&n), sizeof(n));
+
+    alignmentData.resize(n);
+    file.read(reinterpret_cast<char*>(alignmentData.data()), n * sizeof(AlignmentData));
+
+    vector<uint64_t> sizes(n);
+    file.read(reinterpret_cast<char*>(sizes.data()), n * sizeof(uint64_t));
+    for(const uint64_t size: sizes) {
+        compressedAlignments.appendVector(size);
+        if(size > 0) {
+            file.read(compressedAlignments.begin(compressedAlignments.size() - 1), size);
+        }
+    }
+
+    if(not file) {
+        throw runtime_error("Error reading alignment shard " + fileName);
+    }
+    return n;
+}
+
+
+
+class AlignmentWorkerConnection::Implementation {
+public:
+    boost::asio::ip::tcp::iostream s;
+};
+
+
+
+AlignmentWorkerConnection::AlignmentWorkerConnection(
+    const string& coordinator,
+    const string& workerName) :
+    implementation(make_unique<Implementation>())
+{
+    const auto colon = coordinator.find_last_of(':');
+    if(colon == string::npos) {
+        throw runtime_error("The alignment coordinator must be specified as host:port. "
+            "Found " + coordinator);
+    }
+    const string host = coordinator.substr(0, colon);
+    const string port = coordinator.substr(colon + 1);
+
+    // Until the coordinator reaches the alignments stage, it does not accept connections,
+    // so keep trying.
+    auto& s = implementation->s;
+    while(true) {
+        s.clear();
+        s.connect(host, port);
+        if(s) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    }
+
+    s << "hello " << workerName << "\n" << std::flush;
+    string line;
+    string keyword;
+    if(not std::getline(s, line)) {
+        throw runtime_error("No response from alignment coordinator " + coordinator);
+    }
+    std::istringstream(line) >> keyword >> optionsHash >> candidateCount;
+    if(keyword != "options") {
+        throw runtime_error("Unexpected response from alignment coordinator " + coordinator + ": " + line);
+    }
+}
+
+
+
+AlignmentWorkerConnection::~AlignmentWorkerConnection()
+{
+}
+
+
+
+bool AlignmentWorkerConnection::getRange(uint64_t& begin, uint64_t& end)
+{
+    auto& s = implementation->s;
+    s << "next\n" << std::flush;
+    string line;
+    string keyword;
+    if(not std::getline(s, line)) {
+        throw runtime_error("Lost connection to the alignment coordinator.");
+    }
+    std::istringstream(line) >> keyword >> begin >> end;
+    if(keyword == "range") {
+        return true;
+    }
+    if(keyword == "done") {
+        return false;
+    }
+    throw runtime_error("Unexpected response from alignment coordinator: " + line);
+}
+
+
+
+void AlignmentWorkerConnection::complete(uint64_t begin, uint64_t end, uint64_t alignmentCount)
+{
+    auto& s = implementation->s;
+    s << "completed " << begin << " " << end << " " << alignmentCount << "\n" << std::flush;
+    if(not s) {
+        throw runtime_error("Lost connection to the alignment coordinator.");
+    }
+}
@@ -0,0 +1,177 @@
+#ifndef SHASTA_ALIGNMENT_COORDINATOR_HPP
+#define SHASTA_ALIGNMENT_COORDINATOR_HPP
+
+/*******************************************************************************
+
+Distributed computation of alignments.
+
+When --alignmentWorkerPort is used, Assembler::computeAlignments
+creates an AlignmentCoordinator, which listens on that port
+for connections from alignment worker processes, started
+with --command alignmentWorker on other machines.
+The workers access the binary data of the assembly (Data/)
+via a shared filesystem, so the assembly must use
+--memoryMode filesystem --memoryBacking disk in a directory
+visible to all machines.
+
+The alignment candidates are divided in ranges of consecutive candidates.
+Ranges are dispensed, on request, to the threads of the coordinator process
+(in small batches) and to the workers (in large ranges).
+Each worker computes the alignments for its range and writes
+the good alignments to a shard file in the shard directory
+(AlignmentShards in the assembly directory), then tells the coordinator
+it completed the range. The coordinator merges the shards into
+the alignment data after all ranges are completed.
+If a connection to a worker is lost while it is working on a range,
+the range is dispensed again, normally to the threads of the coordinator.
+
+The protocol uses one line of text for each message:
+- worker:      hello <name>
+- coordinator: options <options hash> <number of candidates>
+- worker:      next
+- coordinator: range <begin> <end>     (or done, if there are no more ranges)
+- worker:      completed <begin> <end> <number of good alignments>
+- worker:      next
+...
+The options hash is used by the worker to check that it uses
+the same alignment options as the coordinator.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Alignment.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+
+// Standard library.
+#include <atomic>
+#include "cstdint.hpp"
+#include "iostream.hpp"
+#include "memory.hpp"
+#include <mutex>
+#include "string.hpp"
+#include <thread>
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class AlignmentCoordinator;
+    class AlignmentWorkerConnection;
+}
+
+
+
+class shasta::AlignmentCoordinator {
+public:
+
+    // Start listening for workers on the given port.
+    // Throws if the port cannot be used.
+    AlignmentCoordinator(
+        uint16_t port,
+        uint64_t candidateCount,
+        uint64_t optionsHash);
+
+    // Stop accepting new workers.
+    ~AlignmentCoordinator();
+
+    AlignmentCoordinator(const AlignmentCoordinator&) = delete;
+    AlignmentCoordinator& operator=(const AlignmentCoordinator&) = delete;
+
+    // Get a batch of at most batchSize candidates for a thread of the coordinator.
+    // While ranges are being processed by workers, this waits,
+    // because those ranges are dispensed again if a worker is lost.
+    // Returns false when all ranges were dispensed and completed.
+    bool getLocalBatch(uint64_t batchSize, uint64_t& begin, uint64_t& end);
+
+    // The ranges completed by workers, sorted by begin.
+    // This can only be called after getLocalBatch returned false.
+    class Shard {
+    public:
+        uint64_t begin;
+        uint64_t end;
+        uint64_t alignmentCount;
+        bool operator<(const Shard& that) const
+        {
+            return begin < that.begin;
+        }
+    };
+    vector<Shard> getShards() const;
+
+    // The directory containing the shard files, relative to the assembly directory,
+    // and the name of the shard file for a range.
+    static const string shardDirectory;
+    static string shardFileName(uint64_t begin, uint64_t end);
+
+    // Write the alignments found by the threads of a worker to a shard file.
+    static void writeShard(
+        const string& fileName,
+        const vector< vector<AlignmentData> >& threadAlignmentData,
+        const vector< shared_ptr< MemoryMapped::VectorOfVectors<char, uint64_t> > >& threadCompressedAlignments);
+
+    // Read the alignments stored in a shard file.
+    // The AlignmentData are returned in the vector
+    // and the compressed alignments are appended.
+    // Returns the number of alignments.
+    static uint64_t readShard(
+        const string& fileName,
+        vector<AlignmentData>&,
+        MemoryMapped::VectorOfVectors<char, uint64_t>& compressedAlignments);
+
+private:
+
+    // The state shared with the threads that serve the workers.
+    // Connection threads are detached and keep it alive
+    // after the AlignmentCoordinator is destroyed.
+    class State {
+    public:
+        uint64_t candidateCount;
+        uint64_t optionsHash;
+        uint64_t remoteRangeSize;
+
+        // Everything below is protected by the mutex.
+        std::mutex mutex;
+        uint64_t nextCandidate = 0;
+
+        // Ranges returned by workers that were lost.
+        vector< pair<uint64_t, uint64_t> > returnedRanges;
+
+        // Number of ranges being processed by workers.
+        uint64_t outstandingRangeCount = 0;
+
+        vector<Shard> shards;
+
+        bool getRange(uint64_t maxSize, uint64_t& begin, uint64_t& end);
+        void serveWorker(std::iostream&);
+    };
+    shared_ptr<State> state;
+
+    std::atomic<bool> stopping = false;
+    std::thread acceptThread;
+};
+
+
+
+// Used by an alignment worker to communicate with the AlignmentCoordinator.
+class shasta::AlignmentWorkerConnection {
+public:
+
+    // The coordinator is specified as host:port.
+    // This waits until the coordinator accepts the connection.
+    AlignmentWorkerConnection(const string& coordinator, const string& workerName);
+    ~AlignmentWorkerConnection();
+
+    uint64_t optionsHash;
+    uint64_t candidateCount;
+
+    // Get the next range of candidates. Returns false when there are no more.
+    bool getRange(uint64_t& begin, uint64_t& end);
+
+    // Tell the coordinator that a range was completed
+    // and the shard file written.
+    void complete(uint64_t begin, uint64_t end, uint64_t alignmentCount);
+
+private:
+    class Implementation;
+    unique_ptr<Implementation> implementation;
+};
+
+#endif
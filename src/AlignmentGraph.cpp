@@ -2,6 +2,8 @@
 #include "PngImage.hpp"
 #include "AlignmentGraph.hpp"
 #include "Alignment.hpp"
+#include "AlignmentMatrixRenderer.hpp"
+#include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
 
@@ -503,71 +505,78 @@ void AlignmentGraph::writeImage(
     uint64_t magnifyFactor,
     const string& fileName)
 {
+    // This can be called from a thread function, so use a single thread.
+    const shared_ptr<AlignmentMatrixRenderer> renderer =
+        createAlignmentMatrixRenderer(markers0, markers1, alignment);
+    renderer->render(uint32_t(markersPerPixel), uint32_t(magnifyFactor), 1).write(fileName);
+}
 
-    // Create the image, which gets initialized to black.
-    const int n0 = int(markers0.size());
-    const int n1 = int(markers1.size());
-    const int m0 = (n0 - 1) / int(markersPerPixel) + 1;
-    const int m1 = (n1 - 1) / int(markersPerPixel) + 1;
-    PngImage image(m0, m1);
-
-
-
-    // Write a grid.
-    vector<int> gridSpacing;
-    vector< array<int, 3> > gridRgb;
-    gridSpacing.push_back(   10); gridRgb.push_back({ 15,  15,  15});  // Grey
-    gridSpacing.push_back(   50); gridRgb.push_back({ 30,  30,  30});  // Grey
-    gridSpacing.push_back(  100); gridRgb.push_back({ 90,  90,  90});  // Grey
-    gridSpacing.push_back(  500); gridRgb.push_back({160, 160, 160});  // Grey
-    gridSpacing.push_back( 1000); gridRgb.push_back({255, 255, 255});  // White
-    gridSpacing.push_back( 5000); gridRgb.push_back({255, 120, 255});  // Purple
-    gridSpacing.push_back(10000); gridRgb.push_back({255, 255,  60});  // Yellow
-    gridSpacing.push_back(50000); gridRgb.push_back({255, 255, 120});  // Yellow
-    for(size_t i=0; i<gridSpacing.size(); i++) {
-        const int spacing = gridSpacing[i];
-
-        // If the spacing is too low for our resolution, skip it.
-        if(spacing < 10 * int(markersPerPixel)) {
-            continue;
-        }
 
-        const array<int, 3>& rgb = gridRgb[i];
-        for(int i0=0; i0<n0; i0+=spacing) {
-            for(int i1=0; i1<n1; i1+=int(markersPerPixel)) {
-                image.setPixel(i0/int(markersPerPixel), i1/int(markersPerPixel), rgb[0], rgb[1], rgb[2]);
+
+// Create an AlignmentMatrixRenderer for the markers and the computed alignment.
+// Matching markers are drawn in red and the alignment in green,
+// on top of grids of increasing spacing.
+shared_ptr<AlignmentMatrixRenderer> AlignmentGraph::createAlignmentMatrixRenderer(
+    const vector<MarkerWithOrdinal>& markers0,
+    const vector<MarkerWithOrdinal>& markers1,
+    const Alignment& alignment)
+{
+    SHASTA_ASSERT(std::is_sorted(markers0.begin(), markers0.end()));
+    SHASTA_ASSERT(std::is_sorted(markers1.begin(), markers1.end()));
+    const uint32_t n0 = uint32_t(markers0.size());
+    const uint32_t n1 = uint32_t(markers1.size());
+    const shared_ptr<AlignmentMatrixRenderer> renderer =
+        make_shared<AlignmentMatrixRenderer>(n0, n1);
+
+    // The grids.
+    renderer->addGrid(   10, { 15,  15,  15});  // Grey
+    renderer->addGrid(   50, { 30,  30,  30});  // Grey
+    renderer->addGrid(  100, { 90,  90,  90});  // Grey
+    renderer->addGrid(  500, {160, 160, 160});  // Grey
+    renderer->addGrid( 1000, {255, 255, 255});  // White
+    renderer->addGrid( 5000, {255, 120, 255});  // Purple
+    renderer->addGrid(10000, {255, 255,  60});  // Yellow
+    renderer->addGrid(50000, {255, 255, 120});  // Yellow
+
+    // The pairs of markers with the same k-mer.
+    // Both marker vectors are sorted by kmerId, so we can
+    // find them by joining the runs of equal kmerId.
+    vector< pair<uint32_t, uint32_t> > matches;
+    auto it0 = markers0.begin();
+    auto it1 = markers1.begin();
+    while(it0 != markers0.end() and it1 != markers1.end()) {
+        if(it0->kmerId < it1->kmerId) {
+            ++it0;
+        } else if(it1->kmerId < it0->kmerId) {
+            ++it1;
+        } else {
+            const KmerId kmerId = it0->kmerId;
+            auto end0 = it0;
+            while(end0 != markers0.end() and end0->kmerId == kmerId) {
+                ++end0;
             }
-        }
-        for(int i1=0; i1<n1; i1+=spacing) {
-            for(int i0=0; i0<n0; i0+=int(markersPerPixel)) {
-                image.setPixel(i0/int(markersPerPixel), i1/int(markersPerPixel), rgb[0], rgb[1], rgb[2]);
+            auto end1 = it1;
+            while(end1 != markers1.end() and end1->kmerId == kmerId) {
+                ++end1;
             }
-        }
-    }
-
-
-
-    // Write the markers.
-    for(int i0=0; i0<n0; i0++) {
-        const MarkerWithOrdinal& marker0 = markers0[i0];
-        for(int i1=0; i1<n1; i1++) {
-            const MarkerWithOrdinal& marker1 = markers1[i1];
-            if(marker0.kmerId == marker1.kmerId) {
-                image.setPixel(marker0.ordinal/int(markersPerPixel), int(marker1.ordinal/markersPerPixel), 255, 0, 0);
+            for(auto jt0=it0; jt0!=end0; ++jt0) {
+                for(auto jt1=it1; jt1!=end1; ++jt1) {
+                    matches.push_back(make_pair(jt0->ordinal, jt1->ordinal));
+                }
             }
+            it0 = end0;
+            it1 = end1;
         }
     }
+    renderer->addLayer(matches, {255, 0, 0});
 
-    // Write the alignment.
+    // The alignment.
+    vector< pair<uint32_t, uint32_t> > alignedPairs;
     for(const auto& p: alignment.ordinals) {
-        image.setPixel(p[0]/int(markersPerPixel), p[1]/int(markersPerPixel), 0, 255, 0);
-    }
-
-    if(magnifyFactor != 1) {
-        image.magnify(int(magnifyFactor));
+        alignedPairs.push_back(make_pair(p[0], p[1]));
     }
+    renderer->addLayer(alignedPairs, {0, 255, 0});
 
-    // Write it out.
-    image.write(fileName);
+    return renderer;
 }
 
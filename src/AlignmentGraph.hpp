@@ -23,6 +23,7 @@ To find a good alignment, we find a shortest path in the graph.
 #include "CompactUndirectedGraph.hpp"
 #include "Marker.hpp"
 #include "shortestPath.hpp"
+#include "memory.hpp"
 
 // Standard library.
 #include "utility.hpp"
@@ -38,6 +39,7 @@ namespace shasta {
         AlignmentGraphEdge>;
     class Alignment;
     class AlignmentInfo;
+    class AlignmentMatrixRenderer;
 
     // Top level function to compute the marker alignment.
     void align(
@@ -171,6 +173,14 @@ public:
         uint64_t markersPerPixel,
         uint64_t magnifyFactor,
         const string& fileName);
+
+    // Create an AlignmentMatrixRenderer that can be used to render
+    // that image, or portions of it, at any resolution.
+    // The markers must be sorted by kmerId.
+    static shared_ptr<AlignmentMatrixRenderer> createAlignmentMatrixRenderer(
+        const vector<MarkerWithOrdinal>&,
+        const vector<MarkerWithOrdinal>&,
+        const Alignment&);
 private:
 
     // Data members used to find the shortest path.
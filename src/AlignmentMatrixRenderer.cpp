@@ -0,0 +1,284 @@
+// Shasta.
+#include "AlignmentMatrixRenderer.hpp"
+#include "parallelFor.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "stdexcept.hpp"
+
+
+
+AlignmentMatrixRenderer::AlignmentMatrixRenderer(uint32_t n0, uint32_t n1) :
+    n0(n0),
+    n1(n1)
+{
+}
+
+
+
+void AlignmentMatrixRenderer::setBackground(
+    const std::function<Rgb(uint32_t x, uint32_t y)>& backgroundArgument)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    background = backgroundArgument;
+    cache.clear();
+}
+
+
+
+void AlignmentMatrixRenderer::addGrid(uint32_t spacing, const Rgb& rgb)
+{
+    SHASTA_ASSERT(spacing > 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    grids.push_back(make_pair(spacing, rgb));
+    cache.clear();
+}
+
+
+
+void AlignmentMatrixRenderer::addLayer(
+    const vector< pair<uint32_t, uint32_t> >& entries,
+    const Rgb& rgb)
+{
+    Layer layer;
+    layer.rgb = rgb;
+
+    // Count the entries in each row.
+    layer.rowBegin.resize(n1 + 1, 0);
+    for(const auto& p: entries) {
+        SHASTA_ASSERT(p.first < n0);
+        SHASTA_ASSERT(p.second < n1);
+        ++layer.rowBegin[p.second + 1];
+    }
+    for(uint64_t y=0; y<n1; y++) {
+        layer.rowBegin[y + 1] += layer.rowBegin[y];
+    }
+
+    // Store the x values of each row, then sort them.
+    layer.x.resize(entries.size());
+    vector<uint64_t> position(layer.rowBegin.begin(), layer.rowBegin.end() - 1);
+    for(const auto& p: entries) {
+        layer.x[position[p.second]++] = p.first;
+    }
+    for(uint64_t y=0; y<n1; y++) {
+        sort(layer.x.begin() + layer.rowBegin[y], layer.x.begin() + layer.rowBegin[y + 1]);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    layers.push_back(std::move(layer));
+    cache.clear();
+}
+
+
+
+PngImage AlignmentMatrixRenderer::render(
+    uint32_t begin0, uint32_t end0,
+    uint32_t begin1, uint32_t end1,
+    uint32_t markersPerPixel,
+    uint32_t magnifyFactor,
+    size_t threadCount) const
+{
+    if(markersPerPixel == 0) {
+        throw runtime_error("Invalid markers per pixel value 0.");
+    }
+    if(magnifyFactor == 0) {
+        throw runtime_error("Invalid magnify factor 0.");
+    }
+    end0 = min(end0, n0);
+    end1 = min(end1, n1);
+    if(begin0 >= end0 or begin1 >= end1) {
+        throw runtime_error("Empty alignment matrix region.");
+    }
+    const uint32_t m = markersPerPixel;
+    const uint32_t f = magnifyFactor;
+
+    // The range of downsampled pixels to be rendered.
+    const uint32_t x0 = begin0 / m;
+    const uint32_t x1 = (end0 - 1) / m + 1;
+    const uint32_t y0 = begin1 / m;
+    const uint32_t y1 = (end1 - 1) / m + 1;
+
+    // The tiles that overlap that range.
+    const uint32_t tx0 = x0 / tileSize;
+    const uint32_t tx1 = (x1 - 1) / tileSize + 1;
+    const uint32_t ty0 = y0 / tileSize;
+    const uint32_t ty1 = (y1 - 1) / tileSize + 1;
+    const uint32_t tileCountX = tx1 - tx0;
+    const uint64_t tileCount = uint64_t(tileCountX) * uint64_t(ty1 - ty0);
+
+    // Get the tiles, rasterizing the ones not in the cache,
+    // and copy them to their portion of the image, magnified.
+    // Each tile writes to a separate portion of the image.
+    PngImage image(int((x1 - x0) * f), int((y1 - y0) * f));
+    parallelFor(tileCount, 1, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const uint32_t tx = tx0 + uint32_t(i % tileCountX);
+                const uint32_t ty = ty0 + uint32_t(i / tileCountX);
+                const shared_ptr<const Tile> tile = getTile(TileKey(m, tx, ty));
+
+                // The portion of this tile inside the rendered range.
+                const uint32_t tileX = tx * tileSize;
+                const uint32_t tileY = ty * tileSize;
+                const uint32_t xBegin = max(x0, tileX);
+                const uint32_t xEnd = min(x1, tileX + tile->width);
+                const uint32_t yBegin = max(y0, tileY);
+                const uint32_t yEnd = min(y1, tileY + tile->height);
+
+                for(uint32_t y=yBegin; y<yEnd; y++) {
+                    for(uint32_t x=xBegin; x<xEnd; x++) {
+                        const uint8_t* rgb = tile->data.data() +
+                            3 * (uint64_t(y - tileY) * tile->width + (x - tileX));
+                        for(uint32_t dy=0; dy<f; dy++) {
+                            for(uint32_t dx=0; dx<f; dx++) {
+                                image.setPixel(
+                                    int((x - x0) * f + dx), int((y - y0) * f + dy),
+                                    rgb[0], rgb[1], rgb[2]);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+    return image;
+}
+
+
+
+uint64_t AlignmentMatrixRenderer::cachedTileCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.size();
+}
+
+
+
+shared_ptr<const AlignmentMatrixRenderer::Tile>
+    AlignmentMatrixRenderer::getTile(const TileKey& key) const
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = cache.find(key);
+        if(it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    // Rasterize it without holding the mutex, so other
+    // threads can rasterize other tiles at the same time.
+    const shared_ptr<const Tile> tile = rasterizeTile(key);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(cache.size() >= maxCachedTileCount) {
+        cache.clear();
+    }
+    cache.insert(make_pair(key, tile));
+    return tile;
+}
+
+
+
+shared_ptr<const AlignmentMatrixRenderer::Tile>
+    AlignmentMatrixRenderer::rasterizeTile(const TileKey& key) const
+{
+    const uint32_t m = std::get<0>(key);
+    const uint32_t tx = std::get<1>(key);
+    const uint32_t ty = std::get<2>(key);
+
+    // The range of downsampled pixels covered by this tile.
+    const uint32_t width = (n0 - 1) / m + 1;
+    const uint32_t height = (n1 - 1) / m + 1;
+    const uint32_t x0 = tx * tileSize;
+    const uint32_t y0 = ty * tileSize;
+    SHASTA_ASSERT(x0 < width);
+    SHASTA_ASSERT(y0 < height);
+    const uint32_t x1 = min(width, x0 + tileSize);
+    const uint32_t y1 = min(height, y0 + tileSize);
+
+    const shared_ptr<Tile> tile = make_shared<Tile>();
+    tile->width = x1 - x0;
+    tile->height = y1 - y0;
+    tile->data.resize(3 * uint64_t(tile->width) * uint64_t(tile->height), 0);
+    const auto setPixel = [&](uint32_t x, uint32_t y, const Rgb& rgb)
+    {
+        std::copy(rgb.begin(), rgb.end(),
+            tile->data.begin() + 3 * (uint64_t(y - y0) * tile->width + (x - x0)));
+    };
+
+    // Background.
+    if(background) {
+        for(uint32_t y=y0; y<y1; y++) {
+            for(uint32_t x=x0; x<x1; x++) {
+                setPixel(x, y, background(x * m, y * m));
+            }
+        }
+    }
+
+    // Grids. For each column and row, find the last grid with a line in it.
+    // A grid line at ordinal i is drawn in the pixel that contains it.
+    const auto lastGrid = [&](uint32_t pixel, uint32_t n)
+    {
+        const uint64_t begin = uint64_t(pixel) * m;
+        const uint64_t end = min(uint64_t(n), begin + m);
+        uint64_t gridId = invalid<uint64_t>;
+        for(uint64_t i=0; i<grids.size(); i++) {
+            const uint64_t spacing = grids[i].first;
+            if(spacing < 10 * uint64_t(m)) {
+                continue;
+            }
+            const uint64_t line = ((begin + spacing - 1) / spacing) * spacing;
+            if(line < end) {
+                gridId = i;
+            }
+        }
+        return gridId;
+    };
+    if(not grids.empty()) {
+        vector<uint64_t> rowGrid(y1 - y0);
+        for(uint32_t y=y0; y<y1; y++) {
+            rowGrid[y - y0] = lastGrid(y, n1);
+        }
+        for(uint32_t x=x0; x<x1; x++) {
+            const uint64_t columnGrid = lastGrid(x, n0);
+            for(uint32_t y=y0; y<y1; y++) {
+                const uint64_t r = rowGrid[y - y0];
+                uint64_t gridId;
+                if(columnGrid == invalid<uint64_t>) {
+                    gridId = r;
+                } else if(r == invalid<uint64_t>) {
+                    gridId = columnGrid;
+                } else {
+                    gridId = max(columnGrid, r);
+                }
+                if(gridId != invalid<uint64_t>) {
+                    setPixel(x, y, grids[gridId].second);
+                }
+            }
+        }
+    }
+
+    // Layers.
+    const uint32_t xMarkerBegin = x0 * m;
+    const uint32_t xMarkerEnd = uint32_t(min(uint64_t(n0), uint64_t(x1) * m));
+    const uint32_t yMarkerBegin = y0 * m;
+    const uint32_t yMarkerEnd = uint32_t(min(uint64_t(n1), uint64_t(y1) * m));
+    for(const Layer& layer: layers) {
+        for(uint32_t y=yMarkerBegin; y<yMarkerEnd; y++) {
+            const auto rowBegin = layer.x.begin() + layer.rowBegin[y];
+            const auto rowEnd = layer.x.begin() + layer.rowBegin[y + 1];
+            if(rowBegin == rowEnd) {
+                continue;
+            }
+            for(auto it=std::lower_bound(rowBegin, rowEnd, xMarkerBegin);
+                it!=rowEnd and *it<xMarkerEnd; ++it) {
+                setPixel(*it / m, y / m, layer.rgb);
+            }
+        }
+    }
+
+    return tile;
+}
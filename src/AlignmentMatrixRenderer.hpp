@@ -0,0 +1,136 @@
+#ifndef SHASTA_ALIGNMENT_MATRIX_RENDERER_HPP
+#define SHASTA_ALIGNMENT_MATRIX_RENDERER_HPP
+
+/*******************************************************************************
+
+Class AlignmentMatrixRenderer renders an image of an alignment matrix
+between two sequences of markers (or bases), with x corresponding to
+ordinals on the first sequence and y corresponding to ordinals on the second.
+
+The image is made of:
+- An optional background, computed for each pixel.
+- Grids with given spacings, in ordinal space.
+- Any number of layers of matrix entries, each with its own color.
+Later grids and layers are drawn on top of earlier ones.
+
+The image can be downsampled (markersPerPixel > 1), in which case
+each pixel represents a square of markersPerPixel x markersPerPixel
+matrix entries, and magnified (magnifyFactor > 1), in which case each
+pixel is drawn as a square of magnifyFactor x magnifyFactor image pixels.
+A grid is skipped if its spacing is less than 10 pixels.
+
+The downsampled image is divided in square tiles of tileSize pixels,
+which are rasterized directly from the matrix entries, in parallel, and
+kept in a cache, so rendering again at the same level of detail
+(for example when zooming into a portion of the matrix or changing
+the magnify factor) only rasterizes the tiles not already in the cache.
+To find the entries in a tile quickly, the entries of each
+layer are stored sorted by y and then x, with an index by y.
+
+This class is thread safe.
+
+*******************************************************************************/
+
+// Shasta.
+#include "PngImage.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include "cstdint.hpp"
+#include <functional>
+#include <map>
+#include "memory.hpp"
+#include <mutex>
+#include "tuple.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class AlignmentMatrixRenderer;
+}
+
+
+
+class shasta::AlignmentMatrixRenderer {
+public:
+
+    static const uint32_t tileSize = 256;
+
+    // The maximum number of tiles kept in the cache.
+    // If this is exceeded, the cache is cleared.
+    static const uint64_t maxCachedTileCount = 256;
+
+    using Rgb = array<uint8_t, 3>;
+
+    // n0 and n1 are the sizes of the matrix in x and y.
+    AlignmentMatrixRenderer(uint32_t n0, uint32_t n1);
+
+    // The background function, if any, is evaluated at the
+    // top left matrix entry of each downsampled pixel.
+    void setBackground(const std::function<Rgb(uint32_t x, uint32_t y)>&);
+
+    void addGrid(uint32_t spacing, const Rgb&);
+
+    // Add a layer of matrix entries, given as pairs (x, y).
+    void addLayer(const vector< pair<uint32_t, uint32_t> >&, const Rgb&);
+
+    // Render the portion of the matrix with x in [begin0, end0)
+    // and y in [begin1, end1). The begins are rounded down to
+    // a multiple of markersPerPixel.
+    // A threadCount of 0 means use all hardware threads.
+    // Use a threadCount of 1 when calling from a thread function.
+    PngImage render(
+        uint32_t begin0, uint32_t end0,
+        uint32_t begin1, uint32_t end1,
+        uint32_t markersPerPixel,
+        uint32_t magnifyFactor,
+        size_t threadCount) const;
+
+    // Render the entire matrix.
+    PngImage render(
+        uint32_t markersPerPixel,
+        uint32_t magnifyFactor,
+        size_t threadCount) const
+    {
+        return render(0, n0, 0, n1, markersPerPixel, magnifyFactor, threadCount);
+    }
+
+    uint64_t cachedTileCount() const;
+
+private:
+    uint32_t n0;
+    uint32_t n1;
+
+    std::function<Rgb(uint32_t x, uint32_t y)> background;
+
+    vector< pair<uint32_t, Rgb> > grids;
+
+    class Layer {
+    public:
+        Rgb rgb;
+
+        // The x values of the entries with a given y are
+        // x[rowBegin[y]] through x[rowBegin[y+1]-1], sorted.
+        vector<uint64_t> rowBegin;
+        vector<uint32_t> x;
+    };
+    vector<Layer> layers;
+
+    // A tile of the downsampled image, stored as RGB triplets by row.
+    class Tile {
+    public:
+        uint32_t width;
+        uint32_t height;
+        vector<uint8_t> data;
+    };
+
+    // The cached tiles, keyed by (markersPerPixel, tile x index, tile y index).
+    using TileKey = tuple<uint32_t, uint32_t, uint32_t>;
+    mutable std::mutex mutex;
+    mutable std::map<TileKey, shared_ptr<const Tile> > cache;
+
+    shared_ptr<const Tile> getTile(const TileKey&) const;
+    shared_ptr<const Tile> rasterizeTile(const TileKey&) const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SHASTA_ALIGNMENT_STATISTICS_HPP
+#define SHASTA_ALIGNMENT_STATISTICS_HPP
+
+// Columnar storage of the alignment quality indicators
+// used to select the alignments that go in the read graph.
+// Each column is indexed by alignment id, in the same way as
+// Assembler::alignmentData, and stores one quantity
+// for all alignments, so applying a set of thresholds
+// to all alignments is a simple loop over contiguous arrays
+// that the compiler can vectorize.
+// The quantities stored are the same as those used in
+// Assembler::passesReadGraph2Criteria.
+
+// Shasta.
+#include "MemoryMappedVector.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+
+namespace shasta {
+    class AlignmentStatistics;
+}
+
+
+
+class shasta::AlignmentStatistics {
+public:
+
+    // AlignmentInfo::minAlignedFraction.
+    MemoryMapped::Vector<double> minAlignedFraction;
+
+    // AlignmentInfo::markerCount.
+    MemoryMapped::Vector<uint32_t> markerCount;
+
+    // AlignmentInfo::maxDrift and AlignmentInfo::maxSkip.
+    MemoryMapped::Vector<uint32_t> maxDrift;
+    MemoryMapped::Vector<uint32_t> maxSkip;
+
+    // The maximum of the left and right trim computed by AlignmentInfo::computeTrim.
+    MemoryMapped::Vector<uint32_t> maxTrim;
+
+    void createNew(const string& name, size_t pageSize, uint64_t n)
+    {
+        minAlignedFraction.createNew(name + "-MinAlignedFraction", pageSize, n);
+        markerCount.createNew(name + "-MarkerCount", pageSize, n);
+        maxDrift.createNew(name + "-MaxDrift", pageSize, n);
+        maxSkip.createNew(name + "-MaxSkip", pageSize, n);
+        maxTrim.createNew(name + "-MaxTrim", pageSize, n);
+    }
+
+    void accessExistingReadOnly(const string& name)
+    {
+        minAlignedFraction.accessExistingReadOnly(name + "-MinAlignedFraction");
+        markerCount.accessExistingReadOnly(name + "-MarkerCount");
+        maxDrift.accessExistingReadOnly(name + "-MaxDrift");
+        maxSkip.accessExistingReadOnly(name + "-MaxSkip");
+        maxTrim.accessExistingReadOnly(name + "-MaxTrim");
+    }
+
+    bool isOpen() const
+    {
+        return minAlignedFraction.isOpen;
+    }
+
+    void close()
+    {
+        minAlignedFraction.close();
+        markerCount.close();
+        maxDrift.close();
+        maxSkip.close();
+        maxTrim.close();
+    }
+
+    void remove()
+    {
+        minAlignedFraction.remove();
+        markerCount.remove();
+        maxDrift.remove();
+        maxSkip.remove();
+        maxTrim.remove();
+    }
+
+    uint64_t size() const
+    {
+        return minAlignedFraction.size();
+    }
+
+    // For each alignment in [begin, end), set passes[alignmentId]
+    // to 1 if the alignment satisfies all the thresholds, 0 otherwise.
+    void flagPassing(
+        double minAlignedFractionThreshold,
+        uint64_t minMarkerCountThreshold,
+        uint64_t maxDriftThreshold,
+        uint64_t maxSkipThreshold,
+        uint64_t maxTrimThreshold,
+        uint64_t begin,
+        uint64_t end,
+        uint8_t* passes) const
+    {
+        const double* a = minAlignedFraction.begin();
+        const uint32_t* m = markerCount.begin();
+        const uint32_t* d = maxDrift.begin();
+        const uint32_t* s = maxSkip.begin();
+        const uint32_t* t = maxTrim.begin();
+        for(uint64_t i=begin; i!=end; i++) {
+            passes[i] = uint8_t(
+                (a[i] >= minAlignedFractionThreshold) &
+                (m[i] >= minMarkerCountThreshold) &
+                (d[i] <= maxDriftThreshold) &
+                (s[i] <= maxSkipThreshold) &
+                (t[i] <= maxTrimThreshold));
+        }
+    }
+};
+
+#endif
@@ -48,6 +48,11 @@ Assembler::Assembler(
     } else {
 
         // Access an existing assembly.
+        // If it used tiered placement of binary data, the cold data
+        // are in the cold data directory next to the data directory.
+        if(not largeDataFileNamePrefix.empty()) {
+            accessColdData(coldDataDirectoryName(largeDataFileNamePrefix));
+        }
         assemblerInfo.accessExistingReadWrite(largeDataName("Info"));
         largeDataPageSize = assemblerInfo->largeDataPageSize;
 
@@ -4,7 +4,10 @@
 // Shasta.
 #include "Alignment.hpp"
 #include "AlignmentCandidates.hpp"
+#include "AlignmentStatistics.hpp"
 #include "AssemblyGraph2Statistics.hpp"
+#include "AssemblyStage.hpp"
+#include "BoundedQueue.hpp"
 #include "HttpServer.hpp"
 #include "invalid.hpp"
 #include "Kmer.hpp"
@@ -17,9 +20,15 @@
 #include "ReadGraph.hpp"
 #include "ReadId.hpp"
 #include "shastaTypes.hpp"
+#include "StripedMap.hpp"
 
 // Standard library.
+#include <atomic>
+#include "chrono.hpp"
+#include <functional>
 #include "memory.hpp"
+#include <mutex>
+#include <shared_mutex>
 #include "string.hpp"
 #include "tuple.hpp"
 #include "utility.hpp"
@@ -30,18 +39,25 @@ namespace shasta {
     class AssemblerInfo;
     class AssemblyGraph;
     class Alignment;
+    class AlignmentCache;
+    class AlignmentCoordinator;
     class AlignmentData;
     class AlignmentGraph;
     class AlignmentInfo;
+    class AlignmentMatrixRenderer;
     class AlignOptions;
     class AssemblerOptions;
     class AssembledSegment;
     class AssemblyGraph2;
     class CompressedAssemblyGraph;
+    class Consensus;
     class ConsensusCaller;
+    class Coverage;
     class Histogram2;
+    class HttpResponseCache;
     class InducedAlignment;
     class KmerChecker;
+    class KmerMask;
     class KmersOptions;
     class LocalAssemblyGraph;
     class LocalAlignmentCandidateGraph;
@@ -50,13 +66,18 @@ namespace shasta {
     class LocalReadGraph;
     class LocalReadGraphTriangles;
     class LocalMarkerGraph0RequestParameters;
+    class MarkerGraphNeighborhoodIndex;
     class LongBaseSequences;
     class MarkerConnectivityGraph;
     class MarkerConnectivityGraphVertexMap;
     class Mode2AssemblyOptions;
     class OrientedReadPair;
+    class ReadGraphCsr;
+    class SpoaEnginePool;
     class Reads;
+    class ReadSequenceIndex;
     class ReferenceOverlapMap;
+    class SlowItemTracer;
 
 
     namespace MemoryMapped {
@@ -73,6 +94,7 @@ namespace shasta {
     namespace Align4 {
         class MatrixEntry;
         class Options;
+        class Workspace;
     }
 
     namespace mode3 {
@@ -192,6 +214,44 @@ public:
     uint64_t virtualCpuCount = 0;
     uint64_t totalAvailableMemory = 0;
 
+    // Checkpoints used by --resumeFrom.
+    // When a stage of the assembly completes, it stores here
+    // a hash of the options used by that stage and all previous stages.
+    // The hash is zero for stages that did not complete.
+    // See AssemblyStage.hpp.
+    array<uint64_t, 16> checkpointHash = {};
+
+    // Used by the http server to explore an assembly that is still running.
+    // assemblyIsRunning is set while an assembly or resumed assembly runs.
+    // stageGeneration is incremented every time checkpointHash changes,
+    // so the http server can detect that more stages completed.
+    // These are accessed concurrently by the assembly and by the http server,
+    // which run in different processes, so stageGeneration
+    // is accessed atomically.
+    uint64_t assemblyIsRunning = 0;
+    uint64_t stageGeneration = 0;
+    void incrementStageGeneration()
+    {
+        std::atomic_ref<uint64_t>(stageGeneration).fetch_add(1);
+    }
+    uint64_t getStageGeneration()
+    {
+        return std::atomic_ref<uint64_t>(stageGeneration).load();
+    }
+
+    // Return the number of assembly stages that completed,
+    // without gaps, starting at the first one.
+    uint64_t completedStageCount() const
+    {
+        uint64_t stage = 0;
+        for(; stage<assemblyStageCount; stage++) {
+            if(checkpointHash[stage] == 0) {
+                break;
+            }
+        }
+        return stage;
+    }
+
     inline string peakMemoryUsageForSummaryStats() {
         return peakMemoryUsage > 0 ? to_string(peakMemoryUsage) : "Not determined.";
     }
@@ -228,19 +288,48 @@ public:
         size_t largeDataPageSize);
 
     // Add reads.
-    // The reads in the specified file are added to those already previously present.
+    // The reads in the specified files are added to those already previously present.
     void addReads(
-        const string& fileName,
+        const vector<string>& fileNames,
+        uint64_t minReadLength,
+        uint64_t desiredCoverage,   // If not zero, do a length scan first.
+        bool noCache,
+        uint64_t streamingChunkSize, // In bytes. 0 = no streaming.
+        size_t threadCount,
+        bool findMarkersWhileLoading = false);
+
+    // Create a read store (see class ReadStoreInfo) in the specified
+    // directory, which must not exist, using reads from the specified files.
+    static void createReadStore(
+        const vector<string>& fileNames,
+        const string& readStoreDirectory,
+        uint64_t readRepresentation,
         uint64_t minReadLength,
         bool noCache,
+        uint64_t streamingChunkSize, // In bytes. 0 = no streaming.
         size_t threadCount);
 
+    // Add reads from a read store previously created by createReadStore.
+    // Reads shorter than minReadLength are skipped.
+    void addReadsFromStore(
+        const string& readStoreDirectory,
+        uint64_t minReadLength);
+
+    // Store repeat counts in compressed form (--Reads.compressRepeatCounts).
+    void compressReadRepeatCounts();
+
+    // Store read names and meta data in compressed form (--Reads.compressNames).
+    // This must be called after computeReadIdsSortedByName.
+    void compressReadNames();
+
     // Create a histogram of read lengths.
     void histogramReadLength(const string& fileName);
 
 
     // Functions related to markers.
     // See the beginning of Marker.hpp for more information.
+    // If addReads was called with findMarkersWhileLoading,
+    // findMarkers uses the marker positions computed while loading the reads.
     void findMarkers(size_t threadCount);
     void accessMarkers();
     void writeMarkers(ReadId, Strand, const string& fileName);
@@ -273,16 +362,50 @@ public:
     // Compute an alignment for each alignment candidate.
     // Store summary information for the ones that are good enough,
     // without storing details of the alignment.
+    // If workerPort is not zero, alignment worker processes
+    // can connect to that port and compute alignments for
+    // ranges of alignment candidates (see AlignmentCoordinator.hpp).
     void computeAlignments(
         const AlignOptions&,
 
         // Number of threads. If zero, a number of threads equal to
         // the number of virtual processors is used.
-        size_t threadCount
+        size_t threadCount,
+
+        uint16_t workerPort = 0
     );
+
+    // Run an alignment worker for a computeAlignments running
+    // in another process, specified as host:port.
+    // The AlignOptions must be the same used by computeAlignments.
+    void runAlignmentWorker(
+        const AlignOptions&,
+        const string& coordinator,
+        size_t threadCount);
     void accessAlignmentData();
     void accessAlignmentDataReadWrite();
 
+    // Streaming mode: find alignment candidates using LowHash0
+    // and compute alignments for them, starting alignment
+    // computation during the last LowHash0 iteration, as soon as
+    // the final candidates for each batch of reads are available.
+    // The alignment candidates are also stored as usual.
+    // This requires minHashIterationCount to be not zero,
+    // and cannot be used if the candidates need to be processed
+    // after LowHash0 and before computing alignments
+    // (Align.sameChannelReadAlignmentSuppressDeltaThreshold
+    // and Align.readSaturationAlignmentCount).
+    void findAlignmentCandidatesLowHash0AndComputeAlignments(
+        size_t m,
+        double hashFraction,
+        size_t minHashIterationCount,
+        size_t log2MinHashBucketCount,
+        size_t minBucketSize,
+        size_t maxBucketSize,
+        size_t minFrequency,
+        const AlignOptions&,
+        size_t threadCount);
+
 
     // Loop over all alignments in the read graph
     // to create vertices of the global marker graph.
@@ -315,9 +438,46 @@ public:
 
         // Number of threads. If zero, a number of threads equal to
         // the number of virtual processors is used.
-        size_t threadCount
+        size_t threadCount,
+
+        // Number of shards used for the disjoint set computation.
+        // If greater than 1, the oriented markers are partitioned into
+        // this number of contiguous ranges, and each shard is processed
+        // by threads bound to one NUMA node.
+        // If zero, the number of NUMA nodes is used.
+        uint64_t shardCount = 1,
+
+        // If not zero, use external memory for the disjoint set computation,
+        // with this memory budget in GB. See createMarkerGraphVerticesExternal.
+        double externalMemoryBudget = 0.
     );
 
+    // A single streaming producer of the pairs of aligned markers
+    // used to create marker graph vertices.
+    // streamAlignedMarkerPairs loops over the read graph edges
+    // used to create marker graph vertices, decompresses each alignment once,
+    // and passes the pairs of aligned markers, including the reverse
+    // complemented pairs, to any number of consumers.
+    using AlignedMarkerPair = pair<MarkerId, MarkerId>;
+    class AlignedMarkerPairConsumer {
+    public:
+        // This is called by multiple threads, each with its own threadId,
+        // in [0, threadCount), for batches of pairs of aligned markers.
+        virtual void consume(size_t threadId, span<const AlignedMarkerPair>) = 0;
+        virtual ~AlignedMarkerPairConsumer() {}
+    };
+    void streamAlignedMarkerPairs(
+        const vector<AlignedMarkerPairConsumer*>&,
+        size_t threadCount);
+private:
+    void streamAlignedMarkerPairsThreadFunction(size_t threadId);
+    vector<AlignedMarkerPairConsumer*> alignedMarkerPairConsumers;
+    bool getReadGraphEdgePairAlignedMarkers(
+        uint64_t edgeId,
+        Alignment&,
+        vector<AlignedMarkerPair>&);
+public:
+
 
 
     // Find the vertex of the global marker graph that contains a given marker.
@@ -392,12 +552,12 @@ public:
 public:
     void writeReadsSummary();
 
-    void computeReadIdsSortedByName();
+    void computeReadIdsSortedByName(size_t threadCount = 0);
 
     // Find duplicate reads, as determined by name (not sequence).
     // This also sets the isDuplicate and discardDueToDuplicates read flags
     // and summarizes what it found Duplicates.csv.
-    void findDuplicateReads(const string& handleDuplicates);
+    void findDuplicateReads(const string& handleDuplicates, size_t threadCount = 0);
 
 
 private:
@@ -434,6 +594,11 @@ public:
 private:
     void checkMarkersAreOpen() const;
 
+    // The strand 0 marker positions of each read, indexed by ReadId,
+    // computed while loading reads if addReads was called
+    // with findMarkersWhileLoading. Removed by findMarkers.
+    MemoryMapped::VectorOfVectors<uint32_t, uint64_t> pipelinedMarkerPositions;
+
     // Get markers sorted by KmerId for a given OrientedReadId.
     void getMarkersSortedByKmerId(
         OrientedReadId,
@@ -477,6 +642,24 @@ private:
     // void computeSortedMarkersThreadFunction1(size_t threadId);
     // void computeSortedMarkersThreadFunction2(size_t threadId);
 
+    // Create a KmerMask containing the marker KmerIds that appear
+    // more than maxFrequency times in all oriented reads.
+    // Used by alignment method 4. This requires the sorted markers.
+    shared_ptr<KmerMask> computeHighFrequencyMarkerKmerMask(
+        uint64_t maxFrequency,
+        size_t threadCount) const;
+
+
+
+    // Index used to find occurrences of a sequence in the reads.
+    // It is optional and can be created at any time after the reads are loaded.
+    // See ReadSequenceIndex.hpp.
+    shared_ptr<ReadSequenceIndex> readSequenceIndex;
+public:
+    void createReadSequenceIndex(uint64_t step, uint64_t threadCount);
+    bool accessReadSequenceIndex();
+private:
+
 
 
     // KmerIds for all markers. Indexed by OrientedReadId::getValue().
@@ -490,6 +673,18 @@ public:
 private:
     void computeMarkerKmerIdsThreadFunction(size_t threadId);
 
+    // Marker positions as aligned 32-bit integers,
+    // with the same layout as the markers and markerKmerIds.
+    // Together with markerKmerIds this is a columnar copy of the markers
+    // that can be scanned with stride-1 loads, without unpacking
+    // the 24-bit positions stored in each CompressedMarker.
+    // Like markerKmerIds, only stored during alignment computation.
+    MemoryMapped::VectorOfVectors<uint32_t, uint64_t> markerPositions;
+public:
+    void computeMarkerPositions(uint64_t threadCount);
+    void cleanupMarkerPositions();
+private:
+
 
 
     // Low level functions to get marker Kmers/KmerIds of an oriented read.
@@ -577,10 +772,32 @@ private:
     class SuppressAlignmentCandidatesData {
     public:
         uint64_t delta;
-        MemoryMapped::Vector<bool> suppress; // For each alignment candidate.
+
+        // The meta data used by suppressAlignment, parsed once for each read.
+        // If the ch, sampleid, runid, and read meta data fields
+        // are all present, hasMetaData is set, and hash is a hash of
+        // ch, sampleid, and runid. If in addition the read field is
+        // numeric, readIsNumeric is set and read contains its value.
+        class ReadInfo {
+        public:
+            uint64_t hash = 0;
+            int64_t read = 0;
+            bool hasMetaData = false;
+            bool readIsNumeric = false;
+        };
+        vector<ReadInfo> readInfos;
+
+        // The candidates are compacted in place, one batch at a time.
+        // For each batch, the number of candidates kept
+        // and the candidates that were suppressed.
+        uint64_t batchSize;
+        vector<uint64_t> keptCount;
+        vector< vector<OrientedReadPair> > suppressed;
+        bool hasFrequencies;
     };
     SuppressAlignmentCandidatesData suppressAlignmentCandidatesData;
-    void suppressAlignmentCandidatesThreadFunction(size_t threadId);
+    void suppressAlignmentCandidatesThreadFunction1(size_t threadId);
+    void suppressAlignmentCandidatesThreadFunction2(size_t threadId);
 
 
 
@@ -589,8 +806,23 @@ private:
     // They are interpreted with readId0 on strand 0.
     AlignmentCandidates alignmentCandidates;
 
+    // The number of alignment candidates, total and for each read.
+    // These are saved when the alignment candidates are released
+    // by releaseDeadData, so the assembly summaries can still be written.
+    uint64_t releasedAlignmentCandidateCount = 0;
+    vector<uint32_t> releasedReadAlignmentCandidateCount;
+    uint64_t getAlignmentCandidateCount() const;
+
 public:
     void writeAlignmentCandidates(bool useReadName=false, bool verbose=false) const;
+
+    // Release binary data whose last consumer is the given assembly stage.
+    // The manifest of these binary data is in AssemblerDeadData.cpp.
+    // If removeData is true, the binary data are removed.
+    // Otherwise, they are only closed, which keeps them on the filesystem
+    // for --command explore and --resumeFrom.
+    // This never affects assembly results.
+    void releaseDeadData(AssemblyStage, bool removeData);
 private:
 
 
@@ -608,13 +840,38 @@ public:
         size_t minBucketSize,           // The minimum size for a bucket to be used.
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of lowHash hits for a pair to become a candidate.
+        size_t threadCount,
+
+        // Incremental mode: if not zero, reads with ReadId less than
+        // oldReadCount are old reads, and only candidates
+        // involving at least one new read are found.
+        ReadId oldReadCount = 0
+    );
+
+    // Sharded LowHash0, to distribute the computation across processes.
+    // Each process runs findAlignmentCandidatesLowHash0Shard
+    // with a different shardId, then mergeAlignmentCandidateShards
+    // creates the alignment candidates from the files written by all shards.
+    void findAlignmentCandidatesLowHash0Shard(
+        size_t m,
+        double hashFraction,
+        size_t minHashIterationCount,
+        size_t log2MinHashBucketCount,
+        size_t minBucketSize,
+        size_t maxBucketSize,
+        uint64_t shardCount,
+        uint64_t shardId,
+        const string& shardFileName,
         size_t threadCount
     );
+    void mergeAlignmentCandidateShards(
+        const vector<string>& shardFileNames,
+        size_t minFrequency);
     void markAlignmentCandidatesAllPairs();
     void accessAlignmentCandidates();
     void accessAlignmentCandidateTable();
     vector<OrientedReadPair> getAlignmentCandidates() const;
-    void computeCandidateTable();
+    void computeCandidateTable(size_t threadCount = 0);
 
 private:
     void checkAlignmentCandidatesAreOpen() const;
@@ -761,7 +1018,7 @@ public:
         OrientedReadId,
         OrientedReadId,
         const Align4::Options&,
-        MemoryMapped::ByteAllocator&,
+        Align4::Workspace&,
         Alignment&,
         AlignmentInfo&,
         bool debug);
@@ -802,7 +1059,8 @@ private:
         size_t maxTrim,                 // Maximum left/right trim (expressed in bases).
         uint32_t distance,              // How far to go from starting oriented read.
         double timeout,                 // Or 0 for no timeout.
-        LocalAlignmentGraph&
+        LocalAlignmentGraph&,
+        size_t threadCount = 1
     );
 
     // Compute marker alignments of an oriented read with all reads
@@ -840,12 +1098,31 @@ private:
 
     // The good alignments we found.
     // They are stored with readId0<readId1 and with strand0==0.
-    // The order in compressedAlignments matches that in alignmentData.
-    MemoryMapped::Vector<AlignmentData> alignmentData;
+    // Each alignment is stored as a CompactAlignmentData in alignmentData,
+    // which is all that most stages after the alignments need,
+    // and its AlignmentInfo in alignmentInfos.
+    // The order in alignmentInfos and compressedAlignments
+    // matches that in alignmentData.
+    MemoryMapped::Vector<CompactAlignmentData> alignmentData;
+    MemoryMapped::Vector<AlignmentInfo> alignmentInfos;
     MemoryMapped::VectorOfVectors<char, uint64_t> compressedAlignments;
 
+    // Store an alignment at the end of alignmentData and alignmentInfos.
+    void storeAlignmentData(const AlignmentData&);
+
+    // Reassemble the complete AlignmentData for a stored alignment.
+    AlignmentData getAlignmentData(uint64_t alignmentId) const;
+
     void checkAlignmentDataAreOpen() const;
 public:
+    const MemoryMapped::Vector<CompactAlignmentData>& getAlignmentData() const
+    {
+        return alignmentData;
+    }
+    const MemoryMapped::Vector<AlignmentInfo>& getAlignmentInfos() const
+    {
+        return alignmentInfos;
+    }
     void accessCompressedAlignments();
 private:
 
@@ -875,11 +1152,16 @@ private:
     // Stores, for each OrientedReadId, a vector of indexes into the alignmentData vector.
     // Indexed by OrientedReadId::getValue(),
     MemoryMapped::VectorOfVectors<uint32_t, uint32_t> alignmentTable;
-    void computeAlignmentTable();
+    void computeAlignmentTable(size_t threadCount = 0);
+    void computeAlignmentTableThreadFunction1(size_t threadId);
+    void computeAlignmentTableThreadFunction2(size_t threadId);
+    void computeAlignmentTableThreadFunction3(size_t threadId);
 
 
 
     // Private functions and data used by computeAlignments.
+    void computeAlignmentsBegin(size_t threadCount);
+    void computeAlignmentsEnd(size_t threadCount);
     void computeAlignmentsThreadFunction(size_t threadId);
     class ComputeAlignmentsData {
     public:
@@ -887,11 +1169,45 @@ private:
         // Not owned.
         const AlignOptions* alignOptions = 0;
 
+        // Only used in streaming mode (see findAlignmentCandidatesLowHash0AndComputeAlignments).
+        // If not null, the threads get the candidates from this queue
+        // instead of alignmentCandidates.candidates.
+        BoundedQueue< vector<OrientedReadPair> >* candidateQueue = 0;
+        uint64_t streamedCandidateCount = 0;
+
         // The AlignmentInfo found by each thread.
         vector< vector<AlignmentData> > threadAlignmentData;
 
         // Compressed alignments corresponding to the AlignmentInfo found by each thread.
         vector< shared_ptr< MemoryMapped::VectorOfVectors<char, uint64_t> > > threadCompressedAlignments;
+
+        // Only used if alignOptions->readSaturationAlignmentCount is not zero.
+        // The order in which the alignment candidates are processed
+        // (indexes into alignmentCandidates.candidates), and
+        // the number of good alignments found so far for each read.
+        vector<uint64_t> candidateOrder;
+        vector<uint64_t> readGoodAlignmentCount;
+        uint64_t skippedCandidateCount = 0;
+
+        // Only used if alignOptions->cacheFile is not empty.
+        shared_ptr<AlignmentCache> alignmentCache;
+        uint64_t alignmentCacheOptionsHash = 0;
+        uint64_t alignmentCacheHitCount = 0;
+
+        // Only used for alignment method 4 if
+        // alignOptions->align4MaxKmerFrequency is not zero.
+        shared_ptr<KmerMask> align4KmerMask;
+
+        // Only used if slow item tracing is enabled.
+        shared_ptr<SlowItemTracer> slowItems;
+
+        // Only used when computing alignments in multiple processes.
+        // In the coordinator, the candidates are dispensed by the alignmentCoordinator.
+        // In a worker, the threads process the candidates beginning at candidateRangeBegin,
+        // and keep their results in anonymous memory.
+        shared_ptr<AlignmentCoordinator> alignmentCoordinator;
+        bool isAlignmentWorker = false;
+        uint64_t candidateRangeBegin = 0;
     };
     ComputeAlignmentsData computeAlignmentsData;
 
@@ -915,9 +1231,16 @@ private:
     // For more information, see comments in ReadGraph.hpp.
     ReadGraph readGraph;
 public:
+    // If useAlignmentCriteria is set, only alignments that satisfy
+    // the alignment criteria stored in AssemblerInfo
+    // (see passesReadGraph2Criteria) are used.
+    // This is used by --command rebuildReadGraph to apply
+    // new alignment thresholds without recomputing the alignments.
     void createReadGraph(
         uint32_t maxAlignmentCount,
-        uint32_t maxTrim);
+        uint32_t maxTrim,
+        size_t threadCount = 0,
+        bool useAlignmentCriteria = false);
 
     void createReadGraph2(
         uint32_t maxAlignmentCount,
@@ -925,7 +1248,53 @@ public:
         double alignedFractionPercentile,
         double maxSkipPercentile,
         double maxDriftPercentile,
-        double maxTrimPercentile);
+        double maxTrimPercentile,
+        size_t threadCount = 0);
+private:
+
+    // Multithreaded selection of the alignments to be used in the read graph,
+    // used by createReadGraph and createReadGraph2.
+    void selectReadGraphAlignments(
+        uint32_t maxAlignmentCount,
+        bool useReadGraph2Criteria,
+        size_t threadCount,
+        vector<bool>& keepAlignment);
+    void selectReadGraphAlignmentsThreadFunction(size_t threadId);
+    void flagAlignmentsPassingReadGraph2CriteriaThreadFunction(size_t threadId);
+
+    // Columnar statistics of the stored alignments,
+    // used to apply the read graph 2 criteria.
+    AlignmentStatistics alignmentStatistics;
+    void computeAlignmentStatistics(size_t threadCount);
+    void computeAlignmentStatisticsThreadFunction(size_t threadId);
+
+    // Thread functions used by createReadGraphUsingSelectedAlignments.
+    void createReadGraphEdgesThreadFunction(size_t threadId);
+    void createReadGraphConnectivityThreadFunction1(size_t threadId);
+    void createReadGraphConnectivityThreadFunction2(size_t threadId);
+
+    class CreateReadGraphData {
+    public:
+
+        // Used by selectReadGraphAlignments.
+        uint32_t maxAlignmentCount;
+        bool useReadGraph2Criteria;
+        // For each alignment, 1 if it passes the read graph 2 criteria.
+        // Only used if useReadGraph2Criteria is set.
+        vector<uint8_t> passesReadGraph2Criteria;
+        // The alignments kept by each thread.
+        vector< vector<uint32_t> > threadKeptAlignmentIds;
+
+        // Used by createReadGraphUsingSelectedAlignments.
+        const vector<bool>* keepAlignment = 0;
+        // The edges created by each thread, for each batch of alignments
+        // it processed, keyed by the first alignment id of the batch.
+        vector< vector< pair<uint64_t, vector<ReadGraphEdge> > > > threadEdges;
+        // Used to fill readGraph.connectivity without atomic operations.
+        shared_ptr< MemoryMapped::VectorOfVectorsParallelFill<uint32_t, uint32_t> > connectivityFill;
+    };
+    CreateReadGraphData createReadGraphData;
+public:
 
     void setReadGraph2Criteria(
             double markerCountPercentile,
@@ -938,7 +1307,18 @@ public:
     void accessReadGraph();
     void accessReadGraphReadWrite();
     void checkReadGraphIsOpen() const;
-    void removeReadGraphBridges(uint64_t maxDistance);
+    void removeReadGraphBridges(uint64_t maxDistance, size_t threadCount = 0);
+private:
+    void removeReadGraphBridgesThreadFunction(size_t threadId);
+    class RemoveReadGraphBridgesData {
+    public:
+        uint64_t maxDistance;
+        const ReadGraphCsr* csr = 0;
+        // The alignments found to be bridges by each thread.
+        vector< vector<uint64_t> > threadBridgeAlignmentIds;
+    };
+    RemoveReadGraphBridgesData removeReadGraphBridgesData;
+public:
     void analyzeReadGraph();
     void readGraphClustering();
     void writeReadGraphEdges(bool useReadName=false) const;
@@ -968,10 +1348,32 @@ private:
         // oriented with the lowest OrientedReadId first.
         MemoryMapped::Vector<int32_t> edgeOffset;
 
+        // For each oriented read v, the neighbors u>v, sorted by u,
+        // and the corresponding read graph edge ids.
+        // Edges that cross strands or are already flagged as inconsistent,
+        // and edges involving chimeric reads, are not included.
+        // Triangles are found by intersecting these sorted lists.
+        vector<uint64_t> forwardBegin;
+        vector<uint32_t> forwardNeighbors;
+        vector<uint32_t> forwardEdgeIds;
+        span<const uint32_t> getForwardNeighbors(uint64_t v) const
+        {
+            return span<const uint32_t>(
+                forwardNeighbors.data() + forwardBegin[v],
+                forwardNeighbors.data() + forwardBegin[v + 1]);
+        }
+        span<const uint32_t> getForwardEdgeIds(uint64_t v) const
+        {
+            return span<const uint32_t>(
+                forwardEdgeIds.data() + forwardBegin[v],
+                forwardEdgeIds.data() + forwardBegin[v + 1]);
+        }
+
         // The inconsistent read graph edge ids found by each thread.
         vector< vector<uint64_t> > threadEdgeIds;
     };
     FlagInconsistentAlignmentsData flagInconsistentAlignmentsData;
+    void flagInconsistentAlignmentsCreateForwardLists(size_t threadCount);
 public:
 
 
@@ -1009,7 +1411,7 @@ public:
     };
     CreateReadGraphUsingPseudoPathsData createReadGraphUsingPseudoPathsData;
 
-    // Thread function used to compute pseudoPaths.
+    // Thread function used to extract the segments of the stored pseudoPaths.
     void createReadGraphUsingPseudoPathsThreadFunction1(size_t threadId);
     // Thread functions used to align pseudopaths.
     void createReadGraphUsingPseudoPathsThreadFunction2(size_t threadId);
@@ -1038,6 +1440,7 @@ private:
     class FlagCrossStrandReadGraphEdges1Data {
     public:
         size_t maxDistance;
+        const ReadGraphCsr* csr = 0;
         vector<bool> isNearStrandJump;
     };
     FlagCrossStrandReadGraphEdges1Data flagCrossStrandReadGraphEdges1Data;
@@ -1051,7 +1454,7 @@ public:
 
     // Create the ReadGraph given a bool vector that specifies which
     // alignments should be used in the read graph.
-    void createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignment);
+    void createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignment, size_t threadCount = 0);
 
     // Add alignments to avoid coverage holes.
     void fixCoverageHoles(vector<bool>& keepAlignment) const;
@@ -1064,6 +1467,7 @@ private:
     class FlagChimericReadsData {
     public:
         size_t maxDistance;
+        const ReadGraphCsr* csr = 0;
     };
     FlagChimericReadsData flagChimericReadsData;
     void flagChimericReadsThreadFunction(size_t threadId);
@@ -1079,7 +1483,8 @@ private:
             bool allowCrossStrandEdges,
             bool allowInconsistentAlignmentEdges,
             double timeout,         // Or 0 for no timeout.
-            LocalReadGraph&);
+            LocalReadGraph&,
+            size_t threadCount = 1);
 
     // Create a local subgraph of the global read graph,
     // starting at any number of  given vertexes and extending out to a specified
@@ -1091,7 +1496,68 @@ private:
         bool allowCrossStrandEdges,
         bool allowInconsistentAlignmentEdges,
         double timeout,         // Or 0 for no timeout.
-        LocalReadGraph&);
+        LocalReadGraph&,
+        size_t threadCount = 1);
+    bool createLocalReadGraphParallel(
+        const vector<OrientedReadId>& starts,
+        uint32_t maxDistance,
+        bool allowChimericReads,
+        bool allowCrossStrandEdges,
+        bool allowInconsistentAlignmentEdges,
+        double timeout,
+        LocalReadGraph&,
+        size_t threadCount);
+
+    // Level-synchronous parallel BFS used by createLocalReadGraph
+    // and createLocalAlignmentGraph when threadCount is greater than 1.
+    // Each level of the BFS is expanded in parallel.
+    // Vertices already reached are kept track of in a StripedMap,
+    // so threads can claim newly reached vertices without a global lock.
+    // On return, vertices contains the vertices reached
+    // and their distance from the starts, in order of increasing distance,
+    // and edges contains (orientedReadId0, orientedReadId1, edgeId)
+    // for the edges that the serial BFS would create,
+    // without duplicates and sorted by edgeId.
+    // findEdges is called concurrently by multiple threads and must
+    // return the other vertex and id of the edges that should be followed.
+    // Returns false if the timeout was exceeded.
+    using LocalGraphFindEdges = std::function<void(
+        OrientedReadId,
+        vector< pair<OrientedReadId, uint64_t> >&)>;
+    bool localGraphBfs(
+        const vector<OrientedReadId>& starts,
+        uint32_t maxDistance,
+        double timeout,         // Or 0 for no timeout.
+        size_t threadCount,
+        const LocalGraphFindEdges&,
+        vector< pair<OrientedReadId, uint32_t> >& vertices,
+        vector< tuple<OrientedReadId, OrientedReadId, uint64_t> >& edges);
+    class LocalGraphBfsData {
+    public:
+        const LocalGraphFindEdges* findEdges;
+        uint32_t maxDistance;
+        double timeout;
+        std::chrono::steady_clock::time_point startTime;
+        std::atomic<bool> timeoutExceeded;
+
+        // The vertices at the current distance.
+        vector<OrientedReadId> frontier;
+        uint32_t distance0;
+
+        // The vertices reached so far, with their distance.
+        StripedMap<OrientedReadId::Int, uint32_t> distanceMap;
+
+        // The new vertices and the edges found by each thread
+        // while expanding the current frontier.
+        class ThreadData {
+        public:
+            vector<OrientedReadId> newVertices;
+            vector< tuple<OrientedReadId, OrientedReadId, uint64_t> > edges;
+        };
+        vector<ThreadData> threadData;
+    };
+    LocalGraphBfsData localGraphBfsData;
+    void localGraphBfsThreadFunction(size_t threadId);
 
     // Triangle analysis of the local read graph.
     // Returns a vector of triangles and their alignment residuals,
@@ -1123,13 +1589,40 @@ public:
     // Compute connected components of the read graph.
     // This just writes a csv file and has no other side effects
     // (nothing is stored).
-    void computeReadGraphConnectedComponents() const;
+    void computeReadGraphConnectedComponents(size_t threadCount = 0) const;
+
+    // Renumber the reads in the order in which they are reached by a BFS
+    // of the read graph, so reads that are close in the read graph
+    // get nearby ReadIds. The reads, markers, alignment candidates,
+    // alignments, and read graph are all updated consistently.
+    // This is optionally done at the end of the read graph stage
+    // (--ReadGraph.renumberReads) and must be done
+    // before the marker graph is created.
+    void renumberReads(size_t threadCount = 0);
+
+    // Return the ReadId a read had before the reads were renumbered.
+    // If the reads were not renumbered, this is the ReadId itself.
+    ReadId getOriginalReadId(ReadId) const;
+    void accessOriginalReadIds();
+private:
+
+    // The original ReadId of each read, indexed by ReadId.
+    // Only stored if the reads were renumbered.
+    MemoryMapped::Vector<ReadId> originalReadIds;
+public:
 
 
 
     // Private functions and data used by createMarkerGraphVertices.
 private:
-    void createMarkerGraphVerticesThreadFunction1(size_t threadId);
+    void createMarkerGraphVerticesDisjointSets(uint64_t shardCount, size_t threadCount);
+    void createMarkerGraphVerticesExternal(double memoryBudget, size_t threadCount);
+    void createMarkerGraphVerticesThreadFunction0(size_t threadId);
+    void createMarkerGraphVerticesThreadFunction11(size_t threadId);
+    void createMarkerGraphVerticesThreadFunction12(size_t threadId);
+    void createMarkerGraphVerticesProcessEdgePair(
+        uint64_t edgeId, Alignment&, vector<AlignedMarkerPair>&);
+    void createMarkerGraphVerticesCreateShards(uint64_t shardCount);
     void createMarkerGraphVerticesThreadFunction2(size_t threadId);
     void createMarkerGraphVerticesThreadFunction21(size_t threadId);
     void createMarkerGraphVerticesThreadFunction3(size_t threadId);
@@ -1152,6 +1645,35 @@ private:
         // Disjoint sets data structures.
         shared_ptr<DisjointSets> disjointSetsPointer;
 
+        // The shards used for the disjoint set computation.
+        // Each shard is a contiguous range of ReadIds
+        // and therefore of oriented markers.
+        // Thread threadId works on shard threadId % shards.size() and,
+        // if bindThreadsToNumaNodes is true, it is bound to
+        // NUMA node shardId % numaNodeCount.
+        // See createMarkerGraphVertices for details.
+        class Shard {
+        public:
+            ReadId readBegin;
+            ReadId readEnd;
+            MarkerId markerBegin;
+            MarkerId markerEnd;
+
+            // The read graph edge pairs with both reads in this shard,
+            // each identified by the id of its first edge.
+            vector<uint64_t> edgePairs;
+
+            // Counters used to distribute work to threads.
+            uint64_t nextMarker;
+            uint64_t nextEdgePair;
+        };
+        vector<Shard> shards;
+        bool bindThreadsToNumaNodes;
+        uint64_t numaNodeCount;
+
+        // The read graph edge pairs with reads in different shards.
+        vector<uint64_t> boundaryEdgePairs;
+
         // The disjoint set that each oriented marker was assigned to.
         // See createMarkerGraphVertices for details.
         MemoryMapped::Vector<MarkerGraph::VertexId> disjointSetTable;
@@ -1194,9 +1716,43 @@ public:
     void accessMarkerGraphReverseComplementVertex(bool readWriteAccess = false);
     void removeMarkerGraphVertices();
 private:
+    void findMarkerGraphReverseComplementVerticesThreadFunction0(size_t threadId);
     void findMarkerGraphReverseComplementVerticesThreadFunction1(size_t threadId);
     void findMarkerGraphReverseComplementVerticesThreadFunction2(size_t threadId);
 
+    // Same as findMarkerGraphReverseComplementVertices, but only
+    // finds the reverse complement of the vertices in vertexIds.
+    // The reverse complement of all other vertices must already be stored.
+    void findMarkerGraphReverseComplementVertices(
+        size_t threadCount,
+        vector<MarkerGraph::VertexId>& vertexIds);
+
+    class FindMarkerGraphReverseComplementVerticesData {
+    public:
+
+        // If not empty, only these vertices are processed by
+        // findMarkerGraphReverseComplementVerticesThreadFunction1.
+        vector<MarkerGraph::VertexId> vertexIds;
+
+        // An unpacked copy of markerGraph.vertexTable, with 8 bytes
+        // per marker instead of 5. It is only created if
+        // there is enough memory available. Otherwise,
+        // lookups use markerGraph.vertexTable directly.
+        MemoryMapped::Vector<uint64_t> vertexTable;
+    };
+    FindMarkerGraphReverseComplementVerticesData findMarkerGraphReverseComplementVerticesData;
+public:
+
+    // Renumber the marker graph vertices in the order in which they
+    // are first encountered when walking the marker paths of all
+    // oriented reads (see MarkerGraph::renumberVertexTableInMarkerOrder).
+    // This improves the memory locality of later accesses to the
+    // vertices and to the data structures indexed by VertexId.
+    // It must be called after findMarkerGraphReverseComplementVertices
+    // and before the marker graph edges are created.
+    void renumberMarkerGraphVertices(size_t threadCount);
+private:
+
 
 
     // Given a marker graph vertex, follow all of the contributing oriented
@@ -1227,6 +1783,7 @@ public:
         bool pattern2CreateNewVertices);
 private:
     void cleanupDuplicateMarkersThreadFunction(size_t threadId);
+    void cleanupDuplicateMarkersRenumberThreadFunction(size_t threadId);
     void cleanupDuplicateMarkersPattern1(
         MarkerGraph::VertexId,
         uint64_t minCoverage,
@@ -1258,6 +1815,18 @@ private:
 
         MarkerGraph::VertexId nextVertexId;
 
+        // Set for the vertices with duplicate markers and their
+        // reverse complements, which are the only ones modified.
+        // The reverse complement of all other vertices remains valid,
+        // after renumbering, and does not need to be recomputed.
+        MemoryMapped::Vector<bool> wasChanged;
+
+        // Used after renumbering the vertex table.
+        MemoryMapped::Vector<MarkerGraph::VertexId> oldReverseComplementVertex;
+        MemoryMapped::Vector<MarkerGraph::VertexId> newVertexId;
+        uint64_t oldVertexCount;
+        vector< vector<MarkerGraph::VertexId> > threadVerticesToBeChecked;
+
         // Get the next vertex id, then increment it in thread safe way.
         MarkerGraph::VertexId getAndIncrementNextVertexId()
         {
@@ -1275,16 +1844,46 @@ public:
     void accessMarkerGraphEdges(bool accessEdgesReadWrite, bool accessConnectivityReadWrite = false);
     void checkMarkerGraphEdgesIsOpen() const;
     void accessMarkerGraphConsensus();
+
+    // Create or access the inverted index containing the
+    // OrientedReadIds of each marker graph edge (MarkerGraph::edgeOrientedReadIds).
+    // When available, it is used by mode 3b code
+    // that only needs the OrientedReadIds.
+    void createMarkerGraphEdgeOrientedReadIds(size_t threadCount);
+    void accessMarkerGraphEdgeOrientedReadIds();
 private:
     void createMarkerGraphEdgesThreadFunction0(size_t threadId);
     void createMarkerGraphEdgesThreadFunction1(size_t threadId);
     void createMarkerGraphEdgesThreadFunction2(size_t threadId);
     void createMarkerGraphEdgesThreadFunction12(size_t threadId, size_t pass);
+    void createMarkerGraphEdgesThreadFunction3(size_t threadId);
+    void createMarkerGraphEdgesThreadFunction4(size_t threadId);
     void createMarkerGraphEdgesBySourceAndTarget(size_t threadCount);
     class CreateMarkerGraphEdgesData {
     public:
         vector< shared_ptr< MemoryMapped::Vector<MarkerGraph::Edge> > > threadEdges;
         vector< shared_ptr< MemoryMapped::VectorOfVectors<MarkerInterval, uint64_t> > > threadEdgeMarkerIntervals;
+
+        // Each batch of vertices processed by createMarkerGraphEdgesThreadFunction0
+        // generates a run of edges sorted by source vertex, stored
+        // contiguously in the vectors of the thread that processed it.
+        // Because the batches cover disjoint ranges of source vertices,
+        // sorting the runs by their first vertex merges them
+        // into the final edges, sorted by source vertex.
+        class Run {
+        public:
+            MarkerGraph::VertexId vertexBegin;
+            uint64_t threadId;
+            uint64_t threadEdgeBegin;
+            uint64_t threadEdgeEnd;
+            uint64_t edgeBegin;     // The EdgeId of the first edge of the run.
+            bool operator<(const Run& that) const
+            {
+                return vertexBegin < that.vertexBegin;
+            }
+        };
+        vector< vector<Run> > threadRuns;
+        vector<Run> runs;
     };
     CreateMarkerGraphEdgesData createMarkerGraphEdgesData;
 
@@ -1470,10 +2069,35 @@ private:
 public:
 
     // Prune leaves from the strong subgraph of the global marker graph.
-    void pruneMarkerGraphStrongSubgraph(size_t iterationCount);
+    void pruneMarkerGraphStrongSubgraph(size_t iterationCount, size_t threadCount = 0);
 
 private:
 
+    // Data and functions used by pruneMarkerGraphStrongSubgraph.
+    // Each layer of leaves is pruned at once.
+    // The first layer is found by looking at all edges.
+    // After that, only the edges adjacent to the
+    // edges pruned in the previous layer need to be checked.
+    class PruneMarkerGraphStrongSubgraphData {
+    public:
+
+        // The edges to be pruned at the current iteration.
+        vector<MarkerGraph::EdgeId> frontier;
+
+        // The edges to be pruned at the next iteration,
+        // found by each thread.
+        vector< vector<MarkerGraph::EdgeId> > threadFrontiers;
+
+        // Flags used to make sure each edge is added only once
+        // to the next frontier.
+        MemoryMapped::Vector<uint8_t> isInFrontier;
+    };
+    PruneMarkerGraphStrongSubgraphData pruneMarkerGraphStrongSubgraphData;
+    void pruneMarkerGraphStrongSubgraphThreadFunction1(size_t threadId);
+    void pruneMarkerGraphStrongSubgraphThreadFunction2(size_t threadId);
+    bool isPrunableEdgeOfMarkerGraphStrongSubgraph(MarkerGraph::EdgeId) const;
+    void addToPruneMarkerGraphStrongSubgraphFrontier(size_t threadId, MarkerGraph::EdgeId);
+
 
 
     // Private access functions for the global marker graph.
@@ -1508,6 +2132,13 @@ private:
         vector< pair<MarkerGraphVertexId, MarkerInterval> >& workArea
         ) const;
 
+    // Same as above, but returns the (child vertex, marker interval) pairs
+    // without grouping them, sorted by child vertex.
+    void getGlobalMarkerGraphVertexChildMarkerIntervals(
+        MarkerGraphVertexId,
+        vector< pair<MarkerGraphVertexId, MarkerInterval> >&
+        ) const;
+
     // Given two marker graph vertices, get the marker intervals
     // that a possible edge between the two vertices would have.
     void getMarkerIntervals(
@@ -1578,17 +2209,22 @@ private:
         ) const;
 
     // Create the marker connectivity graph starting with a given marker.
+    // The alignments are decompressed using threadCount threads
+    // (all hardware threads if threadCount is 0). Use a threadCount
+    // of 1 when calling from a thread function.
     void createMarkerConnectivityGraph(
         OrientedReadId,
         uint32_t ordinal,
         bool useReadGraphAlignmentsOnly,
-        MarkerConnectivityGraph&) const;
+        MarkerConnectivityGraph&,
+        size_t threadCount = 0) const;
     void createMarkerConnectivityGraph(
         OrientedReadId,
         uint32_t ordinal,
         bool useReadGraphAlignmentsOnly,
         MarkerConnectivityGraph&,
-        MarkerConnectivityGraphVertexMap&) const;
+        MarkerConnectivityGraphVertexMap&,
+        size_t threadCount = 0) const;
 
     // Compute an alignment between two oriented reads
     // induced by the marker graph. See InducedAlignment.hpp for more
@@ -1606,6 +2242,52 @@ private:
         const vector<OrientedReadId>& orientedReadIds1,
         vector<InducedAlignment>& inducedAlignments);
 
+    // Compute induced alignments for a batch of pairs of oriented reads,
+    // in parallel. On return, inducedAlignments[i] is the induced alignment
+    // for orientedReadPairs[i], with compressed ordinals filled in.
+    // The marker graph vertices of each oriented read are computed only once,
+    // regardless of the number of pairs it appears in.
+    void computeInducedAlignments(
+        const vector< pair<OrientedReadId, OrientedReadId> >& orientedReadPairs,
+        vector<InducedAlignment>& inducedAlignments,
+        size_t threadCount);
+    class ComputeInducedAlignmentsData {
+    public:
+        const vector< pair<OrientedReadId, OrientedReadId> >* orientedReadPairs;
+        vector<InducedAlignment>* inducedAlignments;
+
+        // The distinct oriented reads that appear in the pairs, sorted.
+        vector<OrientedReadId> orientedReadIds;
+
+        // For each of those oriented reads, the markers that are
+        // on a marker graph vertex, sorted by vertex id.
+        class VertexInfo {
+        public:
+            MarkerGraph::VertexId vertexId;
+            uint32_t ordinal;
+            uint32_t compressedOrdinal;
+            bool operator<(const VertexInfo& that) const
+            {
+                return vertexId < that.vertexId;
+            }
+        };
+        vector< vector<VertexInfo> > vertices;
+
+        // The number of markers on a marker graph vertex,
+        // for each of those oriented reads.
+        vector<uint32_t> compressedMarkerCount;
+
+        uint64_t getIndex(OrientedReadId orientedReadId) const
+        {
+            const auto it = std::lower_bound(orientedReadIds.begin(), orientedReadIds.end(), orientedReadId);
+            SHASTA_ASSERT(it != orientedReadIds.end() and *it == orientedReadId);
+            return it - orientedReadIds.begin();
+        }
+    };
+    ComputeInducedAlignmentsData computeInducedAlignmentsData;
+    void computeInducedAlignmentsThreadFunction1(size_t threadId);
+    void computeInducedAlignmentsThreadFunction2(size_t threadId);
+
     // Fill in compressed ordinals of an InducedAlignment.
     void fillCompressedOrdinals(
         OrientedReadId,
@@ -1622,6 +2304,7 @@ private:
 
 
     // Extract a local subgraph of the global marker graph.
+    // Edge consensus sequences are only computed if computeEdgeConsensus is true.
     bool extractLocalMarkerGraph(
         OrientedReadId,
         uint32_t ordinal,
@@ -1634,7 +2317,8 @@ private:
         bool useSuperBubbleEdges,
         bool useLowCoverageCrossEdges,
         bool useRemovedSecondaryEdges,
-        LocalMarkerGraph0&
+        LocalMarkerGraph0&,
+        bool computeEdgeConsensus = true
         );
     bool extractLocalMarkerGraph(
         MarkerGraph::VertexId,
@@ -1647,14 +2331,19 @@ private:
         bool useSuperBubbleEdges,
         bool useLowCoverageCrossEdges,
         bool useRemovedSecondaryEdges,
-        LocalMarkerGraph0&
+        LocalMarkerGraph0&,
+        bool computeEdgeConsensus = true
         );
 
     // Compute consensus sequence for a vertex of the marker graph.
+    // The last two arguments are work areas that the caller
+    // can reuse for many vertices to reduce memory allocation activity.
     void computeMarkerGraphVertexConsensusSequence(
         MarkerGraph::VertexId,
         vector<Base>& sequence,
-        vector<uint32_t>& repeatCounts
+        vector<uint32_t>& repeatCounts,
+        vector<Coverage>& coverages,
+        vector<Consensus>& consensus
         );
 
 
@@ -1702,11 +2391,11 @@ private:
 
     // Use spoa to compute consensus sequence for an edge of the marker graph.
     // This does not include the bases corresponding to the flanking markers.
+    // The SpoaEnginePool should be reused for many edges.
     void computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
         MarkerGraphEdgeId,
         uint32_t markerGraphEdgeLengthThresholdForConsensus,
-        const std::unique_ptr<spoa::AlignmentEngine>& spoaAlignmentEngine,
-        spoa::Graph& spoaAlignmentGraph,
+        SpoaEnginePool&,
         vector<Base>& sequence,
         vector<uint32_t>& repeatCounts,
         uint8_t& overlappingBaseCount,
@@ -1733,6 +2422,18 @@ private:
         size_t maxLength,
         bool debug);
 
+    // Each part of each iteration of simplifyMarkerGraph uses a temporary
+    // assembly graph. The chains of the previous one are kept, so only the
+    // chains affected by the edges removed since then are recomputed.
+    void createSimplifyMarkerGraphAssemblyGraph();
+    void saveSimplifyMarkerGraphChains();
+    class SimplifyMarkerGraphData {
+    public:
+        MemoryMapped::VectorOfVectors<AssemblyGraphEdgeId, AssemblyGraphEdgeId> previousChains;
+        vector<AssemblyGraphEdgeId> previousReverseComplementChain;
+    };
+    SimplifyMarkerGraphData simplifyMarkerGraphData;
+
 
 
     // Create a coverage histogram for vertices and edges of the
@@ -1756,7 +2457,18 @@ public:
     }
     void createAssemblyGraphVertices();
     void accessAssemblyGraphVertices();
-    void createAssemblyGraphEdges();
+    void createAssemblyGraphEdges(size_t threadCount = 0);
+    void createAssemblyGraphEdgesIncremental(
+        const MemoryMapped::VectorOfVectors<AssemblyGraphEdgeId, AssemblyGraphEdgeId>& previousChains,
+        const vector<AssemblyGraphEdgeId>& previousReverseComplementChain);
+    bool findAssemblyGraphChain(
+        MarkerGraphEdgeId startEdgeId,
+        vector<MarkerGraphEdgeId>& chain,
+        vector<MarkerGraphEdgeId>& workArea) const;
+    bool getReverseComplementedAssemblyGraphChain(
+        const vector<MarkerGraphEdgeId>& chain,
+        bool isCircularChain,
+        vector<MarkerGraphEdgeId>& reverseComplementedChain) const;
     void accessAssemblyGraphEdgeLists();
     void accessAssemblyGraphEdges();
     void accessAssemblyGraphOrientedReadsByEdge();
@@ -1764,13 +2476,11 @@ public:
     void pruneAssemblyGraph(uint64_t pruneLength);
 
     // Gather and write out all reads that contributed to
-    // each assembly graph edge.
+    // each assembly graph edge. This also creates the transpose,
+    // AssemblyGraph::edgesByOrientedRead.
     void gatherOrientedReadsByAssemblyGraphEdge(size_t threadCount);
     void writeOrientedReadsByAssemblyGraphEdge();
 private:
-    void gatherOrientedReadsByAssemblyGraphEdgePass1(size_t threadId);
-    void gatherOrientedReadsByAssemblyGraphEdgePass2(size_t threadId);
-    void gatherOrientedReadsByAssemblyGraphEdgePass(int);
 
     // Extract a local assembly graph from the global assembly graph.
     // This returns false if the timeout was exceeded.
@@ -1791,6 +2501,17 @@ public:
     void accessMarkerGraphVertexRepeatCounts();
 private:
     void assembleMarkerGraphVerticesThreadFunction(size_t threadId);
+
+    // Faster computation of the consensus repeat counts of a vertex,
+    // used when consensusCaller->canCallRepeatCounts() returns true.
+    // All markers of a vertex have the same k-mer, so only the repeat
+    // counts can differ. They are gathered in repeatCountMatrix,
+    // a work area that the caller can reuse for many vertices,
+    // with one row for each of the k positions and one column for each marker.
+    void computeMarkerGraphVertexConsensusRepeatCounts(
+        MarkerGraph::VertexId,
+        vector<uint8_t>& repeatCountMatrix,
+        vector<uint32_t>& repeatCounts) const;
 public:
 
 
@@ -1809,9 +2530,7 @@ private:
         // - threadVertexCoverageData[threadId] contains the coverage data for those vertices.
         vector< shared_ptr<
             MemoryMapped::Vector<MarkerGraph::VertexId> > > threadVertexIds;
-        vector< shared_ptr<
-            MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t> > >
-            threadVertexCoverageData;
+        vector< shared_ptr<CoverageDataStore> > threadVertexCoverageData;
     };
     ComputeMarkerGraphVerticesCoverageDataData computeMarkerGraphVerticesCoverageDataData;
 
@@ -1860,7 +2579,8 @@ public:
 
         // The marker graph path computed using computeOrientedReadMarkerGraphPath.
         // This is computed by this function - it does not neet to be filled in
-        // in advance.
+        // in advance. It is left empty if the pseudo-path is obtained
+        // from AssemblyGraph::edgesByOrientedRead.
         vector<MarkerGraphEdgeId>& path,
         vector< pair<uint32_t, uint32_t> >& pathOrdinals,
 
@@ -1868,15 +2588,58 @@ public:
         PseudoPath&) const;
     void writePseudoPath(ReadId, Strand) const;
     static void getPseudoPathSegments(const PseudoPath&, vector<AssemblyGraphEdgeId>&);
+    static void getPseudoPathSegments(span<const PseudoPathEntry>, vector<AssemblyGraphEdgeId>&);
+
+    // Compute the pseudo-paths of all oriented reads in parallel
+    // and store them in pseudoPaths, indexed by OrientedReadId::getValue().
+    // This does nothing if pseudoPaths are already available
+    // for the current assembly graph.
+    void computePseudoPaths(size_t threadCount);
+    bool pseudoPathsAreAvailable() const;
+
+    // Get the pseudo-path of an oriented read, using the stored
+    // pseudoPaths if available, or computing it otherwise.
+    void getPseudoPath(OrientedReadId, PseudoPath&) const;
+
+    MemoryMapped::VectorOfVectors<PseudoPathEntry, uint64_t> pseudoPaths;
+private:
+
+    // The assembly graph the stored pseudoPaths were computed for.
+    // The pseudoPaths become invalid when the assembly graph is replaced.
+    std::weak_ptr<AssemblyGraph> pseudoPathsAssemblyGraph;
+
+    // Each thread computes the pseudo-paths of its oriented reads
+    // into its own scratch area, which is reused for all of them.
+    // The pseudo-paths are then copied to pseudoPaths.
+    void computePseudoPathsThreadFunction1(size_t threadId);
+    void computePseudoPathsThreadFunction2(size_t threadId);
+    class ComputePseudoPathsData {
+    public:
+        class ThreadData {
+        public:
+            vector<PseudoPathEntry> entries;
+
+            // For each oriented read processed by this thread,
+            // the OrientedReadId::getValue() and the
+            // begin index of its pseudo-path in entries.
+            vector< pair<uint64_t, uint64_t> > orientedReads;
+        };
+        vector<ThreadData> threadData;
+    };
+    ComputePseudoPathsData computePseudoPathsData;
+public:
 
 
 
     // Detangle the AssemblyGraph.
-    void detangle();    // detangleMethod 1
-    void detangle2(     // detangleMethod 2
+    // Tangles are evaluated using threadCount threads
+    // (0 means all available hardware threads).
+    void detangle(size_t threadCount = 0);  // detangleMethod 1
+    void detangle2(                         // detangleMethod 2
         uint64_t diagonalReadCountMin,
         uint64_t offDiagonalReadCountMax,
-        double detangleOffDiagonalRatio
+        double detangleOffDiagonalRatio,
+        size_t threadCount = 0
          );
 
 
@@ -1940,9 +2703,10 @@ private:
         vector< shared_ptr< MemoryMapped::VectorOfVectors<pair<Base, uint8_t>, uint64_t> > > threadEdgeConsensus;
         vector< shared_ptr< MemoryMapped::Vector<uint8_t> > > threadEdgeConsensusOverlappingBaseCount;
 
-        vector< shared_ptr<
-            MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t> > >
-            threadEdgeCoverageData;
+        vector< shared_ptr<CoverageDataStore> > threadEdgeCoverageData;
+
+        // Only used if slow item tracing is enabled.
+        shared_ptr<SlowItemTracer> slowItems;
     };
     AssembleMarkerGraphEdgesData assembleMarkerGraphEdgesData;
 
@@ -1991,9 +2755,41 @@ private:
     public:
         uint32_t storeCoverageDataCsvLengthThreshold;
 
+        // Long assembly graph edges are split into ranges of
+        // marker graph edges which are assembled independently,
+        // so a few very long edges don't leave a single thread running
+        // at the end of the assembly.
+        // Each range is assembled with enough marker graph edges of
+        // context on each side to make the concatenated sequence
+        // identical to what we get when assembling the entire edge.
+        // Edges are not split when storing coverage data,
+        // because the csv files are written for entire edges.
+        static const uint64_t maxRangeLength = 10000;
+        class Range {
+        public:
+            AssemblyGraphEdgeId edgeId;
+            uint64_t begin;
+            uint64_t end;
+            uint64_t length() const
+            {
+                return end - begin;
+            }
+        };
+
+        // The ranges, in order of edge id and position in the edge.
+        vector<Range> ranges;
+
+        // The ranges for each edge are ranges[rangesBegin[edgeId], rangesBegin[edgeId+1]).
+        vector<uint64_t> rangesBegin;
+
+        // The order in which ranges are assembled, longest first.
+        vector<uint64_t> rangeOrder;
+
+        void createRanges(const AssemblyGraph&);
+
         // The results created by each thread.
         // All indexed by threadId.
-        vector< vector<AssemblyGraphEdgeId> > edges;
+        vector< vector<uint64_t> > rangeIds;
         vector< shared_ptr<LongBaseSequences> > sequences;
         vector< shared_ptr<MemoryMapped::VectorOfVectors<uint8_t, uint64_t> > > repeatCounts;
         void allocate(size_t threadCount);
@@ -2002,13 +2798,25 @@ private:
     AssembleData assembleData;
     void assembleThreadFunction(size_t threadId);
 
+    // Assemble a range of an assembly graph edge.
+    // Returns the range of positions of the run-length sequence
+    // of the AssembledSegment that belong to the range.
+    pair<uint64_t, uint64_t> assembleRange(
+        const AssembleData::Range&,
+        bool storeCoverageData,
+        AssembledSegment&);
+
 
 
     // Write the assembly graph in GFA 1.0 format defined here:
     // https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
 public:
-    void writeGfa1(const string& fileName);
-    void writeGfa1BothStrands(const string& fileName);
+    // The records are formatted using threadCount threads
+    // (0 means all available hardware threads).
+    // If the file name ends with .gz, the output is compressed
+    // in BGZF format and indexed (see Bgzf.hpp).
+    void writeGfa1(const string& fileName, size_t threadCount = 0);
+    void writeGfa1BothStrands(const string& fileName, size_t threadCount = 0);
     void writeGfa1BothStrandsNoSequence(const string& fileName);
 private:
     // Construct the CIGAR string given two vectors of repeat counts.
@@ -2022,7 +2830,9 @@ private:
 public:
 
     // Write assembled sequences in FASTA format.
-    void writeFasta(const string& fileName);
+    // If the file name ends with .gz, the output is compressed
+    // in BGZF format and indexed (see Bgzf.hpp).
+    void writeFasta(const string& fileName, size_t threadCount = 0);
 
 
 
@@ -2094,10 +2904,28 @@ public:
         const vector<string>& request,
         ostream&,
         const BrowserInformation&) override;
+    bool requiresExclusiveAccess(const vector<string>& request) const override;
+    static bool isCacheable(const string& keyword);
+
+    // The number of assembly stages that must have completed
+    // for a request to be processed, and the number of stages
+    // whose data the request can use, if available.
+    class StageRequirement {
+    public:
+        uint64_t requiredStageCount;
+        uint64_t usedStageCount;
+    };
+    static StageRequirement stageRequirement(const string& keyword);
+    std::shared_lock<std::shared_mutex> accessRequestData(const string& keyword);
+    uint64_t availableStageCount() const;
     void exploreSummary(const vector<string>&, ostream&);
+    void exploreMemoryUsage(const vector<string>&, ostream&);
     void exploreRead(const vector<string>&, ostream&);
     void exploreReadRaw(const vector<string>&, ostream&);
     void exploreReadRle(const vector<string>&, ostream&);
+    void searchReads(const vector<string>&, ostream&);
+    shared_ptr<ReadSequenceIndex> getReadSequenceIndex();
+    void getSearchSequence(const vector<string>& request, vector<Base>&) const;
     void blastRead(const vector<string>&, ostream&);
     void exploreAlignmentCandidateGraph(const vector<string>& request, ostream& html);
     void exploreAlignments(const vector<string>&, ostream&);
@@ -2112,6 +2940,19 @@ public:
     void exploreCompressedAssemblyGraph(const vector<string>&, ostream&);
     static bool parseCommaSeparatedReadIDs(string& commaSeparatedReadIds, vector<OrientedReadId>& readIds, ostream& html);
     static void addScaleSvgButtons(ostream&, uint64_t sizePixels);
+
+    // JSON endpoints (see AssemblerHttpServer-Json.cpp).
+    void jsonIndex(const vector<string>&, ostream&);
+    void jsonReads(const vector<string>&, ostream&);
+    void jsonReadSequenceHits(const vector<string>&, ostream&);
+    void jsonAlignmentCandidates(const vector<string>&, ostream&);
+    void jsonAlignments(const vector<string>&, ostream&);
+    void jsonMarkerGraphVertices(const vector<string>&, ostream&);
+    void jsonMarkerGraphEdges(const vector<string>&, ostream&);
+    void jsonMode3Segments(const vector<string>&, ostream&);
+    static void writeJsonString(ostream&, const string&);
+    static void writeJsonString(ostream&, const span<const char>&);
+
     class HttpServerData {
     public:
         shared_ptr<LocalAlignmentCandidateGraph> referenceOverlapGraph;
@@ -2120,12 +2961,60 @@ public:
             const vector<string>& request,
             ostream&);
         std::map<string, ServerFunction> functionTable;
+
+        // The functions that process requests with keywords beginning
+        // with "/api/". They write JSON instead of html.
+        std::map<string, ServerFunction> jsonFunctionTable;
+
         string docsDirectory;
         string referenceFastaFileName = "reference.fa";
 
         const AssemblerOptions* assemblerOptions = 0;
 
-        void createGraphEdgesFromOverlapMap(const ReferenceOverlapMap& overlapMap);
+        // If not null, the responses to requests for expensive pages
+        // are cached here (see isCacheable in AssemblerHttpServer.cpp).
+        shared_ptr<HttpResponseCache> responseCache;
+
+        // If not null, used to speed up the creation of local marker graphs
+        // (exploreMarkerGraph1).
+        shared_ptr<MarkerGraphNeighborhoodIndex> markerGraphNeighborhoodIndex;
+
+        // Protects Assembler::readSequenceIndex, which can be
+        // created while other requests are being processed.
+        std::mutex readSequenceIndexMutex;
+
+        // The AlignmentMatrixRenderer used by the last exploreAlignment
+        // request that displayed the alignment matrix, so its cached tiles
+        // can be reused when zooming or panning on the same alignment.
+        // It is identified by alignmentMatrixRendererKey and
+        // protected by alignmentMatrixRendererMutex.
+        shared_ptr<AlignmentMatrixRenderer> alignmentMatrixRenderer;
+        string alignmentMatrixRendererKey;
+        std::mutex alignmentMatrixRendererMutex;
+
+        // If lazyAccess is set, the binary data are not accessed
+        // when the http server starts. Instead, the data of the assembly stages
+        // needed by each request are accessed when the request is processed
+        // (see stageRequirement in AssemblerHttpServer.cpp).
+        // The data of assembly stages 0 through accessedStageCount-1
+        // have already been accessed.
+        bool lazyAccess = false;
+        uint64_t accessedStageCount = 0;
+
+        // Used when exploring an assembly that is still running
+        // (AssemblerInfo::assemblyIsRunning was set when the http server started).
+        // Only the data created by the stages that completed are accessed,
+        // and requests that need data from other stages are refused.
+        // When AssemblerInfo::stageGeneration changes, the data of the
+        // stages that completed in the meantime are accessed.
+        bool liveAssembly = false;
+        uint64_t liveStageGeneration = 0;
+
+        // In both cases, data are accessed holding dataAccessMutex for writing,
+        // and all other requests hold it for reading.
+        std::shared_mutex dataAccessMutex;
+
+        void createGraphEdgesFromOverlapMap(ReferenceOverlapMap& overlapMap);
 
     };
     HttpServerData httpServerData;
@@ -2136,6 +3025,9 @@ public:
     // members of HttpServerData
     void loadAlignmentsPafFile(const string& alignmentsPafFileAbsolutePath);
 
+    // Create the MarkerGraphNeighborhoodIndex used by exploreMarkerGraph1.
+    void createMarkerGraphNeighborhoodIndex(uint64_t threadCount);
+
     // Display alignments in an html table.
     void displayAlignments(
         OrientedReadId,
@@ -2246,6 +3138,17 @@ public:
 public:
     void accessAllSoft();
 
+    // Same, but only for the data created by
+    // assembly stages beginStage through endStage-1.
+    void accessAllSoft(uint64_t beginStage, uint64_t endStage);
+
+    // Used to explore an assembly that is still running.
+    // Access the data of the stages that already completed,
+    // unless httpServerData.lazyAccess is set.
+    // The data of stages that complete later are accessed
+    // by the http server as requests are processed.
+    void accessCompletedStagesSoft();
+
     // Store assembly time.
     void storeAssemblyTime(
         double elapsedTimeSeconds,
@@ -2356,6 +3259,7 @@ public:
         uint64_t direction              // 0=forward, 1=backward, 2=bidirectional
         ) const;
     void findCompleteMarkerGraphPaths(uint64_t threadCount) const;
+    void findCompleteMarkerGraphPrimaryPaths(uint64_t threadCount) const;
 
     // Given two consecutive primary edges, find the secondary edges
     // in between.
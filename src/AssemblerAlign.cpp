@@ -4,12 +4,18 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "Alignment.hpp"
+#include "AlignmentCache.hpp"
+#include "AlignmentCoordinator.hpp"
 #include "AlignmentGraph.hpp"
 #include "Align4.hpp"
 #include "AssemblerOptions.hpp"
 #include "compressAlignment.hpp"
+#include "KmerMask.hpp"
+#include "MarkerKmerIds.hpp"
+#include "MurmurHash2.hpp"
 #include "performanceLog.hpp"
 #include "Reads.hpp"
+#include "SlowItemTracer.hpp"
 #include "span.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
@@ -18,8 +24,12 @@ using namespace shasta;
 #include "chrono.hpp"
 #include <filesystem>
 #include "iterator.hpp"
+#include <numeric>
 #include "tuple.hpp"
 
+// Linux.
+#include <unistd.h>
+
 
 
 // Compute a marker alignment of two oriented reads.
@@ -164,7 +174,7 @@ void Assembler::alignOverlappingOrientedReads(
     // Loop over all alignments involving this oriented read.
     size_t goodAlignmentCount = 0;
     for(const uint64_t i: alignmentTable[orientedReadId0.getValue()]) {
-        const AlignmentData& ad = alignmentData[i];
+        const CompactAlignmentData& ad = alignmentData[i];
 
         // Get the other oriented read involved in this alignment.
         const OrientedReadId orientedReadId1 = ad.getOther(orientedReadId0);
@@ -203,6 +213,45 @@ void Assembler::alignOverlappingOrientedReads(
 
 
 
+// Hash of the options that affect the alignments stored by computeAlignments,
+// used as part of the keys of the AlignmentCache.
+static uint64_t computeAlignmentCacheOptionsHash(
+    const AlignOptions& alignOptions,
+    uint64_t k)
+{
+    std::ostringstream s;
+    s << std::setprecision(17);
+    s << k << " ";
+    s << alignOptions.alignMethod << " ";
+    s << alignOptions.maxSkip << " ";
+    s << alignOptions.maxDrift << " ";
+    s << alignOptions.maxTrim << " ";
+    s << alignOptions.maxMarkerFrequency << " ";
+    s << alignOptions.minAlignedMarkerCount << " ";
+    s << alignOptions.minAlignedFraction << " ";
+    s << alignOptions.matchScore << " ";
+    s << alignOptions.mismatchScore << " ";
+    s << alignOptions.gapScore << " ";
+    s << alignOptions.downsamplingFactor << " ";
+    s << alignOptions.bandExtend << " ";
+    s << alignOptions.maxBand << " ";
+    s << int(alignOptions.suppressContainments) << " ";
+    s << alignOptions.align4DeltaX << " ";
+    s << alignOptions.align4DeltaY << " ";
+    s << alignOptions.align4MinEntryCountPerCell << " ";
+    s << alignOptions.align4MaxDistanceFromBoundary << " ";
+    s << int(alignOptions.align4NativeBandedAlignment);
+
+    // Only included when used, so existing cache files remain valid.
+    if(alignOptions.align4MaxKmerFrequency > 0) {
+        s << " " << alignOptions.align4MaxKmerFrequency;
+    }
+    const string t = s.str();
+    return MurmurHash64A(t.data(), int(t.size()), 4553);
+}
+
+
+
 // Compute an alignment for each alignment candidate.
 // Store the alignments the satisfy our criteria.
 void Assembler::computeAlignments(
@@ -211,7 +260,10 @@ void Assembler::computeAlignments(
 
     // Number of threads. If zero, a number of threads equal to
     // the number of virtual processors is used.
-    size_t threadCount
+    size_t threadCount,
+
+    // If not zero, alignment workers can connect to this port.
+    uint16_t workerPort
 )
 {
     const auto tBegin = steady_clock::now();
@@ -223,23 +275,69 @@ void Assembler::computeAlignments(
     SHASTA_ASSERT(kmerChecker);
     checkMarkersAreOpen();
     checkAlignmentCandidatesAreOpen();
+    if(workerPort != 0 and
+        (alignOptions.readSaturationAlignmentCount > 0 or not alignOptions.cacheFile.empty())) {
+        throw runtime_error("Alignment workers cannot be used together with "
+            "--Align.readSaturationAlignmentCount or --Align.cacheFile.");
+    }
 
     // Store parameters so they are accessible to the threads.
     auto& data = computeAlignmentsData;
     data.alignOptions = &alignOptions;
+    data.candidateQueue = 0;
+    data.isAlignmentWorker = false;
+    data.candidateRangeBegin = 0;
 
     // Adjust the numbers of threads, if necessary.
     if(threadCount == 0) {
         threadCount = std::thread::hardware_concurrency();
     }
 
-    // For alignment method 4, compute sorted markers.
-    if(alignOptions.alignMethod == 4) {
-        cout << timestamp << "Computing sorted markers." << endl;
-        computeSortedMarkers(threadCount);
+    // If requested, process the candidates in order of decreasing
+    // LowHash frequency, so the most promising candidates of each read
+    // are aligned first, and keep track of the number of
+    // good alignments for each read, so candidates between
+    // reads that already have enough alignments can be skipped.
+    data.candidateOrder.clear();
+    data.readGoodAlignmentCount.clear();
+    data.skippedCandidateCount = 0;
+    if(alignOptions.readSaturationAlignmentCount > 0) {
+        const uint64_t candidateCount = alignmentCandidates.candidates.size();
+        data.candidateOrder.resize(candidateCount);
+        std::iota(data.candidateOrder.begin(), data.candidateOrder.end(), 0);
+        if(alignmentCandidates.frequencies.isOpen and
+            alignmentCandidates.frequencies.size() == candidateCount) {
+            const auto& frequencies = alignmentCandidates.frequencies;
+            std::stable_sort(data.candidateOrder.begin(), data.candidateOrder.end(),
+                [&frequencies](uint64_t i, uint64_t j)
+                {
+                    return frequencies[i] > frequencies[j];
+                });
+        } else {
+            cout << "Alignment candidate frequencies are not available. " <<
+                "Alignment candidates will be processed in their original order." << endl;
+        }
+        data.readGoodAlignmentCount.resize(reads->readCount(), 0);
     }
 
-    // Pick the batch size for computing alignments.
+    computeAlignmentsBegin(threadCount);
+
+    // If requested, also make the candidates available to alignment workers.
+    // They access the binary data via a shared filesystem,
+    // so make sure the data they need were written to disk.
+    if(workerPort != 0) {
+        markers.syncToDisk();
+        alignmentCandidates.candidates.syncToDisk();
+        if(sortedMarkers.isOpen()) {
+            sortedMarkers.syncToDisk();
+        }
+        data.alignmentCoordinator = make_shared<AlignmentCoordinator>(
+            workerPort,
+            alignmentCandidates.candidates.size(),
+            computeAlignmentCacheOptionsHash(alignOptions, assemblerInfo->k));
+    }
+
+    // Pick the minimum batch size for computing alignments.
     size_t batchSize = 10;
     if(batchSize > alignmentCandidates.candidates.size()/threadCount) {
         batchSize = alignmentCandidates.candidates.size()/threadCount;
@@ -248,25 +346,125 @@ void Assembler::computeAlignments(
         batchSize = 1;
     }
 
-
-    // Compute the alignments.
-    data.threadAlignmentData.resize(threadCount);
-    data.threadCompressedAlignments.resize(threadCount);
-    
+    // Guided load balancing processes the candidates in increasing order,
+    // which preserves the candidate order computed above,
+    // and batch sizes decrease towards the end, using the total number
+    // of markers in the two reads as an estimate of the cost of each alignment.
     performanceLog << timestamp << "Alignment computation begins." << endl;
-    setupLoadBalancing(alignmentCandidates.candidates.size(), batchSize);
+    alignmentCandidates.candidates.advise(data.candidateOrder.empty() ?
+        MemoryMapped::AccessPattern::sequential : MemoryMapped::AccessPattern::random);
+    markers.advise(MemoryMapped::AccessPattern::willNeed);
+    setupGuidedLoadBalancing(alignmentCandidates.candidates.size(), batchSize,
+        [this, &data](uint64_t i)
+        {
+            const uint64_t candidateIndex = data.candidateOrder.empty() ? i : data.candidateOrder[i];
+            const OrientedReadPair& candidate = alignmentCandidates.candidates[candidateIndex];
+            return uint64_t(
+                markers.size(OrientedReadId(candidate.readIds[0], 0).getValue()) +
+                markers.size(OrientedReadId(candidate.readIds[1], 0).getValue()));
+        });
     runThreads(&Assembler::computeAlignmentsThreadFunction, threadCount);
+    alignmentCandidates.candidates.advise(MemoryMapped::AccessPattern::normal);
     performanceLog << timestamp << "Alignment computation completed." << endl;
 
+    computeAlignmentsEnd(threadCount);
+
+    const auto tEnd = steady_clock::now();
+    const double tTotal = seconds(tEnd - tBegin);
+    performanceLog << timestamp << "Computation of alignments ";
+    performanceLog << "completed in " << tTotal << " s." << endl;
+
+    performanceLog << timestamp;
+}
+
+
+
+// Set up the data used by computeAlignmentsThreadFunction.
+// This is called with threadCount already adjusted,
+// after computeAlignmentsData.alignOptions was set.
+void Assembler::computeAlignmentsBegin(size_t threadCount)
+{
+    auto& data = computeAlignmentsData;
+    const AlignOptions& alignOptions = *data.alignOptions;
+
+    // For alignment method 4, compute sorted markers.
+    if(alignOptions.alignMethod == 4) {
+        cout << timestamp << "Computing sorted markers." << endl;
+        computeSortedMarkers(threadCount);
+    }
+
+    // For alignment method 4, if requested, find the high frequency
+    // marker k-mers that will not be used to create alignment matrices.
+    data.align4KmerMask.reset();
+    if(alignOptions.alignMethod == 4 and alignOptions.align4MaxKmerFrequency > 0) {
+        data.align4KmerMask = computeHighFrequencyMarkerKmerMask(
+            alignOptions.align4MaxKmerFrequency, threadCount);
+        cout << timestamp << "Align4 will skip " << data.align4KmerMask->size() <<
+            " marker k-mers with frequency greater than " <<
+            alignOptions.align4MaxKmerFrequency << "." << endl;
+    }
+
+    // If requested, keep track of the slowest alignments.
+    data.slowItems.reset();
+    if(slowItemTracingIsEnabled()) {
+        data.slowItems = make_shared<SlowItemTracer>(
+            "Alignments", "Candidate",
+            vector<string>({"ReadId0", "ReadId1", "Markers0", "Markers1"}));
+    }
+
+    // If requested, load the alignment cache.
+    data.alignmentCache.reset();
+    data.alignmentCacheHitCount = 0;
+    if(not alignOptions.cacheFile.empty()) {
+        if(alignOptions.cacheFile[0] != '/') {
+            throw runtime_error("Option --Align.cacheFile must specify an absolute path. "
+                "A relative path is not accepted.");
+        }
+        data.alignmentCache = make_shared<AlignmentCache>(alignOptions.cacheFile, threadCount);
+        data.alignmentCacheOptionsHash = computeAlignmentCacheOptionsHash(alignOptions, assemblerInfo->k);
+    }
+
+    data.threadAlignmentData.clear();
+    data.threadAlignmentData.resize(threadCount);
+    data.threadCompressedAlignments.clear();
+    data.threadCompressedAlignments.resize(threadCount);
+}
+
+
+
+// Store the alignments found by the threads of computeAlignmentsThreadFunction
+// and create the alignment table.
+void Assembler::computeAlignmentsEnd(size_t threadCount)
+{
+    auto& data = computeAlignmentsData;
+    const AlignOptions& alignOptions = *data.alignOptions;
+
+    // We no longer need the Align4 KmerMask.
+    data.align4KmerMask.reset();
+
+    if(data.slowItems) {
+        data.slowItems->write();
+        data.slowItems.reset();
+    }
+
+    // Update the alignment cache.
+    if(data.alignmentCache) {
+        cout << "Reused " << data.alignmentCacheHitCount <<
+            " alignment results from the alignment cache." << endl;
+        data.alignmentCache->writeNewEntries();
+        data.alignmentCache.reset();
+    }
+
     // Store the alignments found by each thread.
     performanceLog << timestamp << "Storing the alignment found by each thread." << endl;
     alignmentData.createNew(largeDataName("AlignmentData"), largeDataPageSize);
+    alignmentInfos.createNew(largeDataName("AlignmentInfos"), largeDataPageSize);
     compressedAlignments.createNew(largeDataName("CompressedAlignments"), largeDataPageSize);
     
     for(size_t threadId=0; threadId<threadCount; threadId++) {
         const vector<AlignmentData>& threadAlignmentData = data.threadAlignmentData[threadId];
         for(const AlignmentData& ad: threadAlignmentData) {
-            alignmentData.push_back(ad);
+            storeAlignmentData(ad);
         }
 
         const auto threadCompressedAlignments = data.threadCompressedAlignments[threadId];
@@ -282,9 +480,40 @@ void Assembler::computeAlignments(
         data.threadCompressedAlignments[threadId]->remove();
     }
 
+    // Add the alignments computed by alignment workers, if any.
+    if(data.alignmentCoordinator) {
+        const vector<AlignmentCoordinator::Shard> shards = data.alignmentCoordinator->getShards();
+        data.alignmentCoordinator.reset();
+        uint64_t workerAlignmentCount = 0;
+        vector<AlignmentData> shardAlignmentData;
+        for(const AlignmentCoordinator::Shard& shard: shards) {
+            const uint64_t n = AlignmentCoordinator::readShard(
+                AlignmentCoordinator::shardFileName(shard.begin, shard.end),
+                shardAlignmentData, compressedAlignments);
+            SHASTA_ASSERT(n == shard.alignmentCount);
+            for(const AlignmentData& ad: shardAlignmentData) {
+                storeAlignmentData(ad);
+            }
+            workerAlignmentCount += n;
+        }
+        std::filesystem::remove_all(AlignmentCoordinator::shardDirectory);
+        cout << "Alignment workers found " << workerAlignmentCount <<
+            " good alignments in " << shards.size() << " ranges of alignment candidates." << endl;
+    }
+
     // Release unused allocated memory.
     alignmentData.unreserve();
+    alignmentInfos.unreserve();
     compressedAlignments.unreserve();
+    if(alignOptions.readSaturationAlignmentCount > 0) {
+        cout << "Skipped " << data.skippedCandidateCount <<
+            " alignment candidates between reads that already had at least " <<
+            alignOptions.readSaturationAlignmentCount << " good alignments." << endl;
+        data.candidateOrder.clear();
+        data.candidateOrder.shrink_to_fit();
+        data.readGoodAlignmentCount.clear();
+        data.readGoodAlignmentCount.shrink_to_fit();
+    }
 
     // Cleanup.
     if(alignOptions.alignMethod == 4) {
@@ -293,14 +522,7 @@ void Assembler::computeAlignments(
 
     cout << "Found and stored " << alignmentData.size() << " good alignments." << endl;
     performanceLog << timestamp << "Creating alignment table." << endl;
-    computeAlignmentTable();
-
-    const auto tEnd = steady_clock::now();
-    const double tTotal = seconds(tEnd - tBegin);
-    performanceLog << timestamp << "Computation of alignments ";
-    performanceLog << "completed in " << tTotal << " s." << endl;
-
-    performanceLog << timestamp;
+    computeAlignmentTable(threadCount);
 }
 
 
@@ -331,11 +553,19 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
     const int bandExtend = data.alignOptions->bandExtend;
     const int maxBand = data.alignOptions->maxBand;
     const bool suppressContainments = data.alignOptions->suppressContainments;
+    const uint64_t readSaturationAlignmentCount = data.alignOptions->readSaturationAlignmentCount;
+    uint64_t skippedCandidateCount = 0;
+
+    // Used to compute the keys of the alignment cache, if using it.
+    AlignmentCache* alignmentCache = data.alignmentCache.get();
+    const MarkerKmerIds markerKmerIdsAccessor(assemblerInfo->k, getReads(), markers, markerKmerIds);
+    array<vector<KmerId>, 2> kmerIdsBuffers;
+    uint64_t alignmentCacheHitCount = 0;
 
 
     // Align4-specific items.
     Align4::Options align4Options;
-    MemoryMapped::ByteAllocator byteAllocator;
+    Align4::Workspace align4Workspace;
     if(alignmentMethod == 4) {
         align4Options.deltaX = data.alignOptions->align4DeltaX;
         align4Options.deltaY = data.alignOptions->align4DeltaY;
@@ -350,9 +580,8 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
         align4Options.matchScore = matchScore;
         align4Options.mismatchScore = mismatchScore;
         align4Options.gapScore = gapScore;
-        byteAllocator.createNew(
-            largeDataName("tmp-ByteAllocator-" + to_string(threadId)),
-            largeDataPageSize, 2ULL * 1024 * 1024 * 1024);
+        align4Options.nativeBandedAlignment = data.alignOptions->align4NativeBandedAlignment;
+        align4Options.kmerMask = data.align4KmerMask.get();
     }
 
     vector<AlignmentData>& threadAlignmentData = data.threadAlignmentData[threadId];
@@ -362,28 +591,96 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
     data.threadCompressedAlignments[threadId] = thisThreadCompressedAlignmentsPointer;
     auto& thisThreadCompressedAlignments = *thisThreadCompressedAlignmentsPointer;
     thisThreadCompressedAlignments.createNew(
+        data.isAlignmentWorker ? string() :
         largeDataName("tmp-ThreadGlobalCompressedAlignments-" + to_string(threadId)),
         largeDataPageSize);
 
+    // In streaming mode, the candidates are obtained from the queue,
+    // one batch at a time, instead of from alignmentCandidates.candidates.
+    // When using alignment workers, they are obtained from the AlignmentCoordinator.
+    BoundedQueue< vector<OrientedReadPair> >* candidateQueue = data.candidateQueue;
+    AlignmentCoordinator* alignmentCoordinator = data.alignmentCoordinator.get();
+    SlowItemTracer* slowItems = data.slowItems.get();
+    vector<OrientedReadPair> streamedCandidates;
+    uint64_t streamedCandidateCount = 0;
+    auto getNextCandidateBatch = [&](uint64_t& begin, uint64_t& end)
+    {
+        if(candidateQueue) {
+            if(not candidateQueue->pop(streamedCandidates)) {
+                return false;
+            }
+            begin = 0;
+            end = streamedCandidates.size();
+            streamedCandidateCount += end;
+            return true;
+        } else if(alignmentCoordinator) {
+            return alignmentCoordinator->getLocalBatch(10, begin, end);
+        } else {
+            if(not getNextBatch(begin, end)) {
+                return false;
+            }
+            begin += data.candidateRangeBegin;
+            end += data.candidateRangeBegin;
+            return true;
+        }
+    };
+
     uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
-        if((begin % 1000000) == 0){
+    while(getNextCandidateBatch(begin, end)) {
+        if(not candidateQueue and
+            ((begin % 1000000) == 0 or (begin / 1000000) != ((end - 1) / 1000000))) {
             std::lock_guard<std::mutex> lock(mutex);
             performanceLog << timestamp << "Working on alignment " << begin;
             performanceLog << " of " << alignmentCandidates.candidates.size() << endl;
         }
 
         for(size_t i=begin; i!=end; i++) {
-            const OrientedReadPair& candidate = alignmentCandidates.candidates[i];
+            const uint64_t candidateIndex = data.candidateOrder.empty() ? i : data.candidateOrder[i];
+            const OrientedReadPair& candidate = candidateQueue ?
+                streamedCandidates[i] : alignmentCandidates.candidates[candidateIndex];
             SHASTA_ASSERT(candidate.readIds[0] < candidate.readIds[1]);
 
+            // If both reads already have enough good alignments, skip this candidate.
+            if(readSaturationAlignmentCount > 0 and
+                data.readGoodAlignmentCount[candidate.readIds[0]] >= readSaturationAlignmentCount and
+                data.readGoodAlignmentCount[candidate.readIds[1]] >= readSaturationAlignmentCount) {
+                ++skippedCandidateCount;
+                continue;
+            }
+
             // Get the oriented read ids, with the first one on strand 0.
             orientedReadIds[0] = OrientedReadId(candidate.readIds[0], 0);
             orientedReadIds[1] = OrientedReadId(candidate.readIds[1], candidate.isSameStrand ? 0 : 1);
 
+            // If using the alignment cache, look for this pair of oriented reads.
+            uint64_t alignmentCacheKey = 0;
+            if(alignmentCache) {
+                alignmentCacheKey = AlignmentCache::computeKey(
+                    data.alignmentCacheOptionsHash,
+                    markerKmerIdsAccessor.get(orientedReadIds[0], kmerIdsBuffers[0]),
+                    markerKmerIdsAccessor.get(orientedReadIds[1], kmerIdsBuffers[1]));
+                bool isGood = false;
+                span<const char> cachedCompressedAlignment;
+                if(alignmentCache->find(alignmentCacheKey, isGood, alignmentInfo, cachedCompressedAlignment)) {
+                    ++alignmentCacheHitCount;
+                    if(isGood) {
+                        threadAlignmentData.push_back(AlignmentData(candidate, alignmentInfo));
+                        if(readSaturationAlignmentCount > 0) {
+                            __sync_fetch_and_add(&data.readGoodAlignmentCount[candidate.readIds[0]], 1);
+                            __sync_fetch_and_add(&data.readGoodAlignmentCount[candidate.readIds[1]], 1);
+                        }
+                        thisThreadCompressedAlignments.appendVector(
+                            cachedCompressedAlignment.begin(),
+                            cachedCompressedAlignment.end());
+                    }
+                    continue;
+                }
+            }
+
 
 
             // Compute the alignment.
+            const auto t0 = slowItems ? steady_clock::now() : steady_clock::time_point();
             try {
                 if(alignmentMethod == 0) {
 
@@ -409,10 +706,9 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
                 } else if(alignmentMethod == 4) {
                     alignOrientedReads4(orientedReadIds[0], orientedReadIds[1],
                         align4Options,
-                        byteAllocator,
+                        align4Workspace,
                         alignment, alignmentInfo,
                         false);
-                    SHASTA_ASSERT(byteAllocator.isEmpty());
                 } else {
                     SHASTA_ASSERT(0);
                 }
@@ -433,6 +729,20 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
                 continue;
             }
 
+            if(slowItems) {
+                slowItems->record(candidateIndex, seconds(steady_clock::now() - t0), {
+                    orientedReadIds[0].getReadId(),
+                    orientedReadIds[1].getReadId(),
+                    markers.size(orientedReadIds[0].getValue()),
+                    markers.size(orientedReadIds[1].getValue())});
+            }
+
+            // Record this result in the alignment cache.
+            // It is flagged as good below, if it satisfies our criteria.
+            if(alignmentCache) {
+                alignmentCache->add(threadId, alignmentCacheKey, alignmentInfo);
+            }
+
 
 
             // If the alignment has too few markers, skip it.
@@ -474,6 +784,10 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
             // If getting here, this is a good alignment.
             // cout << orientedReadIds[0] << " " << orientedReadIds[1] << " good." << endl;
             threadAlignmentData.push_back(AlignmentData(candidate, alignmentInfo));
+            if(readSaturationAlignmentCount > 0) {
+                __sync_fetch_and_add(&data.readGoodAlignmentCount[candidate.readIds[0]], 1);
+                __sync_fetch_and_add(&data.readGoodAlignmentCount[candidate.readIds[1]], 1);
+            }
 
             // Store the alignment in compressed form.
             shasta::compress(alignment, compressedAlignment);
@@ -481,17 +795,136 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
                 compressedAlignment.c_str(),
                 compressedAlignment.c_str() + compressedAlignment.size()
             );
+            if(alignmentCache) {
+                alignmentCache->setLastGood(threadId, compressedAlignment);
+            }
         }
     }
 
     if(alignmentMethod == 4) {
         std::lock_guard<std::mutex> lock(mutex);
-        cout << "Thread " << threadId << " byte allocator: " <<
-            byteAllocator.getMaxAllocatedByteCount() << "/" <<
-            2ULL * 1024 * 1024 * 1024 << endl;
+        cout << "Thread " << threadId << " Align4 workspace: " <<
+            align4Workspace.allocatedByteCount() << " bytes." << endl;
     }
 
     thisThreadCompressedAlignments.unreserve();
+
+    if(readSaturationAlignmentCount > 0) {
+        __sync_fetch_and_add(&data.skippedCandidateCount, skippedCandidateCount);
+    }
+    if(candidateQueue) {
+        __sync_fetch_and_add(&data.streamedCandidateCount, streamedCandidateCount);
+    }
+    if(alignmentCache) {
+        __sync_fetch_and_add(&data.alignmentCacheHitCount, alignmentCacheHitCount);
+    }
+}
+
+
+
+// Run an alignment worker for a computeAlignments running in another process.
+// The worker gets ranges of alignment candidates from the coordinator,
+// computes the alignments for each range, and writes the good ones
+// to a shard file that the coordinator later merges
+// (see AlignmentCoordinator.hpp).
+// This must run in the assembly directory.
+void Assembler::runAlignmentWorker(
+    const AlignOptions& alignOptions,
+    const string& coordinator,
+    size_t threadCount)
+{
+    // Connect to the coordinator and check that we use the same options.
+    // This waits until the coordinator reaches the alignments stage,
+    // so all the binary data we need are available.
+    array<char, 256> hostName;
+    if(::gethostname(hostName.data(), hostName.size()) != 0) {
+        hostName[0] = 0;
+    }
+    hostName.back() = 0;
+    const string workerName = string(hostName.data()) + "/" + to_string(::getpid());
+    cout << timestamp << "Connecting to alignment coordinator " << coordinator << endl;
+    AlignmentWorkerConnection connection(coordinator, workerName);
+    cout << timestamp << "Connected to alignment coordinator " << coordinator << endl;
+
+    // Access the binary data we need.
+    // The sorted markers are created by the coordinator.
+    accessKmerChecker();
+    accessMarkers();
+    accessAlignmentCandidates();
+    if(alignOptions.alignMethod == 4) {
+        sortedMarkers.accessExistingReadOnly(largeDataName("SortedMarkers"));
+    }
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    if(connection.optionsHash != computeAlignmentCacheOptionsHash(alignOptions, assemblerInfo->k)) {
+        throw runtime_error("The alignment options of this worker are not the same used by "
+            "the alignment coordinator. Use --config with the shasta.conf file "
+            "in the assembly directory.");
+    }
+    if(connection.candidateCount != alignmentCandidates.candidates.size()) {
+        throw runtime_error("The number of alignment candidates seen by this worker is not "
+            "the same seen by the alignment coordinator.");
+    }
+
+    // Store parameters so they are accessible to the threads.
+    auto& data = computeAlignmentsData;
+    data.alignOptions = &alignOptions;
+    data.candidateQueue = 0;
+    data.candidateOrder.clear();
+    data.readGoodAlignmentCount.clear();
+    data.skippedCandidateCount = 0;
+    data.alignmentCache.reset();
+    data.alignmentCoordinator.reset();
+    data.isAlignmentWorker = true;
+    data.align4KmerMask.reset();
+    if(alignOptions.alignMethod == 4 and alignOptions.align4MaxKmerFrequency > 0) {
+        data.align4KmerMask = computeHighFrequencyMarkerKmerMask(
+            alignOptions.align4MaxKmerFrequency, threadCount);
+    }
+
+    // Process one range at a time.
+    uint64_t rangeCount = 0;
+    uint64_t totalAlignmentCount = 0;
+    uint64_t begin, end;
+    while(connection.getRange(begin, end)) {
+        data.threadAlignmentData.clear();
+        data.threadAlignmentData.resize(threadCount);
+        data.threadCompressedAlignments.clear();
+        data.threadCompressedAlignments.resize(threadCount);
+        data.candidateRangeBegin = begin;
+        setupLoadBalancing(end - begin, 10);
+        runThreads(&Assembler::computeAlignmentsThreadFunction, threadCount);
+
+        AlignmentCoordinator::writeShard(
+            AlignmentCoordinator::shardFileName(begin, end),
+            data.threadAlignmentData,
+            data.threadCompressedAlignments);
+        uint64_t alignmentCount = 0;
+        for(size_t threadId=0; threadId<threadCount; threadId++) {
+            alignmentCount += data.threadAlignmentData[threadId].size();
+            data.threadCompressedAlignments[threadId]->remove();
+        }
+        connection.complete(begin, end, alignmentCount);
+
+        ++rangeCount;
+        totalAlignmentCount += alignmentCount;
+        cout << timestamp << "Found " << alignmentCount <<
+            " good alignments for alignment candidates " << begin << " to " << end << endl;
+    }
+
+    // Cleanup.
+    data.threadAlignmentData.clear();
+    data.threadCompressedAlignments.clear();
+    data.align4KmerMask.reset();
+    data.isAlignmentWorker = false;
+    data.candidateRangeBegin = 0;
+
+    cout << timestamp << "Found " << totalAlignmentCount << " good alignments in " <<
+        rangeCount << " ranges of alignment candidates." << endl;
 }
 
 
@@ -505,44 +938,90 @@ void Assembler::accessCompressedAlignments()
 
 
 // Compute alignmentTable from alignmentData.
-// This could be made multithreaded if it becomes a bottleneck.
-void Assembler::computeAlignmentTable()
+// Both passes of the alignment table construction and the
+// sorting of each section of the table are multithreaded.
+void Assembler::computeAlignmentTable(size_t threadCount)
 {
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     alignmentTable.createNew(largeDataName("AlignmentTable"), largeDataPageSize);
     alignmentTable.beginPass1(ReadId(2 * reads->readCount()));
-    for(const AlignmentData& ad: alignmentData) {
-        const auto& readIds = ad.readIds;
-        OrientedReadId orientedReadId0(readIds[0], 0);
-        OrientedReadId orientedReadId1(readIds[1], ad.isSameStrand ? 0 : 1);
-        alignmentTable.incrementCount(orientedReadId0.getValue());
-        alignmentTable.incrementCount(orientedReadId1.getValue());
-        orientedReadId0.flipStrand();
-        orientedReadId1.flipStrand();
-        alignmentTable.incrementCount(orientedReadId0.getValue());
-        alignmentTable.incrementCount(orientedReadId1.getValue());
-    }
+    setupLoadBalancing(alignmentData.size(), 100000);
+    runThreads(&Assembler::computeAlignmentTableThreadFunction1, threadCount);
     alignmentTable.beginPass2();
-    for(uint32_t i=0; i<alignmentData.size(); i++) {
-        const AlignmentData& ad = alignmentData[i];
-        const auto& readIds = ad.readIds;
-        OrientedReadId orientedReadId0(readIds[0], 0);
-        OrientedReadId orientedReadId1(readIds[1], ad.isSameStrand ? 0 : 1);
-        alignmentTable.store(orientedReadId0.getValue(), i);
-        alignmentTable.store(orientedReadId1.getValue(), i);
-        orientedReadId0.flipStrand();
-        orientedReadId1.flipStrand();
-        alignmentTable.store(orientedReadId0.getValue(), i);
-        alignmentTable.store(orientedReadId1.getValue(), i);
-    }
+    setupLoadBalancing(alignmentData.size(), 100000);
+    runThreads(&Assembler::computeAlignmentTableThreadFunction2, threadCount);
     alignmentTable.endPass2();
 
+    // Sort each section of the alignment table by OrientedReadId.
+    setupLoadBalancing(2 * uint64_t(reads->readCount()), 1000);
+    runThreads(&Assembler::computeAlignmentTableThreadFunction3, threadCount);
 
+    alignmentTable.unreserve();
 
-    // Sort each section of the alignment table by OrientedReadId.
+}
+
+
+
+// Pass 1 of the alignment table construction.
+void Assembler::computeAlignmentTableThreadFunction1(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const CompactAlignmentData& ad = alignmentData[i];
+            const auto& readIds = ad.readIds;
+            OrientedReadId orientedReadId0(readIds[0], 0);
+            OrientedReadId orientedReadId1(readIds[1], ad.isSameStrand ? 0 : 1);
+            alignmentTable.incrementCountMultithreaded(orientedReadId0.getValue());
+            alignmentTable.incrementCountMultithreaded(orientedReadId1.getValue());
+            orientedReadId0.flipStrand();
+            orientedReadId1.flipStrand();
+            alignmentTable.incrementCountMultithreaded(orientedReadId0.getValue());
+            alignmentTable.incrementCountMultithreaded(orientedReadId1.getValue());
+        }
+    }
+}
+
+
+
+// Pass 2 of the alignment table construction.
+void Assembler::computeAlignmentTableThreadFunction2(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t j=begin; j!=end; ++j) {
+            const uint32_t i = uint32_t(j);
+            const CompactAlignmentData& ad = alignmentData[i];
+            const auto& readIds = ad.readIds;
+            OrientedReadId orientedReadId0(readIds[0], 0);
+            OrientedReadId orientedReadId1(readIds[1], ad.isSameStrand ? 0 : 1);
+            alignmentTable.storeMultithreaded(orientedReadId0.getValue(), i);
+            alignmentTable.storeMultithreaded(orientedReadId1.getValue(), i);
+            orientedReadId0.flipStrand();
+            orientedReadId1.flipStrand();
+            alignmentTable.storeMultithreaded(orientedReadId0.getValue(), i);
+            alignmentTable.storeMultithreaded(orientedReadId1.getValue(), i);
+        }
+    }
+}
+
+
+
+// Sort each section of the alignment table by OrientedReadId.
+// Because of multithreading, the alignments in each section were
+// stored in no particular order, but the sort makes the result
+// deterministic, because the alignment index is used to break ties.
+void Assembler::computeAlignmentTableThreadFunction3(size_t threadId)
+{
     vector< pair<OrientedReadId, uint32_t> > v;
-    for(ReadId readId0=0; readId0<reads->readCount(); readId0++) {
-        for(Strand strand0=0; strand0<2; strand0++) {
-            const OrientedReadId orientedReadId0(readId0, strand0);
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t j=begin; j!=end; ++j) {
+            const OrientedReadId orientedReadId0 = OrientedReadId::fromValue(ReadId(j));
 
             // Access the section of the alignment table for this oriented read.
             const span<uint32_t> alignmentTableSection =
@@ -551,7 +1030,7 @@ void Assembler::computeAlignmentTable()
             // Store pairs(OrientedReadId, alignmentIndex).
             v.clear();
             for(uint32_t alignmentIndex: alignmentTableSection) {
-                const AlignmentData& alignment = alignmentData[alignmentIndex];
+                const CompactAlignmentData& alignment = alignmentData[alignmentIndex];
                 const OrientedReadId orientedReadId1 = alignment.getOther(orientedReadId0);
                 v.push_back(make_pair(orientedReadId1, alignmentIndex));
             }
@@ -565,9 +1044,6 @@ void Assembler::computeAlignmentTable()
             }
         }
     }
-
-    alignmentTable.unreserve();
-
 }
 
 
@@ -575,11 +1051,13 @@ void Assembler::computeAlignmentTable()
 void Assembler::accessAlignmentData()
 {
     alignmentData.accessExistingReadOnly(largeDataName("AlignmentData"));
+    alignmentInfos.accessExistingReadOnly(largeDataName("AlignmentInfos"));
     alignmentTable.accessExistingReadOnly(largeDataName("AlignmentTable"));
 }
 void Assembler::accessAlignmentDataReadWrite()
 {
     alignmentData.accessExistingReadWrite(largeDataName("AlignmentData"));
+    alignmentInfos.accessExistingReadWrite(largeDataName("AlignmentInfos"));
     alignmentTable.accessExistingReadWrite(largeDataName("AlignmentTable"));
 }
 
@@ -587,13 +1065,32 @@ void Assembler::accessAlignmentDataReadWrite()
 
 void Assembler::checkAlignmentDataAreOpen() const
 {
-    if(!alignmentData.isOpen || !alignmentTable.isOpen()) {
+    if(!alignmentData.isOpen || !alignmentInfos.isOpen || !alignmentTable.isOpen()) {
         throw runtime_error("Alignment data are not accessible.");
     }
 }
 
 
 
+void Assembler::storeAlignmentData(const AlignmentData& ad)
+{
+    alignmentData.push_back(CompactAlignmentData(ad));
+    alignmentInfos.push_back(ad.info);
+}
+
+
+
+// The isInReadGraph flag is stored in the CompactAlignmentData.
+AlignmentData Assembler::getAlignmentData(uint64_t alignmentId) const
+{
+    const CompactAlignmentData& compactAlignmentData = alignmentData[alignmentId];
+    AlignmentData ad(compactAlignmentData, alignmentInfos[alignmentId]);
+    ad.info.isInReadGraph = compactAlignmentData.isInReadGraph;
+    return ad;
+}
+
+
+
 // Find in the alignment table the alignments involving
 // a given oriented read, and return them with the correct
 // orientation (this may involve a swap and/or reverse complement
@@ -612,7 +1109,7 @@ vector< pair<OrientedReadId, shasta::AlignmentInfo> >
     // alignment table.
     const auto alignmentTable0 = alignmentTable[orientedReadId0Argument.getValue()];
     for(const auto i: alignmentTable0) {
-        const AlignmentData& ad = alignmentData[i];
+        const AlignmentData ad = getAlignmentData(i);
 
         // Get the oriented read ids that the AlignmentData refers to.
         OrientedReadId orientedReadId0(ad.readIds[0], 0);
@@ -701,6 +1198,30 @@ void Assembler::flagPalindromicReads(
 
 
 
+// Given the markers of an oriented read and of its reverse complement,
+// both sorted by KmerId, return the sum over KmerIds of the minimum
+// of the number of occurrences in the two.
+static size_t countCommonKmerIds(
+    const array<vector<MarkerWithOrdinal>, 2>& markersSortedByKmerId)
+{
+    const vector<MarkerWithOrdinal>& markers0 = markersSortedByKmerId[0];
+    const vector<MarkerWithOrdinal>& markers1 = markersSortedByKmerId[1];
+
+    size_t count = 0;
+    auto it0 = markers0.begin();
+    auto it1 = markers1.begin();
+    while(it0 != markers0.end() and it1 != markers1.end()) {
+        const KmerId kmerId0 = it0->kmerId;
+        const KmerId kmerId1 = it1->kmerId;
+        count += (kmerId0 == kmerId1);
+        it0 += (kmerId0 <= kmerId1);
+        it1 += (kmerId1 <= kmerId0);
+    }
+    return count;
+}
+
+
+
 void Assembler::flagPalindromicReadsThreadFunction(size_t threadId)
 {
 
@@ -734,13 +1255,28 @@ void Assembler::flagPalindromicReadsThreadFunction(size_t threadId)
                 getMarkersSortedByKmerId(OrientedReadId(readId, strand), markersSortedByKmerId[strand]);
             }
 
+            // Prefilter. For each KmerId, the alignment can contain at most
+            // as many markers as the minimum of its number of occurrences
+            // in the read and in its reverse complement.
+            // The sum of these minima, computed with a joint
+            // loop over the sorted markers, is an upper bound on the
+            // number of aligned markers and of aligned markers near the diagonal.
+            // If that bound is already too small, skip the alignment.
+            // This does not change the result, and most reads
+            // are rejected here without computing an alignment.
+            const size_t totalMarkerCount = markersSortedByKmerId[0].size();
+            const size_t commonMarkerCount = countCommonKmerIds(markersSortedByKmerId);
+            const double maxFraction = double(commonMarkerCount)/double(totalMarkerCount);
+            if(maxFraction < alignedFractionThreshold or maxFraction < nearDiagonalFractionThreshold) {
+                continue;
+            }
+
             // Compute a marker alignment of this read versus its reverse complement.
             alignOrientedReads(markersSortedByKmerId, maxSkip, maxDrift, maxMarkerFrequency, false,
                 graph, alignment, alignmentInfo);
 
             // If the alignment has too few markers, skip it.
             const size_t alignedMarkerCount = alignment.ordinals.size();
-            const size_t totalMarkerCount = markersSortedByKmerId[0].size();
             const double alignedFraction = double(alignedMarkerCount)/double(totalMarkerCount);
             if(alignedFraction < alignedFractionThreshold) {
                 continue;
@@ -1022,11 +1558,22 @@ bool Assembler::suppressAlignment(
     // don't suppress the alignment.
     // Check the channel first for efficiency,
     // so we can return faster in most cases.
-    const auto ch0 = reads->getMetaData(readId0, "ch");
+    // If the names are compressed (--Reads.compressNames),
+    // the parsed channel is available without decoding the meta data.
+    const uint32_t channel0 = reads->getReadChannel(readId0);
+    const uint32_t channel1 = reads->getReadChannel(readId1);
+    if(channel0 != invalid<uint32_t> and channel1 != invalid<uint32_t> and channel0 != channel1) {
+        return false;
+    }
+    const string metaData0 = reads->getReadMetaData(readId0);
+    const string metaData1 = reads->getReadMetaData(readId1);
+    const span<const char> metaDataSpan0(metaData0.data(), metaData0.size());
+    const span<const char> metaDataSpan1(metaData1.data(), metaData1.size());
+    const auto ch0 = Reads::getMetaDataField(metaDataSpan0, "ch");
     if(ch0.empty()) {
         return false;
     }
-    const auto ch1 = reads->getMetaData(readId1, "ch");
+    const auto ch1 = Reads::getMetaDataField(metaDataSpan1, "ch");
     if(ch1.empty()) {
         return false;
     }
@@ -1038,11 +1585,11 @@ bool Assembler::suppressAlignment(
 
     // If the sampleid meta data fields of the two reads are missing or different,
     // don't suppress the alignment.
-    const auto sampleid0 = reads->getMetaData(readId0, "sampleid");
+    const auto sampleid0 = Reads::getMetaDataField(metaDataSpan0, "sampleid");
     if(sampleid0.empty()) {
         return false;
     }
-    const auto sampleid1 = reads->getMetaData(readId1, "sampleid");
+    const auto sampleid1 = Reads::getMetaDataField(metaDataSpan1, "sampleid");
     if(sampleid1.empty()) {
         return false;
     }
@@ -1054,11 +1601,11 @@ bool Assembler::suppressAlignment(
 
     // If the runid meta data fields of the two reads are missing or different,
     // don't suppress the alignment.
-    const auto runid0 = reads->getMetaData(readId0, "runid");
+    const auto runid0 = Reads::getMetaDataField(metaDataSpan0, "runid");
     if(runid0.empty()) {
         return false;
     }
-    const auto runid1 = reads->getMetaData(readId1, "runid");
+    const auto runid1 = Reads::getMetaDataField(metaDataSpan1, "runid");
     if(runid1.empty()) {
         return false;
     }
@@ -1071,11 +1618,11 @@ bool Assembler::suppressAlignment(
 
     // If the read meta data fields of the two reads are missing,
     // don't suppress the alignment.
-    const auto read0 = reads->getMetaData(readId0, "read");
+    const auto read0 = Reads::getMetaDataField(metaDataSpan0, "read");
     if(read0.empty()) {
         return false;
     }
-    const auto read1 = reads->getMetaData(readId1, "read");
+    const auto read1 = Reads::getMetaDataField(metaDataSpan1, "read");
     if(read1.empty()) {
         return false;
     }
@@ -1101,76 +1648,180 @@ bool Assembler::suppressAlignment(
 
 // Remove all alignment candidates for which suppressAlignment
 // returns false.
+// The meta data fields used by suppressAlignment are parsed
+// once for each read, and the candidates are then
+// compacted in place, in parallel.
 void Assembler::suppressAlignmentCandidates(
     uint64_t delta,
     size_t threadCount)
 {
     performanceLog << timestamp << "Suppressing alignment candidates." << endl;
-
-    // Allocate memory for flags to keep track of which alignments
-    // should be suppressed.
-    suppressAlignmentCandidatesData.suppress.createNew(
-        largeDataName("tmp-suppressAlignmentCandidates"), largeDataPageSize);
+    SuppressAlignmentCandidatesData& data = suppressAlignmentCandidatesData;
     const uint64_t candidateCount = alignmentCandidates.candidates.size();
-    suppressAlignmentCandidatesData.suppress.resize(candidateCount);
-
-    // Figure out which candidates should be suppressed.
-    suppressAlignmentCandidatesData.delta = delta;
-    const uint64_t batchSize = 10000;
-    setupLoadBalancing(alignmentCandidates.candidates.size(), batchSize);
-    runThreads(&Assembler::suppressAlignmentCandidatesThreadFunction, threadCount);
-
-    ofstream csv("SuppressedAlignmentCandidates.csv");
-    csv << "ReadId0,ReadId1,SameStrand,Name0,Name1,MetaData0,MetaData1" << endl;
-
-    // Suppress the alignment candidates we flagged.
+    data.delta = delta;
+    data.hasFrequencies =
+        alignmentCandidates.frequencies.isOpenWithWriteAccess and
+        (alignmentCandidates.frequencies.size() == candidateCount);
+
+    // Parse the meta data of each read.
+    data.readInfos.clear();
+    data.readInfos.resize(reads->readCount());
+    setupLoadBalancing(reads->readCount(), 10000);
+    runThreads(&Assembler::suppressAlignmentCandidatesThreadFunction1, threadCount);
+
+    // Compact each batch of candidates in place.
+    data.batchSize = 10000;
+    const uint64_t batchCount = (candidateCount + data.batchSize - 1) / data.batchSize;
+    data.keptCount.clear();
+    data.keptCount.resize(batchCount, 0);
+    data.suppressed.clear();
+    data.suppressed.resize(batchCount);
+    setupLoadBalancing(candidateCount, data.batchSize);
+    runThreads(&Assembler::suppressAlignmentCandidatesThreadFunction2, threadCount);
+
+    // Move the candidates kept in each batch to their final position.
+    // The destination always precedes the source, so this is safe.
     cout << "Number of alignment candidates before suppression is " << candidateCount << endl;
     uint64_t j = 0;
     uint64_t suppressCount = 0;
-    for(uint64_t i=0; i<candidateCount; i++) {
-        if(suppressAlignmentCandidatesData.suppress[i]) {
-            ++suppressCount;
-            const ReadId readId0 = alignmentCandidates.candidates[i].readIds[0];
-            const ReadId readId1 = alignmentCandidates.candidates[i].readIds[1];
-            csv << readId0 << "," << readId1 << ","
-                << (alignmentCandidates.candidates[i].isSameStrand ? "Yes" : "No") << ","
-                << reads->getReadName(readId0) << "," << reads->getReadName(readId1) << ","
-                << reads->getReadMetaData(readId0) << "," << reads->getReadMetaData(readId1) << endl;
-        } else {
-            alignmentCandidates.candidates[j++] =
-                alignmentCandidates.candidates[i];
+    for(uint64_t batchId=0; batchId<batchCount; batchId++) {
+        const uint64_t begin = batchId * data.batchSize;
+        const uint64_t kept = data.keptCount[batchId];
+        if(j != begin) {
+            std::copy(alignmentCandidates.candidates.begin() + begin,
+                alignmentCandidates.candidates.begin() + begin + kept,
+                alignmentCandidates.candidates.begin() + j);
+            if(data.hasFrequencies) {
+                std::copy(alignmentCandidates.frequencies.begin() + begin,
+                    alignmentCandidates.frequencies.begin() + begin + kept,
+                    alignmentCandidates.frequencies.begin() + j);
+            }
         }
+        j += kept;
+        suppressCount += data.suppressed[batchId].size();
     }
     SHASTA_ASSERT(j + suppressCount == candidateCount);
     alignmentCandidates.candidates.resize(j);
+    if(data.hasFrequencies) {
+        alignmentCandidates.frequencies.resize(j);
+    }
     cout << "Suppressed " << suppressCount << " alignment candidates." << endl;
     cout << "Number of alignment candidates after suppression is " << j << endl;
 
+    // Write the suppressed candidates.
+    ofstream csv("SuppressedAlignmentCandidates.csv");
+    csv << "ReadId0,ReadId1,SameStrand,Name0,Name1,MetaData0,MetaData1" << endl;
+    for(const vector<OrientedReadPair>& suppressed: data.suppressed) {
+        for(const OrientedReadPair& p: suppressed) {
+            const ReadId readId0 = p.readIds[0];
+            const ReadId readId1 = p.readIds[1];
+            csv << readId0 << "," << readId1 << ","
+                << (p.isSameStrand ? "Yes" : "No") << ","
+                << reads->getReadName(readId0) << "," << reads->getReadName(readId1) << ","
+                << reads->getReadMetaData(readId0) << "," << reads->getReadMetaData(readId1) << endl;
+        }
+    }
 
     // Clean up.
-    suppressAlignmentCandidatesData.suppress.remove();
+    data.readInfos.clear();
+    data.readInfos.shrink_to_fit();
+    data.keptCount.clear();
+    data.keptCount.shrink_to_fit();
+    data.suppressed.clear();
+    data.suppressed.shrink_to_fit();
 
     performanceLog << timestamp << "Done suppressing alignment candidates." << endl;
 }
 
 
 
-void Assembler::suppressAlignmentCandidatesThreadFunction(size_t threadId)
+// Parse the meta data used by suppressAlignment for each read.
+void Assembler::suppressAlignmentCandidatesThreadFunction1(size_t threadId)
+{
+    SuppressAlignmentCandidatesData& data = suppressAlignmentCandidatesData;
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over reads in this batch.
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            SuppressAlignmentCandidatesData::ReadInfo& readInfo = data.readInfos[readId];
+
+            const string metaData = reads->getReadMetaData(readId);
+            const span<const char> metaDataSpan(metaData.data(), metaData.size());
+            const auto ch = Reads::getMetaDataField(metaDataSpan, "ch");
+            const auto sampleid = Reads::getMetaDataField(metaDataSpan, "sampleid");
+            const auto runid = Reads::getMetaDataField(metaDataSpan, "runid");
+            const auto read = Reads::getMetaDataField(metaDataSpan, "read");
+            if(ch.empty() or sampleid.empty() or runid.empty() or read.empty()) {
+                continue;
+            }
+            readInfo.hasMetaData = true;
+
+            // Hash ch, sampleid, and runid, including their lengths
+            // so different combinations don't give the same input.
+            uint64_t hash = 0;
+            for(const auto& field: {ch, sampleid, runid}) {
+                hash = MurmurHash64A(field.data(), int(field.size()), hash + field.size());
+            }
+            readInfo.hash = hash;
+
+            readInfo.readIsNumeric = std::all_of(read.begin(), read.end(),
+                [](char c) {return std::isdigit(c);});
+            if(readInfo.readIsNumeric) {
+                readInfo.read = int64_t(atoul(read));
+            }
+        }
+    }
+}
+
+
+
+// Compact each batch of alignment candidates in place.
+void Assembler::suppressAlignmentCandidatesThreadFunction2(size_t threadId)
 {
-    const uint64_t delta = suppressAlignmentCandidatesData.delta;
+    SuppressAlignmentCandidatesData& data = suppressAlignmentCandidatesData;
+    const uint64_t delta = data.delta;
 
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
+        const uint64_t batchId = begin / data.batchSize;
+        vector<OrientedReadPair>& suppressed = data.suppressed[batchId];
 
         // Loop over candidate alignments in this batch.
+        uint64_t j = begin;
         for(uint64_t i=begin; i!=end; i++) {
-            const OrientedReadPair& p = alignmentCandidates.candidates[i];
-            // cout << "Checking " << p.readIds[0] << " " << p.readIds[1] <<  " " << int(p.isSameStrand) << endl;
-            suppressAlignmentCandidatesData.suppress[i] =
-                suppressAlignment(p.readIds[0], p.readIds[1], delta);
-        }
+            const OrientedReadPair p = alignmentCandidates.candidates[i];
+            const auto& readInfo0 = data.readInfos[p.readIds[0]];
+            const auto& readInfo1 = data.readInfos[p.readIds[1]];
+
+            // Use the parsed meta data to quickly find the candidates
+            // that are not suppressed. The others are checked
+            // using suppressAlignment, which compares the meta data fields
+            // and is therefore not affected by hash collisions.
+            bool suppress = false;
+            if(readInfo0.hasMetaData and readInfo1.hasMetaData and
+                readInfo0.hash == readInfo1.hash) {
+                if(readInfo0.readIsNumeric and readInfo1.readIsNumeric and
+                    abs(readInfo0.read - readInfo1.read) >= int64_t(delta)) {
+                    suppress = false;
+                } else {
+                    suppress = suppressAlignment(p.readIds[0], p.readIds[1], delta);
+                }
+            }
 
+            if(suppress) {
+                suppressed.push_back(p);
+            } else {
+                if(data.hasFrequencies) {
+                    alignmentCandidates.frequencies[j] = alignmentCandidates.frequencies[i];
+                }
+                alignmentCandidates.candidates[j++] = p;
+            }
+        }
+        data.keptCount[batchId] = j - begin;
     }
 }
 
@@ -119,6 +119,40 @@ void Assembler::alignOrientedReads3(
         return;
     }
 
+    // If the downsampled sequences have no KmerIds in common,
+    // the downsampled alignment cannot contain any matches
+    // and there is no band to use for the full alignment.
+    // Check for this before doing the unbanded alignment, which is expensive.
+    {
+        array<vector<KmerId>, 2> sortedKmerIds;
+        for(uint64_t i=0; i<2; i++) {
+            sortedKmerIds[i].reserve(downsampledMarkers[i].size());
+            for(const auto& p: downsampledMarkers[i]) {
+                sortedKmerIds[i].push_back(p.second);
+            }
+            std::sort(sortedKmerIds[i].begin(), sortedKmerIds[i].end());
+        }
+        bool haveCommonKmerId = false;
+        auto it0 = sortedKmerIds[0].begin();
+        auto it1 = sortedKmerIds[1].begin();
+        while(it0 != sortedKmerIds[0].end() and it1 != sortedKmerIds[1].end()) {
+            if(*it0 < *it1) {
+                ++it0;
+            } else if(*it1 < *it0) {
+                ++it1;
+            } else {
+                haveCommonKmerId = true;
+                break;
+            }
+        }
+        if(not haveCommonKmerId) {
+            alignment.clear();
+            alignmentInfo.create(
+                alignment, uint32_t(allMarkerKmerIds[0].size()), uint32_t(allMarkerKmerIds[1].size()));
+            return;
+        }
+    }
+
     // Use SeqAn to compute an alignment of the downsampled markers, free at both ends.
     // https://seqan.readthedocs.io/en/master/Tutorial/Algorithms/Alignment/PairwiseSequenceAlignment.html
 
@@ -233,6 +267,14 @@ void Assembler::alignOrientedReads3(
             ++i1;
         }
     }
+    // If the downsampled alignment has no matches,
+    // there is no band. Return an empty alignment.
+    if(offsetMin > offsetMax) {
+        alignment.clear();
+        alignmentInfo.create(
+            alignment, uint32_t(allMarkerKmerIds[0].size()), uint32_t(allMarkerKmerIds[1].size()));
+        return;
+    }
     const int32_t bandMin = offsetMin - bandExtend;
     const int32_t bandMax = offsetMax + bandExtend;
     // Note that the above band could end up outside the alignment matrix.
@@ -257,6 +299,7 @@ void Assembler::alignOrientedReads3(
     // Now, do a alignment using this band and all markers.
     array<TSequence, 2> sequences;
     for(uint64_t i=0; i<2; i++) {
+        reserve(sequences[i], allMarkerKmerIds[i].size());
         for(uint32_t ordinal=0; ordinal<uint32_t(allMarkerKmerIds[i].size()); ordinal++) {
             const KmerId kmerId = allMarkerKmerIds[i][ordinal];
             appendValue(sequences[i], kmerId + 100);
@@ -1,8 +1,11 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "Align4.hpp"
-#include "MemoryMappedAllocator.hpp"
+#include "KmerMask.hpp"
+#include "MarkerKmerIds.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
+#include "radixSort.hpp"
 using namespace shasta;
 
 // Standard library.
@@ -43,9 +46,8 @@ void Assembler::alignOrientedReads4(
     options.mismatchScore = mismatchScore;
     options.gapScore = gapScore;
 
-    // Set up the memory allocator.
-    MemoryMapped::ByteAllocator byteAllocator(
-        largeDataName("tmp-ByteAllocator"), largeDataPageSize, 2ULL * 1024 * 1024 * 1024);
+    // Data structures used by Align4.
+    Align4::Workspace workspace;
 
 
     // Compute the alignment.
@@ -55,7 +57,7 @@ void Assembler::alignOrientedReads4(
     alignOrientedReads4(
         OrientedReadId(readId0, strand0),
         OrientedReadId(readId1, strand1),
-        options, byteAllocator, alignment, alignmentInfo, debug);
+        options, workspace, alignment, alignmentInfo, debug);
     cout << "The alignment has " << alignmentInfo.markerCount << " markers." << endl;
 
 }
@@ -99,16 +101,15 @@ void Assembler::alignOrientedReads4(
     options.mismatchScore = mismatchScore;
     options.gapScore = gapScore;
 
-    // Set up the memory allocator.
-    MemoryMapped::ByteAllocator byteAllocator(
-        largeDataName("tmp-ByteAllocator"), largeDataPageSize, 2ULL * 1024 * 1024 * 1024);
+    // Data structures used by Align4.
+    Align4::Workspace workspace;
 
 
     // Compute the alignment.
     const bool debug = false;
     alignOrientedReads4(
         orientedReadId0, orientedReadId1,
-        options, byteAllocator, alignment, alignmentInfo, debug);
+        options, workspace, alignment, alignmentInfo, debug);
 
 }
 
@@ -119,7 +120,7 @@ void Assembler::alignOrientedReads4(
     OrientedReadId orientedReadId0,
     OrientedReadId orientedReadId1,
     const Align4::Options& options,
-    MemoryMapped::ByteAllocator& byteAllocator,
+    Align4::Workspace& workspace,
     Alignment& alignment,
     AlignmentInfo& alignmentInfo,
     bool debug)
@@ -165,6 +166,7 @@ void Assembler::alignOrientedReads4(
             cout << "Stored sorted markers are not available - computing them." << endl;
         }
 
+        vector< pair<KmerId, uint32_t> > work;
         for(uint64_t i=0; i<2; i++) {
 
             // Unsorted markers for this oriented read.
@@ -181,7 +183,9 @@ void Assembler::alignOrientedReads4(
             }
 
             // Sort them.
-            sort(sm.begin(), sm.end(), OrderPairsByFirstOnly<KmerId, uint32_t>());
+            radixSort(sm.data(), sm.data() + n, 2 * assemblerInfo->k,
+                [](const pair<KmerId, uint32_t>& p) {return uint64_t(p.first);},
+                work);
 
             // Make the span point to the data in the vector.
             orientedReadSortedMarkersSpans[i] = sm;
@@ -192,7 +196,7 @@ void Assembler::alignOrientedReads4(
 
     // Compute the alignment.
     Align4::align(orientedReadKmerIds, orientedReadSortedMarkersSpans,
-        options, byteAllocator, alignment, alignmentInfo, debug);
+        options, workspace, alignment, alignmentInfo, debug);
 }
 
 
@@ -203,8 +207,9 @@ void Assembler::computeSortedMarkers(uint64_t threadCount)
     // Check that we have what we need.
     checkMarkersAreOpen();
     const uint64_t orientedReadCount = markers.size();
-    SHASTA_ASSERT(markerKmerIds.isOpen());
-    SHASTA_ASSERT(markerKmerIds.size() == orientedReadCount);
+    if(markerKmerIds.isOpen()) {
+        SHASTA_ASSERT(markerKmerIds.size() == orientedReadCount);
+    }
 
     // Adjust the numbers of threads, if necessary.
     if(threadCount == 0) {
@@ -225,6 +230,16 @@ void Assembler::computeSortedMarkers(uint64_t threadCount)
 
 void Assembler::computeSortedMarkersThreadFunction(size_t threadId)
 {
+    const uint64_t keyBitCount = 2 * assemblerInfo->k;
+
+    // Work area for radixSort, reused for all oriented reads
+    // processed by this thread.
+    vector< pair<KmerId, uint32_t> > work;
+
+    // If the marker KmerIds were not stored, recompute them as needed.
+    const MarkerKmerIds markerKmerIdsAccessor(assemblerInfo->k, getReads(), markers, markerKmerIds);
+    vector<KmerId> kmerIdsBuffer;
+
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -233,7 +248,7 @@ void Assembler::computeSortedMarkersThreadFunction(size_t threadId)
         for(uint64_t i=begin; i!=end; i++) {
 
             // Access the marker KmerIs and sorted markers for this oriented read.
-            const auto kmerIds = markerKmerIds[i];
+            const auto kmerIds = markerKmerIdsAccessor.get(OrientedReadId::fromValue(ReadId(i)), kmerIdsBuffer);
             const uint64_t markerCount = kmerIds.size();
             const span< pair<KmerId, uint32_t> > sm = sortedMarkers[i];
             SHASTA_ASSERT(sm.size() == markerCount);
@@ -245,11 +260,116 @@ void Assembler::computeSortedMarkersThreadFunction(size_t threadId)
                 p.second = ordinal;
             }
 
-            // Sort them by KmerId.
-            sort(sm.begin(), sm.end(), OrderPairsByFirstOnly<KmerId, uint32_t>());
+            // Sort them by KmerId. The sort is stable, so markers
+            // with the same KmerId remain in order of increasing ordinal.
+            radixSort(sm.data(), sm.data() + markerCount, keyBitCount,
+                [](const pair<KmerId, uint32_t>& p) {return uint64_t(p.first);},
+                work);
+        }
+    }
+
+}
+
+
+
+// Create a KmerMask containing the marker KmerIds that appear
+// more than maxFrequency times in all oriented reads.
+// For each oriented read, the sorted markers give the number of times
+// each KmerId appears in that oriented read. These per-read counts
+// are summed using a hash of the KmerId to split the work:
+// - Each pass handles one of passCount partitions of the KmerIds.
+//   This limits memory usage to about 1/passCount of what
+//   would be needed to process all KmerIds at once.
+// - Within each pass, the per-read counts are further split
+//   into bucketCount buckets, which are then
+//   sorted and summed in parallel.
+shared_ptr<KmerMask> Assembler::computeHighFrequencyMarkerKmerMask(
+    uint64_t maxFrequency,
+    size_t threadCount) const
+{
+    SHASTA_ASSERT(sortedMarkers.isOpen());
+    const uint64_t orientedReadCount = sortedMarkers.size();
+
+    const uint64_t passBitCount = 4;
+    const uint64_t bucketBitCount = 6;
+    const uint64_t passCount = 1ULL << passBitCount;
+    const uint64_t bucketCount = 1ULL << bucketBitCount;
+    auto getHash = [](KmerId kmerId)
+    {
+        return uint64_t(kmerId) * 0x9E3779B97F4A7C15ULL;
+    };
+
+    const uint64_t readBatchSize = 100;
+    threadCount = parallelForDetail::getThreadCount(orientedReadCount, readBatchSize, threadCount);
+
+    // The KmerIds with high frequency found in each bucket.
+    vector< vector<KmerId> > bucketKmerIds(bucketCount);
+    vector<KmerId> highFrequencyKmerIds;
+
+    // Per-read counts for each thread and bucket.
+    using Count = pair<KmerId, uint32_t>;
+    vector< vector< vector<Count> > > threadCounts(threadCount, vector< vector<Count> >(bucketCount));
+
+    for(uint64_t pass=0; pass<passCount; pass++) {
+
+        // Gather per-read counts for the KmerIds in this pass.
+        parallelForWithThreadId(orientedReadCount, readBatchSize, threadCount,
+            [&](size_t threadId, uint64_t begin, uint64_t end)
+            {
+                vector< vector<Count> >& counts = threadCounts[threadId];
+                for(uint64_t i=begin; i!=end; ++i) {
+                    const auto sm = sortedMarkers[i];
+                    for(uint64_t j=0; j<sm.size(); ) {
+                        const KmerId kmerId = sm[j].first;
+                        uint64_t k = j + 1;
+                        while(k<sm.size() and sm[k].first == kmerId) {
+                            ++k;
+                        }
+                        const uint64_t h = getHash(kmerId);
+                        if((h >> (64 - passBitCount)) == pass) {
+                            const uint64_t bucket = (h >> (64 - passBitCount - bucketBitCount)) & (bucketCount - 1);
+                            counts[bucket].push_back({kmerId, uint32_t(k - j)});
+                        }
+                        j = k;
+                    }
+                }
+            });
+
+        // Sum the counts in each bucket.
+        parallelFor(bucketCount, 1, threadCount,
+            [&](uint64_t begin, uint64_t end)
+            {
+                vector<Count> counts;
+                for(uint64_t bucket=begin; bucket!=end; ++bucket) {
+                    counts.clear();
+                    for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+                        vector<Count>& v = threadCounts[threadId][bucket];
+                        counts.insert(counts.end(), v.begin(), v.end());
+                        v.clear();
+                    }
+                    sort(counts.begin(), counts.end());
+                    for(uint64_t j=0; j<counts.size(); ) {
+                        const KmerId kmerId = counts[j].first;
+                        uint64_t frequency = 0;
+                        uint64_t k = j;
+                        for(; k<counts.size() and counts[k].first == kmerId; ++k) {
+                            frequency += counts[k].second;
+                        }
+                        if(frequency > maxFrequency) {
+                            bucketKmerIds[bucket].push_back(kmerId);
+                        }
+                        j = k;
+                    }
+                }
+            });
+
+        for(vector<KmerId>& v: bucketKmerIds) {
+            highFrequencyKmerIds.insert(highFrequencyKmerIds.end(), v.begin(), v.end());
+            v.clear();
         }
     }
 
+    return make_shared<KmerMask>(std::move(highFrequencyKmerIds));
 }
 
 
@@ -0,0 +1,135 @@
+// Shasta.
+#include "Assembler.hpp"
+#include "compressAlignment.hpp"
+#include "Reads.hpp"
+using namespace shasta;
+
+
+
+// Get the pairs of aligned markers for a pair of read graph edges.
+// The first edge of the pair is edgeId and the second edge
+// is its reverse complement.
+// The pairs of aligned markers of the alignment are appended to alignedMarkerPairs,
+// followed by the corresponding reverse complemented pairs.
+// Returns false, and does not append anything, if the edge pair
+// should not be used to create marker graph vertices.
+bool Assembler::getReadGraphEdgePairAlignedMarkers(
+    uint64_t edgeId,
+    Alignment& alignment,
+    vector<AlignedMarkerPair>& alignedMarkerPairs)
+{
+    // Get the oriented read ids we want to align.
+    const ReadGraphEdge& readGraphEdge = readGraph.edges[edgeId];
+    const uint64_t alignmentId = readGraphEdge.alignmentId;
+
+    // Check that the next edge is the reverse complement of
+    // this edge.
+    {
+        const ReadGraphEdge& readGraphNextEdge = readGraph.edges[edgeId + 1];
+        array<OrientedReadId, 2> nextEdgeOrientedReadIds = readGraphNextEdge.orientedReadIds;
+        nextEdgeOrientedReadIds[0].flipStrand();
+        nextEdgeOrientedReadIds[1].flipStrand();
+        SHASTA_ASSERT(nextEdgeOrientedReadIds == readGraphEdge.orientedReadIds);
+    }
+
+    // If the edge is flagged as crossing strands, skip it.
+    if(readGraphEdge.crossesStrands) {
+        return false;
+    }
+
+    // If the edge has an alignment flagged as inconsistent, skip it.
+    if(readGraphEdge.hasInconsistentAlignment) {
+        return false;
+    }
+
+    const array<OrientedReadId, 2> orientedReadIds = readGraphEdge.orientedReadIds;
+    SHASTA_ASSERT(orientedReadIds[0] < orientedReadIds[1]);
+
+    // If either of the reads is flagged chimeric, skip it.
+    if( reads->getFlags(orientedReadIds[0].getReadId()).isChimeric ||
+        reads->getFlags(orientedReadIds[1].getReadId()).isChimeric) {
+        return false;
+    }
+
+    // Sanity check.
+    SHASTA_ASSERT(alignmentData[alignmentId].isInReadGraph);
+
+    // Decompress this alignment.
+    span<const char> compressedAlignment = compressedAlignments[alignmentId];
+    shasta::decompress(compressedAlignment, alignment);
+
+    // Store the pairs of aligned markers.
+    const uint64_t begin = alignedMarkerPairs.size();
+    for(const auto& p: alignment.ordinals) {
+        alignedMarkerPairs.push_back(make_pair(
+            getMarkerId(orientedReadIds[0], p[0]),
+            getMarkerId(orientedReadIds[1], p[1])));
+    }
+
+    // Also store the reverse complemented pairs.
+    // This guarantees that the marker graph remains invariant
+    // under strand swap.
+    const uint64_t end = alignedMarkerPairs.size();
+    for(uint64_t i=begin; i!=end; i++) {
+        const AlignedMarkerPair p = alignedMarkerPairs[i];
+        alignedMarkerPairs.push_back(make_pair(
+            findReverseComplement(p.first),
+            findReverseComplement(p.second)));
+    }
+
+    return true;
+}
+
+
+
+// Loop over all read graph edges that are used to create marker graph vertices,
+// decompress each alignment once, and pass the resulting pairs
+// of aligned markers to all of the given consumers.
+void Assembler::streamAlignedMarkerPairs(
+    const vector<AlignedMarkerPairConsumer*>& consumers,
+    size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Each alignment used in the read graph generates a pair of
+    // consecutively numbered edges in the read graph
+    // which are the reverse complement of each other.
+    SHASTA_ASSERT((readGraph.edges.size() % 2) == 0);
+
+    alignedMarkerPairConsumers = consumers;
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(readGraph.edges.size(), batchSize);
+    runThreads(&Assembler::streamAlignedMarkerPairsThreadFunction, threadCount);
+    alignedMarkerPairConsumers.clear();
+}
+
+
+
+void Assembler::streamAlignedMarkerPairsThreadFunction(size_t threadId)
+{
+    Alignment alignment;
+    vector<AlignedMarkerPair> alignedMarkerPairs;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // We process read graph edges in pairs.
+        // In each pair, the second edge is the reverse complement of the first.
+        SHASTA_ASSERT((begin%2) == 0);
+        SHASTA_ASSERT((end%2) == 0);
+
+        // Gather the pairs of aligned markers for this batch.
+        alignedMarkerPairs.clear();
+        for(uint64_t edgeId=begin; edgeId!=end; edgeId+=2) {
+            getReadGraphEdgePairAlignedMarkers(edgeId, alignment, alignedMarkerPairs);
+        }
+
+        // Pass them to all the consumers.
+        for(AlignedMarkerPairConsumer* consumer: alignedMarkerPairConsumers) {
+            consumer->consume(threadId, alignedMarkerPairs);
+        }
+    }
+}
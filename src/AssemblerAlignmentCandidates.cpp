@@ -4,8 +4,11 @@
 #include "Reads.hpp"
 using namespace shasta;
 
+#include <atomic>
 #include "chrono.hpp"
+#include <functional>
 #include <queue>
+#include <thread>
 
 
 
@@ -73,7 +76,7 @@ bool Assembler::createLocalReferenceGraph(
 
             // Search the AlignmentTable to see if this pair exists
             for (const ReadId alignmentIndex: alignmentTable[orientedReadId0.getValue()]) {
-                const AlignmentData& ad = alignmentData[alignmentIndex];
+                const CompactAlignmentData& ad = alignmentData[alignmentIndex];
 
                 // Check if the pair matches the current candidate pair of interest
                 if (ad.getOther(orientedReadId0) == orientedReadId1) {
@@ -261,7 +264,7 @@ bool Assembler::createLocalAlignmentCandidateGraph(
 
             // Search the AlignmentTable to see if this pair exists
             for(const ReadId alignmentIndex: alignmentTable[orientedReadId0.getValue()]) {
-                const AlignmentData& ad = alignmentData[alignmentIndex];
+                const CompactAlignmentData& ad = alignmentData[alignmentIndex];
 
                 // Check if the pair matches the current candidate pair of interest
                  if (ad.getOther(orientedReadId0) == orientedReadId1){
@@ -376,50 +379,98 @@ bool Assembler::createLocalAlignmentCandidateGraph(
 
 
 
-void Assembler::computeCandidateTable()
+void Assembler::computeCandidateTable(size_t threadCount)
 {
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     alignmentCandidates.computeCandidateTable(reads->readCount(),
                                               largeDataName("CandidateTable"),
-                                              largeDataPageSize);
+                                              largeDataPageSize,
+                                              threadCount);
 }
 
 // Compute candidateTable from alignmentCandidates.
-// This could be made multithreaded if it becomes a bottleneck.
-void AlignmentCandidates::computeCandidateTable(ReadId readCount, string largeDataName, size_t largeDataPageSize)
+// Both passes of the candidate table construction and the
+// sorting of each section of the table are multithreaded.
+void AlignmentCandidates::computeCandidateTable(
+    ReadId readCount,
+    string largeDataName,
+    size_t largeDataPageSize,
+    size_t threadCount)
 {
+    SHASTA_ASSERT(threadCount > 0);
+
+    // Run f(begin, end) on batches of [0, n) using threadCount threads.
+    auto runThreads = [threadCount](uint64_t n, uint64_t batchSize,
+        const std::function<void(uint64_t, uint64_t)>& f)
+    {
+        std::atomic<uint64_t> nextBegin(0);
+        auto threadFunction = [&]()
+        {
+            while(true) {
+                const uint64_t begin = nextBegin.fetch_add(batchSize);
+                if(begin >= n) {
+                    return;
+                }
+                f(begin, min(begin + batchSize, n));
+            }
+        };
+        vector<std::thread> threads;
+        for(size_t threadId=0; threadId<threadCount; threadId++) {
+            threads.push_back(std::thread(threadFunction));
+        }
+        for(std::thread& thread: threads) {
+            thread.join();
+        }
+    };
+
     candidateTable.createNew(largeDataName, largeDataPageSize);
     candidateTable.beginPass1(ReadId(2 * readCount));
-    for(const OrientedReadPair& pair: candidates) {
-        OrientedReadId orientedReadId0(pair.readIds[0], 0);
-        OrientedReadId orientedReadId1(pair.readIds[1], pair.isSameStrand ? 0 : 1);
-        candidateTable.incrementCount(orientedReadId0.getValue());
-        candidateTable.incrementCount(orientedReadId1.getValue());
-        orientedReadId0.flipStrand();
-        orientedReadId1.flipStrand();
-        candidateTable.incrementCount(orientedReadId0.getValue());
-        candidateTable.incrementCount(orientedReadId1.getValue());
-    }
+    runThreads(candidates.size(), 100000, [this](uint64_t begin, uint64_t end)
+    {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const OrientedReadPair& pair = candidates[i];
+            OrientedReadId orientedReadId0(pair.readIds[0], 0);
+            OrientedReadId orientedReadId1(pair.readIds[1], pair.isSameStrand ? 0 : 1);
+            candidateTable.incrementCountMultithreaded(orientedReadId0.getValue());
+            candidateTable.incrementCountMultithreaded(orientedReadId1.getValue());
+            orientedReadId0.flipStrand();
+            orientedReadId1.flipStrand();
+            candidateTable.incrementCountMultithreaded(orientedReadId0.getValue());
+            candidateTable.incrementCountMultithreaded(orientedReadId1.getValue());
+        }
+    });
     candidateTable.beginPass2();
-    for(uint64_t i=0; i<candidates.size(); i++) {
-        const OrientedReadPair& pair = candidates[i];
-        OrientedReadId orientedReadId0(pair.readIds[0], 0);
-        OrientedReadId orientedReadId1(pair.readIds[1], pair.isSameStrand ? 0 : 1);
-        candidateTable.store(orientedReadId0.getValue(), i);
-        candidateTable.store(orientedReadId1.getValue(), i);
-        orientedReadId0.flipStrand();
-        orientedReadId1.flipStrand();
-        candidateTable.store(orientedReadId0.getValue(), i);
-        candidateTable.store(orientedReadId1.getValue(), i);
-    }
+    runThreads(candidates.size(), 100000, [this](uint64_t begin, uint64_t end)
+    {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const OrientedReadPair& pair = candidates[i];
+            OrientedReadId orientedReadId0(pair.readIds[0], 0);
+            OrientedReadId orientedReadId1(pair.readIds[1], pair.isSameStrand ? 0 : 1);
+            candidateTable.storeMultithreaded(orientedReadId0.getValue(), i);
+            candidateTable.storeMultithreaded(orientedReadId1.getValue(), i);
+            orientedReadId0.flipStrand();
+            orientedReadId1.flipStrand();
+            candidateTable.storeMultithreaded(orientedReadId0.getValue(), i);
+            candidateTable.storeMultithreaded(orientedReadId1.getValue(), i);
+        }
+    });
     candidateTable.endPass2();
 
 
 
     // Sort each section of the candidate table by OrientedReadId.
-    vector< pair<OrientedReadId, uint32_t> > v;
-    for(ReadId readId0=0; readId0<readCount; readId0++) {
-        for(Strand strand0=0; strand0<2; strand0++) {
-            const OrientedReadId orientedReadId0(readId0, strand0);
+    // Because of multithreading, the candidates in each section were
+    // stored in no particular order, but the sort makes the result
+    // deterministic, because the candidate index is used to break ties.
+    runThreads(2 * uint64_t(readCount), 1000, [this](uint64_t begin, uint64_t end)
+    {
+        vector< pair<OrientedReadId, uint64_t> > v;
+        for(uint64_t i=begin; i!=end; ++i) {
+            const OrientedReadId orientedReadId0 = OrientedReadId::fromValue(ReadId(i));
 
             // Access the section of the candidate table for this oriented read.
             const span<uint64_t> candidateTableSection =
@@ -437,11 +488,11 @@ void AlignmentCandidates::computeCandidateTable(ReadId readCount, string largeDa
             sort(v.begin(), v.end());
 
             // Store the sorted candidateIndex.
-            for(uint64_t i=0; i<v.size(); i++) {
-                candidateTableSection[i] = v[i].second;
+            for(uint64_t j=0; j<v.size(); j++) {
+                candidateTableSection[j] = v[j].second;
             }
         }
-    }
+    });
 
     candidateTable.unreserve();
 
@@ -26,8 +26,55 @@ bool Assembler::createLocalAlignmentGraph(
     size_t maxTrim,                 // Maximum left/right trim (expressed in bases) to generate an edge.
     uint32_t maxDistance,           // How far to go from starting oriented read.
     double timeout,                 // Or 0 for no timeout.
-    LocalAlignmentGraph& graph)
+    LocalAlignmentGraph& graph,
+    size_t threadCount)
 {
+    // If requested, use the parallel level-synchronous BFS
+    // (see AssemblerReadGraph.cpp). It creates the same vertices and edges.
+    if(threadCount > 1) {
+
+        // The alignments to be followed.
+        // This is called concurrently by multiple threads.
+        const LocalGraphFindEdges findEdges =
+            [&](OrientedReadId orientedReadId0, vector< pair<OrientedReadId, uint64_t> >& neighbors)
+        {
+            neighbors.clear();
+            for(const uint64_t i: alignmentTable[orientedReadId0.getValue()]) {
+                SHASTA_ASSERT(i < alignmentData.size());
+                const AlignmentData ad = getAlignmentData(i);
+                if(ad.info.markerCount < minAlignedMarkerCount) {
+                    continue;
+                }
+                uint32_t leftTrim;
+                uint32_t rightTrim;
+                tie(leftTrim, rightTrim) = ad.info.computeTrim();
+                if(leftTrim>maxTrim || rightTrim>maxTrim) {
+                    continue;
+                }
+                neighbors.push_back(make_pair(ad.getOther(orientedReadId0), i));
+            }
+        };
+
+        // Do the BFS.
+        vector< pair<OrientedReadId, uint32_t> > vertices;
+        vector< tuple<OrientedReadId, OrientedReadId, uint64_t> > edges;
+        if(not localGraphBfs({orientedReadIdStart}, maxDistance, timeout, threadCount,
+            findEdges, vertices, edges)) {
+            graph.clear();
+            return false;
+        }
+
+        // Create the local alignment graph.
+        for(const auto& p: vertices) {
+            graph.addVertex(p.first,
+                uint32_t(reads->getRead(p.first.getReadId()).baseCount), p.second);
+        }
+        for(const auto& t: edges) {
+            graph.addEdge(get<0>(t), get<1>(t), getAlignmentData(get<2>(t)).info);
+        }
+        return true;
+    }
+
     const auto startTime = steady_clock::now();
 
     // Add the starting vertex.
@@ -60,7 +107,7 @@ bool Assembler::createLocalAlignmentGraph(
         // Loop over overlaps/alignments involving this vertex.
         for(const uint64_t i: alignmentTable[orientedReadId0.getValue()]) {
             SHASTA_ASSERT(i < alignmentData.size());
-            const AlignmentData& ad = alignmentData[i];
+            const AlignmentData ad = getAlignmentData(i);
 
             // If the alignment involves too few markers, skip.
             if(ad.info.markerCount < minAlignedMarkerCount) {
@@ -218,7 +218,7 @@ void Assembler::getStoredAlignments(
     for(const uint32_t alignmentIndex: alignmentIndexes) {
 
         // Access the stored information we have about this alignment.
-        AlignmentData alignmentData = this->alignmentData[alignmentIndex];
+        const CompactAlignmentData& alignmentData = this->alignmentData[alignmentIndex];
         const span<const char> compressedAlignment = compressedAlignments[alignmentIndex];
 
         // The alignment is stored with its first read on strand 0.
@@ -232,7 +232,7 @@ void Assembler::getStoredAlignments(
         OrientedReadId& orientedReadId1 = alignments.back().orientedReadId;
         alignments.back().alignmentId = alignmentIndex;
         decompress(compressedAlignment, alignment);
-        SHASTA_ASSERT(alignment.ordinals.size() == alignmentData.info.markerCount);
+        SHASTA_ASSERT(alignment.ordinals.size() == alignmentData.markerCount);
 
 
 
@@ -289,7 +289,7 @@ void Assembler::getStoredAlignments(
     // Loop over alignments involving this oriented read.
     alignments.clear();
     for(const uint32_t alignmentId: alignmentIds) {
-        AlignmentData alignmentData = this->alignmentData[alignmentId];
+        const CompactAlignmentData& alignmentData = this->alignmentData[alignmentId];
 
         // The alignment is stored with its first read on strand 0.
         OrientedReadId alignmentOrientedReadId0(alignmentData.readIds[0], 0);
@@ -331,7 +331,7 @@ void Assembler::getStoredAlignments(
         const span<const char> compressedAlignment = compressedAlignments[alignmentId];
         Alignment& alignment = alignments.back().alignment;
         decompress(compressedAlignment, alignment);
-        SHASTA_ASSERT(alignment.ordinals.size() == alignmentData.info.markerCount);
+        SHASTA_ASSERT(alignment.ordinals.size() == alignmentData.markerCount);
 
         // Tweak the alignment consistently with what we did above.
         if(doSwap) {
@@ -363,11 +363,11 @@ void Assembler::findAlignedMarkers(
     Alignment alignment;
     const auto alignmentTable = this->alignmentTable[orientedReadId.getValue()];
     for(const auto alignmentId: alignmentTable) {
-        const AlignmentData& ad = alignmentData[alignmentId];
+        const CompactAlignmentData& ad = alignmentData[alignmentId];
 
         // If this alignment is not in the read graph and only read graph alignments
         // were requested, skip it.
-        if(useReadGraphAlignmentsOnly and (not ad.info.isInReadGraph)) {
+        if(useReadGraphAlignmentsOnly and (not ad.isInReadGraph)) {
             continue;
         }
 
@@ -379,7 +379,7 @@ void Assembler::findAlignedMarkers(
         // Access the alignment and decompress it.
         const span<const char> compressedAlignment = compressedAlignments[alignmentId];
         decompress(compressedAlignment, alignment);
-        SHASTA_ASSERT(alignment.ordinals.size() == ad.info.markerCount);
+        SHASTA_ASSERT(alignment.ordinals.size() == ad.markerCount);
 
         // Swap the reads, if necessary.
         bool swapReads = false;
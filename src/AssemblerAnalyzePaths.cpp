@@ -3,8 +3,9 @@
 #include "AssemblyGraph.hpp"
 #include "deduplicate.hpp"
 #include "orderPairs.hpp"
-// Shasta.
+#include "Reads.hpp"
 #include "seqan.hpp"
+#include "timestamp.hpp"
 using namespace shasta;
 
 // Standard library.
@@ -30,6 +31,26 @@ void Assembler::computePseudoPath(
     const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     using SegmentId = AssemblyGraphEdgeId;
 
+    // If the assembly graph stores the assembly graph edges
+    // encountered by each oriented read, use them.
+    // In that case the marker graph path is not computed.
+    if(assemblyGraph.edgesByOrientedRead.isOpen()) {
+        path.clear();
+        pathOrdinals.clear();
+        pseudoPath.clear();
+        for(const AssemblyGraph::EdgeInfo& info: assemblyGraph.edgesByOrientedRead[orientedReadId.getValue()]) {
+            PseudoPathEntry pseudoPathEntry;
+            pseudoPathEntry.segmentId = info.edgeId;
+            pseudoPathEntry.firstOrdinal = info.firstOrdinal;
+            pseudoPathEntry.lastOrdinal = info.lastOrdinal;
+            pseudoPathEntry.firstPosition = info.firstPosition;
+            pseudoPathEntry.lastPosition = info.lastPosition;
+            pseudoPathEntry.markerGraphEdgeCount = info.markerGraphEdgeCount;
+            pseudoPath.push_back(pseudoPathEntry);
+        }
+        return;
+    }
+
     // Compute the marker graph path.
     const uint64_t markerCount = markers.size(orientedReadId.getValue());
     if(markerCount < 2) {
@@ -100,6 +121,126 @@ void Assembler::computePseudoPath(
 
 
 
+// Compute the pseudo-paths of all oriented reads in parallel
+// and store them in pseudoPaths, indexed by OrientedReadId::getValue().
+void Assembler::computePseudoPaths(size_t threadCount)
+{
+    if(pseudoPathsAreAvailable()) {
+        return;
+    }
+    SHASTA_ASSERT(assemblyGraphPointer);
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const uint64_t readCount = reads->readCount();
+    cout << timestamp << "Computing pseudopaths for " << readCount << " reads." << endl;
+
+    // Pass 1: each thread computes the pseudo-paths of its oriented reads
+    // into its own scratch area, and counts their entries.
+    auto& threadData = computePseudoPathsData.threadData;
+    threadData.clear();
+    threadData.resize(threadCount);
+    pseudoPaths.createNew(largeDataName("PseudoPaths"), largeDataPageSize);
+    pseudoPaths.beginPass1(2 * readCount);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(readCount, batchSize);
+    runThreads(&Assembler::computePseudoPathsThreadFunction1, threadCount);
+
+    // Pass 2: each thread copies its pseudo-paths to their final location.
+    pseudoPaths.beginPass2();
+    pseudoPaths.endPass2(false);
+    runThreads(&Assembler::computePseudoPathsThreadFunction2, threadCount);
+    threadData.clear();
+    threadData.shrink_to_fit();
+
+    pseudoPathsAssemblyGraph = assemblyGraphPointer;
+    cout << timestamp << "Stored " << pseudoPaths.totalSize() << " pseudopath entries." << endl;
+}
+
+
+
+void Assembler::computePseudoPathsThreadFunction1(size_t threadId)
+{
+    auto& data = computePseudoPathsData.threadData[threadId];
+
+    // Scratch vectors reused for all oriented reads processed by this thread.
+    vector<MarkerGraph::EdgeId> path;
+    vector< pair<uint32_t, uint32_t> > pathOrdinals;
+    PseudoPath pseudoPath;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all reads in this batch.
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            for(Strand strand=0; strand<2; strand++) {
+                const OrientedReadId orientedReadId(readId, strand);
+                computePseudoPath(orientedReadId, path, pathOrdinals, pseudoPath);
+                data.orientedReads.push_back(make_pair(orientedReadId.getValue(), data.entries.size()));
+                data.entries.insert(data.entries.end(), pseudoPath.begin(), pseudoPath.end());
+                pseudoPaths.incrementCountMultithreaded(orientedReadId.getValue(), pseudoPath.size());
+            }
+        }
+    }
+}
+
+
+
+void Assembler::computePseudoPathsThreadFunction2(size_t threadId)
+{
+    auto& data = computePseudoPathsData.threadData[threadId];
+
+    for(uint64_t i=0; i<data.orientedReads.size(); i++) {
+        const uint64_t orientedReadIdValue = data.orientedReads[i].first;
+        const uint64_t entriesBegin = data.orientedReads[i].second;
+        const uint64_t entriesEnd =
+            (i + 1 == data.orientedReads.size()) ? data.entries.size() : data.orientedReads[i + 1].second;
+        const span<PseudoPathEntry> pseudoPath = pseudoPaths[orientedReadIdValue];
+        SHASTA_ASSERT(pseudoPath.size() == entriesEnd - entriesBegin);
+        copy(data.entries.begin() + entriesBegin, data.entries.begin() + entriesEnd, pseudoPath.begin());
+    }
+
+    // Free the scratch area of this thread.
+    data.entries.clear();
+    data.entries.shrink_to_fit();
+    data.orientedReads.clear();
+    data.orientedReads.shrink_to_fit();
+}
+
+
+
+// The stored pseudoPaths are only valid for the assembly graph
+// they were computed for.
+bool Assembler::pseudoPathsAreAvailable() const
+{
+    return
+        assemblyGraphPointer and
+        pseudoPaths.isOpen() and
+        pseudoPathsAssemblyGraph.lock() == assemblyGraphPointer;
+}
+
+
+
+// Get the pseudo-path of an oriented read, using the stored
+// pseudoPaths if available, or computing it otherwise.
+void Assembler::getPseudoPath(OrientedReadId orientedReadId, PseudoPath& pseudoPath) const
+{
+    if(pseudoPathsAreAvailable()) {
+        const span<const PseudoPathEntry> storedPseudoPath = pseudoPaths[orientedReadId.getValue()];
+        pseudoPath.assign(storedPseudoPath.begin(), storedPseudoPath.end());
+    } else {
+        vector<MarkerGraph::EdgeId> path;
+        vector< pair<uint32_t, uint32_t> > pathOrdinals;
+        computePseudoPath(orientedReadId, path, pathOrdinals, pseudoPath);
+    }
+}
+
+
+
 // Write the pseudo-path of an oriented read to a csv file.
 // The pseudo-path is the sequence of assembly graph edges
 // (not necsssarily all adjacent, so not necessatily a path)
@@ -108,10 +249,8 @@ void Assembler::writePseudoPath(ReadId readId, Strand strand) const
 {
     // Compute the pseudo path.
     const OrientedReadId orientedReadId(readId, strand);
-    vector<MarkerGraph::EdgeId> path;
-    vector< pair<uint32_t, uint32_t> > pathOrdinals;
     PseudoPath pseudoPath;
-    computePseudoPath(orientedReadId, path, pathOrdinals, pseudoPath);
+    getPseudoPath(orientedReadId, pseudoPath);
 
     // Write it out.
     ofstream csv("PseudoPath.csv");
@@ -142,6 +281,18 @@ void Assembler::getPseudoPathSegments(
 
 
 
+void Assembler::getPseudoPathSegments(
+    span<const PseudoPathEntry> pseudoPath,
+    vector<AssemblyGraph::EdgeId>& segmentIds)
+{
+    segmentIds.clear();
+    for(const PseudoPathEntry& pseudoPathEntry: pseudoPath) {
+        segmentIds.push_back(pseudoPathEntry.segmentId);
+    }
+}
+
+
+
 void Assembler::alignPseudoPaths(
     ReadId readId0, Strand strand0,
     ReadId readId1, Strand strand1)
@@ -162,14 +313,11 @@ void Assembler::alignPseudoPaths(
 
 
     // Compute the two pseudo-paths.
-    vector<MarkerGraph::EdgeId> path;
-    vector< pair<uint32_t, uint32_t> > pathOrdinals;
     PseudoPath pseudoPath;
     array<vector<SegmentId>, 2> pseudoPathSegments;
     for(uint64_t i=0; i<2; i++) {
-            computePseudoPath(orientedReadIds[i], path, pathOrdinals,
-                pseudoPath);
-            getPseudoPathSegments(pseudoPath, pseudoPathSegments[i]);
+        getPseudoPath(orientedReadIds[i], pseudoPath);
+        getPseudoPathSegments(pseudoPath, pseudoPathSegments[i]);
         cout << "The pseudo-path of " << orientedReadIds[i] <<
             " has " << pseudoPathSegments[i].size() << " segments." << endl;
     }
@@ -2,9 +2,12 @@
 #include "Assembler.hpp"
 #include "assembleMarkerGraphPath.hpp"
 #include "AssembledSegment.hpp"
+#include "Bgzf.hpp"
 #include "deduplicate.hpp"
 #include "LocalAssemblyGraph.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
+#include "ParallelWriter.hpp"
 #include "performanceLog.hpp"
 #include "Reads.hpp"
 #include "timestamp.hpp"
@@ -18,6 +21,7 @@ using namespace shasta;
 #include "chrono.hpp"
 #include <filesystem>
 #include "iterator.hpp"
+#include <mutex>
 #include <numeric>
 #include <queue>
 #include <unordered_map>
@@ -35,11 +39,19 @@ using namespace shasta;
 // - assemblyGraph.edgeLists.
 // - assemblyGraph.reverseComplementEdge.
 // - assemblyGraph.markerToAssemblyTable
-void Assembler::createAssemblyGraphEdges()
+//
+// Linear chains are found in parallel, each starting from its
+// first edge, that is, an edge without a previous edge.
+// The remaining edges belong to circular chains, which are found
+// in a final serial pass. The chains are stored in the same order
+// as a serial scan of the marker graph edges would find them:
+// each pair of reverse complemented chains (or each self-complementary chain)
+// in order of the lowest marker graph EdgeId in the pair,
+// first the chain that contains that edge.
+void Assembler::createAssemblyGraphEdges(size_t threadCount)
 {
 
     // Some shorthands.
-    // using VertexId = AssemblyGraph::VertexId;
     using EdgeId = AssemblyGraph::EdgeId;
     if(not assemblyGraphPointer) {
         assemblyGraphPointer = make_shared<AssemblyGraph>();
@@ -51,10 +63,9 @@ void Assembler::createAssemblyGraphEdges()
     checkMarkerGraphEdgesIsOpen();
     const auto& edges = markerGraph.edges;
 
-    // Flag to control debug output.
-    const bool debug = false;
-
     // Vector used to keep track of marker graph edges that were already found.
+    // Each marker graph edge belongs to exactly one chain,
+    // so threads never write the same entry.
     const EdgeId edgeCount = markerGraph.edges.size();
     MemoryMapped::Vector<bool> wasFound;
     wasFound.createNew(
@@ -63,177 +74,483 @@ void Assembler::createAssemblyGraphEdges()
     wasFound.resize(edgeCount);
     fill(wasFound.begin(), wasFound.end(), false);
 
-    // Initialize the data structures we are going to fill in.
-    assemblyGraph.edgeLists.createNew(
-        largeDataName("AssemblyGraphEdgeLists"),
-        largeDataPageSize);
-    assemblyGraph.reverseComplementEdge.createNew(
-        largeDataName("AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+
+
+    // A chain and its reverse complement, or a self-complementary chain.
+    class ChainPair {
+    public:
+        EdgeId key;
+        vector<EdgeId> chain;
+        vector<EdgeId> reverseComplementedChain;
+        bool isSelfComplementary;
+
+        bool operator<(const ChainPair& that) const
+        {
+            return key < that.key;
+        }
+    };
+    vector<ChainPair> chainPairs;
+    std::mutex chainPairsMutex;
+
+
+
+    // Find the linear chains in parallel.
+    // Each pair of reverse complemented chains is stored
+    // by the thread that finds the chain containing the lowest EdgeId.
+    const uint64_t batchSize = 10000;
+    parallelFor(edgeCount, batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            vector<ChainPair> batchChainPairs;
+            vector<EdgeId> chain;
+            vector<EdgeId> reverseComplementedChain;
+            for(EdgeId startEdgeId=begin; startEdgeId!=end; startEdgeId++) {
+                if(edges[startEdgeId].wasRemoved()) {
+                    continue;
+                }
+                if(previousEdgeInMarkerGraphPrunedStrongSubgraphChain(startEdgeId) !=
+                    MarkerGraph::invalidEdgeId) {
+                    continue;
+                }
+
+                // Follow the chain forward.
+                chain.clear();
+                EdgeId edgeId = startEdgeId;
+                while(edgeId != MarkerGraph::invalidEdgeId) {
+                    chain.push_back(edgeId);
+                    edgeId = nextEdgeInMarkerGraphPrunedStrongSubgraphChain(edgeId);
+                }
+
+                const bool isSelfComplementary =
+                    getReverseComplementedAssemblyGraphChain(chain, false, reverseComplementedChain);
+                const EdgeId key = *std::min_element(chain.begin(), chain.end());
+                if(not isSelfComplementary) {
+                    const EdgeId reverseComplementedKey =
+                        *std::min_element(reverseComplementedChain.begin(), reverseComplementedChain.end());
+                    if(reverseComplementedKey < key) {
+                        continue;
+                    }
+                }
+
+                for(const EdgeId edgeId: chain) {
+                    wasFound[edgeId] = true;
+                }
+                if(not isSelfComplementary) {
+                    for(const EdgeId edgeId: reverseComplementedChain) {
+                        wasFound[edgeId] = true;
+                    }
+                }
+                batchChainPairs.push_back({key, chain, reverseComplementedChain, isSelfComplementary});
+            }
+
+            std::lock_guard<std::mutex> lock(chainPairsMutex);
+            for(ChainPair& chainPair: batchChainPairs) {
+                chainPairs.push_back(std::move(chainPair));
+            }
+        });
 
 
 
-    // Work vectors reused for each chain.
-    vector<EdgeId> nextEdges;
-    vector<EdgeId> previousEdges;
+    // The edges not yet found belong to circular chains.
+    // Scanning in order of EdgeId, each circular chain is found
+    // starting from its lowest EdgeId, as in a serial scan of all edges.
+    vector<EdgeId> workArea;
     vector<EdgeId> chain;
     vector<EdgeId> reverseComplementedChain;
+    for(EdgeId startEdgeId=0; startEdgeId<edgeCount; startEdgeId++) {
+        if(edges[startEdgeId].wasRemoved() or wasFound[startEdgeId]) {
+            continue;
+        }
 
+        const bool isCircularChain = findAssemblyGraphChain(startEdgeId, chain, workArea);
+        SHASTA_ASSERT(isCircularChain);
+        for(const EdgeId edgeId: chain) {
+            wasFound[edgeId] = true;
+        }
+        const bool isSelfComplementary =
+            getReverseComplementedAssemblyGraphChain(chain, isCircularChain, reverseComplementedChain);
+        if(not isSelfComplementary) {
+            for(const EdgeId edgeId: reverseComplementedChain) {
+                SHASTA_ASSERT(!wasFound[edgeId]);
+                wasFound[edgeId] = true;
+            }
+        }
+        chainPairs.push_back({startEdgeId, chain, reverseComplementedChain, isSelfComplementary});
+    }
+    sort(chainPairs.begin(), chainPairs.end());
 
 
-    // Main loop over all edges of the marker graph.
-    // At each iteration we find a new linear chain of edges.
-    for(EdgeId startEdgeId=0; startEdgeId<edgeCount; startEdgeId++) {
-        const auto& startEdge = edges[startEdgeId];
 
-        if(debug) {
-            cout << "Working on start edge " << startEdgeId;
-            cout << " " << startEdge.source << "->" << startEdge.target << endl;
-            startEdge.writeFlags(cout);
+    // Assign chain ids and store assemblyGraph.reverseComplementEdge.
+    assemblyGraph.edgeLists.createNew(
+        largeDataName("AssemblyGraphEdgeLists"),
+        largeDataPageSize);
+    assemblyGraph.reverseComplementEdge.createNew(
+        largeDataName("AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+    vector<EdgeId> firstChainIds;
+    firstChainIds.reserve(chainPairs.size());
+    EdgeId chainCount = 0;
+    for(const ChainPair& chainPair: chainPairs) {
+        const EdgeId chainId = chainCount;
+        firstChainIds.push_back(chainId);
+        if(chainPair.isSelfComplementary) {
+            cout << "Found a self-complementary chain." << endl;
+            assemblyGraph.reverseComplementEdge.push_back(chainId);
+            ++chainCount;
+        } else {
+            assemblyGraph.reverseComplementEdge.push_back(chainId+1);
+            assemblyGraph.reverseComplementEdge.push_back(chainId);
+            chainCount += 2;
         }
+    }
 
-        // If this edge is not part of cleaned up marker graph, skip it.
-        if(startEdge.wasRemoved()) {
-            if(debug) {
-                cout << "Start edge was removed." << endl;
+    // Store the chains in assemblyGraph.edgeLists.
+    assemblyGraph.edgeLists.beginPass1(chainCount);
+    for(uint64_t i=0; i<chainPairs.size(); i++) {
+        const ChainPair& chainPair = chainPairs[i];
+        assemblyGraph.edgeLists.incrementCount(firstChainIds[i], chainPair.chain.size());
+        if(not chainPair.isSelfComplementary) {
+            assemblyGraph.edgeLists.incrementCount(firstChainIds[i] + 1,
+                chainPair.reverseComplementedChain.size());
+        }
+    }
+    assemblyGraph.edgeLists.beginPass2();
+    parallelFor(chainPairs.size(), 1000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const ChainPair& chainPair = chainPairs[i];
+                copy(chainPair.chain.begin(), chainPair.chain.end(),
+                    assemblyGraph.edgeLists.begin(firstChainIds[i]));
+                if(not chainPair.isSelfComplementary) {
+                    copy(chainPair.reverseComplementedChain.begin(), chainPair.reverseComplementedChain.end(),
+                        assemblyGraph.edgeLists.begin(firstChainIds[i] + 1));
+                }
             }
-            continue;
+        });
+    assemblyGraph.edgeLists.endPass2(false);
+    chainPairs.clear();
+    chainPairs.shrink_to_fit();
+
+    // Free allocated, unused space.
+    assemblyGraph.edgeLists.unreserve();
+    assemblyGraph.reverseComplementEdge.unreserve();
+
+
+    // Check that only and all edges of the cleaned up marker graph
+    // were found.
+    for(EdgeId edgeId=0; edgeId<edgeCount; edgeId++) {
+        const auto& edge = markerGraph.edges[edgeId];
+        if(edge.wasRemoved()) {
+            SHASTA_ASSERT(!wasFound[edgeId]);
+        } else {
+            SHASTA_ASSERT(wasFound[edgeId]);
         }
+    }
 
-        // If we already found this edge, skip it.
-        // It is part of a chain we already found.
-        if(wasFound[startEdgeId]) {
-            if(debug) {
-                cout << "This edge is part of a chain we already found." << endl;
-            }
-            continue;
+    wasFound.remove();
+
+
+
+    // Create the markerToAssemblyTable.
+    assemblyGraph.markerToAssemblyTable.createNew(
+        largeDataName("MarkerToAssemblyTable"),
+        largeDataPageSize);
+    assemblyGraph.createMarkerToAssemblyTable(edges.size());
+}
+
+
+
+// Find the linear chain of marker graph edges that contains a given edge.
+// The chain is in the order of the marker graph edges.
+// For a circular chain, the chain begins at startEdgeId.
+// Returns true if the chain is circular.
+bool Assembler::findAssemblyGraphChain(
+    MarkerGraph::EdgeId startEdgeId,
+    vector<MarkerGraph::EdgeId>& chain,
+    vector<MarkerGraph::EdgeId>& workArea) const
+{
+    vector<MarkerGraph::EdgeId>& previousEdges = workArea;
+    chain.clear();
+    previousEdges.clear();
+
+    // Follow the chain forward.
+    chain.push_back(startEdgeId);
+    MarkerGraph::EdgeId edgeId = startEdgeId;
+    bool isCircularChain = false;
+    while(true) {
+        edgeId = nextEdgeInMarkerGraphPrunedStrongSubgraphChain(edgeId);
+        if(edgeId == MarkerGraph::invalidEdgeId) {
+            break;
         }
+        if(edgeId == startEdgeId) {
+            isCircularChain = true;
+            break;
+        }
+        chain.push_back(edgeId);
+    }
 
-        // Follow the chain forward.
-        EdgeId edgeId = startEdgeId;
-        bool isCircularChain = false;
+    // Follow the chain backward.
+    if(!isCircularChain) {
+        edgeId = startEdgeId;
         while(true) {
-            edgeId = nextEdgeInMarkerGraphPrunedStrongSubgraphChain(edgeId);
+            edgeId = previousEdgeInMarkerGraphPrunedStrongSubgraphChain(edgeId);
             if(edgeId == MarkerGraph::invalidEdgeId) {
                 break;
             }
-            if(edgeId == startEdgeId) {
-                isCircularChain = true;
-                break;
-            }
-            nextEdges.push_back(edgeId);
+            previousEdges.push_back(edgeId);
         }
+        chain.insert(chain.begin(), previousEdges.rbegin(), previousEdges.rend());
+    }
 
-        // Follow the chain backward.
-        if(!isCircularChain) {
-            edgeId = startEdgeId;
-            while(true) {
-                edgeId = previousEdgeInMarkerGraphPrunedStrongSubgraphChain(edgeId);
-                if(edgeId == MarkerGraph::invalidEdgeId) {
-                    break;
-                }
-                previousEdges.push_back(edgeId);
-            }
-        }
+    return isCircularChain;
+}
 
-        // Gather the chain.
-        copy(previousEdges.rbegin(), previousEdges.rend(), back_inserter< vector<EdgeId> >(chain));
-        chain.push_back(startEdgeId);
-        copy(nextEdges.begin(), nextEdges.end(), back_inserter< vector<EdgeId> >(chain));
 
-        // Mark all the edges in the chain as found.
-        for(const EdgeId edgeId: chain) {
-            wasFound[edgeId] = true;
-        }
 
-        // Store this chain as a new edge of the assembly graph.
-        const EdgeId chainId = assemblyGraph.edgeLists.size();
-        assemblyGraph.edgeLists.appendVector(chain);
+// Construct the reverse complement of a chain of marker graph edges.
+// Returns true if the reverse complemented chain is the same
+// as the original chain. This can happen in exceptional cases.
+bool Assembler::getReverseComplementedAssemblyGraphChain(
+    const vector<MarkerGraph::EdgeId>& chain,
+    bool isCircularChain,
+    vector<MarkerGraph::EdgeId>& reverseComplementedChain) const
+{
+    reverseComplementedChain.clear();
+    for(const MarkerGraph::EdgeId edgeId: chain) {
+        reverseComplementedChain.push_back(markerGraph.reverseComplementEdge[edgeId]);
+    }
+    std::reverse(reverseComplementedChain.begin(), reverseComplementedChain.end());
+
+    if(!isCircularChain) {
+        return chain == reverseComplementedChain;
+    } else {
+
+        // For a circular chain the test is more complex.
+        // We check if the reverse complement of the first edge
+        // is in the chain.
+        return find(chain.begin(), chain.end(), reverseComplementedChain.front()) != chain.end();
+    }
+}
+
+
+
+// Incremental version of createAssemblyGraphEdges, used by simplifyMarkerGraph.
+// previousChains and previousReverseComplementChain describe the assembly graph edges
+// created by a previous call to createAssemblyGraphEdges or createAssemblyGraphEdgesIncremental.
+// Since then, some marker graph edges can have been flagged as removed, but no edges
+// can have been restored. Only the chains that contain removed marker graph edges,
+// or that begin or end at a marker graph vertex of a removed edge, can change,
+// and only those are recomputed. All other chains are reused unchanged.
+// The assembly graph edges created are the same, and in the same order,
+// as the ones createAssemblyGraphEdges would create.
+// Like createAssemblyGraphEdges, this creates:
+// - assemblyGraph.edgeLists.
+// - assemblyGraph.reverseComplementEdge.
+// - assemblyGraph.markerToAssemblyTable
+void Assembler::createAssemblyGraphEdgesIncremental(
+    const MemoryMapped::VectorOfVectors<AssemblyGraph::EdgeId, AssemblyGraph::EdgeId>& previousChains,
+    const vector<AssemblyGraph::EdgeId>& previousReverseComplementChain)
+{
+    using EdgeId = AssemblyGraph::EdgeId;
+    if(not assemblyGraphPointer) {
+        assemblyGraphPointer = make_shared<AssemblyGraph>();
+    }
+    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+
+    // Check that we have what we need.
+    checkMarkerGraphVerticesAreAvailable();
+    checkMarkerGraphEdgesIsOpen();
+    const auto& edges = markerGraph.edges;
+    const EdgeId edgeCount = markerGraph.edges.size();
+    const EdgeId previousChainCount = previousChains.size();
+    SHASTA_ASSERT(previousReverseComplementChain.size() == previousChainCount);
+
 
-        // Also construct the reverse complemented chain.
+
+    // Find the marker graph vertices of the removed edges
+    // that were part of a previous chain.
+    // Previous chains that contain removed edges are recomputed
+    // starting from each of their edges that were not removed.
+    vector<bool> isDirtyVertex(markerGraph.vertexCount(), false);
+    vector<bool> isCleanChain(previousChainCount, true);
+    vector<EdgeId> startEdges;
+    for(EdgeId chainId=0; chainId<previousChainCount; chainId++) {
+        const span<const EdgeId> chain = previousChains[chainId];
         for(const EdgeId edgeId: chain) {
-        	reverseComplementedChain.push_back(markerGraph.reverseComplementEdge[edgeId]);
+            const MarkerGraph::Edge& edge = edges[edgeId];
+            if(edge.wasRemoved()) {
+                isCleanChain[chainId] = false;
+                isDirtyVertex[edge.source] = true;
+                isDirtyVertex[edge.target] = true;
+            }
         }
-        std::reverse(reverseComplementedChain.begin(), reverseComplementedChain.end());
-
-        if(debug) {
-            cout << "Chain:";
-            for(const auto edgeId: chain) {
-                cout << " " << edgeId;
+        if(not isCleanChain[chainId]) {
+            for(const EdgeId edgeId: chain) {
+                if(not edges[edgeId].wasRemoved()) {
+                    startEdges.push_back(edgeId);
+                }
             }
-            cout << endl;
-            cout << "Reverse complemented chain:";
-            for(const auto edgeId: reverseComplementedChain) {
-                cout << " " << edgeId;
+        }
+    }
+
+    // Previous chains that begin or end at a dirty vertex are also recomputed,
+    // because they can now be merged with other chains.
+    for(EdgeId chainId=0; chainId<previousChainCount; chainId++) {
+        if(not isCleanChain[chainId]) {
+            continue;
+        }
+        const span<const EdgeId> chain = previousChains[chainId];
+        if(isDirtyVertex[edges[chain.front()].source] or isDirtyVertex[edges[chain.back()].target]) {
+            isCleanChain[chainId] = false;
+            startEdges.push_back(chain.front());
+        }
+    }
+    sort(startEdges.begin(), startEdges.end());
+
+    // Keep track of marker graph edges that were already found.
+    MemoryMapped::Vector<bool> wasFound;
+    wasFound.createNew(
+        largeDataName("tmp-createAssemblyGraphVertices-wasFound"),
+        largeDataPageSize);
+    wasFound.resize(edgeCount);
+    fill(wasFound.begin(), wasFound.end(), false);
+    uint64_t cleanChainCount = 0;
+    for(EdgeId chainId=0; chainId<previousChainCount; chainId++) {
+        if(isCleanChain[chainId]) {
+            SHASTA_ASSERT(isCleanChain[previousReverseComplementChain[chainId]]);
+            ++cleanChainCount;
+            for(const EdgeId edgeId: previousChains[chainId]) {
+                wasFound[edgeId] = true;
             }
-            cout << endl;
         }
+    }
 
 
 
-        // Figure out if the reverse complemented chain is the same
-        // as the original chain. This can happen in exceptional cases.
-        bool isSelfComplementary = false;
-        if(!isCircularChain) {
-        	isSelfComplementary = (chain == reverseComplementedChain);
-        } else {
+    // Each pair of reverse complemented chains (or each self-complementary chain)
+    // is stored in the order in which createAssemblyGraphEdges would find it,
+    // that is, the order of the lowest marker graph EdgeId in the pair.
+    class ChainPair {
+    public:
+        EdgeId key;
+        bool isSelfComplementary;
 
-        	// For a circular chain the test is more complex.
-        	// We check if the reverse complement of the first edge
-        	// is in the chain.
-        	isSelfComplementary =
-        		find(chain.begin(), chain.end(), reverseComplementedChain.front()) != chain.end();
-        }
-        if(isSelfComplementary) {
-        	cout << "Found a self-complementary chain." << endl;
+        // If the chain pair is reused from the previous chains,
+        // the id of the first previous chain of the pair.
+        // Otherwise, the index of its first chain in newChains.
+        bool isPrevious;
+        uint64_t index;
+
+        bool operator<(const ChainPair& that) const
+        {
+            return key < that.key;
         }
+    };
+    vector<ChainPair> chainPairs;
+    vector< vector<EdgeId> > newChains;
 
+    // Recompute the chains that can have changed.
+    vector<EdgeId> workArea;
+    vector<EdgeId> chain;
+    vector<EdgeId> reverseComplementedChain;
+    for(const EdgeId startEdgeId: startEdges) {
+        if(wasFound[startEdgeId]) {
+            continue;
+        }
 
-        // Store the reverse complemented chain, if different from the original one.
-        // Also update assemblyGraph.reverseComplementEdge.
-        if(isSelfComplementary) {
-        	assemblyGraph.reverseComplementEdge.push_back(chainId);
-        } else {
+        bool isCircularChain = findAssemblyGraphChain(startEdgeId, chain, workArea);
+        bool isSelfComplementary =
+            getReverseComplementedAssemblyGraphChain(chain, isCircularChain, reverseComplementedChain);
+        for(const EdgeId edgeId: chain) {
+            SHASTA_ASSERT(!wasFound[edgeId]);
+            wasFound[edgeId] = true;
+        }
+        if(not isSelfComplementary) {
             for(const EdgeId edgeId: reverseComplementedChain) {
-#if 0
-            	if(wasFound[edgeId]) {
-            		cout << "****** " << edgeId << " " << markerGraph.edges[edgeId].source <<
-            			" " << markerGraph.edges[edgeId].target <<endl;
-            		SHASTA_ASSERT(chain.size() == reverseComplementedChain.size());
-            		for(size_t i=0; i<chain.size(); i++) {
-            			cout << i << " " << chain[i] << " " << reverseComplementedChain[i];
-            			cout << " " << int(wasFound[chain[i]]) << " " <<
-            					int(wasFound[reverseComplementedChain[i]]) << endl;
-            		}
-            	}
-#endif
-            	SHASTA_ASSERT(!wasFound[edgeId]);
+                SHASTA_ASSERT(!wasFound[edgeId]);
                 wasFound[edgeId] = true;
             }
-            assemblyGraph.edgeLists.appendVector(reverseComplementedChain);
-        	assemblyGraph.reverseComplementEdge.push_back(chainId+1);
-        	assemblyGraph.reverseComplementEdge.push_back(chainId);
-
-#if 0
-        	cout << "Chain " << chain.front() << "..." << chain.back();
-            cout << ", reverse complement " << reverseComplementedChain.front() <<
-            		"..." << reverseComplementedChain.back() << endl;
-#endif
         }
 
+        // Orient and rotate the chain as createAssemblyGraphEdges would.
+        // It would find it starting from the lowest EdgeId in
+        // the chain and its reverse complement.
+        EdgeId key = *std::min_element(chain.begin(), chain.end());
+        if(not isSelfComplementary) {
+            const EdgeId reverseComplementedKey =
+                *std::min_element(reverseComplementedChain.begin(), reverseComplementedChain.end());
+            if(reverseComplementedKey < key) {
+                key = reverseComplementedKey;
+                chain.swap(reverseComplementedChain);
+            }
+        }
+        if(isCircularChain) {
+            std::rotate(chain.begin(), find(chain.begin(), chain.end(), key), chain.end());
+            isSelfComplementary =
+                getReverseComplementedAssemblyGraphChain(chain, isCircularChain, reverseComplementedChain);
+        }
 
+        chainPairs.push_back({key, isSelfComplementary, false, newChains.size()});
+        newChains.push_back(chain);
+        if(not isSelfComplementary) {
+            newChains.push_back(reverseComplementedChain);
+        }
+    }
 
-        // Cleanup.
-        nextEdges.clear();
-        previousEdges.clear();
-        chain.clear();
-        reverseComplementedChain.clear();
+    // Reuse the chains that did not change.
+    for(EdgeId chainId=0; chainId<previousChainCount; chainId++) {
+        const EdgeId reverseComplementChainId = previousReverseComplementChain[chainId];
+        if((not isCleanChain[chainId]) or (reverseComplementChainId < chainId)) {
+            continue;
+        }
+        const span<const EdgeId> chain = previousChains[chainId];
+        EdgeId key = *std::min_element(chain.begin(), chain.end());
+        if(reverseComplementChainId != chainId) {
+            const span<const EdgeId> reverseComplementedChain = previousChains[reverseComplementChainId];
+            key = min(key, *std::min_element(reverseComplementedChain.begin(), reverseComplementedChain.end()));
+        }
+        chainPairs.push_back({key, reverseComplementChainId == chainId, true, chainId});
     }
+    cout << "Reused " << cleanChainCount << " assembly graph chains and recomputed " <<
+        newChains.size() << "." << endl;
 
-    // Free allocated, unused space.
+
+
+    // Store the chains.
+    sort(chainPairs.begin(), chainPairs.end());
+    assemblyGraph.edgeLists.createNew(
+        largeDataName("AssemblyGraphEdgeLists"),
+        largeDataPageSize);
+    assemblyGraph.reverseComplementEdge.createNew(
+        largeDataName("AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+    for(const ChainPair& chainPair: chainPairs) {
+        const EdgeId chainId = assemblyGraph.edgeLists.size();
+        if(chainPair.isPrevious) {
+            const span<const EdgeId> chain = previousChains[chainPair.index];
+            assemblyGraph.edgeLists.appendVector(chain.begin(), chain.end());
+            if(not chainPair.isSelfComplementary) {
+                const span<const EdgeId> reverseComplementedChain =
+                    previousChains[previousReverseComplementChain[chainPair.index]];
+                assemblyGraph.edgeLists.appendVector(
+                    reverseComplementedChain.begin(), reverseComplementedChain.end());
+            }
+        } else {
+            assemblyGraph.edgeLists.appendVector(newChains[chainPair.index]);
+            if(not chainPair.isSelfComplementary) {
+                assemblyGraph.edgeLists.appendVector(newChains[chainPair.index + 1]);
+            }
+        }
+        if(chainPair.isSelfComplementary) {
+            assemblyGraph.reverseComplementEdge.push_back(chainId);
+        } else {
+            assemblyGraph.reverseComplementEdge.push_back(chainId+1);
+            assemblyGraph.reverseComplementEdge.push_back(chainId);
+        }
+    }
     assemblyGraph.edgeLists.unreserve();
     assemblyGraph.reverseComplementEdge.unreserve();
 
-
     // Check that only and all edges of the cleaned up marker graph
     // were found.
     for(EdgeId edgeId=0; edgeId<edgeCount; edgeId++) {
@@ -244,40 +561,13 @@ void Assembler::createAssemblyGraphEdges()
             SHASTA_ASSERT(wasFound[edgeId]);
         }
     }
-
     wasFound.remove();
 
-    // cout << "The assembly graph has " << assemblyGraph.edgeLists.size() << " edges." << endl;
-
-
-
     // Create the markerToAssemblyTable.
     assemblyGraph.markerToAssemblyTable.createNew(
         largeDataName("MarkerToAssemblyTable"),
         largeDataPageSize);
     assemblyGraph.createMarkerToAssemblyTable(edges.size());
-
-
-#if 0
-    // Create a histogram of size (chain length) of assembly graph edges.
-    vector<size_t> histogram;
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.edgeLists.size(); edgeId++) {
-        const size_t size = assemblyGraph.edgeLists.size(edgeId);
-        if(histogram.size() <= size) {
-            histogram.resize(size+1);
-        }
-        ++(histogram[size]);
-    }
-    ofstream csv("AssemblyGraphChainLengthHistogram.csv");
-    csv << "ChainLength, Frequency\n";
-    for(size_t size=0; size<histogram.size(); size++) {
-        const size_t frequency = histogram[size];
-        if(frequency) {
-            csv << size << "," << frequency << "\n";
-        }
-    }
-#endif
-
 }
 
 
@@ -700,6 +990,14 @@ void Assembler::accessAssemblyGraphOrientedReadsByEdge()
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     assemblyGraph.orientedReadsByEdge.accessExistingReadOnly(
         largeDataName("PhasingGraphOrientedReads"));
+
+    // The transpose is not available for assemblies
+    // created before it was added.
+    try {
+        assemblyGraph.edgesByOrientedRead.accessExistingReadOnly(
+            largeDataName("AssemblyGraphEdgesByOrientedRead"));
+    } catch(const exception&) {
+    }
 }
 
 void Assembler::writeAssemblyGraph(const string& fileName) const
@@ -750,21 +1048,25 @@ void Assembler::assemble(
     // Attempt to reduce memory fragmentation.
     mallopt(M_MMAP_THRESHOLD, 16*1024);
 
+    // Split long edges into ranges that can be assembled independently.
+    assembleData.createRanges(assemblyGraph);
+
     // Do all the assemblies.
     cout << "Assembly begins for " << assemblyGraph.edgeLists.size() <<
-        " edges of the assembly graph." << endl;
-    setupLoadBalancing(assemblyGraph.edgeLists.size(), 1);
+        " edges of the assembly graph, split into " <<
+        assembleData.ranges.size() << " ranges." << endl;
+    setupLoadBalancing(assembleData.rangeOrder.size(), 1);
     runThreads(&Assembler::assembleThreadFunction, threadCount);
 
-    // Find the pair(thread, index in thread) that the assembly for each edge is stored in.
+    // Find the pair(thread, index in thread) that the assembly for each range is stored in.
     const auto uninitializedPair = make_pair(
         std::numeric_limits<size_t>::max(),
         std::numeric_limits<size_t>::max());
-    vector< pair<size_t, size_t> > edgeTable(assemblyGraph.edgeLists.size(), uninitializedPair);
+    vector< pair<size_t, size_t> > rangeTable(assembleData.ranges.size(), uninitializedPair);
     for(size_t threadId=0; threadId<threadCount; threadId++) {
-        vector<AssemblyGraph::EdgeId>& edges = assembleData.edges[threadId];
-        for(size_t i=0; i<edges.size(); i++) {
-            edgeTable[edges[i]] = make_pair(threadId, i);
+        const vector<uint64_t>& rangeIds = assembleData.rangeIds[threadId];
+        for(size_t i=0; i<rangeIds.size(); i++) {
+            rangeTable[rangeIds[i]] = make_pair(threadId, i);
         }
     }
 
@@ -781,24 +1083,43 @@ void Assembler::assemble(
             continue;
         }
         ++assembledEdgeCount;
-        const auto& p = edgeTable[edgeId];
-        SHASTA_ASSERT(p != uninitializedPair);
-        const size_t threadId = p.first;
-        const size_t i = p.second;
-
-        // Store the sequence for this edge.
-        LongBaseSequences& threadSequences =
-            *(assembleData.sequences[threadId]);
-        const auto vertexSequence = threadSequences[i];
-        assemblyGraph.sequences.append(vertexSequence);
-
-        // Store the repeat count for this edge.
-        MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& threadRepeatCounts =
-            *(assembleData.repeatCounts[threadId]);
-        const span<uint8_t> vertexRepeatCounts = threadRepeatCounts[i];
+        const uint64_t rangesBegin = assembleData.rangesBegin[edgeId];
+        const uint64_t rangesEnd = assembleData.rangesBegin[edgeId + 1];
+        SHASTA_ASSERT(rangesEnd > rangesBegin);
+
+        // Store the sequence for this edge, concatenating the sequences of its ranges.
+        if(rangesEnd == rangesBegin + 1) {
+            const auto& p = rangeTable[rangesBegin];
+            SHASTA_ASSERT(p != uninitializedPair);
+            assemblyGraph.sequences.append((*assembleData.sequences[p.first])[p.second]);
+        } else {
+            uint64_t baseCount = 0;
+            for(uint64_t rangeId=rangesBegin; rangeId!=rangesEnd; rangeId++) {
+                const auto& p = rangeTable[rangeId];
+                SHASTA_ASSERT(p != uninitializedPair);
+                baseCount += (*assembleData.sequences[p.first])[p.second].baseCount;
+            }
+            assemblyGraph.sequences.append(baseCount);
+            LongBaseSequenceView edgeSequence = assemblyGraph.sequences[edgeId];
+            uint64_t position = 0;
+            for(uint64_t rangeId=rangesBegin; rangeId!=rangesEnd; rangeId++) {
+                const auto& p = rangeTable[rangeId];
+                const LongBaseSequenceView rangeSequence = (*assembleData.sequences[p.first])[p.second];
+                for(uint64_t j=0; j<rangeSequence.baseCount; j++) {
+                    edgeSequence.set(position++, rangeSequence[j]);
+                }
+            }
+        }
+
+        // Store the repeat counts for this edge.
         assemblyGraph.repeatCounts.appendVector();
-        for(uint8_t r: vertexRepeatCounts) {
-            assemblyGraph.repeatCounts.append(r);
+        for(uint64_t rangeId=rangesBegin; rangeId!=rangesEnd; rangeId++) {
+            const auto& p = rangeTable[rangeId];
+            MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& threadRepeatCounts =
+                *(assembleData.repeatCounts[p.first]);
+            for(uint8_t r: threadRepeatCounts[p.second]) {
+                assemblyGraph.repeatCounts.append(r);
+            }
         }
     }
 
@@ -821,10 +1142,8 @@ void Assembler::assemble(
 
 void Assembler::assembleThreadFunction(size_t threadId)
 {
-    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
-
     // Initialize data structures for this thread.
-    vector<AssemblyGraph::EdgeId>& edges = assembleData.edges[threadId];
+    vector<uint64_t>& rangeIds = assembleData.rangeIds[threadId];
 
     assembleData.sequences[threadId] = make_shared<LongBaseSequences>();
     LongBaseSequences& sequences = *(assembleData.sequences[threadId]);
@@ -835,19 +1154,20 @@ void Assembler::assembleThreadFunction(size_t threadId)
     repeatCounts.createNew(largeDataName("tmp-RepeatCounts-" + to_string(threadId)), largeDataPageSize);
 
     AssembledSegment assembledSegment;
+    vector<Base> sequence;
 
     // Loop over batches allocated to this thread.
+    // Ranges are processed longest first.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
-        for(AssemblyGraph::EdgeId edgeId=begin; edgeId!=end; edgeId++) {
-            if(assemblyGraph.edges[edgeId].wasRemoved()) {
-                continue;
-            }
-            if(!assemblyGraph.isAssembledEdge(edgeId)) {
-                continue;
-            }
+        for(uint64_t i=begin; i!=end; i++) {
+            const uint64_t rangeId = assembleData.rangeOrder[i];
+            const AssembleData::Range& range = assembleData.ranges[rangeId];
+            const AssemblyGraph::EdgeId edgeId = range.edgeId;
+
+            pair<uint64_t, uint64_t> sequenceRange;
             try {
-                assembleAssemblyGraphEdge(edgeId,
+                sequenceRange = assembleRange(range,
                     assembleData.storeCoverageDataCsvLengthThreshold > 0,
                     assembledSegment);
             } catch(const std::exception& e) {
@@ -863,20 +1183,26 @@ void Assembler::assembleThreadFunction(size_t threadId)
                 throw;
             }
 
-            // Store the edge id.
-            edges.push_back(edgeId);
+            // Store the range id.
+            rangeIds.push_back(rangeId);
 
             // Store the sequence.
-            sequences.append(assembledSegment.runLengthSequence);
+            sequence.assign(
+                assembledSegment.runLengthSequence.begin() + sequenceRange.first,
+                assembledSegment.runLengthSequence.begin() + sequenceRange.second);
+            sequences.append(sequence);
 
             // Store the repeat counts.
             repeatCounts.appendVector();
-            for(const uint32_t r: assembledSegment.repeatCounts) {
+            for(uint64_t j=sequenceRange.first; j!=sequenceRange.second; j++) {
+                const uint32_t r = assembledSegment.repeatCounts[j];
                 repeatCounts.append(uint8_t(min(uint32_t(255), r)));
             }
 
             // If requested and the assembled segment is sufficiently long,
             // write coverage information in csv format.
+            // Edges are never split in this case, so the AssembledSegment
+            // is for the entire edge.
             if(
                 (assembleData.storeCoverageDataCsvLengthThreshold > 0)
                 and
@@ -892,9 +1218,123 @@ void Assembler::assembleThreadFunction(size_t threadId)
 
 
 
+// Assemble a range of an assembly graph edge.
+// The assembled portion of each marker graph vertex depends on the
+// vertices that overlap it, which are at a distance of at most k
+// in the assembled run-length sequence. So we assemble
+// the range with additional marker graph edges on each side until
+// we reach a distance greater than k, then only keep the
+// sequence contributed by the vertices and edges of the range.
+// The last vertex of a range belongs to the next range, if any.
+pair<uint64_t, uint64_t> Assembler::assembleRange(
+    const AssembleData::Range& range,
+    bool storeCoverageData,
+    AssembledSegment& assembledSegment)
+{
+    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    const span<const MarkerGraph::EdgeId> markerGraphPath = assemblyGraph.edgeLists[range.edgeId];
+    const uint64_t k = assemblerInfo->k;
+
+    // Entire edge.
+    if(range.begin == 0 and range.end == markerGraphPath.size()) {
+        assembleAssemblyGraphEdge(markerGraphPath, storeCoverageData, assembledSegment);
+        return make_pair(0, assembledSegment.runLengthSequence.size());
+    }
+    SHASTA_ASSERT(not storeCoverageData);
+
+    // The distance in the assembled run-length sequence between
+    // the source and target vertices of a marker graph edge.
+    // This is computed in the same way as AssembledSegment::computeVertexOffsets.
+    const auto vertexDistance = [&](MarkerGraph::EdgeId markerGraphEdgeId)
+    {
+        const uint64_t overlap = markerGraph.edgeConsensusOverlappingBaseCount[markerGraphEdgeId];
+        if(overlap > 0) {
+            return k - overlap;
+        } else {
+            return k + markerGraph.edgeConsensus.size(markerGraphEdgeId);
+        }
+    };
+
+    // Add context on the left.
+    uint64_t contextBegin = range.begin;
+    uint64_t distance = 0;
+    while(contextBegin > 0 and distance <= k) {
+        --contextBegin;
+        distance += vertexDistance(markerGraphPath[contextBegin]);
+    }
+
+    // Add context on the right.
+    uint64_t contextEnd = range.end;
+    distance = 0;
+    while(contextEnd < markerGraphPath.size() and distance <= k) {
+        distance += vertexDistance(markerGraphPath[contextEnd]);
+        ++contextEnd;
+    }
+
+    // Assemble with the context.
+    const span<const MarkerGraph::EdgeId> contextPath(
+        markerGraphPath.begin() + contextBegin,
+        markerGraphPath.begin() + contextEnd);
+    assembleAssemblyGraphEdge(contextPath, false, assembledSegment);
+
+    // Only keep the sequence contributed by the range.
+    const uint64_t localBegin = range.begin - contextBegin;
+    const uint64_t localEnd = range.end - contextBegin;
+    const uint64_t sequenceBegin = assembledSegment.vertexRunLengthRange[localBegin].first;
+    const uint64_t sequenceEnd =
+        (range.end == markerGraphPath.size()) ?
+        assembledSegment.runLengthSequence.size() :
+        assembledSegment.vertexRunLengthRange[localEnd].first;
+    return make_pair(sequenceBegin, sequenceEnd);
+}
+
+
+
+// Split the assembly graph edges to be assembled into ranges.
+void Assembler::AssembleData::createRanges(const AssemblyGraph& assemblyGraph)
+{
+    const bool allowSplitting = (storeCoverageDataCsvLengthThreshold == 0);
+
+    ranges.clear();
+    rangesBegin.clear();
+    for(AssemblyGraph::EdgeId edgeId=0; edgeId<assemblyGraph.edgeLists.size(); edgeId++) {
+        rangesBegin.push_back(ranges.size());
+        if(assemblyGraph.edges[edgeId].wasRemoved()) {
+            continue;
+        }
+        if(!assemblyGraph.isAssembledEdge(edgeId)) {
+            continue;
+        }
+
+        // Split into ranges of approximately equal length.
+        const uint64_t length = assemblyGraph.edgeLists.size(edgeId);
+        const uint64_t rangeCount =
+            (allowSplitting and length > maxRangeLength) ? ((length - 1) / maxRangeLength + 1) : 1;
+        for(uint64_t i=0; i<rangeCount; i++) {
+            Range range;
+            range.edgeId = edgeId;
+            range.begin = (i * length) / rangeCount;
+            range.end = ((i + 1) * length) / rangeCount;
+            ranges.push_back(range);
+        }
+    }
+    rangesBegin.push_back(ranges.size());
+
+    // Assemble the longest ranges first, for better load balancing.
+    rangeOrder.resize(ranges.size());
+    std::iota(rangeOrder.begin(), rangeOrder.end(), 0);
+    std::stable_sort(rangeOrder.begin(), rangeOrder.end(),
+        [this](uint64_t x, uint64_t y)
+        {
+            return ranges[x].length() > ranges[y].length();
+        });
+}
+
+
+
 void Assembler::AssembleData::allocate(size_t threadCount)
 {
-    edges.resize(threadCount);
+    rangeIds.resize(threadCount);
     sequences.resize(threadCount);
     repeatCounts.resize(threadCount);
 }
@@ -903,7 +1343,10 @@ void Assembler::AssembleData::allocate(size_t threadCount)
 
 void Assembler::AssembleData::free()
 {
-    edges.clear();
+    ranges.clear();
+    rangesBegin.clear();
+    rangeOrder.clear();
+    rangeIds.clear();
     for(auto& sequence: sequences) {
         sequence->remove();
     }
@@ -1009,7 +1452,7 @@ void Assembler::computeAssemblyStatistics()
 
 // Write the assembly graph in GFA 1.0 format defined here:
 // https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
-void Assembler::writeGfa1(const string& fileName)
+void Assembler::writeGfa1(const string& fileName, size_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     using VertexId = AssemblyGraph::VertexId;
@@ -1017,44 +1460,47 @@ void Assembler::writeGfa1(const string& fileName)
 
     performanceLog << timestamp << "writeGfa1 begins" << endl;
 
-    ofstream gfa(fileName);
+    // If the file name ends with .gz, this uses BGZF compression.
+    const auto gfaPointer = openOutputFile(fileName, threadCount);
+    ostream& gfa = *gfaPointer;
 
     // Write the header line.
     gfa << "H\tVN:Z:1.0\n";
 
+    // The records are formatted in parallel, then written in order.
+    ParallelWriter writer(gfa, threadCount);
+
     // Write a segment record for each edge.
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+    writer.write(assemblyGraph.sequences.size(), [&](EdgeId edgeId, string& s) {
         if(assemblyGraph.edges[edgeId].wasRemoved()) {
-            continue;
+            return;
         }
 
         // Only output one of each pair of reverse complemented edges.
         if(!assemblyGraph.isAssembledEdge(edgeId)) {
-            continue;
+            return;
         }
 
         const auto sequence = assemblyGraph.sequences[edgeId];
         const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
         SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
-        gfa << "S\t" << edgeId << "\t";
+        s += "S\t" + to_string(edgeId) + "\t";
 
         // Write the sequence.
         for(size_t i=0; i<sequence.baseCount; i++) {
             const Base b = sequence[i];
             const uint8_t repeatCount = repeatCounts[i];
-            for(size_t k=0; k<repeatCount; k++) {
-                gfa << b;
-            }
+            s.append(repeatCount, b.character());
         }
 
         // Write "number of reads" as average edge coverage
         // times number of bases.
         const uint32_t averageEdgeCoverage =
             assemblyGraph.edges[edgeId].averageEdgeCoverage;
-        gfa << "\tRC:i:" << averageEdgeCoverage * sequence.baseCount;
+        s += "\tRC:i:" + to_string(averageEdgeCoverage * sequence.baseCount);
 
-        gfa << "\n";
-    }
+        s += "\n";
+    });
 
 
     // Write GFA links.
@@ -1063,8 +1509,8 @@ void Assembler::writeGfa1(const string& fileName)
     // Therefore each assembly graph vertex generates a number of
     // links equal to the product of its in-degree and out-degree.
     const size_t k = assemblerInfo->k;
-    string cigarString;
-    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
+    writer.write(assemblyGraph.vertices.size(), [&](VertexId vertexId, string& s) {
+        string cigarString;
 
         // In-edges.
         const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
@@ -1146,16 +1592,16 @@ void Assembler::writeGfa1(const string& fileName)
                 }
 
                 // Write out the link record for this edge.
-                gfa << "L\t" <<
-                    edge0Out << "\t" <<
-                    (reverse0 ? "-" : "+") << "\t" <<
-                    edge1Out << "\t" <<
-                    (reverse1 ? "-" : "+") << "\t" <<
-                    cigarString << "\n";
+                s += "L\t" +
+                    to_string(edge0Out) + "\t" +
+                    (reverse0 ? "-" : "+") + "\t" +
+                    to_string(edge1Out) + "\t" +
+                    (reverse1 ? "-" : "+") + "\t" +
+                    cigarString + "\n";
             }
         }
 
-    }
+    });
     performanceLog << timestamp << "writeGfa1 ends" << endl;
 }
 
@@ -1164,7 +1610,7 @@ void Assembler::writeGfa1(const string& fileName)
 // Write the assembly graph in GFA 1.0 format defined here:
 // https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
 // This version writes a GFA file containing both strands.
-void Assembler::writeGfa1BothStrands(const string& fileName)
+void Assembler::writeGfa1BothStrands(const string& fileName, size_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     using VertexId = AssemblyGraph::VertexId;
@@ -1172,15 +1618,20 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
 
     performanceLog << timestamp << "writeGfa1BothStrands begins" << endl;
 
-    ofstream gfa(fileName);
+    // If the file name ends with .gz, this uses BGZF compression.
+    const auto gfaPointer = openOutputFile(fileName, threadCount);
+    ostream& gfa = *gfaPointer;
 
     // Write the header line.
     gfa << "H\tVN:Z:1.0\n";
 
+    // The records are formatted in parallel, then written in order.
+    ParallelWriter writer(gfa, threadCount);
+
     // Write a segment record for each edge.
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+    writer.write(assemblyGraph.sequences.size(), [&](EdgeId edgeId, string& s) {
         if(assemblyGraph.edges[edgeId].wasRemoved()) {
-            continue;
+            return;
         }
 
         // Get the id of the reverse complemented edge.
@@ -1188,7 +1639,7 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
 
         // Write the name to make it easy to keep track of reverse
         // complemented edges.
-        gfa << "S\t" << edgeId << "\t";
+        s += "S\t" + to_string(edgeId) + "\t";
 
         // Write the sequence.
         size_t sequenceLength;
@@ -1202,9 +1653,7 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
             for(size_t i=0; i<sequence.baseCount; i++) {
                 const Base b = sequence[i];
                 const uint8_t repeatCount = repeatCounts[i];
-                for(size_t k=0; k<repeatCount; k++) {
-                    gfa << b;
-                }
+                s.append(repeatCount, b.character());
             }
         } else {
 
@@ -1219,9 +1668,7 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
                 const size_t j = sequence.baseCount - 1 - i;
                 const Base b = sequence[j].complement();
                 const uint8_t repeatCount = repeatCounts[j];
-                for(size_t k=0; k<repeatCount; k++) {
-                    gfa << b;
-                }
+                s.append(repeatCount, b.character());
             }
 
 
@@ -1231,10 +1678,9 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
         // times number of bases.
         const uint32_t averageEdgeCoverage =
             assemblyGraph.edges[edgeId].averageEdgeCoverage;
-        gfa << "\tRC:i:" << averageEdgeCoverage * sequenceLength;
-;
-        gfa << "\n";
-    }
+        s += "\tRC:i:" + to_string(averageEdgeCoverage * sequenceLength);
+        s += "\n";
+    });
 
 
     // Write GFA links.
@@ -1243,8 +1689,8 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
     // Therefore each assembly graph vertex generates a number of
     // links equal to the product of its in-degree and out-degree.
     const size_t k = assemblerInfo->k;
-    string cigarString;
-    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
+    writer.write(assemblyGraph.vertices.size(), [&](VertexId vertexId, string& s) {
+        string cigarString;
 
         // In-edges.
         const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
@@ -1309,13 +1755,13 @@ void Assembler::writeGfa1BothStrands(const string& fileName)
                 // Write out the link record for this edge.
                 // Note that in the double stranded version of GFA
                 // output all links are written with orientation ++.
-                gfa << "L\t" <<
-                    edge0 << "\t+\t" <<
-                    edge1 << "\t+\t" <<
-                    cigarString << "\n";
+                s += "L\t" +
+                    to_string(edge0) + "\t+\t" +
+                    to_string(edge1) + "\t+\t" +
+                    cigarString + "\n";
             }
         }
-    }
+    });
 
     performanceLog << timestamp << "writeGfa1BothStrands ends" << endl;
 
@@ -1331,24 +1777,28 @@ void Assembler::writeGfa1BothStrandsNoSequence(const string& fileName)
 
 
 // Write assembled sequences in FASTA format.
-void Assembler::writeFasta(const string& fileName)
+void Assembler::writeFasta(const string& fileName, size_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     using EdgeId = AssemblyGraph::EdgeId;
 
     performanceLog << timestamp << "writeFasta begins" << endl;
 
-    ofstream fasta(fileName);
+    // If the file name ends with .gz, this uses BGZF compression.
+    const auto fastaPointer = openOutputFile(fileName, threadCount);
+    ostream& fasta = *fastaPointer;
 
     // Write a sequence for each edge of the assembly graph.
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+    // The records are formatted in parallel, then written in order.
+    ParallelWriter writer(fasta, threadCount);
+    writer.write(assemblyGraph.sequences.size(), [&](EdgeId edgeId, string& s) {
         if(assemblyGraph.edges[edgeId].wasRemoved()) {
-            continue;
+            return;
         }
 
         // Only output one of each pair of reverse complemented edges.
         if(!assemblyGraph.isAssembledEdge(edgeId)) {
-            continue;
+            return;
         }
 
         const auto sequence = assemblyGraph.sequences[edgeId];
@@ -1361,16 +1811,14 @@ void Assembler::writeFasta(const string& fileName)
             length += repeatCount;
         }
 
-        fasta << ">" << edgeId << " length " << length << "\n";
+        s += ">" + to_string(edgeId) + " length " + to_string(length) + "\n";
         for(size_t i=0; i<sequence.baseCount; i++) {
             const Base b = sequence[i];
             const uint8_t repeatCount = repeatCounts[i];
-            for(size_t k=0; k<repeatCount; k++) {
-                fasta << b;
-            }
+            s.append(repeatCount, b.character());
         }
-        fasta << "\n";
-    }
+        s += "\n";
+    });
     performanceLog << timestamp << "writeFasta ends" << endl;
 
 }
@@ -1472,12 +1920,25 @@ void Assembler::colorGfaWithTwoReads(
     orientedReadIds[1] = OrientedReadId(readId1, strand1);
 
     // Find assembly graph edges for the two oriented reads.
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     vector<MarkerGraph::EdgeId> markerGraphPath;
     vector< pair<uint32_t, uint32_t> > pathOrdinals;
     array<vector<MarkerGraph::EdgeId>, 2> assemblyGraphEdges;
     for(int i=0; i<2; i++) {
         const OrientedReadId orientedReadId = orientedReadIds[i];
 
+        // If the assembly graph stores the assembly graph edges
+        // encountered by each oriented read, use them.
+        if(assemblyGraph.edgesByOrientedRead.isOpen()) {
+            assemblyGraphEdges[i].clear();
+            for(const AssemblyGraph::EdgeInfo& info:
+                assemblyGraph.edgesByOrientedRead[orientedReadId.getValue()]) {
+                assemblyGraphEdges[i].push_back(info.edgeId);
+            }
+            deduplicate(assemblyGraphEdges[i]);
+            continue;
+        }
+
         // Find marker graph edges.
         computeOrientedReadMarkerGraphPath(
             orientedReadId,
@@ -1892,45 +2353,35 @@ void Assembler::colorGfaBySimilarityToSegment(
 
 
 // Gather all oriented reads used to assembly each edge of the
-// assembly graph.
+// assembly graph (orientedReadsByEdge), and the transpose,
+// the assembly graph edges encountered by each oriented read
+// (edgesByOrientedRead).
 void Assembler::gatherOrientedReadsByAssemblyGraphEdge(size_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using EdgeInfo = AssemblyGraph::EdgeInfo;
 
     // Adjust the numbers of threads, if necessary.
     if(threadCount == 0) {
         threadCount = std::thread::hardware_concurrency();
     }
 
-    assemblyGraph.orientedReadsByEdge.createNew(
-        largeDataName("PhasingGraphOrientedReads"), largeDataPageSize);
-    assemblyGraph.orientedReadsByEdge.beginPass1(assemblyGraph.edgeLists.size());
-    setupLoadBalancing(assemblyGraph.edgeLists.size(), 1);
-    runThreads(&Assembler::gatherOrientedReadsByAssemblyGraphEdgePass1, threadCount);
-    assemblyGraph.orientedReadsByEdge.beginPass2();
-    setupLoadBalancing(assemblyGraph.edgeLists.size(), 1);
-    runThreads(&Assembler::gatherOrientedReadsByAssemblyGraphEdgePass2, threadCount);
-    assemblyGraph.orientedReadsByEdge.endPass2();
-}
-
-
-
-void Assembler::gatherOrientedReadsByAssemblyGraphEdgePass1(size_t threadId)
-{
-    gatherOrientedReadsByAssemblyGraphEdgePass(1);
-}
-void Assembler::gatherOrientedReadsByAssemblyGraphEdgePass2(size_t threadId)
-{
-    gatherOrientedReadsByAssemblyGraphEdgePass(2);
-}
-void Assembler::gatherOrientedReadsByAssemblyGraphEdgePass(int pass)
-{
-    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
-
-
-    // Loop over batches assigned to this thread.
-    uint64_t begin, end;
-    while (getNextBatch(begin, end)) {
+    // The same passes also store, for each oriented read, the sequences
+    // of consecutive marker graph edges it encounters on each assembly graph edge.
+    // They are stored in arbitrary order and merged below.
+    const uint64_t orientedReadCount = 2 * reads->readCount();
+    MemoryMapped::VectorOfVectors<EdgeInfo, uint64_t> unmergedEdgesByOrientedRead;
+    unmergedEdgesByOrientedRead.createNew(
+        largeDataName("tmp-AssemblyGraphEdgesByOrientedRead"), largeDataPageSize);
+    unmergedEdgesByOrientedRead.beginPass1(orientedReadCount);
+
+    // Function that does one pass over a batch of assembly graph edges.
+    auto gatherPass = [&](int pass, uint64_t begin, uint64_t end)
+    {
+        // Vector used to find the sequences of consecutive marker graph edges
+        // encountered by each oriented read on an assembly graph edge.
+        // Reused for all assembly graph edges in the batch.
+        vector< pair<OrientedReadId, EdgeInfo> > edgeInfos;
 
         // Loop over assembly graph edges assigned to this batch.
         for (AssemblyGraph::EdgeId assemblyGraphEdgeId = begin;
@@ -2006,10 +2457,121 @@ void Assembler::gatherOrientedReadsByAssemblyGraphEdgePass(int pass)
                 std::reverse(v.begin(), v.end());
             }
 
+
+
+            // Find the sequences of consecutive marker graph edges of this
+            // assembly graph edge encountered by each oriented read.
+            // Sequences for the same oriented read that are not consecutive
+            // on the oriented read are merged later, if no other
+            // assembly graph edge is encountered in between.
+            edgeInfos.clear();
+            for(uint32_t position=0; position<n; position++) {
+                const span<MarkerInterval> markerIntervals =
+                    markerGraph.edgeMarkerIntervals[markerGraphEdges[position]];
+                for(const MarkerInterval& markerInterval: markerIntervals) {
+                    EdgeInfo info;
+                    info.edgeId = assemblyGraphEdgeId;
+                    info.firstOrdinal = markerInterval.ordinals[0];
+                    info.lastOrdinal = markerInterval.ordinals[1];
+                    info.firstPosition = position;
+                    info.lastPosition = position;
+                    info.markerGraphEdgeCount = 1;
+                    edgeInfos.push_back(make_pair(markerInterval.orientedReadId, info));
+                }
+            }
+            sort(edgeInfos.begin(), edgeInfos.end(),
+                [](const pair<OrientedReadId, EdgeInfo>& x, const pair<OrientedReadId, EdgeInfo>& y)
+                {
+                    return tie(x.first, x.second.firstOrdinal) < tie(y.first, y.second.firstOrdinal);
+                });
+            for(uint64_t i=0; i<edgeInfos.size(); ) {
+                const OrientedReadId orientedReadId = edgeInfos[i].first;
+                EdgeInfo info = edgeInfos[i].second;
+                for(++i; i<edgeInfos.size(); ++i) {
+                    const pair<OrientedReadId, EdgeInfo>& p = edgeInfos[i];
+                    if(p.first != orientedReadId or p.second.firstOrdinal != info.lastOrdinal) {
+                        break;
+                    }
+                    info.lastOrdinal = p.second.lastOrdinal;
+                    info.lastPosition = p.second.lastPosition;
+                    ++info.markerGraphEdgeCount;
+                }
+
+                // Different assembly graph edges can contribute entries
+                // for the same oriented read, so we need the multithreaded versions.
+                if(pass == 1) {
+                    unmergedEdgesByOrientedRead.incrementCountMultithreaded(orientedReadId.getValue());
+                } else {
+                    unmergedEdgesByOrientedRead.storeMultithreaded(orientedReadId.getValue(), info);
+                }
+            }
         }
+    };
 
-    }
+    assemblyGraph.orientedReadsByEdge.createNew(
+        largeDataName("PhasingGraphOrientedReads"), largeDataPageSize);
+    assemblyGraph.orientedReadsByEdge.beginPass1(assemblyGraph.edgeLists.size());
+    const uint64_t batchSize = 10;
+    parallelFor(assemblyGraph.edgeLists.size(), batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            gatherPass(1, begin, end);
+        });
+    assemblyGraph.orientedReadsByEdge.beginPass2();
+    unmergedEdgesByOrientedRead.beginPass2();
+    parallelFor(assemblyGraph.edgeLists.size(), batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            gatherPass(2, begin, end);
+        });
+    assemblyGraph.orientedReadsByEdge.endPass2();
+    unmergedEdgesByOrientedRead.endPass2();
+
+
+
+    // For each oriented read, sort the entries by ordinal and merge
+    // consecutive entries for the same assembly graph edge.
+    // This is done in place, and the merged entries are then
+    // copied to edgesByOrientedRead.
+    vector<uint64_t> mergedSize(orientedReadCount);
+    parallelFor(orientedReadCount, 1000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const span<EdgeInfo> v = unmergedEdgesByOrientedRead[i];
+                sort(v.begin(), v.end());
+                uint64_t m = 0;
+                for(const EdgeInfo& info: v) {
+                    if(m > 0 and v[m-1].edgeId == info.edgeId) {
+                        EdgeInfo& previous = v[m-1];
+                        previous.lastOrdinal = info.lastOrdinal;
+                        previous.lastPosition = info.lastPosition;
+                        previous.markerGraphEdgeCount += info.markerGraphEdgeCount;
+                    } else {
+                        v[m++] = info;
+                    }
+                }
+                mergedSize[i] = m;
+            }
+        });
 
+    assemblyGraph.edgesByOrientedRead.createNew(
+        largeDataName("AssemblyGraphEdgesByOrientedRead"), largeDataPageSize);
+    assemblyGraph.edgesByOrientedRead.beginPass1(orientedReadCount);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        assemblyGraph.edgesByOrientedRead.incrementCount(i, mergedSize[i]);
+    }
+    assemblyGraph.edgesByOrientedRead.beginPass2();
+    assemblyGraph.edgesByOrientedRead.endPass2(false);
+    parallelFor(orientedReadCount, 1000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const EdgeInfo* v = unmergedEdgesByOrientedRead.begin(i);
+                copy(v, v + mergedSize[i], assemblyGraph.edgesByOrientedRead.begin(i));
+            }
+        });
+    unmergedEdgesByOrientedRead.remove();
 }
 
 
@@ -37,13 +37,14 @@ void Assembler::createReadGraphUsingPseudoPaths(
         threadCount = std::thread::hardware_concurrency();
     }
 
-    // Compute the pseudo-path of each oriented read.
+    // Compute the pseudo-path of each oriented read, if not already available,
+    // then extract its segments.
     // This vector is indexed by OrientedReadId::getValue().
+    computePseudoPaths(threadCount);
     const uint64_t readCount = reads->readCount();
     auto& pseudoPathSegments = createReadGraphUsingPseudoPathsData.pseudoPaths;
     pseudoPathSegments.resize(2*readCount);
     size_t batchSize = 1000;
-    cout << timestamp << "Computing pseudopaths for " << readCount << " reads." << endl;
     setupLoadBalancing(readCount, batchSize);
     runThreads(&Assembler::createReadGraphUsingPseudoPathsThreadFunction1, threadCount);
 
@@ -93,7 +94,7 @@ void Assembler::createReadGraphUsingPseudoPaths(
 
             // Loop over those alignments.
             for(const uint32_t alignmentId: alignmentIds) {
-                const AlignmentData& ad = alignmentData[alignmentId];
+                const CompactAlignmentData& ad = alignmentData[alignmentId];
                 const auto& info = createReadGraphUsingPseudoPathsData.alignmentInfos[alignmentId];
                 const double score = double(info.strongMatchCount) -
                     mismatchSquareFactor * double(info.mismatchCount*info.mismatchCount);
@@ -102,7 +103,7 @@ void Assembler::createReadGraphUsingPseudoPaths(
                 csv << ad.readIds[0] << ",";
                 csv << ad.readIds[1] << ",";
                 csv << (ad.isSameStrand ? "Yes" : "No") << ",";
-                csv << ad.info.markerCount << ",";
+                csv << ad.markerCount << ",";
                 csv << info.weakMatchCount << ",";
                 csv << info.strongMatchCount << ",";
                 csv << info.mismatchCount << ",";
@@ -157,19 +158,16 @@ void Assembler::createReadGraphUsingPseudoPaths(
     const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
     cout << timestamp << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
     readGraph.remove();
-    createReadGraphUsingSelectedAlignments(keepAlignment);
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
 }
 
 
 
-// Thread function used to compute pseudoPaths.
+// Thread function used to extract the segments of the stored pseudoPaths.
 void Assembler::createReadGraphUsingPseudoPathsThreadFunction1(size_t threadId)
 {
-    vector<MarkerGraph::EdgeId> path;
-    vector< pair<uint32_t, uint32_t> > pathOrdinals;
-    PseudoPath pseudoPath;
     using SegmentId = AssemblyGraphEdgeId;
-    vector< vector<SegmentId> >& pseudoPaths =
+    vector< vector<SegmentId> >& pseudoPathSegments =
         createReadGraphUsingPseudoPathsData.pseudoPaths;
 
     // Loop over all batches assigned to this thread.
@@ -180,8 +178,8 @@ void Assembler::createReadGraphUsingPseudoPathsThreadFunction1(size_t threadId)
         for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
             for(Strand strand=0; strand<2; strand++) {
                 const OrientedReadId orientedReadId(readId, strand);
-                computePseudoPath(orientedReadId, path, pathOrdinals, pseudoPath);
-                getPseudoPathSegments(pseudoPath, pseudoPaths[orientedReadId.getValue()]);
+                const span<const PseudoPathEntry> pseudoPath = pseudoPaths[orientedReadId.getValue()];
+                getPseudoPathSegments(pseudoPath, pseudoPathSegments[orientedReadId.getValue()]);
             }
         }
     }
@@ -213,7 +211,7 @@ void Assembler::createReadGraphUsingPseudoPathsThreadFunction2(size_t threadId)
 
         // Loop over all alignments in this batch.
         for(uint64_t alignmentId=begin; alignmentId!=end; alignmentId++) {
-            const AlignmentData& ad = alignmentData[alignmentId];
+            const CompactAlignmentData& ad = alignmentData[alignmentId];
             auto& info = infos[alignmentId];
 
             // Gather the two oriented reads.
@@ -231,7 +229,7 @@ void Assembler::createReadGraphUsingPseudoPathsThreadFunction2(size_t threadId)
 
             // Skip pathological case.
             if(pseudoPathSegments0.empty() or pseudoPathSegments1.empty()) {
-                info.alignedMarkerCount = ad.info.markerCount;
+                info.alignedMarkerCount = ad.markerCount;
                 info.weakMatchCount = 0;
                 info.strongMatchCount = 0;
                 info.mismatchCount = 0;
@@ -300,7 +298,7 @@ void Assembler::createReadGraphUsingPseudoPathsThreadFunction2(size_t threadId)
                 alignment.size());
 
             // Store the information for this alignment.
-            info.alignedMarkerCount = ad.info.markerCount;
+            info.alignedMarkerCount = ad.markerCount;
             info.weakMatchCount = weakMatchCount;
             info.strongMatchCount = strongMatchCount;
             info.mismatchCount = mismatchCount;
@@ -0,0 +1,116 @@
+// Early release of binary data that are no longer needed
+// by the assembly after a given stage.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "performanceLog.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <functional>
+
+
+
+// The manifest of binary data that can be released before the end
+// of the assembly. For each entry, lastConsumer is the last assembly stage
+// that uses the binary data. Binary data that are only used by
+// the http server (--command explore) are listed with the stage
+// that creates them as their last consumer.
+// Binary data not listed here are kept until the end of the assembly.
+// The release function closes the binary data, or removes them
+// if its argument is true.
+// Binary data that only live within a stage are not listed here,
+// and are removed by the code that uses them, as soon as they are no longer needed.
+void Assembler::releaseDeadData(AssemblyStage completedStage, bool removeData)
+{
+    class DeadData {
+    public:
+        string name;
+        AssemblyStage lastConsumer;
+        std::function<void(bool)> release;
+    };
+
+    const vector<DeadData> manifest = {
+
+        // Only used by the http server.
+        {"CandidateTable", AssemblyStage::alignmentCandidates,
+            [this](bool doRemove)
+            {
+                auto& v = alignmentCandidates.candidateTable;
+                if(v.isOpen()) {
+                    doRemove ? v.remove() : v.close();
+                }
+            }},
+
+        // Only used by the http server.
+        {"ReadLowHashStatistics", AssemblyStage::alignmentCandidates,
+            [this](bool doRemove)
+            {
+                auto& v = readLowHashStatistics;
+                if(v.isOpen) {
+                    doRemove ? v.remove() : v.close();
+                }
+            }},
+
+        // Used by computeAlignments with --Align.readSaturationAlignmentCount.
+        {"AlignmentCandidateFrequencies", AssemblyStage::alignments,
+            [this](bool doRemove)
+            {
+                auto& v = alignmentCandidates.frequencies;
+                if(v.isOpen) {
+                    doRemove ? v.remove() : v.close();
+                }
+            }},
+
+        // Used by computeAlignments.
+        // The assembly summaries only need the number of candidates,
+        // which are saved before release.
+        {"AlignmentCandidates", AssemblyStage::alignments,
+            [this](bool doRemove)
+            {
+                auto& v = alignmentCandidates.candidates;
+                if(v.isOpen) {
+                    releasedAlignmentCandidateCount = v.size();
+                    releasedReadAlignmentCandidateCount.clear();
+                    releasedReadAlignmentCandidateCount.resize(reads->readCount(), 0);
+                    for(const OrientedReadPair& p: v) {
+                        ++releasedReadAlignmentCandidateCount[p.readIds[0]];
+                        ++releasedReadAlignmentCandidateCount[p.readIds[1]];
+                    }
+                    doRemove ? v.remove() : v.close();
+                }
+            }},
+
+        // Used by the read graph creation functions.
+        {"AlignmentStatistics", AssemblyStage::readGraph,
+            [this](bool doRemove)
+            {
+                auto& v = alignmentStatistics;
+                if(v.isOpen()) {
+                    doRemove ? v.remove() : v.close();
+                }
+            }},
+    };
+
+    for(const DeadData& deadData: manifest) {
+        if(deadData.lastConsumer == completedStage) {
+            deadData.release(removeData);
+            performanceLog << timestamp << (removeData ? "Removed " : "Closed ") <<
+                deadData.name << " after assembly stage " <<
+                assemblyStageNames[uint64_t(completedStage)] << "." << endl;
+        }
+    }
+}
+
+
+
+uint64_t Assembler::getAlignmentCandidateCount() const
+{
+    if(alignmentCandidates.candidates.isOpen) {
+        return alignmentCandidates.candidates.size();
+    } else {
+        return releasedAlignmentCandidateCount;
+    }
+}
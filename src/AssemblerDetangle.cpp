@@ -14,7 +14,7 @@ using namespace shasta;
 
 
 // Detangle method 1
-void Assembler::detangle()
+void Assembler::detangle(size_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
 
@@ -41,39 +41,13 @@ void Assembler::detangle()
 
     // Fill in the oriented read ids of the edges.
     performanceLog << timestamp << "Filling in oriented reads." << endl;
-    BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
-        AssemblyPathGraphEdge& edge = graph[e];
-
-        // At this stage the path must be a single assembly graph edge.
-        SHASTA_ASSERT(edge.path.size() == 1);
-        const AssemblyGraph::EdgeId edgeId = edge.path.front();
-
-        // Get the marker graph edges corresponding to this assembly graph edge.
-        const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
-
-        // Loop over these marker graph edges.
-        std::set<OrientedReadId> orientedReadIds;
-        for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
-
-            // Loop over the marker intervals of this marker graph edge.
-            const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-            for(const MarkerInterval& markerInterval: markerIntervals) {
-                orientedReadIds.insert(markerInterval.orientedReadId);
-            }
-        }
+    graph.fillOrientedReadIds(assemblyGraph, markerGraph, threadCount);
 
-        // Copy the oriented read ids to the AssemblyPathGraphEdge.
-        copy(orientedReadIds.begin(), orientedReadIds.end(),
-            back_inserter(edge.orientedReadIds));
-
-        // Also store the path length, measured on the marker graph.
-        edge.pathLength = markerGraphEdgeIds.size();
-    }
 
 
     // Create the tangles.
     performanceLog << timestamp << "Creating the tangles." << endl;
-    graph.createTangles();
+    graph.createTangles(threadCount);
 
     // Do the detangling.
     const double basesPerMarker =
@@ -310,7 +284,8 @@ void Assembler::detangle()
 void Assembler::detangle2(
     uint64_t diagonalReadCountMin,
     uint64_t offDiagonalReadCountMax,
-    double detangleOffDiagonalRatio
+    double detangleOffDiagonalRatio,
+    size_t threadCount
     )
 {
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
@@ -342,40 +317,13 @@ void Assembler::detangle2(
 
     // Fill in the oriented read ids of the edges.
     performanceLog << timestamp << "Filling in oriented reads." << endl;
-    BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
-        AssemblyPathGraph2Edge& edge = graph[e];
-
-        // At this stage the path must be a single assembly graph edge.
-        SHASTA_ASSERT(edge.path.size() == 1);
-        const AssemblyGraph::EdgeId edgeId = edge.path.front();
-
-        // Get the marker graph edges corresponding to this assembly graph edge.
-        const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
-
-        // Loop over these marker graph edges.
-        std::set<OrientedReadId> orientedReadIds;
-        for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
-
-            // Loop over the marker intervals of this marker graph edge.
-            const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-            for(const MarkerInterval& markerInterval: markerIntervals) {
-                orientedReadIds.insert(markerInterval.orientedReadId);
-            }
-        }
-
-        // Copy the oriented read ids to the AssemblyPathGraphEdge.
-        copy(orientedReadIds.begin(), orientedReadIds.end(),
-            back_inserter(edge.orientedReadIds));
-
-        // Also store the path length, measured on the marker graph.
-        edge.pathLength = markerGraphEdgeIds.size();
-    }
+    graph.fillOrientedReadIds(assemblyGraph, markerGraph, threadCount);
 
 
 
     // Create the tangles.
     performanceLog << timestamp << "Creating the tangles." << endl;
-    graph.createTangles();
+    graph.createTangles(threadCount);
 
     // Do the detangling.
     const double basesPerMarker =
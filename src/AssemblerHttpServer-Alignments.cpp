@@ -2,11 +2,14 @@
 #include "Assembler.hpp"
 #include "AssemblerOptions.hpp"
 #include "AlignmentGraph.hpp"
+#include "AlignmentMatrixRenderer.hpp"
 #include "Align4.hpp"
 #include "AssemblyGraph.hpp"
 #include "Histogram.hpp"
+#include "HttpResponseCache.hpp"
 #include "LocalAlignmentGraph.hpp"
 #include "LocalAlignmentCandidateGraph.hpp"
+#include "MurmurHash2.hpp"
 #include "platformDependent.hpp"
 #include "PngImage.hpp"
 #include "ReadId.hpp"
@@ -424,6 +427,7 @@ void Assembler::exploreAlignmentCandidateGraph(
                 allowChimericReads,
                 timeout,
                 graph)) {
+            HttpResponseCache::doNotCache();
             html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
             return;
         }
@@ -437,6 +441,7 @@ void Assembler::exploreAlignmentCandidateGraph(
                 inAlignmentsRequired,
                 inReadgraphRequired,
                 graph)) {
+            HttpResponseCache::doNotCache();
             html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
             return;
         }
@@ -476,9 +481,11 @@ void Assembler::exploreAlignmentCandidateGraph(
     // Write the graph to svg directly, without using Graphviz rendering.
     ComputeLayoutReturnCode returnCode = graph.computeLayout(layoutMethod, timeout);
     if(returnCode == ComputeLayoutReturnCode::Timeout){
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout exceeded for computing graph layout. Try longer timeout or different parameters.</p>";
     }
     else if (returnCode != ComputeLayoutReturnCode::Success){
+        HttpResponseCache::doNotCache();
         html << "<p>ERROR: graph layout failed </p>";
     }
     else{
@@ -496,66 +503,31 @@ void Assembler::exploreAlignmentCandidateGraph(
 }
 
 
-/// Given an overlap map with the structure: [interval_start, interval_stop) -> {read_id_0, read_id_1, ... },
+/// Given an overlap map containing the reference interval covered by each oriented read,
 /// build the edges of a graph, one edge for each inferred overlap.
 /// Graph must have existing nodes, stored by the read ID in a vector.
 ///
 /// Method:
-/// Iterate the interval:set pairs in order and add any edges that don't exist yet in the graph
+/// The overlap map finds all pairs of oriented reads with overlapping intervals
+/// (see ReferenceOverlapMap::computeOverlaps), and each pair generates an edge,
+/// plus the reverse complemented edge to make the graph double stranded.
 ///
-/// Case 1:
-/// s1 = {a,b,c}
-/// s2 = {a,b,c,d}
-///
-/// s2 - s1 = {d}
-/// add all edges from (s2 - s1) -> s2
-///
-///
-/// Case 2:
-/// s1 = {a,b,c,d}
-/// s2 = {a,b,c}
-///
-/// s2 - s1 = {}
-/// Do nothing
-///
-///
-/// Case 3:
-/// s1 = {a,b,c}
-/// s2 = {a,b,d}
-///
-/// s2 - s1 = {d}
-/// add all edges from (s2 - s1) -> s2
-///
-void Assembler::HttpServerData::createGraphEdgesFromOverlapMap(const ReferenceOverlapMap& overlapMap){
-    set<OrientedReadId> emptySet = {};
-
-    for (auto& item: overlapMap.intervals){
-        const auto& overlaps = item.second;
-        auto& prevReadSet = emptySet;
-
-        for (auto i = begin(overlaps), e = end(overlaps); i!=e; ++i){
-//            const auto& interval = i->first;
-            auto& readSet = i->second;
-
-            for (const auto& id: readSet){
-                // If this read id is not in the previous set, it indicates that more edges need to be built
-                if (prevReadSet.count(id) == 0){
-                    for (const auto& otherId: readSet){
-                        if (otherId != id){
-                            // Won't duplicate edges if boost::adjacency_list is initialized with OutEdgesList as 'setS'
-                            referenceOverlapGraph->addEdge(id, otherId, false, false, false, false);
-
-                            // Need to make the graph double stranded
-                            auto idFlipped = OrientedReadId(id.getReadId(), 1 - id.getStrand());
-                            auto otherIdFlipped = OrientedReadId(otherId.getReadId(), 1 - otherId.getStrand());
-
-                            referenceOverlapGraph->addEdge(idFlipped, otherIdFlipped, false, false, false, false);
-                        }
-                    }
-                }
-            }
-            prevReadSet = readSet;
-        }
+void Assembler::HttpServerData::createGraphEdgesFromOverlapMap(ReferenceOverlapMap& overlapMap){
+    vector< pair<OrientedReadId, OrientedReadId> > overlaps;
+    overlapMap.computeOverlaps(0, overlaps);
+
+    for (const auto& overlap: overlaps){
+        const OrientedReadId id = overlap.first;
+        const OrientedReadId otherId = overlap.second;
+
+        // Won't duplicate edges if boost::adjacency_list is initialized with OutEdgesList as 'setS'
+        referenceOverlapGraph->addEdge(id, otherId, false, false, false, false);
+
+        // Need to make the graph double stranded
+        auto idFlipped = OrientedReadId(id.getReadId(), 1 - id.getStrand());
+        auto otherIdFlipped = OrientedReadId(otherId.getReadId(), 1 - otherId.getStrand());
+
+        referenceOverlapGraph->addEdge(idFlipped, otherIdFlipped, false, false, false, false);
     }
 }
 
@@ -1112,6 +1084,14 @@ void Assembler::exploreAlignment(
     getParameterValue(request, "markersPerPixel", markersPerPixel);
     uint64_t magnifyFactor = 1;
     getParameterValue(request, "magnifyFactor", magnifyFactor);
+    uint32_t matrixBegin0 = 0;
+    getParameterValue(request, "matrixBegin0", matrixBegin0);
+    uint32_t matrixEnd0 = std::numeric_limits<uint32_t>::max();
+    const bool matrixEnd0IsPresent = getParameterValue(request, "matrixEnd0", matrixEnd0);
+    uint32_t matrixBegin1 = 0;
+    getParameterValue(request, "matrixBegin1", matrixBegin1);
+    uint32_t matrixEnd1 = std::numeric_limits<uint32_t>::max();
+    const bool matrixEnd1IsPresent = getParameterValue(request, "matrixEnd1", matrixEnd1);
     string displayDetailsString;
     bool displayDetails = getParameterValue(request, "displayDetails", displayDetailsString);
 
@@ -1161,6 +1141,15 @@ void Assembler::exploreAlignment(
         "> markers per pixel and with each pixel magnified "
         " <input type=text name=magnifyFactor size=6 value=" << magnifyFactor <<
         "> times."
+        "<br>Only display markers "
+        "<input type=text name=matrixBegin0 size=6 value=" << matrixBegin0 <<
+        "> to <input type=text name=matrixEnd0 size=6" <<
+        (matrixEnd0IsPresent ? " value=" + to_string(matrixEnd0) : "") <<
+        "> of the first read and markers "
+        "<input type=text name=matrixBegin1 size=6 value=" << matrixBegin1 <<
+        "> to <input type=text name=matrixEnd1 size=6" <<
+        (matrixEnd1IsPresent ? " value=" + to_string(matrixEnd1) : "") <<
+        "> of the second read (leave the ends empty to display to the end of the reads)."
         "<br><input type=checkbox name=displayDetails" << (displayDetails ? " checked=checked" : "") <<
         "> Display alignment details"
         "</form>";
@@ -1259,18 +1248,59 @@ void Assembler::exploreAlignment(
 
     if(displayMatrix) {
 
-        // Create an image of the alignment matrix in Alignment.png.
+        // Get the AlignmentMatrixRenderer for this alignment.
+        // If the last request displayed the same alignment, reuse its
+        // renderer, so only the tiles not already cached are rasterized.
         vector<MarkerWithOrdinal> sortedMarkers0;
         vector<MarkerWithOrdinal> sortedMarkers1;
         getMarkersSortedByKmerId(orientedReadId0, sortedMarkers0);
         getMarkersSortedByKmerId(orientedReadId1, sortedMarkers1);
-        AlignmentGraph::writeImage(
-            sortedMarkers0,
-            sortedMarkers1,
-            alignment,
-            markersPerPixel,
-            magnifyFactor,
-            "Alignment.png");
+        const uint32_t n0 = uint32_t(sortedMarkers0.size());
+        const uint32_t n1 = uint32_t(sortedMarkers1.size());
+        const string rendererKey =
+            orientedReadId0.getString() + "-" + orientedReadId1.getString() + "-" +
+            to_string(MurmurHash64A(alignment.ordinals.data(),
+                int(alignment.ordinals.size() * sizeof(alignment.ordinals.front())), 757));
+        shared_ptr<AlignmentMatrixRenderer> renderer;
+        {
+            std::lock_guard<std::mutex> lock(httpServerData.alignmentMatrixRendererMutex);
+            if(httpServerData.alignmentMatrixRenderer and
+                httpServerData.alignmentMatrixRendererKey == rendererKey) {
+                renderer = httpServerData.alignmentMatrixRenderer;
+            }
+        }
+        if(not renderer) {
+            renderer = AlignmentGraph::createAlignmentMatrixRenderer(
+                sortedMarkers0, sortedMarkers1, alignment);
+            std::lock_guard<std::mutex> lock(httpServerData.alignmentMatrixRendererMutex);
+            httpServerData.alignmentMatrixRenderer = renderer;
+            httpServerData.alignmentMatrixRendererKey = rendererKey;
+        }
+
+        // The displayed portion of the matrix, with the begins
+        // rounded down to a multiple of markersPerPixel, as done by the renderer.
+        if(markersPerPixel < 1) {
+            markersPerPixel = 1;
+        }
+        if(magnifyFactor < 1) {
+            magnifyFactor = 1;
+        }
+        matrixEnd0 = min(matrixEnd0, n0);
+        matrixEnd1 = min(matrixEnd1, n1);
+        if(matrixBegin0 >= matrixEnd0 or matrixBegin1 >= matrixEnd1) {
+            html << "<p>The requested portion of the alignment matrix is empty.";
+            return;
+        }
+        matrixBegin0 = uint32_t((matrixBegin0 / markersPerPixel) * markersPerPixel);
+        matrixBegin1 = uint32_t((matrixBegin1 / markersPerPixel) * markersPerPixel);
+
+        // Create an image of the alignment matrix in Alignment.png.
+        renderer->render(
+            matrixBegin0, matrixEnd0,
+            matrixBegin1, matrixEnd1,
+            uint32_t(markersPerPixel),
+            uint32_t(magnifyFactor),
+            0).write("Alignment.png");
 
         // Create a base64 version of the png file.
         const string command = "base64 Alignment.png > Alignment.png.base64";
@@ -1280,27 +1310,63 @@ void Assembler::exploreAlignment(
         html <<
             "<h3>Alignment matrix</h3>"
             "<p>In the picture, horizontal positions correspond to marker ordinals on " <<
-            orientedReadId0 << " (marker 0 is on left) "
+            orientedReadId0 << " (marker " << matrixBegin0 << " is on left) "
             "and vertical positions correspond to marker ordinals on " <<
-            orientedReadId1 << " (marker 0 is on top). "
-            "Each faint line corresponds to 10 markers."
+            orientedReadId1 << " (marker " << matrixBegin1 << " is on top). "
+            "Each faint line corresponds to 10 markers. "
+            "Click on the picture to zoom in around the point clicked."
             "<p><img id=\"alignmentMatrix\" onmousemove=\"updateTitle(event)\" "
+            "onclick=\"zoomIn(event)\" "
             "src=\"data:image/png;base64,";
         ifstream png("Alignment.png.base64");
         html << png.rdbuf();
 
         // Adjust the tooltip dynamically to follow the mouse.
+        // Zoom in by a factor of two when the picture is clicked,
+        // by halving the number of markers per pixel or, if that is
+        // already 1, doubling the magnify factor.
         html << "\"/>"
             "<script>"
-            "function updateTitle(e)"
+            "function markerAt(e)"
             "{"
             "    var element = document.getElementById(\"alignmentMatrix\");"
             "    var rectangle = element.getBoundingClientRect();"
-            "    var x = Math.round((" << markersPerPixel << " * (e.clientX - Math.round(rectangle.left))) / " << magnifyFactor << ");"
-            "    var y = Math.round((" << markersPerPixel << " * (e.clientY - Math.round(rectangle.top))) / " << magnifyFactor << ");"
-            "    element.title = " <<
-            "\"" << orientedReadId0 << " marker \" + x + \", \" + "
-            "\"" << orientedReadId1 << " marker \" + y;"
+            "    var x = " << matrixBegin0 << " + Math.round((" << markersPerPixel << " * (e.clientX - Math.round(rectangle.left))) / " << magnifyFactor << ");"
+            "    var y = " << matrixBegin1 << " + Math.round((" << markersPerPixel << " * (e.clientY - Math.round(rectangle.top))) / " << magnifyFactor << ");"
+            "    return [x, y];"
+            "}"
+            "function updateTitle(e)"
+            "{"
+            "    var xy = markerAt(e);"
+            "    document.getElementById(\"alignmentMatrix\").title = " <<
+            "\"" << orientedReadId0 << " marker \" + xy[0] + \", \" + "
+            "\"" << orientedReadId1 << " marker \" + xy[1];"
+            "}"
+            "function zoomRange(center, span, n)"
+            "{"
+            "    var begin = Math.max(0, Math.min(center - Math.floor(span / 2), n - span));"
+            "    return [begin, Math.min(n, begin + span)];"
+            "}"
+            "function zoomIn(e)"
+            "{"
+            "    var xy = markerAt(e);"
+            "    var parameters = new URLSearchParams(window.location.search);"
+            "    var markersPerPixel = " << markersPerPixel << ";"
+            "    var magnifyFactor = " << magnifyFactor << ";"
+            "    if(markersPerPixel > 1) {"
+            "        markersPerPixel = Math.floor(markersPerPixel / 2);"
+            "    } else {"
+            "        magnifyFactor = 2 * magnifyFactor;"
+            "    }"
+            "    var range0 = zoomRange(xy[0], Math.max(1, Math.ceil(" << matrixEnd0 - matrixBegin0 << " / 2)), " << n0 << ");"
+            "    var range1 = zoomRange(xy[1], Math.max(1, Math.ceil(" << matrixEnd1 - matrixBegin1 << " / 2)), " << n1 << ");"
+            "    parameters.set(\"markersPerPixel\", markersPerPixel);"
+            "    parameters.set(\"magnifyFactor\", magnifyFactor);"
+            "    parameters.set(\"matrixBegin0\", range0[0]);"
+            "    parameters.set(\"matrixEnd0\", range0[1]);"
+            "    parameters.set(\"matrixBegin1\", range1[0]);"
+            "    parameters.set(\"matrixEnd1\", range1[1]);"
+            "    window.location.search = parameters.toString();"
             "}"
             "</script>";
     }
@@ -2347,6 +2413,10 @@ void Assembler::assessAlignments(
 
     showAlignmentResults = getParameterValue(request, "showAlignmentResults", showAlignmentResultsString);
     useDeadEnds = getParameterValue(request, "useDeadEnds", useDeadEndsString);
+    if(useDeadEnds and not assemblyGraphPointer) {
+        throw runtime_error("Sampling reads from dead ends requires the assembly graph, "
+            "which is not available.");
+    }
 
     // Get alignment parameters.
     computeAllAlignmentsData.method = httpServerData.assemblerOptions->alignOptions.alignMethod;
@@ -2751,7 +2821,7 @@ void Assembler::computeAllAlignmentsThreadFunction(size_t threadId)
 
     // Align4-specific items.
     Align4::Options align4Options;
-    MemoryMapped::ByteAllocator byteAllocator;
+    Align4::Workspace align4Workspace;
     if(method == 4) {
         align4Options.deltaX = align4DeltaX;
         align4Options.deltaY = align4DeltaY;
@@ -2766,9 +2836,6 @@ void Assembler::computeAllAlignmentsThreadFunction(size_t threadId)
         align4Options.matchScore = matchScore;
         align4Options.mismatchScore = mismatchScore;
         align4Options.gapScore = gapScore;
-        byteAllocator.createNew(
-            largeDataName("tmp-ByteAllocator-" + to_string(threadId)),
-            largeDataPageSize, 2ULL * 1024 * 1024 * 1024);
     }
 
     // Vectors to contain markers sorted by kmerId.
@@ -2820,10 +2887,9 @@ void Assembler::computeAllAlignmentsThreadFunction(size_t threadId)
                     } else if(method == 4) {
                         alignOrientedReads4(orientedReadId0, orientedReadId1,
                             align4Options,
-                            byteAllocator,
+                            align4Workspace,
                             alignment, alignmentInfo,
                             false);
-                        SHASTA_ASSERT(byteAllocator.isEmpty());
                     } else {
                         SHASTA_ASSERT(0);
                     }
@@ -2984,7 +3050,9 @@ void Assembler::exploreAlignmentGraph(
     // Create the local alignment graph.
     LocalAlignmentGraph graph;
     if(!createLocalAlignmentGraph(orientedReadId,
-        minAlignedMarkerCount, maxTrim, maxDistance, timeout, graph)) {
+        minAlignedMarkerCount, maxTrim, maxDistance, timeout, graph,
+        std::thread::hardware_concurrency())) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -3006,9 +3074,11 @@ void Assembler::exploreAlignmentGraph(
     // Write the graph to svg directly, without using Graphviz rendering.
     ComputeLayoutReturnCode returnCode = graph.computeLayout("sfdp", timeout);
     if(returnCode == ComputeLayoutReturnCode::Timeout){
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout exceeded for computing graph layout. Try longer timeout or different parameters.</p>";
     }
     else if (returnCode != ComputeLayoutReturnCode::Success){
+        HttpResponseCache::doNotCache();
         html << "<p>ERROR: graph layout failed </p>";
     }
     else{
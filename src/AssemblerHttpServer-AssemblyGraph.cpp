@@ -1,6 +1,7 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "AssembledSegment.hpp"
+#include "HttpResponseCache.hpp"
 #include "LocalAssemblyGraph.hpp"
 #include "platformDependent.hpp"
 using namespace shasta;
@@ -56,6 +57,7 @@ void Assembler::exploreAssemblyGraph(
         requestParameters.maxDistance,
         requestParameters.timeout,
         graph)) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -64,6 +66,7 @@ void Assembler::exploreAssemblyGraph(
 
     const auto createFinishTime = steady_clock::now();
     if(seconds(createFinishTime - createStartTime) > requestParameters.timeout) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -90,6 +93,7 @@ void Assembler::exploreAssemblyGraph(
     if(WIFEXITED(commandStatus)) {
         const int exitStatus = WEXITSTATUS(commandStatus);
         if(exitStatus == 124) {
+            HttpResponseCache::doNotCache();
             html << "<p>Timeout for graph layout exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
             std::filesystem::remove(dotFileName);
             return;
@@ -1,6 +1,7 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "CompressedAssemblyGraph.hpp"
+#include "HttpResponseCache.hpp"
 #include "platformDependent.hpp"
 #include "runCommandWithTimeout.hpp"
 #include "timestamp.hpp"
@@ -181,16 +182,19 @@ void Assembler::exploreCompressedAssemblyGraph(
     runCommandWithTimeout(command, timeout,
         timeoutTriggered, signalOccurred, returnCode);
     if(signalOccurred) {
+        HttpResponseCache::doNotCache();
         html << "<p>Unable to compute graph layout: terminated by a signal. "
             "The failing Command was: <code>" << command << "</code>";
         return;
     }
     if(timeoutTriggered) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout exceeded during graph layout computation. "
             "Increase the timeout or decrease the maximum distance to simplify the graph";
         return;
     }
     if(returnCode!=0 ) {
+        HttpResponseCache::doNotCache();
         html << "<p>Unable to compute graph layout: return code " << returnCode <<
             ". The failing Command was: <code>" << command << "</code>";
         return;
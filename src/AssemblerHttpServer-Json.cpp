@@ -0,0 +1,414 @@
+// JSON endpoints of the Assembler http server.
+// They provide programmatic access to the same information
+// displayed by the html pages.
+// The keyword of each request begins with "/api/".
+// Each response is a JSON object which contains one page of items:
+// {"total": ..., "begin": ..., "end": ..., "next": ..., "items": [...]}
+// The page is selected with parameters begin (default 0)
+// and count (default 1000, at most 100000).
+// "next" is the begin value for the next page, or null if this was the last page.
+// The items are written to the output as they are generated,
+// without storing the entire response in memory.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "mode3.hpp"
+#include "Reads.hpp"
+#include "ReadSequenceIndex.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cmath>
+#include <iomanip>
+
+
+
+namespace shasta {
+    class JsonPage;
+}
+
+
+
+// The range of items to be returned by a request.
+class shasta::JsonPage {
+public:
+    uint64_t total;
+    uint64_t begin;
+    uint64_t end;
+
+    JsonPage(const vector<string>& request, uint64_t total) :
+        total(total)
+    {
+        begin = 0;
+        HttpServer::getParameterValue(request, "begin", begin);
+        uint64_t count = 1000;
+        HttpServer::getParameterValue(request, "count", count);
+        count = min(count, uint64_t(100000));
+
+        begin = min(begin, total);
+        end = begin + min(count, total - begin);
+    }
+
+    // Write the beginning of the response, up to the opening
+    // bracket of the items array.
+    // If not empty, extraFields is written before the other fields
+    // and must end with a comma.
+    void writeBegin(ostream& json, const string& extraFields = "") const
+    {
+        json << "{" << extraFields << "\"total\":" << total <<
+            ",\"begin\":" << begin <<
+            ",\"end\":" << end <<
+            ",\"next\":";
+        if(end < total) {
+            json << end;
+        } else {
+            json << "null";
+        }
+        json << ",\"items\":[\n";
+    }
+
+    // Write the separator that precedes an item.
+    void writeSeparator(ostream& json, uint64_t i) const
+    {
+        if(i != begin) {
+            json << ",\n";
+        }
+    }
+
+    static void writeEnd(ostream& json)
+    {
+        json << "\n]}\n";
+    }
+};
+
+
+
+void Assembler::writeJsonString(ostream& json, const span<const char>& s)
+{
+    json << '"';
+    for(const char c: s) {
+        switch(c) {
+        case '"':
+            json << "\\\"";
+            break;
+        case '\\':
+            json << "\\\\";
+            break;
+        case '\n':
+            json << "\\n";
+            break;
+        case '\r':
+            json << "\\r";
+            break;
+        case '\t':
+            json << "\\t";
+            break;
+        default:
+            if((unsigned char)(c) < 0x20) {
+                json << "\\u" << std::hex << std::setw(4) << std::setfill('0') <<
+                    int(c) << std::dec << std::setfill(' ');
+            } else {
+                json << c;
+            }
+        }
+    }
+    json << '"';
+}
+
+
+
+void Assembler::writeJsonString(ostream& json, const string& s)
+{
+    writeJsonString(json, span<const char>(s.data(), s.size()));
+}
+
+
+
+// The list of available endpoints.
+void Assembler::jsonIndex(const vector<string>&, ostream& json)
+{
+    json << "{\"endpoints\":[";
+    bool isFirst = true;
+    for(const auto& p: httpServerData.jsonFunctionTable) {
+        if(p.first == "/api/" or p.first == "/api/index") {
+            continue;
+        }
+        if(not isFirst) {
+            json << ",";
+        }
+        isFirst = false;
+        writeJsonString(json, p.first);
+    }
+    json << "]}\n";
+}
+
+
+
+// Reads.
+// Optional parameter readName returns only the read with that name.
+void Assembler::jsonReads(const vector<string>& request, ostream& json)
+{
+    const Reads& reads = getReads();
+    const bool markersAreOpen = markers.isOpen();
+
+    string readName;
+    vector<ReadId> selectedReadIds;
+    const bool readNameIsPresent = getParameterValue(request, "readName", readName);
+    if(readNameIsPresent) {
+        const ReadId readId = reads.getReadId(readName);
+        if(readId != invalidReadId) {
+            selectedReadIds.push_back(readId);
+        }
+    }
+
+    const JsonPage page(request, readNameIsPresent ? selectedReadIds.size() : reads.readCount());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const ReadId readId = readNameIsPresent ? selectedReadIds[i] : ReadId(i);
+        const ReadFlags& flags = reads.getFlags(readId);
+
+        json << "{\"id\":" << readId << ",\"name\":";
+        writeJsonString(json, reads.getReadName(readId));
+        json <<
+            ",\"rawLength\":" << reads.getReadRawSequenceLength(readId) <<
+            ",\"length\":" << reads.getRead(readId).baseCount;
+        if(markersAreOpen) {
+            json << ",\"markerCount\":" << markers.size(OrientedReadId(readId, 0).getValue());
+        }
+        json <<
+            ",\"isPalindromic\":" << (flags.isPalindromic ? "true" : "false") <<
+            ",\"isChimeric\":" << (flags.isChimeric ? "true" : "false") <<
+            ",\"isDuplicate\":" << (flags.isDuplicate ? "true" : "false") <<
+            ",\"discardDueToDuplicates\":" << (flags.discardDueToDuplicates ? "true" : "false") <<
+            "}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Occurrences of a sequence and its reverse complement in the reads.
+// Requires the read sequence index. Parameters:
+// sequence: the sequence to be found.
+// maxHitCount (default 100000): stop after finding this many occurrences.
+// The response also contains "isComplete", which is false
+// if the search stopped because of maxHitCount.
+void Assembler::jsonReadSequenceHits(const vector<string>& request, ostream& json)
+{
+    const shared_ptr<ReadSequenceIndex> index = getReadSequenceIndex();
+    if(not index) {
+        throw runtime_error("The read sequence index is not available.");
+    }
+
+    vector<Base> sequence;
+    getSearchSequence(request, sequence);
+    uint64_t maxHitCount = 100000;
+    getParameterValue(request, "maxHitCount", maxHitCount);
+
+    vector<ReadSequenceIndex::Hit> hits;
+    const bool isComplete = index->find(sequence, maxHitCount, hits);
+
+    const JsonPage page(request, hits.size());
+    page.writeBegin(json, string("\"isComplete\":") + (isComplete ? "true," : "false,"));
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const ReadSequenceIndex::Hit& hit = hits[i];
+        json <<
+            "{\"readId\":" << hit.orientedReadId.getReadId() <<
+            ",\"strand\":" << hit.orientedReadId.getStrand() <<
+            ",\"position\":" << hit.position <<
+            "}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Alignment candidates found by the LowHash algorithm.
+void Assembler::jsonAlignmentCandidates(const vector<string>& request, ostream& json)
+{
+    checkAlignmentCandidatesAreOpen();
+    const auto& candidates = alignmentCandidates.candidates;
+
+    const JsonPage page(request, candidates.size());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const OrientedReadPair& candidate = candidates[i];
+        json <<
+            "{\"id\":" << i <<
+            ",\"readId0\":" << candidate.readIds[0] <<
+            ",\"readId1\":" << candidate.readIds[1] <<
+            ",\"isSameStrand\":" << (candidate.isSameStrand ? "true" : "false") <<
+            "}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Stored alignments.
+// Optional parameter readId returns only the alignments involving that read.
+void Assembler::jsonAlignments(const vector<string>& request, ostream& json)
+{
+    checkAlignmentDataAreOpen();
+
+    ReadId readId = 0;
+    const bool readIdIsPresent = getParameterValue(request, "readId", readId);
+    span<const uint32_t> selectedAlignmentIds;
+    if(readIdIsPresent) {
+        if(readId >= getReads().readCount()) {
+            throw runtime_error("Invalid read id " + to_string(readId));
+        }
+        if(not alignmentTable.isOpen()) {
+            throw runtime_error("The alignment table is not accessible.");
+        }
+        selectedAlignmentIds = alignmentTable[OrientedReadId(readId, 0).getValue()];
+    }
+
+    const JsonPage page(request, readIdIsPresent ? selectedAlignmentIds.size() : alignmentData.size());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const uint64_t alignmentId = readIdIsPresent ? selectedAlignmentIds[i] : i;
+        const AlignmentData alignment = getAlignmentData(alignmentId);
+        const AlignmentInfo& info = alignment.info;
+        json <<
+            "{\"id\":" << alignmentId <<
+            ",\"readId0\":" << alignment.readIds[0] <<
+            ",\"readId1\":" << alignment.readIds[1] <<
+            ",\"isSameStrand\":" << (alignment.isSameStrand ? "true" : "false") <<
+            ",\"markerCount\":" << info.markerCount <<
+            ",\"minOrdinalOffset\":" << info.minOrdinalOffset <<
+            ",\"maxOrdinalOffset\":" << info.maxOrdinalOffset <<
+            ",\"averageOrdinalOffset\":" << info.averageOrdinalOffset <<
+            ",\"maxSkip\":" << info.maxSkip <<
+            ",\"maxDrift\":" << info.maxDrift <<
+            ",\"isInReadGraph\":" << (info.isInReadGraph ? "true" : "false");
+        for(uint64_t j=0; j<2; j++) {
+            const AlignmentInfo::Data& data = info.data[j];
+            json <<
+                ",\"markerCount" << j << "\":" << data.markerCount <<
+                ",\"firstOrdinal" << j << "\":" << data.firstOrdinal <<
+                ",\"lastOrdinal" << j << "\":" << data.lastOrdinal;
+        }
+        json << "}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Marker graph vertices.
+// Each marker is written as [readId, strand, ordinal].
+void Assembler::jsonMarkerGraphVertices(const vector<string>& request, ostream& json)
+{
+    checkMarkersAreOpen();
+    checkMarkerGraphVerticesAreAvailable();
+
+    const JsonPage page(request, markerGraph.vertexCount());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const span<const MarkerId> markerIds = markerGraph.getVertexMarkerIds(i);
+        json << "{\"id\":" << i << ",\"coverage\":" << markerIds.size() << ",\"markers\":[";
+        for(uint64_t j=0; j<markerIds.size(); j++) {
+            if(j != 0) {
+                json << ",";
+            }
+            const auto p = findMarkerId(markerIds[j]);
+            json << "[" << p.first.getReadId() << "," << p.first.getStrand() << "," << p.second << "]";
+        }
+        json << "]}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Marker graph edges.
+void Assembler::jsonMarkerGraphEdges(const vector<string>& request, ostream& json)
+{
+    checkMarkerGraphEdgesIsOpen();
+    const bool coverageIsAvailable = markerGraph.edgeMarkerIntervals.isOpen();
+
+    const JsonPage page(request, markerGraph.edges.size());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        const MarkerGraph::Edge& edge = markerGraph.edges[i];
+        json <<
+            "{\"id\":" << i <<
+            ",\"source\":" << edge.source <<
+            ",\"target\":" << edge.target;
+        if(coverageIsAvailable) {
+            json << ",\"coverage\":" << markerGraph.edgeCoverage(i);
+        }
+        json <<
+            ",\"wasRemoved\":" << (edge.wasRemoved() ? "true" : "false") <<
+            ",\"wasAssembled\":" << (edge.wasAssembled ? "true" : "false") <<
+            ",\"isSecondary\":" << (edge.isSecondary ? "true" : "false") <<
+            "}";
+    }
+    page.writeEnd(json);
+}
+
+
+
+// Segments of the mode 3 assembly graph.
+void Assembler::jsonMode3Segments(const vector<string>& request, ostream& json)
+{
+    if(not assemblyGraph3Pointer) {
+        throw runtime_error("The mode 3 assembly graph is not available.");
+    }
+    const mode3::AssemblyGraph& assemblyGraph = *assemblyGraph3Pointer;
+    const bool coverageIsAvailable = assemblyGraph.segmentCoverage.isOpen;
+    const bool sequenceIsAvailable = assemblyGraph.segmentSequences.isOpen();
+    const bool backSegmentsAreAvailable = assemblyGraph.isBackSegment.isOpen;
+    const bool linksAreAvailable =
+        assemblyGraph.links.isOpen and
+        assemblyGraph.linksBySource.isOpen() and
+        assemblyGraph.linksByTarget.isOpen();
+
+    const JsonPage page(request, assemblyGraph.markerGraphPaths.size());
+    page.writeBegin(json);
+    for(uint64_t i=page.begin; i<page.end; i++) {
+        page.writeSeparator(json, i);
+        json << "{\"id\":" << i << ",\"markerGraphEdgeCount\":" << assemblyGraph.markerGraphPaths.size(i);
+        if(coverageIsAvailable) {
+            // Make sure not to write a nan to json - it is not allowed.
+            const float coverage = assemblyGraph.segmentCoverage[i];
+            json << ",\"coverage\":";
+            if(std::isfinite(coverage)) {
+                json << coverage;
+            } else {
+                json << "null";
+            }
+        }
+        if(sequenceIsAvailable) {
+            json << ",\"sequenceLength\":" << assemblyGraph.segmentSequences.size(i);
+        }
+        if(backSegmentsAreAvailable) {
+            json << ",\"isBackSegment\":" << (assemblyGraph.isBackSegment[i] ? "true" : "false");
+        }
+        if(linksAreAvailable) {
+            json << ",\"children\":[";
+            bool isFirst = true;
+            for(const uint64_t linkId: assemblyGraph.linksBySource[i]) {
+                json << (isFirst ? "" : ",") << assemblyGraph.links[linkId].segmentId1;
+                isFirst = false;
+            }
+            json << "],\"parents\":[";
+            isFirst = true;
+            for(const uint64_t linkId: assemblyGraph.linksByTarget[i]) {
+                json << (isFirst ? "" : ",") << assemblyGraph.links[linkId].segmentId0;
+                isFirst = false;
+            }
+            json << "]";
+        }
+        json << "}";
+    }
+    page.writeEnd(json);
+}
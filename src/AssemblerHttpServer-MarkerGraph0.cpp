@@ -5,11 +5,13 @@
 #include "ConsensusCaller.hpp"
 #include "Coverage.hpp"
 #include "hsv.hpp"
+#include "HttpResponseCache.hpp"
 #include "InducedAlignment.hpp"
 #include "LocalMarkerGraph0.hpp"
 #include "MarkerConnectivityGraph.hpp"
 #include "MurmurHash2.hpp"
 #include "platformDependent.hpp"
+#include "SpoaEnginePool.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -93,7 +95,9 @@ void Assembler::exploreMarkerGraph0(
         requestParameters.useSuperBubbleEdges,
         requestParameters.useLowCoverageCrossEdges,
         requestParameters.useRemovedSecondaryEdges,
-        graph)) {
+        graph,
+        requestParameters.edgeLabels > 0)) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -104,6 +108,7 @@ void Assembler::exploreMarkerGraph0(
     vector< pair<shasta::Base, int> > sequence;
     const auto createFinishTime = steady_clock::now();
     if(requestParameters.timeout>0 && seconds(createFinishTime - createStartTime) > requestParameters.timeout) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -133,6 +138,7 @@ void Assembler::exploreMarkerGraph0(
     if(WIFEXITED(commandStatus)) {
         const int exitStatus = WEXITSTATUS(commandStatus);
         if(exitStatus == 124) {
+            HttpResponseCache::doNotCache();
             html << "<p>Timeout for graph layout exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
             std::filesystem::remove(dotFileName);
             return;
@@ -1282,19 +1288,12 @@ void Assembler::exploreMarkerGraphEdge(const vector<string>& request, ostream& h
     uint8_t spoaOverlappingBaseCount;
     ComputeMarkerGraphEdgeConsensusSequenceUsingSpoaDetail spoaDetail;
 
-    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
-    const int8_t match = 1;
-    const int8_t mismatch = -1;
-    const int8_t gap = -1;
-    auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
-    spoa::Graph spoaAlignmentGraph = {};
-    spoaAlignmentGraph.Clear();
+    SpoaEnginePool spoaEnginePool;
 
     computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
         edgeId,
         markerGraphEdgeLengthThresholdForConsensus,
-        spoaAlignmentEngine,
-        spoaAlignmentGraph,
+        spoaEnginePool,
         spoaSequence,
         spoaRepeatCounts,
         spoaOverlappingBaseCount,
@@ -1893,11 +1892,11 @@ void Assembler::followReadInMarkerGraph(
     vector< vector<uint32_t> > alignedOrdinals1Matrix; // alignedOrdinals1Matrix[i][ordinal0] = ordinal1;
     const auto alignmentTable0 = alignmentTable[orientedReadId0.getValue()];
     for(const auto alignmentId: alignmentTable0) {
-        const AlignmentData& ad = alignmentData[alignmentId];
+        const CompactAlignmentData& ad = alignmentData[alignmentId];
 
         // If this alignment is not in the read graph and only read graph alignments
         // were requested, skip it.
-        if((whichAlignments=="ReadGraphAlignments") and (not ad.info.isInReadGraph)) {
+        if((whichAlignments=="ReadGraphAlignments") and (not ad.isInReadGraph)) {
             continue;
         }
 
@@ -1910,7 +1909,7 @@ void Assembler::followReadInMarkerGraph(
         const span<char> compressedAlignment = compressedAlignments[alignmentId];
         const span<const char> constCompressedAlignment(compressedAlignment.begin(), compressedAlignment.end());
         decompress(constCompressedAlignment, alignment);
-        SHASTA_ASSERT(alignment.ordinals.size() == ad.info.markerCount);
+        SHASTA_ASSERT(alignment.ordinals.size() == ad.markerCount);
 
         // Swap the reads, if necessary.
         bool swapReads = false;
@@ -1930,7 +1929,7 @@ void Assembler::followReadInMarkerGraph(
         const OrientedReadId orientedReadId1 = alignmentOrientedReadId1;
         const uint32_t markerCount1 = uint32_t(markers.size(orientedReadId1.getValue()));
         orientedReadIds1.push_back(orientedReadId1);
-        isInReadGraph.push_back(ad.info.isInReadGraph);
+        isInReadGraph.push_back(ad.isInReadGraph);
 
         // Store aligned ordinals of orientedReadId1.
         alignedOrdinals1Matrix.resize(orientedReadIds1.size());
@@ -2213,6 +2212,7 @@ void Assembler::exploreMarkerConnectivity(
     if(WIFEXITED(commandStatus)) {
         const int exitStatus = WEXITSTATUS(commandStatus);
         if(exitStatus == 124) {
+            HttpResponseCache::doNotCache();
             html << "<p>Timeout for graph layout exceeded.";
             std::filesystem::remove(dotFileName);
             return;
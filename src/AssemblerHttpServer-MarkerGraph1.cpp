@@ -3,6 +3,7 @@
 #include "html.hpp"
 #include "invalid.hpp"
 #include "LocalMarkerGraph1.hpp"
+#include "MarkerGraphNeighborhoodIndex.hpp"
 #include "platformDependent.hpp"
 #include "Reads.hpp"
 using namespace shasta;
@@ -14,6 +15,30 @@ using namespace shasta;
 
 // Standard library.
 #include "fstream.hpp"
+#include <thread>
+
+
+
+void Assembler::createMarkerGraphNeighborhoodIndex(uint64_t threadCount)
+{
+    if(not (
+        markerGraph.verticesPointer and
+        markerGraph.vertices().isOpen() and
+        markerGraph.edges.isOpen and
+        markerGraph.edgeMarkerIntervals.isOpen() and
+        markerGraph.edgesBySource.isOpen() and
+        markerGraph.edgesByTarget.isOpen())) {
+        cout << "The marker graph is not available. "
+            "The marker graph neighborhood index will not be created." << endl;
+        return;
+    }
+
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    httpServerData.markerGraphNeighborhoodIndex =
+        make_shared<MarkerGraphNeighborhoodIndex>(markerGraph, threadCount);
+}
 
 
 
@@ -229,6 +254,14 @@ void Assembler::exploreMarkerGraph1(
        (outputType == "svg" ? " checked=on" : "") <<
        ">Display vertices and edges, interactive ";
 
+    html <<
+       "<br><input type=radio name=outputType value='canvas'" <<
+       (outputType == "canvas" ? " checked=on" : "") <<
+       ">Display vertices and edges using canvas, interactive ";
+    writeInformationIcon(html, "Uses canvas instead of svg, with pan and zoom. "
+        "Edges are displayed as straight lines and read following is not supported. "
+        "Best for large subgraphs that are too slow to display using svg.");
+
 
     html <<
         "</table>"
@@ -258,7 +291,8 @@ void Assembler::exploreMarkerGraph1(
         vertexId,
         maxDistance,
         minVertexCoverage,
-        minEdgeCoverage);
+        minEdgeCoverage,
+        httpServerData.markerGraphNeighborhoodIndex.get());
 
     // Do the requested graph cleanup.
     if(maxPruneCoverage > 0) {
@@ -284,6 +318,11 @@ void Assembler::exploreMarkerGraph1(
         graph.writeHtml0(html, sizePixels, layoutQuality, timeout, true);
     }
 
+    else if(outputType == "canvas") {
+        graph.writeHtml2(html, sizePixels, thicknessScaling, layoutQuality,
+            coloring, redCoverage, greenCoverage, timeout);
+    }
+
     else if(outputType == "svg") {
         graph.writeHtml1(html, sizePixels, thicknessScaling, layoutQuality, edgeResolution,
             coloring, redCoverage, greenCoverage,
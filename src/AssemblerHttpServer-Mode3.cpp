@@ -6,6 +6,7 @@
 #include "mode3-LocalAssemblyGraph.hpp"
 #include "mode3-SegmentPairInformation.hpp"
 #include "PngImage.hpp"
+#include "SpoaEnginePool.hpp"
 using namespace shasta;
 using namespace mode3;
 
@@ -1010,10 +1011,12 @@ void Assembler::exploreMode3LinkAssembly(
     assemblyPathLink.nextPrimarySegmentId = nextPrimarySegmentId;
 
     // Do the assembly.
+    SpoaEnginePool spoaEnginePool;
     AssemblyPath::assembleNonTrivialLink(
         assemblyGraph,
         segment0,
         segment1,
         assemblyPathLink,
+        spoaEnginePool,
         html);
 }
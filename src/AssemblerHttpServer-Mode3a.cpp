@@ -161,7 +161,11 @@ void Assembler::exploreMode3aAssemblyGraph(
         localAssemblyGraph.computeSegmentTangents();
 
         // Display the local assembly graph.
-        localAssemblyGraph.writeHtml(html, options, snapshotIndex);
+        if(options.displayMethod == "canvas") {
+            localAssemblyGraph.writeCanvas(html, options, snapshotIndex);
+        } else {
+            localAssemblyGraph.writeHtml(html, options, snapshotIndex);
+        }
     }
 
 
@@ -1,6 +1,7 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "AssemblerOptions.hpp"
+#include "HttpResponseCache.hpp"
 #include "LocalReadGraph.hpp"
 #include "orderPairs.hpp"
 #include "platformDependent.hpp"
@@ -312,7 +313,8 @@ void Assembler::exploreUndirectedReadGraph(
     if(!createLocalReadGraph(readIds,
         maxDistance,
         allowChimericReads, allowCrossStrandEdges, allowInconsistentAlignmentEdges,
-        timeout, graph)) {
+        timeout, graph, std::thread::hardware_concurrency())) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout for graph creation exceeded. Increase the timeout or reduce the maximum distance from the start vertex.";
         return;
     }
@@ -496,9 +498,11 @@ void Assembler::exploreUndirectedReadGraph(
     // Write the graph to svg directly, without using Graphviz rendering.
     ComputeLayoutReturnCode returnCode = graph.computeLayout(layoutMethod, timeout);
     if(returnCode == ComputeLayoutReturnCode::Timeout){
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout exceeded for computing graph layout. Try longer timeout or different parameters.</p>";
     }
     else if (returnCode != ComputeLayoutReturnCode::Success){
+        HttpResponseCache::doNotCache();
         html << "<p>ERROR: graph layout failed </p>";
     }
     else{
@@ -554,9 +558,9 @@ void Assembler::exploreUndirectedReadGraph(
             const uint64_t alignmentId12 = globalEdge12.alignmentId;
             const uint64_t alignmentId20 = globalEdge20.alignmentId;
 
-            const AlignmentInfo alignmentInfo01 = alignmentData[alignmentId01].orient(orientedReadId0, orientedReadId1);
-            const AlignmentInfo alignmentInfo12 = alignmentData[alignmentId12].orient(orientedReadId1, orientedReadId2);
-            const AlignmentInfo alignmentInfo20 = alignmentData[alignmentId20].orient(orientedReadId2, orientedReadId0);
+            const AlignmentInfo alignmentInfo01 = getAlignmentData(alignmentId01).orient(orientedReadId0, orientedReadId1);
+            const AlignmentInfo alignmentInfo12 = getAlignmentData(alignmentId12).orient(orientedReadId1, orientedReadId2);
+            const AlignmentInfo alignmentInfo20 = getAlignmentData(alignmentId20).orient(orientedReadId2, orientedReadId0);
 
             html << "<tr>"
                 "<td class=centered>" << orientedReadId0 <<
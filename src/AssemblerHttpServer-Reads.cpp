@@ -1,10 +1,15 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "deduplicate.hpp"
+#include "html.hpp"
 #include "orderPairs.hpp"
 #include "Reads.hpp"
+#include "ReadSequenceIndex.hpp"
 using namespace shasta;
 
+// Standard library.
+#include <thread>
+
 
 
 void Assembler::exploreRead(
@@ -1134,3 +1139,169 @@ void Assembler::exploreReadRaw(
 
 }
 
+
+
+
+shared_ptr<ReadSequenceIndex> Assembler::getReadSequenceIndex()
+{
+    std::lock_guard<std::mutex> lock(httpServerData.readSequenceIndexMutex);
+    return readSequenceIndex;
+}
+
+
+
+// Get the sequence to be searched from the request.
+// Blanks and newlines (for example from copy and paste) are ignored.
+void Assembler::getSearchSequence(
+    const vector<string>& request,
+    vector<Base>& sequence) const
+{
+    string sequenceString;
+    getParameterValue(request, "sequence", sequenceString);
+
+    sequence.clear();
+    for(const char c: sequenceString) {
+        if(c==' ' or c=='\n' or c=='\r' or c=='\t' or c=='+') {
+            continue;
+        }
+        sequence.push_back(Base::fromCharacter(c));
+    }
+}
+
+
+
+// Find reads by name prefix or by sequence.
+void Assembler::searchReads(
+    const vector<string>& request,
+    ostream& html)
+{
+    const Reads& reads = getReads();
+
+    // Get the request parameters.
+    string readNamePrefix;
+    getParameterValue(request, "readNamePrefix", readNamePrefix);
+    string sequenceString;
+    getParameterValue(request, "sequence", sequenceString);
+    uint64_t maxHitCount = 1000;
+    getParameterValue(request, "maxHitCount", maxHitCount);
+    string createIndexString;
+    const bool createIndex = getParameterValue(request, "createIndex", createIndexString);
+    uint64_t step = 16;
+    getParameterValue(request, "step", step);
+
+    // Create the read sequence index, if requested.
+    // This does not block other requests, except other requests
+    // to create the index.
+    if(createIndex) {
+        static std::mutex createMutex;
+        std::lock_guard<std::mutex> createLock(createMutex);
+        if(not getReadSequenceIndex()) {
+            const shared_ptr<ReadSequenceIndex> newReadSequenceIndex =
+                make_shared<ReadSequenceIndex>(reads, step, std::thread::hardware_concurrency(), *this);
+            std::lock_guard<std::mutex> lock(httpServerData.readSequenceIndexMutex);
+            readSequenceIndex = newReadSequenceIndex;
+        }
+    }
+    const shared_ptr<ReadSequenceIndex> index = getReadSequenceIndex();
+
+
+
+    // Write the form.
+    html <<
+        "<h1>Search reads</h1>"
+        "<form>"
+        "<table>"
+        "<tr><th class=left>Read name prefix<td class=left>"
+        "<input type=text name=readNamePrefix size=60 value='" << readNamePrefix << "'>"
+        "<tr><th class=left>Sequence<td class=left>"
+        "<textarea name=sequence rows=4 cols=60>" << sequenceString << "</textarea>"
+        "<tr><th class=left>Maximum number of hits<td class=left>"
+        "<input type=text name=maxHitCount size=8 value=" << maxHitCount << ">"
+        "</table>"
+        "<input type=submit value='Search'>"
+        "</form>";
+
+    if(index) {
+        html << "<p>The read sequence index contains " << index->size() <<
+            " k-mers (step " << index->step() << ")."
+            " Sequences must have at least " << index->minSequenceLength() << " bases";
+        if(reads.representation == 1) {
+            html << " in run-length representation";
+        }
+        html << ".";
+    } else {
+        html <<
+            "<p>Searching by sequence requires the read sequence index, which was not created."
+            "<form>"
+            "<input type=hidden name=createIndex value=on>"
+            "<input type=submit value='Create the read sequence index'> with step "
+            "<input type=text name=step size=4 value=" << step << ">";
+        writeInformationIcon(html,
+            "The index contains one k-mer every step bases of each read "
+            "and uses about 12/step bytes per base. "
+            "It is stored with the binary data and only needs to be created once. "
+            "Sequences to be searched must have at least 15+step bases.");
+        html << "</form>";
+    }
+
+
+
+    // Search by name prefix.
+    if(not readNamePrefix.empty()) {
+        vector<ReadId> readIds;
+        const bool isComplete = reads.findReadsByNamePrefix(readNamePrefix, maxHitCount, readIds);
+        html << "<h2>Reads with name beginning with " << readNamePrefix << "</h2>";
+        if(not isComplete) {
+            html << "<p>Only the first " << maxHitCount << " reads are shown.";
+        }
+        html << "<table><tr><th>Read id<th>Name<th>Length";
+        for(const ReadId readId: readIds) {
+            const auto readName = reads.getReadName(readId);
+            html <<
+                "<tr><td class=centered><a href='exploreRead?readId=" << readId <<
+                "&strand=0'>" << readId << "</a>"
+                "<td class=left>" << string(readName.begin(), readName.end()) <<
+                "<td class=centered>" << reads.getReadRawSequenceLength(readId);
+        }
+        html << "</table>";
+    }
+
+
+
+    // Search by sequence.
+    if(not sequenceString.empty()) {
+        if(not index) {
+            throw runtime_error("The read sequence index is not available.");
+        }
+        vector<Base> sequence;
+        getSearchSequence(request, sequence);
+
+        vector<ReadSequenceIndex::Hit> hits;
+        const bool isComplete = index->find(sequence, maxHitCount, hits);
+
+        html << "<h2>Occurrences of the sequence and its reverse complement</h2>";
+        if(not isComplete) {
+            html << "<p>The search stopped after finding " << maxHitCount << " occurrences.";
+        } else {
+            html << "<p>Found " << hits.size() << " occurrences.";
+        }
+        html << "<table><tr><th>Oriented<br>read id<th>Name<th>Position";
+        for(const ReadSequenceIndex::Hit& hit: hits) {
+            const ReadId readId = hit.orientedReadId.getReadId();
+            const Strand strand = hit.orientedReadId.getStrand();
+            const auto readName = reads.getReadName(readId);
+            html << "<tr><td class=centered><a href='exploreRead?readId=" << readId <<
+                "&strand=" << strand;
+            if(reads.representation == 0) {
+                html <<
+                    "&beginPosition=" << hit.position <<
+                    "&endPosition=" << hit.position + sequence.size();
+            }
+            html <<
+                "'>" << hit.orientedReadId << "</a>"
+                "<td class=left>" << string(readName.begin(), readName.end()) <<
+                "<td class=centered>" << hit.position;
+        }
+        html << "</table>";
+    }
+}
@@ -4,9 +4,11 @@
 #include "AssemblyGraph.hpp"
 #include "filesystem.hpp"
 #include "Coverage.hpp"
+#include "HttpResponseCache.hpp"
 #include "buildId.hpp"
 #include "platformDependent.hpp"
 #include "Reads.hpp"
+#include "SlowItemTracer.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -218,8 +220,10 @@ void Assembler::fillServerFunctionTable()
     httpServerData.functionTable["/index"]  = &Assembler::exploreSummary;
 
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreSummary);
+    SHASTA_ADD_TO_FUNCTION_TABLE(exploreMemoryUsage);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreRead);
     SHASTA_ADD_TO_FUNCTION_TABLE(blastRead);
+    SHASTA_ADD_TO_FUNCTION_TABLE(searchReads);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreAlignments);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreAlignmentCoverage);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreAlignment);
@@ -260,6 +264,17 @@ void Assembler::fillServerFunctionTable()
 
     SHASTA_ADD_TO_FUNCTION_TABLE(fillMode3bAssemblyPathStep);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreMode3bPathGraph);
+
+    // JSON endpoints.
+    httpServerData.jsonFunctionTable["/api/"] = &Assembler::jsonIndex;
+    httpServerData.jsonFunctionTable["/api/index"] = &Assembler::jsonIndex;
+    httpServerData.jsonFunctionTable["/api/reads"] = &Assembler::jsonReads;
+    httpServerData.jsonFunctionTable["/api/readSequenceHits"] = &Assembler::jsonReadSequenceHits;
+    httpServerData.jsonFunctionTable["/api/alignmentCandidates"] = &Assembler::jsonAlignmentCandidates;
+    httpServerData.jsonFunctionTable["/api/alignments"] = &Assembler::jsonAlignments;
+    httpServerData.jsonFunctionTable["/api/markerGraphVertices"] = &Assembler::jsonMarkerGraphVertices;
+    httpServerData.jsonFunctionTable["/api/markerGraphEdges"] = &Assembler::jsonMarkerGraphEdges;
+    httpServerData.jsonFunctionTable["/api/mode3Segments"] = &Assembler::jsonMode3Segments;
 }
 #undef SHASTA_ADD_TO_FUNCTION_TABLE
 
@@ -304,6 +319,70 @@ void Assembler::processRequest(
 
 
 
+    // If the data are accessed lazily, access the data
+    // needed by this request, if not already done.
+    // When exploring an assembly that is still running,
+    // also access the data of stages that completed since the previous request,
+    // then refuse requests that need data from stages that did not complete.
+    std::shared_lock<std::shared_mutex> dataAccessLock;
+    if(httpServerData.liveAssembly or httpServerData.lazyAccess) {
+        dataAccessLock = accessRequestData(keyword);
+    }
+    bool allStagesAreAvailable = true;
+    if(httpServerData.liveAssembly) {
+        const uint64_t availableCount = availableStageCount();
+        allStagesAreAvailable = (assemblerInfo->completedStageCount() == assemblyStageCount);
+        const uint64_t requiredCount = stageRequirement(keyword).requiredStageCount;
+        if(requiredCount > availableCount) {
+            string message = "This request needs the data created by assembly stage " +
+                assemblyStageNames[requiredCount - 1] + ", which has not completed yet. ";
+            if(assemblerInfo->completedStageCount() < httpServerData.accessedStageCount) {
+                message += "The assembly was resumed after the http server started. "
+                    "Restart the http server after the assembly completes.";
+            } else {
+                message += "Retry after that stage of the assembly completes.";
+            }
+            if(keyword.compare(0, 5, "/api/") == 0) {
+                html << "Content-Type: application/json\r\n\r\n";
+                html << "{\"error\":";
+                writeJsonString(html, message);
+                html << "}\n";
+            } else {
+                writeHtmlBegin(html);
+                writeNavigation(html);
+                html << "<p>" << message;
+                writeHtmlEnd(html);
+            }
+            return;
+        }
+    }
+
+
+
+    // Process a JSON request.
+    // If there is an error, the response is a JSON object
+    // containing the error message.
+    // The JSON functions check their parameters
+    // before they start writing output.
+    if(keyword.compare(0, 5, "/api/") == 0) {
+        html << "Content-Type: application/json\r\n\r\n";
+        const auto it = httpServerData.jsonFunctionTable.find(keyword);
+        try {
+            if(it == httpServerData.jsonFunctionTable.end()) {
+                throw runtime_error("Unsupported keyword " + keyword);
+            }
+            const auto function = it->second;
+            (this->*function)(request, html);
+        } catch(const std::exception& e) {
+            html << "{\"error\":";
+            writeJsonString(html, string(e.what()));
+            html << "}\n";
+        }
+        return;
+    }
+
+
+
     // Look up the keyword to find the function that will process this request.
     // Note that the keyword includes the initial "/".
     const auto it = httpServerData.functionTable.find(keyword);
@@ -318,15 +397,82 @@ void Assembler::processRequest(
 
     // We found the keyword. Call the function that processes this keyword.
     // The processing function is only responsible for writing the html body.
-    writeHtmlBegin(html);
-    writeNavigation(html);
-    try {
-        const auto function = it->second;
-        (this->*function)(request, html);
-    } catch(const std::exception& e) {
-        html << "<br><br><span style='color:purple'>" << e.what() << "</span>";
+    // If the response is cacheable, it is written to a string first,
+    // so it can be stored in the cache.
+    const auto writeResponse = [&](ostream& s)
+    {
+        writeHtmlBegin(s);
+        writeNavigation(s);
+        try {
+            const auto function = it->second;
+            (this->*function)(request, s);
+        } catch(const std::exception& e) {
+            HttpResponseCache::doNotCache();
+            s << "<br><br><span style='color:purple'>" << e.what() << "</span>";
+        }
+        writeHtmlEnd(s);
+    };
+
+    HttpResponseCache* cache = httpServerData.responseCache.get();
+    if(cache and isCacheable(keyword) and allStagesAreAvailable) {
+        const string key = HttpResponseCache::key(request);
+        string response;
+        if(cache->get(key, response)) {
+            cout << "Using cached response." << endl;
+        } else {
+            HttpResponseCache::beginRequest();
+            std::ostringstream s;
+            writeResponse(s);
+            response = s.str();
+            if(HttpResponseCache::isCacheable()) {
+                cache->put(key, response);
+            }
+        }
+        html << response;
+    } else {
+        writeResponse(html);
     }
-    writeHtmlEnd(html);
+}
+
+
+
+// Pages that are cached if a response cache is available.
+// These are the pages that compute a local graph and its layout.
+// Their response only depends on the request, because
+// in explore mode the assembly data don't change.
+bool Assembler::isCacheable(const string& keyword)
+{
+    static const std::set<string> cacheableKeywords = {
+        "/exploreAlignmentCandidateGraph",
+        "/exploreAlignmentGraph",
+        "/exploreReadGraph",
+        "/exploreMarkerGraph0",
+        "/exploreMarkerGraph1",
+        "/exploreAssemblyGraph",
+        "/exploreCompressedAssemblyGraph",
+        "/exploreMode3AssemblyGraph",
+        "/exploreMode3aAssemblyGraph",
+        "/exploreMode3bPathGraph"
+    };
+    return cacheableKeywords.contains(keyword);
+}
+
+
+
+// Requests are processed concurrently by the HttpServer worker threads.
+// Most pages only read assembly data, but these pages
+// use the threads of the Assembler (MultithreadedObject)
+// or reuse results saved by the previous request,
+// so they cannot run concurrently with other requests.
+bool Assembler::requiresExclusiveAccess(const vector<string>& request) const
+{
+    static const std::set<string> exclusiveKeywords = {
+        "/computeAllAlignments",
+        "/assessAlignments",
+        "/exploreMode3AssemblyGraph",
+        "/exploreMode3aAssemblyGraph"
+    };
+    return exclusiveKeywords.contains(request.front());
 }
 
 
@@ -435,9 +581,11 @@ void Assembler::writeNavigation(ostream& html) const
 
     writeNavigation(html, "Assembly information", {
         {"Summary", "exploreSummary"},
+        {"Memory usage", "exploreMemoryUsage"},
         });
     writeNavigation(html, "Reads", {
         {"Reads", "exploreRead"},
+        {"Search reads", "searchReads"},
         });
     writeNavigation(html, "Alignments", {
         {"Candidate graph", "exploreAlignmentCandidateGraph"},
@@ -625,166 +773,242 @@ void Assembler::exploreSummary(
     const vector<string>& request,
     ostream& html)
 {
+    const uint64_t completedStageCount = assemblerInfo->completedStageCount();
+    if(httpServerData.liveAssembly and completedStageCount < assemblyStageCount) {
+        html << "<p>This assembly is still running. "
+            "Pages that need data from assembly stages that did not complete yet "
+            "are not available. Completed assembly stages: ";
+        for(uint64_t stage=0; stage<completedStageCount; stage++) {
+            html << assemblyStageNames[stage] << " ";
+        }
+    }
     writeAssemblySummaryBody(html);
 }
 
 
 
-// Access all available assembly data, without throwing exceptions
-void Assembler::accessAllSoft()
+void Assembler::exploreMemoryUsage(
+    const vector<string>& request,
+    ostream& html)
 {
+    MemoryMapped::writeMemoryUsageHtml(html);
+}
 
-    bool allDataAreAvailable = true;
 
-    try {
-        accessKmerChecker();
-    } catch(const exception& e) {
-        cout << "The k-mer checker is not accessible." << endl;
-        allDataAreAvailable = false;
-    }
 
-    try {
-        accessMarkers();
-    } catch(const exception& e) {
-        cout << "Markers are not accessible." << endl;
-        allDataAreAvailable = false;
-    }
+// Access all available assembly data, without throwing exceptions
+void Assembler::accessAllSoft()
+{
+    accessAllSoft(0, assemblyStageCount);
+}
 
-    try {
-        accessAlignmentCandidates();
-    } catch(const exception& e) {
-        cout << "Alignment candidates are not accessible." << endl;
-        allDataAreAvailable = false;
-    }
 
-    try {
-        accessAlignmentCandidateTable();
-    } catch(const exception& e) {
-        cout << "Alignment candidate table is not accessible." << endl;
-        allDataAreAvailable = false;
-    }
 
-    try {
-        accessReadLowHashStatistics();
-    } catch(const exception& e) {
-        cout << "Read alignment statistics are not accessible." << endl;
-        allDataAreAvailable = false;
-    }
+// Access all available assembly data created by
+// assembly stages beginStage through endStage-1,
+// without throwing exceptions.
+void Assembler::accessAllSoft(uint64_t beginStage, uint64_t endStage)
+{
+    const auto isIncluded = [&](AssemblyStage stage)
+    {
+        return uint64_t(stage) >= beginStage and uint64_t(stage) < endStage;
+    };
+
+    bool allDataAreAvailable = true;
 
-    try {
-        accessAlignmentData();
-    } catch(const exception& e) {
-        cout << "Alignments are not accessible." << endl;
-        allDataAreAvailable = false;
+    // The reads are accessed by the constructor.
+    // But if we are exploring an assembly that is still running,
+    // they could have been accessed before they were complete,
+    // so access them again.
+    if(httpServerData.liveAssembly and isIncluded(AssemblyStage::reads)) {
+        try {
+            reads = make_unique<Reads>();
+            reads->access(
+                assemblerInfo->readRepresentation,
+                largeDataName("Reads"),
+                largeDataName("ReadNames"),
+                largeDataName("ReadMetaData"),
+                largeDataName("ReadRepeatCounts"),
+                largeDataName("ReadFlags"),
+                largeDataName("ReadIdsSortedByName")
+            );
+        } catch(const exception& e) {
+            cout << "Reads are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
     }
 
+    if(isIncluded(AssemblyStage::markers)) {
+        try {
+            accessKmerChecker();
+        } catch(const exception& e) {
+            cout << "The k-mer checker is not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
-    // Read graph.
-    // Try accessing the undirected one first.
-    // if that is not there, try the undirected one.
-    try {
-        accessReadGraph();
-    } catch(const exception& e) {
-        cout << "The read graph is not accessible." << endl;
-        allDataAreAvailable = false;
+        try {
+            accessMarkers();
+        } catch(const exception& e) {
+            cout << "Markers are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
     }
 
+    if(isIncluded(AssemblyStage::alignmentCandidates)) {
+        try {
+            accessAlignmentCandidates();
+        } catch(const exception& e) {
+            cout << "Alignment candidates are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
+        try {
+            accessAlignmentCandidateTable();
+        } catch(const exception& e) {
+            cout << "Alignment candidate table is not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
-    try {
-        accessMarkerGraphVertices();
-    } catch(const exception& e) {
-        cout << "Marker graph vertices are not accessible." << endl;
-        allDataAreAvailable = false;
+        try {
+            accessReadLowHashStatistics();
+        } catch(const exception& e) {
+            cout << "Read alignment statistics are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
     }
 
-    try {
-        accessMarkerGraphReverseComplementVertex();
-    } catch(const exception& e) {
-        cout << "Marker graph reverse complement vertices are not accessible." << endl;
-        allDataAreAvailable = false;
-    }
+    if(isIncluded(AssemblyStage::alignments)) {
+        try {
+            accessAlignmentData();
+        } catch(const exception& e) {
+            cout << "Alignments are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
-    try {
-        accessMarkerGraphEdges(false);
-    } catch(const exception& e) {
-        cout << "Marker graph edges are not accessible." << endl;
-        allDataAreAvailable = false;
+        try {
+            accessCompressedAlignments();
+        } catch(const exception& e) {
+            cout << "Alignments are not accessible." << endl;
+            allDataAreAvailable = false;
+        }
     }
 
-    try {
-        accessMarkerGraphReverseComplementEdge();
-    } catch(const exception& e) {
-        cout << "Marker graph reverse complement edges are not accessible." << endl;
-        allDataAreAvailable = false;
-    }
 
-    try {
-        accessMarkerGraphConsensus();
-    } catch(const exception& e) {
-        cout << "MarkerGraph graph consensus is not accessible." << endl;
-        allDataAreAvailable = false;
-    }
+    // Read graph.
+    if(isIncluded(AssemblyStage::readGraph)) {
+        try {
+            accessReadGraph();
+        } catch(const exception& e) {
+            cout << "The read graph is not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
-    try {
-        accessCompressedAlignments();
-    } catch(const exception& e) {
-        cout << "Alignments are not accessible." << endl;
-        allDataAreAvailable = false;
+        // The original ReadIds are only stored if the reads were renumbered.
+        try {
+            accessOriginalReadIds();
+        } catch(const exception&) {
+        }
     }
 
 
 
-    // Data specific to assembly mode 0.
-    if(assemblerInfo->assemblyMode == 0) {
+    if(isIncluded(AssemblyStage::assembly)) {
         try {
-            accessAssemblyGraphVertices();
+            accessMarkerGraphVertices();
         } catch(const exception& e) {
-            cout << "Assembly graph vertices are not accessible." << endl;
+            cout << "Marker graph vertices are not accessible." << endl;
             allDataAreAvailable = false;
         }
 
         try {
-            accessAssemblyGraphEdges();
+            accessMarkerGraphReverseComplementVertex();
         } catch(const exception& e) {
-            cout << "Assembly graph edges are not accessible." << endl;
+            cout << "Marker graph reverse complement vertices are not accessible." << endl;
             allDataAreAvailable = false;
         }
 
         try {
-            accessAssemblyGraphEdgeLists();
+            accessMarkerGraphEdges(false);
         } catch(const exception& e) {
-            cout << "Assembly graph edge lists are not accessible." << endl;
+            cout << "Marker graph edges are not accessible." << endl;
             allDataAreAvailable = false;
         }
 
         try {
-            accessAssemblyGraphSequences();
+            accessMarkerGraphReverseComplementEdge();
         } catch(const exception& e) {
-            cout << "Assembly graph sequences are not accessible." << endl;
+            cout << "Marker graph reverse complement edges are not accessible." << endl;
             allDataAreAvailable = false;
         }
 
-    }
+        try {
+            accessMarkerGraphConsensus();
+        } catch(const exception& e) {
+            cout << "MarkerGraph graph consensus is not accessible." << endl;
+            allDataAreAvailable = false;
+        }
 
 
 
-    // Data specific to assembly mode 3.
-    if(assemblerInfo->assemblyMode == 3) {
-        try {
-            accessMode3AssemblyGraph();
-        } catch(const exception& e) {
+        // Data specific to assembly mode 0.
+        if(assemblerInfo->assemblyMode == 0) {
+            try {
+                accessAssemblyGraphVertices();
+            } catch(const exception& e) {
+                cout << "Assembly graph vertices are not accessible." << endl;
+                allDataAreAvailable = false;
+            }
+
             try {
-                accessMode3aAssemblyData();
+                accessAssemblyGraphEdges();
             } catch(const exception& e) {
-                cout << "The mode 3 assembly graph is not accessible." << endl;
+                cout << "Assembly graph edges are not accessible." << endl;
                 allDataAreAvailable = false;
             }
+
+            try {
+                accessAssemblyGraphEdgeLists();
+            } catch(const exception& e) {
+                cout << "Assembly graph edge lists are not accessible." << endl;
+                allDataAreAvailable = false;
+            }
+
+            try {
+                accessAssemblyGraphSequences();
+            } catch(const exception& e) {
+                cout << "Assembly graph sequences are not accessible." << endl;
+                allDataAreAvailable = false;
+            }
+
+        }
+
+
+
+        // Data specific to assembly mode 3.
+        if(assemblerInfo->assemblyMode == 3) {
+            try {
+                accessMode3AssemblyGraph();
+            } catch(const exception& e) {
+                try {
+                    accessMode3aAssemblyData();
+                } catch(const exception& e) {
+                    cout << "The mode 3 assembly graph is not accessible." << endl;
+                    allDataAreAvailable = false;
+                }
+            }
         }
     }
 
 
 
+    // The read sequence index is optional and is not
+    // created by default, so don't complain if it is not there.
+    if(isIncluded(AssemblyStage::reads)) {
+        if(accessReadSequenceIndex()) {
+            cout << "The read sequence index is accessible." << endl;
+        }
+    }
+
     if(!allDataAreAvailable) {
         cout << "Not all assembly data are accessible." << endl;
         cout << "Some functionality is not available." << endl;
@@ -793,6 +1017,174 @@ void Assembler::accessAllSoft()
 
 
 
+// Used to explore an assembly that is still running.
+void Assembler::accessCompletedStagesSoft()
+{
+    httpServerData.liveAssembly = true;
+    httpServerData.liveStageGeneration = assemblerInfo->getStageGeneration();
+    const uint64_t completedStageCount = assemblerInfo->completedStageCount();
+
+    cout << "This assembly is still running. Only the data of completed assembly stages "
+        "are accessible." << endl;
+    if(completedStageCount > 0) {
+        cout << "Completed assembly stages: ";
+        for(uint64_t stage=0; stage<completedStageCount; stage++) {
+            cout << assemblyStageNames[stage] << " ";
+        }
+        cout << endl;
+    }
+
+    // With lazy access, the data are accessed when needed by a request.
+    if(not httpServerData.lazyAccess) {
+        accessAllSoft(0, completedStageCount);
+        httpServerData.accessedStageCount = completedStageCount;
+    }
+}
+
+
+
+// Access the data needed to process a request with the given keyword,
+// if they were not already accessed.
+// This is only used if the data are accessed lazily
+// or if the assembly being explored is still running.
+// In the second case, the data of assembly stages that completed
+// since the previous request are also accessed, unless using lazy access.
+// This returns a lock on httpServerData.dataAccessMutex for reading,
+// which must be held while the request is processed,
+// so data are never accessed concurrently with a request.
+std::shared_lock<std::shared_mutex> Assembler::accessRequestData(const string& keyword)
+{
+    HttpServerData& data = httpServerData;
+
+    // The number of assembly stages whose data should be accessed.
+    const auto targetStageCount = [&]()
+    {
+        uint64_t n = data.lazyAccess ? stageRequirement(keyword).usedStageCount : assemblyStageCount;
+        if(data.liveAssembly) {
+            n = min(n, assemblerInfo->completedStageCount());
+        }
+        return n;
+    };
+
+    std::shared_lock<std::shared_mutex> lock(data.dataAccessMutex);
+    if(
+        (not data.liveAssembly or assemblerInfo->getStageGeneration() == data.liveStageGeneration) and
+        targetStageCount() <= data.accessedStageCount) {
+        return lock;
+    }
+    lock.unlock();
+
+    {
+        std::unique_lock<std::shared_mutex> exclusiveLock(data.dataAccessMutex);
+
+        if(data.liveAssembly) {
+            const uint64_t stageGeneration = assemblerInfo->getStageGeneration();
+            if(stageGeneration != data.liveStageGeneration) {
+                data.liveStageGeneration = stageGeneration;
+                if(assemblerInfo->assemblyIsRunning == 0) {
+                    cout << "The assembly being explored is no longer running." << endl;
+                }
+            }
+        }
+
+        // Check again, another thread could have done this while we were waiting.
+        const uint64_t n = targetStageCount();
+        if(n > data.accessedStageCount) {
+            cout << "Accessing the data of assembly stages ";
+            for(uint64_t stage=data.accessedStageCount; stage<n; stage++) {
+                cout << assemblyStageNames[stage] << " ";
+            }
+            cout << endl;
+            accessAllSoft(data.accessedStageCount, n);
+            data.accessedStageCount = n;
+        }
+    }
+
+    lock.lock();
+    return lock;
+}
+
+
+
+// Return the number of assembly stages whose data can be used
+// to process requests. All stages are available unless we are
+// exploring an assembly that is still running.
+// If the assembly was resumed while we were exploring it,
+// the stages that are running again are not available,
+// and their data are not accessed again.
+uint64_t Assembler::availableStageCount() const
+{
+    if(not httpServerData.liveAssembly) {
+        return assemblyStageCount;
+    }
+    return min(assemblerInfo->completedStageCount(), httpServerData.accessedStageCount);
+}
+
+
+
+// Return the assembly stages needed to process
+// a request with the given keyword.
+// Keywords not in the table need the complete assembly.
+Assembler::StageRequirement Assembler::stageRequirement(const string& keyword)
+{
+    // The number of stages that must be complete for
+    // pages that need data created by each stage.
+    const auto stageCount = [](AssemblyStage stage)
+    {
+        return uint64_t(stage) + 1;
+    };
+    const uint64_t reads = stageCount(AssemblyStage::reads);
+    const uint64_t markers = stageCount(AssemblyStage::markers);
+    const uint64_t alignmentCandidates = stageCount(AssemblyStage::alignmentCandidates);
+    const uint64_t alignments = stageCount(AssemblyStage::alignments);
+    const uint64_t readGraph = stageCount(AssemblyStage::readGraph);
+    const uint64_t all = assemblyStageCount;
+
+    static const std::map<string, StageRequirement> stageRequirementTable = {
+        {"", {0, 0}},
+        {"/", {0, 0}},
+        {"/index", {0, 0}},
+        {"/exploreSummary", {0, 0}},
+        {"/exploreMemoryUsage", {0, 0}},
+        {"/alignSequencesInBaseRepresentation", {0, 0}},
+        {"/api/", {0, 0}},
+        {"/api/index", {0, 0}},
+
+        // The read page also shows markers and marker graph vertices, if available.
+        {"/exploreRead", {reads, all}},
+        {"/blastRead", {reads, reads}},
+        {"/searchReads", {reads, reads}},
+        {"/api/reads", {reads, reads}},
+        {"/api/readSequenceHits", {reads, reads}},
+
+        {"/exploreAlignment", {markers, markers}},
+        {"/computeAllAlignments", {markers, markers}},
+        {"/alignSequencesInMarkerRepresentation", {markers, markers}},
+
+        {"/exploreAlignmentCandidateGraph", {alignmentCandidates, alignmentCandidates}},
+        {"/api/alignmentCandidates", {alignmentCandidates, alignmentCandidates}},
+
+        {"/exploreAlignments", {alignments, alignments}},
+        {"/exploreAlignmentCoverage", {alignments, alignments}},
+        {"/exploreAlignmentGraph", {alignments, alignments}},
+        {"/api/alignments", {alignments, alignments}},
+
+        // Sampling reads from dead ends uses the assembly graph.
+        {"/assessAlignments", {alignments, all}},
+
+        {"/exploreReadGraph", {readGraph, readGraph}},
+    };
+
+    const auto it = stageRequirementTable.find(keyword);
+    if(it == stageRequirementTable.end()) {
+        return {all, all};
+    } else {
+        return it->second;
+    }
+}
+
+
+
 
 void Assembler::writeStyle(ostream& html)
 {
@@ -1087,7 +1479,7 @@ void Assembler::writeAssemblySummaryBody(ostream& html)
         "<h3>Alignments</h3>"
         "<table>"
         "<tr><td>Number of alignment candidates found by the LowHash algorithm"
-        "<td class=right>" << alignmentCandidates.candidates.size() <<
+        "<td class=right>" << getAlignmentCandidateCount() <<
         "<tr><td>Number of good alignments"
         "<td class=right>" << alignmentData.size() <<
         "<tr><td>Number of good alignments kept in the read graph"
@@ -1258,6 +1650,11 @@ void Assembler::writeAssemblySummaryBody(ostream& html)
         "<td class=right>" << assemblerInfo->totalAvailableMemory <<
         "</table>"
         ;
+
+    if(slowItemTracingIsEnabled()) {
+        html << "<h3>Slowest work items</h3>";
+        writeSlowItemsHtml(html);
+    }
 }
 
 
@@ -1390,7 +1787,7 @@ void Assembler::writeAssemblySummaryJson(ostream& json)
         "  \"Alignments\":\n"
         "  {\n"
         "    \"Number of alignment candidates found by the LowHash algorithm\": " <<
-        alignmentCandidates.candidates.size() << ",\n"
+        getAlignmentCandidateCount() << ",\n"
         "    \"Number of good alignments\": " << alignmentData.size() << ",\n"
         "    \"Number of good alignments kept in the read graph\": " << readGraph.edges.size()/2 << "\n"
         "  },\n"
@@ -1516,6 +1913,20 @@ void Assembler::writeAssemblySummaryJson(ostream& json)
 
 
 
+    if(threadStatisticsAreEnabled()) {
+        json << "  \"Thread load balance\": ";
+        writeThreadStatisticsJson(json);
+        json << ",\n";
+    }
+
+    if(slowItemTracingIsEnabled()) {
+        json << "  \"Slowest work items\": ";
+        writeSlowItemsJson(json);
+        json << ",\n";
+    }
+
+
+
     json <<
         "  \"Performance\":\n"
         "  {\n"
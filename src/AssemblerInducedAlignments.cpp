@@ -184,6 +184,165 @@ void Assembler::computeInducedAlignments(
 
 
 
+
+// Compute induced alignments for a batch of pairs of oriented reads,
+// in parallel.
+// This is done in two phases:
+// 1. For each distinct oriented read, gather the markers that are on a
+//    marker graph vertex, with their compressed ordinals, sorted by vertex id.
+// 2. For each pair, merge the two sorted vectors.
+// This way the vertex table is only read once for each oriented read,
+// and no per pair ordinal tables are needed to fill in the compressed ordinals.
+void Assembler::computeInducedAlignments(
+    const vector< pair<OrientedReadId, OrientedReadId> >& orientedReadPairs,
+    vector<InducedAlignment>& inducedAlignments,
+    size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    inducedAlignments.clear();
+    inducedAlignments.resize(orientedReadPairs.size());
+    if(orientedReadPairs.empty()) {
+        return;
+    }
+
+    // Store pointers so all threads can see them.
+    ComputeInducedAlignmentsData& data = computeInducedAlignmentsData;
+    data.orientedReadPairs = &orientedReadPairs;
+    data.inducedAlignments = &inducedAlignments;
+
+    // Find the distinct oriented reads.
+    data.orientedReadIds.clear();
+    for(const auto& p: orientedReadPairs) {
+        data.orientedReadIds.push_back(p.first);
+        data.orientedReadIds.push_back(p.second);
+    }
+    deduplicate(data.orientedReadIds);
+    data.vertices.clear();
+    data.vertices.resize(data.orientedReadIds.size());
+    data.compressedMarkerCount.clear();
+    data.compressedMarkerCount.resize(data.orientedReadIds.size());
+
+    // Phase 1: gather the vertices of each oriented read.
+    setupLoadBalancing(data.orientedReadIds.size(), 10);
+    runThreads(&Assembler::computeInducedAlignmentsThreadFunction1, threadCount);
+
+    // Phase 2: compute the induced alignments.
+    setupLoadBalancing(orientedReadPairs.size(), 100);
+    runThreads(&Assembler::computeInducedAlignmentsThreadFunction2, threadCount);
+
+    // Clean up.
+    data.orientedReadPairs = 0;
+    data.inducedAlignments = 0;
+    data.orientedReadIds.clear();
+    data.orientedReadIds.shrink_to_fit();
+    data.vertices.clear();
+    data.vertices.shrink_to_fit();
+    data.compressedMarkerCount.clear();
+    data.compressedMarkerCount.shrink_to_fit();
+}
+
+
+
+void Assembler::computeInducedAlignmentsThreadFunction1(size_t /* threadId */)
+{
+    using VertexInfo = ComputeInducedAlignmentsData::VertexInfo;
+    ComputeInducedAlignmentsData& data = computeInducedAlignmentsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const OrientedReadId orientedReadId = data.orientedReadIds[i];
+            vector<VertexInfo>& vertices = data.vertices[i];
+
+            const MarkerId firstMarkerId = markers.begin(orientedReadId.getValue()) - markers.begin();
+            const uint32_t markerCount = uint32_t(markers.size(orientedReadId.getValue()));
+            uint32_t compressedOrdinal = 0;
+            for(uint32_t ordinal=0; ordinal<markerCount; ordinal++) {
+                const MarkerGraph::CompressedVertexId compressedVertexId =
+                    markerGraph.vertexTable[firstMarkerId + ordinal];
+                if(compressedVertexId != MarkerGraph::invalidCompressedVertexId) {
+                    const MarkerGraph::VertexId vertexId = compressedVertexId;
+                    vertices.push_back({vertexId, ordinal, compressedOrdinal++});
+                }
+            }
+            data.compressedMarkerCount[i] = compressedOrdinal;
+
+            // A stable sort keeps markers on the same vertex in ordinal order,
+            // although normally there is at most one of them.
+            std::stable_sort(vertices.begin(), vertices.end());
+        }
+    }
+}
+
+
+
+void Assembler::computeInducedAlignmentsThreadFunction2(size_t /* threadId */)
+{
+    using VertexInfo = ComputeInducedAlignmentsData::VertexInfo;
+    using Iterator = vector<VertexInfo>::const_iterator;
+    const ComputeInducedAlignmentsData& data = computeInducedAlignmentsData;
+    const vector< pair<OrientedReadId, OrientedReadId> >& orientedReadPairs = *data.orientedReadPairs;
+    vector<InducedAlignment>& inducedAlignments = *data.inducedAlignments;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const uint64_t index0 = data.getIndex(orientedReadPairs[i].first);
+            const uint64_t index1 = data.getIndex(orientedReadPairs[i].second);
+            const vector<VertexInfo>& vertices0 = data.vertices[index0];
+            const vector<VertexInfo>& vertices1 = data.vertices[index1];
+            InducedAlignment& inducedAlignment = inducedAlignments[i];
+            inducedAlignment.compressedMarkerCount[0] = data.compressedMarkerCount[index0];
+            inducedAlignment.compressedMarkerCount[1] = data.compressedMarkerCount[index1];
+
+            // Merge the two sorted vectors, looking for common vertices.
+            // As in computeInducedAlignment, each common vertex
+            // generates all pairs of markers in the two streaks.
+            const Iterator end0 = vertices0.end();
+            const Iterator end1 = vertices1.end();
+            Iterator it0 = vertices0.begin();
+            Iterator it1 = vertices1.begin();
+            while(it0 != end0 and it1 != end1) {
+                if(it0->vertexId < it1->vertexId) {
+                    ++it0;
+                    continue;
+                }
+                if(it1->vertexId < it0->vertexId) {
+                    ++it1;
+                    continue;
+                }
+                const MarkerGraph::VertexId vertexId = it0->vertexId;
+                Iterator it0End = it0;
+                Iterator it1End = it1;
+                while(it0End != end0 and it0End->vertexId == vertexId) {
+                    ++it0End;
+                }
+                while(it1End != end1 and it1End->vertexId == vertexId) {
+                    ++it1End;
+                }
+                for(Iterator jt0=it0; jt0!=it0End; ++jt0) {
+                    for(Iterator jt1=it1; jt1!=it1End; ++jt1) {
+                        InducedAlignmentData d(vertexId, jt0->ordinal, jt1->ordinal);
+                        d.compressedOrdinal0 = jt0->compressedOrdinal;
+                        d.compressedOrdinal1 = jt1->compressedOrdinal;
+                        inducedAlignment.data.push_back(d);
+                    }
+                }
+                it0 = it0End;
+                it1 = it1End;
+            }
+
+            inducedAlignment.sort();
+        }
+    }
+}
+
+
+
 // Fill in compressed ordinals of an InducedAlignment.
 // Compressed ordinals are marker ordinals in which
 // only markers associated with a marker graph vertex are counted.
@@ -1,7 +1,15 @@
 #include "Assembler.hpp"
+#include "AssemblerOptions.hpp"
 #include "LowHash0.hpp"
+#include "performanceLog.hpp"
+#include "timestamp.hpp"
 using namespace shasta;
 
+// Standard library.
+#include "chrono.hpp"
+#include <exception>
+#include <thread>
+
 
 
 // Use the LowHash algorithm to find alignment candidates.
@@ -18,7 +26,8 @@ void Assembler::findAlignmentCandidatesLowHash0(
     size_t minBucketSize,           // The minimum size for a bucket to be used.
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to become a candidate.
-    size_t threadCount)
+    size_t threadCount,
+    ReadId oldReadCount)            // If not zero, only find candidates involving ReadId oldReadCount or above.
 {
 
     // Check that we have what we need.
@@ -29,8 +38,13 @@ void Assembler::findAlignmentCandidatesLowHash0(
 
     // Create the alignment candidates.
     alignmentCandidates.candidates.createNew(largeDataName("AlignmentCandidates"), largeDataPageSize);
+    alignmentCandidates.frequencies.createNew(largeDataName("AlignmentCandidateFrequencies"), largeDataPageSize);
     readLowHashStatistics.createNew(largeDataName("ReadLowHashStatistics"), largeDataPageSize);
 
+    // Access the marker KmerIds. If they were not stored,
+    // they will be recomputed as needed.
+    const MarkerKmerIds kmerIds(assemblerInfo->k, getReads(), markers, markerKmerIds);
+
     // Run the LowHash computation to find candidate alignments.
     LowHash0 lowHash(
         m,
@@ -42,9 +56,12 @@ void Assembler::findAlignmentCandidatesLowHash0(
         maxBucketSize,
         minFrequency,
         threadCount,
+        oldReadCount,
+        1, 0, "",
         getReads(),
-        markerKmerIds,
+        kmerIds,
         alignmentCandidates.candidates,
+        alignmentCandidates.frequencies,
         readLowHashStatistics,
         largeDataFileNamePrefix,
         largeDataPageSize);
@@ -54,9 +71,208 @@ void Assembler::findAlignmentCandidatesLowHash0(
 
 
 
+// Find alignment candidates using LowHash0 and compute alignments,
+// streaming the final candidates found during the last LowHash0 iteration
+// to the alignment threads via a bounded queue.
+// The alignment threads are started before LowHash0 and block on the
+// queue until the last iteration begins, so the two computations
+// overlap only during the last pass 3 of LowHash0.
+void Assembler::findAlignmentCandidatesLowHash0AndComputeAlignments(
+    size_t m,
+    double hashFraction,
+    size_t minHashIterationCount,
+    size_t log2MinHashBucketCount,
+    size_t minBucketSize,
+    size_t maxBucketSize,
+    size_t minFrequency,
+    const AlignOptions& alignOptions,
+    size_t threadCount)
+{
+    const auto tBegin = steady_clock::now();
+
+    // Check that we have what we need.
+    reads->checkReadsAreOpen();
+    SHASTA_ASSERT(kmerChecker);
+    checkMarkersAreOpen();
+    const ReadId readCount = ReadId(markers.size() / 2);
+    SHASTA_ASSERT(readCount > 0);
+    if(minHashIterationCount == 0) {
+        throw runtime_error("Streaming of alignment candidates requires "
+            "a non-zero value of --MinHash.minHashIterationCount.");
+    }
+    if(alignOptions.readSaturationAlignmentCount > 0) {
+        throw runtime_error("Streaming of alignment candidates cannot be used "
+            "together with --Align.readSaturationAlignmentCount.");
+    }
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Create the alignment candidates.
+    alignmentCandidates.candidates.createNew(largeDataName("AlignmentCandidates"), largeDataPageSize);
+    alignmentCandidates.frequencies.createNew(largeDataName("AlignmentCandidateFrequencies"), largeDataPageSize);
+    readLowHashStatistics.createNew(largeDataName("ReadLowHashStatistics"), largeDataPageSize);
+
+    // Access the marker KmerIds. If they were not stored,
+    // they will be recomputed as needed.
+    const MarkerKmerIds kmerIds(assemblerInfo->k, getReads(), markers, markerKmerIds);
+
+    // Set up the alignment computation.
+    BoundedQueue< vector<OrientedReadPair> > candidateQueue(4 * threadCount);
+    auto& data = computeAlignmentsData;
+    data.alignOptions = &alignOptions;
+    data.candidateQueue = &candidateQueue;
+    data.streamedCandidateCount = 0;
+    data.candidateOrder.clear();
+    data.readGoodAlignmentCount.clear();
+    data.skippedCandidateCount = 0;
+    computeAlignmentsBegin(threadCount);
+    markers.advise(MemoryMapped::AccessPattern::willNeed);
+
+    // Start the alignment threads. They get their candidates from the queue.
+    performanceLog << timestamp << "Alignment computation begins." << endl;
+    std::exception_ptr alignmentException;
+    std::thread alignmentThread(
+        [this, threadCount, &alignmentException]()
+        {
+            try {
+                runThreads(&Assembler::computeAlignmentsThreadFunction, threadCount);
+            } catch(...) {
+                alignmentException = std::current_exception();
+            }
+        });
+
+    // Run the LowHash computation to find candidate alignments.
+    // Make sure the queue is closed and the alignment threads
+    // are joined even if LowHash0 throws.
+    try {
+        LowHash0 lowHash(
+            m,
+            hashFraction,
+            minHashIterationCount,
+            0.,
+            log2MinHashBucketCount,
+            minBucketSize,
+            maxBucketSize,
+            minFrequency,
+            threadCount,
+            0,
+            1, 0, "",
+            getReads(),
+            kmerIds,
+            alignmentCandidates.candidates,
+            alignmentCandidates.frequencies,
+            readLowHashStatistics,
+            largeDataFileNamePrefix,
+            largeDataPageSize,
+            &candidateQueue);
+    } catch(...) {
+        candidateQueue.close();
+        alignmentThread.join();
+        data.candidateQueue = 0;
+        throw;
+    }
+    candidateQueue.close();
+    alignmentThread.join();
+    data.candidateQueue = 0;
+    if(alignmentException) {
+        std::rethrow_exception(alignmentException);
+    }
+    alignmentCandidates.unreserve();
+    performanceLog << timestamp << "Alignment computation completed." << endl;
+    SHASTA_ASSERT(data.streamedCandidateCount == alignmentCandidates.candidates.size());
+
+    // Store the alignments.
+    computeAlignmentsEnd(threadCount);
+
+    const auto tEnd = steady_clock::now();
+    const double tTotal = seconds(tEnd - tBegin);
+    performanceLog << timestamp << "Computation of alignment candidates and alignments ";
+    performanceLog << "completed in " << tTotal << " s." << endl;
+}
+
+
+
+// Run one shard of a LowHash0 computation distributed across processes,
+// possibly on different machines that share the assembly directory.
+// Each shard uses a subset of the buckets and writes the
+// candidates it finds, with their frequencies, to shardFileName.
+// When all shards are done, use mergeAlignmentCandidateShards
+// to create the alignment candidates.
+void Assembler::findAlignmentCandidatesLowHash0Shard(
+    size_t m,                       // Number of consecutive k-mers that define a feature.
+    double hashFraction,            // Low hash threshold.
+    size_t minHashIterationCount,   // Must not be zero.
+    size_t log2MinHashBucketCount,  // Base 2 log of number of buckets for lowHash.
+    size_t minBucketSize,           // The minimum size for a bucket to be used.
+    size_t maxBucketSize,           // The maximum size for a bucket to be used.
+    uint64_t shardCount,
+    uint64_t shardId,
+    const string& shardFileName,
+    size_t threadCount)
+{
+    // Check that we have what we need.
+    SHASTA_ASSERT(kmerChecker);
+    checkMarkersAreOpen();
+
+    // The candidates and statistics of each shard are not stored.
+    MemoryMapped::Vector<OrientedReadPair> shardCandidates;
+    shardCandidates.createNew("", largeDataPageSize);
+    MemoryMapped::Vector<uint16_t> shardCandidateFrequencies;
+    shardCandidateFrequencies.createNew("", largeDataPageSize);
+    MemoryMapped::Vector< array<uint64_t, 3> > shardReadLowHashStatistics;
+    shardReadLowHashStatistics.createNew("", largeDataPageSize);
+
+    const MarkerKmerIds kmerIds(assemblerInfo->k, getReads(), markers, markerKmerIds);
+    LowHash0 lowHash(
+        m,
+        hashFraction,
+        minHashIterationCount,
+        0.,
+        log2MinHashBucketCount,
+        minBucketSize,
+        maxBucketSize,
+        1,
+        threadCount,
+        0,
+        shardCount,
+        shardId,
+        shardFileName,
+        getReads(),
+        kmerIds,
+        shardCandidates,
+        shardCandidateFrequencies,
+        shardReadLowHashStatistics,
+        largeDataFileNamePrefix,
+        largeDataPageSize);
+}
+
+
+
+void Assembler::mergeAlignmentCandidateShards(
+    const vector<string>& shardFileNames,
+    size_t minFrequency)            // Minimum number of minHash hits for a pair to become a candidate.
+{
+    alignmentCandidates.candidates.createNew(largeDataName("AlignmentCandidates"), largeDataPageSize);
+    alignmentCandidates.frequencies.createNew(largeDataName("AlignmentCandidateFrequencies"), largeDataPageSize);
+    LowHash0::mergeShards(shardFileNames, minFrequency,
+        alignmentCandidates.candidates, alignmentCandidates.frequencies);
+    alignmentCandidates.unreserve();
+}
+
+
+
 void Assembler::accessAlignmentCandidates()
 {
     alignmentCandidates.candidates.accessExistingReadOnly(largeDataName("AlignmentCandidates"));
+
+    // The frequencies are only available if the candidates were created by LowHash0.
+    try {
+        alignmentCandidates.frequencies.accessExistingReadOnly(largeDataName("AlignmentCandidateFrequencies"));
+    } catch(const exception&) {
+    }
 }
 
 void Assembler::accessAlignmentCandidateTable()
@@ -113,7 +329,7 @@ void Assembler::writeOverlappingReads(
 
     // Loop over all overlaps involving this oriented read.
     for(const uint64_t i: alignmentTable[orientedReadId0.getValue()]) {
-        const AlignmentData& ad = alignmentData[i];
+        const CompactAlignmentData& ad = alignmentData[i];
 
         // Get the other oriented read involved in this overlap.
         const OrientedReadId orientedReadId1 = ad.getOther(orientedReadId0);
@@ -190,11 +406,11 @@ void Assembler::writeAlignmentCandidates(bool useReadName, bool verbose) const
 
             // Search the AlignmentTable to see if this pair exists
             for(const ReadId alignmentIndex: alignmentTable[orientedReadId0.getValue()]) {
-                const AlignmentData& a = alignmentData[alignmentIndex];
+                const CompactAlignmentData& a = alignmentData[alignmentIndex];
 
                 // Check if the pair matches the current candidate pair of interest
                 if (a.getOther(orientedReadId0) == orientedReadId1){
-                    if (passesReadGraph2Criteria(a.info)){
+                    if (passesReadGraph2Criteria(alignmentInfos[alignmentIndex])){
                         isPassingReadGraph2Criteria = true;
                     }
                 }
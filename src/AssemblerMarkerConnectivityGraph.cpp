@@ -1,14 +1,14 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "MarkerConnectivityGraph.hpp"
+#include "parallelFor.hpp"
 using namespace shasta;
 
 // Boost libraries.
 #include <boost/graph/iteration_macros.hpp>
 
 // Standard library.
-#include <map>
-#include <queue>
+#include "tuple.hpp"
 
 
 
@@ -17,22 +17,30 @@ void Assembler::createMarkerConnectivityGraph(
     OrientedReadId orientedReadId,
     uint32_t ordinal,
     bool useReadGraphAlignmentsOnly,
-    MarkerConnectivityGraph& graph) const
+    MarkerConnectivityGraph& graph,
+    size_t threadCount) const
 {
     MarkerConnectivityGraphVertexMap vertexMap;
     createMarkerConnectivityGraph(orientedReadId, ordinal, useReadGraphAlignmentsOnly,
-        graph, vertexMap);
+        graph, vertexMap, threadCount);
 
 }
 
 
 
+// This does a BFS in the space of aligned markers, one level at a time.
+// For all the vertices in the frontier (the current BFS level),
+// the aligned markers are found in parallel, which means that
+// the alignments involved are decompressed concurrently.
+// The vertices and edges are then added in a single thread,
+// in the same order as a sequential BFS would add them.
 void Assembler::createMarkerConnectivityGraph(
     OrientedReadId orientedReadId,
     uint32_t ordinal,
     bool useReadGraphAlignmentsOnly,
     MarkerConnectivityGraph& graph,
-    MarkerConnectivityGraphVertexMap& vertexMap) const
+    MarkerConnectivityGraphVertexMap& vertexMap,
+    size_t threadCount) const
 {
 
 
@@ -41,44 +49,50 @@ void Assembler::createMarkerConnectivityGraph(
 
     // Initialize a BFS in the space of aligned markers.
     const vertex_descriptor v = add_vertex(MarkerDescriptor(orientedReadId, ordinal), graph);
-    vertexMap[MarkerDescriptor(orientedReadId, ordinal)] = v;
-    std::queue<vertex_descriptor> q;
-    q.push(v);
-
-
-
-    // BFS loop.
-    vector<MarkerDescriptor> alignedMarkers;
-    while(not q.empty()) {
-
-        // Dequeue a vertex.
-        const vertex_descriptor v0 = q.front();
-        q.pop();
-        const MarkerDescriptor markerDescriptor0 =graph[v0];
-        SHASTA_ASSERT(vertexMap[markerDescriptor0] == v0);
-
-        // Find aligned markers for this vertex.
-        findAlignedMarkers(markerDescriptor0.first, markerDescriptor0.second,
-            useReadGraphAlignmentsOnly, alignedMarkers);
-
-        for(const MarkerDescriptor& markerDescriptor1: alignedMarkers) {
-
-            // If there is no vertex for markerDescriptor1, add it and enqueue it.
-            auto it1 = vertexMap.find(markerDescriptor1);
-            if(it1 == vertexMap.end()) {
-                const vertex_descriptor v1 = add_vertex(markerDescriptor1, graph);
-                tie(it1, ignore) = vertexMap.insert(make_pair(markerDescriptor1, v1));
-                q.push(v1);
-            }
-            const vertex_descriptor v1 = it1->second;
-
-            // If there is no edge between v0 and v1, create one.
-            bool edgeExists;
-            tie(ignore, edgeExists) = edge(v0, v1, graph);
-            if(not edgeExists) {
-                add_edge(v0, v1, graph);
+    vertexMap.insert(MarkerDescriptor(orientedReadId, ordinal), v);
+    vector<vertex_descriptor> frontier(1, v);
+    vector<vertex_descriptor> nextFrontier;
+
+
+
+    // BFS loop, one level at a time.
+    vector< vector<MarkerDescriptor> > alignedMarkers;
+    while(not frontier.empty()) {
+
+        // Find aligned markers for all the vertices in the frontier.
+        alignedMarkers.resize(frontier.size());
+        parallelFor(frontier.size(), 1, threadCount,
+            [&](uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; i++) {
+                    const MarkerDescriptor markerDescriptor0 = graph[frontier[i]];
+                    findAlignedMarkers(markerDescriptor0.first, markerDescriptor0.second,
+                        useReadGraphAlignmentsOnly, alignedMarkers[i]);
+                }
+            });
+
+        nextFrontier.clear();
+        for(uint64_t i=0; i<frontier.size(); i++) {
+            const vertex_descriptor v0 = frontier[i];
+            for(const MarkerDescriptor& markerDescriptor1: alignedMarkers[i]) {
+
+                // If there is no vertex for markerDescriptor1, add it to the next frontier.
+                vertex_descriptor v1 = vertexMap.find(markerDescriptor1);
+                if(v1 == MarkerConnectivityGraph::null_vertex()) {
+                    v1 = add_vertex(markerDescriptor1, graph);
+                    vertexMap.insert(markerDescriptor1, v1);
+                    nextFrontier.push_back(v1);
+                }
+
+                // If there is no edge between v0 and v1, create one.
+                bool edgeExists;
+                tie(ignore, edgeExists) = edge(v0, v1, graph);
+                if(not edgeExists) {
+                    add_edge(v0, v1, graph);
+                }
             }
         }
+        frontier.swap(nextFrontier);
     }
 
 }
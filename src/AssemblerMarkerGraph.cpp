@@ -9,8 +9,14 @@
 #include "extractKmer.hpp"
 #include "PeakFinder.hpp"
 #include "performanceLog.hpp"
+#include "platformDependent.hpp"
 #include "LocalMarkerGraph0.hpp"
+#include "MarkerGraphEdgeArrays.hpp"
+#include "MurmurHash2.hpp"
+#include "parallelFor.hpp"
 #include "Reads.hpp"
+#include "SlowItemTracer.hpp"
+#include "SpoaEnginePool.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 
@@ -61,7 +67,14 @@ void Assembler::createMarkerGraphVertices(
 
     // Number of threads. If zero, a number of threads equal to
     // the number of virtual processors is used.
-    size_t threadCount
+    size_t threadCount,
+
+    // Number of shards used for the disjoint set computation.
+    uint64_t shardCount,
+
+    // If not zero, use external memory for the disjoint set computation,
+    // with this memory budget in GB. See createMarkerGraphVerticesExternal.
+    double externalMemoryBudget
 )
 {
 
@@ -97,77 +110,14 @@ void Assembler::createMarkerGraphVertices(
     // Initialize computation of the global marker graph.
     data.orientedMarkerCount = markers.totalSize();
 
-    data.disjointSetTable.createNew(
-        largeDataName("tmp-DisjointSetTable"),
-        largeDataPageSize);
-    // DisjointSets data structure needs an additional 64 bits per entry, in order to implement
-    // a lock-free, union-find operation. You can find more information in dset64-gccatomic.hpp.
-    // Once the set representatives have been found, we have no need for these extra 64 bits per entry.
-    //
-    // We allocate twice as much space in data.disjointSetTable so that the underlying memory
-    // can be used as an array of 128 bit integers of size data.orientedMarkerCount. This allows
-    // us to compact the data in-place, there by reducing memory usage.
-    data.disjointSetTable.reserveAndResize(data.orientedMarkerCount * 2);
-
-    // Have DisjointSets use the memory allocated in and managed by data.disjointSetTable.
-    data.disjointSetsPointer = std::make_shared<DisjointSets>(
-        reinterpret_cast<DisjointSets::Aint*>(data.disjointSetTable.begin()),
-        data.orientedMarkerCount
-    );
-
-
-
-    // Update the disjoint set data structure for each alignment
-    // in the read graph.
-    performanceLog << timestamp << "Disjoint set computation begins." << endl;
-    size_t batchSize = 10000;
-    setupLoadBalancing(readGraph.edges.size(), batchSize);
-    runThreads(&Assembler::createMarkerGraphVerticesThreadFunction1, threadCount);
-    performanceLog << timestamp << "Disjoint set computation completed." << endl;
-
-
-
-    // Find the disjoint set that each oriented marker was assigned to.
-    // Iterate till each marker has its set representative populated in the parent (lower 64 bits)
-    uint64_t pass = 1;
-    do {
-        (data.disjointSetsPointer)->parentUpdated = 0;
-        performanceLog << "    " << timestamp << " Iteration  " << pass << endl;
-        setupLoadBalancing(data.orientedMarkerCount, batchSize);
-        runThreads(&Assembler::createMarkerGraphVerticesThreadFunction2, threadCount);
-        performanceLog << "    " << timestamp << " Updated parent of - " << (data.disjointSetsPointer)->parentUpdated << " entries." << endl;
-        pass++;
-    } while ((data.disjointSetsPointer)->parentUpdated > 0 && pass <= 10);
-
-    if (pass > 10) {
-        // This should never happen. Even in a highly parallel environment (128 threads), convergence happens
-        // in 2 or 3 passes. It's definitely worth investigating if this ever happens.
-        string errorMsg = "DisjointSets parent information did not converge in " + to_string(pass) + " iterations.";
-        throw runtime_error(errorMsg);
-    }
-
-
-    performanceLog << timestamp << "Verifying convergence of parent information." << endl;
-    setupLoadBalancing(data.orientedMarkerCount, batchSize);
-    runThreads(&Assembler::createMarkerGraphVerticesThreadFunction21, threadCount);
-    performanceLog << timestamp << "Done verifying convergence of parent information." << endl;
-
-
-    // data.disjointSetTable now has the correct set representative for entry N at location 2*N.
-    // That's because DisjointSets stores parent information in the lower 64 bits of the 128 bits
-    // it uses for each entry. Since we only care about these bits, we can compact data.disjointSetTable
-    // and free up half the memory.
-    // This bit seems tricky to parallelize. It's not worth the effort as this is pretty fast as is.
-    performanceLog << timestamp << "Compacting the Disjoint Set data-structure." << endl;
-    for(uint64_t i=0; i<data.orientedMarkerCount; i++) {
-        data.disjointSetTable[i] = data.disjointSetTable[2*i];
+    // Compute the disjoint set that each oriented marker belongs to,
+    // and store it in data.disjointSetTable.
+    if(externalMemoryBudget > 0.) {
+        createMarkerGraphVerticesExternal(externalMemoryBudget, threadCount);
+    } else {
+        createMarkerGraphVerticesDisjointSets(shardCount, threadCount);
     }
-    data.disjointSetTable.resize(data.orientedMarkerCount);
-    data.disjointSetTable.unreserve();
-    performanceLog << timestamp << "Done compacting the Disjoint Set data-structure." << endl;
-
-    // Don't need the DisjointSets data-structure any more.
-    data.disjointSetsPointer = 0;
+    const size_t batchSize = 10000;
 
 
 
@@ -210,17 +160,13 @@ void Assembler::createMarkerGraphVertices(
     // each disjoint set.
     // Compute a histogram of this distribution and write it to a csv file.
     {
-        vector<uint64_t> histogram;
-        for(MarkerGraph::VertexId i=0; i<data.orientedMarkerCount; i++) {
-            const MarkerGraph::VertexId markerCount = data.workArea[i];
-            if(markerCount == 0) {
-                continue;
-            }
-            if(markerCount >= histogram.size()) {
-                histogram.resize(markerCount+1, 0);
-            }
-            ++histogram[markerCount];
-        }
+        const vector<uint64_t> histogram = parallelHistogram(
+            data.orientedMarkerCount, 1024 * 1024, threadCount,
+            [&](uint64_t i)
+            {
+                const MarkerGraph::VertexId markerCount = data.workArea[i];
+                return (markerCount == 0) ? invalid<uint64_t> : uint64_t(markerCount);
+            });
 
         ofstream csv("DisjointSetsHistogram.csv");
         csv << "Coverage,Frequency\n";
@@ -338,6 +284,10 @@ void Assembler::createMarkerGraphVertices(
     runThreads(&Assembler::createMarkerGraphVerticesThreadFunction5, threadCount);
     data.disjointSetMarkers.endPass2();
 
+    // The disjoint set of each marker can now be obtained from
+    // data.disjointSetMarkers, so we no longer need data.disjointSetTable.
+    data.disjointSetTable.remove();
+
 
 
     // Sort the markers in each disjoint set.
@@ -423,24 +373,27 @@ void Assembler::createMarkerGraphVertices(
 
     // Compute the final disjoint set number for each marker.
     // That becomes the vertex id assigned to that marker.
+    // Markers not in any disjoint set, or in a bad one, get no vertex.
     // This could be multithreaded.
     performanceLog << timestamp << "Assigning vertex ids to markers." << endl;
     markerGraph.vertexTable.createNew(
         largeDataName("MarkerGraphVertexTable"),
         largeDataPageSize);
     markerGraph.vertexTable.reserveAndResize(data.orientedMarkerCount);
-    for(MarkerGraph::VertexId markerId=0;
-        markerId<data.orientedMarkerCount; ++markerId) {
-        auto oldValue = data.disjointSetTable[markerId];
-        if(oldValue == MarkerGraph::invalidVertexId) {
-            markerGraph.vertexTable[markerId] = MarkerGraph::invalidCompressedVertexId;
-        } else {
-        	markerGraph.vertexTable[markerId] = data.workArea[oldValue];
+    fill(markerGraph.vertexTable.begin(), markerGraph.vertexTable.end(),
+        MarkerGraph::invalidCompressedVertexId);
+    for(MarkerGraph::VertexId oldDisjointSetId=0;
+        oldDisjointSetId<disjointSetCount; ++oldDisjointSetId) {
+        const auto newValue = data.workArea[oldDisjointSetId];
+        if(newValue == MarkerGraph::invalidVertexId) {
+            continue;
+        }
+        for(const MarkerId markerId: data.disjointSetMarkers[oldDisjointSetId]) {
+            markerGraph.vertexTable[markerId] = newValue;
         }
     }
 
     data.workArea.remove();
-    data.disjointSetTable.remove();
 
 
     // Store the disjoint sets that are not marked bad.
@@ -520,91 +473,342 @@ void Assembler::createMarkerGraphVertices(
 
 
 
-void Assembler::createMarkerGraphVerticesThreadFunction1(size_t threadId)
-{
+// Consumer of aligned marker pairs that merges them in a DisjointSets data structure.
+namespace shasta {
+    class DisjointSetsConsumer : public Assembler::AlignedMarkerPairConsumer {
+    public:
+        DisjointSetsConsumer(DisjointSets& disjointSets) : disjointSets(disjointSets) {}
+        void consume(size_t, span<const Assembler::AlignedMarkerPair> alignedMarkerPairs)
+        {
+            disjointSets.uniteBatch(alignedMarkerPairs.begin(), alignedMarkerPairs.end());
+        }
+    private:
+        DisjointSets& disjointSets;
+    };
+}
+
 
-    array<vector<MarkerWithOrdinal>, 2> markersSortedByKmerId;
-    AlignmentGraph graph;
-    Alignment alignment;
-    AlignmentInfo alignmentInfo;
 
+// Use a lock-free DisjointSets data structure to compute the disjoint set
+// that each oriented marker belongs to, and store it in data.disjointSetTable.
+// This is used by createMarkerGraphVertices when not using external memory.
+void Assembler::createMarkerGraphVerticesDisjointSets(
+    uint64_t shardCount,
+    size_t threadCount)
+{
     auto& data = createMarkerGraphVerticesData;
-    const std::shared_ptr<DisjointSets> disjointSetsPointer = data.disjointSetsPointer;
 
-    const auto& storedAlignments = compressedAlignments;
-    uint64_t alignmentId;
+    data.disjointSetTable.createNew(
+        largeDataName("tmp-DisjointSetTable"),
+        largeDataPageSize);
+    // DisjointSets data structure needs an additional 64 bits per entry, in order to implement
+    // a lock-free, union-find operation. You can find more information in dset64-gccatomic.hpp.
+    // Once the set representatives have been found, we have no need for these extra 64 bits per entry.
+    //
+    // We allocate twice as much space in data.disjointSetTable so that the underlying memory
+    // can be used as an array of 128 bit integers of size data.orientedMarkerCount. This allows
+    // us to compact the data in-place, there by reducing memory usage.
+    //
+    // The memory is not initialized here. Instead, it is initialized
+    // below using multiple threads, so on a NUMA machine
+    // each page is placed on the NUMA node of the thread that first touches it.
+    data.disjointSetTable.reserveAndResizeUninitialized(data.orientedMarkerCount * 2);
 
-    uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
+    // Have DisjointSets use the memory allocated in and managed by data.disjointSetTable.
+    data.disjointSetsPointer = std::make_shared<DisjointSets>(
+        reinterpret_cast<DisjointSets::Aint*>(data.disjointSetTable.begin()),
+        data.orientedMarkerCount,
+        false
+    );
 
-        // We process read graph edges in pairs.
-        // In each pair, the second edge is the reverse complement of the first.
-        SHASTA_ASSERT((begin%2) == 0);
-        SHASTA_ASSERT((end%2) == 0);
+    // Partition the oriented markers into shards.
+    // With a single shard (the default), the disjoint set computation
+    // processes all read graph edges in a single multithreaded pass, in any order.
+    // With more than one shard, each shard is a contiguous range of ReadIds,
+    // and threads are assigned to shards and bound to NUMA nodes.
+    // The disjoint set computation then has two passes:
+    // - A local pass, in which each group of threads processes the
+    //   read graph edges with both reads in its own shard.
+    //   All the union-find operations in this pass
+    //   access memory in the shard, which, because of first-touch placement,
+    //   is on the NUMA node of the thread.
+    // - A boundary pass, in which all threads process the remaining
+    //   read graph edges, which join markers in different shards.
+    // The result is the same for any number of shards.
+    if(shardCount == 0) {
+        shardCount = getNumaNodeCount();
+    }
+    shardCount = max(uint64_t(1), min(shardCount, uint64_t(threadCount)));
+    createMarkerGraphVerticesCreateShards(shardCount);
 
-        for(size_t i=begin; i!=end; i+=2) {
+    // Initialize the disjoint set data structure.
+    const size_t batchSize = 10000;
+    runThreads(&Assembler::createMarkerGraphVerticesThreadFunction0, threadCount);
 
-            // Get the oriented read ids we want to align.
-            array<OrientedReadId, 2> orientedReadIds;
-            const ReadGraphEdge& readGraphEdge = readGraph.edges[i];
-            alignmentId = readGraphEdge.alignmentId;
 
-            // Check that the next edge is the reverse complement of
-            // this edge.
-            {
-                const ReadGraphEdge& readGraphNextEdge = readGraph.edges[i + 1];
-                array<OrientedReadId, 2> nextEdgeOrientedReadIds = readGraphNextEdge.orientedReadIds;
-                nextEdgeOrientedReadIds[0].flipStrand();
-                nextEdgeOrientedReadIds[1].flipStrand();
-                SHASTA_ASSERT(nextEdgeOrientedReadIds == readGraphEdge.orientedReadIds);
-            }
 
-            // If the edge is flagged as crossing strands, skip it.
-            if(readGraphEdge.crossesStrands) {
-                continue;
+    // Update the disjoint set data structure for each alignment
+    // in the read graph.
+    performanceLog << timestamp << "Disjoint set computation begins." << endl;
+    if(shardCount == 1) {
+        DisjointSetsConsumer consumer(*data.disjointSetsPointer);
+        streamAlignedMarkerPairs({&consumer}, threadCount);
+    } else {
+        runThreads(&Assembler::createMarkerGraphVerticesThreadFunction11, threadCount);
+        performanceLog << timestamp << "Disjoint set computation for shard boundaries begins." << endl;
+        setupLoadBalancing(data.boundaryEdgePairs.size(), 1000);
+        runThreads(&Assembler::createMarkerGraphVerticesThreadFunction12, threadCount);
+    }
+    data.shards.clear();
+    data.boundaryEdgePairs.clear();
+    data.boundaryEdgePairs.shrink_to_fit();
+    performanceLog << timestamp << "Disjoint set computation completed." << endl;
+
+
+
+    // Find the disjoint set that each oriented marker was assigned to.
+    // Iterate till each marker has its set representative populated in the parent (lower 64 bits)
+    uint64_t pass = 1;
+    do {
+        (data.disjointSetsPointer)->parentUpdated = 0;
+        performanceLog << "    " << timestamp << " Iteration  " << pass << endl;
+        setupLoadBalancing(data.orientedMarkerCount, batchSize);
+        runThreads(&Assembler::createMarkerGraphVerticesThreadFunction2, threadCount);
+        performanceLog << "    " << timestamp << " Updated parent of - " << (data.disjointSetsPointer)->parentUpdated << " entries." << endl;
+        pass++;
+    } while ((data.disjointSetsPointer)->parentUpdated > 0 && pass <= 10);
+
+    if (pass > 10) {
+        // This should never happen. Even in a highly parallel environment (128 threads), convergence happens
+        // in 2 or 3 passes. It's definitely worth investigating if this ever happens.
+        string errorMsg = "DisjointSets parent information did not converge in " + to_string(pass) + " iterations.";
+        throw runtime_error(errorMsg);
+    }
+
+
+    performanceLog << timestamp << "Verifying convergence of parent information." << endl;
+    setupLoadBalancing(data.orientedMarkerCount, batchSize);
+    runThreads(&Assembler::createMarkerGraphVerticesThreadFunction21, threadCount);
+    performanceLog << timestamp << "Done verifying convergence of parent information." << endl;
+
+
+    // data.disjointSetTable now has the correct set representative for entry N at location 2*N.
+    // That's because DisjointSets stores parent information in the lower 64 bits of the 128 bits
+    // it uses for each entry. Since we only care about these bits, we can compact data.disjointSetTable
+    // and free up half the memory.
+    // This bit seems tricky to parallelize. It's not worth the effort as this is pretty fast as is.
+    performanceLog << timestamp << "Compacting the Disjoint Set data-structure." << endl;
+    for(uint64_t i=0; i<data.orientedMarkerCount; i++) {
+        data.disjointSetTable[i] = data.disjointSetTable[2*i];
+    }
+    data.disjointSetTable.resize(data.orientedMarkerCount);
+    data.disjointSetTable.unreserve();
+    performanceLog << timestamp << "Done compacting the Disjoint Set data-structure." << endl;
+
+    // Don't need the DisjointSets data-structure any more.
+    data.disjointSetsPointer = 0;
+}
+
+
+
+// Partition the oriented markers into shards.
+// Each shard is a contiguous range of ReadIds, chosen so all shards
+// have approximately the same number of markers.
+// Also assign each read graph edge pair to a shard
+// or to the boundary between shards.
+void Assembler::createMarkerGraphVerticesCreateShards(uint64_t shardCount)
+{
+    auto& data = createMarkerGraphVerticesData;
+    const ReadId readCount = reads->readCount();
+
+    // The first MarkerId of a read.
+    auto markerBegin = [this](ReadId readId)
+    {
+        return MarkerId(markers.begin(OrientedReadId(readId, 0).getValue()) - markers.begin());
+    };
+
+    data.shards.resize(shardCount);
+    ReadId readId = 0;
+    for(uint64_t shardId=0; shardId<shardCount; shardId++) {
+        auto& shard = data.shards[shardId];
+        shard.readBegin = readId;
+        if(shardId == shardCount - 1) {
+            readId = readCount;
+        } else {
+            const MarkerId targetMarkerEnd = (data.orientedMarkerCount * (shardId + 1)) / shardCount;
+            while(readId < readCount and markerBegin(readId) < targetMarkerEnd) {
+                ++readId;
             }
+        }
+        shard.readEnd = readId;
+        shard.markerBegin = markerBegin(shard.readBegin);
+        shard.markerEnd = (readId == readCount) ? data.orientedMarkerCount : markerBegin(readId);
+        shard.edgePairs.clear();
+        shard.nextMarker = shard.markerBegin;
+        shard.nextEdgePair = 0;
+    }
+    SHASTA_ASSERT(data.shards.back().markerEnd == data.orientedMarkerCount);
 
-            // If the edge has an alignment flagged as inconsistent, skip it.
-            if(readGraphEdge.hasInconsistentAlignment) {
-                continue;
+    // Find the shard that contains a given read.
+    auto findShard = [&data](ReadId readId)
+    {
+        uint64_t shardId = 0;
+        while(readId >= data.shards[shardId].readEnd) {
+            ++shardId;
+        }
+        return shardId;
+    };
+
+    // Assign edge pairs to shards.
+    // With a single shard, this is not needed because
+    // createMarkerGraphVerticesThreadFunction1 loops over all edges.
+    data.boundaryEdgePairs.clear();
+    if(shardCount > 1) {
+        const uint64_t edgeCount = readGraph.edges.size();
+        SHASTA_ASSERT((edgeCount % 2) == 0);
+        for(uint64_t edgeId=0; edgeId<edgeCount; edgeId+=2) {
+            const ReadGraphEdge& edge = readGraph.edges[edgeId];
+            const uint64_t shardId0 = findShard(edge.orientedReadIds[0].getReadId());
+            const uint64_t shardId1 = findShard(edge.orientedReadIds[1].getReadId());
+            if(shardId0 == shardId1) {
+                data.shards[shardId0].edgePairs.push_back(edgeId);
+            } else {
+                data.boundaryEdgePairs.push_back(edgeId);
             }
+        }
+    }
 
-            orientedReadIds = readGraphEdge.orientedReadIds;
-            SHASTA_ASSERT(orientedReadIds[0] < orientedReadIds[1]);
+    // Bind threads to NUMA nodes only if there is more than one shard
+    // and more than one NUMA node.
+    data.numaNodeCount = getNumaNodeCount();
+    data.bindThreadsToNumaNodes = (shardCount > 1) and (data.numaNodeCount > 1);
 
-            // If either of the reads is flagged chimeric, skip it.
-            if( reads->getFlags(orientedReadIds[0].getReadId()).isChimeric ||
-                reads->getFlags(orientedReadIds[1].getReadId()).isChimeric) {
-                continue;
-            }
+    if(shardCount > 1) {
+        cout << "The disjoint set computation for marker graph vertices uses " <<
+            shardCount << " shards." << endl;
+        for(uint64_t shardId=0; shardId<shardCount; shardId++) {
+            const auto& shard = data.shards[shardId];
+            cout << "Shard " << shardId << ": reads " << shard.readBegin << "-" << shard.readEnd <<
+                ", " << shard.markerEnd - shard.markerBegin << " markers, " <<
+                shard.edgePairs.size() << " local read graph edge pairs." << endl;
+        }
+        cout << data.boundaryEdgePairs.size() <<
+            " read graph edge pairs join reads in different shards." << endl;
+        if(data.bindThreadsToNumaNodes) {
+            cout << "Threads will be bound to " << data.numaNodeCount << " NUMA nodes." << endl;
+        }
+    }
+}
+
+
+
+// Get the next batch from a work counter shared between threads.
+// This is used instead of getNextBatch when threads
+// work on different shards.
+static bool getNextShardBatch(
+    uint64_t& next,
+    uint64_t end,
+    uint64_t batchSize,
+    uint64_t& batchBegin,
+    uint64_t& batchEnd)
+{
+    batchBegin = __sync_fetch_and_add(&next, batchSize);
+    if(batchBegin >= end) {
+        return false;
+    }
+    batchEnd = min(batchBegin + batchSize, end);
+    return true;
+}
+
+
+
+// Initialize the disjoint set data structure.
+// Each thread initializes entries of its own shard,
+// so the corresponding memory pages are placed on its NUMA node.
+void Assembler::createMarkerGraphVerticesThreadFunction0(size_t threadId)
+{
+    auto& data = createMarkerGraphVerticesData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+    const uint64_t shardId = threadId % data.shards.size();
+    auto& shard = data.shards[shardId];
+    if(data.bindThreadsToNumaNodes) {
+        bindThreadToNumaNode(shardId % data.numaNodeCount);
+    }
 
-            // Sanity check.
-            SHASTA_ASSERT(alignmentData[alignmentId].info.isInReadGraph);
-
-            // Decompress this alignment.
-            span<const char> compressedAlignment = storedAlignments[alignmentId];
-            shasta::decompress(compressedAlignment, alignment);
-
-
-            // In the global marker graph, merge pairs
-            // of aligned markers.
-            for(const auto& p: alignment.ordinals) {
-                const uint32_t ordinal0 = p[0];
-                const uint32_t ordinal1 = p[1];
-                const MarkerId markerId0 = getMarkerId(orientedReadIds[0], ordinal0);
-                const MarkerId markerId1 = getMarkerId(orientedReadIds[1], ordinal1);
-                disjointSetsPointer->unite(markerId0, markerId1);
-
-                // Also merge the reverse complemented markers.
-                // This guarantees that the marker graph remains invariant
-                // under strand swap.
-                disjointSetsPointer->unite(
-                    findReverseComplement(markerId0),
-                    findReverseComplement(markerId1));
+    // Use batches that are a multiple of the 2 MB page size.
+    const uint64_t batchSize = 2 * 1024 * 1024 / sizeof(DisjointSets::Aint);
+    uint64_t begin, end;
+    while(getNextShardBatch(shard.nextMarker, shard.markerEnd, batchSize, begin, end)) {
+        for(MarkerId markerId=begin; markerId!=end; ++markerId) {
+            disjointSets.initialize(markerId);
+        }
+    }
+}
+
+
+
+// Local pass of the disjoint set computation when using more than one shard.
+// Each thread processes edge pairs of its own shard and, when done,
+// helps with the edge pairs of the other shards.
+void Assembler::createMarkerGraphVerticesThreadFunction11(size_t threadId)
+{
+    auto& data = createMarkerGraphVerticesData;
+    const uint64_t shardCount = data.shards.size();
+    const uint64_t myShardId = threadId % shardCount;
+    if(data.bindThreadsToNumaNodes) {
+        bindThreadToNumaNode(myShardId % data.numaNodeCount);
+    }
+
+    Alignment alignment;
+    vector<AlignedMarkerPair> alignedMarkerPairs;
+    const uint64_t batchSize = 1000;
+    for(uint64_t k=0; k<shardCount; k++) {
+        auto& shard = data.shards[(myShardId + k) % shardCount];
+        uint64_t begin, end;
+        while(getNextShardBatch(shard.nextEdgePair, shard.edgePairs.size(), batchSize, begin, end)) {
+            for(uint64_t i=begin; i!=end; i++) {
+                createMarkerGraphVerticesProcessEdgePair(shard.edgePairs[i], alignment, alignedMarkerPairs);
             }
         }
     }
+}
+
+
+
+// Boundary pass of the disjoint set computation when using more than one shard.
+void Assembler::createMarkerGraphVerticesThreadFunction12(size_t threadId)
+{
+    auto& data = createMarkerGraphVerticesData;
+    if(data.bindThreadsToNumaNodes) {
+        bindThreadToNumaNode((threadId % data.shards.size()) % data.numaNodeCount);
+    }
+
+    Alignment alignment;
+    vector<AlignedMarkerPair> alignedMarkerPairs;
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            createMarkerGraphVerticesProcessEdgePair(data.boundaryEdgePairs[i], alignment, alignedMarkerPairs);
+        }
+    }
+}
+
+
+
+// Update the disjoint set data structure using a pair of read graph edges.
+// The first edge of the pair is edgeId and the second edge
+// is its reverse complement.
+void Assembler::createMarkerGraphVerticesProcessEdgePair(
+    uint64_t edgeId,
+    Alignment& alignment,
+    vector<AlignedMarkerPair>& alignedMarkerPairs)
+{
+    DisjointSets& disjointSets = *createMarkerGraphVerticesData.disjointSetsPointer;
 
+    // In the global marker graph, merge pairs of aligned markers.
+    alignedMarkerPairs.clear();
+    getReadGraphEdgePairAlignedMarkers(edgeId, alignment, alignedMarkerPairs);
+    disjointSets.uniteBatch(alignedMarkerPairs.begin(), alignedMarkerPairs.end());
 }
 
 
@@ -1029,6 +1233,35 @@ void Assembler::getGlobalMarkerGraphVertexChildren(
     ) const
 {
     children.clear();
+    getGlobalMarkerGraphVertexChildMarkerIntervals(vertexId, workArea);
+
+    // Now construct the children by gathering streaks of workArea entries
+    // with the same child vertex id.
+    for(auto streakBegin=workArea.begin(); streakBegin!=workArea.end(); ) {
+        auto streakEnd = streakBegin + 1;
+        for(;
+            streakEnd!=workArea.end() && streakEnd->first==streakBegin->first;
+            streakEnd++) {
+        }
+        children.resize(children.size() + 1);
+        children.back().first = streakBegin->first;
+        auto& v = children.back().second;
+        for(auto it=streakBegin; it!=streakEnd; it++) {
+            v.push_back(it->second);
+        }
+
+        // Process the next streak.
+        streakBegin = streakEnd;
+    }
+}
+
+
+
+void Assembler::getGlobalMarkerGraphVertexChildMarkerIntervals(
+    MarkerGraph::VertexId vertexId,
+    vector< pair<MarkerGraph::VertexId, MarkerInterval> >& workArea
+    ) const
+{
     workArea.clear();
 
     // Loop over the markers of this vertex.
@@ -1056,27 +1289,6 @@ void Assembler::getGlobalMarkerGraphVertexChildren(
 
     }
     sort(workArea.begin(), workArea.end());
-
-
-
-    // Now construct the children by gathering streaks of workArea entries
-    // with the same child vertex id.
-    for(auto streakBegin=workArea.begin(); streakBegin!=workArea.end(); ) {
-        auto streakEnd = streakBegin + 1;
-        for(;
-            streakEnd!=workArea.end() && streakEnd->first==streakBegin->first;
-            streakEnd++) {
-        }
-        children.resize(children.size() + 1);
-        children.back().first = streakBegin->first;
-        auto& v = children.back().second;
-        for(auto it=streakBegin; it!=streakEnd; it++) {
-            v.push_back(it->second);
-        }
-
-        // Process the next streak.
-        streakBegin = streakEnd;
-    }
 }
 
 
@@ -1158,10 +1370,30 @@ void Assembler::findMarkerGraphReverseComplementVertices(size_t threadCount)
     }
     markerGraph.reverseComplementVertex.resize(vertexCount);
 
+    // The lookups in the vertexTable are random accesses to an array
+    // of 5-byte entries. If there is enough memory, make
+    // an unpacked copy with 8-byte entries.
+    // We require the copy to use no more than half of the available memory.
+    auto& data = findMarkerGraphReverseComplementVerticesData;
+    const uint64_t markerCount = markerGraph.vertexTable.size();
+    if(markerCount * sizeof(uint64_t) < getAvailablePhysicalMemory() / 2) {
+        data.vertexTable.createNew(
+            largeDataName("tmp-MarkerGraphReverseComplementVertexTable"),
+            largeDataPageSize);
+        data.vertexTable.reserveAndResizeUninitialized(markerCount);
+        setupLoadBalancing(markerCount, 1000000);
+        runThreads(&Assembler::findMarkerGraphReverseComplementVerticesThreadFunction0,
+            threadCount);
+    }
+
     // Check each vertex.
+    data.vertexIds.clear();
     setupLoadBalancing(vertexCount, 10000);
     runThreads(&Assembler::findMarkerGraphReverseComplementVerticesThreadFunction1,
         threadCount);
+    if(data.vertexTable.isOpen) {
+        data.vertexTable.remove();
+    }
 
     // Check that the reverse complement of the reverse complement of a
     // vertex is the vertex itself.
@@ -1174,40 +1406,198 @@ void Assembler::findMarkerGraphReverseComplementVertices(size_t threadCount)
 
 
 
-void Assembler::findMarkerGraphReverseComplementVerticesThreadFunction1(size_t threadId)
+// Renumber the marker graph vertices in the order in which they
+// are first encountered when walking the marker paths of all oriented reads.
+// The vertex table is renumbered, the vertices are recreated from it,
+// and the reverse complement vertices are renumbered.
+void Assembler::renumberMarkerGraphVertices(size_t threadCount)
 {
+    performanceLog << timestamp << "Begin renumberMarkerGraphVertices." << endl;
+
+    // Check that we have what we need.
+    checkMarkerGraphVerticesAreAvailable();
+    SHASTA_ASSERT(markerGraph.reverseComplementVertex.isOpen);
+    if(markerGraph.edges.isOpen) {
+        throw runtime_error("Marker graph vertices cannot be renumbered "
+            "after the marker graph edges are created.");
+    }
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     using VertexId = MarkerGraph::VertexId;
+    const VertexId vertexCount = markerGraph.vertexCount();
+    if(vertexCount == 0) {
+        return;
+    }
+
+    // Renumber the vertex table and recreate the vertices.
+    MemoryMapped::Vector<VertexId> newVertexId;
+    newVertexId.createNew(
+        largeDataName("tmp-RenumberMarkerGraphVertices-NewVertexId"), largeDataPageSize);
+    markerGraph.renumberVertexTableInMarkerOrder(threadCount, vertexCount - 1, newVertexId);
+    markerGraph.createVerticesFromVertexTable(threadCount, vertexCount - 1);
+    SHASTA_ASSERT(markerGraph.vertexCount() == vertexCount);
+
+    // Renumber the reverse complement vertices.
+    SHASTA_ASSERT(markerGraph.reverseComplementVertex.size() == vertexCount);
+    const vector<VertexId> oldReverseComplementVertex(
+        markerGraph.reverseComplementVertex.begin(),
+        markerGraph.reverseComplementVertex.end());
+    parallelFor(vertexCount, 100000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(VertexId oldVertexId=begin; oldVertexId!=end; oldVertexId++) {
+                markerGraph.reverseComplementVertex[newVertexId[oldVertexId]] =
+                    newVertexId[oldReverseComplementVertex[oldVertexId]];
+            }
+        });
+    newVertexId.remove();
+
+    performanceLog << timestamp << "End renumberMarkerGraphVertices." << endl;
+}
+
+
+
+// Same as above, but only find the reverse complement of the vertices in vertexIds.
+// The reverse complement of all other vertices must already be stored.
+// This is used after a change that only affects a small number of vertices,
+// so the unpacked copy of the vertex table is not created.
+void Assembler::findMarkerGraphReverseComplementVertices(
+    size_t threadCount,
+    vector<MarkerGraph::VertexId>& vertexIds)
+{
+    performanceLog << timestamp << "Begin findMarkerGraphReverseComplementVertices for " <<
+        vertexIds.size() << " vertices." << endl;
+
+    // Check that we have what we need.
+    checkMarkersAreOpen();
+    checkMarkerGraphVerticesAreAvailable();
+    SHASTA_ASSERT(markerGraph.reverseComplementVertex.isOpen);
+    const MarkerGraph::VertexId vertexCount = markerGraph.vertexCount();
+    SHASTA_ASSERT(markerGraph.reverseComplementVertex.size() == vertexCount);
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Find the reverse complement of the vertices in vertexIds.
+    auto& data = findMarkerGraphReverseComplementVerticesData;
+    if(not vertexIds.empty()) {
+        data.vertexIds.swap(vertexIds);
+        setupLoadBalancing(data.vertexIds.size(), 10000);
+        runThreads(&Assembler::findMarkerGraphReverseComplementVerticesThreadFunction1,
+            threadCount);
+        data.vertexIds.swap(vertexIds);
+        data.vertexIds.clear();
+    }
+
+    // Check that the reverse complement of the reverse complement of a
+    // vertex is the vertex itself. This is done for all vertices.
+    setupLoadBalancing(vertexCount, 10000);
+    runThreads(&Assembler::findMarkerGraphReverseComplementVerticesThreadFunction2,
+        threadCount);
+    performanceLog << timestamp << "End findMarkerGraphReverseComplementVertices." << endl;
+}
+
+
+
+// Create the unpacked copy of the vertexTable.
+void Assembler::findMarkerGraphReverseComplementVerticesThreadFunction0(size_t threadId)
+{
+    auto& vertexTable = findMarkerGraphReverseComplementVerticesData.vertexTable;
 
-    // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
+        for(MarkerId markerId=begin; markerId!=end; markerId++) {
+            vertexTable[markerId] = markerGraph.vertexTable[markerId];
+        }
+    }
+}
 
-        // Loop over vertices in this batch.
-        for (VertexId vertexId=begin; vertexId!=end; vertexId++) {
 
-            // Get the markers of this vertex.
-            const span<MarkerId> vertexMarkers = markerGraph.getVertexMarkerIds(vertexId);
-            SHASTA_ASSERT(vertexMarkers.size() > 0);
 
-            // Get the first marker of this vertex.
-            const MarkerId firstMarkerId = vertexMarkers[0];
+// Find the reverse complement vertex of each vertex in a batch,
+// and check that all markers of each vertex agree.
+// If findMarkerGraphReverseComplementVerticesData.vertexIds is not empty,
+// the batches are of positions in that vector instead of vertex ids.
+// The lookups are done in bulk: we first find the reverse complemented
+// marker of every marker of the batch, then look them all up
+// in the vertex table, prefetching ahead to hide memory latency.
+void Assembler::findMarkerGraphReverseComplementVerticesThreadFunction1(size_t threadId)
+{
+    using VertexId = MarkerGraph::VertexId;
+    const auto& data = findMarkerGraphReverseComplementVerticesData;
+    const uint64_t invalidVertexId = MarkerGraph::invalidCompressedVertexId;
+
+    // Work vectors for a batch.
+    // The reverse complemented markers of all markers of the batch, in order,
+    // and the corresponding vertices.
+    vector<MarkerId> markerIdsReverseComplement;
+    vector<VertexId> vertexIdsReverseComplement;
+
+    // Look up in a vertex table the vertices of
+    // all the markers in markerIdsReverseComplement.
+    // This works with either the packed or unpacked vertex table.
+    const uint64_t prefetchDistance = 16;
+    auto lookup = [&](const auto* vertexTable)
+    {
+        const uint64_t n = markerIdsReverseComplement.size();
+        vertexIdsReverseComplement.resize(n);
+        for(uint64_t i=0; i<n; i++) {
+            if(i + prefetchDistance < n) {
+                __builtin_prefetch(vertexTable + markerIdsReverseComplement[i + prefetchDistance]);
+            }
+            vertexIdsReverseComplement[i] = vertexTable[markerIdsReverseComplement[i]];
+        }
+    };
 
-            /// Find the reverse complemented marker.
-            const MarkerId firstMarkerIdReverseComplement = findReverseComplement(firstMarkerId);
+    // The vertex id corresponding to a position in the batch.
+    auto getVertexId = [&data](uint64_t i)
+    {
+        return data.vertexIds.empty() ? VertexId(i) : data.vertexIds[i];
+    };
 
-            // Find the corresponding vertex.
-            const VertexId vertexIdReverseComplement = markerGraph.vertexTable[firstMarkerIdReverseComplement];
-            SHASTA_ASSERT(vertexIdReverseComplement != MarkerGraph::invalidCompressedVertexId);
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
 
-            // Now check that we get the same reverse complement vertex for all markers.
+        // Find the reverse complemented marker of each marker
+        // of the vertices in this batch.
+        markerIdsReverseComplement.clear();
+        for(uint64_t j=begin; j!=end; j++) {
+            const VertexId vertexId = getVertexId(j);
+            const span<MarkerId> vertexMarkers = markerGraph.getVertexMarkerIds(vertexId);
+            SHASTA_ASSERT(vertexMarkers.size() > 0);
             for(const MarkerId markerId: vertexMarkers) {
-                const MarkerId markerIdReverseComplement = findReverseComplement(markerId);
-                SHASTA_ASSERT(markerGraph.vertexTable[markerIdReverseComplement] == vertexIdReverseComplement);
+                markerIdsReverseComplement.push_back(findReverseComplement(markerId));
             }
+        }
+
+        // Find the corresponding vertices.
+        if(data.vertexTable.isOpen) {
+            lookup(data.vertexTable.begin());
+        } else {
+            lookup(markerGraph.vertexTable.begin());
+        }
 
-            // Store the reverse complement vertex.
+        // For each vertex, check that we get the same reverse complement vertex
+        // for all markers, then store it.
+        uint64_t i = 0;
+        for(uint64_t j=begin; j!=end; j++) {
+            const VertexId vertexId = getVertexId(j);
+            const uint64_t markerCount = markerGraph.getVertexMarkerIds(vertexId).size();
+            const VertexId vertexIdReverseComplement = vertexIdsReverseComplement[i];
+            SHASTA_ASSERT(vertexIdReverseComplement != invalidVertexId);
+            for(uint64_t j=0; j<markerCount; j++, i++) {
+                SHASTA_ASSERT(vertexIdsReverseComplement[i] == vertexIdReverseComplement);
+            }
             markerGraph.reverseComplementVertex[vertexId] = vertexIdReverseComplement;
         }
+        SHASTA_ASSERT(i == vertexIdsReverseComplement.size());
     }
 }
 
@@ -1216,15 +1606,20 @@ void Assembler::findMarkerGraphReverseComplementVerticesThreadFunction1(size_t t
 void Assembler::findMarkerGraphReverseComplementVerticesThreadFunction2(size_t threadId)
 {
     using VertexId = MarkerGraph::VertexId;
+    const VertexId* reverseComplementVertex = markerGraph.reverseComplementVertex.begin();
+    const uint64_t prefetchDistance = 16;
 
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
 
         for (VertexId vertexId=begin; vertexId!=end; vertexId++) {
+            if(vertexId + prefetchDistance < end) {
+                __builtin_prefetch(reverseComplementVertex + reverseComplementVertex[vertexId + prefetchDistance]);
+            }
             const VertexId vertexIdReverseComplement =
-                markerGraph.reverseComplementVertex[vertexId];
+                reverseComplementVertex[vertexId];
             SHASTA_ASSERT(
-                markerGraph.reverseComplementVertex[vertexIdReverseComplement] == vertexId);
+                reverseComplementVertex[vertexIdReverseComplement] == vertexId);
         }
     }
 }
@@ -1631,7 +2026,8 @@ bool Assembler::extractLocalMarkerGraph(
     bool useSuperBubbleEdges,
     bool useLowCoverageCrossEdges,
     bool useRemovedSecondaryEdges,
-    LocalMarkerGraph0& graph
+    LocalMarkerGraph0& graph,
+    bool computeEdgeConsensus
     )
 {
     const MarkerGraph::VertexId startVertexId =
@@ -1645,7 +2041,8 @@ bool Assembler::extractLocalMarkerGraph(
         useSuperBubbleEdges,
         useLowCoverageCrossEdges,
         useRemovedSecondaryEdges,
-        graph);
+        graph,
+        computeEdgeConsensus);
 
 }
 
@@ -1662,7 +2059,8 @@ bool Assembler::extractLocalMarkerGraph(
     bool useSuperBubbleEdges,
     bool useLowCoverageCrossEdges,
     bool useRemovedSecondaryEdges,
-    LocalMarkerGraph0& graph
+    LocalMarkerGraph0& graph,
+    bool computeEdgeConsensus
     )
 {
     // Sanity check.
@@ -1682,171 +2080,103 @@ bool Assembler::extractLocalMarkerGraph(
     }
     const vertex_descriptor vStart = graph.addVertex(startVertexId, 0, markerGraph.getVertexMarkerIds(startVertexId));
 
-    // Some vectors used inside the BFS.
-    // Define them here to reduce memory allocation activity.
-    vector<MarkerInterval> markerIntervals;
+    // Function that returns true if a marker graph edge
+    // should be used, based on the arguments.
+    auto useEdge = [&](MarkerGraph::EdgeId edgeId)
+    {
+        const auto& edge = markerGraph.edges[edgeId];
+        return
+            (markerGraph.edgeMarkerIntervals.size(edgeId) >= minEdgeCoverage) and
+            (useWeakEdges or not edge.wasRemovedByTransitiveReduction) and
+            (usePrunedEdges or not edge.wasPruned) and
+            (useSuperBubbleEdges or not edge.isSuperBubbleEdge) and
+            (useLowCoverageCrossEdges or not edge.isLowCoverageCrossEdge) and
+            (useRemovedSecondaryEdges or not edge.wasRemovedWhileSplittingSecondaryEdges);
+    };
+
+    // Function that adds the vertex reached via an edge, if not already present
+    // and with sufficient coverage. New vertices are added to the next BFS level.
+    vector<vertex_descriptor> currentLevel;
+    vector<vertex_descriptor> nextLevel;
+    auto reachVertex = [&](MarkerGraph::VertexId vertexId1, uint64_t distance1)
+    {
+        SHASTA_ASSERT(vertexId1 < markerGraph.vertexCount());
+        if(markerGraph.vertexCoverage(vertexId1) < minVertexCoverage) {
+            return;
+        }
+        if(graph.findVertex(vertexId1).first) {
+            return;
+        }
+        const vertex_descriptor v1 = graph.addVertex(
+            vertexId1, distance1, markerGraph.getVertexMarkerIds(vertexId1));
+        if(distance1 < distance) {
+            nextLevel.push_back(v1);
+        }
+    };
 
 
-    // Do the BFS to generate the vertices.
+
+    // Do the BFS to generate the vertices, one level at a time.
     // Edges will be created later.
-    std::queue<vertex_descriptor> q;
     if(distance > 0) {
-        q.push(vStart);
+        currentLevel.push_back(vStart);
     }
-    while(!q.empty()) {
-
-        // See if we exceeded the timeout.
-        if(timeout>0. && seconds(steady_clock::now() - startTime) > timeout) {
-            graph.clear();
-            return false;
-        }
-
-        // Dequeue a vertex.
-        const vertex_descriptor v0 = q.front();
-        q.pop();
-        const LocalMarkerGraph0Vertex& vertex0 = graph[v0];
-        const MarkerGraph::VertexId vertexId0 = vertex0.vertexId;
-        const uint64_t distance0 = vertex0.distance;
+    for(uint64_t distance0=0; not currentLevel.empty(); distance0++) {
         const uint64_t distance1 = distance0 + 1;
+        nextLevel.clear();
 
-        // Loop over the children.
-        const auto childEdges = markerGraph.edgesBySource[vertexId0];
-        for(uint64_t edgeId: childEdges) {
-            const auto& edge = markerGraph.edges[edgeId];
+        for(const vertex_descriptor v0: currentLevel) {
 
-            // Skip this edge if the arguments require it.
-            if(markerGraph.edgeMarkerIntervals[edgeId].size() < minEdgeCoverage) {
-                continue;
-            }
-            if(edge.wasRemovedByTransitiveReduction && !useWeakEdges) {
-                continue;
-            }
-            if(edge.wasPruned && !usePrunedEdges) {
-                continue;
-            }
-            if(edge.isSuperBubbleEdge && !useSuperBubbleEdges) {
-                continue;
-            }
-            if(edge.isLowCoverageCrossEdge && !useLowCoverageCrossEdges) {
-                continue;
-            }
-            if(edge.wasRemovedWhileSplittingSecondaryEdges && !useRemovedSecondaryEdges) {
-                continue;
+            // See if we exceeded the timeout.
+            if(timeout>0. && seconds(steady_clock::now() - startTime) > timeout) {
+                graph.clear();
+                return false;
             }
 
-            const MarkerGraph::VertexId vertexId1 = edge.target;
-            SHASTA_ASSERT(edge.source == vertexId0);
-            SHASTA_ASSERT(vertexId1 < markerGraph.vertexCount());
-
-            // If vertex coverage is too low, skip it.
-            if(markerGraph.vertexCoverage(vertexId1) < minVertexCoverage) {
-                continue;
-            }
+            const MarkerGraph::VertexId vertexId0 = graph[v0].vertexId;
 
-            // Find the vertex corresponding to this child, creating it if necessary.
-            bool vertexExists;
-            vertex_descriptor v1;
-            tie(vertexExists, v1) = graph.findVertex(vertexId1);
-            if(!vertexExists) {
-                v1 = graph.addVertex(
-                    vertexId1, distance1, markerGraph.getVertexMarkerIds(vertexId1));
-                if(distance1 < distance) {
-                    q.push(v1);
+            // Loop over the children.
+            for(const uint64_t edgeId: markerGraph.edgesBySource[vertexId0]) {
+                if(useEdge(edgeId)) {
+                    const auto& edge = markerGraph.edges[edgeId];
+                    SHASTA_ASSERT(edge.source == vertexId0);
+                    reachVertex(edge.target, distance1);
                 }
             }
-        }
-
-        // Loop over the parents.
-        const auto parentEdges = markerGraph.edgesByTarget[vertexId0];
-        for(uint64_t edgeId: parentEdges) {
-            const auto& edge = markerGraph.edges[edgeId];
-
-            // Skip this edge if the arguments require it.
-            if(markerGraph.edgeMarkerIntervals[edgeId].size() < minEdgeCoverage) {
-                continue;
-            }
-            if(edge.wasRemovedByTransitiveReduction && !useWeakEdges) {
-                continue;
-            }
-            if(edge.wasPruned && !usePrunedEdges) {
-                continue;
-            }
-            if(edge.isSuperBubbleEdge && !useSuperBubbleEdges) {
-                continue;
-            }
-            if(edge.isLowCoverageCrossEdge && !useLowCoverageCrossEdges) {
-                continue;
-            }
-            if(edge.wasRemovedWhileSplittingSecondaryEdges && !useRemovedSecondaryEdges) {
-                continue;
-            }
-
-            const MarkerGraph::VertexId vertexId1 = edge.source;
-            SHASTA_ASSERT(edge.target == vertexId0);
-            SHASTA_ASSERT(vertexId1 < markerGraph.vertexCount());
-
-            // If vertex coverage is too low, skip it.
-            if(markerGraph.vertexCoverage(vertexId1) < minVertexCoverage) {
-                continue;
-            }
 
-            // Find the vertex corresponding to this child, creating it if necessary.
-            bool vertexExists;
-            vertex_descriptor v1;
-            tie(vertexExists, v1) = graph.findVertex(vertexId1);
-            if(!vertexExists) {
-                v1 = graph.addVertex(
-                    vertexId1, distance1, markerGraph.getVertexMarkerIds(vertexId1));
-                if(distance1 < distance) {
-                    q.push(v1);
+            // Loop over the parents.
+            for(const uint64_t edgeId: markerGraph.edgesByTarget[vertexId0]) {
+                if(useEdge(edgeId)) {
+                    const auto& edge = markerGraph.edges[edgeId];
+                    SHASTA_ASSERT(edge.target == vertexId0);
+                    reachVertex(edge.source, distance1);
                 }
             }
         }
+
+        currentLevel.swap(nextLevel);
     }
 
 
 
     // Create edges.
+    // Loop over the children that exist in the local marker graph.
+    const bool hasMarkerToAssemblyTable =
+        assemblyGraphPointer and assemblyGraph.markerToAssemblyTable.isOpen();
     BGL_FORALL_VERTICES(v0, graph, LocalMarkerGraph0) {
-        const LocalMarkerGraph0Vertex& vertex0 = graph[v0];
-        const MarkerGraph::VertexId vertexId0 = vertex0.vertexId;
+        const MarkerGraph::VertexId vertexId0 = graph[v0].vertexId;
 
-        // Loop over the children that exist in the local marker graph
-        // and are also at maximum distance.
-        const auto childEdges = markerGraph.edgesBySource[vertexId0];
-        for(uint64_t edgeId: childEdges) {
-            const auto& edge = markerGraph.edges[edgeId];
-
-            // Skip this edge if the arguments require it.
-            if(markerGraph.edgeMarkerIntervals[edgeId].size() < minEdgeCoverage) {
-                continue;
-            }
-            if(edge.wasRemovedByTransitiveReduction && !useWeakEdges) {
-                continue;
-            }
-            if(edge.wasPruned && !usePrunedEdges) {
-                continue;
-            }
-            if(edge.isSuperBubbleEdge && !useSuperBubbleEdges) {
-                continue;
-            }
-            if(edge.isLowCoverageCrossEdge && !useLowCoverageCrossEdges) {
+        for(const uint64_t edgeId: markerGraph.edgesBySource[vertexId0]) {
+            if(not useEdge(edgeId)) {
                 continue;
             }
-            if(edge.wasRemovedWhileSplittingSecondaryEdges && !useRemovedSecondaryEdges) {
-                continue;
-            }
-
-            const MarkerGraph::VertexId vertexId1 = edge.target;
+            const auto& edge = markerGraph.edges[edgeId];
             SHASTA_ASSERT(edge.source == vertexId0);
-            SHASTA_ASSERT(vertexId1 < markerGraph.vertexCount());
 
-            // See if we have a vertex for this global vertex id.
+            // If the target does not exist in the local marker graph, skip.
             bool vertexExists;
             vertex_descriptor v1;
-            tie(vertexExists, v1) = graph.findVertex(vertexId1);
-
-            // If it does not exist in the local marker graph, skip.
+            tie(vertexExists, v1) = graph.findVertex(edge.target);
             if(!vertexExists) {
                 continue;
             }
@@ -1858,24 +2188,21 @@ bool Assembler::extractLocalMarkerGraph(
             SHASTA_ASSERT(edgeWasAdded);
 
             // Fill in edge information.
-            const auto storedMarkerIntervals = markerGraph.edgeMarkerIntervals[edgeId];
-            markerIntervals.resize(storedMarkerIntervals.size());
-            copy(storedMarkerIntervals.begin(), storedMarkerIntervals.end(), markerIntervals.begin());
-            graph.storeEdgeInfo(e, markerIntervals);
-            graph[e].edgeId = edgeId;
-            graph[e].wasRemovedByTransitiveReduction = markerGraph.edges[edgeId].wasRemovedByTransitiveReduction;
-            graph[e].wasPruned = markerGraph.edges[edgeId].wasPruned;
-            graph[e].isSuperBubbleEdge = markerGraph.edges[edgeId].isSuperBubbleEdge;
-            graph[e].isLowCoverageCrossEdge = markerGraph.edges[edgeId].isLowCoverageCrossEdge;
-            graph[e].wasAssembled = markerGraph.edges[edgeId].wasAssembled;
-            graph[e].isSecondary = markerGraph.edges[edgeId].isSecondary;
-            graph[e].wasRemovedWhileSplittingSecondaryEdges = markerGraph.edges[edgeId].wasRemovedWhileSplittingSecondaryEdges;
+            graph.storeEdgeInfo(e, markerGraph.edgeMarkerIntervals[edgeId]);
+            LocalMarkerGraph0Edge& localEdge = graph[e];
+            localEdge.edgeId = edgeId;
+            localEdge.wasRemovedByTransitiveReduction = edge.wasRemovedByTransitiveReduction;
+            localEdge.wasPruned = edge.wasPruned;
+            localEdge.isSuperBubbleEdge = edge.isSuperBubbleEdge;
+            localEdge.isLowCoverageCrossEdge = edge.isLowCoverageCrossEdge;
+            localEdge.wasAssembled = edge.wasAssembled;
+            localEdge.isSecondary = edge.isSecondary;
+            localEdge.wasRemovedWhileSplittingSecondaryEdges = edge.wasRemovedWhileSplittingSecondaryEdges;
 
             // Link to assembly graph vertex.
-            if(assemblyGraphPointer and assemblyGraph.markerToAssemblyTable.isOpen()) {
+            if(hasMarkerToAssemblyTable) {
                 const auto& locations = assemblyGraph.markerToAssemblyTable[edgeId];
-                copy(locations.begin(), locations.end(),
-                    back_inserter(graph[e].assemblyGraphLocations));
+                localEdge.assemblyGraphLocations.assign(locations.begin(), locations.end());
             }
         }
     }
@@ -1896,26 +2223,25 @@ bool Assembler::extractLocalMarkerGraph(
     // Back-edges are more likely to be low coverage edges.
     graph.approximateTopologicalSort();
 
-    // Fill in the ConsensusInfo's for each vertex.
-    graph.computeVertexConsensusInfo();
+    // The ConsensusInfo's for the vertices are not displayed,
+    // so they are not computed here. Callers that need them
+    // can use LocalMarkerGraph0::computeVertexConsensusInfo.
 
-    // Fill in the consensus sequence for all edges.
+    // Fill in the consensus sequence for all edges, if requested.
+    // This is only needed when edge labels are displayed.
+    if(not computeEdgeConsensus) {
+        return true;
+    }
     const uint32_t markerGraphEdgeLengthThresholdForConsensus = 1000;
 
-    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
-    const int8_t match = 1;
-    const int8_t mismatch = -1;
-    const int8_t gap = -1;
-    auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
-    spoa::Graph spoaAlignmentGraph;
+    SpoaEnginePool spoaEnginePool;
     BGL_FORALL_EDGES(e, graph, LocalMarkerGraph0) {
         LocalMarkerGraph0Edge& edge = graph[e];
         ComputeMarkerGraphEdgeConsensusSequenceUsingSpoaDetail detail;
         computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
             edge.edgeId,
             markerGraphEdgeLengthThresholdForConsensus,
-            spoaAlignmentEngine,
-            spoaAlignmentGraph,
+            spoaEnginePool,
             edge.consensusSequence,
             edge.consensusRepeatCounts,
             edge.consensusOverlappingBaseCount,
@@ -1929,6 +2255,12 @@ bool Assembler::extractLocalMarkerGraph(
 
 
 // Compute edges of the global marker graph.
+// Each thread writes the edges it finds to its own vectors,
+// one sorted run for each batch of vertices.
+// The runs are then merged, in parallel, directly into
+// edges, edgeMarkerIntervals, edgesBySource, and edgesByTarget.
+// The edges are sorted by source vertex, and then by target vertex,
+// regardless of the number of threads.
 void Assembler::createMarkerGraphEdges(size_t threadCount)
 {
     performanceLog << timestamp << "createMarkerGraphEdges begins." << endl;
@@ -1942,50 +2274,142 @@ void Assembler::createMarkerGraphEdges(size_t threadCount)
     }
 
     // Each thread stores the edges it finds in a separate vector.
-    createMarkerGraphEdgesData.threadEdges.resize(threadCount);
-    createMarkerGraphEdgesData.threadEdgeMarkerIntervals.resize(threadCount);
+    auto& data = createMarkerGraphEdgesData;
+    data.threadEdges.resize(threadCount);
+    data.threadEdgeMarkerIntervals.resize(threadCount);
+    data.threadRuns.clear();
+    data.threadRuns.resize(threadCount);
     performanceLog << timestamp << "Processing " << markerGraph.vertexCount();
     performanceLog << " marker graph vertices." << endl;
     setupLoadBalancing(markerGraph.vertexCount(), 100);
     runThreads(&Assembler::createMarkerGraphEdgesThreadFunction0, threadCount);
 
-    // Combine the edges found by each thread.
-    performanceLog << timestamp << "Combining the edges found by each thread." << endl;
+    // Gather the runs found by all threads, sort them by first vertex,
+    // and assign EdgeIds to the edges of each run.
+    performanceLog << timestamp << "Merging the edges found by each thread." << endl;
+    data.runs.clear();
+    for(const auto& threadRuns: data.threadRuns) {
+        data.runs.insert(data.runs.end(), threadRuns.begin(), threadRuns.end());
+    }
+    data.threadRuns.clear();
+    sort(data.runs.begin(), data.runs.end());
+    uint64_t edgeCount = 0;
+    for(auto& run: data.runs) {
+        run.edgeBegin = edgeCount;
+        edgeCount += run.threadEdgeEnd - run.threadEdgeBegin;
+    }
+
+    // Allocate the edges and prepare the other data structures for pass 1.
     markerGraph.edges.createNew(
             largeDataName("GlobalMarkerGraphEdges"),
             largeDataPageSize);
+    markerGraph.edges.reserveAndResize(edgeCount);
     markerGraph.edgeMarkerIntervals.createNew(
             largeDataName("GlobalMarkerGraphEdgeMarkerIntervals"),
             largeDataPageSize);
+    markerGraph.edgesBySource.createNew(
+        largeDataName("GlobalMarkerGraphEdgesBySource"),
+        largeDataPageSize);
+    markerGraph.edgesByTarget.createNew(
+        largeDataName("GlobalMarkerGraphEdgesByTarget"),
+        largeDataPageSize);
+    markerGraph.edgeMarkerIntervals.beginPass1(edgeCount);
+    markerGraph.edgesBySource.beginPass1(markerGraph.vertexCount());
+    markerGraph.edgesByTarget.beginPass1(markerGraph.vertexCount());
+
+    // Pass 1 stores the edges and computes the sizes of all the other
+    // data structures. Pass 2 stores the marker intervals, edgesBySource,
+    // and edgesByTarget. Each thread processes entire runs.
+    setupLoadBalancing(data.runs.size(), 1);
+    runThreads(&Assembler::createMarkerGraphEdgesThreadFunction3, threadCount);
+    markerGraph.edgeMarkerIntervals.beginPass2();
+    markerGraph.edgesBySource.beginPass2();
+    markerGraph.edgesByTarget.beginPass2();
+    setupLoadBalancing(data.runs.size(), 1);
+    runThreads(&Assembler::createMarkerGraphEdgesThreadFunction4, threadCount);
+
+    // Pass 2 fills edgeMarkerIntervals and edgesBySource by position,
+    // without using the counts, so they are not checked.
+    markerGraph.edgeMarkerIntervals.endPass2(false);
+    markerGraph.edgesBySource.endPass2(false);
+    markerGraph.edgesByTarget.endPass2();
+
+    // Clean up.
+    data.runs.clear();
     for(size_t threadId=0; threadId<threadCount; threadId++) {
-        auto& thisThreadEdges = *createMarkerGraphEdgesData.threadEdges[threadId];
-        auto& thisThreadEdgeMarkerIntervals = *createMarkerGraphEdgesData.threadEdgeMarkerIntervals[threadId];
-        SHASTA_ASSERT(thisThreadEdges.size() == thisThreadEdgeMarkerIntervals.size());
-        for(size_t i=0; i<thisThreadEdges.size(); i++) {
-            const auto& edge = thisThreadEdges[i];
-            const auto edgeMarkerIntervals = thisThreadEdgeMarkerIntervals[i];
-            markerGraph.edges.push_back(edge);
-            markerGraph.edgeMarkerIntervals.appendVector();
-            for(auto edgeMarkerInterval: edgeMarkerIntervals) {
-                markerGraph.edgeMarkerIntervals.append(edgeMarkerInterval);
-            }
-        }
-        thisThreadEdges.remove();
-        thisThreadEdgeMarkerIntervals.remove();
+        data.threadEdges[threadId]->remove();
+        data.threadEdgeMarkerIntervals[threadId]->remove();
     }
-
-    markerGraph.edges.unreserve();
-    markerGraph.edgeMarkerIntervals.unreserve();
+    data.threadEdges.clear();
+    data.threadEdgeMarkerIntervals.clear();
 
     SHASTA_ASSERT(markerGraph.edges.size() == markerGraph.edgeMarkerIntervals.size());
     cout << "Found " << markerGraph.edges.size();
     cout << " edges for " << markerGraph.vertexCount() << " vertices." << endl;
+    performanceLog << timestamp << "createMarkerGraphEdges ends." << endl;
+}
 
 
 
-    // Now we need to create edgesBySource and edgesByTarget.
-    createMarkerGraphEdgesBySourceAndTarget(threadCount);
-    performanceLog << timestamp << "createMarkerGraphEdges ends." << endl;
+// Pass 1 of the merge of the runs of edges found by each thread.
+void Assembler::createMarkerGraphEdgesThreadFunction3(size_t)
+{
+    auto& data = createMarkerGraphEdgesData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t runIndex=begin; runIndex!=end; ++runIndex) {
+            const auto& run = data.runs[runIndex];
+            const auto& threadEdges = *data.threadEdges[run.threadId];
+            const auto& threadEdgeMarkerIntervals = *data.threadEdgeMarkerIntervals[run.threadId];
+
+            MarkerGraph::EdgeId edgeId = run.edgeBegin;
+            for(uint64_t i=run.threadEdgeBegin; i!=run.threadEdgeEnd; ++i, ++edgeId) {
+                const MarkerGraph::Edge& edge = threadEdges[i];
+                markerGraph.edges[edgeId] = edge;
+                markerGraph.edgeMarkerIntervals.incrementCount(edgeId, threadEdgeMarkerIntervals.size(i));
+
+                // The sources in a run are not used by any other run.
+                markerGraph.edgesBySource.incrementCount(edge.source);
+                markerGraph.edgesByTarget.incrementCountMultithreaded(edge.target);
+            }
+        }
+    }
+}
+
+
+
+// Pass 2 of the merge of the runs of edges found by each thread.
+void Assembler::createMarkerGraphEdgesThreadFunction4(size_t)
+{
+    auto& data = createMarkerGraphEdgesData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t runIndex=begin; runIndex!=end; ++runIndex) {
+            const auto& run = data.runs[runIndex];
+            const auto& threadEdgeMarkerIntervals = *data.threadEdgeMarkerIntervals[run.threadId];
+
+            MarkerGraph::EdgeId edgeId = run.edgeBegin;
+            MarkerGraph::VertexId source = MarkerGraph::invalidVertexId;
+            uint64_t sourcePosition = 0;
+            for(uint64_t i=run.threadEdgeBegin; i!=run.threadEdgeEnd; ++i, ++edgeId) {
+                const auto markerIntervals = threadEdgeMarkerIntervals[i];
+                copy(markerIntervals.begin(), markerIntervals.end(),
+                    markerGraph.edgeMarkerIntervals.begin(edgeId));
+
+                // The edges with the same source are contiguous
+                // and in order of increasing EdgeId.
+                const MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
+                if(edge.source != source) {
+                    source = edge.source;
+                    sourcePosition = 0;
+                }
+                markerGraph.edgesBySource[source][sourcePosition++] = Uint40(edgeId);
+                markerGraph.edgesByTarget.storeMultithreaded(edge.target, Uint40(edgeId));
+            }
+        }
+    }
 }
 
 
@@ -2043,34 +2467,43 @@ void Assembler::createMarkerGraphEdgesThreadFunction0(size_t threadId)
             largeDataPageSize);
 
     // Some things used inside the loop but defined here for performance.
-    vector< pair<MarkerGraph::VertexId, vector<MarkerInterval> > > children;
     vector< pair<MarkerGraph::VertexId, MarkerInterval> > workArea;
     MarkerGraph::Edge edge;
+    vector<CreateMarkerGraphEdgesData::Run>& threadRuns =
+        createMarkerGraphEdgesData.threadRuns[threadId];
 
     // Loop over all batches assigned to this thread.
+    // Each batch generates a run of edges sorted by source vertex.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
+        CreateMarkerGraphEdgesData::Run run;
+        run.vertexBegin = begin;
+        run.threadId = threadId;
+        run.threadEdgeBegin = thisThreadEdges.size();
 
         // Loop over all marker graph vertices assigned to this batch.
         for(MarkerGraph::VertexId vertex0=begin; vertex0!=end; ++vertex0) {
             edge.source = vertex0;
 
-            getGlobalMarkerGraphVertexChildren(vertex0, children, workArea);
-            for(const auto& p: children) {
-                const auto vertex1 = p.first;
-                const auto& markerIntervals = p.second;
-                edge.target = vertex1;
-
-                // Store the edge.
-                thisThreadEdges.push_back(edge);
-
-                // Store the marker intervals.
-                thisThreadEdgeMarkerIntervals.appendVector();
-                for(const MarkerInterval markerInterval: markerIntervals) {
-                    thisThreadEdgeMarkerIntervals.append(markerInterval);
+            // Get the (child vertex, marker interval) pairs, sorted by child vertex.
+            // Each streak with the same child vertex generates an edge.
+            getGlobalMarkerGraphVertexChildMarkerIntervals(vertex0, workArea);
+            for(uint64_t i=0; i<workArea.size(); i++) {
+                const auto vertex1 = workArea[i].first;
+                if(i == 0 or vertex1 != workArea[i - 1].first) {
+                    edge.target = vertex1;
+                    thisThreadEdges.push_back(edge);
+                    thisThreadEdgeMarkerIntervals.appendVector();
                 }
+                thisThreadEdgeMarkerIntervals.append(workArea[i].second);
             }
         }
+
+        run.threadEdgeEnd = thisThreadEdges.size();
+        run.edgeBegin = 0;
+        if(run.threadEdgeEnd != run.threadEdgeBegin) {
+            threadRuns.push_back(run);
+        }
     }
 
     thisThreadEdges.unreserve();
@@ -2142,6 +2575,24 @@ void Assembler::accessMarkerGraphEdges(
 
 
 
+void Assembler::createMarkerGraphEdgeOrientedReadIds(size_t threadCount)
+{
+    checkMarkerGraphEdgesIsOpen();
+    markerGraph.createEdgeOrientedReadIds(
+        largeDataName("MarkerGraphEdgeOrientedReadIds"),
+        largeDataPageSize, threadCount);
+}
+
+
+
+void Assembler::accessMarkerGraphEdgeOrientedReadIds()
+{
+    markerGraph.edgeOrientedReadIds.accessExistingReadOnly(
+        largeDataName("MarkerGraphEdgeOrientedReadIds"));
+}
+
+
+
 void Assembler::checkMarkerGraphEdgesIsOpen() const
 {
     SHASTA_ASSERT(markerGraph.edges.isOpen);
@@ -2253,14 +2704,25 @@ void Assembler::transitiveReduction(
     // Vector to store vertices encountered during a BFS.
     vector<VertexId> bfsVertices;
 
+    // The BFSs only use the edge targets and the
+    // wasRemovedByTransitiveReduction flags, so they use
+    // a structure-of-arrays copy of the edges.
+    // Flags are set via edgeArrays, which also sets them in the edges.
+    MarkerGraphEdgeArrays edgeArrays(markerGraph, true);
+    const auto weakFlag = MarkerGraphEdgeArrays::Flag::wasRemovedByTransitiveReduction;
+    auto flagAsWeak = [&](EdgeId edgeId)
+    {
+        edgeArrays.setFlag(weakFlag, edgeId, true);
+        edgeArrays.setFlag(weakFlag, markerGraph.reverseComplementEdge[edgeId], true);
+    };
+
 
 
     // Flag as weak all edges with coverage <= lowCoverageThreshold
     for(size_t coverage=1; coverage<=min(lowCoverageThreshold, maximumEdgeCoverage); coverage++) {
         const auto& edgesWithThisCoverage = edgesByCoverage[coverage];
         for(const EdgeId edgeId: edgesWithThisCoverage) {
-            edges[edgeId].wasRemovedByTransitiveReduction = 1;
-            edges[markerGraph.reverseComplementEdge[edgeId]].wasRemovedByTransitiveReduction = 1;
+            flagAsWeak(edgeId);
         }
     }
 
@@ -2279,9 +2741,8 @@ void Assembler::transitiveReduction(
         const MarkerInterval& markerInterval = markerIntervals[0];
         const uint32_t skip = markerInterval.ordinals[1] - markerInterval.ordinals[0];
         if(skip > edgeMarkerSkipThreshold) {
-            if(edges[edgeId].wasRemovedByTransitiveReduction == 0) {
-                edges[edgeId].wasRemovedByTransitiveReduction = 1;
-                edges[markerGraph.reverseComplementEdge[edgeId]].wasRemovedByTransitiveReduction = 1;
+            if(not edgeArrays.getFlag(weakFlag, edgeId)) {
+                flagAsWeak(edgeId);
                 coverage1HighSkipCount += 2;
             }
         }
@@ -2302,10 +2763,10 @@ void Assembler::transitiveReduction(
 
         // Loop over edges with this coverage.
         for(const EdgeId edgeId: edgesWithThisCoverage) {
-            const Edge& edge = edges[edgeId];
-            if(edge.wasRemovedByTransitiveReduction) {
+            if(edgeArrays.getFlag(weakFlag, edgeId)) {
                 continue;
             }
+            const Edge& edge = edges[edgeId];
             const VertexId u0 = edge.source;
             const VertexId u1 = edge.target;
 
@@ -2327,11 +2788,10 @@ void Assembler::transitiveReduction(
                     if(edgeId01 == edgeId) {
                         continue;
                     }
-                    const Edge& edge01 = markerGraph.edges[edgeId01];
-                    if(edge01.wasRemovedByTransitiveReduction) {
+                    if(edgeArrays.getFlag(weakFlag, edgeId01)) {
                         continue;
                     }
-                    const VertexId v1 = edge01.target;
+                    const VertexId v1 = edgeArrays.target(edgeId01);
                     if(vertexDistances[v1] >= 0) {
                         continue;   // We already encountered this vertex.
                     }
@@ -2352,8 +2812,7 @@ void Assembler::transitiveReduction(
             }
 
             if(found) {
-                edges[edgeId].wasRemovedByTransitiveReduction = 1;
-                edges[markerGraph.reverseComplementEdge[edgeId]].wasRemovedByTransitiveReduction = 1;
+                flagAsWeak(edgeId);
             }
 
             // Clean up to be ready to process the next edge.
@@ -2376,12 +2835,7 @@ void Assembler::transitiveReduction(
 
 
     // Count the number of edges that were flagged as weak.
-    uint64_t weakEdgeCount = 0;;
-    for(const auto& edge: markerGraph.edges) {
-        if(edge.wasRemovedByTransitiveReduction) {
-            ++weakEdgeCount;
-        }
-    }
+    const uint64_t weakEdgeCount = edgeArrays.countFlag(weakFlag);
     cout << "Transitive reduction removed " << weakEdgeCount << " marker graph edges out of ";
     cout << markerGraph.edges.size() << " total." << endl;
 
@@ -2560,72 +3014,78 @@ bool Assembler::markerGraphEdgeDisconnectsLocalStrongSubgraph(
 
 
 // Prune leaves from the strong subgraph of the global marker graph.
-void Assembler::pruneMarkerGraphStrongSubgraph(size_t iterationCount)
+void Assembler::pruneMarkerGraphStrongSubgraph(size_t iterationCount, size_t threadCount)
 {
     // Some shorthands.
     using VertexId = MarkerGraph::VertexId;
     using EdgeId = VertexId;
+    PruneMarkerGraphStrongSubgraphData& data = pruneMarkerGraphStrongSubgraphData;
 
     // Check that we have what we need.
     checkMarkerGraphVerticesAreAvailable();
     checkMarkerGraphEdgesIsOpen();
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     // Get the number of edges.
     auto& edges = markerGraph.edges;
     const EdgeId edgeCount = edges.size();
 
-    // Flags to mark edges to prune at each iteration.
-    MemoryMapped::Vector<bool> edgesToBePruned;
-    edgesToBePruned.createNew(
-        largeDataName("tmp-PruneMarkerGraphStrogngSubgraph"),
-        largeDataPageSize);
-    edgesToBePruned.resize(edgeCount);
-    fill(edgesToBePruned.begin(), edgesToBePruned.end(), false);
-
     // Clear the wasPruned flag of all edges.
     for(MarkerGraph::Edge& edge: edges) {
         edge.wasPruned = 0;
     }
 
+    data.isInFrontier.createNew(
+        largeDataName("tmp-PruneMarkerGraphStrongSubgraph"),
+        largeDataPageSize);
+    data.isInFrontier.resize(edgeCount);
+    fill(data.isInFrontier.begin(), data.isInFrontier.end(), uint8_t(0));
+    data.threadFrontiers.resize(threadCount);
+
 
 
     // At each prune iteration we prune one layer of leaves.
     for(size_t iteration=0; iteration!=iterationCount; iteration++) {
         performanceLog << timestamp << "Begin prune iteration " << iteration << endl;
 
-        // Find the edges to be pruned at each iteration.
-        for(EdgeId edgeId=0; edgeId<edgeCount; edgeId++) {
-            MarkerGraph::Edge& edge = edges[edgeId];
-            if(edge.wasRemovedByTransitiveReduction) {
-                continue;
-            }
-            if(edge.wasPruned) {
-                continue;
-            }
-            if(
-                isForwardLeafOfMarkerGraphPrunedStrongSubgraph(edge.target) ||
-                isBackwardLeafOfMarkerGraphPrunedStrongSubgraph(edge.source)
-                ) {
-                edgesToBePruned[edgeId] = true;
-            }
+        // Find the edges to be pruned at this iteration.
+        // At the first iteration we have to look at all edges.
+        // At the following iterations, an edge can only become
+        // prunable if it is adjacent to an edge pruned at the previous iteration.
+        if(iteration == 0) {
+            setupLoadBalancing(edgeCount, 100000);
+            runThreads(&Assembler::pruneMarkerGraphStrongSubgraphThreadFunction1, threadCount);
+        } else {
+            setupLoadBalancing(data.frontier.size(), 1000);
+            runThreads(&Assembler::pruneMarkerGraphStrongSubgraphThreadFunction2, threadCount);
         }
 
-
+        // Gather the new frontier.
+        data.frontier.clear();
+        for(vector<EdgeId>& threadFrontier: data.threadFrontiers) {
+            data.frontier.insert(data.frontier.end(), threadFrontier.begin(), threadFrontier.end());
+            threadFrontier.clear();
+        }
 
         // Flag the edges we found at this iteration.
-        EdgeId count = 0;
-        for(EdgeId edgeId=0; edgeId<edgeCount; edgeId++) {
-            if(edgesToBePruned[edgeId]) {
-                edges[edgeId].wasPruned = 1;
-                ++count;
-                edgesToBePruned[edgeId] = false;    // For next iteration.
-            }
+        for(const EdgeId edgeId: data.frontier) {
+            edges[edgeId].wasPruned = 1;
+            data.isInFrontier[edgeId] = 0;
         }
-        cout << "Pruned " << count << " edges at prune iteration " << iteration << "." << endl;
-    }
+        cout << "Pruned " << data.frontier.size() << " edges at prune iteration " << iteration << "." << endl;
 
+        if(data.frontier.empty()) {
+            break;
+        }
+    }
 
-    edgesToBePruned.remove();
+    data.isInFrontier.remove();
+    data.frontier.clear();
+    data.threadFrontiers.clear();
 
 
     // Count the number of surviving edges in the pruned strong subgraph.
@@ -2641,6 +3101,78 @@ void Assembler::pruneMarkerGraphStrongSubgraph(size_t iterationCount)
 }
 
 
+
+// Find the first layer of edges to be pruned by looking at all edges.
+void Assembler::pruneMarkerGraphStrongSubgraphThreadFunction1(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(MarkerGraph::EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            if(isPrunableEdgeOfMarkerGraphStrongSubgraph(edgeId)) {
+                addToPruneMarkerGraphStrongSubgraphFrontier(threadId, edgeId);
+            }
+        }
+    }
+}
+
+
+
+// Find the next layer of edges to be pruned by looking
+// only at the edges adjacent to the ones pruned at the previous iteration.
+// If edge (u, v) was pruned, only the edges with target u
+// and the edges with source v can have become leaves.
+void Assembler::pruneMarkerGraphStrongSubgraphThreadFunction2(size_t threadId)
+{
+    const vector<MarkerGraph::EdgeId>& frontier = pruneMarkerGraphStrongSubgraphData.frontier;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const MarkerGraph::Edge& prunedEdge = markerGraph.edges[frontier[i]];
+            for(const MarkerGraph::EdgeId edgeId: markerGraph.edgesByTarget[prunedEdge.source]) {
+                if(isPrunableEdgeOfMarkerGraphStrongSubgraph(edgeId)) {
+                    addToPruneMarkerGraphStrongSubgraphFrontier(threadId, edgeId);
+                }
+            }
+            for(const MarkerGraph::EdgeId edgeId: markerGraph.edgesBySource[prunedEdge.target]) {
+                if(isPrunableEdgeOfMarkerGraphStrongSubgraph(edgeId)) {
+                    addToPruneMarkerGraphStrongSubgraphFrontier(threadId, edgeId);
+                }
+            }
+        }
+    }
+}
+
+
+
+// An edge of the pruned strong subgraph is prunable if it is a leaf,
+// that is, if its target is a forward leaf or its source is a backward leaf.
+bool Assembler::isPrunableEdgeOfMarkerGraphStrongSubgraph(MarkerGraph::EdgeId edgeId) const
+{
+    const MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
+    if(edge.wasRemovedByTransitiveReduction) {
+        return false;
+    }
+    if(edge.wasPruned) {
+        return false;
+    }
+    return
+        isForwardLeafOfMarkerGraphPrunedStrongSubgraph(edge.target) ||
+        isBackwardLeafOfMarkerGraphPrunedStrongSubgraph(edge.source);
+}
+
+
+
+// Add an edge to the next frontier, unless another thread already did.
+void Assembler::addToPruneMarkerGraphStrongSubgraphFrontier(size_t threadId, MarkerGraph::EdgeId edgeId)
+{
+    PruneMarkerGraphStrongSubgraphData& data = pruneMarkerGraphStrongSubgraphData;
+    if(__sync_bool_compare_and_swap(&data.isInFrontier[edgeId], uint8_t(0), uint8_t(1))) {
+        data.threadFrontiers[threadId].push_back(edgeId);
+    }
+}
+
+
 // Find out if a vertex is a forward or backward leaf of the pruned
 // strong subgraph of the marker graph.
 // A forward leaf is a vertex with out-degree 0.
@@ -2827,7 +3359,9 @@ size_t Assembler::markerGraphPrunedStrongSubgraphInDegree(
 void Assembler::computeMarkerGraphVertexConsensusSequence(
     MarkerGraph::VertexId vertexId,
     vector<Base>& sequence,
-    vector<uint32_t>& repeatCounts
+    vector<uint32_t>& repeatCounts,
+    vector<Coverage>& coverages,
+    vector<Consensus>& consensus
     )
 {
 
@@ -2849,14 +3383,13 @@ void Assembler::computeMarkerGraphVertexConsensusSequence(
 
 
     // Loop over all base positions of this marker.
+    // At each position, gather base and repeat count information
+    // in a Coverage object.
     const size_t k = assemblerInfo->k;
-    sequence.resize(k);
-    repeatCounts.resize(k);
+    coverages.resize(k);
     for(uint32_t position=0; position<uint32_t(k); position++) {
-
-        // Object to store base and repeat count information
-        // at this position.
-        Coverage coverage;
+        Coverage& coverage = coverages[position];
+        coverage.reset();
 
         // Loop over markers.
         for(size_t i=0; i<markerCount; i++) {
@@ -2879,11 +3412,16 @@ void Assembler::computeMarkerGraphVertexConsensusSequence(
         for(const CoverageData& c: coverageData) {
             SHASTA_ASSERT(Base(c.base) == firstBase);
         }
+    }
 
-        // Compute the consensus.
-        const Consensus consensus = (*consensusCaller)(coverage);
-        sequence[position] = Base(consensus.base);
-        repeatCounts[position] = uint32_t(consensus.repeatCount);
+    // Compute the consensus at all positions.
+    consensus.resize(k);
+    consensusCaller->callBatch(coverages, consensus);
+    sequence.resize(k);
+    repeatCounts.resize(k);
+    for(uint32_t position=0; position<uint32_t(k); position++) {
+        sequence[position] = Base(consensus[position].base);
+        repeatCounts[position] = uint32_t(consensus[position].repeatCount);
     }
 }
 
@@ -2899,8 +3437,7 @@ void Assembler::computeMarkerGraphVertexConsensusSequence(
 void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
     MarkerGraph::EdgeId edgeId,
     uint32_t markerGraphEdgeLengthThresholdForConsensus,
-    const std::unique_ptr<spoa::AlignmentEngine>& spoaAlignmentEngine,
-    spoa::Graph& spoaAlignmentGraph,
+    SpoaEnginePool& spoaEnginePool,
     vector<Base>& sequence,
     vector<uint32_t>& repeatCounts,
     uint8_t& overlappingBaseCount,
@@ -3136,7 +3673,10 @@ void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
     // Gather all of the intervening sequences and repeatCounts, keeping track of distinct
     // sequences. For each sequence we store a vector of i values
     // where each sequence appear.
+    // To find distinct sequences quickly, we also store a hash of each distinct sequence.
+    // In RLE, the sequences and their hashes use the run-length representation.
     vector< vector<Base> > distinctSequences;
+    vector<uint64_t> distinctSequenceHashes;
     vector< vector<size_t> >& distinctSequenceOccurrences = detail.distinctSequenceOccurrences;
     distinctSequenceOccurrences.clear();
     vector<bool> isUsed(markerCount);
@@ -3198,15 +3738,24 @@ void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
         }
 
         // Store, making sure to check if we already encountered this sequence.
-        const auto it = find(distinctSequences.begin(), distinctSequences.end(), interveningSequence);
-        if(it == distinctSequences.end()) {
+        // Sequences are only compared when their hashes agree.
+        const uint64_t hash = MurmurHash64A(
+            interveningSequence.data(), int(interveningSequence.size() * sizeof(Base)), 759);
+        uint64_t j = 0;
+        for(; j<distinctSequences.size(); j++) {
+            if(distinctSequenceHashes[j] == hash and distinctSequences[j] == interveningSequence) {
+                break;
+            }
+        }
+        if(j == distinctSequences.size()) {
             // We did not already encountered this sequence.
             distinctSequences.push_back(interveningSequence);
+            distinctSequenceHashes.push_back(hash);
             distinctSequenceOccurrences.resize(distinctSequenceOccurrences.size() + 1);
             distinctSequenceOccurrences.back().push_back(i);
         } else {
             // We already encountered this sequence,
-            distinctSequenceOccurrences[it - distinctSequences.begin()].push_back(i);
+            distinctSequenceOccurrences[j].push_back(i);
         }
     }
 
@@ -3261,9 +3810,144 @@ void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
     }
 
 
-    // We are now ready to compute the spoa alignment for the distinct sequences.
+    // Both the fast path below and the general case
+    // use this to store the consensus at one position of the alignment.
+    sequence.clear();
+    repeatCounts.clear();
+    detail.alignedConsensus.clear();
+    detail.alignedRepeatCounts.clear();
+    overlappingBaseCount = 0;
+    if(coverageData) {
+        coverageData->clear();
+    }
+    auto storeConsensus = [&](
+        const Consensus& consensus,
+        const vector<CompressedCoverageData>& compressedCoverageData)
+    {
+        // If not a gap, store the base and repeat count.
+        if(!consensus.base.isGap()) {
+            sequence.push_back(Base(consensus.base));
+            SHASTA_ASSERT(consensus.repeatCount > 0);
+            repeatCounts.push_back(uint32_t(consensus.repeatCount));
+
+            // Also store detailed coverage data, if requested.
+            if(coverageData) {
+                for(const CompressedCoverageData& cd: compressedCoverageData) {
+                    coverageData->push_back(make_pair(sequence.size()-1, cd));
+                }
+            }
+        }
+
+        // Also store aligned consensus.
+        detail.alignedConsensus.push_back(consensus.base);
+        uint8_t repeatCount;
+        if(consensus.base.isGap()) {
+            repeatCount = 0;
+        } else {
+            if(consensus.repeatCount < 256) {
+                repeatCount = uint8_t(consensus.repeatCount);
+            } else {
+                repeatCount = 255;
+            }
+        }
+        detail.alignedRepeatCounts.push_back(repeatCount);
+    };
+
+
+
+    // Fast path for the common case where all the marker intervals we use
+    // have the same intervening sequence.
+    // The multiple sequence alignment is then the sequence itself, without gaps,
+    // and we don't need spoa.
+    // At positions where all reads also have the same repeat count, the Coverage
+    // only depends on the base and repeat count, because the number of reads
+    // on each strand is the same at all positions. So we compute consensus
+    // only once for each distinct base and repeat count, and reuse it.
+    // This gives the same results as the general case.
+    if(distinctSequences.size() == 1) {
+        const vector<Base>& distinctSequence = distinctSequences.front();
+        const vector<size_t>& occurrences = distinctSequenceOccurrences.front();
+        const bool isRle = (assemblerInfo->readRepresentation == 1);
+
+        vector<string>& msa = detail.msa;
+        msa.resize(1);
+        msa.front().clear();
+        for(const Base base: distinctSequence) {
+            msa.front() += base.character();
+        }
+
+        class CachedConsensus {
+        public:
+            AlignedBase base;
+            uint32_t repeatCount;
+            Consensus consensus;
+            vector<CompressedCoverageData> compressedCoverageData;
+        };
+        vector<CachedConsensus> cache;
+        Coverage coverage;
+        vector<CompressedCoverageData> compressedCoverageData;
+
+        for(size_t position=0; position<distinctSequence.size(); position++) {
+            const AlignedBase base = AlignedBase(distinctSequence[position]);
+
+            // Check if all reads have the same repeat count at this position.
+            const uint32_t repeatCount = isRle ? interveningRepeatCounts[occurrences.front()][position] : 1;
+            bool isUnanimous = true;
+            if(isRle) {
+                for(const size_t i: occurrences) {
+                    if(interveningRepeatCounts[i][position] != repeatCount) {
+                        isUnanimous = false;
+                        break;
+                    }
+                }
+            }
+
+            // If so, look for a consensus we already computed.
+            if(isUnanimous) {
+                const CachedConsensus* cached = 0;
+                for(const CachedConsensus& c: cache) {
+                    if(c.base.value == base.value and c.repeatCount == repeatCount) {
+                        cached = &c;
+                        break;
+                    }
+                }
+                if(cached) {
+                    storeConsensus(cached->consensus, cached->compressedCoverageData);
+                    continue;
+                }
+            }
 
-    spoaAlignmentGraph.Clear();
+            // Compute the consensus at this position.
+            coverage.reset();
+            for(const size_t i: occurrences) {
+                coverage.addRead(
+                    base,
+                    markerIntervals[i].orientedReadId.getStrand(),
+                    isRle ? interveningRepeatCounts[i][position] : 1);
+            }
+            const Consensus consensus = (*consensusCaller)(coverage);
+            if(coverageData) {
+                coverage.count(compressedCoverageData);
+            }
+            storeConsensus(consensus, compressedCoverageData);
+            if(isUnanimous) {
+                cache.push_back({base, repeatCount, consensus, compressedCoverageData});
+            }
+        }
+        return;
+    }
+
+
+
+    // We are now ready to compute the spoa alignment for the distinct sequences.
+    // Use the spoa engine for the length of the longest distinct sequence.
+    uint64_t maxDistinctSequenceLength = 0;
+    for(const vector<Base>& distinctSequence: distinctSequences) {
+        maxDistinctSequenceLength = max(maxDistinctSequenceLength, uint64_t(distinctSequence.size()));
+    }
+    const std::unique_ptr<spoa::AlignmentEngine>& spoaAlignmentEngine =
+        spoaEnginePool.getEngine(maxDistinctSequenceLength);
+    spoa::Graph& spoaAlignmentGraph = spoaEnginePool.getClearedGraph();
     // Add the sequences to the alignment, in order of decreasing frequency.
     string sequenceString;
     for(const auto& p: distinctSequenceTable) {
@@ -3298,32 +3982,19 @@ void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
 
 
     // Construct the edge sequence (and repeat counts if working in RLE).
-    // We loop over all positions in the alignment.
-    // At each position we compute a consensus base and repeat count.
-    // If the consensus base is not '-', we store the base and repeat count.
-    sequence.clear();
-    repeatCounts.clear();
-    detail.alignedConsensus.clear();
-    detail.alignedRepeatCounts.clear();
-    overlappingBaseCount = 0;
-    if(coverageData) {
-        coverageData->clear();
-    }
-
-
-
     // We loop over all positions in the alignment.
     // At each position we compute a consensus base and repeat count.
     // If the consensus bases is not '-', we store the base and repeat count.
+    // We first gather the coverage at all positions, then compute consensus
+    // at all positions with a single call to the consensus caller.
     vector<uint32_t> positions(markerCount, 0);
+    vector<Coverage> coverages(alignmentLength);
     for(size_t position=0; position<alignmentLength; position++) {
 
         if(debug) {
-            cout << "Computing consensus repeat count at alignment position " << position << endl;
+            cout << "Gathering coverage at alignment position " << position << endl;
         }
-
-        // Create a Coverage object for this position.
-        Coverage coverage;
+        Coverage& coverage = coverages[position];
 
         // Loop over distinct sequences, in the same order in
         // which we presented them to spoa.
@@ -3362,39 +4033,19 @@ void Assembler::computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
                 }
             }
         }
+    }
 
-        // Compute the consensus at this position.
-        const Consensus consensus = (*consensusCaller)(coverage);
-
-        // If not a gap, store the base and repeat count.
-        if(!consensus.base.isGap()) {
-            sequence.push_back(Base(consensus.base));
-            SHASTA_ASSERT(consensus.repeatCount > 0);
-            repeatCounts.push_back(uint32_t(consensus.repeatCount));
-
-            // Also store detailed coverage data, if requested.
-            if(coverageData) {
-                vector<CompressedCoverageData> c;
-                coverage.count(c);
-                for(const CompressedCoverageData& cd: c) {
-                    coverageData->push_back(make_pair(sequence.size()-1, cd));
-                }
-            }
-        }
+    // Compute the consensus at all positions.
+    vector<Consensus> alignedConsensus(alignmentLength);
+    consensusCaller->callBatch(coverages, alignedConsensus);
 
-        // Also store aligned consensus.
-        detail.alignedConsensus.push_back(consensus.base);
-        uint8_t repeatCount;
-        if(consensus.base.isGap()) {
-            repeatCount = 0;
-        } else {
-            if(consensus.repeatCount < 256) {
-                repeatCount = uint8_t(consensus.repeatCount);
-            } else {
-                repeatCount = 255;
-            }
+    // Store the results.
+    vector<CompressedCoverageData> compressedCoverageData;
+    for(size_t position=0; position<alignmentLength; position++) {
+        if(coverageData) {
+            coverages[position].count(compressedCoverageData);
         }
-        detail.alignedRepeatCounts.push_back(repeatCount);
+        storeConsensus(alignedConsensus[position], compressedCoverageData);
     }
 
     if(debug) {
@@ -3431,6 +4082,10 @@ void Assembler::simplifyMarkerGraph(
     for(MarkerGraph::Edge& edge: markerGraph.edges) {
         edge.isSuperBubbleEdge = 0;
     }
+    auto& data = simplifyMarkerGraphData;
+    if(data.previousChains.isOpen()) {
+        data.previousChains.remove();
+    }
 
 
 
@@ -3446,6 +4101,10 @@ void Assembler::simplifyMarkerGraph(
         simplifyMarkerGraphIterationPart2(iteration, maxLength, debug);
     }
     checkMarkerGraphIsStrandSymmetric();
+    if(data.previousChains.isOpen()) {
+        data.previousChains.remove();
+    }
+    data.previousReverseComplementChain.clear();
 
 
 
@@ -3505,8 +4164,7 @@ void Assembler::simplifyMarkerGraphIterationPart1(
     }
 
     // Create a temporary assembly graph.
-    createAssemblyGraphEdges();
-    createAssemblyGraphVertices();
+    createSimplifyMarkerGraphAssemblyGraph();
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     if(debug) {
         assemblyGraph.writeGfa1BothStrandsNoSequence(
@@ -3613,6 +4271,7 @@ void Assembler::simplifyMarkerGraphIterationPart1(
 
 
     // Remove the assembly graph we created at this iteration.
+    saveSimplifyMarkerGraphChains();
     assemblyGraph.remove();
 
 
@@ -3633,8 +4292,7 @@ void Assembler::simplifyMarkerGraphIterationPart2(
     }
 
     // Create a temporary assembly graph.
-    createAssemblyGraphEdges();
-    createAssemblyGraphVertices();
+    createSimplifyMarkerGraphAssemblyGraph();
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
     if(debug) {
         assemblyGraph.writeGfa1BothStrandsNoSequence(
@@ -4219,12 +4877,52 @@ void Assembler::simplifyMarkerGraphIterationPart2(
 
 
     // Remove the assembly graph we created at this iteration.
+    saveSimplifyMarkerGraphChains();
     assemblyGraph.remove();
 
 }
 
 
 
+// Create the temporary assembly graph for one part of an iteration
+// of simplifyMarkerGraph.
+void Assembler::createSimplifyMarkerGraphAssemblyGraph()
+{
+    auto& data = simplifyMarkerGraphData;
+    if(data.previousChains.isOpen()) {
+        createAssemblyGraphEdgesIncremental(data.previousChains, data.previousReverseComplementChain);
+    } else {
+        createAssemblyGraphEdges();
+    }
+    createAssemblyGraphVertices();
+}
+
+
+
+// Save the chains of the temporary assembly graph before it is removed,
+// so the next part can reuse the ones that don't change.
+void Assembler::saveSimplifyMarkerGraphChains()
+{
+    auto& data = simplifyMarkerGraphData;
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+
+    if(data.previousChains.isOpen()) {
+        data.previousChains.clear();
+    } else {
+        data.previousChains.createNew(
+            largeDataName("tmp-SimplifyMarkerGraphPreviousChains"),
+            largeDataPageSize);
+    }
+    for(AssemblyGraph::EdgeId edgeId=0; edgeId<assemblyGraph.edgeLists.size(); edgeId++) {
+        const span<const AssemblyGraph::EdgeId> chain = assemblyGraph.edgeLists[edgeId];
+        data.previousChains.appendVector(chain.begin(), chain.end());
+    }
+    data.previousReverseComplementChain.assign(
+        assemblyGraph.reverseComplementEdge.begin(), assemblyGraph.reverseComplementEdge.end());
+}
+
+
+
 // Compute consensus repeat counts for each vertex of the marker graph.
 void Assembler::assembleMarkerGraphVertices(size_t threadCount)
 {
@@ -4264,7 +4962,11 @@ void Assembler::assembleMarkerGraphVerticesThreadFunction(size_t threadId)
 {
     vector<Base> sequence;
     vector<uint32_t> repeatCounts;
+    vector<Coverage> coverages;
+    vector<Consensus> consensus;
+    vector<uint8_t> repeatCountMatrix;
     const size_t k = assemblerInfo->k;
+    const bool useRepeatCountsOnly = consensusCaller->canCallRepeatCounts();
 
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
@@ -4274,7 +4976,11 @@ void Assembler::assembleMarkerGraphVerticesThreadFunction(size_t threadId)
         for(MarkerGraph::VertexId vertexId=begin; vertexId!=end; vertexId++) {
 
             // Compute the optimal repeat counts for this vertex.
-            computeMarkerGraphVertexConsensusSequence(vertexId, sequence, repeatCounts);
+            if(useRepeatCountsOnly) {
+                computeMarkerGraphVertexConsensusRepeatCounts(vertexId, repeatCountMatrix, repeatCounts);
+            } else {
+                computeMarkerGraphVertexConsensusSequence(vertexId, sequence, repeatCounts, coverages, consensus);
+            }
 
             // Store them.
             SHASTA_ASSERT(repeatCounts.size() == k);
@@ -4286,6 +4992,49 @@ void Assembler::assembleMarkerGraphVerticesThreadFunction(size_t threadId)
 
 
 
+// Faster computation of the consensus repeat counts of a vertex.
+// This does not check that all markers have the same bases,
+// as computeMarkerGraphVertexConsensusSequence does.
+void Assembler::computeMarkerGraphVertexConsensusRepeatCounts(
+    MarkerGraph::VertexId vertexId,
+    vector<uint8_t>& repeatCountMatrix,
+    vector<uint32_t>& repeatCounts) const
+{
+    const span<const MarkerId> markerIds = markerGraph.getVertexMarkerIds(vertexId);
+    const uint64_t markerCount = markerIds.size();
+    SHASTA_ASSERT(markerCount > 0);
+    const uint32_t k = uint32_t(assemblerInfo->k);
+
+    // Gather the repeat counts, one column for each marker.
+    repeatCountMatrix.resize(k * markerCount);
+    for(uint64_t i=0; i<markerCount; i++) {
+        const MarkerId markerId = markerIds[i];
+        const OrientedReadId orientedReadId = findMarkerId(markerId).first;
+        const ReadId readId = orientedReadId.getReadId();
+        const uint32_t markerPosition = markers.begin()[markerId].position;
+        const RepeatCountsView counts = reads->getReadRepeatCounts(readId);
+
+        if(orientedReadId.getStrand() == 0) {
+            for(uint32_t position=0; position<k; position++) {
+                repeatCountMatrix[position * markerCount + i] = counts[markerPosition + position];
+            }
+        } else {
+            // Positions on the reverse complemented read.
+            const uint32_t baseCount = uint32_t(reads->getRead(readId).baseCount);
+            for(uint32_t position=0; position<k; position++) {
+                repeatCountMatrix[position * markerCount + i] =
+                    counts[baseCount - 1 - (markerPosition + position)];
+            }
+        }
+    }
+
+    // Compute the consensus repeat counts.
+    repeatCounts.resize(k);
+    consensusCaller->callRepeatCounts(repeatCountMatrix, markerCount, repeatCounts);
+}
+
+
+
 void Assembler::accessMarkerGraphVertexRepeatCounts()
 {
     markerGraph.vertexRepeatCounts.accessExistingReadOnly(
@@ -4339,15 +5088,15 @@ void Assembler::computeMarkerGraphVerticesCoverageData(size_t threadCount)
 
     // Gather the results computed by all the threads.
     markerGraph.vertexCoverageData.createNew(
-        largeDataName("MarkerGraphVerticesCoverageData"), largeDataPageSize);
+        largeDataName("MarkerGraphVerticesCompressedCoverageData"), largeDataPageSize);
     for(MarkerGraph::VertexId vertexId=0; vertexId!=markerGraph.vertexCount(); vertexId++) {
         const auto& p = vertexTable[vertexId];
         const size_t threadId = p.first;
         const size_t i = p.second;
         SHASTA_ASSERT(threadId != invalidValue);
         SHASTA_ASSERT(i != invalidValue);
-        const auto v = (*computeMarkerGraphVerticesCoverageDataData.threadVertexCoverageData[threadId])[i];
-        markerGraph.vertexCoverageData.appendVector(v.begin(), v.end());
+        markerGraph.vertexCoverageData.appendEncoded(
+            computeMarkerGraphVerticesCoverageDataData.threadVertexCoverageData[threadId]->getEncoded(i));
     }
 
     markerGraph.vertexCoverageData.unreserve();
@@ -4372,8 +5121,7 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
     ComputeMarkerGraphVerticesCoverageDataData& data = computeMarkerGraphVerticesCoverageDataData;
     data.threadVertexIds[threadId] =
         make_shared< MemoryMapped::Vector<MarkerGraph::VertexId> >();
-    data.threadVertexCoverageData[threadId] =
-        make_shared< MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t> >();
+    data.threadVertexCoverageData[threadId] = make_shared<CoverageDataStore>();
     auto& threadVertexIds = *data.threadVertexIds[threadId];
     auto& threadCoverageData = *data.threadVertexCoverageData[threadId];
     threadVertexIds.createNew(
@@ -4387,6 +5135,8 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
     vector< pair<OrientedReadId, uint32_t> > markerInfos;
     vector<uint32_t> markerPositions;
     vector<CompressedCoverageData> compressedCoverageData;
+    vector< pair<uint32_t, CompressedCoverageData> > vertexCoverageData;
+    Coverage coverage;
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
@@ -4411,12 +5161,12 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
 
             // Loop over the k base positions in this vertex.
             threadVertexIds.push_back(vertexId);
-            threadCoverageData.appendVector();
+            vertexCoverageData.clear();
             for(uint32_t position=0; position<uint32_t(assemblerInfo->k); position++) {
 
-                // Object to store base and repeat count information
+                // Prepare the object to store base and repeat count information
                 // at this position.
-                Coverage coverage;
+                coverage.reset();
 
                 // Loop over markers.
                 for(size_t i=0; i<markerCount; i++) {
@@ -4443,9 +5193,10 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
                 // Store the results.
                 coverage.count(compressedCoverageData);
                 for(const CompressedCoverageData& cd: compressedCoverageData) {
-                    threadCoverageData.append(make_pair(position, cd));
+                    vertexCoverageData.push_back(make_pair(position, cd));
                 }
             }
+            threadCoverageData.append(vertexCoverageData);
         }
     }
 
@@ -4494,11 +5245,33 @@ void Assembler::assembleMarkerGraphEdges(
     if(storeCoverageData) {
         assembleMarkerGraphEdgesData.threadEdgeCoverageData.resize(threadCount);
     }
-    // The batch size should not be too big, to avoid loss of parallelism
+    // The minimum batch size should not be too big, to avoid loss of parallelism
     // in small assemblies with high coverage (see discussion in issue #70).
+    // Guided load balancing uses edge coverage as an estimate of the cost
+    // of assembling each edge, so batches shrink towards the end.
     const size_t batchSize = 10;
-    setupLoadBalancing(markerGraph.edges.size(), batchSize);
+    markerGraph.edges.advise(MemoryMapped::AccessPattern::sequential);
+    markerGraph.edgeMarkerIntervals.advise(MemoryMapped::AccessPattern::sequential);
+    setupGuidedLoadBalancing(markerGraph.edges.size(), batchSize,
+        [this, assembleAllEdges](uint64_t edgeId)
+        {
+            if(not assembleAllEdges and markerGraph.edges[edgeId].wasRemoved()) {
+                return uint64_t(1);
+            }
+            return uint64_t(1 + markerGraph.edgeMarkerIntervals.size(edgeId));
+        });
+    if(slowItemTracingIsEnabled()) {
+        assembleMarkerGraphEdgesData.slowItems = make_shared<SlowItemTracer>(
+            "Marker graph edges", "EdgeId",
+            vector<string>({"Coverage", "Sequence length"}));
+    }
     runThreads(&Assembler::assembleMarkerGraphEdgesThreadFunction, threadCount);
+    if(assembleMarkerGraphEdgesData.slowItems) {
+        assembleMarkerGraphEdgesData.slowItems->write();
+        assembleMarkerGraphEdgesData.slowItems.reset();
+    }
+    markerGraph.edges.advise(MemoryMapped::AccessPattern::normal);
+    markerGraph.edgeMarkerIntervals.advise(MemoryMapped::AccessPattern::normal);
 
 
     // Figure out where the results for each edge are.
@@ -4522,7 +5295,7 @@ void Assembler::assembleMarkerGraphEdges(
     markerGraph.edgeConsensusOverlappingBaseCount.resize(markerGraph.edges.size());
     if(storeCoverageData) {
         markerGraph.edgeCoverageData.createNew(
-            largeDataName("MarkerGraphEdgesCoverageData"), largeDataPageSize);
+            largeDataName("MarkerGraphEdgesCompressedCoverageData"), largeDataPageSize);
     }
     for(MarkerGraph::EdgeId edgeId=0; edgeId!=markerGraph.edges.size(); edgeId++) {
         const auto& p = edgeTable[edgeId];
@@ -4539,8 +5312,8 @@ void Assembler::assembleMarkerGraphEdges(
             (*assembleMarkerGraphEdgesData.threadEdgeConsensusOverlappingBaseCount[threadId])[i];
 
         if(storeCoverageData) {
-            const auto& v = (*assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId])[i];
-            markerGraph.edgeCoverageData.appendVector(v.begin(), v.end());
+            markerGraph.edgeCoverageData.appendEncoded(
+                assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId]->getEncoded(i));
         }
     }
 
@@ -4573,9 +5346,9 @@ void Assembler::accessMarkerGraphCoverageData()
 {
     try {
         markerGraph.vertexCoverageData.accessExistingReadOnly(
-            largeDataName("MarkerGraphVerticesCoverageData"));
+            largeDataName("MarkerGraphVerticesCompressedCoverageData"));
         markerGraph.edgeCoverageData.accessExistingReadOnly(
-            largeDataName("MarkerGraphEdgesCoverageData"));
+            largeDataName("MarkerGraphEdgesCompressedCoverageData"));
 
     } catch (const std::exception&) {
         throw runtime_error("Coverage data is not available. It is only stored if shasta.conf has "
@@ -4591,6 +5364,7 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
     const uint32_t markerGraphEdgeLengthThresholdForConsensus = assembleMarkerGraphEdgesData.markerGraphEdgeLengthThresholdForConsensus;
     const bool storeCoverageData = assembleMarkerGraphEdgesData.storeCoverageData;
     const bool assembleAllEdges = assembleMarkerGraphEdgesData.assembleAllEdges;
+    SlowItemTracer* slowItems = assembleMarkerGraphEdgesData.slowItems.get();
 
     // Allocate space for the results computed by this thread.
     assembleMarkerGraphEdgesData.threadEdgeIds[threadId] =
@@ -4615,7 +5389,7 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
 
     if(storeCoverageData) {
         assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId] =
-            make_shared<MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t> >();
+            make_shared<CoverageDataStore>();
         assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId]->createNew(
             largeDataName("tmp-assembleMarkerGraphEdges-edgeCoverageData" + to_string(threadId)), largeDataPageSize);
     }
@@ -4625,12 +5399,10 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
     uint8_t overlappingBaseCount;
     vector< pair<uint32_t, CompressedCoverageData> > coverageData;
 
-    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
-    const int8_t match = 1;
-    const int8_t mismatch = -1;
-    const int8_t gap = -1;
-    auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
-    spoa::Graph spoaAlignmentGraph;
+    // The spoa engines and the details are reused for all edges
+    // processed by this thread.
+    SpoaEnginePool spoaEnginePool;
+    ComputeMarkerGraphEdgeConsensusSequenceUsingSpoaDetail detail;
 
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
@@ -4669,11 +5441,11 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
                 overlappingBaseCount = 0;
             } else {
                 markerGraph.edges[edgeId].wasAssembled = 1;
+                const auto t0 = slowItems ? steady_clock::now() : steady_clock::time_point();
                 try {
-                    ComputeMarkerGraphEdgeConsensusSequenceUsingSpoaDetail detail;
                     computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
                         edgeId, markerGraphEdgeLengthThresholdForConsensus,
-                        spoaAlignmentEngine, spoaAlignmentGraph,
+                        spoaEnginePool,
                         sequence, repeatCounts, overlappingBaseCount,
                         detail,
                         storeCoverageData ? &coverageData : 0
@@ -4690,6 +5462,11 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
                         "marker graph edge " << edgeId << ":" << endl;
                     throw;
                 }
+                if(slowItems) {
+                    slowItems->record(edgeId, seconds(steady_clock::now() - t0), {
+                        markerGraph.edgeMarkerIntervals.size(edgeId),
+                        sequence.size()});
+                }
             }
 
             // Store the results.
@@ -4702,7 +5479,7 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
             }
             overlappingBaseCountVector.push_back(overlappingBaseCount);
             if(storeCoverageData) {
-                assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId]->appendVector(coverageData);
+                assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId]->append(coverageData);
             }
 
         }
@@ -4711,6 +5488,9 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
     edgeIds.unreserve();
     consensus.unreserve();
     overlappingBaseCountVector.unreserve();
+    if(storeCoverageData) {
+        assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId]->unreserve();
+    }
 }
 
 
@@ -4742,43 +5522,31 @@ void Assembler::accessMarkerGraphConsensus()
 // Output is to csv files.
 void Assembler::computeMarkerGraphCoverageHistogram()
 {
+    // Both histograms are computed in parallel using all hardware threads.
+    const size_t threadCount = 0;
 
     // Vertices.
-    vector<uint64_t> vertexCoverageHistogram;
-    for(MarkerGraph::VertexId vertexId=0;
-        vertexId<markerGraph.vertexCount(); vertexId++) {
-
-        // Check if this vertex is isolated.
-        bool isIsolated = true;
-        // Look at the out-edges.
-        for(const MarkerGraph::EdgeId edgeId: markerGraph.edgesBySource[vertexId]) {
-            if(!markerGraph.edges[edgeId].wasRemoved()) {
-                isIsolated = false;
-                break;
+    const vector<uint64_t> vertexCoverageHistogram = parallelHistogram(
+        markerGraph.vertexCount(), 100000, threadCount,
+        [&](uint64_t vertexId)
+        {
+            // Check if this vertex is isolated.
+            // Look at the out-edges.
+            for(const MarkerGraph::EdgeId edgeId: markerGraph.edgesBySource[vertexId]) {
+                if(!markerGraph.edges[edgeId].wasRemoved()) {
+                    return uint64_t(markerGraph.vertexCoverage(vertexId));
+                }
             }
-        }
-        if(isIsolated) {
             // We did not find any out-edges. Look at the in-edges.
             for(const MarkerGraph::EdgeId edgeId: markerGraph.edgesByTarget[vertexId]) {
                 if(!markerGraph.edges[edgeId].wasRemoved()) {
-                    isIsolated = false;
-                    break;
+                    return uint64_t(markerGraph.vertexCoverage(vertexId));
                 }
             }
-        }
-
-        // If isolated, skip it.
-        if(isIsolated) {
-            continue;
-        }
 
-        // Increment the histogram.
-        const size_t coverage = markerGraph.vertexCoverage(vertexId);
-        if(coverage >= vertexCoverageHistogram.size()) {
-            vertexCoverageHistogram.resize(coverage+1, 0);
-        }
-        ++vertexCoverageHistogram[coverage];
-    }
+            // If isolated, skip it.
+            return invalid<uint64_t>;
+        });
     ofstream verticesCsv("MarkerGraphVertexCoverageHistogram.csv");
     verticesCsv << "Coverage,Frequency\n";
     for(uint64_t coverage = 0; coverage<vertexCoverageHistogram.size(); coverage++) {
@@ -4789,22 +5557,16 @@ void Assembler::computeMarkerGraphCoverageHistogram()
 
 
     // Edges.
-    vector<uint64_t> edgeCoverageHistogram;
-    for(MarkerGraphEdgeId edgeId=0; edgeId<markerGraph.edges.size(); edgeId++) {
-        const MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
-
-        // If this edge was removed, skip it.
-        if(edge.wasRemoved()) {
-            continue;
-        }
-
-        // Increment the histogram.
-        const size_t coverage = markerGraph.edgeCoverage(edgeId);
-        if(coverage >= edgeCoverageHistogram.size()) {
-            edgeCoverageHistogram.resize(coverage+1, 0);
-        }
-        ++edgeCoverageHistogram[coverage];
-    }
+    const vector<uint64_t> edgeCoverageHistogram = parallelHistogram(
+        markerGraph.edges.size(), 100000, threadCount,
+        [&](uint64_t edgeId)
+        {
+            // If this edge was removed, skip it.
+            if(markerGraph.edges[edgeId].wasRemoved()) {
+                return invalid<uint64_t>;
+            }
+            return uint64_t(markerGraph.edgeCoverage(edgeId));
+        });
     ofstream edgesCsv("MarkerGraphEdgeCoverageHistogram.csv");
     edgesCsv << "Coverage,Frequency\n";
     for(uint64_t coverage = 0; coverage<edgeCoverageHistogram.size(); coverage++) {
@@ -107,6 +107,14 @@ void Assembler::cleanupDuplicateMarkers(
     cleanupDuplicateMarkersData.pattern1Count = 0;
     cleanupDuplicateMarkersData.pattern2Count = 0;
     cleanupDuplicateMarkersData.nextVertexId = vertexCount;
+    cleanupDuplicateMarkersData.oldVertexCount = vertexCount;
+    cleanupDuplicateMarkersData.wasChanged.createNew(
+        largeDataName("tmp-CleanupDuplicateMarkers-WasChanged"), largeDataPageSize);
+    cleanupDuplicateMarkersData.wasChanged.resize(vertexCount);
+    fill(
+        cleanupDuplicateMarkersData.wasChanged.begin(),
+        cleanupDuplicateMarkersData.wasChanged.end(),
+        false);
 
     // Process each vertex in multithreaded code.
     // For each vertex, we possibly change the vertexTable for the markers in that vertex (only).
@@ -124,8 +132,13 @@ void Assembler::cleanupDuplicateMarkers(
     if(debug) {
         cout << "Maximum vertex id before renumbering of the vertex table " << cleanupDuplicateMarkersData.nextVertexId - 1 << endl;
     }
-    const MarkerGraph::VertexId maxVertexId =
-        markerGraph.renumberVertexTable(threadCount, cleanupDuplicateMarkersData.nextVertexId - 1);
+    // Keep the new VertexId corresponding to each old VertexId.
+    cleanupDuplicateMarkersData.newVertexId.createNew(
+        largeDataName("tmp-CleanupDuplicateMarkers-NewVertexId"), largeDataPageSize);
+    const MarkerGraph::VertexId maxVertexId = markerGraph.renumberVertexTable(
+        threadCount,
+        cleanupDuplicateMarkersData.nextVertexId - 1,
+        cleanupDuplicateMarkersData.newVertexId);
     if(debug) {
         cout << "Maximum vertex id after renumbering of the vertex table " << maxVertexId << endl;
     }
@@ -152,7 +165,29 @@ void Assembler::cleanupDuplicateMarkers(
 
 
     // Finally, recreate the reverse complement vertices.
-    findMarkerGraphReverseComplementVertices(threadCount);
+    // For vertices that were not changed, the reverse complement vertex
+    // is obtained by renumbering the old one.
+    // Only the remaining vertices need to be looked up.
+    auto& oldReverseComplementVertex = cleanupDuplicateMarkersData.oldReverseComplementVertex;
+    oldReverseComplementVertex.createNew(
+        largeDataName("tmp-CleanupDuplicateMarkers-OldReverseComplementVertex"), largeDataPageSize);
+    oldReverseComplementVertex.reserveAndResizeUninitialized(vertexCount);
+    copy(markerGraph.reverseComplementVertex.begin(), markerGraph.reverseComplementVertex.end(),
+        oldReverseComplementVertex.begin());
+    markerGraph.reverseComplementVertex.resize(markerGraph.vertices().size());
+    cleanupDuplicateMarkersData.threadVerticesToBeChecked.clear();
+    cleanupDuplicateMarkersData.threadVerticesToBeChecked.resize(threadCount);
+    setupLoadBalancing(cleanupDuplicateMarkersData.newVertexId.size(), 100000);
+    runThreads(&Assembler::cleanupDuplicateMarkersRenumberThreadFunction, threadCount);
+    oldReverseComplementVertex.remove();
+    cleanupDuplicateMarkersData.newVertexId.remove();
+    cleanupDuplicateMarkersData.wasChanged.remove();
+    vector<MarkerGraph::VertexId> verticesToBeChecked;
+    for(const auto& v: cleanupDuplicateMarkersData.threadVerticesToBeChecked) {
+        verticesToBeChecked.insert(verticesToBeChecked.end(), v.begin(), v.end());
+    }
+    cleanupDuplicateMarkersData.threadVerticesToBeChecked.clear();
+    findMarkerGraphReverseComplementVertices(threadCount, verticesToBeChecked);
 
 
     cout << timestamp << "Cleaning up duplicate markers completed." << endl;
@@ -205,6 +240,8 @@ void Assembler::cleanupDuplicateMarkersThreadFunction(size_t threadId)
 
             // This vertex has duplicate markers (more than one marker on the
             // same oriented read).
+            cleanupDuplicateMarkersData.wasChanged[vertexId] = true;
+            cleanupDuplicateMarkersData.wasChanged[vertexIdRc] = true;
             if(vertexId == vertexIdRc) {
                 ++badVertexCount;   // Unusual/exceptional case.
             } else {
@@ -299,6 +336,38 @@ void Assembler::cleanupDuplicateMarkersThreadFunction(size_t threadId)
 
 
 
+// After renumbering of the vertex table, set the reverse complement
+// of each vertex that did not change, and find the ones that need to be
+// looked up by findMarkerGraphReverseComplementVertices.
+void Assembler::cleanupDuplicateMarkersRenumberThreadFunction(size_t threadId)
+{
+    using VertexId = MarkerGraph::VertexId;
+    const auto& data = cleanupDuplicateMarkersData;
+    vector<VertexId>& verticesToBeChecked = cleanupDuplicateMarkersData.threadVerticesToBeChecked[threadId];
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over old vertex ids in this batch.
+        for(VertexId oldVertexId=begin; oldVertexId!=end; oldVertexId++) {
+            const VertexId newVertexId = data.newVertexId[oldVertexId];
+            if(newVertexId == MarkerGraph::invalidVertexId) {
+                continue;
+            }
+            if(oldVertexId < data.oldVertexCount and not data.wasChanged[oldVertexId]) {
+                const VertexId newVertexIdRc = data.newVertexId[data.oldReverseComplementVertex[oldVertexId]];
+                SHASTA_ASSERT(newVertexIdRc != MarkerGraph::invalidVertexId);
+                markerGraph.reverseComplementVertex[newVertexId] = newVertexIdRc;
+            } else {
+                verticesToBeChecked.push_back(newVertexId);
+            }
+        }
+    }
+}
+
+
+
 void Assembler::cleanupDuplicateMarkersPattern1(
     MarkerGraph::VertexId vertexId,
     uint64_t minCoverage,
@@ -404,8 +473,9 @@ void Assembler::cleanupDuplicateMarkersPattern2(
     // Create the marker connectivity graph for this vertex.
     MarkerConnectivityGraph graph;
     MarkerConnectivityGraphVertexMap vertexMap;
+    // This runs in a thread function, so use a single thread.
     createMarkerConnectivityGraph(
-        markerDescriptors.front().first, markerDescriptors.front().second, true, graph, vertexMap);
+        markerDescriptors.front().first, markerDescriptors.front().second, true, graph, vertexMap, 1);
     SHASTA_ASSERT(num_vertices(graph) == markerCount);
 
     if(debug) {
@@ -419,9 +489,8 @@ void Assembler::cleanupDuplicateMarkersPattern2(
     for(uint64_t i=0; i<markerCount; i++) {
         if(isDuplicateOrientedReadId[i]) {
             const MarkerDescriptor markerDescriptor = markerDescriptors[i];
-            const auto it = vertexMap.find(markerDescriptor);
-            SHASTA_ASSERT(it != vertexMap.end());
-            const vertex_descriptor v = it->second;
+            const vertex_descriptor v = vertexMap.find(markerDescriptor);
+            SHASTA_ASSERT(v != MarkerConnectivityGraph::null_vertex());
             duplicateMarkerVertices.insert(v);
         }
     }
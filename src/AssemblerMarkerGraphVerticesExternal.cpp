@@ -0,0 +1,277 @@
+// Shasta.
+#include "Assembler.hpp"
+#include "performanceLog.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <filesystem>
+#include "fstream.hpp"
+#include <functional>
+#include <queue>
+
+
+
+// Consumer of aligned marker pairs used in phase 1 of createMarkerGraphVerticesExternal.
+// Each thread accumulates pairs of aligned markers in a buffer.
+// When the buffer is full, it is sorted and written to a run file.
+namespace shasta {
+    class RunFileWriter : public Assembler::AlignedMarkerPairConsumer {
+    public:
+        using Pair = Assembler::AlignedMarkerPair;
+
+        RunFileWriter(uint64_t bufferCapacity, size_t threadCount) :
+            bufferCapacity(bufferCapacity),
+            threadData(threadCount) {}
+
+        void consume(size_t threadId, span<const Pair> alignedMarkerPairs)
+        {
+            ThreadData& data = threadData[threadId];
+            for(Pair p: alignedMarkerPairs) {
+
+                // Store each pair with the lower MarkerId first.
+                if(p.first > p.second) {
+                    std::swap(p.first, p.second);
+                }
+                data.buffer.push_back(p);
+                if(data.buffer.size() == bufferCapacity) {
+                    writeRun(threadId);
+                }
+            }
+        }
+
+        // Write the pairs still in memory and return the names of all run files.
+        void finish(vector<string>& runFileNames)
+        {
+            runFileNames.clear();
+            for(uint64_t threadId=0; threadId<threadData.size(); threadId++) {
+                writeRun(threadId);
+                const vector<string>& threadRunFileNames = threadData[threadId].runFileNames;
+                runFileNames.insert(runFileNames.end(), threadRunFileNames.begin(), threadRunFileNames.end());
+            }
+        }
+
+    private:
+        uint64_t bufferCapacity;
+        class ThreadData {
+        public:
+            vector<Pair> buffer;
+            vector<string> runFileNames;
+        };
+        vector<ThreadData> threadData;
+
+        // Sort the buffer of a thread, remove duplicates, and write it to a new run file.
+        void writeRun(size_t threadId)
+        {
+            ThreadData& data = threadData[threadId];
+            vector<Pair>& buffer = data.buffer;
+            if(buffer.empty()) {
+                return;
+            }
+            sort(buffer.begin(), buffer.end());
+            buffer.erase(unique(buffer.begin(), buffer.end()), buffer.end());
+            const string fileName = "tmp-MarkerPairs-" + to_string(threadId) + "-" +
+                to_string(data.runFileNames.size()) + ".bin";
+            ofstream file(fileName, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(Pair)));
+            if(not file) {
+                throw runtime_error("Error writing " + fileName);
+            }
+            data.runFileNames.push_back(fileName);
+            buffer.clear();
+        }
+    };
+}
+
+
+
+// External memory version of the disjoint set computation
+// used by createMarkerGraphVertices.
+// On return, data.disjointSetTable contains, for each oriented marker,
+// the id of the disjoint set it belongs to, which is the lowest MarkerId
+// in the disjoint set. The rest of createMarkerGraphVertices then proceeds
+// as when the disjoint sets are computed in memory.
+//
+// The in-memory version uses a lock-free DisjointSets data structure
+// with 16 bytes per oriented marker, and accesses it randomly
+// while the alignments are being decompressed.
+// This version instead works in two phases:
+//
+// - Multiple threads decompress the alignments and write the pairs of aligned
+//   markers to sorted run files in the assembly directory.
+//   Each thread keeps in memory at most its share of the memory budget.
+//
+// - A single thread merges the sorted run files and uses the resulting
+//   stream of pairs, sorted by the lower MarkerId of each pair,
+//   to do union-find operations. This uses an array with 8 bytes per oriented
+//   marker, allocated like the other large data structures, according to
+//   --memoryMode and --memoryBacking. Each merged set gets the lower
+//   of the two set ids, so the parent of a marker is never greater than the
+//   marker itself, and a single sequential pass at the end finds the
+//   set of each marker. No iterative convergence passes are necessary.
+//
+// Besides the array of parents, the memory used is bounded by memoryBudget,
+// in GB, which is used for the pair buffers in the first phase
+// and for the run file buffers in the second phase.
+void Assembler::createMarkerGraphVerticesExternal(
+    double memoryBudget,
+    size_t threadCount)
+{
+    auto& data = createMarkerGraphVerticesData;
+    using Pair = pair<MarkerId, MarkerId>;
+    const uint64_t memoryBudgetBytes = uint64_t(memoryBudget * 1024. * 1024. * 1024.);
+    const uint64_t minBufferCapacity = 4096;
+
+
+
+    // Phase 1: write the pairs of aligned markers to sorted run files.
+    performanceLog << timestamp << "Writing pairs of aligned markers to sorted run files." << endl;
+    vector<string> runFileNames;
+    {
+        RunFileWriter writer(
+            max(minBufferCapacity, memoryBudgetBytes / (threadCount * sizeof(Pair))),
+            threadCount);
+        streamAlignedMarkerPairs({&writer}, threadCount);
+        writer.finish(runFileNames);
+    }
+    cout << "Wrote pairs of aligned markers to " << runFileNames.size() << " sorted run files." << endl;
+
+
+
+    // Merge the sorted run files. The function passed in
+    // is called for each pair, in sorted order.
+    class RunReader {
+    public:
+        ifstream file;
+        vector<Pair> buffer;
+        uint64_t position = 0;
+        uint64_t size = 0;
+        bool fill()
+        {
+            file.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(Pair)));
+            size = uint64_t(file.gcount()) / sizeof(Pair);
+            position = 0;
+            return size > 0;
+        }
+    };
+    auto mergeRuns = [&](
+        const vector<string>& fileNames,
+        const std::function<void(const Pair&)>& f)
+    {
+        const uint64_t runBufferCapacity =
+            max(minBufferCapacity, memoryBudgetBytes / (max(fileNames.size(), size_t(1)) * sizeof(Pair)));
+        vector<RunReader> readers(fileNames.size());
+        using QueueEntry = pair<Pair, uint64_t>;
+        std::priority_queue<QueueEntry, vector<QueueEntry>, std::greater<QueueEntry> > q;
+        for(uint64_t i=0; i<fileNames.size(); i++) {
+            RunReader& reader = readers[i];
+            reader.file.open(fileNames[i], std::ios::binary);
+            if(not reader.file) {
+                throw runtime_error("Error opening " + fileNames[i]);
+            }
+            reader.buffer.resize(runBufferCapacity);
+            if(reader.fill()) {
+                q.push(make_pair(reader.buffer[0], i));
+            }
+        }
+        while(not q.empty()) {
+            const QueueEntry entry = q.top();
+            q.pop();
+            f(entry.first);
+            RunReader& reader = readers[entry.second];
+            ++reader.position;
+            if(reader.position < reader.size or reader.fill()) {
+                q.push(make_pair(reader.buffer[reader.position], entry.second));
+            }
+        }
+        for(const string& fileName: fileNames) {
+            std::filesystem::remove(fileName);
+        }
+    };
+
+
+
+    // If there are too many run files to merge at once,
+    // merge them in groups, writing the merged runs to new run files.
+    const uint64_t maxMergeRunCount = 256;
+    uint64_t mergePass = 0;
+    while(runFileNames.size() > maxMergeRunCount) {
+        performanceLog << timestamp << "Merging " << runFileNames.size() << " run files." << endl;
+        vector<string> newRunFileNames;
+        for(uint64_t begin=0; begin<runFileNames.size(); begin+=maxMergeRunCount) {
+            const uint64_t end = min(begin + maxMergeRunCount, uint64_t(runFileNames.size()));
+            const vector<string> group(runFileNames.begin() + begin, runFileNames.begin() + end);
+            const string fileName = "tmp-MarkerPairs-Merged-" + to_string(mergePass) + "-" +
+                to_string(newRunFileNames.size()) + ".bin";
+            ofstream file(fileName, std::ios::binary);
+            vector<Pair> buffer;
+            buffer.reserve(minBufferCapacity);
+            mergeRuns(group, [&](const Pair& p)
+            {
+                buffer.push_back(p);
+                if(buffer.size() == minBufferCapacity) {
+                    file.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(Pair)));
+                    buffer.clear();
+                }
+            });
+            file.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(Pair)));
+            if(not file) {
+                throw runtime_error("Error writing " + fileName);
+            }
+            newRunFileNames.push_back(fileName);
+        }
+        runFileNames.swap(newRunFileNames);
+        ++mergePass;
+    }
+
+
+
+    // Phase 2: union-find using the merged stream of pairs.
+    performanceLog << timestamp << "Union-find using the sorted pairs of aligned markers." << endl;
+    auto& parent = data.disjointSetTable;
+    parent.createNew(
+        largeDataName("tmp-DisjointSetTable"),
+        largeDataPageSize);
+    parent.reserveAndResize(data.orientedMarkerCount);
+    for(MarkerId markerId=0; markerId<data.orientedMarkerCount; markerId++) {
+        parent[markerId] = markerId;
+    }
+
+    // Find with path halving.
+    // This preserves the property that parent[x] <= x.
+    auto find = [&parent](MarkerId x)
+    {
+        while(parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+
+    uint64_t pairCount = 0;
+    uint64_t unionCount = 0;
+    mergeRuns(runFileNames, [&](const Pair& p)
+    {
+        ++pairCount;
+        const MarkerId root0 = find(p.first);
+        const MarkerId root1 = find(p.second);
+        if(root0 != root1) {
+            ++unionCount;
+            if(root0 < root1) {
+                parent[root1] = root0;
+            } else {
+                parent[root0] = root1;
+            }
+        }
+    });
+    cout << "Processed " << pairCount << " pairs of aligned markers, of which " <<
+        unionCount << " merged two disjoint sets." << endl;
+
+    // Because parent[x] <= x, processing the markers in increasing order
+    // guarantees that parent[parent[x]] is already the set representative.
+    for(MarkerId markerId=0; markerId<data.orientedMarkerCount; markerId++) {
+        parent[markerId] = parent[parent[markerId]];
+    }
+    performanceLog << timestamp << "Union-find using the sorted pairs of aligned markers completed." << endl;
+}
@@ -3,6 +3,7 @@
 #include "extractKmer.hpp"
 #include "findMarkerId.hpp"
 #include "MarkerFinder.hpp"
+#include "parallelFor.hpp"
 #include "performanceLog.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
@@ -17,6 +18,23 @@ void Assembler::findMarkers(size_t threadCount)
     SHASTA_ASSERT(kmerChecker);
 
     markers.createNew(largeDataName("Markers"), largeDataPageSize);
+
+    // If the marker positions were computed while loading the reads,
+    // use them. They are only valid if the reads did not change since then.
+    if(pipelinedMarkerPositions.isOpen()) {
+        if(pipelinedMarkerPositions.size() == reads->readCount()) {
+            MarkerFinder markerFinder(
+                assemblerInfo->k,
+                pipelinedMarkerPositions,
+                getReads(),
+                markers,
+                threadCount);
+            pipelinedMarkerPositions.remove();
+            return;
+        }
+        pipelinedMarkerPositions.remove();
+    }
+
     MarkerFinder markerFinder(
         assemblerInfo->k,
         *kmerChecker,
@@ -164,9 +182,11 @@ void Assembler::computeMarkerKmerIds(uint64_t threadCount)
         }
     }
     markerKmerIds.unreserve();
+    markers.advise(MemoryMapped::AccessPattern::sequential);
     const uint64_t batchSize = 100;
     setupLoadBalancing(readCount, batchSize);
     runThreads(&Assembler::computeMarkerKmerIdsThreadFunction, threadCount);
+    markers.advise(MemoryMapped::AccessPattern::normal);
 
 
 
@@ -210,13 +230,65 @@ void Assembler::computeMarkerKmerIds(uint64_t threadCount)
 
 void Assembler::cleanupMarkerKmerIds()
 {
-    markerKmerIds.remove();
+    if(markerKmerIds.isOpen()) {
+        markerKmerIds.remove();
+    }
+}
+
+
+
+void Assembler::computeMarkerPositions(uint64_t threadCount)
+{
+    performanceLog << timestamp << "Gathering marker positions." << endl;
+
+    // Check that we have what we need.
+    checkMarkersAreOpen();
+    const uint64_t orientedReadCount = markers.size();
+
+    // The layout is identical to that used by the markers,
+    // so we can copy the table of contents and then
+    // fill in the positions in parallel.
+    markerPositions.createNew(largeDataName("MarkerPositions"), largeDataPageSize);
+    markerPositions.beginPass1(orientedReadCount);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        markerPositions.incrementCount(i, markers.size(i));
+    }
+    markerPositions.beginPass2();
+    markers.advise(MemoryMapped::AccessPattern::sequential);
+    const uint64_t batchSize = 1000;
+    parallelFor(orientedReadCount, batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; ++i) {
+                const auto orientedReadMarkers = markers[i];
+                uint32_t* p = markerPositions.begin(i);
+                for(const CompressedMarker& marker: orientedReadMarkers) {
+                    *p++ = marker.position;
+                }
+            }
+        });
+    markerPositions.endPass2(false);
+    markers.advise(MemoryMapped::AccessPattern::normal);
+}
+
+
+
+void Assembler::cleanupMarkerPositions()
+{
+    if(markerPositions.isOpen()) {
+        markerPositions.remove();
+    }
 }
 
 
 
 void Assembler::computeMarkerKmerIdsThreadFunction(size_t threadId)
 {
+    const uint64_t k = assemblerInfo->k;
+
+    // Vectors to hold the KmerIds of all k-mers of a read (both strands).
+    vector<KmerId> kmerIds;
+    vector<KmerId> kmerIdsRc;
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
@@ -228,10 +300,21 @@ void Assembler::computeMarkerKmerIdsThreadFunction(size_t threadId)
             const OrientedReadId orientedReadId0(uint32_t(readId), 0);
             const OrientedReadId orientedReadId1(uint32_t(readId), 1);
 
-            getReadMarkerKmerIds(
-                ReadId(readId),
-                markerKmerIds[orientedReadId0.getValue()],
-                markerKmerIds[orientedReadId1.getValue()]);
+            // Compute the KmerIds of all k-mers of this read
+            // with a rolling window, then pick the ones at marker positions.
+            const auto orientedReadMarkers0 = markers[orientedReadId0.getValue()];
+            const uint64_t readMarkerCount = orientedReadMarkers0.size();
+            if(readMarkerCount == 0) {
+                continue;
+            }
+            MarkerFinder::computeKmerIds(reads->getRead(ReadId(readId)), k, kmerIds, kmerIdsRc);
+            const span<KmerId> kmerIds0 = markerKmerIds[orientedReadId0.getValue()];
+            const span<KmerId> kmerIds1 = markerKmerIds[orientedReadId1.getValue()];
+            for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
+                const uint64_t position = orientedReadMarkers0[ordinal0].position;
+                kmerIds0[ordinal0] = kmerIds[position];
+                kmerIds1[readMarkerCount - 1 - ordinal0] = kmerIdsRc[position];
+            }
         }
     }
 
@@ -448,6 +531,16 @@ void Assembler::getOrientedReadMarkersStrand0(
     const uint64_t readMarkerCount = orientedReadMarkers0.size();
     SHASTA_ASSERT(markers0.size() == readMarkerCount);
 
+    // If the columnar marker data are available, use them.
+    if(markerKmerIds.isOpen() and markerPositions.isOpen()) {
+        const KmerId* kmerIds0 = markerKmerIds.begin(orientedReadId0.getValue());
+        const uint32_t* positions0 = markerPositions.begin(orientedReadId0.getValue());
+        for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
+            markers0[ordinal0] = MarkerWithOrdinal(kmerIds0[ordinal0], positions0[ordinal0], uint32_t(ordinal0));
+        }
+        return;
+    }
+
     // Loop over all markers.
     for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
         const CompressedMarker& compressedMarker0 = orientedReadMarkers0[ordinal0];
@@ -475,6 +568,16 @@ void Assembler::getOrientedReadMarkersStrand1(
     const uint64_t readMarkerCount = orientedReadMarkers0.size();
     SHASTA_ASSERT(markers1.size() == readMarkerCount);
 
+    // If the columnar marker data are available, use them.
+    if(markerKmerIds.isOpen() and markerPositions.isOpen()) {
+        const KmerId* kmerIds1 = markerKmerIds.begin(orientedReadId1.getValue());
+        const uint32_t* positions1 = markerPositions.begin(orientedReadId1.getValue());
+        for(uint64_t ordinal1=0; ordinal1<readMarkerCount; ordinal1++) {
+            markers1[ordinal1] = MarkerWithOrdinal(kmerIds1[ordinal1], positions1[ordinal1], uint32_t(ordinal1));
+        }
+        return;
+    }
+
     // Loop over all markers.
     for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
         const uint64_t ordinal1 = readMarkerCount - 1 - ordinal0;
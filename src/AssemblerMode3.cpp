@@ -36,7 +36,7 @@ void Assembler::mode3Assembly(
     assemblyGraph3.writeGfa("AssemblyGraph");
     // assemblyGraph3.clusterSegments(threadCount, minClusterSize);
     assemblyGraph3.createJaccardGraph(threadCount);
-    // assemblyGraph3.assembleJaccardGraphPaths();
+    // assemblyGraph3.assembleJaccardGraphPaths(threadCount);
     assemblyGraph3.createDeBruijnGraph();
 
 }
@@ -68,7 +68,7 @@ void Assembler::createMode3PathGraph()
     SHASTA_ASSERT(assemblyGraph3Pointer);
     const mode3::AssemblyGraph& assemblyGraph = *assemblyGraph3Pointer;
 
-    mode3::PathGraph pathGraph(assemblyGraph);
+    mode3::PathGraph pathGraph(assemblyGraph, 0);
 
 }
 
@@ -113,12 +113,14 @@ void Assembler::accessMode3aAssemblyData()
     mode3aAssemblyData.assemblyGraphSnapshots.clear();
     for(uint64_t i=0; ; i++) {
         try {
+            // Delta snapshots use the previous snapshot as their parent.
             const string name = "Mode3a-AssemblyGraphSnapshot-" + to_string(i);
             const auto snapshot =
                 make_shared<mode3a::AssemblyGraphSnapshot>(
                     name,
                     MappedMemoryOwner(*this),
-                    *mode3aAssemblyData.packedMarkerGraph);
+                    *mode3aAssemblyData.packedMarkerGraph,
+                    i == 0 ? 0 : mode3aAssemblyData.assemblyGraphSnapshots.back().get());
             mode3aAssemblyData.assemblyGraphSnapshots.push_back(snapshot);
         } catch (exception&) {
             break;
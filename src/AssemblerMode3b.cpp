@@ -59,6 +59,21 @@ void Assembler::findCompleteMarkerGraphPaths(uint64_t threadCount) const
 
 
 
+// Parallel path finding in the complete marker graph,
+// using as seeds all edges suitable to become primary edges.
+void Assembler::findCompleteMarkerGraphPrimaryPaths(uint64_t threadCount) const
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    mode3b::PathFinder pathFinder(*this);
+    pathFinder.findPrimaryPaths(threadCount);
+}
+
+
+
 void Assembler::findMode3bPaths(
     uint64_t threadCount0,  // High level parallelization
     uint64_t threadCount1   // Low level parallelization
@@ -158,7 +158,7 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         value<string>(&commandLineOnlyOptions.command)->
         default_value("assemble"),
         "Command to run. Must be one of: "
-        "assemble, saveBinaryData, cleanupBinaryData, explore, createBashCompletionScript")
+        "assemble, assembleBatch, createReadStore, saveBinaryData, cleanupBinaryData, explore, createBashCompletionScript, estimateResources, comparePerformance, rebuildReadGraph")
 
         ("memoryMode",
         value<string>(&commandLineOnlyOptions.memoryMode)->
@@ -170,22 +170,52 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         value<string>(&commandLineOnlyOptions.memoryBacking)->
         default_value("4K"),
         "Specify the type of pages used to back memory.\n"
-        "Allowed values: disk, 4K , 2M (for best performance). "
+        "Allowed values: disk, 4K, THP, 2M (for best performance). "
         "All combinations (memoryMode, memoryBacking) are allowed "
-        "except for (anonymous, disk).\n"
+        "except for (anonymous, disk) and (filesystem, THP). "
+        "THP uses transparent huge pages and does not require root privilege.\n"
         "Some combinations require root privilege, which is obtained using sudo "
         "and may result in a password prompting depending on your sudo set up.")
 
+        ("memoryTiering",
+        value<string>(&commandLineOnlyOptions.memoryTiering),
+        "Tiered placement of binary data. Requires --memoryMode filesystem "
+        "with --memoryBacking 4K or 2M. If set to \"default\", a built-in list "
+        "of infrequently accessed binary data structures are placed on disk "
+        "in the ColdData directory, and all others remain in memory in the Data directory. "
+        "Otherwise, this is the name of a policy file listing the cold binary data structures, "
+        "one per line.")
+
         ("threads",
         value<uint32_t>(&commandLineOnlyOptions.threadCount)->
         default_value(0),
         "Number of threads, or 0 to use one thread per virtual processor.")
+
+        ("threadAffinity",
+        value<string>(&commandLineOnlyOptions.threadAffinity)->
+        default_value("none"),
+        "Specify how threads are pinned to processors. "
+        "Allowed values: none, compact (fill one NUMA node before the next), "
+        "scatter (distribute threads across NUMA nodes).")
+
+        ("numa",
+        value<string>(&commandLineOnlyOptions.numa)->
+        default_value("default"),
+        "Specify the placement of memory on NUMA nodes. "
+        "Allowed values: default (first touch), interleave.")
         
         ("suppressStdoutLog",
         bool_switch(&commandLineOnlyOptions.suppressStdoutLog)->
         default_value(false),
         "Suppress echoing stdout to stdout.log.")
 
+        ("keepDeadData",
+        bool_switch(&commandLineOnlyOptions.keepDeadData)->
+        default_value(false),
+        "Keep all binary data until the end of the assembly, "
+        "instead of releasing each one after the last assembly stage that uses it. "
+        "Useful for debugging.")
+
         ("exploreAccess",
         value<string>(&commandLineOnlyOptions.exploreAccess)->
         default_value("user"),
@@ -200,12 +230,188 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         default_value(17100),
         "Port to be used by the http server (command --explore).")
 
+        ("exploreThreadCount",
+        value<uint64_t>(&commandLineOnlyOptions.exploreThreadCount)->
+        default_value(4),
+        "Number of threads used by the http server to process "
+        "requests concurrently (command --explore). "
+        "If 0, the number of virtual processors is used.")
+
+        ("exploreTimeout",
+        value<uint64_t>(&commandLineOnlyOptions.exploreTimeout)->
+        default_value(86400),
+        "Maximum time in seconds to process a request "
+        "(command --explore). When this is exceeded the connection is closed.")
+
+        ("exploreCacheSize",
+        value<uint64_t>(&commandLineOnlyOptions.exploreCacheSize)->
+        default_value(256),
+        "Size in MB of the in-memory cache of pages that display "
+        "local graphs (command --explore). 0 disables the in-memory cache.")
+
+        ("exploreCacheDirectory",
+        value<string>(&commandLineOnlyOptions.exploreCacheDirectory)->
+        default_value(""),
+        "If not empty, pages that display local graphs are also cached "
+        "in this directory (command --explore).")
+
+        ("exploreBuiltinLayoutThreshold",
+        value<uint64_t>(&commandLineOnlyOptions.exploreBuiltinLayoutThreshold)->
+        default_value(1000),
+        "Force directed layouts of graphs with at least this number of vertices "
+        "use the built-in layout instead of Graphviz or the custom layout program "
+        "(command --explore). 0 means never.")
+
+        ("exploreNeighborhoodIndex",
+        bool_switch(&commandLineOnlyOptions.exploreNeighborhoodIndex)->
+        default_value(false),
+        "Create at startup an index of the marker graph that speeds up "
+        "the display of large local marker graphs (command --explore).")
+
+        ("exploreAccessAll",
+        bool_switch(&commandLineOnlyOptions.exploreAccessAll)->
+        default_value(false),
+        "Access all binary data when the http server starts (command --explore), "
+        "instead of accessing the data needed by each request when it is processed.")
+
         ("alignmentsPafFile",
         value<string>(&commandLineOnlyOptions.alignmentsPafFile),
         "The name of a PAF file containing alignments of reads to "
         "a reference. Only used for --command explore, for display of the alignment "
         "candidate graph. Experimental."
         )
+
+        ("readStore",
+        value<string>(&commandLineOnlyOptions.readStore),
+        "Directory of a read store. For --command createReadStore, "
+        "the read store to be created. For --command assemble, "
+        "a read store to be used instead of --input."
+        )
+
+        ("resumeFrom",
+        value<string>(&commandLineOnlyOptions.resumeFrom),
+        "Resume an interrupted assembly in an existing assembly directory. "
+        "Requires --memoryMode filesystem. "
+        "Allowed values: auto (resume from the first stage that did not complete, "
+        "or that completed with different options), "
+        "or one of the stages: markers, alignmentCandidates, alignments, readGraph, assembly."
+        )
+
+        ("threadStatistics",
+        bool_switch(&commandLineOnlyOptions.threadStatistics)->
+        default_value(false),
+        "Record per-thread timing and load balance statistics for each parallel computation, "
+        "and write them to performance.log and AssemblySummary.json."
+        )
+
+        ("slowItemCount",
+        value<uint64_t>(&commandLineOnlyOptions.slowItemCount)->
+        default_value(0),
+        "If not zero, record the elapsed time of the given number of slowest work items "
+        "of alignment computation, marker graph edge assembly, and assembly path steps, "
+        "and write them to performance.log and AssemblySummary.json."
+        )
+
+        ("hardwareCounters",
+        bool_switch(&commandLineOnlyOptions.hardwareCounters)->
+        default_value(false),
+        "Use hardware performance counters to measure cycles, instructions, "
+        "last level cache misses, data TLB misses, and branch misses "
+        "for each assembly stage, and write them to performance.log and performance.jsonl."
+        )
+
+        ("alignmentWorkerPort",
+        value<uint16_t>(&commandLineOnlyOptions.alignmentWorkerPort)->
+        default_value(0),
+        "If not zero, the port on which --command assemble accepts connections "
+        "from alignment worker processes (--command alignmentWorker) "
+        "that compute alignments on other machines. "
+        "Requires --memoryMode filesystem --memoryBacking disk, "
+        "with the assembly directory on a filesystem shared with the workers."
+        )
+
+        ("alignmentCoordinator",
+        value<string>(&commandLineOnlyOptions.alignmentCoordinator),
+        "For --command alignmentWorker, the host and port, specified as host:port, "
+        "of the assembly that uses --alignmentWorkerPort."
+        )
+
+        ("metricsPort",
+        value<uint16_t>(&commandLineOnlyOptions.metricsPort)->
+        default_value(0),
+        "If not zero, the port for an http server that makes progress "
+        "and resource usage metrics available in Prometheus text format during --command assemble."
+        )
+
+        ("memoryCheck",
+        bool_switch(&commandLineOnlyOptions.memoryCheck)->
+        default_value(false),
+        "Before assembling, estimate the peak memory needed from a sample of the input files, "
+        "as done by --command estimateResources, and stop "
+        "if it exceeds the memory available for the --memoryMode and --memoryBacking used."
+        )
+
+        ("estimateSampleSize",
+        value<uint64_t>(&commandLineOnlyOptions.estimateSampleSize)->
+        default_value(100),
+        "The number of bytes, in MB, to read from each input file "
+        "for --command estimateResources and --memoryCheck. "
+        "The read statistics are extrapolated to the entire file. "
+        "If 0, the input files are read entirely."
+        )
+
+        ("batchManifest",
+        value<string>(&commandLineOnlyOptions.batchManifest),
+        "For --command assembleBatch, the name of a file listing the samples "
+        "to be assembled, one per line. Each line contains a sample name "
+        "followed by the names of the input files for that sample, "
+        "separated by white space. Lines beginning with # are ignored."
+        )
+
+        ("batchConcurrency",
+        value<uint64_t>(&commandLineOnlyOptions.batchConcurrency)->
+        default_value(0),
+        "For --command assembleBatch, the maximum number of assemblies "
+        "that run at the same time. The threads specified by --threads "
+        "are divided among them. If 0, one assembly is run "
+        "for every 8 threads."
+        )
+
+        ("performanceBaseline",
+        value<string>(&commandLineOnlyOptions.performanceBaseline),
+        "For --command comparePerformance, the assembly directory of the baseline run, "
+        "or the name of its performance.jsonl file."
+        )
+
+        ("performanceTimeTolerance",
+        value<double>(&commandLineOnlyOptions.performanceTimeTolerance)->
+        default_value(0.2),
+        "For --command comparePerformance, the maximum increase of the wall time "
+        "or CPU time of a stage, as a fraction of the baseline time, "
+        "before it is flagged as a regression."
+        )
+
+        ("performanceMemoryTolerance",
+        value<double>(&commandLineOnlyOptions.performanceMemoryTolerance)->
+        default_value(0.1),
+        "For --command comparePerformance, the maximum increase of the peak resident memory "
+        "of a stage, as a fraction of the baseline, before it is flagged as a regression."
+        )
+
+        ("performanceFaultTolerance",
+        value<double>(&commandLineOnlyOptions.performanceFaultTolerance)->
+        default_value(1.),
+        "For --command comparePerformance, the maximum increase of the major page faults "
+        "of a stage, as a fraction of the baseline, before it is flagged as a regression. "
+        "Increases of less than 1000 page faults are never flagged."
+        )
+
+        ("performanceMinSeconds",
+        value<double>(&commandLineOnlyOptions.performanceMinSeconds)->
+        default_value(1.),
+        "For --command comparePerformance, time increases of less than this number of seconds "
+        "are never flagged as regressions."
+        )
         ;
 
 }
@@ -245,6 +451,33 @@ void AssemblerOptions::addConfigurableOptions()
         "Power of 10 multipliers can be used, for example 120Gb to "
         "request 120 Gb of coverage.")
 
+        ("Reads.lengthScan",
+        bool_switch(&readsOptions.lengthScan)->
+        default_value(false),
+        "Only used if --Reads.desiredCoverage is not zero. "
+        "If set, the read length cutoff is computed by a fast length scan "
+        "of the input files before loading reads, and reads shorter than "
+        "the cutoff are never decoded or stored. "
+        "This reads the input files twice but reduces time and memory "
+        "spent on reads that would be discarded.")
+
+        ("Reads.compressRepeatCounts",
+        bool_switch(&readsOptions.compressRepeatCounts)->
+        default_value(false),
+        "Only used if --Reads.representation is 1. "
+        "If set, repeat counts are stored in a compressed form "
+        "using 2 bits per base plus an exception table for "
+        "repeat counts greater than 4. This reduces memory "
+        "at a small cost in access time.")
+
+        ("Reads.compressNames",
+        bool_switch(&readsOptions.compressNames)->
+        default_value(false),
+        "If set, read names and meta data are stored using front coding, "
+        "and the ch and start_time meta data fields are stored "
+        "in parsed form. This reduces memory "
+        "at a small cost in access time.")
+
         ("Reads.noCache",
         bool_switch(&readsOptions.noCache)->
         default_value(false),
@@ -252,6 +485,14 @@ void AssemblerOptions::addConfigurableOptions()
         "This is done by specifying the O_DIRECT flag when opening "
         "input files containing reads.")
 
+        ("Reads.streamingChunkSize",
+        value<uint64_t>(&readsOptions.streamingChunkSize)->
+        default_value(0),
+        "If not zero, read input files in chunks of this size (in MB), "
+        "parsing each chunk while the next one is being read. "
+        "This limits the memory needed to load reads. "
+        "If zero, each input file is read entirely before parsing.")
+
         ("Reads.handleDuplicates",
         value<string>(&readsOptions.handleDuplicates)->
         default_value("useOneCopy"),
@@ -330,6 +571,22 @@ void AssemblerOptions::addConfigurableOptions()
         "A relative path is not accepted. "
         "Only used if Kmers.generationMethod is 3.")
 
+        ("Kmers.recomputeMarkerKmerIds",
+        bool_switch(&kmersOptions.recomputeMarkerKmerIds)->
+        default_value(false),
+        "If set, marker KmerIds are not stored during LowHash "
+        "and alignment computation, and are instead recomputed "
+        "from the reads when needed. This reduces peak memory "
+        "usage at the cost of additional computation.")
+
+        ("Kmers.findMarkersWhileLoadingReads",
+        bool_switch(&kmersOptions.findMarkersWhileLoadingReads)->
+        default_value(false),
+        "If set, and the choice of marker k-mers does not depend on the reads "
+        "(Kmers.generationMethod 0 or 3), markers are found "
+        "while the reads are loaded, overlapping marker finding "
+        "with reading and parsing the input files.")
+
         ("MinHash.version",
         value<int>(&minHashOptions.version)->
         default_value(0),
@@ -473,6 +730,30 @@ void AssemblerOptions::addConfigurableOptions()
         "one read is entirely contained in another read, "
         "except possibly for up to maxTrim markers at the beginning and end.")
 
+        ("Align.readSaturationAlignmentCount",
+        value<uint64_t>(&alignOptions.readSaturationAlignmentCount)->
+        default_value(0),
+        "If not zero, alignment candidates are processed in order of decreasing "
+        "LowHash frequency, and a candidate is skipped if both of its reads "
+        "already have at least this number of good alignments. "
+        "Zero (the default) computes alignments for all candidates.")
+
+        ("Align.streamAlignmentCandidates",
+        bool_switch(&alignOptions.streamAlignmentCandidates)->
+        default_value(false),
+        "Start computing alignments during the last LowHash iteration, "
+        "as soon as the final alignment candidates for each batch of reads are found. "
+        "Only used with --MinHash.version 0 and a non-zero --MinHash.minHashIterationCount. "
+        "Ignored if --MinHash.allPairs, --Align.readSaturationAlignmentCount, or "
+        "--Align.sameChannelReadAlignment.suppressDeltaThreshold are used.")
+
+        ("Align.cacheFile",
+        value<string>(&alignOptions.cacheFile),
+        "The absolute path of a file used to cache alignment results across runs. "
+        "A relative path is not accepted. "
+        "If the file exists, alignments found in it are reused. "
+        "Alignments not found in it are computed and added to it.")
+
         ("Align.align4.deltaX",
         value<uint64_t>(&alignOptions.align4DeltaX)->
         default_value(200),
@@ -493,6 +774,21 @@ void AssemblerOptions::addConfigurableOptions()
         default_value(100),
         "Only used for alignment method 4 (experimental).")
 
+        ("Align.align4.nativeBandedAlignment",
+        bool_switch(&alignOptions.align4NativeBandedAlignment)->
+        default_value(false),
+        "Only used for alignment method 4 (experimental). "
+        "Compute banded alignments with the native Shasta implementation "
+        "instead of SeqAn.")
+
+        ("Align.align4.maxKmerFrequency",
+        value<uint64_t>(&alignOptions.align4MaxKmerFrequency)->
+        default_value(0),
+        "Only used for alignment method 4 (experimental). "
+        "Marker k-mers that appear more than this number of times "
+        "in all oriented reads are not used to create alignment matrices. "
+        "If 0, all marker k-mers are used.")
+
         ("ReadGraph.creationMethod",
         value<int>(&readGraphOptions.creationMethod)->
         default_value(0),
@@ -579,6 +875,13 @@ void AssemblerOptions::addConfigurableOptions()
         "Least square max distance for flagging inconsistent alignments. "
         "Only used if --ReadGraph.flagInconsistentAlignments is set. Experimental.")
 
+        ("ReadGraph.renumberReads",
+        bool_switch(&readGraphOptions.renumberReads)->
+        default_value(false),
+        "Renumber the reads in the order of a BFS of the read graph "
+        "after the read graph is created, to improve memory locality "
+        "in later assembly stages. Experimental.")
+
         ("MarkerGraph.minCoverage",
         value<int>(&markerGraphOptions.minCoverage)->
         default_value(10),
@@ -632,6 +935,13 @@ void AssemblerOptions::addConfigurableOptions()
         "Used when cleaning up marker graph vertices with more than one marker on the "
         "same oriented read. Experimental.")
 
+        ("MarkerGraph.renumberVertices",
+        bool_switch(&markerGraphOptions.renumberVertices)->
+        default_value(false),
+        "Renumber marker graph vertices in the order in which they are first encountered "
+        "along the marker paths of the oriented reads, before the marker graph "
+        "edges are created. This improves memory locality. Experimental.")
+
         ("MarkerGraph.lowCoverageThreshold",
         value<int>(&markerGraphOptions.lowCoverageThreshold)->
         default_value(0),
@@ -684,6 +994,22 @@ void AssemblerOptions::addConfigurableOptions()
         "Used in the automatic selection of --MarkerGraph.minCoverage when "
         "--MarkerGraph.minCoverage is set to 0.")
 
+        ("MarkerGraph.shardCount",
+        value<uint64_t>(&markerGraphOptions.shardCount)->
+        default_value(1),
+        "Number of shards used to compute marker graph vertices. "
+        "With more than one shard, threads are bound to NUMA nodes, "
+        "and each shard is processed by threads on one NUMA node. "
+        "If 0, the number of NUMA nodes is used.")
+
+        ("MarkerGraph.externalMemoryBudget",
+        value<double>(&markerGraphOptions.externalMemoryBudget)->
+        default_value(0.),
+        "If not zero, compute marker graph vertices using external memory, "
+        "with this memory budget in GB for buffers. "
+        "Pairs of aligned markers are written to temporary files "
+        "in the assembly directory.")
+
         ("MarkerGraph.secondaryEdges.maxSkip",
         value<uint64_t>(&markerGraphOptions.secondaryEdgesMaxSkip)->
         default_value(1000000),
@@ -738,6 +1064,12 @@ void AssemblerOptions::addConfigurableOptions()
         default_value(false),
         "Used to request writing the reads that contributed to assembling each segment.")
 
+        ("Assembly.bgzfOutput",
+        bool_switch(&assemblyOptions.bgzfOutput)->
+        default_value(false),
+        "Write the assembly GFA and FASTA files compressed in BGZF format, "
+        "with .gzi indexes, and .fai indexes for FASTA (Mode 0 assembly only).")
+
         ("Assembly.pruneLength",
         value<uint64_t>(&assemblyOptions.pruneLength)->
         default_value(0),
@@ -924,6 +1256,12 @@ void AssemblerOptions::addConfigurableOptions()
         default_value(false),
         "Suppress output of haploid representation of the assembly (Mode 2 assembly only).")
 
+        ("Assembly.mode2.bgzfOutput",
+        bool_switch(&assemblyOptions.mode2Options.bgzfOutput)->
+        default_value(false),
+        "Write GFA and FASTA files compressed in BGZF format, "
+        "with .gzi indexes, and .fai indexes for FASTA (Mode 2 assembly only).")
+
         ;
 }
 
@@ -948,8 +1286,15 @@ void ReadsOptions::write(ostream& s) const
     s << "representation = " << representation << "\n";
     s << "minReadLength = " << minReadLength << "\n";
     s << "desiredCoverage = " << desiredCoverageString << "\n";
+    s << "lengthScan = " <<
+        convertBoolToPythonString(lengthScan) << "\n";
+    s << "compressRepeatCounts = " <<
+        convertBoolToPythonString(compressRepeatCounts) << "\n";
+    s << "compressNames = " <<
+        convertBoolToPythonString(compressNames) << "\n";
     s << "noCache = " <<
         convertBoolToPythonString(noCache) << "\n";
+    s << "streamingChunkSize = " << streamingChunkSize << "\n";
     s << "handleDuplicates = " << handleDuplicates << "\n";
     palindromicReads.write(s);
 }
@@ -965,6 +1310,10 @@ void KmersOptions::write(ostream& s) const
     s << "enrichmentThreshold = " << enrichmentThreshold << "\n";
     s << "distanceThreshold = " << distanceThreshold << "\n";
     s << "file = " << file << "\n";
+    s << "recomputeMarkerKmerIds = " <<
+        convertBoolToPythonString(recomputeMarkerKmerIds) << "\n";
+    s << "findMarkersWhileLoadingReads = " <<
+        convertBoolToPythonString(findMarkersWhileLoadingReads) << "\n";
 }
 
 
@@ -1006,10 +1355,17 @@ void AlignOptions::write(ostream& s) const
         sameChannelReadAlignmentSuppressDeltaThreshold << "\n";
     s << "suppressContainments = " <<
         convertBoolToPythonString(suppressContainments) << "\n";
+    s << "readSaturationAlignmentCount = " << readSaturationAlignmentCount << "\n";
+    s << "streamAlignmentCandidates = " <<
+        convertBoolToPythonString(streamAlignmentCandidates) << "\n";
+    s << "cacheFile = " << cacheFile << "\n";
     s << "align4.deltaX = " << align4DeltaX << "\n";
     s << "align4.deltaY = " << align4DeltaY << "\n";
     s << "align4.minEntryCountPerCell = " << align4MinEntryCountPerCell << "\n";
     s << "align4.maxDistanceFromBoundary = " << align4MaxDistanceFromBoundary << "\n";
+    s << "align4.nativeBandedAlignment = " <<
+        convertBoolToPythonString(align4NativeBandedAlignment) << "\n";
+    s << "align4.maxKmerFrequency = " << align4MaxKmerFrequency << "\n";
 }
 
 
@@ -1037,6 +1393,7 @@ void ReadGraphOptions::write(ostream& s) const
         flagInconsistentAlignmentsLeastSquareErrorThreshold << "\n";
     s << "flagInconsistentAlignments.leastSquareMaxDistance = " <<
         flagInconsistentAlignmentsLeastSquareMaxDistance << "\n";
+    s << "renumberReads = " << convertBoolToPythonString(renumberReads) << "\n";
 }
 
 
@@ -1054,6 +1411,8 @@ void MarkerGraphOptions::write(ostream& s) const
     s << "cleanupDuplicateMarkers = " <<
         convertBoolToPythonString(cleanupDuplicateMarkers) << "\n";
     s << "duplicateMarkersPattern1Threshold = " << duplicateMarkersPattern1Threshold << "\n";
+    s << "renumberVertices = " <<
+        convertBoolToPythonString(renumberVertices) << "\n";
     s << "lowCoverageThreshold = " << lowCoverageThreshold << "\n";
     s << "highCoverageThreshold = " << highCoverageThreshold << "\n";
     s << "maxDistance = " << maxDistance << "\n";
@@ -1063,6 +1422,8 @@ void MarkerGraphOptions::write(ostream& s) const
     s << "crossEdgeCoverageThreshold = " << crossEdgeCoverageThreshold << "\n";
     s << "peakFinder.minAreaFraction = " << peakFinderMinAreaFraction << "\n";
     s << "peakFinder.areaStartIndex = " << peakFinderAreaStartIndex << "\n";
+    s << "shardCount = " << shardCount << "\n";
+    s << "externalMemoryBudget = " << externalMemoryBudget << "\n";
 
     s << "secondaryEdges.maxSkip = " << secondaryEdgesMaxSkip << "\n";
     s << "secondaryEdges.split.errorRateThreshold = " << secondaryEdgesSplitErrorRateThreshold << "\n";
@@ -1086,6 +1447,8 @@ void AssemblyOptions::write(ostream& s) const
         storeCoverageDataCsvLengthThreshold << "\n";
     s << "writeReadsByAssembledSegment = " <<
         convertBoolToPythonString(writeReadsByAssembledSegment) << "\n";
+    s << "bgzfOutput = " <<
+        convertBoolToPythonString(bgzfOutput) << "\n";
     s << "pruneLength = " << pruneLength << "\n";
     s << "detangleMethod = " << detangleMethod << "\n";
     s << "detangle.diagonalReadCountMin = " << detangleDiagonalReadCountMin << "\n";
@@ -1129,6 +1492,7 @@ void Mode2AssemblyOptions::write(ostream& s) const
     s << "mode2.suppressDetailedOutput = " << convertBoolToPythonString(suppressDetailedOutput) << "\n";
     s << "mode2.suppressPhasedOutput = " << convertBoolToPythonString(suppressPhasedOutput) << "\n";
     s << "mode2.suppressHaploidOutput = " << convertBoolToPythonString(suppressHaploidOutput) << "\n";
+    s << "mode2.bgzfOutput = " << convertBoolToPythonString(bgzfOutput) << "\n";
 }
 
 
@@ -96,11 +96,39 @@ public:
     string command;
     string memoryMode;
     string memoryBacking;
+    string memoryTiering;
     uint32_t threadCount;
+    string threadAffinity;
+    string numa;
     bool suppressStdoutLog;
+    bool keepDeadData;
     string exploreAccess;
     uint16_t port;
+    uint64_t exploreThreadCount;
+    uint64_t exploreTimeout;
+    uint64_t exploreCacheSize;
+    string exploreCacheDirectory;
+    uint64_t exploreBuiltinLayoutThreshold;
+    bool exploreNeighborhoodIndex;
+    bool exploreAccessAll;
     string alignmentsPafFile;
+    string readStore;
+    string resumeFrom;
+    bool threadStatistics;
+    uint64_t slowItemCount;
+    bool hardwareCounters;
+    uint16_t metricsPort;
+    uint16_t alignmentWorkerPort;
+    string alignmentCoordinator;
+    bool memoryCheck;
+    uint64_t estimateSampleSize;
+    string batchManifest;
+    uint64_t batchConcurrency;
+    string performanceBaseline;
+    double performanceTimeTolerance;
+    double performanceMemoryTolerance;
+    double performanceFaultTolerance;
+    double performanceMinSeconds;
 };
 
 
@@ -125,8 +153,12 @@ public:
     uint64_t representation;    // 0 = Raw, 1=RLE
     int minReadLength;
     bool noCache;
+    uint64_t streamingChunkSize; // In MB. 0 = read each file entirely before parsing.
     string desiredCoverageString;
     uint64_t desiredCoverage;
+    bool lengthScan;
+    bool compressRepeatCounts;
+    bool compressNames;
 
     // String to control handling of duplicate reads.
     // Can be one of:
@@ -157,6 +189,8 @@ public:
     double enrichmentThreshold;
     uint64_t distanceThreshold;
     string file;
+    bool recomputeMarkerKmerIds;
+    bool findMarkersWhileLoadingReads;
     void write(ostream&) const;
 };
 
@@ -201,10 +235,15 @@ public:
     int maxBand;
     int sameChannelReadAlignmentSuppressDeltaThreshold;
     bool suppressContainments;
+    uint64_t readSaturationAlignmentCount;
+    bool streamAlignmentCandidates;
+    string cacheFile;
     uint64_t align4DeltaX;
     uint64_t align4DeltaY;
     uint64_t align4MinEntryCountPerCell;
     uint64_t align4MaxDistanceFromBoundary;
+    bool align4NativeBandedAlignment;
+    uint64_t align4MaxKmerFrequency;
     void write(ostream&) const;
 };
 
@@ -230,6 +269,7 @@ public:
     uint64_t flagInconsistentAlignmentsTriangleErrorThreshold;
     uint64_t flagInconsistentAlignmentsLeastSquareErrorThreshold;
     uint64_t flagInconsistentAlignmentsLeastSquareMaxDistance;
+    bool renumberReads;
     void write(ostream& ) const;
 };
 
@@ -248,6 +288,7 @@ public:
     bool allowDuplicateMarkers;
     bool cleanupDuplicateMarkers;
     double duplicateMarkersPattern1Threshold;
+    bool renumberVertices;
     int lowCoverageThreshold;
     int highCoverageThreshold;
     int maxDistance;
@@ -258,6 +299,8 @@ public:
     vector<size_t> simplifyMaxLengthVector;
     double peakFinderMinAreaFraction;
     uint64_t peakFinderAreaStartIndex;
+    uint64_t shardCount;
+    double externalMemoryBudget;
 
     // Options that control secondary edges (assembly mode 2 only).
     uint64_t secondaryEdgesMaxSkip;
@@ -310,6 +353,9 @@ public:
     bool suppressPhasedOutput;
     bool suppressHaploidOutput;
 
+    // Compress GFA and FASTA output with BGZF.
+    bool bgzfOutput;
+
     void write(ostream&) const;
 
 };
@@ -329,6 +375,7 @@ public:
     bool storeCoverageData;
     int storeCoverageDataCsvLengthThreshold;
     bool writeReadsByAssembledSegment;
+    bool bgzfOutput;
     uint64_t pruneLength;
 
     // Options that control detangling.
@@ -2,11 +2,15 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "deduplicate.hpp"
+#include "dset64-gccAtomic.hpp"
 #include "LocalReadGraph.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
 #include "performanceLog.hpp"
+#include "ReadGraphCsr.hpp"
 #include "Reads.hpp"
 #include "shastaLapack.hpp"
+#include "sortedIntersection.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 
@@ -34,130 +38,218 @@ using namespace shasta;
 // be more than maxAlignmentCount.
 void Assembler::createReadGraph(
     uint32_t maxAlignmentCount,
-    uint32_t maxTrim)
+    uint32_t maxTrim,
+    size_t threadCount,
+    bool useAlignmentCriteria)
+{
+    // Select the alignments to be kept.
+    vector<bool> keepAlignment;
+    selectReadGraphAlignments(maxAlignmentCount, useAlignmentCriteria, threadCount, keepAlignment);
+    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
+    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
+
+    // Create the read graph using the alignments we selected.
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
+}
+
+
+
+// For each read, select the best maxAlignmentCount alignments,
+// optionally only considering alignments that pass the
+// read graph 2 criteria (see createReadGraph2).
+// Each thread processes a batch of reads and stores the alignments
+// it selects in its own vector. To avoid races accessing the vector<bool>,
+// keepAlignment is only updated at the end, by a single thread.
+void Assembler::selectReadGraphAlignments(
+    uint32_t maxAlignmentCount,
+    bool useReadGraph2Criteria,
+    size_t threadCount,
+    vector<bool>& keepAlignment)
 {
     // Find the number of reads and oriented reads.
     const ReadId orientedReadCount = uint32_t(markers.size());
     SHASTA_ASSERT((orientedReadCount % 2) == 0);
     const ReadId readCount = orientedReadCount / 2;
 
-    // Mark all alignments as not to be kept.
-    vector<bool> keepAlignment(alignmentData.size(), false);
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // If requested, flag the alignments that pass the read graph 2 criteria.
+    // This uses the columnar alignment statistics.
+    createReadGraphData.useReadGraph2Criteria = useReadGraph2Criteria;
+    if(useReadGraph2Criteria) {
+        if(not alignmentStatistics.isOpen() or alignmentStatistics.size() != alignmentData.size()) {
+            computeAlignmentStatistics(threadCount);
+        }
+        createReadGraphData.passesReadGraph2Criteria.resize(alignmentData.size());
+        setupLoadBalancing(alignmentData.size(), 100000);
+        runThreads(&Assembler::flagAlignmentsPassingReadGraph2CriteriaThreadFunction, threadCount);
+    }
+
+    // Select the alignments in parallel.
+    createReadGraphData.maxAlignmentCount = maxAlignmentCount;
+    createReadGraphData.threadKeptAlignmentIds.clear();
+    createReadGraphData.threadKeptAlignmentIds.resize(threadCount);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(readCount, batchSize);
+    runThreads(&Assembler::selectReadGraphAlignmentsThreadFunction, threadCount);
+
+    // Mark the selected alignments as to be kept.
+    keepAlignment.clear();
+    keepAlignment.resize(alignmentData.size(), false);
+    for(vector<uint32_t>& keptAlignmentIds: createReadGraphData.threadKeptAlignmentIds) {
+        for(const uint32_t alignmentId: keptAlignmentIds) {
+            keepAlignment[alignmentId] = true;
+        }
+    }
+    createReadGraphData.threadKeptAlignmentIds.clear();
+    createReadGraphData.threadKeptAlignmentIds.shrink_to_fit();
+    createReadGraphData.passesReadGraph2Criteria.clear();
+    createReadGraphData.passesReadGraph2Criteria.shrink_to_fit();
+}
+
+
+
+void Assembler::flagAlignmentsPassingReadGraph2CriteriaThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        alignmentStatistics.flagPassing(
+            assemblerInfo->actualMinAlignedFraction,
+            assemblerInfo->actualMinAlignedMarkerCount,
+            assemblerInfo->actualMaxDrift,
+            assemblerInfo->actualMaxSkip,
+            assemblerInfo->actualMaxTrim,
+            begin, end,
+            createReadGraphData.passesReadGraph2Criteria.data());
+    }
+}
+
+
+
+void Assembler::selectReadGraphAlignmentsThreadFunction(size_t threadId)
+{
+    const uint32_t maxAlignmentCount = createReadGraphData.maxAlignmentCount;
+    const bool useReadGraph2Criteria = createReadGraphData.useReadGraph2Criteria;
+    vector<uint32_t>& keptAlignmentIds = createReadGraphData.threadKeptAlignmentIds[threadId];
 
     // Vector to keep the alignments for each read,
     // with their number of markers.
     // Contains pairs(marker count, alignment id).
     vector< pair<uint32_t, uint32_t> > readAlignments;
 
-    const bool debug = false;
-    if(debug) {
-        cout << "createReadGraph begins, maxAlignmentCount " << maxAlignmentCount << endl;
-    }
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
 
+        // Loop over reads in this batch.
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
 
-    // Loop over reads.
-    for(ReadId readId=0; readId<readCount; readId++) {
-        if(debug) {
-            cout << "Working on read " << readId << endl;
-        }
+            // Gather the alignments for this read, each with its number of markers.
+            readAlignments.clear();
+            for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
+                const AlignmentInfo& info = alignmentInfos[alignmentId];
 
-        // Gather the alignments for this read, each with its number of markers.
-        readAlignments.clear();
-        for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
-            const AlignmentData& alignment = alignmentData[alignmentId];
-            readAlignments.push_back(make_pair(alignment.info.markerCount, alignmentId));
-        }
-        if(debug) {
-            cout << "Found " << readAlignments.size() << " alignments." << endl;
-        }
+                // Discard each alignment if it does not pass the chosen thresholds.
+                if(useReadGraph2Criteria and not createReadGraphData.passesReadGraph2Criteria[alignmentId]) {
+                    continue;
+                }
 
-        // Keep the best maxAlignmentCount.
-        if(readAlignments.size() > maxAlignmentCount) {
-            std::nth_element(
-                readAlignments.begin(),
-                readAlignments.begin() + maxAlignmentCount,
-                readAlignments.end(),
-                std::greater< pair<uint32_t, uint32_t> >());
-            readAlignments.resize(maxAlignmentCount);
-        }
-        if(debug) {
-            cout << "Kept " << readAlignments.size() << " alignments." << endl;
-        }
+                readAlignments.push_back(make_pair(info.markerCount, alignmentId));
+            }
 
-        // Mark the surviving alignments as to be kept.
-        for(const auto& p: readAlignments) {
-            const uint32_t alignmentId = p.second;
-            keepAlignment[alignmentId] = true;
-            if(debug) {
-                const AlignmentData& alignment = alignmentData[alignmentId];
-                cout << "Marked alignment " << alignment.readIds[0] << " " <<
-                    alignment.readIds[1] << (alignment.isSameStrand ? " same strand" : " opposite strand") << endl;
+            // Keep the best maxAlignmentCount.
+            if(readAlignments.size() > maxAlignmentCount) {
+                std::nth_element(
+                    readAlignments.begin(),
+                    readAlignments.begin() + maxAlignmentCount,
+                    readAlignments.end(),
+                    std::greater< pair<uint32_t, uint32_t> >());
+                readAlignments.resize(maxAlignmentCount);
+            }
+
+            // Store the surviving alignments.
+            for(const auto& p: readAlignments) {
+                keptAlignmentIds.push_back(p.second);
             }
         }
     }
-    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
-    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
-
-    // Create the read graph using the alignments we selected.
-    createReadGraphUsingSelectedAlignments(keepAlignment);
 }
 
 
 
 // This is called for ReadGraph.creationMethod 0 and 2.
-void Assembler::createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignment)
+// Edges are created by multiple threads, each processing batches of alignments
+// and storing the edges in its own buffers. The buffers are then concatenated
+// in order of alignment id, so the result is the same as when processing
+// alignments sequentially.
+void Assembler::createReadGraphUsingSelectedAlignments(
+    vector<bool>& keepAlignment,
+    size_t threadCount)
 {
+    SHASTA_ASSERT(keepAlignment.size() == alignmentData.size());
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
 
     // Now we can create the read graph.
     // Only the alignments we marked as "keep" generate edges in the read graph.
-    readGraph.edges.createNew(largeDataName("ReadGraphEdges"), largeDataPageSize);
-    for(size_t alignmentId=0; alignmentId<alignmentData.size(); alignmentId++) {
-
-        // Record whether this alignment is used in the read graph.
-        const bool keepThisAlignment = keepAlignment[alignmentId];
-        AlignmentData& alignment = alignmentData[alignmentId];
-        alignment.info.isInReadGraph = uint8_t(keepThisAlignment);
-
-        // If this alignment is not used in the read graph, we are done.
-        if(not keepThisAlignment) {
-            continue;
+    createReadGraphData.keepAlignment = &keepAlignment;
+    createReadGraphData.threadEdges.clear();
+    createReadGraphData.threadEdges.resize(threadCount);
+    const uint64_t alignmentBatchSize = 100000;
+    setupLoadBalancing(alignmentData.size(), alignmentBatchSize);
+    runThreads(&Assembler::createReadGraphEdgesThreadFunction, threadCount);
+    createReadGraphData.keepAlignment = 0;
+
+    // Gather the edge buffers of all threads, sorted by alignment id.
+    vector< pair<uint64_t, vector<ReadGraphEdge> >* > edgeBuffers;
+    uint64_t edgeCount = 0;
+    for(auto& threadEdges: createReadGraphData.threadEdges) {
+        for(auto& p: threadEdges) {
+            edgeBuffers.push_back(&p);
+            edgeCount += p.second.size();
         }
+    }
+    sort(edgeBuffers.begin(), edgeBuffers.end(),
+        [](const auto* x, const auto* y) {return x->first < y->first;});
 
-        // Create the edge corresponding to this alignment.
-        ReadGraphEdge edge;
-        edge.alignmentId = alignmentId & 0x3fff'ffff'ffff'ffff;
-        edge.crossesStrands = 0;
-        edge.hasInconsistentAlignment = 0;
-        edge.orientedReadIds[0] = OrientedReadId(alignment.readIds[0], 0);
-        edge.orientedReadIds[1] = OrientedReadId(alignment.readIds[1], alignment.isSameStrand ? 0 : 1);
-        SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
-        readGraph.edges.push_back(edge);
-
-        // Also create the reverse complemented edge.
-        edge.orientedReadIds[0].flipStrand();
-        edge.orientedReadIds[1].flipStrand();
-        SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
-        readGraph.edges.push_back(edge);
+    // Store the edges.
+    readGraph.edges.createNew(largeDataName("ReadGraphEdges"), largeDataPageSize);
+    readGraph.edges.resize(edgeCount);
+    ReadGraphEdge* edgePointer = readGraph.edges.begin();
+    for(const auto* p: edgeBuffers) {
+        edgePointer = std::copy(p->second.begin(), p->second.end(), edgePointer);
     }
+    SHASTA_ASSERT(edgePointer == readGraph.edges.end());
+    createReadGraphData.threadEdges.clear();
+    createReadGraphData.threadEdges.shrink_to_fit();
 
     // Release unused allocated memory
     readGraph.unreserve();
 
     // Create read graph connectivity.
+    // The edges of each oriented read are sorted by decreasing edge id,
+    // which is the order generated by the single-threaded VectorOfVectors::store.
+    // The edges are added to per-thread buffers in a single pass,
+    // then stored without atomic operations on the counts
+    // of oriented reads with many edges.
+    const uint64_t edgeBatchSize = 100000;
     readGraph.connectivity.createNew(largeDataName("ReadGraphConnectivity"), largeDataPageSize);
-    readGraph.connectivity.beginPass1(2 * reads->readCount());
-    for(const ReadGraphEdge& edge: readGraph.edges) {
-        readGraph.connectivity.incrementCount(edge.orientedReadIds[0].getValue());
-        readGraph.connectivity.incrementCount(edge.orientedReadIds[1].getValue());
-    }
-    readGraph.connectivity.beginPass2();
-    for(size_t i=0; i<readGraph.edges.size(); i++) {
-        const ReadGraphEdge& edge = readGraph.edges[i];
-        readGraph.connectivity.store(edge.orientedReadIds[0].getValue(), uint32_t(i));
-        readGraph.connectivity.store(edge.orientedReadIds[1].getValue(), uint32_t(i));
-    }
-    readGraph.connectivity.endPass2();
+    createReadGraphData.connectivityFill =
+        make_shared< MemoryMapped::VectorOfVectorsParallelFill<uint32_t, uint32_t> >(
+        readGraph.connectivity, 2 * reads->readCount(), threadCount);
+    setupLoadBalancing(readGraph.edges.size(), edgeBatchSize);
+    runThreads(&Assembler::createReadGraphConnectivityThreadFunction1, threadCount);
+    createReadGraphData.connectivityFill->finish();
+    createReadGraphData.connectivityFill = 0;
+    const uint64_t orientedReadBatchSize = 10000;
+    setupLoadBalancing(readGraph.connectivity.size(), orientedReadBatchSize);
+    runThreads(&Assembler::createReadGraphConnectivityThreadFunction2, threadCount);
 
     // Count the number of isolated reads and their bases.
     uint64_t isolatedReadCount = 0;
@@ -177,6 +269,87 @@ void Assembler::createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignme
 
 
 
+void Assembler::createReadGraphEdgesThreadFunction(size_t threadId)
+{
+    const vector<bool>& keepAlignment = *createReadGraphData.keepAlignment;
+    auto& threadEdges = createReadGraphData.threadEdges[threadId];
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        threadEdges.resize(threadEdges.size() + 1);
+        threadEdges.back().first = begin;
+        vector<ReadGraphEdge>& edges = threadEdges.back().second;
+
+        // Loop over alignments in this batch.
+        for(uint64_t alignmentId=begin; alignmentId!=end; alignmentId++) {
+
+            // Record whether this alignment is used in the read graph.
+            const bool keepThisAlignment = keepAlignment[alignmentId];
+            CompactAlignmentData& alignment = alignmentData[alignmentId];
+            alignment.isInReadGraph = uint8_t(keepThisAlignment);
+
+            // If this alignment is not used in the read graph, we are done.
+            if(not keepThisAlignment) {
+                continue;
+            }
+
+            // Create the edge corresponding to this alignment.
+            ReadGraphEdge edge;
+            edge.alignmentId = alignmentId & 0x3fff'ffff'ffff'ffff;
+            edge.crossesStrands = 0;
+            edge.hasInconsistentAlignment = 0;
+            edge.orientedReadIds[0] = OrientedReadId(alignment.readIds[0], 0);
+            edge.orientedReadIds[1] = OrientedReadId(alignment.readIds[1], alignment.isSameStrand ? 0 : 1);
+            SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
+            edges.push_back(edge);
+
+            // Also create the reverse complemented edge.
+            edge.orientedReadIds[0].flipStrand();
+            edge.orientedReadIds[1].flipStrand();
+            SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
+            edges.push_back(edge);
+        }
+    }
+}
+
+
+
+void Assembler::createReadGraphConnectivityThreadFunction1(size_t threadId)
+{
+    auto& fill = *createReadGraphData.connectivityFill;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over edges assigned to this batch.
+        for(uint64_t i=begin; i!=end; ++i) {
+            const ReadGraphEdge& edge = readGraph.edges[i];
+            fill.add(threadId, edge.orientedReadIds[0].getValue(), uint32_t(i));
+            fill.add(threadId, edge.orientedReadIds[1].getValue(), uint32_t(i));
+        }
+    }
+}
+
+
+
+void Assembler::createReadGraphConnectivityThreadFunction2(size_t)
+{
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch and sort their edges.
+        for(uint64_t i=begin; i!=end; ++i) {
+            const span<uint32_t> edgeIds = readGraph.connectivity[uint32_t(i)];
+            sort(edgeIds.begin(), edgeIds.end(), std::greater<uint32_t>());
+        }
+    }
+}
+
+
+
 void Assembler::accessReadGraph()
 {
     readGraph.edges.accessExistingReadOnly(largeDataName("ReadGraphEdges"));
@@ -209,7 +382,8 @@ bool Assembler::createLocalReadGraph(
         bool allowCrossStrandEdges,
         bool allowInconsistentAlignmentEdges,
         double timeout,                 // Or 0 for no timeout.
-        LocalReadGraph& graph)
+        LocalReadGraph& graph,
+        size_t threadCount)
 {
     const vector<OrientedReadId> starts = {start};
     bool success = createLocalReadGraph(
@@ -219,7 +393,8 @@ bool Assembler::createLocalReadGraph(
             allowCrossStrandEdges,
             allowInconsistentAlignmentEdges,
             timeout,                 // Or 0 for no timeout.
-            graph
+            graph,
+            threadCount
     );
 
     return success;
@@ -236,8 +411,21 @@ bool Assembler::createLocalReadGraph(
     bool allowCrossStrandEdges,
     bool allowInconsistentAlignmentEdges,
     double timeout,                 // Or 0 for no timeout.
-    LocalReadGraph& graph)
+    LocalReadGraph& graph,
+    size_t threadCount)
 {
+    if(threadCount > 1) {
+        return createLocalReadGraphParallel(
+            starts,
+            maxDistance,
+            allowChimericReads,
+            allowCrossStrandEdges,
+            allowInconsistentAlignmentEdges,
+            timeout,
+            graph,
+            threadCount);
+    }
+
     const auto startTime = steady_clock::now();
 
     // Initialize a BFS starting at the start vertex.
@@ -293,10 +481,10 @@ bool Assembler::createLocalReadGraph(
             }
 
             // Get alignment information.
-            const AlignmentData& alignment = alignmentData[globalEdge.alignmentId];
+            const CompactAlignmentData& alignment = alignmentData[globalEdge.alignmentId];
             OrientedReadId alignmentOrientedReadId0(alignment.readIds[0], 0);
             OrientedReadId alignmentOrientedReadId1(alignment.readIds[1], alignment.isSameStrand ? 0 : 1);
-            AlignmentInfo alignmentInfo = alignment.info;
+            AlignmentInfo alignmentInfo = alignmentInfos[globalEdge.alignmentId];
             if (alignmentOrientedReadId0.getReadId() != orientedReadId0.getReadId()) {
                 swap(alignmentOrientedReadId0, alignmentOrientedReadId1);
                 alignmentInfo.swap();
@@ -343,6 +531,222 @@ bool Assembler::createLocalReadGraph(
 
 
 
+// Parallel version of createLocalReadGraph.
+// It creates the same vertices and edges, using a level-synchronous BFS.
+bool Assembler::createLocalReadGraphParallel(
+    const vector<OrientedReadId>& starts,
+    uint32_t maxDistance,
+    bool allowChimericReads,
+    bool allowCrossStrandEdges,
+    bool allowInconsistentAlignmentEdges,
+    double timeout,
+    LocalReadGraph& graph,
+    size_t threadCount)
+{
+    // If a starting read is chimeric and we don't allow chimeric reads, skip it.
+    vector<OrientedReadId> bfsStarts;
+    for(const OrientedReadId start: starts) {
+        if(allowChimericReads or not reads->getFlags(start.getReadId()).isChimeric) {
+            bfsStarts.push_back(start);
+        }
+    }
+
+    // The edges of the global read graph to be followed.
+    // This is called concurrently by multiple threads.
+    const LocalGraphFindEdges findEdges =
+        [&](OrientedReadId orientedReadId0, vector< pair<OrientedReadId, uint64_t> >& neighbors)
+    {
+        neighbors.clear();
+        for(const uint64_t i: readGraph.connectivity[orientedReadId0.getValue()]) {
+            SHASTA_ASSERT(i < readGraph.edges.size());
+            const ReadGraphEdge& globalEdge = readGraph.edges[i];
+            if(!allowCrossStrandEdges && globalEdge.crossesStrands) {
+                continue;
+            }
+            if(!allowInconsistentAlignmentEdges && globalEdge.hasInconsistentAlignment) {
+                continue;
+            }
+            const OrientedReadId orientedReadId1 = globalEdge.getOther(orientedReadId0);
+            if(!allowChimericReads && reads->getFlags(orientedReadId1.getReadId()).isChimeric) {
+                continue;
+            }
+            neighbors.push_back(make_pair(orientedReadId1, i));
+        }
+    };
+
+    // Do the BFS.
+    vector< pair<OrientedReadId, uint32_t> > vertices;
+    vector< tuple<OrientedReadId, OrientedReadId, uint64_t> > edges;
+    if(not localGraphBfs(bfsStarts, maxDistance, timeout, threadCount, findEdges, vertices, edges)) {
+        graph.clear();
+        return false;
+    }
+
+    // Create the local read graph.
+    for(const auto& p: vertices) {
+        const OrientedReadId orientedReadId = p.first;
+        graph.addVertex(orientedReadId,
+            uint32_t(markers[orientedReadId.getValue()].size()),
+            reads->getFlags(orientedReadId.getReadId()).isChimeric, p.second);
+    }
+    for(const auto& t: edges) {
+        const uint64_t i = get<2>(t);
+        const ReadGraphEdge& globalEdge = readGraph.edges[i];
+
+        // The marker count of an alignment does not change
+        // when swapping or reverse complementing it.
+        const uint32_t markerCount = alignmentData[globalEdge.alignmentId].markerCount;
+        graph.addEdge(get<0>(t), get<1>(t), markerCount, i, globalEdge.crossesStrands == 1);
+    }
+
+    return true;
+}
+
+
+
+bool Assembler::localGraphBfs(
+    const vector<OrientedReadId>& starts,
+    uint32_t maxDistance,
+    double timeout,
+    size_t threadCount,
+    const LocalGraphFindEdges& findEdges,
+    vector< pair<OrientedReadId, uint32_t> >& vertices,
+    vector< tuple<OrientedReadId, OrientedReadId, uint64_t> >& edges)
+{
+    // Check that we have what we need.
+    SHASTA_ASSERT(threadCount > 0);
+
+    LocalGraphBfsData& data = localGraphBfsData;
+    data.findEdges = &findEdges;
+    data.maxDistance = maxDistance;
+    data.timeout = timeout;
+    data.startTime = steady_clock::now();
+    data.timeoutExceeded = false;
+    data.distanceMap.clear();
+    data.threadData.resize(threadCount);
+    vertices.clear();
+    edges.clear();
+
+    // The starts are at distance 0.
+    data.frontier.clear();
+    for(const OrientedReadId start: starts) {
+        if(data.distanceMap.insert(start.getValue(), 0)) {
+            data.frontier.push_back(start);
+            vertices.push_back(make_pair(start, 0));
+        }
+    }
+
+    // Process one level at a time.
+    // We also process the vertices at maxDistance,
+    // to find their edges to other vertices at maxDistance.
+    bool success = true;
+    for(data.distance0=0; not data.frontier.empty(); ++data.distance0) {
+
+        // See if we exceeded the timeout.
+        if(timeout > 0. and (seconds(steady_clock::now() - data.startTime) > timeout)) {
+            success = false;
+            break;
+        }
+
+        // Expand the frontier in parallel.
+        for(auto& threadData: data.threadData) {
+            threadData.newVertices.clear();
+            threadData.edges.clear();
+        }
+        const uint64_t batchSize = 16;
+        setupLoadBalancing(data.frontier.size(), batchSize);
+        runThreads(&Assembler::localGraphBfsThreadFunction, threadCount);
+        if(data.timeoutExceeded) {
+            success = false;
+            break;
+        }
+
+        // Gather the results. The new vertices are sorted so the result
+        // does not depend on the order in which threads processed them.
+        data.frontier.clear();
+        for(const auto& threadData: data.threadData) {
+            data.frontier.insert(data.frontier.end(),
+                threadData.newVertices.begin(), threadData.newVertices.end());
+            edges.insert(edges.end(),
+                threadData.edges.begin(), threadData.edges.end());
+        }
+        sort(data.frontier.begin(), data.frontier.end());
+        for(const OrientedReadId orientedReadId: data.frontier) {
+            vertices.push_back(make_pair(orientedReadId, data.distance0 + 1));
+        }
+    }
+
+    // Clean up.
+    data.distanceMap.clear();
+    data.frontier.clear();
+    data.threadData.clear();
+    if(not success) {
+        vertices.clear();
+        edges.clear();
+        return false;
+    }
+
+    // An edge is usually found from both of its vertices.
+    // Keep only one copy of each.
+    sort(edges.begin(), edges.end(),
+        [](const auto& x, const auto& y)
+        {
+            return get<2>(x) < get<2>(y);
+        });
+    edges.resize(unique(edges.begin(), edges.end(),
+        [](const auto& x, const auto& y)
+        {
+            return get<2>(x) == get<2>(y);
+        }) - edges.begin());
+
+    return true;
+}
+
+
+
+void Assembler::localGraphBfsThreadFunction(size_t threadId)
+{
+    LocalGraphBfsData& data = localGraphBfsData;
+    LocalGraphBfsData::ThreadData& threadData = data.threadData[threadId];
+    const uint32_t distance1 = data.distance0 + 1;
+    vector< pair<OrientedReadId, uint64_t> > neighbors;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // See if we exceeded the timeout, or another thread did.
+        if(data.timeout > 0. and (seconds(steady_clock::now() - data.startTime) > data.timeout)) {
+            data.timeoutExceeded = true;
+        }
+        if(data.timeoutExceeded) {
+            return;
+        }
+
+        for(uint64_t i=begin; i!=end; ++i) {
+            const OrientedReadId orientedReadId0 = data.frontier[i];
+            (*data.findEdges)(orientedReadId0, neighbors);
+
+            for(const auto& p: neighbors) {
+                const OrientedReadId orientedReadId1 = p.first;
+                if(data.distance0 < data.maxDistance) {
+                    // Claim orientedReadId1, if no other thread did it before.
+                    if(data.distanceMap.insert(orientedReadId1.getValue(), distance1)) {
+                        threadData.newVertices.push_back(orientedReadId1);
+                    }
+                    threadData.edges.push_back(make_tuple(orientedReadId0, orientedReadId1, p.second));
+                } else {
+                    // At maxDistance, only keep edges to vertices already reached.
+                    if(data.distanceMap.contains(orientedReadId1.getValue())) {
+                        threadData.edges.push_back(make_tuple(orientedReadId0, orientedReadId1, p.second));
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
 // Use the read graph to flag chimeric reads.
 // For each oriented read and corresponding vertex v0, we do
 // a BFS in the read graph up to the specified maxDistance.
@@ -379,9 +783,15 @@ void Assembler::flagChimericReads(size_t maxDistance, size_t threadCount)
         threadCount = std::thread::hardware_concurrency();
     }
 
+    // Create the CSR view of the read graph used for the BFSs,
+    // excluding cross-strand edges.
+    const ReadGraphCsr csr(readGraph, true, threadCount);
+    flagChimericReadsData.csr = &csr;
+
     // Multithreaded loop over all reads.
     setupLoadBalancing(readCount, 10000);
     runThreads(&Assembler::flagChimericReadsThreadFunction, threadCount);
+    flagChimericReadsData.csr = 0;
 
     performanceLog << timestamp << "Done flagging chimeric reads." << endl;
 
@@ -402,28 +812,14 @@ void Assembler::flagChimericReads(size_t maxDistance, size_t threadCount)
 void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 {
     const size_t maxDistance = flagChimericReadsData.maxDistance;
+    const ReadGraphCsr& csr = *flagChimericReadsData.csr;
+    const uint32_t notReached = ReadGraphBfs::notReached;
 
-    // Vector used for BFS searches by this thread.
-    // It stores the local vertex id in the current BFS assigned to each vertex,
-    // or notReached for vertices not yet reached by the current BFS.
-    // Indexed by orientedRead.getValue().
-    // This is of size equal to the number of oriented reads, and each thread has its own copy.
+    // The BFS used by this thread. It contains a vector of
+    // size equal to the number of oriented reads, and each thread has its own copy.
     // This is not prohibitive. For example, for a large human size run with
-    // 20 million reads and 100 threads, the total space is only 16 GB.
-    MemoryMapped::Vector<uint32_t> vertexTable;
-    vertexTable.createNew(
-        largeDataName("tmp-FlagChimericReads-VertexTable" + to_string(threadId)),
-        largeDataPageSize);
-    vertexTable.resize(readGraph.connectivity.size());
-    const uint32_t notReached = std::numeric_limits<uint32_t>::max();
-    fill(vertexTable.begin(), vertexTable.end(), notReached);
-
-    // Vector to contain the vertices we found in the current BFS,
-    // each with the distance from the start vertex.
-    vector< pair<OrientedReadId, uint32_t> > localVertices;
-
-    // The queue used for the BFS.
-    std::queue<OrientedReadId> q;
+    // 20 million reads and 100 threads, the total space is only 32 GB.
+    ReadGraphBfs bfs(csr);
 
     // Vectors used to compute connected components after each BFS.
     vector<uint32_t> rank;
@@ -437,59 +833,15 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
         // Loop over all reads assigned to this batch.
         for(ReadId startReadId=ReadId(begin); startReadId!=ReadId(end); startReadId++) {
 
-            // Check that there is no garbage left by the previous BFS.
-            SHASTA_ASSERT(localVertices.empty());
-            SHASTA_ASSERT(q.empty());
-
             // Begin by flagging this read as not chimeric.
             reads->setChimericFlag(startReadId, false);
 
-
-
             // Do the BFS for this read and strand 0.
+            // This finds the vertices within maxDistance of vStart,
+            // each with its distance from vStart.
             const OrientedReadId startOrientedReadId(startReadId, 0);
-            uint32_t localVertexId = 0;
-            q.push(startOrientedReadId);
-            localVertices.push_back(make_pair(startOrientedReadId, 0));
-            vertexTable[startOrientedReadId.getValue()] = localVertexId++;
-            while(!q.empty()) {
-
-                // Dequeue a vertex.
-                const OrientedReadId v0 = q.front();
-                q.pop();
-                const uint32_t distance0 = localVertices[vertexTable[v0.getValue()]].second;
-                const uint32_t distance1 = distance0 + 1;
-                // out << "Dequeued " << v0 << endl;
-
-                // Loop over edges involving this vertex.
-                const auto edgeIds = readGraph.connectivity[v0.getValue()];
-                for(const uint32_t edgeId: edgeIds) {
-                    const ReadGraphEdge& edge = readGraph.edges[edgeId];
-                    if(edge.crossesStrands) {
-                        continue;
-                    }
-                    const OrientedReadId v1 = edge.getOther(v0);
-                    // out << "Found " << v1 << endl;
-
-                    // If we already encountered this read in this BFS, do nothing.
-                    if(vertexTable[v1.getValue()] != notReached) {
-                        // out << "Previously reached." << endl;
-                        continue;
-                    }
-
-                    // Record this vertex.
-                    // out << "Recording " << v1 << endl;
-                    localVertices.push_back(make_pair(v1, distance1));
-                    vertexTable[v1.getValue()] = localVertexId++;
-
-                    // If at distance less than maxDistance, also enqueue it.
-                    if(distance1 < maxDistance) {
-                        // out << "Enqueueing " << v1 << endl;
-                        q.push(v1);
-                    }
-                }
-            }
-            // out << "BFS found " << localVertices.size() << " vertices." << endl;
+            bfs.run(startOrientedReadId, maxDistance);
+            const vector<ReadGraphBfs::Vertex>& localVertices = bfs.getVertices();
 
 
 
@@ -508,24 +860,17 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 
             // Loop over all edges involving the vertices we found during the BFS,
             // but disregarding vertices involving vStart or its reverse complement.
-            for(const auto& p: localVertices) {
-                const OrientedReadId v0 = p.first;
+            // Cross-strand edges are not in the CSR view.
+            for(uint32_t u0=0; u0<n; u0++) {
+                const OrientedReadId v0 = localVertices[u0].orientedReadId;
                 if(v0.getReadId() == startOrientedReadId.getReadId()) {
                     continue;   // Skip edges involving vStart or its reverse complement.
                 }
-                const uint32_t u0 = vertexTable[v0.getValue()];
-                SHASTA_ASSERT(u0 != notReached);
-                const auto edges = readGraph.connectivity[v0.getValue()];
-                for(const uint32_t edgeId: edges) {
-                    const ReadGraphEdge& edge = readGraph.edges[edgeId];
-                    if(edge.crossesStrands) {
-                        continue;
-                    }
-                    const OrientedReadId v1 = edge.getOther(v0);
+                for(const OrientedReadId v1: csr[v0]) {
                     if(v1.getReadId() == startOrientedReadId.getReadId()) {
                         continue;   // Skip edges involving startOrientedReadId.
                     }
-                    const uint32_t u1 = vertexTable[v1.getValue()];
+                    const uint32_t u1 = bfs.getLocalIndex(v1);
                     if(u1 != notReached) {
                         disjointSets.union_set(u0, u1);
                     }
@@ -538,17 +883,15 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
             // removing vStart affects the large scale connectivity of the
             // read graph, and therefore we flag vStart as chimeric.
             uint32_t component = std::numeric_limits<uint32_t>::max();
-            for(const auto& p: localVertices) {
-                if(p.second != maxDistance) {
+            for(uint32_t u=0; u<n; u++) {
+                if(localVertices[u].distance != maxDistance) {
                     continue;
                 }
-                const OrientedReadId v = p.first;
+                const OrientedReadId v = localVertices[u].orientedReadId;
                 if(v.getReadId() == startOrientedReadId.getReadId()) {
                     // Skip the reverse complement of the start vertex.
                     continue;
                 }
-                const uint32_t u = vertexTable[v.getValue()];
-                SHASTA_ASSERT(u != notReached);
                 const uint32_t uComponent = disjointSets.find_set(u);
                 if(component == std::numeric_limits<ReadId>::max()) {
                     component = uComponent;
@@ -558,28 +901,14 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
                         // Also flag all alignments involving this read as not in the read graph.
                         const span<uint32_t> alignmentIds = alignmentTable[OrientedReadId(startReadId, 0).getValue()];
                         for(const uint32_t alignmentId: alignmentIds) {
-                            alignmentData[alignmentId].info.isInReadGraph = 0;
+                            alignmentData[alignmentId].isInReadGraph = 0;
                         }
                         break;
                     }
                 }
             }
-
-
-            // Before processing the next read, we need to reset
-            // all entries of the distance vector to notReached,
-            // then clear the verticesFound vector.
-            for(const auto& p: localVertices) {
-                const OrientedReadId orientedReadId = p.first;
-                vertexTable[orientedReadId.getValue()] = notReached;
-            }
-            localVertices.clear();
         }
     }
-
-    // Remove our work vector.
-    vertexTable.remove();
-
 }
 
 
@@ -587,7 +916,7 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 // Compute connected components of the read graph.
 // This just writes a csv file and has no other side effects
 // (nothing is stored).
-void Assembler::computeReadGraphConnectedComponents() const
+void Assembler::computeReadGraphConnectedComponents(size_t threadCount) const
 {
     // Check that we have what we need.
     reads->checkReadFlagsAreOpen();
@@ -597,72 +926,112 @@ void Assembler::computeReadGraphConnectedComponents() const
     SHASTA_ASSERT(readGraph.connectivity.size() == orientedReadCount);
     checkAlignmentDataAreOpen();
 
+    // Batch sizes used below.
+    const uint64_t edgeBatchSize = 10000;
+    const uint64_t vertexBatchSize = 10000;
+
 
 
     // Compute connected components of the read graph,
     // treating chimeric reads as isolated and ignoring
     // edges flagged as crossesStrands or hasInconsistentAlignment.
-    vector<ReadId> rank(orientedReadCount);
-    vector<ReadId> parent(orientedReadCount);
-    boost::disjoint_sets<ReadId*, ReadId*> disjointSets(&rank[0], &parent[0]);
+    // This uses the lock-free DisjointSets, so the edges
+    // can be processed by multiple threads in any order.
     performanceLog << timestamp << "Computing connected components of the read graph." << endl;
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            disjointSets.make_set(OrientedReadId(readId, strand).getValue());
-        }
-    }
-    for(const ReadGraphEdge& edge: readGraph.edges) {
-        if(edge.crossesStrands) {
-            continue;
-        }
-        if(edge.hasInconsistentAlignment) {
-            continue;
-        }
-        const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
-        const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
-        const ReadId readId0 = orientedReadId0.getReadId();
-        const ReadId readId1 = orientedReadId1.getReadId();
-        if(reads->getFlags(readId0).isChimeric) {
-            continue;
-        }
-        if(reads->getFlags(readId1).isChimeric) {
-            continue;
-        }
-        disjointSets.union_set(orientedReadId0.getValue(), orientedReadId1.getValue());
-    }
+    vector<DisjointSets::Aint> disjointSetsData(orientedReadCount);
+    DisjointSets disjointSets(&disjointSetsData[0], orientedReadCount, false);
+    parallelFor(orientedReadCount, vertexBatchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; ++i) {
+                disjointSets.initialize(i);
+            }
+        });
+    parallelFor(readGraph.edges.size(), edgeBatchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t edgeId=begin; edgeId!=end; ++edgeId) {
+                const ReadGraphEdge& edge = readGraph.edges[edgeId];
+                if(edge.crossesStrands) {
+                    continue;
+                }
+                if(edge.hasInconsistentAlignment) {
+                    continue;
+                }
+                const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
+                const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
+                const ReadId readId0 = orientedReadId0.getReadId();
+                const ReadId readId1 = orientedReadId1.getReadId();
+                if(reads->getFlags(readId0).isChimeric) {
+                    continue;
+                }
+                if(reads->getFlags(readId1).isChimeric) {
+                    continue;
+                }
+                disjointSets.unite(orientedReadId0.getValue(), orientedReadId1.getValue());
+            }
+        });
 
 
 
-    // Gather the vertices of each component.
-    std::map<ReadId, vector<OrientedReadId> > componentMap;
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const ReadId componentId = disjointSets.find_set(orientedReadId.getValue());
-            componentMap[componentId].push_back(orientedReadId);
-        }
-    }
-    cout << "The read graph has " << componentMap.size() <<
+    // Find the representative of each oriented read
+    // and count the oriented reads in each component.
+    // The count for each component is stored at the representative.
+    vector<uint64_t> representative(orientedReadCount);
+    vector<uint64_t> componentSize(orientedReadCount, 0);
+    parallelFor(orientedReadCount, vertexBatchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; ++i) {
+                const uint64_t r = disjointSets.find(i);
+                representative[i] = r;
+                __sync_fetch_and_add(&componentSize[r], 1);
+            }
+        });
+    const uint64_t componentCount = parallelReduce(orientedReadCount, vertexBatchSize, threadCount,
+        uint64_t(0),
+        [&](uint64_t& count, uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; ++i) {
+                if(representative[i] == i) {
+                    ++count;
+                }
+            }
+        },
+        [](uint64_t& x, const uint64_t& y) {x += y;});
+    cout << "The read graph has " << componentCount <<
         " connected components." << endl;
 
 
 
-    // Sort the components by decreasing size (number of reads).
-    // componentTable contains pairs(size, componentId as key in componentMap).
-    vector< pair<size_t, uint32_t> > componentTable;
-    for(const auto& p: componentMap) {
-        const vector<OrientedReadId>& component = p.second;
-        componentTable.push_back(make_pair(component.size(), p.first));
+    // Gather the oriented reads of each component with more than one oriented read.
+    // Isolated oriented reads are not written below.
+    // The oriented reads of each component are in increasing order.
+    vector< vector<OrientedReadId> > components;
+    vector<uint64_t> componentIndex(orientedReadCount, invalid<uint64_t>);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        const uint64_t r = representative[i];
+        if(componentSize[r] > 1) {
+            if(componentIndex[r] == invalid<uint64_t>) {
+                componentIndex[r] = components.size();
+                components.emplace_back();
+                components.back().reserve(componentSize[r]);
+            }
+            components[componentIndex[r]].push_back(OrientedReadId::fromValue(ReadId(i)));
+        }
     }
-    std::ranges::sort(componentTable, std::greater<pair<size_t, uint32_t>>());
 
 
 
-    // Store components in this order of decreasing size.
-    vector< vector<OrientedReadId> > components;
-    for(const auto& p: componentTable) {
-        components.push_back(componentMap[p.second]);
-    }
+    // Sort the components by decreasing size (number of reads),
+    // then by increasing first oriented read.
+    // The representatives chosen by the DisjointSets depend on the order
+    // in which the edges were processed, so they are not used to sort.
+    std::ranges::sort(components,
+        [](const vector<OrientedReadId>& x, const vector<OrientedReadId>& y)
+        {
+            return (x.size() > y.size()) or (x.size() == y.size() and x.front() < y.front());
+        });
     performanceLog << timestamp << "Done computing connected components of the read graph." << endl;
 
 
@@ -806,6 +1175,11 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
     // Store the maximum distance so all threads can see it.
     flagCrossStrandReadGraphEdges1Data.maxDistance = maxDistance;
 
+    // Create the CSR view of the read graph used for the BFSs.
+    // There are no cross-strand edges at this point.
+    const ReadGraphCsr csr(readGraph, true, threadCount);
+    flagCrossStrandReadGraphEdges1Data.csr = &csr;
+
     // Find which vertices are close to their reverse complement.
     // "Close" means that there is a path of distance up to maxDistance.
     flagCrossStrandReadGraphEdges1Data.isNearStrandJump.clear();
@@ -813,6 +1187,10 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
     const size_t batchSize = 10000;
     setupLoadBalancing(readCount, batchSize);
     runThreads(&Assembler::flagCrossStrandReadGraphEdges1ThreadFunction, threadCount);
+    flagCrossStrandReadGraphEdges1Data.csr = 0;
+    // The CSR view is also used below to find the edges of each strand jump region.
+    // Setting the crossesStrands flag of some edges below does not invalidate it,
+    // because only its isFirstFlag is used there.
     const auto& isNearStrandJump = flagCrossStrandReadGraphEdges1Data.isNearStrandJump;
 
 
@@ -836,13 +1214,15 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
             disjointSets.make_set(OrientedReadId(readId, strand).getValue());
         }
     }
-    for(const ReadGraphEdge& edge: readGraph.edges) {
-        const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
-        const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
-        const auto v0 = orientedReadId0.getValue();
-        const auto v1 = orientedReadId1.getValue();
-        if(isNearStrandJump[v0] && isNearStrandJump[v1]) {
-            disjointSets.union_set(v0, v1);
+    for(ReadId v0=0; v0<orientedReadCount; v0++) {
+        if(not isNearStrandJump[v0]) {
+            continue;
+        }
+        for(const OrientedReadId orientedReadId1: csr[OrientedReadId::fromValue(v0)]) {
+            const auto v1 = orientedReadId1.getValue();
+            if(isNearStrandJump[v1]) {
+                disjointSets.union_set(v0, v1);
+            }
         }
     }
 
@@ -901,16 +1281,18 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
         // This allows us later to match edges into reverse complemented pairs.
         vector< pair<uint32_t, uint64_t> > edgeIds;  // pair(edgeId, alignmentId).
         for(const OrientedReadId orientedReadId0: vertices) {
-            const OrientedReadId::Int v0 = orientedReadId0.getValue();
-            for(const uint32_t edgeId: readGraph.connectivity[v0]) {
-                const ReadGraphEdge& edge = readGraph.edges[edgeId];
-                const OrientedReadId orientedReadId1 = edge.getOther(orientedReadId0);
-                if(vertexMap.find(orientedReadId1) == vertexMap.end()) {
-                    continue;
+            const span<const OrientedReadId> neighbors = csr[orientedReadId0];
+            const span<const uint32_t> neighborEdgeIds = csr.getEdgeIds(orientedReadId0);
+            const span<const uint32_t> neighborAlignmentIds = csr.getAlignmentIds(orientedReadId0);
+            const span<const uint8_t> neighborFlags = csr.getFlags(orientedReadId0);
+            for(uint64_t i=0; i<neighbors.size(); i++) {
+                if(not (neighborFlags[i] & ReadGraphCsr::isFirstFlag)) {
+                    continue;   // So we don't add it twice.
                 }
-                if(edge.orientedReadIds[0] == orientedReadId0) { // So we don't add it twice.
-                    edgeIds.push_back(make_pair(edgeId, edge.alignmentId));
+                if(vertexMap.find(neighbors[i]) == vertexMap.end()) {
+                    continue;
                 }
+                edgeIds.push_back(make_pair(neighborEdgeIds[i], uint64_t(neighborAlignmentIds[i])));
             }
         }
         if(debug) {
@@ -931,7 +1313,7 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
         for(size_t i=0; i<edgeIds.size(); i+=2){
             const uint64_t alignmentId = edgeIds[i].second;
             SHASTA_ASSERT(alignmentId == edgeIds[i+1].second);
-            const uint32_t markerCount = alignmentData[alignmentId].info.markerCount;
+            const uint32_t markerCount = alignmentData[alignmentId].markerCount;
             const array<uint32_t, 2> edgePair = {edgeIds[i].first, edgeIds[i+1].first};
             edgePairs.push_back(make_pair(edgePair, markerCount));
         }
@@ -985,7 +1367,7 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
                     edge.crossesStrands = 1;
                     // Also mark the corresponding alignment as not in the read graph.
                     const uint64_t alignmentId = edge.alignmentId;
-                    alignmentData[alignmentId].info.isInReadGraph = 0;
+                    alignmentData[alignmentId].isInReadGraph = 0;
                 } else {
                     disjointSets.union_set(i0, i1);
                     disjointSets.union_set(i0rc, i1rc);
@@ -1014,13 +1396,9 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
 
 void Assembler::flagCrossStrandReadGraphEdges1ThreadFunction(size_t threadId)
 {
-    const size_t readCount = reads->readCount();
     const size_t maxDistance = flagCrossStrandReadGraphEdges1Data.maxDistance;
     auto& isNearStrandJump = flagCrossStrandReadGraphEdges1Data.isNearStrandJump;
-    vector<uint32_t> distance(2*readCount, ReadGraph::infiniteDistance);
-    vector<OrientedReadId> reachedVertices;
-    vector<uint32_t> parentEdges(2*readCount);
-    vector<uint32_t> shortestPath;
+    ReadGraphBfs bfs(*flagCrossStrandReadGraphEdges1Data.csr);
     uint64_t begin, end;
 
     while(getNextBatch(begin, end)) {
@@ -1028,10 +1406,7 @@ void Assembler::flagCrossStrandReadGraphEdges1ThreadFunction(size_t threadId)
         for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
             const OrientedReadId orientedReadId0(readId, 0);
             const OrientedReadId orientedReadId1(readId, 1);
-            readGraph.computeShortPath(orientedReadId0, orientedReadId1,
-                maxDistance, shortestPath,
-                distance, reachedVertices, parentEdges);
-            if(!shortestPath.empty()) {
+            if(bfs.run(orientedReadId0, maxDistance, orientedReadId1)) {
                 isNearStrandJump[orientedReadId0.getValue()] = true;
                 isNearStrandJump[orientedReadId1.getValue()] = true;
             }
@@ -1074,7 +1449,7 @@ void Assembler::flagCrossStrandReadGraphEdges2()
         }
 
         const uint64_t alignmentId = edge.alignmentId;
-        const AlignmentData& alignment = alignmentData[alignmentId];
+        const CompactAlignmentData& alignment = alignmentData[alignmentId];
 
         // Skip edges involving reads classified as chimeric.
         if(getReads().getFlags(alignment.readIds[0]).isChimeric) {
@@ -1085,7 +1460,7 @@ void Assembler::flagCrossStrandReadGraphEdges2()
         }
 
         // Sanity check.
-        SHASTA_ASSERT(alignmentData[alignmentId].info.isInReadGraph);
+        SHASTA_ASSERT(alignmentData[alignmentId].isInReadGraph);
 
         // Check that the next edge is the reverse complement of
         // this edge.
@@ -1100,7 +1475,7 @@ void Assembler::flagCrossStrandReadGraphEdges2()
         }
 
         // Store this pair of edges in our edgeTable.
-        const uint32_t alignedMarkerCount = alignment.info.markerCount;
+        const uint32_t alignedMarkerCount = alignment.markerCount;
         if(edgeTable.size() <= alignedMarkerCount) {
             edgeTable.resize(alignedMarkerCount + 1);
         }
@@ -1177,7 +1552,7 @@ void Assembler::flagCrossStrandReadGraphEdges2()
                 SHASTA_ASSERT(a1 == b0);
                 edge.crossesStrands = 1;
                 nextEdge.crossesStrands = 1;
-                alignmentData[edge.alignmentId].info.isInReadGraph = false;
+                alignmentData[edge.alignmentId].isInReadGraph = false;
                 crossStrandEdgeCount += 2;
                 continue;
             }
@@ -1306,7 +1681,7 @@ void Assembler::flagCrossStrandReadGraphEdges2()
 
 
 
-void Assembler::removeReadGraphBridges(uint64_t maxDistance)
+void Assembler::removeReadGraphBridges(uint64_t maxDistance, size_t threadCount)
 {
     // Check that we have what we need.
     SHASTA_ASSERT(alignmentData.isOpen);
@@ -1324,13 +1699,36 @@ void Assembler::removeReadGraphBridges(uint64_t maxDistance)
         count(keepAlignment.begin(), keepAlignment.end(), true) <<
         " alignments out of " << alignmentData.size() << endl;
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Find the read graph bridges, in parallel.
+    // Each thread stores the alignments corresponding to the bridges it finds.
+    {
+        const ReadGraphCsr csr(readGraph, false, threadCount);
+        removeReadGraphBridgesData.maxDistance = maxDistance;
+        removeReadGraphBridgesData.csr = &csr;
+        removeReadGraphBridgesData.threadBridgeAlignmentIds.clear();
+        removeReadGraphBridgesData.threadBridgeAlignmentIds.resize(threadCount);
+        setupLoadBalancing(readGraph.connectivity.size() / 2, 1000);
+        runThreads(&Assembler::removeReadGraphBridgesThreadFunction, threadCount);
+        removeReadGraphBridgesData.csr = 0;
+    }
+
     // Unflag alignments corresponding to read graph bridges.
-    readGraph.findBridges(keepAlignment, maxDistance);
+    for(const vector<uint64_t>& bridgeAlignmentIds: removeReadGraphBridgesData.threadBridgeAlignmentIds) {
+        for(const uint64_t alignmentId: bridgeAlignmentIds) {
+            keepAlignment[alignmentId] = false;
+        }
+    }
+    removeReadGraphBridgesData.threadBridgeAlignmentIds.clear();
 
     // Recreate the read graph using the surviving alignments.
     readGraph.edges.remove();
     readGraph.connectivity.remove();
-    createReadGraphUsingSelectedAlignments(keepAlignment);
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
 
     cout << timestamp << "After removing bridges, the read graph uses " <<
         count(keepAlignment.begin(), keepAlignment.end(), true) <<
@@ -1339,6 +1737,26 @@ void Assembler::removeReadGraphBridges(uint64_t maxDistance)
 
 
 
+void Assembler::removeReadGraphBridgesThreadFunction(size_t threadId)
+{
+    const uint64_t maxDistance = removeReadGraphBridgesData.maxDistance;
+    vector<uint64_t>& bridgeAlignmentIds = removeReadGraphBridgesData.threadBridgeAlignmentIds[threadId];
+    ReadGraphBfs bfs(*removeReadGraphBridgesData.csr);
+    vector<OrientedReadId> neighbors;
+
+    // Loop over all batches assigned to this thread.
+    // We only consider vertices corresponding to reads on strand 0.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            readGraph.findBridges(OrientedReadId(readId, 0), maxDistance,
+                bfs, neighbors, bridgeAlignmentIds);
+        }
+    }
+}
+
+
+
 void Assembler::analyzeReadGraph()
 {
     // Check that we have what we need.
@@ -1449,6 +1867,10 @@ void Assembler::readGraphClustering()
     vector<ReadId> cluster;
     const bool debug = false;
 
+    // The per-edge loops below use all available threads.
+    const size_t threadCount = 0;
+    const uint64_t edgeBatchSize = 10000;
+
     // Vector to count, for each edge, how many times
     // the two vertices belong to the same cluster.
     vector<uint64_t> isSameClusterEdge(readGraph.edges.size(), 0);
@@ -1459,24 +1881,41 @@ void Assembler::readGraphClustering()
         readGraph.clustering(randomSource, cluster, debug);
 
         // Increment isSameClusterEdge counters for each edge.
-        for(uint64_t edgeId=0; edgeId<readGraph.edges.size(); edgeId++) {
-            const ReadGraphEdge& edge = readGraph.edges[edgeId];
-            const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
-            const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
-            const ReadId cluster0 = cluster[orientedReadId0.getValue()];
-            const ReadId cluster1 = cluster[orientedReadId1.getValue()];
-            if(cluster0 == cluster1) {
-                ++isSameClusterEdge[edgeId];
-            }
-        }
+        // Each edge has its own counter, so the edges can be processed in parallel.
+        parallelFor(readGraph.edges.size(), edgeBatchSize, threadCount,
+            [&](uint64_t begin, uint64_t end)
+            {
+                for(uint64_t edgeId=begin; edgeId!=end; ++edgeId) {
+                    const ReadGraphEdge& edge = readGraph.edges[edgeId];
+                    const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
+                    const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
+                    const ReadId cluster0 = cluster[orientedReadId0.getValue()];
+                    const ReadId cluster1 = cluster[orientedReadId1.getValue()];
+                    if(cluster0 == cluster1) {
+                        ++isSameClusterEdge[edgeId];
+                    }
+                }
+            });
     }
 
 
     // Histogram isSameClusterEdge.
-    vector<uint64_t> histogram(iterationCount, 0);
-    for(uint64_t edgeId=0; edgeId<readGraph.edges.size(); edgeId++) {
-        histogram[isSameClusterEdge[edgeId]]++;
-    }
+    // A counter can be equal to iterationCount, so the histogram
+    // needs iterationCount + 1 entries.
+    const vector<uint64_t> histogram = parallelReduce(readGraph.edges.size(), edgeBatchSize, threadCount,
+        vector<uint64_t>(iterationCount + 1, 0),
+        [&](vector<uint64_t>& h, uint64_t begin, uint64_t end)
+        {
+            for(uint64_t edgeId=begin; edgeId!=end; ++edgeId) {
+                h[isSameClusterEdge[edgeId]]++;
+            }
+        },
+        [](vector<uint64_t>& x, const vector<uint64_t>& y)
+        {
+            for(uint64_t i=0; i<x.size(); i++) {
+                x[i] += y[i];
+            }
+        });
     ofstream csv("Histogram.csv");
     for(uint64_t i=0; i<histogram.size(); i++) {
         csv << i << "," << histogram[i] << "\n";
@@ -1599,7 +2038,7 @@ void Assembler::leastSquareAnalysis(
         const uint64_t globalEdgeId = graph[e].globalEdgeId;
         const ReadGraphEdge& globalEdge = readGraph.edges[globalEdgeId];
         const uint64_t alignmentId = globalEdge.alignmentId;
-        const AlignmentInfo alignmentInfo = alignmentData[alignmentId].orient(orientedReadId0, orientedReadId1);
+        const AlignmentInfo alignmentInfo = getAlignmentData(alignmentId).orient(orientedReadId0, orientedReadId1);
 
         // Get the offset.
         const double offset = - alignmentInfo.averageOrdinalOffset;
@@ -1767,7 +2206,7 @@ void Assembler::triangleAnalysis(
             const uint64_t globalEdgeId01 = graph[e01].globalEdgeId;
             const ReadGraphEdge& globalEdge01 = readGraph.edges[globalEdgeId01];
             const uint64_t alignmentId01 = globalEdge01.alignmentId;
-            const AlignmentInfo alignmentInfo01 = alignmentData[alignmentId01].orient(orientedReadId0, orientedReadId1);
+            const AlignmentInfo alignmentInfo01 = getAlignmentData(alignmentId01).orient(orientedReadId0, orientedReadId1);
             const int32_t offset01 = - alignmentInfo01.averageOrdinalOffset;
 
             BGL_FORALL_OUTEDGES(v1, e12, graph, LocalReadGraph) {
@@ -1781,7 +2220,7 @@ void Assembler::triangleAnalysis(
                 const uint64_t globalEdgeId12 = graph[e12].globalEdgeId;
                 const ReadGraphEdge& globalEdge12 = readGraph.edges[globalEdgeId12];
                 const uint64_t alignmentId12 = globalEdge12.alignmentId;
-                const AlignmentInfo alignmentInfo12 = alignmentData[alignmentId12].orient(orientedReadId1, orientedReadId2);
+                const AlignmentInfo alignmentInfo12 = getAlignmentData(alignmentId12).orient(orientedReadId1, orientedReadId2);
                 const int32_t offset12 = - alignmentInfo12.averageOrdinalOffset;
 
                 // Get the offset of orientedReadId2 relative to orientedReadId0.
@@ -1797,7 +2236,7 @@ void Assembler::triangleAnalysis(
                     const uint64_t globalEdgeId23 = graph[e23].globalEdgeId;
                     const ReadGraphEdge& globalEdge23 = readGraph.edges[globalEdgeId23];
                     const uint64_t alignmentId23 = globalEdge23.alignmentId;
-                    const AlignmentInfo alignmentInfo23 = alignmentData[alignmentId23].orient(orientedReadId2, orientedReadId0);
+                    const AlignmentInfo alignmentInfo23 = getAlignmentData(alignmentId23).orient(orientedReadId2, orientedReadId0);
                     const int32_t offset23 = - alignmentInfo23.averageOrdinalOffset;
 
                     // Since v3 is the same as v0, the total offset should be zero.
@@ -1852,6 +2291,9 @@ void Assembler::flagInconsistentAlignments(
     setupLoadBalancing(readGraph.edges.size(), 1000);
     runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction1, threadCount);
 
+    // Create the sorted forward neighbor lists used to find triangles.
+    flagInconsistentAlignmentsCreateForwardLists(threadCount);
+
     // Loop over triangles in the read graph.
     flagInconsistentAlignmentsData.threadEdgeIds.clear();
     flagInconsistentAlignmentsData.threadEdgeIds.resize(threadCount);
@@ -1859,8 +2301,14 @@ void Assembler::flagInconsistentAlignments(
     setupLoadBalancing(readCount, 100);
     runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction2, threadCount);
 
-    // We no longer need the offsets.
+    // We no longer need the offsets and the forward lists.
     flagInconsistentAlignmentsData.edgeOffset.remove();
+    flagInconsistentAlignmentsData.forwardBegin.clear();
+    flagInconsistentAlignmentsData.forwardBegin.shrink_to_fit();
+    flagInconsistentAlignmentsData.forwardNeighbors.clear();
+    flagInconsistentAlignmentsData.forwardNeighbors.shrink_to_fit();
+    flagInconsistentAlignmentsData.forwardEdgeIds.clear();
+    flagInconsistentAlignmentsData.forwardEdgeIds.shrink_to_fit();
 
     // Gather the inconsistent edge ids found by all threads.
     vector<uint64_t> edgeIds;
@@ -1877,7 +2325,7 @@ void Assembler::flagInconsistentAlignments(
     for(const uint64_t edgeId: edgeIds) {
         ReadGraphEdge& edge = readGraph.edges[edgeId];
         edge.hasInconsistentAlignment = 1;
-        alignmentData[edge.alignmentId].info.isInReadGraph = 0;
+        alignmentData[edge.alignmentId].isInReadGraph = 0;
         cout << edge.orientedReadIds[0] << " " <<
             edge.orientedReadIds[1] << " " << edge.alignmentId << endl;
     }
@@ -1903,8 +2351,7 @@ void Assembler::flagInconsistentAlignmentsThreadFunction1(size_t threadId)
             SHASTA_ASSERT(orientedReadIds[0] < orientedReadIds[1]);
 
             // Orient the alignment accordingly.
-            const AlignmentData& ad = alignmentData[edge.alignmentId];
-            const AlignmentInfo alignmentInfo = ad.orient(orientedReadIds[0], orientedReadIds[1]);
+            const AlignmentInfo alignmentInfo = getAlignmentData(edge.alignmentId).orient(orientedReadIds[0], orientedReadIds[1]);
 
             // Store the offset.
             flagInconsistentAlignmentsData.edgeOffset[edgeId] = alignmentInfo.averageOrdinalOffset;
@@ -1915,15 +2362,96 @@ void Assembler::flagInconsistentAlignmentsThreadFunction1(size_t threadId)
 
 
 
+// For each oriented read v, store the neighbors u>v, sorted by u,
+// and the corresponding edge ids, excluding edges that cross strands
+// or are already flagged as inconsistent, and edges involving chimeric reads.
+// This uses a ReadGraphCsr to avoid accessing the ReadGraphEdge objects.
+void Assembler::flagInconsistentAlignmentsCreateForwardLists(size_t threadCount)
+{
+    auto& data = flagInconsistentAlignmentsData;
+    const ReadGraphCsr csr(readGraph, true, threadCount);
+    const uint64_t n = csr.vertexCount();
+    const uint64_t batchSize = 10000;
+
+    // Return true if the i-th neighbor of v goes in the forward list of v.
+    auto isForward = [&](
+        OrientedReadId v,
+        span<const OrientedReadId> neighbors,
+        span<const uint8_t> flags,
+        uint64_t i)
+    {
+        const OrientedReadId u = neighbors[i];
+        return
+            (v < u) and
+            not (flags[i] & ReadGraphCsr::hasInconsistentAlignmentFlag) and
+            not reads->getFlags(v.getReadId()).isChimeric and
+            not reads->getFlags(u.getReadId()).isChimeric;
+    };
+
+    // Pass 1: count.
+    data.forwardBegin.resize(n + 1);
+    data.forwardBegin[0] = 0;
+    parallelFor(n, batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; ++i) {
+                const OrientedReadId v = OrientedReadId::fromValue(ReadId(i));
+                const auto neighbors = csr[v];
+                const auto flags = csr.getFlags(v);
+                uint64_t count = 0;
+                for(uint64_t j=0; j<neighbors.size(); j++) {
+                    if(isForward(v, neighbors, flags, j)) {
+                        ++count;
+                    }
+                }
+                data.forwardBegin[i + 1] = count;
+            }
+        });
+    for(uint64_t i=0; i<n; i++) {
+        data.forwardBegin[i + 1] += data.forwardBegin[i];
+    }
+
+    // Pass 2: store and sort by neighbor.
+    data.forwardNeighbors.resize(data.forwardBegin.back());
+    data.forwardEdgeIds.resize(data.forwardBegin.back());
+    parallelFor(n, batchSize, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            vector< pair<uint32_t, uint32_t> > forward;
+            for(uint64_t i=begin; i!=end; ++i) {
+                const OrientedReadId v = OrientedReadId::fromValue(ReadId(i));
+                const auto neighbors = csr[v];
+                const auto flags = csr.getFlags(v);
+                const auto edgeIds = csr.getEdgeIds(v);
+                forward.clear();
+                for(uint64_t j=0; j<neighbors.size(); j++) {
+                    if(isForward(v, neighbors, flags, j)) {
+                        forward.push_back({neighbors[j].getValue(), edgeIds[j]});
+                    }
+                }
+                sort(forward.begin(), forward.end());
+                uint64_t k = data.forwardBegin[i];
+                for(const auto& p: forward) {
+                    data.forwardNeighbors[k] = p.first;
+                    data.forwardEdgeIds[k] = p.second;
+                    ++k;
+                }
+            }
+        });
+}
+
+
+
 // Here we loop over triangles.
 // We only consider triangles with oriented read ids 012 where:
 // - orientedReadId0 is on strand 0.
 // - orientedReadId0<orientedReadId1<orientedReadId2.
 // This way each pair of reverse complemented triangles gets looked at exactly once.
-// This code is written with a triple loop for each start vertex,
-// but could be made faster if necessary.
-// In the triple loop, we exclude vertices corresponding to chimeric reads
-// and edges marked as cross-strand edges.
+// For each orientedReadId1 in the forward list of orientedReadId0,
+// the possible orientedReadId2 are the intersection of the forward lists
+// of orientedReadId0 and orientedReadId1.
+// Vertices corresponding to chimeric reads and edges marked as cross-strand
+// or inconsistent are not in the forward lists.
 
 void Assembler::flagInconsistentAlignmentsThreadFunction2(size_t threadId)
 {
@@ -1941,6 +2469,17 @@ void Assembler::flagInconsistentAlignmentsThreadFunction2(size_t threadId)
     const uint64_t leastSquareMaxDistance = flagInconsistentAlignmentsData.leastSquareMaxDistance;
     vector<uint64_t>& inconsistentEdgeIds = flagInconsistentAlignmentsData.threadEdgeIds[threadId];
 
+    // Vectors used below for each pair orientedReadId0, orientedReadId1.
+    vector< pair<uint32_t, uint32_t> > intersection;
+    class Triangle {
+    public:
+        ReadId orientedReadId2;
+        int32_t offset12;
+        int32_t offset20;
+        int32_t offsetError;
+    };
+    vector<Triangle> triangles;
+
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -1952,136 +2491,114 @@ void Assembler::flagInconsistentAlignmentsThreadFunction2(size_t threadId)
             }
             const OrientedReadId orientedReadId0(readId0, 0);
 
-            // Loop over edges of orientedReadId0.
-            const span<uint32_t> edgeIds0 = readGraph.connectivity[orientedReadId0.getValue()];
-            for(uint32_t edgeId01: edgeIds0){
-                const ReadGraphEdge edge01 = readGraph.edges[edgeId01];
-                const OrientedReadId orientedReadId1 = edge01.getOther(orientedReadId0);
-                if(orientedReadId1 < orientedReadId0) {
-                    continue;
-                }
-                if(reads->getFlags(orientedReadId1.getReadId()).isChimeric) {
-                    continue;
-                }
-                if(edge01.crossesStrands) {
-                    continue;
-                }
-                if(edge01.hasInconsistentAlignment) {
-                    continue;
-                }
+            // Get the forward list of orientedReadId0.
+            const span<const uint32_t> neighbors0 =
+                flagInconsistentAlignmentsData.getForwardNeighbors(orientedReadId0.getValue());
+            const span<const uint32_t> edgeIds0 =
+                flagInconsistentAlignmentsData.getForwardEdgeIds(orientedReadId0.getValue());
+
+            // Loop over the forward list of orientedReadId0.
+            for(uint64_t i1=0; i1<neighbors0.size(); i1++) {
+                const OrientedReadId orientedReadId1 = OrientedReadId::fromValue(neighbors0[i1]);
+                const uint32_t edgeId01 = edgeIds0[i1];
                 const int32_t offset01 = flagInconsistentAlignmentsData.edgeOffset[edgeId01];
 
-                // Loop over edges of orientedReadId1.
-                const span<uint32_t> edgeIds1 = readGraph.connectivity[orientedReadId1.getValue()];
-                for(uint32_t edgeId12: edgeIds1){
-                    const ReadGraphEdge edge12 = readGraph.edges[edgeId12];
-                    const OrientedReadId orientedReadId2 = edge12.getOther(orientedReadId1);
-                    if(orientedReadId2 < orientedReadId1) {
-                        continue;
-                    }
-                    if(reads->getFlags(orientedReadId2.getReadId()).isChimeric) {
-                        continue;
-                    }
-                    if(edge12.crossesStrands) {
-                        continue;
-                    }
-                    if(edge12.hasInconsistentAlignment) {
-                        continue;
-                    }
+                // Find the triangles containing orientedReadId0 and orientedReadId1.
+                const span<const uint32_t> neighbors1 =
+                    flagInconsistentAlignmentsData.getForwardNeighbors(orientedReadId1.getValue());
+                const span<const uint32_t> edgeIds1 =
+                    flagInconsistentAlignmentsData.getForwardEdgeIds(orientedReadId1.getValue());
+                sortedIntersection(neighbors0, neighbors1, intersection);
+
+                // Compute the offset errors of these triangles.
+                triangles.clear();
+                for(const auto& p: intersection) {
+                    const uint32_t edgeId02 = edgeIds0[p.first];
+                    const uint32_t edgeId12 = edgeIds1[p.second];
                     const int32_t offset12 = flagInconsistentAlignmentsData.edgeOffset[edgeId12];
-                    const int32_t offset02 = offset01 + offset12;
-
-                    // Loop over edges of orientedReadId2.
-                    const span<uint32_t> edgeIds2 = readGraph.connectivity[orientedReadId2.getValue()];
-                    for(uint32_t edgeId20: edgeIds2){
-                        const ReadGraphEdge edge20 = readGraph.edges[edgeId20];
-                        if(edge20.crossesStrands) {
-                            continue;
-                        }
-                        if(edge20.hasInconsistentAlignment) {
-                            continue;
-                        }
-                        if(edge20.getOther(orientedReadId2) != orientedReadId0) {
-                            continue;
-                        }
+                    const int32_t offset20 = -flagInconsistentAlignmentsData.edgeOffset[edgeId02];
+                    const int32_t offsetError = offset01 + offset12 + offset20;
 
-                        // We found a triangle.
-                        const int32_t offset20 = -flagInconsistentAlignmentsData.edgeOffset[edgeId20];
-                        const int32_t offsetError = offset02 + offset20;
+                    // If the error is small, don't do anything.
+                    if(abs(offsetError) >= triangleErrorThreshold) {
+                        triangles.push_back({neighbors0[p.first], offset12, offset20, offsetError});
+                    }
+                }
 
-                        // If the error is small, don't do anything.
-                        if(abs(offsetError) < triangleErrorThreshold) {
-                            continue;
-                        }
+                // Process the triangles with large offset errors.
+                for(const Triangle& triangle: triangles) {
+                    const OrientedReadId orientedReadId2 = OrientedReadId::fromValue(triangle.orientedReadId2);
+                    const int32_t offset12 = triangle.offset12;
+                    const int32_t offset20 = triangle.offset20;
+                    const int32_t offsetError = triangle.offsetError;
+
+                    if(debug) {
+                        out << "Working on triangle ";
+                        out << orientedReadId0 << " ";
+                        out << orientedReadId1 << " ";
+                        out << orientedReadId2 << " ";
+                        out << offset01 << " ";
+                        out << offset12 << " ";
+                        out << offset20 << " ";
+                        out << offsetError << "\n";
+                    }
 
+                    // Construct a local read graph around this triangle.
+                    LocalReadGraph graph;
+                    const vector<OrientedReadId> orientedReadIds =
+                        {orientedReadId0, orientedReadId1, orientedReadId2};
+                    createLocalReadGraph(orientedReadIds,
+                        uint32_t(leastSquareMaxDistance), false, false, false, 0., graph);
+
+                    // Iterate, removing one edge at a time
+                    // until all residuals are small.
+                    while(true) {
+
+                        // Perform least square analysis.
+                        vector<double> singularValues;
+                        leastSquareAnalysis(graph, singularValues);
+
+                        // Find the edge with the worst residual absolute value.
+                        double maxResidual = -1.;
+                        LocalReadGraph::edge_iterator it, end, itWorst;
+                        tie(it, end) = edges(graph);
+                        for(; it!=end; ++it) {
+                            const edge_descriptor e = *it;
+                            const vertex_descriptor v0 = source(e, graph);
+                            const vertex_descriptor v1 = target(e, graph);
+                            const double x0 = graph[v0].leastSquarePosition;
+                            const double x1 = graph[v1].leastSquarePosition;
+                            const double residual = abs((x1 - x0) - graph[e].averageAlignmentOffset);
+                            if(residual > maxResidual) {
+                                maxResidual = residual;
+                                itWorst = it;
+                            }
+                        }
+                        const edge_descriptor eWorst = *itWorst;
+                        const uint64_t globalEdgeId = graph[eWorst].globalEdgeId;
                         if(debug) {
-                            out << "Working on triangle ";
-                            out << orientedReadId0 << " ";
-                            out << orientedReadId1 << " ";
-                            out << orientedReadId2 << " ";
-                            out << offset01 << " ";
-                            out << offset12 << " ";
-                            out << offset20 << " ";
-                            out << offsetError << "\n";
+                             out << "Edge with worst residual " <<
+                                graph[source(eWorst, graph)].orientedReadId << " " <<
+                                graph[target(eWorst, graph)].orientedReadId << " " << maxResidual << endl;
                         }
 
-                        // Construct a local read graph around this triangle.
-                        LocalReadGraph graph;
-                        const vector<OrientedReadId> orientedReadIds =
-                            {orientedReadId0, orientedReadId1, orientedReadId2};
-                        createLocalReadGraph(orientedReadIds,
-                            uint32_t(leastSquareMaxDistance), false, false, false, 0., graph);
-
-                        // Iterate, removing one edge at a time
-                        // until all residuals are small.
-                        while(true) {
-
-                            // Perform least square analysis.
-                            vector<double> singularValues;
-                            leastSquareAnalysis(graph, singularValues);
-
-                            // Find the edge with the worst residual absolute value.
-                            double maxResidual = -1.;
-                            LocalReadGraph::edge_iterator it, end, itWorst;
-                            tie(it, end) = edges(graph);
-                            for(; it!=end; ++it) {
-                                const edge_descriptor e = *it;
-                                const vertex_descriptor v0 = source(e, graph);
-                                const vertex_descriptor v1 = target(e, graph);
-                                const double x0 = graph[v0].leastSquarePosition;
-                                const double x1 = graph[v1].leastSquarePosition;
-                                const double residual = abs((x1 - x0) - graph[e].averageAlignmentOffset);
-                                if(residual > maxResidual) {
-                                    maxResidual = residual;
-                                    itWorst = it;
-                                }
-                            }
-                            const edge_descriptor eWorst = *itWorst;
-                            const uint64_t globalEdgeId = graph[eWorst].globalEdgeId;
-                            if(debug) {
-                                 out << "Edge with worst residual " <<
-                                    graph[source(eWorst, graph)].orientedReadId << " " <<
-                                    graph[target(eWorst, graph)].orientedReadId << " " << maxResidual << endl;
-                            }
+                        // If the residual is small, end the iteration.
+                        if(maxResidual < leastSquareErrorThreshold) {
+                            break;
+                        }
 
-                            // If the residual is small, end the iteration.
-                            if(maxResidual < leastSquareErrorThreshold) {
-                                break;
+                        // Remove the edge with the worst residual and its
+                        // reverse complement.
+                        inconsistentEdgeIds.push_back(globalEdgeId);
+                        inconsistentEdgeIds.push_back(readGraph.getReverseComplementEdgeId(globalEdgeId));
+                        if(debug) {
+                            const ReadGraphEdge& globalEdge = readGraph.edges[globalEdgeId];
+                            const CompactAlignmentData& ad = alignmentData[globalEdge.alignmentId];
+                            out << "Alignment " << globalEdge.alignmentId << " " <<
+                                ad.readIds[0] << " " << ad.readIds[1] << " " << int(ad.isSameStrand) <<
+                                " flagged as inconsistent." << endl;
                             }
-
-                            // Remove the edge with the worst residual and its
-                            // reverse complement.
-                            inconsistentEdgeIds.push_back(globalEdgeId);
-                            inconsistentEdgeIds.push_back(readGraph.getReverseComplementEdgeId(globalEdgeId));
-                            if(debug) {
-                                const ReadGraphEdge& globalEdge = readGraph.edges[globalEdgeId];
-                                const AlignmentData& ad = alignmentData[globalEdge.alignmentId];
-                                out << "Alignment " << globalEdge.alignmentId << " " <<
-                                    ad.readIds[0] << " " << ad.readIds[1] << " " << int(ad.isSameStrand) <<
-                                    " flagged as inconsistent." << endl;
-                                }
-                            remove_edge(eWorst, graph);
-                        }
+                        remove_edge(eWorst, graph);
                     }
                 }
             }
@@ -120,25 +120,32 @@ void Assembler::setReadGraph2Criteria(
                 << "trim" << '\n';
     }
 
+    // Make sure the columnar alignment statistics are available.
+    if(not alignmentStatistics.isOpen() or alignmentStatistics.size() != alignmentData.size()) {
+        computeAlignmentStatistics(0);
+    }
+
     // Sample all available alignments that pass the initial permissive criteria
-    for (size_t i=0; i<alignmentData.size(); i++){
-        const auto info = alignmentData[i].info;
-        const auto trims = info.computeTrim();
-        const auto trim = max(trims.first, trims.second);
-
-        alignedFractionHistogram.update(info.minAlignedFraction());
-        markerCountHistogram.update(info.markerCount);
-        maxDriftHistogram.update(info.maxDrift);
-        maxSkipHistogram.update(info.maxSkip);
+    for (size_t i=0; i<alignmentStatistics.size(); i++){
+        const double minAlignedFraction = alignmentStatistics.minAlignedFraction[i];
+        const uint32_t markerCount = alignmentStatistics.markerCount[i];
+        const uint32_t maxDrift = alignmentStatistics.maxDrift[i];
+        const uint32_t maxSkip = alignmentStatistics.maxSkip[i];
+        const uint32_t trim = alignmentStatistics.maxTrim[i];
+
+        alignedFractionHistogram.update(minAlignedFraction);
+        markerCountHistogram.update(markerCount);
+        maxDriftHistogram.update(maxDrift);
+        maxSkipHistogram.update(maxSkip);
         maxTrimHistogram.update(trim);
 
         if (debug) {
             alignmentInfoCsv << alignmentData[i].readIds[0] << ','
                              << alignmentData[i].readIds[1] << ','
-                             << info.minAlignedFraction() << ','
-                             << info.markerCount << ','
-                             << info.maxDrift << ','
-                             << info.maxSkip << ','
+                             << minAlignedFraction << ','
+                             << markerCount << ','
+                             << maxDrift << ','
+                             << maxSkip << ','
                              << trim << '\n';
         }
     }
@@ -185,8 +192,12 @@ void Assembler::createReadGraph2(
     double alignedFractionPercentile,
     double maxSkipPercentile,
     double maxDriftPercentile,
-    double maxTrimPercentile)
+    double maxTrimPercentile,
+    size_t threadCount)
 {
+    // Store the alignment quality indicators in columnar form.
+    computeAlignmentStatistics(threadCount);
+
     // First find thresholds based on the observed
     // distribution of alignment quality indicators
     setReadGraph2Criteria(
@@ -196,53 +207,46 @@ void Assembler::createReadGraph2(
             maxDriftPercentile,
             maxTrimPercentile);
 
-    vector<bool> keepAlignment(alignmentData.size(), false);
+    // Select the alignments to be kept, among those that pass the thresholds.
+    vector<bool> keepAlignment;
+    selectReadGraphAlignments(maxAlignmentCount, true, threadCount, keepAlignment);
+    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
+    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
 
-    // Find the number of reads and oriented reads.
-    const ReadId orientedReadCount = uint32_t(markers.size());
-    SHASTA_ASSERT((orientedReadCount % 2) == 0);
-    const ReadId readCount = orientedReadCount / 2;
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
+}
 
-    // Vector to keep the alignments for each read,
-    // with their number of markers.
-    // Contains pairs(marker count, alignment id).
-    vector< pair<uint32_t, uint32_t> > readAlignments;
 
-    // Loop over reads.
-    for(ReadId readId=0; readId<readCount; readId++) {
 
-        // Gather the alignments for this read, each with its number of markers.
-        readAlignments.clear();
-        for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
-            const AlignmentInfo& info = alignmentData[alignmentId].info;
+// Store the alignment quality indicators used by
+// passesReadGraph2Criteria in columnar form.
+void Assembler::computeAlignmentStatistics(size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
 
-            // Discard each alignment if it does not pass the chosen thresholds
-            if(not passesReadGraph2Criteria(info)){
-                continue;
-            }
+    alignmentStatistics.createNew(largeDataName("AlignmentStatistics"),
+        largeDataPageSize, alignmentData.size());
+    setupLoadBalancing(alignmentData.size(), 100000);
+    runThreads(&Assembler::computeAlignmentStatisticsThreadFunction, threadCount);
+}
 
-            // Otherwise add it to the list of candidate alignments for this read (to be ranked)
-            readAlignments.push_back(make_pair(info.markerCount, alignmentId));
-        }
 
-        // Keep the best maxAlignmentCount.
-        if(readAlignments.size() > maxAlignmentCount) {
-            std::nth_element(
-                    readAlignments.begin(),
-                    readAlignments.begin() + maxAlignmentCount,
-                    readAlignments.end(),
-                    std::greater< pair<uint32_t, uint32_t> >());
-            readAlignments.resize(maxAlignmentCount);
-        }
 
-        // Mark the surviving alignments as to be kept.
-        for(const auto& p: readAlignments) {
-            const uint32_t alignmentId = p.second;
-            keepAlignment[alignmentId] = true;
+void Assembler::computeAlignmentStatisticsThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const AlignmentInfo& info = alignmentInfos[i];
+            const auto trims = info.computeTrim();
+            alignmentStatistics.minAlignedFraction[i] = info.minAlignedFraction();
+            alignmentStatistics.markerCount[i] = info.markerCount;
+            alignmentStatistics.maxDrift[i] = info.maxDrift;
+            alignmentStatistics.maxSkip[i] = info.maxSkip;
+            alignmentStatistics.maxTrim[i] = max(trims.first, trims.second);
         }
     }
-    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
-    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
-
-    createReadGraphUsingSelectedAlignments(keepAlignment);
 }
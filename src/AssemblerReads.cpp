@@ -2,39 +2,79 @@
 #include "Assembler.hpp"
 #include "performanceLog.hpp"
 #include "ReadLoader.hpp"
+#include "Reads.hpp"
+#include "ReadSequenceIndex.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 
 // Standard libraries.
 #include "algorithm.hpp"
 #include "iterator.hpp"
+#include <filesystem>
+#include <thread>
 
 
 // Add reads.
 // The reads are added to those already previously present.
+// All files are processed by a single ReadLoader, which
+// keeps its threads busy across file boundaries.
 void Assembler::addReads(
-    const string& fileName,
+    const vector<string>& fileNames,
     uint64_t minReadLength,
+    uint64_t desiredCoverage,
     bool noCache,
-    const size_t threadCount)
+    uint64_t streamingChunkSize,
+    const size_t threadCount,
+    bool findMarkersWhileLoading)
 {
     reads->checkReadsAreOpen();
     reads->checkReadNamesAreOpen();
 
+    // If requested, find the markers of each read while the reads are loaded.
+    // This requires the KmerChecker to already exist, and to not depend on the reads.
+    if(findMarkersWhileLoading) {
+        if(not kmerChecker) {
+            throw runtime_error("Finding markers while loading reads requires a KmerChecker.");
+        }
+        if(reads->readCount() != 0) {
+            throw runtime_error("Finding markers while loading reads "
+                "is only possible if no reads are present.");
+        }
+        pipelinedMarkerPositions.createNew(
+            largeDataName("tmp-PipelinedMarkerPositions"), largeDataPageSize);
+    }
+
     ReadLoader readLoader(
-        fileName,
+        fileNames,
         assemblerInfo->readRepresentation,
         minReadLength,
+        desiredCoverage,
         noCache,
+        streamingChunkSize,
         threadCount,
         largeDataFileNamePrefix,
         largeDataPageSize,
-        *reads);
+        *reads,
+        findMarkersWhileLoading ? kmerChecker.get() : 0,
+        assemblerInfo->k,
+        findMarkersWhileLoading ? &pipelinedMarkerPositions : 0);
 
     reads->checkSanity();
     reads->computeReadLengthHistogram();
 
-    cout << "Discarded read statistics for file " << fileName << ":" << endl;
+    // If a length scan was done, write out the read length histogram
+    // it computed using the original minReadLength.
+    if(desiredCoverage) {
+        Reads::writeReadLengthHistogram(readLoader.lengthScanHistogram,
+            "ExtendedReadLengthHistogram.csv");
+        minReadLength = readLoader.getMinReadLength();
+    }
+
+    if(fileNames.size() == 1) {
+        cout << "Discarded read statistics for file " << fileNames.front() << ":" << endl;
+    } else {
+        cout << "Discarded read statistics for " << fileNames.size() << " input files:" << endl;
+    }
     cout << "    Discarded " << readLoader.discardedInvalidBaseReadCount <<
         " reads containing invalid bases for a total " <<
         readLoader.discardedInvalidBaseBaseCount << " valid bases." << endl;
@@ -44,6 +84,11 @@ void Assembler::addReads(
     cout << "    Discarded " << readLoader.discardedBadRepeatCountReadCount <<
         " reads containing repeat counts 256 or more" <<
         " for a total " << readLoader.discardedBadRepeatCountBaseCount << " bases." << endl;
+    if(readLoader.splitReadCount) {
+        cout << "Split " << readLoader.splitReadCount << " reads longer than " <<
+            CompressedMarker::maxReadLength << " stored bases into " <<
+            readLoader.splitReadPieceCount << " pieces." << endl;
+    }
 
     // Increment the discarded reads statistics.
     assemblerInfo->discardedInvalidBaseReadCount += readLoader.discardedInvalidBaseReadCount;
@@ -56,6 +101,150 @@ void Assembler::addReads(
 }
 
 
+
+// Create a read store in the specified directory,
+// which must not exist, using reads from the specified files.
+// The read store is always created in the filesystem,
+// using 4K pages, and can be reused by any number of assemblies.
+void Assembler::createReadStore(
+    const vector<string>& fileNames,
+    const string& readStoreDirectory,
+    uint64_t readRepresentation,
+    uint64_t minReadLength,
+    bool noCache,
+    uint64_t streamingChunkSize,
+    size_t threadCount)
+{
+    if(std::filesystem::exists(readStoreDirectory)) {
+        throw runtime_error("Read store directory " + readStoreDirectory +
+            " already exists.");
+    }
+    SHASTA_ASSERT(std::filesystem::create_directory(readStoreDirectory));
+    const string prefix = readStoreDirectory + "/";
+    const size_t pageSize = 4096;
+
+    Reads reads;
+    reads.createNew(
+        readRepresentation,
+        prefix + "Reads",
+        prefix + "ReadNames",
+        prefix + "ReadMetaData",
+        prefix + "ReadRepeatCounts",
+        prefix + "ReadFlags",
+        prefix + "ReadIdsSortedByName",
+        pageSize);
+
+    ReadLoader readLoader(
+        fileNames,
+        readRepresentation,
+        minReadLength,
+        0,
+        noCache,
+        streamingChunkSize,
+        threadCount,
+        prefix,
+        pageSize,
+        reads);
+    reads.checkSanity();
+    reads.computeReadLengthHistogram();
+
+    MemoryMapped::Object<ReadStoreInfo> info;
+    info.createNew(prefix + "Info", pageSize);
+    info->formatVersion = ReadStoreInfo::currentFormatVersion;
+    info->readRepresentation = readRepresentation;
+    info->minReadLength = minReadLength;
+    info->readCount = reads.readCount();
+    info->baseCount = reads.getTotalBaseCount();
+    info->discardedInvalidBaseReadCount = readLoader.discardedInvalidBaseReadCount;
+    info->discardedInvalidBaseBaseCount = readLoader.discardedInvalidBaseBaseCount;
+    info->discardedShortReadReadCount = readLoader.discardedShortReadReadCount;
+    info->discardedShortReadBaseCount = readLoader.discardedShortReadBaseCount;
+    info->discardedBadRepeatCountReadCount = readLoader.discardedBadRepeatCountReadCount;
+    info->discardedBadRepeatCountBaseCount = readLoader.discardedBadRepeatCountBaseCount;
+
+    cout << "Read store " << readStoreDirectory << " contains " <<
+        info->readCount << " reads for a total " << info->baseCount << " bases." << endl;
+}
+
+
+
+// Add reads from a read store previously created by createReadStore.
+// The read store is accessed read-only, and the reads
+// are copied to the binary data of this assembly
+// without parsing the original input files.
+void Assembler::addReadsFromStore(
+    const string& readStoreDirectory,
+    uint64_t minReadLength)
+{
+    const string prefix = readStoreDirectory + "/";
+    if(not std::filesystem::exists(prefix + "Info")) {
+        throw runtime_error(readStoreDirectory + " is not a valid read store.");
+    }
+    MemoryMapped::Object<ReadStoreInfo> info;
+    info.accessExistingReadOnly(prefix + "Info");
+
+    if(info->formatVersion != ReadStoreInfo::currentFormatVersion) {
+        throw runtime_error("Read store " + readStoreDirectory + " has format version " +
+            to_string(info->formatVersion) + " but this version of Shasta requires format version " +
+            to_string(ReadStoreInfo::currentFormatVersion) + ". Recreate the read store.");
+    }
+    if(info->readRepresentation != assemblerInfo->readRepresentation) {
+        throw runtime_error("Read store " + readStoreDirectory + " was created with "
+            "--Reads.representation " + to_string(info->readRepresentation) +
+            " but this assembly uses --Reads.representation " +
+            to_string(assemblerInfo->readRepresentation) + ".");
+    }
+    if(minReadLength < info->minReadLength) {
+        throw runtime_error("Read store " + readStoreDirectory + " was created with "
+            "--Reads.minReadLength " + to_string(info->minReadLength) +
+            " and cannot be used with a lower value " + to_string(minReadLength) + ".");
+    }
+
+    Reads storeReads;
+    storeReads.accessReadStore(
+        info->readRepresentation,
+        prefix + "Reads",
+        prefix + "ReadNames",
+        prefix + "ReadMetaData",
+        prefix + "ReadRepeatCounts");
+    SHASTA_ASSERT(storeReads.readCount() == info->readCount);
+
+    reads->checkReadsAreOpen();
+    reads->checkReadNamesAreOpen();
+    reads->copyDataForReadsLongerThan(
+        storeReads,
+        minReadLength,
+        assemblerInfo->discardedShortReadReadCount,
+        assemblerInfo->discardedShortReadBaseCount);
+    reads->checkSanity();
+    reads->computeReadLengthHistogram();
+
+    // Increment the discarded reads statistics with the
+    // ones from the creation of the read store.
+    assemblerInfo->discardedInvalidBaseReadCount += info->discardedInvalidBaseReadCount;
+    assemblerInfo->discardedInvalidBaseBaseCount += info->discardedInvalidBaseBaseCount;
+    assemblerInfo->discardedShortReadReadCount += info->discardedShortReadReadCount;
+    assemblerInfo->discardedShortReadBaseCount += info->discardedShortReadBaseCount;
+    assemblerInfo->discardedBadRepeatCountReadCount += info->discardedBadRepeatCountReadCount;
+    assemblerInfo->discardedBadRepeatCountBaseCount += info->discardedBadRepeatCountBaseCount;
+    assemblerInfo->minReadLength = minReadLength;
+
+    cout << "Used " << reads->readCount() << " of the " << info->readCount <<
+        " reads in read store " << readStoreDirectory << "." << endl;
+}
+
+void Assembler::compressReadRepeatCounts()
+{
+    reads->compressRepeatCounts(largeDataPageSize);
+}
+
+void Assembler::compressReadNames()
+{
+    reads->compressNames(largeDataPageSize);
+}
+
+
+
 // Create a histogram of read lengths.
 // All lengths here are raw sequence lengths
 // (length of the original read), not lengths
@@ -100,10 +289,17 @@ void Assembler::writeReadsSummary()
     SHASTA_ASSERT(markers.isOpen());
 
     // Count the number of alignment candidates for each read.
+    // If the alignment candidates were released by releaseDeadData,
+    // use the counts saved at that time.
     vector<uint64_t> alignmentCandidatesCount(reads->readCount(), 0);
-    for(const OrientedReadPair& p: alignmentCandidates.candidates) {
-        ++alignmentCandidatesCount[p.readIds[0]];
-        ++alignmentCandidatesCount[p.readIds[1]];
+    if(alignmentCandidates.candidates.isOpen) {
+        for(const OrientedReadPair& p: alignmentCandidates.candidates) {
+            ++alignmentCandidatesCount[p.readIds[0]];
+            ++alignmentCandidatesCount[p.readIds[1]];
+        }
+    } else if(releasedReadAlignmentCandidateCount.size() == reads->readCount()) {
+        std::copy(releasedReadAlignmentCandidateCount.begin(), releasedReadAlignmentCandidateCount.end(),
+            alignmentCandidatesCount.begin());
     }
 
 
@@ -227,32 +423,13 @@ void Assembler::writeReadsSummary()
 uint64_t Assembler::adjustCoverageAndGetNewMinReadLength(uint64_t desiredCoverage) {
     cout << timestamp << "Adjusting for desired coverage." << endl;
     cout << "Desired Coverage: " << desiredCoverage << endl;
-    uint64_t cumulativeBaseCount = reads->getTotalBaseCount();
 
-    assemblerInfo->minReadLength = 0ULL;
-
-    if (desiredCoverage > cumulativeBaseCount) {
+    assemblerInfo->minReadLength = Reads::computeMinReadLengthForCoverage(
+        reads->getReadLengthHistogram(), desiredCoverage);
+    if(assemblerInfo->minReadLength == 0) {
         return assemblerInfo->minReadLength;
     }
 
-    const auto& histogram = reads->getReadLengthHistogram();
-    uint64_t lastLength = 0;
-
-    for (uint64_t length = 0; length < histogram.size(); length++) {
-        const uint64_t frequency = histogram[length];
-        if (frequency) {
-            const uint64_t baseCount = frequency * length;
-            if (cumulativeBaseCount > desiredCoverage) {
-                cumulativeBaseCount -= baseCount;
-                lastLength = length;
-                continue;
-            }
-
-            assemblerInfo->minReadLength = lastLength;
-            break;
-        }
-    }
-
     cout << "Setting minReadLength to " + to_string(assemblerInfo->minReadLength) +
         " to get desired coverage." << endl;
 
@@ -292,9 +469,34 @@ uint64_t Assembler::adjustCoverageAndGetNewMinReadLength(uint64_t desiredCoverag
 
 
 
-void Assembler::computeReadIdsSortedByName()
+void Assembler::computeReadIdsSortedByName(size_t threadCount)
+{
+    reads->computeReadIdsSortedByName(threadCount);
+}
+
+
+
+void Assembler::createReadSequenceIndex(uint64_t step, uint64_t threadCount)
 {
-    reads->computeReadIdsSortedByName();
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    readSequenceIndex = make_shared<ReadSequenceIndex>(getReads(), step, threadCount, *this);
+}
+
+
+
+bool Assembler::accessReadSequenceIndex()
+{
+    try {
+        readSequenceIndex = make_shared<ReadSequenceIndex>(getReads(), *this);
+        return true;
+    } catch(const exception&) {
+        readSequenceIndex = 0;
+        return false;
+    }
 }
 
 
@@ -303,7 +505,7 @@ void Assembler::computeReadIdsSortedByName()
 // Find duplicate reads, as determined by name (not sequence).
 // This also sets the isDuplicate and discardDueToDuplicates read flags
 // and summarizes what it found Duplicates.csv.
-void Assembler::findDuplicateReads(const string& handleDuplicates)
+void Assembler::findDuplicateReads(const string& handleDuplicates, size_t threadCount)
 {
-    reads->findDuplicates(handleDuplicates);
+    reads->findDuplicates(handleDuplicates, threadCount);
 }
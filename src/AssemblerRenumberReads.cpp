@@ -0,0 +1,424 @@
+// Optional renumbering of the reads at the end of the read graph stage.
+
+// ReadIds are initially assigned in the order in which the reads
+// appear in the input files, which has no relation to their
+// location in the genome. As a result, the per-read and per-oriented-read
+// data accessed while processing a region of the assembly
+// are scattered across memory.
+// Renumbering the reads in an order obtained from a BFS
+// of the read graph gives nearby ReadIds to reads that are
+// close in the read graph and therefore, normally, in the genome.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "compressAlignment.hpp"
+#include "copyPermuted.hpp"
+#include "parallelFor.hpp"
+#include "performanceLog.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <filesystem>
+#include <numeric>
+#include <queue>
+
+
+
+namespace shasta {
+    namespace {
+
+        // Permute the vectors of a VectorOfVectors, so that
+        // v[i] becomes the old v[oldIndexes[i]].
+        // The permuted copy goes to a temporary VectorOfVectors,
+        // then v is recreated with its original name and
+        // the permuted copy is copied back.
+        template<class T, class Int, class Index> void permuteVectorOfVectors(
+            MemoryMapped::VectorOfVectors<T, Int>& v,
+            const vector<Index>& oldIndexes,
+            const string& temporaryName,
+            size_t pageSize,
+            size_t threadCount)
+        {
+            MemoryMapped::VectorOfVectors<T, Int> w;
+            w.createNew(temporaryName, pageSize);
+            copyPermuted(v, w, oldIndexes, threadCount);
+
+            const string name = v.getName();
+            v.remove();
+            v.createNew(name, pageSize);
+            vector<uint64_t> identity(oldIndexes.size());
+            std::iota(identity.begin(), identity.end(), uint64_t(0));
+            copyPermuted(w, v, identity, threadCount);
+            w.remove();
+        }
+
+        // Make sure a MemoryMapped::Vector is open with write access.
+        // Binary data that were released (closed) by releaseDeadData
+        // but still exist on disk are opened again, so they can be
+        // updated and stay consistent with the new ReadIds.
+        // Returns true if the binary data were opened again.
+        // In that case, the caller should close them when done.
+        template<class T> bool accessForRenumbering(
+            MemoryMapped::Vector<T>& v,
+            const string& name)
+        {
+            if(v.isOpen) {
+                if(not v.isOpenWithWriteAccess) {
+                    const string fileName = v.fileName;
+                    v.close();
+                    v.accessExistingReadWrite(fileName);
+                }
+                return false;
+            }
+            if(name.empty() or not std::filesystem::exists(name)) {
+                return false;
+            }
+            v.accessExistingReadWrite(name);
+            return true;
+        }
+    }
+}
+
+
+
+void Assembler::renumberReads(size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    performanceLog << timestamp << "Read renumbering begins." << endl;
+    checkMarkersAreOpen();
+    checkAlignmentDataAreOpen();
+    checkReadGraphIsOpen();
+    if(markerGraph.vertexTable.isOpen) {
+        throw runtime_error("Reads cannot be renumbered after the marker graph is created.");
+    }
+    if(readSequenceIndex) {
+        throw runtime_error("Reads cannot be renumbered after the read sequence index is created.");
+    }
+    const ReadId readCount = reads->readCount();
+    const string temporaryName = largeDataName("tmp-RenumberReads");
+
+
+
+    // Compute the new order of the reads using a BFS of the read graph,
+    // starting from strand 0 of the lowest numbered read not yet reached.
+    // Edges that cross strands are not used, so each BFS covers
+    // one strand of a connected component of the read graph.
+    // Reads are numbered in the order in which the BFS reaches them,
+    // and isolated reads keep their relative order.
+    vector<ReadId> oldReadIds;
+    oldReadIds.reserve(readCount);
+    vector<bool> wasReached(readCount, false);
+    std::queue<OrientedReadId> q;
+    for(ReadId readId=0; readId<readCount; readId++) {
+        if(wasReached[readId]) {
+            continue;
+        }
+        wasReached[readId] = true;
+        q.push(OrientedReadId(readId, 0));
+        while(not q.empty()) {
+            const OrientedReadId orientedReadId0 = q.front();
+            q.pop();
+            oldReadIds.push_back(orientedReadId0.getReadId());
+            for(const uint32_t edgeId: readGraph.connectivity[orientedReadId0.getValue()]) {
+                const ReadGraphEdge& edge = readGraph.edges[edgeId];
+                if(edge.crossesStrands) {
+                    continue;
+                }
+                const OrientedReadId orientedReadId1 = edge.getOther(orientedReadId0);
+                if(not wasReached[orientedReadId1.getReadId()]) {
+                    wasReached[orientedReadId1.getReadId()] = true;
+                    q.push(orientedReadId1);
+                }
+            }
+        }
+    }
+    SHASTA_ASSERT(oldReadIds.size() == readCount);
+
+    // The inverse permutation.
+    vector<ReadId> newReadIds(readCount, invalidReadId);
+    for(ReadId newReadId=0; newReadId<readCount; newReadId++) {
+        newReadIds[oldReadIds[newReadId]] = newReadId;
+    }
+
+    // The same permutation, expressed in terms of OrientedReadId values.
+    vector<uint64_t> oldOrientedReadIds(2 * uint64_t(readCount));
+    for(ReadId newReadId=0; newReadId<readCount; newReadId++) {
+        for(Strand strand=0; strand<2; strand++) {
+            oldOrientedReadIds[OrientedReadId(newReadId, strand).getValue()] =
+                OrientedReadId(oldReadIds[newReadId], strand).getValue();
+        }
+    }
+    const auto newOrientedReadId = [&newReadIds](OrientedReadId orientedReadId)
+    {
+        return OrientedReadId(newReadIds[orientedReadId.getReadId()], orientedReadId.getStrand());
+    };
+
+
+
+    // Store the original ReadIds.
+    // If the reads were already renumbered, compose the permutations.
+    accessForRenumbering(originalReadIds, largeDataName("OriginalReadIds"));
+    {
+        vector<ReadId> newOriginalReadIds(readCount);
+        for(ReadId newReadId=0; newReadId<readCount; newReadId++) {
+            const ReadId oldReadId = oldReadIds[newReadId];
+            newOriginalReadIds[newReadId] =
+                originalReadIds.isOpen ? originalReadIds[oldReadId] : oldReadId;
+        }
+        if(not originalReadIds.isOpen) {
+            originalReadIds.createNew(largeDataName("OriginalReadIds"), largeDataPageSize);
+        }
+        originalReadIds.resize(readCount);
+        copy(newOriginalReadIds.begin(), newOriginalReadIds.end(), originalReadIds.begin());
+    }
+
+
+
+    // Reads. The read names are permuted together with the reads,
+    // so each read keeps its name.
+    performanceLog << timestamp << "Renumbering reads." << endl;
+    reads->rename();
+    unique_ptr<Reads> newReads = make_unique<Reads>();
+    newReads->createNew(
+        assemblerInfo->readRepresentation,
+        largeDataName("Reads"),
+        largeDataName("ReadNames"),
+        largeDataName("ReadMetaData"),
+        largeDataName("ReadRepeatCounts"),
+        largeDataName("ReadFlags"),
+        largeDataName("ReadIdsSortedByName"),
+        largeDataPageSize
+    );
+    newReads->copyPermutedData(getReads(), oldReadIds, newReadIds, largeDataPageSize, threadCount);
+    reads->remove();
+    reads = std::move(newReads);
+
+
+
+    // Markers, and the other binary data indexed by OrientedReadId
+    // that are not normally released by this point.
+    performanceLog << timestamp << "Renumbering markers." << endl;
+    permuteVectorOfVectors(markers, oldOrientedReadIds, temporaryName, largeDataPageSize, threadCount);
+    if(sortedMarkers.isOpen()) {
+        permuteVectorOfVectors(sortedMarkers, oldOrientedReadIds, temporaryName, largeDataPageSize, threadCount);
+    }
+    if(markerKmerIds.isOpen()) {
+        permuteVectorOfVectors(markerKmerIds, oldOrientedReadIds, temporaryName, largeDataPageSize, threadCount);
+    }
+    if(markerPositions.isOpen()) {
+        permuteVectorOfVectors(markerPositions, oldOrientedReadIds, temporaryName, largeDataPageSize, threadCount);
+    }
+
+
+
+    // Per-read data of the alignment candidates stage.
+    const bool readLowHashStatisticsWereReopened =
+        accessForRenumbering(readLowHashStatistics, largeDataName("ReadLowHashStatistics"));
+    if(readLowHashStatistics.isOpen) {
+        SHASTA_ASSERT(readLowHashStatistics.size() == readCount);
+        const vector< array<uint64_t, 3> > oldStatistics(
+            readLowHashStatistics.begin(), readLowHashStatistics.end());
+        for(ReadId newReadId=0; newReadId<readCount; newReadId++) {
+            readLowHashStatistics[newReadId] = oldStatistics[oldReadIds[newReadId]];
+        }
+        if(readLowHashStatisticsWereReopened) {
+            readLowHashStatistics.close();
+        }
+    }
+    if(releasedReadAlignmentCandidateCount.size() == readCount) {
+        const vector<uint32_t> oldCounts = releasedReadAlignmentCandidateCount;
+        for(ReadId newReadId=0; newReadId<readCount; newReadId++) {
+            releasedReadAlignmentCandidateCount[newReadId] = oldCounts[oldReadIds[newReadId]];
+        }
+    }
+
+
+
+    // Alignment candidates. They keep their order, so the candidate
+    // frequencies don't change, but the two reads of a candidate
+    // are swapped if needed, so that readIds[0] < readIds[1].
+    // The feature ordinals, if present, are removed
+    // because they would refer to the wrong orientation of swapped candidates.
+    // The candidate table is recomputed.
+    {
+        const bool candidatesWereReopened =
+            accessForRenumbering(alignmentCandidates.candidates, largeDataName("AlignmentCandidates"));
+        if(alignmentCandidates.candidates.isOpen) {
+            performanceLog << timestamp << "Renumbering alignment candidates." << endl;
+            parallelFor(alignmentCandidates.candidates.size(), 100000, threadCount,
+                [&](uint64_t begin, uint64_t end)
+                {
+                    for(uint64_t i=begin; i!=end; i++) {
+                        OrientedReadPair& candidate = alignmentCandidates.candidates[i];
+                        const ReadId readId0 = newReadIds[candidate.readIds[0]];
+                        const ReadId readId1 = newReadIds[candidate.readIds[1]];
+                        candidate.readIds = {min(readId0, readId1), max(readId0, readId1)};
+                    }
+                });
+
+            if(alignmentCandidates.featureOrdinals.isOpen()) {
+                alignmentCandidates.featureOrdinals.remove();
+            }
+
+            const string candidateTableName = largeDataName("CandidateTable");
+            const bool candidateTableWasOpen = alignmentCandidates.candidateTable.isOpen();
+            if(candidateTableWasOpen) {
+                alignmentCandidates.candidateTable.remove();
+            }
+            if(candidateTableWasOpen or
+                (not candidateTableName.empty() and std::filesystem::exists(candidateTableName + ".toc"))) {
+                computeCandidateTable(threadCount);
+                if(not candidateTableWasOpen) {
+                    alignmentCandidates.candidateTable.close();
+                }
+            }
+
+            if(candidatesWereReopened) {
+                alignmentCandidates.candidates.close();
+            }
+        }
+    }
+
+
+
+    // Alignments. They keep their order and AlignmentIds,
+    // so the read graph edges and the alignment statistics
+    // don't need to be updated (the alignment statistics
+    // don't change when the two reads of an alignment are swapped).
+    // The reads of an alignment are swapped if needed,
+    // so that readIds[0] < readIds[1], and in that case its
+    // AlignmentInfo and stored alignment are swapped and,
+    // for alignments between opposite strands, reverse complemented.
+    performanceLog << timestamp << "Renumbering alignments." << endl;
+    accessForRenumbering(alignmentData, largeDataName("AlignmentData"));
+    accessForRenumbering(alignmentInfos, largeDataName("AlignmentInfos"));
+    if(not compressedAlignments.isOpen()) {
+        accessCompressedAlignments();
+    }
+    const uint64_t alignmentCount = alignmentData.size();
+    vector<uint8_t> alignmentWasSwapped(alignmentCount, 0);
+    parallelFor(alignmentCount, 100000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t alignmentId=begin; alignmentId!=end; alignmentId++) {
+                CompactAlignmentData& ad = alignmentData[alignmentId];
+                const ReadId readId0 = newReadIds[ad.readIds[0]];
+                const ReadId readId1 = newReadIds[ad.readIds[1]];
+                if(readId0 < readId1) {
+                    ad.readIds = {readId0, readId1};
+                } else {
+                    ad.readIds = {readId1, readId0};
+                    AlignmentInfo& info = alignmentInfos[alignmentId];
+                    info.swap();
+                    if(not ad.isSameStrand) {
+                        info.reverseComplement();
+                    }
+                    alignmentWasSwapped[alignmentId] = 1;
+                }
+            }
+        });
+
+    // The stored alignments are rebuilt in chunks, because
+    // the compressed size of a swapped alignment can change.
+    {
+        MemoryMapped::VectorOfVectors<char, uint64_t> newCompressedAlignments;
+        newCompressedAlignments.createNew(temporaryName, largeDataPageSize);
+        const uint64_t chunkSize = 1000000;
+        vector<string> swappedCompressedAlignments;
+        for(uint64_t chunkBegin=0; chunkBegin<alignmentCount; chunkBegin+=chunkSize) {
+            const uint64_t chunkEnd = min(chunkBegin + chunkSize, alignmentCount);
+            swappedCompressedAlignments.clear();
+            swappedCompressedAlignments.resize(chunkEnd - chunkBegin);
+            parallelFor(chunkEnd - chunkBegin, 1000, threadCount,
+                [&](uint64_t begin, uint64_t end)
+                {
+                    Alignment alignment;
+                    for(uint64_t j=begin; j!=end; j++) {
+                        const uint64_t alignmentId = chunkBegin + j;
+                        if(not alignmentWasSwapped[alignmentId]) {
+                            continue;
+                        }
+                        const CompactAlignmentData& ad = alignmentData[alignmentId];
+                        decompress(compressedAlignments[alignmentId], alignment);
+                        alignment.swap();
+                        if(not ad.isSameStrand) {
+                            alignment.reverseComplement(
+                                uint32_t(markers.size(OrientedReadId(ad.readIds[0], 0).getValue())),
+                                uint32_t(markers.size(OrientedReadId(ad.readIds[1], 0).getValue())));
+                        }
+                        compress(alignment, swappedCompressedAlignments[j]);
+                    }
+                });
+            for(uint64_t alignmentId=chunkBegin; alignmentId!=chunkEnd; alignmentId++) {
+                if(alignmentWasSwapped[alignmentId]) {
+                    const string& s = swappedCompressedAlignments[alignmentId - chunkBegin];
+                    newCompressedAlignments.appendVector(s.begin(), s.end());
+                } else {
+                    newCompressedAlignments.appendVector(
+                        compressedAlignments.begin(alignmentId),
+                        compressedAlignments.end(alignmentId));
+                }
+            }
+        }
+        newCompressedAlignments.unreserve();
+
+        const string name = compressedAlignments.getName();
+        compressedAlignments.remove();
+        compressedAlignments.createNew(name, largeDataPageSize);
+        vector<uint64_t> identity(alignmentCount);
+        std::iota(identity.begin(), identity.end(), uint64_t(0));
+        copyPermuted(newCompressedAlignments, compressedAlignments, identity, threadCount);
+        newCompressedAlignments.remove();
+    }
+
+    alignmentTable.remove();
+    computeAlignmentTable(threadCount);
+
+
+
+    // Read graph. The edges keep their order,
+    // so the reverse complemented edge pairs are preserved
+    // and only the connectivity needs to be permuted.
+    performanceLog << timestamp << "Renumbering the read graph." << endl;
+    accessForRenumbering(readGraph.edges, largeDataName("ReadGraphEdges"));
+    parallelFor(readGraph.edges.size(), 100000, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t edgeId=begin; edgeId!=end; edgeId++) {
+                ReadGraphEdge& edge = readGraph.edges[edgeId];
+                for(OrientedReadId& orientedReadId: edge.orientedReadIds) {
+                    orientedReadId = newOrientedReadId(orientedReadId);
+                }
+            }
+        });
+    permuteVectorOfVectors(readGraph.connectivity, oldOrientedReadIds,
+        temporaryName, largeDataPageSize, threadCount);
+
+    performanceLog << timestamp << "Read renumbering ends." << endl;
+}
+
+
+
+// Return the ReadId a read had before the reads were renumbered.
+// If the reads were not renumbered, this is the ReadId itself.
+ReadId Assembler::getOriginalReadId(ReadId readId) const
+{
+    if(originalReadIds.isOpen) {
+        return originalReadIds[readId];
+    } else {
+        return readId;
+    }
+}
+
+
+
+void Assembler::accessOriginalReadIds()
+{
+    originalReadIds.accessExistingReadOnly(largeDataName("OriginalReadIds"));
+}
@@ -78,6 +78,10 @@ void AssemblyGraph::close()
     if(orientedReadsByEdge.isOpen()) {
         orientedReadsByEdge.close();
     }
+
+    if(edgesByOrientedRead.isOpen()) {
+        edgesByOrientedRead.close();
+    }
 }
 
 
@@ -127,6 +131,10 @@ void AssemblyGraph::remove()
     if(orientedReadsByEdge.isOpen()) {
         orientedReadsByEdge.remove();
     }
+
+    if(edgesByOrientedRead.isOpen()) {
+        edgesByOrientedRead.remove();
+    }
 }
 
 
@@ -188,6 +188,35 @@ public:
     };
     MemoryMapped::VectorOfVectors<OrientedReadInfo, uint64_t> orientedReadsByEdge;
 
+    // The transpose of orientedReadsByEdge: the assembly graph edges
+    // encountered by each oriented read, in order of ordinal on the oriented read.
+    // Each entry describes a sequence of marker graph edges of the
+    // same assembly graph edge, encountered consecutively by the oriented read.
+    // These are the same entries as the pseudo-path of the oriented read.
+    // Created together with orientedReadsByEdge.
+    // Indexed by OrientedReadId::getValue().
+    class EdgeInfo {
+    public:
+        EdgeId edgeId;
+
+        // The first and last ordinal on the oriented read.
+        uint32_t firstOrdinal;
+        uint32_t lastOrdinal;
+
+        // The first and last position in the assembly graph edge.
+        uint32_t firstPosition;
+        uint32_t lastPosition;
+
+        // The number of marker graph edges.
+        uint32_t markerGraphEdgeCount;
+
+        bool operator<(const EdgeInfo& that) const
+        {
+            return tie(firstOrdinal, edgeId) < tie(that.firstOrdinal, that.edgeId);
+        }
+    };
+    MemoryMapped::VectorOfVectors<EdgeInfo, uint64_t> edgesByOrientedRead;
+
     // Compute the number of oriented reads in common between two segments.
     uint64_t commonOrientedReadCount(
         EdgeId, EdgeId,
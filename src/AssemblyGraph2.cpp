@@ -3,6 +3,7 @@
 #include "AssemblyGraph2Statistics.hpp"
 #include "AssembledSegment.hpp"
 #include "assembleMarkerGraphPath.hpp"
+#include "Bgzf.hpp"
 #include "AssemblerOptions.hpp"
 #include "copyNumber.hpp"
 #include "deduplicate.hpp"
@@ -12,6 +13,7 @@
 #include "findMarkerId.hpp"
 #include "GfaAssemblyGraph.hpp"
 #include "orderPairs.hpp"
+#include "ParallelWriter.hpp"
 #include "PhasingGraph.hpp"
 #include "performanceLog.hpp"
 #include "ReadFlags.hpp"
@@ -60,7 +62,9 @@ AssemblyGraph2::AssemblyGraph2(
     readFlags(readFlags),
     reads(reads),
     markers(markers),
-    markerGraph(markerGraph)
+    markerGraph(markerGraph),
+    outputThreadCount(threadCount),
+    outputCompressionExtension(mode2Options.bgzfOutput ? ".gz" : "")
 {
 
 
@@ -112,15 +116,18 @@ AssemblyGraph2::AssemblyGraph2(
         writeDetailedEarly("Assembly-Detailed-Debug-1");
     }
 
+    // Create the index used to compute read information.
+    createOrientedReadIndex(threadCount);
+
     // Handle superbubbles.
     handleSuperbubbles0(superbubbleRemovalEdgeLengthThreshold,
-        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false);
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false, threadCount);
     merge(false, false);
     if(debug) {
         writeDetailedEarly("Assembly-Detailed-Debug-2");
     }
     handleSuperbubbles1(
-        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false);
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false, threadCount);
     merge(false, false);
     if(debug) {
         writeDetailedEarly("Assembly-Detailed-Debug-3");
@@ -143,8 +150,10 @@ AssemblyGraph2::AssemblyGraph2(
     }
 
     // Remove degenerate edges (both branches have the same sequence).
+    // From here on, sequence is only assembled when needed,
+    // for the branches that are still present at the end.
     removeDegenerateBranches();
-    merge(true, true);
+    merge(true, false);
     prune(pruneLength);
 
     if(debug) {
@@ -175,6 +184,9 @@ AssemblyGraph2::AssemblyGraph2(
         writeDetailedEarly("Assembly-Detailed-Debug-6");
     }
 
+    // Read information will not be recomputed anymore.
+    orientedReadIndex.clear();
+
     // Final pruning.
     prune(pruneLength);
 
@@ -189,6 +201,14 @@ AssemblyGraph2::AssemblyGraph2(
     // in the final AssemblyGraph2.
     updateMarkerGraph();
 
+    // Assemble sequence for the branches created
+    // since the last assembly.
+    assembleParallel(threadCount);
+
+    // The graph will not change anymore.
+    // Create its compact representation, used by the read-only phases below.
+    compact();
+
     // Write out what we have.
     storeGfaSequence();
     if(not mode2Options.suppressDetailedOutput) {
@@ -648,7 +668,7 @@ AssemblyGraph2::edge_descriptor AssemblyGraph2::addEdge(
     SHASTA_ASSERT(edgeWasAdded);
 
     if(storeReadInformation) {
-        (*this)[e].storeReadInformation(markerGraph);
+        (*this)[e].storeReadInformation(markerGraph, orientedReadIndex);
     }
     if(assemble) {
         AssemblyGraph2::assemble(e, reads);
@@ -754,16 +774,93 @@ void AssemblyGraph2::assemble()
 
 
 
+// Create the compact representation of the graph.
+// This must be called again after any change to the graph.
+void AssemblyGraph2::compact()
+{
+    const G& g = *this;
+    CompactGraph& c = compactGraph;
+    c.clear();
+
+    // Vertices.
+    std::map<vertex_descriptor, uint64_t> vertexIndexMap;
+    BGL_FORALL_VERTICES(v, g, G) {
+        vertexIndexMap.insert(make_pair(v, c.vertices.size()));
+        c.vertices.push_back(v);
+    }
+    const uint64_t vertexCount = c.vertices.size();
+
+    // Edges, in the order BGL_FORALL_EDGES uses.
+    BGL_FORALL_EDGES(e, g, G) {
+        c.edges.push_back(e);
+        c.sources.push_back(vertexIndexMap[source(e, g)]);
+        c.targets.push_back(vertexIndexMap[target(e, g)]);
+    }
+    const uint64_t edgeCount = c.edges.size();
+
+    // Out-edges and in-edges of each vertex.
+    c.outEdgesBegin.resize(vertexCount + 1, 0);
+    c.inEdgesBegin.resize(vertexCount + 1, 0);
+    for(uint64_t ie=0; ie<edgeCount; ie++) {
+        ++c.outEdgesBegin[c.sources[ie] + 1];
+        ++c.inEdgesBegin[c.targets[ie] + 1];
+    }
+    for(uint64_t iv=0; iv<vertexCount; iv++) {
+        c.outEdgesBegin[iv + 1] += c.outEdgesBegin[iv];
+        c.inEdgesBegin[iv + 1] += c.inEdgesBegin[iv];
+    }
+    c.outEdges.resize(edgeCount);
+    c.inEdges.resize(edgeCount);
+    vector<uint64_t> outPosition(c.outEdgesBegin.begin(), c.outEdgesBegin.end() - 1);
+    vector<uint64_t> inPosition(c.inEdgesBegin.begin(), c.inEdgesBegin.end() - 1);
+    for(uint64_t ie=0; ie<edgeCount; ie++) {
+        c.outEdges[outPosition[c.sources[ie]]++] = ie;
+        c.inEdges[inPosition[c.targets[ie]]++] = ie;
+    }
+
+    c.isValid = true;
+}
+
+
+
+void AssemblyGraph2::clearCompact()
+{
+    compactGraph.clear();
+}
+
+
+
+void AssemblyGraph2::CompactGraph::clear()
+{
+    isValid = false;
+    vertices.clear();
+    edges.clear();
+    sources.clear();
+    targets.clear();
+    outEdgesBegin.clear();
+    outEdges.clear();
+    inEdgesBegin.clear();
+    inEdges.clear();
+}
+
+
+
 // Assemble sequence for every marker graph path of every edge. Multithreaded version.
+// Only edges with at least one branch with dirty sequence are processed.
 void AssemblyGraph2::assembleParallel(uint64_t threadCount)
 {
     performanceLog << timestamp << "AssemblyGraph2::assembleParallel begins." << endl;
     G& g = *this;
 
-    // Store a vector of edge descriptors for all edges, to be processed in parallel.
+    // Store a vector of edge descriptors for the edges to be processed in parallel.
     assembleParallelData.allEdges.clear();
     BGL_FORALL_EDGES(e, g, G) {
-        assembleParallelData.allEdges.push_back(e);
+        for(const E::Branch& branch: g[e].branches) {
+            if(branch.sequenceIsDirty) {
+                assembleParallelData.allEdges.push_back(e);
+                break;
+            }
+        }
     }
 
     // Process all edges in parallel.
@@ -795,6 +892,7 @@ void AssemblyGraph2::assembleThreadFunction(size_t threadId)
 
 
 // Assemble sequence for every marker graph path of a given edge.
+// Branches with sequence already up to date are skipped.
 void AssemblyGraph2::assemble(edge_descriptor e, const Reads& reads)
 {
     G& g = *this;
@@ -802,6 +900,9 @@ void AssemblyGraph2::assemble(edge_descriptor e, const Reads& reads)
 
     E& edge = g[e];
     for(E::Branch& branch: edge.branches) {
+        if(not branch.sequenceIsDirty) {
+            continue;
+        }
         const MarkerGraphPath& path = branch.path;
 
         AssembledSegment assembledSegment;
@@ -832,6 +933,7 @@ void AssemblyGraph2::assemble(edge_descriptor e, const Reads& reads)
             assembledSegment.rawSequence.begin() + beginSkip,
             assembledSegment.rawSequence.end() - endSkip,
             branch.rawSequence.begin());
+        branch.sequenceIsDirty = false;
     }
 }
 
@@ -995,17 +1097,20 @@ void AssemblyGraph2::writeDetailed(
 
 
     // Open the fasta file.
-    ofstream fasta;
+    std::shared_ptr<ostream> fastaPointer = std::make_shared<ofstream>();
     if(writeFasta) {
-        fasta.open(baseName + ".fasta");
+        fastaPointer = openOutputFile(baseName + ".fasta" + outputCompressionExtension, outputThreadCount);
     }
+    ostream& fasta = *fastaPointer;
 
     // Create a GFA with a segment for each branch, then write it out.
     GfaAssemblyGraph<vertex_descriptor> gfa;
-    BGL_FORALL_EDGES(e, g, G) {
-        const E& edge = g[e];
-        const vertex_descriptor v0 = source(e, g);
-        const vertex_descriptor v1 = target(e, g);
+    SHASTA_ASSERT(compactGraph.isValid);
+    const CompactGraph& c = compactGraph;
+    for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+        const E& edge = g[c.edges[ie]];
+        const vertex_descriptor v0 = c.vertices[c.sources[ie]];
+        const vertex_descriptor v1 = c.vertices[c.targets[ie]];
 
         for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
             const E::Branch& branch = edge.branches[branchId];
@@ -1022,14 +1127,6 @@ void AssemblyGraph2::writeDetailed(
                 }
             }
 
-            if(writeFasta) {
-                fasta << ">" << edge.pathId(branchId) << " " << branch.gfaSequence.size() << "\n";
-                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
-                fasta << "\n";
-            }
-
-
-
             // Write a line for this segment to the csv file.
             if(writeCsv) {
 
@@ -1167,9 +1264,25 @@ void AssemblyGraph2::writeDetailed(
 
 
 
+    // Write out the fasta, formatting the sequences in parallel.
+    if(writeFasta) {
+        ParallelWriter writer(fasta, outputThreadCount);
+        writer.write(c.edges.size(), [&](uint64_t ie, string& s) {
+            const E& edge = g[c.edges[ie]];
+            for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
+                const vector<Base>& sequence = edge.branches[branchId].gfaSequence;
+                s += ">" + edge.pathId(branchId) + " " + to_string(sequence.size()) + "\n";
+                for(const Base b: sequence) {
+                    s.push_back(b.character());
+                }
+                s += "\n";
+            }
+        });
+    }
+
     // Write out the GFA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa" + outputCompressionExtension, outputThreadCount);
     }
 
     performanceLog << timestamp << "AssemblyGraph2::writeDetailed ends." << endl;
@@ -1185,8 +1298,10 @@ void AssemblyGraph2::writeDetailedEarly(const string& baseName)
     const bool writeGfa = true;
     const bool writeFasta = false;
 
+    compact();
     writeDetailed(baseName,
         writeSequence, writeSequenceLengthInMarkers, writeCsv, writeGfa, writeFasta);
+    clearCompact();
 }
 
 
@@ -1206,22 +1321,25 @@ void AssemblyGraph2::writeHaploid(
     uint64_t totalNonBubbleChainLength = 0;
 
     // Open the fasta file.
-    ofstream fasta;
+    std::shared_ptr<ostream> fastaPointer = std::make_shared<ofstream>();
     if(writeFasta) {
-        fasta.open(baseName + ".fasta");
+        fastaPointer = openOutputFile(baseName + ".fasta" + outputCompressionExtension, outputThreadCount);
     }
+    ostream& fasta = *fastaPointer;
 
     // Create a GFA and add a segment for each edge that is not part
     // of a bubble chain.
     GfaAssemblyGraph<vertex_descriptor> gfa;
-    BGL_FORALL_EDGES(e, g, G) {
-        const E& edge = g[e];
+    SHASTA_ASSERT(compactGraph.isValid);
+    const CompactGraph& c = compactGraph;
+    for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+        const E& edge = g[c.edges[ie]];
         if(edge.bubbleChain.first) {
             continue;
         }
 
-        const vertex_descriptor v0 = source(e, g);
-        const vertex_descriptor v1 = target(e, g);
+        const vertex_descriptor v0 = c.vertices[c.sources[ie]];
+        const vertex_descriptor v1 = c.vertices[c.targets[ie]];
 
         for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
             const E::Branch& branch = edge.branches[branchId];
@@ -1276,7 +1394,7 @@ void AssemblyGraph2::writeHaploid(
 
     // Write the GFA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa" + outputCompressionExtension, outputThreadCount);
     }
 
 
@@ -1291,8 +1409,8 @@ void AssemblyGraph2::writeHaploid(
 
 
         // Write a line to csv for each edge that is not part of a bubble chain.
-        BGL_FORALL_EDGES(e, g, G) {
-            const E& edge = g[e];
+        for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+            const E& edge = g[c.edges[ie]];
             if(edge.bubbleChain.first) {
                 continue;
             }
@@ -1388,22 +1506,25 @@ void AssemblyGraph2::writePhased(
     }
 
     // Open the fasta file.
-    ofstream fasta;
+    std::shared_ptr<ostream> fastaPointer = std::make_shared<ofstream>();
     if(writeFasta) {
-        fasta.open(baseName + ".fasta");
+        fastaPointer = openOutputFile(baseName + ".fasta" + outputCompressionExtension, outputThreadCount);
     }
+    ostream& fasta = *fastaPointer;
 
     // Create a GFA and add a segment for each edge that is not part
     // of a bubble chain.
     GfaAssemblyGraph<vertex_descriptor> gfa;
-    BGL_FORALL_EDGES(e, g, G) {
-        const E& edge = g[e];
+    SHASTA_ASSERT(compactGraph.isValid);
+    const CompactGraph& c = compactGraph;
+    for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+        const E& edge = g[c.edges[ie]];
         if(edge.bubbleChain.first) {
             continue;
         }
 
-        const vertex_descriptor v0 = source(e, g);
-        const vertex_descriptor v1 = target(e, g);
+        const vertex_descriptor v0 = c.vertices[c.sources[ie]];
+        const vertex_descriptor v1 = c.vertices[c.targets[ie]];
 
         for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
             const E::Branch& branch = edge.branches[branchId];
@@ -1559,7 +1680,7 @@ void AssemblyGraph2::writePhased(
 
     // Write the GFA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa" + outputCompressionExtension, outputThreadCount);
     }
 
 
@@ -1860,9 +1981,11 @@ string AssemblyGraph2Edge::color(uint64_t branchId) const
 void AssemblyGraph2::countTransferredBases()
 {
     G& g = *this;
+    SHASTA_ASSERT(compactGraph.isValid);
+    const CompactGraph& c = compactGraph;
 
-    BGL_FORALL_EDGES(e, g, G) {
-        E& edge = g[e];
+    for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+        E& edge = g[c.edges[ie]];
         edge.backwardTransferCount = 0;
         edge.forwardTransferCount = 0;
 
@@ -1877,35 +2000,31 @@ void AssemblyGraph2::countTransferredBases()
         }
 
         // v0 must have in-degree and out-degree 1.
-        const vertex_descriptor v0 = source(e, g);
-        if(in_degree(v0, g) != 1) {
+        const uint64_t iv0 = c.sources[ie];
+        if(c.inDegree(iv0) != 1) {
             continue;
         }
-        if(out_degree(v0, g) != 1) {
+        if(c.outDegree(iv0) != 1) {
             continue;
         }
 
         // v1 must have in-degree and out-degree 1.
-        const vertex_descriptor v1 = target(e, g);
-        if(in_degree(v1, g) != 1) {
+        const uint64_t iv1 = c.targets[ie];
+        if(c.inDegree(iv1) != 1) {
             continue;
         }
-        if(out_degree(v1, g) != 1) {
+        if(c.outDegree(iv1) != 1) {
             continue;
         }
 
         // The previous edge must not be a bubble.
-        in_edge_iterator itPrevious;
-        tie(itPrevious, ignore) = in_edges(v0, g);
-        const E& previousEdge = g[*itPrevious];
+        const E& previousEdge = g[c.firstInEdge(iv0)];
         if(previousEdge.isBubble()) {
             continue;
         }
 
         // The next edge must not be a bubble.
-        out_edge_iterator itNext;
-        tie(itNext, ignore) = out_edges(v1, g);
-        const E& nextEdge = g[*itNext];
+        const E& nextEdge = g[c.firstOutEdge(iv1)];
         if(nextEdge.isBubble()) {
             continue;
         }
@@ -1954,22 +2073,23 @@ void AssemblyGraph2::storeGfaSequence()
 
 
 
-    BGL_FORALL_EDGES(e, g, G) {
-        E& edge = g[e];
-        const vertex_descriptor v0 = source(e, g);
-        const vertex_descriptor v1 = target(e, g);
+    SHASTA_ASSERT(compactGraph.isValid);
+    const CompactGraph& c = compactGraph;
+    for(uint64_t ie=0; ie<c.edges.size(); ie++) {
+        E& edge = g[c.edges[ie]];
+        const uint64_t iv0 = c.sources[ie];
+        const uint64_t iv1 = c.targets[ie];
 
         for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
             E::Branch& branch = edge.branches[branchId];
+            SHASTA_ASSERT(not branch.sequenceIsDirty);
 
             branch.gfaSequence.clear();
 
             // Add the sequence transferred forward by the preceding bubble, if appropriate.
             if(not edge.isBubble()) {
-                if(in_degree(v0, g)==1 and out_degree(v0, g)==1) {
-                    in_edge_iterator it;
-                    tie(it, ignore) = in_edges(v0, g);
-                    const E& previousEdge = g[*it];
+                if(c.inDegree(iv0)==1 and c.outDegree(iv0)==1) {
+                    const E& previousEdge = g[c.firstInEdge(iv0)];
                     if(previousEdge.isBubble()) {
                         const vector<Base>& s = previousEdge.branches.front().rawSequence;
                         copy(s.end() - previousEdge.forwardTransferCount, s.end(),
@@ -1987,10 +2107,8 @@ void AssemblyGraph2::storeGfaSequence()
 
             // Add the sequence transferred backward by the following bubble, if appropriate.
             if(not edge.isBubble()) {
-                if(in_degree(v1, g)==1 and out_degree(v1, g)==1) {
-                    out_edge_iterator it;
-                    tie(it, ignore) = out_edges(v1, g);
-                    const E& nextEdge = g[*it];
+                if(c.inDegree(iv1)==1 and c.outDegree(iv1)==1) {
+                    const E& nextEdge = g[c.firstOutEdge(iv1)];
                     if(nextEdge.isBubble()) {
                         const vector<Base>& s = nextEdge.branches.front().rawSequence;
                         copy(s.begin(), s.begin() + nextEdge.backwardTransferCount,
@@ -2095,7 +2213,9 @@ uint64_t AssemblyGraph2Edge::bubbleEditDistance() const
 
 
 // Fill in orientedReads and average/minimum coverage.
-void AssemblyGraph2Edge::Branch::storeReadInformation(const MarkerGraph& markerGraph)
+void AssemblyGraph2Edge::Branch::storeReadInformation(
+    const MarkerGraph& markerGraph,
+    const AssemblyGraph2OrientedReadIndex& orientedReadIndex)
 {
     minimumCoverage = std::numeric_limits<uint64_t>::max();
     coverageSum = 0;
@@ -2104,16 +2224,24 @@ void AssemblyGraph2Edge::Branch::storeReadInformation(const MarkerGraph& markerG
     // Loop over the marker graph path of this branch.
     for(MarkerGraph::EdgeId edgeId: path) {
 
-        // Loop over the marker intervals of this edge.
-        const span<const MarkerInterval> markerIntervals =
-            markerGraph.edgeMarkerIntervals[edgeId];
-        for(const MarkerInterval& markerInterval: markerIntervals) {
-            orientedReadIds.push_back(markerInterval.orientedReadId);
+        // Get the oriented reads of this edge from the index, if possible.
+        // Otherwise, loop over the marker intervals of this edge.
+        span<const OrientedReadId> edgeOrientedReadIds;
+        if(orientedReadIndex.find(edgeId, edgeOrientedReadIds)) {
+            orientedReadIds.insert(orientedReadIds.end(),
+                edgeOrientedReadIds.begin(), edgeOrientedReadIds.end());
+        } else {
+            const span<const MarkerInterval> markerIntervals =
+                markerGraph.edgeMarkerIntervals[edgeId];
+            for(const MarkerInterval& markerInterval: markerIntervals) {
+                orientedReadIds.push_back(markerInterval.orientedReadId);
+            }
         }
 
         // Update coverage.
-        minimumCoverage = min(minimumCoverage, uint64_t(markerIntervals.size()));
-        coverageSum += markerIntervals.size();
+        const uint64_t coverage = markerGraph.edgeMarkerIntervals.size(edgeId);
+        minimumCoverage = min(minimumCoverage, coverage);
+        coverageSum += coverage;
     }
 
     deduplicate(orientedReadIds);
@@ -2121,6 +2249,103 @@ void AssemblyGraph2Edge::Branch::storeReadInformation(const MarkerGraph& markerG
 
 
 
+// Create the index used to compute read information, for the
+// marker graph edges of all branches currently in the graph.
+void AssemblyGraph2::createOrientedReadIndex(uint64_t threadCount)
+{
+    performanceLog << timestamp << "AssemblyGraph2::createOrientedReadIndex begins." << endl;
+    G& g = *this;
+
+    // Flag the marker graph edges used by at least one branch.
+    const uint64_t markerGraphEdgeCount = markerGraph.edges.size();
+    vector<uint8_t>& isUsed = createOrientedReadIndexData.isUsed;
+    isUsed.clear();
+    isUsed.resize(markerGraphEdgeCount, 0);
+    BGL_FORALL_EDGES(e, g, G) {
+        for(const E::Branch& branch: g[e].branches) {
+            for(const MarkerGraph::EdgeId edgeId: branch.path) {
+                isUsed[edgeId] = 1;
+            }
+        }
+    }
+
+    // Pass 1: count the distinct oriented reads of each used marker graph edge.
+    orientedReadIndex.begin.clear();
+    orientedReadIndex.begin.resize(markerGraphEdgeCount + 1, 0);
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(markerGraphEdgeCount, batchSize);
+    runThreads(&AssemblyGraph2::createOrientedReadIndexThreadFunction1, threadCount);
+
+    // Turn the counts into offsets.
+    uint64_t offset = 0;
+    for(uint64_t& x: orientedReadIndex.begin) {
+        const uint64_t count = x;
+        x = offset;
+        offset += count;
+    }
+    orientedReadIndex.orientedReadIds.resize(offset);
+
+    // Pass 2: store the oriented reads.
+    setupLoadBalancing(markerGraphEdgeCount, batchSize);
+    runThreads(&AssemblyGraph2::createOrientedReadIndexThreadFunction2, threadCount);
+
+    isUsed.clear();
+    isUsed.shrink_to_fit();
+
+    performanceLog << timestamp << "AssemblyGraph2::createOrientedReadIndex ends." << endl;
+}
+
+
+
+void AssemblyGraph2::createOrientedReadIndexThreadFunction1(size_t /* threadId */)
+{
+    const vector<uint8_t>& isUsed = createOrientedReadIndexData.isUsed;
+    vector<OrientedReadId> orientedReadIds;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(MarkerGraph::EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            if(not isUsed[edgeId]) {
+                continue;
+            }
+            orientedReadIds.clear();
+            for(const MarkerInterval& markerInterval: markerGraph.edgeMarkerIntervals[edgeId]) {
+                orientedReadIds.push_back(markerInterval.orientedReadId);
+            }
+            deduplicate(orientedReadIds);
+            orientedReadIndex.begin[edgeId] = orientedReadIds.size();
+        }
+    }
+}
+
+
+
+void AssemblyGraph2::createOrientedReadIndexThreadFunction2(size_t /* threadId */)
+{
+    const vector<uint8_t>& isUsed = createOrientedReadIndexData.isUsed;
+    vector<OrientedReadId> orientedReadIds;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(MarkerGraph::EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            if(not isUsed[edgeId]) {
+                continue;
+            }
+            orientedReadIds.clear();
+            for(const MarkerInterval& markerInterval: markerGraph.edgeMarkerIntervals[edgeId]) {
+                orientedReadIds.push_back(markerInterval.orientedReadId);
+            }
+            deduplicate(orientedReadIds);
+            SHASTA_ASSERT(orientedReadIds.size() ==
+                orientedReadIndex.begin[edgeId + 1] - orientedReadIndex.begin[edgeId]);
+            copy(orientedReadIds.begin(), orientedReadIds.end(),
+                orientedReadIndex.orientedReadIds.begin() + orientedReadIndex.begin[edgeId]);
+        }
+    }
+}
+
+
+
 // Store read information on all edges.
 void AssemblyGraph2::storeReadInformation()
 {
@@ -2129,7 +2354,7 @@ void AssemblyGraph2::storeReadInformation()
     G& g = *this;
 
     BGL_FORALL_EDGES(e, g, G) {
-        g[e].storeReadInformation(markerGraph);
+        g[e].storeReadInformation(markerGraph, orientedReadIndex);
     }
     performanceLog << timestamp << "AssemblyGraph2::storeReadInformation ends." << endl;
 }
@@ -2170,7 +2395,7 @@ void AssemblyGraph2::storeReadInformationThreadFunction(size_t threadId)
         // Loop over all edges in this batch.
         for(uint64_t i=begin; i!=end; i++) {
             const edge_descriptor e = storeReadInformationParallelData.allEdges[i];
-            g[e].storeReadInformation(markerGraph);
+            g[e].storeReadInformation(markerGraph, orientedReadIndex);
         }
     }
 }
@@ -2178,10 +2403,12 @@ void AssemblyGraph2::storeReadInformationThreadFunction(size_t threadId)
 
 
 // Store read information on all branches.
-void AssemblyGraph2Edge::storeReadInformation(const MarkerGraph& markerGraph)
+void AssemblyGraph2Edge::storeReadInformation(
+    const MarkerGraph& markerGraph,
+    const AssemblyGraph2OrientedReadIndex& orientedReadIndex)
 {
     for(Branch& branch: branches) {
-        branch.storeReadInformation(markerGraph);
+        branch.storeReadInformation(markerGraph, orientedReadIndex);
     }
 }
 
@@ -2648,7 +2875,7 @@ AssemblyGraph2::edge_descriptor AssemblyGraph2::mergeWithPreviousIfPossible(edge
     newBranch.containsSecondaryEdges = branch.containsSecondaryEdges or previousBranch.containsSecondaryEdges;
 
     // Recompute read support for the merged branch.
-    newBranch.storeReadInformation(markerGraph);
+    newBranch.storeReadInformation(markerGraph, orientedReadIndex);
 
     // Compute sequence for the updated edge.
     assemble(eNew, reads);
@@ -2716,7 +2943,7 @@ AssemblyGraph2::edge_descriptor AssemblyGraph2::mergeWithFollowingIfPossible(edg
     newBranch.containsSecondaryEdges = branch.containsSecondaryEdges or followingBranch.containsSecondaryEdges;
 
     // Recompute read support for the merged branch.
-    newBranch.storeReadInformation(markerGraph);
+    newBranch.storeReadInformation(markerGraph, orientedReadIndex);
 
     // Compute sequence for the updated edge.
     assemble(eNew, reads);
@@ -3098,7 +3325,8 @@ void AssemblyGraph2::handleSuperbubbles0(
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
     bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
+    bool assemble,              // If true, assemble sequence for newly created edges
+    uint64_t threadCount
     )
 {
     G& g = *this;
@@ -3141,19 +3369,16 @@ void AssemblyGraph2::handleSuperbubbles0(
 
 
 
-    // Process one components one at a time.
     // Each component is used to create a superbubble.
-    for(const auto& p: components) {
-        const vector<vertex_descriptor>& componentVertices = p.second;
-
-        // Create a superbubble with this component.
-        Superbubble superbubble(g, componentVertices, edgeLengthThreshold);
-
-        // Process it.
-        handleSuperbubble1(superbubble,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
-            storeReadInformation, assemble);
+    vector< vector<vertex_descriptor> > componentVector;
+    for(auto& p: components) {
+        componentVector.push_back(std::move(p.second));
     }
+    components.clear();
+    handleSuperbubbles(componentVector, true, edgeLengthThreshold,
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
+        storeReadInformation, assemble, threadCount);
+
     performanceLog << timestamp << "AssemblyGraph2::handleSuperbubbles0 ends." << endl;
 }
 
@@ -3165,7 +3390,8 @@ void AssemblyGraph2::handleSuperbubbles1(
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
     bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
+    bool assemble,              // If true, assemble sequence for newly created edges
+    uint64_t threadCount
     )
 {
     G& g = *this;
@@ -3209,20 +3435,15 @@ void AssemblyGraph2::handleSuperbubbles1(
         components[component].push_back(v);
     }
 
-    // Process one components one at a time.
     // Each component is used to create a superbubble.
-    for(const auto& p: components) {
-        const vector<vertex_descriptor>& componentVertices = p.second;
-
-        // Create a superbubble with this component.
-        Superbubble superbubble(g, componentVertices);
-        // superbubble.writeGraphviz(cout, g);
-
-        // Process it.
-        handleSuperbubble1(superbubble,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
-            storeReadInformation, assemble);
+    vector< vector<vertex_descriptor> > componentVector;
+    for(auto& p: components) {
+        componentVector.push_back(std::move(p.second));
     }
+    components.clear();
+    handleSuperbubbles(componentVector, false, 0,
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
+        storeReadInformation, assemble, threadCount);
 
     clearBubbleChains();
     performanceLog << timestamp << "AssemblyGraph2::handleSuperbubbles1 ends." << endl;
@@ -3230,6 +3451,172 @@ void AssemblyGraph2::handleSuperbubbles1(
 
 
 
+// Create a superbubble for each of the given components
+// and process it using handleSuperbubble1.
+void AssemblyGraph2::handleSuperbubbles(
+    const vector< vector<vertex_descriptor> >& components,
+    bool useEdgeLengthThreshold,
+    uint64_t edgeLengthThreshold,
+    uint64_t maxSuperbubbleSize,
+    uint64_t maxSuperbubbleChunkSize,
+    uint64_t maxSuperbubbleChunkPathCount,
+    bool storeReadInformation,
+    bool assemble,
+    uint64_t threadCount)
+{
+    G& g = *this;
+
+    // Sequential version.
+    // Process one component at a time.
+    if(threadCount <= 1) {
+        vector<SuperbubbleChange> changes;
+        for(const vector<vertex_descriptor>& componentVertices: components) {
+
+            // Create a superbubble with this component.
+            Superbubble superbubble = useEdgeLengthThreshold ?
+                Superbubble(g, componentVertices, edgeLengthThreshold) :
+                Superbubble(g, componentVertices);
+
+            // Process it.
+            handleSuperbubble1(superbubble,
+                maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
+                changes);
+            applySuperbubbleChanges(changes, storeReadInformation, assemble, 0);
+        }
+        return;
+    }
+
+
+
+    // Parallel version.
+    // Superbubbles are independent, so we can compute the changes for
+    // all of them in parallel. During this phase the AssemblyGraph2 is not modified,
+    // except for read information of the superbubble edges.
+    HandleSuperbubblesData& data = handleSuperbubblesData;
+    data.components = &components;
+    data.useEdgeLengthThreshold = useEdgeLengthThreshold;
+    data.edgeLengthThreshold = edgeLengthThreshold;
+    data.maxSuperbubbleSize = maxSuperbubbleSize;
+    data.maxSuperbubbleChunkSize = maxSuperbubbleChunkSize;
+    data.maxSuperbubbleChunkPathCount = maxSuperbubbleChunkPathCount;
+    data.changes.clear();
+    data.changes.resize(components.size());
+    const uint64_t batchSize = 10;
+    setupLoadBalancing(components.size(), batchSize);
+    runThreads(&AssemblyGraph2::handleSuperbubblesThreadFunction, threadCount);
+
+    // Apply the changes sequentially, in the same order
+    // as the sequential version. This creates the new edges
+    // in the same order and with the same ids.
+    vector<edge_descriptor> newEdges;
+    for(const vector<SuperbubbleChange>& changes: data.changes) {
+        applySuperbubbleChanges(changes, storeReadInformation, assemble, &newEdges);
+    }
+    data.changes.clear();
+    data.components = 0;
+
+    // Store read information and assemble sequence
+    // for the new edges, in parallel.
+    if(storeReadInformation) {
+        storeReadInformationParallelData.allEdges = newEdges;
+        setupLoadBalancing(newEdges.size(), 100);
+        runThreads(&AssemblyGraph2::storeReadInformationThreadFunction, threadCount);
+        storeReadInformationParallelData.allEdges.clear();
+    }
+    if(assemble) {
+        assembleParallelData.allEdges = newEdges;
+        setupLoadBalancing(newEdges.size(), 100);
+        runThreads(&AssemblyGraph2::assembleThreadFunction, threadCount);
+        assembleParallelData.allEdges.clear();
+    }
+}
+
+
+
+void AssemblyGraph2::handleSuperbubblesThreadFunction(size_t threadId)
+{
+    G& g = *this;
+    HandleSuperbubblesData& data = handleSuperbubblesData;
+    const vector< vector<vertex_descriptor> >& components = *data.components;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all components in this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+            const vector<vertex_descriptor>& componentVertices = components[i];
+
+            // Create a superbubble with this component.
+            Superbubble superbubble = data.useEdgeLengthThreshold ?
+                Superbubble(g, componentVertices, data.edgeLengthThreshold) :
+                Superbubble(g, componentVertices);
+
+            // Compute the changes, without applying them.
+            handleSuperbubble1(superbubble,
+                data.maxSuperbubbleSize, data.maxSuperbubbleChunkSize, data.maxSuperbubbleChunkPathCount,
+                data.changes[i]);
+        }
+    }
+}
+
+
+
+// Apply the changes computed by handleSuperbubble1.
+void AssemblyGraph2::applySuperbubbleChanges(
+    const vector<SuperbubbleChange>& changes,
+    bool storeReadInformation,  // If true, store read information for newly created edges.
+    bool assemble,              // If true, assemble sequence for newly created edges
+    vector<edge_descriptor>* newEdges)
+{
+    G& g = *this;
+
+    for(const SuperbubbleChange& change: changes) {
+        switch(change.type) {
+
+        case SuperbubbleChange::Type::removeEdge:
+            boost::remove_edge(change.e, g);
+            break;
+
+        case SuperbubbleChange::Type::addHaploidEdge:
+            {
+                const edge_descriptor eNew = addEdge(change.path0, change.containsSecondaryEdges0,
+                    storeReadInformation and not newEdges,
+                    assemble and not newEdges);
+                if(newEdges) {
+                    newEdges->push_back(eNew);
+                }
+            }
+            break;
+
+        case SuperbubbleChange::Type::addBubbleEdge:
+            {
+                edge_descriptor eNew;
+                bool edgeWasAdded = false;
+                tie(eNew, edgeWasAdded) = add_edge(change.v0, change.v1,
+                    E(nextId++,
+                    change.path0, change.containsSecondaryEdges0,
+                    change.path1, change.containsSecondaryEdges1),
+                    g);
+                SHASTA_ASSERT(edgeWasAdded);
+                if(newEdges) {
+                    newEdges->push_back(eNew);
+                } else {
+                    if(storeReadInformation) {
+                        g[eNew].storeReadInformation(markerGraph, orientedReadIndex);
+                    }
+                    if(assemble) {
+                        AssemblyGraph2::assemble(eNew, reads);
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+
+
+
 /*******************************************************************************
 
 Version of superbubble removal that avoids enumerating paths over the entire superbubble.
@@ -3290,12 +3677,11 @@ void AssemblyGraph2::handleSuperbubble1(
     uint64_t maxSuperbubbleSize,
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
-    bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
-    )
+    vector<SuperbubbleChange>& changes)
 {
     G& g = *this;
     const bool debug = false;
+    changes.clear();
 
     // If there are no edges, don't do anything.
     if(num_edges(superbubble) == 0) {
@@ -3338,15 +3724,14 @@ void AssemblyGraph2::handleSuperbubble1(
     const Superbubble::vertex_descriptor exit = superbubble.exits.front();
 
     // Compute the forward dominator tree.
-    // Use the shasta version which includes a bug fix
-    // (see dominatorTree.hpp).
-    shasta::lengauer_tarjan_dominator_tree(
+    // Use the shasta iterative version (see dominatorTree.hpp).
+    shasta::cooper_harvey_kennedy_dominator_tree(
         superbubble,
         entrance,
         boost::get(&SuperbubbleVertex::immediateDominator0, superbubble));
 
     // Compute the backward dominator tree.
-    shasta::lengauer_tarjan_dominator_tree(
+    shasta::cooper_harvey_kennedy_dominator_tree(
         boost::reverse_graph<Superbubble>(superbubble),
         exit,
         boost::get(&SuperbubbleVertex::immediateDominator1, superbubble));
@@ -3452,13 +3837,47 @@ void AssemblyGraph2::handleSuperbubble1(
             cout << "Removing edge " << g[sEdge.ae].pathId(sEdge.branchId) << endl;
         }
         if(sEdge.branchId==0) {
-            boost::remove_edge(sEdge.ae, g);
+            SuperbubbleChange change;
+            change.type = SuperbubbleChange::Type::removeEdge;
+            change.e = sEdge.ae;
+            changes.push_back(change);
         }
         boost::remove_edge(se, superbubble);
     }
 
 
 
+    // The score of a path in a chunk is its average coverage.
+    // A partial path dominates another one ending at the same vertex
+    // if it has a greater or equal coverage sum and a lesser or equal length sum.
+    class ChunkPathScorer {
+    public:
+        ChunkPathScorer(const G& g, const Superbubble& superbubble) : g(g), superbubble(superbubble) {}
+        const G& g;
+        const Superbubble& superbubble;
+
+        // Coverage sum and length sum.
+        using Score = pair<uint64_t, uint64_t>;
+        Score initialScore() const
+        {
+            return {0, 0};
+        }
+        Score extend(const Score& score, Superbubble::edge_descriptor se) const
+        {
+            const SuperbubbleEdge& sEdge = superbubble[se];
+            const auto& branch = g[sEdge.ae].branches[sEdge.branchId];
+            return {score.first + branch.coverageSum, score.second + branch.path.size()};
+        }
+        bool isBetter(const Score& x, const Score& y) const
+        {
+            return double(x.first) / double(x.second) > double(y.first) / double(y.second);
+        }
+        bool dominates(const Score& x, const Score& y) const
+        {
+            return x.first >= y.first and x.second <= y.second;
+        }
+    };
+
     // Loop over the chunks.
     // Chunk chunkId consists of all edges reachable forward from choke point chunkId
     // and backward from choke point chunkId+1.
@@ -3505,22 +3924,37 @@ void AssemblyGraph2::handleSuperbubble1(
             const AssemblyGraph2::edge_descriptor ae = sEdge.ae;
             AssemblyGraph2Edge& aEdge = g[ae];
             AssemblyGraph2Edge::Branch& branch = aEdge.branches[sEdge.branchId];
-            branch.storeReadInformation(markerGraph);
+            branch.storeReadInformation(markerGraph, orientedReadIndex);
         }
 
-        // Enumerate paths between chunkEntrance and chunkExit.
-        superbubble.enumeratePaths(chunkEntrance, chunkExit);
-
-        // If we found too many paths, ignore this chunk.
-        if(superbubble.paths.size() > maxSuperbubbleChunkPathCount) {
-            if(debug) {
-                cout << "Chunk ignored because it has too many paths." << endl;
+        // Find the two paths with the highest average coverage
+        // between chunkEntrance and chunkExit.
+        // If the chunk is acyclic, this is done without enumerating all paths.
+        // Otherwise, fall back to enumerating all paths.
+        // In both cases, if there are too many paths, ignore this chunk.
+        uint64_t pathCount = 0;
+        if(countPathsBetween(superbubble, chunkEntrance, chunkExit, maxSuperbubbleChunkPathCount, pathCount)) {
+            if(pathCount > maxSuperbubbleChunkPathCount) {
+                if(debug) {
+                    cout << "Chunk ignored because it has too many paths." << endl;
+                }
+                continue;
+            }
+            const ChunkPathScorer scorer(g, superbubble);
+            SHASTA_ASSERT(findBestPathsBetween(superbubble, chunkEntrance, chunkExit, 2, scorer, superbubble.paths));
+        } else {
+            superbubble.enumeratePaths(chunkEntrance, chunkExit);
+            pathCount = superbubble.paths.size();
+            if(pathCount > maxSuperbubbleChunkPathCount) {
+                if(debug) {
+                    cout << "Chunk ignored because it has too many paths." << endl;
+                }
+                continue;
             }
-            continue;
         }
 
         if(debug) {
-            cout << "Found " << superbubble.paths.size() << " paths for this chunk:" << endl;
+            cout << "Found " << pathCount << " paths for this chunk. Paths considered:" << endl;
             for(const vector<Superbubble::edge_descriptor>& path: superbubble.paths) {
 
                 uint64_t coverageSum = 0;
@@ -3607,22 +4041,22 @@ void AssemblyGraph2::handleSuperbubble1(
             const auto end = begin + prefixLength;
 
             // Construct the marker graph path.
-            MarkerGraphPath markerGraphPath;
-            bool containsSecondaryEdges = false;
+            SuperbubbleChange change;
+            change.type = SuperbubbleChange::Type::addHaploidEdge;
             for(auto it=begin; it!=end; ++it) {
                 const Superbubble::edge_descriptor se = *it;
                 const SuperbubbleEdge& sEdge = superbubble[se];
                 const AssemblyGraph2::edge_descriptor ae = sEdge.ae;
                 const AssemblyGraph2Edge& aEdge = g[ae];
                 const AssemblyGraph2Edge::Branch& branch = aEdge.branches[sEdge.branchId];
-                copy(branch.path.begin(), branch.path.end(), back_inserter(markerGraphPath));
+                copy(branch.path.begin(), branch.path.end(), back_inserter(change.path0));
                 if(branch.containsSecondaryEdges) {
-                    containsSecondaryEdges = true;
+                    change.containsSecondaryEdges0 = true;
                 }
             }
 
             // Create a new haploid edge with this path.
-            addEdge(markerGraphPath, containsSecondaryEdges, storeReadInformation, assemble);
+            changes.push_back(change);
         }
 
 
@@ -3652,8 +4086,12 @@ void AssemblyGraph2::handleSuperbubble1(
 
 
             // Create the new edge with two branches, one for each of our best paths.
-            MarkerGraphPath markerGraphPath0;
-            bool containsSecondaryEdges0 = false;
+            SuperbubbleChange change;
+            change.type = SuperbubbleChange::Type::addBubbleEdge;
+            change.v0 = av0;
+            change.v1 = av1;
+            MarkerGraphPath& markerGraphPath0 = change.path0;
+            bool& containsSecondaryEdges0 = change.containsSecondaryEdges0;
             for(auto it=begin0; it!=end0; ++it) {
                 const Superbubble::edge_descriptor se = *it;
                 const SuperbubbleEdge& sEdge = superbubble[se];
@@ -3665,8 +4103,8 @@ void AssemblyGraph2::handleSuperbubble1(
                     containsSecondaryEdges0 = true;
                 }
             }
-            MarkerGraphPath markerGraphPath1;
-            bool containsSecondaryEdges1 = false;
+            MarkerGraphPath& markerGraphPath1 = change.path1;
+            bool& containsSecondaryEdges1 = change.containsSecondaryEdges1;
             for(auto it=begin1; it!=end1; ++it) {
                 const Superbubble::edge_descriptor se = *it;
                 const SuperbubbleEdge& sEdge = superbubble[se];
@@ -3678,20 +4116,7 @@ void AssemblyGraph2::handleSuperbubble1(
                     containsSecondaryEdges1 = true;
                 }
             }
-            edge_descriptor eNew;
-            bool edgeWasAdded = false;
-            tie(eNew, edgeWasAdded) = add_edge(av0, av1,
-                E(nextId++,
-                markerGraphPath0, containsSecondaryEdges0,
-                markerGraphPath1, containsSecondaryEdges1),
-                g);
-            SHASTA_ASSERT(edgeWasAdded);
-            if(storeReadInformation) {
-                g[eNew].storeReadInformation(markerGraph);
-            }
-            if(assemble) {
-                AssemblyGraph2::assemble(eNew, reads);
-            }
+            changes.push_back(change);
         }
 
 
@@ -3701,22 +4126,22 @@ void AssemblyGraph2::handleSuperbubble1(
             const auto end = bestPaths[0].end();
 
             // Construct the marker graph path.
-            MarkerGraphPath markerGraphPath;
-            bool containsSecondaryEdges = false;
+            SuperbubbleChange change;
+            change.type = SuperbubbleChange::Type::addHaploidEdge;
             for(auto it=begin; it!=end; ++it) {
                 const Superbubble::edge_descriptor se = *it;
                 const SuperbubbleEdge& sEdge = superbubble[se];
                 const AssemblyGraph2::edge_descriptor ae = sEdge.ae;
                 const AssemblyGraph2Edge& aEdge = g[ae];
                 const AssemblyGraph2Edge::Branch& branch = aEdge.branches[sEdge.branchId];
-                copy(branch.path.begin(), branch.path.end(), back_inserter(markerGraphPath));
+                copy(branch.path.begin(), branch.path.end(), back_inserter(change.path0));
                 if(branch.containsSecondaryEdges) {
-                    containsSecondaryEdges = true;
+                    change.containsSecondaryEdges0 = true;
                 }
             }
 
             // Create a new haploid edge with this path.
-            addEdge(markerGraphPath, containsSecondaryEdges, storeReadInformation, assemble);
+            changes.push_back(change);
         }
 
 
@@ -3725,7 +4150,10 @@ void AssemblyGraph2::handleSuperbubble1(
         for(const Superbubble::edge_descriptor se: superbubble.chunkEdges[chunkId]) {
             const SuperbubbleEdge& sEdge = superbubble[se];
             if(sEdge.branchId == 0) {
-                boost::remove_edge(sEdge.ae, g);
+                SuperbubbleChange change;
+                change.type = SuperbubbleChange::Type::removeEdge;
+                change.e = sEdge.ae;
+                changes.push_back(change);
             }
         }
     }
@@ -4401,17 +4829,21 @@ void AssemblyGraph2::removeBadBubblesIterative(
 
 
         // Some new bubbles may form after we merge.
-        merge(true, true);
+        // Sequence for new edges is not needed here, and
+        // is assembled later for the edges that survive.
+        merge(true, false);
         gatherBubbles();
         forceMaximumPloidy(2);
 
         // Handle superbubbles that may have appeared as a result of removing bubbles.
         handleSuperbubbles0(superbubbleRemovalEdgeLengthThreshold,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true);
-        merge(true, true);
+            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, false,
+            threadCount);
+        merge(true, false);
         handleSuperbubbles1(
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true);
-        merge(true, true);
+            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, false,
+            threadCount);
+        merge(true, false);
         prune(pruneLength);
 
         performanceLog << timestamp << "Removing bad bubbles: iteration " << iteration << " ends." << endl;
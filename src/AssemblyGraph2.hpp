@@ -14,6 +14,7 @@
 
 // Standard library.
 #include <map>
+#include "span.hpp"
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -23,6 +24,7 @@ namespace shasta {
     class AssemblyGraph2;
     class AssemblyGraph2Vertex;
     class AssemblyGraph2Edge;
+    class AssemblyGraph2OrientedReadIndex;
     class AssemblyGraph2Statistics;
     class BubbleChain;
     class MarkerGraph;
@@ -78,6 +80,47 @@ public:
 
 
 
+// For each marker graph edge, the distinct oriented reads
+// of its marker intervals, sorted.
+// This is only filled in for the marker graph edges that
+// appear in the AssemblyGraph2 when the index is created.
+// It is used to compute read information for the branches of
+// the AssemblyGraph2 without scanning the marker intervals of the
+// same marker graph edges repeatedly.
+class shasta::AssemblyGraph2OrientedReadIndex {
+public:
+
+    // The oriented reads for marker graph edge edgeId are
+    // orientedReadIds[begin[edgeId], begin[edgeId+1]).
+    vector<uint64_t> begin;
+    vector<OrientedReadId> orientedReadIds;
+
+    // Return true and set the span if the marker graph edge is in the index.
+    bool find(MarkerGraph::EdgeId edgeId, span<const OrientedReadId>& s) const
+    {
+        if(edgeId + 1 >= begin.size()) {
+            return false;
+        }
+        const uint64_t b = begin[edgeId];
+        const uint64_t e = begin[edgeId + 1];
+        if(b == e) {
+            return false;
+        }
+        s = span<const OrientedReadId>(orientedReadIds.data() + b, orientedReadIds.data() + e);
+        return true;
+    }
+
+    void clear()
+    {
+        begin.clear();
+        begin.shrink_to_fit();
+        orientedReadIds.clear();
+        orientedReadIds.shrink_to_fit();
+    }
+};
+
+
+
 class shasta::AssemblyGraph2Edge {
 public:
 
@@ -107,6 +150,11 @@ public:
         // Sequence to be written to gfa.
         vector<Base> gfaSequence;
 
+        // Set if rawSequence is not up to date with the path.
+        // Sequence is assembled lazily, only for branches that
+        // survive the transformations of the AssemblyGraph2.
+        bool sequenceIsDirty = true;
+
         // The distinct oriented reads present on edges of this branch.
         // Sorted.
         vector<OrientedReadId> orientedReadIds;
@@ -121,7 +169,9 @@ public:
         }
 
         // Fill in orientedReads and average/minimum coverage.
-        void storeReadInformation(const MarkerGraph&);
+        // Marker graph edges that are not in the index
+        // are processed using their marker intervals.
+        void storeReadInformation(const MarkerGraph&, const AssemblyGraph2OrientedReadIndex&);
     };
     vector<Branch> branches;
 
@@ -134,7 +184,7 @@ public:
     void forceMaximumPloidy(uint64_t);
 
     // Store read information on all branches.
-    void storeReadInformation(const MarkerGraph&);
+    void storeReadInformation(const MarkerGraph&, const AssemblyGraph2OrientedReadIndex&);
 
     // This constructor creates an edge without any paths.
     AssemblyGraph2Edge(uint64_t id) : id(id) {}
@@ -272,6 +322,7 @@ public:
     // These must be called after storeGfaSequence,
     // but writeDetailed can be caller earlier for some combinations of flags
     // (see writeDetailedEarly).
+    // They use the compact representation of the graph (see compact()).
     void writeDetailed(
         const string& baseName,
         bool writeSequence,
@@ -320,6 +371,13 @@ public:
 private:
     MarkerGraph& markerGraph;
 
+    // The number of threads used for output.
+    size_t outputThreadCount;
+
+    // Appended to the names of GFA and FASTA files.
+    // If ".gz", they are compressed in BGZF format (see Bgzf.hpp).
+    string outputCompressionExtension;
+
     // Map that gives us the vertex descriptor corresponding to
     // each marker graph vertex.
     std::map<MarkerGraph::VertexId, vertex_descriptor> vertexMap;
@@ -341,7 +399,8 @@ private:
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
         bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        bool assemble,              // If true, assemble sequence for newly created edges
+        uint64_t threadCount
         );
 
     // This creates superbubbles using all edges not in bubble chains.
@@ -350,21 +409,85 @@ private:
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
         bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        bool assemble,              // If true, assemble sequence for newly created edges
+        uint64_t threadCount
         );
 
     class Superbubble;
 
+    // A change to the AssemblyGraph2 computed by handleSuperbubble1.
+    // The changes for a superbubble only involve edges
+    // between vertices of the superbubble, so superbubbles
+    // can be processed independently.
+    class SuperbubbleChange {
+    public:
+        enum class Type {
+            removeEdge,         // Remove edge e.
+            addHaploidEdge,     // Add a haploid edge with path0 (see addEdge).
+            addBubbleEdge       // Add an edge v0->v1 with branches path0 and path1.
+        } type;
+        edge_descriptor e;
+        vertex_descriptor v0;
+        vertex_descriptor v1;
+        MarkerGraphPath path0;
+        MarkerGraphPath path1;
+        bool containsSecondaryEdges0 = false;
+        bool containsSecondaryEdges1 = false;
+    };
+
+    // Create a superbubble for each of the given components
+    // and process it using handleSuperbubble1.
+    // If threadCount is greater than 1, the changes for all superbubbles
+    // are computed in parallel without modifying the AssemblyGraph2,
+    // then applied sequentially in the same order used when threadCount is 1,
+    // so the results do not depend on the number of threads.
+    void handleSuperbubbles(
+        const vector< vector<vertex_descriptor> >& components,
+        bool useEdgeLengthThreshold,
+        uint64_t edgeLengthThreshold,
+        uint64_t maxSuperbubbleSize,
+        uint64_t maxSuperbubbleChunkSize,
+        uint64_t maxSuperbubbleChunkPathCount,
+        bool storeReadInformation,
+        bool assemble,
+        uint64_t threadCount
+        );
+    void handleSuperbubblesThreadFunction(size_t threadId);
+    class HandleSuperbubblesData {
+    public:
+        const vector< vector<vertex_descriptor> >* components;
+        bool useEdgeLengthThreshold;
+        uint64_t edgeLengthThreshold;
+        uint64_t maxSuperbubbleSize;
+        uint64_t maxSuperbubbleChunkSize;
+        uint64_t maxSuperbubbleChunkPathCount;
+        vector< vector<SuperbubbleChange> > changes;
+    };
+    HandleSuperbubblesData handleSuperbubblesData;
+
     // This uses a dominator tree to find choking points
     // and partition the superbubble into chunks,
     // then does path enumeration on individual chunks.
+    // It computes the changes to the AssemblyGraph2 without applying them.
+    // The only AssemblyGraph2 data it modifies is the read information
+    // of the edges of the superbubble.
     void handleSuperbubble1(
         Superbubble&,
         uint64_t maxSuperbubbleSize,
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
+        vector<SuperbubbleChange>&
+        );
+
+    // Apply the changes computed by handleSuperbubble1.
+    // If newEdges is not null, read information and sequence
+    // for the newly created edges are not computed. Instead, the new edges
+    // are added to newEdges so the caller can do that later.
+    void applySuperbubbleChanges(
+        const vector<SuperbubbleChange>&,
         bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        bool assemble,              // If true, assemble sequence for newly created edges
+        vector<edge_descriptor>* newEdges
         );
 
 
@@ -443,6 +566,59 @@ private:
     };
     AssembleParallelData assembleParallelData;
 
+
+
+    // Compact representation of the graph, with contiguous storage
+    // of vertex and edge descriptors and of the connectivity.
+    // It is used by the read-only phases, so they don't
+    // have to follow the linked lists of the boost::listS adjacency_list.
+    // It is created by compact() after the phases that modify the graph,
+    // and it becomes stale as soon as the graph is modified again,
+    // so it must be cleared by clearCompact() before that happens.
+    // Edges are stored in the same order used by BGL_FORALL_EDGES,
+    // so the output does not depend on whether or not it is used.
+    class CompactGraph {
+    public:
+        bool isValid = false;
+
+        // Vertices and edges.
+        vector<vertex_descriptor> vertices;
+        vector<edge_descriptor> edges;
+
+        // The source and target vertex index of each edge.
+        vector<uint64_t> sources;
+        vector<uint64_t> targets;
+
+        // The indexes of the out-edges of vertex iv are
+        // outEdges[outEdgesBegin[iv]] through outEdges[outEdgesBegin[iv+1]-1],
+        // and similarly for the in-edges.
+        vector<uint64_t> outEdgesBegin;
+        vector<uint64_t> outEdges;
+        vector<uint64_t> inEdgesBegin;
+        vector<uint64_t> inEdges;
+
+        uint64_t outDegree(uint64_t iv) const
+        {
+            return outEdgesBegin[iv + 1] - outEdgesBegin[iv];
+        }
+        uint64_t inDegree(uint64_t iv) const
+        {
+            return inEdgesBegin[iv + 1] - inEdgesBegin[iv];
+        }
+        edge_descriptor firstOutEdge(uint64_t iv) const
+        {
+            return edges[outEdges[outEdgesBegin[iv]]];
+        }
+        edge_descriptor firstInEdge(uint64_t iv) const
+        {
+            return edges[inEdges[inEdgesBegin[iv]]];
+        }
+        void clear();
+    };
+    CompactGraph compactGraph;
+    void compact();
+    void clearCompact();
+
     // Assemble sequence for every marker graph path of a given edge.
     void assemble(edge_descriptor, const Reads&);
 
@@ -484,6 +660,20 @@ private:
     };
     StoreReadInformationParallelData storeReadInformationParallelData;
 
+    // Index used to compute read information.
+    // It is created once, from the marker graph edges of all
+    // branches, and used by all calls to storeReadInformation.
+    AssemblyGraph2OrientedReadIndex orientedReadIndex;
+    void createOrientedReadIndex(uint64_t threadCount);
+    void createOrientedReadIndexThreadFunction1(size_t threadId);
+    void createOrientedReadIndexThreadFunction2(size_t threadId);
+    class CreateOrientedReadIndexData {
+    public:
+        // For each marker graph edge, 1 if it is used by a branch.
+        vector<uint8_t> isUsed;
+    };
+    CreateOrientedReadIndexData createOrientedReadIndexData;
+
 
     // Linear chains of bubbles in the AssemblyGraph2.
     vector<BubbleChain> bubbleChains;
@@ -2,6 +2,7 @@
 #include "AssemblyPathGraph.hpp"
 #include "deduplicate.hpp"
 #include "html.hpp"
+#include "MarkerGraph.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -12,9 +13,13 @@ using namespace shasta;
 #include "fstream.hpp"
 #include <set>
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<AssemblyPathGraph>;
 
 
-AssemblyPathGraph::AssemblyPathGraph(const AssemblyGraph& assemblyGraph)
+
+AssemblyPathGraph::AssemblyPathGraph(const AssemblyGraph& assemblyGraph) :
+    MultithreadedObject<AssemblyPathGraph>(*this)
 {
     AssemblyPathGraph& graph = *this;
 
@@ -186,32 +191,144 @@ void AssemblyPathGraph::writeGraphviz(ostream& s) const
 
 
 
+// Fill in the oriented read ids and path length of each edge.
+void AssemblyPathGraph::fillOrientedReadIds(
+    const AssemblyGraph& assemblyGraph,
+    const MarkerGraph& markerGraph,
+    size_t threadCount)
+{
+    AssemblyPathGraph& graph = *this;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    threadData.assemblyGraph = &assemblyGraph;
+    threadData.markerGraph = &markerGraph;
+    threadData.edges.clear();
+    BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
+        threadData.edges.push_back(e);
+    }
+
+    setupLoadBalancing(threadData.edges.size(), 100);
+    runThreads(&AssemblyPathGraph::fillOrientedReadIdsThreadFunction, threadCount);
+
+    threadData.edges.clear();
+    threadData.assemblyGraph = 0;
+    threadData.markerGraph = 0;
+}
+
+
+
+void AssemblyPathGraph::fillOrientedReadIdsThreadFunction(size_t /* threadId */)
+{
+    AssemblyPathGraph& graph = *this;
+    const AssemblyGraph& assemblyGraph = *threadData.assemblyGraph;
+    const MarkerGraph& markerGraph = *threadData.markerGraph;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            AssemblyPathGraphEdge& edge = graph[threadData.edges[i]];
+
+            // At this stage the path must be a single assembly graph edge.
+            SHASTA_ASSERT(edge.path.size() == 1);
+            const AssemblyGraph::EdgeId edgeId = edge.path.front();
+
+            // Get the marker graph edges corresponding to this assembly graph edge.
+            const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
+            edge.orientedReadIds.clear();
+
+            if(assemblyGraph.orientedReadsByEdge.isOpen()) {
+
+                // Use the stored oriented reads of this assembly graph edge,
+                // which are sorted by OrientedReadId.
+                // Only keep the ones that appear on its marker graph edges.
+                for(const AssemblyGraph::OrientedReadInfo& info: assemblyGraph.orientedReadsByEdge[edgeId]) {
+                    if(info.edgeCount > 0) {
+                        edge.orientedReadIds.push_back(info.orientedReadId);
+                    }
+                }
+            } else {
+
+                // Loop over these marker graph edges and their marker intervals.
+                for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
+                    const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
+                    for(const MarkerInterval& markerInterval: markerIntervals) {
+                        edge.orientedReadIds.push_back(markerInterval.orientedReadId);
+                    }
+                }
+                deduplicate(edge.orientedReadIds);
+            }
+
+            // Also store the path length, measured on the marker graph.
+            edge.pathLength = markerGraphEdgeIds.size();
+        }
+    }
+}
+
+
+
 // Initial creation of all tangles.
-void AssemblyPathGraph::createTangles()
+void AssemblyPathGraph::createTangles(size_t threadCount)
 {
     AssemblyPathGraph& graph = *this;
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     // Just in case, clean up.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
         graph[e].clearTangles();
     }
     tangles.clear();
+    priorityIndex.clear();
     nextTangleId = 0;
 
     // Create the tangles.
+    // This only depends on the graph structure, so the
+    // tangle matrices can be computed later, in parallel.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, false);
+    }
+
+    // Compute the tangle matrices in parallel.
+    threadData.tangles.clear();
+    for(auto& p: tangles) {
+        threadData.tangles.push_back(&p.second);
     }
+    setupLoadBalancing(threadData.tangles.size(), 100);
+    runThreads(&AssemblyPathGraph::evaluateTanglesThreadFunction, threadCount);
+    for(const Tangle* tangle: threadData.tangles) {
+        addToPriorityIndex(*tangle);
+    }
+    threadData.tangles.clear();
+
     cout << "Found " << tangles.size() << " tangles." << endl;
 }
 
 
 
+void AssemblyPathGraph::evaluateTanglesThreadFunction(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            evaluateTangle(*threadData.tangles[i]);
+        }
+    }
+}
+
+
+
 // Create a new tangle that has the specified edge
 // as the tangle edge, if such a tangle is valid
 // and does not already exist.
 // Return true if the new tangle was created.
-bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
+bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01, bool evaluate)
 {
     AssemblyPathGraph& graph = *this;
 
@@ -244,9 +361,6 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
         return false;
     }
 
-    const auto inDegree = in_degree(v0, graph);
-    const auto outDegree = out_degree(v1, graph);
-
     Tangle tangle;
     tangle.edge = e01;
     SHASTA_ASSERT(graph[e01].tangle == invalidTangleId);
@@ -266,6 +380,31 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
 
 
 
+    // Compute the tangle matrix, unless the caller will do it.
+    if(evaluate) {
+        evaluateTangle(tangle);
+    }
+
+    tangle.tangleId = nextTangleId;
+    tangles.insert(make_pair(nextTangleId++, tangle));
+    if(evaluate) {
+        addToPriorityIndex(tangle);
+    }
+    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
+
+    return true;
+}
+
+
+
+// Compute the tangle matrix, find if the tangle is solvable,
+// and compute its priority.
+void AssemblyPathGraph::evaluateTangle(Tangle& tangle)
+{
+    const AssemblyPathGraph& graph = *this;
+    const uint64_t inDegree = tangle.inDegree();
+    const uint64_t outDegree = tangle.outDegree();
+
     // Compute the tangle matrix, which contains the number of common oriented reads
     // for each pair of in-edges and out-edges.
     vector<OrientedReadId> commonOrientedReadIds;
@@ -287,12 +426,6 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
     // is solvable, and if it is we can compute its priority.
     tangle.findIfSolvable();
     tangle.computePriority();
-
-    tangle.tangleId = nextTangleId;
-    tangles.insert(make_pair(nextTangleId++, tangle));
-    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
-
-    return true;
 }
 
 
@@ -404,11 +537,13 @@ void AssemblyPathGraph::detangle(
         for(const edge_descriptor e: newEdges) {
             createTanglesInvolvingEdge(e);
         }
-
-        // Remove any vertices that were left isolated.
-        removeIsolatedVertices();
     }
 
+    // Remove any vertices that were left isolated.
+    // Isolated vertices cannot participate in tangles,
+    // so this does not need to be done at each iteration.
+    removeIsolatedVertices();
+
     graph.writeGraphviz("AssemblyPathGraph-Final.dot");
     graph.writeHtml("AssemblyPathGraph-Final.html");
     graph.writeGfa("AssemblyPathGraph-Final.gfa", basesPerMarker);
@@ -566,6 +701,7 @@ void AssemblyPathGraph::detangle(
     remove_vertex(v1, graph);
 
     // Finally we can remove this tangle.
+    removeFromPriorityIndex(tangle);
     tangles.erase(tangleId);
 
 }
@@ -639,10 +775,8 @@ void AssemblyPathGraph::detangleCollidingComplementaryPair(
     if(BFollowsA and AFollowsB) {
         // This is a horrible mess where the two tangles follow each other.
         // Just mark both of them as unsolvable.
-        tangleA.isSolvable = false;
-        tangleB.isSolvable = false;
-        tangleA.priority = 0;
-        tangleB.priority = 0;
+        markUnsolvable(tangleA);
+        markUnsolvable(tangleB);
         /*
         cout << "Colliding pair of reverse complement tangles " <<
             tangleIdA << " " << tangleIdB <<
@@ -825,6 +959,8 @@ void AssemblyPathGraph::detangleCollidingComplementaryPair(
 
 
     // Finally we can remove these two tangles.
+    removeFromPriorityIndex(tangle0);
+    removeFromPriorityIndex(tangle1);
     tangles.erase(tangleId0);
     tangles.erase(tangleId1);
 }
@@ -854,6 +990,7 @@ void AssemblyPathGraph::removeTangle(TangleId tangleId)
     }
 
     // Now we can remove the tangle.
+    removeFromPriorityIndex(tangle);
     tangles.erase(tangleId);
 }
 
@@ -1002,26 +1139,39 @@ void Tangle::computePriority()
 
 
 // Return the next tangle to work on.
-// This does a linear search, which could be eliminated
-// with appropriated data structures if it becomes a
-// performance problem.
-
+// This is the first tangle in the priority index.
 TangleId AssemblyPathGraph::findNextTangle() const
 {
+    if(priorityIndex.empty()) {
+        return invalidTangleId;
+    } else {
+        return priorityIndex.begin()->second;
+    }
+}
 
-    TangleId bestTangleId = invalidTangleId;
-    uint64_t bestPriority = 0;
-    for(const auto& p: tangles) {
-        const Tangle& tangle = p.second;
-        if(not tangle.isSolvable) {
-            continue;
-        }
-        if(tangle.priority > bestPriority) {
-            bestPriority = tangle.priority;
-            bestTangleId = tangle.tangleId;
-        }
+
+
+void AssemblyPathGraph::addToPriorityIndex(const Tangle& tangle)
+{
+    if(tangle.isSolvable and tangle.priority > 0) {
+        priorityIndex.insert(make_pair(tangle.priority, tangle.tangleId));
     }
-    return bestTangleId;
+}
+
+
+
+void AssemblyPathGraph::removeFromPriorityIndex(const Tangle& tangle)
+{
+    priorityIndex.erase(make_pair(tangle.priority, tangle.tangleId));
+}
+
+
+
+void AssemblyPathGraph::markUnsolvable(Tangle& tangle)
+{
+    removeFromPriorityIndex(tangle);
+    tangle.isSolvable = false;
+    tangle.priority = 0;
 }
 
 
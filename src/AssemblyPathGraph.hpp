@@ -95,6 +95,7 @@ there is no such tangle.
 
 // Shasta.
 #include "AssemblyGraph.hpp"
+#include "MultithreadedObject.hpp"
 #include "ReadId.hpp"
 
 // Boost libraries.
@@ -104,6 +105,7 @@ there is no such tangle.
 #include "algorithm.hpp"
 #include "iosfwd.hpp"
 #include <map>
+#include <set>
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -129,6 +131,8 @@ namespace shasta {
         const AssemblyPathGraphEdge&);
 
     class AssemblyGraph;
+    class MarkerGraph;
+    extern template class MultithreadedObject<AssemblyPathGraph>;
 }
 
 
@@ -256,7 +260,9 @@ public:
 
 
 
-class shasta::AssemblyPathGraph : public AssemblyPathGraphBaseClass {
+class shasta::AssemblyPathGraph :
+    public AssemblyPathGraphBaseClass,
+    public MultithreadedObject<AssemblyPathGraph> {
 public:
 
     // The constructor does not fill in the oriented read ids for each edge.
@@ -275,8 +281,14 @@ public:
         const vector<edge_descriptor>& newEdges,
         const AssemblyGraph&);
 
+    // Fill in the oriented read ids and path length of each edge,
+    // using multiple threads.
+    // At this stage each edge must correspond to a single assembly graph edge.
+    void fillOrientedReadIds(const AssemblyGraph&, const MarkerGraph&, size_t threadCount);
+
     // Initial creation of all tangles.
-    void createTangles();
+    // The tangle matrices are computed in parallel.
+    void createTangles(size_t threadCount);
 
     // Create tangles involving a given edge.
     // This can create up to two tangles involving
@@ -289,7 +301,35 @@ public:
     // as the tangle edge, if such a tangle is valid
     // and does not already exist.
     // Return true if the new tangle was created.
-    bool createTangleAtEdge(edge_descriptor e);
+    // If evaluate is false, the caller is responsible for
+    // calling evaluateTangle and addToPriorityIndex for the new tangle.
+    bool createTangleAtEdge(edge_descriptor e, bool evaluate = true);
+
+    // Compute the tangle matrix, find if the tangle is solvable,
+    // and compute its priority.
+    // This only reads the graph, so it can be called
+    // for multiple tangles at the same time.
+    void evaluateTangle(Tangle&);
+
+    // The solvable tangles with non-zero priority, ordered
+    // by decreasing priority, then by increasing tangle id.
+    // This is the order in which detangling processes them.
+    class PriorityOrder {
+    public:
+        bool operator()(
+            const pair<uint64_t, TangleId>& x,
+            const pair<uint64_t, TangleId>& y) const
+        {
+            if(x.first != y.first) {
+                return x.first > y.first;
+            }
+            return x.second < y.second;
+        }
+    };
+    std::set<pair<uint64_t, TangleId>, PriorityOrder> priorityIndex;
+    void addToPriorityIndex(const Tangle&);
+    void removeFromPriorityIndex(const Tangle&);
+    void markUnsolvable(Tangle&);
 
     // Return the next tangle to work on.
     TangleId findNextTangle() const;
@@ -341,6 +381,18 @@ public:
 
 private:
     void removeIsolatedVertices();
+
+    // Data and functions used by the multithreaded code.
+    class ThreadData {
+    public:
+        const AssemblyGraph* assemblyGraph = 0;
+        const MarkerGraph* markerGraph = 0;
+        vector<edge_descriptor> edges;
+        vector<Tangle*> tangles;
+    };
+    ThreadData threadData;
+    void fillOrientedReadIdsThreadFunction(size_t threadId);
+    void evaluateTanglesThreadFunction(size_t threadId);
 };
 
 
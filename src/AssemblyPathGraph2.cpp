@@ -2,6 +2,7 @@
 #include "AssemblyPathGraph2.hpp"
 #include "deduplicate.hpp"
 #include "html.hpp"
+#include "MarkerGraph.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -12,6 +13,9 @@ using namespace shasta;
 #include "fstream.hpp"
 #include <set>
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<AssemblyPathGraph2>;
+
 
 
 AssemblyPathGraph2::AssemblyPathGraph2(
@@ -19,6 +23,7 @@ AssemblyPathGraph2::AssemblyPathGraph2(
     uint64_t diagonalReadCountMin,
     uint64_t offDiagonalReadCountMax,
     double detangleOffDiagonalRatio) :
+    MultithreadedObject<AssemblyPathGraph2>(*this),
     diagonalReadCountMin(diagonalReadCountMin),
     offDiagonalReadCountMax(offDiagonalReadCountMax),
     detangleOffDiagonalRatio(detangleOffDiagonalRatio)
@@ -193,32 +198,144 @@ void AssemblyPathGraph2::writeGraphviz(ostream& s) const
 
 
 
+// Fill in the oriented read ids and path length of each edge.
+void AssemblyPathGraph2::fillOrientedReadIds(
+    const AssemblyGraph& assemblyGraph,
+    const MarkerGraph& markerGraph,
+    size_t threadCount)
+{
+    AssemblyPathGraph2& graph = *this;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    threadData.assemblyGraph = &assemblyGraph;
+    threadData.markerGraph = &markerGraph;
+    threadData.edges.clear();
+    BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
+        threadData.edges.push_back(e);
+    }
+
+    setupLoadBalancing(threadData.edges.size(), 100);
+    runThreads(&AssemblyPathGraph2::fillOrientedReadIdsThreadFunction, threadCount);
+
+    threadData.edges.clear();
+    threadData.assemblyGraph = 0;
+    threadData.markerGraph = 0;
+}
+
+
+
+void AssemblyPathGraph2::fillOrientedReadIdsThreadFunction(size_t /* threadId */)
+{
+    AssemblyPathGraph2& graph = *this;
+    const AssemblyGraph& assemblyGraph = *threadData.assemblyGraph;
+    const MarkerGraph& markerGraph = *threadData.markerGraph;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            AssemblyPathGraph2Edge& edge = graph[threadData.edges[i]];
+
+            // At this stage the path must be a single assembly graph edge.
+            SHASTA_ASSERT(edge.path.size() == 1);
+            const AssemblyGraph::EdgeId edgeId = edge.path.front();
+
+            // Get the marker graph edges corresponding to this assembly graph edge.
+            const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
+            edge.orientedReadIds.clear();
+
+            if(assemblyGraph.orientedReadsByEdge.isOpen()) {
+
+                // Use the stored oriented reads of this assembly graph edge,
+                // which are sorted by OrientedReadId.
+                // Only keep the ones that appear on its marker graph edges.
+                for(const AssemblyGraph::OrientedReadInfo& info: assemblyGraph.orientedReadsByEdge[edgeId]) {
+                    if(info.edgeCount > 0) {
+                        edge.orientedReadIds.push_back(info.orientedReadId);
+                    }
+                }
+            } else {
+
+                // Loop over these marker graph edges and their marker intervals.
+                for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
+                    const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
+                    for(const MarkerInterval& markerInterval: markerIntervals) {
+                        edge.orientedReadIds.push_back(markerInterval.orientedReadId);
+                    }
+                }
+                deduplicate(edge.orientedReadIds);
+            }
+
+            // Also store the path length, measured on the marker graph.
+            edge.pathLength = markerGraphEdgeIds.size();
+        }
+    }
+}
+
+
+
 // Initial creation of all tangles.
-void AssemblyPathGraph2::createTangles()
+void AssemblyPathGraph2::createTangles(size_t threadCount)
 {
     AssemblyPathGraph2& graph = *this;
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     // Just in case, clean up.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
         graph[e].clearTangles();
     }
     tangles.clear();
+    priorityQueue = std::priority_queue<PriorityQueueEntry>();
     nextTangleId = 0;
 
     // Create the tangles.
+    // This only depends on the graph structure, so the
+    // tangle matrices can be computed later, in parallel.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, false);
     }
+
+    // Compute the tangle matrices in parallel.
+    threadData.tangles.clear();
+    for(auto& p: tangles) {
+        threadData.tangles.push_back(&p.second);
+    }
+    setupLoadBalancing(threadData.tangles.size(), 100);
+    runThreads(&AssemblyPathGraph2::evaluateTanglesThreadFunction, threadCount);
+    for(const Tangle2* tangle: threadData.tangles) {
+        addToPriorityIndex(*tangle);
+    }
+    threadData.tangles.clear();
+
     cout << "Found " << tangles.size() << " tangles." << endl;
 }
 
 
 
+void AssemblyPathGraph2::evaluateTanglesThreadFunction(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            evaluateTangle(*threadData.tangles[i]);
+        }
+    }
+}
+
+
+
 // Create a new tangle that has the specified edge
 // as the tangle edge, if such a tangle is valid
 // and does not already exist.
 // Return true if the new tangle was created.
-bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
+bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01, bool evaluate)
 {
     AssemblyPathGraph2& graph = *this;
 
@@ -251,9 +368,6 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
         return false;
     }
 
-    const auto inDegree = in_degree(v0, graph);
-    const auto outDegree = out_degree(v1, graph);
-
     Tangle2 tangle;
     tangle.edge = e01;
     SHASTA_ASSERT(graph[e01].tangle == invalidTangle2Id);
@@ -273,6 +387,31 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
 
 
 
+    // Compute the tangle matrix, unless the caller will do it.
+    if(evaluate) {
+        evaluateTangle(tangle);
+    }
+
+    tangle.tangleId = nextTangleId;
+    tangles.insert(make_pair(nextTangleId++, tangle));
+    if(evaluate) {
+        addToPriorityIndex(tangle);
+    }
+    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
+
+    return true;
+}
+
+
+
+// Compute the tangle matrix, find if the tangle is solvable,
+// and compute its priority.
+void AssemblyPathGraph2::evaluateTangle(Tangle2& tangle)
+{
+    const AssemblyPathGraph2& graph = *this;
+    const uint64_t inDegree = tangle.inDegree();
+    const uint64_t outDegree = tangle.outDegree();
+
     // Compute the tangle matrix, which contains the number of common oriented reads
     // for each pair of in-edges and out-edges.
     vector<OrientedReadId> commonOrientedReadIds;
@@ -297,12 +436,6 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
         offDiagonalReadCountMax,
         detangleOffDiagonalRatio);
     tangle.computePriority();
-
-    tangle.tangleId = nextTangleId;
-    tangles.insert(make_pair(nextTangleId++, tangle));
-    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
-
-    return true;
 }
 
 
@@ -414,11 +547,13 @@ void AssemblyPathGraph2::detangle(
         for(const edge_descriptor e: newEdges) {
             createTanglesInvolvingEdge(e);
         }
-
-        // Remove any vertices that were left isolated.
-        removeIsolatedVertices();
     }
 
+    // Remove any vertices that were left isolated.
+    // Isolated vertices cannot participate in tangles,
+    // so this does not need to be done at each iteration.
+    removeIsolatedVertices();
+
     // graph.writeGraphviz("AssemblyPathGraph2-Final.dot");
     // graph.writeHtml("AssemblyPathGraph2-Final.html");
     // graph.writeGfa("AssemblyPathGraph2-Final.gfa", basesPerMarker);
@@ -568,6 +703,7 @@ void AssemblyPathGraph2::detangle(
     remove_vertex(v1, graph);
 
     // Finally we can remove this tangle.
+    removeFromPriorityIndex(tangle);
     tangles.erase(tangleId);
 
 }
@@ -643,10 +779,8 @@ void AssemblyPathGraph2::detangleCollidingComplementaryPair(
         // but it can actually happen in tangles with in-degree/out-degree
         // greater than 2.
         // Just mark both of them as unsolvable.
-        tangleA.isSolvable = false;
-        tangleB.isSolvable = false;
-        tangleA.priority = 0;
-        tangleB.priority = 0;
+        markUnsolvable(tangleA);
+        markUnsolvable(tangleB);
         /*
         cout << "Unusual arrangement of colliding pair of reverse complement tangles " <<
             tangleIdA << " " << tangleIdB <<
@@ -657,10 +791,8 @@ void AssemblyPathGraph2::detangleCollidingComplementaryPair(
     if(BFollowsA and AFollowsB) {
         // This is a horrible mess where the two tangles follow each other.
         // Just mark both of them as unsolvable.
-        tangleA.isSolvable = false;
-        tangleB.isSolvable = false;
-        tangleA.priority = 0;
-        tangleB.priority = 0;
+        markUnsolvable(tangleA);
+        markUnsolvable(tangleB);
         /*
         cout << "Colliding pair of reverse complement tangles " <<
             tangleIdA << " " << tangleIdB <<
@@ -681,8 +813,8 @@ void AssemblyPathGraph2::detangleCollidingComplementaryPair(
         SHASTA_ASSERT(BFollowsA);
     }
     // cout << "Tangle2 " << tangleId1 << " follows tangle " << tangleId0 << endl;
-    const Tangle2& tangle0 = getTangle(tangleId0);
-    const Tangle2& tangle1 = getTangle(tangleId1);
+    Tangle2& tangle0 = getTangle(tangleId0);
+    Tangle2& tangle1 = getTangle(tangleId1);
 
 
     // At this point, we know that tangle 1 follows tangle0.
@@ -833,6 +965,8 @@ void AssemblyPathGraph2::detangleCollidingComplementaryPair(
 
 
     // Finally we can remove these two tangles.
+    removeFromPriorityIndex(tangle0);
+    removeFromPriorityIndex(tangle1);
     tangles.erase(tangleId0);
     tangles.erase(tangleId1);
 }
@@ -842,7 +976,7 @@ void AssemblyPathGraph2::detangleCollidingComplementaryPair(
 void AssemblyPathGraph2::removeTangle(Tangle2Id tangleId)
 {
     AssemblyPathGraph2& graph = *this;
-    const Tangle2& tangle = getTangle(tangleId);
+    Tangle2& tangle = getTangle(tangleId);
 
     // Remove all references to this tangle.
     graph[tangle.edge].tangle = invalidTangle2Id;
@@ -862,6 +996,7 @@ void AssemblyPathGraph2::removeTangle(Tangle2Id tangleId)
     }
 
     // Now we can remove the tangle.
+    removeFromPriorityIndex(tangle);
     tangles.erase(tangleId);
 }
 
@@ -1132,26 +1267,45 @@ void Tangle2::computePriority()
 
 
 // Return the next tangle to work on.
-// This does a linear search, which could be eliminated
-// with appropriated data structures if it becomes a
-// performance problem.
-
-Tangle2Id AssemblyPathGraph2::findNextTangle() const
+// This is the first tangle in the priority index.
+Tangle2Id AssemblyPathGraph2::findNextTangle()
 {
-
-    Tangle2Id bestTangleId = invalidTangle2Id;
-    uint64_t bestPriority = 0;
-    for(const auto& p: tangles) {
-        const Tangle2& tangle = p.second;
-        if(not tangle.isSolvable) {
-            continue;
-        }
-        if(tangle.priority > bestPriority) {
-            bestPriority = tangle.priority;
-            bestTangleId = tangle.tangleId;
+    while(not priorityQueue.empty()) {
+        const PriorityQueueEntry& entry = priorityQueue.top();
+        const auto it = tangles.find(entry.tangleId);
+        if(it != tangles.end() and it->second.priorityVersion == entry.priorityVersion) {
+            return entry.tangleId;
         }
+        priorityQueue.pop();
     }
-    return bestTangleId;
+    return invalidTangle2Id;
+}
+
+
+
+void AssemblyPathGraph2::addToPriorityIndex(const Tangle2& tangle)
+{
+    if(tangle.isSolvable and tangle.priority > 0) {
+        priorityQueue.push({tangle.priority, tangle.tangleId, tangle.priorityVersion});
+    }
+}
+
+
+
+// This invalidates the priority queue entries for this tangle.
+// They will be discarded by findNextTangle.
+void AssemblyPathGraph2::removeFromPriorityIndex(Tangle2& tangle)
+{
+    ++tangle.priorityVersion;
+}
+
+
+
+void AssemblyPathGraph2::markUnsolvable(Tangle2& tangle)
+{
+    removeFromPriorityIndex(tangle);
+    tangle.isSolvable = false;
+    tangle.priority = 0;
 }
 
 
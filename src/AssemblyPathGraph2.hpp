@@ -99,6 +99,7 @@ there is no such tangle.
 
 // Shasta.
 #include "AssemblyGraph.hpp"
+#include "MultithreadedObject.hpp"
 #include "ReadId.hpp"
 
 // Boost libraries.
@@ -108,6 +109,7 @@ there is no such tangle.
 #include "algorithm.hpp"
 #include "iosfwd.hpp"
 #include <map>
+#include <queue>
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -133,6 +135,8 @@ namespace shasta {
         const AssemblyPathGraph2Edge&);
 
     class AssemblyGraph;
+    class MarkerGraph;
+    extern template class MultithreadedObject<AssemblyPathGraph2>;
 }
 
 
@@ -272,11 +276,17 @@ public:
     // matrix. Solvable tangles are processed in order of decreasing priority.
     uint64_t priority = 0;
     void computePriority();
+
+    // Incremented each time the tangle is removed from the priority queue.
+    // This invalidates the priority queue entries for this tangle.
+    uint64_t priorityVersion = 0;
 };
 
 
 
-class shasta::AssemblyPathGraph2 : public AssemblyPathGraph2BaseClass {
+class shasta::AssemblyPathGraph2 :
+    public AssemblyPathGraph2BaseClass,
+    public MultithreadedObject<AssemblyPathGraph2> {
 public:
 
     // The constructor does not fill in the oriented read ids for each edge.
@@ -304,8 +314,14 @@ public:
         const vector<edge_descriptor>& newEdges,
         const AssemblyGraph&);
 
+    // Fill in the oriented read ids and path length of each edge,
+    // using multiple threads.
+    // At this stage each edge must correspond to a single assembly graph edge.
+    void fillOrientedReadIds(const AssemblyGraph&, const MarkerGraph&, size_t threadCount);
+
     // Initial creation of all tangles.
-    void createTangles();
+    // The tangle matrices are computed in parallel.
+    void createTangles(size_t threadCount);
 
     // Create tangles involving a given edge.
     // This can create up to two tangles involving
@@ -318,10 +334,47 @@ public:
     // as the tangle edge, if such a tangle is valid
     // and does not already exist.
     // Return true if the new tangle was created.
-    bool createTangleAtEdge(edge_descriptor e);
+    // If evaluate is false, the caller is responsible for
+    // calling evaluateTangle and addToPriorityIndex for the new tangle.
+    bool createTangleAtEdge(edge_descriptor e, bool evaluate = true);
+
+    // Compute the tangle matrix, find if the tangle is solvable,
+    // and compute its priority.
+    // This only reads the graph, so it can be called
+    // for multiple tangles at the same time.
+    void evaluateTangle(Tangle2&);
+
+    // A priority queue of the solvable tangles with non-zero priority.
+    // The top entry has the highest priority and, among those,
+    // the lowest tangle id. This is the order in which detangling processes them.
+    // Entries are not removed from the queue when a tangle is
+    // removed or changes priority. Instead, removeFromPriorityIndex
+    // increments the priorityVersion of the tangle, and findNextTangle
+    // discards entries for tangles that no longer exist
+    // or have a different priorityVersion.
+    class PriorityQueueEntry {
+    public:
+        uint64_t priority;
+        Tangle2Id tangleId;
+        uint64_t priorityVersion;
+
+        // The top of the std::priority_queue is the largest entry.
+        bool operator<(const PriorityQueueEntry& that) const
+        {
+            if(priority != that.priority) {
+                return priority < that.priority;
+            }
+            return tangleId > that.tangleId;
+        }
+    };
+    std::priority_queue<PriorityQueueEntry> priorityQueue;
+    void addToPriorityIndex(const Tangle2&);
+    void removeFromPriorityIndex(Tangle2&);
+    void markUnsolvable(Tangle2&);
 
     // Return the next tangle to work on.
-    Tangle2Id findNextTangle() const;
+    // This discards invalidated entries at the top of the priority queue.
+    Tangle2Id findNextTangle();
 
     // Return true if a tangle collides with its reverse complement.
     bool collidesWithReverseComplement(Tangle2Id) const;
@@ -370,6 +423,18 @@ public:
 
 private:
     void removeIsolatedVertices();
+
+    // Data and functions used by the multithreaded code.
+    class ThreadData {
+    public:
+        const AssemblyGraph* assemblyGraph = 0;
+        const MarkerGraph* markerGraph = 0;
+        vector<edge_descriptor> edges;
+        vector<Tangle2*> tangles;
+    };
+    ThreadData threadData;
+    void fillOrientedReadIdsThreadFunction(size_t threadId);
+    void evaluateTanglesThreadFunction(size_t threadId);
 };
 
 
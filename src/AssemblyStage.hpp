@@ -0,0 +1,38 @@
+#ifndef SHASTA_ASSEMBLY_STAGE_HPP
+#define SHASTA_ASSEMBLY_STAGE_HPP
+
+// The stages of an assembly.
+// When a stage completes, it stores in AssemblerInfo::checkpointHash
+// a hash of the options used by that stage and all previous stages.
+// This is used by --resumeFrom to skip stages that already completed,
+// and by the http server to decide which data are available
+// when exploring an assembly that is still running.
+
+#include "array.hpp"
+#include "cstdint.hpp"
+#include "string.hpp"
+
+namespace shasta {
+
+    enum class AssemblyStage {
+        reads,
+        markers,
+        alignmentCandidates,
+        alignments,
+        readGraph,
+        assembly,       // Everything after the read graph is created.
+        count
+    };
+
+    const uint64_t assemblyStageCount = uint64_t(AssemblyStage::count);
+
+    const array<string, assemblyStageCount> assemblyStageNames = {
+        "reads",
+        "markers",
+        "alignmentCandidates",
+        "alignments",
+        "readGraph",
+        "assembly"};
+}
+
+#endif
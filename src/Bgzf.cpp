@@ -0,0 +1,359 @@
+// Shasta.
+#include "Bgzf.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cstring>
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include <zlib.h>
+
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<BgzfStreamBuffer>;
+
+
+
+// Open an output file, using BGZF compression if the name ends with .gz.
+std::shared_ptr<ostream> shasta::openOutputFile(const string& fileName, size_t threadCount)
+{
+    const auto endsWith = [&fileName](const string& suffix)
+    {
+        return
+            fileName.size() >= suffix.size() and
+            fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+
+    if(endsWith(".gz")) {
+        const bool writeFastaIndex = endsWith(".fasta.gz") or endsWith(".fa.gz");
+        return std::make_shared<BgzfOutputStream>(fileName, threadCount, writeFastaIndex);
+    } else {
+        return std::make_shared<ofstream>(fileName);
+    }
+}
+
+
+
+BgzfStreamBuffer::BgzfStreamBuffer(
+    const string& fileName,
+    size_t threadCount,
+    bool writeFastaIndex) :
+    MultithreadedObject<BgzfStreamBuffer>(*this),
+    fileName(fileName),
+    threadCount(threadCount),
+    writeFastaIndex(writeFastaIndex)
+{
+    // Adjust the number of threads, if necessary.
+    if(threadCount == 0) {
+        this->threadCount = std::thread::hardware_concurrency();
+    }
+
+    file.open(fileName, std::ios::binary);
+    if(not file) {
+        throw runtime_error("Error opening " + fileName);
+    }
+
+    // Use a few blocks per thread, so the threads are kept busy.
+    const uint64_t blockCount = 4 * this->threadCount;
+    uncompressedData.resize(blockCount * blockSize);
+    compressedBlocks.resize(blockCount);
+    setp(uncompressedData.data(), uncompressedData.data() + uncompressedData.size());
+}
+
+
+
+BgzfStreamBuffer::~BgzfStreamBuffer()
+{
+    if(not finished) {
+        try {
+            finish();
+        } catch(const std::exception& e) {
+            cout << "Error writing " << fileName << ": " << e.what() << endl;
+        }
+    }
+}
+
+
+
+BgzfStreamBuffer::int_type BgzfStreamBuffer::overflow(int_type c)
+{
+    if(finished) {
+        return traits_type::eof();
+    }
+    writeBlocks();
+    if(not traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+
+
+// Compress the data written so far, and write the compressed blocks.
+// All blocks are full, except possibly the last one.
+void BgzfStreamBuffer::writeBlocks()
+{
+    const char* begin = pbase();
+    const char* end = pptr();
+    const uint64_t n = end - begin;
+    if(n == 0) {
+        return;
+    }
+    if(writeFastaIndex) {
+        fastaIndexer.process(begin, end);
+    }
+
+    // Compress the blocks in parallel.
+    const uint64_t filledBlockCount = (n - 1) / blockSize + 1;
+    if(threadCount == 1 or filledBlockCount == 1) {
+        for(uint64_t i=0; i<filledBlockCount; i++) {
+            compressBlock(begin + i * blockSize, min(end, begin + (i + 1) * blockSize), compressedBlocks[i]);
+        }
+    } else {
+        setupLoadBalancing(filledBlockCount, 1);
+        runThreads(&BgzfStreamBuffer::threadFunction, min(threadCount, size_t(filledBlockCount)));
+    }
+
+    // Write the compressed blocks in order.
+    for(uint64_t i=0; i<filledBlockCount; i++) {
+        if(compressedOffset != 0) {
+            blockOffsets.push_back(make_pair(compressedOffset, uncompressedOffset));
+        }
+        const vector<char>& block = compressedBlocks[i];
+        file.write(block.data(), std::streamsize(block.size()));
+        compressedOffset += block.size();
+        uncompressedOffset += min(blockSize, n - i * blockSize);
+    }
+    if(not file) {
+        throw runtime_error("Error writing " + fileName);
+    }
+
+    setp(uncompressedData.data(), uncompressedData.data() + uncompressedData.size());
+}
+
+
+
+void BgzfStreamBuffer::threadFunction(size_t /* threadId */)
+{
+    const char* begin = pbase();
+    const char* end = pptr();
+
+    uint64_t batchBegin, batchEnd;
+    while(getNextBatch(batchBegin, batchEnd)) {
+        for(uint64_t i=batchBegin; i!=batchEnd; i++) {
+            compressBlock(begin + i * blockSize, min(end, begin + (i + 1) * blockSize), compressedBlocks[i]);
+        }
+    }
+}
+
+
+
+// Create a BGZF block containing the given data.
+void BgzfStreamBuffer::compressBlock(const char* begin, const char* end, vector<char>& block)
+{
+    const uint64_t n = end - begin;
+    SHASTA_ASSERT(n <= blockSize);
+    const uint64_t headerSize = 18;
+    const uint64_t footerSize = 8;
+
+    // Compress using raw deflate (no zlib or gzip wrapper).
+    // If the compressed data don't fit in a block,
+    // which can only happen for data that are not compressible,
+    // store them uncompressed instead.
+    uint64_t compressedSize = 0;
+    for(const int level: {Z_DEFAULT_COMPRESSION, 0}) {
+        z_stream zStream;
+        zStream.zalloc = Z_NULL;
+        zStream.zfree = Z_NULL;
+        zStream.opaque = Z_NULL;
+        if(deflateInit2(&zStream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw runtime_error("Error initializing zlib for BGZF compression.");
+        }
+        block.resize(headerSize + deflateBound(&zStream, uLong(n)) + footerSize);
+        zStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(begin));
+        zStream.avail_in = uInt(n);
+        zStream.next_out = reinterpret_cast<Bytef*>(block.data() + headerSize);
+        zStream.avail_out = uInt(block.size() - headerSize - footerSize);
+        const int status = deflate(&zStream, Z_FINISH);
+        compressedSize = zStream.total_out;
+        deflateEnd(&zStream);
+        if(status != Z_STREAM_END) {
+            throw runtime_error("Error during BGZF compression.");
+        }
+        if(headerSize + compressedSize + footerSize <= 65536) {
+            break;
+        }
+    }
+    const uint64_t totalSize = headerSize + compressedSize + footerSize;
+    SHASTA_ASSERT(totalSize <= 65536);
+    block.resize(totalSize);
+
+    // Gzip header with the BC extra field, which contains the block size minus 1.
+    const unsigned char header[headerSize] = {
+        0x1f, 0x8b, 8, 4,   // Gzip magic, deflate, FEXTRA flag.
+        0, 0, 0, 0,         // Modification time.
+        0, 0xff,            // Extra flags, operating system (unknown).
+        6, 0,               // Length of the extra field.
+        'B', 'C', 2, 0,     // Subfield identifier and length.
+        (unsigned char)((totalSize - 1) & 0xff), (unsigned char)((totalSize - 1) >> 8)};
+    std::memcpy(block.data(), header, headerSize);
+
+    // Footer: CRC32 and size of the uncompressed data, little endian.
+    const uint32_t crc = uint32_t(crc32(0, reinterpret_cast<const Bytef*>(begin), uInt(n)));
+    char* footer = block.data() + headerSize + compressedSize;
+    for(uint64_t i=0; i<4; i++) {
+        footer[i] = char((crc >> (8 * i)) & 0xff);
+        footer[4 + i] = char((n >> (8 * i)) & 0xff);
+    }
+}
+
+
+
+void BgzfStreamBuffer::finish()
+{
+    if(finished) {
+        return;
+    }
+    writeBlocks();
+    finished = true;
+
+    // The end of file marker is an empty block.
+    const unsigned char eofBlock[28] = {
+        0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+        0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    file.write(reinterpret_cast<const char*>(eofBlock), sizeof(eofBlock));
+    file.close();
+    if(not file) {
+        throw runtime_error("Error writing " + fileName);
+    }
+
+    writeGzi();
+
+    if(writeFastaIndex) {
+        fastaIndexer.finish();
+        ofstream fai(fileName + ".fai");
+        fastaIndexer.write(fai);
+    }
+}
+
+
+
+// The .gzi index contains the number of entries, then for each
+// entry the compressed and uncompressed offsets, all as
+// 64-bit little endian integers.
+void BgzfStreamBuffer::writeGzi() const
+{
+    vector<uint64_t> data;
+    data.push_back(blockOffsets.size());
+    for(const auto& p: blockOffsets) {
+        data.push_back(p.first);
+        data.push_back(p.second);
+    }
+
+    ofstream gzi(fileName + ".gzi", std::ios::binary);
+    for(const uint64_t x: data) {
+        char bytes[8];
+        for(uint64_t i=0; i<8; i++) {
+            bytes[i] = char((x >> (8 * i)) & 0xff);
+        }
+        gzi.write(bytes, 8);
+    }
+    if(not gzi) {
+        throw runtime_error("Error writing " + fileName + ".gzi");
+    }
+}
+
+
+
+// Process uncompressed FASTA data, in order.
+void FastaIndexer::process(const char* begin, const char* end)
+{
+    const char* p = begin;
+    while(p != end) {
+
+        // Beginning of a header line.
+        if(atLineStart and *p == '>') {
+            entries.emplace_back();
+            inHeader = true;
+            inName = true;
+            atLineStart = false;
+            ++p;
+            continue;
+        }
+
+        // Header line.
+        if(inHeader) {
+            const char c = *p;
+            if(c == '\n') {
+                inHeader = false;
+                atLineStart = true;
+                entries.back().offset = offset + (p + 1 - begin);
+            } else if(c == ' ' or c == '\t' or c == '\r') {
+                inName = false;
+            } else if(inName) {
+                entries.back().name.push_back(c);
+            }
+            ++p;
+            continue;
+        }
+
+        // Sequence line. Find the end of the line.
+        atLineStart = false;
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if(lineEnd == 0) {
+            currentLineBases += end - p;
+            p = end;
+        } else {
+            currentLineBases += lineEnd - p;
+            endSequenceLine();
+            atLineStart = true;
+            p = lineEnd + 1;
+        }
+    }
+    offset += end - begin;
+}
+
+
+
+// Process the last line, if it does not end with a newline.
+void FastaIndexer::finish()
+{
+    if(not atLineStart and not inHeader) {
+        endSequenceLine();
+        atLineStart = true;
+    }
+}
+
+
+
+void FastaIndexer::endSequenceLine()
+{
+    if(entries.empty()) {
+        currentLineBases = 0;
+        return;
+    }
+    Entry& entry = entries.back();
+    if(entry.lineCount == 0) {
+        entry.lineBases = currentLineBases;
+        entry.lineWidth = currentLineBases + 1;
+    }
+    entry.length += currentLineBases;
+    ++entry.lineCount;
+    currentLineBases = 0;
+}
+
+
+
+void FastaIndexer::write(ostream& s) const
+{
+    for(const Entry& entry: entries) {
+        s <<
+            entry.name << "\t" <<
+            entry.length << "\t" <<
+            entry.offset << "\t" <<
+            entry.lineBases << "\t" <<
+            entry.lineWidth << "\n";
+    }
+}
@@ -0,0 +1,171 @@
+#ifndef SHASTA_BGZF_HPP
+#define SHASTA_BGZF_HPP
+
+/*******************************************************************************
+
+Output of files compressed in BGZF format, the blocked gzip format
+used by htslib and samtools (see section 4.1 of
+https://samtools.github.io/hts-specs/SAMv1.pdf).
+
+A BGZF file is a sequence of independent gzip members (blocks),
+each containing at most 65280 bytes of uncompressed data,
+followed by an empty block that marks the end of file.
+It can be decompressed by any gzip decompressor.
+
+BgzfStreamBuffer is a stream buffer that writes a BGZF file.
+It collects the uncompressed data for a number of blocks. When
+they are all full, it compresses them in parallel and
+writes them in order. When finish is called it also writes:
+- A .gzi index, with the compressed and uncompressed offsets of the
+  beginning of each block except the first. It gives random access
+  to the uncompressed data, as created by bgzip -i.
+- Optionally, a .fai index of the uncompressed data interpreted as FASTA,
+  as created by samtools faidx, so sequences can be
+  extracted without decompressing the entire file.
+The index files are named by appending .gzi and .fai to the file name.
+
+BgzfOutputStream is an ostream that uses a BgzfStreamBuffer.
+
+openOutputFile opens an output file, using BGZF compression
+if the file name ends with .gz, and also writing a .fai index
+if it ends with .fasta.gz or .fa.gz.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "fstream.hpp"
+#include <memory>
+#include <streambuf>
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class BgzfStreamBuffer;
+    class BgzfOutputStream;
+    class FastaIndexer;
+    extern template class MultithreadedObject<BgzfStreamBuffer>;
+
+    std::shared_ptr<ostream> openOutputFile(const string& fileName, size_t threadCount);
+}
+
+
+
+// Class used by BgzfStreamBuffer to create the .fai index.
+// It processes the uncompressed data in order.
+class shasta::FastaIndexer {
+public:
+    void process(const char* begin, const char* end);
+    void finish();
+    void write(ostream&) const;
+
+private:
+
+    // The number of bytes processed so far.
+    uint64_t offset = 0;
+
+    // An entry of the .fai file.
+    class Entry {
+    public:
+        string name;
+        uint64_t length = 0;        // Number of bases.
+        uint64_t offset = 0;        // Offset of the first base.
+        uint64_t lineBases = 0;     // Number of bases in each line.
+        uint64_t lineWidth = 0;     // Number of bytes in each line, including the newline.
+        uint64_t lineCount = 0;
+    };
+    vector<Entry> entries;
+
+    bool atLineStart = true;
+    bool inHeader = false;
+    bool inName = false;
+    uint64_t currentLineBases = 0;
+    void endSequenceLine();
+};
+
+
+
+class shasta::BgzfStreamBuffer :
+    public std::streambuf,
+    public MultithreadedObject<BgzfStreamBuffer> {
+public:
+
+    // A threadCount of 0 means use all available hardware threads.
+    BgzfStreamBuffer(
+        const string& fileName,
+        size_t threadCount,
+        bool writeFastaIndex);
+    ~BgzfStreamBuffer();
+
+    // Write out the remaining data, the end of file block, and the indexes.
+    void finish();
+
+    // The maximum number of uncompressed bytes in a block.
+    static const uint64_t blockSize = 65280;
+
+protected:
+    int_type overflow(int_type) override;
+
+    // All data are written out by finish.
+    // Flushing does not write out partially filled blocks,
+    // so it does not reduce the compression ratio.
+    int sync() override
+    {
+        return 0;
+    }
+
+private:
+    string fileName;
+    ofstream file;
+    size_t threadCount;
+    bool finished = false;
+
+    // The uncompressed data for the blocks being filled,
+    // and the compressed blocks.
+    vector<char> uncompressedData;
+    vector< vector<char> > compressedBlocks;
+
+    // Compress the data written so far, and write the compressed blocks.
+    void writeBlocks();
+    void threadFunction(size_t threadId);
+    static void compressBlock(const char* begin, const char* end, vector<char>& block);
+
+    // The compressed and uncompressed offsets of the beginning
+    // of each block except the first, for the .gzi index.
+    uint64_t compressedOffset = 0;
+    uint64_t uncompressedOffset = 0;
+    vector< pair<uint64_t, uint64_t> > blockOffsets;
+    void writeGzi() const;
+
+    bool writeFastaIndex;
+    FastaIndexer fastaIndexer;
+};
+
+
+
+class shasta::BgzfOutputStream : public ostream {
+public:
+    BgzfOutputStream(
+        const string& fileName,
+        size_t threadCount,
+        bool writeFastaIndex) :
+        ostream(0),
+        buffer(fileName, threadCount, writeFastaIndex)
+    {
+        rdbuf(&buffer);
+    }
+
+    void finish()
+    {
+        buffer.finish();
+    }
+
+private:
+    BgzfStreamBuffer buffer;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SHASTA_BOUNDED_QUEUE_HPP
+#define SHASTA_BOUNDED_QUEUE_HPP
+
+// A queue with bounded capacity used to hand off work
+// from producer threads to consumer threads.
+// push blocks while the queue is full, and pop blocks
+// while the queue is empty and has not been closed.
+// After close is called, pop returns false
+// once all queued items have been consumed.
+
+// Standard library.
+#include <condition_variable>
+#include "cstdint.hpp"
+#include <deque>
+#include <mutex>
+
+namespace shasta {
+    template<class T> class BoundedQueue;
+}
+
+
+
+template<class T> class shasta::BoundedQueue {
+public:
+
+    BoundedQueue(uint64_t capacity) : capacity(capacity) {}
+
+    void push(T&& t)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]{return items.size() < capacity;});
+        items.push_back(std::move(t));
+        notEmpty.notify_one();
+    }
+
+    // Returns false if the queue was closed and is empty.
+    bool pop(T& t)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]{return isClosed or not items.empty();});
+        if(items.empty()) {
+            return false;
+        }
+        t = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isClosed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    uint64_t capacity;
+    std::deque<T> items;
+    bool isClosed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+#endif
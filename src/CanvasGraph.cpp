@@ -0,0 +1,518 @@
+// Implementation of class CanvasGraph - see CanvasGraph.hpp for more information.
+
+// Shasta.
+#include "CanvasGraph.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <iomanip>
+#include "iostream.hpp"
+#include <limits>
+
+
+
+void CanvasGraph::addPoint(
+    double x,
+    double y,
+    double radius,
+    const string& color,
+    const string& title,
+    const string& urlSuffix)
+{
+    points.push_back({x, y, radius, getColorIndex(color), title, urlSuffix});
+}
+
+
+
+void CanvasGraph::addLine(
+    double x0,
+    double y0,
+    double x1,
+    double y1,
+    double width,
+    const string& color,
+    bool hasArrow,
+    const string& title,
+    const string& urlSuffix)
+{
+    lines.push_back({x0, y0, x1, y1, width, getColorIndex(color), hasArrow, title, urlSuffix});
+}
+
+
+
+uint64_t CanvasGraph::getColorIndex(const string& color)
+{
+    const auto it = colorMap.find(color);
+    if(it != colorMap.end()) {
+        return it->second;
+    }
+    const uint64_t colorIndex = colors.size();
+    colors.push_back(color);
+    colorMap.insert(make_pair(color, colorIndex));
+    return colorIndex;
+}
+
+
+
+// Write a string as a JavaScript string literal.
+// "<" is escaped so the string cannot terminate the script element.
+static void writeJavaScriptString(ostream& html, const string& s)
+{
+    html << '"';
+    for(const char c: s) {
+        if(c == '"' or c == '\\') {
+            html << '\\' << c;
+        } else if(c == '<') {
+            html << "\\x3c";
+        } else if(c == '\n') {
+            html << "\\n";
+        } else if((unsigned char)(c) < 0x20) {
+            html << ' ';
+        } else {
+            html << c;
+        }
+    }
+    html << '"';
+}
+
+
+
+// Write a vector of strings as a JavaScript array.
+// If they are all empty, write an empty array.
+template<class T, class F> static void writeJavaScriptStrings(
+    ostream& html,
+    const vector<T>& items,
+    const F& getString)
+{
+    html << "[";
+    const bool allEmpty = std::all_of(items.begin(), items.end(),
+        [&](const T& item) {return getString(item).empty();});
+    if(not allEmpty) {
+        for(uint64_t i=0; i<items.size(); i++) {
+            if(i != 0) {
+                html << ",";
+            }
+            writeJavaScriptString(html, getString(items[i]));
+        }
+    }
+    html << "]";
+}
+
+
+
+void CanvasGraph::write(ostream& html, uint64_t sizePixels) const
+{
+    // Coordinates are rescaled so the largest dimension is 10000.
+    // This allows writing them with a single decimal digit
+    // without loss of visible precision.
+    double xMin = std::numeric_limits<double>::max();
+    double xMax = std::numeric_limits<double>::lowest();
+    double yMin = xMin;
+    double yMax = xMax;
+    for(const Point& point: points) {
+        xMin = min(xMin, point.x);
+        xMax = max(xMax, point.x);
+        yMin = min(yMin, point.y);
+        yMax = max(yMax, point.y);
+    }
+    for(const Line& line: lines) {
+        xMin = min(xMin, min(line.x0, line.x1));
+        xMax = max(xMax, max(line.x0, line.x1));
+        yMin = min(yMin, min(line.y0, line.y1));
+        yMax = max(yMax, max(line.y0, line.y1));
+    }
+    const double range = max(xMax - xMin, yMax - yMin);
+    const double factor = (range > 0.) ? 10000. / range : 1.;
+
+    html <<
+        "<div style='display:inline-block;vertical-align:top;position:relative'>"
+        "<canvas id=CanvasGraph width=" << sizePixels << " height=" << sizePixels <<
+        " style='border-style:solid;border-color:Black;border-width:1px;cursor:grab'></canvas>"
+        "<div id=CanvasGraphTooltip style='position:absolute;display:none;pointer-events:none;"
+        "background-color:white;border:1px solid grey;padding:2px;font-size:12px;white-space:nowrap'></div>"
+        "<br><button type=button onclick='canvasGraphViewer.fit()'>Fit</button>"
+        " <span style='color:grey;font-size:smaller'>"
+        "Drag to pan, use the mouse wheel to zoom, ctrl-click to follow a link.</span>"
+        "</div>";
+
+    html << "\n<script>\nvar canvasGraphData = {\ncolors:[";
+    for(uint64_t i=0; i<colors.size(); i++) {
+        if(i != 0) {
+            html << ",";
+        }
+        writeJavaScriptString(html, colors[i]);
+    }
+
+    const auto oldPrecision = html.precision(1);
+    const auto oldFlags = html.setf(std::ios_base::fixed, std::ios_base::floatfield);
+
+    // Point data: x, y, radius, color index.
+    html << "],\npoints:[";
+    for(uint64_t i=0; i<points.size(); i++) {
+        const Point& point = points[i];
+        if(i != 0) {
+            html << ",";
+        }
+        html <<
+            (point.x - xMin) * factor << "," <<
+            (point.y - yMin) * factor << "," <<
+            point.radius * factor << "," <<
+            point.colorIndex;
+    }
+
+    // Line data: x0, y0, x1, y1, width, color index, arrow flag.
+    html << "],\nlines:[";
+    for(uint64_t i=0; i<lines.size(); i++) {
+        const Line& line = lines[i];
+        if(i != 0) {
+            html << ",";
+        }
+        html <<
+            (line.x0 - xMin) * factor << "," <<
+            (line.y0 - yMin) * factor << "," <<
+            (line.x1 - xMin) * factor << "," <<
+            (line.y1 - yMin) * factor << "," <<
+            line.width * factor << "," <<
+            line.colorIndex << "," <<
+            int(line.hasArrow);
+    }
+    html.precision(oldPrecision);
+    html.flags(oldFlags);
+
+    html << "],\npointTitles:";
+    writeJavaScriptStrings(html, points, [](const Point& point) -> const string& {return point.title;});
+    html << ",\npointUrls:";
+    writeJavaScriptStrings(html, points, [](const Point& point) -> const string& {return point.urlSuffix;});
+    html << ",\nlineTitles:";
+    writeJavaScriptStrings(html, lines, [](const Line& line) -> const string& {return line.title;});
+    html << ",\nlineUrls:";
+    writeJavaScriptStrings(html, lines, [](const Line& line) -> const string& {return line.urlSuffix;});
+    html << ",\npointUrlPrefix:";
+    writeJavaScriptString(html, pointUrlPrefix);
+    html << ",\nlineUrlPrefix:";
+    writeJavaScriptString(html, lineUrlPrefix);
+    html << "\n};\n</script>\n";
+
+    writeJavaScript(html);
+}
+
+
+
+void CanvasGraph::writeJavaScript(ostream& html)
+{
+    html << R"zzz(
+<script>
+function CanvasGraphViewer(canvas, tooltip, d)
+{
+    var ctx = canvas.getContext('2d');
+    var dpr = window.devicePixelRatio || 1;
+    var width = canvas.width;
+    var height = canvas.height;
+    canvas.style.width = width + 'px';
+    canvas.style.height = height + 'px';
+    canvas.width = Math.round(width * dpr);
+    canvas.height = Math.round(height * dpr);
+
+    var P = d.points;
+    var L = d.lines;
+    var pointCount = P.length / 4;
+    var lineCount = L.length / 7;
+
+    // Bounding box.
+    var xMin = Infinity, xMax = -Infinity, yMin = Infinity, yMax = -Infinity;
+    for(var i=0; i<pointCount; i++) {
+        xMin = Math.min(xMin, P[4*i]); xMax = Math.max(xMax, P[4*i]);
+        yMin = Math.min(yMin, P[4*i+1]); yMax = Math.max(yMax, P[4*i+1]);
+    }
+    for(var i=0; i<lineCount; i++) {
+        xMin = Math.min(xMin, L[7*i], L[7*i+2]); xMax = Math.max(xMax, L[7*i], L[7*i+2]);
+        yMin = Math.min(yMin, L[7*i+1], L[7*i+3]); yMax = Math.max(yMax, L[7*i+1], L[7*i+3]);
+    }
+    if(pointCount + lineCount == 0) {
+        return {fit: function() {}};
+    }
+
+    // Uniform grid used to find the items in a region.
+    var gridSize = Math.max(1, Math.min(256, Math.ceil(Math.sqrt((pointCount + lineCount) / 4))));
+    var cellWidth = Math.max(xMax - xMin, 1e-6) / gridSize;
+    var cellHeight = Math.max(yMax - yMin, 1e-6) / gridSize;
+    var pointCells = new Array(gridSize * gridSize);
+    var lineCells = new Array(gridSize * gridSize);
+    for(var i=0; i<gridSize*gridSize; i++) {
+        pointCells[i] = [];
+        lineCells[i] = [];
+    }
+    function cellX(x) {return Math.max(0, Math.min(gridSize-1, Math.floor((x - xMin) / cellWidth)));}
+    function cellY(y) {return Math.max(0, Math.min(gridSize-1, Math.floor((y - yMin) / cellHeight)));}
+    for(var i=0; i<pointCount; i++) {
+        pointCells[cellY(P[4*i+1]) * gridSize + cellX(P[4*i])].push(i);
+    }
+    for(var i=0; i<lineCount; i++) {
+        var ix0 = cellX(Math.min(L[7*i], L[7*i+2])), ix1 = cellX(Math.max(L[7*i], L[7*i+2]));
+        var iy0 = cellY(Math.min(L[7*i+1], L[7*i+3])), iy1 = cellY(Math.max(L[7*i+1], L[7*i+3]));
+        for(var iy=iy0; iy<=iy1; iy++) {
+            for(var ix=ix0; ix<=ix1; ix++) {
+                lineCells[iy * gridSize + ix].push(i);
+            }
+        }
+    }
+    var maxPointRadius = 0, maxLineWidth = 0;
+    for(var i=0; i<pointCount; i++) {
+        maxPointRadius = Math.max(maxPointRadius, P[4*i+2]);
+    }
+    for(var i=0; i<lineCount; i++) {
+        maxLineWidth = Math.max(maxLineWidth, L[7*i+4]);
+    }
+
+    // The view: screen = (world - origin) * scale.
+    var scale = 1, xOrigin = 0, yOrigin = 0;
+    function fit()
+    {
+        scale = 0.95 * Math.min(width / Math.max(xMax - xMin, 1e-6), height / Math.max(yMax - yMin, 1e-6));
+        xOrigin = 0.5 * (xMin + xMax) - 0.5 * width / scale;
+        yOrigin = 0.5 * (yMin + yMax) - 0.5 * height / scale;
+        requestRender();
+    }
+
+    // Gather the items in a region of world coordinates.
+    // Each call uses a new stamp value to avoid returning the same item twice.
+    var stampCounter = 0;
+    var pointStamp = new Uint32Array(pointCount);
+    var lineStamp = new Uint32Array(lineCount);
+    function gather(x0, y0, x1, y1, stampValue, points, lines)
+    {
+        var ix0 = cellX(x0), ix1 = cellX(x1), iy0 = cellY(y0), iy1 = cellY(y1);
+        for(var iy=iy0; iy<=iy1; iy++) {
+            for(var ix=ix0; ix<=ix1; ix++) {
+                var cell = iy * gridSize + ix;
+                var c = lineCells[cell];
+                for(var k=0; k<c.length; k++) {
+                    if(lineStamp[c[k]] != stampValue) {
+                        lineStamp[c[k]] = stampValue;
+                        lines.push(c[k]);
+                    }
+                }
+                c = pointCells[cell];
+                for(var k=0; k<c.length; k++) {
+                    if(pointStamp[c[k]] != stampValue) {
+                        pointStamp[c[k]] = stampValue;
+                        points.push(c[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    function drawLine(i)
+    {
+        var x0 = (L[7*i] - xOrigin) * scale, y0 = (L[7*i+1] - yOrigin) * scale;
+        var x1 = (L[7*i+2] - xOrigin) * scale, y1 = (L[7*i+3] - yOrigin) * scale;
+        var dx = x1 - x0, dy = y1 - y0;
+        var length = Math.sqrt(dx * dx + dy * dy);
+        if(length < 0.5) {
+            return;
+        }
+        var lineWidth = Math.max(0.5, L[7*i+4] * scale);
+        ctx.strokeStyle = d.colors[L[7*i+5]];
+        ctx.lineWidth = lineWidth;
+        ctx.beginPath();
+        ctx.moveTo(x0, y0);
+        ctx.lineTo(x1, y1);
+        ctx.stroke();
+        if(L[7*i+6] && lineWidth >= 1.5) {
+            var a = Math.min(3 * lineWidth, 0.5 * length);
+            var ux = dx / length, uy = dy / length;
+            ctx.fillStyle = ctx.strokeStyle;
+            ctx.beginPath();
+            ctx.moveTo(x1 + ux * a, y1 + uy * a);
+            ctx.lineTo(x1 - uy * lineWidth, y1 + ux * lineWidth);
+            ctx.lineTo(x1 + uy * lineWidth, y1 - ux * lineWidth);
+            ctx.fill();
+        }
+    }
+
+    function drawPoint(i)
+    {
+        var x = (P[4*i] - xOrigin) * scale, y = (P[4*i+1] - yOrigin) * scale;
+        var r = P[4*i+2] * scale;
+        ctx.fillStyle = d.colors[P[4*i+3]];
+        if(r < 1) {
+            ctx.fillRect(x - 0.5, y - 0.5, 1, 1);
+        } else {
+            ctx.beginPath();
+            ctx.arc(x, y, r, 0, 2 * Math.PI);
+            ctx.fill();
+        }
+    }
+
+    // Draw the visible items, a limited number per animation frame.
+    // A new render interrupts a render in progress.
+    var itemsPerFrame = 20000;
+    var generation = 0;
+    function render()
+    {
+        var g = ++generation;
+        ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+        ctx.clearRect(0, 0, width, height);
+        var margin = Math.max(maxPointRadius, 0.5 * maxLineWidth);
+        var points = [], lines = [];
+        gather(xOrigin - margin, yOrigin - margin,
+            xOrigin + width / scale + margin, yOrigin + height / scale + margin, ++stampCounter, points, lines);
+        var total = lines.length + points.length;
+        var k = 0;
+        function step()
+        {
+            if(g != generation) {
+                return;
+            }
+            var end = Math.min(k + itemsPerFrame, total);
+            for(; k<end; k++) {
+                if(k < lines.length) {
+                    drawLine(lines[k]);
+                } else {
+                    drawPoint(points[k - lines.length]);
+                }
+            }
+            if(k < total) {
+                requestAnimationFrame(step);
+            }
+        }
+        step();
+    }
+    var renderIsPending = false;
+    function requestRender()
+    {
+        if(!renderIsPending) {
+            renderIsPending = true;
+            requestAnimationFrame(function() {renderIsPending = false; render();});
+        }
+    }
+
+    // Find the item at a screen position, if any.
+    // Returns [isPoint, index] or null.
+    function findItem(sx, sy)
+    {
+        var x = xOrigin + sx / scale, y = yOrigin + sy / scale;
+        var tolerance = 4 / scale;
+        var margin = Math.max(maxPointRadius, 0.5 * maxLineWidth) + tolerance;
+        var points = [], lines = [];
+        gather(x - margin, y - margin, x + margin, y + margin, ++stampCounter, points, lines);
+        var best = null, bestDistance = Infinity;
+        for(var k=0; k<points.length; k++) {
+            var i = points[k];
+            var dx = P[4*i] - x, dy = P[4*i+1] - y;
+            var distance = Math.sqrt(dx * dx + dy * dy) - P[4*i+2];
+            if(distance < tolerance && distance < bestDistance) {
+                best = [true, i];
+                bestDistance = distance;
+            }
+        }
+        if(best) {
+            return best;
+        }
+        for(var k=0; k<lines.length; k++) {
+            var i = lines[k];
+            var x0 = L[7*i], y0 = L[7*i+1], x1 = L[7*i+2], y1 = L[7*i+3];
+            var dx = x1 - x0, dy = y1 - y0;
+            var length2 = dx * dx + dy * dy;
+            var t = (length2 > 0) ? Math.max(0, Math.min(1, ((x - x0) * dx + (y - y0) * dy) / length2)) : 0;
+            var ex = x0 + t * dx - x, ey = y0 + t * dy - y;
+            var distance = Math.sqrt(ex * ex + ey * ey) - 0.5 * L[7*i+4];
+            if(distance < tolerance && distance < bestDistance) {
+                best = [false, i];
+                bestDistance = distance;
+            }
+        }
+        return best;
+    }
+    function itemTitle(item)
+    {
+        var titles = item[0] ? d.pointTitles : d.lineTitles;
+        return (item[1] < titles.length) ? titles[item[1]] : '';
+    }
+    function itemUrl(item)
+    {
+        var urls = item[0] ? d.pointUrls : d.lineUrls;
+        if(item[1] >= urls.length || urls[item[1]] == '') {
+            return '';
+        }
+        var prefix = item[0] ? d.pointUrlPrefix : d.lineUrlPrefix;
+        if(prefix != '?') {
+            return prefix + urls[item[1]];
+        }
+        var parameters = new URLSearchParams(window.location.search);
+        new URLSearchParams(urls[item[1]]).forEach(function(value, name) {parameters.set(name, value);});
+        return '?' + parameters.toString();
+    }
+
+    // Pan, zoom, tooltip, and links.
+    var isDragging = false, lastX = 0, lastY = 0;
+    canvas.addEventListener('pointerdown', function(event) {
+        isDragging = true;
+        lastX = event.offsetX;
+        lastY = event.offsetY;
+        canvas.setPointerCapture(event.pointerId);
+        canvas.style.cursor = 'grabbing';
+    });
+    canvas.addEventListener('pointerup', function(event) {
+        isDragging = false;
+        canvas.style.cursor = 'grab';
+    });
+    canvas.addEventListener('pointermove', function(event) {
+        if(isDragging) {
+            xOrigin -= (event.offsetX - lastX) / scale;
+            yOrigin -= (event.offsetY - lastY) / scale;
+            lastX = event.offsetX;
+            lastY = event.offsetY;
+            tooltip.style.display = 'none';
+            requestRender();
+            return;
+        }
+        var item = findItem(event.offsetX, event.offsetY);
+        var title = item ? itemTitle(item) : '';
+        if(title == '') {
+            tooltip.style.display = 'none';
+        } else {
+            tooltip.textContent = title;
+            tooltip.style.left = (event.offsetX + 12) + 'px';
+            tooltip.style.top = (event.offsetY + 12) + 'px';
+            tooltip.style.display = 'block';
+        }
+    });
+    canvas.addEventListener('pointerleave', function(event) {
+        tooltip.style.display = 'none';
+    });
+    canvas.addEventListener('wheel', function(event) {
+        event.preventDefault();
+        var factor = Math.exp(-0.002 * event.deltaY);
+        var x = xOrigin + event.offsetX / scale, y = yOrigin + event.offsetY / scale;
+        scale *= factor;
+        xOrigin = x - event.offsetX / scale;
+        yOrigin = y - event.offsetY / scale;
+        requestRender();
+    }, {passive: false});
+    canvas.addEventListener('click', function(event) {
+        if(!event.ctrlKey) {
+            return;
+        }
+        var item = findItem(event.offsetX, event.offsetY);
+        if(item) {
+            var url = itemUrl(item);
+            if(url != '') {
+                window.location.href = url;
+            }
+        }
+    });
+
+    fit();
+    return {fit: fit};
+}
+var canvasGraphViewer = CanvasGraphViewer(
+    document.getElementById('CanvasGraph'),
+    document.getElementById('CanvasGraphTooltip'),
+    canvasGraphData);
+document.getElementById('CanvasGraph').scrollIntoView();
+</script>
+)zzz";
+}
@@ -0,0 +1,111 @@
+#ifndef SHASTA_CANVAS_GRAPH_HPP
+#define SHASTA_CANVAS_GRAPH_HPP
+
+/*******************************************************************************
+
+Class CanvasGraph is used to display large local graphs in the browser
+using an html canvas instead of svg.
+
+The server fills in the points (usually graph vertices) and lines
+(usually graph edges or segments), with coordinates
+already computed by a layout, then calls write.
+This writes a compact description of the graph (numbers, with colors and strings
+stored once in tables) followed by a script that renders it.
+The browser never creates an element for each point or line.
+
+The script:
+- Draws only what is visible in the current viewport,
+  using a uniform grid to locate the visible points and lines.
+- Uses level of detail: lines shorter than a pixel are skipped
+  and points too small to be seen are drawn as a single pixel.
+- Draws progressively, a limited number of items per animation frame,
+  so the page remains responsive even for very large graphs.
+  A new pan or zoom interrupts the drawing in progress.
+- Supports pan (drag), zoom (mouse wheel), a tooltip with the title
+  of the item under the mouse, and ctrl-click to follow
+  the url associated with an item.
+
+Urls are obtained by appending the url suffix of the item
+to the urlPrefix of its kind (points or lines).
+A urlPrefix of "?" means that the suffix contains request parameters
+(for example "vertexId=1234") that replace the ones in the current page url.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include <map>
+#include "iosfwd.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class CanvasGraph;
+}
+
+
+
+class shasta::CanvasGraph {
+public:
+
+    class Point {
+    public:
+        double x;
+        double y;
+        double radius;
+        uint64_t colorIndex;
+        string title;
+        string urlSuffix;
+    };
+    vector<Point> points;
+
+    class Line {
+    public:
+        double x0;
+        double y0;
+        double x1;
+        double y1;
+        double width;
+        uint64_t colorIndex;
+        bool hasArrow;
+        string title;
+        string urlSuffix;
+    };
+    vector<Line> lines;
+
+    string pointUrlPrefix;
+    string lineUrlPrefix;
+
+    // Radius, width, x, and y are in the same units.
+    void addPoint(
+        double x,
+        double y,
+        double radius,
+        const string& color,
+        const string& title = "",
+        const string& urlSuffix = "");
+    void addLine(
+        double x0,
+        double y0,
+        double x1,
+        double y1,
+        double width,
+        const string& color,
+        bool hasArrow = false,
+        const string& title = "",
+        const string& urlSuffix = "");
+
+    // Write the canvas and the script that displays the graph.
+    // Lines are drawn in the order they were added, then points.
+    void write(ostream& html, uint64_t sizePixels) const;
+
+private:
+
+    // Colors are stored once. They can be any color accepted by html canvas.
+    vector<string> colors;
+    std::map<string, uint64_t> colorMap;
+    uint64_t getColorIndex(const string& color);
+
+    static void writeJavaScript(ostream&);
+};
+
+#endif
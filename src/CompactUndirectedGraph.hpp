@@ -17,6 +17,16 @@
 // that allows reusing the same object multiple times
 // with minimal memory allocation activity.
 
+// Once in the Processing state, it also provides multithreaded
+// traversal operations that work directly on its compressed
+// sparse row representation:
+// - A direction-optimizing breadth first search
+//   (Beamer, Asanovic, and Patterson, Direction-Optimizing
+//   Breadth-First Search, SC 2012), optionally limited
+//   to a maximum distance.
+// - Computation of connected components,
+//   using a lock-free union-find.
+
 // Shasta.
 #include "SHASTA_ASSERT.hpp"
 
@@ -26,9 +36,12 @@
 #include <boost/graph/iteration_macros.hpp>
 
 // Standard library.
+#include "algorithm.hpp"
 #include "array.hpp"
+#include <atomic>
 #include "iostream.hpp"
 #include  <limits>
+#include <thread>
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -168,6 +181,42 @@ public:
 
 
 
+    // Multithreaded traversal operations.
+    // A threadCount of 0 means use all available hardware threads.
+    // Small jobs are done in the calling thread.
+    static const Int infiniteDistance = std::numeric_limits<Int>::max();
+
+    // Breadth first search starting at vertex start,
+    // visiting vertices at distance up to maxDistance
+    // (use infiniteDistance for no limit).
+    // On return, distance[v] is the distance of each vertex from start,
+    // or infiniteDistance if it was not reached, and reachedVertices
+    // contains the vertices reached, sorted by distance, then by vertex index.
+    void bfs(
+        vertex_descriptor start,
+        Int maxDistance,
+        vector<Int>& distance,
+        vector<vertex_descriptor>& reachedVertices,
+        size_t threadCount = 1) const;
+
+    // Find the vertices at distance up to maxDistance from a given vertex,
+    // sorted by distance, then by vertex index.
+    void findNeighborhood(
+        vertex_descriptor,
+        Int maxDistance,
+        vector<vertex_descriptor>&,
+        size_t threadCount = 1) const;
+
+    // Compute connected components.
+    // On return, componentId[v] is the component that each vertex belongs to.
+    // Components are numbered in order of their lowest numbered vertex.
+    // Returns the number of connected components.
+    Int computeConnectedComponents(
+        vector<Int>& componentId,
+        size_t threadCount = 1) const;
+
+
+
     // Iteration over vertices.
     class vertex_iterator {
     public:
@@ -350,6 +399,29 @@ private:
     // Each vertex points to the index in this vector
     // for the first edge of the vertex.
     vector<Int> edgeLists;
+
+    // The vertex at the other side of an edge.
+    Int otherVertex(Int v, Int e) const
+    {
+        const EdgeInfo& edgeInfo = edgeTable[e];
+        return (edgeInfo.vertices[0].v == v) ? edgeInfo.vertices[1].v : edgeInfo.vertices[0].v;
+    }
+    Int degree(Int v) const
+    {
+        return vertexTable[v + 1].second - vertexTable[v].second;
+    }
+
+    // Call f(threadId, begin, end) for batches covering [0, n).
+    // This uses the calling thread only if the job is small.
+    template<class F> static void parallelForBatches(
+        Int n, size_t threadCount, const F& f);
+    static size_t adjustThreadCount(size_t threadCount)
+    {
+        if(threadCount == 0) {
+            threadCount = std::max(1U, std::thread::hardware_concurrency());
+        }
+        return threadCount;
+    }
 };
 
 
@@ -607,4 +679,245 @@ template<class Vertex, class Edge>
     }
 }
 
+
+template<class Vertex, class Edge>
+    template<class F>
+    inline void
+    shasta::CompactUndirectedGraph<Vertex, Edge>::
+    parallelForBatches(Int n, size_t threadCount, const F& f)
+{
+    const Int batchSize = 1024;
+    if(threadCount == 1 or n <= 8 * batchSize) {
+        if(n > 0) {
+            f(size_t(0), Int(0), n);
+        }
+        return;
+    }
+
+    std::atomic<Int> nextBegin(0);
+    auto threadFunction = [&](size_t threadId)
+    {
+        while(true) {
+            const Int begin = nextBegin.fetch_add(batchSize);
+            if(begin >= n) {
+                break;
+            }
+            f(threadId, begin, std::min(n, begin + batchSize));
+        }
+    };
+    vector<std::thread> threads;
+    for(size_t threadId=1; threadId<threadCount; threadId++) {
+        threads.push_back(std::thread(threadFunction, threadId));
+    }
+    threadFunction(0);
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+}
+
+
+
+// Direction-optimizing breadth first search.
+// At each level, the search either expands the frontier (top-down step)
+// or checks, for each vertex not yet reached, whether it has a neighbor
+// in the frontier (bottom-up step). Bottom-up steps are used when the frontier
+// is large, because they can stop scanning the edges of a vertex as soon as
+// a neighbor in the frontier is found.
+template<class Vertex, class Edge>
+    inline void
+    shasta::CompactUndirectedGraph<Vertex, Edge>::
+    bfs(
+        vertex_descriptor start,
+        Int maxDistance,
+        vector<Int>& distance,
+        vector<vertex_descriptor>& reachedVertices,
+        size_t threadCount) const
+{
+    SHASTA_ASSERT(state == State::Processing);
+    const Int n = vertexCount();
+    SHASTA_ASSERT(start.v < n);
+    threadCount = adjustThreadCount(threadCount);
+
+    // Parameters that control switching between top-down and bottom-up steps,
+    // as recommended by Beamer et al.
+    const Int alpha = 14;
+    const Int beta = 24;
+
+    distance.assign(n, infiniteDistance);
+    vector< std::atomic<bool> > wasReached(n);
+    vector<uint8_t> isInFrontier;
+    vector< vector<Int> > threadNextFrontier(threadCount);
+
+    vector<Int> frontier(1, start.v);
+    distance[start.v] = 0;
+    wasReached[start.v].store(true, std::memory_order_relaxed);
+    reachedVertices.clear();
+    reachedVertices.push_back(start);
+
+    // The number of edge ends of vertices not yet reached.
+    Int unexploredEdgeCount = edgeLists.size() - degree(start.v);
+    bool useBottomUp = false;
+
+    for(Int level=0; level<maxDistance and not frontier.empty(); level++) {
+
+        // Decide the type of this step.
+        Int frontierEdgeCount = 0;
+        for(const Int v: frontier) {
+            frontierEdgeCount += degree(v);
+        }
+        if(useBottomUp) {
+            useBottomUp = frontier.size() >= n / beta;
+        } else {
+            useBottomUp = frontierEdgeCount > unexploredEdgeCount / alpha;
+        }
+
+        for(vector<Int>& v: threadNextFrontier) {
+            v.clear();
+        }
+
+        if(useBottomUp) {
+            isInFrontier.assign(n, 0);
+            for(const Int v: frontier) {
+                isInFrontier[v] = 1;
+            }
+            parallelForBatches(n, threadCount, [&](size_t threadId, Int begin, Int end)
+            {
+                vector<Int>& nextFrontier = threadNextFrontier[threadId];
+                for(Int v=begin; v!=end; v++) {
+                    if(wasReached[v].load(std::memory_order_relaxed)) {
+                        continue;
+                    }
+                    for(Int i=vertexTable[v].second; i!=vertexTable[v+1].second; i++) {
+                        if(isInFrontier[otherVertex(v, edgeLists[i])]) {
+                            wasReached[v].store(true, std::memory_order_relaxed);
+                            distance[v] = level + 1;
+                            nextFrontier.push_back(v);
+                            break;
+                        }
+                    }
+                }
+            });
+        } else {
+            parallelForBatches(Int(frontier.size()), threadCount, [&](size_t threadId, Int begin, Int end)
+            {
+                vector<Int>& nextFrontier = threadNextFrontier[threadId];
+                for(Int j=begin; j!=end; j++) {
+                    const Int v0 = frontier[j];
+                    for(Int i=vertexTable[v0].second; i!=vertexTable[v0+1].second; i++) {
+                        const Int v1 = otherVertex(v0, edgeLists[i]);
+                        if(wasReached[v1].load(std::memory_order_relaxed)) {
+                            continue;
+                        }
+                        if(not wasReached[v1].exchange(true, std::memory_order_relaxed)) {
+                            distance[v1] = level + 1;
+                            nextFrontier.push_back(v1);
+                        }
+                    }
+                }
+            });
+        }
+
+        // Gather the next frontier, sorted so the results
+        // don't depend on the number of threads.
+        frontier.clear();
+        for(const vector<Int>& v: threadNextFrontier) {
+            frontier.insert(frontier.end(), v.begin(), v.end());
+        }
+        std::sort(frontier.begin(), frontier.end());
+        for(const Int v: frontier) {
+            unexploredEdgeCount -= degree(v);
+            reachedVertices.push_back(vertex_descriptor(v));
+        }
+    }
+}
+
+
+
+template<class Vertex, class Edge>
+    inline void
+    shasta::CompactUndirectedGraph<Vertex, Edge>::
+    findNeighborhood(
+        vertex_descriptor v,
+        Int maxDistance,
+        vector<vertex_descriptor>& neighborhood,
+        size_t threadCount) const
+{
+    vector<Int> distance;
+    bfs(v, maxDistance, distance, neighborhood, threadCount);
+}
+
+
+
+// Connected components using a lock-free union-find.
+// Each union links the root with the higher index to the root with the lower index,
+// so the root of each component is its lowest numbered vertex.
+template<class Vertex, class Edge>
+    inline typename shasta::CompactUndirectedGraph<Vertex, Edge>::Int
+    shasta::CompactUndirectedGraph<Vertex, Edge>::
+    computeConnectedComponents(
+        vector<Int>& componentId,
+        size_t threadCount) const
+{
+    SHASTA_ASSERT(state == State::Processing);
+    const Int n = vertexCount();
+    threadCount = adjustThreadCount(threadCount);
+
+    vector< std::atomic<Int> > parent(n);
+    for(Int v=0; v<n; v++) {
+        parent[v].store(v, std::memory_order_relaxed);
+    }
+
+    // Find with path halving.
+    auto findSet = [&parent](Int x)
+    {
+        while(true) {
+            Int p = parent[x].load(std::memory_order_relaxed);
+            if(p == x) {
+                return x;
+            }
+            const Int q = parent[p].load(std::memory_order_relaxed);
+            if(q != p) {
+                parent[x].compare_exchange_weak(p, q, std::memory_order_relaxed);
+            }
+            x = q;
+        }
+    };
+
+    parallelForBatches(edgeCount(), threadCount, [&](size_t, Int begin, Int end)
+    {
+        for(Int e=begin; e!=end; e++) {
+            Int x = edgeTable[e].vertices[0].v;
+            Int y = edgeTable[e].vertices[1].v;
+            while(true) {
+                x = findSet(x);
+                y = findSet(y);
+                if(x == y) {
+                    break;
+                }
+                if(x < y) {
+                    std::swap(x, y);
+                }
+                Int expected = x;
+                if(parent[x].compare_exchange_strong(expected, y, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+        }
+    });
+
+    // Number the components. Because each root is the lowest numbered vertex
+    // of its component, it is encountered first.
+    componentId.resize(n);
+    Int componentCount = 0;
+    for(Int v=0; v<n; v++) {
+        const Int root = findSet(v);
+        if(root == v) {
+            componentId[v] = componentCount++;
+        } else {
+            componentId[v] = componentId[root];
+        }
+    }
+    return componentCount;
+}
+
 #endif
@@ -5,6 +5,7 @@
 #include "findLinearChains.hpp"
 #include "html.hpp"
 #include "MurmurHash2.hpp"
+#include "parallelFor.hpp"
 #include "platformDependent.hpp"
 #include "Reads.hpp"
 #include "runCommandWithTimeout.hpp"
@@ -27,7 +28,8 @@ using namespace shasta;
 
 // Create the CompressedAssemblyGraph from the AssemblyGraph.
 CompressedAssemblyGraph::CompressedAssemblyGraph(
-    const Assembler& assembler)
+    const Assembler& assembler,
+    size_t threadCount)
 {
     CompressedAssemblyGraph& graph = *this;
     const AssemblyGraph& assemblyGraph = *(assembler.assemblyGraphPointer);
@@ -53,21 +55,15 @@ CompressedAssemblyGraph::CompressedAssemblyGraph(
     // Assign an id to each edge.
     assignEdgeIds();
 
-    // Fill in the assembly graph edges that go into each
-    // edge of the compressed assembly graph.
-    fillContributingEdges(assemblyGraph);
-
-    // Fill in minimum and maximum marker counts for each edge.
-    fillMarkerCounts(assemblyGraph);
-
-    // Find the oriented reads that appear in marker graph vertices
-    // internal to each edge of the compressed assembly graph.
-    findOrientedReads(assembler);
+    // Fill in the assembly graph edges, marker counts,
+    // and oriented reads for each edge.
+    // These are independent for each edge and are computed in parallel.
+    computeEdgeInformation(assembler, threadCount);
     fillOrientedReadTable(assembler);
 
     // Find edges that have at least one common oriented read
     // which each edge.
-    findRelatedEdges();
+    findRelatedEdges(threadCount);
 }
 
 
@@ -245,49 +241,49 @@ void CompressedAssemblyGraph::assignEdgeIds()
 
 
 
-// Fill in the assembly graph edges that go into each
-// edge of the compressed assembly graph.
-void CompressedAssemblyGraph::fillContributingEdges(
-    const AssemblyGraph& assemblyGraph)
+// Fill in the assembly graph edges, marker counts,
+// and oriented reads for each edge.
+// Each thread only modifies the edges assigned to it.
+void CompressedAssemblyGraph::computeEdgeInformation(
+    const Assembler& assembler,
+    size_t threadCount)
 {
     CompressedAssemblyGraph& graph = *this;
+    const AssemblyGraph& assemblyGraph = *(assembler.assemblyGraphPointer);
 
+    vector<edge_descriptor> allEdges;
     BGL_FORALL_EDGES(e, graph, CompressedAssemblyGraph) {
-        CompressedAssemblyGraphEdge& edge = graph[e];
-        edge.edges.resize(edge.vertices.size() - 1);
-        for(uint64_t i=0; i<edge.edges.size(); i++) {
-            const VertexId vertexId0 = edge.vertices[i];
-            const VertexId vertexId1 = edge.vertices[i+1];
-            const span<const EdgeId> edges0 = assemblyGraph.edgesBySource[vertexId0];
-            for(const EdgeId edge01: edges0) {
-                if(assemblyGraph.edges[edge01].target == vertexId1) {
-                    edge.edges[i].push_back(edge01);
-                }
-            }
-        }
-
+        allEdges.push_back(e);
     }
+
+    parallelFor(allEdges.size(), 16, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                CompressedAssemblyGraphEdge& edge = graph[allEdges[i]];
+                edge.fillContributingEdges(assemblyGraph);
+                edge.fillMarkerCounts(assemblyGraph);
+                edge.findOrientedReads(assembler);
+            }
+        });
 }
 
 
 
-// Find the oriented reads that appear in marker graph vertices
-// internal to each edge of the compressed assembly graph.
-void CompressedAssemblyGraph::findOrientedReads(
-    const Assembler& assembler)
+// Fill in the assembly graph edges that go into
+// this edge of the compressed assembly graph.
+void CompressedAssemblyGraphEdge::fillContributingEdges(
+    const AssemblyGraph& assemblyGraph)
 {
-    CompressedAssemblyGraph& graph = *this;
-
-    BGL_FORALL_EDGES(e, graph, CompressedAssemblyGraph) {
-        graph[e].findOrientedReads(assembler);
-    }
-
-    // Fill in the oriented read table, which tells us
-    // which edges each read appears in.
-    orientedReadTable.resize(2 * assembler.getReads().readCount());
-    BGL_FORALL_EDGES(e, graph, CompressedAssemblyGraph) {
-        for(const OrientedReadId orientedReadId: graph[e].orientedReadIds) {
-            orientedReadTable[orientedReadId.getValue()].push_back(e);
+    edges.resize(vertices.size() - 1);
+    for(uint64_t i=0; i<edges.size(); i++) {
+        const AssemblyGraph::VertexId vertexId0 = vertices[i];
+        const AssemblyGraph::VertexId vertexId1 = vertices[i+1];
+        const span<const AssemblyGraph::EdgeId> edges0 = assemblyGraph.edgesBySource[vertexId0];
+        for(const AssemblyGraph::EdgeId edge01: edges0) {
+            if(assemblyGraph.edges[edge01].target == vertexId1) {
+                edges[i].push_back(edge01);
+            }
         }
     }
 }
@@ -356,12 +352,23 @@ void CompressedAssemblyGraphEdge::findOrientedReads(
 
 // Find edges that have at least one common oriented read
 // which each edge.
-void CompressedAssemblyGraph::findRelatedEdges()
+// This runs in parallel. Each thread only modifies the edges assigned to it.
+void CompressedAssemblyGraph::findRelatedEdges(size_t threadCount)
 {
     CompressedAssemblyGraph& graph = *this;
+
+    vector<edge_descriptor> allEdges;
     BGL_FORALL_EDGES(e, graph, CompressedAssemblyGraph) {
-        findRelatedEdges(e);
+        allEdges.push_back(e);
     }
+
+    parallelFor(allEdges.size(), 16, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                findRelatedEdges(allEdges[i]);
+            }
+        });
 }
 void CompressedAssemblyGraph::findRelatedEdges(edge_descriptor e0)
 {
@@ -601,15 +608,7 @@ void CompressedAssemblyGraph::writeCsvOrientedReads() const
 
 
 
-// Fill in minimum and maximum marker counts for each edge.
-void CompressedAssemblyGraph::fillMarkerCounts(const AssemblyGraph& assemblyGraph)
-{
-    CompressedAssemblyGraph& graph = *this;
-
-    BGL_FORALL_EDGES(e, graph, CompressedAssemblyGraph) {
-        graph[e].fillMarkerCounts(assemblyGraph);
-    }
-}
+// Fill in minimum and maximum marker counts for this edge.
 void CompressedAssemblyGraphEdge::fillMarkerCounts(const AssemblyGraph& assemblyGraph)
 {
     minMarkerCount = 0;
@@ -70,6 +70,9 @@ public:
     }
     void fillMarkerCounts(const AssemblyGraph&);
 
+    // Fill in the assembly graph edges that go into this edge.
+    void fillContributingEdges(const AssemblyGraph&);
+
     // Find the oriented reads that appear in marker graph vertices
     // internal to this edge of the compressed assembly graph.
     void findOrientedReads(const Assembler&);
@@ -104,7 +107,9 @@ public:
 
 
     // Create the CompressedAssemblyGraph from the AssemblyGraph.
-    CompressedAssemblyGraph(const Assembler&);
+    // If threadCount is 0, all available hardware threads are used
+    // for the per-edge computations.
+    CompressedAssemblyGraph(const Assembler&, size_t threadCount = 0);
 
     // Create a local subgraph.
     // See createLocalSubgraph for argument explanation.
@@ -194,15 +199,10 @@ private:
     void assignEdgeIds();
 
     // Fill in the assembly graph edges that go into each
-    // edge of the compressed assembly graph.
-    void fillContributingEdges(const AssemblyGraph&);
-
-    // Fill in minimum and maximum marker counts for each edge.
-    void fillMarkerCounts(const AssemblyGraph&);
-
-    // Find the oriented reads that appear in marker graph vertices
-    // internal to each edge of the compressed assembly graph.
-    void findOrientedReads(const Assembler&);
+    // edge of the compressed assembly graph, the minimum and maximum
+    // marker counts, and the oriented reads that appear in marker graph
+    // vertices internal to each edge. This runs in parallel.
+    void computeEdgeInformation(const Assembler&, size_t threadCount);
 
     // The edges that each oriented read appears in.
     // Indexed by OrientedRead::getValue().
@@ -211,7 +211,7 @@ private:
 
     // Find edges that have at least one common oriented read
     // which each edge.
-    void findRelatedEdges();
+    void findRelatedEdges(size_t threadCount);
     void findRelatedEdges(edge_descriptor);
 
 private:
@@ -1,7 +1,36 @@
 #include "ConsensusCaller.hpp"
 #include "Coverage.hpp"
+#include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
+// Standard library.
+#include "stdexcept.hpp"
+
+
+
+// Compute consensus at many positions.
+void ConsensusCaller::callBatch(
+    span<const Coverage> coverages,
+    span<Consensus> consensus) const
+{
+    SHASTA_ASSERT(coverages.size() == consensus.size());
+    for(uint64_t i=0; i<coverages.size(); i++) {
+        consensus[i] = (*this)(coverages[i]);
+    }
+}
+
+
+
+// Compute consensus repeat counts at positions where all reads have the same base.
+// Only available in derived classes for which canCallRepeatCounts returns true.
+void ConsensusCaller::callRepeatCounts(
+    span<const uint8_t>,
+    uint64_t,
+    span<uint32_t>) const
+{
+    throw runtime_error("This consensus caller cannot compute consensus from repeat counts only.");
+}
+
 
 
 // Given a vector of Coverage objects,
@@ -16,13 +16,27 @@ Derived classes must implement operator(), which must
 run the consensus algorithm and return a pair containing
 the "best" base and repeat count.
 
+Derived classes can also override callBatch, which computes
+consensus at many positions with a single virtual call.
+This allows the derived class to use a tight loop
+without virtual dispatch at each position.
+
+Derived classes whose repeat count consensus only depends
+on the repeat counts of the called base can also override
+canCallRepeatCounts and callRepeatCounts. These are used
+at positions where all reads have the same base, for example
+the positions of the marker of a marker graph vertex,
+and avoid the construction of Coverage objects.
+
 *******************************************************************************/
 
 // Shasta
 #include "Base.hpp"
 
 // Standard libraries.
+#include "cstdint.hpp"
 #include <set>
+#include "span.hpp"
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -57,6 +71,25 @@ public:
     // It must be implemented by all derived classes.
     virtual Consensus operator()(const Coverage&) const = 0;
 
+    // Compute consensus at many positions.
+    // The two spans must have the same size.
+    // The default implementation calls operator() for each position.
+    virtual void callBatch(span<const Coverage>, span<Consensus>) const;
+
+    // Compute consensus repeat counts at positions where all reads have the same base.
+    // The repeat counts are stored by position, with one row for each position:
+    // the repeat count of read i at position j is repeatCounts[j * readCount + i].
+    // This can only be called if canCallRepeatCounts returns true.
+    // The default implementation throws.
+    virtual bool canCallRepeatCounts() const
+    {
+        return false;
+    }
+    virtual void callRepeatCounts(
+        span<const uint8_t> repeatCounts,
+        uint64_t readCount,
+        span<uint32_t> consensusRepeatCounts) const;
+
     // Virtual destructor, to ensure destruction of derived classes.
     virtual ~ConsensusCaller() {}
 
@@ -21,11 +21,14 @@ CoverageData::CoverageData(AlignedBase base, Strand strand, size_t repeatCount)
 // Coverage default constructor.
 Coverage::Coverage()
 {
-    // Zero out the baseCoverage.
+    // Zero out the baseCoverage and detailedCoverageSize.
     for(size_t base=0; base<5; base++) {
         auto& v = baseCoverage[base];
         v[0] = 0;
         v[1] = 0;
+        auto& w = detailedCoverageSize[base];
+        w[0] = 0;
+        w[1] = 0;
     }
 
     // The detailedCoverage structure does not need to be zero,
@@ -34,10 +37,31 @@ Coverage::Coverage()
 
 
 
+// Remove all reads, returning to the state of a default constructed Coverage,
+// but without releasing any memory.
+void Coverage::reset()
+{
+    readCoverageData.clear();
+
+    for(size_t base=0; base<5; base++) {
+        for(Strand strand=0; strand<2; strand++) {
+
+            // Zero the entries in use, so all entries of the vector are zero.
+            auto& c = detailedCoverage[base][strand];
+            auto& size = detailedCoverageSize[base][strand];
+            fill(c.begin(), c.begin() + size, 0);
+            size = 0;
+
+            baseCoverage[base][strand] = 0;
+        }
+    }
+}
+
+
+
 // Add information about a supporting read.
 // If the AlignedBase is '-',repeatCount must be zero.
 // Otherwise, it must not be zero.
-// This is the only public non-const function.
 void Coverage::addRead(AlignedBase base, Strand strand, size_t repeatCount)
 {
     // Sanity check on the base.
@@ -55,11 +79,14 @@ void Coverage::addRead(AlignedBase base, Strand strand, size_t repeatCount)
     readCoverageData.push_back(CoverageData(base, strand, repeatCount));
 
     // Increment detailed coverage.
+    // Entries past detailedCoverageSize are already zero.
     auto& c = detailedCoverage[baseValue][strand];
     if(c.size() <= repeatCount) {
         c.resize(repeatCount + 1);
     }
     ++c[repeatCount];
+    auto& size = detailedCoverageSize[baseValue][strand];
+    size = max(size, repeatCount + 1);
 
     // Increment base coverage.
     ++baseCoverage[baseValue][strand];
@@ -178,9 +205,8 @@ size_t Coverage::coverage(AlignedBase base, size_t repeatCount) const
     // Return coverage for the given repeat count, summing over both strands.
     size_t c = 0;
     for(Strand strand=0; strand<2; strand++) {
-        const auto& baseAndStrandDetailedCoverage = baseDetailedCoverage[strand];
-        if(repeatCount < baseAndStrandDetailedCoverage.size()) {
-            c += baseAndStrandDetailedCoverage[repeatCount];
+        if(repeatCount < detailedCoverageSize[baseValue][strand]) {
+            c += baseDetailedCoverage[strand][repeatCount];
         }
     }
     return c;
@@ -221,8 +247,8 @@ size_t Coverage::repeatCountEnd(AlignedBase base) const
     const size_t baseValue = base.value;
     SHASTA_ASSERT(baseValue < 5);
 
-    const auto& c = detailedCoverage[baseValue];
-    return max(c[0].size(), c[1].size());
+    const auto& size = detailedCoverageSize[baseValue];
+    return max(size[0], size[1]);
 }
 
 
@@ -235,7 +261,8 @@ void Coverage::count(vector<CompressedCoverageData>& compressedCoverageData) con
         const array<vector<size_t>, 2>& x = detailedCoverage[base];
         for(uint8_t strand=0; strand<2; strand++) {
             const vector<size_t>& y = x[strand];
-            for(size_t repeatCount=0; repeatCount<y.size(); repeatCount++) {
+            const size_t size = detailedCoverageSize[base][strand];
+            for(size_t repeatCount=0; repeatCount<size; repeatCount++) {
                 const size_t frequency = y[repeatCount];
                 if(frequency > 0) {
                     CompressedCoverageData c;
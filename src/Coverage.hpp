@@ -20,6 +20,11 @@ read at a single position of a multiple sequence alignment.
 
 Class Coverage stores coverage information for all reads at a single
 position of a multiple sequence alignment.
+A Coverage object can be reused for many positions by calling reset()
+between positions. This keeps all allocated capacity, so after
+the first few positions adding reads does not allocate memory.
+This is important in consensus computations that loop over
+positions of all marker graph vertices or edges.
 
 *******************************************************************************/
 
@@ -101,9 +106,12 @@ public:
     // Add information about a supporting read.
     // If the AlignedBase is '-',repeatCount must be zero.
     // Otherwise, it must not be zero.
-    // This is the only public non-const function.
     void addRead(AlignedBase, Strand, size_t repeatCount);
 
+    // Remove all reads, returning to the state of a default constructed Coverage,
+    // but without releasing any memory.
+    void reset();
+
     // Return the list detailing coverage from each read.
     const vector<CoverageData>& getReadCoverageData() const
     {
@@ -157,7 +165,11 @@ private:
 
     // Coverage for each base (ACGT or '-'), strand, and repeat count.
     // Indexed by [AlignedBase::value][strand][repeatCount].
+    // Only the first detailedCoverageSize[AlignedBase::value][strand] entries
+    // of each vector are in use. The remaining entries are capacity
+    // kept by reset() and are always zero.
     array< array<vector<size_t>, 2>, 5> detailedCoverage;
+    array< array<size_t, 2>, 5> detailedCoverageSize;
 
     // Coverage for each base (ACGT or '-') and strand.
     // Indexed by [AlignedBase::value][strand].
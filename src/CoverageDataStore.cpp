@@ -0,0 +1,93 @@
+#include "CoverageDataStore.hpp"
+using namespace shasta;
+
+#include <cstring>
+
+static_assert(sizeof(CompressedCoverageData) == 3,
+    "Unexpected size of CompressedCoverageData");
+
+
+
+void CoverageDataStore::append(const vector< pair<uint32_t, CompressedCoverageData> >& v)
+{
+    // Work area reused by each thread to avoid memory allocation.
+    thread_local vector<uint8_t> encoded;
+    encode(v, encoded);
+    data.appendVector(encoded);
+}
+
+
+
+void CoverageDataStore::get(
+    uint64_t i,
+    vector< pair<uint32_t, CompressedCoverageData> >& v) const
+{
+    decode(getEncoded(i), v);
+}
+
+
+
+void CoverageDataStore::encode(
+    const vector< pair<uint32_t, CompressedCoverageData> >& v,
+    vector<uint8_t>& encoded)
+{
+    encoded.clear();
+
+    int64_t previousPosition = 0;
+    for(const auto& p: v) {
+
+        // Zigzag encode the position difference, so a (never expected)
+        // decrease in position is still represented correctly.
+        const int64_t delta = int64_t(p.first) - previousPosition;
+        previousPosition = int64_t(p.first);
+        uint64_t x = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+
+        // Varint: 7 bits per byte, high bit set if more bytes follow.
+        while(x >= 0x80) {
+            encoded.push_back(uint8_t(x | 0x80));
+            x >>= 7;
+        }
+        encoded.push_back(uint8_t(x));
+
+        // The CompressedCoverageData, as is.
+        uint8_t bytes[3];
+        std::memcpy(bytes, &p.second, 3);
+        encoded.insert(encoded.end(), bytes, bytes + 3);
+    }
+}
+
+
+
+void CoverageDataStore::decode(
+    span<const uint8_t> encoded,
+    vector< pair<uint32_t, CompressedCoverageData> >& v)
+{
+    v.clear();
+
+    int64_t position = 0;
+    const uint8_t* p = encoded.data();
+    const uint8_t* end = p + encoded.size();
+    while(p != end) {
+
+        // The position difference.
+        uint64_t x = 0;
+        for(uint64_t shift=0; ; shift+=7) {
+            SHASTA_ASSERT(p != end);
+            const uint8_t byte = *p++;
+            x |= uint64_t(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        const int64_t delta = int64_t(x >> 1) ^ -int64_t(x & 1);
+        position += delta;
+
+        // The CompressedCoverageData.
+        SHASTA_ASSERT(end - p >= 3);
+        pair<uint32_t, CompressedCoverageData> q;
+        q.first = uint32_t(position);
+        std::memcpy(&q.second, p, 3);
+        p += 3;
+        v.push_back(q);
+    }
+}
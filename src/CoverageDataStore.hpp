@@ -0,0 +1,106 @@
+#ifndef SHASTA_COVERAGE_DATA_STORE_HPP
+#define SHASTA_COVERAGE_DATA_STORE_HPP
+
+// Compressed storage of coverage data for marker graph vertices or edges.
+// The coverage data for each vertex or edge is a sequence of
+// pairs (position, CompressedCoverageData), ordered by position.
+// Stored as is, each pair takes 8 bytes, including a padding byte.
+// Here, each pair is encoded as:
+// - The difference between its position and the position of
+//   the previous pair (0 for the first pair) as a zigzag varint,
+//   almost always a single byte because there are usually
+//   several pairs at each position.
+// - The 3 bytes of the CompressedCoverageData.
+// So each pair typically takes 4 bytes instead of 8.
+// The encoded bytes for all vertices or edges are stored in a
+// MemoryMapped::VectorOfVectors, whose table of contents provides
+// random access to the data for any vertex or edge.
+
+// Shasta.
+#include "Coverage.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "span.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class CoverageDataStore;
+}
+
+
+
+class shasta::CoverageDataStore {
+public:
+
+    void createNew(const string& name, size_t pageSize)
+    {
+        data.createNew(name, pageSize);
+    }
+    void accessExistingReadOnly(const string& name)
+    {
+        data.accessExistingReadOnly(name);
+    }
+    bool isOpen() const
+    {
+        return data.isOpen();
+    }
+    void remove()
+    {
+        data.remove();
+    }
+    void unreserve()
+    {
+        data.unreserve();
+    }
+
+    // The number of vertices or edges stored.
+    uint64_t size() const
+    {
+        return data.size();
+    }
+
+    // Append the coverage data for a new vertex or edge.
+    void append(const vector< pair<uint32_t, CompressedCoverageData> >&);
+
+    // Append data already encoded, for example by another CoverageDataStore.
+    void appendEncoded(span<const uint8_t> encoded)
+    {
+        data.appendVector(encoded.begin(), encoded.end());
+    }
+
+    // Access the encoded and decoded forms of the data
+    // for the i-th vertex or edge.
+    span<const uint8_t> getEncoded(uint64_t i) const
+    {
+        return data[i];
+    }
+    void get(uint64_t i, vector< pair<uint32_t, CompressedCoverageData> >&) const;
+    vector< pair<uint32_t, CompressedCoverageData> > get(uint64_t i) const
+    {
+        vector< pair<uint32_t, CompressedCoverageData> > v;
+        get(i, v);
+        return v;
+    }
+
+    // Low level access, for Python.
+    const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& getData() const
+    {
+        return data;
+    }
+
+    static void encode(
+        const vector< pair<uint32_t, CompressedCoverageData> >&,
+        vector<uint8_t>&);
+    static void decode(
+        span<const uint8_t>,
+        vector< pair<uint32_t, CompressedCoverageData> >&);
+
+private:
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t> data;
+};
+
+#endif
@@ -0,0 +1,522 @@
+// Implementation of class ForceDirectedLayout - see ForceDirectedLayout.hpp for more information.
+
+// Shasta.
+#include "ForceDirectedLayout.hpp"
+#include "invalid.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cmath>
+#include <numeric>
+#include <random>
+#include "tuple.hpp"
+
+// Explicit instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<ForceDirectedLayout>;
+
+
+
+// Parameters of the layout algorithm.
+namespace {
+
+    // The relative strength of the repulsive force.
+    const double repulsionStrength = 0.2;
+
+    // Barnes-Hut opening criterion: a quadtree node is used as a whole
+    // if its size is less than theta times its distance.
+    const double theta = 0.9;
+
+    // Maximum number of vertices in a quadtree leaf.
+    const uint64_t quadTreeLeafSize = 8;
+    const uint64_t quadTreeMaxDepth = 30;
+
+    // Coarsening stops when the graph has fewer vertices than this,
+    // or when coarsening leaves more than coarseningMaxRatio of the vertices.
+    const uint64_t minCoarsenedVertexCount = 20;
+    const double coarseningMaxRatio = 0.8;
+
+    // Iterations and step length control.
+    const uint64_t coarsestLevelMaxIterationCount = 500;
+    const uint64_t finerLevelsMaxIterationCount = 50;
+    const double cooling = 0.9;
+    const double convergenceTolerance = 0.01;
+
+    // Below this number of vertices the forces are computed
+    // in the calling thread.
+    const uint64_t minVertexCountForThreads = 2000;
+
+    const uint64_t seed = 231;
+}
+
+
+
+ForceDirectedLayout::ForceDirectedLayout(
+    uint64_t vertexCount,
+    const vector< pair<uint64_t, uint64_t> >& edges,
+    const vector<double>& edgeLengths,
+    double timeout,
+    uint64_t threadCountArgument,
+    vector< array<double, 2> >& positions) :
+    MultithreadedObject(*this),
+    threadCount(threadCountArgument),
+    timeout(timeout),
+    startTime(steady_clock::now())
+{
+    SHASTA_ASSERT(edges.size() == edgeLengths.size());
+    positions.clear();
+    if(vertexCount == 0) {
+        return;
+    }
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    threadCount = max(threadCount, uint64_t(1));
+
+    // Create the levels.
+    levels.resize(1);
+    levels.front().create(vertexCount, edges, edgeLengths);
+    while(levels.back().vertexCount >= minCoarsenedVertexCount) {
+        const uint64_t oldLevelCount = levels.size();
+        coarsen();
+        if(levels.size() == oldLevelCount) {
+            break;
+        }
+    }
+
+    // Lay out the coarsest level starting from random positions.
+    std::mt19937 randomGenerator(seed);
+    {
+        level = &levels.back();
+        const double K = level->averageLength;
+        const double side = K * std::sqrt(double(level->vertexCount));
+        std::uniform_real_distribution<double> distribution(0., side);
+        levelPositions.resize(level->vertexCount);
+        for(array<double, 2>& x: levelPositions) {
+            x[0] = distribution(randomGenerator);
+            x[1] = distribution(randomGenerator);
+        }
+        if(not layoutLevel(coarsestLevelMaxIterationCount, K)) {
+            timeoutTriggered = true;
+            return;
+        }
+    }
+
+    // Use the layout of each level as the starting point for the next finer level.
+    for(uint64_t i=levels.size()-1; i>0; i--) {
+        const Level& coarseLevel = levels[i];
+        const Level& fineLevel = levels[i-1];
+
+        // The finer level has more vertices and needs more space.
+        const double scale = std::sqrt(double(fineLevel.vertexCount) / double(coarseLevel.vertexCount));
+        const double jitter = 0.1 * fineLevel.averageLength;
+        std::uniform_real_distribution<double> distribution(-jitter, jitter);
+        vector< array<double, 2> > finePositions(fineLevel.vertexCount);
+        for(uint64_t v=0; v<fineLevel.vertexCount; v++) {
+            const array<double, 2>& x = levelPositions[fineLevel.coarseVertex[v]];
+            finePositions[v][0] = scale * x[0] + distribution(randomGenerator);
+            finePositions[v][1] = scale * x[1] + distribution(randomGenerator);
+        }
+        levelPositions.swap(finePositions);
+
+        level = &fineLevel;
+        if(not layoutLevel(finerLevelsMaxIterationCount, 0.3 * fineLevel.averageLength)) {
+            timeoutTriggered = true;
+            return;
+        }
+    }
+
+
+
+    // Scale the layout so the average edge length
+    // equals the average desired edge length.
+    const Level& finestLevel = levels.front();
+    double lengthSum = 0.;
+    uint64_t edgeCount = 0;
+    for(uint64_t v0=0; v0<finestLevel.vertexCount; v0++) {
+        for(uint64_t j=finestLevel.adjacencyBegin[v0]; j<finestLevel.adjacencyBegin[v0+1]; j++) {
+            const uint64_t v1 = finestLevel.neighbors[j];
+            if(v1 > v0) {
+                const double dx = levelPositions[v1][0] - levelPositions[v0][0];
+                const double dy = levelPositions[v1][1] - levelPositions[v0][1];
+                lengthSum += std::sqrt(dx * dx + dy * dy);
+                ++edgeCount;
+            }
+        }
+    }
+    if(edgeCount > 0 and lengthSum > 0.) {
+        const double scale = finestLevel.averageLength / (lengthSum / double(edgeCount));
+        for(array<double, 2>& x: levelPositions) {
+            x[0] *= scale;
+            x[1] *= scale;
+        }
+    }
+
+    positions.swap(levelPositions);
+}
+
+
+
+void ForceDirectedLayout::Level::create(
+    uint64_t vertexCountArgument,
+    const vector< pair<uint64_t, uint64_t> >& edges,
+    const vector<double>& edgeLengths)
+{
+    vertexCount = vertexCountArgument;
+
+    // Count the neighbors of each vertex.
+    vector<uint64_t> degree(vertexCount, 0);
+    double lengthSum = 0.;
+    uint64_t edgeCount = 0;
+    for(uint64_t i=0; i<edges.size(); i++) {
+        const auto& edge = edges[i];
+        SHASTA_ASSERT(edge.first < vertexCount);
+        SHASTA_ASSERT(edge.second < vertexCount);
+        if(edge.first != edge.second) {
+            ++degree[edge.first];
+            ++degree[edge.second];
+            lengthSum += edgeLengths[i];
+            ++edgeCount;
+        }
+    }
+    averageLength = (edgeCount > 0 and lengthSum > 0.) ? lengthSum / double(edgeCount) : 1.;
+
+    // Fill in the adjacency lists.
+    adjacencyBegin.resize(vertexCount + 1);
+    adjacencyBegin[0] = 0;
+    for(uint64_t v=0; v<vertexCount; v++) {
+        adjacencyBegin[v+1] = adjacencyBegin[v] + degree[v];
+    }
+    neighbors.resize(adjacencyBegin.back());
+    lengths.resize(adjacencyBegin.back());
+    vector<uint64_t> next(adjacencyBegin.begin(), adjacencyBegin.end() - 1);
+    for(uint64_t i=0; i<edges.size(); i++) {
+        const auto& edge = edges[i];
+        if(edge.first != edge.second) {
+            // Nonpositive lengths are replaced by the average length.
+            const double length = edgeLengths[i] > 0. ? edgeLengths[i] : averageLength;
+            neighbors[next[edge.first]] = edge.second;
+            lengths[next[edge.first]++] = length;
+            neighbors[next[edge.second]] = edge.first;
+            lengths[next[edge.second]++] = length;
+        }
+    }
+}
+
+
+
+// Create a coarser level by collapsing the edges of a maximal matching.
+// Each vertex is matched with its unmatched neighbor of lowest degree,
+// so leaves are collapsed preferentially.
+// If this does not reduce the number of vertices enough,
+// no level is added.
+void ForceDirectedLayout::coarsen()
+{
+    Level& fineLevel = levels.back();
+    const uint64_t n = fineLevel.vertexCount;
+
+    // Visit the vertices in random order.
+    vector<uint64_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 randomGenerator(seed + levels.size());
+    std::shuffle(order.begin(), order.end(), randomGenerator);
+
+    fineLevel.coarseVertex.assign(n, invalid<uint64_t>);
+    uint64_t coarseVertexCount = 0;
+    for(const uint64_t v: order) {
+        if(fineLevel.coarseVertex[v] != invalid<uint64_t>) {
+            continue;
+        }
+        uint64_t bestNeighbor = invalid<uint64_t>;
+        uint64_t bestDegree = invalid<uint64_t>;
+        for(uint64_t j=fineLevel.adjacencyBegin[v]; j<fineLevel.adjacencyBegin[v+1]; j++) {
+            const uint64_t u = fineLevel.neighbors[j];
+            if(fineLevel.coarseVertex[u] == invalid<uint64_t>) {
+                const uint64_t degree = fineLevel.adjacencyBegin[u+1] - fineLevel.adjacencyBegin[u];
+                if(degree < bestDegree) {
+                    bestNeighbor = u;
+                    bestDegree = degree;
+                }
+            }
+        }
+        fineLevel.coarseVertex[v] = coarseVertexCount;
+        if(bestNeighbor != invalid<uint64_t>) {
+            fineLevel.coarseVertex[bestNeighbor] = coarseVertexCount;
+        }
+        ++coarseVertexCount;
+    }
+
+    if(double(coarseVertexCount) > coarseningMaxRatio * double(n)) {
+        fineLevel.coarseVertex.clear();
+        return;
+    }
+
+
+
+    // Gather the coarse edges. Parallel edges are merged
+    // and their desired length is the average of the lengths of the fine edges.
+    vector< tuple<uint64_t, uint64_t, double> > fineEdges;
+    for(uint64_t v0=0; v0<n; v0++) {
+        const uint64_t c0 = fineLevel.coarseVertex[v0];
+        for(uint64_t j=fineLevel.adjacencyBegin[v0]; j<fineLevel.adjacencyBegin[v0+1]; j++) {
+            const uint64_t v1 = fineLevel.neighbors[j];
+            const uint64_t c1 = fineLevel.coarseVertex[v1];
+            if(c0 < c1) {
+                fineEdges.push_back(make_tuple(c0, c1, fineLevel.lengths[j]));
+            }
+        }
+    }
+    sort(fineEdges.begin(), fineEdges.end());
+
+    vector< pair<uint64_t, uint64_t> > coarseEdges;
+    vector<double> coarseLengths;
+    for(uint64_t i=0; i<fineEdges.size(); ) {
+        const uint64_t c0 = get<0>(fineEdges[i]);
+        const uint64_t c1 = get<1>(fineEdges[i]);
+        double lengthSum = 0.;
+        uint64_t count = 0;
+        for(; i<fineEdges.size() and get<0>(fineEdges[i])==c0 and get<1>(fineEdges[i])==c1; i++) {
+            lengthSum += get<2>(fineEdges[i]);
+            ++count;
+        }
+        coarseEdges.push_back(make_pair(c0, c1));
+        coarseLengths.push_back(lengthSum / double(count));
+    }
+
+    // This invalidates fineLevel.
+    levels.emplace_back();
+    levels.back().create(coarseVertexCount, coarseEdges, coarseLengths);
+}
+
+
+
+// Refine levelPositions for the current level.
+// Returns false if the timeout was exceeded.
+bool ForceDirectedLayout::layoutLevel(uint64_t maxIterationCount, double initialStep)
+{
+    const uint64_t n = level->vertexCount;
+    const double K = level->averageLength;
+    repulsionConstant = repulsionStrength * K * K;
+    forces.resize(n);
+
+    double step = initialStep;
+    double oldEnergy = std::numeric_limits<double>::max();
+    uint64_t progress = 0;
+    for(uint64_t iteration=0; iteration<maxIterationCount; iteration++) {
+        if(timeoutExceeded()) {
+            return false;
+        }
+
+        // Compute the forces.
+        createQuadTree();
+        if(threadCount > 1 and n >= minVertexCountForThreads) {
+            setupLoadBalancing(n, 64);
+            runThreads(&ForceDirectedLayout::computeForcesThreadFunction, threadCount);
+        } else {
+            for(uint64_t v=0; v<n; v++) {
+                forces[v] = computeForce(v);
+            }
+        }
+
+        // Move each vertex by step in the direction of its force.
+        double energy = 0.;
+        for(uint64_t v=0; v<n; v++) {
+            const array<double, 2>& f = forces[v];
+            const double f2 = f[0] * f[0] + f[1] * f[1];
+            energy += f2;
+            if(f2 > 0.) {
+                const double factor = step / std::sqrt(f2);
+                levelPositions[v][0] += factor * f[0];
+                levelPositions[v][1] += factor * f[1];
+            }
+        }
+
+        // Adaptive step length.
+        if(energy < oldEnergy) {
+            ++progress;
+            if(progress >= 5) {
+                progress = 0;
+                step /= cooling;
+            }
+        } else {
+            progress = 0;
+            step *= cooling;
+        }
+        oldEnergy = energy;
+
+        if(step < convergenceTolerance * K) {
+            break;
+        }
+    }
+    return true;
+}
+
+
+
+void ForceDirectedLayout::computeForcesThreadFunction(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t v=begin; v!=end; v++) {
+            forces[v] = computeForce(v);
+        }
+    }
+}
+
+
+
+array<double, 2> ForceDirectedLayout::computeForce(uint64_t v) const
+{
+    array<double, 2> f = computeRepulsion(v);
+
+    // Attraction from the neighbors.
+    const array<double, 2>& x = levelPositions[v];
+    for(uint64_t j=level->adjacencyBegin[v]; j<level->adjacencyBegin[v+1]; j++) {
+        const array<double, 2>& y = levelPositions[level->neighbors[j]];
+        const double dx = y[0] - x[0];
+        const double dy = y[1] - x[1];
+        const double factor = std::sqrt(dx * dx + dy * dy) / level->lengths[j];
+        f[0] += factor * dx;
+        f[1] += factor * dy;
+    }
+    return f;
+}
+
+
+
+// Repulsion from all other vertices, using the Barnes-Hut approximation.
+array<double, 2> ForceDirectedLayout::computeRepulsion(uint64_t v) const
+{
+    const array<double, 2>& x = levelPositions[v];
+    array<double, 2> f = {0., 0.};
+
+    array<uint64_t, 4 * quadTreeMaxDepth + 4> stack;
+    uint64_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0) {
+        const QuadTreeNode& node = quadTree[stack[--stackSize]];
+        const double dx = x[0] - node.centerOfMass[0];
+        const double dy = x[1] - node.centerOfMass[1];
+        const double d2 = dx * dx + dy * dy;
+
+        if(node.children[0] == invalid<uint64_t> and
+            node.children[1] == invalid<uint64_t> and
+            node.children[2] == invalid<uint64_t> and
+            node.children[3] == invalid<uint64_t>) {
+
+            // Leaf: add the contribution of each vertex.
+            for(uint64_t i=node.begin; i!=node.end; i++) {
+                const uint64_t u = quadTreeVertices[i];
+                if(u == v) {
+                    continue;
+                }
+                const array<double, 2>& y = levelPositions[u];
+                const double ex = x[0] - y[0];
+                const double ey = x[1] - y[1];
+                const double e2 = ex * ex + ey * ey;
+                if(e2 > 0.) {
+                    const double factor = repulsionConstant / e2;
+                    f[0] += factor * ex;
+                    f[1] += factor * ey;
+                }
+            }
+
+        } else if(node.size * node.size < theta * theta * d2) {
+
+            // Far enough: use the node as a whole.
+            const double factor = double(node.count) * repulsionConstant / d2;
+            f[0] += factor * dx;
+            f[1] += factor * dy;
+
+        } else {
+            for(const uint64_t child: node.children) {
+                if(child != invalid<uint64_t>) {
+                    stack[stackSize++] = child;
+                }
+            }
+        }
+    }
+    return f;
+}
+
+
+
+void ForceDirectedLayout::createQuadTree()
+{
+    const uint64_t n = level->vertexCount;
+    quadTreeVertices.resize(n);
+    std::iota(quadTreeVertices.begin(), quadTreeVertices.end(), 0);
+
+    // Bounding square.
+    array<double, 2> xMin = levelPositions.front();
+    array<double, 2> xMax = xMin;
+    for(const array<double, 2>& x: levelPositions) {
+        for(uint64_t i=0; i<2; i++) {
+            xMin[i] = min(xMin[i], x[i]);
+            xMax[i] = max(xMax[i], x[i]);
+        }
+    }
+    const double size = max(max(xMax[0] - xMin[0], xMax[1] - xMin[1]) * 1.0001, 1.e-12);
+
+    quadTree.clear();
+    createQuadTreeNode(0, n, xMin, size, 0);
+}
+
+
+
+uint64_t ForceDirectedLayout::createQuadTreeNode(
+    uint64_t begin, uint64_t end,
+    array<double, 2> lowerCorner, double size,
+    uint64_t depth)
+{
+    const uint64_t nodeIndex = quadTree.size();
+    quadTree.emplace_back();
+
+    QuadTreeNode node;
+    node.size = size;
+    node.count = end - begin;
+    node.begin = begin;
+    node.end = end;
+    node.centerOfMass = {0., 0.};
+    for(uint64_t i=begin; i!=end; i++) {
+        const array<double, 2>& x = levelPositions[quadTreeVertices[i]];
+        node.centerOfMass[0] += x[0];
+        node.centerOfMass[1] += x[1];
+    }
+    node.centerOfMass[0] /= double(node.count);
+    node.centerOfMass[1] /= double(node.count);
+    node.children.fill(invalid<uint64_t>);
+
+    if(node.count > quadTreeLeafSize and depth < quadTreeMaxDepth) {
+
+        // Partition the vertices in the four quadrants.
+        const double halfSize = 0.5 * size;
+        const double xMid = lowerCorner[0] + halfSize;
+        const double yMid = lowerCorner[1] + halfSize;
+        const auto first = quadTreeVertices.begin();
+        const auto isLeft = [this, xMid](uint64_t u) {return levelPositions[u][0] < xMid;};
+        const auto isBelow = [this, yMid](uint64_t u) {return levelPositions[u][1] < yMid;};
+        const uint64_t xSplit = std::partition(first + begin, first + end, isLeft) - first;
+        const uint64_t ySplit0 = std::partition(first + begin, first + xSplit, isBelow) - first;
+        const uint64_t ySplit1 = std::partition(first + xSplit, first + end, isBelow) - first;
+
+        const array<uint64_t, 5> boundaries = {begin, ySplit0, xSplit, ySplit1, end};
+        const array<array<double, 2>, 4> corners = {
+            array<double, 2>{lowerCorner[0], lowerCorner[1]},
+            array<double, 2>{lowerCorner[0], yMid},
+            array<double, 2>{xMid, lowerCorner[1]},
+            array<double, 2>{xMid, yMid}
+        };
+        for(uint64_t i=0; i<4; i++) {
+            if(boundaries[i+1] > boundaries[i]) {
+                node.children[i] = createQuadTreeNode(
+                    boundaries[i], boundaries[i+1], corners[i], halfSize, depth + 1);
+            }
+        }
+    }
+
+    quadTree[nodeIndex] = node;
+    return nodeIndex;
+}
@@ -0,0 +1,136 @@
+#ifndef SHASTA_FORCE_DIRECTED_LAYOUT_HPP
+#define SHASTA_FORCE_DIRECTED_LAYOUT_HPP
+
+/*******************************************************************************
+
+Built-in multithreaded force directed graph layout,
+used by computeLayoutBuiltin (see computeLayout.hpp)
+as an alternative to running Graphviz or a custom layout program.
+
+This uses the multilevel spring-electrical model described in
+Yifan Hu, Efficient and High Quality Force-Directed Graph Drawing,
+The Mathematica Journal 10 (2005), which is also the basis of Graphviz sfdp:
+
+- The graph is coarsened repeatedly by collapsing the edges
+  of a maximal matching, until it is small or coarsening
+  no longer reduces its size significantly.
+- The coarsest graph is laid out starting from random positions.
+- The layout of each level is used as the starting point
+  for the next finer level, which is then refined.
+
+At each level, vertices repel each other with a force K^2/d,
+computed using a Barnes-Hut quadtree, and each edge pulls its
+two vertices together with a force d^2/L, where L is the desired
+length of the edge and K is the average desired edge length.
+Vertices move in the direction of the total force
+with an adaptive step length.
+The forces are computed in parallel.
+
+The final layout is scaled so the average edge length
+equals the average desired edge length.
+The computation is deterministic for a given graph.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include "chrono.hpp"
+#include "cstdint.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class ForceDirectedLayout;
+}
+
+
+
+class shasta::ForceDirectedLayout :
+    public MultithreadedObject<ForceDirectedLayout> {
+public:
+
+    // The vertices are numbered 0 to vertexCount-1.
+    // For each edge, the desired length is in the corresponding
+    // entry of edgeLengths. Edges that join a vertex with itself are ignored.
+    // If threadCount is 0, the number of virtual processors is used.
+    // When done, timeoutTriggered tells whether the layout was abandoned
+    // because it took longer than timeout seconds.
+    // If so, positions is left empty.
+    ForceDirectedLayout(
+        uint64_t vertexCount,
+        const vector< pair<uint64_t, uint64_t> >& edges,
+        const vector<double>& edgeLengths,
+        double timeout,
+        uint64_t threadCount,
+        vector< array<double, 2> >& positions);
+
+    bool timeoutTriggered = false;
+
+private:
+
+    // A graph in compressed sparse row format.
+    // Each edge is stored twice, once for each of its vertices.
+    class Level {
+    public:
+        uint64_t vertexCount = 0;
+        vector<uint64_t> adjacencyBegin;
+        vector<uint64_t> neighbors;
+        vector<double> lengths;
+        double averageLength = 1.;
+
+        // For each vertex, the corresponding vertex of the next coarser level.
+        vector<uint64_t> coarseVertex;
+
+        void create(
+            uint64_t vertexCount,
+            const vector< pair<uint64_t, uint64_t> >&,
+            const vector<double>&);
+    };
+    vector<Level> levels;
+    void coarsen();
+
+    // Barnes-Hut quadtree of the positions of the level being laid out.
+    class QuadTreeNode {
+    public:
+        array<double, 2> centerOfMass;
+        double size;
+        uint64_t count;
+
+        // The children, or invalid<uint64_t> for a leaf.
+        array<uint64_t, 4> children;
+
+        // For a leaf, the range of its vertices in quadTreeVertices.
+        uint64_t begin;
+        uint64_t end;
+    };
+    vector<QuadTreeNode> quadTree;
+    vector<uint64_t> quadTreeVertices;
+    void createQuadTree();
+    uint64_t createQuadTreeNode(
+        uint64_t begin, uint64_t end,
+        array<double, 2> lowerCorner, double size,
+        uint64_t depth);
+
+    // Layout of one level.
+    const Level* level = 0;
+    vector< array<double, 2> > levelPositions;
+    vector< array<double, 2> > forces;
+    double repulsionConstant = 0.;
+    bool layoutLevel(uint64_t maxIterationCount, double initialStep);
+    void computeForcesThreadFunction(size_t threadId);
+    array<double, 2> computeForce(uint64_t v) const;
+    array<double, 2> computeRepulsion(uint64_t v) const;
+
+    uint64_t threadCount;
+    double timeout;
+    steady_clock::time_point startTime;
+    bool timeoutExceeded() const
+    {
+        return timeout > 0. and seconds(steady_clock::now() - startTime) > timeout;
+    }
+};
+
+#endif
@@ -0,0 +1,203 @@
+// Shasta.
+#include "FrontCodedStrings.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+
+
+void FrontCodedStrings::createNew(const string& nameArgument, uint64_t pageSize)
+{
+    name = nameArgument;
+    data.createNew(dataName(name, "-Data"), pageSize);
+    blocks.createNew(dataName(name, "-Blocks"), pageSize);
+    blocks.push_back(0);
+    last.clear();
+}
+
+
+
+void FrontCodedStrings::accessExistingReadOnly(const string& nameArgument)
+{
+    name = nameArgument;
+    data.accessExistingReadOnly(dataName(name, "-Data"));
+    blocks.accessExistingReadOnly(dataName(name, "-Blocks"));
+}
+
+
+
+void FrontCodedStrings::accessExistingReadWrite(const string& nameArgument)
+{
+    name = nameArgument;
+    data.accessExistingReadWrite(dataName(name, "-Data"));
+    blocks.accessExistingReadWrite(dataName(name, "-Blocks"));
+}
+
+
+
+// No need to rename if anonymous memory is used.
+void FrontCodedStrings::rename(const string& newName)
+{
+    if(name.empty()) {
+        return;
+    }
+    data.rename(dataName(newName, "-Data"));
+    blocks.rename(dataName(newName, "-Blocks"));
+    name = newName;
+}
+
+
+
+void FrontCodedStrings::remove()
+{
+    data.remove();
+    blocks.remove();
+    last.clear();
+}
+
+
+
+void FrontCodedStrings::append(span<const char> s)
+{
+    const uint64_t i = size();
+
+    if((i % blockSize) == 0) {
+
+        // This is the first string of a new block. Store it in full.
+        blocks.push_back(data.size());
+        appendLength(s.size());
+        for(const char c: s) {
+            data.push_back(c);
+        }
+
+    } else {
+
+        // Store the length of the prefix shared with the previous string,
+        // followed by the rest of this string.
+        const uint64_t prefixLength = uint64_t(
+            std::mismatch(s.begin(), s.end(), last.begin(), last.end()).first - s.begin());
+        appendLength(prefixLength);
+        appendLength(s.size() - prefixLength);
+        for(uint64_t j=prefixLength; j<s.size(); j++) {
+            data.push_back(s[j]);
+        }
+    }
+
+    last.assign(s.begin(), s.end());
+    ++blocks[0];
+}
+
+
+
+void FrontCodedStrings::unreserve()
+{
+    data.unreserve();
+    blocks.unreserve();
+    last.clear();
+    last.shrink_to_fit();
+}
+
+
+
+void FrontCodedStrings::copyFrom(const FrontCodedStrings& that)
+{
+    SHASTA_ASSERT(size() == 0);
+    data.resize(that.data.size());
+    std::copy(that.data.begin(), that.data.end(), data.begin());
+    blocks.resize(that.blocks.size());
+    std::copy(that.blocks.begin(), that.blocks.end(), blocks.begin());
+}
+
+
+
+void FrontCodedStrings::get(uint64_t i, string& s) const
+{
+    SHASTA_ASSERT(i < size());
+    const char* p = getFirst(i / blockSize, s);
+    for(uint64_t j=0; j<(i % blockSize); j++) {
+        const uint64_t prefixLength = readLength(p);
+        const uint64_t suffixLength = readLength(p);
+        s.resize(prefixLength);
+        s.append(p, suffixLength);
+        p += suffixLength;
+    }
+}
+
+
+
+uint64_t FrontCodedStrings::lowerBound(span<const char> s) const
+{
+    const uint64_t n = size();
+    const uint64_t blockCount = blocks.size() - 1;
+    string t;
+
+    // Binary search for the first block whose first string is not less than s.
+    uint64_t b0 = 0;
+    uint64_t b1 = blockCount;
+    while(b0 < b1) {
+        const uint64_t b = (b0 + b1) / 2;
+        getFirst(b, t);
+        if(std::lexicographical_compare(t.begin(), t.end(), s.begin(), s.end())) {
+            b0 = b + 1;
+        } else {
+            b1 = b;
+        }
+    }
+    if(b0 == 0) {
+        return 0;
+    }
+
+    // The answer is in the previous block, or it is the first string of block b0.
+    const uint64_t b = b0 - 1;
+    const char* p = getFirst(b, t);
+    uint64_t i = b * blockSize;
+    const uint64_t end = min(n, i + blockSize);
+    for(++i; i<end; i++) {
+        const uint64_t prefixLength = readLength(p);
+        const uint64_t suffixLength = readLength(p);
+        t.resize(prefixLength);
+        t.append(p, suffixLength);
+        p += suffixLength;
+        if(not std::lexicographical_compare(t.begin(), t.end(), s.begin(), s.end())) {
+            return i;
+        }
+    }
+    return end;
+}
+
+
+
+const char* FrontCodedStrings::getFirst(uint64_t b, string& s) const
+{
+    const char* p = data.begin() + blocks[1 + b];
+    const uint64_t length = readLength(p);
+    s.assign(p, length);
+    return p + length;
+}
+
+
+
+void FrontCodedStrings::appendLength(uint64_t length)
+{
+    while(length >= 128) {
+        data.push_back(char(uint8_t(length & 127) | 128));
+        length >>= 7;
+    }
+    data.push_back(char(uint8_t(length)));
+}
+
+
+
+uint64_t FrontCodedStrings::readLength(const char*& p)
+{
+    uint64_t length = 0;
+    for(uint64_t shift=0; ; shift+=7) {
+        const uint8_t byte = uint8_t(*p++);
+        length |= uint64_t(byte & 127) << shift;
+        if((byte & 128) == 0) {
+            return length;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef SHASTA_FRONT_CODED_STRINGS_HPP
+#define SHASTA_FRONT_CODED_STRINGS_HPP
+
+/*******************************************************************************
+
+A memory mapped sequence of strings stored using front coding.
+
+The strings are divided in blocks of blockSize consecutive strings.
+The first string of each block is stored in full.
+Each of the remaining strings is stored as the length of the
+prefix it shares with the previous string, followed by the
+rest of the string. Lengths are stored as variable length integers
+(7 bits per byte, high bit set if more bytes follow).
+So each entry is, in order:
+- The shared prefix length (omitted for the first string of a block).
+- The suffix length.
+- The suffix characters.
+
+Getting string i requires decoding at most blockSize entries,
+starting at the beginning of its block.
+If the strings are sorted, the first strings of the blocks
+can also be used for a binary search (see lowerBound).
+
+Front coding works best when consecutive strings share long prefixes,
+for example read names sorted by name, or nanopore read meta data,
+which begins with the same runid for all reads of a run.
+
+The strings are added sequentially using append, and cannot be modified.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MemoryMappedVector.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "span.hpp"
+#include "string.hpp"
+
+namespace shasta {
+    class FrontCodedStrings;
+}
+
+
+
+class shasta::FrontCodedStrings {
+public:
+
+    static const uint64_t blockSize = 16;
+
+    // The data are stored in name-Data and name-Blocks.
+    // An empty name means anonymous memory.
+    void createNew(const string& name, uint64_t pageSize);
+    void accessExistingReadOnly(const string& name);
+    void accessExistingReadWrite(const string& name);
+    void rename(const string& newName);
+    void remove();
+    bool isOpen() const
+    {
+        return data.isOpen and blocks.isOpen;
+    }
+    string getName() const
+    {
+        return name;
+    }
+
+    // Append a string at the end.
+    // This can only be used after createNew.
+    void append(span<const char>);
+    void append(const string& s)
+    {
+        append(span<const char>(s.data(), s.size()));
+    }
+    void unreserve();
+
+    // Make this a copy of another FrontCodedStrings. This must be empty.
+    void copyFrom(const FrontCodedStrings&);
+
+    uint64_t size() const
+    {
+        return blocks.empty() ? 0 : blocks[0];
+    }
+
+    // Get string i.
+    void get(uint64_t i, string&) const;
+    string operator[](uint64_t i) const
+    {
+        string s;
+        get(i, s);
+        return s;
+    }
+
+    // Return the index of the first string not less than s,
+    // in lexicographical order. Only meaningful if the strings are sorted.
+    uint64_t lowerBound(span<const char> s) const;
+
+    // The number of bytes used by the data.
+    uint64_t totalSize() const
+    {
+        return data.size() * sizeof(char) + blocks.size() * sizeof(uint64_t);
+    }
+
+private:
+
+    // The encoded entries for all strings.
+    MemoryMapped::Vector<char> data;
+
+    // blocks[0] is the number of strings.
+    // blocks[1+b] is the position in data of the first entry of block b.
+    MemoryMapped::Vector<uint64_t> blocks;
+
+    string name;
+
+    // The last string appended. Only used while appending.
+    string last;
+
+    void appendLength(uint64_t);
+    static uint64_t readLength(const char*& p);
+
+    // Decode the first string of block b, and return
+    // a pointer to the next entry.
+    const char* getFirst(uint64_t b, string&) const;
+    static string dataName(const string& name, const string& suffix)
+    {
+        return name.empty() ? "" : (name + suffix);
+    }
+};
+
+#endif
@@ -12,6 +12,8 @@
 
 // Shasta.
 #include "Base.hpp"
+#include "Bgzf.hpp"
+#include "ParallelWriter.hpp"
 #include "SHASTA_ASSERT.hpp"
 
 // Boost libraries.
@@ -132,15 +134,19 @@ public:
     }
 
     // Write out in GFA format.
-    void write(const string& fileName) const
+    // The segments are formatted using threadCount threads
+    // (0 means all available hardware threads).
+    // If the file name ends with .gz, the output is compressed
+    // in BGZF format and indexed (see Bgzf.hpp).
+    void write(const string& fileName, size_t threadCount = 1) const
     {
-        ofstream gfa(fileName);
-        write(gfa);
+        const auto gfaPointer = openOutputFile(fileName, threadCount);
+        write(*gfaPointer, threadCount);
     }
-    void write(ostream& gfa) const
+    void write(ostream& gfa, size_t threadCount = 1) const
     {
         writeHeader(gfa);
-        writeSegments(gfa);
+        writeSegments(gfa, threadCount);
         writeLinks(gfa);
         writePaths(gfa);
     }
@@ -167,26 +173,34 @@ private:
     }
 
     // Write a segment for each edge.
-    void writeSegments(ostream& gfa) const
+    void writeSegments(ostream& gfa, size_t threadCount) const
     {
         const G& g = *this;
 
-        // Write one segment for each edge.
+        // Gather the edges, so the segments can be formatted in parallel.
+        vector<const GfaAssemblyGraphEdge*> segments;
         BGL_FORALL_EDGES_T(e, g, G) {
-            const GfaAssemblyGraphEdge& edge = g[e];
+            segments.push_back(&g[e]);
+        }
+
+        // Write one segment for each edge.
+        ParallelWriter writer(gfa, threadCount);
+        writer.write(segments.size(), [&](uint64_t i, string& s) {
+            const GfaAssemblyGraphEdge& edge = *segments[i];
 
-            gfa << "S\t" << edge.name << "\t";
+            s += "S\t" + edge.name + "\t";
 
             if(edge.sequenceIsAvailable) {
-                copy(edge.sequence.begin(), edge.sequence.end(),
-                    ostream_iterator<Base>(gfa));
-                gfa << "\tLN:i:" << edge.sequenceLength << "\n";
+                for(const Base b: edge.sequence) {
+                    s.push_back(b.character());
+                }
+                s += "\tLN:i:" + to_string(edge.sequenceLength) + "\n";
             } else if (edge.sequenceLengthIsAvailable) {
-                gfa << "*\tLN:i:" << edge.sequenceLength << "\n";
+                s += "*\tLN:i:" + to_string(edge.sequenceLength) + "\n";
             } else {
-                gfa << "*\n";
+                s += "*\n";
             }
-        }
+        });
     }
 
 
@@ -2,16 +2,50 @@
 #include "HashedKmerChecker.hpp"
 #include "Kmer.hpp"
 #include "MemoryMappedObject.hpp"
+#include "platformDependent.hpp"
 using namespace shasta;
 
-// MurmurHash.
-#include "MurmurHash2.hpp"
-
 // Standard library.
 #include <cmath>
 
 
 
+// This is the same as
+// MurmurHash2(&kmerId, sizeof(kmerId), 267457831)
+// on little endian platforms, specialized for 8 bytes.
+// Having this inline, without a loop or switch, allows
+// the compiler to vectorize the loop in isMarkerBatch.
+inline uint32_t HashedKmerChecker::hash(KmerId kmerId)
+{
+    static_assert(sizeof(KmerId) == 8);
+    const uint32_t m = 0x5bd1e995;
+    const int r = 24;
+
+    uint32_t h = 267457831 ^ uint32_t(sizeof(KmerId));
+
+    uint32_t k0 = uint32_t(kmerId);
+    k0 *= m;
+    k0 ^= k0 >> r;
+    k0 *= m;
+    h *= m;
+    h ^= k0;
+
+    uint32_t k1 = uint32_t(kmerId >> 32);
+    k1 *= m;
+    k1 ^= k1 >> r;
+    k1 *= m;
+    h *= m;
+    h ^= k1;
+
+    h ^= h >> 13;
+    h *= m;
+    h ^= h >> 15;
+
+    return h;
+}
+
+
+
 // We must guarantee that if a KmerId if a marker
 // its reverse complement is also a marker.
 // To do this we check both.
@@ -21,7 +55,7 @@ using namespace shasta;
 bool HashedKmerChecker::isMarker(KmerId kmerId) const
 {
     // Check the KmerId.
-    if(MurmurHash2(&kmerId, sizeof(kmerId), 267457831) < hashThreshold) {
+    if(hash(kmerId) < hashThreshold) {
         return true;
     }
 
@@ -29,7 +63,42 @@ bool HashedKmerChecker::isMarker(KmerId kmerId) const
     const Kmer kmer(kmerId, k);
     const Kmer kmerRc = kmer.reverseComplement(k);
     const KmerId kmerIdRc = KmerId(kmerRc.id(k));
-    return MurmurHash2(&kmerIdRc, sizeof(kmerId), 267457831) < hashThreshold;
+    return hash(kmerIdRc) < hashThreshold;
+}
+
+
+
+// Batch version. Here the reverse complemented KmerIds are
+// provided by the caller, and we always compute both hashes.
+void HashedKmerChecker::isMarkerBatch(
+    span<const KmerId> kmerIds,
+    span<const KmerId> kmerIdsRc,
+    span<uint8_t> isMarker) const
+{
+    const uint64_t n = kmerIds.size();
+    SHASTA_ASSERT(kmerIdsRc.size() == n);
+    SHASTA_ASSERT(isMarker.size() == n);
+
+    isMarkerBatchKernel(kmerIds.data(), kmerIdsRc.data(), isMarker.data(), n, hashThreshold);
+}
+
+
+
+// The loop has no branches, so the compiler can vectorize it,
+// using the widest vector instructions available (see SHASTA_TARGET_CLONES).
+// This cannot be done in isMarkerBatch, which is virtual.
+SHASTA_TARGET_CLONES void HashedKmerChecker::isMarkerBatchKernel(
+    const KmerId* kmerIds,
+    const KmerId* kmerIdsRc,
+    uint8_t* isMarker,
+    uint64_t n,
+    uint32_t threshold)
+{
+    for(uint64_t i=0; i<n; i++) {
+        isMarker[i] = uint8_t(
+            (hash(kmerIds[i]) < threshold) |
+            (hash(kmerIdsRc[i]) < threshold));
+    }
 }
 
 
@@ -18,6 +18,10 @@ class shasta::HashedKmerChecker :
     public MappedMemoryOwner {
 public:
     bool isMarker(KmerId) const;
+    void isMarkerBatch(
+        span<const KmerId> kmerIds,
+        span<const KmerId> kmerIdsRc,
+        span<uint8_t> isMarker) const;
 
     // Initial creation.
     HashedKmerChecker(uint64_t k, double markerDensity, const MappedMemoryOwner&);
@@ -29,6 +33,18 @@ private:
     uint64_t k;
     uint32_t hashThreshold;
 
+    // MurmurHash2 of a KmerId (8 bytes) with the seed used for markers,
+    // specialized for fixed length so it can be inlined.
+    static uint32_t hash(KmerId);
+
+    // The loop used by isMarkerBatch.
+    static void isMarkerBatchKernel(
+        const KmerId* kmerIds,
+        const KmerId* kmerIdsRc,
+        uint8_t* isMarker,
+        uint64_t n,
+        uint32_t threshold);
+
     // This is used to store the hashThreshold in binary data.
     class HashedKmerCheckerData {
     public:
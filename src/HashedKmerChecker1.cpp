@@ -0,0 +1,139 @@
+// Shasta.
+#include "HashedKmerChecker1.hpp"
+#include "HashedKmerChecker.hpp"
+#include "Kmer.hpp"
+#include "KmerCounter.hpp"
+#include "Reads.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+
+
+// Initial creation.
+HashedKmerChecker1::HashedKmerChecker1(
+    uint64_t k,
+
+    // The desired marker density
+    double markerDensity,
+
+    // Exclude k-mers enriched by more than this amount.
+    // Enrichment is the ratio of k-mer frequency in reads
+    // over the average frequency of k-mers that occur in the reads.
+    double enrichmentThreshold,
+
+    const Reads& reads,
+    uint64_t threadCount,
+    const MappedMemoryOwner& mappedMemoryOwner) :
+    MappedMemoryOwner(mappedMemoryOwner),
+    k(k)
+{
+    // Sanity check.
+    if(markerDensity<0. || markerDensity>1.) {
+        throw runtime_error("Invalid marker density " +
+            to_string(markerDensity) + " requested.");
+    }
+
+    // Count the k-mers.
+    const KmerCounter kmerCounter(k, reads, threadCount, mappedMemoryOwner);
+    if(kmerCounter.distinctKmerCount == 0) {
+        throw runtime_error("No k-mers of length " + to_string(k) + " found in the reads.");
+    }
+    const double averageOccurrenceCount =
+        double(kmerCounter.totalOccurrenceCount) / double(kmerCounter.distinctKmerCount);
+
+    // Convert the enrichment threshold to a frequency.
+    const uint64_t frequencyThreshold =
+        uint64_t(enrichmentThreshold * averageOccurrenceCount);
+
+    // Gather the overenriched k-mers.
+    overenrichedKmerIds.createNew(largeDataName("OverenrichedKmerIds"), largeDataPageSize);
+    uint64_t overenrichedOccurrenceCount = 0;
+    for(uint64_t partitionId=0; partitionId<KmerCounter::partitionCount; partitionId++) {
+        for(const KmerCounter::KmerCount& kmerCount: kmerCounter.getPartition(partitionId)) {
+            if(kmerCount.frequency > frequencyThreshold) {
+                overenrichedKmerIds.push_back(kmerCount.kmerId);
+                overenrichedOccurrenceCount += kmerCount.frequency;
+            }
+        }
+    }
+    sort(overenrichedKmerIds.begin(), overenrichedKmerIds.end());
+
+    cout <<
+        "K-mer length k " << k << "\n"
+        "Total number of distinct canonical k-mers " << kmerCounter.distinctKmerCount << "\n"
+        "Total number of k-mer occurrences in all reads " << kmerCounter.totalOccurrenceCount << "\n"
+        "Average number of occurrences per k-mer " << averageOccurrenceCount << endl;
+    cout << overenrichedKmerIds.size() << " canonical k-mers were found to be "
+        "enriched by more than a factor of " << enrichmentThreshold <<
+        " and will not be used as markers." << endl;
+
+    // The overenriched k-mers are excluded, so the remaining k-mers
+    // must be selected with higher density to achieve the requested
+    // marker density. Because the hash is independent of frequency,
+    // the density of markers in the remaining k-mer occurrences is the
+    // density used by the HashedKmerChecker.
+    const uint64_t remainingOccurrenceCount =
+        kmerCounter.totalOccurrenceCount - overenrichedOccurrenceCount;
+    const double adjustedMarkerDensity =
+        markerDensity * double(kmerCounter.totalOccurrenceCount) / double(remainingOccurrenceCount);
+    if(remainingOccurrenceCount == 0 or adjustedMarkerDensity > 1.) {
+        throw runtime_error("The requested marker density cannot be achieved "
+            "after excluding overenriched k-mers.");
+    }
+    hashedKmerChecker = make_shared<HashedKmerChecker>(k, adjustedMarkerDensity, mappedMemoryOwner);
+}
+
+
+
+// Creation from binary data.
+HashedKmerChecker1::HashedKmerChecker1(
+    uint64_t k,
+    const MappedMemoryOwner& mappedMemoryOwner) :
+    MappedMemoryOwner(mappedMemoryOwner),
+    k(k)
+{
+    overenrichedKmerIds.accessExistingReadOnly(largeDataName("OverenrichedKmerIds"));
+    hashedKmerChecker = make_shared<HashedKmerChecker>(mappedMemoryOwner);
+}
+
+
+
+bool HashedKmerChecker1::isOverenriched(KmerId canonicalKmerId) const
+{
+    return std::binary_search(overenrichedKmerIds.begin(), overenrichedKmerIds.end(), canonicalKmerId);
+}
+
+
+
+bool HashedKmerChecker1::isMarker(KmerId kmerId) const
+{
+    if(not hashedKmerChecker->isMarker(kmerId)) {
+        return false;
+    }
+    const Kmer kmer(kmerId, k);
+    const KmerId kmerIdRc = KmerId(kmer.reverseComplement(k).id(k));
+    return not isOverenriched(KmerCounter::canonicalKmerId(kmerId, kmerIdRc));
+}
+
+
+
+// Use the HashedKmerChecker batch version, then exclude
+// overenriched k-mers. Only k-mers that pass the hash check
+// need to be looked up.
+void HashedKmerChecker1::isMarkerBatch(
+    span<const KmerId> kmerIds,
+    span<const KmerId> kmerIdsRc,
+    span<uint8_t> isMarker) const
+{
+    hashedKmerChecker->isMarkerBatch(kmerIds, kmerIdsRc, isMarker);
+    if(overenrichedKmerIds.empty()) {
+        return;
+    }
+    for(uint64_t i=0; i<kmerIds.size(); i++) {
+        if(isMarker[i] and isOverenriched(KmerCounter::canonicalKmerId(kmerIds[i], kmerIdsRc[i]))) {
+            isMarker[i] = 0;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef SHASTA_HASHED_KMER_CHECKER1_HPP
+#define SHASTA_HASHED_KMER_CHECKER1_HPP
+
+#include "KmerChecker.hpp"
+#include "MappedMemoryOwner.hpp"
+#include "MemoryMappedVector.hpp"
+#include "memory.hpp"
+
+namespace shasta {
+    class HashedKmerChecker1;
+    class HashedKmerChecker;
+    class Reads;
+}
+
+
+// Hashed KmerChecker for marker generation method 1 (random selection,
+// excluding k-mers that are globally overenriched). This is used
+// instead of KmerTable1 for k>15, up to k=31.
+// The frequency of all k-mers in the reads is computed using
+// a KmerCounter. The overenriched k-mers are stored
+// as sorted canonical KmerIds, and the remaining k-mers are selected
+// as markers using a HashedKmerChecker, with a marker density
+// adjusted to compensate for the overenriched k-mers that were excluded.
+// Because KmerId space is too large for k>15, the average frequency
+// used to define enrichment is computed over the k-mers
+// that actually occur in the reads, not over all possible k-mers
+// as in KmerTable1.
+class shasta::HashedKmerChecker1 :
+    public KmerChecker,
+    public MappedMemoryOwner {
+public:
+    bool isMarker(KmerId) const;
+    void isMarkerBatch(
+        span<const KmerId> kmerIds,
+        span<const KmerId> kmerIdsRc,
+        span<uint8_t> isMarker) const;
+
+    // Initial creation.
+    HashedKmerChecker1(
+        uint64_t k,
+        double markerDensity,
+        double enrichmentThreshold,
+        const Reads&,
+        uint64_t threadCount,
+        const MappedMemoryOwner&);
+
+    // Creation from binary data.
+    HashedKmerChecker1(uint64_t k, const MappedMemoryOwner&);
+
+private:
+    uint64_t k;
+    shared_ptr<HashedKmerChecker> hashedKmerChecker;
+
+    // The canonical KmerIds of the overenriched k-mers, sorted.
+    MemoryMapped::Vector<KmerId> overenrichedKmerIds;
+    bool isOverenriched(KmerId canonicalKmerId) const;
+};
+
+
+
+#endif
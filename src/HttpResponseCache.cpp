@@ -0,0 +1,164 @@
+// Implementation of class HttpResponseCache - see HttpResponseCache.hpp for more information.
+
+// Shasta.
+#include "HttpResponseCache.hpp"
+#include "algorithm.hpp"
+#include "MurmurHash2.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <filesystem>
+#include "fstream.hpp"
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+
+
+thread_local bool HttpResponseCache::responseIsCacheable = true;
+
+
+
+HttpResponseCache::HttpResponseCache(uint64_t maxBytes, const string& directory) :
+    maxBytes(maxBytes),
+    directory(directory)
+{
+    if(not directory.empty()) {
+        std::filesystem::create_directories(directory);
+    }
+}
+
+
+
+// The normalized request is the keyword followed by
+// the (name, value) pairs sorted by name.
+string HttpResponseCache::key(const vector<string>& request)
+{
+    vector< pair<string, string> > parameters;
+    for(uint64_t i=1; i+1<request.size(); i+=2) {
+        parameters.push_back(make_pair(request[i], request[i+1]));
+    }
+    std::stable_sort(parameters.begin(), parameters.end(),
+        [](const pair<string, string>& x, const pair<string, string>& y)
+        {
+            return x.first < y.first;
+        });
+
+    string key = request.front();
+    char separator = '?';
+    for(const auto& p: parameters) {
+        key += separator;
+        key += p.first;
+        key += '=';
+        key += p.second;
+        separator = '&';
+    }
+    return key;
+}
+
+
+
+bool HttpResponseCache::get(const string& key, string& response)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = responseMap.find(key);
+        if(it != responseMap.end()) {
+            // Move it to the front of the list.
+            responses.splice(responses.begin(), responses, it->second);
+            response = it->second->second;
+            return true;
+        }
+    }
+
+    // Look in the directory.
+    // The first line of the file contains the key,
+    // used to detect hash collisions.
+    if(directory.empty()) {
+        return false;
+    }
+    ifstream file(fileName(key), std::ios::binary);
+    if(not file) {
+        return false;
+    }
+    string fileKey;
+    std::getline(file, fileKey);
+    if(fileKey != key) {
+        return false;
+    }
+    std::ostringstream s;
+    s << file.rdbuf();
+    response = s.str();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    insert(key, response);
+    return true;
+}
+
+
+
+void HttpResponseCache::put(const string& key, const string& response)
+{
+    // The key is stored on a line by itself.
+    if(key.find('\n') != string::npos) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        insert(key, response);
+    }
+
+    // Write it to the directory. Write to a temporary file first, then rename,
+    // so other threads never see a partially written file.
+    if(not directory.empty()) {
+        const string name = fileName(key);
+        std::ostringstream temporaryName;
+        temporaryName << name << "." << std::this_thread::get_id() << ".tmp";
+        {
+            ofstream file(temporaryName.str(), std::ios::binary);
+            file << key << "\n" << response;
+            if(not file) {
+                return;
+            }
+        }
+        std::error_code errorCode;
+        std::filesystem::rename(temporaryName.str(), name, errorCode);
+        if(errorCode) {
+            std::filesystem::remove(temporaryName.str(), errorCode);
+        }
+    }
+}
+
+
+
+// Insert in memory and evict the oldest responses as necessary.
+// The caller must hold the mutex.
+void HttpResponseCache::insert(const string& key, const string& response)
+{
+    const uint64_t bytes = key.size() + response.size();
+    if(bytes > maxBytes or responseMap.contains(key)) {
+        return;
+    }
+
+    responses.push_front(make_pair(key, response));
+    responseMap.insert(make_pair(key, responses.begin()));
+    totalBytes += bytes;
+
+    while(totalBytes > maxBytes) {
+        const auto& p = responses.back();
+        totalBytes -= p.first.size() + p.second.size();
+        responseMap.erase(p.first);
+        responses.pop_back();
+    }
+}
+
+
+
+string HttpResponseCache::fileName(const string& key) const
+{
+    const uint64_t hash = MurmurHash64A(key.data(), int(key.size()), 231);
+    std::ostringstream s;
+    s << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".html";
+    return s.str();
+}
@@ -0,0 +1,92 @@
+#ifndef SHASTA_HTTP_RESPONSE_CACHE_HPP
+#define SHASTA_HTTP_RESPONSE_CACHE_HPP
+
+/*******************************************************************************
+
+Cache of rendered http responses, used by the Assembler http server
+for pages that are expensive to compute, such as local graphs
+that require a layout computation.
+In explore mode the assembly data are read-only, so the response
+to a given request does not change, and requesting again
+the same page (for example via back navigation or a shared link)
+returns the cached response without recomputing it.
+
+The cache is keyed by the normalized request: the keyword followed by the
+parameters sorted by name, so the order of the parameters does not matter.
+
+Responses are kept in memory with least recently used eviction
+up to a maximum number of bytes. If a directory is specified,
+responses are also written there, one file per response,
+and are read back from there if they are not in memory.
+The directory can be reused by later runs on the same assembly,
+but must be removed if the assembly changes.
+
+While a request is processed, the code that creates the response
+can call doNotCache to prevent caching that response,
+for example when a layout computation timed out.
+
+This class is thread safe.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include <list>
+#include <mutex>
+#include "string.hpp"
+#include <unordered_map>
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class HttpResponseCache;
+}
+
+
+
+class shasta::HttpResponseCache {
+public:
+
+    // If maxBytes is 0, only the directory (if any) is used.
+    HttpResponseCache(uint64_t maxBytes, const string& directory);
+
+    static string key(const vector<string>& request);
+
+    // Return true and the response, if the key is in the cache.
+    bool get(const string& key, string& response);
+
+    void put(const string& key, const string& response);
+
+    // Functions to control caching of the response of the request
+    // being processed by the calling thread.
+    static void beginRequest()
+    {
+        responseIsCacheable = true;
+    }
+    static void doNotCache()
+    {
+        responseIsCacheable = false;
+    }
+    static bool isCacheable()
+    {
+        return responseIsCacheable;
+    }
+
+private:
+    uint64_t maxBytes;
+    string directory;
+
+    std::mutex mutex;
+
+    // The cached responses, most recently used first.
+    using List = std::list< pair<string, string> >;
+    List responses;
+    std::unordered_map<string, List::iterator> responseMap;
+    uint64_t totalBytes = 0;
+
+    void insert(const string& key, const string& response);
+    string fileName(const string& key) const;
+
+    static thread_local bool responseIsCacheable;
+};
+
+#endif
@@ -0,0 +1,295 @@
+// Implementation of class HttpResponseEncoder - see HttpResponseEncoder.hpp for more information.
+
+// Shasta.
+#include "HttpResponseEncoder.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/algorithm/string.hpp>
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cstring>
+#include <sstream>
+#include "stdexcept.hpp"
+
+
+
+// Size of the input and output buffers.
+static const uint64_t bufferSize = 64 * 1024;
+
+// If no empty line is found in this many bytes,
+// the response does not begin with headers and is sent unchanged.
+static const uint64_t maxHeadersSize = 64 * 1024;
+
+
+
+HttpResponseEncoder::HttpResponseEncoder(
+    std::streambuf& out,
+    Encoding encoding,
+    bool chunked) :
+    encoding(encoding),
+    chunked(chunked),
+    out(out)
+{
+    inputBuffer.resize(bufferSize);
+    setp(inputBuffer.data(), inputBuffer.data() + inputBuffer.size());
+}
+
+
+
+HttpResponseEncoder::~HttpResponseEncoder()
+{
+    if(zStreamIsInitialized) {
+        deflateEnd(&zStream);
+    }
+}
+
+
+
+// Choose gzip if the client accepts it, otherwise deflate,
+// otherwise no compression. Encodings with q=0 are not accepted.
+HttpResponseEncoder::Encoding HttpResponseEncoder::negotiate(const string& acceptEncoding)
+{
+    bool gzipIsAccepted = false;
+    bool deflateIsAccepted = false;
+
+    vector<string> items;
+    boost::algorithm::split(items, acceptEncoding, boost::algorithm::is_any_of(","));
+    for(const string& item: items) {
+        vector<string> tokens;
+        boost::algorithm::split(tokens, item, boost::algorithm::is_any_of(";"));
+        string name = tokens.front();
+        boost::algorithm::trim(name);
+        boost::algorithm::to_lower(name);
+
+        bool isAccepted = true;
+        for(uint64_t i=1; i<tokens.size(); i++) {
+            string parameter = tokens[i];
+            boost::algorithm::erase_all(parameter, " ");
+            if(parameter.compare(0, 2, "q=") == 0) {
+                isAccepted = (std::strtod(parameter.c_str() + 2, 0) > 0.);
+            }
+        }
+
+        if(name == "gzip" or name == "x-gzip" or name == "*") {
+            gzipIsAccepted = isAccepted;
+        } else if(name == "deflate") {
+            deflateIsAccepted = isAccepted;
+        }
+    }
+
+    if(gzipIsAccepted) {
+        return Encoding::gzip;
+    } else if(deflateIsAccepted) {
+        return Encoding::deflate;
+    } else {
+        return Encoding::identity;
+    }
+}
+
+
+
+const char* HttpResponseEncoder::encodingName(Encoding encoding)
+{
+    switch(encoding) {
+    case Encoding::gzip:
+        return "gzip";
+    case Encoding::deflate:
+        return "deflate";
+    default:
+        return "identity";
+    }
+}
+
+
+
+HttpResponseEncoder::int_type HttpResponseEncoder::overflow(int_type c)
+{
+    if(failed) {
+        return traits_type::eof();
+    }
+    processInputBuffer();
+    if(failed) {
+        return traits_type::eof();
+    }
+    if(not traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+
+
+void HttpResponseEncoder::processInputBuffer()
+{
+    const char* begin = pbase();
+    const char* end = pptr();
+    if(inHeaders) {
+        processHeaders(begin, end);
+    } else {
+        writeBody(begin, end, false);
+    }
+    setp(inputBuffer.data(), inputBuffer.data() + inputBuffer.size());
+}
+
+
+
+void HttpResponseEncoder::finish()
+{
+    if(finished) {
+        return;
+    }
+    processInputBuffer();
+
+    if(inHeaders) {
+        // We never saw the end of the headers. Send everything unchanged.
+        encoding = Encoding::identity;
+        chunked = false;
+        write(headers.data(), headers.size());
+        bodyBytes = encodedBodyBytes = 0;
+    } else {
+        writeBody(0, 0, true);
+        if(chunked) {
+            write("0\r\n\r\n", 5);
+        }
+    }
+    out.pubsync();
+    finished = true;
+}
+
+
+
+// Accumulate the headers until the empty line that terminates them.
+void HttpResponseEncoder::processHeaders(const char* begin, const char* end)
+{
+    const uint64_t oldSize = headers.size();
+    headers.append(begin, end);
+
+    // Look for the empty line, starting a bit before the new data
+    // in case it straddles the boundary.
+    const uint64_t searchBegin = (oldSize > 3) ? oldSize - 3 : 0;
+    const uint64_t position = headers.find("\r\n\r\n", searchBegin);
+    if(position == string::npos) {
+        if(headers.size() > maxHeadersSize) {
+            // This is not a response with headers. Send it unchanged.
+            encoding = Encoding::identity;
+            chunked = false;
+            inHeaders = false;
+            write(headers.data(), headers.size());
+            headers.clear();
+        }
+        return;
+    }
+
+    // Separate the body that follows the headers.
+    const string body = headers.substr(position + 4);
+    headers.resize(position + 2);
+    inHeaders = false;
+
+    writeHeaders();
+    writeBody(body.data(), body.data() + body.size(), false);
+}
+
+
+
+void HttpResponseEncoder::writeHeaders()
+{
+    // If the headers already determine how the body is sent,
+    // don't change anything.
+    string lowerCaseHeaders = headers;
+    boost::algorithm::to_lower(lowerCaseHeaders);
+    for(const char* header: {"\ncontent-length:", "\ncontent-encoding:", "\ntransfer-encoding:"}) {
+        if(lowerCaseHeaders.find(header) != string::npos) {
+            encoding = Encoding::identity;
+            chunked = false;
+        }
+    }
+
+    if(encoding != Encoding::identity) {
+        headers += "Content-Encoding: ";
+        headers += encodingName(encoding);
+        headers += "\r\nVary: Accept-Encoding\r\n";
+
+        // Favor speed over compression ratio. Most of the benefit
+        // is obtained at the lowest level, and the large pages
+        // compress well because they are very repetitive.
+        std::memset(&zStream, 0, sizeof(zStream));
+        const int windowBits = (encoding == Encoding::gzip) ? (15 + 16) : 15;
+        if(deflateInit2(&zStream, Z_BEST_SPEED, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw runtime_error("Error initializing zlib compression.");
+        }
+        zStreamIsInitialized = true;
+        outputBuffer.resize(bufferSize);
+    }
+    if(chunked) {
+        headers += "Transfer-Encoding: chunked\r\n";
+    }
+    headers += "\r\n";
+
+    write(headers.data(), headers.size());
+    headers.clear();
+}
+
+
+
+void HttpResponseEncoder::writeBody(const char* begin, const char* end, bool isLast)
+{
+    const uint64_t size = end - begin;
+    bodyBytes += size;
+
+    if(encoding == Encoding::identity) {
+        if(size > 0) {
+            writeChunk(begin, size);
+        }
+        return;
+    }
+
+    // Compress, sending a chunk each time the output buffer is filled.
+    zStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(begin));
+    zStream.avail_in = uInt(size);
+    while(true) {
+        zStream.next_out = reinterpret_cast<Bytef*>(outputBuffer.data());
+        zStream.avail_out = uInt(outputBuffer.size());
+        const int status = deflate(&zStream, isLast ? Z_FINISH : Z_NO_FLUSH);
+        SHASTA_ASSERT(status != Z_STREAM_ERROR);
+        const uint64_t outputSize = outputBuffer.size() - zStream.avail_out;
+        if(outputSize > 0) {
+            writeChunk(outputBuffer.data(), outputSize);
+        }
+        if(isLast ? (status == Z_STREAM_END) : (zStream.avail_out != 0)) {
+            break;
+        }
+    }
+}
+
+
+
+void HttpResponseEncoder::writeChunk(const char* begin, uint64_t size)
+{
+    encodedBodyBytes += size;
+    if(chunked) {
+        std::ostringstream s;
+        s << std::hex << size << "\r\n";
+        const string chunkHeader = s.str();
+        write(chunkHeader.data(), chunkHeader.size());
+        write(begin, size);
+        write("\r\n", 2);
+    } else {
+        write(begin, size);
+    }
+}
+
+
+
+void HttpResponseEncoder::write(const char* begin, uint64_t size)
+{
+    if(failed) {
+        return;
+    }
+    if(out.sputn(begin, std::streamsize(size)) != std::streamsize(size)) {
+        failed = true;
+    }
+}
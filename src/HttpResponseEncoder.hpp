@@ -0,0 +1,91 @@
+#ifndef SHASTA_HTTP_RESPONSE_ENCODER_HPP
+#define SHASTA_HTTP_RESPONSE_ENCODER_HPP
+
+/*******************************************************************************
+
+Stream buffer used by HttpServer to send the response to a GET request.
+It sits between the code that writes the response and the socket.
+
+The response is written to it exactly as it would be written
+to the socket: status line, headers, an empty line, then the body.
+When the empty line is seen, the encoder adds its own headers,
+then sends the body as it is written:
+- Compressed with gzip or deflate, if the client accepts it
+  (see negotiate, which parses the Accept-Encoding header).
+- With chunked transfer encoding, if requested.
+  This allows the client to detect the end of the response
+  without a Content-Length header, and so start receiving
+  the body before it is complete.
+
+If the headers written already specify Content-Length,
+Content-Encoding, or Transfer-Encoding, the response
+is sent unchanged.
+
+finish must be called when the response is complete.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+#include <streambuf>
+#include <zlib.h>
+
+namespace shasta {
+    class HttpResponseEncoder;
+}
+
+
+
+class shasta::HttpResponseEncoder : public std::streambuf {
+public:
+
+    enum class Encoding {identity, gzip, deflate};
+
+    HttpResponseEncoder(std::streambuf& out, Encoding, bool chunked);
+    ~HttpResponseEncoder();
+
+    // Send what is left of the response.
+    void finish();
+
+    // Choose an encoding given the value of the Accept-Encoding header.
+    static Encoding negotiate(const string& acceptEncoding);
+    static const char* encodingName(Encoding);
+
+    Encoding encoding;
+    bool chunked;
+
+    // The number of bytes of the body before and after compression.
+    uint64_t bodyBytes = 0;
+    uint64_t encodedBodyBytes = 0;
+
+protected:
+    int_type overflow(int_type) override;
+
+private:
+    std::streambuf& out;
+    bool failed = false;
+    bool finished = false;
+
+    // Data written but not yet processed.
+    vector<char> inputBuffer;
+    void processInputBuffer();
+
+    // The status line and headers, until the empty line is seen.
+    bool inHeaders = true;
+    string headers;
+    void processHeaders(const char* begin, const char* end);
+    void writeHeaders();
+
+    // Compression.
+    z_stream zStream;
+    bool zStreamIsInitialized = false;
+    vector<char> outputBuffer;
+    void writeBody(const char* begin, const char* end, bool isLast);
+
+    void writeChunk(const char* begin, uint64_t size);
+    void write(const char* begin, uint64_t size);
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 // Shasta.
 #include "HttpServer.hpp"
+#include "HttpResponseEncoder.hpp"
 #include "platformDependent.hpp"
 #include "SHASTA_ASSERT.hpp"
 #include "timestamp.hpp"
@@ -21,13 +22,19 @@ using namespace asio;
 using namespace ip;
 
 // Standard library.
+#include "algorithm.hpp"
 #include "chrono.hpp"
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include "fstream.hpp"
 #include "iostream.hpp"
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <sstream>
 #include "stdexcept.hpp"
+#include <thread>
 
 // Operating system.
 #include <sys/types.h>
@@ -37,7 +44,12 @@ using namespace ip;
 // This function puts the server into an endless loop
 // of processing requests.
 // This is the function that the base class should call to start the server.
-void HttpServer::explore(uint16_t port, bool localOnly, bool sameUserOnly)
+void HttpServer::explore(
+    uint16_t port,
+    bool localOnly,
+    bool sameUserOnly,
+    uint64_t threadCount,
+    uint64_t requestTimeoutArgument)
 {
     // Sanity check on the arguments.
     if(!localOnly && sameUserOnly) {
@@ -119,39 +131,118 @@ void HttpServer::explore(uint16_t port, bool localOnly, bool sameUserOnly)
 
 
 
+    // Start the worker threads. They process connections
+    // from a queue filled by the loop below.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    threadCount = max(threadCount, uint64_t(1));
+    requestTimeout = requestTimeoutArgument;
+    const uint64_t maxQueueLength = 4 * threadCount;
+    cout << "Processing http requests using " << threadCount << " threads." << endl;
+    class Connection {
+    public:
+        tcp::iostream s;
+        tcp::endpoint remoteEndpoint;
+    };
+    std::deque< std::shared_ptr<Connection> > queue;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool done = false;
+    vector<std::thread> threads;
+    for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+        threads.push_back(std::thread([&]()
+        {
+            while(true) {
+
+                // Get a connection from the queue.
+                std::shared_ptr<Connection> connection;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCondition.wait(lock, [&]() {return done or not queue.empty();});
+                    if(queue.empty()) {
+                        return;
+                    }
+                    connection = queue.front();
+                    queue.pop_front();
+                }
+                tcp::iostream& s = connection->s;
+
+                // If sameUserOnly was specified, check that this is a local
+                // connection originating from a process owned by the same
+                // user running the server.
+                if(sameUserOnly) {
+                    SHASTA_ASSERT(localOnly);
+                    if(!isLocalConnectionSameUser(s, port)) {
+                        // Unceremoniously close the connection.
+                        cout << timestamp << "Reset a local connection originating from a process "
+                            "not owned by the same user running the server." << endl;
+                        continue;
+                    }
+                }
+
+                // Process the request.
+                // An exception only terminates this request.
+                cout << timestamp << connection->remoteEndpoint.address().to_string() << " " << flush;
+                const auto t0 = steady_clock::now();
+                try {
+                    processRequest(s);
+                } catch(const std::exception& e) {
+                    cout << timestamp << "Error processing request: " << e.what() << endl;
+                }
+                const auto t1 = steady_clock::now();
+                cout << timestamp << "Request satisfied in " << seconds(t1 - t0) << "s." << endl;
+            }
+        }));
+    }
+
+
+
     // Endless loop over incoming connections.
     while(true) {
-          tcp::iostream s;
-          tcp::endpoint remoteEndpoint;
-          boost::system::error_code errorCode;
-          acceptor.accept(*s.rdbuf(), remoteEndpoint, errorCode);
-          if(errorCode) {
-              // If interrupted with Ctrl-C, we get here.
-              cout << "\nError code from accept: " << errorCode.message() << endl;
-              s.close();        // Should not be necessary.
-              acceptor.close(); // Should not be necessary
-              return;
-          }
-
-          // If sameUserOnly was specified, check that this is a local
-          // connection originating from a process owned by the same
-          // user running the server.
-          if(sameUserOnly) {
-              SHASTA_ASSERT(localOnly);
-              if(!isLocalConnectionSameUser(s, port)) {
-                  // Unceremoniously close the connection.
-                  cout << timestamp << "Reset a local connection originating from a process "
-                      "not owned by the same user running the server." << endl;
-                  continue;
-              }
-          }
-
-          // Process the request.
-          cout << timestamp << remoteEndpoint.address().to_string() << " " << flush;
-          const auto t0 = steady_clock::now();
-          processRequest(s);
-          const auto t1 = steady_clock::now();
-          cout << timestamp << "Request satisfied in " << seconds(t1 - t0) << "s." << endl;
+        const auto connection = std::make_shared<Connection>();
+        boost::system::error_code errorCode;
+        acceptor.accept(*connection->s.rdbuf(), connection->remoteEndpoint, errorCode);
+        if(errorCode) {
+            // If interrupted with Ctrl-C, we get here.
+            cout << "\nError code from accept: " << errorCode.message() << endl;
+            connection->s.close();  // Should not be necessary.
+            acceptor.close();       // Should not be necessary
+
+            // Let the worker threads finish the requests already queued.
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                done = true;
+            }
+            queueCondition.notify_all();
+            for(std::thread& thread: threads) {
+                thread.join();
+            }
+            return;
+        }
+
+        // Queue the connection, unless the queue is full.
+        bool wasQueued = false;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if(queue.size() < maxQueueLength) {
+                queue.push_back(connection);
+                wasQueued = true;
+            }
+        }
+        if(wasQueued) {
+            queueCondition.notify_one();
+        } else {
+            cout << timestamp << "Rejected a connection from " <<
+                connection->remoteEndpoint.address().to_string() <<
+                " because the server is busy." << endl;
+            connection->s <<
+                "HTTP/1.1 503 Service Unavailable\r\n"
+                "Retry-After: 10\r\n"
+                "Connection: close\r\n"
+                "\r\n"
+                "The server is busy. Try again later." << std::flush;
+        }
     }
 }
 
@@ -197,6 +288,7 @@ template<class T> void HttpServer::processRequest(T& s)
     }
     if(tokens.front() == "POST") {
         setRequestTimeout(10000000, s);
+        std::unique_lock<std::shared_mutex> lock(requestMutex);
         processPost(tokens, s);
         return;
     }
@@ -207,7 +299,8 @@ template<class T> void HttpServer::processRequest(T& s)
         cout << "Request was: " << requestLine << endl;
         return;
     }
-    const string& request = tokens[1];
+    const string request = tokens[1];
+    const bool isHttp11 = (tokens[2].compare(0, 8, "HTTP/1.1") == 0);
     if(request.empty()) {
         s << "Empty GET request: " << requestLine;
         cout << "Empty GET request: " << requestLine;
@@ -215,7 +308,7 @@ template<class T> void HttpServer::processRequest(T& s)
     }
 
     // Give ourselves time to satisfy the request
-    setRequestTimeout(86400, s);
+    setRequestTimeout(int(requestTimeout), s);
 
     // Parse the request.
     cout << requestLine << endl;
@@ -238,10 +331,13 @@ template<class T> void HttpServer::processRequest(T& s)
 
     // Read the rest of the input from the client, but ignore it,
     // except for the User Agent string, which tells us what browser
-    // issued the request.
+    // issued the request, and the Accept-Encoding string,
+    // which tells us whether we can compress the response.
     // If we don't read all the input, the client may get a timeout.
     string line;
     const string userAgentPrefix = "User-Agent: ";
+    const string acceptEncodingPrefix = "Accept-Encoding: ";
+    HttpResponseEncoder::Encoding encoding = HttpResponseEncoder::Encoding::identity;
     BrowserInformation browserInformation;
     string originatingProcessUserName;
     string thisProcessUserName;
@@ -262,19 +358,43 @@ template<class T> void HttpServer::processRequest(T& s)
         if(line.compare(0, userAgentPrefix.size(), userAgentPrefix) == 0) {
             browserInformation.set(line);
         }
+
+        // See if this is the Accept-Encoding string.
+        if(line.compare(0, acceptEncodingPrefix.size(), acceptEncodingPrefix) == 0) {
+            encoding = HttpResponseEncoder::negotiate(line.substr(acceptEncodingPrefix.size()));
+        }
     }
     cout << "isFirefox=" << browserInformation.isFirefox << " ";
     cout << "isChrome=" << browserInformation.isChrome << endl;
 
 
 
+    // The response goes through an HttpResponseEncoder, which compresses
+    // the body if the client accepts it, and sends it in chunks
+    // as it is written, instead of waiting for the connection to close.
+    HttpResponseEncoder encoder(*s.rdbuf(), encoding, isHttp11);
+    ostream html(&encoder);
+
     // Write the success response.
     // We don't write the required empty line, so the derived class can send headers
     // if it wants to.
-    s << "HTTP/1.1 200 OK\r\n";
+    html << "HTTP/1.1 200 OK\r\n";
 
     // The derived class processes the request.
-    processRequest(tokens, s, browserInformation);
+    if(requiresExclusiveAccess(tokens)) {
+        std::unique_lock<std::shared_mutex> lock(requestMutex);
+        processRequest(tokens, html, browserInformation);
+    } else {
+        std::shared_lock<std::shared_mutex> lock(requestMutex);
+        processRequest(tokens, html, browserInformation);
+    }
+    encoder.finish();
+
+    if(encoder.encoding != HttpResponseEncoder::Encoding::identity) {
+        cout << "Response body of " << encoder.bodyBytes << " bytes sent as " <<
+            encoder.encodedBodyBytes << " bytes using " <<
+            HttpResponseEncoder::encodingName(encoder.encoding) << " encoding." << endl;
+    }
 }
 
 
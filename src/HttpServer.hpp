@@ -6,11 +6,17 @@
 // The derived class only has to override
 // function processRequest.
 
+// Requests are processed concurrently by a pool of worker threads.
+// The derived class must make sure processRequest can be called
+// concurrently, or override requiresExclusiveAccess
+// for requests that cannot run concurrently with other requests.
+
 #include "span.hpp"
 
 #include "iosfwd.hpp"
 #include <map>
 #include <set>
+#include <shared_mutex>
 #include <sstream>
 #include "string.hpp"
 #include "vector.hpp"
@@ -73,8 +79,20 @@ class shasta::HttpServer {
 public:
 
     // This function puts the server into an endless loop of processing requests.
-    // See comments above for the meaning of localOnly and sameUserOnly
-    void explore(uint16_t port, bool localOnly, bool sameUserOnly);
+    // See comments above for the meaning of localOnly and sameUserOnly.
+    // Requests are processed by threadCount worker threads
+    // (if zero, the number of virtual processors).
+    // Connections that arrive when all threads are busy are queued,
+    // up to a maximum queue length, after which they get
+    // an immediate "503 Service Unavailable" response.
+    // The connection of a request that is not completed within
+    // requestTimeout seconds is closed.
+    void explore(
+        uint16_t port,
+        bool localOnly,
+        bool sameUserOnly,
+        uint64_t threadCount = 1,
+        uint64_t requestTimeout = 86400);
 
     // The destructor needs to be virtual for clean destruction of
     // the derived class.
@@ -100,6 +118,15 @@ protected:
         const PostData&,
         ostream& html);
 
+    // The derived class can override this to return true for GET requests
+    // that must not run concurrently with any other request,
+    // for example because they modify data used by other requests.
+    // POST requests always run with exclusive access.
+    virtual bool requiresExclusiveAccess(const vector<string>& /* request */) const
+    {
+        return false;
+    }
+
 
 public:
     // This function can be used to get the value of a parameter.
@@ -169,6 +196,13 @@ protected:
 
 
 private:
+
+    // Requests with exclusive access lock this for writing,
+    // and all other requests lock it for reading.
+    std::shared_mutex requestMutex;
+
+    uint64_t requestTimeout = 86400;
+
     // Argument is boost::asio::ip::tcp::iostream&,
     // but make it templated to reduce include file dependencies.
     template<class T> void processRequest(T&);
@@ -3,6 +3,8 @@
 
 // Shasta.
 #include "shastaTypes.hpp"
+#include "span.hpp"
+#include "SHASTA_ASSERT.hpp"
 
 namespace shasta {
     class KmerChecker;
@@ -18,6 +20,23 @@ namespace shasta {
 class shasta::KmerChecker {
 public:
     virtual bool isMarker(KmerId) const = 0;
+
+    // Batch version, for use in performance critical loops.
+    // Sets isMarker[i] to 1 if kmerIds[i] is a marker and to 0 otherwise.
+    // The caller also provides kmerIdsRc, the KmerIds of the reverse
+    // complemented k-mers, which some implementations can use to avoid
+    // recomputing them. The default implementation
+    // just calls isMarker(KmerId) for each KmerId.
+    virtual void isMarkerBatch(
+        span<const KmerId> kmerIds,
+        span<const KmerId> /* kmerIdsRc */,
+        span<uint8_t> isMarker) const
+    {
+        SHASTA_ASSERT(isMarker.size() == kmerIds.size());
+        for(uint64_t i=0; i<kmerIds.size(); i++) {
+            isMarker[i] = uint8_t(this->isMarker(kmerIds[i]));
+        }
+    }
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include "Kmer.hpp"
 #include "KmerTable.hpp"
 #include "HashedKmerChecker.hpp"
+#include "HashedKmerChecker1.hpp"
 #include "AssemblerOptions.hpp"
 #include "Reads.hpp"
 using namespace shasta;
@@ -22,6 +23,18 @@ std::shared_ptr<KmerChecker> KmerCheckerFactory::createNew(
             mappedMemoryOwner);
     }
 
+    // For generation method 1 with k>15, use the HashedKmerChecker1,
+    // which counts k-mers without a table indexed by KmerId.
+    if(kmersOptions.generationMethod == 1 and kmersOptions.k >= int(Kmer16::capacity)) {
+        return make_shared<HashedKmerChecker1>(
+            kmersOptions.k,
+            kmersOptions.probability,
+            kmersOptions.enrichmentThreshold,
+            reads,
+            threadCount,
+            mappedMemoryOwner);
+    }
+
     // In all other cases, we are limited to k<=16.
     if(kmersOptions.k > int(Kmer16::capacity)) {
         throw runtime_error("Kmer generation method " +
@@ -93,6 +106,9 @@ std::shared_ptr<shasta::KmerChecker> KmerCheckerFactory::createFromBinaryData(
     if(generationMethod == 0) {
         return make_shared<HashedKmerChecker>(mappedMemoryOwner);
     }
+    if(generationMethod == 1 and k >= Kmer16::capacity) {
+        return make_shared<HashedKmerChecker1>(k, mappedMemoryOwner);
+    }
 
     switch(generationMethod) {
     case 0:
@@ -0,0 +1,243 @@
+// Shasta.
+#include "KmerCounter.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Explicit template instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<KmerCounter>;
+
+
+
+KmerCounter::KmerCounter(
+    uint64_t k,
+    const Reads& reads,
+    uint64_t threadCount,
+    const MappedMemoryOwner& mappedMemoryOwner) :
+    MultithreadedObject<KmerCounter>(*this),
+    MappedMemoryOwner(mappedMemoryOwner),
+    k(k),
+    reads(reads),
+    spillMutexes(partitionCount)
+{
+    SHASTA_ASSERT(k > 0);
+    SHASTA_ASSERT(k < 32);
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Create the spill vectors.
+    for(uint64_t partitionId=0; partitionId<partitionCount; partitionId++) {
+        spill.emplace_back(make_unique< MemoryMapped::Vector<KmerId> >());
+        spill.back()->createNew(
+            largeDataName("tmp-KmerCounter-Spill-" + to_string(partitionId)),
+            largeDataPageSize);
+    }
+
+    // Pass 1: partition the k-mers of all reads.
+    cout << timestamp << "K-mer counting pass 1 begins." << endl;
+    setupLoadBalancing(reads.readCount(), 1000);
+    runThreads(&KmerCounter::pass1ThreadFunction, threadCount);
+
+    // Pass 2: count each partition.
+    cout << timestamp << "K-mer counting pass 2 begins." << endl;
+    for(uint64_t partitionId=0; partitionId<partitionCount; partitionId++) {
+        counts.emplace_back(make_unique< MemoryMapped::Vector<KmerCount> >());
+        counts.back()->createNew(
+            largeDataName("tmp-KmerCounter-Counts-" + to_string(partitionId)),
+            largeDataPageSize);
+    }
+    setupLoadBalancing(partitionCount, 1);
+    runThreads(&KmerCounter::pass2ThreadFunction, threadCount);
+    spill.clear();
+
+    // Summary statistics.
+    for(uint64_t partitionId=0; partitionId<partitionCount; partitionId++) {
+        for(const KmerCount& kmerCount: getPartition(partitionId)) {
+            totalOccurrenceCount += kmerCount.frequency;
+        }
+        distinctKmerCount += counts[partitionId]->size();
+    }
+    cout << timestamp << "K-mer counting found " << distinctKmerCount <<
+        " distinct canonical k-mers of length " << k <<
+        " and " << totalOccurrenceCount << " k-mer occurrences." << endl;
+}
+
+
+
+KmerCounter::~KmerCounter()
+{
+    for(const auto& v: spill) {
+        v->remove();
+    }
+    for(const auto& v: counts) {
+        v->remove();
+    }
+}
+
+
+
+void KmerCounter::pass1ThreadFunction(size_t /* threadId */)
+{
+    // Buffers for each partition. When one is full, it is
+    // appended to the spill vector for that partition.
+    const uint64_t bufferSize = 4096;
+    vector< vector<KmerId> > buffers(partitionCount);
+    for(vector<KmerId>& buffer: buffers) {
+        buffer.reserve(bufferSize);
+    }
+
+    const uint64_t mask = (1ULL << k) - 1ULL;
+    const uint64_t km1 = k - 1;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all reads assigned to this batch.
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const LongBaseSequenceView read = reads.getRead(readId);
+            if(read.baseCount < k) {
+                continue;
+            }
+
+            // Rolling computation of the KmerId and of the KmerId
+            // of the reverse complement, one bit plane at a time.
+            // See ShortBaseSequence::id for the layout of a KmerId.
+            uint64_t lsb = 0;
+            uint64_t msb = 0;
+            uint64_t lsbRc = 0;
+            uint64_t msbRc = 0;
+            for(uint64_t position=0; position<read.baseCount; position++) {
+                const uint64_t value = read[position].value;
+                const uint64_t bit0 = value & 1ULL;
+                const uint64_t bit1 = value >> 1;
+                lsb = ((lsb << 1) | bit0) & mask;
+                msb = ((msb << 1) | bit1) & mask;
+                lsbRc = (lsbRc >> 1) | ((1ULL - bit0) << km1);
+                msbRc = (msbRc >> 1) | ((1ULL - bit1) << km1);
+
+                if(position >= km1) {
+                    const KmerId kmerId = KmerId((msb << k) | lsb);
+                    const KmerId kmerIdRc = KmerId((msbRc << k) | lsbRc);
+                    const KmerId canonical = canonicalKmerId(kmerId, kmerIdRc);
+                    const uint64_t partitionId = getPartitionId(canonical);
+                    vector<KmerId>& buffer = buffers[partitionId];
+                    buffer.push_back(canonical);
+                    if(buffer.size() == bufferSize) {
+                        appendToSpill(partitionId, buffer);
+                        buffer.clear();
+                    }
+                }
+            }
+        }
+    }
+
+    // Flush the buffers.
+    for(uint64_t partitionId=0; partitionId<partitionCount; partitionId++) {
+        appendToSpill(partitionId, buffers[partitionId]);
+    }
+}
+
+
+
+void KmerCounter::appendToSpill(uint64_t partitionId, const vector<KmerId>& buffer)
+{
+    if(buffer.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(spillMutexes[partitionId]);
+    MemoryMapped::Vector<KmerId>& v = *spill[partitionId];
+    const uint64_t oldSize = v.size();
+    v.resize(oldSize + buffer.size());
+    copy(buffer.begin(), buffer.end(), v.begin() + oldSize);
+}
+
+
+
+void KmerCounter::pass2ThreadFunction(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t partitionId=begin; partitionId!=end; partitionId++) {
+            countPartition(partitionId);
+        }
+    }
+}
+
+
+
+// Count the k-mers in a partition using an open addressing
+// hash table with linear probing. The table starts small and its size
+// is doubled when its load factor exceeds 1/2.
+void KmerCounter::countPartition(uint64_t partitionId)
+{
+    MemoryMapped::Vector<KmerId>& partitionSpill = *spill[partitionId];
+
+    // KmerId 0 is a valid KmerId, so we use a value that
+    // cannot be a KmerId for k<32 to mark empty slots.
+    const KmerId emptySlot = std::numeric_limits<KmerId>::max();
+    vector<KmerCount> table(1ULL << 16, KmerCount({emptySlot, 0}));
+    uint64_t slotMask = table.size() - 1;
+    uint64_t usedSlotCount = 0;
+
+    // The partition uses the high bits of getPartitionId,
+    // so here we hash differently.
+    auto getSlot = [&slotMask](KmerId kmerId)
+    {
+        uint64_t h = kmerId ^ (kmerId >> 29);
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h & slotMask;
+    };
+
+    // Insert a KmerId with a given frequency.
+    auto insert = [&](KmerId kmerId, uint64_t frequency)
+    {
+        for(uint64_t slot=getSlot(kmerId); ; slot=(slot+1) & slotMask) {
+            KmerCount& kmerCount = table[slot];
+            if(kmerCount.kmerId == kmerId) {
+                kmerCount.frequency += frequency;
+                return;
+            }
+            if(kmerCount.kmerId == emptySlot) {
+                kmerCount.kmerId = kmerId;
+                kmerCount.frequency = frequency;
+                ++usedSlotCount;
+                return;
+            }
+        }
+    };
+
+    for(const KmerId kmerId: partitionSpill) {
+        insert(kmerId, 1);
+
+        // If necessary, double the size of the table.
+        if(2 * usedSlotCount > table.size()) {
+            vector<KmerCount> oldTable(2 * table.size(), KmerCount({emptySlot, 0}));
+            oldTable.swap(table);
+            slotMask = table.size() - 1;
+            usedSlotCount = 0;
+            for(const KmerCount& kmerCount: oldTable) {
+                if(kmerCount.kmerId != emptySlot) {
+                    insert(kmerCount.kmerId, kmerCount.frequency);
+                }
+            }
+        }
+    }
+
+    // The spill for this partition is no longer needed.
+    partitionSpill.remove();
+
+    // Store the counts for this partition.
+    MemoryMapped::Vector<KmerCount>& partitionCounts = *counts[partitionId];
+    partitionCounts.reserve(usedSlotCount);
+    for(const KmerCount& kmerCount: table) {
+        if(kmerCount.kmerId != emptySlot) {
+            partitionCounts.push_back(kmerCount);
+        }
+    }
+}
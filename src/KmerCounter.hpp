@@ -0,0 +1,104 @@
+#ifndef SHASTA_KMER_COUNTER_HPP
+#define SHASTA_KMER_COUNTER_HPP
+
+// Shasta.
+#include "MappedMemoryOwner.hpp"
+#include "MemoryMappedVector.hpp"
+#include "MultithreadedObject.hpp"
+#include "shastaTypes.hpp"
+#include "span.hpp"
+
+// Standard library.
+#include "algorithm.hpp"
+#include "memory.hpp"
+#include <mutex>
+#include "vector.hpp"
+
+namespace shasta {
+    class KmerCounter;
+    class Reads;
+
+    extern template class MultithreadedObject<KmerCounter>;
+}
+
+
+
+// Count the k-mers of length k<32 that occur in the reads.
+// This does not use a table indexed by KmerId, so it does not
+// have the k<16 limitation of KmerTable.
+// Each k-mer is counted together with its reverse complement,
+// using as key the canonical KmerId (the smaller of the KmerIds
+// of the k-mer and its reverse complement). Therefore,
+// the frequency stored for a canonical KmerId is the number of times
+// the k-mer appears in oriented reads, which is the same as the
+// KmerInfo::frequency computed by KmerTable1.
+// Counting is done in two multithreaded passes:
+// - In pass 1, the canonical KmerIds of all reads are radix partitioned
+//   using the high bits of a hash, and appended to one spill vector
+//   for each partition. The spill vectors are memory mapped, so they
+//   go to disk if the assembly is using disk backed binary data.
+// - In pass 2, each partition is counted separately using
+//   an open addressing hash table, so the memory needed is only
+//   what is required to count one partition in each thread.
+//   The result for each partition is a vector of (KmerId, frequency).
+// All binary data are temporary and are removed by the destructor.
+class shasta::KmerCounter :
+    public MultithreadedObject<KmerCounter>,
+    public MappedMemoryOwner {
+public:
+
+    KmerCounter(
+        uint64_t k,
+        const Reads&,
+        uint64_t threadCount,
+        const MappedMemoryOwner&);
+    ~KmerCounter();
+
+    class KmerCount {
+    public:
+        KmerId kmerId;  // Canonical.
+        uint64_t frequency;
+    };
+
+    static const uint64_t partitionBitCount = 8;
+    static const uint64_t partitionCount = 1ULL << partitionBitCount;
+    span<const KmerCount> getPartition(uint64_t partitionId) const
+    {
+        const MemoryMapped::Vector<KmerCount>& v = *counts[partitionId];
+        return span<const KmerCount>(v.begin(), v.end());
+    }
+
+    // The total number of k-mer occurrences in the reads (strand 0 only)
+    // and the number of distinct canonical k-mers.
+    uint64_t totalOccurrenceCount = 0;
+    uint64_t distinctKmerCount = 0;
+
+    // The canonical KmerId of a k-mer.
+    static KmerId canonicalKmerId(KmerId kmerId, KmerId kmerIdRc)
+    {
+        return min(kmerId, kmerIdRc);
+    }
+
+private:
+    uint64_t k;
+    const Reads& reads;
+
+    static uint64_t getPartitionId(KmerId kmerId)
+    {
+        return (kmerId * 0x9E3779B97F4A7C15ULL) >> (64 - partitionBitCount);
+    }
+
+    // The spill vectors for pass 1, one for each partition.
+    vector< unique_ptr< MemoryMapped::Vector<KmerId> > > spill;
+    vector<std::mutex> spillMutexes;
+    void appendToSpill(uint64_t partitionId, const vector<KmerId>&);
+
+    // The counts for each partition, computed in pass 2.
+    vector< unique_ptr< MemoryMapped::Vector<KmerCount> > > counts;
+
+    void pass1ThreadFunction(size_t threadId);
+    void pass2ThreadFunction(size_t threadId);
+    void countPartition(uint64_t partitionId);
+};
+
+#endif
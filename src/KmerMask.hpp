@@ -0,0 +1,75 @@
+#ifndef SHASTA_KMER_MASK_HPP
+#define SHASTA_KMER_MASK_HPP
+
+// A set of KmerIds that are skipped when creating alignment matrices.
+// It is used by Align4 to skip marker k-mers with high global
+// frequency, which would otherwise generate a quadratic
+// number of alignment matrix entries.
+// Lookups first check a bitmap indexed by a hash of the KmerId,
+// which is small enough to stay in cache. This rejects
+// almost all KmerIds that are not in the set. The remaining lookups
+// are confirmed with a binary search in the sorted KmerIds,
+// so there are no false positives.
+
+// Shasta.
+#include "shastaTypes.hpp"
+
+// Standard library.
+#include "algorithm.hpp"
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class KmerMask;
+}
+
+
+
+class shasta::KmerMask {
+public:
+
+    // The KmerIds don't need to be sorted.
+    KmerMask(vector<KmerId>&& kmerIdsArgument) :
+        kmerIds(std::move(kmerIdsArgument))
+    {
+        sort(kmerIds.begin(), kmerIds.end());
+        kmerIds.erase(unique(kmerIds.begin(), kmerIds.end()), kmerIds.end());
+
+        // Use at least 16 bits per KmerId, rounded up to a power of 2.
+        bitmapBitCount = 12;
+        while((1ULL << bitmapBitCount) < 16 * kmerIds.size()) {
+            ++bitmapBitCount;
+        }
+        bitmap.resize((1ULL << bitmapBitCount) / 64, 0);
+        for(const KmerId kmerId: kmerIds) {
+            const uint64_t h = hash(kmerId);
+            bitmap[h >> 6] |= (1ULL << (h & 63));
+        }
+    }
+
+    bool contains(KmerId kmerId) const
+    {
+        const uint64_t h = hash(kmerId);
+        if((bitmap[h >> 6] & (1ULL << (h & 63))) == 0) {
+            return false;
+        }
+        return binary_search(kmerIds.begin(), kmerIds.end(), kmerId);
+    }
+
+    uint64_t size() const
+    {
+        return kmerIds.size();
+    }
+
+private:
+    vector<KmerId> kmerIds;
+    uint64_t bitmapBitCount;
+    vector<uint64_t> bitmap;
+
+    uint64_t hash(KmerId kmerId) const
+    {
+        return (uint64_t(kmerId) * 0x9E3779B97F4A7C15ULL) >> (64 - bitmapBitCount);
+    }
+};
+
+#endif
@@ -8,6 +8,9 @@ using namespace shasta;
 // Boost libraries.
 #include <boost/graph/iteration_macros.hpp>
 
+// Standard library.
+#include <map>
+
 
 
 LocalMarkerGraph0::LocalMarkerGraph0(
@@ -59,11 +62,12 @@ LocalMarkerGraph0::vertex_descriptor
     span<MarkerId> vertexMarkers)
 {
     // Check that the vertex does not already exist.
-    SHASTA_ASSERT(vertexMap.find(vertexId) == vertexMap.end());
+    const auto [it, wasInserted] = vertexMap.try_emplace(vertexId);
+    SHASTA_ASSERT(wasInserted);
 
     // Add the vertex and store it in the vertex map.
     const vertex_descriptor v = add_vertex(LocalMarkerGraph0Vertex(vertexId, distance), *this);
-    vertexMap.insert(make_pair(vertexId, v));
+    it->second = v;
 
     // Fill in the marker information for this vertex.
     LocalMarkerGraph0Vertex& vertex = (*this)[v];
@@ -163,11 +167,11 @@ void LocalMarkerGraph0::computeVertexConsensusInfo( vertex_descriptor v)
 
 
 // Store sequence information in the edge.
-// This version takes as input a vector of the
-// LocalMarkerGraph0Edge::Info that caused the edge to be created.
+// This version takes as input the marker intervals of the
+// global marker graph edge that caused the edge to be created.
 void LocalMarkerGraph0::storeEdgeInfo(
     edge_descriptor e,
-    const vector<MarkerInterval>& intervals)
+    span<const MarkerInterval> intervals)
 {
     LocalMarkerGraph0& graph = *this;
     LocalMarkerGraph0Edge& edge = graph[e];
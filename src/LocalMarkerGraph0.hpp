@@ -24,6 +24,9 @@ a group of aligned markers.
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
 
+// Standard library.
+#include <unordered_map>
+
 namespace shasta {
 
     class LocalMarkerGraph0Vertex;
@@ -261,9 +264,9 @@ public:
     void computeVertexConsensusInfo(vertex_descriptor);
 
     // Store sequence information in the edge.
-    // Takes as input a vector of the
-    // LocalMarkerGraph0Edge::Info that caused the edge to be created.
-    void storeEdgeInfo(edge_descriptor, const vector<MarkerInterval>&);
+    // Takes as input the marker intervals of the
+    // global marker graph edge that caused the edge to be created.
+    void storeEdgeInfo(edge_descriptor, span<const MarkerInterval>);
 
 
     // Write in Graphviz format.
@@ -286,7 +289,7 @@ public:
 private:
 
     // Map a global vertex id to a vertex descriptor for the local graph.
-    std::map<MarkerGraph::VertexId, vertex_descriptor> vertexMap;
+    std::unordered_map<MarkerGraph::VertexId, vertex_descriptor> vertexMap;
 
     // Reads representation: 0 = raw, 1 = RLE.
     uint64_t readRepresentation;
@@ -1,12 +1,14 @@
 // Shasta.
 #include "LocalMarkerGraph1.hpp"
 #include "Base.hpp"
+#include "CanvasGraph.hpp"
 #include "computeLayout.hpp"
 #include "findLinearChains.hpp"
 #include "html.hpp"
 #include "invalid.hpp"
 #include "Marker.hpp"
 #include "MarkerGraph.hpp"
+#include "MarkerGraphNeighborhoodIndex.hpp"
 #include "MurmurHash2.hpp"
 #include "orderPairs.hpp"
 #include "platformDependent.hpp"
@@ -25,6 +27,8 @@ using namespace shasta;
 #include "fstream.hpp"
 #include <queue>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 
 
@@ -34,7 +38,8 @@ LocalMarkerGraph1::LocalMarkerGraph1(
     MarkerGraphVertexId startVertexId,
     uint64_t maxDistance,
     uint64_t minVertexCoverage,
-    uint64_t minEdgeCoverage) :
+    uint64_t minEdgeCoverage,
+    const MarkerGraphNeighborhoodIndex* neighborhoodIndex) :
     markers(markers),
     markerGraph(markerGraph),
     maxDistance(maxDistance)
@@ -43,9 +48,13 @@ LocalMarkerGraph1::LocalMarkerGraph1(
 
     // Do a BFS to generate the vertices.
     // Edges will be created later.
-    const vertex_descriptor vStart = addVertex(startVertexId, 0);
     std::queue<vertex_descriptor> q;
-    q.push(vStart);
+    if(neighborhoodIndex) {
+        createVertices(startVertexId, minVertexCoverage, minEdgeCoverage, *neighborhoodIndex);
+    } else {
+        const vertex_descriptor vStart = addVertex(startVertexId, 0);
+        q.push(vStart);
+    }
     while(!q.empty()) {
 
         // Dequeue a vertex.
@@ -150,6 +159,141 @@ LocalMarkerGraph1::LocalMarkerGraph1(
 
 
 
+// Find the vertices within maxDistance of the start vertex
+// using the chains stored in the MarkerGraphNeighborhoodIndex.
+// This is a Dijkstra search in which a chain that satisfies the
+// coverage thresholds is traversed in one step, from the vertex
+// where we enter it to the other end. The distances of the
+// internal vertices of those chains are computed at the end.
+void LocalMarkerGraph1::createVertices(
+    MarkerGraphVertexId startVertexId,
+    uint64_t minVertexCoverage,
+    uint64_t minEdgeCoverage,
+    const MarkerGraphNeighborhoodIndex& index)
+{
+    std::unordered_map<MarkerGraphVertexId, uint64_t> distanceMap;
+    std::unordered_set<uint64_t> passableChains;
+
+    // Min-heap of pairs(distance, vertexId).
+    using QueueItem = pair<uint64_t, MarkerGraphVertexId>;
+    std::priority_queue<QueueItem, vector<QueueItem>, std::greater<QueueItem> > q;
+
+    // Like the BFS, always look at the neighbors of the start vertex,
+    // even if maxDistance is 0.
+    const uint64_t searchDistance = max(maxDistance, uint64_t(1));
+
+    auto relax = [&](MarkerGraphVertexId vertexId, uint64_t distance) {
+        if(distance > searchDistance) {
+            return;
+        }
+        auto it = distanceMap.find(vertexId);
+        if(it == distanceMap.end()) {
+            distanceMap.insert({vertexId, distance});
+        } else if(distance < it->second) {
+            it->second = distance;
+        } else {
+            return;
+        }
+        q.push({distance, vertexId});
+    };
+
+    relax(startVertexId, 0);
+    while(not q.empty()) {
+        const uint64_t distance0 = q.top().first;
+        const MarkerGraphVertexId vertexId0 = q.top().second;
+        q.pop();
+        if(distance0 != distanceMap[vertexId0] or distance0 == searchDistance) {
+            continue;
+        }
+
+        // If this vertex is in a chain that satisfies the coverage thresholds,
+        // jump to the ends of the chain. In that case the chain edges
+        // are not used. The other edges can only be into the first vertex
+        // or out of the last vertex.
+        const uint64_t chainId = index.vertexChain[vertexId0];
+        const uint64_t position = index.vertexPosition[vertexId0];
+        const uint64_t length = index.chainLength(chainId);
+        const bool isPassable =
+            (length > 0) and
+            index.isPassable(chainId, minVertexCoverage, minEdgeCoverage);
+        if(isPassable) {
+            passableChains.insert(chainId);
+            if(position > 0) {
+                relax(index.chainVertex(chainId, 0), distance0 + position);
+            }
+            if(position < length) {
+                relax(index.chainVertex(chainId, length), distance0 + length - position);
+            }
+        }
+
+        if(not (isPassable and position < length)) {
+            for(uint64_t edgeId: markerGraph.edgesBySource[vertexId0]) {
+                if(markerGraph.edgeCoverage(edgeId) < minEdgeCoverage) {
+                    continue;
+                }
+                const MarkerGraphVertexId vertexId1 = markerGraph.edges[edgeId].target;
+                if(markerGraph.vertexCoverage(vertexId1) < minVertexCoverage) {
+                    continue;
+                }
+                relax(vertexId1, distance0 + 1);
+            }
+        }
+
+        if(not (isPassable and position > 0)) {
+            for(uint64_t edgeId: markerGraph.edgesByTarget[vertexId0]) {
+                if(markerGraph.edgeCoverage(edgeId) < minEdgeCoverage) {
+                    continue;
+                }
+                const MarkerGraphVertexId vertexId1 = markerGraph.edges[edgeId].source;
+                if(markerGraph.vertexCoverage(vertexId1) < minVertexCoverage) {
+                    continue;
+                }
+                relax(vertexId1, distance0 + 1);
+            }
+        }
+    }
+
+    // Fill in the internal vertices of the chains we jumped over.
+    // Their distance is determined by the vertices of the chain
+    // found by the search: the two ends and possibly the start vertex.
+    for(const uint64_t chainId: passableChains) {
+        const uint64_t length = index.chainLength(chainId);
+        vector< pair<uint64_t, uint64_t> > found; // (position, distance)
+        for(const uint64_t position: {uint64_t(0), length}) {
+            auto it = distanceMap.find(index.chainVertex(chainId, position));
+            if(it != distanceMap.end()) {
+                found.push_back({position, it->second});
+            }
+        }
+        if(index.vertexChain[startVertexId] == chainId) {
+            found.push_back({index.vertexPosition[startVertexId], 0});
+        }
+        for(uint64_t position=1; position<length; position++) {
+            uint64_t distance = invalid<uint64_t>;
+            for(const auto& p: found) {
+                const uint64_t offset = (position > p.first) ? (position - p.first) : (p.first - position);
+                distance = min(distance, p.second + offset);
+            }
+            if(distance <= searchDistance) {
+                distanceMap.insert({index.chainVertex(chainId, position), distance});
+            }
+        }
+    }
+
+    // Create the vertices in order of increasing distance, like the BFS does.
+    vector<QueueItem> vertices;
+    vertices.reserve(distanceMap.size());
+    for(const auto& p: distanceMap) {
+        vertices.push_back({p.second, p.first});
+    }
+    sort(vertices.begin(), vertices.end());
+    for(const auto& p: vertices) {
+        addVertex(p.second, p.first);
+    }
+}
+
+
+
 LocalMarkerGraph1::vertex_descriptor LocalMarkerGraph1::addVertex(
     MarkerGraphVertexId vertexId,
     uint64_t distance)
@@ -394,6 +538,132 @@ void LocalMarkerGraph1::writeHtml0(
 
 
 
+// Color for a coverage value: red up to redCoverage, green from greenCoverage,
+// and intermediate hues in between.
+string LocalMarkerGraph1::coverageColor(
+    uint64_t coverage,
+    uint64_t redCoverage,
+    uint64_t greenCoverage)
+{
+    if(coverage <= redCoverage) {
+        return "Red";
+    } else if(coverage >= greenCoverage) {
+        return "Green";
+    } else {
+        const uint32_t hue = uint32_t(120. *
+            (double(coverage) - double(redCoverage)) / (double(greenCoverage) - double(redCoverage)));
+        return "hsl(" + to_string(hue) + ",50%,50%)";
+    }
+}
+
+
+
+// Display vertices and edges using class CanvasGraph.
+// This does not create an svg element for each vertex and edge,
+// so it can be used for subgraphs too large for writeHtml1.
+// Edges are displayed as straight lines, and vertices are colored
+// by coverage as in writeHtml0.
+// Read following coloring is not supported and
+// is replaced by coloring by coverage.
+void LocalMarkerGraph1::writeHtml2(
+    ostream& html,
+    uint64_t sizePixels,
+    double thicknessScaling,
+    uint64_t quality,
+    const string& coloring,
+    uint64_t redCoverage,
+    uint64_t greenCoverage,
+    double timeout) const
+{
+    const LocalMarkerGraph1& graph = *this;
+
+    // Compute the layout.
+    std::map<edge_descriptor, double> edgeLengthMap;
+    BGL_FORALL_EDGES(e, graph, LocalMarkerGraph1) {
+        edgeLengthMap.insert(make_pair(e, 1.));
+    }
+    std::map<vertex_descriptor, array<double, 2> > positionMap;
+    const ComputeLayoutReturnCode returnCode = computeLayoutCustom(
+        graph, edgeLengthMap, positionMap, quality, timeout);
+    if(returnCode == ComputeLayoutReturnCode::Timeout) {
+        throw runtime_error("Graph layout took too long. "
+            "Increase the timeout or decrease the maximum distance.");
+    }
+    if(returnCode != ComputeLayoutReturnCode::Success) {
+        throw runtime_error("Graph layout failed.");
+    }
+
+    // Sizes relative to the desired edge length, which is 1.
+    const double vertexRadius = 0.1 * thicknessScaling;
+    const double edgeThickness = 0.05 * thicknessScaling;
+
+    CanvasGraph canvasGraph;
+    canvasGraph.pointUrlPrefix = "?";
+    canvasGraph.lineUrlPrefix = "exploreMarkerGraphEdge?edgeId=";
+
+    // The edges, with the highest coverage written last,
+    // so they are less likely to be superimposed by other edges.
+    vector< pair<edge_descriptor, uint64_t> > allEdges;
+    BGL_FORALL_EDGES(e, graph, LocalMarkerGraph1) {
+        allEdges.push_back({e, markerGraph.edgeCoverage(graph[e].edgeId)});
+    }
+    sort(allEdges.begin(), allEdges.end(),
+        OrderPairsBySecondOnly<edge_descriptor, uint64_t>());
+    for(const auto& p: allEdges) {
+        const edge_descriptor e = p.first;
+        const uint64_t coverage = p.second;
+        const MarkerGraphEdgeId edgeId = graph[e].edgeId;
+
+        string color;
+        if(coloring == "random") {
+            const uint32_t hue = MurmurHash2(&edgeId, sizeof(edgeId), 231) % 360;
+            color = "hsl(" + to_string(hue) + ",50%,50%)";
+        } else {
+            color = coverageColor(coverage, redCoverage, greenCoverage);
+        }
+
+        // Stop the line at the boundary of the target vertex,
+        // so the arrow is visible.
+        const auto& p0 = positionMap[source(e, graph)];
+        const auto& p1 = positionMap[target(e, graph)];
+        const double dx = p1[0] - p0[0];
+        const double dy = p1[1] - p0[1];
+        const double length = sqrt(dx * dx + dy * dy);
+        const double f = (length > 2. * vertexRadius) ? (length - vertexRadius) / length : 1.;
+
+        canvasGraph.addLine(
+            p0[0], p0[1],
+            p0[0] + f * dx, p0[1] + f * dy,
+            edgeThickness, color, true,
+            "Edge " + to_string(edgeId) + ", coverage " + to_string(coverage) +
+            ", " + to_string(markerGraph.edgeSequence[edgeId].size()) + " bases",
+            to_string(edgeId));
+    }
+
+    // The vertices.
+    BGL_FORALL_VERTICES(v, graph, LocalMarkerGraph1) {
+        const MarkerGraphVertexId vertexId = graph[v].vertexId;
+        const uint64_t coverage = markerGraph.vertexCoverage(vertexId);
+        string color;
+        if(coverage == 1) {
+            color = "Red";
+        } else if(coverage == 2) {
+            color = "Gold";
+        } else {
+            color = "Black";
+        }
+        const auto& xy = positionMap[v];
+        canvasGraph.addPoint(xy[0], xy[1], vertexRadius, color,
+            "Vertex " + to_string(vertexId) + ", coverage " + to_string(coverage) +
+            ", distance " + to_string(graph[v].distance),
+            "vertexId=" + to_string(vertexId));
+    }
+
+    canvasGraph.write(html, sizePixels);
+}
+
+
+
 void LocalMarkerGraph1::writeHtml1(
     ostream& html,
     uint64_t sizePixels,
@@ -645,15 +915,7 @@ void LocalMarkerGraph1::writeHtml1(
             const uint32_t hue = MurmurHash2(&edgeId, sizeof(edgeId), 231) % 360;
             color = "hsl(" + to_string(hue) + ",50%,50%)";
         } else if(coloring == "byCoverage") {
-            if(coverage <= redCoverage) {
-                color = "Red";
-            } else if(coverage >= greenCoverage) {
-                color = "Green";
-            } else {
-                const uint32_t hue = uint32_t(120. *
-                    (double(coverage) - double(redCoverage)) / (double(greenCoverage) - double(redCoverage)));
-                color = "hsl(" + to_string(hue) + ",50%,50%)";
-            }
+            color = coverageColor(coverage, redCoverage, greenCoverage);
         } else if(coloring == "readFollowing") {
             auto it = readFollowingCoverageMap.find(e);
             if(it == readFollowingCoverageMap.end()) {
@@ -661,15 +923,7 @@ void LocalMarkerGraph1::writeHtml1(
             } else {
                 const uint64_t coverage = it->second;
                 readFollowingCoverage = coverage;
-                if(coverage <= redCoverage) {
-                    color = "Red";
-                } else if(coverage >= greenCoverage) {
-                    color = "Green";
-                } else {
-                    const uint32_t hue = uint32_t(120. *
-                        (double(coverage) - double(redCoverage)) / (double(greenCoverage) - double(redCoverage)));
-                    color = "hsl(" + to_string(hue) + ",50%,50%)";
-                }
+                color = coverageColor(coverage, redCoverage, greenCoverage);
             }
         } else {
             SHASTA_ASSERT(0);
@@ -28,6 +28,7 @@ namespace shasta {
 
     class CompressedMarker;
     class MarkerGraph;
+    class MarkerGraphNeighborhoodIndex;
     namespace MemoryMapped {
         template<class T, class Int> class VectorOfVectors;
     }
@@ -80,7 +81,8 @@ public:
         MarkerGraphVertexId,
         uint64_t maxDistance,
         uint64_t minVertexCoverage,
-        uint64_t minEdgeCoverage
+        uint64_t minEdgeCoverage,
+        const MarkerGraphNeighborhoodIndex* = 0
     );
 
     const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
@@ -91,6 +93,16 @@ public:
     std::map<MarkerGraphEdgeId, edge_descriptor> edgeMap;
     vertex_descriptor addVertex(MarkerGraphVertexId, uint64_t distance);
 
+private:
+    // Create the vertices using a MarkerGraphNeighborhoodIndex
+    // instead of a BFS. The result is the same.
+    void createVertices(
+        MarkerGraphVertexId startVertexId,
+        uint64_t minVertexCoverage,
+        uint64_t minEdgeCoverage,
+        const MarkerGraphNeighborhoodIndex&);
+public:
+
     void writeGfa(const string& fileName) const;
     void writeHtml0(
         ostream&,
@@ -113,6 +125,20 @@ public:
         bool showLabels,
         double timeout) const;
 
+    void writeHtml2(
+        ostream&,
+        uint64_t sizePixels,
+        double thicknessScaling,
+        uint64_t quality,
+        const string& coloring,
+        uint64_t redCoverage,
+        uint64_t greenCoverage,
+        double timeout) const;
+    static string coverageColor(
+        uint64_t coverage,
+        uint64_t redCoverage,
+        uint64_t greenCoverage);
+
     void pruneLowCoverageLeaves(uint64_t maxPruneCoverage);
 private:
     void pruneLowCoverageForwardLeaves(uint64_t maxPruneCoverage);
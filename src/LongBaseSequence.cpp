@@ -1,5 +1,7 @@
 #include "LongBaseSequence.hpp"
+#include "bitReversal.hpp"
 #include "extractKmer.hpp"
+#include "platformDependent.hpp"
 #include "ShortBaseSequence.hpp"
 using namespace shasta;
 
@@ -104,6 +106,56 @@ void LongBaseSequences::append(size_t baseCountArgument)
 
 
 
+void LongBaseSequenceView::reverseComplement()
+{
+    SHASTA_ASSERT(!readOnly);
+    if(baseCount == 0) {
+        return;
+    }
+
+    const uint64_t blockCount = wordCount(baseCount) / 2;
+
+    // Bit reverse and complement all words.
+    complementedBitReversal(begin, 2 * blockCount);
+
+    // Reverse the order of the blocks.
+    for(uint64_t i=0; i<blockCount/2; i++) {
+        const uint64_t j = blockCount - 1 - i;
+        std::swap(begin[2 * i], begin[2 * j]);
+        std::swap(begin[2 * i + 1], begin[2 * j + 1]);
+    }
+
+    // The padding, which was at the end of the last block,
+    // is now at the beginning of the first block.
+    // Shift it out.
+    const uint64_t shift = 64 * blockCount - baseCount;
+    if(shift == 0) {
+        return;
+    }
+    const uint64_t lastBlock = blockCount - 1;
+    for(uint64_t i=0; i<lastBlock; i++) {
+        for(uint64_t bit=0; bit<2; bit++) {
+            uint64_t& w = begin[2 * i + bit];
+            w = (w << shift) | (begin[2 * (i + 1) + bit] >> (64 - shift));
+        }
+    }
+    begin[2 * lastBlock] <<= shift;
+    begin[2 * lastBlock + 1] <<= shift;
+}
+
+
+
+// The loop has no branches, so the compiler can vectorize it,
+// doing the byte swaps in bitReversal with byte shuffle instructions.
+SHASTA_TARGET_CLONES void LongBaseSequenceView::complementedBitReversal(uint64_t* w, uint64_t n)
+{
+    for(uint64_t i=0; i<n; i++) {
+        w[i] = ~bitReversal(w[i]);
+    }
+}
+
+
+
 void shasta::testLongBaseSequence()
 {
 
@@ -202,4 +254,30 @@ void shasta::testLongBaseSequence()
     cout << s16 << endl;
     extractKmer(view, 72, 8, s16);
     cout << s16 << endl;
+
+    // Test reverseComplement against the base by base version.
+    for(uint64_t n=0; n<300; n++) {
+        vector<Base> bases;
+        for(uint64_t i=0; i<n; i++) {
+            bases.push_back(Base::fromInteger(uint8_t((i * 7 + i / 5) % 4)));
+        }
+        LongBaseSequence s(bases);
+        s.reverseComplement();
+        reverseComplement(bases);
+        for(uint64_t i=0; i<n; i++) {
+            SHASTA_ASSERT(s[i] == bases[i]);
+        }
+    }
+
+    // Test extractKmers against extractKmer.
+    vector<uint64_t> positions;
+    for(uint64_t position=0; position+8<=84; position++) {
+        positions.push_back(position);
+    }
+    vector<ShortBaseSequence16> kmers(positions.size());
+    extractKmers(view, positions, 8, span<ShortBaseSequence16>(kmers));
+    for(uint64_t i=0; i<positions.size(); i++) {
+        extractKmer(view, positions[i], 8, s16);
+        SHASTA_ASSERT(kmers[i] == s16);
+    }
 }
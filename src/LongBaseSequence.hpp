@@ -109,23 +109,16 @@ public:
 
 
     // In-place reverse complement.
-    void reverseComplement()
-    {
-        SHASTA_ASSERT(!readOnly);
-
-        for(uint64_t i=0; i<baseCount/2; i++) {
-            const uint64_t j = baseCount - 1 - i;
-            const Base b = get(i);
-            set(i, get(j).complement());
-            set(j, b.complement());
-        }
-
-        // If the number of bases is odd, also complement
-        // the central base.
-        if(baseCount & 1ULL) {
-            set(baseCount/2, get(baseCount/2).complement());
-        }
-    }
+    // Because each block of 64 bases stores the two bits of each base
+    // in separate words, this is done one word at a time:
+    // the order of the blocks is reversed, each word is bit reversed
+    // and complemented, and finally the words are shifted
+    // to remove the padding that was at the end of the last block.
+    void reverseComplement();
+
+    // Replace each of n words with its complemented bit reversal.
+    // Used by reverseComplement.
+    static void complementedBitReversal(uint64_t*, uint64_t n);
 
 
 
@@ -1,6 +1,5 @@
 // Shasta.
 #include "LowHash0.hpp"
-#include "MurmurHash2.hpp"
 #include "performanceLog.hpp"
 #include "ReadFlags.hpp"
 #include "timestamp.hpp"
@@ -8,6 +7,7 @@ using namespace shasta;
 
 // Standard library.
 #include "chrono.hpp"
+#include <limits>
 #include <numeric>
 
 #include "MultithreadedObject.tpp"
@@ -18,6 +18,21 @@ template class MultithreadedObject<LowHash0>;
 // of aligned reads. It uses as features
 // sequences of m consecutive markers.
 
+// Incremental mode (oldReadCount not zero) is used when reads are
+// added to a set of reads for which alignment candidates were
+// already found, for example when topping up a sample
+// with an additional flowcell. The new reads must have been added
+// after the old ones, so their ReadIds are oldReadCount and above.
+// The low hashes of the old reads are recomputed rather than stored
+// by the previous run, because pass 1 is cheap compared to pass 3
+// and the bucket layout depends on the total number of markers.
+// The only candidates generated are the ones that involve
+// at least one new read.
+// Pairs of old reads, which are the vast majority of bucket pairs
+// in a top-up run, are skipped before any candidate is created.
+// To obtain the same features at each iteration as the previous run,
+// the iteration must be controlled by minHashIterationCount.
+
 
 
 LowHash0::LowHash0(
@@ -33,12 +48,18 @@ LowHash0::LowHash0(
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
     size_t threadCountArgument,
+    ReadId oldReadCount,
+    uint64_t shardCount,
+    uint64_t shardId,
+    const string& shardFileName,
     const Reads& reads,
-    const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& kmerIds,
+    const MarkerKmerIds& kmerIds,
     MemoryMapped::Vector<OrientedReadPair>& candidateAlignments,
+    MemoryMapped::Vector<uint16_t>& candidateFrequencies,
     MemoryMapped::Vector< array<uint64_t, 3> >& readLowHashStatistics,
     const string& largeDataFileNamePrefix,
-    size_t largeDataPageSize
+    size_t largeDataPageSize,
+    BoundedQueue< vector<OrientedReadPair> >* candidateQueue
     ) :
     MultithreadedObject(*this),
     m(m),
@@ -47,11 +68,16 @@ LowHash0::LowHash0(
     maxBucketSize(maxBucketSize),
     minFrequency(minFrequency),
     threadCount(threadCountArgument),
+    oldReadCount(oldReadCount),
+    shardCount(shardCount),
+    shardId(shardId),
     reads(reads),
     kmerIds(kmerIds),
     readLowHashStatistics(readLowHashStatistics),
     largeDataFileNamePrefix(largeDataFileNamePrefix),
     largeDataPageSize(largeDataPageSize),
+    candidateQueue(candidateQueue),
+    lastIteration(minHashIterationCount - 1),
     histogramCsv("LowHashBucketHistogram.csv")
 
 {
@@ -95,6 +121,11 @@ LowHash0::LowHash0(
     cout << "LowHash0 algorithm will use 2^" << log2MinHashBucketCount;
     cout << " = " << bucketCount << " buckets. "<< endl;
 
+    // Group the buckets into partitions.
+    const uint64_t log2PartitionCount = min(size_t(10), log2MinHashBucketCount);
+    partitionCount = 1ULL << log2PartitionCount;
+    partitionShift = log2MinHashBucketCount - log2PartitionCount;
+
 
     // Compute the threshold for a hash value to be considered low.
     hashThreshold = uint64_t(double(hashFraction) * double(std::numeric_limits<uint64_t>::max()));
@@ -103,14 +134,64 @@ LowHash0::LowHash0(
     const OrientedReadId::Int orientedReadCount = OrientedReadId::Int(kmerIds.size());
     const ReadId readCount = orientedReadCount / 2;
 
+    // Check the arguments for incremental mode.
+    if(oldReadCount > 0) {
+        if(oldReadCount >= readCount) {
+            throw runtime_error("LowHash0 incremental mode requires at least one new read.");
+        }
+        if(minHashIterationCount == 0) {
+            throw runtime_error("LowHash0 incremental mode requires "
+                "the number of iterations to be specified via minHashIterationCount.");
+        }
+        cout << "LowHash0 incremental mode: only candidates involving ReadId " <<
+            oldReadCount << " or above will be generated." << endl;
+    }
+
+    // Check the arguments for sharding.
+    SHASTA_ASSERT(shardCount > 0);
+    if(shardCount > 1) {
+        if(shardId >= shardCount) {
+            throw runtime_error("Invalid LowHash0 shard id " + to_string(shardId) +
+                " for shard count " + to_string(shardCount));
+        }
+        if(shardCount > partitionCount) {
+            throw runtime_error("LowHash0 shard count cannot be greater than " +
+                to_string(partitionCount) + " for this number of buckets.");
+        }
+        if(minHashIterationCount == 0) {
+            throw runtime_error("Sharded LowHash0 requires "
+                "the number of iterations to be specified via minHashIterationCount.");
+        }
+        cout << "LowHash0 running shard " << shardId << " of " << shardCount << endl;
+    }
+
+    // Check the arguments for streaming of the final candidates.
+    if(candidateQueue) {
+        SHASTA_ASSERT(shardCount == 1);
+        if(minHashIterationCount == 0) {
+            throw runtime_error("Streaming of LowHash0 candidates requires "
+                "the number of iterations to be specified via minHashIterationCount.");
+        }
+    }
+
 
     // Set up work areas.
+    // Give each shard its own buckets, as shards can run concurrently
+    // using the same large data directory.
+    string bucketsName = largeDataFileNamePrefix + "tmp-LowHash0-Buckets";
+    if(shardCount > 1) {
+        bucketsName += "-" + to_string(shardId);
+    }
     buckets.createNew(
-        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-Buckets"),
+        largeDataFileNamePrefix.empty() ? "" : bucketsName,
         largeDataPageSize);
     lowHashes.resize(orientedReadCount);
-    candidates.resize(readCount);
+    candidateLocations.resize(readCount);
+    for(auto& v: candidateArenas) {
+        v.resize(threadCount);
+    }
     threadStatistics.resize(threadCount);
+    stagedBucketEntries.resize(threadCount, vector< vector<StagedBucketEntry> >(partitionCount));
     readLowHashStatistics.resize(readCount);
     fill(readLowHashStatistics.begin(), readLowHashStatistics.end(),
         array<uint64_t, 3>({0, 0, 0}));
@@ -152,18 +233,19 @@ LowHash0::LowHash0(
         performanceLog << timestamp << "LowHash0 iteration " << iteration << " begins." << endl;
 
         // Pass1: compute the low hashes for each oriented read
-        // and prepare the buckets for filling.
-        buckets.clear();
-        buckets.beginPass1(bucketCount);
+        // and stage the bucket entries by partition.
         size_t batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash0::pass1ThreadFunction, threadCount);
 
-        // Pass 2: fill the buckets.
+        // Pass 2: fill the buckets, one partition at a time.
+        buckets.clear();
+        buckets.beginPass1(bucketCount);
+        setupLoadBalancing(partitionCount, 1);
+        runThreads(&LowHash0::pass2CountThreadFunction, threadCount);
         buckets.beginPass2();
-        batchSize = 10000;
-        setupLoadBalancing(readCount, batchSize);
-        runThreads(&LowHash0::pass2ThreadFunction, threadCount);
+        setupLoadBalancing(partitionCount, 1);
+        runThreads(&LowHash0::pass2StoreThreadFunction, threadCount);
         buckets.endPass2(false, false);
         computeBucketHistogram();
 
@@ -192,20 +274,27 @@ LowHash0::LowHash0(
     // Create the candidate alignments.
     performanceLog << timestamp << "Storing candidate alignments." << endl;
     SHASTA_ASSERT(orientedReadCount == 2*readCount);
-    for(ReadId readId0=0; readId0<readCount; readId0++) {
-        const auto& candidates0 = candidates[readId0];
-        for(const Candidate& candidate: candidates0) {
-            if(candidate.frequency >= minFrequency) {
-                const ReadId readId1 = candidate.readId1;
-                SHASTA_ASSERT(readId0 < readId1);
-                candidateAlignments.push_back(
-                    OrientedReadPair(readId0, readId1, candidate.strand==0));
+    if(shardCount > 1) {
+        writeShard(shardFileName);
+    } else {
+        // The last iteration left the candidates in the generation of iteration-1.
+        for(ReadId readId0=0; readId0<readCount; readId0++) {
+            const auto candidates0 = (iteration == 0) ?
+                span<const Candidate>() : getCandidates(readId0, generation(iteration - 1));
+            for(const Candidate& candidate: candidates0) {
+                if(candidate.frequency >= minFrequency) {
+                    const ReadId readId1 = candidate.readId1;
+                    SHASTA_ASSERT(readId0 < readId1);
+                    candidateAlignments.push_back(
+                        OrientedReadPair(readId0, readId1, candidate.strand==0));
+                    candidateFrequencies.push_back(candidate.frequency);
+                }
             }
         }
+        cout << "Found " << candidateAlignments.size() << " alignment candidates."<< endl;
+        cout << "Average number of alignment candidates per oriented read is ";
+        cout << (2.* double(candidateAlignments.size())) / double(orientedReadCount)  << "." << endl;
     }
-    cout << "Found " << candidateAlignments.size() << " alignment candidates."<< endl;
-    cout << "Average number of alignment candidates per oriented read is ";
-    cout << (2.* double(candidateAlignments.size())) / double(orientedReadCount)  << "." << endl;
 
     // Write read bucket statistics.
     ofstream csv("ReadLowHashStatistics.csv");
@@ -214,7 +303,7 @@ LowHash0::LowHash0(
     for(ReadId readId=0; readId<readCount; readId++) {
         const array<uint64_t, 3>& counters = readLowHashStatistics[readId];
         const uint64_t total = std::accumulate(counters.begin(), counters.end(), 0);
-        const uint64_t featureCount = kmerIds.size(OrientedReadId(readId, 0).getValue()) - (m-1);
+        const uint64_t featureCount = kmerIds.size(OrientedReadId(readId, 0)) - (m-1);
         const double featureSampling = double(total) / double(featureCount);
         csv << readId << ",";
         csv << (reads.getFlags(readId).isPalindromic ? "Yes," : "No,");
@@ -245,12 +334,19 @@ LowHash0::LowHash0(
 
 
 // Pass1: compute the low hashes for each oriented read
-// and prepare the buckets for filling.
+// and stage the bucket entries by partition.
 void LowHash0::pass1ThreadFunction(size_t threadId)
 {
-    const int featureByteCount = int(m * sizeof(KmerId));
+    vector< vector<StagedBucketEntry> >& threadStagedBucketEntries = stagedBucketEntries[threadId];
+
     const uint64_t seed = iteration * 37;
 
+    // Buffer used if the marker KmerIds have to be recomputed.
+    vector<KmerId> kmerIdsBuffer;
+
+    // Work area for computeFeatureLowHashes.
+    vector<uint64_t> mixedKmerIds;
+
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -269,7 +365,7 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
 
                 vector<uint64_t>& orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
                 orientedReadLowHashes.clear();
-                const size_t markerCount = kmerIds.size(orientedReadId.getValue());
+                const size_t markerCount = kmerIds.size(orientedReadId);
 
                 // Handle the pathological case where there are fewer than m markers.
                 // This oriented read ends up in no bucket.
@@ -278,19 +374,19 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
                 }
 
 
-                // Get the markers for this oriented read.
-                const KmerId* kmerIdsPointer = kmerIds.begin(orientedReadId.getValue());
-                const size_t featureCount = markerCount - m + 1;
-
-                // Loop over features of this oriented read.
+                // Compute the low hashes of the features of this oriented read.
                 // Features are sequences of m consecutive markers.
-                for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
-                    const uint64_t hash = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
-                    if(hash < hashThreshold) {
-                        orientedReadLowHashes.push_back(hash);
-                        const uint64_t bucketId = hash & mask;
-                        buckets.incrementCountMultithreaded(bucketId);
+                computeFeatureLowHashes(kmerIds.get(orientedReadId, kmerIdsBuffer),
+                    m, seed, hashThreshold, mixedKmerIds, orientedReadLowHashes);
+
+                // Stage the corresponding bucket entries.
+                for(const uint64_t hash: orientedReadLowHashes) {
+                    const uint64_t bucketId = hash & mask;
+                    if(not isInShard(bucketId)) {
+                        continue;
                     }
+                    threadStagedBucketEntries[bucketId >> partitionShift].push_back(
+                        StagedBucketEntry(bucketId, BucketEntry(orientedReadId, hash)));
                 }
             }
         }
@@ -300,40 +396,93 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
 
 
 
-// Pass 2: fill the buckets.
-void LowHash0::pass2ThreadFunction(size_t threadId)
+void LowHash0::computeFeatureLowHashes(
+    span<const KmerId> kmerIds,
+    uint64_t m,
+    uint64_t seed,
+    uint64_t hashThreshold,
+    vector<uint64_t>& mixedKmerIds,
+    vector<uint64_t>& lowHashes)
 {
+    // Constants used by MurmurHash64A.
+    const uint64_t M = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
 
-    // Loop over batches assigned to this thread.
-    uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
+    const uint64_t n = kmerIds.size();
+    if(n < m) {
+        return;
+    }
+    const uint64_t featureCount = n - m + 1;
+
+    // The part of MurmurHash64A that only depends on each 8-byte word.
+    mixedKmerIds.resize(n);
+    for(uint64_t i=0; i<n; i++) {
+        uint64_t k = kmerIds[i];
+        k *= M;
+        k ^= k >> r;
+        k *= M;
+        mixedKmerIds[i] = k;
+    }
 
-        // Loop over oriented reads assigned to this batch.
-        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
-            const ReadFlags& flags = reads.getFlags(readId);
-            if(flags.discardDueToDuplicates) {
-                continue;
+    // Process the features in blocks of independent lanes.
+    const uint64_t h0 = seed ^ (m * sizeof(KmerId) * M);
+    const uint64_t laneCount = 16;
+    array<uint64_t, laneCount> h;
+    for(uint64_t begin=0; begin<featureCount; begin+=laneCount) {
+        const uint64_t blockSize = min(laneCount, featureCount - begin);
+        const uint64_t* x = mixedKmerIds.data() + begin;
+
+        if(blockSize == laneCount) {
+            for(uint64_t lane=0; lane<laneCount; lane++) {
+                h[lane] = h0;
             }
-            if(flags.isPalindromic) {
-                continue;
+            for(uint64_t j=0; j<m; j++) {
+                for(uint64_t lane=0; lane<laneCount; lane++) {
+                    h[lane] ^= x[lane + j];
+                    h[lane] *= M;
+                }
             }
-            for(Strand strand=0; strand<2; strand++) {
-                const OrientedReadId orientedReadId(readId, strand);
-                const vector<uint64_t>& orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
+            for(uint64_t lane=0; lane<laneCount; lane++) {
+                h[lane] ^= h[lane] >> r;
+                h[lane] *= M;
+                h[lane] ^= h[lane] >> r;
+            }
+        } else {
+            for(uint64_t lane=0; lane<blockSize; lane++) {
+                uint64_t hh = h0;
+                for(uint64_t j=0; j<m; j++) {
+                    hh ^= x[lane + j];
+                    hh *= M;
+                }
+                hh ^= hh >> r;
+                hh *= M;
+                hh ^= hh >> r;
+                h[lane] = hh;
+            }
+        }
 
-                for(const uint64_t hash: orientedReadLowHashes) {
-                    const uint64_t bucketId = hash & mask;
-                    buckets.storeMultithreaded(bucketId, BucketEntry(orientedReadId, hash));
+        // Only keep the low hashes.
+        for(uint64_t lane=0; lane<blockSize; lane++) {
+            if(h[lane] < hashThreshold) {
+                lowHashes.push_back(h[lane]);
+            }
+        }
+    }
+}
 
-                    // Update statistics for this read.
-                    const uint64_t bucketSize = buckets.size(bucketId);
-                    if(bucketSize < minBucketSize) {
-                        ++readLowHashStatistics[readId][0];
-                    } else if(bucketSize > maxBucketSize) {
-                        ++readLowHashStatistics[readId][2];
-                    } else {
-                        ++readLowHashStatistics[readId][1];
-                    }
+
+
+// Pass 2: fill the buckets, one partition at a time.
+// Each partition is processed by a single thread,
+// so no synchronization is needed.
+void LowHash0::pass2CountThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t partition=begin; partition!=end; partition++) {
+            for(const auto& threadStagedBucketEntries: stagedBucketEntries) {
+                for(const StagedBucketEntry& s: threadStagedBucketEntries[partition]) {
+                    buckets.incrementCount(s.bucketId);
                 }
             }
         }
@@ -342,6 +491,26 @@ void LowHash0::pass2ThreadFunction(size_t threadId)
 
 
 
+void LowHash0::pass2StoreThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t partition=begin; partition!=end; partition++) {
+            for(auto& threadStagedBucketEntries: stagedBucketEntries) {
+                vector<StagedBucketEntry>& v = threadStagedBucketEntries[partition];
+                for(const StagedBucketEntry& s: v) {
+                    buckets.store(s.bucketId, s.bucketEntry);
+                }
+
+                // This keeps the memory allocated for the next iteration.
+                v.clear();
+            }
+        }
+    }
+}
+
+
+
 // Pass 3: inspect the buckets to find candidates.
 void LowHash0::pass3ThreadFunction(size_t threadId)
 {
@@ -349,8 +518,16 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
     // The alignment candidates found at this iteration for a single read.
     vector<Candidate> newCandidates;
 
-    // The merged candidates for a single readId0.
-    vector<Candidate> mergedCandidates;
+    // The arena of the previous iteration is only read from,
+    // and the merged candidates of this iteration are appended
+    // to the arena of the current generation for this thread.
+    const uint64_t previousGeneration = generation(iteration + 1);
+    vector<Candidate>& arena = candidateArenas[generation(iteration)][threadId];
+    arena.clear();
+
+    // If streaming, the final candidates of each batch found during the last iteration.
+    const bool streamCandidates = candidateQueue and (iteration == lastIteration);
+    vector<OrientedReadPair> batchCandidates;
 
     ThreadStatistics& thisThreadStatistics = threadStatistics[threadId];
     thisThreadStatistics.clear();
@@ -375,7 +552,20 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
 
                     // Loop over oriented read ids in the bucket corresponding to this hash.
                     const uint64_t bucketId = hash & mask;
+                    if(not isInShard(bucketId)) {
+                        continue;
+                    }
                     const span<BucketEntry> bucket = buckets[bucketId];
+
+                    // Update statistics for this read.
+                    if(bucket.size() < minBucketSize) {
+                        ++readLowHashStatistics[readId0][0];
+                    } else if(bucket.size() > maxBucketSize) {
+                        ++readLowHashStatistics[readId0][2];
+                    } else {
+                        ++readLowHashStatistics[readId0][1];
+                    }
+
                     if(bucket.size() < max(size_t(2), minBucketSize)) {
                         continue;
                     }
@@ -394,6 +584,12 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
                             continue;
                         }
 
+                        // In incremental mode, skip pairs of old reads.
+                        // Since readId0 < readId1, it is enough to check readId1.
+                        if(readId1 < oldReadCount) {
+                            continue;
+                        }
+
                         // Add it to our work area.
                         const bool isSameStrand = orientedReadId1.getStrand() == strand0;
                         newCandidates.push_back(Candidate(readId1, isSameStrand? 0 : 1));
@@ -405,52 +601,68 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
             sort(newCandidates.begin(), newCandidates.end());
 
             // Merge the contents of the work area
-            // with the candidates previously stored.
-            vector<Candidate>& storedCandidates = candidates[readId0];
-            mergedCandidates.clear();
-            merge(storedCandidates, newCandidates, mergedCandidates);
-
-            // Store the merged candidates in place of the old ones.
-            storedCandidates.resize(mergedCandidates.size());
-            copy(mergedCandidates.begin(), mergedCandidates.end(), storedCandidates.begin());
+            // with the candidates stored at the previous iteration,
+            // appending the result to the arena for this thread.
+            const span<const Candidate> storedCandidates = (iteration == 0) ?
+                span<const Candidate>() : getCandidates(readId0, previousGeneration);
+            CandidateLocation& location = candidateLocations[readId0];
+            location.begin = arena.size();
+            location.threadId = uint32_t(threadId);
+            merge(storedCandidates, newCandidates, arena);
+            location.size = uint32_t(arena.size() - location.begin);
 
             // Update thread statistics.
-            thisThreadStatistics.total += storedCandidates.size();
-            thisThreadStatistics.capacity += storedCandidates.capacity();
-            for(const Candidate& candidate: storedCandidates) {
+            thisThreadStatistics.total += location.size;
+            for(uint64_t i=location.begin; i<arena.size(); i++) {
+                const Candidate& candidate = arena[i];
                 if(candidate.frequency >= minFrequency) {
                     ++thisThreadStatistics.highFrequency;
+                    if(streamCandidates) {
+                        batchCandidates.push_back(
+                            OrientedReadPair(readId0, candidate.readId1, candidate.strand==0));
+                    }
                 }
             }
         }
+
+        // If streaming, the candidates for the reads of this batch are final.
+        if(streamCandidates and not batchCandidates.empty()) {
+            candidateQueue->push(std::move(batchCandidates));
+            batchCandidates.clear();
+        }
     }
+    thisThreadStatistics.capacity = arena.capacity();
 }
 
 
 
-// Merge two sorted vectors of candidates into a third one.
-// The input vectors can be sorted but can have duplicates.
+// Merge two sorted spans of candidates and append the result to a vector.
+// The input spans can be sorted but can have duplicates.
 // During merging, when two candidates with the same readId1
 // and strand are found, they are combined, adding up their frequency.
-// This is used by pass4ThreadFunction.
+// This is used by pass3ThreadFunction.
 void LowHash0::merge(
-    const vector<LowHash0::Candidate>& x0,
-    const vector<LowHash0::Candidate>& x1,
+    span<const LowHash0::Candidate> x0,
+    span<const LowHash0::Candidate> x1,
     vector<LowHash0::Candidate>& y
     )
 {
-    using Iterator = vector<LowHash0::Candidate>::const_iterator;
-    Iterator begin0 = x0.begin();
-    Iterator begin1 = x1.begin();
-    Iterator end0 = x0.end();
-    Iterator end1 = x1.end();
+    // Entries of y before this were not generated by this merge
+    // and must not be combined with.
+    const uint64_t yBegin = y.size();
+
+    using Iterator = const LowHash0::Candidate*;
+    Iterator begin0 = x0.data();
+    Iterator begin1 = x1.data();
+    Iterator end0 = begin0 + x0.size();
+    Iterator end1 = begin1 + x1.size();
 
 
 
     // Merge loop..
     // At each step, we find the lowest of the two candidates
     // currently pointed by the two iterators (ties allowed and are ok).
-    // If the merged vector is not empty and ends with an entry that compares equal,
+    // If the merged portion of y is not empty and ends with an entry that compares equal,
     // increment its frequency. Otherwise, just create a new entry in the merged vector.
     Iterator it0 = begin0;
     Iterator it1 = begin1;
@@ -460,7 +672,7 @@ void LowHash0::merge(
         // then exit the merge loop.
         if(it0 == end0) {
             for(; it1!=end1; ++it1) {
-                if(!y.empty() && y.back() == *it1) {
+                if(y.size() > yBegin && y.back() == *it1) {
                     y.back().frequency = uint16_t(y.back().frequency + it1->frequency);
                 } else {
                     y.push_back(*it1);
@@ -473,7 +685,7 @@ void LowHash0::merge(
         // then exit the merge loop.
         if(it1 == end1) {
             for(; it0!=end0; ++it0) {
-                if(!y.empty() && y.back() == *it0) {
+                if(y.size() > yBegin && y.back() == *it0) {
                     y.back().frequency = uint16_t(y.back().frequency + it0->frequency);
                 } else {
                     y.push_back(*it0);
@@ -485,7 +697,7 @@ void LowHash0::merge(
         // If the current x0 entry is less than the current x1 entry,
         // process the x0 entry.
         if(*it0 < *it1) {
-            if(!y.empty() && y.back() == *it0) {
+            if(y.size() > yBegin && y.back() == *it0) {
                 y.back().frequency  = uint16_t(y.back().frequency + it0->frequency);
             } else {
                 y.push_back(*it0);
@@ -494,7 +706,7 @@ void LowHash0::merge(
         } else {
         // If the current x0 entry is not less than the current x1 entry,
         // process the current x1 entry.
-            if(!y.empty() && y.back() == *it1) {
+            if(y.size() > yBegin && y.back() == *it1) {
                 y.back().frequency = uint16_t(y.back().frequency + it1->frequency);
             } else {
                 y.push_back(*it1);
@@ -554,3 +766,88 @@ void LowHash0::computeBucketHistogramThreadFunction(size_t threadId)
         }
     }
 }
+
+
+
+// Write all the candidates found by this shard, with their frequencies,
+// to a binary file. See mergeShards.
+void LowHash0::writeShard(const string& shardFileName) const
+{
+    ofstream file(shardFileName, std::ios::binary);
+    if(not file) {
+        throw runtime_error("Error opening " + shardFileName);
+    }
+
+    // The last iteration left the candidates in the generation of iteration-1.
+    uint64_t count = 0;
+    if(iteration > 0) {
+        const ReadId readCount = ReadId(candidateLocations.size());
+        for(ReadId readId0=0; readId0<readCount; readId0++) {
+            for(const Candidate& candidate: getCandidates(readId0, generation(iteration - 1))) {
+                const ShardCandidate shardCandidate = {readId0, candidate};
+                file.write(reinterpret_cast<const char*>(&shardCandidate), sizeof(shardCandidate));
+                ++count;
+            }
+        }
+    }
+
+    if(not file) {
+        throw runtime_error("Error writing " + shardFileName);
+    }
+    cout << "Wrote " << count << " alignment candidates to " << shardFileName << endl;
+}
+
+
+
+void LowHash0::mergeShards(
+    const vector<string>& shardFileNames,
+    size_t minFrequency,
+    MemoryMapped::Vector<OrientedReadPair>& candidateAlignments,
+    MemoryMapped::Vector<uint16_t>& candidateFrequencies)
+{
+    // Read the candidates written by all the shards.
+    vector<ShardCandidate> shardCandidates;
+    for(const string& fileName: shardFileNames) {
+        ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if(not file) {
+            throw runtime_error("Error opening " + fileName);
+        }
+        const uint64_t byteCount = file.tellg();
+        if((byteCount % sizeof(ShardCandidate)) != 0) {
+            throw runtime_error("Invalid LowHash0 shard file " + fileName);
+        }
+        const uint64_t begin = shardCandidates.size();
+        shardCandidates.resize(begin + byteCount / sizeof(ShardCandidate));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(shardCandidates.data() + begin), std::streamsize(byteCount));
+        if(not file) {
+            throw runtime_error("Error reading " + fileName);
+        }
+    }
+
+    // The same pair can be found by more than one shard,
+    // so add up the frequencies before applying minFrequency.
+    sort(shardCandidates.begin(), shardCandidates.end());
+    for(uint64_t i=0; i<shardCandidates.size(); ) {
+        const ShardCandidate& s = shardCandidates[i];
+        uint64_t frequency = 0;
+        uint64_t j = i;
+        for(; j<shardCandidates.size(); j++) {
+            const ShardCandidate& t = shardCandidates[j];
+            if(t.readId0 != s.readId0 or not(t.candidate == s.candidate)) {
+                break;
+            }
+            frequency += t.candidate.frequency;
+        }
+        if(frequency >= minFrequency) {
+            SHASTA_ASSERT(s.readId0 < s.candidate.readId1);
+            candidateAlignments.push_back(
+                OrientedReadPair(s.readId0, s.candidate.readId1, s.candidate.strand==0));
+            candidateFrequencies.push_back(uint16_t(min(frequency,
+                uint64_t(std::numeric_limits<uint16_t>::max()))));
+        }
+        i = j;
+    }
+    cout << "Found " << candidateAlignments.size() << " alignment candidates in " <<
+        shardFileNames.size() << " LowHash0 shards." << endl;
+}
@@ -2,7 +2,9 @@
 #define SHASTA_LOW_HASH0_HPP
 
 // Shasta
+#include "BoundedQueue.hpp"
 #include "Marker.hpp"
+#include "MarkerKmerIds.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 #include "OrientedReadPair.hpp"
@@ -42,14 +44,47 @@ public:
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
         size_t threadCount,
+
+        // If not zero, reads with ReadId less than oldReadCount are
+        // considered old, and only candidates involving at least
+        // one new read are generated. See LowHash0.cpp for details.
+        ReadId oldReadCount,
+
+        // Sharding of the bucket space, used to distribute
+        // the computation across processes. If shardCount is greater
+        // than 1, only buckets that belong to shard shardId are used,
+        // and the candidates, with their frequencies, are written to
+        // shardFileName instead of being stored. See mergeShards.
+        uint64_t shardCount,
+        uint64_t shardId,
+        const string& shardFileName,
+
         const Reads& reads,
-        const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& kmerIds,
+        const MarkerKmerIds& kmerIds,
         MemoryMapped::Vector<OrientedReadPair>&,
+        MemoryMapped::Vector<uint16_t>& candidateFrequencies, // Same indexing as the candidates.
         MemoryMapped::Vector< array<uint64_t, 3> >& readLowHashStatistics,
         const string& largeDataFileNamePrefix,
-        size_t largeDataPageSize
+        size_t largeDataPageSize,
+
+        // If not null, during the last iteration the final candidates
+        // for each batch of readId0 values are also pushed to this queue
+        // as soon as they are found, so they can be consumed
+        // while LowHash0 is still running. The candidates
+        // are stored as usual. The queue is not closed.
+        // This requires minHashIterationCount to be not zero.
+        BoundedQueue< vector<OrientedReadPair> >* candidateQueue = 0
 );
 
+    // Combine the candidates written by all the shards of a sharded
+    // LowHash0 computation, adding up their frequencies,
+    // and store the ones with frequency at least minFrequency.
+    static void mergeShards(
+        const vector<string>& shardFileNames,
+        size_t minFrequency,
+        MemoryMapped::Vector<OrientedReadPair>&,
+        MemoryMapped::Vector<uint16_t>& candidateFrequencies);
+
 private:
 
     // Store some of the arguments passed to the constructor.
@@ -59,11 +94,16 @@ private:
     size_t maxBucketSize;           // The maximum size for a bucket to be used.
     size_t minFrequency;            // Minimum number of minHash hits for a pair to be considered a candidate.
     size_t threadCount;
+    ReadId oldReadCount;
+    uint64_t shardCount;
+    uint64_t shardId;
     const Reads& reads;
-    const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& kmerIds;
+    const MarkerKmerIds& kmerIds;
     MemoryMapped::Vector< array<uint64_t, 3> > &readLowHashStatistics;
     const string& largeDataFileNamePrefix;
     size_t largeDataPageSize;
+    BoundedQueue< vector<OrientedReadPair> >* candidateQueue;
+    uint64_t lastIteration;
 
     // The current MinHash iteration.
     // This is used to compute a different MurmurHash function
@@ -76,6 +116,22 @@ private:
     vector< vector<uint64_t> > lowHashes;
     void computeLowHashes(size_t threadId);
 
+    // Compute the hashes of all features of an oriented read
+    // and append to lowHashes the ones less than hashThreshold.
+    // A feature is a sequence of m consecutive KmerIds,
+    // and the hash is the same as MurmurHash64A over its m*sizeof(KmerId)
+    // bytes. The per-KmerId part of MurmurHash64A
+    // is computed once per KmerId instead of once per feature,
+    // and features are processed in blocks of independent lanes
+    // that the compiler can vectorize.
+    static void computeFeatureLowHashes(
+        span<const KmerId>,
+        uint64_t m,
+        uint64_t seed,
+        uint64_t hashThreshold,
+        vector<uint64_t>& mixedKmerIds,     // Work area.
+        vector<uint64_t>& lowHashes);
+
     // The mask used to compute to compute the bucket
     // corresponding to a hash value.
     uint64_t mask;
@@ -96,6 +152,34 @@ private:
     };
     MemoryMapped::VectorOfVectors<BucketEntry, uint64_t> buckets;
 
+    // To improve memory locality when filling the buckets,
+    // consecutive buckets are grouped into partitions.
+    // During pass 1, each thread stages the entries it generates
+    // separately for each partition. During pass 2, each partition
+    // is processed by a single thread, which then writes
+    // to a contiguous range of buckets without synchronization.
+    class StagedBucketEntry {
+    public:
+        uint32_t bucketId;
+        BucketEntry bucketEntry;
+        StagedBucketEntry(
+            uint64_t bucketId,
+            const BucketEntry& bucketEntry) :
+            bucketId(uint32_t(bucketId)),
+            bucketEntry(bucketEntry) {}
+    };
+    uint64_t partitionCount;
+    uint64_t partitionShift;    // bucketId >> partitionShift gives the partition.
+
+    // Indexed by [threadId][partition].
+    vector< vector< vector<StagedBucketEntry> > > stagedBucketEntries;
+
+    // When sharding, partitions are assigned to shards round robin.
+    bool isInShard(uint64_t bucketId) const
+    {
+        return ((bucketId >> partitionShift) % shardCount) == shardId;
+    }
+
 
 
     // Class used to store candidate pairs.
@@ -125,26 +209,66 @@ private:
     };
     static_assert(sizeof(Candidate) == 8, "Unexpected size of LowHash0::Candidate.");
 
+    // The record written to a shard file for each candidate.
+    class ShardCandidate {
+    public:
+        ReadId readId0;
+        Candidate candidate;
+        bool operator<(const ShardCandidate& that) const
+        {
+            return tie(readId0, candidate) < tie(that.readId0, that.candidate);
+        }
+    };
+    void writeShard(const string& shardFileName) const;
 
 
-    // Merge two sorted vectors of candidates into a third one.
-    // The input vectors can be sorted but can have duplicates.
+
+    // Merge two sorted spans of candidates and append the result to a vector.
+    // The input spans can be sorted but can have duplicates.
     // During merging, when two candidates with the same readId1
     // and strand are found, they are combined, adding up their frequency.
-    // This is used by pass4ThreadFunction.
+    // This is used by pass3ThreadFunction.
     static void merge(
-        const vector<Candidate>&,
-        const vector<Candidate>&,
+        span<const Candidate>,
+        span<const Candidate>,
         vector<Candidate>&
         );
 
 
 
     // The alignment candidates for each read.
-    // Indexed by readId0, the read id of the lower numbered read in the pair.
     // We only store pairs with readId1>readId0.
     // For each readId0, this is kept sorted.
-    vector< vector<Candidate> > candidates;
+    // The candidates are stored in per-thread arenas. Two generations
+    // of arenas are used: at each iteration, pass 3 reads
+    // the candidates of the previous iteration from one generation
+    // and appends the merged candidates to the other one.
+    // The arenas are cleared but keep their memory, so after
+    // the first few iterations no memory allocation takes place.
+    class CandidateLocation {
+    public:
+        uint64_t begin = 0;
+        uint32_t size = 0;
+        uint32_t threadId = 0;
+    };
+
+    // Indexed by readId0, the read id of the lower numbered read in the pair.
+    vector<CandidateLocation> candidateLocations;
+
+    // Indexed by [generation][threadId].
+    array<vector< vector<Candidate> >, 2> candidateArenas;
+    uint64_t generation(uint64_t iteration) const
+    {
+        return iteration & 1;
+    }
+
+    // Get the candidates for a readId0 stored in the given generation.
+    span<const Candidate> getCandidates(ReadId readId0, uint64_t generation) const
+    {
+        const CandidateLocation& location = candidateLocations[readId0];
+        const Candidate* begin = candidateArenas[generation][location.threadId].data() + location.begin;
+        return span<const Candidate>(begin, location.size);
+    }
 
 
 
@@ -181,11 +305,14 @@ private:
     // Thread functions.
 
     // Pass1: compute the low hashes for each oriented read
-    // and prepare the buckets for filling.
+    // and stage the bucket entries by partition.
     void pass1ThreadFunction(size_t threadId);
 
-    // Pass 2: fill the buckets.
-    void pass2ThreadFunction(size_t threadId);
+    // Pass 2: fill the buckets, one partition at a time.
+    // The first function counts the entries of each bucket,
+    // the second one stores them.
+    void pass2CountThreadFunction(size_t threadId);
+    void pass2StoreThreadFunction(size_t threadId);
 
     // Pass 3: inspect the buckets to find candidates.
     void pass3ThreadFunction(size_t threadId);
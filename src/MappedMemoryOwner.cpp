@@ -0,0 +1,106 @@
+#include "MappedMemoryOwner.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <filesystem>
+#include "fstream.hpp"
+#include "stdexcept.hpp"
+
+// The file, in the cold data directory, that records the cold names.
+static const string coldDataNamesFileName = "ColdDataNames.txt";
+
+
+
+// Binary objects that are large but accessed infrequently
+// or only sequentially, mostly for output and the http server.
+const vector<string>& MappedMemoryOwner::defaultColdDataNames()
+{
+    static const vector<string> names = {
+        "ReadNames",
+        "ReadMetaData",
+        "ReadIdsSortedByName",
+        "ReadLowHashStatistics",
+        "CandidateTable",
+        "CompressedAlignments",
+        "MarkerGraphVerticesCompressedCoverageData",
+        "MarkerGraphEdgesCompressedCoverageData",
+        "AssembledSequences",
+        "AssembledRepeatCounts"
+        };
+    return names;
+}
+
+
+
+vector<string> MappedMemoryOwner::readColdDataNames(const string& fileName)
+{
+    ifstream file(fileName);
+    if(not file) {
+        throw runtime_error("Error opening memory tiering policy file " + fileName);
+    }
+
+    vector<string> names;
+    string line;
+    while(std::getline(file, line)) {
+
+        // Remove leading and trailing white space.
+        const auto begin = line.find_first_not_of(" \t\r");
+        if(begin == string::npos) {
+            continue;
+        }
+        const auto end = line.find_last_not_of(" \t\r");
+        const string name = line.substr(begin, end + 1 - begin);
+
+        if(name[0] == '#') {
+            continue;
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+
+
+void MappedMemoryOwner::setupColdData(
+    const string& coldDataDirectory,
+    const vector<string>& names)
+{
+    if(not std::filesystem::create_directory(coldDataDirectory)) {
+        throw runtime_error("Could not create directory " + coldDataDirectory);
+    }
+
+    ofstream file(coldDataDirectory + "/" + coldDataNamesFileName);
+    for(const string& name: names) {
+        file << name << "\n";
+    }
+    if(not file) {
+        throw runtime_error("Error writing " + coldDataDirectory + "/" + coldDataNamesFileName);
+    }
+
+    coldDataFileNamePrefix = coldDataDirectory + "/";
+    coldDataNames = names;
+}
+
+
+
+bool MappedMemoryOwner::accessColdData(const string& coldDataDirectory)
+{
+    const string fileName = coldDataDirectory + "/" + coldDataNamesFileName;
+    if(not std::filesystem::exists(fileName)) {
+        return false;
+    }
+
+    coldDataNames = readColdDataNames(fileName);
+    coldDataFileNamePrefix = coldDataDirectory + "/";
+    return true;
+}
+
+
+
+string MappedMemoryOwner::coldDataDirectoryName(const string& largeDataFileNamePrefix)
+{
+    // Remove the trailing slash, then replace the last component.
+    const std::filesystem::path dataDirectory =
+        std::filesystem::path(largeDataFileNamePrefix).parent_path();
+    return (dataDirectory.parent_path() / "ColdData").string();
+}
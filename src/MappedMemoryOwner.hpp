@@ -1,8 +1,11 @@
 #ifndef SHASTA_MAPPED_MEMORY_OWNER_HPP
 #define SHASTA_MAPPED_MEMORY_OWNER_HPP
 
+#include "algorithm.hpp"
 #include "cstdint.hpp"
+#include "MemoryMappedVector.hpp"
 #include "string.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     class MappedMemoryOwner;
@@ -19,15 +22,65 @@ public:
     // Function to construct names for binary objects.
     // The output can be passed to createNew or accessExisting
     // member functions of MemoryMapped obkects.
+    // For anonymous objects, the name is kept in MemoryMapped::anonymousName
+    // to identify the object in memory usage reports.
+    // If tiered placement is in use (see below), the objects
+    // designated as cold are placed in coldDataFileNamePrefix.
     string largeDataName(const string& name) const
     {
         if(largeDataFileNamePrefix.empty()) {
+            MemoryMapped::anonymousName = name;
             return "";  // Anonymous;
+        } else if(isColdData(name)) {
+            return coldDataFileNamePrefix + name;
         } else {
             return largeDataFileNamePrefix + name;
         }
     }
 
+    // Tiered placement of binary data (--memoryTiering).
+    // With --memoryMode filesystem, binary data normally all go
+    // to the Data directory, which can be backed by huge pages.
+    // If tiered placement is in use, the binary objects listed
+    // in coldDataNames go instead to coldDataFileNamePrefix,
+    // a directory on disk, so memory is reserved for
+    // the structures that are accessed most heavily.
+    // This only affects placement, never the stored data.
+    // The names are those passed to largeDataName.
+    static inline string coldDataFileNamePrefix;
+    static inline vector<string> coldDataNames;
+    static bool isColdData(const string& name)
+    {
+        if(coldDataFileNamePrefix.empty()) {
+            return false;
+        }
+        return std::find(coldDataNames.begin(), coldDataNames.end(), name) != coldDataNames.end();
+    }
+
+    // The names that are cold by default, used by "--memoryTiering default".
+    static const vector<string>& defaultColdDataNames();
+
+    // Read the names of the cold binary objects from a policy file,
+    // with one name per line. Blank lines and lines
+    // beginning with "#" are ignored.
+    static vector<string> readColdDataNames(const string& fileName);
+
+    // Turn on tiered placement for a new assembly, using the
+    // given directory for cold data. This creates the directory
+    // and records the cold names in it, so later uses
+    // of the same binary data can find them (see accessColdData).
+    static void setupColdData(const string& coldDataDirectory, const vector<string>& names);
+
+    // If the given directory exists and was created by setupColdData,
+    // turn on tiered placement as it was used when the binary data
+    // were created, and return true. Otherwise, return false.
+    static bool accessColdData(const string& coldDataDirectory);
+
+    // The cold data directory that goes with a data directory:
+    // for a largeDataFileNamePrefix of the form .../Data/,
+    // this is .../ColdData/.
+    static string coldDataDirectoryName(const string& largeDataFileNamePrefix);
+
     MappedMemoryOwner() {}
     MappedMemoryOwner(const MappedMemoryOwner&) = default;
 
@@ -37,8 +37,12 @@ class shasta::CompressedMarker {
 public:
 
     // The position of this marker in the oriented read.
-    // This limits the length of a read to 2^24=16Mib bases.
+    // This limits the length of a read to 2^24=16Mib bases
+    // (in the representation used to store the reads).
+    // Longer reads are split into pieces by the ReadLoader.
     Uint24 position;
+
+    static const uint64_t maxReadLength = 1ULL << 24;
 };
 
 
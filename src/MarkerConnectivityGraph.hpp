@@ -17,10 +17,13 @@ or just alignments that are in the ReadGraph.
 #include "Marker.hpp"
 #include <boost/graph/adjacency_list.hpp>
 
-#include <map>
+#include <limits>
+#include "utility.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     class MarkerConnectivityGraph;
+    class MarkerConnectivityGraphVertexMap;
 
     using MarkerConnectivityGraphBaseClass = boost::adjacency_list<
         boost::setS,
@@ -28,14 +31,118 @@ namespace shasta {
         boost::undirectedS,
         MarkerDescriptor
         >;
-
-    class MarkerConnectivityGraphVertexMap :
-        public std::map<MarkerDescriptor, MarkerConnectivityGraphBaseClass::vertex_descriptor>
-    {};
 }
 
 
 
+// Map from MarkerDescriptor to vertex of the MarkerConnectivityGraph.
+// This uses an open addressing hash table with linear probing,
+// keyed by the MarkerDescriptor packed in 64 bits.
+// The table is doubled when its load factor exceeds 1/2.
+class shasta::MarkerConnectivityGraphVertexMap {
+public:
+    using vertex_descriptor = MarkerConnectivityGraphBaseClass::vertex_descriptor;
+
+    MarkerConnectivityGraphVertexMap()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        table.assign(1ULL << 8, Slot({emptyKey, 0}));
+        slotMask = table.size() - 1;
+        usedSlotCount = 0;
+    }
+
+    uint64_t size() const
+    {
+        return usedSlotCount;
+    }
+
+    // Return the vertex corresponding to a MarkerDescriptor,
+    // or MarkerConnectivityGraph::null_vertex() if not present.
+    vertex_descriptor find(const MarkerDescriptor& markerDescriptor) const
+    {
+        const uint64_t key = getKey(markerDescriptor);
+        for(uint64_t slot=getSlot(key); ; slot=(slot+1) & slotMask) {
+            const Slot& s = table[slot];
+            if(s.key == key) {
+                return s.v;
+            }
+            if(s.key == emptyKey) {
+                return MarkerConnectivityGraphBaseClass::null_vertex();
+            }
+        }
+    }
+
+    // Insert a MarkerDescriptor, if not already present.
+    // Returns the vertex stored for the MarkerDescriptor,
+    // and true if it was inserted.
+    pair<vertex_descriptor, bool> insert(const MarkerDescriptor& markerDescriptor, vertex_descriptor v)
+    {
+        const pair<vertex_descriptor, bool> p = insert(getKey(markerDescriptor), v);
+
+        // If necessary, double the size of the table.
+        if(2 * usedSlotCount > table.size()) {
+            vector<Slot> oldTable(2 * table.size(), Slot({emptyKey, 0}));
+            oldTable.swap(table);
+            slotMask = table.size() - 1;
+            usedSlotCount = 0;
+            for(const Slot& s: oldTable) {
+                if(s.key != emptyKey) {
+                    insert(s.key, s.v);
+                }
+            }
+        }
+        return p;
+    }
+
+private:
+    class Slot {
+    public:
+        uint64_t key;
+        vertex_descriptor v;
+    };
+    vector<Slot> table;
+    uint64_t slotMask;
+    uint64_t usedSlotCount;
+
+    // The invalid OrientedReadId with ordinal 0xffffffff cannot be a valid key.
+    static const uint64_t emptyKey = std::numeric_limits<uint64_t>::max();
+
+    static uint64_t getKey(const MarkerDescriptor& markerDescriptor)
+    {
+        return (uint64_t(markerDescriptor.first.getValue()) << 32) | uint64_t(markerDescriptor.second);
+    }
+
+    uint64_t getSlot(uint64_t key) const
+    {
+        uint64_t h = key ^ (key >> 29);
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h & slotMask;
+    }
+
+    pair<vertex_descriptor, bool> insert(uint64_t key, vertex_descriptor v)
+    {
+        for(uint64_t slot=getSlot(key); ; slot=(slot+1) & slotMask) {
+            Slot& s = table[slot];
+            if(s.key == key) {
+                return make_pair(s.v, false);
+            }
+            if(s.key == emptyKey) {
+                s.key = key;
+                s.v = v;
+                ++usedSlotCount;
+                return make_pair(v, true);
+            }
+        }
+    }
+};
+
+
+
 class shasta::MarkerConnectivityGraph : public MarkerConnectivityGraphBaseClass {
 public:
 };
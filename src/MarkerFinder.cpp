@@ -10,6 +10,7 @@ using namespace shasta;
 // Standard library.
 #include <chrono>
 #include <limits>
+#include <type_traits>
 
 #include "MultithreadedObject.tpp"
 template class MultithreadedObject<MarkerFinder>;
@@ -22,13 +23,46 @@ MarkerFinder::MarkerFinder(
     size_t threadCountArgument) :
     MultithreadedObject(*this),
     k(k),
-    kmerChecker(kmerChecker),
+    kmerChecker(&kmerChecker),
     reads(reads),
     markers(markers),
     threadCount(threadCountArgument)
+{
+    run();
+}
+
+
+
+// Constructor that uses marker positions already computed
+// while the reads were loaded (see ReadLoader).
+// markerPositions[readId] contains the strand 0 marker positions of each read.
+MarkerFinder::MarkerFinder(
+    size_t k,
+    const MemoryMapped::VectorOfVectors<uint32_t, uint64_t>& markerPositions,
+    const Reads& reads,
+    MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    size_t threadCountArgument) :
+    MultithreadedObject(*this),
+    k(k),
+    markerPositions(&markerPositions),
+    reads(reads),
+    markers(markers),
+    threadCount(threadCountArgument)
+{
+    SHASTA_ASSERT(markerPositions.size() == reads.readCount());
+    run();
+}
+
+
+
+void MarkerFinder::run()
 {
     // Initial message.
-    performanceLog << timestamp << "Finding markers in " << reads.readCount() << " reads." << endl;
+    performanceLog << timestamp << "Finding markers in " << reads.readCount() << " reads";
+    if(markerPositions) {
+        performanceLog << " using marker positions computed while loading reads";
+    }
+    performanceLog << "." << endl;
     const auto tBegin = std::chrono::steady_clock::now();
 
     // Adjust the numbers of threads, if necessary.
@@ -56,8 +90,47 @@ MarkerFinder::MarkerFinder(
 
 
 
+// Find the strand 0 positions of the markers of a read.
+// The work vectors are passed in to avoid memory allocation.
+void MarkerFinder::findMarkerPositions(
+    const LongBaseSequenceView& read,
+    uint64_t k,
+    const KmerChecker& kmerChecker,
+    vector<KmerId>& kmerIds,
+    vector<KmerId>& kmerIdsRc,
+    vector<uint8_t>& isMarker,
+    vector<uint32_t>& positions)
+{
+    positions.clear();
+    if(read.baseCount < k) {   // Avoid pathological case.
+        return;
+    }
+
+    // Compute the KmerIds of all k-mers of this read
+    // and find out which ones are markers, with a single
+    // call to the KmerChecker.
+    computeKmerIds(read, k, kmerIds, kmerIdsRc);
+    isMarker.resize(kmerIds.size());
+    kmerChecker.isMarkerBatch(kmerIds, kmerIdsRc, isMarker);
+
+    const uint32_t kmerCount = uint32_t(read.baseCount + 1 - k);
+    for(uint32_t position=0; position<kmerCount; position++) {
+        if(isMarker[position]) {
+            positions.push_back(position);
+        }
+    }
+}
+
+
+
 void MarkerFinder::threadFunction(size_t threadId)
 {
+    // Vectors to hold the KmerIds of a read, reused for all reads
+    // processed by this thread.
+    vector<KmerId> kmerIds;
+    vector<KmerId> kmerIdsRc;
+    vector<uint8_t> isMarker;
+    vector<uint32_t> positionsVector;
 
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
@@ -67,54 +140,35 @@ void MarkerFinder::threadFunction(size_t threadId)
         for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
 
             const LongBaseSequenceView read = reads.getRead(readId);
-            size_t markerCount = 0; // For this read.
-            CompressedMarker* markerPointerStrand0 = 0;
-            CompressedMarker* markerPointerStrand1 = 0;
-            if(pass == 2) {
-                markerPointerStrand0 = markers.begin(OrientedReadId(readId, 0).getValue());
-                markerPointerStrand1 = markers.end(OrientedReadId(readId, 1).getValue()) - 1ULL;
-            }
+            SHASTA_ASSERT(read.baseCount <= CompressedMarker::maxReadLength);
 
-            if(read.baseCount >= k) {   // Avoid pathological case.
-
-                // Loop over k-mers of this read.
-                Kmer kmer;
-                for(size_t position=0; position<k; position++) {
-                    kmer.set(position, read[position]);
-                }
-                for(uint32_t position=0; /*The check is done later */; position++) {
-                    const KmerId kmerId = KmerId(kmer.id(k));
-                    if(kmerChecker.isMarker(kmerId)) {
-                        // This k-mer is a marker.
-
-                        if(pass == 1) {
-                            ++markerCount;
-                        } else {
-                            // Strand 0.
-                            markerPointerStrand0->position = position;
-                            ++markerPointerStrand0;
-
-                            // Strand 1.
-                            markerPointerStrand1->position = uint32_t(read.baseCount - k - position);
-                            --markerPointerStrand1;
-
-                        }
-                    }
-
-                    if(position+k == read.baseCount) {
-                        break;
-                    }
-
-                    // Update the k-mer.
-                    kmer.shiftLeft();
-                    kmer.set(k-1, read[position+k]);
-                }
+            // Get the strand 0 marker positions of this read,
+            // computing them if necessary.
+            span<const uint32_t> positions;
+            if(markerPositions) {
+                positions = (*markerPositions)[readId];
+            } else {
+                findMarkerPositions(read, k, *kmerChecker, kmerIds, kmerIdsRc, isMarker, positionsVector);
+                positions = span<const uint32_t>(positionsVector.data(), positionsVector.size());
             }
+            const uint64_t markerCount = positions.size();
 
             if(pass == 1) {
                 markers.incrementCount(OrientedReadId(readId, 0).getValue(), markerCount);
                 markers.incrementCount(OrientedReadId(readId, 1).getValue(), markerCount);
             } else {
+                CompressedMarker* markerPointerStrand0 = markers.begin(OrientedReadId(readId, 0).getValue());
+                CompressedMarker* markerPointerStrand1 = markers.end(OrientedReadId(readId, 1).getValue()) - 1ULL;
+                for(const uint32_t position: positions) {
+
+                    // Strand 0.
+                    markerPointerStrand0->position = position;
+                    ++markerPointerStrand0;
+
+                    // Strand 1.
+                    markerPointerStrand1->position = uint32_t(read.baseCount - k - position);
+                    --markerPointerStrand1;
+                }
                 SHASTA_ASSERT(markerPointerStrand0 ==
                     markers.end(OrientedReadId(readId, 0).getValue()));
                 SHASTA_ASSERT(markerPointerStrand1 ==
@@ -124,3 +178,98 @@ void MarkerFinder::threadFunction(size_t threadId)
     }
 
 }
+
+
+
+// Compute the KmerIds of all k-mers of a read, for both strands.
+// The KmerId of a k-mer is the concatenation of the MSB bits
+// of its k bases followed by the LSB bits, with the first base
+// in the most significant position (see ShortBaseSequence::id).
+// We maintain the two bit planes of the k-mer and of its
+// reverse complement as rolling windows. Each block of 64 bases
+// of the LongBaseSequenceView is loaded once, and the
+// inner loop only uses shifts and masks, without going through
+// Base and ShortBaseSequence for each position.
+template<class K> void MarkerFinder::computeKmerIdsImplementation(
+    const LongBaseSequenceView& read,
+    K kArgument,
+    vector<KmerId>& kmerIds,
+    vector<KmerId>& kmerIdsRc)
+{
+    const uint64_t k = kArgument;
+    SHASTA_ASSERT(k > 0 and k < 32);
+    const uint64_t n = read.baseCount;
+    SHASTA_ASSERT(n >= k);
+    const uint64_t kmerCount = n + 1 - k;
+    kmerIds.resize(kmerCount);
+    kmerIdsRc.resize(kmerCount);
+    KmerId* kmerIdsPointer = kmerIds.data();
+    KmerId* kmerIdsRcPointer = kmerIdsRc.data();
+
+    const uint64_t mask = (1ULL << k) - 1ULL;
+    const uint64_t rcShift = k - 1;
+
+    // The rolling bit planes.
+    uint64_t lsb = 0;
+    uint64_t msb = 0;
+    uint64_t lsbRc = 0;
+    uint64_t msbRc = 0;
+
+    // Loop over blocks of 64 bases.
+    for(uint64_t blockBegin=0; blockBegin<n; blockBegin+=64) {
+        const uint64_t word0 = read.begin[(blockBegin >> 6ULL) << 1ULL];
+        const uint64_t word1 = read.begin[((blockBegin >> 6ULL) << 1ULL) + 1ULL];
+        const uint64_t blockEnd = min(blockBegin + 64, n);
+
+        for(uint64_t i=blockBegin; i<blockEnd; i++) {
+            const uint64_t bitIndex = 63ULL - (i & 63ULL);
+            const uint64_t bit0 = (word0 >> bitIndex) & 1ULL;
+            const uint64_t bit1 = (word1 >> bitIndex) & 1ULL;
+
+            // The new base goes in the least significant
+            // position of the forward k-mer.
+            lsb = ((lsb << 1ULL) | bit0) & mask;
+            msb = ((msb << 1ULL) | bit1) & mask;
+
+            // Its complement goes in the most significant
+            // position of the reverse complemented k-mer.
+            lsbRc = (lsbRc >> 1ULL) | ((bit0 ^ 1ULL) << rcShift);
+            msbRc = (msbRc >> 1ULL) | ((bit1 ^ 1ULL) << rcShift);
+
+            if(i + 1 >= k) {
+                const uint64_t position = i + 1 - k;
+                kmerIdsPointer[position] = KmerId((msb << k) | lsb);
+                kmerIdsRcPointer[position] = KmerId((msbRc << k) | lsbRc);
+            }
+        }
+    }
+}
+
+
+
+// For the values of k used by the built-in configurations,
+// dispatch to a version compiled for that value of k,
+// so shifts and masks are compile time constants.
+void MarkerFinder::computeKmerIds(
+    const LongBaseSequenceView& read,
+    uint64_t k,
+    vector<KmerId>& kmerIds,
+    vector<KmerId>& kmerIdsRc)
+{
+    switch(k) {
+    case 8:
+        computeKmerIdsImplementation(read, std::integral_constant<uint64_t, 8>(), kmerIds, kmerIdsRc);
+        return;
+    case 10:
+        computeKmerIdsImplementation(read, std::integral_constant<uint64_t, 10>(), kmerIds, kmerIdsRc);
+        return;
+    case 14:
+        computeKmerIdsImplementation(read, std::integral_constant<uint64_t, 14>(), kmerIds, kmerIdsRc);
+        return;
+    case 15:
+        computeKmerIdsImplementation(read, std::integral_constant<uint64_t, 15>(), kmerIds, kmerIdsRc);
+        return;
+    default:
+        computeKmerIdsImplementation(read, k, kmerIds, kmerIdsRc);
+    }
+}
@@ -32,15 +32,65 @@ public:
         MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
         size_t threadCount);
 
+    // Constructor that uses marker positions already computed
+    // by findMarkerPositions while the reads were loaded
+    // (see ReadLoader). markerPositions is indexed by ReadId
+    // and contains the strand 0 marker positions of each read.
+    MarkerFinder(
+        size_t k,
+        const MemoryMapped::VectorOfVectors<uint32_t, uint64_t>& markerPositions,
+        const Reads& reads,
+        MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        size_t threadCount);
+
+    // Find the strand 0 positions of the markers of a read.
+    // This only depends on the read and the KmerChecker,
+    // so it can be called as soon as a read is available.
+    // The other vectors are work areas passed in by the caller
+    // to avoid memory allocation.
+    static void findMarkerPositions(
+        const LongBaseSequenceView&,
+        uint64_t k,
+        const KmerChecker&,
+        vector<KmerId>& kmerIds,
+        vector<KmerId>& kmerIdsRc,
+        vector<uint8_t>& isMarker,
+        vector<uint32_t>& positions);
+
+    // Compute the KmerIds of all k-mers of a read, for both strands.
+    // On return, kmerIds[position] is the KmerId of the k-mer
+    // starting at that position on strand 0, and kmerIdsRc[position]
+    // is the KmerId of its reverse complement.
+    // This uses a rolling 2-bit window that works directly
+    // on the words of the LongBaseSequenceView.
+    static void computeKmerIds(
+        const LongBaseSequenceView&,
+        uint64_t k,
+        vector<KmerId>& kmerIds,
+        vector<KmerId>& kmerIdsRc);
+
 private:
 
+    // Implementation of computeKmerIds. K is either uint64_t or,
+    // for the values of k used by the built-in configurations,
+    // std::integral_constant<uint64_t, k>. In the latter case
+    // the shifts and masks are compile time constants.
+    template<class K> static void computeKmerIdsImplementation(
+        const LongBaseSequenceView&,
+        K k,
+        vector<KmerId>& kmerIds,
+        vector<KmerId>& kmerIdsRc);
+
     // The arguments passed to the constructor.
+    // Only one of kmerChecker and markerPositions is set.
     size_t k;
-    const KmerChecker& kmerChecker;
+    const KmerChecker* kmerChecker = 0;
+    const MemoryMapped::VectorOfVectors<uint32_t, uint64_t>* markerPositions = 0;
     const Reads& reads;
     MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
     size_t threadCount;
 
+    void run();
     void threadFunction(size_t threadId);
 
     // In pass 1, we count the number of markers for each
@@ -8,6 +8,7 @@ using namespace shasta;
 
 // Standard library.
 #include "fstream.hpp"
+#include <limits>
 
 #include "MultithreadedObject.tpp"
 template class MultithreadedObject<MarkerGraph>;
@@ -65,6 +66,9 @@ void MarkerGraph::remove()
     if(edgeCoverageData.isOpen()) {
         edgeCoverageData.remove();
     }
+    if(edgeOrientedReadIds.isOpen()) {
+        edgeOrientedReadIds.remove();
+    }
 }
 
 
@@ -178,6 +182,14 @@ void MarkerGraph::removeVertices(
     const uint64_t batchCount = 10000;
     setupLoadBalancing(verticesToBeKept.size(), batchCount);
     runThreads(&MarkerGraph::removeVerticesThreadFunction1, threadCount);
+
+    // Invalidate the entire vertexTable.
+    // Pass 2 will then fill in the entries for the vertices that are kept.
+    setupLoadBalancing(vertexTable.size(), 1000000);
+    runThreads(&MarkerGraph::removeVerticesThreadFunction3, threadCount);
+
+    // Pass 2 copies the markers of the vertices that are kept
+    // and, in the same loop, updates the vertexTable, in place.
     newVertices.beginPass2();
     setupLoadBalancing(verticesToBeKept.size(), batchCount);
     runThreads(&MarkerGraph::removeVerticesThreadFunction2, threadCount);
@@ -193,12 +205,6 @@ void MarkerGraph::removeVertices(
     removeVerticesData.newVerticesPointer = 0;
 
 
-    // Update the vertexTable, in place.
-    fill(vertexTable.begin(), vertexTable.end(), invalidCompressedVertexId);
-    setupLoadBalancing(vertexCount(), batchCount);
-    runThreads(&MarkerGraph::removeVerticesThreadFunction3, threadCount);
-
-
 
     // Remove everything else.
     if(reverseComplementVertex.isOpen) {
@@ -234,6 +240,9 @@ void MarkerGraph::removeVertices(
     if(edgeCoverageData.isOpen()) {
         edgeCoverageData.remove();
     }
+    if(edgeOrientedReadIds.isOpen()) {
+        edgeOrientedReadIds.remove();
+    }
 }
 
 
@@ -273,8 +282,13 @@ void MarkerGraph::removeVerticesThreadFunction2(size_t threadId)
         // Loop over vertices assigned to this thread.
         for(VertexId newVertexId=begin; newVertexId!=end; newVertexId++) {
             const VertexId oldVertexId = verticesToBeKept[newVertexId];
-            copy(vertices().begin(oldVertexId), vertices().end(oldVertexId),
+            const CompressedVertexId compressedVertexId = newVertexId;
+            const span<MarkerId> oldVertexMarkerIds = vertices()[oldVertexId];
+            copy(oldVertexMarkerIds.begin(), oldVertexMarkerIds.end(),
                 newVertices.begin(newVertexId));
+            for(const MarkerId markerId: oldVertexMarkerIds) {
+                vertexTable[markerId] = compressedVertexId;
+            }
         }
     }
 }
@@ -283,19 +297,12 @@ void MarkerGraph::removeVerticesThreadFunction2(size_t threadId)
 
 void MarkerGraph::removeVerticesThreadFunction3(size_t threadId)
 {
+    CompressedVertexId* v = vertexTable.begin();
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
-
-        // Loop over vertices assigned to this thread.
-        for(VertexId vertexId=begin; vertexId!=end; vertexId++) {
-            const CompressedVertexId compressedVertexId = vertexId;
-            const span<MarkerId> vertexMarkerIds = vertices()[vertexId];
-            for(const MarkerId markerId: vertexMarkerIds) {
-                vertexTable[markerId] = compressedVertexId;
-            }
-        }
+        std::fill(v + begin, v + end, invalidCompressedVertexId);
     }
 }
 
@@ -327,6 +334,22 @@ MarkerGraph::VertexId MarkerGraph::renumberVertexTable(size_t threadCount)
 // This second version can be called if the maximum vertex id
 // present in the vertex table is already known, and is faster.
 MarkerGraph::VertexId MarkerGraph::renumberVertexTable(size_t threadCount, VertexId maxVertexId)
+{
+    MemoryMapped::Vector<VertexId> newVertexId;
+    const VertexId newMaxVertexId = renumberVertexTable(threadCount, maxVertexId, newVertexId);
+    newVertexId.remove();
+    return newMaxVertexId;
+}
+
+
+
+// This third version also returns the new VertexId corresponding to
+// each old VertexId (invalidVertexId for VertexId's not present).
+// On return, the caller owns newVertexId and is responsible for removing it.
+MarkerGraph::VertexId MarkerGraph::renumberVertexTable(
+    size_t threadCount,
+    VertexId maxVertexId,
+    MemoryMapped::Vector<VertexId>& newVertexId)
 {
     const bool debug = false;
 
@@ -361,26 +384,37 @@ MarkerGraph::VertexId MarkerGraph::renumberVertexTable(size_t threadCount, Verte
 
     // Now we know what VertexId's are present, so we can compute the new VertexId
     // corresponding to each old VertexId.
-    renumberVertexTableData.newVertexId.createNew(
+    // This is done in parallel using prefix sums over blocks of old VertexId's:
+    // count the VertexId's present in each block, compute the
+    // prefix sums of the block counts (the number of blocks is small),
+    // then assign new VertexId's independently in each block.
+    newVertexId.createNew(
         vertexTableName.empty() ? "" : (vertexTableName + "-tmp-newVertexId"),
         vertexTable.getPageSize());
-    renumberVertexTableData.newVertexId.resize(maxVertexId + 1);
-    VertexId newVertexId = 0;
-    for(VertexId oldVertexId=0; oldVertexId<=maxVertexId; oldVertexId++) {
-        if(renumberVertexTableData.isPresent[oldVertexId]) {
-            renumberVertexTableData.newVertexId[oldVertexId] = newVertexId;
-            ++newVertexId;
-        } else {
-            renumberVertexTableData.newVertexId[oldVertexId] = invalidVertexId;
-        }
+    newVertexId.resize(maxVertexId + 1);
+    renumberVertexTableData.newVertexIdPointer = &newVertexId;
+    renumberVertexTableData.blockSize = batchSize;
+    const uint64_t blockCount = maxVertexId / batchSize + 1;
+    renumberVertexTableData.blockBegin.resize(blockCount + 1);
+    setupLoadBalancing(maxVertexId + 1, batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction3, threadCount);
+    VertexId newVertexCount = 0;
+    for(uint64_t blockId=0; blockId<blockCount; blockId++) {
+        const VertexId blockPresentCount = renumberVertexTableData.blockBegin[blockId];
+        renumberVertexTableData.blockBegin[blockId] = newVertexCount;
+        newVertexCount += blockPresentCount;
     }
+    renumberVertexTableData.blockBegin[blockCount] = newVertexCount;
+    setupLoadBalancing(maxVertexId + 1, batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction4, threadCount);
 
     // Now we can renumber the vertex table.
     setupLoadBalancing(vertexTable.size(), batchSize);
     runThreads(&MarkerGraph::renumberVertexTableThreadFunction2, threadCount);
 
     // Clean up.
-    renumberVertexTableData.newVertexId.remove();
+    renumberVertexTableData.newVertexIdPointer = 0;
+    renumberVertexTableData.blockBegin.clear();
     renumberVertexTableData.isPresent.remove();
 
     if(debug) {
@@ -392,7 +426,7 @@ MarkerGraph::VertexId MarkerGraph::renumberVertexTable(size_t threadCount, Verte
     }
 
     cout << timestamp << "Done renumbering the marker graph vertex table." << endl;
-    return newVertexId - 1;
+    return newVertexCount - 1;
 }
 
 
@@ -428,7 +462,7 @@ void MarkerGraph::renumberVertexTableThreadFunction2(size_t threadId)
             const CompressedVertexId compressedVertexId = vertexTable[markerId];
             if(compressedVertexId != invalidCompressedVertexId) {
                 const VertexId oldVertexId = VertexId(compressedVertexId);
-                const VertexId newVertexId = renumberVertexTableData.newVertexId[oldVertexId];
+                const VertexId newVertexId = (*renumberVertexTableData.newVertexIdPointer)[oldVertexId];
                 vertexTable[markerId] = CompressedVertexId(newVertexId);
             }
         }
@@ -437,6 +471,195 @@ void MarkerGraph::renumberVertexTableThreadFunction2(size_t threadId)
 
 
 
+// Count the VertexId's present in each block of old VertexId's.
+void MarkerGraph::renumberVertexTableThreadFunction3(size_t threadId)
+{
+    const uint64_t blockSize = renumberVertexTableData.blockSize;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        VertexId presentCount = 0;
+        for(VertexId oldVertexId=begin; oldVertexId!=end; oldVertexId++) {
+            presentCount += renumberVertexTableData.isPresent[oldVertexId];
+        }
+        renumberVertexTableData.blockBegin[begin / blockSize] = presentCount;
+    }
+}
+
+
+
+// Assign new VertexId's in each block of old VertexId's,
+// starting at the prefix sum computed for the block.
+void MarkerGraph::renumberVertexTableThreadFunction4(size_t threadId)
+{
+    MemoryMapped::Vector<VertexId>& newVertexId = *renumberVertexTableData.newVertexIdPointer;
+    const uint64_t blockSize = renumberVertexTableData.blockSize;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        VertexId nextNewVertexId = renumberVertexTableData.blockBegin[begin / blockSize];
+        for(VertexId oldVertexId=begin; oldVertexId!=end; oldVertexId++) {
+            if(renumberVertexTableData.isPresent[oldVertexId]) {
+                newVertexId[oldVertexId] = nextNewVertexId++;
+            } else {
+                newVertexId[oldVertexId] = invalidVertexId;
+            }
+        }
+    }
+}
+
+
+
+// Renumber the vertex table so vertices are numbered in order of their lowest MarkerId.
+// The new VertexId's are assigned in parallel using prefix sums
+// over blocks of MarkerIds: a block contains one new VertexId
+// for each of its markers that is the lowest marker of its vertex.
+void MarkerGraph::renumberVertexTableInMarkerOrder(
+    size_t threadCount,
+    VertexId maxVertexId,
+    MemoryMapped::Vector<VertexId>& newVertexId)
+{
+    // Sanity check.
+    SHASTA_ASSERT(threadCount > 0);
+    SHASTA_ASSERT(vertexTable.isOpen);
+    SHASTA_ASSERT(vertexTable.size() > 0);
+
+    cout << timestamp << "Renumbering the marker graph vertex table in marker order." << endl;
+
+    // Find the lowest MarkerId of each vertex.
+    const string vertexTableName = vertexTable.fileName;
+    auto& firstMarkerId = renumberVertexTableData.firstMarkerId;
+    firstMarkerId.createNew(
+        vertexTableName.empty() ? "" : (vertexTableName + "-tmp-firstMarkerId"),
+        vertexTable.getPageSize());
+    firstMarkerId.resize(maxVertexId + 1);
+    fill(firstMarkerId.begin(), firstMarkerId.end(), std::numeric_limits<MarkerId>::max());
+    const uint64_t batchSize = 100000;
+    setupLoadBalancing(vertexTable.size(), batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction5, threadCount);
+
+    // Count the vertices that have their lowest marker in each block of markers,
+    // then compute the prefix sums of the block counts.
+    if(not newVertexId.isOpen) {
+        newVertexId.createNew(
+            vertexTableName.empty() ? "" : (vertexTableName + "-tmp-newVertexId"),
+            vertexTable.getPageSize());
+    }
+    newVertexId.resize(maxVertexId + 1);
+    renumberVertexTableData.newVertexIdPointer = &newVertexId;
+    renumberVertexTableData.blockSize = batchSize;
+    const uint64_t blockCount = (vertexTable.size() - 1) / batchSize + 1;
+    renumberVertexTableData.blockBegin.resize(blockCount + 1);
+    setupLoadBalancing(vertexTable.size(), batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction6, threadCount);
+    VertexId newVertexCount = 0;
+    for(uint64_t blockId=0; blockId<blockCount; blockId++) {
+        const VertexId blockVertexCount = renumberVertexTableData.blockBegin[blockId];
+        renumberVertexTableData.blockBegin[blockId] = newVertexCount;
+        newVertexCount += blockVertexCount;
+    }
+    renumberVertexTableData.blockBegin[blockCount] = newVertexCount;
+    SHASTA_ASSERT(newVertexCount == maxVertexId + 1);
+
+    // Assign the new VertexId's.
+    setupLoadBalancing(vertexTable.size(), batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction7, threadCount);
+
+    // Now we can renumber the vertex table.
+    setupLoadBalancing(vertexTable.size(), batchSize);
+    runThreads(&MarkerGraph::renumberVertexTableThreadFunction2, threadCount);
+
+    // Clean up.
+    renumberVertexTableData.newVertexIdPointer = 0;
+    renumberVertexTableData.blockBegin.clear();
+    firstMarkerId.remove();
+
+    cout << timestamp << "Done renumbering the marker graph vertex table in marker order." << endl;
+}
+
+
+
+// Find the lowest MarkerId of each vertex.
+void MarkerGraph::renumberVertexTableThreadFunction5(size_t threadId)
+{
+    MarkerId* firstMarkerId = renumberVertexTableData.firstMarkerId.begin();
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(MarkerId markerId=begin; markerId!=end; markerId++) {
+            const CompressedVertexId compressedVertexId = vertexTable[markerId];
+            if(compressedVertexId == invalidCompressedVertexId) {
+                continue;
+            }
+            MarkerId& m = firstMarkerId[VertexId(compressedVertexId)];
+            MarkerId oldValue = m;
+            while(markerId < oldValue) {
+                const MarkerId value = __sync_val_compare_and_swap(&m, oldValue, markerId);
+                if(value == oldValue) {
+                    break;
+                }
+                oldValue = value;
+            }
+        }
+    }
+}
+
+
+
+// Count the markers in each block of markers that are
+// the lowest marker of their vertex.
+void MarkerGraph::renumberVertexTableThreadFunction6(size_t threadId)
+{
+    const uint64_t blockSize = renumberVertexTableData.blockSize;
+    const auto& firstMarkerId = renumberVertexTableData.firstMarkerId;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        VertexId count = 0;
+        for(MarkerId markerId=begin; markerId!=end; markerId++) {
+            const CompressedVertexId compressedVertexId = vertexTable[markerId];
+            if(compressedVertexId != invalidCompressedVertexId and
+                firstMarkerId[VertexId(compressedVertexId)] == markerId) {
+                ++count;
+            }
+        }
+        renumberVertexTableData.blockBegin[begin / blockSize] = count;
+    }
+}
+
+
+
+// Assign new VertexId's in each block of markers,
+// starting at the prefix sum computed for the block.
+void MarkerGraph::renumberVertexTableThreadFunction7(size_t threadId)
+{
+    MemoryMapped::Vector<VertexId>& newVertexId = *renumberVertexTableData.newVertexIdPointer;
+    const uint64_t blockSize = renumberVertexTableData.blockSize;
+    const auto& firstMarkerId = renumberVertexTableData.firstMarkerId;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        VertexId nextNewVertexId = renumberVertexTableData.blockBegin[begin / blockSize];
+        for(MarkerId markerId=begin; markerId!=end; markerId++) {
+            const CompressedVertexId compressedVertexId = vertexTable[markerId];
+            if(compressedVertexId == invalidCompressedVertexId) {
+                continue;
+            }
+            const VertexId oldVertexId = VertexId(compressedVertexId);
+            if(firstMarkerId[oldVertexId] == markerId) {
+                newVertexId[oldVertexId] = nextNewVertexId++;
+            }
+        }
+    }
+}
+
+
+
 MarkerGraph::VertexId MarkerGraph::findMaxVertexTableEntry(size_t threadCount)
 {
     // Sanity checks.
@@ -744,6 +967,100 @@ bool MarkerGraph::edgeHasDuplicateOrientedReadIds(EdgeId edgeId) const
 
 
 
+// Create the inverted index containing the OrientedReadIds of each edge.
+// The MarkerIntervals of each edge are sorted by OrientedReadId,
+// so we only have to remove duplicates.
+void MarkerGraph::createEdgeOrientedReadIds(
+    const string& name,
+    uint64_t pageSize,
+    size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const uint64_t edgeCount = edgeMarkerIntervals.size();
+    edgeOrientedReadIds.createNew(name, pageSize);
+
+    // Pass 1: count the distinct OrientedReadIds of each edge.
+    edgeOrientedReadIds.beginPass1(edgeCount);
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(edgeCount, batchSize);
+    runThreads(&MarkerGraph::createEdgeOrientedReadIdsThreadFunction1, threadCount);
+
+    // Pass 2: store them.
+    edgeOrientedReadIds.beginPass2();
+    edgeOrientedReadIds.endPass2(false);
+    setupLoadBalancing(edgeCount, batchSize);
+    runThreads(&MarkerGraph::createEdgeOrientedReadIdsThreadFunction2, threadCount);
+}
+
+
+
+void MarkerGraph::createEdgeOrientedReadIdsThreadFunction1(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            const auto markerIntervals = edgeMarkerIntervals[edgeId];
+            uint64_t n = 0;
+            for(uint64_t i=0; i<markerIntervals.size(); i++) {
+                if(i == 0 or markerIntervals[i].orientedReadId != markerIntervals[i-1].orientedReadId) {
+                    SHASTA_ASSERT(i == 0 or markerIntervals[i-1].orientedReadId < markerIntervals[i].orientedReadId);
+                    ++n;
+                }
+            }
+            edgeOrientedReadIds.incrementCount(edgeId, n);
+        }
+    }
+}
+
+
+
+void MarkerGraph::createEdgeOrientedReadIdsThreadFunction2(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            const auto markerIntervals = edgeMarkerIntervals[edgeId];
+            const span<OrientedReadId> orientedReadIds = edgeOrientedReadIds[edgeId];
+            uint64_t n = 0;
+            for(uint64_t i=0; i<markerIntervals.size(); i++) {
+                if(i == 0 or markerIntervals[i].orientedReadId != markerIntervals[i-1].orientedReadId) {
+                    orientedReadIds[n++] = markerIntervals[i].orientedReadId;
+                }
+            }
+            SHASTA_ASSERT(n == orientedReadIds.size());
+        }
+    }
+}
+
+
+
+// Append to a vector the OrientedReadIds of an edge,
+// using edgeOrientedReadIds if available.
+void MarkerGraph::appendEdgeOrientedReadIds(
+    EdgeId edgeId,
+    vector<OrientedReadId>& orientedReadIds) const
+{
+    if(edgeOrientedReadIds.isOpen()) {
+        const span<const OrientedReadId> edgeOrientedReadIdsSpan = edgeOrientedReadIds[edgeId];
+        orientedReadIds.insert(orientedReadIds.end(),
+            edgeOrientedReadIdsSpan.begin(), edgeOrientedReadIdsSpan.end());
+    } else {
+        const auto markerIntervals = edgeMarkerIntervals[edgeId];
+        for(uint64_t i=0; i<markerIntervals.size(); i++) {
+            const OrientedReadId orientedReadId = markerIntervals[i].orientedReadId;
+            if(i == 0 or orientedReadId != markerIntervals[i-1].orientedReadId) {
+                orientedReadIds.push_back(orientedReadId);
+            }
+        }
+    }
+}
+
+
+
 // Find out if a vertex has more than one marker on the same oriented read.
 bool MarkerGraph::vertexHasDuplicateOrientedReadIds(
     VertexId vertexId,
@@ -1,6 +1,7 @@
 #ifndef SHASTA_MARKER_GRAPH_HPP
 #define SHASTA_MARKER_GRAPH_HPP
 
+#include "CoverageDataStore.hpp"
 #include "MarkerInterval.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
@@ -105,19 +106,57 @@ public:
     // are inconsistent and need to be recreated.
     // The second version can be called if the maximum vertex id
     // present in the vertex table is already known, and is faster.
+    // The third version also returns the new VertexId corresponding
+    // to each old VertexId, or invalidVertexId for VertexId's not present.
+    // The caller owns newVertexId and must remove it when done.
     // Returns the maximmum vertex id after renumbering.
     VertexId renumberVertexTable(size_t threadCount);
     VertexId renumberVertexTable(size_t threadCount, VertexId maxVertexId);
+    VertexId renumberVertexTable(
+        size_t threadCount,
+        VertexId maxVertexId,
+        MemoryMapped::Vector<VertexId>& newVertexId);
+
+    // Same as the third version of renumberVertexTable, but the vertices
+    // are renumbered in order of their lowest MarkerId.
+    // Because MarkerIds are ordered by OrientedReadId and then by ordinal,
+    // this is the order in which the vertices are first encountered when
+    // walking the marker paths of all oriented reads in order.
+    // Consecutive markers of an oriented read are normally in adjacent
+    // vertices, so this approximates a bandwidth-reducing numbering
+    // (like Reverse Cuthill-McKee) of the marker graph.
+    // This requires the valid VertexId's in the vertex table to be
+    // numbered contiguously starting at 0, so the maximum vertex id
+    // does not change.
+    void renumberVertexTableInMarkerOrder(
+        size_t threadCount,
+        VertexId maxVertexId,
+        MemoryMapped::Vector<VertexId>& newVertexId);
 private:
     void renumberVertexTableThreadFunction1(size_t threadId);
     void renumberVertexTableThreadFunction2(size_t threadId);
+    void renumberVertexTableThreadFunction3(size_t threadId);
+    void renumberVertexTableThreadFunction4(size_t threadId);
+    void renumberVertexTableThreadFunction5(size_t threadId);
+    void renumberVertexTableThreadFunction6(size_t threadId);
+    void renumberVertexTableThreadFunction7(size_t threadId);
     class RenumberVertexTableData {
     public:
         // Set to true for VertexId values represented in the starting vertexTable.
         MemoryMapped::Vector<bool> isPresent;
 
         // The new VertexId corresponding to each old VertexId.
-        MemoryMapped::Vector<VertexId> newVertexId;
+        MemoryMapped::Vector<VertexId>* newVertexIdPointer = 0;
+
+        // The new VertexId's are computed in parallel using prefix sums
+        // over blocks of blockSize old VertexId's.
+        // blockBegin[blockId] is the first new VertexId assigned in each block.
+        uint64_t blockSize;
+        vector<VertexId> blockBegin;
+
+        // Used by renumberVertexTableInMarkerOrder:
+        // the lowest MarkerId of each old VertexId.
+        MemoryMapped::Vector<MarkerId> firstMarkerId;
     };
     RenumberVertexTableData renumberVertexTableData;
 
@@ -299,6 +338,26 @@ public:
     // in its MarkerIntervals.
     bool edgeHasDuplicateOrientedReadIds(EdgeId) const;
 
+    // Optional inverted index containing, for each edge,
+    // the sorted and deduplicated OrientedReadIds of its MarkerIntervals.
+    // This is more compact than edgeMarkerIntervals and can be used
+    // when only the OrientedReadIds are needed,
+    // for example to intersect the sets of oriented reads of two edges.
+    MemoryMapped::VectorOfVectors<OrientedReadId, uint64_t> edgeOrientedReadIds;
+    void createEdgeOrientedReadIds(
+        const string& name,
+        uint64_t pageSize,
+        size_t threadCount);
+private:
+    void createEdgeOrientedReadIdsThreadFunction1(size_t threadId);
+    void createEdgeOrientedReadIdsThreadFunction2(size_t threadId);
+public:
+
+    // Append to a vector the OrientedReadIds of an edge,
+    // using edgeOrientedReadIds if available.
+    // The OrientedReadIds are appended in increasing order, without duplicates.
+    void appendEdgeOrientedReadIds(EdgeId, vector<OrientedReadId>&) const;
+
     // The reverse complement of each edge.
     // Indexed by EdgeId.
     MemoryMapped::Vector<EdgeId> reverseComplementEdge;
@@ -349,19 +408,17 @@ public:
     // They can be used to calibrate the Bayesian model for repeat counts
     // and for some types of analyses.
     // Indeed by VertexId. For each vertex, contains pairs (position, CompressedCoverageData),
-    // ordered by position.
+    // ordered by position, compressed as described in CoverageDataStore.hpp.
     // Note that the bases at a given position are all identical by construction.
-    MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t>
-        vertexCoverageData;
+    CoverageDataStore vertexCoverageData;
 
     // Details of edge coverage.
     // These are not stored by default.
     // They can be used to calibrate the Bayesian model for repeat counts
     // and for some types of analyses.
     // Indeed by EdgeId. For each edge, contains pairs (position, CompressedCoverageData),
-    // ordered by position.
-    MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t>
-        edgeCoverageData;
+    // ordered by position, compressed as described in CoverageDataStore.hpp.
+    CoverageDataStore edgeCoverageData;
 
 
 
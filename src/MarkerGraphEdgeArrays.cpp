@@ -0,0 +1,138 @@
+// Shasta.
+#include "MarkerGraphEdgeArrays.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <bit>
+
+
+
+MarkerGraphEdgeArrays::MarkerGraphEdgeArrays(
+    MarkerGraph& markerGraph,
+    bool storeTargets) :
+    markerGraph(markerGraph),
+    edgeCount(markerGraph.edges.size())
+{
+    const uint64_t wordCount = (edgeCount + 63) / 64;
+    for(auto& v: bits) {
+        v.resize(wordCount, 0);
+    }
+    wasRemovedBits.resize(wordCount, 0);
+    if(storeTargets) {
+        targets.resize(edgeCount);
+    }
+
+    // Gather the information one word (64 edges) at a time.
+    for(uint64_t wordIndex=0; wordIndex<wordCount; wordIndex++) {
+        const EdgeId begin = 64 * wordIndex;
+        const EdgeId end = min(begin + 64, edgeCount);
+        array<uint64_t, flagCount> words;
+        words.fill(0);
+        uint64_t wasRemovedWord = 0;
+        for(EdgeId edgeId=begin; edgeId!=end; edgeId++) {
+            const MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
+            const uint64_t mask = uint64_t(1) << (edgeId - begin);
+            for(uint64_t i=0; i<flagCount; i++) {
+                if(getEdgeFlag(edge, Flag(i))) {
+                    words[i] |= mask;
+                }
+            }
+            if(edge.wasRemoved()) {
+                wasRemovedWord |= mask;
+            }
+            if(storeTargets) {
+                targets[edgeId] = edge.target;
+            }
+        }
+        for(uint64_t i=0; i<flagCount; i++) {
+            bits[i][wordIndex] = words[i];
+        }
+        wasRemovedBits[wordIndex] = wasRemovedWord;
+    }
+}
+
+
+
+void MarkerGraphEdgeArrays::setFlag(Flag flag, EdgeId edgeId, bool value)
+{
+    SHASTA_ASSERT(edgeId < edgeCount);
+    MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
+    setEdgeFlag(edge, flag, value);
+    setBit(bits[uint64_t(flag)], edgeId, value);
+    setBit(wasRemovedBits, edgeId, edge.wasRemoved());
+}
+
+
+
+uint64_t MarkerGraphEdgeArrays::countFlag(Flag flag) const
+{
+    return countBits(bits[uint64_t(flag)]);
+}
+
+
+
+uint64_t MarkerGraphEdgeArrays::countRemoved() const
+{
+    return countBits(wasRemovedBits);
+}
+
+
+
+uint64_t MarkerGraphEdgeArrays::countBits(const vector<uint64_t>& v)
+{
+    uint64_t n = 0;
+    for(const uint64_t word: v) {
+        n += std::popcount(word);
+    }
+    return n;
+}
+
+
+
+bool MarkerGraphEdgeArrays::getEdgeFlag(const MarkerGraph::Edge& edge, Flag flag)
+{
+    switch(flag) {
+    case Flag::wasRemovedByTransitiveReduction:
+        return edge.wasRemovedByTransitiveReduction;
+    case Flag::wasPruned:
+        return edge.wasPruned;
+    case Flag::isSuperBubbleEdge:
+        return edge.isSuperBubbleEdge;
+    case Flag::isLowCoverageCrossEdge:
+        return edge.isLowCoverageCrossEdge;
+    case Flag::wasAssembled:
+        return edge.wasAssembled;
+    case Flag::wasRemovedWhileSplittingSecondaryEdges:
+        return edge.wasRemovedWhileSplittingSecondaryEdges;
+    }
+    SHASTA_ASSERT(0);
+}
+
+
+
+void MarkerGraphEdgeArrays::setEdgeFlag(MarkerGraph::Edge& edge, Flag flag, bool value)
+{
+    switch(flag) {
+    case Flag::wasRemovedByTransitiveReduction:
+        edge.wasRemovedByTransitiveReduction = value ? 1 : 0;
+        return;
+    case Flag::wasPruned:
+        edge.wasPruned = value ? 1 : 0;
+        return;
+    case Flag::isSuperBubbleEdge:
+        edge.isSuperBubbleEdge = value ? 1 : 0;
+        return;
+    case Flag::isLowCoverageCrossEdge:
+        edge.isLowCoverageCrossEdge = value ? 1 : 0;
+        return;
+    case Flag::wasAssembled:
+        edge.wasAssembled = value ? 1 : 0;
+        return;
+    case Flag::wasRemovedWhileSplittingSecondaryEdges:
+        edge.wasRemovedWhileSplittingSecondaryEdges = value ? 1 : 0;
+        return;
+    }
+    SHASTA_ASSERT(0);
+}
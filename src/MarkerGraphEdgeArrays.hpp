@@ -0,0 +1,116 @@
+#ifndef SHASTA_MARKER_GRAPH_EDGE_ARRAYS_HPP
+#define SHASTA_MARKER_GRAPH_EDGE_ARRAYS_HPP
+
+/*******************************************************************************
+
+Class MarkerGraphEdgeArrays is a structure-of-arrays copy of the
+marker graph edges, for passes that only use one or two fields of each edge.
+
+MarkerGraph::Edge packs the source, the target, and all the flags
+of an edge together, so a scan of a single flag reads entire edges.
+Here, each flag is stored in a separate bitset, and the targets
+are optionally stored in a separate array. A scan of a flag only reads
+one bit per edge, and counting the edges with a given flag set
+is done 64 edges at a time.
+
+The arrays are a snapshot of MarkerGraph::edges at the time of creation,
+and are not automatically kept in sync with it.
+setFlag changes a flag in both places at once.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MarkerGraph.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class MarkerGraphEdgeArrays;
+}
+
+
+
+class shasta::MarkerGraphEdgeArrays {
+public:
+    using EdgeId = MarkerGraph::EdgeId;
+    using VertexId = MarkerGraph::VertexId;
+
+    // The flags of MarkerGraph::Edge stored in bitsets.
+    enum class Flag {
+        wasRemovedByTransitiveReduction,
+        wasPruned,
+        isSuperBubbleEdge,
+        isLowCoverageCrossEdge,
+        wasAssembled,
+        wasRemovedWhileSplittingSecondaryEdges
+    };
+    static const uint64_t flagCount = 6;
+
+    // If storeTargets is false, target cannot be used.
+    MarkerGraphEdgeArrays(MarkerGraph&, bool storeTargets);
+
+    uint64_t size() const
+    {
+        return edgeCount;
+    }
+
+    bool getFlag(Flag flag, EdgeId edgeId) const
+    {
+        return getBit(bits[uint64_t(flag)], edgeId);
+    }
+
+    // Same as MarkerGraph::Edge::wasRemoved.
+    bool wasRemoved(EdgeId edgeId) const
+    {
+        return getBit(wasRemovedBits, edgeId);
+    }
+
+    VertexId target(EdgeId edgeId) const
+    {
+        return targets[edgeId];
+    }
+
+    // Set or clear a flag, both here and in MarkerGraph::edges.
+    void setFlag(Flag, EdgeId, bool value);
+
+    // Return the number of edges with a given flag set.
+    uint64_t countFlag(Flag) const;
+
+    // Return the number of edges for which wasRemoved() is true.
+    uint64_t countRemoved() const;
+
+private:
+    MarkerGraph& markerGraph;
+    uint64_t edgeCount;
+
+    // One bitset for each flag, plus one for wasRemoved().
+    // Bit i of word j corresponds to EdgeId 64*j+i.
+    array<vector<uint64_t>, flagCount> bits;
+    vector<uint64_t> wasRemovedBits;
+
+    vector<MarkerGraph::CompressedVertexId> targets;
+
+    static bool getBit(const vector<uint64_t>& v, EdgeId edgeId)
+    {
+        return (v[edgeId >> 6] >> (edgeId & 63)) & 1;
+    }
+    static void setBit(vector<uint64_t>& v, EdgeId edgeId, bool value)
+    {
+        const uint64_t mask = uint64_t(1) << (edgeId & 63);
+        if(value) {
+            v[edgeId >> 6] |= mask;
+        } else {
+            v[edgeId >> 6] &= ~mask;
+        }
+    }
+    static uint64_t countBits(const vector<uint64_t>&);
+
+    // Access a flag in a MarkerGraph::Edge.
+    static bool getEdgeFlag(const MarkerGraph::Edge&, Flag);
+    static void setEdgeFlag(MarkerGraph::Edge&, Flag, bool value);
+};
+
+#endif
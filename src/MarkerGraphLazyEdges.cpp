@@ -0,0 +1,198 @@
+// Shasta.
+#include "MarkerGraphLazyEdges.hpp"
+#include "findMarkerId.hpp"
+#include "MarkerGraph.hpp"
+#include "Reads.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "tuple.hpp"
+#include "utility.hpp"
+
+
+
+MarkerGraphLazyEdges::MarkerGraphLazyEdges(
+    const MarkerGraph& markerGraph,
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    const Reads& reads,
+    uint64_t k,
+    uint64_t shardCount) :
+    markerGraph(markerGraph),
+    markers(markers),
+    reads(reads),
+    k(k)
+{
+    SHASTA_ASSERT(shardCount > 0);
+    shards.resize(shardCount);
+    for(auto& shard: shards) {
+        shard = make_unique<Shard>();
+    }
+}
+
+
+
+shared_ptr<const MarkerGraphLazyEdges::Edges>
+    MarkerGraphLazyEdges::getOutgoingEdges(MarkerGraphVertexId vertexId) const
+{
+    return getEdges(vertexId, 0);
+}
+shared_ptr<const MarkerGraphLazyEdges::Edges>
+    MarkerGraphLazyEdges::getIncomingEdges(MarkerGraphVertexId vertexId) const
+{
+    return getEdges(vertexId, 1);
+}
+
+
+
+shared_ptr<const MarkerGraphLazyEdges::Edges> MarkerGraphLazyEdges::getEdges(
+    MarkerGraphVertexId vertexId,
+    uint64_t direction) const
+{
+    Shard& shard = *shards[vertexId % shards.size()];
+
+    // If we already have them, just return them.
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto& cache = (direction == 0) ? shard.outgoingEdges : shard.incomingEdges;
+        const auto it = cache.find(vertexId);
+        if(it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    // Compute them without holding the lock, then store them.
+    // If another thread stored them in the meantime, keep the ones already stored.
+    const shared_ptr<const Edges> edges = computeEdges(vertexId, direction);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& cache = (direction == 0) ? shard.outgoingEdges : shard.incomingEdges;
+    return cache.insert(make_pair(vertexId, edges)).first->second;
+}
+
+
+
+shared_ptr<const MarkerGraphLazyEdges::Edges> MarkerGraphLazyEdges::computeEdges(
+    MarkerGraphVertexId vertexId,
+    uint64_t direction) const
+{
+    SHASTA_ASSERT(direction < 2);
+
+    // Follow each oriented read from each marker of this vertex
+    // to the next (direction 0) or previous (direction 1) marker that belongs to a vertex.
+    // Store pairs (other vertex, marker interval).
+    vector< pair<MarkerGraphVertexId, MarkerInterval> > markerIntervals;
+    for(const MarkerId markerId: markerGraph.getVertexMarkerIds(vertexId)) {
+        OrientedReadId orientedReadId;
+        uint32_t ordinal;
+        tie(orientedReadId, ordinal) = findMarkerId(markerId, markers);
+        const MarkerId firstMarkerId = markers.begin(orientedReadId.getValue()) - markers.begin();
+        const uint32_t markerCount = uint32_t(markers.size(orientedReadId.getValue()));
+
+        if(direction == 0) {
+            for(uint32_t ordinal1=ordinal+1; ordinal1<markerCount; ordinal1++) {
+                const MarkerGraph::CompressedVertexId vertexId1 = markerGraph.vertexTable[firstMarkerId + ordinal1];
+                if(vertexId1 != MarkerGraph::invalidCompressedVertexId) {
+                    markerIntervals.push_back(make_pair(
+                        MarkerGraphVertexId(vertexId1), MarkerInterval(orientedReadId, ordinal, ordinal1)));
+                    break;
+                }
+            }
+        } else {
+            for(uint32_t ordinal0=ordinal; ordinal0>0; ordinal0--) {
+                const MarkerGraph::CompressedVertexId vertexId0 = markerGraph.vertexTable[firstMarkerId + ordinal0 - 1];
+                if(vertexId0 != MarkerGraph::invalidCompressedVertexId) {
+                    markerIntervals.push_back(make_pair(
+                        MarkerGraphVertexId(vertexId0), MarkerInterval(orientedReadId, ordinal0 - 1, ordinal)));
+                    break;
+                }
+            }
+        }
+    }
+    sort(markerIntervals.begin(), markerIntervals.end());
+
+
+
+    // Each streak with the same other vertex generates one or more parallel edges,
+    // one for each distinct sequence between the two markers.
+    // Store tuples (overlap, sequence, marker interval), as in createMarkerGraphEdgesStrictPass3.
+    const shared_ptr<Edges> edges = make_shared<Edges>();
+    vector< tuple<uint32_t, vector<Base>, MarkerInterval> > streak;
+    for(uint64_t i0=0; i0!=markerIntervals.size(); /* Incremented later */) {
+        const MarkerGraphVertexId otherVertexId = markerIntervals[i0].first;
+
+        // Find the end of the streak.
+        uint64_t i1 = i0;
+        while((i1 != markerIntervals.size()) and (markerIntervals[i1].first == otherVertexId)) {
+            ++i1;
+        }
+
+        // Find the overlap or the sequence in between for each marker interval in the streak.
+        streak.clear();
+        for(uint64_t i=i0; i!=i1; i++) {
+            const MarkerInterval& markerInterval = markerIntervals[i].second;
+            const OrientedReadId orientedReadId = markerInterval.orientedReadId;
+            const MarkerId firstMarkerId = markers.begin(orientedReadId.getValue()) - markers.begin();
+            const uint32_t position0 = uint32_t(markers.begin()[firstMarkerId + markerInterval.ordinals[0]].position);
+            const uint32_t position1 = uint32_t(markers.begin()[firstMarkerId + markerInterval.ordinals[1]].position);
+            uint32_t overlap = 0;
+            vector<Base> sequence;
+            if(position1 <= position0 + k) {
+                overlap = uint32_t((position0 + k) - position1);
+            } else {
+                for(uint32_t position=uint32_t(position0 + k); position<position1; position++) {
+                    sequence.push_back(reads.getOrientedReadBase(orientedReadId, position));
+                }
+            }
+            streak.push_back(make_tuple(overlap, sequence, markerInterval));
+        }
+        sort(streak.begin(), streak.end());
+
+        // Generate an edge for each distinct sequence.
+        for(uint64_t j0=0; j0!=streak.size(); /* Incremented later */) {
+            uint64_t j1 = j0;
+            while((j1 != streak.size()) and
+                (get<0>(streak[j1]) == get<0>(streak[j0])) and
+                (get<1>(streak[j1]) == get<1>(streak[j0]))) {
+                ++j1;
+            }
+
+            Edge edge;
+            edge.source = (direction == 0) ? vertexId : otherVertexId;
+            edge.target = (direction == 0) ? otherVertexId : vertexId;
+            for(uint64_t j=j0; j!=j1; j++) {
+                edge.markerIntervals.push_back(get<2>(streak[j]));
+            }
+            edges->push_back(edge);
+
+            j0 = j1;
+        }
+
+        i0 = i1;
+    }
+
+    return edges;
+}
+
+
+
+uint64_t MarkerGraphLazyEdges::cacheSize() const
+{
+    uint64_t count = 0;
+    for(const auto& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        count += shard->outgoingEdges.size() + shard->incomingEdges.size();
+    }
+    return count;
+}
+
+
+
+void MarkerGraphLazyEdges::clear()
+{
+    for(const auto& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->outgoingEdges.clear();
+        shard->incomingEdges.clear();
+    }
+}
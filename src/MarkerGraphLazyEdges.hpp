@@ -0,0 +1,109 @@
+#ifndef SHASTA_MARKER_GRAPH_LAZY_EDGES_HPP
+#define SHASTA_MARKER_GRAPH_LAZY_EDGES_HPP
+
+/*******************************************************************************
+
+Lazy, on-demand edges of the complete marker graph used in assembly mode 3.
+
+The edges out of (or into) a marker graph vertex are computed
+the first time they are requested, using only the vertex table
+and the markers, and then kept in a cache.
+This way, code that only looks at the neighborhood of a small
+number of vertices does not need edgesBySource and edgesByTarget.
+
+The edges are computed using the same criteria used by
+Assembler::createMarkerGraphEdgesStrict with no coverage thresholds:
+- Starting at each marker of the vertex, the oriented read is followed
+  to the next (or previous) marker that belongs to a vertex.
+- The resulting marker intervals are grouped by the vertex they reach.
+- Marker intervals between the same two vertices are further split into
+  parallel edges, so all the oriented reads on an edge have exactly
+  the same sequence between the two markers.
+The marker intervals of each edge are sorted by OrientedReadId,
+like in MarkerGraph::edgeMarkerIntervals.
+Because these edges are not materialized, they have no MarkerGraphEdgeId.
+
+The cache is divided in shards, each protected by its own mutex,
+so it can be used by many threads at the same time with little contention.
+Edges are computed outside the lock. If two threads compute
+the edges of the same vertex at the same time, the
+edges computed by the first one to finish are kept.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Marker.hpp"
+#include "MarkerInterval.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "shastaTypes.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "memory.hpp"
+#include <mutex>
+#include <unordered_map>
+#include "vector.hpp"
+
+namespace shasta {
+    class MarkerGraph;
+    class MarkerGraphLazyEdges;
+    class Reads;
+}
+
+
+
+class shasta::MarkerGraphLazyEdges {
+public:
+
+    MarkerGraphLazyEdges(
+        const MarkerGraph&,
+        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        const Reads&,
+        uint64_t k,
+        uint64_t shardCount = 256);
+
+    class Edge {
+    public:
+        MarkerGraphVertexId source;
+        MarkerGraphVertexId target;
+        vector<MarkerInterval> markerIntervals;
+
+        uint64_t coverage() const
+        {
+            return markerIntervals.size();
+        }
+    };
+    using Edges = vector<Edge>;
+
+    // Get the edges out of or into a vertex, computing them if necessary.
+    // The returned edges remain valid, even if clear is called.
+    shared_ptr<const Edges> getOutgoingEdges(MarkerGraphVertexId) const;
+    shared_ptr<const Edges> getIncomingEdges(MarkerGraphVertexId) const;
+
+    // Return the number of cache entries, counting outgoing and incoming
+    // edges of a vertex separately.
+    uint64_t cacheSize() const;
+
+    // Remove all cached edges.
+    void clear();
+
+private:
+    const MarkerGraph& markerGraph;
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    const Reads& reads;
+    uint64_t k;
+
+    class Shard {
+    public:
+        std::mutex mutex;
+        std::unordered_map<MarkerGraphVertexId, shared_ptr<const Edges> > outgoingEdges;
+        std::unordered_map<MarkerGraphVertexId, shared_ptr<const Edges> > incomingEdges;
+    };
+    vector< unique_ptr<Shard> > shards;
+
+    // Direction is 0 for outgoing edges and 1 for incoming edges.
+    shared_ptr<const Edges> getEdges(MarkerGraphVertexId, uint64_t direction) const;
+    shared_ptr<const Edges> computeEdges(MarkerGraphVertexId, uint64_t direction) const;
+};
+
+#endif
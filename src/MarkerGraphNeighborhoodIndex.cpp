@@ -0,0 +1,138 @@
+// Shasta.
+#include "MarkerGraphNeighborhoodIndex.hpp"
+#include "invalid.hpp"
+#include "MarkerGraph.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "iostream.hpp"
+#include <limits>
+
+// Explicit instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<MarkerGraphNeighborhoodIndex>;
+
+
+
+MarkerGraphNeighborhoodIndex::MarkerGraphNeighborhoodIndex(
+    const MarkerGraph& markerGraph,
+    uint64_t threadCount) :
+    MultithreadedObject(*this),
+    markerGraph(markerGraph)
+{
+    const uint64_t vertexCount = markerGraph.vertexCount();
+    cout << timestamp << "Creating the marker graph neighborhood index for " <<
+        vertexCount << " vertices." << endl;
+
+    vertexChain.resize(vertexCount, invalid<uint64_t>);
+    vertexPosition.resize(vertexCount);
+    chainVertices.reserve(vertexCount);
+    chainBegin.push_back(0);
+
+    // Create the chains that begin at a vertex without a chain predecessor.
+    for(MarkerGraphVertexId v=0; v<vertexCount; v++) {
+        if(not hasChainPredecessor(v)) {
+            addChain(v);
+        }
+    }
+
+    // The vertices not yet assigned are on cycles in which
+    // every vertex has a chain predecessor.
+    // Break each cycle at the first vertex we encounter.
+    for(MarkerGraphVertexId v=0; v<vertexCount; v++) {
+        if(vertexChain[v] == invalid<uint64_t>) {
+            addChain(v);
+        }
+    }
+    SHASTA_ASSERT(chainVertices.size() == vertexCount);
+
+    // Compute the coverage of each chain.
+    minVertexCoverage.resize(chainCount());
+    minEdgeCoverage.resize(chainCount());
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(chainCount(), batchSize);
+    runThreads(&MarkerGraphNeighborhoodIndex::computeCoverageThreadFunction, threadCount);
+
+    uint64_t maxLength = 0;
+    for(uint64_t chainId=0; chainId<chainCount(); chainId++) {
+        maxLength = max(maxLength, chainLength(chainId));
+    }
+    cout << timestamp << "The marker graph neighborhood index has " << chainCount() <<
+        " chains. Average number of vertices per chain " <<
+        double(vertexCount) / double(max(uint64_t(1), chainCount())) <<
+        ", maximum chain length " << maxLength << "." << endl;
+}
+
+
+
+bool MarkerGraphNeighborhoodIndex::hasChainPredecessor(MarkerGraphVertexId v) const
+{
+    const auto inEdges = markerGraph.edgesByTarget[v];
+    if(inEdges.size() != 1) {
+        return false;
+    }
+    const MarkerGraphVertexId u = markerGraph.edges[inEdges[0]].source;
+    return markerGraph.edgesBySource.size(u) == 1;
+}
+
+
+
+void MarkerGraphNeighborhoodIndex::addChain(MarkerGraphVertexId v0)
+{
+    const uint64_t chainId = chainCount();
+
+    MarkerGraphVertexId v = v0;
+    uint32_t position = 0;
+    while(true) {
+        SHASTA_ASSERT(vertexChain[v] == invalid<uint64_t>);
+        vertexChain[v] = chainId;
+        vertexPosition[v] = position++;
+        chainVertices.push_back(v);
+
+        // See if the chain continues.
+        const auto outEdges = markerGraph.edgesBySource[v];
+        if(outEdges.size() != 1) {
+            break;
+        }
+        const MarkerGraphVertexId next = markerGraph.edges[outEdges[0]].target;
+        if(markerGraph.edgesByTarget.size(next) != 1) {
+            break;
+        }
+        if(vertexChain[next] != invalid<uint64_t>) {
+            // We went around a cycle.
+            break;
+        }
+        v = next;
+    }
+
+    chainBegin.push_back(chainVertices.size());
+}
+
+
+
+void MarkerGraphNeighborhoodIndex::computeCoverageThreadFunction(uint64_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t chainId=begin; chainId!=end; chainId++) {
+            const uint64_t length = chainLength(chainId);
+
+            uint64_t minVertexCoverageThisChain = std::numeric_limits<uint32_t>::max();
+            uint64_t minEdgeCoverageThisChain = std::numeric_limits<uint32_t>::max();
+            for(uint64_t position=0; position<=length; position++) {
+                const MarkerGraphVertexId v = chainVertex(chainId, position);
+                minVertexCoverageThisChain = min(minVertexCoverageThisChain, markerGraph.vertexCoverage(v));
+                if(position < length) {
+                    const auto outEdges = markerGraph.edgesBySource[v];
+                    SHASTA_ASSERT(outEdges.size() == 1);
+                    minEdgeCoverageThisChain = min(minEdgeCoverageThisChain, markerGraph.edgeCoverage(outEdges[0]));
+                }
+            }
+            minVertexCoverage[chainId] = uint32_t(minVertexCoverageThisChain);
+            minEdgeCoverage[chainId] = uint32_t(minEdgeCoverageThisChain);
+        }
+    }
+}
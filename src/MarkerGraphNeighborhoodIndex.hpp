@@ -0,0 +1,108 @@
+#ifndef SHASTA_MARKER_GRAPH_NEIGHBORHOOD_INDEX_HPP
+#define SHASTA_MARKER_GRAPH_NEIGHBORHOOD_INDEX_HPP
+
+/*******************************************************************************
+
+Index used in explore mode to speed up the extraction of local marker graphs
+(the vertices within a given distance of a start vertex, see LocalMarkerGraph1).
+
+The vertices of the marker graph are partitioned into chains.
+A chain is a maximal sequence of vertices v0, v1, ..., vn such that,
+for 0 <= i < n, the only edge out of vi is vi->vi+1, and that edge
+is also the only edge into vi+1.
+A vertex that does not belong to any longer chain is a chain of length 0.
+
+As a result, the only edges connecting a chain to the rest
+of the marker graph are the edges into v0 and the edges out of vn.
+During a bounded distance search, a chain whose vertices and edges all
+satisfy the coverage thresholds can therefore be traversed in one step
+from one end to the other, without looking at its internal vertices and edges.
+The distances of the internal vertices are computed at the end
+from the distances of the chain ends.
+
+Most of the marker graph consists of long chains, so this
+greatly reduces the number of vertices and edges looked at
+when the distance is large.
+
+The index is created in memory when the http server starts.
+
+*******************************************************************************/
+
+// Shasta.
+#include "shastaTypes.hpp"
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class MarkerGraph;
+    class MarkerGraphNeighborhoodIndex;
+}
+
+
+
+class shasta::MarkerGraphNeighborhoodIndex :
+    public MultithreadedObject<MarkerGraphNeighborhoodIndex> {
+public:
+
+    MarkerGraphNeighborhoodIndex(const MarkerGraph&, uint64_t threadCount);
+
+    // The chain each vertex belongs to and its position in the chain.
+    vector<uint64_t> vertexChain;
+    vector<uint32_t> vertexPosition;
+
+    // The vertices of each chain, stored contiguously.
+    // The vertices of chain i are in
+    // chainVertices[chainBegin[i]] through chainVertices[chainBegin[i+1]-1].
+    vector<MarkerGraphVertexId> chainVertices;
+    vector<uint64_t> chainBegin;
+
+    // The minimum vertex coverage and edge coverage in each chain.
+    // For a chain of length 0, minEdgeCoverage is the maximum possible value.
+    vector<uint32_t> minVertexCoverage;
+    vector<uint32_t> minEdgeCoverage;
+
+    uint64_t chainCount() const
+    {
+        return chainBegin.size() - 1;
+    }
+
+    // Return the number of edges in a chain.
+    // The number of vertices is one more.
+    uint64_t chainLength(uint64_t chainId) const
+    {
+        return chainBegin[chainId + 1] - chainBegin[chainId] - 1;
+    }
+
+    MarkerGraphVertexId chainVertex(uint64_t chainId, uint64_t position) const
+    {
+        return chainVertices[chainBegin[chainId] + position];
+    }
+
+    // Return true if all vertices and edges of a chain satisfy the coverage thresholds.
+    bool isPassable(
+        uint64_t chainId,
+        uint64_t minVertexCoverageThreshold,
+        uint64_t minEdgeCoverageThreshold) const
+    {
+        return
+            minVertexCoverage[chainId] >= minVertexCoverageThreshold and
+            minEdgeCoverage[chainId] >= minEdgeCoverageThreshold;
+    }
+
+private:
+    const MarkerGraph& markerGraph;
+
+    // Return true if the only edge into v is also the only edge
+    // out of its source, so v cannot be the first vertex of a chain.
+    bool hasChainPredecessor(MarkerGraphVertexId) const;
+
+    // Add the chain that begins at v0.
+    void addChain(MarkerGraphVertexId v0);
+
+    void computeCoverageThreadFunction(uint64_t threadId);
+};
+
+#endif
@@ -0,0 +1,68 @@
+// Shasta.
+#include "MarkerKmerIds.hpp"
+#include "extractKmer.hpp"
+#include "Reads.hpp"
+using namespace shasta;
+
+
+
+MarkerKmerIds::MarkerKmerIds(
+    uint64_t k,
+    const Reads& reads,
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& storedKmerIds) :
+    k(k),
+    reads(reads),
+    markers(markers),
+    storedKmerIds(storedKmerIds)
+{
+    if(storedKmerIds.isOpen()) {
+        SHASTA_ASSERT(storedKmerIds.size() == markers.size());
+    }
+}
+
+
+
+span<const KmerId> MarkerKmerIds::get(
+    OrientedReadId orientedReadId,
+    vector<KmerId>& buffer) const
+{
+    if(storedKmerIds.isOpen()) {
+        const auto kmerIds = storedKmerIds[orientedReadId.getValue()];
+        return span<const KmerId>(kmerIds.begin(), kmerIds.end());
+    }
+
+    // The marker positions are always stored for strand 0.
+    const ReadId readId = orientedReadId.getReadId();
+    const Strand strand = orientedReadId.getStrand();
+    const auto read = reads.getRead(readId);
+    const auto orientedReadMarkers0 = markers[OrientedReadId(readId, 0).getValue()];
+    const uint64_t readMarkerCount = orientedReadMarkers0.size();
+    buffer.resize(readMarkerCount);
+
+    // Extract all the k-mers at once.
+    // The work vectors are reused by each thread to avoid memory allocation.
+    thread_local vector<uint64_t> positions;
+    thread_local vector<Kmer> kmers0;
+    positions.resize(readMarkerCount);
+    kmers0.resize(readMarkerCount);
+    for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
+        positions[ordinal0] = uint64_t(orientedReadMarkers0[ordinal0].position);
+    }
+    extractKmers(read,
+        span<const uint64_t>(positions.data(), readMarkerCount),
+        k,
+        span<Kmer>(kmers0.data(), readMarkerCount));
+
+    for(uint64_t ordinal0=0; ordinal0<readMarkerCount; ordinal0++) {
+        const Kmer& kmer0 = kmers0[ordinal0];
+        if(strand == 0) {
+            buffer[ordinal0] = KmerId(kmer0.id(k));
+        } else {
+            const Kmer kmer1 = kmer0.reverseComplement(k);
+            buffer[readMarkerCount - 1 - ordinal0] = KmerId(kmer1.id(k));
+        }
+    }
+
+    return buffer;
+}
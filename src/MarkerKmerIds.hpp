@@ -0,0 +1,73 @@
+#ifndef SHASTA_MARKER_KMER_IDS_HPP
+#define SHASTA_MARKER_KMER_IDS_HPP
+
+// Shasta.
+#include "Marker.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+
+// Standard library.
+#include "span.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class MarkerKmerIds;
+    class Reads;
+}
+
+
+
+// Class used to access the marker KmerIds of each oriented read.
+// If the marker KmerIds were stored by Assembler::computeMarkerKmerIds,
+// they are returned directly from storage.
+// Otherwise, they are recomputed on demand, one oriented read at a time,
+// from the read sequence and the marker positions,
+// into a buffer owned by the caller.
+// This avoids storing 8 bytes per marker on each strand
+// at the cost of additional computation.
+class shasta::MarkerKmerIds {
+public:
+
+    MarkerKmerIds(
+        uint64_t k,
+        const Reads&,
+        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& storedKmerIds);
+
+    // Return true if the marker KmerIds are available from storage.
+    bool isStored() const
+    {
+        return storedKmerIds.isOpen();
+    }
+
+    // The number of oriented reads.
+    uint64_t size() const
+    {
+        return markers.size();
+    }
+
+    // The number of markers of an oriented read.
+    uint64_t size(OrientedReadId orientedReadId) const
+    {
+        return markers.size(orientedReadId.getValue());
+    }
+
+    // The total number of markers, for all oriented reads.
+    uint64_t totalSize() const
+    {
+        return markers.totalSize();
+    }
+
+    // Return the marker KmerIds of an oriented read.
+    // If they have to be recomputed, they are stored in the buffer
+    // and the returned span points to it. The buffer should be reused
+    // across calls to avoid memory allocation.
+    span<const KmerId> get(OrientedReadId, vector<KmerId>& buffer) const;
+
+private:
+    uint64_t k;
+    const Reads& reads;
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    const MemoryMapped::VectorOfVectors<KmerId, uint64_t>& storedKmerIds;
+};
+
+#endif
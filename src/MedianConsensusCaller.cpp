@@ -57,6 +57,19 @@ Consensus MedianConsensusCaller::operator()(
 }
 
 
+// Compute consensus at many positions.
+// The qualified call is not virtual.
+void MedianConsensusCaller::callBatch(
+    span<const Coverage> coverages,
+    span<Consensus> consensus) const
+{
+    SHASTA_ASSERT(coverages.size() == consensus.size());
+    for(size_t i=0; i<coverages.size(); i++){
+        consensus[i] = MedianConsensusCaller::operator()(coverages[i]);
+    }
+}
+
+
 void testMedianConsensusCaller(){
     MedianConsensusCaller classifier;
     Coverage coverage;
@@ -0,0 +1,627 @@
+// Class to describe a compressed vector of vectors of integers
+// stored contiguously in mapped memory.
+// It is read-mostly: vectors can only be appended, not modified.
+
+// Each vector is split in blocks of up to blockSize elements.
+// For each block, the first element is stored as a variable length integer
+// (LEB128), and the differences between consecutive elements
+// are bit packed using the minimum number of bits for the block.
+// If all differences in a block are non-negative, they are stored as is,
+// which is the case for sorted vectors.
+// Otherwise they are stored zig-zag encoded.
+// Each non-empty vector begins with its number of elements,
+// also as a variable length integer.
+//
+// The table of contents (toc) contains the byte offset
+// of the encoded data of each vector.
+// The first 8 bytes of the encoded data store the total number of elements.
+//
+// T must be an integer type, or a type convertible to and from uint64_t
+// such as Uint40.
+
+#ifndef SHASTA_MEMORY_MAPPED_COMPRESSED_VECTOR_OF_VECTORS_HPP
+#define SHASTA_MEMORY_MAPPED_COMPRESSED_VECTOR_OF_VECTORS_HPP
+
+// Shasta.
+#include "MemoryMappedVectorOfVectors.hpp"
+
+// Standard libraries.
+#include <bit>
+#include <cstring>
+#include <iterator>
+
+// Forward declarations.
+namespace shasta {
+    namespace MemoryMapped {
+        template<class T, class Int> class CompressedVectorOfVectors;
+    }
+}
+
+
+
+template<class T, class Int> class shasta::MemoryMapped::CompressedVectorOfVectors {
+public:
+
+    // The maximum number of elements in each block.
+    static const uint64_t blockSize = 128;
+
+    void createNew(const string& nameArgument, size_t pageSize)
+    {
+        name = nameArgument;
+        if(name.empty()) {
+            // Propagate the name used in memory usage reports.
+            const string baseName = takeAnonymousName();
+            if(not baseName.empty()) {
+                MemoryMapped::anonymousName = baseName + ".toc";
+            }
+            toc.createNew("", pageSize);
+            if(not baseName.empty()) {
+                MemoryMapped::anonymousName = baseName + ".data";
+            }
+            data.createNew("", pageSize);
+        } else {
+            toc.createNew(name + ".toc", pageSize);
+            data.createNew(name + ".data", pageSize);
+        }
+        data.resize(headerSize + paddingSize);
+        std::fill(data.begin(), data.end(), uint8_t(0));
+        toc.push_back(headerSize);
+    }
+
+    void accessExisting(const string& nameArgument, bool readWriteAccess)
+    {
+        name = nameArgument;
+        toc.accessExisting(name + ".toc", readWriteAccess);
+        data.accessExisting(name + ".data", readWriteAccess);
+    }
+    void accessExistingReadOnly(const string& name)
+    {
+        accessExisting(name, false);
+    }
+    void accessExistingReadWrite(const string& name)
+    {
+        accessExisting(name, true);
+    }
+
+    void remove()
+    {
+        toc.remove();
+        data.remove();
+    }
+    void close()
+    {
+        toc.close();
+        data.close();
+    }
+    bool isOpen() const
+    {
+        return toc.isOpen and data.isOpen;
+    }
+
+    size_t size() const
+    {
+        return toc.size() - 1;
+    }
+    bool empty() const
+    {
+        return toc.size() == 1;
+    }
+    size_t totalSize() const
+    {
+        uint64_t n;
+        std::memcpy(&n, data.begin(), sizeof(n));
+        return n;
+    }
+
+    // The number of bytes used by the toc and the encoded data.
+    size_t byteSize() const
+    {
+        return toc.size() * sizeof(uint64_t) + data.size();
+    }
+
+    // The number of elements of the i-th vector.
+    size_t size(Int i) const
+    {
+        const uint64_t begin = toc[uint64_t(i)];
+        if(begin == toc[uint64_t(i) + 1]) {
+            return 0;
+        }
+        const uint8_t* p = data.begin() + begin;
+        return readVarint(p);
+    }
+
+    // Add a vector at the end.
+    template<class Iterator> void appendVector(Iterator begin, Iterator end)
+    {
+        const vector<uint64_t> v(begin, end);
+        const uint64_t oldEnd = toc.back();
+        const uint64_t newEnd = oldEnd + encodedSize(v.data(), v.size());
+        data.resize(newEnd + paddingSize);
+        std::fill(data.begin() + oldEnd, data.end(), uint8_t(0));
+        encode(v.data(), v.size(), data.begin() + oldEnd);
+        toc.push_back(newEnd);
+        setTotalSize(totalSize() + v.size());
+    }
+    void appendVector(const vector<T>& v)
+    {
+        appendVector(v.begin(), v.end());
+    }
+    void appendVector(span<const T> v)
+    {
+        appendVector(v.begin(), v.end());
+    }
+
+    // Create from an existing VectorOfVectors, using multiple threads.
+    // This must be empty.
+    void createFrom(const VectorOfVectors<T, Int>&);
+
+    // Decode the i-th vector.
+    // The output buffer must have room for size(i) elements.
+    void get(Int i, T* out) const;
+    void get(Int i, vector<T>& v) const
+    {
+        v.resize(size(i));
+        get(i, v.data());
+    }
+
+    // Decode the entire CompressedVectorOfVectors to a VectorOfVectors,
+    // using multiple threads. The VectorOfVectors must be open with write access.
+    void decompress(VectorOfVectors<T, Int>&) const;
+
+
+
+    // Operator[] returns a lightweight object that behaves
+    // like the span<const T> returned by VectorOfVectors::operator[],
+    // except that its iterators are forward iterators that decode on the fly.
+    // Use get to decode an entire vector at once, which is faster.
+    class Range;
+    Range operator[](Int i) const
+    {
+        const uint64_t begin = toc[uint64_t(i)];
+        if(begin == toc[uint64_t(i) + 1]) {
+            return Range(0, 0);
+        }
+        const uint8_t* p = data.begin() + begin;
+        const uint64_t n = readVarint(p);
+        return Range(p, n);
+    }
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        const_iterator() {}
+        T operator*() const
+        {
+            return T(value);
+        }
+        const_iterator& operator++()
+        {
+            --remaining;
+            if(remaining == 0) {
+                return *this;
+            }
+            if(blockRemaining == 0) {
+                beginBlock();
+            } else {
+                --blockRemaining;
+                const uint64_t delta = (width == 0) ? 0 : readBits(p, bitPosition, width);
+                bitPosition += width;
+                value += isZigZag ? zigZagDecode(delta) : delta;
+                if(blockRemaining == 0) {
+                    p += (bitPosition + 7) / 8;
+                }
+            }
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator it = *this;
+            ++(*this);
+            return it;
+        }
+        bool operator==(const const_iterator& that) const
+        {
+            return remaining == that.remaining;
+        }
+        bool operator!=(const const_iterator& that) const
+        {
+            return remaining != that.remaining;
+        }
+
+    private:
+        friend class Range;
+        const_iterator(const uint8_t* p, uint64_t n) : p(p), remaining(n)
+        {
+            if(remaining > 0) {
+                beginBlock();
+            }
+        }
+
+        // The next byte to be read. While in the packed differences
+        // of a block, this points to the beginning of the packed differences.
+        const uint8_t* p = 0;
+        uint64_t bitPosition = 0;
+
+        // The number of elements not yet visited, including the current one.
+        uint64_t remaining = 0;
+
+        // The number of differences not yet read in the current block.
+        uint64_t blockRemaining = 0;
+
+        uint64_t value = 0;
+        uint64_t width = 0;
+        bool isZigZag = false;
+
+        void beginBlock()
+        {
+            value = readVarint(p);
+            blockRemaining = std::min(remaining, blockSize) - 1;
+            bitPosition = 0;
+            if(blockRemaining > 0) {
+                decodeBlockHeader(*p++, width, isZigZag);
+            }
+        }
+    };
+
+    class Range {
+    public:
+        size_t size() const
+        {
+            return n;
+        }
+        bool empty() const
+        {
+            return n == 0;
+        }
+        const_iterator begin() const
+        {
+            return const_iterator(p, n);
+        }
+        const_iterator end() const
+        {
+            return const_iterator();
+        }
+
+        // Access an element. This skips the preceding blocks
+        // without decoding them, but must decode the preceding elements
+        // of the block containing the requested element.
+        T operator[](uint64_t j) const;
+        T front() const
+        {
+            return (*this)[0];
+        }
+        T back() const
+        {
+            return (*this)[n - 1];
+        }
+
+        // Decode all the elements. The output buffer must have room for size() elements.
+        void get(T* out) const
+        {
+            decodeVector(p, n, out);
+        }
+
+    private:
+        friend class CompressedVectorOfVectors<T, Int>;
+        Range(const uint8_t* p, uint64_t n) : p(p), n(n) {}
+
+        // Points to the first block.
+        const uint8_t* p;
+        uint64_t n;
+    };
+
+
+
+private:
+    string name;
+    Vector<uint64_t> toc;
+    Vector<uint8_t> data;
+
+    // The total number of elements is stored at the beginning of the data.
+    static const uint64_t headerSize = sizeof(uint64_t);
+    void setTotalSize(uint64_t n)
+    {
+        std::memcpy(data.begin(), &n, sizeof(n));
+    }
+
+    // The data is followed by padding, so readBits
+    // can always load 9 bytes.
+    static const uint64_t paddingSize = 16;
+
+    static_assert(std::endian::native == std::endian::little,
+        "CompressedVectorOfVectors requires a little endian architecture.");
+
+    // Variable length integers.
+    static uint64_t varintSize(uint64_t x)
+    {
+        return (uint64_t(std::bit_width(x | 1)) + 6) / 7;
+    }
+    static void writeVarint(uint8_t*& p, uint64_t x)
+    {
+        while(x >= 0x80) {
+            *p++ = uint8_t(x | 0x80);
+            x >>= 7;
+        }
+        *p++ = uint8_t(x);
+    }
+    static uint64_t readVarint(const uint8_t*& p)
+    {
+        uint64_t x = 0;
+        for(uint64_t shift=0; ; shift+=7) {
+            const uint8_t byte = *p++;
+            x |= uint64_t(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                return x;
+            }
+        }
+    }
+
+    static uint64_t zigZagEncode(uint64_t d)
+    {
+        return (d << 1) ^ (0 - (d >> 63));
+    }
+    static uint64_t zigZagDecode(uint64_t z)
+    {
+        return (z >> 1) ^ (0 - (z & 1));
+    }
+
+    // The block header byte contains the width in bits
+    // of the packed differences and the zig-zag flag.
+    static uint8_t encodeBlockHeader(uint64_t width, bool isZigZag)
+    {
+        return uint8_t(width | (isZigZag ? 0x80 : 0));
+    }
+    static void decodeBlockHeader(uint8_t header, uint64_t& width, bool& isZigZag)
+    {
+        width = header & 0x7f;
+        isZigZag = ((header & 0x80) != 0);
+    }
+
+    // Read 1 to 64 bits starting at the given bit position.
+    static uint64_t readBits(const uint8_t* p, uint64_t bitPosition, uint64_t width)
+    {
+        const uint8_t* q = p + (bitPosition >> 3);
+        const uint64_t shift = bitPosition & 7;
+        uint64_t word;
+        std::memcpy(&word, q, sizeof(word));
+        uint64_t x = word >> shift;
+        if(shift + width > 64) {
+            x |= uint64_t(q[8]) << (64 - shift);
+        }
+        return (width == 64) ? x : (x & ((uint64_t(1) << width) - 1));
+    }
+
+    // Find the width and zig-zag flag for the differences of a block.
+    static void analyzeBlock(const uint64_t* x, uint64_t n, uint64_t& width, bool& isZigZag)
+    {
+        isZigZag = false;
+        for(uint64_t j=1; j<n; j++) {
+            if(x[j] < x[j-1]) {
+                isZigZag = true;
+                break;
+            }
+        }
+        uint64_t mask = 0;
+        for(uint64_t j=1; j<n; j++) {
+            const uint64_t delta = x[j] - x[j-1];
+            mask |= isZigZag ? zigZagEncode(delta) : delta;
+        }
+        width = uint64_t(std::bit_width(mask));
+    }
+
+    // The number of bytes needed to encode a vector.
+    static uint64_t encodedSize(const uint64_t* x, uint64_t n)
+    {
+        if(n == 0) {
+            return 0;
+        }
+        uint64_t byteCount = varintSize(n);
+        for(uint64_t begin=0; begin<n; begin+=blockSize) {
+            const uint64_t blockN = std::min(blockSize, n - begin);
+            byteCount += varintSize(x[begin]);
+            if(blockN > 1) {
+                uint64_t width;
+                bool isZigZag;
+                analyzeBlock(x + begin, blockN, width, isZigZag);
+                byteCount += 1 + ((blockN - 1) * width + 7) / 8;
+            }
+        }
+        return byteCount;
+    }
+
+    // Encode a vector. The output buffer must be zero filled.
+    static void encode(const uint64_t* x, uint64_t n, uint8_t* p)
+    {
+        if(n == 0) {
+            return;
+        }
+        writeVarint(p, n);
+        for(uint64_t begin=0; begin<n; begin+=blockSize) {
+            const uint64_t blockN = std::min(blockSize, n - begin);
+            const uint64_t* y = x + begin;
+            writeVarint(p, y[0]);
+            if(blockN == 1) {
+                continue;
+            }
+            uint64_t width;
+            bool isZigZag;
+            analyzeBlock(y, blockN, width, isZigZag);
+            *p++ = encodeBlockHeader(width, isZigZag);
+            uint64_t bitPosition = 0;
+            for(uint64_t j=1; j<blockN; j++) {
+                uint64_t delta = y[j] - y[j-1];
+                if(isZigZag) {
+                    delta = zigZagEncode(delta);
+                }
+                for(uint64_t bitCount=width; bitCount>0; ) {
+                    const uint64_t shift = bitPosition & 7;
+                    const uint64_t m = std::min(8 - shift, bitCount);
+                    p[bitPosition >> 3] |= uint8_t((delta & ((uint64_t(1) << m) - 1)) << shift);
+                    delta >>= m;
+                    bitPosition += m;
+                    bitCount -= m;
+                }
+            }
+            p += (bitPosition + 7) / 8;
+        }
+    }
+
+    // Decode a vector, given a pointer to its first block.
+    // Each block is decoded in two steps. First the packed differences
+    // are unpacked independently of each other, in a loop the compiler
+    // can vectorize. Then the prefix sum of the differences is computed.
+    static void decodeVector(const uint8_t* p, uint64_t n, T* out)
+    {
+        array<uint64_t, blockSize> deltas;
+        for(uint64_t begin=0; begin<n; begin+=blockSize) {
+            const uint64_t blockN = std::min(blockSize, n - begin);
+            uint64_t value = readVarint(p);
+            out[begin] = T(value);
+            if(blockN == 1) {
+                continue;
+            }
+            uint64_t width;
+            bool isZigZag;
+            decodeBlockHeader(*p++, width, isZigZag);
+            const uint64_t deltaCount = blockN - 1;
+            if(width == 0) {
+                std::fill(deltas.begin(), deltas.begin() + deltaCount, uint64_t(0));
+            } else {
+                for(uint64_t j=0; j<deltaCount; j++) {
+                    deltas[j] = readBits(p, j * width, width);
+                }
+                if(isZigZag) {
+                    for(uint64_t j=0; j<deltaCount; j++) {
+                        deltas[j] = zigZagDecode(deltas[j]);
+                    }
+                }
+            }
+            for(uint64_t j=0; j<deltaCount; j++) {
+                value += deltas[j];
+                out[begin + 1 + j] = T(value);
+            }
+            p += (deltaCount * width + 7) / 8;
+        }
+    }
+};
+
+
+
+template<class T, class Int>
+    void shasta::MemoryMapped::CompressedVectorOfVectors<T, Int>::get(Int i, T* out) const
+{
+    (*this)[i].get(out);
+}
+
+
+
+template<class T, class Int>
+    T shasta::MemoryMapped::CompressedVectorOfVectors<T, Int>::Range::operator[](uint64_t j) const
+{
+    SHASTA_ASSERT(j < n);
+
+    // Skip the preceding blocks.
+    const uint8_t* q = p;
+    uint64_t begin = 0;
+    for(; begin + blockSize <= j; begin += blockSize) {
+        readVarint(q);
+        uint64_t width;
+        bool isZigZag;
+        decodeBlockHeader(*q++, width, isZigZag);
+        q += ((blockSize - 1) * width + 7) / 8;
+    }
+
+    // Decode the block containing element j, up to element j.
+    uint64_t value = readVarint(q);
+    if(j == begin) {
+        return T(value);
+    }
+    uint64_t width;
+    bool isZigZag;
+    decodeBlockHeader(*q++, width, isZigZag);
+    if(width == 0) {
+        return T(value);
+    }
+    for(uint64_t k=0; k<j-begin; k++) {
+        const uint64_t delta = readBits(q, k * width, width);
+        value += isZigZag ? zigZagDecode(delta) : delta;
+    }
+    return T(value);
+}
+
+
+
+template<class T, class Int>
+    void shasta::MemoryMapped::CompressedVectorOfVectors<T, Int>::createFrom(
+    const VectorOfVectors<T, Int>& v)
+{
+    SHASTA_ASSERT(empty());
+    const uint64_t n = v.size();
+    const uint64_t rangeCount = getParallelRangeCount(n);
+
+    // Compute the encoded size of each vector.
+    toc.resize(n + 1);
+    forEachParallelRange(n, rangeCount,
+        [&](uint64_t, uint64_t begin, uint64_t end)
+        {
+            vector<uint64_t> x;
+            for(uint64_t i=begin; i!=end; i++) {
+                const span<const T> vi = v[Int(i)];
+                x.assign(vi.begin(), vi.end());
+                toc[i + 1] = encodedSize(x.data(), x.size());
+            }
+        });
+
+    // Compute the offsets.
+    toc[0] = headerSize;
+    for(uint64_t i=0; i<n; i++) {
+        toc[i + 1] += toc[i];
+    }
+
+    // Encode.
+    data.resize(toc.back() + paddingSize);
+    forEachParallelRange(n, rangeCount,
+        [&](uint64_t, uint64_t begin, uint64_t end)
+        {
+            std::fill(data.begin() + toc[begin], data.begin() + toc[end], uint8_t(0));
+            vector<uint64_t> x;
+            for(uint64_t i=begin; i!=end; i++) {
+                const span<const T> vi = v[Int(i)];
+                x.assign(vi.begin(), vi.end());
+                encode(x.data(), x.size(), data.begin() + toc[i]);
+            }
+        });
+    std::fill(data.begin() + toc.back(), data.end(), uint8_t(0));
+    setTotalSize(v.totalSize());
+}
+
+
+
+template<class T, class Int>
+    void shasta::MemoryMapped::CompressedVectorOfVectors<T, Int>::decompress(
+    VectorOfVectors<T, Int>& v) const
+{
+    const uint64_t n = size();
+    v.beginPass1(Int(n));
+    for(uint64_t i=0; i<n; i++) {
+        v.incrementCount(Int(i), Int(size(Int(i))));
+    }
+    v.beginPass2();
+    forEachParallelRange(n, getParallelRangeCount(n),
+        [&](uint64_t, uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                get(Int(i), v.begin(Int(i)));
+            }
+        });
+    v.endPass2(false);
+}
+
+
+
+#endif
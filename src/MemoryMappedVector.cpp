@@ -1,5 +1,21 @@
 #include "MemoryMappedObject.hpp"
 #include "MemoryMappedVector.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/core/demangle.hpp>
+
+// Standard library.
+#include "algorithm.hpp"
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include "memory.hpp"
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "utility.hpp"
 
 namespace shasta {
     class MemoryMappedObjectTest {
@@ -33,3 +49,412 @@ void shasta::testMemoryMappedVector()
     SHASTA_ASSERT(x->b == 3);
 #endif
 }
+
+
+
+// Registry of Vector objects used for memory usage reporting.
+// It is allocated on the heap and never destroyed,
+// so it can be used by Vector objects with static storage duration.
+namespace shasta {
+    namespace MemoryMapped {
+        namespace {
+            class VectorRegistry {
+            public:
+                std::mutex mutex;
+                std::unordered_map<const void*, GetVectorInfo> vectors;
+            };
+            VectorRegistry& getVectorRegistry()
+            {
+                static VectorRegistry* registry = new VectorRegistry();
+                return *registry;
+            }
+
+            // Use mincore to count resident bytes in a range of mapped memory.
+            // This is done in chunks, to limit the size of the vector used by mincore.
+            uint64_t getResidentBytes(const void* address, uint64_t n)
+            {
+                const uint64_t pageSize = uint64_t(::sysconf(_SC_PAGESIZE));
+                const uint64_t chunkSize = 1ULL << 30;
+                vector<unsigned char> residency;
+                uint64_t residentPageCount = 0;
+                for(uint64_t begin=0; begin<n; begin+=chunkSize) {
+                    const uint64_t end = min(n, begin + chunkSize);
+                    residency.resize((end - begin - 1) / pageSize + 1);
+                    if(::mincore(const_cast<char*>(static_cast<const char*>(address) + begin),
+                        end - begin, residency.data()) != 0) {
+                        return 0;
+                    }
+                    for(const unsigned char r: residency) {
+                        residentPageCount += (r & 1);
+                    }
+                }
+                return residentPageCount * pageSize;
+            }
+
+            string formatMegabytes(uint64_t bytes)
+            {
+                std::ostringstream s;
+                s << std::fixed << std::setprecision(1) << double(bytes) / double(1ULL << 20);
+                return s.str();
+            }
+
+            // Type names contain angle brackets.
+            string htmlEscape(const string& s)
+            {
+                string escaped;
+                for(const char c: s) {
+                    switch(c) {
+                    case '<': escaped += "&lt;"; break;
+                    case '>': escaped += "&gt;"; break;
+                    case '&': escaped += "&amp;"; break;
+                    default: escaped += c;
+                    }
+                }
+                return escaped;
+            }
+
+            string displayName(const VectorInfo& info)
+            {
+                return std::filesystem::path(info.name).filename().string();
+            }
+        }
+    }
+}
+
+
+
+void shasta::MemoryMapped::registerVector(const void* v, GetVectorInfo getVectorInfo)
+{
+    VectorRegistry& registry = getVectorRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.vectors.insert(make_pair(v, getVectorInfo));
+}
+
+
+
+void shasta::MemoryMapped::unregisterVector(const void* v)
+{
+    VectorRegistry& registry = getVectorRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.vectors.erase(v);
+}
+
+
+
+string shasta::MemoryMapped::VectorInfo::backing() const
+{
+    if(isAnonymous) {
+        if(pageSize == 2 * 1024 * 1024) {
+            return "anonymous, 2 MB pages";
+        } else if(useTransparentHugePages and mappedBytes >= transparentHugePageSize) {
+            return "anonymous, transparent huge pages";
+        } else {
+            return "anonymous, 4 KB pages";
+        }
+    } else {
+        if(pageSize == 2 * 1024 * 1024) {
+            return "filesystem, 2 MB pages";
+        } else {
+            return "filesystem";
+        }
+    }
+}
+
+
+
+vector<shasta::MemoryMapped::VectorInfo> shasta::MemoryMapped::getOpenVectors()
+{
+    vector<VectorInfo> infos;
+    {
+        VectorRegistry& registry = getVectorRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for(const auto& p: registry.vectors) {
+            VectorInfo info;
+            (*p.second)(p.first, info);
+            if(info.isOpen) {
+                infos.push_back(info);
+            }
+        }
+    }
+
+    for(VectorInfo& info: infos) {
+        info.typeName = boost::core::demangle(info.typeName.c_str());
+        info.residentBytes = getResidentBytes(info.address, info.mappedBytes);
+    }
+
+    sort(infos.begin(), infos.end(),
+        [](const VectorInfo& x, const VectorInfo& y)
+        {
+            return x.mappedBytes > y.mappedBytes;
+        });
+    return infos;
+}
+
+
+
+void shasta::MemoryMapped::writeMemoryUsage(ostream& s, uint64_t minBytes)
+{
+    const vector<VectorInfo> infos = getOpenVectors();
+
+    uint64_t totalMappedBytes = 0;
+    uint64_t totalResidentBytes = 0;
+    uint64_t otherCount = 0;
+    uint64_t otherMappedBytes = 0;
+    uint64_t otherResidentBytes = 0;
+    std::map<string, pair<uint64_t, uint64_t> > byBacking;
+    for(const VectorInfo& info: infos) {
+        totalMappedBytes += info.mappedBytes;
+        totalResidentBytes += info.residentBytes;
+        auto& b = byBacking[info.backing()];
+        b.first += info.mappedBytes;
+        b.second += info.residentBytes;
+    }
+
+    s << "Memory usage of " << infos.size() << " open MemoryMapped::Vector objects: " <<
+        formatMegabytes(totalMappedBytes) << " MB mapped, " <<
+        formatMegabytes(totalResidentBytes) << " MB resident." << endl;
+    for(const auto& p: byBacking) {
+        s << "    " << p.first << ": " << formatMegabytes(p.second.first) << " MB mapped, " <<
+            formatMegabytes(p.second.second) << " MB resident." << endl;
+    }
+    s << "    MappedMB ResidentMB         Size     Capacity ObjectBytes Name / Type" << endl;
+    for(const VectorInfo& info: infos) {
+        if(info.mappedBytes < minBytes) {
+            ++otherCount;
+            otherMappedBytes += info.mappedBytes;
+            otherResidentBytes += info.residentBytes;
+            continue;
+        }
+        s << "    " <<
+            std::setw(8) << formatMegabytes(info.mappedBytes) << " " <<
+            std::setw(10) << formatMegabytes(info.residentBytes) << " " <<
+            std::setw(12) << info.size << " " <<
+            std::setw(12) << info.capacity << " " <<
+            std::setw(11) << info.objectSize << " " <<
+            (info.name.empty() ? string("(unnamed)") : displayName(info)) << " / " <<
+            info.typeName << " / " << info.backing() << endl;
+    }
+    if(otherCount) {
+        s << "    " << otherCount << " other objects using less than " <<
+            formatMegabytes(minBytes) << " MB each: " <<
+            formatMegabytes(otherMappedBytes) << " MB mapped, " <<
+            formatMegabytes(otherResidentBytes) << " MB resident." << endl;
+    }
+}
+
+
+
+void shasta::MemoryMapped::writeMemoryUsageHtml(ostream& html)
+{
+    const vector<VectorInfo> infos = getOpenVectors();
+
+    uint64_t totalMappedBytes = 0;
+    uint64_t totalResidentBytes = 0;
+    for(const VectorInfo& info: infos) {
+        totalMappedBytes += info.mappedBytes;
+        totalResidentBytes += info.residentBytes;
+    }
+
+    html <<
+        "<h1>Memory usage</h1>"
+        "<p>This page lists the " << infos.size() << " MemoryMapped::Vector objects "
+        "that are currently open in this process, sorted by decreasing mapped size. "
+        "Vectors of vectors appear as two objects, for the table of contents (.toc) and the data (.data). "
+        "Resident memory is obtained using <code>mincore</code>."
+        "<p>Total mapped " << formatMegabytes(totalMappedBytes) << " MB, "
+        "total resident " << formatMegabytes(totalResidentBytes) << " MB."
+        "<p><table>"
+        "<tr><th>Name<th>Type<th>Backing<th>Object<br>bytes<th>Size<th>Capacity"
+        "<th>Mapped<br>MB<th>Resident<br>MB";
+
+    for(const VectorInfo& info: infos) {
+        html <<
+            "<tr><td>" << displayName(info) <<
+            "<td>" << htmlEscape(info.typeName) <<
+            "<td>" << info.backing() <<
+            "<td class=centered>" << info.objectSize <<
+            "<td class=centered>" << info.size <<
+            "<td class=centered>" << info.capacity <<
+            "<td class=centered>" << formatMegabytes(info.mappedBytes) <<
+            "<td class=centered>" << formatMegabytes(info.residentBytes);
+    }
+    html << "</table>";
+}
+
+
+
+// Pool of files on hugetlbfs released by Vector::remove.
+// See MemoryMappedVector.hpp for more information.
+// Like the registry, it is allocated on the heap and never destroyed,
+// so a zeroing thread still running at exit does not cause problems.
+namespace shasta {
+    namespace MemoryMapped {
+        namespace {
+            class HugePagePool {
+            public:
+                class Entry {
+                public:
+                    string directory;
+                    string fileName;
+                    uint64_t fileSize;
+
+                    // Set by the zeroing thread when it is done.
+                    std::atomic<bool> isZeroed = false;
+
+                    // Set to ask the zeroing thread to stop early.
+                    std::atomic<bool> stop = false;
+
+                    std::thread zeroingThread;
+                };
+
+                std::mutex mutex;
+                vector< shared_ptr<Entry> > entries;
+                uint64_t nextFileId = 0;
+            };
+            HugePagePool& getHugePagePool()
+            {
+                static HugePagePool* pool = new HugePagePool();
+                return *pool;
+            }
+
+            // Zero a pooled file, so it can be reused as a newly created file.
+            // This also allocates the huge pages of the file that were never touched.
+            // The mmap reserves them, so if there are not enough huge pages
+            // it fails and the file is not zeroed and never reused.
+            void zeroHugePageFile(HugePagePool::Entry& entry)
+            {
+                const uint64_t hugePageSize = 2 * 1024 * 1024;
+                const int fileDescriptor = ::open(entry.fileName.c_str(), O_RDWR);
+                if(fileDescriptor == -1) {
+                    return;
+                }
+                void* pointer = ::mmap(0, entry.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+                ::close(fileDescriptor);
+                if(pointer == reinterpret_cast<void*>(-1LL)) {
+                    return;
+                }
+                char* begin = static_cast<char*>(pointer);
+                bool success = true;
+                for(uint64_t offset=0; offset<entry.fileSize; offset+=hugePageSize) {
+                    if(entry.stop) {
+                        success = false;
+                        break;
+                    }
+                    std::memset(begin + offset, 0, min(hugePageSize, entry.fileSize - offset));
+                }
+                ::munmap(pointer, entry.fileSize);
+                entry.isZeroed = success;
+            }
+
+            // Stop the zeroing thread of an entry and unlink its file.
+            void freeHugePagePoolEntry(HugePagePool::Entry& entry)
+            {
+                entry.stop = true;
+                if(entry.zeroingThread.joinable()) {
+                    entry.zeroingThread.join();
+                }
+                std::filesystem::remove(entry.fileName);
+            }
+        }
+    }
+}
+
+
+
+bool shasta::MemoryMapped::releaseToHugePagePool(const string& fileName, size_t fileSize)
+{
+    if(not useHugePagePool) {
+        return false;
+    }
+
+    // Only files on hugetlbfs are pooled.
+    const long hugetlbfsMagic = 0x958458f6;
+    struct statfs fileSystemInformation;
+    if(::statfs(fileName.c_str(), &fileSystemInformation) != 0 or
+        long(fileSystemInformation.f_type) != hugetlbfsMagic) {
+        return false;
+    }
+
+    HugePagePool& pool = getHugePagePool();
+    const auto entry = make_shared<HugePagePool::Entry>();
+    entry->directory = std::filesystem::path(fileName).parent_path().string();
+    entry->fileSize = fileSize;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        const std::filesystem::path poolDirectory =
+            std::filesystem::path(entry->directory) / "HugePagePool";
+        std::error_code errorCode;
+        std::filesystem::create_directory(poolDirectory, errorCode);
+        entry->fileName = (poolDirectory / to_string(pool.nextFileId++)).string();
+        std::filesystem::rename(fileName, entry->fileName, errorCode);
+        if(errorCode) {
+            return false;
+        }
+        entry->zeroingThread = std::thread(zeroHugePageFile, std::ref(*entry));
+        pool.entries.push_back(entry);
+    }
+    return true;
+}
+
+
+
+bool shasta::MemoryMapped::acquireFromHugePagePool(const string& fileName, size_t fileSize)
+{
+    if(not useHugePagePool) {
+        return false;
+    }
+    const string directory = std::filesystem::path(fileName).parent_path().string();
+
+    // Find the smallest zeroed file that is large enough
+    // and remove it from the pool.
+    HugePagePool& pool = getHugePagePool();
+    shared_ptr<HugePagePool::Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        uint64_t bestIndex = pool.entries.size();
+        for(uint64_t i=0; i<pool.entries.size(); i++) {
+            const HugePagePool::Entry& candidate = *pool.entries[i];
+            if(candidate.isZeroed and candidate.directory == directory and candidate.fileSize >= fileSize and
+                (bestIndex == pool.entries.size() or candidate.fileSize < pool.entries[bestIndex]->fileSize)) {
+                bestIndex = i;
+            }
+        }
+        if(bestIndex == pool.entries.size()) {
+            return false;
+        }
+        entry = pool.entries[bestIndex];
+        pool.entries[bestIndex] = pool.entries.back();
+        pool.entries.pop_back();
+    }
+    entry->zeroingThread.join();
+
+    // Give it the requested name and size.
+    // Truncating releases the huge pages past the new size.
+    std::error_code errorCode;
+    std::filesystem::rename(entry->fileName, fileName, errorCode);
+    if(errorCode) {
+        std::filesystem::remove(entry->fileName);
+        return false;
+    }
+    if(::truncate(fileName.c_str(), off_t(fileSize)) != 0) {
+        std::filesystem::remove(fileName);
+        return false;
+    }
+    return true;
+}
+
+
+
+bool shasta::MemoryMapped::freeHugePagePool()
+{
+    HugePagePool& pool = getHugePagePool();
+    vector< shared_ptr<HugePagePool::Entry> > entries;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        entries.swap(pool.entries);
+    }
+    for(const auto& entry: entries) {
+        freeHugePagePoolEntry(*entry);
+    }
+    return not entries.empty();
+}
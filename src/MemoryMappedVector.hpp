@@ -5,6 +5,7 @@
 
 // Shasta.
 #include "array.hpp"
+#include "mappedCopy.hpp"
 #include "touchMemory.hpp"
 #include "SHASTA_ASSERT.hpp"
 
@@ -12,7 +13,10 @@
 #include <cstring>
 #include "algorithm"
 #include "cstddef.hpp"
+#include "cstdint.hpp"
 #include <filesystem>
+#include <type_traits>
+#include <typeinfo>
 #include "iostream.hpp"
 #include "stdexcept.hpp"
 #include "string.hpp"
@@ -23,6 +27,7 @@
 #include <sys/mman.h>
 #include <linux/mman.h>
 #include <sys/stat.h>
+#include <sys/vfs.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -31,6 +36,129 @@
 namespace shasta {
     namespace MemoryMapped {
         template<class T> class Vector;
+
+        // Hints about how the memory of a Vector or VectorOfVectors
+        // will be accessed. They are passed to the kernel via madvise
+        // and only affect performance, never the stored data.
+        // They are most useful with --memoryMode filesystem --memoryBacking disk,
+        // where they control read ahead from disk.
+        enum class AccessPattern {
+            normal,     // Default behavior (MADV_NORMAL).
+            sequential, // Aggressive read ahead (MADV_SEQUENTIAL).
+            random,     // No read ahead (MADV_RANDOM).
+            willNeed,   // Start reading the pages now (MADV_WILLNEED).
+            dontNeed,   // The pages are not needed soon and can be reclaimed first (MADV_COLD).
+            hugePage,   // Use transparent huge pages if possible (MADV_HUGEPAGE).
+            populate    // Fault in all pages now (MADV_POPULATE_READ).
+        };
+
+        // If set, anonymous mappings on 4 KB pages of at least 2 MB
+        // are aligned at 2 MB boundaries and advised with MADV_HUGEPAGE,
+        // so the kernel can back them with transparent huge pages.
+        // This does not require root privilege or hugetlbfs.
+        // Set by --memoryBacking THP.
+        inline bool useTransparentHugePages = false;
+        const size_t transparentHugePageSize = 2 * 1024 * 1024;
+
+        // Anonymous mmap and mremap, as used by Vector for 4 KB pages,
+        // honoring useTransparentHugePages. On failure they return MAP_FAILED
+        // and set errno, like mmap and mremap.
+        void* mapAnonymous(size_t size);
+        void* remapAnonymous(void* oldPointer, size_t oldSize, size_t newSize);
+
+        // If set, when the file of a Vector grows its blocks are allocated
+        // immediately with fallocate, so the file system can lay them out
+        // contiguously and running out of disk space is detected
+        // at allocation time rather than as a SIGBUS on first access.
+        // This has no effect for files on tmpfs or hugetlbfs,
+        // or if the file system does not support fallocate.
+        // Set by --memoryMode filesystem --memoryBacking disk.
+        inline bool preallocateFiles = false;
+        void preallocateFile(int fileDescriptor, size_t fileSize);
+
+        // Pool of files on hugetlbfs released by Vector::remove.
+        // When it is enabled, the file of a Vector on hugetlbfs
+        // is not unlinked by remove. It is moved to a pool directory
+        // (HugePagePool, next to the file), and a background thread
+        // zeroes the huge pages it already owns.
+        // Vector::createNew then reuses a pooled file of sufficient size,
+        // if one is available, so the new Vector gets pages that are
+        // already allocated and zeroed, without paying for the kernel
+        // faulting in and zeroing fresh huge pages on first touch.
+        // If an mmap fails because no huge pages are available,
+        // the pool is freed and the mmap is retried, so the pool
+        // never causes an allocation failure.
+        // Set by --memoryMode filesystem --memoryBacking 2M.
+        inline bool useHugePagePool = false;
+
+        // Move a closed file to the pool, if the pool is enabled
+        // and the file is on hugetlbfs. Returns true if this was done.
+        bool releaseToHugePagePool(const string& fileName, size_t fileSize);
+
+        // Rename a zeroed pooled file to fileName and truncate it to fileSize.
+        // Returns false if the pool contains no file of at least fileSize
+        // in the same directory.
+        bool acquireFromHugePagePool(const string& fileName, size_t fileSize);
+
+        // Unlink all pooled files, freeing their huge pages.
+        // Returns true if the pool was not empty.
+        bool freeHugePagePool();
+
+        // When a Vector stored in a file shrinks by at least this many bytes,
+        // the pages past the new end are released with MADV_REMOVE,
+        // which punches a hole in the file. This frees disk space
+        // as well as tmpfs or hugetlbfs memory.
+        // The capacity of the Vector does not change.
+        const size_t holePunchMinBytes = 64 * 1024 * 1024;
+
+        // Registry of all Vector objects, used to report the memory
+        // used by each Vector that is open (--command assemble writes it
+        // to performance.log at the end of each assembly stage,
+        // and the http server has a page that displays it).
+        // VectorOfVectors and other containers are built from Vector objects,
+        // so their components are registered individually.
+        class VectorInfo {
+        public:
+            string name;
+            string typeName;
+            uint64_t objectSize;
+            uint64_t size;
+            uint64_t capacity;
+            uint64_t mappedBytes;
+            uint64_t residentBytes;
+            uint64_t pageSize;
+            bool isOpen;
+            bool isAnonymous;
+            const void* address;
+            string backing() const;
+        };
+        using GetVectorInfo = void (*)(const void*, VectorInfo&);
+        void registerVector(const void*, GetVectorInfo);
+        void unregisterVector(const void*);
+
+        // Return information on all the Vector objects that are open,
+        // sorted by decreasing mapped size.
+        // This must not be called while other threads create,
+        // resize, or close Vector objects.
+        vector<VectorInfo> getOpenVectors();
+
+        // Write memory usage of all open Vector objects, as a table.
+        // Only the ones using at least minBytes are listed individually.
+        void writeMemoryUsage(ostream&, uint64_t minBytes = 1024 * 1024);
+        void writeMemoryUsageHtml(ostream&);
+
+        // Anonymous Vector objects have no file name.
+        // To identify them in memory usage reports, they get the
+        // name in anonymousName, if any. This is set by
+        // MappedMemoryOwner::largeDataName and used and cleared
+        // by the next anonymous Vector created by the same thread.
+        inline thread_local string anonymousName;
+        inline string takeAnonymousName()
+        {
+            string name;
+            name.swap(anonymousName);
+            return name;
+        }
     }
     void testMemoryMappedVector();
 }
@@ -103,12 +231,18 @@ public:
         resize(0);
     }
 
+    // Give the kernel a hint about how this Vector will be accessed.
+    // Errors are ignored, except that for AccessPattern::populate
+    // the pages are touched if madvise fails (for example on older kernels).
+    void advise(AccessPattern) const;
+
     // Touch a range of memory in order to cause the
     // supporting pages of virtual memory to be loaded in real memory.
     // The return value can be ignored.
     size_t touchMemory() const
     {
-        return shasta::touchMemory(begin(), end());
+        advise(AccessPattern::populate);
+        return 0;
     }
 
 
@@ -127,6 +261,21 @@ public:
         resize(n);
     }
 
+    // Like reserveAndResize, but the elements added are not constructed,
+    // so this can only be used for trivially copyable types,
+    // and the caller must assign all of them.
+    // This allows the caller to initialize the elements using multiple threads,
+    // so each page of memory is first touched by the thread that initializes it.
+    // On a NUMA machine, this places each page on the NUMA node of that thread.
+    void reserveAndResizeUninitialized(size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "reserveAndResizeUninitialized requires a trivially copyable type.");
+        SHASTA_ASSERT(n >= size());
+        reserve(n);
+        header->objectCount = n;
+    }
+
     // Make a copy of the Vector.
     void makeCopy(Vector<T>& copy, const string& newName) const;
 
@@ -244,7 +393,14 @@ public:
     // The file name. If not open, this is an empty string.
     string fileName;
 
+    // The name used in memory usage reports.
+    // For anonymous Vectors, this is obtained from anonymousName
+    // and can be empty.
+    string memoryUsageName;
+
 private:
+    static void getInfo(const void*, VectorInfo&);
+
     // Unmap the memory.
     void unmap();
 
@@ -362,6 +518,7 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::push_back(const T
 // Destructor.
 template<class T> inline shasta::MemoryMapped::Vector<T>::~Vector()
 {
+    unregisterVector(this);
     if(isOpen) {
 
         if(fileName.empty()) {
@@ -386,6 +543,31 @@ template<class T> inline shasta::MemoryMapped::Vector<T>::Vector() :
     isOpen(false),
     isOpenWithWriteAccess(false)
 {
+    registerVector(this, &getInfo);
+}
+
+
+
+// Get information on a Vector for the registry used for memory usage reporting.
+template<class T> inline void shasta::MemoryMapped::Vector<T>::getInfo(
+    const void* pointer,
+    VectorInfo& info)
+{
+    const Vector<T>& v = *static_cast<const Vector<T>*>(pointer);
+    info.isOpen = v.isOpen;
+    if(not v.isOpen) {
+        return;
+    }
+    info.name = v.memoryUsageName;
+    info.typeName = typeid(T).name();
+    info.objectSize = sizeof(T);
+    info.size = v.header->objectCount;
+    info.capacity = v.header->capacity;
+    info.mappedBytes = v.header->fileSize;
+    info.residentBytes = 0;
+    info.pageSize = v.header->pageSize;
+    info.isAnonymous = v.fileName.empty();
+    info.address = v.header;
 }
 
 
@@ -423,6 +605,126 @@ template<class T> inline int shasta::MemoryMapped::Vector<T>::openExisting(const
     return fileDescriptor;
 }
 
+inline void* shasta::MemoryMapped::mapAnonymous(size_t size)
+{
+    if(not useTransparentHugePages or size < transparentHugePageSize) {
+        return ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    // Map an extra huge page, then unmap the unaligned portions at the two ends.
+    const size_t mappedSize = size + transparentHugePageSize;
+    char* pointer = static_cast<char*>(::mmap(0, mappedSize,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if(pointer == reinterpret_cast<char*>(-1LL)) {
+        return pointer;
+    }
+    const size_t misalignment = reinterpret_cast<uintptr_t>(pointer) % transparentHugePageSize;
+    char* alignedPointer = pointer + (misalignment ? (transparentHugePageSize - misalignment) : 0);
+    if(alignedPointer != pointer) {
+        ::munmap(pointer, size_t(alignedPointer - pointer));
+    }
+    char* end = pointer + mappedSize;
+    char* alignedEnd = alignedPointer + size;
+    if(end != alignedEnd) {
+        ::munmap(alignedEnd, size_t(end - alignedEnd));
+    }
+
+    ::madvise(alignedPointer, size, MADV_HUGEPAGE);
+    return alignedPointer;
+}
+
+
+
+inline void* shasta::MemoryMapped::remapAnonymous(void* oldPointer, size_t oldSize, size_t newSize)
+{
+    if(not useTransparentHugePages or newSize < transparentHugePageSize) {
+        return ::mremap(oldPointer, oldSize, newSize, MREMAP_MAYMOVE);
+    }
+
+    // Get an aligned address range, then move the existing pages there.
+    void* alignedPointer = mapAnonymous(newSize);
+    if(alignedPointer == reinterpret_cast<void*>(-1LL)) {
+        return alignedPointer;
+    }
+    void* pointer = ::mremap(oldPointer, oldSize, newSize, MREMAP_MAYMOVE | MREMAP_FIXED, alignedPointer);
+    if(pointer == reinterpret_cast<void*>(-1LL)) {
+        const int savedErrno = errno;
+        ::munmap(alignedPointer, newSize);
+        errno = savedErrno;
+        return pointer;
+    }
+    ::madvise(pointer, newSize, MADV_HUGEPAGE);
+    return pointer;
+}
+
+
+
+// Allocate the blocks of a file, if its file system is backed by disk
+// and supports fallocate. Failures are ignored - the file was already
+// given the requested size by ftruncate, and blocks will then be allocated
+// on first access, as without preallocation.
+inline void shasta::MemoryMapped::preallocateFile(int fileDescriptor, size_t fileSize)
+{
+    const long tmpfsMagic = 0x01021994;
+    const long hugetlbfsMagic = 0x958458f6;
+    struct statfs fileSystemInformation;
+    if(::fstatfs(fileDescriptor, &fileSystemInformation) != 0) {
+        return;
+    }
+    if(long(fileSystemInformation.f_type) == tmpfsMagic or
+        long(fileSystemInformation.f_type) == hugetlbfsMagic) {
+        return;
+    }
+    ::fallocate(fileDescriptor, 0, 0, off_t(fileSize));
+}
+
+
+
+template<class T> inline void shasta::MemoryMapped::Vector<T>::advise(AccessPattern accessPattern) const
+{
+    if(not isOpen) {
+        return;
+    }
+
+    int advice = MADV_NORMAL;
+    switch(accessPattern) {
+    case AccessPattern::normal:
+        advice = MADV_NORMAL;
+        break;
+    case AccessPattern::sequential:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case AccessPattern::random:
+        advice = MADV_RANDOM;
+        break;
+    case AccessPattern::willNeed:
+        advice = MADV_WILLNEED;
+        break;
+    case AccessPattern::dontNeed:
+        // Don't use MADV_DONTNEED, which discards the contents of anonymous memory.
+        advice = MADV_COLD;
+        break;
+    case AccessPattern::hugePage:
+        // Memory backed by 2 MB pages is already using huge pages.
+        if(header->pageSize == 2*1024*1024) {
+            return;
+        }
+        advice = MADV_HUGEPAGE;
+        break;
+    case AccessPattern::populate:
+        advice = MADV_POPULATE_READ;
+        break;
+    }
+
+    // The mapping begins at the header and is page aligned.
+    const int returnCode = ::madvise(header, header->fileSize, advice);
+    if(returnCode != 0 and accessPattern == AccessPattern::populate) {
+        shasta::touchMemory(begin(), end());
+    }
+}
+
+
+
 // Truncate the given file descriptor to the specified size.
 template<class T> inline void shasta::MemoryMapped::Vector<T>::truncate(int fileDescriptor, size_t fileSize)
 {
@@ -435,12 +737,22 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::truncate(int file
             "\nThe most likely cause for this error is insufficient memory. "
             "Run on a larger machine.");
     }
+    if(preallocateFiles) {
+        preallocateFile(fileDescriptor, fileSize);
+    }
 }
 
 // Map to memory the given file descriptor for the specified size.
 template<class T> inline void* shasta::MemoryMapped::Vector<T>::map(int fileDescriptor, size_t fileSize, bool writeAccess)
 {
-    void* pointer = ::mmap(0, fileSize, PROT_READ | (writeAccess ? PROT_WRITE : 0), MAP_SHARED, fileDescriptor, 0);
+    const int protection = PROT_READ | (writeAccess ? PROT_WRITE : 0);
+    void* pointer = ::mmap(0, fileSize, protection, MAP_SHARED, fileDescriptor, 0);
+
+    // If there are not enough huge pages, release the ones held by the pool and try again.
+    if(pointer == reinterpret_cast<void*>(-1LL) and errno == ENOMEM and freeHugePagePool()) {
+        pointer = ::mmap(0, fileSize, protection, MAP_SHARED, fileDescriptor, 0);
+    }
+
     if(pointer == reinterpret_cast<void*>(-1LL)) {
         ::close(fileDescriptor);
         if(errno == ENOMEM) {
@@ -484,8 +796,10 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNew(
 
     if(name.empty()) {
         createNewAnonymous(pageSize, n, requiredCapacity);
+        memoryUsageName = takeAnonymousName();
         return;
     }
+    memoryUsageName = name;
 
     try {
         // If already open, should have called close first.
@@ -496,11 +810,16 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNew(
         const Header headerOnStack(n, requiredCapacity, pageSize);
         const size_t fileSize = headerOnStack.fileSize;
 
-        // Create the file.
-        const int fileDescriptor = openNew(name);
+        // Create the file, or reuse one from the pool of huge page files.
+        int fileDescriptor = -1;
+        if(useHugePagePool and pageSize == 2*1024*1024 and acquireFromHugePagePool(name, fileSize)) {
+            fileDescriptor = openExisting(name, true);
+        } else {
+            fileDescriptor = openNew(name);
 
-        // Make it the size we want.
-        truncate(fileDescriptor, fileSize);
+            // Make it the size we want.
+            truncate(fileDescriptor, fileSize);
+        }
 
         // Map it in memory.
         void* pointer = map(fileDescriptor, fileSize, true);
@@ -552,13 +871,14 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNewAnonymou
         const size_t fileSize = headerOnStack.fileSize;
 
         // Map it in memory.
-        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        void* pointer = 0;
         if(pageSize == 2*1024*1024) {
-            flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+            pointer = ::mmap(0, fileSize,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB,
+                -1, 0);
+        } else {
+            pointer = mapAnonymous(fileSize);
         }
-        void* pointer = ::mmap(0, fileSize,
-            PROT_READ | PROT_WRITE, flags,
-            -1, 0);
         if(pointer == reinterpret_cast<void*>(-1LL)) {
             if(errno == ENOMEM) {
                 throw runtime_error("Memory allocation failure "
@@ -597,6 +917,7 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNewAnonymou
 // Open a previously created vector with read-only or read-write access.
 template<class T> inline void shasta::MemoryMapped::Vector<T>::accessExisting(const string& name, bool readWriteAccess)
 {
+    memoryUsageName = name;
     try {
         // If already open, should have called close first.
         SHASTA_ASSERT(!isOpen);
@@ -745,8 +1066,13 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::remove()
         unmapAnonymous();
     } else {
         const string savedFileName = fileName;
+        const size_t savedFileSize = header->fileSize;
+        const bool isHugePageFile = (header->pageSize == 2*1024*1024);
         close();    // This forgets the fileName.
-        std::filesystem::remove(savedFileName);
+        if(not (useHugePagePool and isHugePageFile and
+            releaseToHugePagePool(savedFileName, savedFileSize))) {
+            std::filesystem::remove(savedFileName);
+        }
     }
 }
 
@@ -777,6 +1103,17 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::resize(size_t new
         }
         header->objectCount = newSize;
 
+        // If the vector shrank by a large amount, release the pages
+        // past the new end, up to the end of capacity. They read as zero if the vector grows again
+        // within its capacity, and the constructor is called
+        // on the elements added in that case.
+        const size_t pageSize = header->pageSize;
+        const size_t newEnd = ((sizeof(Header) + newSize * sizeof(T) + pageSize - 1) / pageSize) * pageSize;
+        const size_t oldEnd = ((sizeof(Header) + oldSize * sizeof(T) + pageSize - 1) / pageSize) * pageSize;
+        if(oldEnd >= newEnd + holePunchMinBytes) {
+            ::madvise(reinterpret_cast<char*>(header) + newEnd, header->fileSize - newEnd, MADV_REMOVE);
+        }
+
     } else {
 
         // The vector is getting longer.
@@ -900,7 +1237,7 @@ template<class T> inline void
             void* pointer = 0;
             useMremap = (pageSize == 4096);
             if(useMremap) {
-                pointer = ::mremap(header, header->fileSize, headerOnStack.fileSize, MREMAP_MAYMOVE);
+                pointer = remapAnonymous(header, header->fileSize, headerOnStack.fileSize);
                 if(pointer == reinterpret_cast<void*>(-1LL)) {
                     if(errno == ENOMEM) {
                         throw runtime_error("Memory allocation failure "
@@ -1039,7 +1376,7 @@ template<class T> inline
     useMremap = (pageSize == 4096);
     void* pointer = 0;
     if(useMremap) {
-        pointer = ::mremap(header, header->fileSize, headerOnStack.fileSize, MREMAP_MAYMOVE);
+        pointer = remapAnonymous(header, header->fileSize, headerOnStack.fileSize);
         if(pointer == reinterpret_cast<void*>(-1LL)) {
             if(errno == ENOMEM) {
                 throw runtime_error("Memory allocation failure "
@@ -1106,11 +1443,19 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::unreserve()
 
 
 // Make a copy of the Vector.
+// If both are backed by files, the file is copied using snapshotCopy,
+// which uses a reflink if the filesystem supports it.
 template<class T> inline void shasta::MemoryMapped::Vector<T>::makeCopy(
     Vector<T>& copy, const string& newName) const
 {
-    copy.createNew(newName, size());
-    std::copy(begin(), end(), copy.begin());
+    SHASTA_ASSERT(isOpen);
+    if(not fileName.empty() and not newName.empty()) {
+        snapshotCopy(fileName, newName);
+        copy.accessExistingReadWrite(newName);
+    } else {
+        copy.createNew(newName, header->pageSize, size());
+        std::copy(begin(), end(), copy.begin());
+    }
 }
 
 template<class T> inline void shasta::MemoryMapped::Vector<T>::rename(const string& newFileName)
@@ -10,6 +10,7 @@
 
 // Standard libraries.
 #include "algorithm.hpp"
+#include <thread>
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -17,6 +18,45 @@
 namespace shasta {
     namespace MemoryMapped {
         template<class T, class Int> class VectorOfVectors;
+        template<class T, class Int> class VectorOfVectorsParallelFill;
+
+        // Split [0, n) in contiguous ranges and call f(rangeId, begin, end)
+        // for each range, using one thread per range.
+        // The number of ranges is 1 if n is small, so small
+        // VectorOfVectors don't pay the cost of starting threads.
+        // Used by the VectorOfVectors functions that loop over all vectors.
+        // f must not throw.
+        uint64_t getParallelRangeCount(uint64_t n);
+        template<class F> void forEachParallelRange(uint64_t n, uint64_t rangeCount, const F& f);
+    }
+}
+
+
+
+inline uint64_t shasta::MemoryMapped::getParallelRangeCount(uint64_t n)
+{
+    const uint64_t minRangeSize = 1ULL << 20;
+    const uint64_t threadCount = std::max(1U, std::thread::hardware_concurrency());
+    return std::max(uint64_t(1), std::min(threadCount, n / minRangeSize));
+}
+
+
+
+template<class F> inline void shasta::MemoryMapped::forEachParallelRange(
+    uint64_t n,
+    uint64_t rangeCount,
+    const F& f)
+{
+    if(rangeCount == 1) {
+        f(0, 0, n);
+        return;
+    }
+    vector<std::thread> threads;
+    for(uint64_t rangeId=0; rangeId<rangeCount; rangeId++) {
+        threads.push_back(std::thread(f, rangeId, (rangeId * n) / rangeCount, ((rangeId + 1) * n) / rangeCount));
+    }
+    for(std::thread& thread: threads) {
+        thread.join();
     }
 }
 
@@ -31,7 +71,15 @@ public:
         pageSize = pageSizeArgument;
 
         if(nameArgument.empty()) {
+            // Propagate the name used in memory usage reports.
+            const string baseName = takeAnonymousName();
+            if(not baseName.empty()) {
+                MemoryMapped::anonymousName = baseName + ".toc";
+            }
             toc.createNew("", pageSize);
+            if(not baseName.empty()) {
+                MemoryMapped::anonymousName = baseName + ".data";
+            }
             data.createNew("", pageSize);
         } else {
             toc.createNew(name + ".toc", pageSize);
@@ -203,7 +251,7 @@ public:
 
     // Append vectors at the end.
     void appendVectors(const vector< vector<T> >& v) {
-        for(const auto x: v) {
+        for(const auto& x: v) {
             appendVector(x);
         }
     }
@@ -263,6 +311,13 @@ public:
         }
     }
 
+    // Sync the mapped memory to disk.
+    void syncToDisk()
+    {
+        toc.syncToDisk();
+        data.syncToDisk();
+    }
+
     // Touch the memory in order to cause the
     // supporting pages of virtual memory to be loaded in real memory.
     size_t touchMemory() const
@@ -270,6 +325,13 @@ public:
         return toc.touchMemory() + data.touchMemory();
     }
 
+    // Give the kernel a hint about how the toc and data will be accessed.
+    void advise(AccessPattern accessPattern) const
+    {
+        toc.advise(accessPattern);
+        data.advise(accessPattern);
+    }
+
     bool isOpen() const
     {
         return toc.isOpen && data.isOpen;
@@ -301,6 +363,17 @@ public:
         return name;
     }
 
+    // Direct read-only access to the table of contents and the data,
+    // used to expose them to Python without copying.
+    const Vector<Int>& getToc() const
+    {
+        return toc;
+    }
+    const Vector<T>& getData() const
+    {
+        return data;
+    }
+
 private:
     Vector<Int> toc;
     Vector<Int> count;
@@ -322,8 +395,15 @@ template<class T, class Int>
             count.createNew(name + ".count", pageSize);
         }
     }
-    count.reserveAndResize(n);
-    fill(count.begin(), count.end(), Int(0));
+    // The counts are initialized in parallel.
+    count.resize(0);
+    count.reserveAndResizeUninitialized(n);
+    Int* countPointer = count.begin();
+    forEachParallelRange(n, getParallelRangeCount(n),
+        [countPointer](uint64_t, uint64_t begin, uint64_t end)
+        {
+            std::fill(countPointer + begin, countPointer + end, Int(0));
+        });
 }
 
 
@@ -332,11 +412,44 @@ template<class T, class Int>
     void shasta::MemoryMapped::VectorOfVectors<T, Int>::beginPass2()
 {
     const Int n = Int(count.size());
-    toc.reserveAndResize(n+1);
+    toc.resize(0);
+    toc.reserveAndResizeUninitialized(n+1);
     toc[0] = 0;
-    for(Int i=0; i<n; i++) {
-        toc[i+1] = toc[i] + count[i];
+
+    // Parallel prefix sum of the counts.
+    // Each thread sums the counts in its range, then, after
+    // the offset of each range is computed, stores the toc for its range.
+    const uint64_t rangeCount = getParallelRangeCount(n);
+    vector<Int> rangeSum(rangeCount, 0);
+    const Int* countPointer = count.begin();
+    Int* tocPointer = toc.begin();
+    if(rangeCount > 1) {
+        forEachParallelRange(n, rangeCount,
+            [countPointer, &rangeSum](uint64_t rangeId, uint64_t begin, uint64_t end)
+            {
+                Int sum = 0;
+                for(uint64_t i=begin; i!=end; i++) {
+                    sum += countPointer[i];
+                }
+                rangeSum[rangeId] = sum;
+            });
+        Int offset = 0;
+        for(uint64_t rangeId=0; rangeId<rangeCount; rangeId++) {
+            const Int sum = rangeSum[rangeId];
+            rangeSum[rangeId] = offset;
+            offset += sum;
+        }
     }
+    forEachParallelRange(n, rangeCount,
+        [countPointer, tocPointer, &rangeSum](uint64_t rangeId, uint64_t begin, uint64_t end)
+        {
+            Int sum = rangeSum[rangeId];
+            for(uint64_t i=begin; i!=end; i++) {
+                sum += countPointer[i];
+                tocPointer[i + 1] = sum;
+            }
+        });
+
     const size_t  dataSize = toc.back();
     data.reserveAndResize(dataSize);
 }
@@ -348,10 +461,20 @@ template<class T, class Int>
         bool check, bool free)
 {
     // Verify that all counts are now zero.
+    // Each thread checks a range, and the assertion is in the calling thread.
     if(check) {
-        const Int n = Int(count.size());
-        for(Int i=0; i<n; i++) {
-            SHASTA_ASSERT(count[i] == 0);;
+        const uint64_t n = count.size();
+        const uint64_t rangeCount = getParallelRangeCount(n);
+        vector<uint8_t> rangeIsZero(rangeCount, 0);
+        const Int* countPointer = count.begin();
+        forEachParallelRange(n, rangeCount,
+            [countPointer, &rangeIsZero](uint64_t rangeId, uint64_t begin, uint64_t end)
+            {
+                rangeIsZero[rangeId] = std::all_of(countPointer + begin, countPointer + end,
+                    [](Int c) {return c == 0;}) ? 1 : 0;
+            });
+        for(const uint8_t isZero: rangeIsZero) {
+            SHASTA_ASSERT(isZero);
         }
     }
 
@@ -409,4 +532,102 @@ template<class T, class Int>
     return make_pair(i, j);
 }
 
+// Contention free multithreaded construction of a VectorOfVectors.
+// This is an alternative to the two pass protocol using
+// incrementCountMultithreaded and storeMultithreaded, which uses
+// atomic operations on the count of each vector. When many threads
+// add to the same vectors (hot keys), those become points of contention.
+//
+// Here the elements are added in a single pass over the input.
+// Each thread keeps them in its own buffers, one for each range of vector indexes.
+// Then, in finish, each range of vector indexes is processed by a single thread,
+// which counts and stores all the elements for that range,
+// from all threads, with no atomic operations.
+// The offsets of each vector are computed by the parallel prefix sum in beginPass2.
+//
+// The final layout is the same as with the two pass protocol.
+// In each vector, the elements added by each thread are stored in the order
+// in which they were added, and elements added by lower thread ids come first.
+//
+// The buffers require extra memory proportional to the number of elements,
+// sizeof(pair<Int, T>) bytes per element, until finish returns.
+// Usage:
+//     VectorOfVectorsParallelFill<T, Int> fill(v, n, threadCount);
+//     fill.add(threadId, index, t);   // Called by all threads, for all elements.
+//     fill.finish();
+template<class T, class Int> class shasta::MemoryMapped::VectorOfVectorsParallelFill {
+public:
+
+    // The VectorOfVectors must already be open with write access.
+    // On return from finish, it will contain n vectors.
+    VectorOfVectorsParallelFill(VectorOfVectors<T, Int>& v, uint64_t n, uint64_t threadCount) :
+        v(v),
+        n(n),
+        threadCount(threadCount)
+    {
+        SHASTA_ASSERT(threadCount > 0);
+        rangeCount = std::max(uint64_t(1), std::min(n, 4 * threadCount));
+        rangeSize = (n + rangeCount - 1) / rangeCount;
+        buffers.resize(threadCount * rangeCount);
+    }
+
+    void add(uint64_t threadId, Int index, const T& t)
+    {
+        buffers[threadId * rangeCount + uint64_t(index) / rangeSize].push_back(make_pair(index, t));
+    }
+
+    void finish()
+    {
+        v.beginPass1(Int(n));
+
+        // Count the elements in each range.
+        forEachParallelRange(rangeCount, std::min(threadCount, rangeCount),
+            [this](uint64_t, uint64_t rangeBegin, uint64_t rangeEnd)
+            {
+                for(uint64_t rangeId=rangeBegin; rangeId!=rangeEnd; rangeId++) {
+                    for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+                        for(const pair<Int, T>& p: buffers[threadId * rangeCount + rangeId]) {
+                            v.incrementCount(p.first);
+                        }
+                    }
+                }
+            });
+
+        v.beginPass2();
+
+        // Store the elements of each range.
+        // VectorOfVectors::store fills each vector backward,
+        // so we go through the elements in reverse order.
+        forEachParallelRange(rangeCount, std::min(threadCount, rangeCount),
+            [this](uint64_t, uint64_t rangeBegin, uint64_t rangeEnd)
+            {
+                for(uint64_t rangeId=rangeBegin; rangeId!=rangeEnd; rangeId++) {
+                    for(uint64_t threadId=threadCount; threadId>0; threadId--) {
+                        vector< pair<Int, T> >& buffer = buffers[(threadId - 1) * rangeCount + rangeId];
+                        for(auto it=buffer.rbegin(); it!=buffer.rend(); ++it) {
+                            v.store(it->first, it->second);
+                        }
+                        vector< pair<Int, T> >().swap(buffer);
+                    }
+                }
+            });
+
+        v.endPass2();
+        buffers.clear();
+    }
+
+private:
+    VectorOfVectors<T, Int>& v;
+    uint64_t n;
+    uint64_t threadCount;
+    uint64_t rangeCount;
+    uint64_t rangeSize;
+
+    // The elements added by thread threadId for vectors in range rangeId
+    // are in buffers[threadId * rangeCount + rangeId].
+    vector< vector< pair<Int, T> > > buffers;
+};
+
+
+
 #endif
@@ -0,0 +1,168 @@
+// Implementation of class MetricsServer - see MetricsServer.hpp for more information.
+
+// Shasta.
+#include "MetricsServer.hpp"
+#include "MultithreadedObject.hpp"
+#include "performanceLog.hpp"
+#include "platformDependent.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/v6_only.hpp>
+
+// Standard library.
+#include "chrono.hpp"
+#include "iostream.hpp"
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include "stdexcept.hpp"
+#include <thread>
+
+
+
+void MetricsServer::start(uint16_t port)
+{
+    using boost::asio::io_service;
+    using boost::asio::ip::tcp;
+
+    // Create the acceptor, accepting both ipv4 and ipv6 ip addresses.
+    // This is done here rather than in the server thread,
+    // so errors are reported to the caller.
+    const auto service = std::make_shared<io_service>();
+    const auto acceptor = std::make_shared<tcp::acceptor>(*service);
+    const tcp::endpoint endpoint(tcp::v6(), port);
+    try {
+        acceptor->open(endpoint.protocol());
+        acceptor->set_option(boost::asio::ip::v6_only(false));
+        acceptor->set_option(tcp::acceptor::reuse_address(true));
+        acceptor->bind(endpoint);
+        acceptor->listen();
+    } catch(const std::exception& e) {
+        throw runtime_error("Unable to use port " + to_string(port) + " for metrics: " + e.what());
+    }
+
+    enableBatchProgress(true);
+
+    // The server thread. It is never joined: it runs
+    // until the process exits.
+    std::thread([service, acceptor]()
+    {
+        while(true) {
+            tcp::iostream s;
+            boost::system::error_code errorCode;
+            acceptor->accept(*s.rdbuf(), errorCode);
+            if(errorCode) {
+                continue;
+            }
+            try {
+
+                // Skip the request line and headers.
+                string line;
+                while(std::getline(s, line) and line != "\r" and not line.empty()) {
+                }
+
+                const string metrics = getMetrics();
+                s <<
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " << metrics.size() << "\r\n"
+                    "Connection: close\r\n"
+                    "\r\n" << metrics << std::flush;
+            } catch(...) {
+                // Ignore errors in the connection.
+            }
+        }
+    }).detach();
+
+    cout << "Metrics are available at http://localhost:" << port << "/metrics" << endl;
+}
+
+
+
+string MetricsServer::getMetrics()
+{
+    // The page fault counts and time of the previous request,
+    // used to compute page fault rates.
+    static std::mutex mutex;
+    static bool havePrevious = false;
+    static steady_clock::time_point previousTime;
+    static uint64_t previousMajorFaultCount = 0;
+    static uint64_t previousMinorFaultCount = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    string stageName;
+    double stageSeconds = 0.;
+    getCurrentPerformanceSpan(stageName, stageSeconds);
+    const BatchProgress progress = getBatchProgress();
+    const ResourceUsage usage = getResourceUsage();
+    const auto now = steady_clock::now();
+
+    double majorFaultRate = 0.;
+    double minorFaultRate = 0.;
+    if(havePrevious) {
+        const double t = seconds(now - previousTime);
+        if(t > 0.) {
+            majorFaultRate = double(usage.majorFaultCount - previousMajorFaultCount) / t;
+            minorFaultRate = double(usage.minorFaultCount - previousMinorFaultCount) / t;
+        }
+    }
+    havePrevious = true;
+    previousTime = now;
+    previousMajorFaultCount = usage.majorFaultCount;
+    previousMinorFaultCount = usage.minorFaultCount;
+
+    std::ostringstream s;
+    s.precision(15);
+    auto write = [&s](const char* name, const char* type, const char* help, double value)
+    {
+        s <<
+            "# HELP " << name << " " << help << "\n"
+            "# TYPE " << name << " " << type << "\n" <<
+            name << " " << value << "\n";
+    };
+
+    s <<
+        "# HELP shasta_stage_info The current assembly stage.\n"
+        "# TYPE shasta_stage_info gauge\n"
+        "shasta_stage_info{stage=\"" << stageName << "\"} 1\n";
+    write("shasta_stage_seconds", "gauge",
+        "Seconds elapsed in the current assembly stage.", stageSeconds);
+
+    write("shasta_batch_jobs_total", "counter",
+        "Number of parallel computations using load balancing started so far.",
+        double(progress.jobCount));
+    write("shasta_batch_items_done", "gauge",
+        "Items dispensed so far in the current parallel computation.",
+        double(progress.itemsDone));
+    write("shasta_batch_items_total", "gauge",
+        "Total items in the current parallel computation.",
+        double(progress.itemsTotal));
+    write("shasta_batch_items_per_second", "gauge",
+        "Average items per second in the current parallel computation.",
+        progress.seconds > 0. ? double(progress.itemsDone) / progress.seconds : 0.);
+    write("shasta_batch_seconds", "gauge",
+        "Seconds elapsed in the current parallel computation.",
+        progress.seconds);
+
+    write("shasta_resident_bytes", "gauge",
+        "Resident memory.", double(usage.residentBytes));
+    write("shasta_cpu_user_seconds_total", "counter",
+        "User CPU time of all threads.", usage.userSeconds);
+    write("shasta_cpu_system_seconds_total", "counter",
+        "System CPU time of all threads.", usage.systemSeconds);
+    write("shasta_major_page_faults_total", "counter",
+        "Major page faults.", double(usage.majorFaultCount));
+    write("shasta_minor_page_faults_total", "counter",
+        "Minor page faults.", double(usage.minorFaultCount));
+    write("shasta_major_page_faults_per_second", "gauge",
+        "Major page faults per second since the previous request.", majorFaultRate);
+    write("shasta_minor_page_faults_per_second", "gauge",
+        "Minor page faults per second since the previous request.", minorFaultRate);
+    write("shasta_threads", "gauge",
+        "Number of threads.", double(usage.threadCount));
+
+    return s.str();
+}
@@ -0,0 +1,45 @@
+#ifndef SHASTA_METRICS_SERVER_HPP
+#define SHASTA_METRICS_SERVER_HPP
+
+/*******************************************************************************
+
+A minimal http server that makes live progress and resource usage
+metrics available in the Prometheus text format while an assembly runs.
+Any request receives the same response, so it can be used as
+http://host:port/metrics, as Prometheus expects.
+
+The metrics are:
+- The current PerformanceSpan (assembly stage) and its elapsed seconds.
+- The progress of the most recent computation using load balancing
+  (MultithreadedObject::setupLoadBalancing / getNextBatch):
+  items done, total items, and items per second.
+- Resident memory, CPU time, and page faults, with page fault rates
+  computed over the interval since the previous request.
+
+The server runs in a separate thread, processes one request at a time,
+and only exposes these metrics, never any assembly data.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include "string.hpp"
+
+namespace shasta {
+    class MetricsServer;
+}
+
+
+
+class shasta::MetricsServer {
+public:
+
+    // Start the server thread, listening on the given port on all interfaces.
+    // This also enables batch progress reporting in MultithreadedObject.
+    // Throws if the port cannot be used.
+    static void start(uint16_t port);
+
+    // Return the metrics in Prometheus text format.
+    static string getMetrics();
+};
+
+#endif
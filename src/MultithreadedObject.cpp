@@ -1,14 +1,176 @@
 // Shasta.
 #include "MultithreadedObject.hpp"
 #include "MultithreadedObject.tpp"
+#include "performanceLog.hpp"
+#include "threadAffinity.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 
 // Linux.
 #include <pthread.h>
 
+// Boost libraries.
+#include <boost/core/demangle.hpp>
+
 // Standard library.
 #include "chrono.hpp"
+#include <condition_variable>
+
+
+
+// The persistent thread pool used by runThreads.
+// Worker i runs thread function i of each job with at least i+1 threads.
+// The pool is never destroyed, so it is safe to call exit
+// from one of its threads.
+namespace shasta {
+    namespace {
+        class ThreadPool {
+        public:
+            bool run(size_t threadCount, const std::function<void(size_t)>& f);
+            void cancelAllExceptMe();
+        private:
+
+            // Only one job at a time can use the pool.
+            std::mutex dispatchMutex;
+
+            // Protects everything below.
+            std::mutex mutex;
+            std::condition_variable jobAvailable;
+            std::condition_variable jobDone;
+            vector<std::thread> workers;
+            const std::function<void(size_t)>* job = 0;
+            size_t jobThreadCount = 0;
+            size_t pendingThreadCount = 0;
+            uint64_t generation = 0;
+
+            void workerFunction(size_t workerId, uint64_t lastGeneration);
+        };
+
+        ThreadPool& getThreadPool()
+        {
+            static ThreadPool* threadPool = new ThreadPool();
+            return *threadPool;
+        }
+
+        // The object whose thread function is running in this thread, if any,
+        // and the corresponding thread id.
+        thread_local const MultithreadedObjectBaseClass* currentObject = 0;
+        thread_local size_t currentThreadId = 0;
+
+        // Thread statistics accumulated over all calls to runThreads
+        // with the same name, in order of first appearance.
+        // The name is the name of the current PerformanceSpan,
+        // followed by the class name.
+        class ThreadStatisticsSummary {
+        public:
+            string name;
+            uint64_t callCount = 0;
+            uint64_t maxThreadCount = 0;
+            double wallSeconds = 0.;
+            double busySeconds = 0.;
+            double idleCoreSeconds = 0.;
+
+            // Sum over calls of threadCount times the busy time of the slowest thread.
+            double balancedCoreSeconds = 0.;
+            double worstImbalance = 0.;
+
+            uint64_t batchCount = 0;
+            uint64_t itemCount = 0;
+            double slowestBatchSeconds = 0.;
+            uint64_t slowestBatchBegin = 0;
+            uint64_t slowestBatchEnd = 0;
+        };
+        std::atomic<bool> threadStatisticsEnabled = false;
+
+        // Batch progress. Counts are approximate if multiple
+        // objects use load balancing at the same time.
+        std::atomic<bool> batchProgressEnabled = false;
+        std::atomic<uint64_t> batchProgressJobCount = 0;
+        std::atomic<uint64_t> batchProgressItemsDone = 0;
+        std::atomic<uint64_t> batchProgressItemsTotal = 0;
+        std::atomic<int64_t> batchProgressBeginTime = 0;    // Nanoseconds of steady_clock.
+        std::mutex threadStatisticsMutex;
+        vector<ThreadStatisticsSummary> threadStatisticsSummaries;
+    }
+}
+
+
+
+bool ThreadPool::run(size_t threadCount, const std::function<void(size_t)>& f)
+{
+    std::unique_lock<std::mutex> dispatchLock(dispatchMutex, std::try_to_lock);
+    if(not dispatchLock.owns_lock()) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Create the workers we need and don't have yet.
+    while(workers.size() < threadCount) {
+        const size_t workerId = workers.size();
+        try {
+            workers.push_back(std::thread(&ThreadPool::workerFunction, this, workerId, generation));
+        } catch(const std::exception& e) {
+            throw runtime_error(
+                "The following error occurred while attempting to start thread " +
+                to_string(workerId) + ":\n" + e.what() + "\n" +
+                "You may have hit a limit imposed by your system on the maximum number of threads "
+                "allowed. Rerunning with \"--threads " + to_string(workerId) + "\" may fix this problem "
+                "at a cost in performance.");
+        }
+    }
+
+    // Start the job and wait for it to complete.
+    job = &f;
+    jobThreadCount = threadCount;
+    pendingThreadCount = threadCount;
+    ++generation;
+    jobAvailable.notify_all();
+    jobDone.wait(lock, [this]{return pendingThreadCount == 0;});
+    job = 0;
+
+    return true;
+}
+
+
+
+void ThreadPool::workerFunction(size_t workerId, uint64_t lastGeneration)
+{
+    setThreadPoolThreadAffinity(workerId);
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        jobAvailable.wait(lock, [&]{return generation != lastGeneration;});
+        lastGeneration = generation;
+        if(workerId >= jobThreadCount) {
+            continue;
+        }
+
+        const std::function<void(size_t)>& f = *job;
+        lock.unlock();
+        f(workerId);
+        setThreadPoolThreadAffinity(workerId);
+        lock.lock();
+
+        --pendingThreadCount;
+        if(pendingThreadCount == 0) {
+            jobDone.notify_all();
+        }
+    }
+}
+
+
+
+// Only used when an exception occurs in a thread, just before calling exit.
+void ThreadPool::cancelAllExceptMe()
+{
+    const auto me = ::pthread_self();
+    for(std::thread& worker: workers) {
+        const auto h = worker.native_handle();
+        if(h and not ::pthread_equal(h, me)) {
+            ::pthread_cancel(h);
+        }
+    }
+}
 
 
 
@@ -92,6 +254,73 @@ void shasta::MultithreadedObjectBaseClass::setupLoadBalancing(
     n = nArgument;
     batchSize = batchSizeArgument;
     nextBatch = 0;
+    batchDistributionPending = true;
+    batchesDistributed = false;
+    guided = false;
+    guidedCost = {};
+    remainingCost = 0;
+
+    if(batchProgressEnabled) {
+        batchProgressItemsDone = 0;
+        batchProgressItemsTotal = n;
+        batchProgressBeginTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            steady_clock::now().time_since_epoch()).count();
+        ++batchProgressJobCount;
+    }
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::setupGuidedLoadBalancing(
+    uint64_t nArgument,
+    uint64_t minBatchSize,
+    const std::function<uint64_t(uint64_t)>& cost)
+{
+    setupLoadBalancing(nArgument, max(minBatchSize, uint64_t(1)));
+    guided = true;
+    guidedThreadCount = 1;
+    guidedCost = cost;
+    if(guidedCost) {
+        for(uint64_t i=0; i<n; i++) {
+            remainingCost += guidedCost(i);
+        }
+    }
+}
+
+
+
+// Give each thread a contiguous range of batches.
+// If there is only one thread, or too many batches to pack
+// a range in 64 bits, getNextBatch uses a single shared counter instead.
+void shasta::MultithreadedObjectBaseClass::distributeBatches(size_t threadCount)
+{
+    if(not batchDistributionPending) {
+        return;
+    }
+    batchDistributionPending = false;
+
+    // With guided load balancing, the batches are computed on the fly.
+    if(guided) {
+        guidedThreadCount = max(threadCount, size_t(1));
+        return;
+    }
+
+    SHASTA_ASSERT(batchSize > 0);
+    const uint64_t batchCount = (n + batchSize - 1) / batchSize;
+    if(threadCount < 2 or batchCount >= (uint64_t(1) << 32)) {
+        return;
+    }
+
+    if(batchRangeCount != threadCount) {
+        batchRanges = std::make_unique<BatchRange[]>(threadCount);
+        batchRangeCount = threadCount;
+    }
+    for(uint64_t i=0; i<threadCount; i++) {
+        const uint64_t rangeBegin = (i * batchCount) / threadCount;
+        const uint64_t rangeEnd = ((i + 1) * batchCount) / threadCount;
+        batchRanges[i].range = (rangeBegin << 32) | rangeEnd;
+    }
+    batchesDistributed = true;
 }
 
 
@@ -100,6 +329,36 @@ bool shasta::MultithreadedObjectBaseClass::getNextBatch(
     uint64_t& begin,
     uint64_t& end)
 {
+    const bool found = getNextBatchRange(begin, end);
+    if(threadStatisticsActive) {
+        recordBatch(found, begin, end);
+    }
+    if(found and batchProgressEnabled) {
+        batchProgressItemsDone.fetch_add(end - begin, std::memory_order_relaxed);
+    }
+    return found;
+}
+
+
+
+bool shasta::MultithreadedObjectBaseClass::getNextBatchRange(
+    uint64_t& begin,
+    uint64_t& end)
+{
+    if(guided) {
+        return getNextGuidedBatch(begin, end);
+    }
+
+    if(batchesDistributed) {
+        uint64_t batch;
+        if(not getNextBatchIndex(batch)) {
+            return false;
+        }
+        begin = batch * batchSize;
+        end = min(n, begin + batchSize);
+        return true;
+    }
+
     begin = __sync_fetch_and_add(&nextBatch, batchSize);
     if(begin < n) {
         end = min(n, begin + batchSize);
@@ -111,6 +370,372 @@ bool shasta::MultithreadedObjectBaseClass::getNextBatch(
 
 
 
+// The next guided batch begins at nextBatch.
+// Its end is computed based on the remaining items or cost,
+// and then nextBatch is advanced with a compare and swap.
+// If another thread advanced nextBatch in the meantime, try again.
+bool shasta::MultithreadedObjectBaseClass::getNextGuidedBatch(
+    uint64_t& begin,
+    uint64_t& end)
+{
+    const uint64_t batchCountPerThread = 2;
+    begin = __atomic_load_n(&nextBatch, __ATOMIC_SEQ_CST);
+    while(true) {
+        if(begin >= n) {
+            return false;
+        }
+
+        uint64_t batchCost = 0;
+        if(guidedCost) {
+            const uint64_t targetCost = max(uint64_t(1),
+                __atomic_load_n(&remainingCost, __ATOMIC_SEQ_CST) / (batchCountPerThread * guidedThreadCount));
+            end = begin;
+            while(end < n and ((end - begin) < batchSize or batchCost < targetCost)) {
+                batchCost += guidedCost(end);
+                ++end;
+            }
+        } else {
+            end = min(n, begin + max(batchSize, (n - begin) / (batchCountPerThread * guidedThreadCount)));
+        }
+
+        if(__atomic_compare_exchange_n(&nextBatch, &begin, end, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            if(guidedCost) {
+                __atomic_fetch_sub(&remainingCost, batchCost, __ATOMIC_SEQ_CST);
+            }
+            return true;
+        }
+    }
+}
+
+
+
+// Get the next batch from the range of the calling thread
+// or, if that is empty, steal from another thread.
+// A thread that was not assigned a range (for example
+// because it was not started by runThreads or startThreads
+// of this object) can only steal.
+bool shasta::MultithreadedObjectBaseClass::getNextBatchIndex(uint64_t& batch)
+{
+    const uint64_t me =
+        (currentObject == this and currentThreadId < batchRangeCount) ?
+        currentThreadId : batchRangeCount;
+
+    if(me < batchRangeCount and popBatch(me, batch)) {
+        return true;
+    }
+
+    for(uint64_t i=1; i<=batchRangeCount; i++) {
+        const uint64_t victimId = (me + i) % batchRangeCount;
+        if(victimId != me and stealBatches(victimId, me, batch)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+// Take the first batch of a range.
+bool shasta::MultithreadedObjectBaseClass::popBatch(uint64_t rangeId, uint64_t& batch)
+{
+    std::atomic<uint64_t>& range = batchRanges[rangeId].range;
+    uint64_t oldRange = range.load();
+    while(true) {
+        const uint64_t rangeBegin = oldRange >> 32;
+        const uint64_t rangeEnd = oldRange & 0xffffffffULL;
+        if(rangeBegin >= rangeEnd) {
+            return false;
+        }
+        if(range.compare_exchange_weak(oldRange, ((rangeBegin + 1) << 32) | rangeEnd)) {
+            batch = rangeBegin;
+            return true;
+        }
+    }
+}
+
+
+
+// Steal the second half of the range of the victim.
+// The thief processes the first stolen batch immediately and
+// stores the rest as its own range, which is empty at this point.
+// No other thread writes to an empty range, so a plain store is sufficient.
+// A thief without its own range only steals one batch.
+bool shasta::MultithreadedObjectBaseClass::stealBatches(
+    uint64_t victimId,
+    uint64_t thiefId,
+    uint64_t& batch)
+{
+    std::atomic<uint64_t>& range = batchRanges[victimId].range;
+    uint64_t oldRange = range.load();
+    while(true) {
+        const uint64_t rangeBegin = oldRange >> 32;
+        const uint64_t rangeEnd = oldRange & 0xffffffffULL;
+        if(rangeBegin >= rangeEnd) {
+            return false;
+        }
+        const uint64_t stolenCount = (thiefId < batchRangeCount) ? (rangeEnd - rangeBegin + 1) / 2 : 1;
+        const uint64_t stolenBegin = rangeEnd - stolenCount;
+        if(range.compare_exchange_weak(oldRange, (rangeBegin << 32) | stolenBegin)) {
+            batch = stolenBegin;
+            if(thiefId < batchRangeCount) {
+                batchRanges[thiefId].range = ((stolenBegin + 1) << 32) | rangeEnd;
+            }
+            return true;
+        }
+    }
+}
+
+
+
+bool shasta::MultithreadedObjectBaseClass::runOnThreadPool(
+    size_t threadCount,
+    const std::function<void(size_t)>& f)
+{
+    return getThreadPool().run(threadCount, f);
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::setCurrentThread(size_t threadId) const
+{
+    currentObject = this;
+    currentThreadId = threadId;
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::clearCurrentThread()
+{
+    currentObject = 0;
+    currentThreadId = 0;
+}
+
+
+
+bool shasta::MultithreadedObjectBaseClass::isInsideThreadFunction()
+{
+    return currentObject != 0;
+}
+
+
+
+void shasta::enableThreadStatistics(bool enable)
+{
+    threadStatisticsEnabled = enable;
+}
+
+
+
+bool shasta::threadStatisticsAreEnabled()
+{
+    return threadStatisticsEnabled;
+}
+
+
+
+bool shasta::MultithreadedObjectBaseClass::beginThreadStatistics(size_t threadCount)
+{
+    if(not threadStatisticsEnabled) {
+        return false;
+    }
+    threadStatistics.clear();
+    threadStatistics.resize(threadCount);
+    threadStatisticsActive = true;
+    threadStatisticsBeginTime = steady_clock::now();
+    return true;
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::beginThreadTiming(size_t threadId)
+{
+    if(threadStatisticsActive and threadId < threadStatistics.size()) {
+        threadStatistics[threadId].beginTime = steady_clock::now();
+    }
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::endThreadTiming(size_t threadId)
+{
+    if(threadStatisticsActive and threadId < threadStatistics.size()) {
+        ThreadStatistics& s = threadStatistics[threadId];
+        const auto now = steady_clock::now();
+        s.endBatch(now);
+        s.busySeconds = seconds(now - s.beginTime);
+    }
+}
+
+
+
+// Called by getNextBatch. The batch previously returned to the
+// calling thread, if any, is complete.
+void shasta::MultithreadedObjectBaseClass::recordBatch(bool found, uint64_t begin, uint64_t end)
+{
+    if(currentObject != this or currentThreadId >= threadStatistics.size()) {
+        return;
+    }
+    ThreadStatistics& s = threadStatistics[currentThreadId];
+    const auto now = steady_clock::now();
+    s.endBatch(now);
+    if(found) {
+        s.inBatch = true;
+        s.batchBegin = begin;
+        s.batchEnd = end;
+        s.batchBeginTime = now;
+        ++s.batchCount;
+        s.itemCount += end - begin;
+    }
+}
+
+
+
+void shasta::MultithreadedObjectBaseClass::ThreadStatistics::endBatch(steady_clock::time_point now)
+{
+    if(not inBatch) {
+        return;
+    }
+    inBatch = false;
+    const double batchSeconds = seconds(now - batchBeginTime);
+    if(batchSeconds >= slowestBatchSeconds) {
+        slowestBatchSeconds = batchSeconds;
+        slowestBatchBegin = batchBegin;
+        slowestBatchEnd = batchEnd;
+    }
+}
+
+
+
+void shasta::enableBatchProgress(bool enable)
+{
+    batchProgressEnabled = enable;
+}
+
+
+
+shasta::BatchProgress shasta::getBatchProgress()
+{
+    BatchProgress progress;
+    progress.jobCount = batchProgressJobCount;
+    progress.itemsDone = batchProgressItemsDone;
+    progress.itemsTotal = batchProgressItemsTotal;
+    if(progress.jobCount > 0) {
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            steady_clock::now().time_since_epoch()).count();
+        progress.seconds = 1.e-9 * double(now - batchProgressBeginTime);
+    }
+    return progress;
+}
+
+
+
+// Summarize the thread statistics of a call to runThreads,
+// write them to the performance log, and accumulate them.
+void shasta::MultithreadedObjectBaseClass::endThreadStatistics(const char* className)
+{
+    threadStatisticsActive = false;
+    const double wallSeconds = seconds(steady_clock::now() - threadStatisticsBeginTime);
+    const uint64_t threadCount = threadStatistics.size();
+
+    double busySeconds = 0.;
+    double maxBusySeconds = 0.;
+    uint64_t batchCount = 0;
+    uint64_t itemCount = 0;
+    const ThreadStatistics* slowest = 0;
+    for(const ThreadStatistics& s: threadStatistics) {
+        busySeconds += s.busySeconds;
+        maxBusySeconds = max(maxBusySeconds, s.busySeconds);
+        batchCount += s.batchCount;
+        itemCount += s.itemCount;
+        if(s.batchCount > 0 and (slowest == 0 or s.slowestBatchSeconds > slowest->slowestBatchSeconds)) {
+            slowest = &s;
+        }
+    }
+    const double meanBusySeconds = busySeconds / double(threadCount);
+    const double imbalance = (meanBusySeconds > 0.) ? maxBusySeconds / meanBusySeconds : 1.;
+    const double idleCoreSeconds = max(0., double(threadCount) * wallSeconds - busySeconds);
+
+    string name = PerformanceSpan::currentName();
+    if(not name.empty()) {
+        name += "/";
+    }
+    name += boost::core::demangle(className);
+    threadStatistics.clear();
+
+    std::lock_guard<std::mutex> lock(threadStatisticsMutex);
+
+    performanceLog << timestamp << "Threads " << name << ": " <<
+        threadCount << " threads, " <<
+        wallSeconds << " s elapsed, imbalance " << imbalance << ", " <<
+        idleCoreSeconds << " idle core-seconds";
+    if(batchCount > 0) {
+        performanceLog << ", " << batchCount << " batches, " << itemCount << " items";
+    }
+    if(slowest) {
+        performanceLog << ", slowest batch [" << slowest->slowestBatchBegin << "," <<
+            slowest->slowestBatchEnd << ") " << slowest->slowestBatchSeconds << " s";
+    }
+    performanceLog << endl;
+
+    auto it = std::find_if(threadStatisticsSummaries.begin(), threadStatisticsSummaries.end(),
+        [&name](const ThreadStatisticsSummary& summary) {return summary.name == name;});
+    if(it == threadStatisticsSummaries.end()) {
+        threadStatisticsSummaries.emplace_back();
+        it = threadStatisticsSummaries.end() - 1;
+        it->name = name;
+    }
+    ThreadStatisticsSummary& summary = *it;
+    ++summary.callCount;
+    summary.maxThreadCount = max(summary.maxThreadCount, threadCount);
+    summary.wallSeconds += wallSeconds;
+    summary.busySeconds += busySeconds;
+    summary.idleCoreSeconds += idleCoreSeconds;
+    summary.balancedCoreSeconds += double(threadCount) * maxBusySeconds;
+    summary.worstImbalance = max(summary.worstImbalance, imbalance);
+    summary.batchCount += batchCount;
+    summary.itemCount += itemCount;
+    if(slowest and slowest->slowestBatchSeconds >= summary.slowestBatchSeconds) {
+        summary.slowestBatchSeconds = slowest->slowestBatchSeconds;
+        summary.slowestBatchBegin = slowest->slowestBatchBegin;
+        summary.slowestBatchEnd = slowest->slowestBatchEnd;
+    }
+}
+
+
+
+// Write the accumulated thread statistics as a json array.
+// The imbalance is the total, over all calls, of threadCount times
+// the busy time of the slowest thread, divided by the total busy time.
+void shasta::writeThreadStatisticsJson(ostream& json)
+{
+    std::lock_guard<std::mutex> lock(threadStatisticsMutex);
+    json << "[";
+    for(uint64_t i=0; i<threadStatisticsSummaries.size(); i++) {
+        const ThreadStatisticsSummary& summary = threadStatisticsSummaries[i];
+        const double imbalance = (summary.busySeconds > 0.) ?
+            summary.balancedCoreSeconds / summary.busySeconds : 1.;
+        json << (i == 0 ? "\n" : ",\n") <<
+            "    {\n"
+            "      \"Name\": \"" << summary.name << "\",\n"
+            "      \"Number of calls\": " << summary.callCount << ",\n"
+            "      \"Maximum number of threads\": " << summary.maxThreadCount << ",\n"
+            "      \"Elapsed seconds\": " << summary.wallSeconds << ",\n"
+            "      \"Busy core-seconds\": " << summary.busySeconds << ",\n"
+            "      \"Idle core-seconds\": " << summary.idleCoreSeconds << ",\n"
+            "      \"Imbalance (max/mean busy time)\": " << imbalance << ",\n"
+            "      \"Worst imbalance of a single call\": " << summary.worstImbalance << ",\n"
+            "      \"Number of batches\": " << summary.batchCount << ",\n"
+            "      \"Number of items\": " << summary.itemCount << ",\n"
+            "      \"Slowest batch\": {\"Begin\": " << summary.slowestBatchBegin <<
+            ", \"End\": " << summary.slowestBatchEnd <<
+            ", \"Seconds\": " << summary.slowestBatchSeconds << "}\n"
+            "    }";
+    }
+    json << "\n  ]";
+}
+
+
+
 void shasta::MultithreadedObjectBaseClass::killAllThreadsExceptMe(size_t me)
 {
     for(size_t threadId=0; threadId<threads.size(); threadId++) {
@@ -123,6 +748,7 @@ void shasta::MultithreadedObjectBaseClass::killAllThreadsExceptMe(size_t me)
             ::pthread_cancel(h);
         }
     }
+    getThreadPool().cancelAllExceptMe();
 }
 
 
@@ -12,7 +12,52 @@
 //     A() : MultithreadedObject(*this) {}
 // };
 
+// runThreads does not create new threads each time it is called.
+// Instead, it uses a persistent, process-wide pool of threads,
+// which grows as needed to the largest number of threads ever requested.
+// If runThreads is called from a thread function, or while
+// another thread is already using the pool, it falls back to
+// starting new threads, as startThreads does.
+
+// Dynamic load balancing: setupLoadBalancing divides [0, n)
+// in batches of batchSize, and getNextBatch returns the next batch to be processed.
+// When the threads are started, each thread is assigned a contiguous
+// range of batches, which it processes in increasing order.
+// A thread that has exhausted its range steals
+// half of the remaining batches of another thread.
+// As a result, the batches processed by a thread are not necessarily
+// in increasing order. Each batch is processed exactly once.
+
+// Guided load balancing: setupGuidedLoadBalancing also divides [0, n)
+// in batches, but the batches are dispensed in increasing order,
+// and their sizes start large and decrease as the remaining work decreases.
+// Each batch gets about 1/(2*threadCount) of the remaining items or,
+// if a cost function is specified, of the remaining cost.
+// This keeps the number of batches low while reducing the
+// long tail at the end of the computation when the cost
+// of processing different items varies widely.
+
+// Thread statistics: if enabled via enableThreadStatistics,
+// each call to runThreads records, for each thread, the time spent
+// in the thread function and the number of batches and items
+// obtained from getNextBatch, and the time spent processing each batch
+// (measured from one call to getNextBatch to the next).
+// A one line summary is written to the performance log for each call,
+// and summaries grouped by PerformanceSpan and class
+// are accumulated for writeThreadStatisticsJson.
+// Calls of runThreads from inside a thread function are not recorded.
+
+// Batch progress: if enabled via enableBatchProgress, setupLoadBalancing
+// and getNextBatch update process-wide counters of the items
+// dispensed so far for the most recent call to setupLoadBalancing,
+// which can be read at any time, from any thread, via getBatchProgress.
+// This is used to report progress while a long computation is running.
+
 // Standard libraries.
+#include <atomic>
+#include "chrono.hpp"
+#include <functional>
+#include "iostream.hpp"
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -22,6 +67,16 @@ namespace shasta {
     class MultithreadedObjectBaseClass;
     template<class T> class MultithreadedObject;
 
+    // Thread statistics.
+    void enableThreadStatistics(bool);
+    bool threadStatisticsAreEnabled();
+    void writeThreadStatisticsJson(ostream&);
+
+    // Batch progress.
+    class BatchProgress;
+    void enableBatchProgress(bool);
+    BatchProgress getBatchProgress();
+
     // Testing.
     void testMultithreadedObject();
     class MultithreadedObjectTestClass;
@@ -29,6 +84,21 @@ namespace shasta {
 
 
 
+class shasta::BatchProgress {
+public:
+    // The number of calls to setupLoadBalancing so far.
+    uint64_t jobCount = 0;
+
+    // For the most recent call to setupLoadBalancing,
+    // the number of items dispensed by getNextBatch so far,
+    // the total number of items, and the seconds elapsed since the call.
+    uint64_t itemsDone = 0;
+    uint64_t itemsTotal = 0;
+    double seconds = 0.;
+};
+
+
+
 // The base class contains code that is not templated.
 class shasta::MultithreadedObjectBaseClass {
 protected:
@@ -53,16 +123,110 @@ protected:
         uint64_t& begin,
         uint64_t& end);
 
+    // Guided load balancing. Batches are never smaller than minBatchSize,
+    // except possibly for the last one.
+    // If specified, cost(i) must return the cost of processing item i.
+    // It is called by multiple threads, so it must be thread safe.
+    // It is also called once for each item by setupGuidedLoadBalancing,
+    // to compute the total cost.
+    // After that, getNextBatch is used as with setupLoadBalancing.
+    void setupGuidedLoadBalancing(
+        uint64_t n,
+        uint64_t minBatchSize,
+        const std::function<uint64_t(uint64_t)>& cost = {});
+
     // Wait for the running threads to complete.
     void waitForThreads();
 
     // Kill all threads except the one passed as argument.
     void killAllThreadsExceptMe(size_t me);
 
+    // Assign to each thread its initial range of batches,
+    // if setupLoadBalancing was called since the last time threads were started.
+    void distributeBatches(size_t threadCount);
+
+    // Run f(threadId) for all threadId in [0, threadCount-1]
+    // using the persistent thread pool, and wait for completion.
+    // Returns false, without running anything, if the pool
+    // is being used by another thread.
+    static bool runOnThreadPool(
+        size_t threadCount,
+        const std::function<void(size_t)>& f);
+
+    // Keep track of the thread function running in the current thread, if any.
+    void setCurrentThread(size_t threadId) const;
+    static void clearCurrentThread();
+    static bool isInsideThreadFunction();
+
+    // Thread statistics.
+    // beginThreadStatistics returns false, and does nothing,
+    // if thread statistics are not enabled.
+    bool beginThreadStatistics(size_t threadCount);
+    void endThreadStatistics(const char* className);
+    void beginThreadTiming(size_t threadId);
+    void endThreadTiming(size_t threadId);
+
 private:
     uint64_t n = 0;
     uint64_t batchSize = 0;
     uint64_t nextBatch = 0;
+
+    // The ranges of batches assigned to each thread by distributeBatches.
+    // Each range [begin, end) is packed in a single 64-bit word,
+    // with begin in the high 32 bits and end in the low 32 bits,
+    // so it can be updated with a single compare and swap.
+    class alignas(64) BatchRange {
+    public:
+        std::atomic<uint64_t> range = 0;
+    };
+    std::unique_ptr<BatchRange[]> batchRanges;
+    uint64_t batchRangeCount = 0;
+
+    // Set by setupLoadBalancing, cleared by distributeBatches.
+    bool batchDistributionPending = false;
+
+    // Set if the batches were distributed by distributeBatches.
+    // Otherwise, getNextBatch uses nextBatch.
+    bool batchesDistributed = false;
+
+    // Guided load balancing.
+    bool guided = false;
+    uint64_t guidedThreadCount = 1;
+    std::function<uint64_t(uint64_t)> guidedCost;
+    uint64_t remainingCost = 0;
+    bool getNextGuidedBatch(uint64_t& begin, uint64_t& end);
+
+    bool getNextBatchRange(uint64_t& begin, uint64_t& end);
+    bool getNextBatchIndex(uint64_t& batch);
+    bool popBatch(uint64_t rangeId, uint64_t& batch);
+    bool stealBatches(uint64_t victimId, uint64_t thiefId, uint64_t& batch);
+
+    // Thread statistics for the current call to runThreads, one for each thread.
+    // Each thread only touches its own entry.
+    class alignas(64) ThreadStatistics {
+    public:
+        steady_clock::time_point beginTime;
+        double busySeconds = 0.;
+        uint64_t batchCount = 0;
+        uint64_t itemCount = 0;
+
+        // The batch being processed, if any.
+        bool inBatch = false;
+        uint64_t batchBegin = 0;
+        uint64_t batchEnd = 0;
+        steady_clock::time_point batchBeginTime;
+
+        // The batch that took the longest time.
+        double slowestBatchSeconds = 0.;
+        uint64_t slowestBatchBegin = 0;
+        uint64_t slowestBatchEnd = 0;
+
+        void endBatch(steady_clock::time_point);
+    };
+    vector<ThreadStatistics> threadStatistics;
+    bool threadStatisticsActive = false;
+    steady_clock::time_point threadStatisticsBeginTime;
+    void recordBatch(bool found, uint64_t begin, uint64_t end);
 };
 
 
@@ -3,6 +3,7 @@
 // Shasta.
 #include "MultithreadedObject.hpp"
 #include "SHASTA_ASSERT.hpp"
+#include "threadAffinity.hpp"
 #include "timestamp.hpp"
 
 // Standard library.
@@ -10,6 +11,7 @@
 #include "iostream.hpp"
 #include "stdexcept.hpp"
 #include "string.hpp"
+#include <typeinfo>
 
 
 
@@ -24,6 +26,37 @@ template<class T> void shasta::MultithreadedObject<T>::runThreads(
     ThreadFunction f,
     size_t threadCount)
 {
+    SHASTA_ASSERT(threadCount > 0);
+
+    if(!threads.empty()) {
+        throw runtime_error("Unsupported attempt to start new threads while other threads have not been joined.");
+    }
+
+    // Use the persistent thread pool, unless we are being called from a
+    // thread function (which could be running on the pool itself).
+    if(not isInsideThreadFunction()) {
+        const bool recordStatistics = beginThreadStatistics(threadCount);
+        distributeBatches(threadCount);
+        exceptionsOccurred = false;
+        const bool success = runOnThreadPool(threadCount,
+            [this, f](size_t threadId)
+            {
+                runThreadFunction(t, f, threadId);
+            });
+        if(not success) {
+            // The pool is not available. Start new threads.
+            startThreads(f, threadCount);
+            waitForThreads();
+        } else if(exceptionsOccurred) {
+            throw runtime_error("Exceptions occurred in at least one thread.");
+        }
+        if(recordStatistics) {
+            endThreadStatistics(typeid(T).name());
+        }
+        return;
+    }
+
+    // We are being called from a thread function. Start new threads.
     startThreads(f, threadCount);
     waitForThreads();
 }
@@ -40,6 +73,8 @@ template<class T> void shasta::MultithreadedObject<T>::startThreads(
         throw runtime_error("Unsupported attempt to start new threads while other threads have not been joined.");
     }
 
+    distributeBatches(threadCount);
+
     // __sync_synchronize (); A full memory barrier is probably not needed here.
     exceptionsOccurred = false;
     for(size_t threadId=0; threadId<threadCount; threadId++) {
@@ -50,6 +85,7 @@ template<class T> void shasta::MultithreadedObject<T>::startThreads(
                 std::ref(t),
                 f,
                 threadId)));
+            unpinThread(*threads.back());
         } catch(const std::exception& e) {
             throw runtime_error(
                 "The following error occurred while attempting to start thread " +
@@ -80,7 +116,11 @@ template<class T> void shasta::MultithreadedObject<T>::runThreadFunction(
     size_t threadId)
 {
     try {
+        t.setCurrentThread(threadId);
+        t.beginThreadTiming(threadId);
         (t.*f)(threadId);
+        t.endThreadTiming(threadId);
+        clearCurrentThread();
     } catch(const runtime_error& e) {
         t.exceptionsOccurred = true;
         std::lock_guard<std::mutex> lock(t.mutex);
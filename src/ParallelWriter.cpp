@@ -0,0 +1,91 @@
+// Shasta.
+#include "ParallelWriter.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<ParallelWriter>;
+
+
+
+ParallelWriter::ParallelWriter(
+    ostream& s,
+    size_t threadCount,
+    uint64_t batchSize) :
+    MultithreadedObject<ParallelWriter>(*this),
+    s(s),
+    threadCount(threadCount),
+    batchSize(batchSize)
+{
+    SHASTA_ASSERT(batchSize > 0);
+
+    // Adjust the number of threads, if necessary.
+    if(threadCount == 0) {
+        this->threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Use enough batches per chunk to give good load balancing,
+    // while keeping the size of the buffers limited.
+    chunkBatchCount = 16 * this->threadCount;
+    buffers.resize(chunkBatchCount);
+}
+
+
+
+void ParallelWriter::write(uint64_t n, const FormatFunction& f)
+{
+    formatFunction = &f;
+
+    const uint64_t chunkSize = batchSize * chunkBatchCount;
+    for(chunkBegin=0; chunkBegin<n; chunkBegin+=chunkSize) {
+        const uint64_t chunkEnd = min(n, chunkBegin + chunkSize);
+        const uint64_t bufferCount = (chunkEnd - chunkBegin - 1) / batchSize + 1;
+
+        if(threadCount == 1) {
+            for(uint64_t i=chunkBegin; i!=chunkEnd; i++) {
+                f(i, buffers[(i - chunkBegin) / batchSize]);
+            }
+        } else {
+            setupLoadBalancing(chunkEnd - chunkBegin, batchSize);
+            runThreads(&ParallelWriter::threadFunction, threadCount);
+        }
+
+        writeBuffers(bufferCount);
+    }
+
+    formatFunction = 0;
+}
+
+
+
+void ParallelWriter::threadFunction(size_t /* threadId */)
+{
+    const FormatFunction& f = *formatFunction;
+
+    // Each batch goes to its own buffer, so the order
+    // in which the batches are processed does not matter.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        string& buffer = buffers[begin / batchSize];
+        for(uint64_t i=begin; i!=end; i++) {
+            f(chunkBegin + i, buffer);
+        }
+    }
+}
+
+
+
+// Write out the buffers in order, then clear them.
+// Clearing a string does not free its memory,
+// so the buffers keep their capacity for the next chunk.
+void ParallelWriter::writeBuffers(uint64_t bufferCount)
+{
+    for(uint64_t i=0; i<bufferCount; i++) {
+        string& buffer = buffers[i];
+        s.write(buffer.data(), std::streamsize(buffer.size()));
+        buffer.clear();
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef SHASTA_PARALLEL_WRITER_HPP
+#define SHASTA_PARALLEL_WRITER_HPP
+
+// Class ParallelWriter writes to an ostream the records
+// for a sequence of items [0, n), formatting them in parallel.
+// The caller provides a function that appends to a string
+// the records for a given item (for example, a GFA segment
+// or a FASTA sequence). Items are processed in chunks.
+// The threads format batches of a chunk in separate buffers,
+// which are then written out in order, with one write call per buffer.
+// The buffers are reused for all chunks, so after the first chunk
+// they are already large enough and don't need to be reallocated.
+// The output is identical to what we get when formatting the items
+// one at a time, in order, regardless of the number of threads.
+
+// Usage pattern:
+// ParallelWriter writer(gfa, threadCount);
+// writer.write(segmentCount,
+//     [&](uint64_t segmentId, string& s) {s += "S\t" + to_string(segmentId) + ...;});
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include <functional>
+#include "iostream.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class ParallelWriter;
+    extern template class MultithreadedObject<ParallelWriter>;
+}
+
+
+
+class shasta::ParallelWriter : public MultithreadedObject<ParallelWriter> {
+public:
+
+    // A threadCount of 0 means use all available hardware threads.
+    ParallelWriter(
+        ostream&,
+        size_t threadCount,
+        uint64_t batchSize = 1000);
+
+    // Append to the string the records for the given item.
+    // This is called by multiple threads, so it must be thread safe.
+    using FormatFunction = std::function<void(uint64_t itemId, string&)>;
+
+    // Write the records for items [0, n).
+    // Can be called more than once, to write different types of records.
+    void write(uint64_t n, const FormatFunction&);
+
+private:
+    ostream& s;
+    size_t threadCount;
+    uint64_t batchSize;
+
+    // The number of batches in each chunk.
+    uint64_t chunkBatchCount;
+
+    // Data used during a call to write.
+    const FormatFunction* formatFunction = 0;
+    uint64_t chunkBegin = 0;
+    vector<string> buffers;     // One for each batch of a chunk.
+    void threadFunction(size_t threadId);
+
+    void writeBuffers(uint64_t bufferCount);
+};
+
+#endif
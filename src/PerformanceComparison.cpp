@@ -0,0 +1,343 @@
+// Shasta.
+#include "PerformanceComparison.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cctype>
+#include <filesystem>
+#include "fstream.hpp"
+#include <iomanip>
+#include "iostream.hpp"
+#include <map>
+#include <sstream>
+#include "stdexcept.hpp"
+
+
+
+namespace shasta {
+    namespace {
+
+        // Parse one line of a performance trace, a JSON object with
+        // string and numeric values and no nested objects or arrays,
+        // as written by PerformanceSpan.
+        // The values are returned as strings, keyed by field name.
+        void parseTraceLine(const string& line, std::map<string, string>& fields)
+        {
+            fields.clear();
+            uint64_t i = line.find('{');
+            if(i == string::npos) {
+                throw runtime_error("Invalid performance trace line: " + line);
+            }
+            ++i;
+
+            const auto skipSpaces = [&]()
+            {
+                while(i < line.size() and std::isspace(static_cast<unsigned char>(line[i]))) {
+                    ++i;
+                }
+            };
+            const auto readString = [&]()
+            {
+                if(i >= line.size() or line[i] != '"') {
+                    throw runtime_error("Invalid performance trace line: " + line);
+                }
+                ++i;
+                string s;
+                while(i < line.size() and line[i] != '"') {
+                    if(line[i] == '\\' and i + 1 < line.size()) {
+                        ++i;
+                    }
+                    s.push_back(line[i++]);
+                }
+                if(i >= line.size()) {
+                    throw runtime_error("Invalid performance trace line: " + line);
+                }
+                ++i;
+                return s;
+            };
+
+            while(true) {
+                skipSpaces();
+                if(i < line.size() and line[i] == '}') {
+                    return;
+                }
+                const string key = readString();
+                skipSpaces();
+                if(i >= line.size() or line[i] != ':') {
+                    throw runtime_error("Invalid performance trace line: " + line);
+                }
+                ++i;
+                skipSpaces();
+                string value;
+                if(i < line.size() and line[i] == '"') {
+                    value = readString();
+                } else {
+                    while(i < line.size() and line[i] != ',' and line[i] != '}') {
+                        value.push_back(line[i++]);
+                    }
+                }
+                fields[key] = value;
+                skipSpaces();
+                if(i < line.size() and line[i] == ',') {
+                    ++i;
+                } else if(i >= line.size() or line[i] != '}') {
+                    throw runtime_error("Invalid performance trace line: " + line);
+                }
+            }
+        }
+
+        double getNumericField(const std::map<string, string>& fields, const string& key)
+        {
+            const auto it = fields.find(key);
+            return (it == fields.end() or it->second.empty()) ? 0. : std::stod(it->second);
+        }
+
+        // Format a metric value for the table.
+        string formatValue(const string& metricName, double value)
+        {
+            std::ostringstream s;
+            s << std::fixed;
+            if(metricName == "peakResidentBytes") {
+                s << std::setprecision(2) << value / double(1ULL << 30);
+            } else if(metricName == "wallSeconds" or metricName == "cpuSeconds") {
+                s << std::setprecision(1) << value;
+            } else {
+                s << std::setprecision(0) << value;
+            }
+            return s.str();
+        }
+    }
+}
+
+
+
+vector<PerformanceComparison::Span> PerformanceComparison::readTrace(const string& fileNameArgument)
+{
+    const string fileName = std::filesystem::is_directory(fileNameArgument) ?
+        (fileNameArgument + "/performance.jsonl") : fileNameArgument;
+    ifstream file(fileName);
+    if(not file) {
+        throw runtime_error("Error opening performance trace " + fileName);
+    }
+
+    vector<Span> spans;
+    std::map<string, uint64_t> spanIndex;
+    std::map<string, string> fields;
+    string line;
+    while(std::getline(file, line)) {
+        if(line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        parseTraceLine(line, fields);
+        const auto it = fields.find("name");
+        if(it == fields.end()) {
+            throw runtime_error("Missing span name in performance trace " + fileName + ": " + line);
+        }
+
+        // Find or create the Span for this name.
+        const auto jt = spanIndex.find(it->second);
+        uint64_t i;
+        if(jt == spanIndex.end()) {
+            i = spans.size();
+            spanIndex.insert(make_pair(it->second, i));
+            spans.resize(i + 1);
+            spans.back().name = it->second;
+            spans.back().depth = uint64_t(getNumericField(fields, "depth"));
+        } else {
+            i = jt->second;
+        }
+
+        Span& span = spans[i];
+        span.wallSeconds += getNumericField(fields, "wallSeconds");
+        span.cpuSeconds +=
+            getNumericField(fields, "userSeconds") +
+            getNumericField(fields, "systemSeconds");
+        span.peakResidentBytes = max(span.peakResidentBytes,
+            uint64_t(getNumericField(fields, "peakResidentBytes")));
+        span.majorFaults += uint64_t(getNumericField(fields, "majorFaults"));
+        span.minorFaults += uint64_t(getNumericField(fields, "minorFaults"));
+    }
+
+    if(spans.empty()) {
+        throw runtime_error("Performance trace " + fileName + " is empty.");
+    }
+    return spans;
+}
+
+
+
+PerformanceComparison::PerformanceComparison(
+    const string& baselineFileName,
+    const string& candidateFileName,
+    const Tolerances& tolerances) :
+    tolerances(tolerances)
+{
+    const vector<Span> baselineSpans = readTrace(baselineFileName);
+    const vector<Span> candidateSpans = readTrace(candidateFileName);
+
+    // Spans are listed in baseline order, followed by
+    // the spans only present in the candidate.
+    std::map<string, uint64_t> candidateIndex;
+    for(uint64_t i=0; i<candidateSpans.size(); i++) {
+        candidateIndex.insert(make_pair(candidateSpans[i].name, i));
+    }
+    std::map<string, uint64_t> baselineIndex;
+    for(uint64_t i=0; i<baselineSpans.size(); i++) {
+        baselineIndex.insert(make_pair(baselineSpans[i].name, i));
+    }
+
+    const auto addSpan = [&](const Span* baseline, const Span* candidate)
+    {
+        static const Span empty;
+        const Span& b = baseline ? *baseline : empty;
+        const Span& c = candidate ? *candidate : empty;
+        const bool isChecked = baseline and candidate;
+
+        SpanComparison span;
+        span.name = baseline ? baseline->name : candidate->name;
+        span.depth = baseline ? baseline->depth : candidate->depth;
+        span.isInBaseline = baseline;
+        span.isInCandidate = candidate;
+        span.metrics.push_back({"wallSeconds", b.wallSeconds, c.wallSeconds,
+            tolerances.timeTolerance, isChecked, tolerances.minSeconds});
+        span.metrics.push_back({"cpuSeconds", b.cpuSeconds, c.cpuSeconds,
+            tolerances.timeTolerance, isChecked, tolerances.minSeconds});
+        span.metrics.push_back({"peakResidentBytes",
+            double(b.peakResidentBytes), double(c.peakResidentBytes),
+            tolerances.memoryTolerance, isChecked, 0.});
+        span.metrics.push_back({"majorFaults",
+            double(b.majorFaults), double(c.majorFaults),
+            tolerances.faultTolerance, isChecked, double(minFaultIncrease)});
+        span.metrics.push_back({"minorFaults",
+            double(b.minorFaults), double(c.minorFaults),
+            0., false, 0.});
+        spans.push_back(span);
+    };
+
+    for(const Span& span: baselineSpans) {
+        const auto it = candidateIndex.find(span.name);
+        addSpan(&span, (it == candidateIndex.end()) ? 0 : &candidateSpans[it->second]);
+    }
+    for(const Span& span: candidateSpans) {
+        if(not baselineIndex.contains(span.name)) {
+            addSpan(0, &span);
+        }
+    }
+}
+
+
+
+bool PerformanceComparison::Metric::isRegression() const
+{
+    return
+        isChecked and
+        delta() > minIncrease and
+        delta() > tolerance * baseline;
+}
+
+
+
+bool PerformanceComparison::SpanComparison::isRegression() const
+{
+    for(const Metric& metric: metrics) {
+        if(metric.isRegression()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+uint64_t PerformanceComparison::regressionCount() const
+{
+    uint64_t n = 0;
+    for(const SpanComparison& span: spans) {
+        for(const Metric& metric: span.metrics) {
+            if(metric.isRegression()) {
+                ++n;
+            }
+        }
+    }
+    return n;
+}
+
+
+
+void PerformanceComparison::write(ostream& s) const
+{
+    s << "Baseline and candidate values for each span, with the relative change. "
+        "Regressions are marked with *." << endl;
+    s << std::left << std::setw(40) << "Span" << std::right;
+    const vector<string> headers = {
+        "Wall (s)", "CPU (s)", "Peak RSS (GiB)", "Major faults", "Minor faults"};
+    for(const string& header: headers) {
+        s << std::setw(28) << header;
+    }
+    s << endl;
+
+    for(const SpanComparison& span: spans) {
+
+        // Show the last component of the name, indented by depth.
+        const uint64_t slash = span.name.find_last_of('/');
+        const string shortName = string(2 * span.depth, ' ') +
+            ((slash == string::npos) ? span.name : span.name.substr(slash + 1));
+        s << std::left << std::setw(40) << shortName << std::right;
+
+        if(not span.isInBaseline) {
+            s << " only in candidate";
+        } else if(not span.isInCandidate) {
+            s << " only in baseline";
+        } else {
+            for(const Metric& metric: span.metrics) {
+                std::ostringstream cell;
+                cell << formatValue(metric.name, metric.baseline) << " -> " <<
+                    formatValue(metric.name, metric.candidate);
+                if(metric.baseline > 0.) {
+                    cell << " " << std::showpos << std::fixed << std::setprecision(0) <<
+                        100. * metric.relativeDelta() << "%";
+                }
+                if(metric.isRegression()) {
+                    cell << "*";
+                }
+                s << std::setw(28) << cell.str();
+            }
+        }
+        s << endl;
+    }
+
+    s << "Tolerances: time " << 100. * tolerances.timeTolerance <<
+        "% (increases under " << tolerances.minSeconds << " s ignored), "
+        "peak memory " << 100. * tolerances.memoryTolerance <<
+        "%, major page faults " << 100. * tolerances.faultTolerance <<
+        "% (increases under " << minFaultIncrease << " faults ignored)." << endl;
+}
+
+
+
+void PerformanceComparison::writeCsv(ostream& csv) const
+{
+    csv << "Span,Depth,Metric,Baseline,Candidate,Delta,RelativeDelta,Tolerance,Checked,Regression\n";
+    csv << std::fixed << std::setprecision(3);
+    for(const SpanComparison& span: spans) {
+        for(const Metric& metric: span.metrics) {
+            csv << span.name << ",";
+            csv << span.depth << ",";
+            csv << metric.name << ",";
+            if(span.isInBaseline) {
+                csv << metric.baseline;
+            }
+            csv << ",";
+            if(span.isInCandidate) {
+                csv << metric.candidate;
+            }
+            csv << ",";
+            csv << metric.delta() << ",";
+            csv << metric.relativeDelta() << ",";
+            csv << metric.tolerance << ",";
+            csv << (metric.isChecked ? "Yes" : "No") << ",";
+            csv << (metric.isRegression() ? "Yes" : "No") << "\n";
+        }
+    }
+}
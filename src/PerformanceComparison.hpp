@@ -0,0 +1,122 @@
+#ifndef SHASTA_PERFORMANCE_COMPARISON_HPP
+#define SHASTA_PERFORMANCE_COMPARISON_HPP
+
+/*******************************************************************************
+
+Comparison of the resources used by two runs, as recorded in their
+performance traces (performance.jsonl, written by PerformanceSpan),
+used by --command comparePerformance.
+
+For each span present in either run, the wall time, CPU time (user plus
+system), peak resident memory, and major and minor page faults
+are compared. If a span appears more than once in a trace
+(for example the top level span of an assembly resumed with --resumeFrom),
+its times and page faults are added and its peak resident memory
+is the maximum.
+
+A metric of a span is a regression if the candidate exceeds the baseline
+by more than the specified tolerance, as a fraction of the baseline:
+- Wall and CPU time use timeTolerance, and increases of less
+  than minSeconds are ignored, because short spans are noisy.
+- Peak resident memory uses memoryTolerance.
+- Major page faults use faultTolerance, and increases of less
+  than minFaultIncrease are ignored.
+Minor page faults are reported but never flagged.
+Spans present in only one of the two runs are reported but never flagged.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include "iosfwd.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class PerformanceComparison;
+}
+
+
+
+class shasta::PerformanceComparison {
+public:
+
+    class Tolerances {
+    public:
+        double timeTolerance = 0.2;
+        double memoryTolerance = 0.1;
+        double faultTolerance = 1.;
+        double minSeconds = 1.;
+    };
+    static const uint64_t minFaultIncrease = 1000;
+
+    // The resources used by one span, as recorded in a performance trace.
+    class Span {
+    public:
+        string name;
+        uint64_t depth = 0;
+        double wallSeconds = 0.;
+        double cpuSeconds = 0.;
+        uint64_t peakResidentBytes = 0;
+        uint64_t majorFaults = 0;
+        uint64_t minorFaults = 0;
+    };
+
+    // Read a performance trace, combining spans with the same name.
+    // The spans are returned in order of first appearance.
+    // If fileName is a directory, performance.jsonl in that directory is used.
+    static vector<Span> readTrace(const string& fileName);
+
+    PerformanceComparison(
+        const string& baselineFileName,
+        const string& candidateFileName,
+        const Tolerances&);
+
+    // The comparison of one metric of one span.
+    class Metric {
+    public:
+        string name;
+        double baseline;
+        double candidate;
+        double tolerance;
+
+        // False if this metric is reported but never flagged.
+        bool isChecked;
+
+        // The minimum absolute increase that can be flagged.
+        double minIncrease;
+
+        double delta() const
+        {
+            return candidate - baseline;
+        }
+        double relativeDelta() const
+        {
+            return (baseline > 0.) ? delta() / baseline : 0.;
+        }
+        bool isRegression() const;
+    };
+
+    class SpanComparison {
+    public:
+        string name;
+        uint64_t depth;
+        bool isInBaseline;
+        bool isInCandidate;
+        vector<Metric> metrics;
+        bool isRegression() const;
+    };
+    vector<SpanComparison> spans;
+
+    uint64_t regressionCount() const;
+
+    // Write a human readable table.
+    void write(ostream&) const;
+
+    // Write one line for each metric of each span in csv format.
+    void writeCsv(ostream&) const;
+
+private:
+    Tolerances tolerances;
+};
+
+#endif
@@ -23,7 +23,20 @@ template class MultithreadedObject<PhasingGraph>;
 
 void PhasingGraphEdge::runBayesianModel(double epsilon, bool allowRandomHypothesis)
 {
+    double logPin, logPout;
     tie(logPin, logPout) = diploidBayesianPhase(matrix, epsilon);
+    storeBayesianModelResults(logPin, logPout, allowRandomHypothesis);
+}
+
+
+
+void PhasingGraphEdge::storeBayesianModelResults(
+    double logPinArgument,
+    double logPoutArgument,
+    bool allowRandomHypothesis)
+{
+    logPin = logPinArgument;
+    logPout = logPoutArgument;
 
     if(allowRandomHypothesis) {
 
@@ -188,9 +201,21 @@ void PhasingGraph::createEdges(
 
     // Create a vector of all vertices, to be processed
     // one by one in parallel.
-    createEdgesData.allVertices.clear();
+    // The work for each vertex is roughly proportional to the number of
+    // its oriented reads, so process vertices in order of decreasing
+    // number of oriented reads. This way the largest vertices start first
+    // and don't delay the end of the computation.
+    vector< pair<PhasingGraph::vertex_descriptor, uint64_t> > vertexTable;
     BGL_FORALL_VERTICES(v, phasingGraph, PhasingGraph) {
-        createEdgesData.allVertices.push_back(v);
+        const PhasingGraphVertex& vertex = phasingGraph[v];
+        vertexTable.push_back(make_pair(v,
+            vertex.orientedReadIds[0].size() + vertex.orientedReadIds[1].size()));
+    }
+    std::stable_sort(vertexTable.begin(), vertexTable.end(),
+        OrderPairsBySecondOnlyGreater<PhasingGraph::vertex_descriptor, uint64_t>());
+    createEdgesData.allVertices.clear();
+    for(const auto& p: vertexTable) {
+        createEdgesData.allVertices.push_back(p.first);
     }
 
     // Store the parameters so all threads can see them.
@@ -202,9 +227,27 @@ void PhasingGraph::createEdges(
 
     // Process all vertices in parallel.
     const uint64_t batchSize = 100;
+    createEdgesData.edges.clear();
     setupLoadBalancing(createEdgesData.allVertices.size(), batchSize);
     runThreads(&PhasingGraph::createEdgesThreadFunction, threadCount);
 
+    // Add the edges in order of their vertices.
+    // This is the order in which they are found when using a single thread
+    // and processing vertices in order, and it makes the PhasingGraph
+    // (and therefore the optimal spanning tree and the phasing)
+    // independent of the number of threads.
+    auto& edges = createEdgesData.edges;
+    sort(edges.begin(), edges.end(),
+        [](const auto& x, const auto& y)
+        {
+            return make_pair(get<0>(x), get<1>(x)) < make_pair(get<0>(y), get<1>(y));
+        });
+    for(const auto& t: edges) {
+        add_edge(get<0>(t), get<1>(t), get<2>(t), phasingGraph);
+    }
+    edges.clear();
+    edges.shrink_to_fit();
+
     performanceLog << timestamp << "AssemblyGraph2::PhasingGraph::createEdges ends." << endl;
 }
 
@@ -212,14 +255,13 @@ void PhasingGraph::createEdges(
 
 void PhasingGraph::createEdgesThreadFunction(size_t threadId)
 {
-    PhasingGraph& phasingGraph = *this;
-
     const uint64_t minConcordantReadCount = createEdgesData.minConcordantReadCount;
     const uint64_t maxDiscordantReadCount = createEdgesData.maxDiscordantReadCount;
     const double minLogP = createEdgesData.minLogP;
     const double epsilon = createEdgesData.epsilon;
     const bool allowRandomHypothesis = createEdgesData.allowRandomHypothesis;
     vector<CreateEdgesData::EdgeData> edgeData;
+    CreateEdgesData::BayesianBatch bayesianBatch;
 
     // Temporary storage of the edges found by this thread.
     vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> > threadEdges;
@@ -233,18 +275,13 @@ void PhasingGraph::createEdgesThreadFunction(size_t threadId)
             createEdges(createEdgesData.allVertices[i],
                 minConcordantReadCount,
                 maxDiscordantReadCount,
-                minLogP, epsilon, edgeData, threadEdges,
+                minLogP, epsilon, edgeData, bayesianBatch, threadEdges,
                 allowRandomHypothesis);
         }
     }
 
     std::lock_guard<std::mutex> lock(mutex);
-    for(const auto& t: threadEdges) {
-        const vertex_descriptor v0 = get<0>(t);
-        const vertex_descriptor v1 = get<1>(t);
-        const PhasingGraphEdge&  edge = get<2>(t);
-        add_edge(v0, v1, edge, phasingGraph);
-    }
+    copy(threadEdges.begin(), threadEdges.end(), back_inserter(createEdgesData.edges));
 }
 
 
@@ -258,6 +295,7 @@ void PhasingGraph::createEdges(
     double minLogP,
     double epsilon,
     vector<CreateEdgesData::EdgeData>& edgeData,
+    CreateEdgesData::BayesianBatch& bayesianBatch,
     vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> >& threadEdges,
     bool allowRandomHypothesis)
 {
@@ -292,8 +330,10 @@ void PhasingGraph::createEdges(
     // Sort the EdgeData by vB.
     sort(edgeData.begin(), edgeData.end());
 
-    // Each streak with the same vB generates an edge, if there
+    // Each streak with the same vB generates a candidate edge, if there
     // is a sufficient number of reads.
+    bayesianBatch.edges.clear();
+    bayesianBatch.matrices.clear();
     for(auto it=edgeData.begin(); it!=edgeData.end();  /* Increment later */) {
 
         auto streakBegin = it;
@@ -313,18 +353,26 @@ void PhasingGraph::createEdges(
 
             if( (edge.concordantCount() >= minConcordantReadCount) and
                 (edge.discordantCount() <= maxDiscordantReadCount)) {
-
-                edge.runBayesianModel(epsilon, allowRandomHypothesis);
-
-                if(edge.logP > minLogP) {
-                    threadEdges.push_back(make_tuple(vA, vB, edge));
-                }
+                bayesianBatch.edges.push_back(make_pair(vB, edge));
+                bayesianBatch.matrices.push_back(edge.matrix);
             }
         }
 
         // Prepare to process the next streak.
         it = streakEnd;
     }
+
+    // Run the Bayesian model for all the candidate edges
+    // and keep the ones with sufficient logP.
+    diploidBayesianPhase(bayesianBatch.matrices, epsilon, bayesianBatch.logPin, bayesianBatch.logPout);
+    for(uint64_t i=0; i<bayesianBatch.edges.size(); i++) {
+        const vertex_descriptor vB = bayesianBatch.edges[i].first;
+        PhasingGraphEdge& edge = bayesianBatch.edges[i].second;
+        edge.storeBayesianModelResults(bayesianBatch.logPin[i], bayesianBatch.logPout[i], allowRandomHypothesis);
+        if(edge.logP > minLogP) {
+            threadEdges.push_back(make_tuple(vA, vB, edge));
+        }
+    }
 }
 
 
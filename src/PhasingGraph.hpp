@@ -107,6 +107,10 @@ public:
     uint64_t relativePhase; // 0 = in phase, 1 = out of phase
     void runBayesianModel(double epsilon, bool allowRandomHypothesis);
 
+    // Store logPin and logPout, computed by the batch version of diploidBayesianPhase,
+    // and compute logP and relativePhase.
+    void storeBayesianModelResults(double logPin, double logPout, bool allowRandomHypothesis);
+
 
 
     bool isTreeEdge = false;
@@ -191,7 +195,27 @@ private:
         double minLogP;
         double epsilon; // For Bayesian model.
         bool allowRandomHypothesis;
+
+        // The vertices to be processed, in order of decreasing number of
+        // oriented reads, so the most expensive vertices are processed first.
         vector<PhasingGraph::vertex_descriptor> allVertices;
+
+        // The edges found by all threads. They are sorted before
+        // being added to the PhasingGraph, so the PhasingGraph
+        // does not depend on the number of threads or on timing.
+        vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> > edges;
+
+        // The candidate edges for one vertex, so the Bayesian model
+        // can be evaluated for all of them with a single call
+        // to the batch version of diploidBayesianPhase.
+        class BayesianBatch {
+        public:
+            vector< pair<vertex_descriptor, PhasingGraphEdge> > edges;
+            vector< array<array<uint64_t, 2>, 2> > matrices;
+            vector<double> logPin;
+            vector<double> logPout;
+        };
+
         class EdgeData {
         public:
             PhasingGraph::vertex_descriptor vB;
@@ -211,6 +235,7 @@ private:
         double minLogP,
         double epsilon,
         vector<CreateEdgesData::EdgeData>&,
+        CreateEdgesData::BayesianBatch&,
         vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> >& threadEdges,
         bool allowRandomHypothesis);
 
@@ -6,7 +6,9 @@
 #include "AssemblerOptions.hpp"
 #include "AssemblyGraph.hpp"
 #include "Base.hpp"
+#include "benchmarkKernels.hpp"
 #include "CompactUndirectedGraph.hpp"
+#include "Coverage.hpp"
 #include "compressAlignment.hpp"
 #include "ConfigurationTable.hpp"
 #include "deduplicate.hpp"
@@ -38,6 +40,152 @@ using namespace pybind11;
 
 
 
+// Functions used to expose MemoryMapped::Vector and MemoryMapped::VectorOfVectors
+// objects of the Assembler to Python as read-only NumPy arrays
+// that use the mapped memory directly, without copying.
+// Each array keeps a reference to the Python Assembler object,
+// so the Assembler cannot be destroyed while the array is in use.
+// However, the arrays become invalid if the data they refer to
+// are recreated, closed, or accessed again, so they should be
+// obtained again after any such operation.
+// Fields of type Uint24 and Uint40, for which NumPy has no types,
+// are exposed as arrays of 3 or 5 bytes (little endian),
+// and bit fields are exposed as the byte that contains them.
+namespace {
+
+    // Byte offset of a field within an object.
+    template<class T, class F> ssize_t fieldOffset(const T& object, const F& field)
+    {
+        return reinterpret_cast<const char*>(&field) - reinterpret_cast<const char*>(&object);
+    }
+
+    // Helper class to construct a NumPy structured dtype.
+    class StructuredDtype {
+    public:
+        void add(const char* name, const char* format, ssize_t offset)
+        {
+            names.append(name);
+            formats.append(format);
+            offsets.append(offset);
+        }
+        pybind11::dtype get(size_t itemSize) const
+        {
+            return pybind11::dtype(names, formats, offsets, ssize_t(itemSize));
+        }
+    private:
+        pybind11::list names;
+        pybind11::list formats;
+        pybind11::list offsets;
+    };
+
+    template<class T> pybind11::array vectorArray(
+        const MemoryMapped::Vector<T>& v,
+        const pybind11::dtype& dtype,
+        const object& owner)
+    {
+        if(not v.isOpen) {
+            throw runtime_error("Data " + v.memoryUsageName + " are not accessible.");
+        }
+        SHASTA_ASSERT(size_t(dtype.itemsize()) == sizeof(T));
+        pybind11::array a(
+            dtype,
+            vector<ssize_t>{ssize_t(v.size())},
+            vector<ssize_t>{ssize_t(sizeof(T))},
+            v.begin(),
+            owner);
+        a.attr("setflags")(arg("write") = false);
+        return a;
+    }
+
+    // For a VectorOfVectors, return a tuple (toc, data).
+    // The data for vector i are data[toc[i]:toc[i+1]].
+    template<class T, class Int> pybind11::tuple vectorOfVectorsArrays(
+        const MemoryMapped::VectorOfVectors<T, Int>& v,
+        const pybind11::dtype& tocDtype,
+        const pybind11::dtype& dataDtype,
+        const object& owner)
+    {
+        return make_tuple(
+            vectorArray(v.getToc(), tocDtype, owner),
+            vectorArray(v.getData(), dataDtype, owner));
+    }
+
+    // A structured dtype with a single field of n bytes,
+    // used for Uint24 and Uint40.
+    template<class T> pybind11::dtype bytesDtype()
+    {
+        StructuredDtype d;
+        const string format = "(" + to_string(sizeof(T)) + ",)u1";
+        d.add("bytes", format.c_str(), 0);
+        return d.get(sizeof(T));
+    }
+
+    pybind11::dtype compressedMarkerDtype()
+    {
+        static_assert(sizeof(CompressedMarker) == 3);
+        StructuredDtype d;
+        d.add("position", "(3,)u1", 0);
+        return d.get(sizeof(CompressedMarker));
+    }
+
+    pybind11::dtype alignmentDataDtype()
+    {
+        const CompactAlignmentData x;
+        StructuredDtype d;
+        d.add("readIds", "(2,)u4", fieldOffset(x, x.readIds));
+        d.add("isSameStrand", "u1", fieldOffset(x, x.isSameStrand));
+        d.add("isInReadGraph", "u1", fieldOffset(x, x.isInReadGraph));
+        d.add("markerCount", "u4", fieldOffset(x, x.markerCount));
+        return d.get(sizeof(CompactAlignmentData));
+    }
+
+    pybind11::dtype alignmentInfoDtype()
+    {
+        const AlignmentInfo x;
+        StructuredDtype d;
+        for(uint64_t i=0; i<2; i++) {
+            const string suffix = to_string(i);
+            d.add(("markerCount" + suffix).c_str(), "u4", fieldOffset(x, x.data[i].markerCount));
+            d.add(("firstOrdinal" + suffix).c_str(), "u4", fieldOffset(x, x.data[i].firstOrdinal));
+            d.add(("lastOrdinal" + suffix).c_str(), "u4", fieldOffset(x, x.data[i].lastOrdinal));
+        }
+        d.add("markerCount", "u4", fieldOffset(x, x.markerCount));
+        d.add("minOrdinalOffset", "i4", fieldOffset(x, x.minOrdinalOffset));
+        d.add("maxOrdinalOffset", "i4", fieldOffset(x, x.maxOrdinalOffset));
+        d.add("averageOrdinalOffset", "i4", fieldOffset(x, x.averageOrdinalOffset));
+        d.add("maxSkip", "u4", fieldOffset(x, x.maxSkip));
+        d.add("maxDrift", "u4", fieldOffset(x, x.maxDrift));
+        return d.get(sizeof(AlignmentInfo));
+    }
+
+    pybind11::dtype markerGraphEdgeDtype()
+    {
+        static_assert(sizeof(MarkerGraph::Edge) == 13);
+        const MarkerGraph::Edge x;
+        StructuredDtype d;
+        d.add("source", "(5,)u1", fieldOffset(x, x.source));
+        d.add("target", "(5,)u1", fieldOffset(x, x.target));
+
+        // The bit fields before and after isSecondary each occupy one byte.
+        const ssize_t isSecondaryOffset = fieldOffset(x, x.isSecondary);
+        d.add("flags", "u1", isSecondaryOffset - 1);
+        d.add("isSecondary", "u1", isSecondaryOffset);
+        d.add("flags2", "u1", isSecondaryOffset + 1);
+        return d.get(sizeof(MarkerGraph::Edge));
+    }
+
+    pybind11::dtype markerIntervalDtype()
+    {
+        const MarkerInterval x;
+        StructuredDtype d;
+        d.add("orientedReadId", "u4", fieldOffset(x, x.orientedReadId));
+        d.add("ordinals", "(2,)u4", fieldOffset(x, x.ordinals));
+        return d.get(sizeof(MarkerInterval));
+    }
+}
+
+
+
 PYBIND11_MODULE(shasta, shastaModule)
 {
 
@@ -130,11 +278,28 @@ PYBIND11_MODULE(shasta, shastaModule)
         .def_readwrite("suppressDetailedOutput", &Mode2AssemblyOptions::suppressDetailedOutput)
         .def_readwrite("suppressPhasedOutput", &Mode2AssemblyOptions::suppressPhasedOutput)
         .def_readwrite("suppressHaploidOutput", &Mode2AssemblyOptions::suppressHaploidOutput)
+        .def_readwrite("bgzfOutput", &Mode2AssemblyOptions::bgzfOutput)
+        ;
+
+
+
+    // Expose class BatchProgress to Python, see getBatchProgress below.
+    class_<BatchProgress>(shastaModule, "BatchProgress")
+        .def_readonly("jobCount", &BatchProgress::jobCount)
+        .def_readonly("itemsDone", &BatchProgress::itemsDone)
+        .def_readonly("itemsTotal", &BatchProgress::itemsTotal)
+        .def_readonly("seconds", &BatchProgress::seconds)
         ;
 
 
 
     // Expose class Assembler to Python.
+    // Long running computations use call_guard<gil_scoped_release>,
+    // so other Python threads can run while they execute,
+    // for example to poll progress via getBatchProgress
+    // and getCurrentPerformanceSpan.
+    // The Assembler is not thread safe, so Python threads
+    // must not call other Assembler functions while this happens.
     class_<Assembler>(shastaModule, "Assembler")
 
         // Constructor.
@@ -165,6 +330,7 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::accessMarkers)
         .def("findMarkers",
             &Assembler::findMarkers,
+            call_guard<gil_scoped_release>(),
             "Find markers in reads.",
             arg("threadCount") = 0)
         .def("writeMarkers",
@@ -179,14 +345,23 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("fileName"))
         .def("computeSortedMarkers",
             &Assembler::computeSortedMarkers,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("accessSortedMarkers",
             &Assembler::accessSortedMarkers)
+        .def("createReadSequenceIndex",
+            &Assembler::createReadSequenceIndex,
+            call_guard<gil_scoped_release>(),
+            arg("step") = 16,
+            arg("threadCount") = 0)
+        .def("accessReadSequenceIndex",
+            &Assembler::accessReadSequenceIndex)
 
 
         // Alignment candidates.
         .def("findAlignmentCandidatesLowHash0",
             &Assembler::findAlignmentCandidatesLowHash0,
+            call_guard<gil_scoped_release>(),
             arg("m"),
             arg("hashFraction"),
             arg("minHashIterationCount"),
@@ -195,7 +370,25 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("minBucketSize"),
             arg("maxBucketSize"),
             arg("minFrequency"),
+            arg("threadCount") = 0,
+            arg("oldReadCount") = 0)
+        .def("findAlignmentCandidatesLowHash0Shard",
+            &Assembler::findAlignmentCandidatesLowHash0Shard,
+            call_guard<gil_scoped_release>(),
+            arg("m"),
+            arg("hashFraction"),
+            arg("minHashIterationCount"),
+            arg("log2MinHashBucketCount") = 0,
+            arg("minBucketSize"),
+            arg("maxBucketSize"),
+            arg("shardCount"),
+            arg("shardId"),
+            arg("shardFileName"),
             arg("threadCount") = 0)
+        .def("mergeAlignmentCandidateShards",
+            &Assembler::mergeAlignmentCandidateShards,
+            arg("shardFileNames"),
+            arg("minFrequency"))
         .def("accessAlignmentCandidates",
             &Assembler::accessAlignmentCandidates)
         .def("accessAlignmentCandidateTable",
@@ -210,6 +403,7 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("fileName") = "OverlappingReads.fasta")
         .def("flagPalindromicReads",
             &Assembler::flagPalindromicReads,
+            call_guard<gil_scoped_release>(),
             arg("maxSkip"),
             arg("maxDrift"),
             arg("maxMarkerFrequency"),
@@ -300,7 +494,11 @@ PYBIND11_MODULE(shasta, shastaModule)
 
         // Compute an alignment for each alignment candidate.
         .def("computeAlignments",
-            &Assembler::computeAlignments)
+            &Assembler::computeAlignments,
+            call_guard<gil_scoped_release>(),
+            arg("alignOptions"),
+            arg("threadCount"),
+            arg("workerPort") = 0)
         .def("accessCompressedAlignments",
             &Assembler::accessCompressedAlignments)
         .def("accessAlignmentData",
@@ -319,18 +517,24 @@ PYBIND11_MODULE(shasta, shastaModule)
         // Undirected read graph
         .def("createReadGraph",
             &Assembler::createReadGraph,
+            call_guard<gil_scoped_release>(),
             arg("maxAlignmentCount"),
-            arg("maxTrim"))
+            arg("maxTrim"),
+            arg("threadCount") = 0,
+            arg("useAlignmentCriteria") = false)
         .def("createReadGraph2",
              &Assembler::createReadGraph2,
+             call_guard<gil_scoped_release>(),
             arg("maxAlignmentCount"),
             arg("markerCountPercentile"),
             arg("alignedFractionPercentile"),
             arg("maxSkipPercentile"),
             arg("maxDriftPercentile"),
-            arg("maxTrimPercentile"))
+            arg("maxTrimPercentile"),
+            arg("threadCount") = 0)
         .def("createReadGraphUsingPseudoPaths",
              &Assembler::createReadGraphUsingPseudoPaths,
+             call_guard<gil_scoped_release>(),
              arg("matchScore"),
              arg("mismatchScore"),
              arg("gapScore"),
@@ -345,16 +549,29 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::accessReadGraphReadWrite)
         .def("flagCrossStrandReadGraphEdges1",
             &Assembler::flagCrossStrandReadGraphEdges1,
+            call_guard<gil_scoped_release>(),
             arg("maxDistance"),
             arg("threadCount") = 0)
         .def("flagCrossStrandReadGraphEdges2",
             &Assembler::flagCrossStrandReadGraphEdges2)
         .def("flagChimericReads",
              &Assembler::flagChimericReads,
+             call_guard<gil_scoped_release>(),
             arg("maxChimericReadDistance"),
             arg("threadCount") = 0)
         .def("computeReadGraphConnectedComponents",
-            &Assembler::computeReadGraphConnectedComponents)
+            &Assembler::computeReadGraphConnectedComponents,
+            call_guard<gil_scoped_release>(),
+            arg("threadCount") = 0)
+        .def("renumberReads",
+            &Assembler::renumberReads,
+            call_guard<gil_scoped_release>(),
+            arg("threadCount") = 0)
+        .def("accessOriginalReadIds",
+            &Assembler::accessOriginalReadIds)
+        .def("getOriginalReadId",
+            &Assembler::getOriginalReadId,
+            arg("readId"))
         .def("writeLocalReadGraphReads",
             &Assembler::writeLocalReadGraphReads,
             arg("readId"),
@@ -365,7 +582,9 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("allowInconsistentAlignmentEdges"))
         .def("removeReadGraphBridges",
              &Assembler::removeReadGraphBridges,
-             arg("maxDistance"))
+             call_guard<gil_scoped_release>(),
+             arg("maxDistance"),
+             arg("threadCount") = 0)
         .def("analyzeReadGraph",
              &Assembler::analyzeReadGraph)
         .def("readGraphClustering",
@@ -375,6 +594,7 @@ PYBIND11_MODULE(shasta, shastaModule)
              arg("useReadName") = false)
         .def("flagInconsistentAlignments",
              &Assembler::flagInconsistentAlignments,
+             call_guard<gil_scoped_release>(),
              arg("triangleErrorThreshold"),
              arg("leastSquareErrorThreshold"),
              arg("leastSquareMaxDistance"),
@@ -385,13 +605,16 @@ PYBIND11_MODULE(shasta, shastaModule)
         // Global marker graph.
         .def("createMarkerGraphVertices",
             &Assembler::createMarkerGraphVertices,
+            call_guard<gil_scoped_release>(),
             arg("minCoverage"),
             arg("maxCoverage"),
             arg("minCoveragePerStrand"),
             arg("allowDuplicateMarkers"),
             arg("peakFinderMinAreaFraction"),
             arg("peakFinderAreaStartIndex"),
-            arg("threadCount") = 0)
+            arg("threadCount") = 0,
+            arg("shardCount") = 1,
+            arg("externalMemoryBudget") = 0.)
         .def("accessMarkerGraphVertices",
              &Assembler::accessMarkerGraphVertices,
              arg("readWriteAccess") = false)
@@ -413,17 +636,24 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("vertexId"))
         .def("findMarkerGraphReverseComplementVertices",
             &Assembler::findMarkerGraphReverseComplementVertices,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("accessMarkerGraphReverseComplementVertex",
             &Assembler::accessMarkerGraphReverseComplementVertex,
             arg("readWriteAccess") = false)
+        .def("renumberMarkerGraphVertices",
+            &Assembler::renumberMarkerGraphVertices,
+            call_guard<gil_scoped_release>(),
+            arg("threadCount") = 0)
         .def("findMarkerGraphReverseComplementEdges",
             &Assembler::findMarkerGraphReverseComplementEdges,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("accessMarkerGraphReverseComplementEdge",
             &Assembler::accessMarkerGraphReverseComplementEdge)
         .def("checkMarkerGraphIsStrandSymmetric",
             &Assembler::checkMarkerGraphIsStrandSymmetric,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("computeMarkerGraphCoverageHistogram",
             &Assembler::computeMarkerGraphCoverageHistogram)
@@ -431,6 +661,7 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::writeBadMarkerGraphVertices)
         .def("cleanupDuplicateMarkers",
             &Assembler::cleanupDuplicateMarkers,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0,
             arg("minCoverage"),
             arg("minCoveragePerStrand"),
@@ -443,9 +674,11 @@ PYBIND11_MODULE(shasta, shastaModule)
         // Edges of the global marker graph.
         .def("createMarkerGraphEdges",
             &Assembler::createMarkerGraphEdges,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("createMarkerGraphEdgesStrict",
             &Assembler::createMarkerGraphEdgesStrict,
+            call_guard<gil_scoped_release>(),
             arg("minEdgeCoverage"),
             arg("minEdgeCoveragePerStrand"),
             arg("threadCount") = 0)
@@ -454,6 +687,7 @@ PYBIND11_MODULE(shasta, shastaModule)
                 void (Assembler::*) (uint32_t, size_t)
             )
             &Assembler::createMarkerGraphSecondaryEdges,
+            call_guard<gil_scoped_release>(),
             arg("secondaryEdgeMaxSkip"),
             arg("threadCount") = 0)
         .def("clusterMarkerGraphEdgeOrientedReads",
@@ -463,6 +697,7 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("debug") = false)
         .def("splitMarkerGraphSecondaryEdges",
             &Assembler::splitMarkerGraphSecondaryEdges,
+            call_guard<gil_scoped_release>(),
             arg("errorRateThreshold"),
             arg("minCoverage"),
             arg("threadCount") = 0)
@@ -470,6 +705,11 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::accessMarkerGraphEdges,
             arg("accessEdgesReadWrite") = false,
             arg("accessConnectivityReadWrite") = false)
+        .def("createMarkerGraphEdgeOrientedReadIds",
+            &Assembler::createMarkerGraphEdgeOrientedReadIds,
+            arg("threadCount") = 0)
+        .def("accessMarkerGraphEdgeOrientedReadIds",
+            &Assembler::accessMarkerGraphEdgeOrientedReadIds)
         .def("transitiveReduction",
             &Assembler::transitiveReduction,
             arg("lowCoverageThreshold"),
@@ -478,21 +718,25 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("edgeMarkerSkipThreshold"))
         .def("pruneMarkerGraphStrongSubgraph",
             &Assembler::pruneMarkerGraphStrongSubgraph,
-            arg("iterationCount"))
+            arg("iterationCount"),
+            arg("threadCount") = 0)
         .def("simplifyMarkerGraph",
             &Assembler::simplifyMarkerGraph,
             arg("maxLength"),
             arg("debug") = false)
         .def("assembleMarkerGraphVertices",
             &Assembler::assembleMarkerGraphVertices,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("accessMarkerGraphVertexRepeatCounts",
             &Assembler::accessMarkerGraphVertexRepeatCounts)
         .def("computeMarkerGraphVerticesCoverageData",
             &Assembler::computeMarkerGraphVerticesCoverageData,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("assembleMarkerGraphEdges",
             &Assembler::assembleMarkerGraphEdges,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0,
             arg("markerGraphEdgeLengthThresholdForConsensus"),
             arg("storeCoverageData"),
@@ -515,7 +759,8 @@ PYBIND11_MODULE(shasta, shastaModule)
 
         // Assembly graph.
         .def("createAssemblyGraphEdges",
-            &Assembler::createAssemblyGraphEdges)
+            &Assembler::createAssemblyGraphEdges,
+            arg("threadCount") = 0)
         .def("createAssemblyGraphVertices",
             &Assembler::createAssemblyGraphVertices)
         .def("accessAssemblyGraphEdgeLists",
@@ -530,6 +775,7 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::writeAssemblyGraph)
         .def("assemble",
             &Assembler::assemble,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0,
             arg("storeCoverageDataCsvLengthThreshold") = 0)
         .def("accessAssemblyGraphSequences",
@@ -538,13 +784,16 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::computeAssemblyStatistics)
         .def("writeGfa1",
             &Assembler::writeGfa1,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
         .def("writeGfa1BothStrands",
             &Assembler::writeGfa1BothStrands,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
         .def("writeFasta",
             &Assembler::writeFasta,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
         .def("colorGfaWithTwoReads",
             &Assembler::colorGfaWithTwoReads,
             arg("readId0"),
@@ -560,6 +809,9 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("readId"),
             arg("strand"),
             arg("fileName") = "OrientedReadPath.csv")
+        .def("computePseudoPaths",
+            &Assembler::computePseudoPaths,
+            arg("threadCount") = 0)
         .def("writePseudoPath",
             &Assembler::writePseudoPath,
             arg("readId"),
@@ -579,16 +831,19 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("storeCoverageData") = true)
         .def("gatherOrientedReadsByAssemblyGraphEdge",
             &Assembler::gatherOrientedReadsByAssemblyGraphEdge,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("writeOrientedReadsByAssemblyGraphEdge",
             &Assembler::writeOrientedReadsByAssemblyGraphEdge)
         .def("detangle",
-            &Assembler::detangle)
+            &Assembler::detangle,
+            arg("threadCount") = 0)
         .def("detangle2",
             &Assembler::detangle2,
             arg("diagonalReadCountMin"),
             arg("offDiagonalReadCountMax"),
-            arg("offDiagonalRatio"))
+            arg("offDiagonalRatio"),
+            arg("threadCount") = 0)
         .def("alignPseudoPaths",
             &Assembler::alignPseudoPaths)
         .def("removeAssemblyGraph",
@@ -599,6 +854,7 @@ PYBIND11_MODULE(shasta, shastaModule)
         // Assembly mode 2.
         .def("createAssemblyGraph2",
             &Assembler::createAssemblyGraph2,
+            call_guard<gil_scoped_release>(),
             arg("pruneLength"),
             arg("mode2Options"),
             arg("threadCount") = 0,
@@ -607,6 +863,7 @@ PYBIND11_MODULE(shasta, shastaModule)
         // Assembly mode 3.
         .def("mode3Assembly",
             &Assembler::mode3Assembly,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("accessMode3AssemblyGraph",
             &Assembler::accessMode3AssemblyGraph)
@@ -618,11 +875,17 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::createMode3Detangler)
         .def("mode3aAssembly",
             &Assembler::mode3aAssembly,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("findCompleteMarkerGraphPath",
             &Assembler::findCompleteMarkerGraphPath)
         .def("findCompleteMarkerGraphPaths",
             &Assembler::findCompleteMarkerGraphPaths,
+            call_guard<gil_scoped_release>(),
+            arg("threadCount") = 0)
+        .def("findCompleteMarkerGraphPrimaryPaths",
+            &Assembler::findCompleteMarkerGraphPrimaryPaths,
+            call_guard<gil_scoped_release>(),
             arg("threadCount") = 0)
         .def("findMode3bPaths",
             &Assembler::findMode3bPaths,
@@ -648,6 +911,85 @@ PYBIND11_MODULE(shasta, shastaModule)
 
 
 
+        // Read-only NumPy views of Assembler data, without copying.
+        // See the comments before PYBIND11_MODULE for more information.
+        // For data stored as a MemoryMapped::VectorOfVectors,
+        // these return a tuple (toc, data).
+        .def("getMarkersArrays",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorOfVectorsArrays(assembler.markers,
+                    pybind11::dtype::of<uint64_t>(), compressedMarkerDtype(), self);
+            })
+        .def("getAlignmentDataArray",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorArray(assembler.getAlignmentData(), alignmentDataDtype(), self);
+            })
+        .def("getAlignmentInfosArray",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorArray(assembler.getAlignmentInfos(), alignmentInfoDtype(), self);
+            })
+        .def("getMarkerGraphVerticesArrays",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorOfVectorsArrays(assembler.markerGraph.vertices(),
+                    bytesDtype<MarkerGraph::CompressedVertexId>(), pybind11::dtype::of<MarkerId>(), self);
+            })
+        .def("getMarkerGraphVertexTableArray",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorArray(assembler.markerGraph.vertexTable,
+                    bytesDtype<MarkerGraph::CompressedVertexId>(), self);
+            })
+        .def("getMarkerGraphEdgesArray",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorArray(assembler.markerGraph.edges, markerGraphEdgeDtype(), self);
+            })
+        .def("getMarkerGraphEdgeMarkerIntervalsArrays",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorOfVectorsArrays(assembler.markerGraph.edgeMarkerIntervals,
+                    pybind11::dtype::of<uint64_t>(), markerIntervalDtype(), self);
+            })
+        .def("getMarkerGraphVertexCoverageDataArrays",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorOfVectorsArrays(assembler.markerGraph.vertexCoverageData.getData(),
+                    pybind11::dtype::of<uint64_t>(), pybind11::dtype::of<uint8_t>(), self);
+            })
+        .def("getMarkerGraphEdgeCoverageDataArrays",
+            [](const object& self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return vectorOfVectorsArrays(assembler.markerGraph.edgeCoverageData.getData(),
+                    pybind11::dtype::of<uint64_t>(), pybind11::dtype::of<uint8_t>(), self);
+            })
+        .def("getMarkerGraphVertexCoverageData",
+            [](const Assembler& assembler, MarkerGraphVertexId vertexId)
+            {
+                return assembler.markerGraph.vertexCoverageData.get(vertexId);
+            },
+            arg("vertexId"))
+        .def("getMarkerGraphEdgeCoverageData",
+            [](const Assembler& assembler, MarkerGraphEdgeId edgeId)
+            {
+                return assembler.markerGraph.edgeCoverageData.get(edgeId);
+            },
+            arg("edgeId"))
+
+
+
         .def("test", &Assembler::test)
 
         // Definition of class_Assembler ends here.
@@ -687,6 +1029,31 @@ PYBIND11_MODULE(shasta, shastaModule)
     shastaModule.def("openPerformanceLog",
         openPerformanceLog
         );
+
+    // Progress of a running computation. These can be called
+    // from any Python thread while a long running Assembler function
+    // executes in another thread.
+    shastaModule.def("enableBatchProgress",
+        enableBatchProgress,
+        arg("enable") = true
+        );
+    shastaModule.def("getBatchProgress",
+        getBatchProgress
+        );
+    shastaModule.def("getCurrentPerformanceSpan",
+        []()
+        {
+            string name;
+            double seconds;
+            getCurrentPerformanceSpan(name, seconds);
+            return make_pair(name, seconds);
+        },
+        "Return the name and elapsed seconds of the current PerformanceSpan."
+        );
+    shastaModule.def("benchmarkKernels",
+        benchmarkKernels,
+        arg("repeatCount") = 5
+        );
     shastaModule.def("testMultithreadedObject",
         testMultithreadedObject
         );
@@ -734,6 +1101,12 @@ PYBIND11_MODULE(shasta, shastaModule)
     shastaModule.def("mappedCopy",
         mappedCopy
         );
+    shastaModule.def("snapshotCopy",
+        snapshotCopy
+        );
+    shastaModule.def("snapshotDirectory",
+        snapshotDirectory
+        );
     shastaModule.def("testLongBaseSequence",
         testLongBaseSequence
         );
@@ -1,6 +1,7 @@
 // Shasta.
 #include "ReadGraph.hpp"
 #include "deduplicate.hpp"
+#include "ReadGraphCsr.hpp"
 #include "orderPairs.hpp"
 using namespace shasta;
 
@@ -228,142 +229,96 @@ void ReadGraph::findNeighbors(
 
 
 
-// Find "bridges" from the read graph.
-// Takes as input a vector<bool> that says, for each alignmentId,
-// whether that alignment is used in the read graph.
-// Updates that vector to set to false the entries corresponding
-// to read graph "bridges".
-void ReadGraph::findBridges(vector<bool>& keepAlignment, uint64_t maxDistance)
+// Find "bridges" from the read graph involving a given oriented read.
+// Adds to bridgeAlignmentIds the alignment ids of the bridges found.
+void ReadGraph::findBridges(
+    OrientedReadId orientedReadId0,
+    uint64_t maxDistance,
+    ReadGraphBfs& bfs,
+    vector<OrientedReadId>& neighbors,
+    vector<uint64_t>& bridgeAlignmentIds) const
 {
+    // Find neighbors within the specified distance, sorted.
+    bfs.run(orientedReadId0, maxDistance);
+    neighbors.clear();
+    for(uint64_t i=1; i<bfs.getVertices().size(); i++) {
+        neighbors.push_back(bfs.getVertices()[i].orientedReadId);
+    }
+    sort(neighbors.begin(), neighbors.end());
+    const uint64_t n = neighbors.size();
+    if(n == 0) {
+        return;
+    }
 
-    // Vector to flag edges that will be removed.
-    vector<bool> isToBeRemoved(edges.size(), false);
-
-    // Work vectors to contain neighbors and
-    // the corresponding edge ids.
-    vector<OrientedReadId> neighbors;
-    vector<uint32_t> neighborEdges;
-
-    vector<uint64_t> rank;
-    vector<uint64_t> parent;
-
-    // Loop over reads. We only consider vertices corresponding
-    // reads on strand 0, then for each edge to be removed
-    // also flag its reverse complement.
-    const uint32_t orientedReadCount = uint32_t(connectivity.size());
-    SHASTA_ASSERT((orientedReadCount % 2) == 0);
-    const uint32_t readCount = orientedReadCount / 2;
-    for(ReadId readId0=0; readId0<readCount; readId0++) {
-        const OrientedReadId orientedReadId0(readId0, 0);
-        // cout << "Working on " << orientedReadId0 << endl;
-
-        // Find neighbors within the specified distance.
-        findNeighbors(orientedReadId0, maxDistance, neighbors);
-        const uint64_t n = neighbors.size();
-        if(n == 0) {
-            continue;
-        }
-
-        /*
-        cout << "Neighbors:" << endl;
-        for(uint64_t i1=0; i1<n; i1++) {
-            cout << i1 << " " << neighbors[i1] << endl;
-        }
-        */
-
-        // Initialize the disjoint set data structure.
-        rank.resize(n);
-        parent.resize(n);
-        boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
-        for(uint64_t i=0; i<n; i++) {
-            disjointSets.make_set(i);
-        }
-
-        // Compute connected components of the subgraph formed by the neighbors.
-        for(uint64_t i1=0; i1<n; i1++) {
-            const OrientedReadId orientedReadId1 = neighbors[i1];
-            for(const uint32_t edgeId12: connectivity[orientedReadId1.getValue()]) {
-                const ReadGraphEdge& edge12 = edges[edgeId12];
-                const OrientedReadId orientedReadId2 = edge12.getOther(orientedReadId1);
-                SHASTA_ASSERT(orientedReadId1 != orientedReadId2);
-
-                // Only consider each edge once.
-                if(orientedReadId2 < orientedReadId1) {
-                    continue;
-                }
+    // Initialize the disjoint set data structure.
+    vector<uint64_t> rank(n);
+    vector<uint64_t> parent(n);
+    boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
+    for(uint64_t i=0; i<n; i++) {
+        disjointSets.make_set(i);
+    }
 
-                // Look up the other oriented read in our vector of neighbors.
-                const auto it2 = lower_bound(neighbors.begin(), neighbors.end(), orientedReadId2);
-                if((it2 == neighbors.end()) or (*it2 != orientedReadId2)) {
-                    // Not a neighbor. Ignore.
-                    continue;
-                }
-                SHASTA_ASSERT(*it2 == orientedReadId2);
-                const uint64_t i2 = it2 - neighbors.begin();
+    // Compute connected components of the subgraph formed by the neighbors.
+    for(uint64_t i1=0; i1<n; i1++) {
+        const OrientedReadId orientedReadId1 = neighbors[i1];
+        for(const uint32_t edgeId12: connectivity[orientedReadId1.getValue()]) {
+            const ReadGraphEdge& edge12 = edges[edgeId12];
+            const OrientedReadId orientedReadId2 = edge12.getOther(orientedReadId1);
+            SHASTA_ASSERT(orientedReadId1 != orientedReadId2);
 
-                // Update our disjoint set data structure.
-                // cout << "Updating: " << i1 << " " << i2 << endl;
-                disjointSets.union_set(i1, i2);
+            // Only consider each edge once.
+            if(orientedReadId2 < orientedReadId1) {
+                continue;
             }
-        }
 
-        /*
-        for(uint64_t i1=0; i1<n; i1++) {
-            cout << i1 << " " << neighbors[i1] << " " << disjointSets.find_set(i1) << endl;
-        }
-        */
-
-        // Gather connected components.
-        vector< vector<uint64_t> > components(n);
-        for(uint64_t i1=0; i1<n; i1++) {
-            const uint64_t componentId = disjointSets.find_set(i1);
-            components[componentId].push_back(i1);
-        }
-
-        // Sort them by size.
-        vector<pair<uint64_t, uint64_t> > componentTable; // pair(componentId, size).
-        for(uint64_t componentId=0; componentId<n;componentId++) {
-            const auto& component = components[componentId];
-            const uint64_t componentSize = component.size();
-            if(componentSize > 0) {
-                componentTable.push_back(make_pair(componentId, componentSize));
+            // Look up the other oriented read in our vector of neighbors.
+            const auto it2 = lower_bound(neighbors.begin(), neighbors.end(), orientedReadId2);
+            if((it2 == neighbors.end()) or (*it2 != orientedReadId2)) {
+                // Not a neighbor. Ignore.
+                continue;
             }
-        }
-        sort(componentTable.begin(), componentTable.end(),
-            OrderPairsBySecondOnlyGreater<uint64_t, uint64_t>());
-        const uint64_t largestComponentId = componentTable.front().first;
-        const vector<uint64_t>& largestComponent = components[largestComponentId];
-        SHASTA_ASSERT(largestComponent.size() == componentTable.front().second);
+            SHASTA_ASSERT(*it2 == orientedReadId2);
+            const uint64_t i2 = it2 - neighbors.begin();
 
-        /*
-        cout << "Largest component:" << endl;
-        for(const uint64_t i1: largestComponent) {
-            cout << i1 << " " << neighbors[i1] << endl;
+            // Update our disjoint set data structure.
+            disjointSets.union_set(i1, i2);
         }
-        */
+    }
 
-        vector<bool> keep(n, false);
-        for(const uint64_t i1: largestComponent) {
-            keep[i1] = true;
-        }
+    // Gather connected components.
+    vector< vector<uint64_t> > components(n);
+    for(uint64_t i1=0; i1<n; i1++) {
+        const uint64_t componentId = disjointSets.find_set(i1);
+        components[componentId].push_back(i1);
+    }
 
-        /*
-        for (uint64_t i1=0; i1<n; i1++) {
-            if(not keep[i1]) {
-                cout << "Remove " << orientedReadId0 << " " << neighbors[i1] << endl;
-            }
+    // Sort them by size.
+    vector<pair<uint64_t, uint64_t> > componentTable; // pair(componentId, size).
+    for(uint64_t componentId=0; componentId<n;componentId++) {
+        const auto& component = components[componentId];
+        const uint64_t componentSize = component.size();
+        if(componentSize > 0) {
+            componentTable.push_back(make_pair(componentId, componentSize));
         }
-        */
+    }
+    sort(componentTable.begin(), componentTable.end(),
+        OrderPairsBySecondOnlyGreater<uint64_t, uint64_t>());
+    const uint64_t largestComponentId = componentTable.front().first;
+    const vector<uint64_t>& largestComponent = components[largestComponentId];
+    SHASTA_ASSERT(largestComponent.size() == componentTable.front().second);
+
+    vector<bool> keep(n, false);
+    for(const uint64_t i1: largestComponent) {
+        keep[i1] = true;
+    }
 
-        for (uint64_t i1=0; i1<n; i1++) {
-            if(not keep[i1]) {
-                const uint32_t edgeId = connectivity[orientedReadId0.getValue()][i1];
-                const ReadGraphEdge& edge = edges[edgeId];
-                keepAlignment[edge.alignmentId] = false;
-            }
+    for (uint64_t i1=0; i1<n; i1++) {
+        if(not keep[i1]) {
+            const uint32_t edgeId = connectivity[orientedReadId0.getValue()][i1];
+            const ReadGraphEdge& edge = edges[edgeId];
+            bridgeAlignmentIds.push_back(edge.alignmentId);
         }
     }
-
 }
 
 
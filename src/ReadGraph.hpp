@@ -28,6 +28,7 @@ but read-only form using MemoryMapped data structures.
 
 namespace shasta {
     class ReadGraph;
+    class ReadGraphBfs;
     class ReadGraphEdge;
 }
 
@@ -114,12 +115,17 @@ public:
     void findNeighbors(OrientedReadId, vector<OrientedReadId>&) const;
     void findNeighbors(OrientedReadId, uint64_t maxDistance, vector<OrientedReadId>&) const;
 
-    // Find "bridges" from the read graph.
-    // Takes as input a vector<bool> that says, for each alignmentId,
-    // whether that alignment is used in the read graph.
-    // Updates that vector to set to false the entries corresponding
-    // to read graph "bridges".
-    void findBridges(vector<bool>& keepAlignment, uint64_t maxDistance);
+    // Find "bridges" from the read graph involving a given oriented read.
+    // Adds to bridgeAlignmentIds the alignment ids of the bridges found.
+    // The ReadGraphBfs must use a ReadGraphCsr that includes all edges.
+    // This is called by Assembler::removeReadGraphBridges for all reads
+    // on strand 0, using multiple threads.
+    void findBridges(
+        OrientedReadId,
+        uint64_t maxDistance,
+        ReadGraphBfs&,
+        vector<OrientedReadId>& neighbors,
+        vector<uint64_t>& bridgeAlignmentIds) const;
 
     void clustering(
         std::mt19937& randomSource,
@@ -0,0 +1,162 @@
+// Shasta.
+#include "ReadGraphCsr.hpp"
+#include "ReadGraph.hpp"
+using namespace shasta;
+
+// Explicit instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<ReadGraphCsr>;
+
+
+
+ReadGraphCsr::ReadGraphCsr(
+    const ReadGraph& readGraph,
+    bool skipCrossStrandEdges,
+    size_t threadCount) :
+    MultithreadedObject(*this),
+    readGraph(readGraph),
+    skipCrossStrandEdges(skipCrossStrandEdges)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Pass 1: count the neighbors of each vertex.
+    const uint64_t n = readGraph.connectivity.size();
+    neighborsBegin.resize(n + 1);
+    neighborsBegin[0] = 0;
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(n, batchSize);
+    runThreads(&ReadGraphCsr::threadFunction1, threadCount);
+
+    // Convert the counts to positions.
+    for(uint64_t v=0; v<n; v++) {
+        neighborsBegin[v + 1] += neighborsBegin[v];
+    }
+
+    // Pass 2: store the neighbors.
+    const uint64_t neighborCount = neighborsBegin.back();
+    neighborIds.resize(neighborCount);
+    edgeIds.resize(neighborCount);
+    alignmentIds.resize(neighborCount);
+    flags.resize(neighborCount);
+    setupLoadBalancing(n, batchSize);
+    runThreads(&ReadGraphCsr::threadFunction2, threadCount);
+}
+
+
+
+void ReadGraphCsr::threadFunction1(size_t)
+{
+    threadFunction12(1);
+}
+void ReadGraphCsr::threadFunction2(size_t)
+{
+    threadFunction12(2);
+}
+void ReadGraphCsr::threadFunction12(size_t pass)
+{
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over vertices assigned to this batch.
+        for(uint64_t v=begin; v!=end; v++) {
+            const OrientedReadId orientedReadId0 = OrientedReadId::fromValue(ReadId(v));
+            // In pass 1, i counts the neighbors of v.
+            // In pass 2, it is the position where the next neighbor is stored.
+            uint64_t i = (pass == 1) ? 0 : neighborsBegin[v];
+            for(const uint32_t edgeId: readGraph.connectivity[ReadId(v)]) {
+                const ReadGraphEdge& edge = readGraph.edges[edgeId];
+                if(skipCrossStrandEdges and edge.crossesStrands) {
+                    continue;
+                }
+                if(pass == 2) {
+                    SHASTA_ASSERT(edge.alignmentId <= std::numeric_limits<uint32_t>::max());
+                    neighborIds[i] = edge.getOther(orientedReadId0);
+                    edgeIds[i] = edgeId;
+                    alignmentIds[i] = uint32_t(edge.alignmentId);
+                    uint8_t f = 0;
+                    if(edge.crossesStrands) {
+                        f |= crossesStrandsFlag;
+                    }
+                    if(edge.hasInconsistentAlignment) {
+                        f |= hasInconsistentAlignmentFlag;
+                    }
+                    if(edge.orientedReadIds[0] == orientedReadId0) {
+                        f |= isFirstFlag;
+                    }
+                    flags[i] = f;
+                }
+                ++i;
+            }
+            if(pass == 1) {
+                neighborsBegin[v + 1] = i;
+            } else {
+                SHASTA_ASSERT(i == neighborsBegin[v + 1]);
+            }
+        }
+    }
+}
+
+
+
+ReadGraphBfs::ReadGraphBfs(const ReadGraphCsr& csr) :
+    csr(csr),
+    marks(csr.vertexCount())
+{
+}
+
+
+
+bool ReadGraphBfs::run(
+    OrientedReadId start,
+    uint64_t maxDistance,
+    OrientedReadId target)
+{
+    // Start a new epoch. If the epoch counter wraps around,
+    // reset all marks.
+    ++epoch;
+    if(epoch == 0) {
+        fill(marks.begin(), marks.end(), Mark());
+        epoch = 1;
+    }
+
+    // The vertices vector is also used as the BFS queue.
+    vertices.clear();
+    vertices.push_back({start, 0});
+    marks[start.getValue()] = {epoch, 0};
+
+    for(uint64_t i=0; i<vertices.size(); i++) {
+
+        // Dequeue a vertex.
+        const OrientedReadId v0 = vertices[i].orientedReadId;
+        const uint32_t distance1 = vertices[i].distance + 1;
+
+        // Loop over its neighbors.
+        for(const OrientedReadId v1: csr[v0]) {
+            Mark& mark = marks[v1.getValue()];
+
+            // If we did not encounter this vertex before, record it.
+            if(mark.epoch != epoch) {
+                mark.epoch = epoch;
+                mark.localIndex = uint32_t(vertices.size());
+                vertices.push_back({v1, distance1});
+            }
+
+            if(v1 == target) {
+                return true;
+            }
+        }
+
+        // Vertices at maxDistance are not expanded.
+        // Since vertices are in order of increasing distance, we can stop here
+        // if the next vertex in the queue is at maxDistance.
+        if(i + 1 < vertices.size() and vertices[i + 1].distance >= maxDistance) {
+            break;
+        }
+    }
+
+    return false;
+}
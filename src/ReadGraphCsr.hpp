@@ -0,0 +1,171 @@
+#ifndef SHASTA_READ_GRAPH_CSR_HPP
+#define SHASTA_READ_GRAPH_CSR_HPP
+
+/*******************************************************************************
+
+Classes ReadGraphCsr and ReadGraphBfs provide fast bounded
+breadth first searches (BFS) of the read graph, used in
+flagChimericReads, flagCrossStrandReadGraphEdges1, and removeReadGraphBridges.
+
+ReadGraphCsr is a read-only, compressed sparse row (CSR) view of the ReadGraph.
+For each oriented read it stores, contiguously, the neighboring oriented reads,
+in the same order as ReadGraph::connectivity.
+The information for each neighbor is stored as a structure of arrays:
+neighbor oriented read ids, 32-bit edge ids, 32-bit alignment ids,
+and packed edge flags are in separate vectors, all indexed the same way.
+A BFS then only touches the neighbor oriented read ids,
+4 bytes per neighbor, without accessing the ReadGraphEdge objects.
+Cross-strand edges can optionally be excluded when the view is created.
+The view is created once, using multiple threads,
+and is then shared by all threads doing BFSs.
+
+ReadGraphBfs does bounded BFSs on a ReadGraphCsr.
+Each thread uses its own ReadGraphBfs.
+To mark visited vertices, each vertex stores the number of the last BFS
+that visited it (an "epoch"), so no cleanup is needed between BFSs.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+#include "ReadId.hpp"
+
+// Standard library.
+#include <limits>
+#include "span.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class ReadGraph;
+    class ReadGraphBfs;
+    class ReadGraphCsr;
+
+    extern template class MultithreadedObject<ReadGraphCsr>;
+}
+
+
+
+class shasta::ReadGraphCsr : public MultithreadedObject<ReadGraphCsr> {
+public:
+
+    ReadGraphCsr(
+        const ReadGraph&,
+        bool skipCrossStrandEdges,
+        size_t threadCount);
+
+    uint64_t vertexCount() const
+    {
+        return neighborsBegin.size() - 1;
+    }
+
+    // The neighbors of an oriented read.
+    span<const OrientedReadId> operator[](OrientedReadId orientedReadId) const
+    {
+        return getRange(neighborIds, orientedReadId);
+    }
+
+    // The edge ids, alignment ids, and flags corresponding to
+    // the neighbors returned by operator[].
+    span<const uint32_t> getEdgeIds(OrientedReadId orientedReadId) const
+    {
+        return getRange(edgeIds, orientedReadId);
+    }
+    span<const uint32_t> getAlignmentIds(OrientedReadId orientedReadId) const
+    {
+        return getRange(alignmentIds, orientedReadId);
+    }
+    span<const uint8_t> getFlags(OrientedReadId orientedReadId) const
+    {
+        return getRange(flags, orientedReadId);
+    }
+
+    // The bits used in the flags.
+    // isFirstFlag is set if the oriented read is orientedReadIds[0]
+    // of the edge, and the neighbor is orientedReadIds[1].
+    // When looping over the neighbors of all vertices, this can be used
+    // to visit each edge only once.
+    static const uint8_t crossesStrandsFlag = 1;
+    static const uint8_t hasInconsistentAlignmentFlag = 2;
+    static const uint8_t isFirstFlag = 4;
+
+private:
+    const ReadGraph& readGraph;
+    bool skipCrossStrandEdges;
+
+    // The neighbors of vertex v are in
+    // [neighborsBegin[v], neighborsBegin[v + 1]).
+    vector<uint64_t> neighborsBegin;
+    vector<OrientedReadId> neighborIds;
+    vector<uint32_t> edgeIds;
+    vector<uint32_t> alignmentIds;
+    vector<uint8_t> flags;
+
+    template<class T> span<const T> getRange(
+        const vector<T>& v,
+        OrientedReadId orientedReadId) const
+    {
+        const uint64_t i = orientedReadId.getValue();
+        return span<const T>(
+            v.data() + neighborsBegin[i],
+            v.data() + neighborsBegin[i + 1]);
+    }
+
+    // Pass 1 counts the neighbors of each vertex, pass 2 stores them.
+    void threadFunction1(size_t threadId);
+    void threadFunction2(size_t threadId);
+    void threadFunction12(size_t pass);
+};
+
+
+
+class shasta::ReadGraphBfs {
+public:
+    ReadGraphBfs(const ReadGraphCsr&);
+
+    // Do a BFS starting at start and up to maxDistance.
+    // If target is specified, the BFS stops as soon as it reaches target,
+    // and the return value is true if target was reached.
+    bool run(
+        OrientedReadId start,
+        uint64_t maxDistance,
+        OrientedReadId target = OrientedReadId::invalid());
+
+    // The vertices reached by the last BFS, in the order they were reached.
+    class Vertex {
+    public:
+        OrientedReadId orientedReadId;
+        uint32_t distance;
+    };
+    const vector<Vertex>& getVertices() const
+    {
+        return vertices;
+    }
+
+    // Return the index in getVertices() of a vertex reached by the last BFS,
+    // or notReached if the vertex was not reached.
+    uint32_t getLocalIndex(OrientedReadId orientedReadId) const
+    {
+        const Mark& mark = marks[orientedReadId.getValue()];
+        return (mark.epoch == epoch) ? mark.localIndex : notReached;
+    }
+    static const uint32_t notReached = std::numeric_limits<uint32_t>::max();
+
+private:
+    const ReadGraphCsr& csr;
+
+    // For each vertex, the last BFS that reached it
+    // and its index in the vertices vector for that BFS.
+    class Mark {
+    public:
+        uint32_t epoch = 0;
+        uint32_t localIndex = 0;
+    };
+    vector<Mark> marks;
+    uint32_t epoch = 0;
+
+    // The vertices reached by the last BFS.
+    // This is also used as the BFS queue.
+    vector<Vertex> vertices;
+};
+
+#endif
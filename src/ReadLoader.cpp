@@ -2,6 +2,9 @@
 #include "ReadLoader.hpp"
 #include "computeRunLengthRepresentation.hpp"
 #include "filesystem.hpp"
+#include "Marker.hpp"
+#include "MarkerFinder.hpp"
+#include "objectStorage.hpp"
 #include "performanceLog.hpp"
 #include "splitRange.hpp"
 using namespace shasta;
@@ -12,38 +15,96 @@ using namespace shasta;
 #include <filesystem>
 #include "tuple.hpp"
 
+// Zlib, used for compressed input.
+#include <zlib.h>
+
 #include "MultithreadedObject.tpp"
 template class MultithreadedObject<ReadLoader>;
 
-// Load reads from a fastq or fasta file.
+// Load reads from fastq or fasta files.
 ReadLoader::ReadLoader(
-    const string& fileName,
+    const vector<string>& fileNames,
     uint64_t representation, // 0 = raw sequence, 1 = RLE sequence
     uint64_t minReadLength,
+    uint64_t desiredCoverage,
     bool noCache,
+    uint64_t streamingChunkSize,
     size_t threadCount,
     const string& dataNamePrefix,
     size_t pageSize,
-    Reads& reads):
+    Reads& reads,
+    const KmerChecker* kmerChecker,
+    uint64_t k,
+    MemoryMapped::VectorOfVectors<uint32_t, uint64_t>* markerPositions):
 
     MultithreadedObject(*this),
-    fileName(fileName),
     representation(representation),
     minReadLength(minReadLength),
     noCache(noCache),
     threadCount(threadCount),
     dataNamePrefix(dataNamePrefix),
     pageSize(pageSize),
-    reads(reads)
+    reads(reads),
+    kmerChecker(kmerChecker),
+    k(k),
+    markerPositions(markerPositions),
+    streamingChunkSize(streamingChunkSize)
+{
+    adjustThreadCount();
+    if(kmerChecker) {
+        SHASTA_ASSERT(markerPositions);
+        SHASTA_ASSERT(markerPositions->size() == reads.readCount());
+    }
+
+    // If requested, do a length scan to increase minReadLength
+    // to get the desired coverage.
+    if(desiredCoverage) {
+        lengthScan(fileNames, desiredCoverage);
+    }
+
+    // Process the files one at a time.
+    // Except in streaming mode, each thread keeps the reads it finds
+    // for all files in its own data structures,
+    // and they are all stored in reads at the end.
+    const auto t0 = std::chrono::steady_clock::now();
+    for(const string& inputFileName: fileNames) {
+        fileName = inputFileName;
+        processFile();
+    }
+
+    // Store the reads found by all threads.
+    const auto t1 = std::chrono::steady_clock::now();
+    storeReads();
+    finishStoringReads();
+    const auto t2 = std::chrono::steady_clock::now();
+
+    performanceLog << "Time to store reads for all files: " << seconds(t2 - t1) << " s." << endl;
+    performanceLog << "Time to load reads from " << fileNames.size() << " files: " <<
+        seconds(t2 - t0) << " s." << endl;
+}
+
+
+
+// Load reads from the fastq or fasta file currently being processed.
+void ReadLoader::processFile()
 {
     performanceLog << timestamp << "Loading reads from " << fileName << endl;
 
-    adjustThreadCount();
+    // For URLs, the file format is deduced from the path portion of the URL.
+    const bool isUrl = isObjectStorageUrl(fileName);
+    httpUrl = isUrl ? getObjectHttpUrl(fileName) : string();
+    const string path = isUrl ? getObjectPath(fileName) : fileName;
 
     // Get the file extension.
+    // If the file is gzip compressed, use the extension that precedes the ".gz".
     string extension;
+    isCompressed = false;
     try {
-        extension = filesystem::extension(fileName);
+        extension = filesystem::extension(path);
+        if(extension == "gz" || extension == "GZ") {
+            isCompressed = true;
+            extension = filesystem::extension(path.substr(0, path.size() - 3));
+        }
     } catch (...) {
         throw runtime_error("Input file " + fileName +
             " must have an extension consistent with its format.");
@@ -63,7 +124,8 @@ ReadLoader::ReadLoader(
 
     // If getting here, the file extension is not supported.
     throw runtime_error("File extension " + extension + " is not supported. "
-        "Supported file extensions are .fasta, .fa, .FASTA, .FA, .fastq, .fq, .FASTQ, .FQ.");
+        "Supported file extensions are .fasta, .fa, .FASTA, .FA, .fastq, .fq, .FASTQ, .FQ, "
+        "optionally followed by .gz for gzip compressed files.");
 }
 
 
@@ -83,55 +145,100 @@ void ReadLoader::adjustThreadCount()
 
 void ReadLoader::processFastaFile()
 {
+    if(streamingChunkSize and not isCompressed) {
+        processFileStreaming(false);
+        return;
+    }
 
     // Read the entire fasta file.
     const auto t0 = std::chrono::steady_clock::now();
     allocateBufferAndReadFile();
 
     // Each thread stores reads in its own data structures.
+    // They are stored in reads at the end, after processing all files.
     const auto t1 = std::chrono::steady_clock::now();
-    allocatePerThreadDataStructures();
-    runThreads(&ReadLoader::processFastaFileThreadFunction, threadCount);
+    parseBuffer(false);
     const auto t2 = std::chrono::steady_clock::now();
     buffer.remove();
 
-    // Store the reads computed by each thread and free
-    // the per-thread data structures.
-    storeReads();
-    const auto t3 = std::chrono::steady_clock::now();
-
 
     performanceLog << "Time to process this file:\n" <<
         "Allocate buffer + read: " << seconds(t1-t0) << " s.\n" <<
         "Parse: " << seconds(t2-t1) << " s.\n"
-        "Store: " << seconds(t3-t2) << " s.\n"
-        "Total: " << seconds(t3-t0) << " s." << endl;
+        "Total: " << seconds(t2-t0) << " s." << endl;
 
 
 }
 
 
 
-// Each thread processes the reads whose initial ">" character
-// is in the file block assigned to the read.
+// Parse the reads in the buffer.
+// The buffer is divided in blocks which are assigned to threads
+// using dynamic load balancing. Each thread stores the reads
+// it finds in its own data structures, and records
+// in the blocks vector where the reads of each block were stored.
+void ReadLoader::parseBuffer(bool isFastq)
+{
+    allocatePerThreadDataStructures();
+
+    blockCount = threadCount * blocksPerThread;
+    blockBegin = blocks.size();
+    blocks.resize(blockBegin + blockCount);
+
+    setupLoadBalancing(blockCount, 1);
+    if(isFastq) {
+        runThreads(&ReadLoader::processFastqFileThreadFunction, threadCount);
+    } else {
+        runThreads(&ReadLoader::processFastaFileThreadFunction, threadCount);
+    }
+}
+
+
+
+// Each thread processes the blocks assigned to it
+// by dynamic load balancing.
 void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 {
-    const char* bufferPointer = &buffer[0];
-    const uint64_t bufferSize = buffer.size();
+    if(isLengthScan) {
+        uint64_t begin, end;
+        while(getNextBatch(begin, end)) {
+            for(uint64_t blockId=begin; blockId!=end; blockId++) {
+                scanFastaBlock(threadId, blockId);
+            }
+        }
+        return;
+    }
 
-    // Allocate and access the data structures where this thread will store the
-    // reads it finds.
-    allocatePerThreadDataStructures(threadId);
-    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames = *threadReadNames[threadId];
-    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadMetaData = *threadReadMetaData[threadId];
-    LongBaseSequences& thisThreadReads = *threadReads[threadId];
-    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
-        *threadReadRepeatCounts[threadId];
+    // Allocate the data structures where this thread will store the
+    // reads it finds, if not already done.
+    if(not threadReads[threadId]) {
+        allocatePerThreadDataStructures(threadId);
+    }
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t blockId=begin; blockId!=end; blockId++) {
+            Block& block = blocks[blockBegin + blockId];
+            block.threadId = threadId;
+            block.firstRead = threadReadNames[threadId]->size();
+            processFastaBlock(threadId, blockId);
+            block.readCount = threadReadNames[threadId]->size() - block.firstRead;
+        }
+    }
+}
 
 
-    // Compute the file block assigned to this thread.
+
+// Process the reads whose initial ">" character
+// is in the given block of the buffer.
+void ReadLoader::processFastaBlock(size_t threadId, uint64_t blockId)
+{
+    const char* bufferPointer = &buffer[0];
+    const uint64_t bufferSize = buffer.size();
+
+    // Compute the file block to be processed.
     uint64_t begin, end;
-    tie(begin, end) = splitRange(0, bufferSize, threadCount, threadId);
+    tie(begin, end) = splitRange(0, bufferSize, blockCount, blockId);
     if(begin == end) {
         return;
     }
@@ -146,7 +253,7 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
         while(!fastaReadBeginsHere(offset)) {
             ++offset;
             if(offset == end) {
-                // We reached the end of the block assigned to this thread
+                // We reached the end of this block
                 // without finding any reads.
                 return;
             }
@@ -207,7 +314,7 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 
 
         // Read the bases.
-        // Note that here we can go past the file block assigned to this thread.
+        // Note that here we can go past the end of this block.
         read.clear();
         uint64_t invalidBaseCount = 0;
         while(offset != bufferSize) {
@@ -250,23 +357,263 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
         }
 
         // Store the read bases.
+        storeRead(threadId, readName, readMetaData, read, runLengthRead, readRepeatCount);
+    }
+
+}
+
+
+
+// Store a read found by processFastaBlock or processFastqBlock
+// in the data structures of this thread.
+// Marker positions are stored in 24 bits (see CompressedMarker),
+// so reads longer than CompressedMarker::maxReadLength
+// in the representation used to store them are split into pieces
+// no longer than that. Each piece gets the name of the original
+// read followed by "_" and the piece number.
+void ReadLoader::storeRead(
+    size_t threadId,
+    const string& readName,
+    const string& readMetaData,
+    const vector<Base>& read,
+    vector<Base>& runLengthRead,
+    vector<uint8_t>& readRepeatCount)
+{
+    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames = *threadReadNames[threadId];
+    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadMetaData = *threadReadMetaData[threadId];
+    LongBaseSequences& thisThreadReads = *threadReads[threadId];
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
+        *threadReadRepeatCounts[threadId];
+
+    // Get the bases to be stored.
+    if(representation == 1) {
+        if(not computeRunLengthRepresentation(read, runLengthRead, readRepeatCount)) {
+            __sync_fetch_and_add(&discardedBadRepeatCountReadCount, 1);
+            __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, read.size());
+            return;
+        }
+    }
+    const vector<Base>& storedRead = (representation == 1) ? runLengthRead : read;
+    const uint64_t n = storedRead.size();
+
+    // Common case: store the read as is.
+    if(n <= CompressedMarker::maxReadLength) {
+        thisThreadReadNames.appendVector(readName.begin(), readName.end());
+        thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
+        thisThreadReads.append(storedRead);
         if(representation == 1) {
-            if(computeRunLengthRepresentation(read, runLengthRead, readRepeatCount)) {
-                thisThreadReadNames.appendVector(readName.begin(), readName.end());
-                thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
-                thisThreadReads.append(runLengthRead);
-                thisThreadReadRepeatCounts.appendVector(readRepeatCount);
+            thisThreadReadRepeatCounts.appendVector(readRepeatCount);
+        }
+        storeMarkerPositions(threadId);
+        return;
+    }
+
+    // This read is too long. Split it into pieces of equal length.
+    const uint64_t pieceCount = (n - 1) / CompressedMarker::maxReadLength + 1;
+    __sync_fetch_and_add(&splitReadCount, 1);
+    __sync_fetch_and_add(&splitReadPieceCount, pieceCount);
+    vector<Base> piece;
+    for(uint64_t i=0; i<pieceCount; i++) {
+        uint64_t begin, end;
+        tie(begin, end) = splitRange(0, n, pieceCount, i);
+        const string pieceName = readName + "_" + to_string(i);
+        thisThreadReadNames.appendVector(pieceName.begin(), pieceName.end());
+        thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
+        piece.assign(storedRead.begin() + begin, storedRead.begin() + end);
+        thisThreadReads.append(piece);
+        if(representation == 1) {
+            thisThreadReadRepeatCounts.appendVector(
+                readRepeatCount.begin() + begin, readRepeatCount.begin() + end);
+        }
+        storeMarkerPositions(threadId);
+    }
+}
+
+
+
+// If marker positions are being computed, compute them for the
+// last read stored by this thread and store them
+// in the data structures of this thread.
+void ReadLoader::storeMarkerPositions(size_t threadId)
+{
+    if(not kmerChecker) {
+        return;
+    }
+
+    // Work vectors reused for all reads processed by this thread.
+    thread_local vector<KmerId> kmerIds;
+    thread_local vector<KmerId> kmerIdsRc;
+    thread_local vector<uint8_t> isMarker;
+    thread_local vector<uint32_t> positions;
+
+    const LongBaseSequences& thisThreadReads = *threadReads[threadId];
+    MarkerFinder::findMarkerPositions(
+        thisThreadReads[thisThreadReads.size() - 1],
+        k, *kmerChecker,
+        kmerIds, kmerIdsRc, isMarker, positions);
+    threadMarkerPositions[threadId]->appendVector(positions);
+}
+
+
+
+// Length scan of all input files.
+// This reads all input files and computes a histogram of read lengths,
+// without decoding and storing the reads.
+// It then increases minReadLength to get the desired coverage.
+void ReadLoader::lengthScan(
+    const vector<string>& fileNames,
+    uint64_t desiredCoverage)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    performanceLog << timestamp << "Length scan begins." << endl;
+
+    isLengthScan = true;
+    threadLengthHistograms.clear();
+    threadLengthHistograms.resize(threadCount);
+    for(const string& inputFileName: fileNames) {
+        fileName = inputFileName;
+        processFile();
+    }
+    blocks.clear();
+    isLengthScan = false;
+
+    // Combine the histograms computed by all threads.
+    lengthScanHistogram.clear();
+    for(const vector<uint64_t>& threadHistogram: threadLengthHistograms) {
+        if(threadHistogram.size() > lengthScanHistogram.size()) {
+            lengthScanHistogram.resize(threadHistogram.size(), 0);
+        }
+        for(uint64_t length=0; length<threadHistogram.size(); length++) {
+            lengthScanHistogram[length] += threadHistogram[length];
+        }
+    }
+    threadLengthHistograms.clear();
+
+    uint64_t totalBaseCount = 0;
+    for(uint64_t length=0; length<lengthScanHistogram.size(); length++) {
+        totalBaseCount += lengthScanHistogram[length] * length;
+    }
+
+    // Compute the new read length cutoff.
+    const uint64_t newMinReadLength =
+        Reads::computeMinReadLengthForCoverage(lengthScanHistogram, desiredCoverage);
+    if(newMinReadLength == 0) {
+        throw runtime_error(
+            "With Reads.minReadLength " +
+            to_string(minReadLength) +
+            ", total available coverage is " +
+            to_string(totalBaseCount) +
+            ", less than desired coverage " +
+            to_string(desiredCoverage) +
+            ". Try reducing Reads.minReadLength if appropriate or get more coverage."
+        );
+    }
+
+    // Adjusting coverage should only ever reduce coverage if necessary.
+    SHASTA_ASSERT(newMinReadLength >= minReadLength);
+    cout << "Length scan found " << totalBaseCount << " bases in reads of length at least " <<
+        minReadLength << "." << endl;
+    minReadLength = newMinReadLength;
+    cout << "Setting minReadLength to " << minReadLength <<
+        " to get desired coverage " << desiredCoverage << "." << endl;
+
+    const auto t1 = std::chrono::steady_clock::now();
+    performanceLog << timestamp << "Length scan ends. Elapsed time " << seconds(t1 - t0) << " s." << endl;
+}
+
+
+
+void ReadLoader::addToLengthHistogram(size_t threadId, uint64_t length)
+{
+    if(length < minReadLength) {
+        return;
+    }
+    vector<uint64_t>& histogram = threadLengthHistograms[threadId];
+    if(histogram.size() <= length) {
+        histogram.resize(length + 1, 0);
+    }
+    ++histogram[length];
+}
+
+
+
+// Length scan for a block of a fasta file.
+// This counts the bases of the reads whose initial ">" character
+// is in the given block of the buffer, skipping reads that
+// contain invalid bases, as processFastaBlock does.
+void ReadLoader::scanFastaBlock(size_t threadId, uint64_t blockId)
+{
+    const char* bufferPointer = &buffer[0];
+    const uint64_t bufferSize = buffer.size();
+
+    uint64_t begin, end;
+    tie(begin, end) = splitRange(0, bufferSize, blockCount, blockId);
+    if(begin == end) {
+        return;
+    }
+
+    // Locate the first read that begins in this block.
+    uint64_t offset = begin;
+    if(offset == 0) {
+        if(!fastaReadBeginsHere(offset)) {
+            throw runtime_error("Fasta file " + fileName + " does not begin with a \">\".");
+        }
+    } else {
+        while(!fastaReadBeginsHere(offset)) {
+            ++offset;
+            if(offset == end) {
+                return;
+            }
+        }
+    }
+
+    while(offset < end) {
+
+        // Skip the header line.
+        while(offset != bufferSize and bufferPointer[offset] != '\n') {
+            ++offset;
+        }
+
+        // Count the bases.
+        uint64_t baseCount = 0;
+        uint64_t invalidBaseCount = 0;
+        while(offset != bufferSize) {
+            const char c = bufferPointer[offset];
+            if(c==' ' || c=='\t' || c=='\n' || c=='\r') {
+                ++offset;
+                continue;
+            }
+            if(c=='>' && fastaReadBeginsHere(offset))  {
+                break;
+            }
+            if(Base::fromCharacterNoException(c).isValid()) {
+                ++baseCount;
             } else {
-                __sync_fetch_and_add(&discardedBadRepeatCountReadCount, 1);
-                __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, read.size());
+                ++invalidBaseCount;
             }
-        } else {
-            thisThreadReadNames.appendVector(readName.begin(), readName.end());
-            thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
-            thisThreadReads.append(read);
+            ++offset;
+        }
+
+        if(invalidBaseCount == 0) {
+            addToLengthHistogram(threadId, baseCount);
         }
     }
+}
+
+
 
+// Length scan for a block of a fastq file.
+// This only uses the line ends.
+void ReadLoader::scanFastqBlock(size_t threadId, uint64_t blockId)
+{
+    const ReadId readCountInFile = ReadId(lineEnds.size() / 4);
+
+    uint64_t begin, end;
+    tie(begin, end) = splitRange(0, readCountInFile, blockCount, blockId);
+    for(uint64_t i=begin; i!=end; i++) {
+        const auto thisReadLineEnds = lineEnds.begin() + i * 4;
+        addToLengthHistogram(threadId, thisReadLineEnds[1] - thisReadLineEnds[0] - 1);
+    }
 }
 
 
@@ -300,6 +647,10 @@ bool ReadLoader::fastaReadBeginsHere(uint64_t offset) const
 // - No Windows line ends.
 void ReadLoader::processFastqFile()
 {
+    if(streamingChunkSize and not isCompressed) {
+        processFileStreaming(true);
+        return;
+    }
 
     // Read the entire fastq file.
     const auto t0 = std::chrono::steady_clock::now();
@@ -307,6 +658,7 @@ void ReadLoader::processFastqFile()
 
     // Find all line ends in the file.
     const auto t1 = std::chrono::steady_clock::now();
+    lineEnds.clear();
     findLineEnds();
     // cout << "Found " << lineEnds.size() << " lines in this file." << endl;
 
@@ -319,50 +671,71 @@ void ReadLoader::processFastqFile()
     }
 
     // Each thread stores reads in its own data structures.
+    // They are stored in reads at the end, after processing all files.
     const auto t2 = std::chrono::steady_clock::now();
-    allocatePerThreadDataStructures();
-    runThreads(&ReadLoader::processFastqFileThreadFunction, threadCount);
+    parseBuffer(true);
     buffer.remove();
-
-
-    // Store the reads computed by each thread and free
-    // the per-thread data structures.
+    lineEnds.clear();
     const auto t3 = std::chrono::steady_clock::now();
-    storeReads();
-    const auto t4 = std::chrono::steady_clock::now();
 
 
     performanceLog << "Time to process this file:\n" <<
         "Allocate buffer + read: " << seconds(t1-t0) << " s.\n" <<
         "Locate: " << seconds(t2-t1) << " s.\n"
         "Parse: " << seconds(t3-t2) << " s.\n"
-        "Store: " << seconds(t4-t3) << " s.\n"
-        "Total: " << seconds(t4-t0) << " s." << endl;
+        "Total: " << seconds(t3-t0) << " s." << endl;
 
 
 }
 
 
 
+// Each thread processes the blocks assigned to it
+// by dynamic load balancing.
 void ReadLoader::processFastqFileThreadFunction(size_t threadId)
 {
+    if(isLengthScan) {
+        uint64_t begin, end;
+        while(getNextBatch(begin, end)) {
+            for(uint64_t blockId=begin; blockId!=end; blockId++) {
+                scanFastqBlock(threadId, blockId);
+            }
+        }
+        return;
+    }
+
+    // Allocate the data structures where this thread will store the
+    // reads it finds, if not already done.
+    if(not threadReads[threadId]) {
+        allocatePerThreadDataStructures(threadId);
+    }
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t blockId=begin; blockId!=end; blockId++) {
+            Block& block = blocks[blockBegin + blockId];
+            block.threadId = threadId;
+            block.firstRead = threadReadNames[threadId]->size();
+            processFastqBlock(threadId, blockId);
+            block.readCount = threadReadNames[threadId]->size() - block.firstRead;
+        }
+    }
+}
 
-    // Allocate and access the data structures where this thread will store the
-    // reads it finds.
-    allocatePerThreadDataStructures(threadId);
-    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames = *threadReadNames[threadId];
-    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadMetaData = *threadReadMetaData[threadId];
-    LongBaseSequences& thisThreadReads = *threadReads[threadId];
-    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
-        *threadReadRepeatCounts[threadId];
 
+
+// Process the reads in the given block.
+// For fastq files, blocks are defined in terms of reads
+// rather than bytes.
+void ReadLoader::processFastqBlock(size_t threadId, uint64_t blockId)
+{
     // Find the total number of reads in the file.
     SHASTA_ASSERT((lineEnds.size() % 4) == 0); // We already checked for that.
     const ReadId readCountInFile = ReadId(lineEnds.size() / 4);
 
-    // Compute the range of reads in the file assigned to this thread.
+    // Compute the range of reads in this block.
     uint64_t begin, end;
-    tie(begin, end) = splitRange(0, readCountInFile, threadCount, threadId);
+    tie(begin, end) = splitRange(0, readCountInFile, blockCount, blockId);
     if(begin == end) {
         return;
     }
@@ -404,11 +777,11 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
         // Check the header line.
         if (headerEnd == headerBegin) {
             throw runtime_error("Empty header line for read at offset " +
-                to_string(headerBegin - fileBegin) + ".");
+                to_string(bufferFileOffset + (headerBegin - fileBegin)) + ".");
         }
         if (*headerBegin != '@') {
             throw runtime_error("Read at offset " +
-                to_string(headerBegin - fileBegin) +
+                to_string(bufferFileOffset + (headerBegin - fileBegin)) +
                 " does not begin with \"@\".");
         }
 
@@ -426,7 +799,7 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
         }
         if(readName.empty()) {
             throw runtime_error("Empty name for read at offset " +
-                to_string(headerBegin - fileBegin) + ".");
+                to_string(bufferFileOffset + (headerBegin - fileBegin)) + ".");
         }
 
         // Extract the read meta data. It starts at the first non-space character
@@ -447,7 +820,7 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
         // We already checked above that it is at least 1 character long.
         if (*plusBegin != '+') {
             throw runtime_error("Third line does not contain \"+\" for read " +
-                                readName + " at offset " + to_string(headerBegin - fileBegin) + ".");
+                                readName + " at offset " + to_string(bufferFileOffset + (headerBegin - fileBegin)) + ".");
         }
 
         // Get the number of bases.
@@ -456,7 +829,7 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
             throw runtime_error(
                     "Inconsistent numbers of bases and quality scores for read " +
                     readName + " at offset " +
-                    to_string(headerBegin - fileBegin) + ": " +
+                    to_string(bufferFileOffset + (headerBegin - fileBegin)) + ": " +
                     to_string(baseCount) + " bases, " +
                     to_string(scoresEnd - scoresBegin) + " quality scores."
             );
@@ -469,7 +842,7 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
             const Base base = Base::fromCharacterNoException(c);
             if (!base.isValid()) {
                 throw runtime_error("Invalid base " + string(1, c) + " for read " +
-                                    readName + " at offset " + to_string(it - fileBegin) + ".");
+                                    readName + " at offset " + to_string(bufferFileOffset + (it - fileBegin)) + ".");
             }
             read.push_back(base);
         }
@@ -482,63 +855,274 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
         }
 
         // Store the read.
-        if(representation == 1) {
-            if(computeRunLengthRepresentation(read, runLengthRead, readRepeatCount)) {
-                thisThreadReadNames.appendVector(readName.begin(), readName.end());
-                thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
-                thisThreadReads.append(runLengthRead);
-                thisThreadReadRepeatCounts.appendVector(readRepeatCount);
-            } else {
-                __sync_fetch_and_add(&discardedBadRepeatCountReadCount, 1);
-                __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, read.size());
+        storeRead(threadId, readName, readMetaData, read, runLengthRead, readRepeatCount);
+    }
+}
+
+
+
+// Streaming mode.
+// The file is read in chunks of streamingChunkSize bytes.
+// While the reads in a chunk are being parsed by the worker threads,
+// a separate thread reads the next chunk.
+// Only complete reads are parsed. The incomplete read at the end
+// of a chunk is carried over and parsed together with the next chunk.
+void ReadLoader::processFileStreaming(bool isFastq)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    performanceLog << "Streaming mode, chunk size " << streamingChunkSize << " bytes." << endl;
+
+    // Open the file. O_DIRECT is not used here because chunks are appended
+    // at arbitrary offsets in nextBuffer, which violates the O_DIRECT
+    // alignment requirements. If noCache is set, readNextChunk
+    // tells the kernel that cached pages are no longer needed instead.
+    // For URLs, readNextChunk downloads each chunk using range requests instead.
+    if(httpUrl.empty()) {
+        streamingFileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+        if(streamingFileDescriptor == -1) {
+            throw runtime_error("Error opening " + fileName);
+        }
+    }
+    fileSize = getInputFileSize();
+    performanceLog <<  "File size: " << fileSize << " bytes." << endl;
+
+    streamingFileOffset = 0;
+    streamingEndOfFile = false;
+    bufferFileOffset = 0;
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    nextBuffer.createNew(dataName("tmp-FastaNextBuffer"), pageSize);
+    nextBuffer.reserve(streamingChunkSize);
+
+    // Read the first chunk.
+    readNextChunk();
+
+    double readWaitTime = 0.;
+    double parseTime = 0.;
+    uint64_t chunkCount = 0;
+    while(true) {
+        if(not streamingErrorMessage.empty()) {
+            if(streamingFileDescriptor != -1) {
+                ::close(streamingFileDescriptor);
+                streamingFileDescriptor = -1;
+            }
+            throw runtime_error(streamingErrorMessage);
+        }
+
+        // Move the complete reads in nextBuffer to buffer.
+        prepareNextChunk(isFastq);
+        const bool isLastChunk = streamingEndOfFile and nextBuffer.empty();
+
+        // Start reading the next chunk while we parse this one.
+        std::thread readerThread;
+        if(not streamingEndOfFile) {
+            readerThread = std::thread(&ReadLoader::readNextChunk, this);
+        }
+
+        // Parse the reads in this chunk.
+        // To keep memory bounded, in streaming mode
+        // the reads are stored after each chunk.
+        const auto t1 = std::chrono::steady_clock::now();
+        if(not buffer.empty()) {
+            ++chunkCount;
+            parseBuffer(isFastq);
+            storeReads();
+        }
+        const auto t2 = std::chrono::steady_clock::now();
+        parseTime += seconds(t2 - t1);
+
+        // Wait for the reader thread to finish.
+        if(readerThread.joinable()) {
+            readerThread.join();
+        }
+        readWaitTime += seconds(std::chrono::steady_clock::now() - t2);
+
+        if(isLastChunk) {
+            break;
+        }
+    }
+
+    if(streamingFileDescriptor != -1) {
+        ::close(streamingFileDescriptor);
+        streamingFileDescriptor = -1;
+    }
+    buffer.remove();
+    nextBuffer.remove();
+    lineEnds.clear();
+    const auto t3 = std::chrono::steady_clock::now();
+
+    performanceLog << "Time to process this file:\n" <<
+        "Chunks: " << chunkCount << "\n" <<
+        "Parse and store: " << parseTime << " s.\n" <<
+        "Wait for read: " << readWaitTime << " s.\n" <<
+        "Total: " << seconds(t3-t0) << " s." << endl;
+}
+
+
+
+// Append up to streamingChunkSize bytes from the file to nextBuffer.
+// This runs in a separate thread, so it does not throw.
+// Errors are reported via streamingErrorMessage.
+void ReadLoader::readNextChunk()
+{
+    // For URLs, download the chunk over multiple connections.
+    if(not httpUrl.empty()) {
+        const uint64_t chunkBegin = streamingFileOffset;
+        const uint64_t chunkEnd = min(chunkBegin + streamingChunkSize, uint64_t(fileSize));
+        const uint64_t oldSize = nextBuffer.size();
+        nextBuffer.resize(oldSize + (chunkEnd - chunkBegin));
+        const uint64_t pieceSize = max(minStreamingPieceSize,
+            (streamingChunkSize + maxReadThreadCount - 1) / maxReadThreadCount);
+        if(not readObjectRange(httpUrl, chunkBegin, chunkEnd, nextBuffer.begin() + oldSize,
+            pieceSize, min(threadCount, size_t(maxReadThreadCount)))) {
+            streamingErrorMessage = "Error reading " + fileName;
+            return;
+        }
+        streamingFileOffset = chunkEnd;
+        if(streamingFileOffset == uint64_t(fileSize)) {
+            streamingEndOfFile = true;
+        }
+        return;
+    }
+
+    const uint64_t oldSize = nextBuffer.size();
+    nextBuffer.resize(oldSize + streamingChunkSize);
+    char* bufferPointer = nextBuffer.begin() + oldSize;
+
+    uint64_t bytesToRead = streamingChunkSize;
+    uint64_t totalBytesRead = 0;
+    while(bytesToRead) {
+        const int64_t bytesRead = ::read(streamingFileDescriptor, bufferPointer, bytesToRead);
+        if(bytesRead == -1) {
+            streamingErrorMessage = "Error reading " + fileName;
+            break;
+        }
+        if(bytesRead == 0) {
+            streamingEndOfFile = true;
+            break;
+        }
+        bufferPointer += bytesRead;
+        bytesToRead -= bytesRead;
+        totalBytesRead += bytesRead;
+    }
+    nextBuffer.resize(oldSize + totalBytesRead);
+
+    // If requested, drop the pages we just read from the Linux cache.
+    if(noCache and totalBytesRead) {
+        ::posix_fadvise(streamingFileDescriptor,
+            off_t(streamingFileOffset), off_t(totalBytesRead), POSIX_FADV_DONTNEED);
+    }
+    streamingFileOffset += totalBytesRead;
+    if(streamingFileOffset == uint64_t(fileSize)) {
+        streamingEndOfFile = true;
+    }
+}
+
+
+
+// Move the complete reads at the beginning of nextBuffer to buffer,
+// and leave the incomplete read at the end in nextBuffer.
+// For fastq files, this also computes the lineEnds for the reads
+// moved to the buffer.
+void ReadLoader::prepareNextChunk(bool isFastq)
+{
+    bufferFileOffset += buffer.size();
+
+    // Copy everything to the buffer.
+    buffer.resize(nextBuffer.size());
+    copy(nextBuffer.begin(), nextBuffer.end(), buffer.begin());
+
+    // Find where the last complete read ends.
+    uint64_t chunkEnd = buffer.size();
+    if(isFastq) {
+        lineEnds.clear();
+        findLineEnds();
+        if(not streamingEndOfFile) {
+            lineEnds.resize(lineEnds.size() - (lineEnds.size() % 4));
+            chunkEnd = lineEnds.empty() ? 0 : (lineEnds.back() + 1);
+        }
+    } else {
+        if(not streamingEndOfFile) {
+            // Look backward for the last read that begins in this chunk.
+            // A read beginning at offset 0 is not sufficient, because
+            // that could be the only read, and it could be incomplete.
+            chunkEnd = 0;
+            for(uint64_t offset=buffer.size(); offset>1; offset--) {
+                if(fastaReadBeginsHere(offset - 1)) {
+                    chunkEnd = offset - 1;
+                    break;
+                }
             }
-        } else {
-            thisThreadReadNames.appendVector(readName.begin(), readName.end());
-            thisThreadReadMetaData.appendVector(readMetaData.begin(), readMetaData.end());
-            thisThreadReads.append(read);
         }
     }
+
+    // Carry over the incomplete read at the end.
+    copy(buffer.begin() + chunkEnd, buffer.end(), nextBuffer.begin());
+    nextBuffer.resize(buffer.size() - chunkEnd);
+    buffer.resize(chunkEnd);
+
+    // Check that the number of lines is a multiple of 4
+    // (there must be exactly 4 lines per read).
+    if(isFastq and (lineEnds.size() % 4) != 0) {
+        throw runtime_error("File has " + to_string(lineEnds.size()) +
+            " lines in its last chunk. Expected a multiple of 4. "
+            "Only fastq files with each read on exactly 4 lines are supported.");
+    }
 }
 
 
 
 void ReadLoader::allocateBufferAndReadFile()
 {
-    allocateBuffer();
+    // If the file is compressed, read it into the compressed buffer first.
+    MemoryMapped::Vector<char>& inputBuffer = isCompressed ? compressedBuffer : buffer;
+    allocateBuffer(inputBuffer, isCompressed ? "tmp-CompressedBuffer" : "tmp-FastaBuffer");
 
     // Try reading using the requested setting of noCache/O_DIRECT.
-    // If successful, all done.
-    if(readFile(noCache)) {
-        return;
-    }
+    bool success = readFile(inputBuffer, noCache);
 
     // If there was failure and we are using noCache, try turning it off.
-    // If successful, all done.
-    if(noCache) {
+    if(not success and noCache and httpUrl.empty()) {
         cout << "Turning off --Reads.noCache for " << fileName << endl;
-        if(readFile(false)) {
-            return;
-        }
+        success = readFile(inputBuffer, false);
     }
 
     // If getting here, nothing worked.
-    throw runtime_error("Error reading " + fileName);
+    if(not success) {
+        throw runtime_error("Error reading " + fileName);
+    }
+
+    if(isCompressed) {
+        decompress();
+    }
 }
 
 
 
-void ReadLoader::allocateBuffer()
+int64_t ReadLoader::getInputFileSize() const
+{
+    if(httpUrl.empty()) {
+        return std::filesystem::file_size(fileName);
+    } else {
+        return getObjectSize(httpUrl);
+    }
+}
+
+
+
+void ReadLoader::allocateBuffer(
+    MemoryMapped::Vector<char>& inputBuffer,
+    const string& name)
 {
     const auto t0 = std::chrono::steady_clock::now();
 
     // Create a buffer to contain the entire file.
-    fileSize = std::filesystem::file_size(fileName);
-    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    fileSize = getInputFileSize();
+    inputBuffer.createNew(dataName(name), pageSize);
 
     // Do reserve before resize, to force using exactly the
     // amount of memory necessary and nothing more.
-    buffer.reserve(fileSize);
-    buffer.resize(fileSize);
+    inputBuffer.reserve(fileSize);
+    inputBuffer.resize(fileSize);
 
     const auto t1 = std::chrono::steady_clock::now();
 
@@ -549,10 +1133,25 @@ void ReadLoader::allocateBuffer()
 
 
 // Read an entire file into the buffer.
-bool ReadLoader::readFile(bool useODirect)
+bool ReadLoader::readFile(
+    MemoryMapped::Vector<char>& inputBuffer,
+    bool useODirect)
 {
     const auto t0 = std::chrono::steady_clock::now();
 
+    // For URLs, download the file over multiple connections.
+    // O_DIRECT does not apply.
+    if(not httpUrl.empty()) {
+        const size_t connectionCount = min(threadCount, size_t(maxReadThreadCount));
+        if(not readObjectRange(httpUrl, 0, fileSize, &inputBuffer[0], readBlockSize, connectionCount)) {
+            return false;
+        }
+        const double t01 = seconds(std::chrono::steady_clock::now() - t0);
+        performanceLog << "Download time: " << t01 << " s using " << connectionCount << " connections." << endl;
+        performanceLog << "Download rate: " << double(fileSize) / t01 << " bytes/s." << endl;
+        return true;
+    }
+
     // Set up flags to open the file.
     int flags = O_RDONLY;
     if(useODirect) {
@@ -565,31 +1164,317 @@ bool ReadLoader::readFile(bool useODirect)
         return false;
     }
 
-    // Read it in.
-    char* bufferPointer = &buffer[0];
-    uint64_t bufferCapacity = buffer.capacity();
-    uint64_t bytesToRead = fileSize;
-    while(bytesToRead) {
-        const int64_t bytesRead = ::read(fileDescriptor, bufferPointer, bufferCapacity);
-        if(bytesRead == -1) {
-            ::close(fileDescriptor);
-            return false;
-        }
-        bufferPointer += bytesRead;
-        bytesToRead -= bytesRead;
-        bufferCapacity -= bytesRead;
-    }
+    // The buffer capacity is a multiple of the page size,
+    // so requests rounded up to the O_DIRECT alignment
+    // don't go past the end of the buffer.
+    SHASTA_ASSERT(inputBuffer.capacity() % readAlignment == 0);
+
+    // Read it in using multiple threads.
+    readFileData.fileDescriptor = fileDescriptor;
+    readFileData.bufferPointer = &inputBuffer[0];
+    readFileData.success = true;
+    const uint64_t blockCount = (uint64_t(fileSize) + readBlockSize - 1) / readBlockSize;
+    const size_t readThreadCount = max(size_t(1), min(min(threadCount, size_t(maxReadThreadCount)), size_t(blockCount)));
+    setupLoadBalancing(blockCount, 1);
+    runThreads(&ReadLoader::readFileThreadFunction, readThreadCount);
     ::close(fileDescriptor);
+    if(not readFileData.success) {
+        return false;
+    }
+
     const auto t1 = std::chrono::steady_clock::now();
     const double t01 = seconds(t1 - t0);
 
-    performanceLog << "Read time: " << t01 << " s." << endl;
+    performanceLog << "Read time: " << t01 << " s using " << readThreadCount << " threads." << endl;
     performanceLog << "Read rate: " << double(fileSize) / t01 << " bytes/s." << endl;
     return true;
 }
 
 
 
+// Each thread reads the blocks assigned to it.
+// Errors are reported via readFileData.success, so the caller
+// can retry without O_DIRECT.
+void ReadLoader::readFileThreadFunction(size_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t block=begin; block!=end; block++) {
+            const uint64_t blockBegin = block * readBlockSize;
+            const uint64_t blockEnd = min(blockBegin + readBlockSize, uint64_t(fileSize));
+
+            uint64_t offset = blockBegin;
+            while(offset < blockEnd) {
+
+                // Round the request size up to the O_DIRECT alignment.
+                // For the last block this can request bytes past the end of file,
+                // which is not a problem.
+                const uint64_t requestSize =
+                    ((blockEnd - offset + readAlignment - 1) / readAlignment) * readAlignment;
+                const int64_t bytesRead = ::pread(readFileData.fileDescriptor,
+                    readFileData.bufferPointer + offset, requestSize, off_t(offset));
+                if(bytesRead <= 0) {
+                    // Error, or the file became shorter while we were reading it.
+                    readFileData.success = false;
+                    return;
+                }
+                // With O_DIRECT, if a short read ends at an unaligned
+                // offset, the next pread fails and the caller retries
+                // without O_DIRECT.
+                offset += bytesRead;
+            }
+        }
+    }
+}
+
+
+
+// Decompress the compressedBuffer into the buffer,
+// then free the compressedBuffer.
+void ReadLoader::decompress()
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    if(findBgzfBlocks()) {
+        performanceLog << "File is in BGZF format with " << bgzfBlocks.size() << " blocks." << endl;
+        decompressBgzf();
+    } else {
+        performanceLog << "File is not in BGZF format, decompressing using one thread." << endl;
+        decompressGzip();
+    }
+    compressedBuffer.remove();
+
+    const auto t1 = std::chrono::steady_clock::now();
+    const double t01 = seconds(t1 - t0);
+    performanceLog << "Decompressed size: " << buffer.size() << " bytes." << endl;
+    performanceLog << "Decompress time: " << t01 << " s." << endl;
+}
+
+
+
+// Decompress a general gzip file, possibly consisting of
+// multiple concatenated gzip members.
+void ReadLoader::decompressGzip()
+{
+    // Zlib uses 32-bit sizes, so we process input and output in chunks.
+    const uint64_t maxChunkSize = 1ULL << 30;
+
+    const uint64_t compressedSize = compressedBuffer.size();
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    buffer.reserve(4 * compressedSize + 1);
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+
+    // 15 + 32 means maximum window size with automatic header detection.
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+        throw runtime_error("Error initializing decompression for " + fileName);
+    }
+
+    uint64_t inputOffset = 0;
+    while(true) {
+
+        // Make sure we have some input to work on.
+        if(stream.avail_in == 0) {
+            const uint64_t inputChunkSize = min(maxChunkSize, compressedSize - inputOffset);
+            stream.next_in = reinterpret_cast<Bytef*>(compressedBuffer.begin() + inputOffset);
+            stream.avail_in = uInt(inputChunkSize);
+            inputOffset += inputChunkSize;
+        }
+
+        // Make sure we have some space for output.
+        // The buffer can be remapped when it grows, so recompute the output pointer every time.
+        if(buffer.size() == buffer.capacity()) {
+            buffer.reserve(2 * buffer.capacity());
+        }
+        const uint64_t outputBegin = buffer.size();
+        const uint64_t outputChunkSize = min(maxChunkSize, buffer.capacity() - outputBegin);
+        buffer.resize(outputBegin + outputChunkSize);
+        stream.next_out = reinterpret_cast<Bytef*>(buffer.begin() + outputBegin);
+        stream.avail_out = uInt(outputChunkSize);
+
+        const int returnCode = inflate(&stream, Z_NO_FLUSH);
+        buffer.resize(outputBegin + outputChunkSize - stream.avail_out);
+
+        if(returnCode == Z_STREAM_END) {
+            if(stream.avail_in == 0 and inputOffset == compressedSize) {
+                break;
+            }
+            // Another gzip member follows.
+            if(inflateReset(&stream) != Z_OK) {
+                inflateEnd(&stream);
+                throw runtime_error("Error decompressing " + fileName);
+            }
+
+        } else if(returnCode == Z_BUF_ERROR) {
+            if(stream.avail_in == 0 and inputOffset == compressedSize) {
+                inflateEnd(&stream);
+                throw runtime_error("Unexpected end of compressed file " + fileName);
+            }
+
+        } else if(returnCode != Z_OK) {
+            inflateEnd(&stream);
+            throw runtime_error("Error decompressing " + fileName +
+                (stream.msg ? (string(": ") + stream.msg) : string()));
+        }
+    }
+    inflateEnd(&stream);
+
+    // Free up unused allocated memory.
+    buffer.unreserve();
+}
+
+
+
+// Locate the BGZF blocks in the compressedBuffer.
+// Returns false if the file is not in BGZF format.
+bool ReadLoader::findBgzfBlocks()
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(compressedBuffer.begin());
+    const uint64_t n = compressedBuffer.size();
+
+    // Fixed part of a gzip header and size of the gzip trailer.
+    const uint64_t headerSize = 12;
+    const uint64_t trailerSize = 8;
+
+    bgzfBlocks.clear();
+    uint64_t offset = 0;
+    uint64_t uncompressedBegin = 0;
+    while(offset < n) {
+        const uint8_t* block = p + offset;
+
+        // Check the gzip magic number, compression method, and FEXTRA flag.
+        if(offset + headerSize > n) {
+            return false;
+        }
+        if(block[0] != 31 or block[1] != 139 or block[2] != 8 or (block[3] & 4) == 0) {
+            return false;
+        }
+
+        // Look for the "BC" subfield in the extra field. It contains the
+        // total block size minus 1.
+        const uint64_t extraSize = uint64_t(block[10]) + (uint64_t(block[11]) << 8);
+        if(offset + headerSize + extraSize > n) {
+            return false;
+        }
+        uint64_t blockSize = 0;
+        for(uint64_t i=headerSize; i+4<=headerSize+extraSize; ) {
+            const uint64_t subfieldSize = uint64_t(block[i+2]) + (uint64_t(block[i+3]) << 8);
+            if(block[i] == 'B' and block[i+1] == 'C' and subfieldSize == 2) {
+                blockSize = 1 + uint64_t(block[i+4]) + (uint64_t(block[i+5]) << 8);
+                break;
+            }
+            i += 4 + subfieldSize;
+        }
+        if(blockSize == 0 or
+            blockSize < headerSize + extraSize + trailerSize or
+            offset + blockSize > n) {
+            return false;
+        }
+
+        // The trailer contains the CRC32 and the uncompressed size.
+        const uint8_t* trailer = block + blockSize - trailerSize;
+        BgzfBlock bgzfBlock;
+        bgzfBlock.compressedBegin = offset + headerSize + extraSize;
+        bgzfBlock.compressedSize = blockSize - headerSize - extraSize - trailerSize;
+        bgzfBlock.uncompressedBegin = uncompressedBegin;
+        bgzfBlock.crc =
+            uint32_t(trailer[0]) +
+            (uint32_t(trailer[1]) << 8) +
+            (uint32_t(trailer[2]) << 16) +
+            (uint32_t(trailer[3]) << 24);
+        bgzfBlock.uncompressedSize =
+            uint64_t(trailer[4]) +
+            (uint64_t(trailer[5]) << 8) +
+            (uint64_t(trailer[6]) << 16) +
+            (uint64_t(trailer[7]) << 24);
+        bgzfBlocks.push_back(bgzfBlock);
+
+        uncompressedBegin += bgzfBlock.uncompressedSize;
+        offset += blockSize;
+    }
+
+    return not bgzfBlocks.empty();
+}
+
+
+
+// Decompress the BGZF blocks in parallel.
+void ReadLoader::decompressBgzf()
+{
+    // The uncompressed size is known, so we can allocate the buffer exactly.
+    const BgzfBlock& lastBlock = bgzfBlocks.back();
+    const uint64_t uncompressedSize = lastBlock.uncompressedBegin + lastBlock.uncompressedSize;
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    buffer.reserve(uncompressedSize);
+    buffer.resize(uncompressedSize);
+
+    // Each block is at most 64 KB, so use large batches.
+    const uint64_t batchSize = 64;
+    setupLoadBalancing(bgzfBlocks.size(), batchSize);
+    runThreads(&ReadLoader::decompressBgzfThreadFunction, threadCount);
+
+    bgzfBlocks.clear();
+    bgzfBlocks.shrink_to_fit();
+}
+
+
+
+void ReadLoader::decompressBgzfThreadFunction(size_t /* threadId */)
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+
+    // Negative window size means raw deflate data, without a gzip header.
+    if(inflateInit2(&stream, -15) != Z_OK) {
+        throw runtime_error("Error initializing decompression for " + fileName);
+    }
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over blocks assigned to this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+            const BgzfBlock& block = bgzfBlocks[i];
+            Bytef* output = reinterpret_cast<Bytef*>(buffer.begin() + block.uncompressedBegin);
+
+            if(inflateReset(&stream) != Z_OK) {
+                throw runtime_error("Error decompressing " + fileName);
+            }
+            stream.next_in = reinterpret_cast<Bytef*>(compressedBuffer.begin() + block.compressedBegin);
+            stream.avail_in = uInt(block.compressedSize);
+            stream.next_out = output;
+            stream.avail_out = uInt(block.uncompressedSize);
+
+            const int returnCode = inflate(&stream, Z_FINISH);
+            if(returnCode != Z_STREAM_END or stream.avail_out != 0) {
+                throw runtime_error("Error decompressing BGZF block " + to_string(i) +
+                    " of " + fileName);
+            }
+
+            // Check the CRC.
+            const uint32_t crc = uint32_t(crc32(0L, output, uInt(block.uncompressedSize)));
+            if(crc != block.crc) {
+                throw runtime_error("CRC mismatch for BGZF block " + to_string(i) +
+                    " of " + fileName);
+            }
+        }
+    }
+
+    inflateEnd(&stream);
+}
+
+
+
 // Find all of the line ends ('\n') in the buffer.
 void ReadLoader::findLineEnds()
 {
@@ -655,12 +1540,18 @@ string ReadLoader::threadDataName(
 
 // Allocate space for the data structures where
 // each thread stores the reads it found and their names.
+// The data structures for each thread are allocated
+// by the thread itself the first time it runs.
 void ReadLoader::allocatePerThreadDataStructures()
 {
+    if(threadReads.size() == threadCount) {
+        return;
+    }
     threadReadNames.resize(threadCount);
     threadReadMetaData.resize(threadCount);
     threadReads.resize(threadCount);
     threadReadRepeatCounts.resize(threadCount); // Not actually used is representation==1
+    threadMarkerPositions.resize(threadCount);  // Not actually used if kmerChecker is null
 }
 
 
@@ -680,42 +1571,47 @@ void ReadLoader::allocatePerThreadDataStructures(size_t threadId)
         threadReadRepeatCounts[threadId]->createNew(
             threadDataName(threadId, "ReadRepeatCounts"), pageSize);
     }
+    threadMarkerPositions[threadId] = make_unique< MemoryMapped::VectorOfVectors<uint32_t, uint64_t> >();
+    if(kmerChecker) {
+        threadMarkerPositions[threadId]->createNew(
+            threadDataName(threadId, "MarkerPositions"), pageSize);
+    }
 }
 
 
 
 // Store the reads computed by each thread and free
 // the per-thread data structures.
+// The reads are stored block by block, in the order in which
+// the blocks appear in the input files.
+// This way, the order of the reads does not depend on which
+// thread processed each block.
 void ReadLoader::storeReads()
 {
-    // Loop over all threads.
-    for(size_t threadId=0; threadId<threadCount; threadId++) {
+    // Loop over all blocks processed since the last call to storeReads.
+    for(const Block& block: blocks) {
+        if(block.readCount == 0) {
+            continue;
+        }
+        const size_t threadId = block.threadId;
 
         // Access the names.
-        MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames =
+        const MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames =
             *(threadReadNames[threadId]);
 
         // Access the meta data.
-        MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadMetaData =
+        const MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadMetaData =
             *(threadReadMetaData[threadId]);
 
         // Access the reads.
-        LongBaseSequences& thisThreadReads = *(threadReads[threadId]);
-        const size_t n = thisThreadReadNames.size();
-        SHASTA_ASSERT(thisThreadReads.size() == n);
-        SHASTA_ASSERT(thisThreadReadMetaData.size() == n);
+        const LongBaseSequences& thisThreadReads = *(threadReads[threadId]);
 
         // Access the repeat counts.
-        MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
+        const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
             *threadReadRepeatCounts[threadId];
-        if(representation == 1) {
-            SHASTA_ASSERT(thisThreadReadRepeatCounts.size() == n);
-        } else {
-            SHASTA_ASSERT(not thisThreadReadRepeatCounts.isOpen());
-        }
 
         // Store the reads.
-        for(size_t i=0; i<n; i++) {
+        for(size_t i=block.firstRead; i<block.firstRead+block.readCount; i++) {
             reads.readNames.appendVector(thisThreadReadNames.begin(i), thisThreadReadNames.end(i));
             reads.readMetaData.appendVector(thisThreadReadMetaData.begin(i), thisThreadReadMetaData.end(i));
             reads.reads.append(thisThreadReads[i]);
@@ -727,14 +1623,36 @@ void ReadLoader::storeReads()
                     thisThreadReadRepeatCounts.end(i),
                     reads.readRepeatCounts.begin(j));
             }
+            if(kmerChecker) {
+                const auto thisReadMarkerPositions = (*threadMarkerPositions[threadId])[i];
+                markerPositions->appendVector(thisReadMarkerPositions.begin(), thisReadMarkerPositions.end());
+            }
         }
+    }
+    blocks.clear();
+
 
-        // Remove the data structures used by this thread.
-        thisThreadReadNames.remove();
-        thisThreadReadMetaData.remove();
-        thisThreadReads.remove();
+
+    // Remove the data structures used by each thread.
+    for(size_t threadId=0; threadId<threadReads.size(); threadId++) {
+        if(not threadReads[threadId]) {
+            continue;
+        }
+        const size_t n = threadReadNames[threadId]->size();
+        SHASTA_ASSERT(threadReads[threadId]->size() == n);
+        SHASTA_ASSERT(threadReadMetaData[threadId]->size() == n);
+        threadReadNames[threadId]->remove();
+        threadReadMetaData[threadId]->remove();
+        threadReads[threadId]->remove();
         if(representation == 1) {
-            thisThreadReadRepeatCounts.remove();
+            SHASTA_ASSERT(threadReadRepeatCounts[threadId]->size() == n);
+            threadReadRepeatCounts[threadId]->remove();
+        } else {
+            SHASTA_ASSERT(not threadReadRepeatCounts[threadId]->isOpen());
+        }
+        if(kmerChecker) {
+            SHASTA_ASSERT(threadMarkerPositions[threadId]->size() == n);
+            threadMarkerPositions[threadId]->remove();
         }
     }
 
@@ -743,6 +1661,15 @@ void ReadLoader::storeReads()
     threadReadMetaData.clear();
     threadReads.clear();
     threadReadRepeatCounts.clear();
+    threadMarkerPositions.clear();
+}
+
+
+
+// Free unused memory in the Reads data structures
+// after storeReads was called for the last time.
+void ReadLoader::finishStoringReads()
+{
 
     // Free up unused allocated memory.
     reads.readNames.unreserve();
@@ -751,6 +1678,9 @@ void ReadLoader::storeReads()
         reads.readRepeatCounts.unreserve();
     }
     reads.reads.unreserve();
+    if(kmerChecker) {
+        markerPositions->unreserve();
+    }
 
     // Allocate enough space for readFlags which are populated later.
     reads.readFlags.resize(reads.readCount());
@@ -10,30 +10,46 @@
 // Standard library.
 #include "memory.hpp"
 #include "string.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     class ReadLoader;
+    class KmerChecker;
 
     extern template class MultithreadedObject<ReadLoader>;
 }
 
 
 
-// Class used to load reads from a fasta file.
+// Class used to load reads from a fasta or fastq file.
+// The file can optionally be gzip compressed (extension .gz).
+// If it is in BGZF format (as created by bgzip),
+// decompression is multithreaded.
+// If a KmerChecker is specified, the strand 0 marker positions of each read
+// are also computed, by the same threads that parse the reads,
+// and stored in markerPositions in the same order as the reads.
+// This overlaps marker finding with reading and parsing the input files.
 class shasta::ReadLoader :
     public MultithreadedObject<ReadLoader>{
 public:
 
     // The constructor does all the work.
+    // The reads from all files are stored in the order
+    // in which they appear in the input files.
     ReadLoader(
-        const string& fileName,
+        const vector<string>& fileNames,
         uint64_t representation, // 0 = raw sequence, 1 = RLE sequence
         uint64_t minReadLength,
+        uint64_t desiredCoverage,   // 0 = no length scan.
         bool noCache,
+        uint64_t streamingChunkSize, // In bytes. 0 = no streaming.
         size_t threadCount,
         const string& dataNamePrefix,
         size_t pageSize,
-        Reads& reads);
+        Reads& reads,
+        const KmerChecker* kmerChecker = 0,
+        uint64_t k = 0,
+        MemoryMapped::VectorOfVectors<uint32_t, uint64_t>* markerPositions = 0);
 
     ~ReadLoader();
 
@@ -57,24 +73,55 @@ public:
     uint64_t discardedBadRepeatCountReadCount = 0;
     uint64_t discardedBadRepeatCountBaseCount = 0;
 
+    // The number of reads that were too long for marker positions
+    // (see CompressedMarker) and were split into pieces,
+    // and the total number of pieces they were split into.
+    uint64_t splitReadCount = 0;
+    uint64_t splitReadPieceCount = 0;
+
+    // If desiredCoverage is not zero, the constructor first does
+    // a fast scan of all input files that only computes read lengths,
+    // without decoding and storing the reads.
+    // From the resulting read length histogram it computes
+    // the read length cutoff that gives the desired coverage.
+    // Only the reads that satisfy the increased cutoff are then
+    // decoded and stored.
+    // These contain the read length histogram computed by the scan
+    // (for reads satisfying the original minReadLength) and the
+    // read length cutoff that was actually used.
+    vector<uint64_t> lengthScanHistogram;
+    uint64_t getMinReadLength() const
+    {
+        return minReadLength;
+    }
+
 private:
 
     // The name of the file we are processing.
-    const string& fileName;
+    string fileName;
+    void processFile();
 
     // Read representation.
     // 0 = raw sequence, 1 = RLE sequence
     uint64_t representation;
 
     // The minimum read length. Shorter reads are not stored.
-    const uint64_t minReadLength;
+    // This can be increased by the length scan.
+    uint64_t minReadLength;
+
+    // The length scan.
+    bool isLengthScan = false;
+    vector< vector<uint64_t> > threadLengthHistograms;
+    void lengthScan(const vector<string>& fileNames, uint64_t desiredCoverage);
+    void scanFastaBlock(size_t threadId, uint64_t blockId);
+    void scanFastqBlock(size_t threadId, uint64_t blockId);
+    void addToLengthHistogram(size_t threadId, uint64_t length);
 
     // If set, use the O_DIRECT flag when opening input files (Linux only).
     bool noCache;
 
     // The number of threads to be used for processing.
-    // Reading is done single-threaded as there is usually no benefit
-    // frm multithreaded reading.
+    // Reading uses at most maxReadThreadCount of these threads.
     size_t threadCount;
     void adjustThreadCount();
 
@@ -86,6 +133,12 @@ private:
     // The data structure that the reads will be added to.
     Reads& reads;
 
+    // If kmerChecker is not null, marker positions are computed
+    // for each read as it is stored and added to markerPositions.
+    const KmerChecker* kmerChecker;
+    uint64_t k;
+    MemoryMapped::VectorOfVectors<uint32_t, uint64_t>* markerPositions;
+
     // Create the name to be used for a MemoryMapped object.
     string dataName(
         const string& dataName) const;
@@ -93,20 +146,79 @@ private:
         size_t threadId,
         const string& dataName) const;
 
-    // Read an entire file into a buffer,
-    // using threadCountForReading threads.
+    // If the input file is a URL (see objectStorage.hpp),
+    // the http or https URL used to download it. Otherwise empty.
+    string httpUrl;
+    int64_t getInputFileSize() const;
+
+    // Read an entire file into a buffer.
     int64_t fileSize;
     MemoryMapped::Vector<char> buffer;
-    void allocateBuffer();
-    bool readFile(bool useODirect);
+    void allocateBuffer(MemoryMapped::Vector<char>&, const string& name);
+    bool readFile(MemoryMapped::Vector<char>&, bool useODirect);
     void allocateBufferAndReadFile();
 
+    // Multithreaded reading.
+    // The file is divided in blocks of readBlockSize bytes,
+    // and each thread uses pread to read the blocks assigned to it.
+    // This keeps multiple read requests in flight,
+    // which is necessary to use the full bandwidth of fast storage devices,
+    // particularly when using O_DIRECT.
+    // The block size is a multiple of the alignment required by O_DIRECT.
+    static const uint64_t readBlockSize = 64ULL * 1024ULL * 1024ULL;
+    static const uint64_t readAlignment = 4096;
+    static const size_t maxReadThreadCount = 16;
+
+    // For URLs, the file is downloaded in pieces of at most readBlockSize bytes,
+    // using up to maxReadThreadCount concurrent connections.
+    // In streaming mode, the pieces are smaller,
+    // so each chunk is still downloaded over multiple connections.
+    static const uint64_t minStreamingPieceSize = 8ULL * 1024ULL * 1024ULL;
+    class ReadFileData {
+    public:
+        int fileDescriptor;
+        char* bufferPointer;
+        bool success;
+    };
+    ReadFileData readFileData;
+    void readFileThreadFunction(size_t threadId);
+
+    // Gzip compressed input.
+    // If the file is compressed, it is first read into compressedBuffer,
+    // then decompressed into buffer.
+    bool isCompressed = false;
+    MemoryMapped::Vector<char> compressedBuffer;
+    void decompress();
+
+    // Decompression of a general gzip file (single threaded).
+    void decompressGzip();
+
+    // Decompression of a BGZF file (multithreaded).
+    // BGZF is a sequence of independent gzip blocks, each of which
+    // stores its compressed size in the gzip header and its
+    // uncompressed size in the gzip trailer.
+    // So we can locate all the blocks, compute where each of them
+    // goes in the decompressed buffer, and then decompress them in parallel.
+    class BgzfBlock {
+    public:
+        uint64_t compressedBegin;   // Offset of the deflate data in compressedBuffer.
+        uint64_t compressedSize;    // Size of the deflate data.
+        uint64_t uncompressedBegin; // Offset in buffer.
+        uint64_t uncompressedSize;
+        uint32_t crc;
+    };
+    vector<BgzfBlock> bgzfBlocks;
+    bool findBgzfBlocks();
+    void decompressBgzf();
+    void decompressBgzfThreadFunction(size_t threadId);
+
     // Vectors where each thread stores the reads it found.
     // Indexed by threadId.
     vector< unique_ptr<MemoryMapped::VectorOfVectors<char, uint64_t> > > threadReadNames;
     vector< unique_ptr<MemoryMapped::VectorOfVectors<char, uint64_t> > > threadReadMetaData;
     vector< unique_ptr<LongBaseSequences> > threadReads;
     vector< unique_ptr<MemoryMapped::VectorOfVectors<uint8_t, uint64_t> > > threadReadRepeatCounts;
+    vector< unique_ptr<MemoryMapped::VectorOfVectors<uint32_t, uint64_t> > > threadMarkerPositions;
     void allocatePerThreadDataStructures();
     void allocatePerThreadDataStructures(size_t threadId);
 
@@ -114,18 +226,78 @@ private:
     // the per-thread data structures.
     void storeReads();
 
+    // Free unused memory in the Reads data structures
+    // after storeReads was called for the last time.
+    void finishStoringReads();
+
+    // Streaming mode, used if streamingChunkSize is not zero
+    // and the file is not compressed.
+    // The file is read in chunks of streamingChunkSize bytes.
+    // A separate thread reads the next chunk into nextBuffer
+    // while the reads in the current chunk are being parsed from buffer.
+    // At each step, buffer receives only complete reads, and the
+    // incomplete read at the end of a chunk is carried over
+    // at the beginning of nextBuffer.
+    uint64_t streamingChunkSize;
+    MemoryMapped::Vector<char> nextBuffer;
+    int streamingFileDescriptor = -1;
+    uint64_t streamingFileOffset = 0;
+    bool streamingEndOfFile = false;
+    string streamingErrorMessage;
+    void processFileStreaming(bool isFastq);
+    void readNextChunk();
+    void prepareNextChunk(bool isFastq);
+
+    // The offset in the file of the first character in the buffer.
+    // This is zero except in streaming mode.
+    uint64_t bufferFileOffset = 0;
+
+    // Parsing is done in blocks assigned to threads using
+    // dynamic load balancing, with blocksPerThread blocks
+    // per thread for each file (or chunk, in streaming mode).
+    // For each block we store the thread that processed it
+    // and where that thread stored the reads it found.
+    // This allows storeReads to store the reads in the same
+    // order as in the input files, regardless of which
+    // thread processed each block.
+    class Block {
+    public:
+        size_t threadId = 0;
+        uint64_t firstRead = 0;
+        uint64_t readCount = 0;
+    };
+    static const uint64_t blocksPerThread = 16;
+    vector<Block> blocks;
+    uint64_t blockBegin = 0;    // Index in blocks of the first block of the current file.
+    uint64_t blockCount = 0;    // Number of blocks for the current file.
+    void parseBuffer(bool isFastq);
+
     // Functions used for fasta files.
     void processFastaFile();
     void processFastaFileThreadFunction(size_t threadId);
+    void processFastaBlock(size_t threadId, uint64_t blockId);
     // Function that returns true if a read begins
     // at this position in Fasta format.
     bool fastaReadBeginsHere(uint64_t offset) const;
 
+    // Store a read found by processFastaBlock or processFastqBlock
+    // in the data structures of this thread, in the requested representation.
+    // Reads longer than CompressedMarker::maxReadLength are split into pieces.
+    void storeRead(
+        size_t threadId,
+        const string& readName,
+        const string& readMetaData,
+        const vector<Base>& read,
+        vector<Base>& runLengthRead,
+        vector<uint8_t>& readRepeatCount);
+    void storeMarkerPositions(size_t threadId);
+
     // Functions used for fastq files.
     void processFastqFile();
     void processFastqFileThreadFunction(size_t threadId);
+    void processFastqBlock(size_t threadId, uint64_t blockId);
 
-    // Find all line ends in the file.
+    // Find all line ends in the buffer.
     void findLineEnds();
     void findLineEndsThreadFunction(size_t threadId);
     vector< vector<uint64_t> > threadLineEnds;
@@ -0,0 +1,252 @@
+// Shasta.
+#include "ReadSequenceIndex.hpp"
+#include "LongBaseSequence.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+
+// Explicit instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<ReadSequenceIndex>;
+
+
+
+// Initial creation.
+ReadSequenceIndex::ReadSequenceIndex(
+    const Reads& reads,
+    uint64_t step,
+    uint64_t threadCount,
+    const MappedMemoryOwner& mappedMemoryOwner) :
+    MultithreadedObject<ReadSequenceIndex>(*this),
+    MappedMemoryOwner(mappedMemoryOwner),
+    reads(reads)
+{
+    if(step == 0) {
+        throw runtime_error("The step of the read sequence index cannot be 0.");
+    }
+    data.createNew(largeDataName("ReadSequenceIndexData"), largeDataPageSize);
+    data->k = k;
+    data->step = step;
+
+    cout << timestamp << "Creating the read sequence index with step " << step << "." << endl;
+    const uint64_t batchSize = 1000;
+
+    // Pass 1: count the k-mers in each bucket.
+    buckets.createNew(largeDataName("ReadSequenceIndex"), largeDataPageSize);
+    buckets.beginPass1(uint64_t(1) << 16);
+    setupLoadBalancing(reads.readCount(), batchSize);
+    runThreads(&ReadSequenceIndex::threadFunction1, threadCount);
+
+    // Pass 2: store them.
+    buckets.beginPass2();
+    setupLoadBalancing(reads.readCount(), batchSize);
+    runThreads(&ReadSequenceIndex::threadFunction2, threadCount);
+    buckets.endPass2(false);
+
+    // Sort each bucket.
+    setupLoadBalancing(buckets.size(), 1);
+    runThreads(&ReadSequenceIndex::threadFunction3, threadCount);
+
+    cout << timestamp << "The read sequence index contains " << buckets.totalSize() <<
+        " k-mers." << endl;
+}
+
+
+
+// Creation from binary data.
+ReadSequenceIndex::ReadSequenceIndex(
+    const Reads& reads,
+    const MappedMemoryOwner& mappedMemoryOwner) :
+    MultithreadedObject<ReadSequenceIndex>(*this),
+    MappedMemoryOwner(mappedMemoryOwner),
+    reads(reads)
+{
+    data.accessExistingReadOnly(largeDataName("ReadSequenceIndexData"));
+    SHASTA_ASSERT(data->k == k);
+    buckets.accessExistingReadOnly(largeDataName("ReadSequenceIndex"));
+}
+
+
+
+uint32_t ReadSequenceIndex::getKmer(const LongBaseSequenceView& read, uint64_t position)
+{
+    uint32_t kmer = 0;
+    for(uint64_t i=0; i<k; i++) {
+        kmer = (kmer << 2) | read[position + i].value;
+    }
+    return kmer;
+}
+
+
+
+void ReadSequenceIndex::threadFunction1(uint64_t /* threadId */)
+{
+    const uint64_t step = data->step;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const LongBaseSequenceView read = reads.getRead(readId);
+            for(uint64_t position=0; position+k<=read.baseCount; position+=step) {
+                buckets.incrementCountMultithreaded(getKmer(read, position) >> 16);
+            }
+        }
+    }
+}
+
+
+
+void ReadSequenceIndex::threadFunction2(uint64_t /* threadId */)
+{
+    const uint64_t step = data->step;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const LongBaseSequenceView read = reads.getRead(readId);
+            for(uint64_t position=0; position+k<=read.baseCount; position+=step) {
+                const uint32_t kmer = getKmer(read, position);
+                Entry entry;
+                entry.readId = readId;
+                entry.position = uint32_t(position);
+                entry.lowBits = uint16_t(kmer & 0xffff);
+                buckets.storeMultithreaded(kmer >> 16, entry);
+            }
+        }
+    }
+}
+
+
+
+// Sort each bucket by low bits. The read ids and positions
+// are also used, so the result does not depend on the order
+// in which the threads stored the entries.
+void ReadSequenceIndex::threadFunction3(uint64_t /* threadId */)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t bucketId=begin; bucketId!=end; bucketId++) {
+            span<Entry> bucket = buckets[bucketId];
+            sort(bucket.begin(), bucket.end(),
+                [](const Entry& x, const Entry& y)
+                {
+                    return
+                        tie(x.lowBits, x.readId, x.position) <
+                        tie(y.lowBits, y.readId, y.position);
+                });
+        }
+    }
+}
+
+
+
+bool ReadSequenceIndex::find(
+    const vector<Base>& sequenceArgument,
+    uint64_t maxHitCount,
+    vector<Hit>& hits) const
+{
+    hits.clear();
+
+    // If the reads are stored in run-length representation,
+    // convert the sequence to run-length representation.
+    vector<Base> sequence;
+    if(reads.representation == 1) {
+        for(const Base b: sequenceArgument) {
+            if(sequence.empty() or b != sequence.back()) {
+                sequence.push_back(b);
+            }
+        }
+    } else {
+        sequence = sequenceArgument;
+    }
+
+    if(sequence.size() < minSequenceLength()) {
+        throw runtime_error("The sequence must have at least " +
+            to_string(minSequenceLength()) + " bases" +
+            ((reads.representation == 1) ? " in run-length representation." : "."));
+    }
+
+    // Occurrences on strand 0 of the reads.
+    bool isComplete = findOnStrand0(sequence, 0, maxHitCount, hits);
+
+    // Occurrences on strand 1 of the reads are
+    // occurrences of the reverse complement on strand 0.
+    if(isComplete) {
+        vector<Base> reverseComplementedSequence;
+        for(auto it=sequence.rbegin(); it!=sequence.rend(); ++it) {
+            reverseComplementedSequence.push_back(it->complement());
+        }
+        isComplete = findOnStrand0(reverseComplementedSequence, 1, maxHitCount, hits);
+    }
+
+    sort(hits.begin(), hits.end());
+    return isComplete;
+}
+
+
+
+// Find the occurrences of a sequence on strand 0 of the reads,
+// and add them to the hits as occurrences on the specified strand.
+bool ReadSequenceIndex::findOnStrand0(
+    const vector<Base>& sequence,
+    Strand strand,
+    uint64_t maxHitCount,
+    vector<Hit>& hits) const
+{
+    const uint64_t step = data->step;
+    const uint64_t n = sequence.size();
+
+    for(uint64_t offset=0; offset<step; offset++) {
+
+        // The k-mer of the sequence at this offset.
+        uint32_t kmer = 0;
+        for(uint64_t i=0; i<k; i++) {
+            kmer = (kmer << 2) | sequence[offset + i].value;
+        }
+        const uint16_t lowBits = uint16_t(kmer & 0xffff);
+
+        // Look it up.
+        const span<const Entry> bucket = buckets[kmer >> 16];
+        auto it = std::lower_bound(bucket.begin(), bucket.end(), lowBits,
+            [](const Entry& entry, uint16_t lowBits)
+            {
+                return entry.lowBits < lowBits;
+            });
+
+        // Check each candidate occurrence.
+        for(; it!=bucket.end() and it->lowBits==lowBits; ++it) {
+            if(it->position < offset) {
+                continue;
+            }
+            const uint64_t begin = it->position - offset;
+            const LongBaseSequenceView read = reads.getRead(it->readId);
+            if(begin + n > read.baseCount) {
+                continue;
+            }
+            bool isMatch = true;
+            for(uint64_t i=0; i<n; i++) {
+                if(read[begin + i] != sequence[i]) {
+                    isMatch = false;
+                    break;
+                }
+            }
+            if(not isMatch) {
+                continue;
+            }
+
+            Hit hit;
+            hit.orientedReadId = OrientedReadId(it->readId, strand);
+            hit.position = uint32_t((strand == 0) ? begin : (read.baseCount - begin - n));
+            hits.push_back(hit);
+            if(hits.size() >= maxHitCount) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+#ifndef SHASTA_READ_SEQUENCE_INDEX_HPP
+#define SHASTA_READ_SEQUENCE_INDEX_HPP
+
+/*******************************************************************************
+
+Index used to find all occurrences of a sequence in the reads.
+
+The index contains the k-mers (k=16) that begin at positions
+0, step, 2*step, ... of each read, on strand 0 only.
+Any occurrence of a sequence of length at least k+step-1
+contains exactly one of these k-mers at an offset less than step
+from the beginning of the occurrence.
+So all occurrences are found by looking up the first step k-mers
+of the sequence and of its reverse complement, and then checking
+each candidate against the read sequence.
+
+The k-mers are stored in buckets indexed by their 16 high bits.
+Each bucket is sorted by the 16 low bits, so a lookup
+is a binary search in a single bucket.
+Each indexed k-mer uses 12 bytes, so the index uses
+about 12/step bytes per base of the reads.
+
+The index is memory mapped and stored with the rest of the binary data,
+so it only needs to be created once for each assembly.
+
+Positions are in the representation used to store the reads.
+For assemblies that use the run-length representation
+the sequence to be found is converted to run-length representation
+before searching.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Base.hpp"
+#include "MappedMemoryOwner.hpp"
+#include "MemoryMappedObject.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MultithreadedObject.hpp"
+#include "ReadId.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "tuple.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class LongBaseSequenceView;
+    class ReadSequenceIndex;
+    class Reads;
+}
+
+
+
+class shasta::ReadSequenceIndex :
+    public MultithreadedObject<ReadSequenceIndex>,
+    public MappedMemoryOwner {
+public:
+
+    static const uint64_t k = 16;
+
+    // Initial creation.
+    ReadSequenceIndex(
+        const Reads&,
+        uint64_t step,
+        uint64_t threadCount,
+        const MappedMemoryOwner&);
+
+    // Creation from binary data.
+    ReadSequenceIndex(
+        const Reads&,
+        const MappedMemoryOwner&);
+
+    uint64_t step() const
+    {
+        return data->step;
+    }
+    uint64_t minSequenceLength() const
+    {
+        return k + step() - 1;
+    }
+    uint64_t size() const
+    {
+        return buckets.totalSize();
+    }
+
+    // An occurrence of a sequence in an oriented read.
+    class Hit {
+    public:
+        OrientedReadId orientedReadId;
+        uint32_t position;
+        bool operator<(const Hit& that) const
+        {
+            return tie(orientedReadId, position) < tie(that.orientedReadId, that.position);
+        }
+    };
+
+    // Find the occurrences of a sequence and its reverse complement,
+    // sorted by oriented read and position.
+    // Returns false if the search stopped after finding maxHitCount occurrences.
+    bool find(
+        const vector<Base>& sequence,
+        uint64_t maxHitCount,
+        vector<Hit>&) const;
+
+private:
+    const Reads& reads;
+
+    class Entry {
+    public:
+        ReadId readId;
+        uint32_t position;
+        uint16_t lowBits;
+    };
+    MemoryMapped::VectorOfVectors<Entry, uint64_t> buckets;
+
+    class Data {
+    public:
+        uint64_t k;
+        uint64_t step;
+    };
+    MemoryMapped::Object<Data> data;
+
+    // Return the k-mer at a given position of a read, with 2 bits per base.
+    static uint32_t getKmer(const LongBaseSequenceView&, uint64_t position);
+
+    // Find the occurrences of a sequence on strand 0 of the reads.
+    bool findOnStrand0(
+        const vector<Base>&,
+        Strand,
+        uint64_t maxHitCount,
+        vector<Hit>&) const;
+
+    void threadFunction1(uint64_t threadId);
+    void threadFunction2(uint64_t threadId);
+    void threadFunction3(uint64_t threadId);
+};
+
+#endif
@@ -1,9 +1,17 @@
 // Shasta
 #include "Reads.hpp"
+#include "computeRunLengthRepresentation.hpp"
+#include "copyPermuted.hpp"
+#include "parallelFor.hpp"
+#include "parallelSort.hpp"
 #include "ReadId.hpp"
 
 // Standard Library
 #include "fstream.hpp"
+#include "iostream.hpp"
+#include <filesystem>
+#include <limits>
+#include <thread>
 #include "tuple.hpp"
 
 using namespace shasta;
@@ -41,40 +49,107 @@ void Reads::access(
 {
     representation = representationArgument;
     reads.accessExistingReadWrite(readsDataName);
-    readNames.accessExistingReadWrite(readNamesDataName);
-    readMetaData.accessExistingReadWrite(readMetaDataDataName);
+    // If the names were compressed, only the compressed form exists.
+    if(std::filesystem::exists(readNamesDataName + ".toc")) {
+        readNames.accessExistingReadWrite(readNamesDataName);
+        readMetaData.accessExistingReadWrite(readMetaDataDataName);
+    } else {
+        compressedReadNames.accessExistingReadWrite(readNamesDataName + "-FrontCoded");
+        readNameRanks.accessExistingReadWrite(readNamesDataName + "-Ranks");
+        compressedReadMetaData.accessExistingReadWrite(readMetaDataDataName + "-FrontCoded");
+        readNumericMetaData.accessExistingReadWrite(readMetaDataDataName + "-Numeric");
+        namesAreCompressed = true;
+    }
     if(representation == 1) {
-        readRepeatCounts.accessExistingReadWrite(readRepeatCountsDataName);
+        // If the repeat counts were compressed, only the compressed form exists.
+        if(std::filesystem::exists(readRepeatCountsDataName + ".toc")) {
+            readRepeatCounts.accessExistingReadWrite(readRepeatCountsDataName);
+        } else {
+            packedRepeatCounts.accessExistingReadWrite(readRepeatCountsDataName + "-Packed");
+            repeatCountExceptions.accessExistingReadWrite(readRepeatCountsDataName + "-Exceptions");
+            repeatCountsAreCompressed = true;
+        }
     }
     readFlags.accessExistingReadWrite(readFlagsDataName);
     readIdsSortedByName.accessExistingReadWrite(readIdsSortedByNameDataName);
 }
 
 
+void Reads::accessReadStore(
+    uint64_t representationArgument, // 0 = raw sequence, 1 = RLE sequence
+    const string& readsDataName,
+    const string& readNamesDataName,
+    const string& readMetaDataDataName,
+    const string& readRepeatCountsDataName)
+{
+    representation = representationArgument;
+    reads.accessExistingReadOnly(readsDataName);
+    readNames.accessExistingReadOnly(readNamesDataName);
+    readMetaData.accessExistingReadOnly(readMetaDataDataName);
+    if(representation == 1) {
+        readRepeatCounts.accessExistingReadOnly(readRepeatCountsDataName);
+    }
+}
+
+
 void Reads::rename() {
     const string suffix = "_old";
     const string readsDataName = reads.getName();
     const string readNamesDataName = readNames.getName();
     const string readMetaDataDataName = readMetaData.getName();
+    const string compressedReadNamesDataName = compressedReadNames.getName();
+    const string readNameRanksDataName = readNameRanks.fileName;
+    const string compressedReadMetaDataDataName = compressedReadMetaData.getName();
+    const string readNumericMetaDataDataName = readNumericMetaData.fileName;
     const string readRepeatCountsDataName = readRepeatCounts.getName();
+    const string packedRepeatCountsDataName = packedRepeatCounts.getName();
+    const string repeatCountExceptionsDataName = repeatCountExceptions.getName();
     const string readFlagsDataName = readFlags.fileName;
+    const string readIdsSortedByNameDataName = readIdsSortedByName.fileName;
 
     // No need to rename if anonymous memory mode is used.
     if (!readsDataName.empty()) {
         reads.rename(readsDataName + suffix);
     }
-    if (!readNamesDataName.empty()) {
-        readNames.rename(readNamesDataName + suffix);
-    }
-    if (!readMetaDataDataName.empty()) {
-        readMetaData.rename(readMetaDataDataName + suffix);
+    if(namesAreCompressed) {
+        if (!compressedReadNamesDataName.empty()) {
+            compressedReadNames.rename(compressedReadNamesDataName + suffix);
+        }
+        if (!readNameRanksDataName.empty()) {
+            readNameRanks.rename(readNameRanksDataName + suffix);
+        }
+        if (!compressedReadMetaDataDataName.empty()) {
+            compressedReadMetaData.rename(compressedReadMetaDataDataName + suffix);
+        }
+        if (!readNumericMetaDataDataName.empty()) {
+            readNumericMetaData.rename(readNumericMetaDataDataName + suffix);
+        }
+    } else {
+        if (!readNamesDataName.empty()) {
+            readNames.rename(readNamesDataName + suffix);
+        }
+        if (!readMetaDataDataName.empty()) {
+            readMetaData.rename(readMetaDataDataName + suffix);
+        }
     }
-    if (!readRepeatCountsDataName.empty()) {
-        readRepeatCounts.rename(readRepeatCountsDataName + suffix);
+    if(repeatCountsAreCompressed) {
+        if (!packedRepeatCountsDataName.empty()) {
+            packedRepeatCounts.rename(packedRepeatCountsDataName + suffix);
+        }
+        if (!repeatCountExceptionsDataName.empty()) {
+            repeatCountExceptions.rename(repeatCountExceptionsDataName + suffix);
+        }
+    } else {
+        if (!readRepeatCountsDataName.empty()) {
+            readRepeatCounts.rename(readRepeatCountsDataName + suffix);
+        }
     }
     if (!readFlagsDataName.empty()) {
         readFlags.rename(readFlagsDataName + suffix);
     }
+    if (!readIdsSortedByNameDataName.empty()) {
+        readIdsSortedByName.rename(readIdsSortedByNameDataName + suffix);
+    }
 }
 
 
@@ -88,18 +163,22 @@ void Reads::copyDataForReadsLongerThan(
         const auto len = rhs.getReadRawSequenceLength(id);
         if (len >= newMinReadLength) {
             // Copy over stuff.
-            readNames.appendVector(rhs.readNames.begin(id), rhs.readNames.end(id));
-            readMetaData.appendVector(rhs.readMetaData.begin(id), rhs.readMetaData.end(id));
+            SHASTA_ASSERT(not namesAreCompressed);
+            const string name = rhs.getReadName(id);
+            const string metaData = rhs.getReadMetaData(id);
+            readNames.appendVector(name.begin(), name.end());
+            readMetaData.appendVector(metaData.begin(), metaData.end());
             reads.append(rhs.reads[id]);
 
             if(representation == 1) {
+                SHASTA_ASSERT(not repeatCountsAreCompressed);
+                const RepeatCountsView rhsCounts = rhs.getReadRepeatCounts(id);
                 const uint64_t j = readRepeatCounts.size();
-                readRepeatCounts.appendVector(rhs.readRepeatCounts.size(id));
-                copy(
-                    rhs.readRepeatCounts.begin(id),
-                    rhs.readRepeatCounts.end(id),
-                    readRepeatCounts.begin(j)
-                );
+                readRepeatCounts.appendVector(rhsCounts.size());
+                uint8_t* counts = readRepeatCounts.begin(j);
+                for(uint64_t i=0; i<rhsCounts.size(); i++) {
+                    counts[i] = rhsCounts[i];
+                }
             }
         } else {
             discardedShortReadCount++;
@@ -118,14 +197,238 @@ void Reads::copyDataForReadsLongerThan(
 
 
 
-void Reads::remove() {
-    reads.remove();
+void Reads::copyPermutedData(
+    const Reads& rhs,
+    const vector<ReadId>& oldReadIds,
+    const vector<ReadId>& newReadIds,
+    uint64_t largeDataPageSize,
+    size_t threadCount)
+{
+    const ReadId n = rhs.readCount();
+    SHASTA_ASSERT(oldReadIds.size() == n);
+    SHASTA_ASSERT(newReadIds.size() == n);
+    SHASTA_ASSERT(representation == rhs.representation);
+
+    for(ReadId newReadId=0; newReadId<n; newReadId++) {
+        reads.append(rhs.reads[oldReadIds[newReadId]]);
+    }
+    reads.unreserve();
+
+    // If the names of rhs are compressed, copy them in compressed form.
+    // The names are stored in name order, which does not change,
+    // so only their ranks need to be permuted. The meta data
+    // are stored in ReadId order, so they are front coded again.
+    if(rhs.namesAreCompressed) {
+        const string namesName = readNames.getName();
+        const string metaDataName = readMetaData.getName();
+        readNames.remove();
+        readMetaData.remove();
+        compressedReadNames.createNew(namesName.empty() ? "" : (namesName + "-FrontCoded"), largeDataPageSize);
+        readNameRanks.createNew(namesName.empty() ? "" : (namesName + "-Ranks"), largeDataPageSize);
+        compressedReadMetaData.createNew(metaDataName.empty() ? "" : (metaDataName + "-FrontCoded"), largeDataPageSize);
+        readNumericMetaData.createNew(metaDataName.empty() ? "" : (metaDataName + "-Numeric"), largeDataPageSize);
+        namesAreCompressed = true;
+
+        compressedReadNames.copyFrom(rhs.compressedReadNames);
+        readNameRanks.reserveAndResize(n);
+        readNumericMetaData.reserveAndResize(n);
+        for(ReadId newReadId=0; newReadId<n; newReadId++) {
+            const ReadId oldReadId = oldReadIds[newReadId];
+            readNameRanks[newReadId] = rhs.readNameRanks[oldReadId];
+            compressedReadMetaData.append(rhs.compressedReadMetaData[oldReadId]);
+            readNumericMetaData[newReadId] = rhs.readNumericMetaData[oldReadId];
+        }
+        compressedReadMetaData.unreserve();
+    } else {
+        copyPermuted(rhs.readNames, readNames, oldReadIds, threadCount);
+        copyPermuted(rhs.readMetaData, readMetaData, oldReadIds, threadCount);
+    }
+
+    // If the repeat counts of rhs are compressed,
+    // copy them in compressed form.
     if(representation == 1) {
-        readRepeatCounts.remove();
+        if(rhs.repeatCountsAreCompressed) {
+            const string name = readRepeatCounts.getName();
+            readRepeatCounts.remove();
+            packedRepeatCounts.createNew(name.empty() ? "" : (name + "-Packed"), largeDataPageSize);
+            repeatCountExceptions.createNew(name.empty() ? "" : (name + "-Exceptions"), largeDataPageSize);
+            repeatCountsAreCompressed = true;
+            copyPermuted(rhs.packedRepeatCounts, packedRepeatCounts, oldReadIds, threadCount);
+            copyPermuted(rhs.repeatCountExceptions, repeatCountExceptions, oldReadIds, threadCount);
+        } else {
+            copyPermuted(rhs.readRepeatCounts, readRepeatCounts, oldReadIds, threadCount);
+        }
+    }
+
+    readFlags.reserveAndResize(n);
+    for(ReadId newReadId=0; newReadId<n; newReadId++) {
+        readFlags[newReadId] = rhs.readFlags[oldReadIds[newReadId]];
+    }
+
+    // The names don't change, so the order by name is preserved.
+    if(rhs.readIdsSortedByName.isOpen) {
+        readIdsSortedByName.reserveAndResize(rhs.readIdsSortedByName.size());
+        for(uint64_t i=0; i<rhs.readIdsSortedByName.size(); i++) {
+            readIdsSortedByName[i] = newReadIds[rhs.readIdsSortedByName[i]];
+        }
+    }
+
+    // The read statistics don't change.
+    histogram = rhs.histogram;
+    binnedHistogram = rhs.binnedHistogram;
+    totalBaseCount = rhs.totalBaseCount;
+    n50 = rhs.n50;
+}
+
+
+
+// Convert the repeat counts to the compressed representation
+// described in class RepeatCountsView.
+// This is done in a single pass over the reads,
+// after which the uncompressed repeat counts are removed.
+void Reads::compressRepeatCounts(uint64_t largeDataPageSize)
+{
+    if(representation != 1 or repeatCountsAreCompressed) {
+        return;
+    }
+
+    const string name = readRepeatCounts.getName();
+    packedRepeatCounts.createNew(name.empty() ? "" : (name + "-Packed"), largeDataPageSize);
+    repeatCountExceptions.createNew(name.empty() ? "" : (name + "-Exceptions"), largeDataPageSize);
+
+    vector<RepeatCountException> exceptions;
+    for(ReadId readId=0; readId<readCount(); readId++) {
+        const span<const uint8_t> counts = readRepeatCounts[readId];
+        const uint64_t n = counts.size();
+        const uint64_t wordCount = (n + 31) / 32;
+
+        packedRepeatCounts.appendVector(wordCount);
+        uint64_t* packed = packedRepeatCounts.begin(readId);
+        std::fill(packed, packed + wordCount, 0);
+
+        exceptions.clear();
+        for(uint64_t i=0; i<n; i++) {
+            const uint8_t count = counts[i];
+            SHASTA_ASSERT(count > 0);
+            const uint64_t code = uint64_t(min(count, uint8_t(4)) - 1);
+            packed[i >> 5] |= code << ((i & 31) << 1);
+            if(count > 4) {
+                exceptions.push_back({uint32_t(i), count});
+            }
+        }
+        repeatCountExceptions.appendVector(exceptions);
     }
+    packedRepeatCounts.unreserve();
+    repeatCountExceptions.unreserve();
+
+    const uint64_t oldSize = readRepeatCounts.totalSize() * sizeof(uint8_t);
+    const uint64_t newSize =
+        packedRepeatCounts.totalSize() * sizeof(uint64_t) +
+        repeatCountExceptions.totalSize() * sizeof(RepeatCountException);
+    cout << "Compressed repeat counts from " << oldSize << " to " << newSize <<
+        " bytes. Repeat counts greater than 4: " << repeatCountExceptions.totalSize() << endl;
+
+    readRepeatCounts.remove();
+    repeatCountsAreCompressed = true;
+}
+
+
+
+// Convert the read names and meta data to the front coded
+// representation described at the beginning of Reads.hpp.
+// The names are front coded in the order sorted by name,
+// so this must be called after computeReadIdsSortedByName.
+// The numeric meta data fields are also parsed and stored.
+// After this, the uncompressed names and meta data are removed.
+void Reads::compressNames(uint64_t largeDataPageSize)
+{
+    if(namesAreCompressed) {
+        return;
+    }
+    const ReadId n = readCount();
+    SHASTA_ASSERT(readIdsSortedByName.isOpen and readIdsSortedByName.size() == n);
+
+    const string namesName = readNames.getName();
+    const string metaDataName = readMetaData.getName();
+    compressedReadNames.createNew(namesName.empty() ? "" : (namesName + "-FrontCoded"), largeDataPageSize);
+    readNameRanks.createNew(namesName.empty() ? "" : (namesName + "-Ranks"), largeDataPageSize);
+    compressedReadMetaData.createNew(metaDataName.empty() ? "" : (metaDataName + "-FrontCoded"), largeDataPageSize);
+    readNumericMetaData.createNew(metaDataName.empty() ? "" : (metaDataName + "-Numeric"), largeDataPageSize);
+
+    // The names, in the order sorted by name.
+    readNameRanks.reserveAndResize(n);
+    for(ReadId rank=0; rank<n; rank++) {
+        const ReadId readId = readIdsSortedByName[rank];
+        compressedReadNames.append(readNames[readId]);
+        readNameRanks[readId] = rank;
+    }
+    compressedReadNames.unreserve();
+
+    // The meta data, in ReadId order.
+    readNumericMetaData.reserveAndResize(n);
+    for(ReadId readId=0; readId<n; readId++) {
+        const span<const char> metaData = readMetaData[readId];
+        compressedReadMetaData.append(metaData);
+        readNumericMetaData[readId].parse(metaData);
+    }
+    compressedReadMetaData.unreserve();
+
+    const uint64_t oldSize =
+        readNames.totalSize() * sizeof(char) + readNames.size() * sizeof(uint64_t) +
+        readMetaData.totalSize() * sizeof(char) + readMetaData.size() * sizeof(uint64_t);
+    const uint64_t newSize =
+        compressedReadNames.totalSize() + readNameRanks.size() * sizeof(ReadId) +
+        compressedReadMetaData.totalSize() + readNumericMetaData.size() * sizeof(ReadNumericMetaData);
+    cout << "Compressed read names and meta data from " << oldSize << " to " << newSize <<
+        " bytes, including parsed numeric meta data." << endl;
+
     readNames.remove();
     readMetaData.remove();
+    namesAreCompressed = true;
+}
+
+
+
+// Return the total number of bases in the
+// representation used to store the reads.
+uint64_t Reads::getRepeatCountsTotalSize() const
+{
+    if(repeatCountsAreCompressed) {
+        uint64_t n = 0;
+        for(ReadId readId=0; readId<readCount(); readId++) {
+            n += reads[readId].baseCount;
+        }
+        return n;
+    } else {
+        return readRepeatCounts.totalSize();
+    }
+}
+
+
+
+void Reads::remove() {
+    reads.remove();
+    if(representation == 1) {
+        if(repeatCountsAreCompressed) {
+            packedRepeatCounts.remove();
+            repeatCountExceptions.remove();
+        } else {
+            readRepeatCounts.remove();
+        }
+    }
+    if(namesAreCompressed) {
+        compressedReadNames.remove();
+        readNameRanks.remove();
+        compressedReadMetaData.remove();
+        readNumericMetaData.remove();
+    } else {
+        readNames.remove();
+        readMetaData.remove();
+    }
     readFlags.remove();
+    if(readIdsSortedByName.isOpen) {
+        readIdsSortedByName.remove();
+    }
 }
 
 
@@ -156,7 +459,7 @@ pair<Base, uint8_t> Reads::getOrientedReadBaseAndRepeatCount(
 
     // Access the bases and repeat counts for this read.
     const auto& read = reads[readId];
-    const auto& counts = readRepeatCounts[readId];
+    const RepeatCountsView counts = getReadRepeatCounts(readId);
 
     // Compute the position as stored, depending on strand.
     uint32_t orientedPosition = position;
@@ -187,14 +490,20 @@ vector<Base> Reads::getOrientedReadRawSequence(OrientedReadId orientedReadId) co
     if(representation == 1) {
 
         // We are storing a run-length representation of the read.
-        // Expand it base by base to create the raw representation.
+        // Extract its bases and repeat counts on strand 0,
+        // then expand them to the raw representation.
+        const ReadId readId = orientedReadId.getReadId();
+        const LongBaseSequenceView read = reads[readId];
+        const RepeatCountsView repeatCounts = getReadRepeatCounts(readId);
+        vector<Base> runLengthSequence(storedBaseCount);
+        vector<uint8_t> repeatCount(storedBaseCount);
         for(uint32_t position=0; position<storedBaseCount; position++) {
-            Base base;
-            uint8_t count;
-            tie(base, count) = getOrientedReadBaseAndRepeatCount(orientedReadId, position);
-            for(uint32_t i=0; i<uint32_t(count); i++) {
-                sequence.push_back(base);
-            }
+            runLengthSequence[position] = read[position];
+            repeatCount[position] = repeatCounts[position];
+        }
+        expandRunLengthRepresentation(runLengthSequence, repeatCount, sequence);
+        if(orientedReadId.getStrand() == 1) {
+            reverseComplement(sequence);
         }
 
     } else if(representation == 0) {
@@ -224,7 +533,7 @@ uint64_t Reads::getReadRawSequenceLength(ReadId readId) const
         // the repeat counts.
         // Don't use std::accumulate to compute the sum,
         // otherwise the sum is computed using uint8_t!
-        const auto& counts = readRepeatCounts[readId];
+        const RepeatCountsView counts = getReadRepeatCounts(readId);
         uint64_t sum = 0;;
         for(uint8_t count: counts) {
             sum += count;
@@ -247,7 +556,7 @@ vector<uint32_t> Reads::getRawPositions(OrientedReadId orientedReadId) const
     if(representation == 1) {
         const ReadId readId = orientedReadId.getReadId();
         const ReadId strand = orientedReadId.getStrand();
-        const auto repeatCounts = readRepeatCounts[readId];
+        const RepeatCountsView repeatCounts = getReadRepeatCounts(readId);
         const uint64_t n = repeatCounts.size();
 
         uint32_t position = 0;
@@ -278,14 +587,23 @@ vector<uint32_t> Reads::getRawPositions(OrientedReadId orientedReadId) const
 // if that field is missing. This treats the meta data
 // as a space separated sequence of Key=Value,
 // without embedded spaces in each Key=Value pair.
-span<const char> Reads::getMetaData(ReadId readId, const string& key) const
+string Reads::getMetaData(ReadId readId, const string& key) const
+{
+    SHASTA_ASSERT(readId < readCount());
+    if(namesAreCompressed) {
+        const string metaData = compressedReadMetaData[readId];
+        return convertToString(getMetaDataField(span<const char>(metaData.data(), metaData.size()), key));
+    } else {
+        return convertToString(getMetaDataField(readMetaData[readId], key));
+    }
+}
+span<const char> Reads::getMetaDataField(span<const char> metaData, const string& key)
 {
-    SHASTA_ASSERT(readId < readMetaData.size());
     const uint64_t keySize = key.size();
     char* keyBegin = const_cast<char*>(&key[0]);
     char* keyEnd = keyBegin + keySize;
-    const char* begin = readMetaData.begin(readId);
-    const char* end = readMetaData.end(readId);
+    const char* begin = metaData.data();
+    const char* end = begin + metaData.size();
 
 
     const char* p = begin;
@@ -332,6 +650,126 @@ span<const char> Reads::getMetaData(ReadId readId, const string& key) const
 
 
 
+ReadNumericMetaData Reads::getReadNumericMetaData(ReadId readId) const
+{
+    if(namesAreCompressed) {
+        return readNumericMetaData[readId];
+    } else {
+        ReadNumericMetaData numericMetaData;
+        numericMetaData.parse(readMetaData[readId]);
+        return numericMetaData;
+    }
+}
+
+
+
+// Parse the ch and start_time meta data fields.
+// The start_time can be a number of seconds since the Unix epoch,
+// or an ISO 8601 time as written by the nanopore base callers,
+// for example 2019-06-09T13:38:05Z or 2021-04-22T11:46:32.123+02:00.
+// Fractional seconds are ignored.
+void ReadNumericMetaData::parse(span<const char> metaData)
+{
+    channel = invalid<uint32_t>;
+    startTime = invalid<uint32_t>;
+
+    // Parse the digits in [begin, end) as an integer.
+    // Return invalid<uint64_t> if there are non-digits or it is too large.
+    auto parseInteger = [](const char* begin, const char* end)
+    {
+        if(begin == end or end - begin > 10) {
+            return invalid<uint64_t>;
+        }
+        uint64_t n = 0;
+        for(const char* p=begin; p!=end; ++p) {
+            if(not std::isdigit(*p)) {
+                return invalid<uint64_t>;
+            }
+            n = 10 * n + uint64_t(*p - '0');
+        }
+        return n;
+    };
+
+    const span<const char> ch = Reads::getMetaDataField(metaData, "ch");
+    const uint64_t c = parseInteger(ch.data(), ch.data() + ch.size());
+    if(c < invalid<uint32_t>) {
+        channel = uint32_t(c);
+    }
+
+    const span<const char> t = Reads::getMetaDataField(metaData, "start_time");
+    const char* begin = t.data();
+    const char* end = begin + t.size();
+
+    // A number of seconds.
+    const uint64_t seconds = parseInteger(begin, end);
+    if(seconds != invalid<uint64_t>) {
+        if(seconds < invalid<uint32_t>) {
+            startTime = uint32_t(seconds);
+        }
+        return;
+    }
+
+    // YYYY-MM-DDTHH:MM:SS.
+    if(t.size() < 19 or t[4] != '-' or t[7] != '-' or
+        (t[10] != 'T' and t[10] != ' ') or t[13] != ':' or t[16] != ':') {
+        return;
+    }
+    const uint64_t year = parseInteger(begin, begin + 4);
+    const uint64_t month = parseInteger(begin + 5, begin + 7);
+    const uint64_t day = parseInteger(begin + 8, begin + 10);
+    const uint64_t hour = parseInteger(begin + 11, begin + 13);
+    const uint64_t minute = parseInteger(begin + 14, begin + 16);
+    const uint64_t second = parseInteger(begin + 17, begin + 19);
+    if(year < 1970 or year == invalid<uint64_t> or
+        month < 1 or month > 12 or day < 1 or day > 31 or
+        hour > 23 or minute > 59 or second > 60) {
+        return;
+    }
+
+    // Skip fractional seconds, then parse the time zone, if any.
+    const char* p = begin + 19;
+    if(p != end and *p == '.') {
+        ++p;
+        while(p != end and std::isdigit(*p)) {
+            ++p;
+        }
+    }
+    int64_t offset = 0;
+    if(p != end and *p == 'Z') {
+        ++p;
+    } else if(p != end and (*p == '+' or *p == '-')) {
+        const int64_t sign = (*p == '+') ? 1 : -1;
+        ++p;
+        if(end - p == 5 and p[2] == ':') {
+            offset = sign * int64_t(60 * parseInteger(p, p + 2) + parseInteger(p + 3, p + 5));
+        } else if(end - p == 4) {
+            offset = sign * int64_t(60 * parseInteger(p, p + 2) + parseInteger(p + 2, p + 4));
+        } else {
+            return;
+        }
+        p = end;
+    }
+    if(p != end or offset > 24 * 60 or offset < -24 * 60) {
+        return;
+    }
+
+    // Days since the Unix epoch of the civil date (proleptic Gregorian calendar).
+    const int64_t y = int64_t(year) - (month <= 2 ? 1 : 0);
+    const int64_t era = y / 400;
+    const int64_t yearOfEra = y - era * 400;
+    const int64_t dayOfYear = (153 * (int64_t(month) + (month > 2 ? -3 : 9)) + 2) / 5 + int64_t(day) - 1;
+    const int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    const int64_t days = era * 146097 + dayOfEra - 719468;
+
+    const int64_t time =
+        86400 * days + 3600 * int64_t(hour) + 60 * int64_t(minute) + int64_t(second) - 60 * offset;
+    if(time >= 0 and time < int64_t(invalid<uint32_t>)) {
+        startTime = uint32_t(time);
+    }
+}
+
+
+
 // Function to write one or all reads in Fasta format.
 void Reads::writeReads(const string& fileName)
 {
@@ -356,8 +794,8 @@ void Reads::writeRead(ReadId readId, ostream& file)
     checkReadId(readId);
 
     const vector<Base> rawSequence = getOrientedReadRawSequence(OrientedReadId(readId, 0));
-    const auto readName = readNames[readId];
-    const auto metaData = readMetaData[readId];
+    const string readName = getReadName(readId);
+    const string metaData = getReadMetaData(readId);
 
     file << ">";
     copy(readName.begin(), readName.end(), ostream_iterator<char>(file));
@@ -393,7 +831,7 @@ void Reads::writeOrientedRead(OrientedReadId orientedReadId, ostream& file)
     checkReadNamesAreOpen();
 
     const vector<Base> rawSequence = getOrientedReadRawSequence(orientedReadId);
-    const auto readName = readNames[orientedReadId.getReadId()];
+    const string readName = getReadName(orientedReadId.getReadId());
 
     file << ">" << orientedReadId;
     file << " " << rawSequence.size() << " ";
@@ -414,16 +852,15 @@ void Reads::computeReadLengthHistogram() {
     // Create the histogram.
     // It contains the number of reads of each length.
     // Indexed by the length.
-    const ReadId totalReadCount = readCount();
+    // It is computed in parallel using all hardware threads.
+    histogram = parallelHistogram(readCount(), 10000, 0,
+        [&](uint64_t readId)
+        {
+            return getReadRawSequenceLength(ReadId(readId));
+        });
     totalBaseCount = 0;
-    
-    for(ReadId readId=0; readId<totalReadCount; readId++) {
-        const uint64_t length = getReadRawSequenceLength(readId);
-        totalBaseCount += length;
-        if(histogram.size() <= length) {
-            histogram.resize(length+1, 0);
-        }
-        ++(histogram[length]);
+    for(uint64_t length=0; length<histogram.size(); length++) {
+        totalBaseCount += histogram[length] * length;
     }
 
     // Binned histogram
@@ -444,9 +881,23 @@ void Reads::computeReadLengthHistogram() {
 
 void Reads::writeReadLengthHistogram(const string& fileName) {
     checkReadsAreOpen();
-    const ReadId totalReadCount = readCount();
-    
-    n50 = 0;
+    n50 = writeReadLengthHistogram(histogram, fileName);
+}
+
+
+
+uint64_t Reads::writeReadLengthHistogram(
+    const vector<uint64_t>& histogram,
+    const string& fileName)
+{
+    uint64_t totalReadCount = 0;
+    uint64_t totalBaseCount = 0;
+    for(uint64_t length=0; length<histogram.size(); length++) {
+        totalReadCount += histogram[length];
+        totalBaseCount += histogram[length] * length;
+    }
+
+    uint64_t n50 = 0;
     {
         ofstream csv(fileName);
         csv << "Length,Reads,Bases,CumulativeReads,CumulativeBases,"
@@ -472,14 +923,27 @@ void Reads::writeReadLengthHistogram(const string& fileName) {
                 }
             }
         }
-        
+
         SHASTA_ASSERT(cumulativeReadCount == 0);
         SHASTA_ASSERT(cumulativeBaseCount == 0);
     }
 
     // Binned Histogram.
     {
-        const int binWidth = 1000;
+        const uint64_t binWidth = 1000;
+        vector< pair<uint64_t, uint64_t> > binnedHistogram;
+        for(uint64_t length=0; length<histogram.size(); length++) {
+            const uint64_t readCount = histogram[length];
+            if(readCount) {
+                const uint64_t bin = length / binWidth;
+                if(binnedHistogram.size() <= bin) {
+                    binnedHistogram.resize(bin+1, make_pair(0, 0));
+                }
+                binnedHistogram[bin].first += readCount;
+                binnedHistogram[bin].second += readCount * length;
+            }
+        }
+
         ofstream csv("Binned-" + fileName);
         csv << "LengthBegin,LengthEnd,Reads,Bases,CumulativeReads,CumulativeBases,"
             "FractionalCumulativeReads,FractionalCumulativeBases,\n";
@@ -506,21 +970,110 @@ void Reads::writeReadLengthHistogram(const string& fileName) {
         SHASTA_ASSERT(cumulativeBaseCount == 0);
     }
 
+    return n50;
 }
 
 
 
-void Reads::computeReadIdsSortedByName()
+// Given a histogram of read lengths, find the read length cutoff
+// that reduces coverage to approximately the desired value.
+// Returns 0 if the coverage in the histogram is less than desired.
+uint64_t Reads::computeMinReadLengthForCoverage(
+    const vector<uint64_t>& histogram,
+    uint64_t desiredCoverage)
 {
-    // Store ReadId's in numerical order.
-    readIdsSortedByName.resize(readCount());
-    for(ReadId readId=0; readId<readCount(); readId++) {
-        readIdsSortedByName[readId] = readId;
+    uint64_t cumulativeBaseCount = 0;
+    for(uint64_t length=0; length<histogram.size(); length++) {
+        cumulativeBaseCount += histogram[length] * length;
+    }
+
+    if (desiredCoverage > cumulativeBaseCount) {
+        return 0;
+    }
+
+    uint64_t lastLength = 0;
+    for (uint64_t length = 0; length < histogram.size(); length++) {
+        const uint64_t frequency = histogram[length];
+        if (frequency) {
+            const uint64_t baseCount = frequency * length;
+            if (cumulativeBaseCount > desiredCoverage) {
+                cumulativeBaseCount -= baseCount;
+                lastLength = length;
+                continue;
+            }
+
+            return lastLength;
+        }
     }
 
-    // Sort them by name.
-    sort(readIdsSortedByName.begin(), readIdsSortedByName.end(),
-        OrderReadsByName(readNames));
+    return 0;
+}
+
+
+
+// To speed up the sort, each read is first assigned a 64-bit key
+// obtained from the first 8 characters of its name, so most comparisons
+// only compare keys. Names are only compared when the keys are equal.
+// The keys are constructed so that key0 < key1 implies name0 < name1
+// in the order defined by OrderReadsByName.
+void Reads::computeReadIdsSortedByName(size_t threadCount)
+{
+    // If the names are compressed, they are already stored
+    // in name order and readIdsSortedByName is up to date.
+    if(namesAreCompressed) {
+        return;
+    }
+
+    if(threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    const ReadId n = readCount();
+
+    // Compute the keys.
+    // Each character is offset so the smallest char value maps to 0
+    // (char can be signed). Short names are padded with zeros,
+    // which preserves the order because a prefix sorts first.
+    vector< pair<uint64_t, ReadId> > keys(n);
+    auto computeKeys = [&](ReadId begin, ReadId end)
+    {
+        for(ReadId readId=begin; readId!=end; readId++) {
+            const auto name = readNames[readId];
+            uint64_t key = 0;
+            for(uint64_t i=0; i<8; i++) {
+                key <<= 8;
+                if(i < name.size()) {
+                    key |= uint64_t(uint8_t(int(name[i]) - int(std::numeric_limits<char>::min())));
+                }
+            }
+            keys[readId] = make_pair(key, readId);
+        }
+    };
+    vector<std::thread> threads;
+    for(uint64_t t=0; t<threadCount; t++) {
+        threads.push_back(std::thread(computeKeys,
+            ReadId((t * n) / threadCount), ReadId(((t + 1) * n) / threadCount)));
+    }
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+    // Sort them by key, then by name.
+    const OrderReadsByName orderReadsByName(readNames);
+    parallelSort(keys.begin(), keys.end(),
+        [&orderReadsByName](const pair<uint64_t, ReadId>& x, const pair<uint64_t, ReadId>& y)
+        {
+            if(x.first != y.first) {
+                return x.first < y.first;
+            }
+            return orderReadsByName(x.second, y.second);
+        },
+        threadCount);
+
+    // Store the sorted ReadId's.
+    readIdsSortedByName.resize(n);
+    for(ReadId i=0; i<n; i++) {
+        readIdsSortedByName[i] = keys[i].second;
+    }
 }
 
 
@@ -536,6 +1089,19 @@ ReadId Reads::getReadId(const string& readName) const
 }
 ReadId Reads::getReadId(const span<const char>& readName) const
 {
+    if(namesAreCompressed) {
+        const uint64_t rank = compressedReadNames.lowerBound(readName);
+        if(rank == compressedReadNames.size()) {
+            return invalidReadId;
+        }
+        const string name = compressedReadNames[rank];
+        if(std::equal(name.begin(), name.end(), readName.begin(), readName.end())) {
+            return readIdsSortedByName[rank];
+        } else {
+            return invalidReadId;
+        }
+    }
+
     const auto begin = readIdsSortedByName.begin();
     const auto end = readIdsSortedByName.end();
     auto it = std::lower_bound(begin, end, readName, OrderReadsByName(readNames));
@@ -552,14 +1118,44 @@ ReadId Reads::getReadId(const span<const char>& readName) const
 
 
 
+bool Reads::findReadsByNamePrefix(
+    const string& prefix,
+    uint64_t maxCount,
+    vector<ReadId>& readIds) const
+{
+    readIds.clear();
+
+    const span<const char> s(prefix.data(), prefix.data() + prefix.size());
+    const auto end = readIdsSortedByName.end();
+    auto it = namesAreCompressed ?
+        readIdsSortedByName.begin() + compressedReadNames.lowerBound(s) :
+        std::lower_bound(readIdsSortedByName.begin(), end, s, OrderReadsByName(readNames));
+    for(; it!=end; ++it) {
+        const ReadId readId = *it;
+        const string readName = namesAreCompressed ?
+            compressedReadNames[it - readIdsSortedByName.begin()] : getReadName(readId);
+        if(readName.size() < prefix.size() or
+            not std::equal(s.begin(), s.end(), readName.begin())) {
+            break;
+        }
+        if(readIds.size() == maxCount) {
+            return false;
+        }
+        readIds.push_back(readId);
+    }
+    return true;
+}
+
+
+
 // Find duplicate reads, as determined by name (not sequence).
 // This also sets the isDuplicate and discardDueToDuplicates read flags
 // and summarizes what it found Duplicates.csv.
-void Reads::findDuplicates(const string& handleDuplicates)
+void Reads::findDuplicates(const string& handleDuplicates, size_t threadCount)
 {
     const uint64_t readCount = reads.size();
     SHASTA_ASSERT(readFlags.size() == readCount);
-    SHASTA_ASSERT(readNames.size() == readCount);
+    SHASTA_ASSERT(readIdsSortedByName.size() == readCount);
 
     // Set bool variables correspondng to the permitted values of handleDuplicates.
     bool useAllCopies = false;
@@ -579,55 +1175,95 @@ void Reads::findDuplicates(const string& handleDuplicates)
             "Must be one of: useAllCopies, useOneCopy, useNone, forbid.");
     }
 
-    uint64_t discardedCount = 0;
-    vector<uint64_t> duplicatedReadIds;
-    for(uint64_t i=0; i<readCount; i++) {
-        const uint64_t readId = readIdsSortedByName[i];
-        const auto name = readNames[readId];
-
-        // Find out if the name is the same as the
-        // name of the previous read, in order sorted by name.
-        bool hasSameNameAsPrevious = false;
-        if(i != 0) {
-            const auto previousName = readNames[readIdsSortedByName[i - 1]];
-            hasSameNameAsPrevious = equal(
-                name.begin(), name.end(),
-                previousName.begin(), previousName.end());
-        }
-
-        // Find out if the name is the same as the
-        // name of the next read, in order sorted by name.
-        bool hasSameNameAsNext = false;
-        if(i < readCount - 1) {
-            const auto nextName = readNames[readIdsSortedByName[i + 1]];
-            hasSameNameAsNext = equal(
-                name.begin(), name.end(),
-                nextName.begin(), nextName.end());
-        }
-
-        // Set the isDuplicate flag for this read.
-        ReadFlags& flags = readFlags[readId];
-        flags.isDuplicate = uint8_t(hasSameNameAsPrevious or hasSameNameAsNext);
-
-        // Set the discardDueToDuplicates flag for this read.
-        if(useAllCopies) {
-            flags.discardDueToDuplicates = uint8_t(false);
-        } else if(useOneCopy) {
-            flags.discardDueToDuplicates = uint8_t(hasSameNameAsPrevious);
-        } else if(useNone) {
-            flags.discardDueToDuplicates = flags.isDuplicate;
-        } else if(forbid) {
-            // This does not really matter because in this case the assembly will stop.
-            flags.discardDueToDuplicates = flags.isDuplicate;
-        }
-
-        // Increment counts.
-        if(flags.isDuplicate) {
-            duplicatedReadIds.push_back(readId);
+    // Process the reads in order sorted by name,
+    // in chunks processed in parallel. Each read is only compared
+    // to its neighbors in this order, so chunks are independent.
+    if(threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(uint64_t(1), std::min(uint64_t(threadCount), readCount / 100000));
+    vector<uint64_t> discardedCounts(threadCount, 0);
+    vector< vector<uint64_t> > threadDuplicatedReadIds(threadCount);
+    auto processChunk = [&](uint64_t t)
+    {
+        uint64_t& discardedCount = discardedCounts[t];
+        vector<uint64_t>& duplicatedReadIds = threadDuplicatedReadIds[t];
+        const uint64_t begin = (t * readCount) / threadCount;
+        const uint64_t end = ((t + 1) * readCount) / threadCount;
+        // Each name is compared to the next one, so we only
+        // need to get each name once.
+        // If the names are compressed, they are stored in name order.
+        auto getName = [&](uint64_t i)
+        {
+            return namesAreCompressed ?
+                compressedReadNames[i] : getReadName(readIdsSortedByName[i]);
+        };
+        string previousName;
+        string name;
+        string nextName;
+        if(begin < end) {
+            if(begin != 0) {
+                previousName = getName(begin - 1);
+            }
+            nextName = getName(begin);
         }
-        if(flags.discardDueToDuplicates) {
-            ++discardedCount;
+        for(uint64_t i=begin; i<end; i++) {
+            const uint64_t readId = readIdsSortedByName[i];
+            name.swap(nextName);
+
+            // Find out if the name is the same as the
+            // name of the previous read, in order sorted by name.
+            const bool hasSameNameAsPrevious = (i != 0) and (name == previousName);
+
+            // Find out if the name is the same as the
+            // name of the next read, in order sorted by name.
+            bool hasSameNameAsNext = false;
+            if(i < readCount - 1) {
+                nextName = getName(i + 1);
+                hasSameNameAsNext = (name == nextName);
+            }
+            previousName.swap(name);
+
+            // Set the isDuplicate flag for this read.
+            ReadFlags& flags = readFlags[readId];
+            flags.isDuplicate = uint8_t(hasSameNameAsPrevious or hasSameNameAsNext);
+
+            // Set the discardDueToDuplicates flag for this read.
+            if(useAllCopies) {
+                flags.discardDueToDuplicates = uint8_t(false);
+            } else if(useOneCopy) {
+                flags.discardDueToDuplicates = uint8_t(hasSameNameAsPrevious);
+            } else if(useNone) {
+                flags.discardDueToDuplicates = flags.isDuplicate;
+            } else if(forbid) {
+                // This does not really matter because in this case the assembly will stop.
+                flags.discardDueToDuplicates = flags.isDuplicate;
+            }
+
+            // Increment counts.
+            if(flags.isDuplicate) {
+                duplicatedReadIds.push_back(readId);
+            }
+            if(flags.discardDueToDuplicates) {
+                ++discardedCount;
+            }
         }
+    };
+    vector<std::thread> threads;
+    for(uint64_t t=0; t<threadCount; t++) {
+        threads.push_back(std::thread(processChunk, t));
+    }
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+    // Combine the results of all threads.
+    uint64_t discardedCount = 0;
+    vector<uint64_t> duplicatedReadIds;
+    for(uint64_t t=0; t<threadCount; t++) {
+        discardedCount += discardedCounts[t];
+        duplicatedReadIds.insert(duplicatedReadIds.end(),
+            threadDuplicatedReadIds[t].begin(), threadDuplicatedReadIds[t].end());
     }
 
     cout << "Found " << duplicatedReadIds.size() << " reads with duplicate names." << endl;
@@ -644,11 +1280,11 @@ void Reads::findDuplicates(const string& handleDuplicates)
             csv << readId << ",";
             csv << (flags.discardDueToDuplicates ? "Yes" : "No") << ",";
 
-            const auto name = readNames[readId];
+            const string name = getReadName(readId);
             copy(name.begin(), name.end(), ostream_iterator<char>(csv));
             csv << ",";
 
-            const auto metaData = readMetaData[readId];
+            const string metaData = getReadMetaData(readId);
             copy(metaData.begin(), metaData.end(), ostream_iterator<char>(csv));
             csv << "\n";
         }
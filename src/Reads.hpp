@@ -2,7 +2,10 @@
 #define SHASTA_READS
 
 // Shasta
+#include "algorithm.hpp"
 #include "Base.hpp"
+#include "FrontCodedStrings.hpp"
+#include "invalid.hpp"
 #include "LongBaseSequence.hpp"
 #include "MemoryMappedObject.hpp"
 #include "ReadFlags.hpp"
@@ -12,6 +15,10 @@
 
 namespace shasta {
     class Reads;
+    class ReadNumericMetaData;
+    class ReadStoreInfo;
+    class RepeatCountException;
+    class RepeatCountsView;
     class OrientedReadId;
 }
 
@@ -74,9 +81,161 @@ than the raw representation.
 Run-length representations that are more economic in memory are possible,
 at the price of additional code complexity and performance cost
 in assembly phases that use the base repeat counts.
+Optionally (--Reads.compressRepeatCounts), after all reads are stored
+the repeat counts are converted to a compressed form
+(see Reads::compressRepeatCounts) that uses 2 bits per base
+plus an exception table for repeat counts 5 or more.
+In both cases repeat counts are accessed via Reads::getReadRepeatCounts,
+which returns a RepeatCountsView.
+
+Similarly, optionally (--Reads.compressNames), after the reads are sorted
+by name the read names and meta data are converted to a front coded form
+(see class FrontCodedStrings and Reads::compressNames).
+The names are front coded in the order sorted by name,
+so consecutive names share long prefixes, and readNameRanks gives
+the position of each read in that order. The meta data are front coded
+in ReadId order, which works well for nanopore meta data because
+all reads of a run begin with the same runid.
+At the same time, the numeric meta data fields ch and start_time
+are parsed and stored in class ReadNumericMetaData.
+In both cases read names and meta data are accessed via
+Reads::getReadName and Reads::getReadMetaData, which return a string.
 
 ***************************************************************************/
 
+
+
+// A repeat count greater than 4 in the compressed representation
+// of repeat counts. The exceptions for each read are sorted by position.
+class shasta::RepeatCountException {
+public:
+    uint32_t position;
+    uint8_t repeatCount;
+};
+
+
+
+// Read-only view of the repeat counts of a read.
+// This gives random access to repeat counts regardless
+// of whether they are stored compressed or not.
+// In compressed form, each repeat count is stored in 2 bits,
+// with values 0, 1, 2, 3 corresponding to repeat counts 1, 2, 3, 4.
+// A value of 3 can also mean a repeat count greater that 4,
+// in which case it is stored in the exceptions for the read.
+class shasta::RepeatCountsView {
+public:
+
+    // Uncompressed repeat counts.
+    RepeatCountsView(span<const uint8_t> counts) :
+        counts(counts.data()), n(counts.size()) {}
+
+    // Compressed repeat counts.
+    RepeatCountsView(
+        const uint64_t* packed,
+        span<const RepeatCountException> exceptions,
+        uint64_t n) :
+        packed(packed), exceptions(exceptions), n(n) {}
+
+    uint64_t size() const
+    {
+        return n;
+    }
+
+    uint8_t operator[](uint64_t i) const
+    {
+        if(counts) {
+            return counts[i];
+        }
+        const uint64_t code = (packed[i >> 5] >> ((i & 31) << 1)) & 3;
+        if(code != 3) {
+            return uint8_t(code + 1);
+        }
+
+        // Binary search in the exceptions.
+        auto it = std::lower_bound(exceptions.begin(), exceptions.end(), i,
+            [](const RepeatCountException& e, uint64_t i) {return e.position < i;});
+        if(it != exceptions.end() and it->position == i) {
+            return it->repeatCount;
+        } else {
+            return 4;
+        }
+    }
+
+    class const_iterator {
+    public:
+        using value_type = uint8_t;
+        using difference_type = int64_t;
+        const_iterator(const RepeatCountsView& view, uint64_t i) : view(&view), i(i) {}
+        uint8_t operator*() const {return (*view)[i];}
+        const_iterator& operator++() {++i; return *this;}
+        bool operator==(const const_iterator& that) const {return i == that.i;}
+        bool operator!=(const const_iterator& that) const {return i != that.i;}
+    private:
+        const RepeatCountsView* view;
+        uint64_t i;
+    };
+    const_iterator begin() const {return const_iterator(*this, 0);}
+    const_iterator end() const {return const_iterator(*this, n);}
+
+private:
+    const uint8_t* counts = 0;
+    const uint64_t* packed = 0;
+    span<const RepeatCountException> exceptions;
+    uint64_t n;
+};
+
+
+
+// Numeric meta data fields of a read, parsed from the
+// ch and start_time fields of the read meta data.
+// Missing or invalid fields are stored as invalid<uint32_t>.
+class shasta::ReadNumericMetaData {
+public:
+
+    // The ch meta data field.
+    uint32_t channel = invalid<uint32_t>;
+
+    // The start_time meta data field, in seconds since the Unix epoch (UTC).
+    uint32_t startTime = invalid<uint32_t>;
+
+    // Parse the fields from the meta data of a read.
+    void parse(span<const char> metaData);
+};
+
+
+
+// Information stored in the Info file of a read store.
+// A read store is a directory containing the binary read data
+// created by --command createReadStore. It can be used
+// by any number of later assemblies via --readStore,
+// skipping the parsing of the input fasta/fastq files.
+class shasta::ReadStoreInfo {
+public:
+
+    // This must be incremented each time the layout
+    // of the read store changes.
+    static const uint64_t currentFormatVersion = 1;
+    uint64_t formatVersion;
+
+    // The read representation used: 0 = raw sequence, 1 = RLE sequence
+    uint64_t readRepresentation;
+
+    // The --Reads.minReadLength used when creating the read store.
+    // Assemblies using the read store cannot use a lower value.
+    uint64_t minReadLength;
+
+    uint64_t readCount;
+    uint64_t baseCount;
+
+    // Statistics on reads discarded when creating the read store.
+    uint64_t discardedInvalidBaseReadCount;
+    uint64_t discardedInvalidBaseBaseCount;
+    uint64_t discardedShortReadReadCount;
+    uint64_t discardedShortReadBaseCount;
+    uint64_t discardedBadRepeatCountReadCount;
+    uint64_t discardedBadRepeatCountBaseCount;
+};
+
 class shasta::Reads {
 public:
   
@@ -104,6 +263,17 @@ public:
         const string& readIdsSortedByNameDataName
     );
 
+    // Access read only the data in a read store,
+    // for use by copyDataForReadsLongerThan.
+    // Read flags and readIdsSortedByName are not accessed.
+    void accessReadStore(
+        uint64_t representation, // 0 = raw sequence, 1 = RLE sequence
+        const string& readsDataName,
+        const string& readNamesDataName,
+        const string& readMetaDataDataName,
+        const string& readRepeatCountsDataName
+    );
+
     inline ReadId readCount() const {
         return ReadId(reads.size());
     }
@@ -112,21 +282,66 @@ public:
         return reads[readId];
     }
 
-    inline span<const uint8_t> getReadRepeatCounts(ReadId readId) const {
-        return readRepeatCounts[readId];
+    inline RepeatCountsView getReadRepeatCounts(ReadId readId) const {
+        if(repeatCountsAreCompressed) {
+            return RepeatCountsView(
+                packedRepeatCounts.begin(readId),
+                repeatCountExceptions[readId],
+                reads[readId].baseCount);
+        } else {
+            return RepeatCountsView(readRepeatCounts[readId]);
+        }
     }
 
-    inline span<const char> getReadName(ReadId readId) const {
-        return readNames[readId];
+    // Convert the repeat counts to the compressed representation
+    // described in class RepeatCountsView. Only used for the run-length
+    // representation, and only after all reads have been stored.
+    void compressRepeatCounts(uint64_t largeDataPageSize);
+
+    inline string getReadName(ReadId readId) const {
+        if(namesAreCompressed) {
+            return compressedReadNames[readNameRanks[readId]];
+        } else {
+            return convertToString(readNames[readId]);
+        }
     }
 
+    // Convert the read names and meta data to the front coded
+    // representation described at the beginning of this file.
+    // This must be called after computeReadIdsSortedByName.
+    void compressNames(uint64_t largeDataPageSize);
+
     // Get a ReadId given a read name.
     // This uses a binary search in readIdsSortedByName.
     ReadId getReadId(const string& readName) const;
     ReadId getReadId(const span<const char>& readName) const;
 
-    inline span<const char> getReadMetaData(ReadId readId) const {
-        return readMetaData[readId];
+    // Find the reads whose name begins with a given prefix, in name order.
+    // Returns false if there are more than maxCount.
+    bool findReadsByNamePrefix(
+        const string& prefix,
+        uint64_t maxCount,
+        vector<ReadId>&) const;
+
+    inline string getReadMetaData(ReadId readId) const {
+        if(namesAreCompressed) {
+            return compressedReadMetaData[readId];
+        } else {
+            return convertToString(readMetaData[readId]);
+        }
+    }
+
+    // Get the ch and start_time meta data fields of a read,
+    // or invalid<uint32_t> if missing or invalid.
+    // The start time is in seconds since the Unix epoch (UTC).
+    ReadNumericMetaData getReadNumericMetaData(ReadId) const;
+    uint32_t getReadChannel(ReadId readId) const
+    {
+        return getReadNumericMetaData(readId).channel;
+    }
+    uint32_t getReadStartTime(ReadId readId) const
+    {
+        return getReadNumericMetaData(readId).startTime;
     }
 
     inline const ReadFlags& getFlags(ReadId readId) const {
@@ -164,7 +379,12 @@ public:
     // if that field is missing. This treats the meta data
     // as a space separated sequence of Key=Value,
     // without embedded spaces in each Key=Value pair.
-    span<const char> getMetaData(ReadId, const string& key) const;
+    string getMetaData(ReadId, const string& key) const;
+
+    // Same as above, but using meta data already obtained
+    // from getReadMetaData. The returned span points into the meta data,
+    // which is useful to get more than one field for a read.
+    static span<const char> getMetaDataField(span<const char> metaData, const string& key);
 
 
     // Setters for readFlags.
@@ -190,23 +410,45 @@ public:
 
     // Assertions for data integrity.
     inline void checkSanity() const {
-        SHASTA_ASSERT(readNames.size() == reads.size());
-        SHASTA_ASSERT(readMetaData.size() == reads.size());
+        if(namesAreCompressed) {
+            SHASTA_ASSERT(compressedReadNames.size() == reads.size());
+            SHASTA_ASSERT(readNameRanks.size() == reads.size());
+            SHASTA_ASSERT(compressedReadMetaData.size() == reads.size());
+            SHASTA_ASSERT(readNumericMetaData.size() == reads.size());
+        } else {
+            SHASTA_ASSERT(readNames.size() == reads.size());
+            SHASTA_ASSERT(readMetaData.size() == reads.size());
+        }
     }
 
     inline void checkReadsAreOpen() const {
         SHASTA_ASSERT(reads.isOpen());
         if(representation == 1) {
-            SHASTA_ASSERT(readRepeatCounts.isOpen());
+            if(repeatCountsAreCompressed) {
+                SHASTA_ASSERT(packedRepeatCounts.isOpen());
+                SHASTA_ASSERT(repeatCountExceptions.isOpen());
+            } else {
+                SHASTA_ASSERT(readRepeatCounts.isOpen());
+            }
         }
     }
 
     inline void checkReadNamesAreOpen() const {
-        SHASTA_ASSERT(readNames.isOpen());
+        if(namesAreCompressed) {
+            SHASTA_ASSERT(compressedReadNames.isOpen());
+            SHASTA_ASSERT(readNameRanks.isOpen);
+        } else {
+            SHASTA_ASSERT(readNames.isOpen());
+        }
     }
 
     inline void checkReadMetaDataAreOpen() const {
-        SHASTA_ASSERT(readMetaData.isOpen());
+        if(namesAreCompressed) {
+            SHASTA_ASSERT(compressedReadMetaData.isOpen());
+            SHASTA_ASSERT(readNumericMetaData.isOpen);
+        } else {
+            SHASTA_ASSERT(readMetaData.isOpen());
+        }
     }
 
     inline void checkReadFlagsAreOpen() const {
@@ -231,6 +473,20 @@ public:
 
     void computeReadLengthHistogram();
     void writeReadLengthHistogram(const string& fileName);
+
+    // Write a read length histogram given the number of reads of each length.
+    // This also writes a binned version of the histogram,
+    // and returns the N50.
+    static uint64_t writeReadLengthHistogram(
+        const vector<uint64_t>& histogram,
+        const string& fileName);
+
+    // Given a histogram of read lengths, find the read length cutoff
+    // that reduces coverage to approximately the desired value.
+    // Returns 0 if the coverage in the histogram is less than desired.
+    static uint64_t computeMinReadLengthForCoverage(
+        const vector<uint64_t>& histogram,
+        uint64_t desiredCoverage);
     
     inline uint64_t getTotalBaseCount() const {
         return totalBaseCount;
@@ -239,9 +495,7 @@ public:
         return n50;
     }
 
-    inline uint64_t getRepeatCountsTotalSize() const {
-        return readRepeatCounts.totalSize();
-    }
+    uint64_t getRepeatCountsTotalSize() const;
 
     inline const vector<uint64_t>& getReadLengthHistogram() const {
         return histogram;
@@ -256,10 +510,24 @@ public:
         uint64_t& discardedShortReadBases
     );
 
+    // Copy all data from rhs, permuting the reads so that
+    // the read with ReadId newReadId is a copy of
+    // the read of rhs with ReadId oldReadIds[newReadId].
+    // newReadIds is the inverse permutation.
+    // This must be called after createNew.
+    void copyPermutedData(
+        const Reads& rhs,
+        const vector<ReadId>& oldReadIds,
+        const vector<ReadId>& newReadIds,
+        uint64_t largeDataPageSize,
+        size_t threadCount
+    );
+
     // Find duplicate reads, as determined by name (not sequence).
     // This also sets the isDuplicate and discardDueToDuplicates read flags
     // and summarizes what it found Duplicates.csv.
-    void findDuplicates(const string& handleDuplicates);
+    // A threadCount of 0 means use all available hardware threads.
+    void findDuplicates(const string& handleDuplicates, size_t threadCount = 0);
 
     void remove();
 
@@ -268,6 +536,14 @@ private:
     LongBaseSequences reads;
     MemoryMapped::VectorOfVectors<uint8_t, uint64_t> readRepeatCounts;
 
+    // The compressed representation of the repeat counts,
+    // used instead of readRepeatCounts if repeatCountsAreCompressed is set.
+    // See class RepeatCountsView.
+    // packedRepeatCounts stores 32 repeat counts per uint64_t.
+    bool repeatCountsAreCompressed = false;
+    MemoryMapped::VectorOfVectors<uint64_t, uint64_t> packedRepeatCounts;
+    MemoryMapped::VectorOfVectors<RepeatCountException, uint64_t> repeatCountExceptions;
+
     // The names of the reads from the input fasta or fastq files.
     // Indexed by ReadId.
     // Note that we don't enforce uniqueness of read names.
@@ -281,6 +557,19 @@ private:
     // Indexed by ReadId.
     MemoryMapped::VectorOfVectors<char, uint64_t> readMetaData;
 
+    // The front coded representation of the read names and meta data,
+    // used instead of readNames and readMetaData if namesAreCompressed is set.
+    // See the comments at the beginning of this file.
+    // compressedReadNames is in the order sorted by name, so
+    // compressedReadNames[i] is the name of read readIdsSortedByName[i],
+    // and readNameRanks is the inverse permutation of readIdsSortedByName.
+    // compressedReadMetaData and readNumericMetaData are indexed by ReadId.
+    bool namesAreCompressed = false;
+    FrontCodedStrings compressedReadNames;
+    MemoryMapped::Vector<ReadId> readNameRanks;
+    FrontCodedStrings compressedReadMetaData;
+    MemoryMapped::Vector<ReadNumericMetaData> readNumericMetaData;
+
     MemoryMapped::Vector<ReadFlags> readFlags;
 
 
@@ -289,7 +578,8 @@ private:
     // This is used to find the read id corresponding to a name.
     MemoryMapped::Vector<ReadId> readIdsSortedByName;
 public:
-    void computeReadIdsSortedByName();
+    // A threadCount of 0 means use all available hardware threads.
+    void computeReadIdsSortedByName(size_t threadCount = 0);
 private:
 
     // Class used to sort ReadId's by name, and also to look up the
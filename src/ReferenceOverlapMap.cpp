@@ -1,32 +1,73 @@
 #include "ReferenceOverlapMap.hpp"
+#include "parallelFor.hpp"
+#include "parallelSort.hpp"
 
+#include "algorithm.hpp"
 
-void shasta::ReferenceOverlapMap::insert(string& region_name, uint32_t start, uint32_t stop, OrientedReadId id) {
-    // Check if this reference contig has been encountered before, and initialize it if needed
-    if (intervals.count(region_name) == 0){
-        interval_map <uint32_t, set<OrientedReadId>, total_enricher> empty_interval_map;
-        intervals.emplace(region_name, empty_interval_map);
-    }
 
-    // Construct a Boost interval for this numeric range/coord
-    auto a = interval<uint32_t>::right_open(start, stop);
-    set<OrientedReadId> b = {id};
+void shasta::ReferenceOverlapMap::insert(const string& region_name, uint32_t start, uint32_t stop, OrientedReadId id) {
+    // An empty interval cannot overlap anything
+    if (stop <= start){
+        return;
+    }
 
-    // Within this reference contig, add the numeric interval
-    intervals.at(region_name).add({a, b});
+    // This also initializes the reference contig, if it was not encountered before
+    intervals[region_name].push_back({start, stop, id});
     size++;
 }
 
 
-void shasta::ReferenceOverlapMap::print(ostream& out){
+void shasta::ReferenceOverlapMap::computeOverlaps(
+    size_t threadCount,
+    vector< pair<OrientedReadId, OrientedReadId> >& overlaps)
+{
+    overlaps.clear();
+
+    // Sort the intervals of each contig by start position
+    vector< vector<Interval>* > contigs;
     for (auto& item: intervals){
-        out << item.first << '\n';
-        for (auto& item1: item.second){
-            out << item1.first << " -> ";
-            for (auto& item2: item1.second){
-                out << item2 << " " ;
+        parallelSort(item.second.begin(), item.second.end(), std::less<Interval>(), threadCount);
+        contigs.push_back(&item.second);
+    }
+
+    // Sweep each contig, keeping the intervals that contain the current start position.
+    // An interval overlaps all the active intervals when it starts.
+    using Overlaps = vector< pair<OrientedReadId, OrientedReadId> >;
+    overlaps = parallelReduce(contigs.size(), 1, threadCount, Overlaps(),
+        [&](Overlaps& threadOverlaps, uint64_t begin, uint64_t end)
+        {
+            vector<Interval> active;
+            for (uint64_t i=begin; i!=end; i++){
+                active.clear();
+                for (const Interval& interval: *contigs[i]){
+                    active.erase(std::remove_if(active.begin(), active.end(),
+                        [&interval](const Interval& a){return a.stop <= interval.start;}), active.end());
+
+                    for (const Interval& a: active){
+                        if (a.orientedReadId != interval.orientedReadId){
+                            threadOverlaps.push_back(std::minmax(a.orientedReadId, interval.orientedReadId));
+                        }
+                    }
+                    active.push_back(interval);
+                }
             }
-            out << '\n';
+        },
+        [](Overlaps& x, const Overlaps& y)
+        {
+            x.insert(x.end(), y.begin(), y.end());
+        });
+
+    // The same pair can be found more than once, on the same or different contigs
+    parallelSort(overlaps.begin(), overlaps.end(), std::less< pair<OrientedReadId, OrientedReadId> >(), threadCount);
+    overlaps.erase(std::unique(overlaps.begin(), overlaps.end()), overlaps.end());
+}
+
+
+void shasta::ReferenceOverlapMap::print(ostream& out) const{
+    for (auto& item: intervals){
+        out << item.first << '\n';
+        for (auto& interval: item.second){
+            out << '[' << interval.start << ',' << interval.stop << ") -> " << interval.orientedReadId << '\n';
         }
     }
 }
@@ -9,41 +9,56 @@
 
 #include "ReadId.hpp"
 
-#include <boost/icl/split_interval_map.hpp>
-#include <boost/icl/interval_map.hpp>
-#include <boost/icl/interval.hpp>
-
-using boost::icl::total_enricher;
-using boost::icl::interval_map;
-using boost::icl::interval;
-
 #include <unordered_map>
 #include <string>
-#include <set>
+#include <utility>
+#include <vector>
 
 using std::unordered_map;
 using std::string;
-using std::set;
+using std::pair;
+using std::vector;
 
 
 namespace shasta{
     class ReferenceOverlapMap;
 }
 
-/// The overlap map is based on a boost interval map. The interval map performs an "aggregation" operation whenever
-/// multiple intervals share space on the number line, combining values for those key:value pairs, and splitting the
-/// intervals at all boundaries. The overlap map uses this data structure for each chromosome/contig in the reference
-/// alignment to infer overlap between reads
+/// The overlap map stores, for each chromosome/contig in the reference alignment, the half-open interval
+/// [start, stop) covered by each aligned oriented read. Two oriented reads overlap if their intervals
+/// on the same contig share at least one position.
+/// The overlaps are found by sorting the intervals of each contig by start position and sweeping them
+/// in that order, keeping the intervals that are still active at each start position. This is proportional
+/// to the number of intervals plus the number of overlapping pairs, and, unlike an interval map,
+/// does not need to split intervals or copy sets of reads at each insertion.
 class shasta::ReferenceOverlapMap {
 public:
-    unordered_map <string, interval_map <uint32_t, set<OrientedReadId>, total_enricher> > intervals;
+    class Interval {
+    public:
+        uint32_t start;
+        uint32_t stop;
+        OrientedReadId orientedReadId;
+
+        bool operator<(const Interval& that) const
+        {
+            return start < that.start;
+        }
+    };
+    unordered_map <string, vector<Interval> > intervals;
     size_t size;
 
-    void insert(string& region_name, uint32_t start, uint32_t stop, OrientedReadId id);
+    /// Empty intervals are ignored.
+    void insert(const string& region_name, uint32_t start, uint32_t stop, OrientedReadId id);
+
+    /// Find all pairs of distinct oriented reads whose intervals overlap on at least one contig.
+    /// Each pair is stored once, with the lower OrientedReadId first, and the pairs are sorted.
+    /// This sorts the intervals of each contig, which is done in parallel, and then sweeps the contigs
+    /// in parallel. A threadCount of 0 means use all available hardware threads.
+    void computeOverlaps(size_t threadCount, vector< pair<OrientedReadId, OrientedReadId> >& overlaps);
 
     ReferenceOverlapMap();
 
-    void print(ostream& out);
+    void print(ostream& out) const;
 };
 
 
@@ -0,0 +1,553 @@
+// Implementation of class ResourceEstimate - see ResourceEstimate.hpp for more information.
+
+// Shasta.
+#include "ResourceEstimate.hpp"
+#include "Alignment.hpp"
+#include "AssemblerOptions.hpp"
+#include "Base.hpp"
+#include "Marker.hpp"
+#include "MarkerGraph.hpp"
+#include "MarkerInterval.hpp"
+#include "OrientedReadPair.hpp"
+#include "platformDependent.hpp"
+#include "ReadGraph.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include "iostream.hpp"
+#include <sstream>
+#include "stdexcept.hpp"
+
+// zlib, used to read a sample of compressed or uncompressed input files.
+#include <zlib.h>
+
+
+
+ResourceEstimate::ResourceEstimate(
+    const AssemblerOptions& assemblerOptions,
+    uint64_t sampleSize) :
+    assemblerOptions(assemblerOptions)
+{
+    const CommandLineOnlyOptions& commandLineOnlyOptions = assemblerOptions.commandLineOnlyOptions;
+    if(commandLineOnlyOptions.inputFileNames.empty()) {
+        throw runtime_error("Specify at least one input file "
+            "using command line option \"--input\".");
+    }
+    for(const string& inputFileName: commandLineOnlyOptions.inputFileNames) {
+        if(!std::filesystem::is_regular_file(inputFileName)) {
+            throw runtime_error("Input file not found or not a regular file: " + inputFileName);
+        }
+        sampleFile(inputFileName, sampleSize);
+    }
+    if(readCount == 0) {
+        throw runtime_error("No usable reads found in the input files.");
+    }
+
+    const double memoryBudget = assemblerOptions.markerGraphOptions.externalMemoryBudget;
+    computeStages(memoryBudget > 0., memoryBudget, stages);
+
+    // If in-memory creation of marker graph vertices is used,
+    // also compute the stages for createMarkerGraphVerticesExternal,
+    // using a memory budget of 10% of available memory, but at least 1 GB.
+    if(memoryBudget == 0.) {
+        externalMemoryBudget = max(1., std::floor(0.1 * double(getAvailablePhysicalMemory()) / double(1ULL << 30)));
+        computeStages(true, externalMemoryBudget, externalStages);
+    }
+}
+
+
+
+// Parse a sample from the beginning of an input file, in FASTA or FASTQ format,
+// and add the extrapolated read statistics.
+void ResourceEstimate::sampleFile(const string& fileName, uint64_t sampleSize)
+{
+    const uint64_t minReadLength = assemblerOptions.readsOptions.minReadLength;
+
+    // gzopen also reads uncompressed files.
+    gzFile file = gzopen(fileName.c_str(), "rb");
+    if(not file) {
+        throw runtime_error("Error opening " + fileName);
+    }
+
+    // Statistics for this file.
+    uint64_t fileReadCount = 0;
+    uint64_t fileBaseCount = 0;
+    uint64_t fileRunLengthBaseCount = 0;
+    uint64_t fileReadNameByteCount = 0;
+    uint64_t fileDiscardedReadCount = 0;
+
+    // The read being parsed.
+    uint64_t readBaseCount = 0;
+    uint64_t readRunLengthBaseCount = 0;
+    uint64_t readNameByteCount = 0;
+    bool readHasInvalidBases = false;
+    uint8_t previousBase = 255;
+    bool haveRead = false;
+    auto finishRead = [&]()
+    {
+        if(not haveRead) {
+            return;
+        }
+        if(readHasInvalidBases or readBaseCount < minReadLength) {
+            ++fileDiscardedReadCount;
+        } else {
+            ++fileReadCount;
+            fileBaseCount += readBaseCount;
+            fileRunLengthBaseCount += readRunLengthBaseCount;
+            fileReadNameByteCount += readNameByteCount;
+        }
+        readBaseCount = 0;
+        readRunLengthBaseCount = 0;
+        readNameByteCount = 0;
+        readHasInvalidBases = false;
+        previousBase = 255;
+        haveRead = false;
+    };
+
+    // Parsing state.
+    // For FASTQ, lineNumber is the line number in the current record (0 to 3).
+    // Multi-line FASTQ is not supported, as in the ReadLoader.
+    char format = 0;        // '>' for FASTA, '@' for FASTQ.
+    uint64_t lineNumber = 0;
+    bool atLineBegin = true;
+    bool inHeader = false;
+    bool inName = false;
+    bool inSequence = false;
+
+    vector<char> buffer(1024 * 1024);
+    uint64_t parsedByteCount = 0;
+    bool stopped = false;
+    double stoppedFraction = 1.;
+    while(not stopped) {
+        const double offsetBegin = double(gzoffset(file));
+        const int n = gzread(file, buffer.data(), unsigned(buffer.size()));
+        if(n < 0) {
+            gzclose(file);
+            throw runtime_error("Error reading " + fileName);
+        }
+        if(n == 0) {
+            break;
+        }
+        for(int i=0; i<n; i++) {
+            const char c = buffer[i];
+
+            if(atLineBegin) {
+                if(format == 0) {
+                    if(c != '>' and c != '@') {
+                        gzclose(file);
+                        throw runtime_error("Input file is not in FASTA or FASTQ format: " + fileName);
+                    }
+                    format = c;
+                }
+                const bool isRecordBegin = (format == '>') ? (c == '>') : (lineNumber == 0);
+
+                // If the sample is complete, stop at the beginning of a record.
+                if(isRecordBegin and sampleSize != 0 and parsedByteCount + uint64_t(i) >= sampleSize) {
+                    stopped = true;
+
+                    // The fraction of this file that was parsed.
+                    // For a compressed file, interpolate the compressed offset
+                    // within the block returned by gzread.
+                    const uint64_t fileSize = std::filesystem::file_size(fileName);
+                    const double offset = gzdirect(file) ?
+                        double(parsedByteCount + uint64_t(i)) :
+                        offsetBegin + (double(gzoffset(file)) - offsetBegin) * double(i) / double(n);
+                    stoppedFraction = min(1., offset / double(max(fileSize, uint64_t(1))));
+                    break;
+                }
+
+                if(isRecordBegin) {
+                    finishRead();
+                    haveRead = true;
+                    inHeader = true;
+                    inName = true;
+                } else {
+                    inSequence = (format == '>') or (lineNumber == 1);
+                }
+                atLineBegin = false;
+                if(isRecordBegin) {
+                    continue;
+                }
+            }
+
+            if(c == '\n') {
+                atLineBegin = true;
+                inHeader = false;
+                inName = false;
+                inSequence = false;
+                if(format == '@') {
+                    lineNumber = (lineNumber + 1) % 4;
+                }
+                continue;
+            }
+
+            if(inHeader) {
+                if(inName) {
+                    if(c == ' ' or c == '\t' or c == '\r') {
+                        inName = false;
+                    } else {
+                        ++readNameByteCount;
+                    }
+                }
+            } else if(inSequence and c != '\r') {
+                const Base base = Base::fromCharacterNoException(c);
+                if(base.value > 3) {
+                    readHasInvalidBases = true;
+                } else {
+                    ++readBaseCount;
+                    if(base.value != previousBase) {
+                        ++readRunLengthBaseCount;
+                        previousBase = base.value;
+                    }
+                }
+            }
+        }
+        parsedByteCount += uint64_t(n);
+    }
+    gzclose(file);
+    finishRead();
+
+    // Extrapolate to the entire file.
+    const double factor = (stoppedFraction > 0.) ? 1. / stoppedFraction : 1.;
+    if(stopped) {
+        isExtrapolated = true;
+    }
+    readCount += uint64_t(std::round(double(fileReadCount) * factor));
+    baseCount += uint64_t(std::round(double(fileBaseCount) * factor));
+    runLengthBaseCount += uint64_t(std::round(double(fileRunLengthBaseCount) * factor));
+    readNameByteCount += uint64_t(std::round(double(fileReadNameByteCount) * factor));
+    discardedReadCount += uint64_t(std::round(double(fileDiscardedReadCount) * factor));
+}
+
+
+
+// Project the memory used by each assembly stage.
+// The byte counts used here follow the data structures
+// created by each stage, as declared in Assembler.hpp,
+// MarkerGraph.hpp, LowHash0.hpp, and ReadGraph.hpp.
+void ResourceEstimate::computeStages(
+    bool useExternalVertices,
+    double memoryBudget,
+    vector<Stage>& stages) const
+{
+    stages.clear();
+
+    const double reads = double(readCount);
+    const double orientedReads = 2. * reads;
+    const double representationBases = double(
+        (assemblerOptions.readsOptions.representation == 1) ? runLengthBaseCount : baseCount);
+    const double k = double(assemblerOptions.kmersOptions.k);
+    const double probability = assemblerOptions.kmersOptions.probability;
+
+    // Markers, for both orientations of each read.
+    const double markersPerRead = max(0., representationBases / reads - k + 1.) * probability;
+    const double orientedMarkers = orientedReads * markersPerRead;
+
+    // Alignment candidates. LowHash0 stops iterating
+    // when each read is involved in alignmentCandidatesPerRead candidates
+    // on average, and each candidate involves two reads.
+    double candidates = 0.;
+    if(assemblerOptions.minHashOptions.allPairs) {
+        candidates = reads * (reads - 1.);
+    } else {
+        double candidatesPerRead = assemblerOptions.minHashOptions.alignmentCandidatesPerRead;
+        if(candidatesPerRead <= 0. ) {
+            candidatesPerRead = 20.;
+        }
+        candidates = 0.5 * reads * candidatesPerRead;
+    }
+
+    // Alignments. As an upper bound, assume all candidates
+    // give an alignment, each covering on average half of the markers
+    // of a read and compressed to about one byte per aligned marker.
+    const double alignments = candidates;
+    const double compressedAlignmentBytes = 0.5 * markersPerRead;
+
+    // Marker graph. Typical ratios: about half of the markers
+    // end up in vertices, with about 10 markers per vertex,
+    // and about 1.2 edges per vertex.
+    const double markersInVertices = 0.5 * orientedMarkers;
+    const double vertices = 0.1 * orientedMarkers;
+    const double edges = 1.2 * vertices;
+    const double markerIntervals = markersInVertices;
+    const double vertexIdBytes = double(sizeof(MarkerGraph::CompressedVertexId));
+
+    // The size of the table of contents entries of a VectorOfVectors.
+    const double tocBytes = 8.;
+
+    uint64_t inUse = 0;
+    auto addStage = [&](const string& name, double kept, double transient, double freed)
+    {
+        Stage stage;
+        stage.name = name;
+        stage.keptBytes = uint64_t(kept);
+        stage.freedBytes = min(uint64_t(freed), inUse);
+        stage.peakBytes = inUse + uint64_t(kept) + uint64_t(transient);
+        inUse += stage.keptBytes;
+        inUse -= stage.freedBytes;
+        stages.push_back(stage);
+    };
+
+
+
+    // Reads: two bits per base, plus one byte per base for repeat counts
+    // when using the run-length representation, plus names and flags.
+    // During loading, the input is buffered in chunks of --Reads.streamingChunkSize.
+    {
+        double kept =
+            representationBases / 4. +
+            double(readNameByteCount) +
+            reads * (4. * tocBytes + 1.);
+        if(assemblerOptions.readsOptions.representation == 1) {
+            kept += representationBases;
+        }
+        double chunkBytes = double(assemblerOptions.readsOptions.streamingChunkSize) * 1024. * 1024.;
+        if(chunkBytes == 0.) {
+            chunkBytes = double(baseCount) + double(readNameByteCount);
+        }
+        addStage("reads", kept, 2. * chunkBytes, 0.);
+    }
+
+
+
+    // Markers. With --Kmers.generationMethod other than 0,
+    // a table with an entry for each of the 4^k k-mers is also used.
+    {
+        double kept = orientedMarkers * double(sizeof(CompressedMarker)) + orientedReads * tocBytes;
+        double transient = 0.;
+        if(assemblerOptions.kmersOptions.generationMethod != 0) {
+            const double kmerCount = std::pow(4., k);
+            kept += 8. * kmerCount;
+            transient += 16. * kmerCount;
+        }
+        addStage("markers", kept, transient, 0.);
+    }
+
+
+
+    // Alignment candidates. The marker KmerIds are kept until
+    // alignments are computed. During each LowHash0 iteration,
+    // the buckets use a table of contents with about 32 buckets
+    // per low hash, plus staged and final bucket entries.
+    // Candidates are kept in two generations of 8 bytes each.
+    const double markerKmerIdBytes = assemblerOptions.kmersOptions.recomputeMarkerKmerIds ? 0. :
+        orientedMarkers * double(sizeof(KmerId)) + orientedReads * tocBytes;
+    {
+        double transient = 0.;
+        if(not assemblerOptions.minHashOptions.allPairs) {
+            const double lowHashes = max(1., orientedMarkers * assemblerOptions.minHashOptions.hashFraction);
+            const double bucketCount = std::pow(2., min(31., 5. + std::ceil(std::log2(lowHashes))));
+            transient = bucketCount * tocBytes + lowHashes * (8. + 12.) + candidates * 2. * 8. + reads * 16.;
+        }
+        const double kept =
+            markerKmerIdBytes +
+            candidates * (double(sizeof(OrientedReadPair)) + 1.) +
+            reads * 24. +
+            2. * candidates * 4. + orientedReads * tocBytes;
+        addStage("alignmentCandidates", kept, transient, 0.);
+    }
+
+
+
+    // Alignments. While computing alignments, each thread keeps
+    // its compressed alignments, which are then copied to the global ones.
+    {
+        const double compressed = alignments * (compressedAlignmentBytes + tocBytes);
+        const double kept =
+            alignments * double(sizeof(AlignmentData)) +
+            compressed +
+            2. * alignments * 4. + orientedReads * tocBytes;
+        addStage("alignments", kept, compressed, markerKmerIdBytes);
+    }
+
+
+
+    // Read graph: at most --ReadGraph.maxAlignmentCount alignments per read,
+    // each giving two edges, plus the connectivity table.
+    {
+        const double readGraphEdges = 2. * reads * double(max(0, assemblerOptions.readGraphOptions.maxAlignmentCount));
+        const double kept =
+            readGraphEdges * (double(sizeof(ReadGraphEdge)) + 2. * 4.) +
+            orientedReads * tocBytes;
+        addStage("readGraph", kept, readGraphEdges * 8., 0.);
+    }
+
+
+
+    // Marker graph vertices.
+    // In memory, the disjoint sets use 16 bytes per marker,
+    // plus 8 bytes per marker of work area and 8 bytes per marker to gather
+    // the markers of each disjoint set.
+    // With createMarkerGraphVerticesExternal, the disjoint sets use
+    // 8 bytes per marker, plus the memory budget.
+    {
+        const double kept =
+            orientedMarkers * vertexIdBytes +
+            markersInVertices * double(sizeof(MarkerId)) + vertices * vertexIdBytes +
+            vertices * (8. + 1.);
+        double transient = 0.;
+        if(useExternalVertices) {
+            transient = orientedMarkers * 8. + memoryBudget * 1024. * 1024. * 1024.;
+        } else {
+            transient = orientedMarkers * (16. + 8. + 8.) + vertices * tocBytes;
+        }
+        addStage("assembly/markerGraphVertices", kept, transient, 0.);
+    }
+
+
+
+    // Marker graph edges. Each thread first stores its edges and marker intervals,
+    // which are then copied to the global ones.
+    {
+        const double edgeBytes =
+            edges * (double(sizeof(MarkerGraph::Edge)) + tocBytes) +
+            markerIntervals * double(sizeof(MarkerInterval));
+        const double kept =
+            edgeBytes +
+            2. * (edges * vertexIdBytes + vertices * tocBytes) +
+            edges * 8.;
+        addStage("assembly/markerGraphEdges", kept, edgeBytes, 0.);
+    }
+
+
+
+    // Assembly: consensus sequence of marker graph edges, two bytes
+    // per base, with about 1/probability bases per edge.
+    // Each thread stores its results first.
+    {
+        const double consensusBytes = edges * (2. / probability + tocBytes + 1.);
+        addStage("assembly/sequence", consensusBytes, consensusBytes, 0.);
+    }
+}
+
+
+
+uint64_t ResourceEstimate::peakBytes(const vector<Stage>& stages)
+{
+    uint64_t peak = 0;
+    for(const Stage& stage: stages) {
+        peak = max(peak, stage.peakBytes);
+    }
+    return peak;
+}
+
+
+
+namespace shasta {
+    namespace {
+        string formatBytes(uint64_t bytes)
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(1);
+            if(bytes < (1ULL << 30)) {
+                s << double(bytes) / double(1ULL << 20) << " MB";
+            } else {
+                s << double(bytes) / double(1ULL << 30) << " GB";
+            }
+            return s.str();
+        }
+    }
+}
+
+
+
+bool ResourceEstimate::check(string& recommendation) const
+{
+    const CommandLineOnlyOptions& commandLineOnlyOptions = assemblerOptions.commandLineOnlyOptions;
+    const uint64_t peak = peakBytes(stages);
+    std::ostringstream s;
+
+    // With --memoryBacking disk, the binary data are on disk
+    // in the assembly directory, so check the available disk space instead.
+    if(commandLineOnlyOptions.memoryBacking == "disk") {
+        // The assembly directory may not exist yet,
+        // so use its closest existing ancestor.
+        std::filesystem::path directory =
+            std::filesystem::absolute(commandLineOnlyOptions.assemblyDirectory).parent_path();
+        while(not std::filesystem::exists(directory) and directory.has_parent_path() and
+            directory != directory.parent_path()) {
+            directory = directory.parent_path();
+        }
+        const uint64_t available = std::filesystem::space(directory).available;
+        if(peak <= available) {
+            s << "The estimated peak of " << formatBytes(peak) <<
+                " fits in the " << formatBytes(available) <<
+                " of disk space available in " << directory.string() << ".";
+            recommendation = s.str();
+            return true;
+        } else {
+            s << "The estimated peak of " << formatBytes(peak) <<
+                " exceeds the " << formatBytes(available) <<
+                " of disk space available in " << directory.string() <<
+                ". Use an assembly directory on a larger filesystem.";
+            recommendation = s.str();
+            return false;
+        }
+    }
+
+    // Leave 10% of available memory for the operating system and other processes.
+    const uint64_t available = getAvailablePhysicalMemory();
+    const uint64_t usable = uint64_t(0.9 * double(available));
+    if(peak <= usable) {
+        s << "The estimated peak of " << formatBytes(peak) <<
+            " fits in the " << formatBytes(available) << " of available memory.";
+        if(commandLineOnlyOptions.memoryMode != "filesystem" or commandLineOnlyOptions.memoryBacking != "2M") {
+            s << " For faster assembly, use \"--memoryMode filesystem --memoryBacking 2M\".";
+        }
+        recommendation = s.str();
+        return true;
+    }
+
+    s << "The estimated peak of " << formatBytes(peak) <<
+        " exceeds the " << formatBytes(usable) << " of usable memory"
+        " (90% of the available " << formatBytes(available) << ").";
+    if(not externalStages.empty() and peakBytes(externalStages) <= usable) {
+        s << " With \"--MarkerGraph.externalMemoryBudget " << externalMemoryBudget << "\""
+            " the estimated peak is " << formatBytes(peakBytes(externalStages)) <<
+            ", which fits.";
+    } else {
+        s << " Use \"--memoryMode filesystem --memoryBacking disk\" to keep the binary data on disk."
+            " This is much slower.";
+    }
+    recommendation = s.str();
+    return false;
+}
+
+
+
+void ResourceEstimate::write(ostream& s) const
+{
+    s << "Reads: " << readCount << " reads with " << baseCount << " bases";
+    if(assemblerOptions.readsOptions.representation == 1) {
+        s << " (" << runLengthBaseCount << " run-length bases)";
+    }
+    s << ", " << discardedReadCount << " reads discarded";
+    if(isExtrapolated) {
+        s << ", extrapolated from a sample of each input file";
+    }
+    s << "." << endl;
+
+    auto writeStages = [&](const vector<Stage>& stages)
+    {
+        s << std::left << std::setw(30) << "Stage" << std::right <<
+            std::setw(12) << "Peak" << std::setw(12) << "Kept" << std::setw(12) << "Freed" << endl;
+        for(const Stage& stage: stages) {
+            s << std::left << std::setw(30) << stage.name << std::right <<
+                std::setw(12) << formatBytes(stage.peakBytes) <<
+                std::setw(12) << formatBytes(stage.keptBytes) <<
+                std::setw(12) << formatBytes(stage.freedBytes) << endl;
+        }
+        s << "Estimated peak memory " << formatBytes(peakBytes(stages)) << "." << endl;
+    };
+
+    s << "Estimated memory for each assembly stage:" << endl;
+    writeStages(stages);
+    if(not externalStages.empty()) {
+        s << "Estimated memory with --MarkerGraph.externalMemoryBudget " << externalMemoryBudget << ":" << endl;
+        writeStages(externalStages);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef SHASTA_RESOURCE_ESTIMATE_HPP
+#define SHASTA_RESOURCE_ESTIMATE_HPP
+
+/*******************************************************************************
+
+Pre-flight estimate of the memory needed by an assembly,
+used by --command estimateResources and by --memoryCheck.
+
+Read statistics are obtained by parsing a sample from the beginning
+of each input file and extrapolated to the entire file
+using the fraction of the file that was read.
+The memory used by each assembly stage is then projected
+from the sizes of the main MemoryMapped data structures
+created by that stage, for example bytes per marker,
+per alignment candidate, per alignment, per marker graph vertex and edge.
+Data structures created by a stage are normally kept
+for the rest of the assembly, so the projected peak
+of each stage includes the data structures of all previous stages.
+
+This is an approximation. In particular, the numbers of
+alignments, marker graph vertices, and marker graph edges
+depend on the data and are estimated using typical ratios.
+It only models assembly mode 0 and does not include
+the optional coverage data (--Assembly.storeCoverageData).
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include "iosfwd.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class AssemblerOptions;
+    class ResourceEstimate;
+}
+
+
+
+class shasta::ResourceEstimate {
+public:
+
+    // Sample at most sampleSize bytes (uncompressed) from each input file.
+    // If sampleSize is 0, the input files are read entirely.
+    ResourceEstimate(const AssemblerOptions&, uint64_t sampleSize);
+
+    // Read statistics, extrapolated to the entire input.
+    // Only reads that would be kept by the ReadLoader are counted.
+    uint64_t readCount = 0;
+    uint64_t baseCount = 0;
+    uint64_t runLengthBaseCount = 0;
+    uint64_t readNameByteCount = 0;
+    uint64_t discardedReadCount = 0;
+    bool isExtrapolated = false;
+
+    // Memory projected for each assembly stage.
+    class Stage {
+    public:
+        string name;
+
+        // The bytes of the data structures created by this stage
+        // that are kept after the stage completes.
+        uint64_t keptBytes = 0;
+
+        // The bytes of the data structures of previous stages freed by this stage.
+        uint64_t freedBytes = 0;
+
+        // The peak bytes in use while this stage runs,
+        // including data structures of previous stages.
+        uint64_t peakBytes = 0;
+    };
+
+    // The stages for the memory options specified on input.
+    vector<Stage> stages;
+
+    // The stages obtained using createMarkerGraphVerticesExternal,
+    // if the options specified on input don't already use it.
+    // The memory budget used is in externalMemoryBudget, in GB.
+    vector<Stage> externalStages;
+    double externalMemoryBudget = 0.;
+
+    static uint64_t peakBytes(const vector<Stage>&);
+
+    // Check the projected peak memory against the memory available
+    // for the memory options specified on input.
+    // Returns true if the assembly is expected to fit and, in any case,
+    // a recommendation of memory options.
+    bool check(string& recommendation) const;
+
+    void write(ostream&) const;
+
+private:
+    const AssemblerOptions& assemblerOptions;
+
+    void sampleFile(const string& fileName, uint64_t sampleSize);
+    void computeStages(bool useExternalVertices, double memoryBudget, vector<Stage>&) const;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include "SimpleBayesianConsensusCaller.hpp"
 #include "Coverage.hpp"
 #include "ConsensusCaller.hpp"
+#include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -179,6 +180,7 @@ SimpleBayesianConsensusCaller::SimpleBayesianConsensusCaller(
 
     maxInputRunlength = uint16_t(probabilityMatrices[0][0].size() - 1);
     maxOutputRunlength = uint16_t(probabilityMatrices[0].size() - 1);
+    computeLogLikelihoodColumns();
 
     cout << "Bayesian consensus caller configuration name is " <<
         configurationName << endl;
@@ -186,6 +188,23 @@ SimpleBayesianConsensusCaller::SimpleBayesianConsensusCaller(
 
 
 
+void SimpleBayesianConsensusCaller::computeLogLikelihoodColumns(){
+    const uint64_t xSize = uint64_t(maxInputRunlength) + 1;
+    const uint64_t ySize = uint64_t(maxOutputRunlength) + 1;
+
+    for (size_t baseIndex=0; baseIndex < probabilityMatrices.size(); baseIndex++){
+        vector<double>& columns = logLikelihoodColumns[baseIndex];
+        columns.resize(xSize * ySize);
+        for (uint64_t y=0; y<ySize; y++){
+            for (uint64_t x=0; x<xSize; x++){
+                columns[x*ySize + y] = probabilityMatrices[baseIndex][y][x];
+            }
+        }
+    }
+}
+
+
+
 void SimpleBayesianConsensusCaller::printProbabilityMatrices(char separator){
     const uint32_t length = uint(probabilityMatrices[0].size());
     uint32_t nBases = 4;
@@ -326,62 +345,45 @@ void SimpleBayesianConsensusCaller::printLogLikelihoodVector(vector<double>& log
 }
 
 
-void SimpleBayesianConsensusCaller::normalizeLikelihoods(vector<double>& x, double xMax) const{
+void SimpleBayesianConsensusCaller::normalizeLikelihoods(span<double> x, double xMax) const{
     for (uint32_t i=0; i<x.size(); i++){
         x[i] = x[i]-xMax;
     }
 }
 
 
-void SimpleBayesianConsensusCaller::factorRepeats(
-    array<std::map<uint16_t,uint16_t>,2>& factoredRepeats,
-    const Coverage& coverage) const{
+void SimpleBayesianConsensusCaller::countRepeats(
+    span<uint32_t> repeatCounts,
+    const Coverage& coverage,
+    AlignedBase consensusBase) const{
+
+    std::fill(repeatCounts.begin(), repeatCounts.end(), 0);
 
-    // Store counts for each unique observation
+    // Store counts for each observed repeat
     for (auto& observation: coverage.getReadCoverageData() ){
+        // Depending on class boolean "ignoreNonConsensusBaseRepeats", ignore non consensus repeat values
+        if (ignoreNonConsensusBaseRepeats and observation.base.value != consensusBase.value){
+            continue;
+        }
+
         // If NOT a gap, always increment
         if (not observation.base.isGap()) {
-            factoredRepeats[uint16_t(observation.strand)][uint16_t(observation.repeatCount)]++;
+            // In the case that observed runlength is too large for the matrix, cap it at maxRunlength
+            repeatCounts[min(uint16_t(observation.repeatCount), maxInputRunlength)]++;
         // If IS a gap only increment if "countGapsAsZeros" is true
         }else if (countGapsAsZeros){
-            factoredRepeats[uint16_t(observation.strand)][0]++;
-        }
-    }
-}
-
-
-void SimpleBayesianConsensusCaller::factorRepeats(
-    array<std::map<uint16_t,uint16_t>,2>& factoredRepeats,
-    const Coverage& coverage,
-    AlignedBase consensusBase) const{
-
-    // Store counts for each unique observation
-    for (auto& observation: coverage.getReadCoverageData() ){
-        // Ignore non consensus repeat values
-        if (observation.base.value == consensusBase.value){
-            // If NOT a gap, always increment
-            if (not observation.base.isGap()) {
-                factoredRepeats[uint16_t(observation.strand)][uint16_t(observation.repeatCount)]++;
-            // If IS a gap only increment if "countGapsAsZeros" is true
-            }else if (countGapsAsZeros){
-                factoredRepeats[uint16_t(observation.strand)][0]++;
-            }
+            repeatCounts[0]++;
         }
     }
 }
 
 
-uint16_t SimpleBayesianConsensusCaller::predictRunlength(const Coverage &coverage, AlignedBase consensusBase, vector<double>& logLikelihoodY) const{
-    array <std::map <uint16_t,uint16_t>, 2> factoredRepeats;    // Repeats grouped by strand and length
+uint16_t SimpleBayesianConsensusCaller::predictRunlength(const Coverage &coverage, AlignedBase consensusBase, span<double> logLikelihoodY) const{
+    const uint64_t xSize = uint64_t(maxInputRunlength) + 1;
+    const uint64_t ySize = uint64_t(maxOutputRunlength) + 1;
+    SHASTA_ASSERT(logLikelihoodY.size() == ySize);
 
     size_t priorIndex = -1;   // Used to determine which prior probability vector to access (AT=0 or GC=1)
-    uint16_t x;               // Element of X = {x_0, x_1, ..., x_i} observed repeats
-    uint16_t c;               // Number of times x_i was observed
-    uint16_t y;               // Element of Y = {y_0, y_1, ..., y_j} true repeat between 0 and j=max_runlength
-    double logSum;            // Product (in logspace) of P(x_i|y_j) for each i
-
-    double yMaxLikelihood = -INF;     // Probability of most probable true repeat length
-    uint16_t yMax = 0;                 // Most probable repeat length
 
     // Determine which index to use for this->priors
     if (consensusBase.character() == 'A' || consensusBase.character() == 'T'){
@@ -391,41 +393,44 @@ uint16_t SimpleBayesianConsensusCaller::predictRunlength(const Coverage &coverag
         priorIndex = 1;
     }
 
-    // Count the number of times each unique repeat was observed, to reduce redundancy in calculating log likelihoods/
-    // Depending on class boolean "ignoreNonConsensusBaseRepeats" filter out observations
-    if (ignoreNonConsensusBaseRepeats) {
-        factorRepeats(factoredRepeats, coverage, consensusBase);
+    // Count the number of times each observed repeat was observed, to reduce redundancy in calculating log likelihoods.
+    array<uint32_t, stackBufferSize> repeatCountsBuffer;
+    vector<uint32_t> repeatCountsHeapBuffer;
+    span<uint32_t> repeatCounts;
+    if (xSize <= stackBufferSize){
+        repeatCounts = span<uint32_t>(repeatCountsBuffer.data(), xSize);
     }
-    else {
-        factorRepeats(factoredRepeats, coverage);
+    else{
+        repeatCountsHeapBuffer.resize(xSize);
+        repeatCounts = span<uint32_t>(repeatCountsHeapBuffer.data(), xSize);
     }
-
-    // Iterate all possible Y from 0 to j to calculate p(Y_j|X) where X is all observations 0 to i,
-    // assuming i and j are less than maxRunlength
-    for (y = 0; y <= maxOutputRunlength; y++){
-        // Initialize logSum for this Y value using empirically determined priors
-        logSum = priors[priorIndex][y];
-
-        for (uint16_t strand = 0; strand <= factoredRepeats.size() - 1; strand++){
-            for (auto& item: factoredRepeats[strand]){
-                x = item.first;
-                c = item.second;
-
-                // In the case that observed runlength is too large for the matrix, cap it at maxRunlength
-                if (x > maxInputRunlength){
-                    x = maxInputRunlength;
-                }
-
-                // Increment log likelihood for this y_j
-                logSum += double(c)*probabilityMatrices[consensusBase.value][y][x];
-            }
+    countRepeats(repeatCounts, coverage, consensusBase);
+
+    // Initialize the log likelihood of each Y value using empirically determined priors.
+    const vector<double>& prior = priors[priorIndex];
+    std::copy(prior.begin(), prior.end(), logLikelihoodY.begin());
+
+    // For each observed repeat x_i, increment the log likelihood of all Y values at once,
+    // using the column of log probabilities p(x_i|Y).
+    const double* columns = logLikelihoodColumns[consensusBase.value].data();
+    for (uint64_t x=0; x<xSize; x++){
+        const uint32_t c = repeatCounts[x];
+        if (c == 0){
+            continue;
         }
+        const double dc = double(c);
+        const double* column = columns + x*ySize;
+        for (uint64_t y=0; y<ySize; y++){
+            logLikelihoodY[y] += dc*column[y];
+        }
+    }
 
-        logLikelihoodY[y] = logSum;
-
-        // Update max Y value if log likelihood is greater than previous maximum... Should do this outside this loop?
-        if (logSum > yMaxLikelihood){
-            yMaxLikelihood = logSum;
+    // Find the most probable true repeat length.
+    double yMaxLikelihood = -INF;     // Probability of most probable true repeat length
+    uint16_t yMax = 0;                 // Most probable repeat length
+    for (uint16_t y=0; y<ySize; y++){
+        if (logLikelihoodY[y] > yMaxLikelihood){
+            yMaxLikelihood = logLikelihoodY[y];
             yMax = y;
         }
     }
@@ -438,7 +443,7 @@ uint16_t SimpleBayesianConsensusCaller::predictRunlength(const Coverage &coverag
 
 AlignedBase SimpleBayesianConsensusCaller::predictConsensusBase(const Coverage& coverage) const{
     const vector<CoverageData>& coverageDataVector = coverage.getReadCoverageData();
-    vector<uint32_t> baseCounts(5,0);
+    array<uint32_t, 5> baseCounts = {0, 0, 0, 0, 0};
     uint32_t maxBaseCount = 0;
     uint8_t maxBase = 4;   // Default to gap in case coverage is empty (is this possible?)
     uint32_t key;
@@ -471,7 +476,18 @@ Consensus SimpleBayesianConsensusCaller::operator()(const Coverage& coverage) co
     AlignedBase consensusBase;
     uint16_t consensusRepeat;
 
-    vector<double> logLikelihoods(u_long(maxOutputRunlength+1), -INF);    // initialize as zeros in log space
+    // The log likelihoods are kept on the stack, unless the configuration is unusually large.
+    const uint64_t ySize = uint64_t(maxOutputRunlength) + 1;
+    array<double, stackBufferSize> logLikelihoodsBuffer;
+    vector<double> logLikelihoodsHeapBuffer;
+    span<double> logLikelihoods;
+    if (ySize <= stackBufferSize){
+        logLikelihoods = span<double>(logLikelihoodsBuffer.data(), ySize);
+    }
+    else{
+        logLikelihoodsHeapBuffer.resize(ySize);
+        logLikelihoods = span<double>(logLikelihoodsHeapBuffer.data(), ySize);
+    }
 
     consensusBase = predictConsensusBase(coverage);
 
@@ -494,6 +510,15 @@ Consensus SimpleBayesianConsensusCaller::operator()(const Coverage& coverage) co
 }
 
 
+void SimpleBayesianConsensusCaller::callBatch(span<const Coverage> coverages, span<Consensus> consensus) const{
+    SHASTA_ASSERT(coverages.size() == consensus.size());
+    for (size_t i=0; i<coverages.size(); i++){
+        // The qualified call is not virtual.
+        consensus[i] = SimpleBayesianConsensusCaller::operator()(coverages[i]);
+    }
+}
+
+
 // The test program expects as input two csv files:
 // - SimpleBayesianConsensusCaller.csv:
 //       The configuration file to create the caller.
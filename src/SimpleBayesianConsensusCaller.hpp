@@ -34,6 +34,7 @@ must take into account which strand each read is on.
 #include <map>
 #include <limits>
 #include <set>
+#include "span.hpp"
 #include "string.hpp"
 
 namespace shasta {
@@ -56,9 +57,9 @@ public:
     // - A path to a configuration file.
     SimpleBayesianConsensusCaller(const string& constructorString);
 
-    // Given a coverage object, return the most likely run length, and the normalized log likelihood vector for all run
-    // lengths as a pair
-    uint16_t predictRunlength(const Coverage &coverage, AlignedBase consensusBase, vector<double>& logLikelihoodY) const;
+    // Given a coverage object, return the most likely run length, and fill in the normalized log likelihood
+    // for all run lengths. The size of logLikelihoodY must be maxOutputRunlength+1.
+    uint16_t predictRunlength(const Coverage &coverage, AlignedBase consensusBase, span<double> logLikelihoodY) const;
 
     AlignedBase predictConsensusBase(const Coverage& coverage) const;
 
@@ -66,6 +67,10 @@ public:
     // run length of the aligned bases at a position
     virtual Consensus operator()(const Coverage&) const;
 
+    // Compute consensus at many positions, without virtual dispatch
+    // at each position.
+    virtual void callBatch(span<const Coverage>, span<Consensus>) const;
+
     static bool isBuiltIn(const string&);
 
     static const std::set<string> builtIns;
@@ -92,6 +97,17 @@ private:
     // priors p(Y) normalized for each Y, where X = observed and Y = True run length
     array<vector<double>, 2> priors;
 
+    // The same values as probabilityMatrices, stored for each base as a single
+    // contiguous vector of columns: the log probability p(X=x|Y=y) is at
+    // position x*(maxOutputRunlength+1)+y. This allows predictRunlength
+    // to accumulate the log likelihoods for all Y values at once,
+    // for each observed run length.
+    array<vector<double>, 4> logLikelihoodColumns;
+
+    // Size of the buffers that predictRunlength and operator() keep on the stack.
+    // Larger configurations fall back to heap allocated buffers.
+    static const uint64_t stackBufferSize = 128;
+
     /// ----- Methods ----- ///
 
     // Attempt to construct interpreting the constructor string as
@@ -101,6 +117,9 @@ private:
     // Ensure that the config file specified matrices with rectangular, matching dimensions.
     void validateMatrixDimensions(string configPath);
 
+    // Fill in logLikelihoodColumns from probabilityMatrices.
+    void computeLogLikelihoodColumns();
+
     // For parsing any character separated file format
     void splitAsDouble(string s, string& separators, vector<double>& tokens);
     void splitAsString(string s, string& separators, vector<string>& tokens);
@@ -116,11 +135,13 @@ private:
     void parseLikelihood(ifstream& matrixFile, string& line, vector<string>& tokens);
 
     // For a given vector of likelihoods over each Y value, normalize by the maximum
-    void normalizeLikelihoods(vector<double>& x, double xMax) const;
+    void normalizeLikelihoods(span<double> x, double xMax) const;
 
-    // Count the number of times each unique repeat was observed, to reduce redundancy in calculating log likelihoods
-    void factorRepeats(array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats, const Coverage& coverage) const;
-    void factorRepeats(array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats, const Coverage& coverage, AlignedBase consensusBase) const;
+    // Count the number of times each observed repeat was observed, to reduce redundancy in calculating log likelihoods.
+    // Observed repeats larger than maxInputRunlength are counted as maxInputRunlength.
+    // Observations on both strands use the same probability matrix, so they are counted together.
+    // The size of repeatCounts must be maxInputRunlength+1.
+    void countRepeats(span<uint32_t> repeatCounts, const Coverage& coverage, AlignedBase consensusBase) const;
 
     // For debugging or exporting
     void printPriors(char separator);
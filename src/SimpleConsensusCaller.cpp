@@ -1,7 +1,16 @@
 #include "SimpleConsensusCaller.hpp"
 #include "Coverage.hpp"
+#include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
+// Standard library.
+#include "algorithm.hpp"
+#include "array.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 Consensus SimpleConsensusCaller::operator()(
     const Coverage& coverage) const
@@ -11,3 +20,117 @@ Consensus SimpleConsensusCaller::operator()(
     return Consensus(base, repeatCount);
 }
 
+
+
+// Compute consensus at many positions.
+// The qualified call is not virtual.
+void SimpleConsensusCaller::callBatch(
+    span<const Coverage> coverages,
+    span<Consensus> consensus) const
+{
+    SHASTA_ASSERT(coverages.size() == consensus.size());
+    for(uint64_t i=0; i<coverages.size(); i++) {
+        consensus[i] = SimpleConsensusCaller::operator()(coverages[i]);
+    }
+}
+
+
+
+
+// Compute consensus repeat counts at positions where all reads have the same base.
+// This gives the same results as callBatch on the corresponding Coverage objects.
+void SimpleConsensusCaller::callRepeatCounts(
+    span<const uint8_t> repeatCounts,
+    uint64_t readCount,
+    span<uint32_t> consensusRepeatCounts) const
+{
+    SHASTA_ASSERT(readCount > 0);
+    SHASTA_ASSERT(repeatCounts.size() == readCount * consensusRepeatCounts.size());
+    for(uint64_t j=0; j<consensusRepeatCounts.size(); j++) {
+        consensusRepeatCounts[j] = mostFrequentRepeatCount(repeatCounts.data() + j * readCount, readCount);
+    }
+}
+
+
+
+uint8_t SimpleConsensusCaller::mostFrequentRepeatCount(const uint8_t* x, uint64_t n)
+{
+    // Find the range of values.
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    uint64_t i = 0;
+#if defined(__SSE2__)
+    // SSE2 is always available on x86_64.
+    // Process 16 values at a time.
+    if(n >= 16) {
+        __m128i vMin = _mm_set1_epi8(char(255));
+        __m128i vMax = _mm_setzero_si128();
+        for(; i+16<=n; i+=16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+            vMin = _mm_min_epu8(vMin, v);
+            vMax = _mm_max_epu8(vMax, v);
+        }
+        alignas(16) array<uint8_t, 16> minValues;
+        alignas(16) array<uint8_t, 16> maxValues;
+        _mm_store_si128(reinterpret_cast<__m128i*>(minValues.data()), vMin);
+        _mm_store_si128(reinterpret_cast<__m128i*>(maxValues.data()), vMax);
+        minValue = *std::min_element(minValues.begin(), minValues.end());
+        maxValue = *std::max_element(maxValues.begin(), maxValues.end());
+    }
+#endif
+    for(; i<n; i++) {
+        minValue = min(minValue, x[i]);
+        maxValue = max(maxValue, x[i]);
+    }
+
+    // The most common case: all reads agree.
+    if(minValue == maxValue) {
+        return maxValue;
+    }
+
+
+
+    // Count the occurrences of each value in [minValue, maxValue].
+    array<uint64_t, 256> frequency;
+    std::fill(frequency.begin() + minValue, frequency.begin() + maxValue + 1, 0);
+#if defined(__SSE2__)
+    // When the range is small, count each value by comparing
+    // 16 values at a time. The counts are accumulated in 8 bits
+    // for at most 255 blocks, then added up using _mm_sad_epu8.
+    if(maxValue - minValue < 16 and n >= 16) {
+        const uint64_t blockCount = n / 16;
+        for(uint32_t value=minValue; value<=maxValue; value++) {
+            const __m128i vValue = _mm_set1_epi8(char(value));
+            uint64_t count = 0;
+            for(uint64_t block0=0; block0<blockCount; block0+=255) {
+                const uint64_t block1 = min(blockCount, block0 + 255);
+                __m128i vCount = _mm_setzero_si128();
+                for(uint64_t block=block0; block<block1; block++) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 16 * block));
+                    vCount = _mm_sub_epi8(vCount, _mm_cmpeq_epi8(v, vValue));
+                }
+                const __m128i sums = _mm_sad_epu8(vCount, _mm_setzero_si128());
+                count += uint64_t(_mm_cvtsi128_si32(sums)) + uint64_t(_mm_extract_epi16(sums, 4));
+            }
+            frequency[value] = count;
+        }
+        for(uint64_t i=16*blockCount; i<n; i++) {
+            ++frequency[x[i]];
+        }
+    } else
+#endif
+    {
+        for(uint64_t i=0; i<n; i++) {
+            ++frequency[x[i]];
+        }
+    }
+
+    // Find the most frequent value, breaking ties in favor of larger values.
+    uint32_t bestValue = maxValue;
+    for(uint32_t value=maxValue; value>minValue; value--) {
+        if(frequency[value - 1] > frequency[bestValue]) {
+            bestValue = value - 1;
+        }
+    }
+    return uint8_t(bestValue);
+}
@@ -32,6 +32,24 @@ class shasta::SimpleConsensusCaller :
 public:
 
     virtual Consensus operator()(const Coverage&) const;
+    virtual void callBatch(span<const Coverage>, span<Consensus>) const;
+
+    // The best repeat count only depends on the repeat counts,
+    // so it can be computed without Coverage objects.
+    virtual bool canCallRepeatCounts() const
+    {
+        return true;
+    }
+    virtual void callRepeatCounts(
+        span<const uint8_t> repeatCounts,
+        uint64_t readCount,
+        span<uint32_t> consensusRepeatCounts) const;
+
+private:
+
+    // Return the most frequent value in x, with ties broken
+    // in favor of larger values, as in Coverage::mostFrequentRepeatCount.
+    static uint8_t mostFrequentRepeatCount(const uint8_t* x, uint64_t n);
 
 };
 
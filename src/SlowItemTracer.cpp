@@ -0,0 +1,176 @@
+// Shasta.
+#include "SlowItemTracer.hpp"
+#include "performanceLog.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+
+
+// The slowest items of all tracers with the same name,
+// in order of first appearance.
+namespace shasta {
+    namespace {
+        class SlowItemsSummary {
+        public:
+            string name;
+            string idName;
+            vector<string> valueNames;
+            vector<SlowItemTracer::Item> items;
+        };
+        std::atomic<uint64_t> slowItemCount = 0;
+        std::mutex slowItemsMutex;
+        vector<SlowItemsSummary> slowItemsSummaries;
+    }
+}
+
+
+
+void shasta::enableSlowItemTracing(uint64_t n)
+{
+    slowItemCount = n;
+}
+
+
+
+bool shasta::slowItemTracingIsEnabled()
+{
+    return slowItemCount > 0;
+}
+
+
+
+SlowItemTracer::SlowItemTracer(
+    const string& name,
+    const string& idName,
+    const vector<string>& valueNames) :
+    name(name),
+    idName(idName),
+    valueNames(valueNames),
+    capacity(slowItemCount)
+{
+    SHASTA_ASSERT(valueNames.size() <= maxValueCount);
+    items.reserve(capacity);
+}
+
+
+
+void SlowItemTracer::recordLocked(
+    uint64_t id,
+    double seconds,
+    const array<uint64_t, maxValueCount>& values)
+{
+    if(capacity == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(items.size() == capacity) {
+        if(seconds <= items.front().seconds) {
+            return;
+        }
+        pop_heap(items.begin(), items.end());
+        items.pop_back();
+    }
+    items.push_back({id, seconds, values});
+    push_heap(items.begin(), items.end());
+    if(items.size() == capacity) {
+        threshold.store(items.front().seconds, std::memory_order_relaxed);
+    }
+}
+
+
+
+void SlowItemTracer::write()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(items.empty()) {
+        return;
+    }
+    sort(items.begin(), items.end());
+
+    performanceLog << timestamp << "Slowest items for " << name << ":" << endl;
+    for(const Item& item: items) {
+        performanceLog << idName << " " << item.id << " " << item.seconds << " s";
+        for(uint64_t i=0; i<valueNames.size(); i++) {
+            performanceLog << ", " << valueNames[i] << " " << item.values[i];
+        }
+        performanceLog << "\n";
+    }
+    performanceLog << std::flush;
+
+    // Merge into the summary.
+    {
+        std::lock_guard<std::mutex> summaryLock(slowItemsMutex);
+        SlowItemsSummary* summary = 0;
+        for(SlowItemsSummary& s: slowItemsSummaries) {
+            if(s.name == name) {
+                summary = &s;
+                break;
+            }
+        }
+        if(not summary) {
+            slowItemsSummaries.push_back({name, idName, valueNames, {}});
+            summary = &slowItemsSummaries.back();
+        }
+        vector<Item>& summaryItems = summary->items;
+        summaryItems.insert(summaryItems.end(), items.begin(), items.end());
+        sort(summaryItems.begin(), summaryItems.end());
+        if(summaryItems.size() > capacity) {
+            summaryItems.resize(capacity);
+        }
+    }
+
+    items.clear();
+    threshold.store(-1., std::memory_order_relaxed);
+}
+
+
+
+void shasta::writeSlowItemsJson(ostream& json)
+{
+    std::lock_guard<std::mutex> lock(slowItemsMutex);
+    json << "{";
+    for(uint64_t i=0; i<slowItemsSummaries.size(); i++) {
+        const SlowItemsSummary& summary = slowItemsSummaries[i];
+        json << (i == 0 ? "\n" : ",\n") <<
+            "    \"" << summary.name << "\": [";
+        for(uint64_t j=0; j<summary.items.size(); j++) {
+            const SlowItemTracer::Item& item = summary.items[j];
+            json << (j == 0 ? "\n" : ",\n") <<
+                "      {\"" << summary.idName << "\": " << item.id <<
+                ", \"Seconds\": " << item.seconds;
+            for(uint64_t k=0; k<summary.valueNames.size(); k++) {
+                json << ", \"" << summary.valueNames[k] << "\": " << item.values[k];
+            }
+            json << "}";
+        }
+        json << "\n    ]";
+    }
+    json << "\n  }";
+}
+
+
+
+void shasta::writeSlowItemsHtml(ostream& html)
+{
+    std::lock_guard<std::mutex> lock(slowItemsMutex);
+    for(const SlowItemsSummary& summary: slowItemsSummaries) {
+        html << "<h4>" << summary.name << "</h4>"
+            "<table><tr><th>" << summary.idName << "<th>Seconds";
+        for(const string& valueName: summary.valueNames) {
+            html << "<th>" << valueName;
+        }
+        for(const SlowItemTracer::Item& item: summary.items) {
+            html << "<tr><td class=centered>" << item.id <<
+                "<td class=centered>" << item.seconds;
+            for(uint64_t k=0; k<summary.valueNames.size(); k++) {
+                html << "<td class=centered>" << item.values[k];
+            }
+        }
+        html << "</table>";
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef SHASTA_SLOW_ITEM_TRACER_HPP
+#define SHASTA_SLOW_ITEM_TRACER_HPP
+
+// Slow item tracing: if enabled via enableSlowItemTracing(n),
+// parallel computations that process work items of widely varying cost
+// keep track of the n slowest items they processed,
+// with their elapsed time and a few numbers describing
+// the size of their input.
+// This complements the thread statistics (see MultithreadedObject.hpp),
+// which only identify the slowest batch.
+
+// A SlowItemTracer is created for each parallel computation.
+// Its record function can be called from any thread.
+// It is cheap for items that are not slower than the n-th slowest item
+// seen so far. When the computation ends, write() writes the slowest items
+// to the performance log and merges them into a process-wide summary,
+// grouped by tracer name, which is written by writeSlowItemsJson
+// and writeSlowItemsHtml.
+
+// Standard library.
+#include "array.hpp"
+#include <atomic>
+#include "cstdint.hpp"
+#include "iostream.hpp"
+#include <mutex>
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class SlowItemTracer;
+
+    // Slow item tracing is disabled if n is zero.
+    void enableSlowItemTracing(uint64_t n);
+    bool slowItemTracingIsEnabled();
+    void writeSlowItemsJson(ostream&);
+    void writeSlowItemsHtml(ostream&);
+}
+
+
+
+class shasta::SlowItemTracer {
+public:
+
+    // The name identifies the computation.
+    // The id name describes the item ids (for example, "EdgeId").
+    // The value names describe the numbers stored with each item.
+    static const uint64_t maxValueCount = 4;
+    SlowItemTracer(
+        const string& name,
+        const string& idName,
+        const vector<string>& valueNames);
+
+    SlowItemTracer(const SlowItemTracer&) = delete;
+    SlowItemTracer& operator=(const SlowItemTracer&) = delete;
+
+    class Item {
+    public:
+        uint64_t id;
+        double seconds;
+        array<uint64_t, maxValueCount> values;
+        bool operator<(const Item& that) const
+        {
+            return seconds > that.seconds;
+        }
+    };
+
+    // Thread safe.
+    void record(uint64_t id, double seconds, const array<uint64_t, maxValueCount>& values)
+    {
+        if(seconds <= threshold.load(std::memory_order_relaxed)) {
+            return;
+        }
+        recordLocked(id, seconds, values);
+    }
+
+    // Write the slowest items to the performance log and merge them
+    // into the process-wide summary. This also clears the recorded items,
+    // so the tracer can be reused.
+    void write();
+
+private:
+    string name;
+    string idName;
+    vector<string> valueNames;
+    uint64_t capacity;
+
+    // Items with elapsed time not greater than this are not recorded.
+    // It is the elapsed time of the fastest recorded item
+    // once capacity items have been recorded.
+    std::atomic<double> threshold = -1.;
+
+    // A heap (in the sense of std::push_heap) of the recorded items,
+    // with the fastest item at the front.
+    std::mutex mutex;
+    vector<Item> items;
+
+    void recordLocked(uint64_t id, double seconds, const array<uint64_t, maxValueCount>& values);
+};
+
+#endif
@@ -0,0 +1,55 @@
+// Shasta.
+#include "SpoaEnginePool.hpp"
+using namespace shasta;
+
+// Spoa.
+#include "spoa/spoa.hpp"
+
+
+
+SpoaEnginePool::SpoaEnginePool()
+{
+    // These are the same parameters used for all marker graph edge consensus.
+    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
+    const int8_t match = 1;
+    const int8_t mismatch = -1;
+    const int8_t gap = -1;
+
+    for(uint64_t i=0; i<engines.size(); i++) {
+        engines[i] = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
+
+        // Preallocate the engines for the bounded buckets.
+        if(i < bucketMaxLength.size()) {
+            engines[i]->Prealloc(bucketMaxLength[i], 4);
+        }
+    }
+
+    graph = std::make_unique<spoa::Graph>();
+}
+
+
+
+// The destructor is defined here because spoa types
+// are incomplete in the header.
+SpoaEnginePool::~SpoaEnginePool() {}
+
+
+
+const std::unique_ptr<spoa::AlignmentEngine>& SpoaEnginePool::getEngine(
+    uint64_t maxSequenceLength) const
+{
+    for(uint64_t i=0; i<bucketMaxLength.size(); i++) {
+        if(maxSequenceLength <= bucketMaxLength[i]) {
+            return engines[i];
+        }
+    }
+    return engines.back();
+}
+
+
+
+spoa::Graph& SpoaEnginePool::getClearedGraph()
+{
+    graph->Clear();
+    return *graph;
+}
@@ -0,0 +1,52 @@
+#ifndef SHASTA_SPOA_ENGINE_POOL_HPP
+#define SHASTA_SPOA_ENGINE_POOL_HPP
+
+// Standard library.
+#include "array.hpp"
+#include "cstdint.hpp"
+#include "memory.hpp"
+
+namespace shasta {
+    class SpoaEnginePool;
+}
+
+namespace spoa {
+    class AlignmentEngine;
+    class Graph;
+}
+
+
+
+// A set of spoa alignment engines and a spoa alignment graph
+// that can be reused for many multiple sequence alignments.
+// This is used to compute consensus sequence of marker graph edges.
+// Each thread uses its own SpoaEnginePool, so the engines and the graph
+// are created once per thread instead of once per alignment.
+//
+// Spoa engines grow their dynamic programming matrices as needed,
+// but never shrink them. To keep short alignments, which are the vast
+// majority, working on small matrices, engines are bucketed by the length
+// of the longest sequence to be aligned. The engines for the
+// bounded buckets are preallocated for their maximum length.
+class shasta::SpoaEnginePool {
+public:
+    SpoaEnginePool();
+    ~SpoaEnginePool();
+
+    // Return the engine to be used to align sequences
+    // of length up to maxSequenceLength.
+    const std::unique_ptr<spoa::AlignmentEngine>& getEngine(uint64_t maxSequenceLength) const;
+
+    // Return the alignment graph, cleared and ready for a new alignment.
+    spoa::Graph& getClearedGraph();
+
+    // The maximum sequence length for each bounded bucket.
+    // The last engine is used for all longer sequences.
+    static constexpr std::array<uint32_t, 2> bucketMaxLength = {64, 512};
+
+private:
+    std::array<std::unique_ptr<spoa::AlignmentEngine>, bucketMaxLength.size() + 1> engines;
+    std::unique_ptr<spoa::Graph> graph;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef SHASTA_STRIPED_MAP_HPP
+#define SHASTA_STRIPED_MAP_HPP
+
+// A hash map that can be updated concurrently by multiple threads.
+// The keys are distributed among a fixed number of stripes,
+// each consisting of a mutex and an std::unordered_map.
+// Threads that access keys in different stripes don't contend.
+// This is only useful for maps that are updated by many threads
+// at the same time, for example to keep track of vertices
+// already reached by a parallel BFS.
+
+// Standard library.
+#include "array.hpp"
+#include "cstdint.hpp"
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include "utility.hpp"
+
+namespace shasta {
+    template<class Key, class T, uint64_t stripeCount = 64> class StripedMap;
+}
+
+
+
+template<class Key, class T, uint64_t stripeCount> class shasta::StripedMap {
+public:
+
+    // Insert a key with the given value, if not already present.
+    // Returns true if the key was inserted.
+    bool insert(const Key& key, const T& value)
+    {
+        Stripe& stripe = getStripe(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return stripe.data.insert(make_pair(key, value)).second;
+    }
+
+    // Find out if a key is present.
+    bool contains(const Key& key) const
+    {
+        const Stripe& stripe = getStripe(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return stripe.data.find(key) != stripe.data.end();
+    }
+
+    // Get the value for a key, if present.
+    bool get(const Key& key, T& value) const
+    {
+        const Stripe& stripe = getStripe(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        const auto it = stripe.data.find(key);
+        if(it == stripe.data.end()) {
+            return false;
+        } else {
+            value = it->second;
+            return true;
+        }
+    }
+
+    // The functions below are not thread safe
+    // and must not be called while the map is being updated.
+    uint64_t size() const
+    {
+        uint64_t n = 0;
+        for(const Stripe& stripe: stripes) {
+            n += stripe.data.size();
+        }
+        return n;
+    }
+    void clear()
+    {
+        for(Stripe& stripe: stripes) {
+            stripe.data.clear();
+        }
+    }
+
+private:
+
+    // Each stripe is aligned to a cache line to avoid false sharing
+    // between threads locking adjacent mutexes.
+    class alignas(64) Stripe {
+    public:
+        mutable std::mutex mutex;
+        std::unordered_map<Key, T> data;
+    };
+    array<Stripe, stripeCount> stripes;
+
+    // The stripe is chosen using the high bits of a mixed hash,
+    // because std::hash is the identity for integer types.
+    static uint64_t getStripeIndex(const Key& key)
+    {
+        const uint64_t h = uint64_t(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ULL;
+        return (h >> 32) % stripeCount;
+    }
+    Stripe& getStripe(const Key& key)
+    {
+        return stripes[getStripeIndex(key)];
+    }
+    const Stripe& getStripe(const Key& key) const
+    {
+        return stripes[getStripeIndex(key)];
+    }
+};
+
+#endif
@@ -44,13 +44,38 @@ and therefore excluded from the topological sort.
 As an example, if the input graph consists of a single cycle,
 Only the last edge processed will be classified as causing a cycle.
 
+approximateTopologicalSortParallel has the same interface and requirements,
+and flags exactly the same edges as causing cycles, because
+an edge can only cause a cycle together with edges in the same
+strongly connected component. It computes the strongly connected
+components of the graph formed by the edges to be processed
+(using an iterative version of Tarjan's algorithm),
+then processes each strongly connected component
+independently and in parallel with the above algorithm,
+using local vectors instead of the graph.
+The strongly connected components are ranked in the topological order
+of the condensation graph, which Tarjan's algorithm provides
+at no additional cost. This avoids the DFS's extending over large
+regions of the graph when there are many small cycles.
+The ranks it computes are a valid topological sort of the DAG edges,
+but are not necessarily the same as those computed by
+approximateTopologicalSort.
+
 ********************************************************************************/
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/filtered_graph.hpp>
 #include <boost/graph/iteration_macros.hpp>
 
+#include "SHASTA_ASSERT.hpp"
+
+#include "algorithm.hpp"
+#include <atomic>
+#include "cstdint.hpp"
+#include <limits>
 #include <stack>
+#include <thread>
+#include <unordered_map>
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -59,6 +84,20 @@ namespace shasta {
     template<class Graph> void approximateTopologicalSort(
         Graph&,
         const vector<typename Graph::edge_descriptor>&);
+
+    // A threadCount of 0 means use all available hardware threads.
+    template<class Graph> void approximateTopologicalSortParallel(
+        Graph&,
+        const vector<typename Graph::edge_descriptor>&,
+        size_t threadCount);
+
+    namespace approximateTopologicalSortDetail {
+        inline void processStronglyConnectedComponent(
+            uint64_t vertexCount,
+            const vector< pair<uint32_t, uint32_t> >& edges,
+            vector<uint32_t>& rank,
+            vector<bool>& isDagEdge);
+    }
 }
 
 
@@ -233,4 +272,330 @@ template<class Graph> void shasta::approximateTopologicalSort(
     }
 }
 
+
+
+// Process a strongly connected component, using the same
+// algorithm as approximateTopologicalSort, but operating on local vectors.
+// The vertices are numbered 0 to vertexCount-1, and the edges are
+// given as pairs (source, target), in the order in which they should be processed.
+// On return, rank contains the topological sort of the vertices,
+// and isDagEdge flags the edges that did not cause cycles.
+inline void shasta::approximateTopologicalSortDetail::processStronglyConnectedComponent(
+    uint64_t vertexCount,
+    const vector< pair<uint32_t, uint32_t> >& edges,
+    vector<uint32_t>& rank,
+    vector<bool>& isDagEdge)
+{
+    rank.resize(vertexCount);
+    for(uint64_t i=0; i<vertexCount; i++) {
+        rank[i] = uint32_t(i);
+    }
+    isDagEdge.assign(edges.size(), false);
+
+    // The DAG edges found so far.
+    vector< vector<uint32_t> > outEdges(vertexCount);
+    vector< vector<uint32_t> > inEdges(vertexCount);
+
+    vector<bool> color(vertexCount, false);
+    vector< pair<uint32_t, uint32_t> > deltaF;
+    vector< pair<uint32_t, uint32_t> > deltaB;
+    vector<uint32_t> deltaRanks;
+    vector<uint32_t> vertexStack;
+
+    for(uint64_t i=0; i<edges.size(); i++) {
+        const uint32_t x = edges[i].first;
+        const uint32_t y = edges[i].second;
+
+        if(rank[x] < rank[y]) {
+            isDagEdge[i] = true;
+            outEdges[x].push_back(y);
+            inEdges[y].push_back(x);
+            continue;
+        }
+
+        // Forward DFS from y limited to the affected region.
+        // If it reaches x, this edge causes a cycle.
+        bool createsCycle = (x == y);
+        deltaF.clear();
+        deltaRanks.clear();
+        if(not createsCycle) {
+            vertexStack.push_back(y);
+            deltaF.push_back({rank[y], y});
+            color[y] = true;
+            while(not vertexStack.empty()) {
+                const uint32_t v0 = vertexStack.back();
+                vertexStack.pop_back();
+                for(const uint32_t v1: outEdges[v0]) {
+                    if(rank[v1] > rank[x] or color[v1]) {
+                        continue;
+                    }
+                    if(v1 == x) {
+                        createsCycle = true;
+                        break;
+                    }
+                    color[v1] = true;
+                    vertexStack.push_back(v1);
+                    deltaF.push_back({rank[v1], v1});
+                }
+                if(createsCycle) {
+                    break;
+                }
+            }
+            vertexStack.clear();
+            for(const auto& p: deltaF) {
+                color[p.second] = false;
+            }
+        }
+        if(createsCycle) {
+            continue;
+        }
+
+        // Backward DFS from x limited to the affected region.
+        deltaB.clear();
+        vertexStack.push_back(x);
+        deltaB.push_back({rank[x], x});
+        color[x] = true;
+        while(not vertexStack.empty()) {
+            const uint32_t v0 = vertexStack.back();
+            vertexStack.pop_back();
+            for(const uint32_t v1: inEdges[v0]) {
+                if(rank[v1] < rank[y] or color[v1]) {
+                    continue;
+                }
+                color[v1] = true;
+                vertexStack.push_back(v1);
+                deltaB.push_back({rank[v1], v1});
+            }
+        }
+        for(const auto& p: deltaB) {
+            color[p.second] = false;
+        }
+
+        // Redistribute the ranks of deltaB and deltaF.
+        sort(deltaF.begin(), deltaF.end());
+        sort(deltaB.begin(), deltaB.end());
+        for(const auto& p: deltaF) {
+            deltaRanks.push_back(p.first);
+        }
+        for(const auto& p: deltaB) {
+            deltaRanks.push_back(p.first);
+        }
+        sort(deltaRanks.begin(), deltaRanks.end());
+        uint64_t j = 0;
+        for(const auto& p: deltaB) {
+            rank[p.second] = deltaRanks[j++];
+        }
+        for(const auto& p: deltaF) {
+            rank[p.second] = deltaRanks[j++];
+        }
+
+        isDagEdge[i] = true;
+        outEdges[x].push_back(y);
+        inEdges[y].push_back(x);
+    }
+}
+
+
+
+template<class Graph> void shasta::approximateTopologicalSortParallel(
+    Graph& graph,
+    const vector<typename Graph::edge_descriptor>& edgesToProcess,
+    size_t threadCount)
+{
+    using namespace approximateTopologicalSortDetail;
+    using vertex_descriptor = typename Graph::vertex_descriptor;
+
+    if(threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    // Number the vertices and initialize.
+    vector<vertex_descriptor> vertexVector;
+    std::unordered_map<vertex_descriptor, uint64_t> vertexMap;
+    BGL_FORALL_VERTICES_T(v, graph, Graph) {
+        vertexMap.insert({v, vertexVector.size()});
+        vertexVector.push_back(v);
+        graph[v].color = 0;
+    }
+    BGL_FORALL_EDGES_T(e, graph, Graph) {
+        graph[e].isDagEdge = false;
+    }
+    const uint64_t n = vertexVector.size();
+    SHASTA_ASSERT(n < std::numeric_limits<uint32_t>::max());
+
+    // Store the edges to be processed in compressed sparse row format.
+    vector< pair<uint32_t, uint32_t> > edgeVertices;
+    edgeVertices.reserve(edgesToProcess.size());
+    vector<uint64_t> outEdgesBegin(n + 1, 0);
+    for(const auto e: edgesToProcess) {
+        const uint32_t x = uint32_t(vertexMap.at(source(e, graph)));
+        const uint32_t y = uint32_t(vertexMap.at(target(e, graph)));
+        edgeVertices.push_back({x, y});
+        ++outEdgesBegin[x + 1];
+    }
+    for(uint64_t i=0; i<n; i++) {
+        outEdgesBegin[i + 1] += outEdgesBegin[i];
+    }
+    vector<uint32_t> outEdges(edgeVertices.size());
+    {
+        vector<uint64_t> position(outEdgesBegin.begin(), outEdgesBegin.end() - 1);
+        for(const auto& p: edgeVertices) {
+            outEdges[position[p.first]++] = p.second;
+        }
+    }
+
+
+
+    // Iterative Tarjan algorithm to compute strongly connected components.
+    // Components are completed in reverse topological order of the condensation graph.
+    const uint32_t unvisited = std::numeric_limits<uint32_t>::max();
+    vector<uint32_t> index(n, unvisited);
+    vector<uint32_t> lowLink(n);
+    vector<bool> isOnStack(n, false);
+    vector<uint32_t> tarjanStack;
+    vector< pair<uint32_t, uint64_t> > dfsStack;   // (vertex, next out-edge)
+    vector<uint32_t> componentId(n);
+    vector< vector<uint32_t> > components;
+    uint32_t nextIndex = 0;
+    for(uint64_t iStart=0; iStart<n; iStart++) {
+        if(index[iStart] != unvisited) {
+            continue;
+        }
+        dfsStack.push_back({uint32_t(iStart), outEdgesBegin[iStart]});
+        index[iStart] = lowLink[iStart] = nextIndex++;
+        tarjanStack.push_back(uint32_t(iStart));
+        isOnStack[iStart] = true;
+
+        while(not dfsStack.empty()) {
+            const uint32_t v = dfsStack.back().first;
+            uint64_t& k = dfsStack.back().second;
+            if(k != outEdgesBegin[v + 1]) {
+                const uint32_t w = outEdges[k++];
+                if(index[w] == unvisited) {
+                    index[w] = lowLink[w] = nextIndex++;
+                    tarjanStack.push_back(w);
+                    isOnStack[w] = true;
+                    dfsStack.push_back({w, outEdgesBegin[w]});
+                } else if(isOnStack[w]) {
+                    lowLink[v] = std::min(lowLink[v], index[w]);
+                }
+                continue;
+            }
+
+            // All out-edges of v were processed.
+            dfsStack.pop_back();
+            if(not dfsStack.empty()) {
+                const uint32_t u = dfsStack.back().first;
+                lowLink[u] = std::min(lowLink[u], lowLink[v]);
+            }
+            if(lowLink[v] == index[v]) {
+                const uint32_t id = uint32_t(components.size());
+                components.emplace_back();
+                vector<uint32_t>& component = components.back();
+                while(true) {
+                    const uint32_t w = tarjanStack.back();
+                    tarjanStack.pop_back();
+                    isOnStack[w] = false;
+                    componentId[w] = id;
+                    component.push_back(w);
+                    if(w == v) {
+                        break;
+                    }
+                }
+                // Keep the vertices of each component in their original order.
+                sort(component.begin(), component.end());
+            }
+        }
+    }
+    const uint64_t componentCount = components.size();
+
+
+
+    // The local index of each vertex in its strongly connected component.
+    vector<uint32_t> localIndex(n);
+    for(const vector<uint32_t>& component: components) {
+        for(uint64_t i=0; i<component.size(); i++) {
+            localIndex[component[i]] = uint32_t(i);
+        }
+    }
+
+    // Gather the edges internal to each strongly connected component,
+    // in the order in which they should be processed.
+    // Edges between different components never cause cycles.
+    vector<bool> isDagEdge(edgesToProcess.size(), true);
+    vector< vector< pair<uint32_t, uint32_t> > > componentEdges(componentCount);
+    vector< vector<uint64_t> > componentEdgeIds(componentCount);
+    for(uint64_t i=0; i<edgeVertices.size(); i++) {
+        const uint32_t x = edgeVertices[i].first;
+        const uint32_t y = edgeVertices[i].second;
+        const uint32_t c = componentId[x];
+        if(c == componentId[y]) {
+            componentEdges[c].push_back({localIndex[x], localIndex[y]});
+            componentEdgeIds[c].push_back(i);
+        }
+    }
+
+    // Process the strongly connected components that have internal edges
+    // in parallel, largest first.
+    vector<uint32_t> workList;
+    for(uint64_t c=0; c<componentCount; c++) {
+        if(not componentEdges[c].empty()) {
+            workList.push_back(uint32_t(c));
+        }
+    }
+    sort(workList.begin(), workList.end(),
+        [&componentEdges](uint32_t c0, uint32_t c1)
+        {
+            return componentEdges[c0].size() > componentEdges[c1].size();
+        });
+    vector< vector<uint32_t> > localRank(componentCount);
+    vector< vector<bool> > localIsDagEdge(componentCount);
+    std::atomic<uint64_t> nextWorkItem(0);
+    auto threadFunction = [&]()
+    {
+        while(true) {
+            const uint64_t i = nextWorkItem++;
+            if(i >= workList.size()) {
+                break;
+            }
+            const uint32_t c = workList[i];
+            processStronglyConnectedComponent(
+                components[c].size(), componentEdges[c], localRank[c], localIsDagEdge[c]);
+        }
+    };
+    vector<std::thread> threads;
+    const uint64_t usedThreadCount = std::min(uint64_t(threadCount), uint64_t(workList.size()));
+    for(uint64_t threadId=1; threadId<usedThreadCount; threadId++) {
+        threads.push_back(std::thread(threadFunction));
+    }
+    threadFunction();
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+
+
+    // Store the ranks and the DAG edge flags.
+    // The components are ranked in reverse order of completion
+    // by the Tarjan algorithm, which is a topological sort of the condensation graph.
+    uint64_t rankBegin = 0;
+    for(uint64_t c=componentCount-1; ; c--) {
+        const vector<uint32_t>& component = components[c];
+        for(uint64_t i=0; i<component.size(); i++) {
+            const uint64_t localRankValue = localRank[c].empty() ? i : localRank[c][i];
+            graph[vertexVector[component[i]]].rank = rankBegin + localRankValue;
+        }
+        rankBegin += component.size();
+        for(uint64_t j=0; j<componentEdgeIds[c].size(); j++) {
+            isDagEdge[componentEdgeIds[c][j]] = localIsDagEdge[c][j];
+        }
+        if(c == 0) {
+            break;
+        }
+    }
+    for(uint64_t i=0; i<edgesToProcess.size(); i++) {
+        graph[edgesToProcess[i]].isDagEdge = isDagEdge[i];
+    }
+}
+
 #endif
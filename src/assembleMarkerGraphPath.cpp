@@ -120,9 +120,10 @@ void shasta::assembleMarkerGraphPath(
         }
 
         // Vertices.
+        vector< pair<uint32_t, CompressedCoverageData> > input;
         assembledSegment.vertexCoverageData.resize(assembledSegment.vertexCount);
         for(size_t i=0; i<assembledSegment.vertexCount; i++) {
-            const auto& input = markerGraph.vertexCoverageData[assembledSegment.vertexIds[i]];
+            markerGraph.vertexCoverageData.get(assembledSegment.vertexIds[i], input);
             auto& output = assembledSegment.vertexCoverageData[i];
             output.resize(k);
             for(const pair<uint32_t, CompressedCoverageData>& p: input) {
@@ -136,7 +137,7 @@ void shasta::assembleMarkerGraphPath(
         // Edges.
         assembledSegment.edgeCoverageData.resize(assembledSegment.edgeCount);
         for(size_t i=0; i<assembledSegment.edgeCount; i++) {
-            const auto& input = markerGraph.edgeCoverageData[assembledSegment.edgeIds[i]];
+            markerGraph.edgeCoverageData.get(assembledSegment.edgeIds[i], input);
             auto& output = assembledSegment.edgeCoverageData[i];
             for(const pair<uint32_t, CompressedCoverageData>& p: input) {
                 const uint32_t position = p.first;
@@ -0,0 +1,348 @@
+// Micro-benchmarks of low level kernels. See benchmarkKernels.hpp.
+
+// Shasta.
+#include "benchmarkKernels.hpp"
+#include "Align4.hpp"
+#include "Alignment.hpp"
+#include "Base.hpp"
+#include "compressAlignment.hpp"
+#include "Coverage.hpp"
+#include "dset64-gccAtomic.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MurmurHash2.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "ShortBaseSequence.hpp"
+#include "SimpleBayesianConsensusCaller.hpp"
+#include "shastaTypes.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "chrono.hpp"
+#include <functional>
+#include <iomanip>
+#include "iostream.hpp"
+#include <limits>
+#include <random>
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+
+
+namespace shasta {
+    namespace {
+
+        // Run f repeatCount times and write the best time.
+        // f returns a checksum of its results.
+        void benchmark(
+            const string& name,
+            uint64_t itemCount,
+            const string& itemName,
+            uint64_t repeatCount,
+            const std::function<uint64_t()>& f)
+        {
+            double bestSeconds = std::numeric_limits<double>::max();
+            uint64_t checksum = 0;
+            for(uint64_t i=0; i<max(repeatCount, uint64_t(1)); i++) {
+                const auto t0 = steady_clock::now();
+                const uint64_t iChecksum = f();
+                const auto t1 = steady_clock::now();
+                bestSeconds = min(bestSeconds, seconds(t1 - t0));
+                if(i == 0) {
+                    checksum = iChecksum;
+                } else {
+                    SHASTA_ASSERT(iChecksum == checksum);
+                }
+            }
+            cout <<
+                std::left << std::setw(36) << name << std::right <<
+                std::setw(12) << std::fixed << std::setprecision(6) << bestSeconds << " s" <<
+                std::defaultfloat << std::setprecision(4) <<
+                std::setw(14) << double(itemCount) / bestSeconds << " " <<
+                std::left << std::setw(14) << (itemName + "/s") << std::right <<
+                " checksum " << std::hex << checksum << std::dec << endl;
+        }
+
+
+
+        // A random sequence of KmerIds, and a second one obtained from it
+        // with substitutions, insertions, and deletions, as for two reads
+        // that overlap entirely. The KmerIds are in [0, kmerIdCount).
+        void generateMarkerSequences(
+            uint64_t n,
+            uint64_t kmerIdCount,
+            double errorRate,
+            std::mt19937_64& random,
+            array<vector<KmerId>, 2>& kmerIds)
+        {
+            std::uniform_int_distribution<KmerId> kmerIdDistribution(0, kmerIdCount - 1);
+            std::uniform_real_distribution<double> uniform(0., 1.);
+            kmerIds[0].clear();
+            kmerIds[1].clear();
+            for(uint64_t i=0; i<n; i++) {
+                kmerIds[0].push_back(kmerIdDistribution(random));
+            }
+            for(uint64_t i=0; i<n; i++) {
+                const double r = uniform(random);
+                if(r < errorRate / 3.) {
+                    kmerIds[1].push_back(kmerIdDistribution(random));       // Substitution.
+                } else if(r < 2. * errorRate / 3.) {
+                    kmerIds[1].push_back(kmerIds[0][i]);                    // Insertion.
+                    kmerIds[1].push_back(kmerIdDistribution(random));
+                } else if(r < errorRate) {
+                    // Deletion.
+                } else {
+                    kmerIds[1].push_back(kmerIds[0][i]);
+                }
+            }
+        }
+
+    }
+}
+
+
+
+void shasta::benchmarkKernels(uint64_t repeatCount)
+{
+    std::mt19937_64 random(231);
+
+
+
+    // MurmurHash64A hashing of LowHash features,
+    // each consisting of m consecutive KmerIds.
+    {
+        const uint64_t n = 4 * 1024 * 1024;
+        const uint64_t m = 4;
+        vector<KmerId> kmerIds(n);
+        for(KmerId& kmerId: kmerIds) {
+            kmerId = random() & 0xffffffffULL;
+        }
+        benchmark("MurmurHash64A features", n - m + 1, "features", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i+m<=n; i++) {
+                    checksum += MurmurHash64A(&kmerIds[i], int(m * sizeof(KmerId)), 1357);
+                }
+                return checksum;
+            });
+    }
+
+
+
+    // K-mer extraction using ShortBaseSequence, as done
+    // when computing k-mer frequencies and finding markers.
+    {
+        const uint64_t n = 16 * 1024 * 1024;
+        const uint64_t k = 14;
+        vector<Base> sequence(n);
+        for(Base& base: sequence) {
+            base = Base::fromInteger(uint8_t(random() & 3));
+        }
+        benchmark("ShortBaseSequence k-mer extraction", n - k + 1, "k-mers", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                ShortBaseSequence64 kmer;
+                for(uint64_t i=0; i<k; i++) {
+                    kmer.set(i, sequence[i]);
+                }
+                for(uint64_t position=0; ; position++) {
+                    checksum += kmer.id(k);
+                    if(position + k == n) {
+                        break;
+                    }
+                    kmer.shiftLeft();
+                    kmer.set(k-1, sequence[position + k]);
+                }
+                return checksum;
+            });
+    }
+
+
+
+    // Two marker sequences used by Align4 and,
+    // via the alignment computed by Align4, by the compression benchmarks.
+    array<vector<KmerId>, 2> kmerIds;
+    generateMarkerSequences(5000, 1 << 20, 0.1, random, kmerIds);
+    Alignment alignment;
+
+
+
+    // Align4::align.
+    {
+        array<vector< pair<KmerId, uint32_t> >, 2> sortedMarkers;
+        for(uint64_t i=0; i<2; i++) {
+            for(uint64_t ordinal=0; ordinal<kmerIds[i].size(); ordinal++) {
+                sortedMarkers[i].push_back(make_pair(kmerIds[i][ordinal], uint32_t(ordinal)));
+            }
+            sort(sortedMarkers[i].begin(), sortedMarkers[i].end());
+        }
+        const array<span<KmerId>, 2> kmerIdSpans = {
+            span<KmerId>(kmerIds[0]), span<KmerId>(kmerIds[1])};
+        const array<span< pair<KmerId, uint32_t> >, 2> sortedMarkerSpans = {
+            span< pair<KmerId, uint32_t> >(sortedMarkers[0]),
+            span< pair<KmerId, uint32_t> >(sortedMarkers[1])};
+
+        // The default Align4 options.
+        Align4::Options options;
+        options.deltaX = 200;
+        options.deltaY = 10;
+        options.minEntryCountPerCell = 10;
+        options.maxDistanceFromBoundary = 100;
+        options.minAlignedMarkerCount = 100;
+        options.minAlignedFraction = 0.;
+        options.maxSkip = 30;
+        options.maxDrift = 30;
+        options.maxTrim = 30;
+        options.maxBand = 1000;
+        options.matchScore = 6;
+        options.mismatchScore = -1;
+        options.gapScore = -1;
+
+        const uint64_t alignmentCount = 20;
+        Align4::Workspace workspace;
+        AlignmentInfo alignmentInfo;
+        benchmark("Align4::align", alignmentCount, "alignments", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i<alignmentCount; i++) {
+                    Align4::align(kmerIdSpans, sortedMarkerSpans, options,
+                        workspace, alignment, alignmentInfo, false);
+                    checksum += alignment.ordinals.size();
+                }
+                return checksum;
+            });
+    }
+
+
+
+    // Alignment compression and decompression.
+    // If Align4 did not find an alignment, use the diagonal.
+    if(alignment.ordinals.empty()) {
+        for(uint32_t i=0; i<uint32_t(min(kmerIds[0].size(), kmerIds[1].size())); i++) {
+            alignment.ordinals.push_back({i, i});
+        }
+    }
+    {
+        const uint64_t alignmentCount = 1000;
+        string compressedAlignment;
+        benchmark("compressAlignment::compress", alignmentCount, "alignments", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i<alignmentCount; i++) {
+                    shasta::compress(alignment, compressedAlignment);
+                    checksum += compressedAlignment.size();
+                }
+                return checksum;
+            });
+
+        Alignment decompressedAlignment;
+        benchmark("compressAlignment::decompress", alignmentCount, "alignments", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i<alignmentCount; i++) {
+                    shasta::decompress(compressedAlignment, decompressedAlignment);
+                    checksum += decompressedAlignment.ordinals.size();
+                }
+                return checksum;
+            });
+        SHASTA_ASSERT(decompressedAlignment.ordinals == alignment.ordinals);
+    }
+
+
+
+    // SimpleBayesianConsensusCaller::operator().
+    // Each position has 30 reads with repeat counts that scatter
+    // around a true repeat count between 1 and 8.
+    {
+        const uint64_t positionCount = 20000;
+        const uint64_t coverage = 30;
+        vector<Coverage> coverages(positionCount);
+        std::uniform_int_distribution<uint64_t> baseDistribution(0, 3);
+        std::uniform_int_distribution<uint64_t> repeatCountDistribution(1, 8);
+        std::uniform_int_distribution<int> errorDistribution(-1, 1);
+        for(Coverage& c: coverages) {
+            const AlignedBase base = AlignedBase::fromInteger(uint8_t(baseDistribution(random)));
+            const int repeatCount = int(repeatCountDistribution(random));
+            for(uint64_t i=0; i<coverage; i++) {
+                c.addRead(base, Strand(i % 2), size_t(max(1, repeatCount + errorDistribution(random))));
+            }
+        }
+        const SimpleBayesianConsensusCaller consensusCaller("guppy-3.0.5-a");
+        benchmark("SimpleBayesianConsensusCaller", positionCount, "positions", repeatCount,
+            [&]()
+            {
+                uint64_t checksum = 0;
+                for(const Coverage& c: coverages) {
+                    const Consensus consensus = consensusCaller(c);
+                    checksum = 31 * checksum + 8 * consensus.base.value + consensus.repeatCount;
+                }
+                return checksum;
+            });
+    }
+
+
+
+    // DisjointSets unite and find.
+    // The pairs are local, as for aligned markers of nearby reads.
+    {
+        const uint64_t n = 4 * 1024 * 1024;
+        vector< pair<uint64_t, uint64_t> > pairs(n);
+        std::uniform_int_distribution<uint64_t> offsetDistribution(1, 1000);
+        for(uint64_t i=0; i<n; i++) {
+            const uint64_t x = random() % n;
+            pairs[i] = make_pair(x, (x + offsetDistribution(random)) % n);
+        }
+        vector<DisjointSets::Aint> data(n);
+        benchmark("DisjointSets unite and find", 2 * n, "operations", repeatCount,
+            [&]()
+            {
+                DisjointSets disjointSets(data.data(), n);
+                for(const auto& p: pairs) {
+                    disjointSets.unite(p.first, p.second);
+                }
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i<n; i++) {
+                    checksum += (disjointSets.find(i) == i);
+                }
+                return checksum;
+            });
+    }
+
+
+
+    // MemoryMapped::VectorOfVectors two-pass fill.
+    {
+        const uint64_t vectorCount = 1024 * 1024;
+        const uint64_t n = 8 * vectorCount;
+        vector< pair<uint64_t, uint64_t> > items(n);
+        for(uint64_t i=0; i<n; i++) {
+            items[i] = make_pair(random() % vectorCount, i);
+        }
+        benchmark("VectorOfVectors two-pass fill", n, "items", repeatCount,
+            [&]()
+            {
+                MemoryMapped::VectorOfVectors<uint64_t, uint64_t> v;
+                v.createNew("", 4096);
+                v.beginPass1(vectorCount);
+                for(const auto& item: items) {
+                    v.incrementCount(item.first);
+                }
+                v.beginPass2();
+                for(const auto& item: items) {
+                    v.store(item.first, item.second);
+                }
+                v.endPass2();
+                uint64_t checksum = 0;
+                for(uint64_t i=0; i<vectorCount; i++) {
+                    checksum = 31 * checksum + v.size(i);
+                }
+                return checksum;
+            });
+    }
+}
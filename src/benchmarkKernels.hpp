@@ -0,0 +1,31 @@
+#ifndef SHASTA_BENCHMARK_KERNELS_HPP
+#define SHASTA_BENCHMARK_KERNELS_HPP
+
+/*******************************************************************************
+
+Micro-benchmarks for some of the low level kernels used during assembly:
+
+- MurmurHash64A hashing of LowHash features (m consecutive KmerIds).
+- K-mer extraction using ShortBaseSequence.
+- Alignment compression and decompression.
+- Align4::align.
+- SimpleBayesianConsensusCaller::operator().
+- DisjointSets unite and find.
+- MemoryMapped::VectorOfVectors two-pass fill.
+
+All inputs are synthetic, generated with fixed seeds,
+so results are comparable between builds and can be used
+to measure kernel level changes in isolation.
+Each kernel runs repeatCount times and the best time is reported,
+together with a checksum of the results, which should not change
+unless the behavior of the kernel changes.
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+
+namespace shasta {
+    void benchmarkKernels(uint64_t repeatCount = 5);
+}
+
+#endif
@@ -2,6 +2,10 @@
 #define SHASTA_BIT_REVERSAL_HPP
 
 // See https://graphics.stanford.edu/~seander/bithacks.html#ReverseParallel
+// The last steps, which swap bytes, are done using the byte swap builtins
+// (a single instruction on x86_64 and aarch64, and a byte shuffle
+// when the compiler vectorizes loops that use these functions).
+// Clang also has a bit reversal builtin (rbit on aarch64).
 
 #include "cstdint.hpp"
 
@@ -15,6 +19,9 @@ namespace shasta {
 
 inline uint16_t shasta::bitReversal(uint16_t x)
 {
+#if defined(__clang__)
+    return __builtin_bitreverse16(x);
+#else
     const uint16_t m1 = uint16_t(0x5555);
     const uint16_t m2 = uint16_t(0x3333);
     const uint16_t m4 = uint16_t(0x0F0F);
@@ -22,33 +29,36 @@ inline uint16_t shasta::bitReversal(uint16_t x)
     x = ((x >> 1) & m1) | ((x & m1) << 1);
     x = ((x >> 2) & m2) | ((x & m2) << 2);
     x = ((x >> 4) & m4) | ((x & m4) << 4);
-    x = (x >> 8) | (x << 8);
-    return x;
+    return __builtin_bswap16(x);
+#endif
 }
 
 
 
 inline uint32_t shasta::bitReversal(uint32_t x)
 {
+#if defined(__clang__)
+    return __builtin_bitreverse32(x);
+#else
     x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
     x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
     x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
-    x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
-    x = ( x >> 16) | ( x << 16);
-    return x;
+    return __builtin_bswap32(x);
+#endif
 }
 
 
 
 inline uint64_t shasta::bitReversal(uint64_t x)
 {
+#if defined(__clang__)
+    return __builtin_bitreverse64(x);
+#else
     x = ((x >> 1)  & 0x5555555555555555UL) | ((x & 0x5555555555555555UL) << 1 );
     x = ((x >> 2)  & 0x3333333333333333UL) | ((x & 0x3333333333333333UL) << 2 );
     x = ((x >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((x & 0x0F0F0F0F0F0F0F0FUL) << 4 );
-    x = ((x >> 8)  & 0x00FF00FF00FF00FFUL) | ((x & 0x00FF00FF00FF00FFUL) << 8 );
-    x = ((x >> 16) & 0x0000FFFF0000FFFFUL) | ((x & 0x0000FFFF0000FFFFUL) << 16);
-    x = (x >> 32) | (x << 32);
-    return x;
+    return __builtin_bswap64(x);
+#endif
 }
 
 #endif
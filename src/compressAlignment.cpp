@@ -3,14 +3,18 @@
 using namespace shasta;
 using namespace compressAlignment;
 
+// Standard library.
+#include <cstring>
+#include "stdexcept.hpp"
+
 // Compress/decompress an alignment to bytes.
 // See compressAlignment.hpp for more details.
 
 
 
-void shasta::compress(const Alignment& alignment, string& s)
+// Append to s the streaks describing an alignment.
+static void appendStreaks(const Alignment& alignment, string& s)
 {
-    s.clear();
     uint32_t ordinal0 = 0;
     uint32_t ordinal1 = 0;
 
@@ -70,70 +74,162 @@ void shasta::compress(const Alignment& alignment, string& s)
 }
 
 
+void shasta::compressAlignment::compressStreaks(const Alignment& alignment, string& s)
+{
+    s.clear();
+    appendStreaks(alignment, s);
+}
+
+
+
+void shasta::compress(const Alignment& alignment, string& s)
+{
+    s.clear();
+
+    // The header.
+    const Format1 header(0, 0, uint32_t(currentVersion) + 1);
+    s.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // The number of marker pairs.
+    const uint32_t markerCount = uint32_t(alignment.ordinals.size());
+    SHASTA_ASSERT(markerCount == alignment.ordinals.size());
+    s.append(reinterpret_cast<const char*>(&markerCount), sizeof(markerCount));
+
+    // The streaks.
+    appendStreaks(alignment, s);
+}
+
+
+
+uint8_t shasta::compressAlignment::getVersion(span<const char> s)
+{
+    if(s.size() < sizeof(Format1) or extractFormatIdentifier(s[0]) != Format1::id) {
+        return 0;
+    }
+    Format1 header(0, 0, 1);
+    std::memcpy(&header, s.data(), sizeof(header));
+    if(header.skip0 != 0 or header.skip1 != 0 or not Format0::ok(0, 0, header.n())) {
+        return 0;
+    }
+    return uint8_t(header.nMinus1);
+}
+
+
+
+// Read the streak that begins at p and return its size in bytes.
+static uint64_t readStreak(const char* p, int32_t& skip0, int32_t& skip1, uint32_t& n)
+{
+    const uint8_t formatIdentifier = extractFormatIdentifier(*p);
+    if(formatIdentifier == Format0::id) {
+        const Format0* f = reinterpret_cast<const Format0*>(p);
+        skip0 = f->skip0;
+        skip1 = f->skip1;
+        n = f->n();
+        return sizeof(Format0);
+    } else if(formatIdentifier == Format1::id) {
+        const Format1* f = reinterpret_cast<const Format1*>(p);
+        skip0 = f->skip0;
+        skip1 = f->skip1;
+        n = f->n();
+        return sizeof(Format1);
+    } else if(formatIdentifier == Format2::id) {
+        const Format2* f = reinterpret_cast<const Format2*>(p);
+        skip0 = f->skip0;
+        skip1 = f->skip1;
+        n = f->n();
+        return sizeof(Format2);
+    } else if(formatIdentifier == Format3::id) {
+        const Format3* f = reinterpret_cast<const Format3*>(p);
+        skip0 = int32_t(f->skip0);
+        skip1 = int32_t(f->skip1);
+        n = f->n();
+        return sizeof(Format3);
+    } else {
+        const Format4* f = reinterpret_cast<const Format4*>(p);
+        skip0 = f->skip0;
+        skip1 = f->skip1;
+        n = f->n();
+        return sizeof(Format4);
+    }
+}
+
+
+
 void shasta::decompress(span<const char> s, Alignment& alignment)
 {
-    alignment.clear();
-    uint32_t ordinal0 = 0;
-    uint32_t ordinal1 = 0;
-    
-    size_t pos = 0;
-    while (pos < s.size()) {
-        uint32_t streakSize;
+    // Locate the streaks and get the number of marker pairs.
+    const char* begin = s.data();
+    const char* end = s.data() + s.size();
+    uint64_t markerCount = 0;
+    const uint8_t version = getVersion(s);
+    if(version == 0) {
+
+        // There is no header, and we have to count the marker pairs.
+        // This is much faster than decoding.
         int32_t skip0, skip1;
+        uint32_t n;
+        for(const char* p=begin; p<end; ) {
+            p += readStreak(p, skip0, skip1, n);
+            markerCount += n;
+        }
 
-        uint8_t formatIdentifier = compressAlignment::extractFormatIdentifier(s[pos]);
-        if (formatIdentifier == Format0::id) {
-            // Format0
-            Format0 const *f0 = reinterpret_cast<Format0*>(const_cast<char*>(&s[pos]));
-            pos += sizeof(Format0);
-            skip0 = f0->skip0;
-            skip1 = f0->skip1;
-            streakSize = f0->n();
-            
-        } else if (formatIdentifier == Format1::id) {
-            // Format1
-            Format1 const *f1 = reinterpret_cast<Format1*>(const_cast<char*>(&s[pos]));
-            pos += sizeof(Format1);
-            skip0 = f1->skip0;
-            skip1 = f1->skip1;
-            streakSize = f1->n();
-            
-        } else if (formatIdentifier == Format2::id) {
-            // Format2
-            Format2 const *f2 = reinterpret_cast<Format2*>(const_cast<char*>(&s[pos]));
-            pos += sizeof(Format2);
-            skip0 = f2->skip0;
-            skip1 = f2->skip1;
-            streakSize = f2->n();
-
-        } else if (formatIdentifier == Format3::id) {
-            // Format3
-            Format3 const *f3 = reinterpret_cast<Format3*>(const_cast<char*>(&s[pos]));
-            pos += sizeof(Format3);
-            skip0 = f3->skip0;
-            skip1 = f3->skip1;
-            streakSize = f3->n();
+    } else if(version == 1) {
+        if(s.size() < sizeof(Format1) + sizeof(uint32_t)) {
+            throw runtime_error("Shasta Internal Error: truncated compressed alignment.");
+        }
+        uint32_t storedMarkerCount;
+        std::memcpy(&storedMarkerCount, begin + sizeof(Format1), sizeof(storedMarkerCount));
+        markerCount = storedMarkerCount;
+        begin += sizeof(Format1) + sizeof(uint32_t);
 
-        } else {
-            // Format4
-            Format4 const *f4 = reinterpret_cast<Format4*>(const_cast<char*>(&s[pos]));
-            pos += sizeof(Format4);
-            skip0 = f4->skip0;
-            skip1 = f4->skip1;
-            streakSize = f4->n();
+    } else {
+        throw runtime_error("Shasta Internal Error: unsupported compressed alignment version " +
+            to_string(version) + ".");
+    }
+
+
+
+    // Streaks with up to this many marker pairs are written using
+    // a fixed number of stores, which the compiler vectorizes.
+    // This avoids a loop with a variable and unpredictable number of iterations.
+    // For this to work, we need some extra space at the end of the ordinals,
+    // which is removed at the end.
+    const uint32_t fixedWriteCount = 8;
+    alignment.clear();
+    alignment.ordinals.resize(markerCount + fixedWriteCount - 1);
+    array<uint32_t, 2>* output = alignment.ordinals.data();
+    const array<uint32_t, 2>* outputEnd = output + markerCount;
+
+    uint32_t ordinal0 = 0;
+    uint32_t ordinal1 = 0;
+    int32_t skip0, skip1;
+    uint32_t n;
+    for(const char* p=begin; p<end; ) {
+        p += readStreak(p, skip0, skip1, n);
+        if(n > uint64_t(outputEnd - output)) {
+            throw runtime_error("Shasta Internal Error: inconsistent compressed alignment.");
         }
 
-        // cout << "(Skip0, Skip1, N) = (" << skip0 << ", " << skip1 << ", " << streakSize << ")" << endl;
-       
         ordinal0 += skip0;
         ordinal1 += skip1;
-        for(uint32_t i = 0; i < streakSize; i++) {
-            alignment.ordinals.push_back(array<uint32_t, 2>({ordinal0+i, ordinal1+i}));
+        if(n <= fixedWriteCount) {
+            for(uint32_t i=0; i<fixedWriteCount; i++) {
+                output[i] = {ordinal0 + i, ordinal1 + i};
+            }
+        } else {
+            for(uint32_t i=0; i<n; i++) {
+                output[i] = {ordinal0 + i, ordinal1 + i};
+            }
         }
+        output += n;
 
-        ordinal0 += (streakSize-1);
-        ordinal1 += (streakSize-1);
+        ordinal0 += (n - 1);
+        ordinal1 += (n - 1);
+    }
+    if(output != outputEnd) {
+        throw runtime_error("Shasta Internal Error: inconsistent compressed alignment.");
     }
+    alignment.ordinals.resize(markerCount);
 }
 
 uint8_t shasta::compressAlignment::extractFormatIdentifier(const char c) {
@@ -200,21 +296,31 @@ void shasta::testAlignmentCompression() {
     // }
     // cout << "--------------------------" << endl;
 
-    string compressed;
-    shasta::compress(alignment, compressed);
+    // Check the current version, and also version 0 (no header),
+    // which must remain readable.
+    for(uint64_t version=0; version<2; version++) {
+        string compressed;
+        if(version == 0) {
+            compressStreaks(alignment, compressed);
+        } else {
+            shasta::compress(alignment, compressed);
+        }
+        SHASTA_ASSERT(getVersion(compressed) == (version == 0 ? 0 : currentVersion));
 
-    cout << "Uncompressed size = " << ordinals.size() * sizeof(uint32_t) * 2 << " bytes." << endl;
-    cout << "Compressed size = " << compressed.size() << " bytes." << endl;
+        cout << "Version " << (version == 0 ? 0 : int(currentVersion)) << ":" << endl;
+        cout << "Uncompressed size = " << ordinals.size() * sizeof(uint32_t) * 2 << " bytes." << endl;
+        cout << "Compressed size = " << compressed.size() << " bytes." << endl;
 
-    Alignment decompressedAlignment;
-    span<const char> spanOfBytes(compressed.c_str(), compressed.c_str() + compressed.size());
-    shasta::decompress(spanOfBytes, decompressedAlignment);
+        Alignment decompressedAlignment;
+        span<const char> spanOfBytes(compressed.c_str(), compressed.c_str() + compressed.size());
+        shasta::decompress(spanOfBytes, decompressedAlignment);
 
-    // cout << "---Decompressed Alignment -----" << endl;
-    // for(const auto& x: decompressedAlignment.ordinals) {
-    //     cout << x[0] << ", " << x[1] << endl;
-    // }
-    // cout << "-------------------------------" << endl;
+        // cout << "---Decompressed Alignment -----" << endl;
+        // for(const auto& x: decompressedAlignment.ordinals) {
+        //     cout << x[0] << ", " << x[1] << endl;
+        // }
+        // cout << "-------------------------------" << endl;
 
-    SHASTA_ASSERT(alignment.ordinals == decompressedAlignment.ordinals);
+        SHASTA_ASSERT(alignment.ordinals == decompressedAlignment.ordinals);
+    }
 }
@@ -70,6 +70,27 @@ that can be represented.                   0      -8     -512   -2^19   -2^31
 Maximum value of skip0 and skip1
 that can be represented                    3       7      511   2^19-1  2^31-1
 
+
+
+Versioned format
+
+Decompression time is dominated by the expansion of the streaks into
+marker pairs, and is much faster if the number of marker pairs
+is known in advance: the output can then be allocated once, and each short
+streak can be written with a fixed number of (vectorizable) stores,
+without a loop whose trip count varies unpredictably from streak to streak.
+
+For this reason, compress generates a versioned format consisting of:
+
+- A 2-byte header that identifies the format version.
+  The header is a Format1 streak with skip0 = skip1 = 0 and n = version + 1.
+  The code above never generates such a streak, because it can be
+  represented using Format0. This allows decompress to distinguish
+  the versioned format from alignments stored without a header
+  (which is considered version 0) and which remain readable.
+- Version 1: the number of marker pairs in the alignment (uint32_t),
+  followed by the streaks, represented as described above.
+
 *******************************************************************************/
 
 // Shasta.
@@ -81,7 +102,11 @@ that can be represented                    3       7      511   2^19-1  2^31-1
 
 
 namespace shasta {
+
+    // Compress using the current version of the versioned format.
     void compress(const Alignment&, string&);
+
+    // Decompress an alignment stored using any version.
     void decompress(span<const char>, Alignment&);
 
     void testAlignmentCompression();
@@ -94,6 +119,16 @@ namespace shasta {
         class Format4;
 
         uint8_t extractFormatIdentifier(const char);
+
+        // The current version of the versioned format.
+        const uint8_t currentVersion = 1;
+
+        // Return the version of a compressed alignment
+        // (0 if it has no header).
+        uint8_t getVersion(span<const char>);
+
+        // Compress to streaks only, without a header (version 0).
+        void compressStreaks(const Alignment&, string&);
     }
 }
 
@@ -4,11 +4,20 @@
 
 
 /******************************************************************************
-This file contains two functions that can be used to compute the layout
+This file contains three functions that can be used to compute the layout
 of a graph:
 
 - computeLayoutGraphviz uses one of the layout progrzams provided by Graphviz.
 - computeLayoutCustom uses a custom layout program that must be provided by the user.
+- computeLayoutBuiltin uses the built-in force directed layout
+  of class ForceDirectedLayout, which runs in-process and multithreaded.
+
+For graphs with at least builtinLayoutMinVertexCount vertices,
+computeLayoutGraphviz (with the force directed layout methods neato, fdp, and sfdp)
+and computeLayoutCustom use computeLayoutBuiltin instead,
+to avoid the cost of running an external program
+and the timeouts it causes for large graphs.
+computeLayoutGraphviz also uses it when the layout method is "builtin".
 
 The layout program required by computeLayoutCustom must be provided by the
 user and is not part of Shasta. It is invoked as follows:
@@ -34,6 +43,7 @@ v x y
 
 
 // Shasta.
+#include "ForceDirectedLayout.hpp"
 #include "platformDependent.hpp"
 #include "runCommandWithTimeout.hpp"
 #include "SHASTA_ASSERT.hpp"
@@ -82,6 +92,22 @@ namespace shasta {
         uint64_t quality,
         double timeout);
 
+    // Use the built-in force directed layout.
+    // Edges missing from the edge length map get length 1.
+    template<class Graph> ComputeLayoutReturnCode computeLayoutBuiltin(
+        const Graph&,
+        double timeout,
+        std::map<typename Graph::vertex_descriptor, array<double, 2> >& positionMap,
+        const std::map<typename Graph::edge_descriptor, double>* edgeLengthMap = 0);
+
+    // Graphs with at least this number of vertices use computeLayoutBuiltin
+    // (see comments at the beginning of this file). Zero means never.
+    inline uint64_t builtinLayoutMinVertexCount = 1000;
+    inline bool useBuiltinLayout(uint64_t vertexCount)
+    {
+        return builtinLayoutMinVertexCount > 0 and vertexCount >= builtinLayoutMinVertexCount;
+    }
+
 }
 
 
@@ -96,6 +122,12 @@ template<class Graph> shasta::ComputeLayoutReturnCode shasta::computeLayoutGraph
 {
     using vertex_descriptor = typename Graph::vertex_descriptor;
 
+    if(layoutMethod == "builtin" or
+        (useBuiltinLayout(num_vertices(graph)) and
+        (layoutMethod == "neato" or layoutMethod == "fdp" or layoutMethod == "sfdp"))) {
+        return computeLayoutBuiltin(graph, timeout, positionMap, edgeLengthMap);
+    }
+
     // Create a vector of vertex descriptors and
     // a map from vertex descriptors to vertex indices.
     uint64_t i = 0;
@@ -220,6 +252,10 @@ template<class Graph> shasta::ComputeLayoutReturnCode shasta::computeLayoutCusto
 {
     using vertex_descriptor = typename Graph::vertex_descriptor;
 
+    if(useBuiltinLayout(num_vertices(graph))) {
+        return computeLayoutBuiltin(graph, timeout, positionMap, &edgeLengthMap);
+    }
+
     // Create a vector of vertex descriptors and
     // a map from vertex descriptors to vertex indices.
     uint64_t i = 0;
@@ -292,5 +328,58 @@ template<class Graph> shasta::ComputeLayoutReturnCode shasta::computeLayoutCusto
     return ComputeLayoutReturnCode::Success;
 }
 
+
+
+template<class Graph> shasta::ComputeLayoutReturnCode shasta::computeLayoutBuiltin(
+    const Graph& graph,
+    double timeout,
+    std::map<typename Graph::vertex_descriptor, array<double, 2> >& positionMap,
+    const std::map<typename Graph::edge_descriptor, double>* edgeLengthMap)
+{
+    using vertex_descriptor = typename Graph::vertex_descriptor;
+
+    // Create a vector of vertex descriptors and
+    // a map from vertex descriptors to vertex indices.
+    uint64_t i = 0;
+    vector<vertex_descriptor> vertexVector;
+    std::map<vertex_descriptor, uint64_t> vertexIndexMap;
+    BGL_FORALL_VERTICES_T(v, graph, Graph) {
+        vertexVector.push_back(v);
+        vertexIndexMap.insert(make_pair(v, i++));
+    }
+    const uint64_t vertexCount = i;
+
+    // Gather the edges and their lengths.
+    vector< pair<uint64_t, uint64_t> > edgeVector;
+    vector<double> edgeLengths;
+    BGL_FORALL_EDGES_T(e, graph, Graph) {
+        edgeVector.push_back(make_pair(
+            vertexIndexMap[source(e, graph)],
+            vertexIndexMap[target(e, graph)]));
+        double length = 1.;
+        if(edgeLengthMap) {
+            const auto it = edgeLengthMap->find(e);
+            if(it != edgeLengthMap->end()) {
+                length = it->second;
+            }
+        }
+        edgeLengths.push_back(length);
+    }
+
+    // Compute the layout.
+    vector< array<double, 2> > positions;
+    const ForceDirectedLayout layout(vertexCount, edgeVector, edgeLengths, timeout, 0, positions);
+    if(layout.timeoutTriggered) {
+        return ComputeLayoutReturnCode::Timeout;
+    }
+
+    // Store it in the position map.
+    positionMap.clear();
+    for(uint64_t i=0; i<vertexCount; i++) {
+        positionMap.insert(make_pair(vertexVector[i], positions[i]));
+    }
+    return ComputeLayoutReturnCode::Success;
+}
+
 #endif
 
@@ -1,6 +1,57 @@
 #include "computeRunLengthRepresentation.hpp"
 using namespace shasta;
 
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(Base) == 1, "Unexpected size of class Base.");
+
+
+
+// Run detection is done a block of bases at a time.
+// For each block starting at position i, runEndMask returns a mask
+// with bit j set if p[i+j] != p[i+j+1], that is, if
+// a run ends at position i+j.
+// This accesses p[i] through p[i+runEndBlockSize] included.
+#if defined(__SSE2__)
+
+// SSE2 is always available on x86_64.
+// Compare 16 bases with the 16 bases shifted by one position
+// and extract the result with movemask.
+static const uint64_t runEndBlockSize = 16;
+static inline uint64_t runEndMask(const uint8_t* p)
+{
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    const uint64_t equalMask = uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+    return (~equalMask) & 0xffffULL;
+}
+
+#else
+
+// Portable version working on 8 bases at a time in a 64-bit word.
+static const uint64_t runEndBlockSize = 8;
+static inline uint64_t runEndMask(const uint8_t* p)
+{
+    uint64_t x;
+    uint64_t y;
+    std::memcpy(&x, p, 8);
+    std::memcpy(&y, p + 1, 8);
+    const uint64_t d = x ^ y;
+
+    // Set the high bit of each byte of d that is not zero.
+    const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+    const uint64_t t = (((d & low7) + low7) | d) & ~low7;
+
+    // Gather the high bits of the 8 bytes into the low 8 bits.
+    // This assumes little endian byte order.
+    return ((t >> 7) * 0x0102040810204080ULL) >> 56;
+}
+
+#endif
+
 
 
 // Given the raw representation of a sequence, compute its
@@ -16,30 +67,89 @@ bool shasta::computeRunLengthRepresentation(
     runLengthSequence.clear();
     repeatCount.clear();
 
-    const auto begin = sequence.begin();
-    const auto end = sequence.end();
-
-
+    const uint64_t n = sequence.size();
+    if(n == 0) {
+        return true;
+    }
+    const uint8_t* p = &(sequence.front().value);
 
-    for(auto it=begin; it!=end; ) {
-        const Base base = *it;
-        uint32_t count = 0;
-        while(it!=end && *it==base) {
-            ++it;
-            ++count;
-        }
-        // Do this check outside the above loop
-        // as it will trip very rarely.
+    // Store the run that begins at runBegin and ends at runEnd (included).
+    uint64_t runBegin = 0;
+    auto storeRun = [&](uint64_t runEnd)
+    {
+        const uint64_t count = runEnd + 1 - runBegin;
         if(count >= 256) {
             return false;
         }
-        // SHASTA_ASSERT(count > 0);
-        // SHASTA_ASSERT(count <= 255);
-        runLengthSequence.push_back(base);
+        runLengthSequence.push_back(sequence[runBegin]);
         repeatCount.push_back(uint8_t(count));
+        runBegin = runEnd + 1;
+        return true;
+    };
+
+    // Process blocks of bases.
+    uint64_t i = 0;
+    for(; i + runEndBlockSize < n; i += runEndBlockSize) {
+        uint64_t mask = runEndMask(p + i);
+        while(mask) {
+            if(not storeRun(i + uint64_t(__builtin_ctzll(mask)))) {
+                return false;
+            }
+            mask &= mask - 1;
+        }
     }
 
-    SHASTA_ASSERT(runLengthSequence.size() == runLengthSequence.size());
-    return true;
+    // Scalar tail.
+    for(; i + 1 < n; i++) {
+        if(p[i] != p[i + 1]) {
+            if(not storeRun(i)) {
+                return false;
+            }
+        }
+    }
+
+    // The last run.
+    return storeRun(n - 1);
+}
+
+
+
+// Expand a run-length representation back to raw bases.
+// For speed, each base is written as a block of 16 copies,
+// and the output pointer is then advanced by its repeat count.
+// Repeat counts greater than 16 are rare and
+// handled with additional blocks.
+void shasta::expandRunLengthRepresentation(
+    span<const Base> runLengthSequence,
+    span<const uint8_t> repeatCount,
+    vector<Base>& sequence)
+{
+    SHASTA_ASSERT(runLengthSequence.size() == repeatCount.size());
+    const uint64_t n = runLengthSequence.size();
+
+    uint64_t rawLength = 0;
+    for(uint64_t i=0; i<n; i++) {
+        rawLength += repeatCount[i];
+    }
+
+    // Leave room for the last block.
+    const uint64_t blockSize = 16;
+    sequence.resize(rawLength + blockSize);
+
+    uint8_t* q = &(sequence.front().value);
+    for(uint64_t i=0; i<n; i++) {
+        const uint8_t value = runLengthSequence[i].value;
+        uint64_t count = repeatCount[i];
+        while(true) {
+            std::memset(q, value, blockSize);
+            if(count <= blockSize) {
+                q += count;
+                break;
+            }
+            q += blockSize;
+            count -= blockSize;
+        }
+    }
 
+    sequence.resize(rawLength);
 }
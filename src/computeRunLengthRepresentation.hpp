@@ -2,6 +2,7 @@
 #define SHASTA_COMPUTE_RUN_LENGTH_REPRESENTATION_HPP
 
 #include "Base.hpp"
+#include "span.hpp"
 #include "vector.hpp"
 
 namespace shasta {
@@ -16,6 +17,12 @@ namespace shasta {
         vector<Base>& runLengthSequence,
         vector<uint8_t>& repeatCount);
 
+    // Expand a run-length representation back to raw bases.
+    void expandRunLengthRepresentation(
+        span<const Base> runLengthSequence,
+        span<const uint8_t> repeatCount,
+        vector<Base>& sequence);
+
 }
 
 #endif
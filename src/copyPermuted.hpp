@@ -0,0 +1,51 @@
+#ifndef SHASTA_COPY_PERMUTED_HPP
+#define SHASTA_COPY_PERMUTED_HPP
+
+// Copy a MemoryMapped::VectorOfVectors, permuting its vectors.
+// On return, target[i] is a copy of source[oldIndexes[i]].
+// The target must be open with write access and empty.
+// The sizes of the target vectors are set in a single thread,
+// and the copying is done using threadCount threads
+// (all available hardware threads if threadCount is 0).
+// This is used to renumber reads (see Assembler::renumberReads).
+
+// Shasta.
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "parallelFor.hpp"
+
+// Standard library.
+#include "algorithm.hpp"
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+
+    template<class T, class Int, class Index> void copyPermuted(
+        const MemoryMapped::VectorOfVectors<T, Int>& source,
+        MemoryMapped::VectorOfVectors<T, Int>& target,
+        const vector<Index>& oldIndexes,
+        size_t threadCount)
+    {
+        SHASTA_ASSERT(target.size() == 0);
+        const uint64_t n = oldIndexes.size();
+
+        target.beginPass1(Int(n));
+        for(uint64_t i=0; i<n; i++) {
+            target.incrementCount(Int(i), Int(source.size(oldIndexes[i])));
+        }
+        target.beginPass2();
+        target.endPass2(false);
+
+        parallelFor(n, 1000, threadCount,
+            [&](uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; i++) {
+                    const uint64_t oldIndex = oldIndexes[i];
+                    std::copy(source.begin(oldIndex), source.end(oldIndex), target.begin(i));
+                }
+            });
+    }
+
+}
+
+#endif
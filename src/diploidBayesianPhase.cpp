@@ -1,128 +1,128 @@
 #include "diploidBayesianPhase.hpp"
-#include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
 #include "iostream.hpp"
 #include <cmath>
+#include <limits>
 #include "tuple.hpp"
 
 // See comments in diploidBayesianPhase.hpp for the meaning
 // of the arguments and the return value.
 
 
-static void writeMatrix(const array<array<double, 2>, 2>& m)
+// Under the random hypothesis, the probability that a read
+// is on side side0 of bubble0 and on side side1 of bubble1 is
+// Prandom[side0][side1] = n0[side0] * n1[side1] / n^2, where
+// n0[side0] is the number of common reads on side side0 of bubble0,
+// n1[side1] is the number of common reads on side side1 of bubble1,
+// and n is the total number of common reads.
+// Under the in-phase hypothesis, a fraction epsilon of the reads
+// is distributed as under the random hypothesis, and the rest
+// on the diagonal, proportionally to n0[side0] * n1[side1]:
+// Pin[side0][side1] = epsilon * Prandom[side0][side1] +
+//     (1 - epsilon) * n0[side0] * n1[side1] / (n0[0] * n1[0] + n0[1] * n1[1])
+//     (the second term for side0 == side1 only).
+// So Pin/Prandom is
+// epsilon + (1 - epsilon) * n^2 / (n0[0] * n1[0] + n0[1] * n1[1]) on the diagonal
+// and epsilon off the diagonal.
+// Similarly, Pout/Prandom is
+// epsilon + (1 - epsilon) * n^2 / (n0[0] * n1[1] + n0[1] * n1[0]) off the diagonal
+// and epsilon on the diagonal.
+// This computes the two ratios that are not epsilon.
+// If a marginal count is zero, some of the Prandom are zero,
+// and the results are NaN.
+static void computeRatios(
+    const array<array<uint64_t, 2>, 2>& matrix,
+    double epsilon,
+    double& ratioIn,
+    double& ratioOut)
 {
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            cout << m[side0][side1] << " ";
-        }
-        cout << endl;
+    const double m00 = double(matrix[0][0]);
+    const double m01 = double(matrix[0][1]);
+    const double m10 = double(matrix[1][0]);
+    const double m11 = double(matrix[1][1]);
+    const double n00 = m00 + m01;
+    const double n01 = m10 + m11;
+    const double n10 = m00 + m10;
+    const double n11 = m01 + m11;
+    const double n = n00 + n01;
+
+    if(n00 == 0. or n01 == 0. or n10 == 0. or n11 == 0.) {
+        ratioIn = std::numeric_limits<double>::quiet_NaN();
+        ratioOut = std::numeric_limits<double>::quiet_NaN();
+        return;
     }
 
+    const double n2 = n * n;
+    ratioIn  = epsilon + (1. - epsilon) * n2 / (n00 * n10 + n01 * n11);
+    ratioOut = epsilon + (1. - epsilon) * n2 / (n00 * n11 + n01 * n10);
 }
 
 
+
+// Combine the logarithms of the ratios into log(Pin/Prandom) and log(Pout/Prandom) in dB.
+static pair<double, double> combineLogRatios(
+    const array<array<uint64_t, 2>, 2>& matrix,
+    double log10Epsilon,
+    double log10RatioIn,
+    double log10RatioOut)
+{
+    const double m00 = double(matrix[0][0]);
+    const double m01 = double(matrix[0][1]);
+    const double m10 = double(matrix[1][0]);
+    const double m11 = double(matrix[1][1]);
+
+    // Each matrix element is multiplied separately, so an empty cell
+    // multiplied by an infinite logarithm (epsilon = 0) gives NaN,
+    // as in a direct evaluation of the sum over the four cells.
+    const double logPin = 10. *
+        ((m00 * log10RatioIn + m11 * log10RatioIn) + (m01 * log10Epsilon + m10 * log10Epsilon));
+    const double logPout = 10. *
+        ((m01 * log10RatioOut + m10 * log10RatioOut) + (m00 * log10Epsilon + m11 * log10Epsilon));
+    return make_pair(logPin, logPout);
+}
+
+
+
 pair<double, double> shasta::diploidBayesianPhase(
     const array<array<uint64_t, 2>, 2>& matrix,
     double epsilon)
 {
-    const bool debug = false;
-
-    // Construct a version of the matrix containing doubles,
-    // so we don't need to keep converting.
-    array<array<double, 2>, 2> m;
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            m[side0][side1] = double(matrix[side0][side1]);
-        }
-    }
-
-    // Contract the matrix over side1 to compute n0.
-    // n0[side0] is the number of common reads seen on
-    // side side0 of bubble0 regardless of where they are on bubble1.
-    array<double, 2> n0;
-    for(uint64_t side0=0; side0<2; side0++) {
-        n0[side0] = 0.;
-        for(uint64_t side1=0; side1<2; side1++) {
-            n0[side0] += m[side0][side1];
-        }
-    }
+    double ratioIn, ratioOut;
+    computeRatios(matrix, epsilon, ratioIn, ratioOut);
+    return combineLogRatios(matrix, std::log10(epsilon), std::log10(ratioIn), std::log10(ratioOut));
+}
 
-    // Contract the matrix over side0 to compute n1.
-    // n1[side1] is the number of common reads seen on
-    // side side1 of bubble1 regardless of where they are on bubble0.
-    array<double, 2> n1;
-    for(uint64_t side1=0; side1<2; side1++) {
-        n1[side1] = 0.;
-        for(uint64_t side0=0; side0<2; side0++) {
-            n1[side1] += m[side0][side1];
-        }
-    }
 
-    // Compute the total number of common reads, n.
-    const double n = n0[0] + n0[1];
-    SHASTA_ASSERT(n == n1[0] + n1[1]);
-    const double nm2 = 1. / (n * n);
-
-    // Compute Prandom[side0][side1], the probability that a
-    // read is on side side0 of bubble0 and on side side1 of bubble1
-    // under the random hypothesis.
-    array<array<double, 2>, 2> Prandom;
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            Prandom[side0][side1] = nm2 * n0[side0] * n1[side1];
-        }
-    }
 
-    // Compute Pin[side0][side1], the probability that a
-    // read is on side side0 of bubble0 and on side side1 of bubble1
-    // under the in phase hypothesis.
-    array<array<double, 2>, 2> Pin;
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            Pin[side0][side1] = epsilon * Prandom[side0][side1];
-        }
+void shasta::diploidBayesianPhase(
+    const vector< array<array<uint64_t, 2>, 2> >& matrices,
+    double epsilon,
+    vector<double>& logPin,
+    vector<double>& logPout)
+{
+    const uint64_t n = matrices.size();
+    logPin.resize(n);
+    logPout.resize(n);
+    const double log10Epsilon = std::log10(epsilon);
+
+    // Store the ratios in logPin and logPout, then take the logarithms
+    // in place in simple loops.
+    for(uint64_t i=0; i<n; i++) {
+        computeRatios(matrices[i], epsilon, logPin[i], logPout[i]);
     }
-    const double factorIn = (1. - epsilon) / (n0[0] * n1[0] + n0[1] * n1[1]);
-    Pin[0][0] += factorIn * (n0[0] * n1[0]);
-    Pin[1][1] += factorIn * (n0[1] * n1[1]);
-
-    // Compute Pout[side0][side1], the probability that a
-    // read is on side side0 of bubble0 and on side side1 of bubble1
-    // under the out of phase hypothesis.
-    array<array<double, 2>, 2> Pout;
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            Pout[side0][side1] = epsilon * Prandom[side0][side1];
-        }
+    double* pIn = logPin.data();
+    double* pOut = logPout.data();
+    for(uint64_t i=0; i<n; i++) {
+        pIn[i] = std::log10(pIn[i]);
     }
-    const double factorOut = (1. - epsilon) / (n0[0] * n1[1] + n0[1] * n1[0]);
-    Pout[0][1] += factorOut * (n0[0] * n1[1]);
-    Pout[1][0] += factorOut * (n0[1] * n1[0]);
-
-    if(debug) {
-        cout << "Prandom" << endl;
-        writeMatrix(Prandom);
-        cout << "Pin" << endl;
-        writeMatrix(Pin);
-        cout << "Pout" << endl;
-        writeMatrix(Pout);
+    for(uint64_t i=0; i<n; i++) {
+        pOut[i] = std::log10(pOut[i]);
     }
 
-
-
-    // Now compute probability ratios, conditional to the observed
-    // distribution of reads.
-    double logPin = 0.;
-    double logPout = 0.;
-    for(uint64_t side0=0; side0<2; side0++) {
-        for(uint64_t side1=0; side1<2; side1++) {
-            logPin += m[side0][side1] * 10. * std::log10(Pin[side0][side1] / Prandom[side0][side1]);
-            logPout += m[side0][side1] * 10. * std::log10(Pout[side0][side1] / Prandom[side0][side1]);
-        }
+    for(uint64_t i=0; i<n; i++) {
+        tie(logPin[i], logPout[i]) = combineLogRatios(matrices[i], log10Epsilon, logPin[i], logPout[i]);
     }
-
-    return make_pair(logPin, logPout);
 }
 
 
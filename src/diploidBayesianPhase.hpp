@@ -4,6 +4,7 @@
 #include "array.hpp"
 #include "cstdint.hpp"
 #include "utility.hpp"
+#include "vector.hpp"
 
 /*******************************************************************************
 
@@ -44,6 +45,14 @@ three hypotheses).
 
 On exit, diploidBayesianPhase returns a pair containing
 log(Pin/Prandom) and log(Pout/Prandom) expressed in decibels (dB).
+If any of the four marginal counts is zero, both are NaN.
+
+The batch version evaluates many matrices at once.
+It stores the results in two separate vectors
+and does the logarithms in separate loops,
+which allows the compiler to vectorize them.
+It gives the same results as calling diploidBayesianPhase
+for each matrix.
 
 *******************************************************************************/
 
@@ -55,6 +64,13 @@ namespace shasta {
         double epsilon
     );
 
+    void diploidBayesianPhase(
+        const vector< array<array<uint64_t, 2>, 2> >& matrices,
+        double epsilon,
+        vector<double>& logPin,
+        vector<double>& logPout
+    );
+
     void testDiploidBayesianPhase(
         double epsilon,
         uint64_t m00,
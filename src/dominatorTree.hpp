@@ -30,10 +30,28 @@ includes the following comment about initializing dfnum/dfnumMap:
 The above fix implements this requirement.
 The fixed version below works correctly even if the graph contains unreachable vertices.
 
+This also provides shasta::cooper_harvey_kennedy_dominator_tree,
+with the same interface and results. It uses the iterative algorithm described in
+Keith D. Cooper, Timothy J. Harvey, and Ken Kennedy,
+A Simple, Fast Dominance Algorithm,
+Software Practice and Experience 4, 1-10 (2001).
+It uses an explicit stack for the depth first search,
+so it does not use recursion, and does all the work
+on vectors indexed by reverse postorder number. This is
+usually faster than the Lengauer-Tarjan algorithm,
+and scales to large graphs.
+
 *******************************************************************************/
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/dominator_tree.hpp>
+#include <boost/graph/iteration_macros.hpp>
+
+#include "algorithm.hpp"
+#include "cstdint.hpp"
+#include <limits>
+#include "tuple.hpp"
+#include "vector.hpp"
 
 namespace shasta {
 
@@ -78,6 +96,119 @@ namespace shasta {
             parentMap, verticesByDFNum, domTreePredMap);
     }
 
+
+
+    // On return, domTreePredMap contains the immediate dominator
+    // of each vertex reachable from the entry, except the entry itself.
+    // Other vertices are not stored in domTreePredMap.
+    template<class Graph, class DomTreePredMap>
+    void cooper_harvey_kennedy_dominator_tree(const Graph &g,
+        const typename boost::graph_traits<Graph>::vertex_descriptor &entry,
+        DomTreePredMap domTreePredMap)
+    {
+        using namespace boost;
+        using Vertex = typename graph_traits<Graph>::vertex_descriptor;
+        using OutEdgeIterator = typename graph_traits<Graph>::out_edge_iterator;
+
+        const uint64_t n = num_vertices(g);
+        if(n == 0) {
+            return;
+        }
+        const auto indexMap = get(vertex_index, g);
+        const uint64_t unreached = std::numeric_limits<uint64_t>::max();
+
+        // Iterative depth first search from the entry, to compute
+        // the vertices reachable from the entry in postorder.
+        vector<Vertex> sortedVertices;
+        vector<bool> wasVisited(n, false);
+        vector< tuple<Vertex, OutEdgeIterator, OutEdgeIterator> > stack;
+        wasVisited[get(indexMap, entry)] = true;
+        OutEdgeIterator begin, end;
+        tie(begin, end) = out_edges(entry, g);
+        stack.push_back({entry, begin, end});
+        while(not stack.empty()) {
+            auto& top = stack.back();
+            if(get<1>(top) == get<2>(top)) {
+                sortedVertices.push_back(get<0>(top));
+                stack.pop_back();
+                continue;
+            }
+            const Vertex v = target(*get<1>(top)++, g);
+            if(not wasVisited[get(indexMap, v)]) {
+                wasVisited[get(indexMap, v)] = true;
+                tie(begin, end) = out_edges(v, g);
+                stack.push_back({v, begin, end});
+            }
+        }
+
+        // Switch to reverse postorder. The entry is at position 0.
+        std::reverse(sortedVertices.begin(), sortedVertices.end());
+        const uint64_t m = sortedVertices.size();
+        vector<uint64_t> order(n, unreached);
+        for(uint64_t i=0; i<m; i++) {
+            order[get(indexMap, sortedVertices[i])] = i;
+        }
+
+        // Store the reachable predecessors of each reachable vertex,
+        // in compressed sparse row format, indexed by reverse postorder.
+        vector<uint64_t> predecessorsBegin(m + 1);
+        vector<uint64_t> predecessors;
+        for(uint64_t i=0; i<m; i++) {
+            predecessorsBegin[i] = predecessors.size();
+            BGL_FORALL_INEDGES_T(sortedVertices[i], e, g, Graph) {
+                const uint64_t j = order[get(indexMap, source(e, g))];
+                if(j != unreached) {
+                    predecessors.push_back(j);
+                }
+            }
+        }
+        predecessorsBegin[m] = predecessors.size();
+
+        // Iterate to convergence. Because vertices are processed in reverse postorder,
+        // this normally takes very few iterations.
+        vector<uint64_t> immediateDominator(m, unreached);
+        immediateDominator[0] = 0;
+        auto intersect = [&immediateDominator](uint64_t i, uint64_t j)
+        {
+            while(i != j) {
+                while(i > j) {
+                    i = immediateDominator[i];
+                }
+                while(j > i) {
+                    j = immediateDominator[j];
+                }
+            }
+            return i;
+        };
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            for(uint64_t i=1; i<m; i++) {
+                uint64_t newImmediateDominator = unreached;
+                for(uint64_t k=predecessorsBegin[i]; k!=predecessorsBegin[i+1]; k++) {
+                    const uint64_t j = predecessors[k];
+                    if(immediateDominator[j] == unreached) {
+                        continue;
+                    }
+                    if(newImmediateDominator == unreached) {
+                        newImmediateDominator = j;
+                    } else {
+                        newImmediateDominator = intersect(j, newImmediateDominator);
+                    }
+                }
+                if(immediateDominator[i] != newImmediateDominator) {
+                    immediateDominator[i] = newImmediateDominator;
+                    changed = true;
+                }
+            }
+        }
+
+        // Store the results.
+        for(uint64_t i=1; i<m; i++) {
+            put(domTreePredMap, sortedVertices[i], sortedVertices[immediateDominator[i]]);
+        }
+    }
+
 }
 
 #endif
@@ -1,6 +1,7 @@
 #if !defined(__DSET64_GCC_ATOMIC_HPP)
 #define __DSET64_GCC_ATOMIC_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <stdexcept>
 
@@ -91,9 +92,18 @@ public:
 
     // For memory allocation flexibility, the memory is allocated
     // and owned by the caller.
-    DisjointSets(Aint* mData, Uint size) : mData(mData), n(size), parentUpdated(0) {
-        for (Uint i=0; i<size; ++i)
-            mData[i] = Aint(i);
+    // If initialize is false, the caller is responsible for
+    // calling initialize(i) for all i before using the DisjointSets.
+    // This allows the initialization to be done using multiple threads.
+    DisjointSets(Aint* mData, Uint size, bool initialize = true) : mData(mData), n(size), parentUpdated(0) {
+        if (initialize) {
+            for (Uint i=0; i<size; ++i)
+                mData[i] = Aint(i);
+        }
+    }
+
+    void initialize(Uint id) {
+        mData[id] = Aint(id);
     }
 
 
@@ -176,6 +186,48 @@ public:
         return id2;
     }
 
+    // Batched version of unite, for a range of pairs of item ids
+    // (any random access iterator to objects with members first and second).
+    // While processing a pair, this prefetches the entries of the items of pairs
+    // further ahead, and the entries of their parents for pairs a bit closer, so the
+    // memory latency of find is mostly hidden. Consecutive pairs that share an item
+    // are coalesced: the next find starts from the root returned by the previous unite,
+    // which is in the same set, instead of starting again from the item.
+    // Note that find already uses path halving.
+    template<class Iterator> void uniteBatch(Iterator begin, Iterator end) {
+        const std::ptrdiff_t itemPrefetchDistance = 16;
+        const std::ptrdiff_t parentPrefetchDistance = 8;
+        const std::ptrdiff_t count = end - begin;
+
+        Uint previousId1 = n;
+        Uint previousId2 = n;
+        Uint previousRoot = n;
+        for (std::ptrdiff_t i=0; i<count; ++i) {
+            if (i + itemPrefetchDistance < count) {
+                const auto& p = begin[i + itemPrefetchDistance];
+                __builtin_prefetch(&mData[p.first]);
+                __builtin_prefetch(&mData[p.second]);
+            }
+            if (i + parentPrefetchDistance < count) {
+                const auto& p = begin[i + parentPrefetchDistance];
+                __builtin_prefetch(&mData[parent(p.first)]);
+                __builtin_prefetch(&mData[parent(p.second)]);
+            }
+
+            const auto& p = begin[i];
+            Uint id1 = p.first;
+            Uint id2 = p.second;
+            if (id1 == previousId1 || id1 == previousId2) {
+                id1 = previousRoot;
+            } else if (id2 == previousId1 || id2 == previousId2) {
+                id2 = previousRoot;
+            }
+            previousRoot = unite(id1, id2);
+            previousId1 = p.first;
+            previousId2 = p.second;
+        }
+    }
+
     Uint size() const { return n; }
 
     Uint rank(Uint id) const {
@@ -155,6 +155,30 @@ Dset64Test::Dset64Test(
     SHASTA_ASSERT(sortedComponentsParallel == sortedComponentsBoost);
 
 
+
+    // Now, do it using the batched version of unite, using the specified number of threads.
+    vector< vector<uint64_t> > sortedComponentsParallelBatched;
+    {
+        using Aint = DisjointSets::Aint;
+        vector<Aint> data(n);
+        DisjointSets disjointSets(&data.front(), n);
+        disjointSetsPointer = &disjointSets;
+        const auto t0 = std::chrono::steady_clock::now();
+        setupLoadBalancing(edges.size(), batchSize);
+        runThreads(&Dset64Test::threadFunctionBatched, threadCount);
+        const auto t1 = std::chrono::steady_clock::now();
+        cout << "Parallel batched dset64 ran in " << seconds(t1-t0) << "s." << endl;
+
+        // Gather the components.
+        std::map<uint64_t, vector<uint64_t> > componentTable;
+        for(uint64_t i=0; i<n; i++) {
+            componentTable[disjointSets.find(i)].push_back(i);
+        }
+        getSortedComponents(componentTable, sortedComponentsParallelBatched);
+    }
+    SHASTA_ASSERT(sortedComponentsParallelBatched == sortedComponentsBoost);
+
+
     cout << "No error found. All algorithms found " << sortedComponentsBoost.size();
     cout << " identical connected components." << endl;
 }
@@ -178,6 +202,17 @@ void Dset64Test::threadFunction(size_t threadId)
 
 
 
+void Dset64Test::threadFunctionBatched(size_t threadId)
+{
+    uint64_t begin;
+    uint64_t end;
+    while(getNextBatch(begin, end)) {
+        disjointSetsPointer->uniteBatch(edges.begin() + begin, edges.begin() + end);
+    }
+}
+
+
+
 void Dset64Test::getSortedComponents(
     const std::map<uint64_t, vector<uint64_t> >& componentTable,
     vector< vector<uint64_t> >& sortedComponents
@@ -44,6 +44,7 @@ private:
 
     DisjointSets* disjointSetsPointer;
     void threadFunction(size_t threadId);
+    void threadFunctionBatched(size_t threadId);
 };
 
 #endif
@@ -6,6 +6,9 @@
 
 #include "algorithm.hpp"
 #include "iostream.hpp"
+#include <limits>
+#include <map>
+#include <set>
 #include <stack>
 #include "tuple.hpp"
 #include "utility.hpp"
@@ -17,17 +20,13 @@ namespace shasta {
         typename G::vertex_descriptor vA, typename G::vertex_descriptor vB,
         vector<vector<typename G::edge_descriptor> > &paths);
 
+    // These use an explicit stack rather than recursion,
+    // so deep graphs cannot overflow the call stack.
     template<class G, class PathInspector> void enumeratePaths(
         const G&,
         typename G::vertex_descriptor v,
         uint64_t pathLength,
         PathInspector&);
-    template<class G, class PathInspector> void enumeratePathsRecursive(
-        const G&,
-        typename G::vertex_descriptor v,
-        uint64_t pathLength,
-        PathInspector&,
-        vector<typename G::edge_descriptor>& path);
 
     // Same, but in the reverse direction (backward paths).
     template<class G, class PathInspector> void enumeratePathsReverse(
@@ -35,12 +34,6 @@ namespace shasta {
         typename G::vertex_descriptor v,
         uint64_t pathLength,
         PathInspector&);
-    template<class G, class PathInspector> void enumeratePathsReverseRecursive(
-        const G&,
-        typename G::vertex_descriptor v,
-        uint64_t pathLength,
-        PathInspector&,
-        vector<typename G::edge_descriptor>& path);
 
     // Similar to the above, but for paths of any length beginning at vA and ending at vB.
     template<class G, class PathInspector> void enumeratePathsBetween(
@@ -48,12 +41,36 @@ namespace shasta {
         typename G::vertex_descriptor vA,
         typename G::vertex_descriptor vB,
         PathInspector&);
-    template<class G, class PathInspector> void enumeratePathsBetweenRecursive(
+
+    // Find the vertices that are on at least one path from vA to vB,
+    // in topological order. Returns false if there is a cycle among those vertices.
+    template<class G> bool topologicalSortBetween(
         const G&,
         typename G::vertex_descriptor vA,
         typename G::vertex_descriptor vB,
-        PathInspector&,
-        vector<typename G::edge_descriptor>& path);
+        vector<typename G::vertex_descriptor>&);
+
+    // Count the paths from vA to vB without enumerating them.
+    // Counting stops at maxPathCount + 1.
+    // Returns false if the paths cannot be counted because
+    // there is a cycle among the vertices between vA and vB.
+    template<class G> bool countPathsBetween(
+        const G&,
+        typename G::vertex_descriptor vA,
+        typename G::vertex_descriptor vB,
+        uint64_t maxPathCount,
+        uint64_t& pathCount);
+
+    // Find the k best paths from vA to vB, without enumerating all paths.
+    // Returns false if there is a cycle among the vertices between vA and vB.
+    // See the definition below for the requirements on the Scorer.
+    template<class G, class Scorer> bool findBestPathsBetween(
+        const G&,
+        typename G::vertex_descriptor vA,
+        typename G::vertex_descriptor vB,
+        uint64_t k,
+        const Scorer&,
+        vector< vector<typename G::edge_descriptor> >& bestPaths);
 
 
     void testEnumeratePaths();
@@ -132,24 +149,34 @@ template<class G, class PathInspector> void shasta::enumeratePaths(
     uint64_t maxPathLength,
     PathInspector& pathInspector)
 {
-    vector<typename G::edge_descriptor> path;
-    enumeratePathsRecursive(g, v, maxPathLength, pathInspector, path);
-}
-template<class G, class PathInspector> void shasta::enumeratePathsRecursive(
-    const G& g,
-    typename G::vertex_descriptor v,
-    uint64_t maxPathLength,
-    PathInspector& pathInspector,
-    vector<typename G::edge_descriptor>& path)
-{
+    using out_edge_iterator = typename G::out_edge_iterator;
     if(maxPathLength == 0) {
         return;
     }
-    BGL_FORALL_OUTEDGES_T(v, e, g, G) {
+
+    // The stack contains the out-edges still to be visited
+    // at each vertex of the current path.
+    vector<typename G::edge_descriptor> path;
+    vector< pair<out_edge_iterator, out_edge_iterator> > stack;
+    stack.push_back(out_edges(v, g));
+    while(not stack.empty()) {
+        pair<out_edge_iterator, out_edge_iterator>& p = stack.back();
+        if(p.first == p.second) {
+            stack.pop_back();
+            if(not path.empty()) {
+                path.pop_back();
+            }
+            continue;
+        }
+        const typename G::edge_descriptor e = *p.first;
+        ++p.first;
         path.push_back(e);
         pathInspector(path);
-        enumeratePathsRecursive(g, target(e, g), maxPathLength - 1, pathInspector, path);
-        path.pop_back();
+        if(path.size() < maxPathLength) {
+            stack.push_back(out_edges(target(e, g), g));
+        } else {
+            path.pop_back();
+        }
     }
 }
 
@@ -161,24 +188,32 @@ template<class G, class PathInspector> void shasta::enumeratePathsReverse(
     uint64_t maxPathLength,
     PathInspector& pathInspector)
 {
-    vector<typename G::edge_descriptor> path;
-    enumeratePathsReverseRecursive(g, v, maxPathLength, pathInspector, path);
-}
-template<class G, class PathInspector> void shasta::enumeratePathsReverseRecursive(
-    const G& g,
-    typename G::vertex_descriptor v,
-    uint64_t maxPathLength,
-    PathInspector& pathInspector,
-    vector<typename G::edge_descriptor>& path)
-{
+    using in_edge_iterator = typename G::in_edge_iterator;
     if(maxPathLength == 0) {
         return;
     }
-    BGL_FORALL_INEDGES_T(v, e, g, G) {
+
+    vector<typename G::edge_descriptor> path;
+    vector< pair<in_edge_iterator, in_edge_iterator> > stack;
+    stack.push_back(in_edges(v, g));
+    while(not stack.empty()) {
+        pair<in_edge_iterator, in_edge_iterator>& p = stack.back();
+        if(p.first == p.second) {
+            stack.pop_back();
+            if(not path.empty()) {
+                path.pop_back();
+            }
+            continue;
+        }
+        const typename G::edge_descriptor e = *p.first;
+        ++p.first;
         path.push_back(e);
         pathInspector(path);
-        enumeratePathsReverseRecursive(g, source(e, g), maxPathLength - 1, pathInspector, path);
-        path.pop_back();
+        if(path.size() < maxPathLength) {
+            stack.push_back(in_edges(source(e, g), g));
+        } else {
+            path.pop_back();
+        }
     }
 }
 
@@ -187,32 +222,330 @@ template<class G, class PathInspector> void shasta::enumeratePathsReverseRecursi
 // enumerate all paths of any length starting at vA ending at vB.
 // For each path found, apply the given function object by calling
 // functionObject(path), where path is a vector<G::edge_descriptor>
+// Out-edges leading to vertices from which vB cannot be reached are skipped,
+// so the work is proportional to the number and length of the paths found.
 template<class G, class PathInspector> void shasta::enumeratePathsBetween(
     const G& g,
     typename G::vertex_descriptor vA,
     typename G::vertex_descriptor vB,
     PathInspector& pathInspector)
 {
+    using vertex_descriptor = typename G::vertex_descriptor;
+    using out_edge_iterator = typename G::out_edge_iterator;
+
+    // Find the vertices from which vB can be reached.
+    std::set<vertex_descriptor> canReachB;
+    vector<vertex_descriptor> queue(1, vB);
+    canReachB.insert(vB);
+    while(not queue.empty()) {
+        const vertex_descriptor v1 = queue.back();
+        queue.pop_back();
+        BGL_FORALL_INEDGES_T(v1, e, g, G) {
+            const vertex_descriptor v0 = source(e, g);
+            if(canReachB.insert(v0).second) {
+                queue.push_back(v0);
+            }
+        }
+    }
+
     vector<typename G::edge_descriptor> path;
-    enumeratePathsBetweenRecursive(g, vA, vB, pathInspector, path);
+    vector< pair<out_edge_iterator, out_edge_iterator> > stack;
+    stack.push_back(out_edges(vA, g));
+    while(not stack.empty()) {
+        pair<out_edge_iterator, out_edge_iterator>& p = stack.back();
+        if(p.first == p.second) {
+            stack.pop_back();
+            if(not path.empty()) {
+                path.pop_back();
+            }
+            continue;
+        }
+        const typename G::edge_descriptor e = *p.first;
+        ++p.first;
+        const vertex_descriptor vC = target(e, g);
+        if(not canReachB.contains(vC)) {
+            continue;
+        }
+        path.push_back(e);
+        if(vC == vB) {
+            pathInspector(path);
+            path.pop_back();
+        } else {
+            stack.push_back(out_edges(vC, g));
+        }
+    }
 }
-template<class G, class PathInspector> void shasta::enumeratePathsBetweenRecursive(
+
+
+
+// Find the vertices that are on at least one path from vA to vB,
+// in topological order. The first vertex is vA and the last vertex is vB.
+// If vB cannot be reached from vA, the vector is returned empty.
+// Returns false if there is a cycle among those vertices.
+template<class G> bool shasta::topologicalSortBetween(
     const G& g,
     typename G::vertex_descriptor vA,
     typename G::vertex_descriptor vB,
-    PathInspector& pathInspector,
-    vector<typename G::edge_descriptor>& path)
+    vector<typename G::vertex_descriptor>& order)
 {
-    BGL_FORALL_OUTEDGES_T(vA, e, g, G) {
-        path.push_back(e);
-        typename G::vertex_descriptor vC = target(e, g);
-        if(vC == vB) {
-            pathInspector(path);
-        } else {
-            enumeratePathsBetweenRecursive(g, vC, vB, pathInspector, path);
+    using vertex_descriptor = typename G::vertex_descriptor;
+    using out_edge_iterator = typename G::out_edge_iterator;
+    order.clear();
+
+    // Iterative depth first search from vA, which does not go past vB.
+    // Vertices are added to the order, in reverse, when they are finished,
+    // if they can reach vB. An edge to a vertex that is still
+    // on the stack is a back edge, which means there is a cycle.
+    enum class Color {gray, black};
+    std::map<vertex_descriptor, Color> color;
+    std::set<vertex_descriptor> canReachB;
+    vector< tuple<vertex_descriptor, out_edge_iterator, out_edge_iterator> > stack;
+    color.insert({vA, Color::gray});
+    if(vA == vB) {
+        order.push_back(vA);
+        return true;
+    }
+    {
+        out_edge_iterator begin, end;
+        tie(begin, end) = out_edges(vA, g);
+        stack.push_back({vA, begin, end});
+    }
+    while(not stack.empty()) {
+        auto& [v0, it, end] = stack.back();
+        if(it == end) {
+            const vertex_descriptor v = v0;
+            color[v] = Color::black;
+            stack.pop_back();
+            if(canReachB.contains(v)) {
+                order.push_back(v);
+                if(not stack.empty()) {
+                    canReachB.insert(get<0>(stack.back()));
+                }
+            }
+            continue;
+        }
+        const vertex_descriptor v1 = target(*it, g);
+        ++it;
+
+        if(v1 == vB) {
+            canReachB.insert(v0);
+            if(not color.contains(vB)) {
+                color.insert({vB, Color::black});
+                canReachB.insert(vB);
+                order.push_back(vB);
+            }
+            continue;
+        }
+
+        const auto jt = color.find(v1);
+        if(jt == color.end()) {
+            color.insert({v1, Color::gray});
+            out_edge_iterator begin1, end1;
+            tie(begin1, end1) = out_edges(v1, g);
+            stack.push_back({v1, begin1, end1});
+        } else if(jt->second == Color::gray) {
+            // Back edge. The cycle may not be on a path to vB,
+            // but we don't know that yet, so report it anyway.
+            order.clear();
+            return false;
+        } else if(canReachB.contains(v1)) {
+            canReachB.insert(v0);
+        }
+    }
+
+    if(not canReachB.contains(vA)) {
+        order.clear();
+        return true;
+    }
+    reverse(order.begin(), order.end());
+    return true;
+}
+
+
+
+// Count the paths from vA to vB using dynamic programming
+// on the vertices in topological order.
+template<class G> bool shasta::countPathsBetween(
+    const G& g,
+    typename G::vertex_descriptor vA,
+    typename G::vertex_descriptor vB,
+    uint64_t maxPathCount,
+    uint64_t& pathCount)
+{
+    using vertex_descriptor = typename G::vertex_descriptor;
+
+    pathCount = 0;
+    vector<vertex_descriptor> order;
+    if(not topologicalSortBetween(g, vA, vB, order)) {
+        return false;
+    }
+    if(order.empty()) {
+        return true;
+    }
+
+    // The number of paths from vA to each vertex, saturated at maxPathCount + 1.
+    std::map<vertex_descriptor, uint64_t> count;
+    for(const vertex_descriptor v: order) {
+        count.insert({v, 0});
+    }
+    count[vA] = 1;
+    for(const vertex_descriptor v0: order) {
+        const uint64_t count0 = count[v0];
+        if(v0 == vB) {
+            break;
+        }
+        BGL_FORALL_OUTEDGES_T(v0, e, g, G) {
+            const auto it = count.find(target(e, g));
+            if(it != count.end()) {
+                it->second = min(maxPathCount + 1, it->second + count0);
+            }
+        }
+    }
+    pathCount = count[vB];
+    return true;
+}
+
+
+
+// Find the k best paths from vA to vB.
+// The vertices between vA and vB are processed in topological order,
+// and each of them stores the partial paths from vA that reached it.
+// A partial path is discarded as soon as k other partial paths
+// ending at the same vertex dominate it. This is exact
+// and avoids enumerating all paths, as long as the Scorer is consistent.
+//
+// The Scorer must provide:
+// - A type Score.
+// - Score initialScore() const: the score of an empty path.
+// - Score extend(const Score&, edge_descriptor) const:
+//   the score of a path extended by one edge.
+// - bool isBetter(const Score& x, const Score& y) const:
+//   true if a path with score x is better than a path with score y.
+// - bool dominates(const Score& x, const Score& y) const:
+//   true if, for two partial paths ending at the same vertex with scores x and y,
+//   any extension of the path with score y is not better
+//   than the same extension of the path with score x.
+//
+// On return, bestPaths contains up to k paths, best first.
+template<class G, class Scorer> bool shasta::findBestPathsBetween(
+    const G& g,
+    typename G::vertex_descriptor vA,
+    typename G::vertex_descriptor vB,
+    uint64_t k,
+    const Scorer& scorer,
+    vector< vector<typename G::edge_descriptor> >& bestPaths)
+{
+    using vertex_descriptor = typename G::vertex_descriptor;
+    using edge_descriptor = typename G::edge_descriptor;
+    using Score = typename Scorer::Score;
+
+    bestPaths.clear();
+    vector<vertex_descriptor> order;
+    if(not topologicalSortBetween(g, vA, vB, order)) {
+        return false;
+    }
+    if(order.empty() or k == 0 or vA == vB) {
+        return true;
+    }
+
+    // A partial path is stored as its last edge and the partial path it extends.
+    // Partial paths are never removed from this vector,
+    // so their indexes remain valid.
+    class PartialPath {
+    public:
+        Score score;
+        uint64_t previous;
+        edge_descriptor e;
+    };
+    const uint64_t noPrevious = std::numeric_limits<uint64_t>::max();
+    vector<PartialPath> partialPaths;
+
+    // The partial paths currently stored at each vertex.
+    std::map<vertex_descriptor, vector<uint64_t> > vertexPartialPaths;
+    for(const vertex_descriptor v: order) {
+        vertexPartialPaths.insert({v, {}});
+    }
+    partialPaths.push_back({scorer.initialScore(), noPrevious, edge_descriptor()});
+    vertexPartialPaths[vA].push_back(0);
+
+    // Return the number of partial paths in a vector that dominate a given score.
+    // The partial path to be skipped, if any, is not counted.
+    const auto dominatorCount = [&](
+        const vector<uint64_t>& v, const Score& score, uint64_t skip)
+    {
+        uint64_t n = 0;
+        for(const uint64_t i: v) {
+            if(i != skip and scorer.dominates(partialPaths[i].score, score)) {
+                ++n;
+            }
+        }
+        return n;
+    };
+
+    for(const vertex_descriptor v0: order) {
+        if(v0 == vB) {
+            break;
+        }
+        // The partial paths at v0 don't change while we extend them,
+        // because the graph between vA and vB is acyclic.
+        const vector<uint64_t>& partialPaths0 = vertexPartialPaths[v0];
+        BGL_FORALL_OUTEDGES_T(v0, e, g, G) {
+            const auto it = vertexPartialPaths.find(target(e, g));
+            if(it == vertexPartialPaths.end()) {
+                continue;
+            }
+            vector<uint64_t>& partialPaths1 = it->second;
+
+            for(const uint64_t i0: partialPaths0) {
+                const Score score = scorer.extend(partialPaths[i0].score, e);
+
+                // If this partial path is dominated by k others, discard it.
+                if(dominatorCount(partialPaths1, score, noPrevious) >= k) {
+                    continue;
+                }
+
+                // Store it.
+                const uint64_t i1 = partialPaths.size();
+                partialPaths.push_back({score, i0, e});
+                partialPaths1.push_back(i1);
+
+                // Remove partial paths that are now dominated by k others.
+                for(uint64_t j=0; j<partialPaths1.size(); ) {
+                    const uint64_t i = partialPaths1[j];
+                    if(i != i1 and dominatorCount(partialPaths1, partialPaths[i].score, i) >= k) {
+                        partialPaths1.erase(partialPaths1.begin() + j);
+                    } else {
+                        ++j;
+                    }
+                }
+            }
+        }
+
+        // The partial paths ending here are no longer needed.
+        vertexPartialPaths[v0].clear();
+    }
+
+    // Sort the complete paths, best first, and keep the best k.
+    vector<uint64_t> completePaths = vertexPartialPaths[vB];
+    sort(completePaths.begin(), completePaths.end(),
+        [&](uint64_t i, uint64_t j)
+        {
+            return scorer.isBetter(partialPaths[i].score, partialPaths[j].score);
+        });
+    if(completePaths.size() > k) {
+        completePaths.resize(k);
+    }
+
+    // Reconstruct the paths.
+    for(uint64_t i: completePaths) {
+        vector<edge_descriptor> path;
+        for(; partialPaths[i].previous != noPrevious; i = partialPaths[i].previous) {
+            path.push_back(partialPaths[i].e);
         }
-        path.pop_back();
+        reverse(path.begin(), path.end());
+        bestPaths.push_back(path);
     }
+    return true;
 }
 
 #endif
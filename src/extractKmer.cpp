@@ -57,6 +57,35 @@ template<class Int> inline void shasta::extractBits(
 
 
 
+// Extract a k-mer without going through extractBits.
+// The two words of the block containing the first base of the k-mer
+// are combined with the two words of the next block (if any)
+// using a funnel shift, which puts the first base of the k-mer in
+// the most significant bit. There are no data dependent branches,
+// which is important when this is called in a loop by extractKmers.
+template<class Int> inline void extractKmerInline(
+    const LongBaseSequenceView& v,
+    uint64_t position,
+    uint64_t length,
+    ShortBaseSequence<Int>& s)
+{
+    const uint64_t i0 = (position >> 6) << 1;
+    const uint64_t shift = position & 63;
+    const bool hasNextBlock = (i0 + 2 < LongBaseSequenceView::wordCount(v.baseCount));
+
+    // Mask for the first length bits, counting from the MSB.
+    const uint64_t mask = (length == 0) ? 0 : (~0ULL << (64 - length));
+
+    for(uint64_t bit=0; bit<2; bit++) {
+        const uint64_t w0 = v.begin[i0 + bit];
+        const uint64_t w1 = hasNextBlock ? v.begin[i0 + 2 + bit] : 0;
+        const uint64_t w = (shift == 0) ? w0 : ((w0 << shift) | (w1 >> (64 - shift)));
+        s.data[bit] = Int((w & mask) >> (64 - ShortBaseSequence<Int>::capacity));
+    }
+}
+
+
+
 template<class Int> void shasta::extractKmer(
     const LongBaseSequenceView& v,
     uint64_t position,
@@ -68,41 +97,25 @@ template<class Int> void shasta::extractKmer(
     SHASTA_ASSERT(length <= s.capacity);
     SHASTA_ASSERT(position + length <= v.baseCount);
 
-    // Access the first two words containing the k-mer we want.
-    const uint64_t i0 = (position >> 6) << 1;
-    const uint64_t i1 = i0 + 1;
-    array<uint64_t, 2> ww01 = {v.begin[i0], v.begin[i1]};
+    extractKmerInline(v, position, length, s);
+}
 
-    // The starting position of the k-mer in the first two words.
-    const uint64_t position01 = position & 63;
-    // cout << "position01 " << position01 << endl;
 
-    // The number of k-mer bases in the first two words.
-    const uint64_t length01 = min(length, 64 - position01);
 
-    // Store these length01 bases at the beginning of the ShortBaseSequence.
-    s.data[0] = 0;
-    s.data[1] = 0;
-    extractBits(&(ww01[0]), position01, length01, &(s.data[0]), 0);
+template<class Int> void shasta::extractKmers(
+    const LongBaseSequenceView& v,
+    span<const uint64_t> positions,
+    uint64_t length,
+    span< ShortBaseSequence<Int> > kmers)
+{
+    SHASTA_ASSERT(length <= ShortBaseSequence<Int>::capacity);
+    SHASTA_ASSERT(kmers.size() == positions.size());
 
-    // If the k-mer is entirely contained in the first two words, we are done.
-    if(length01 == length) {
-        return;
+    for(uint64_t i=0; i<positions.size(); i++) {
+        const uint64_t position = positions[i];
+        SHASTA_ASSERT(position + length <= v.baseCount);
+        extractKmerInline(v, position, length, kmers[i]);
     }
-
-    // Get the remaining bases from the next two words.
-    // The number of k-mer bases in the second two words
-    const uint64_t length23 = length - length01;
-
-    // Access the second two words.
-    const uint64_t i2 = i1 + 1;
-    const uint64_t i3 = i2 + 1;
-    array<uint64_t, 2> ww23 = {v.begin[i2], v.begin[i3]};
-
-    // Store the most significant length23 bits in the ShortBaseSequence,
-    // following the ones we already stored.
-    extractBits(&(ww23[0]), 0, length23, &(s.data[0]), length01);
-
 }
 
 
@@ -132,3 +145,27 @@ template void shasta::extractKmer(
     uint64_t length,
     ShortBaseSequence<uint64_t>&);
 
+
+template void shasta::extractKmers(
+    const LongBaseSequenceView&,
+    span<const uint64_t> positions,
+    uint64_t length,
+    span< ShortBaseSequence<uint8_t> >);
+
+template void shasta::extractKmers(
+    const LongBaseSequenceView&,
+    span<const uint64_t> positions,
+    uint64_t length,
+    span< ShortBaseSequence<uint16_t> >);
+
+template void shasta::extractKmers(
+    const LongBaseSequenceView&,
+    span<const uint64_t> positions,
+    uint64_t length,
+    span< ShortBaseSequence<uint32_t> >);
+
+template void shasta::extractKmers(
+    const LongBaseSequenceView&,
+    span<const uint64_t> positions,
+    uint64_t length,
+    span< ShortBaseSequence<uint64_t> >);
@@ -9,6 +9,7 @@
 
 #include <concepts>
 #include "cstdint.hpp"
+#include "span.hpp"
 
 
 
@@ -22,6 +23,14 @@ namespace shasta {
         uint64_t length,
         ShortBaseSequence<Int>&);
 
+    // Bulk version: extract the k-mers of the given length
+    // starting at each of the given positions.
+    template<class Int> void extractKmers(
+        const LongBaseSequenceView&,
+        span<const uint64_t> positions,
+        uint64_t length,
+        span< ShortBaseSequence<Int> >);
+
     // Extract n bits from x, starting at position xPosition,
     // and store them in y, starting at position yPosition,
     // leaving the remaining bits of y unchanged.
@@ -62,6 +71,30 @@ namespace shasta {
         uint64_t length,
         ShortBaseSequence<uint64_t>&);
 
+    extern template void extractKmers(
+        const LongBaseSequenceView&,
+        span<const uint64_t> positions,
+        uint64_t length,
+        span< ShortBaseSequence<uint8_t> >);
+
+    extern template void extractKmers(
+        const LongBaseSequenceView&,
+        span<const uint64_t> positions,
+        uint64_t length,
+        span< ShortBaseSequence<uint16_t> >);
+
+    extern template void extractKmers(
+        const LongBaseSequenceView&,
+        span<const uint64_t> positions,
+        uint64_t length,
+        span< ShortBaseSequence<uint32_t> >);
+
+    extern template void extractKmers(
+        const LongBaseSequenceView&,
+        span<const uint64_t> positions,
+        uint64_t length,
+        span< ShortBaseSequence<uint64_t> >);
+
 }
 
 
@@ -24,8 +24,12 @@ using namespace shasta;
 #include <unistd.h>
 
 // Standard library.
+#include "algorithm.hpp"
 #include "array.hpp"
+#include <atomic>
+#include <exception>
 #include <filesystem>
+#include <thread>
 
 
 
@@ -117,3 +121,55 @@ string shasta::filesystem::executablePath() {
     return path;
 }
 
+
+
+
+void shasta::filesystem::removeDirectory(const string& directory, uint64_t threadCount)
+{
+    // Gather the files to be removed by the threads.
+    // Anything else (subdirectories, for example) is removed
+    // at the end by remove_all.
+    vector<std::filesystem::path> files;
+    for(const auto& entry: std::filesystem::directory_iterator(directory)) {
+        if(entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    threadCount = std::max(uint64_t(1), std::min(threadCount, uint64_t(files.size())));
+
+    // Each thread removes files until there are none left.
+    std::atomic<uint64_t> nextFile = 0;
+    vector<std::exception_ptr> exceptions(threadCount);
+    auto threadFunction = [&](uint64_t threadId)
+    {
+        try {
+            while(true) {
+                const uint64_t i = nextFile++;
+                if(i >= files.size()) {
+                    break;
+                }
+                std::filesystem::remove(files[i]);
+            }
+        } catch(...) {
+            exceptions[threadId] = std::current_exception();
+        }
+    };
+    vector<std::thread> threads;
+    for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+        threads.push_back(std::thread(threadFunction, threadId));
+    }
+    for(std::thread& t: threads) {
+        t.join();
+    }
+    for(const std::exception_ptr& e: exceptions) {
+        if(e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -1,6 +1,7 @@
 #ifndef SHASTA_FILESYSTEM_HPP
 #define SHASTA_FILESYSTEM_HPP
 
+#include "cstdint.hpp"
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -21,6 +22,15 @@ namespace shasta {
         // Find the absolute path of the executable. Works only for Linux.
         string executablePath();
 
+        // Remove a directory and everything it contains.
+        // The files directly contained in the directory are removed
+        // using the specified number of threads (0 = use all available).
+        // This is much faster than a single threaded rm -rf
+        // for directories containing many large binary files on disk,
+        // because freeing the blocks of large files is expensive.
+        // In case of failure, throw an exception.
+        void removeDirectory(const string&, uint64_t threadCount);
+
     }
 }
 
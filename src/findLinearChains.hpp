@@ -1,12 +1,35 @@
 #ifndef SHASTA_FIND_LINEAR_CHAINS_HPP
 #define SHASTA_FIND_LINEAR_CHAINS_HPP
 
-// Find linear chains in a directed graph
+// Find linear chains in a directed graph.
+
+// The elements of the graph (vertices or edges) are numbered
+// in the order in which the graph iterates over them,
+// and the degree-1 links between them (the pairs of consecutive
+// elements in a chain) are stored in vectors indexed by these numbers.
+// The chains are then found by following the links,
+// without recursion and without searching in sets.
+// For large graphs, the links are computed and followed in parallel.
+// Chains are returned in the order of
+// their first element in the above numbering. Circular chains
+// begin at their first element in the above numbering.
+
+// Shasta.
+#include "SHASTA_ASSERT.hpp"
 
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/iteration_macros.hpp>
+
+// Standard library.
+#include "algorithm.hpp"
+#include <atomic>
+#include "cstdint.hpp"
+#include <limits>
 #include <list>
+#include <thread>
+#include <unordered_map>
+#include "utility.hpp"
 #include "vector.hpp"
 
 namespace shasta {
@@ -29,234 +52,333 @@ namespace shasta {
     template<class Graph> void findLinearVertexChains(
         const Graph&,
         vector< vector<typename Graph::vertex_descriptor> >&);
+
+    namespace findLinearChainsDetail {
+
+        const uint64_t noLink = std::numeric_limits<uint64_t>::max();
+
+        // Call f(i) for all i in [0, n).
+        // This uses all available threads if n is large enough
+        // to make this worthwhile.
+        template<class F> void parallelFor(uint64_t n, const F&);
+
+        // Given the degree-1 links between n elements,
+        // find the chains, as vectors of element numbers.
+        inline void followLinks(
+            const vector<uint64_t>& next,
+            const vector<uint64_t>& previous,
+            vector< vector<uint64_t> >& chains);
+
+        template<class Graph> void numberVertices(
+            const Graph&,
+            vector<typename Graph::vertex_descriptor>&,
+            std::unordered_map<typename Graph::vertex_descriptor, uint64_t>&);
+    }
+}
+
+
+
+template<class F> void shasta::findLinearChainsDetail::parallelFor(uint64_t n, const F& f)
+{
+    const uint64_t minParallelSize = 100000;
+    const uint64_t threadCount = std::max(1U, std::thread::hardware_concurrency());
+    if(n < minParallelSize or threadCount == 1) {
+        for(uint64_t i=0; i<n; i++) {
+            f(i);
+        }
+        return;
+    }
+
+    const uint64_t batchSize = 1000;
+    std::atomic<uint64_t> nextBegin(0);
+    auto threadFunction = [&]()
+    {
+        while(true) {
+            const uint64_t begin = nextBegin.fetch_add(batchSize);
+            if(begin >= n) {
+                break;
+            }
+            const uint64_t end = std::min(n, begin + batchSize);
+            for(uint64_t i=begin; i!=end; i++) {
+                f(i);
+            }
+        }
+    };
+    vector<std::thread> threads;
+    for(uint64_t threadId=1; threadId<threadCount; threadId++) {
+        threads.push_back(std::thread(threadFunction));
+    }
+    threadFunction();
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
 }
 
 
 
-// Version that uses vectors.
+inline void shasta::findLinearChainsDetail::followLinks(
+    const vector<uint64_t>& next,
+    const vector<uint64_t>& previous,
+    vector< vector<uint64_t> >& chains)
+{
+    const uint64_t n = next.size();
+    SHASTA_ASSERT(previous.size() == n);
+
+    // Each chain that is not circular begins at an element without a previous link.
+    vector<uint64_t> chainBegins;
+    for(uint64_t i=0; i<n; i++) {
+        if(previous[i] == noLink) {
+            chainBegins.push_back(i);
+        }
+    }
+
+    // Follow these chains in parallel, keeping track of
+    // the lowest numbered element of each.
+    vector< vector<uint64_t> > linearChains(chainBegins.size());
+    vector<uint64_t> firstElement(chainBegins.size());
+    vector<uint8_t> wasFound(n, 0);
+    parallelFor(chainBegins.size(), [&](uint64_t k)
+    {
+        vector<uint64_t>& chain = linearChains[k];
+        uint64_t first = noLink;
+        for(uint64_t i=chainBegins[k]; i!=noLink; i=next[i]) {
+            chain.push_back(i);
+            wasFound[i] = 1;
+            first = std::min(first, i);
+        }
+        firstElement[k] = first;
+    });
+
+    // The elements not yet found are in circular chains.
+    // Because we scan them in order, each circular chain
+    // begins at its lowest numbered element.
+    vector< vector<uint64_t> > circularChains;
+    for(uint64_t i=0; i<n; i++) {
+        if(wasFound[i]) {
+            continue;
+        }
+        circularChains.emplace_back();
+        vector<uint64_t>& chain = circularChains.back();
+        uint64_t j = i;
+        do {
+            SHASTA_ASSERT(not wasFound[j]);
+            chain.push_back(j);
+            wasFound[j] = 1;
+            j = next[j];
+        } while(j != i);
+    }
+
+    // Gather all the chains, sorted by their lowest numbered element.
+    vector< pair<uint64_t, vector<uint64_t>*> > sortedChains;
+    for(uint64_t k=0; k<linearChains.size(); k++) {
+        sortedChains.push_back({firstElement[k], &linearChains[k]});
+    }
+    for(vector<uint64_t>& chain: circularChains) {
+        sortedChains.push_back({chain.front(), &chain});
+    }
+    std::sort(sortedChains.begin(), sortedChains.end());
+    chains.clear();
+    chains.reserve(sortedChains.size());
+    for(const auto& p: sortedChains) {
+        chains.push_back(std::move(*p.second));
+    }
+}
+
+
+
+// Number the vertices in the order in which the graph iterates over them.
+template<class Graph> void shasta::findLinearChainsDetail::numberVertices(
+    const Graph& graph,
+    vector<typename Graph::vertex_descriptor>& vertexVector,
+    std::unordered_map<typename Graph::vertex_descriptor, uint64_t>& vertexMap)
+{
+    vertexVector.clear();
+    vertexMap.clear();
+    BGL_FORALL_VERTICES_T(v, graph, Graph) {
+        vertexMap.insert({v, vertexVector.size()});
+        vertexVector.push_back(v);
+    }
+}
+
+
+
+// Version that uses lists.
 template<class Graph> void shasta::findLinearChains(
     const Graph& graph,
     uint64_t minimumLength,
-    vector< vector<typename Graph::edge_descriptor> >& chainVectors)
+    vector< std::list<typename Graph::edge_descriptor> >& chainLists)
 {
     using edge_descriptor = typename Graph::edge_descriptor;
 
-    // Call the version that uses lists.
-    vector< std::list<edge_descriptor> > chains;
+    // Call the version that uses vectors.
+    vector< vector<edge_descriptor> > chains;
     findLinearChains(graph, minimumLength, chains);
 
-    // Copy the lists to vectors.
-    chainVectors.clear();
+    // Copy the vectors to lists.
+    chainLists.clear();
     for(const auto& chain: chains) {
-        chainVectors.push_back(vector<edge_descriptor>(chain.begin(), chain.end()));
+        chainLists.push_back(std::list<edge_descriptor>(chain.begin(), chain.end()));
     }
 }
 
 
 
 // Find linear chains of edges (paths).
-template<class Graph> inline void shasta::findLinearChains(
+// Edge e0 is followed by edge e1 in a chain if
+// the target of e0 is the source of e1,
+// and that vertex has in-degree and out-degree 1.
+template<class Graph> void shasta::findLinearChains(
     const Graph& graph,
     uint64_t minimumLength,
-    vector< std::list<typename Graph::edge_descriptor> >& chains)
+    vector< vector<typename Graph::edge_descriptor> >& chains)
 {
+    using namespace findLinearChainsDetail;
     using vertex_descriptor = typename Graph::vertex_descriptor;
     using edge_descriptor = typename Graph::edge_descriptor;
 
-    // The edges we have already encountered.
-    std::set<edge_descriptor> edgesFound;
-
-
-    chains.clear();
-
-    // Consider all possible start edges for the chain.
-    BGL_FORALL_EDGES_T(eStart, graph, Graph) {
-
-        // If we already assigned this edge to a chain, skip it.
-        if(edgesFound.find(eStart) != edgesFound.end()) {
-            continue;
+    // Number the vertices and edges.
+    // This iterates over all edges of the graph, so it also works
+    // if the graph is a filtered_graph.
+    vector<vertex_descriptor> vertexVector;
+    std::unordered_map<vertex_descriptor, uint64_t> vertexMap;
+    numberVertices(graph, vertexVector, vertexMap);
+    vector<edge_descriptor> edgeVector;
+    vector< pair<uint64_t, uint64_t> > edgeVertices;
+    BGL_FORALL_EDGES_T(e, graph, Graph) {
+        edgeVector.push_back(e);
+        edgeVertices.push_back({vertexMap.at(source(e, graph)), vertexMap.at(target(e, graph))});
+    }
+    const uint64_t vertexCount = vertexVector.size();
+    const uint64_t edgeCount = edgeVector.size();
+
+    // Find the vertices with in-degree and out-degree 1.
+    vector<uint8_t> isLinear(vertexCount);
+    parallelFor(vertexCount, [&](uint64_t i)
+    {
+        const vertex_descriptor v = vertexVector[i];
+        isLinear[i] = (in_degree(v, graph) == 1) and (out_degree(v, graph) == 1);
+    });
+
+    // For each of those vertices, find its in-edge and out-edge.
+    vector<uint64_t> inEdge(vertexCount, noLink);
+    vector<uint64_t> outEdge(vertexCount, noLink);
+    for(uint64_t k=0; k<edgeCount; k++) {
+        const uint64_t i0 = edgeVertices[k].first;
+        const uint64_t i1 = edgeVertices[k].second;
+        if(isLinear[i0]) {
+            outEdge[i0] = k;
         }
-
-        // Add a new chain consisting of the start edge.
-        chains.resize(chains.size() + 1);
-        std::list<edge_descriptor>& chain = chains.back();
-        chain.push_back(eStart);
-        edgesFound.insert(eStart);
-
-        // Extend forward.
-        bool isCircular = false;
-        edge_descriptor e = eStart;
-        while(true) {
-            const vertex_descriptor v = target(e, graph);
-            if(in_degree(v, graph) != 1) {
-                break;
-            }
-            if(out_degree(v, graph) != 1) {
-                break;
-            }
-            BGL_FORALL_OUTEDGES_T(v, eNext, graph, Graph) {
-                e = eNext;
-                break;
-            }
-            if(e == eStart) {
-                isCircular = true;
-                break;
-            }
-            chain.push_back(e);
-            SHASTA_ASSERT(edgesFound.find(e) == edgesFound.end());
-            edgesFound.insert(e);
+        if(isLinear[i1]) {
+            inEdge[i1] = k;
         }
+    }
 
+    // Find the links between edges.
+    vector<uint64_t> next(edgeCount);
+    vector<uint64_t> previous(edgeCount);
+    parallelFor(edgeCount, [&](uint64_t k)
+    {
+        next[k] = outEdge[edgeVertices[k].second];
+        previous[k] = inEdge[edgeVertices[k].first];
+    });
 
-        // Extend backward.
-        if(not isCircular) {
-            edge_descriptor e = eStart;
-            while(true) {
-                const vertex_descriptor v = source(e, graph);
-                if(in_degree(v, graph) != 1) {
-                    break;
-                }
-                if(out_degree(v, graph) != 1) {
-                    break;
-                }
-                BGL_FORALL_INEDGES_T(v, ePrevious, graph, Graph) {
-                    e = ePrevious;
-                    break;
-                }
-                if(e == eStart) {
-                    isCircular = true;
-                    break;
-                }
-                chain.push_front(e);
-                SHASTA_ASSERT(edgesFound.find(e) == edgesFound.end());
-                edgesFound.insert(e);
-            }
-        }
+    // Follow the links.
+    vector< vector<uint64_t> > chainIndexes;
+    followLinks(next, previous, chainIndexes);
 
-        // If the chain is too short, get rid of it.
-        if(chain.size() < minimumLength) {
-            chains.resize(chains.size() - 1);
+    // Store the chains that are long enough.
+    chains.clear();
+    for(const vector<uint64_t>& chainIndex: chainIndexes) {
+        if(chainIndex.size() < minimumLength) {
+            continue;
+        }
+        chains.emplace_back();
+        vector<edge_descriptor>& chain = chains.back();
+        chain.reserve(chainIndex.size());
+        for(const uint64_t k: chainIndex) {
+            chain.push_back(edgeVector[k]);
         }
-
-    }
-
-    // Check that all edges were found.
-    // Just using num_edges does not work if the graph is a filtered_graph.
-    // SHASTA_ASSERT(edgesFound.size() == num_edges(graph));
-    uint64_t edgeCount = 0;
-    BGL_FORALL_EDGES_T(e, graph, Graph) {
-        ++edgeCount;
     }
-    SHASTA_ASSERT(edgesFound.size() == edgeCount);
 }
 
 
 
 // Find linear chains of vertices.
+// Vertex v0 is followed by vertex v1 in a chain if
+// v0 has out-degree 1, v1 has in-degree 1,
+// and there is an edge v0->v1.
 template<class Graph> void shasta::findLinearVertexChains(
     const Graph& graph,
-    vector< std::list<typename Graph::vertex_descriptor> >& chains)
+    vector< vector<typename Graph::vertex_descriptor> >& chains)
 {
+    using namespace findLinearChainsDetail;
     using vertex_descriptor = typename Graph::vertex_descriptor;
 
-    // The vertices we have already encountered.
-    std::set<vertex_descriptor> verticesFound;
-
-    chains.clear();
-
-    // Consider all possible start vertices for the chain.
-    BGL_FORALL_VERTICES_T(vStart, graph, Graph) {
-
-        // If we already assigned this vertex to a chain, skip it.
-        if(verticesFound.find(vStart) != verticesFound.end()) {
-            continue;
+    // Number the vertices.
+    vector<vertex_descriptor> vertexVector;
+    std::unordered_map<vertex_descriptor, uint64_t> vertexMap;
+    numberVertices(graph, vertexVector, vertexMap);
+    const uint64_t vertexCount = vertexVector.size();
+
+    // Find the links between vertices.
+    vector<uint64_t> next(vertexCount, noLink);
+    parallelFor(vertexCount, [&](uint64_t i)
+    {
+        const vertex_descriptor v0 = vertexVector[i];
+        if(out_degree(v0, graph) != 1) {
+            return;
         }
-
-        // Add a new chain consisting of the start vertex.
-        chains.resize(chains.size() + 1);
-        std::list<vertex_descriptor>& chain = chains.back();
-        chain.push_back(vStart);
-        verticesFound.insert(vStart);
-
-        // Extend forward.
-        bool isCircular = false;
-        vertex_descriptor v = vStart;
-        while(true) {
-            if(out_degree(v, graph) != 1) {
-                break;
+        BGL_FORALL_OUTEDGES_T(v0, e, graph, Graph) {
+            const vertex_descriptor v1 = target(e, graph);
+            if(in_degree(v1, graph) == 1) {
+                next[i] = vertexMap.at(v1);
             }
-            BGL_FORALL_OUTEDGES_T(v, e, graph, Graph) {
-                v = target(e, graph);
-                break;
-            }
-            if(v == vStart) {
-                isCircular = true;
-                break;
-            }
-            if(in_degree(v, graph) != 1) {
-                break;
-            }
-            chain.push_back(v);
-            SHASTA_ASSERT(verticesFound.find(v) == verticesFound.end());
-            verticesFound.insert(v);
+            break;
         }
-
-        // Extend backward.
-        if(not isCircular) {
-            vertex_descriptor v = vStart;
-            while(true) {
-                if(in_degree(v, graph) != 1) {
-                    break;
-                }
-                BGL_FORALL_INEDGES_T(v, e, graph, Graph) {
-                    v = source(e, graph);
-                    break;
-                }
-                if(out_degree(v, graph) != 1) {
-                    break;
-                }
-                chain.push_front(v);
-                SHASTA_ASSERT(verticesFound.find(v) == verticesFound.end());
-                verticesFound.insert(v);
-            }
+    });
+    vector<uint64_t> previous(vertexCount, noLink);
+    for(uint64_t i=0; i<vertexCount; i++) {
+        if(next[i] != noLink) {
+            previous[next[i]] = i;
         }
     }
 
+    // Follow the links.
+    vector< vector<uint64_t> > chainIndexes;
+    followLinks(next, previous, chainIndexes);
 
-
-    // Check that all vertices were found.
-    // Just using num_vertices does not work if the graph is a filtered_graph.
-    // SHASTA_ASSERT(verticesFound.size() == num_vertices(graph));
-    uint64_t vertexCount = 0;
-    BGL_FORALL_VERTICES_T(v, graph, Graph) {
-        if(v != Graph::null_vertex()) { // Just to avoid compiler warning.
-            ++vertexCount;
+    // Store the chains.
+    chains.clear();
+    chains.reserve(chainIndexes.size());
+    for(const vector<uint64_t>& chainIndex: chainIndexes) {
+        chains.emplace_back();
+        vector<vertex_descriptor>& chain = chains.back();
+        chain.reserve(chainIndex.size());
+        for(const uint64_t i: chainIndex) {
+            chain.push_back(vertexVector[i]);
         }
     }
-    SHASTA_ASSERT(verticesFound.size() == vertexCount);
 }
 
 
 
 template<class Graph> void shasta::findLinearVertexChains(
     const Graph& graph,
-    vector< vector<typename Graph::vertex_descriptor> >& chains)
+    vector< std::list<typename Graph::vertex_descriptor> >& chainLists)
 {
     using vertex_descriptor = typename Graph::vertex_descriptor;
 
     // Find the chains.
-    vector< std::list<typename Graph::vertex_descriptor> > chainLists;
-    findLinearVertexChains(graph, chainLists);
+    vector< vector<vertex_descriptor> > chains;
+    findLinearVertexChains(graph, chains);
 
-    // Copy lists to vectors.
-    chains.clear();
-    chains.reserve(chainLists.size());
-    for(const auto& chain: chainLists) {
-        chains.push_back(vector<vertex_descriptor>());
-        copy(chain.begin(), chain.end(), back_inserter(chains.back()));
+    // Copy vectors to lists.
+    chainLists.clear();
+    chainLists.reserve(chains.size());
+    for(const auto& chain: chains) {
+        chainLists.push_back(std::list<vertex_descriptor>(chain.begin(), chain.end()));
     }
 }
 
 
 #endif
-
@@ -12,17 +12,72 @@
 
 // Standard library.
 #include "algorithm.hpp"
+#include <atomic>
+#include <exception>
 #include <map>
+#include <thread>
 #include "tuple.hpp"
 
 // See the comments in globalMsa.hpp.
 
+namespace shasta {
+    void globalMsaSpoa(
+        const vector< pair<vector<Base>, uint64_t> >& sequences,
+        vector< vector<AlignedBase> >& alignment,
+        const std::unique_ptr<spoa::AlignmentEngine>&,
+        spoa::Graph&
+        );
+
+    // The backend used by globalMsaSpoaBatch.
+    shared_ptr<GlobalMsaBackend> globalMsaBackend = make_shared<SpoaGlobalMsaBackend>();
+
+    // A k-mer that appears only once in a sequence, and its position.
+    class GlobalMsaKmerInfo {
+    public:
+        using Kmer = ShortBaseSequence64;
+        Kmer kmer;
+        uint64_t position;
+        bool operator<(const GlobalMsaKmerInfo& that) const
+        {
+            return kmer.data < that.kmer.data;
+        }
+        bool operator==(const GlobalMsaKmerInfo& that) const
+        {
+            return kmer.data == that.kmer.data;
+        }
+    };
+
+    // Find the k-mers that appear only once in a sequence.
+    // On return, the k-mers are sorted.
+    // The sequence must be at least kmerLength long.
+    void findGlobalMsaUniqueKmers(
+        const vector<Base>& sequence,
+        uint64_t kmerLength,
+        vector<GlobalMsaKmerInfo>&);
+
+    bool globalMsaAnchored(
+        const vector< pair<vector<Base>, uint64_t> >& sequences,
+        uint64_t maxSpoaLength,
+        uint64_t kmerLength,
+        uint64_t threadCount,
+        vector<Base>& consensus,
+        bool debug
+        );
+    void globalMsaWindow(
+        const vector< pair<vector<Base>, uint64_t> >& sequences,
+        uint64_t maxSpoaLength,
+        uint64_t kmerLength,
+        vector<Base>& consensus
+        );
+}
+
 
 
 void shasta::globalMsa(
     const vector< pair<vector<Base>, uint64_t> >& sequences,
     uint64_t maxSpoaLength,
     uint64_t kmerLength,
+    uint64_t threadCount,
     vector<Base>& consensus
     )
 {
@@ -65,57 +120,21 @@ void shasta::globalMsa(
         return;
     }
 
+    // If possible, split the MSA into windows at k-mers
+    // that appear once in all sequences, and compute
+    // the MSAs of the windows in parallel.
+    if(globalMsaAnchored(sequences, maxSpoaLength, kmerLength, threadCount, consensus, debug)) {
+        return;
+    }
+
 
 
+    // Otherwise, split it in two at the best unique k-mer.
     // Create a table of unique k-mers for each of the sequences.
-    class KmerInfo {
-    public:
-        Kmer kmer;
-        uint64_t position;
-        bool operator<(const KmerInfo& that) const
-        {
-            return kmer.data < that.kmer.data;
-        }
-        bool operator==(const KmerInfo& that) const
-        {
-            return kmer.data == that.kmer.data;
-        }
-    };
+    using KmerInfo = GlobalMsaKmerInfo;
     vector< vector<KmerInfo> > kmerTable1(sequences.size());
-
     for(uint64_t i=0; i<sequences.size(); i++) {
-        const vector<Base>& sequence = sequences[i].first;
-        if(false) {
-            cout << "Finding unique k-mers for sequence of length " << sequence.size() << endl;
-        }
-        vector<KmerInfo>& kmerInfos = kmerTable1[i];
-
-        Kmer kmer;
-        for(uint64_t position=0; position<kmerLength; position++) {
-            kmer.set(position, sequence[position]);
-        }
-
-        for(uint64_t position=0; /* Check later */; position++) {
-            kmerInfos.push_back({kmer, position});
-
-            if(position + kmerLength == sequence.size()) {
-                break;
-            }
-
-            // Update the k-mer.
-            kmer.shiftLeft();
-            kmer.set(kmerLength - 1, sequence[position + kmerLength]);
-        }
-        SHASTA_ASSERT(kmerInfos.size() == sequence.size() - kmerLength + 1);
-
-        // Only keep the k-mers that appear once.
-        if(false) {
-            cout << kmerInfos.size() << " total kmers." << endl;
-        }
-        deduplicateAndCountAndKeepUnique(kmerInfos);
-        if(false) {
-            cout << kmerInfos.size() << " unique kmers." << endl;
-        }
+        findGlobalMsaUniqueKmers(sequences[i].first, kmerLength, kmerTable1[i]);
     }
 
 
@@ -245,8 +264,8 @@ void shasta::globalMsa(
     }
 
     // Recursive call to do the left and right MSA.
-    globalMsa(leftSequences , maxSpoaLength, kmerLength, leftConsensus);
-    globalMsa(rightSequences, maxSpoaLength, kmerLength, rightConsensus);
+    globalMsa(leftSequences , maxSpoaLength, kmerLength, threadCount, leftConsensus);
+    globalMsa(rightSequences, maxSpoaLength, kmerLength, threadCount, rightConsensus);
 
     // Now stitch the pieces together.
     consensus = leftConsensus;
@@ -259,6 +278,292 @@ void shasta::globalMsa(
 
 
 
+void shasta::findGlobalMsaUniqueKmers(
+    const vector<Base>& sequence,
+    uint64_t kmerLength,
+    vector<GlobalMsaKmerInfo>& kmerInfos)
+{
+    using Kmer = GlobalMsaKmerInfo::Kmer;
+    SHASTA_ASSERT(sequence.size() >= kmerLength);
+    kmerInfos.clear();
+
+    Kmer kmer;
+    for(uint64_t position=0; position<kmerLength; position++) {
+        kmer.set(position, sequence[position]);
+    }
+
+    for(uint64_t position=0; /* Check later */; position++) {
+        kmerInfos.push_back({kmer, position});
+
+        if(position + kmerLength == sequence.size()) {
+            break;
+        }
+
+        // Update the k-mer.
+        kmer.shiftLeft();
+        kmer.set(kmerLength - 1, sequence[position + kmerLength]);
+    }
+    SHASTA_ASSERT(kmerInfos.size() == sequence.size() - kmerLength + 1);
+
+    // Only keep the k-mers that appear once.
+    deduplicateAndCountAndKeepUnique(kmerInfos);
+}
+
+
+
+// Anchored MSA for long sequences.
+// An anchor is a k-mer that appears exactly once in each of the sequences.
+// We find a chain of anchors that appear in the same order in all sequences,
+// and select from it the smallest number of anchors that splits
+// all sequences into windows no longer than maxSpoaLength, when possible.
+// The MSA of each window is computed independently, using multiple threads,
+// and the window consensus sequences are then stitched together
+// with the anchor k-mers between them.
+// Because each window is at most maxSpoaLength long,
+// memory and time are linear in the length of the sequences.
+// Returns false, without changing the consensus, if no anchor was found.
+bool shasta::globalMsaAnchored(
+    const vector< pair<vector<Base>, uint64_t> >& sequences,
+    uint64_t maxSpoaLength,
+    uint64_t kmerLength,
+    uint64_t threadCount,
+    vector<Base>& consensus,
+    bool debug
+    )
+{
+    using KmerInfo = GlobalMsaKmerInfo;
+    const uint64_t sequenceCount = sequences.size();
+    for(const auto& p: sequences) {
+        if(p.first.size() < kmerLength) {
+            return false;
+        }
+    }
+
+    // Find the unique k-mers of each sequence.
+    vector< vector<KmerInfo> > kmerTable(sequenceCount);
+    for(uint64_t i=0; i<sequenceCount; i++) {
+        findGlobalMsaUniqueKmers(sequences[i].first, kmerLength, kmerTable[i]);
+    }
+
+    // Find the k-mers that are unique in all the sequences.
+    // For each, store its position in each of the sequences.
+    // They are stored as a flat vector with sequenceCount positions per anchor.
+    vector<uint64_t> anchorPositions;
+    vector<uint64_t> positions(sequenceCount);
+    for(const KmerInfo& kmerInfo0: kmerTable.front()) {
+        positions[0] = kmerInfo0.position;
+        bool isAnchor = true;
+        for(uint64_t i=1; i<sequenceCount; i++) {
+            const vector<KmerInfo>& kmerInfos = kmerTable[i];
+            const auto it = std::lower_bound(kmerInfos.begin(), kmerInfos.end(), kmerInfo0);
+            if(it == kmerInfos.end() or not(*it == kmerInfo0)) {
+                isAnchor = false;
+                break;
+            }
+            positions[i] = it->position;
+        }
+        if(isAnchor) {
+            anchorPositions.insert(anchorPositions.end(), positions.begin(), positions.end());
+        }
+    }
+    const uint64_t anchorCount = anchorPositions.size() / sequenceCount;
+    auto anchor = [&](uint64_t anchorIndex)
+    {
+        return anchorPositions.begin() + anchorIndex * sequenceCount;
+    };
+
+    // Sort the anchors by position in the first sequence.
+    vector<uint64_t> anchorOrder(anchorCount);
+    for(uint64_t anchorIndex=0; anchorIndex<anchorCount; anchorIndex++) {
+        anchorOrder[anchorIndex] = anchorIndex;
+    }
+    sort(anchorOrder.begin(), anchorOrder.end(),
+        [&](uint64_t a, uint64_t b) {return *anchor(a) < *anchor(b);});
+
+    // Find a chain of non-overlapping anchors that appear
+    // in the same order in all sequences.
+    vector<uint64_t> chain;
+    vector<uint64_t> chainEnd(sequenceCount, 0);
+    for(const uint64_t anchorIndex: anchorOrder) {
+        const auto a = anchor(anchorIndex);
+        bool isCompatible = true;
+        for(uint64_t i=0; i<sequenceCount; i++) {
+            if(a[i] < chainEnd[i]) {
+                isCompatible = false;
+                break;
+            }
+        }
+        if(isCompatible) {
+            chain.push_back(anchorIndex);
+            for(uint64_t i=0; i<sequenceCount; i++) {
+                chainEnd[i] = a[i] + kmerLength;
+            }
+        }
+    }
+
+    // Select the anchors that define the windows.
+    // Starting from the beginning of the sequences, we repeatedly select
+    // the last anchor of the chain that keeps the window at most maxSpoaLength long
+    // in all sequences. If there is no such anchor, we select the next one,
+    // and that window will have to be split further.
+    vector<uint64_t> windowBegin(sequenceCount, 0);
+    auto fits = [&](const vector<uint64_t>& begin, auto end)
+    {
+        for(uint64_t i=0; i<sequenceCount; i++) {
+            if(end[i] - begin[i] > maxSpoaLength) {
+                return false;
+            }
+        }
+        return true;
+    };
+    vector<uint64_t> sequenceEnds(sequenceCount);
+    for(uint64_t i=0; i<sequenceCount; i++) {
+        sequenceEnds[i] = sequences[i].first.size();
+    }
+    vector<uint64_t> selectedAnchors;
+    uint64_t chainIndex = 0;
+    while(chainIndex < chain.size() and not fits(windowBegin, sequenceEnds.begin())) {
+        uint64_t selected = chainIndex;
+        while(selected + 1 < chain.size() and fits(windowBegin, anchor(chain[selected + 1]))) {
+            ++selected;
+        }
+        selectedAnchors.push_back(chain[selected]);
+        const auto a = anchor(chain[selected]);
+        for(uint64_t i=0; i<sequenceCount; i++) {
+            windowBegin[i] = a[i] + kmerLength;
+        }
+        chainIndex = selected + 1;
+    }
+    if(selectedAnchors.empty()) {
+        return false;
+    }
+
+    // Gather the sequences of each window. Identical sequences
+    // in a window are combined, adding their weights.
+    const uint64_t windowCount = selectedAnchors.size() + 1;
+    vector< vector< pair<vector<Base>, uint64_t> > > windowSequences(windowCount);
+    for(uint64_t i=0; i<sequenceCount; i++) {
+        const vector<Base>& sequence = sequences[i].first;
+        const uint64_t weight = sequences[i].second;
+        uint64_t begin = 0;
+        for(uint64_t windowIndex=0; windowIndex<windowCount; windowIndex++) {
+            const uint64_t end = (windowIndex == windowCount - 1) ?
+                sequence.size() : anchor(selectedAnchors[windowIndex])[i];
+            const vector<Base> windowSequence(sequence.begin() + begin, sequence.begin() + end);
+            auto& window = windowSequences[windowIndex];
+            bool found = false;
+            for(auto& p: window) {
+                if(p.first == windowSequence) {
+                    p.second += weight;
+                    found = true;
+                    break;
+                }
+            }
+            if(not found) {
+                window.push_back(make_pair(windowSequence, weight));
+            }
+            begin = end + kmerLength;
+        }
+    }
+
+    if(debug) {
+        cout << "Anchored MSA uses " << windowCount << " windows, from a chain of " <<
+            chain.size() << " anchors out of " << anchorCount << "." << endl;
+    }
+
+    // Compute the consensus of each window, using multiple threads.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    threadCount = max(uint64_t(1), min(threadCount, windowCount));
+    vector< vector<Base> > windowConsensus(windowCount);
+    std::atomic<uint64_t> nextWindowIndex = 0;
+    vector<std::exception_ptr> exceptions(threadCount);
+    auto threadFunction = [&](uint64_t threadId)
+    {
+        try {
+            while(true) {
+                const uint64_t windowIndex = nextWindowIndex++;
+                if(windowIndex >= windowCount) {
+                    break;
+                }
+                globalMsaWindow(windowSequences[windowIndex], maxSpoaLength, kmerLength,
+                    windowConsensus[windowIndex]);
+            }
+        } catch(...) {
+            exceptions[threadId] = std::current_exception();
+        }
+    };
+    if(threadCount == 1) {
+        threadFunction(0);
+    } else {
+        vector<std::thread> threads;
+        for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+            threads.push_back(std::thread(threadFunction, threadId));
+        }
+        for(std::thread& t: threads) {
+            t.join();
+        }
+    }
+    for(const std::exception_ptr& e: exceptions) {
+        if(e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    // Stitch the window consensus sequences and the anchors together.
+    const vector<Base>& sequence0 = sequences.front().first;
+    consensus.clear();
+    for(uint64_t windowIndex=0; windowIndex<windowCount; windowIndex++) {
+        const vector<Base>& c = windowConsensus[windowIndex];
+        consensus.insert(consensus.end(), c.begin(), c.end());
+        if(windowIndex < windowCount - 1) {
+            const uint64_t position = anchor(selectedAnchors[windowIndex])[0];
+            consensus.insert(consensus.end(),
+                sequence0.begin() + position, sequence0.begin() + position + kmerLength);
+        }
+    }
+
+    return true;
+}
+
+
+
+// Compute the consensus of one window of an anchored MSA.
+// Spoa does not add empty sequences to the MSA, so they are handled here:
+// if at least half of the weight is for empty sequences the consensus is empty,
+// otherwise the empty sequences are ignored.
+void shasta::globalMsaWindow(
+    const vector< pair<vector<Base>, uint64_t> >& sequences,
+    uint64_t maxSpoaLength,
+    uint64_t kmerLength,
+    vector<Base>& consensus
+    )
+{
+    consensus.clear();
+    uint64_t totalWeight = 0;
+    uint64_t emptyWeight = 0;
+    vector< pair<vector<Base>, uint64_t> > nonEmptySequences;
+    for(const auto& p: sequences) {
+        totalWeight += p.second;
+        if(p.first.empty()) {
+            emptyWeight += p.second;
+        } else {
+            nonEmptySequences.push_back(p);
+        }
+    }
+    if(2 * emptyWeight >= totalWeight) {
+        return;
+    }
+
+    // The sequences must be in order of decreasing weight.
+    sort(nonEmptySequences.begin(), nonEmptySequences.end(),
+        OrderPairsBySecondOnlyGreater<vector<Base>, uint64_t>());
+    globalMsa(nonEmptySequences, maxSpoaLength, kmerLength, 1, consensus);
+}
+
+
+
 // This just uses spoa.
 // It cannot be used for very long sequences due to quadratic
 // memory and time. Practical limit is a few thousand bases.
@@ -361,14 +666,6 @@ void shasta::globalMsaSpoa(
     vector< vector<AlignedBase> >& alignmentArgument
     )
 {
-    // Sanity check.
-    SHASTA_ASSERT(not sequences.empty());
-
-    // Check that the sequences are ordered by decreasing weight.
-    for(uint64_t i=1; i<sequences.size(); i++) {
-        SHASTA_ASSERT(sequences[i-1].second >= sequences[i].second);
-    }
-
     // Create the spoa alignment engine and alignment graph.
     const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
     const int8_t match = 1;
@@ -377,6 +674,28 @@ void shasta::globalMsaSpoa(
     auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
     spoa::Graph spoaAlignmentGraph;
 
+    globalMsaSpoa(sequences, alignmentArgument, spoaAlignmentEngine, spoaAlignmentGraph);
+}
+
+
+
+// Same as above, using a given spoa alignment engine and graph.
+// The graph must be empty.
+void shasta::globalMsaSpoa(
+    const vector< pair<vector<Base>, uint64_t> >& sequences,
+    vector< vector<AlignedBase> >& alignmentArgument,
+    const std::unique_ptr<spoa::AlignmentEngine>& spoaAlignmentEngine,
+    spoa::Graph& spoaAlignmentGraph
+    )
+{
+    // Sanity check.
+    SHASTA_ASSERT(not sequences.empty());
+
+    // Check that the sequences are ordered by decreasing weight.
+    for(uint64_t i=1; i<sequences.size(); i++) {
+        SHASTA_ASSERT(sequences[i-1].second >= sequences[i].second);
+    }
+
     // Add the sequences to the MSA in order of decreasing weight.
     string sequenceString;
     for(uint64_t i=0; i<sequences.size(); i++) {
@@ -413,6 +732,57 @@ void shasta::globalMsaSpoa(
 
 
 
+// Batched version that computes many independent MSAs.
+void shasta::globalMsaSpoaBatch(
+    const vector< vector< pair<vector<Base>, uint64_t> > >& batch,
+    vector< vector< vector<AlignedBase> > >& alignments
+    )
+{
+    alignments.clear();
+    alignments.resize(batch.size());
+    if(batch.empty()) {
+        return;
+    }
+    globalMsaBackend->computeAlignments(batch, alignments);
+    SHASTA_ASSERT(alignments.size() == batch.size());
+}
+
+
+
+void shasta::setGlobalMsaBackend(shared_ptr<GlobalMsaBackend> backend)
+{
+    if(backend) {
+        globalMsaBackend = backend;
+    } else {
+        globalMsaBackend = make_shared<SpoaGlobalMsaBackend>();
+    }
+}
+
+
+
+// The default backend computes the MSAs one at a time using spoa,
+// but creates the spoa alignment engine only once for the entire batch.
+// The engine and graph are local, so concurrent calls are safe.
+void shasta::SpoaGlobalMsaBackend::computeAlignments(
+    const vector< vector< pair<vector<Base>, uint64_t> > >& batch,
+    vector< vector< vector<AlignedBase> > >& alignments
+    )
+{
+    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
+    const int8_t match = 1;
+    const int8_t mismatch = -1;
+    const int8_t gap = -1;
+    auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
+    spoa::Graph spoaAlignmentGraph;
+
+    for(uint64_t i=0; i<batch.size(); i++) {
+        spoaAlignmentGraph.Clear();
+        globalMsaSpoa(batch[i], alignments[i], spoaAlignmentEngine, spoaAlignmentGraph);
+    }
+}
+
+
+
 // Version that enforces a maximum MSA length and returns false if it is exceeded.
 bool shasta::globalMsaSpoa(
     const vector< pair<vector<Base>, uint64_t> >& sequences,
@@ -444,6 +814,9 @@ std::string shasta::globalMsaPython(
     uint64_t maxSpoaLength,
     uint64_t kmerLength)
 {
+    // Use all available threads for anchored MSAs.
+    const uint64_t threadCount = 0;
+
     // Extract the sequences.
     vector< pair<vector<Base>, uint64_t> > sequences;
     sequences.reserve(sequenceStrings.size());
@@ -459,7 +832,7 @@ std::string shasta::globalMsaPython(
 
     // Do the MSA.
     vector<Base> consensus;
-    globalMsa(sequences, maxSpoaLength, kmerLength, consensus);
+    globalMsa(sequences, maxSpoaLength, kmerLength, threadCount, consensus);
 
     // Construct the consensus string and return it.
     string consensusString;
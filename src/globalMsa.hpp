@@ -10,7 +10,12 @@ This supports sequences of arbitrary length.
 If all the sequences are at most maxSpoaLength long,
 this invokes spoa.
 
-Otherwise it finds a common subsequence of length kmerLength
+Otherwise it looks for k-mers of length kmerLength that appear once
+in every sequence, in the same order ("anchors"), and uses them to split
+the sequences into windows at most maxSpoaLength long.
+The MSAs of the windows are computed independently using threadCount threads
+(0 to use all available threads), and the results are stitched together.
+If there are no such anchors, it finds a common subsequence of length kmerLength
 and splits the MSA at that location, invoking itself recursively
 to solve the two MSAs.
 
@@ -18,9 +23,17 @@ Each of the input sequences is passed in as a pair.
 The second member of the pair is the "weight" of the sequence
 (that is, typically the number of reads with that sequence).
 
+globalMsaSpoaBatch computes many independent MSAs with a single call.
+The MSAs are computed by a GlobalMsaBackend. The default backend
+uses spoa on the CPU, reusing the same spoa engine and graph
+for all the MSAs in a batch. A different backend, for example
+one that sends the whole batch to an accelerator,
+can be installed with setGlobalMsaBackend.
+
 *******************************************************************************/
 
 #include "cstdint.hpp"
+#include "memory.hpp"
 #include "utility.hpp"
 #include "string.hpp"
 #include "vector.hpp"
@@ -29,11 +42,14 @@ namespace shasta {
 
     class Base;
     class AlignedBase;
+    class GlobalMsaBackend;
+    class SpoaGlobalMsaBackend;
 
     void globalMsa(
         const vector< pair<vector<Base>, uint64_t> >& sequences,
         uint64_t maxSpoaLength,
         uint64_t kmerLength,
+        uint64_t threadCount,
         vector<Base>& consensus
         );
 
@@ -51,6 +67,19 @@ namespace shasta {
         vector< vector<AlignedBase> >& alignment
         );
 
+    // Batched version of the above.
+    // For each batch entry, the sequences must be in order of decreasing weight.
+    // On return, alignments[i] is the alignment for batch[i].
+    void globalMsaSpoaBatch(
+        const vector< vector< pair<vector<Base>, uint64_t> > >& batch,
+        vector< vector< vector<AlignedBase> > >& alignments
+        );
+
+    // Set the backend used by globalMsaSpoaBatch.
+    // Passing a null pointer restores the default spoa backend.
+    // This must not be called while MSAs are being computed.
+    void setGlobalMsaBackend(shared_ptr<GlobalMsaBackend>);
+
     // Python-callable version.
     string globalMsaPython(
         const vector< pair<string, uint64_t> >& sequenceStrings,
@@ -59,4 +88,29 @@ namespace shasta {
     );
 }
 
+
+
+
+// Abstract base class for an engine that computes batches of
+// independent MSAs for globalMsaSpoaBatch.
+class shasta::GlobalMsaBackend {
+public:
+    virtual void computeAlignments(
+        const vector< vector< pair<vector<Base>, uint64_t> > >& batch,
+        vector< vector< vector<AlignedBase> > >& alignments
+        ) = 0;
+    virtual ~GlobalMsaBackend() {}
+};
+
+
+
+// The default backend, which uses spoa on the CPU.
+class shasta::SpoaGlobalMsaBackend : public GlobalMsaBackend {
+public:
+    void computeAlignments(
+        const vector< vector< pair<vector<Base>, uint64_t> > >& batch,
+        vector< vector< vector<AlignedBase> > >& alignments
+        );
+};
+
 #endif
@@ -6,13 +6,16 @@
 // Standard library.
 #include "algorithm.hpp"
 #include <chrono>
+#include <filesystem>
 #include "iostream.hpp"
 #include "stdexcept.hpp"
 
 // Linux.
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/fs.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -102,3 +105,110 @@ void shasta::mappedCopy(
     const double tTotal = 1.e-9 * double((std::chrono::duration_cast<std::chrono::nanoseconds>(tEnd - tBegin)).count());
     cout << timestamp << "Copied " << n << " bytes in " << tTotal << " s, " << double(n)/tTotal << " bytes/s." << endl;
 }
+
+
+
+// Copy a file as cheaply as the filesystems allow.
+// See mappedCopy.hpp for details.
+void shasta::snapshotCopy(
+    const string& inputPath,
+    const string& outputPath)
+{
+    // Open the input file.
+    const int inputFileDescriptor = ::open(inputPath.c_str(), O_RDONLY);
+    if(inputFileDescriptor == -1) {
+        throw runtime_error("Error opening " + inputPath + ": " + strerror(errno));
+    }
+
+    // Get the size of the input file.
+    struct stat inputStat;
+    if(::fstat(inputFileDescriptor, &inputStat) == -1) {
+        ::close(inputFileDescriptor);
+        throw runtime_error("Error during fstat for " + inputPath + ": " + strerror(errno));
+    }
+    const uint64_t n = uint64_t(inputStat.st_size);
+
+    // Open the output file.
+    const int outputFileDescriptor = ::open(outputPath.c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(outputFileDescriptor == -1) {
+        ::close(inputFileDescriptor);
+        throw runtime_error("Error opening " + outputPath + ": " + strerror(errno));
+    }
+
+    // Try a reflink first.
+    if(::ioctl(outputFileDescriptor, FICLONE, inputFileDescriptor) == 0) {
+        ::close(inputFileDescriptor);
+        ::close(outputFileDescriptor);
+        cout << timestamp << "Cloned " << inputPath << " to " << outputPath << endl;
+        return;
+    }
+
+    // Try copy_file_range.
+    // It can fail before copying anything if the filesystems don't support it,
+    // in which case we fall back to mappedCopy.
+    uint64_t copiedByteCount = 0;
+    bool copyFileRangeFailed = false;
+    while(copiedByteCount < n) {
+        const ssize_t m = ::copy_file_range(
+            inputFileDescriptor, 0, outputFileDescriptor, 0,
+            n - copiedByteCount, 0);
+        if(m <= 0) {
+            copyFileRangeFailed = true;
+            break;
+        }
+        copiedByteCount += uint64_t(m);
+    }
+    const int copyFileRangeErrno = errno;
+    ::close(inputFileDescriptor);
+    ::close(outputFileDescriptor);
+    if(not copyFileRangeFailed) {
+        cout << timestamp << "Copied " << inputPath << " to " << outputPath << endl;
+        return;
+    }
+    if(copiedByteCount > 0) {
+        throw runtime_error("Error copying " + inputPath + " to " + outputPath + ": " +
+            strerror(copyFileRangeErrno));
+    }
+    mappedCopy(inputPath, outputPath);
+}
+
+
+
+// Use snapshotCopy to copy all files in a directory
+// and its subdirectories to a new directory.
+void shasta::snapshotDirectory(
+    const string& inputDirectory,
+    const string& outputDirectory)
+{
+    if(not std::filesystem::is_directory(inputDirectory)) {
+        throw runtime_error(inputDirectory + " does not exist or is not a directory.");
+    }
+    if(std::filesystem::exists(outputDirectory)) {
+        throw runtime_error(outputDirectory + " already exists.");
+    }
+
+    const auto tBegin = std::chrono::steady_clock::now();
+    std::filesystem::create_directory(outputDirectory, inputDirectory);
+    for(const auto& entry: std::filesystem::recursive_directory_iterator(inputDirectory)) {
+        const std::filesystem::path outputPath =
+            std::filesystem::path(outputDirectory) /
+            entry.path().lexically_relative(inputDirectory);
+        if(entry.is_symlink()) {
+            std::filesystem::copy_symlink(entry.path(), outputPath);
+        } else if(entry.is_directory()) {
+            std::filesystem::create_directory(outputPath, entry.path());
+        } else if(entry.is_regular_file()) {
+            snapshotCopy(entry.path().string(), outputPath.string());
+            std::filesystem::permissions(outputPath, entry.status().permissions());
+            std::filesystem::last_write_time(outputPath, entry.last_write_time());
+        } else {
+            std::filesystem::copy(entry.path(), outputPath);
+        }
+    }
+    const auto tEnd = std::chrono::steady_clock::now();
+    const double tTotal = 1.e-9 * double((std::chrono::duration_cast<std::chrono::nanoseconds>(tEnd - tBegin)).count());
+    cout << timestamp << "Copied " << inputDirectory << " to " << outputDirectory <<
+        " in " << tTotal << " s." << endl;
+}
@@ -11,6 +11,26 @@ namespace shasta {
     void mappedCopy(
         const string& inputPath,
         const string& outputPath);
+
+    // Copy a file as cheaply as the filesystems allow.
+    // - If both files are on the same filesystem and it supports reflinks
+    //   (XFS, Btrfs), the copy shares the data blocks of the input file
+    //   (FICLONE ioctl). This is almost instantaneous regardless of file size,
+    //   and the blocks are only duplicated when one of the files is modified.
+    // - Otherwise, if the filesystems allow it, copy_file_range is used,
+    //   so the kernel does the copy without going through user space.
+    // - Otherwise (for example to or from the huge page filesystem)
+    //   the copy is done by mappedCopy.
+    void snapshotCopy(
+        const string& inputPath,
+        const string& outputPath);
+
+    // Use snapshotCopy to copy all files in a directory
+    // and its subdirectories to a new directory, which must not exist.
+    // Permissions and modification times are preserved.
+    void snapshotDirectory(
+        const string& inputDirectory,
+        const string& outputDirectory);
 }
 
 #endif
@@ -9,6 +9,8 @@
 #include "MarkerGraph.hpp"
 #include "Reads.hpp"
 #include "mode3.hpp"
+#include "parallelFor.hpp"
+#include "SpoaEnginePool.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 using namespace mode3;
@@ -21,13 +23,16 @@ using namespace mode3;
 
 // Standard library.
 #include "fstream.hpp"
+#include "memory.hpp"
+#include <thread>
 
 
 
 // Assemble sequence for an AssemblyPath.
 void AssemblyPath::assemble(
     const AssemblyGraph& assemblyGraph,
-    const Reads& reads)
+    const Reads& reads,
+    size_t threadCount)
 {
     const bool debug = false;
     if(debug) {
@@ -35,11 +40,11 @@ void AssemblyPath::assemble(
     }
 
     // Assemble each segment on the path.
-    assembleSegments(assemblyGraph, reads);
+    assembleSegments(assemblyGraph, reads, threadCount);
 
     // Assemble links in this assembly path.
     initializeLinks(assemblyGraph);
-    assembleLinks(assemblyGraph);
+    assembleLinks(assemblyGraph, threadCount);
 
     if(debug) {
         writeSegmentSequences();
@@ -113,7 +118,7 @@ void AssemblyPath::initializeLinks(const AssemblyGraph& assemblyGraph)
 
 
 // Assemble links in this assembly path.
-void AssemblyPath::assembleLinks(const AssemblyGraph& assemblyGraph)
+void AssemblyPath::assembleLinks(const AssemblyGraph& assemblyGraph, size_t threadCount)
 {
     const bool debug = false;
 
@@ -129,11 +134,47 @@ void AssemblyPath::assembleLinks(const AssemblyGraph& assemblyGraph)
         html.open("Msa.html");
     }
 
-    // Loop over links in the path.
     links.resize(segments.size()-1);
+
+    // The html output cannot be shared between threads.
+    if(html.is_open()) {
+        threadCount = 1;
+    }
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // The links are independent of each other. Each link only writes
+    // the rightTrim of its preceding segment and the leftTrim
+    // of its following segment, so they can be assembled in parallel.
+    // Process them in order of decreasing coverage, which is a proxy for the
+    // cost of the MSA, so the most expensive ones don't end up last.
+    vector< pair<uint64_t, uint64_t> > positionsByCoverage;   // (coverage, position)
     for(uint64_t position0=0; position0<links.size(); position0++) {
-        assembleLinkAtPosition(assemblyGraph, position0, html);
+        const AssemblyPathLink& link = links[position0];
+        positionsByCoverage.push_back(make_pair(
+            link.isTrivial ? 0 : assemblyGraph.transitions.size(link.id), position0));
     }
+    sort(positionsByCoverage.begin(), positionsByCoverage.end(),
+        std::greater< pair<uint64_t, uint64_t> >());
+
+    // Loop over links in the path.
+    // Each thread also gets its own (not open) html stream,
+    // because writing to a stream that is not open changes its state.
+    vector< unique_ptr<SpoaEnginePool> > spoaEnginePools(threadCount);
+    vector<ofstream> threadHtml(threadCount);
+    parallelForWithThreadId(positionsByCoverage.size(), 1, threadCount,
+        [&](size_t threadId, uint64_t begin, uint64_t end)
+        {
+            unique_ptr<SpoaEnginePool>& spoaEnginePool = spoaEnginePools[threadId];
+            if(not spoaEnginePool) {
+                spoaEnginePool = make_unique<SpoaEnginePool>();
+            }
+            for(uint64_t i=begin; i!=end; i++) {
+                assembleLinkAtPosition(assemblyGraph, positionsByCoverage[i].second, *spoaEnginePool,
+                    html.is_open() ? html : threadHtml[threadId]);
+            }
+        });
 }
 
 
@@ -141,6 +182,7 @@ void AssemblyPath::assembleLinks(const AssemblyGraph& assemblyGraph)
 void AssemblyPath::assembleLinkAtPosition(
     const AssemblyGraph& assemblyGraph,
     uint64_t position0,
+    SpoaEnginePool& spoaEnginePool,
     ostream& html)
 {
     const bool debug = false;
@@ -174,6 +216,7 @@ void AssemblyPath::assembleLinkAtPosition(
             segment0,
             segment1,
             link,
+            spoaEnginePool,
             html);
     }
 }
@@ -185,6 +228,7 @@ void AssemblyPath::assembleNonTrivialLink(
     AssemblyPathSegment& segment0,
     AssemblyPathSegment& segment1,
     AssemblyPathLink& link,
+    SpoaEnginePool& spoaEnginePool,
     ostream& html)
 {
     const bool debug = false;
@@ -349,6 +393,7 @@ void AssemblyPath::assembleNonTrivialLink(
         orientedReadsRepeatCountsForAssembly,
         assemblyGraph.readRepresentation,
         assemblyGraph.consensusCaller,
+        spoaEnginePool,
         debug,
         html,
         link.msaRleSequence,
@@ -453,20 +498,37 @@ void AssemblyPath::clear()
 
 
 // Assemble each segment on the path.
-void AssemblyPath::assembleSegments(const AssemblyGraph& assemblyGraph, const Reads& reads)
+void AssemblyPath::assembleSegments(
+    const AssemblyGraph& assemblyGraph,
+    const Reads& reads,
+    size_t threadCount)
 {
+    // Process the segments in order of decreasing path length,
+    // so the longest ones don't end up last.
+    vector< pair<uint64_t, uint64_t> > segmentsByPathLength;   // (path length, i)
     for(uint64_t i=0; i<segments.size(); i++) {
-        AssemblyPathSegment& segment = segments[i];
-        assembleMarkerGraphPath(
-            assemblyGraph.readRepresentation,
-            assemblyGraph.k,
-            reads,
-            assemblyGraph.markers,
-            assemblyGraph.markerGraph,
-            assemblyGraph.markerGraphPaths[segment.id],
-            false,
-            segment.assembledSegment);
+        segmentsByPathLength.push_back(make_pair(
+            assemblyGraph.markerGraphPaths.size(segments[i].id), i));
     }
+    sort(segmentsByPathLength.begin(), segmentsByPathLength.end(),
+        std::greater< pair<uint64_t, uint64_t> >());
+
+    parallelFor(segmentsByPathLength.size(), 1, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t j=begin; j!=end; j++) {
+                AssemblyPathSegment& segment = segments[segmentsByPathLength[j].second];
+                assembleMarkerGraphPath(
+                    assemblyGraph.readRepresentation,
+                    assemblyGraph.k,
+                    reads,
+                    assemblyGraph.markers,
+                    assemblyGraph.markerGraph,
+                    assemblyGraph.markerGraphPaths[segment.id],
+                    false,
+                    segment.assembledSegment);
+            }
+        });
 }
 
 
@@ -559,6 +621,7 @@ void AssemblyPath::computeLinkConsensusUsingSpoa(
     const vector< vector<uint32_t> > repeatCounts,
     uint64_t readRepresentation,
     const ConsensusCaller& consensusCaller,
+    SpoaEnginePool& spoaEnginePool,
     bool debug,
     ostream& html,
     vector<Base>& consensusRleSequence,
@@ -568,13 +631,14 @@ void AssemblyPath::computeLinkConsensusUsingSpoa(
     SHASTA_ASSERT(rleSequences.size() == orientedReadIds.size());
     SHASTA_ASSERT(repeatCounts.size() == orientedReadIds.size());
 
-    // Create the spoa alignment engine and elignment graph.
-    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
-    const int8_t match = 1;
-    const int8_t mismatch = -1;
-    const int8_t gap = -1;
-    auto spoaAlignmentEngine = spoa::AlignmentEngine::Create(alignmentType, match, mismatch, gap);
-    spoa::Graph spoaAlignmentGraph;
+    // Get the spoa alignment engine and alignment graph.
+    // They use the same parameters used before (kNW, match 1, mismatch -1, gap -1).
+    uint64_t maxSequenceLength = 0;
+    for(const vector<Base>& sequence: rleSequences) {
+        maxSequenceLength = max(maxSequenceLength, uint64_t(sequence.size()));
+    }
+    const auto& spoaAlignmentEngine = spoaEnginePool.getEngine(maxSequenceLength);
+    spoa::Graph& spoaAlignmentGraph = spoaEnginePool.getClearedGraph();
 
     // Add the oriented read sequences to the alignment.
     string sequenceString;
@@ -25,6 +25,7 @@ namespace shasta {
     class ConsensusCaller;
     class OrientedReadId;
     class Reads;
+    class SpoaEnginePool;
 }
 
 
@@ -136,10 +137,12 @@ public:
     vector<AssemblyPathLink> links;
 
     // Top level function to assemble sequence for this path.
-    void assemble(const AssemblyGraph&, const Reads&);
+    // Segments and links are assembled in parallel
+    // using the specified number of threads (0 = use all available).
+    void assemble(const AssemblyGraph&, const Reads&, size_t threadCount = 1);
 
     // Assemble the sequence of each segment.
-    void assembleSegments(const AssemblyGraph&, const Reads&);
+    void assembleSegments(const AssemblyGraph&, const Reads&, size_t threadCount = 1);
     void writeSegmentSequences();
 
     // Initialize the links.
@@ -151,10 +154,12 @@ public:
     void initializeLinks(const AssemblyGraph&);
 
     // Assemble links in this assembly path.
-    void assembleLinks(const AssemblyGraph&);
+    // Each thread uses its own SpoaEnginePool.
+    void assembleLinks(const AssemblyGraph&, size_t threadCount = 1);
     void assembleLinkAtPosition(
         const AssemblyGraph& assemblyGraph,
         uint64_t position0,
+        SpoaEnginePool&,
         ostream& html);
     static void assembleTrivialLink(
         AssemblyPathSegment& segment0,
@@ -166,6 +171,7 @@ public:
         AssemblyPathSegment& segment0,
         AssemblyPathSegment& segment1,
         AssemblyPathLink& link,
+        SpoaEnginePool&,
         ostream& html);
     void writeLinkSequences(const AssemblyGraph&);
 
@@ -184,6 +190,7 @@ public:
         const vector< vector<uint32_t> > repeatCounts,
         uint64_t readRepresentation,
         const ConsensusCaller&,
+        SpoaEnginePool&,
         bool debug,
         ostream& html,
         vector<Base>& consensusRleSequence,
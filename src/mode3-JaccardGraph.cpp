@@ -1,5 +1,6 @@
 #include "mode3-JaccardGraph.hpp"
 #include "deduplicate.hpp"
+#include "dset64-gccAtomic.hpp"
 #include "mode3.hpp"
 #include "orderPairs.hpp"
 #include "orderVectors.hpp"
@@ -14,11 +15,15 @@ using namespace mode3;
 // Standard library.
 #include "fstream.hpp"
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<mode3::JaccardGraph>;
+
 
 
 // Create a JaccardGraph with the given number of vertices
 // (one for each segment) and no edges.
-JaccardGraph::JaccardGraph(uint64_t segmentCount)
+JaccardGraph::JaccardGraph(uint64_t segmentCount) :
+    MultithreadedObject<JaccardGraph>(*this)
 {
     for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
         vertexTable.push_back(add_vertex(JaccardGraphVertex(segmentId), *this));
@@ -41,12 +46,18 @@ void AssemblyGraph::createJaccardGraph(
     jaccardGraphPointer = make_shared<JaccardGraph>(segmentCount);
     JaccardGraph& jaccardGraph = *jaccardGraphPointer;
 
+    // Gather oriented read information for all segments.
+    // Computing edges analyzes many segment pairs,
+    // and this way the information is computed only once for each segment.
+    storeSegmentOrientedReadInformation(threadCount);
+
     // Compute edges, in parallel.
     jaccardGraph.threadEdges.resize(threadCount);
     const uint64_t batchSize = 100;
     setupLoadBalancing(segmentCount, batchSize);
     runThreads(&AssemblyGraph::createJaccardGraphThreadFunction, threadCount);
     jaccardGraph.storeEdges();
+    segmentOrientedReadInformation.remove();
     jaccardGraph.writeGraphviz("JaccardGraph0.dot", false, false);
     jaccardGraph.writeGraphviz("JaccardGraph0-Labeled.dot", false, true);
     jaccardGraph.writeEdgesCsv("JaccardGraph0Edges.csv");
@@ -62,7 +73,7 @@ void AssemblyGraph::createJaccardGraph(
     jaccardGraph.writeEdgesCsv("JaccardGraph1Edges.csv");
 
     // Compute all connected components of size at least minComponentSize.
-    jaccardGraph.computeConnectedComponents(minComponentSize);
+    jaccardGraph.computeConnectedComponents(minComponentSize, threadCount);
 
     // Store the cluster id of each segment.
     // Each connected component of the Jaccard graph with sufficient size
@@ -129,8 +140,7 @@ void AssemblyGraph::createJaccardGraphEdges(
     // common oriented reads with primarySegmentId.
     // At each step, we choose the link that has the most common oriented
     // reads with the primarySegmentId.
-    SegmentOrientedReadInformation infoPrimary;
-    getOrientedReadsOnSegment(primarySegmentId, infoPrimary);
+    const auto infoPrimary = segmentOrientedReadInformation[primarySegmentId];
     JaccardGraphEdgeInfo edge;
     edge.direction = direction;
     uint64_t segmentId0 = primarySegmentId;
@@ -182,8 +192,7 @@ void AssemblyGraph::createJaccardGraphEdges(
         previousSegments.insert(segmentId1);
 
         // Check segmentId1 against the primary segment.
-        SegmentOrientedReadInformation info1;
-        getOrientedReadsOnSegment(segmentId1, info1);
+        const auto info1 = segmentOrientedReadInformation[segmentId1];
         if(direction == 0) {
             analyzeSegmentPair(
                     primarySegmentId, segmentId1,
@@ -224,24 +233,41 @@ void JaccardGraph::storeEdges()
 {
     JaccardGraph& jaccardGraph = *this;
 
+    // Sort the edges found by all threads, so the order in which they are added
+    // does not depend on the assignment of segments to threads.
+    // For a given direction there is at most one edge for each segment,
+    // so (segmentId0, segmentId1, direction) identifies an edge.
+    vector<const JaccardGraphEdgeInfo*> infos;
     for(const auto& threadEdges: threadEdges) {
         for(const JaccardGraphEdgeInfo& info: threadEdges) {
-
-            const uint64_t segmentId0 = info.segmentId0;
-            const uint64_t segmentId1 = info.segmentId1;
-            const JaccardGraph::vertex_descriptor v0 = vertexTable[segmentId0];
-            const JaccardGraph::vertex_descriptor v1 = vertexTable[segmentId1];
-
-            edge_descriptor e;
-            bool edgeExists = false;
-            tie(e, edgeExists) = boost::edge(v0, v1, jaccardGraph);
-            if(not edgeExists) {
-                boost::add_edge(v0, v1,
-                    JaccardGraphEdge(info.segmentPairInformation, info.direction, info.segmentIds),
-                    jaccardGraph);
-            } else {
-                jaccardGraph[e].wasFoundInDirection[info.direction] = true;
-            }
+            infos.push_back(&info);
+        }
+    }
+    sort(infos.begin(), infos.end(),
+        [](const JaccardGraphEdgeInfo* x, const JaccardGraphEdgeInfo* y)
+        {
+            return
+                tie(x->segmentId0, x->segmentId1, x->direction) <
+                tie(y->segmentId0, y->segmentId1, y->direction);
+        });
+
+    for(const JaccardGraphEdgeInfo* infoPointer: infos) {
+        const JaccardGraphEdgeInfo& info = *infoPointer;
+
+        const uint64_t segmentId0 = info.segmentId0;
+        const uint64_t segmentId1 = info.segmentId1;
+        const JaccardGraph::vertex_descriptor v0 = vertexTable[segmentId0];
+        const JaccardGraph::vertex_descriptor v1 = vertexTable[segmentId1];
+
+        edge_descriptor e;
+        bool edgeExists = false;
+        tie(e, edgeExists) = boost::edge(v0, v1, jaccardGraph);
+        if(not edgeExists) {
+            boost::add_edge(v0, v1,
+                JaccardGraphEdge(info.segmentPairInformation, info.direction, info.segmentIds),
+                jaccardGraph);
+        } else {
+            jaccardGraph[e].wasFoundInDirection[info.direction] = true;
         }
     }
     threadEdges.clear();
@@ -436,46 +462,67 @@ void JaccardGraph::writeEdgesCsv(ostream& csv) const
 
 // Compute all connected components of size at least minComponentSize.
 // They are stored in order of decreasing size.
-void JaccardGraph::computeConnectedComponents(uint64_t minComponentSize)
+void JaccardGraph::computeConnectedComponents(
+    uint64_t minComponentSize,
+    size_t threadCount)
 {
     const JaccardGraph& jaccardGraph = *this;
 
     // This must be called without removing any vertices.
     const uint64_t segmentCount = num_vertices(jaccardGraph);
-
-    // Compute connected components.
-    vector<uint64_t> rank(segmentCount);
-    vector<uint64_t> parent(segmentCount);
-    boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
-    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
-        disjointSets.make_set(segmentId);
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
     }
+
+    // Gather the segment pairs corresponding to the edges.
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    data.segmentPairs.clear();
     BGL_FORALL_EDGES(e, jaccardGraph, JaccardGraph) {
         const JaccardGraph::vertex_descriptor v0 = source(e, jaccardGraph);
         const JaccardGraph::vertex_descriptor v1 = target(e, jaccardGraph);
-        const uint64_t segmentId0 = jaccardGraph[v0].segmentId;
-        const uint64_t segmentId1 = jaccardGraph[v1].segmentId;
-        disjointSets.union_set(segmentId0, segmentId1);
+        data.segmentPairs.push_back({jaccardGraph[v0].segmentId, jaccardGraph[v1].segmentId});
     }
 
+    // Compute connected components, in parallel.
+    vector<DisjointSets::Aint> disjointSetsData(segmentCount);
+    data.disjointSetsPointer = make_shared<DisjointSets>(disjointSetsData.data(), segmentCount);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(data.segmentPairs.size(), batchSize);
+    runThreads(&JaccardGraph::computeConnectedComponentsThreadFunction1, threadCount);
+    data.componentIds.resize(segmentCount);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&JaccardGraph::computeConnectedComponentsThreadFunction2, threadCount);
+    data.segmentPairs.clear();
+    data.disjointSetsPointer = 0;
+
     // Gather the segments in each connected component.
+    // Each component is sorted by segmentId.
     vector< vector<uint64_t> > allComponents(segmentCount);
     for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
-        const uint64_t componentId = disjointSets.find_set(segmentId);
+        const uint64_t componentId = data.componentIds[segmentId];
         allComponents[componentId].push_back(segmentId);
     }
+    data.componentIds.clear();
 
     // Create a table of the components of size at least minComponentSize,
     // sorted by decreasing size.
+    // The component ids depend on the order of the parallel union-find operations,
+    // so components of the same size are ordered by their lowest segmentId.
     vector< pair<uint64_t, uint64_t> > componentTable; // pair(componentId, componentSize)
     for(uint64_t componentId=0; componentId<segmentCount; componentId++) {
         const uint64_t componentSize = allComponents[componentId].size();
-        if(componentSize >= minComponentSize) {
+        if(componentSize > 0 and componentSize >= minComponentSize) {
             componentTable.push_back(make_pair(componentId, componentSize));
         }
     }
     sort(componentTable.begin(), componentTable.end(),
-        OrderPairsBySecondOnlyGreater<uint64_t, uint64_t>());
+        [&allComponents](const pair<uint64_t, uint64_t>& x, const pair<uint64_t, uint64_t>& y)
+        {
+            if(x.second != y.second) {
+                return x.second > y.second;
+            }
+            return allComponents[x.first].front() < allComponents[y.first].front();
+        });
 
     // Store the connected components of size at least minComponentSize.
     components.clear();
@@ -514,6 +561,37 @@ void JaccardGraph::computeConnectedComponents(uint64_t minComponentSize)
 
 
 
+void JaccardGraph::computeConnectedComponentsThreadFunction1(size_t /* threadId */)
+{
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const auto& p = data.segmentPairs[i];
+            disjointSets.unite(p.first, p.second);
+        }
+    }
+}
+
+
+
+void JaccardGraph::computeConnectedComponentsThreadFunction2(size_t /* threadId */)
+{
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t segmentId=begin; segmentId!=end; segmentId++) {
+            data.componentIds[segmentId] = disjointSets.find(segmentId);
+        }
+    }
+}
+
+
+
 // Compute connected component and store the component
 // (define as a cluster) that each segment belongs to.
 void JaccardGraph::findClusters(
@@ -24,6 +24,7 @@ For the edge to be created, we also require one of the following:
 
 // Shasta.
 #include "mode3-SegmentPairInformation.hpp"
+#include "MultithreadedObject.hpp"
 
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
@@ -33,6 +34,7 @@ For the edge to be created, we also require one of the following:
 #include "cstdint.hpp"
 #include "iosfwd.hpp"
 #include <map>
+#include "memory.hpp"
 #include "string.hpp"
 #include "tuple.hpp"
 #include "utility.hpp"
@@ -62,8 +64,12 @@ namespace shasta {
     namespace MemoryMapped {
         template<class T> class Vector;
     }
+
+    extern template class MultithreadedObject<mode3::JaccardGraph>;
 }
 
+class DisjointSets;
+
 
 
 class shasta::mode3::JaccardGraphVertex {
@@ -127,7 +133,9 @@ public:
 
 
 
-class shasta::mode3::JaccardGraph : public JaccardGraphBaseClass {
+class shasta::mode3::JaccardGraph :
+    public JaccardGraphBaseClass,
+    public MultithreadedObject<JaccardGraph> {
 public:
 
     // Create a JaccardGraph with the given number of vertices
@@ -146,6 +154,8 @@ public:
     vector< vector<JaccardGraphEdgeInfo> > threadEdges;
 
     // Use the threadEdges to add edges to the graph.
+    // The edges are added in a deterministic order that does not depend
+    // on how segments were assigned to threads.
     void storeEdges();
 
     // A strong vertex is one that is incident to at least one strong edge.
@@ -175,8 +185,19 @@ public:
     // They are stored in order of decreasing size.
     // The vectors contain segmentIds. Use the vertexMap
     // to convert to file decriptors.
-    void computeConnectedComponents(uint64_t minComponentSize);
+    // Components of the same size are ordered by their lowest segmentId.
+    // The union-find operations run in parallel using the lock-free DisjointSets.
+    void computeConnectedComponents(uint64_t minComponentSize, size_t threadCount);
     vector< vector<uint64_t> > components;
+    class ComputeConnectedComponentsData {
+    public:
+        vector< pair<uint64_t, uint64_t> > segmentPairs;
+        shared_ptr<DisjointSets> disjointSetsPointer;
+        vector<uint64_t> componentIds;
+    };
+    ComputeConnectedComponentsData computeConnectedComponentsData;
+    void computeConnectedComponentsThreadFunction1(size_t threadId);
+    void computeConnectedComponentsThreadFunction2(size_t threadId);
 
     // Each stored connected component generates a cluster.
     void findClusters(
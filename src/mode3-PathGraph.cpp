@@ -3,6 +3,7 @@
 #include "findLinearChains.hpp"
 #include "MurmurHash2.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
 #include "transitiveReduction.hpp"
 using namespace shasta;
 using namespace mode3;
@@ -26,7 +27,7 @@ template class MultithreadedObject<mode3::PathGraph>;
 // Create the PathGraph from the AssemblyGraph.
 // Start with a single segment for each vertex
 // (that is, paths of length 1).
-PathGraph::PathGraph(const AssemblyGraph& assemblyGraph) :
+PathGraph::PathGraph(const AssemblyGraph& assemblyGraph, size_t threadCount) :
     MultithreadedObject<PathGraph>(*this),
     assemblyGraph(assemblyGraph)
 {
@@ -79,7 +80,7 @@ PathGraph::PathGraph(const AssemblyGraph& assemblyGraph) :
 
         // Detangle.
         vector<PathGraphVertex> newVertices;
-        detangle(newVertices);
+        detangle(newVertices, threadCount);
 
         // Recreate the vertices.
         clear();
@@ -964,8 +965,9 @@ template<uint64_t N> void PathGraph::detangleSubgraphTemplate(
         }
     }
     if(debug or unclusterVertexCount>0) {
-        cout << "Subgraph " << subgraphId << " has " << unclusterVertexCount <<
-            " unclustered snippets out of " << snippetCount << " total." << endl;
+        // Write the message in one piece, as subgraphs can be detangled in parallel.
+        cout << ("Subgraph " + to_string(subgraphId) + " has " + to_string(unclusterVertexCount) +
+            " unclustered snippets out of " + to_string(snippetCount) + " total.\n") << flush;
     }
 
 
@@ -1143,13 +1145,33 @@ template<uint64_t N> void PathGraph::detangleSubgraphTemplate(
 // Detangle all the subgraphs.
 // This does not modify the PathGraph.
 // Instead, it creates vertices to be used for next detangle iteration.
-void PathGraph::detangle(vector<PathGraphVertex>& allNewVertices) const
+// The subgraphs are disjoint and detangleSubgraph only reads the PathGraph,
+// so they are detangled in parallel, largest first.
+// The new vertices of each subgraph are stored separately, then
+// concatenated in order of subgraph id, so the result does not
+// depend on the number of threads.
+void PathGraph::detangle(vector<PathGraphVertex>& allNewVertices, size_t threadCount) const
 {
-    allNewVertices.clear();
-    vector<PathGraphVertex> newVertices;
+    vector< pair<uint64_t, uint64_t> > subgraphsBySize;   // (size, subgraphId)
     for(uint64_t subgraphId=0; subgraphId<subgraphs.size(); subgraphId++) {
-        detangleSubgraph(subgraphId, newVertices, false);
-        copy(newVertices.begin(), newVertices.end(), back_inserter(allNewVertices));
+        subgraphsBySize.push_back(make_pair(subgraphs[subgraphId].size(), subgraphId));
+    }
+    sort(subgraphsBySize.begin(), subgraphsBySize.end(),
+        std::greater< pair<uint64_t, uint64_t> >());
+
+    vector< vector<PathGraphVertex> > subgraphNewVertices(subgraphs.size());
+    parallelFor(subgraphsBySize.size(), 1, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const uint64_t subgraphId = subgraphsBySize[i].second;
+                detangleSubgraph(subgraphId, subgraphNewVertices[subgraphId], false);
+            }
+        });
+
+    allNewVertices.clear();
+    for(vector<PathGraphVertex>& newVertices: subgraphNewVertices) {
+        std::move(newVertices.begin(), newVertices.end(), back_inserter(allNewVertices));
     }
 }
 
@@ -166,7 +166,9 @@ class shasta::mode3::PathGraph :
 public:
 
     // Create the PathGraph from the AssemblyGraph.
-    PathGraph(const AssemblyGraph&);
+    // The subgraphs are detangled using the specified number of threads
+    // (0 = use all available).
+    PathGraph(const AssemblyGraph&, size_t threadCount);
 
     // This writes a GFA representation of the PathGraph,
     // with one GFA segment per vertex.
@@ -252,7 +254,7 @@ private:
     // Detangle all the subgraphs.
     // This does not modify the PathGraph.
     // Instead, it creates vertices to be used for next detangle iteration.
-    void detangle(vector<PathGraphVertex>& newVertices) const;
+    void detangle(vector<PathGraphVertex>& newVertices, size_t threadCount) const;
 
     // Given a PathGraphJourneySnippetCluster, find plausible
     // paths for it in the PathGraph.
@@ -9,6 +9,7 @@
 #include "mode3-AssemblyPath.hpp"
 #include "mode3-JaccardGraph.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
 #include "Reads.hpp"
 #include "ReadFlags.hpp"
 #include "mode3-SegmentPairInformation.hpp"
@@ -360,28 +361,24 @@ void AssemblyGraph::sortMarkerGraphJourneys(size_t threadId)
 
 // The assembly graph journey of an oriented read
 // is the sequence of segmentIds it encounters.
-void AssemblyGraph::computeAssemblyGraphJourneys()
+// This runs in parallel over oriented reads, in two passes.
+// Pass 1 computes the length of each assembly graph journey,
+// and pass 2 computes it again and stores it in place.
+void AssemblyGraph::computeAssemblyGraphJourneys(size_t threadCount)
 {
     const bool debug = true;
 
     // Initialize the assembly graph journeys.
     createNew(assemblyGraphJourneys, "Mode3-AssemblyGraphJourneys");
 
-    // Work vector defined outside the loop to reduce memory allocation overhead.
-    vector<AssemblyGraphJourneyEntry> assemblyGraphJourney;
-
-    // Loop over all oriented reads.
-    for(uint64_t i=0; i<markerGraphJourneys.size(); i++) {
-
-        // Access the marker graph journey for this oriented read.
-        const span<MarkerGraphJourneyEntry> markerGraphJourney = markerGraphJourneys[i];
-
-        // Compute the assembly graph journey.
-        computeAssemblyGraphJourney(markerGraphJourney, assemblyGraphJourney);
-
-        // Store it.
-        assemblyGraphJourneys.appendVector(assemblyGraphJourney);
-    }
+    const uint64_t batchSize = 1000;
+    assemblyGraphJourneys.beginPass1(markerGraphJourneys.size());
+    setupLoadBalancing(markerGraphJourneys.size(), batchSize);
+    runThreads(&AssemblyGraph::computeAssemblyGraphJourneysPass1, threadCount);
+    assemblyGraphJourneys.beginPass2();
+    setupLoadBalancing(markerGraphJourneys.size(), batchSize);
+    runThreads(&AssemblyGraph::computeAssemblyGraphJourneysPass2, threadCount);
+    assemblyGraphJourneys.endPass2(false);
 
 
 
@@ -438,6 +435,50 @@ void AssemblyGraph::computeAssemblyGraphJourneys()
 
 
 
+void AssemblyGraph::computeAssemblyGraphJourneysPass1(size_t threadId)
+{
+    computeAssemblyGraphJourneysPass12(1);
+}
+
+
+
+void AssemblyGraph::computeAssemblyGraphJourneysPass2(size_t threadId)
+{
+    computeAssemblyGraphJourneysPass12(2);
+}
+
+
+
+void AssemblyGraph::computeAssemblyGraphJourneysPass12(uint64_t pass)
+{
+    // Work vector defined outside the loop to reduce memory allocation overhead.
+    vector<AssemblyGraphJourneyEntry> assemblyGraphJourney;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t i=begin; i!=end; ++i) {
+
+            // Compute the assembly graph journey.
+            computeAssemblyGraphJourney(markerGraphJourneys[i], assemblyGraphJourney);
+
+            // Pass 1: store its length.
+            // Pass 2: store it.
+            if(pass == 1) {
+                assemblyGraphJourneys.incrementCount(i, assemblyGraphJourney.size());
+            } else {
+                const span<AssemblyGraphJourneyEntry> v = assemblyGraphJourneys[i];
+                SHASTA_ASSERT(v.size() == assemblyGraphJourney.size());
+                copy(assemblyGraphJourney.begin(), assemblyGraphJourney.end(), v.begin());
+            }
+        }
+    }
+}
+
+
+
 // Given the marker graph journey of an oriented read,
 // find the corresponding assembly graph journey.
 void AssemblyGraph::computeAssemblyGraphJourney(
@@ -554,26 +595,99 @@ bool AssemblyGraph::segmentContainsOrientedRead(
 
 
 
-void AssemblyGraph::findTransitions(std::map<SegmentPair, Transitions>& transitionMap)
+void AssemblyGraph::findTransitions(
+    size_t threadCount,
+    vector<TransitionInfo>& transitionInfos)
 {
-    transitionMap.clear();
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Each thread finds and sorts the transitions for the reads it processes.
+    FindTransitionsData& data = findTransitionsData;
+    data.transitionInfos.clear();
+    data.transitionInfos.resize(threadCount);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(assemblyGraphJourneys.size() / 2, batchSize);
+    runThreads(&AssemblyGraph::findTransitionsThreadFunction, threadCount);
+
+    // Merge the sorted vectors in pairs, in parallel,
+    // until there is only one left.
+    while(data.transitionInfos.size() > 1) {
+        const uint64_t mergeCount = (data.transitionInfos.size() + 1) / 2;
+        data.mergedTransitionInfos.clear();
+        data.mergedTransitionInfos.resize(mergeCount);
+        setupLoadBalancing(mergeCount, 1);
+        runThreads(&AssemblyGraph::findTransitionsMergeThreadFunction,
+            min(size_t(mergeCount), threadCount));
+        data.transitionInfos.swap(data.mergedTransitionInfos);
+    }
+    data.mergedTransitionInfos.clear();
+
+    transitionInfos.clear();
+    if(not data.transitionInfos.empty()) {
+        transitionInfos.swap(data.transitionInfos.front());
+    }
+    data.transitionInfos.clear();
+}
 
-    for(ReadId readId=0; readId<assemblyGraphJourneys.size()/2; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto journey = assemblyGraphJourneys[orientedReadId.getValue()];
 
-            for(uint64_t i=1; i<journey.size(); i++) {
-                const auto& previous = journey[i-1];
-                const auto& current = journey[i];
-                SHASTA_ASSERT(previous.segmentId != current.segmentId);
 
-                const SegmentPair segmentPair = make_pair(previous.segmentId, current.segmentId);
-                transitionMap[segmentPair].push_back(
-                    make_pair(orientedReadId, Transition({
-                    previous.markerGraphJourneyEntries[1],
-                    current.markerGraphJourneyEntries[0]})));
+void AssemblyGraph::findTransitionsThreadFunction(size_t threadId)
+{
+    vector<TransitionInfo>& transitionInfos = findTransitionsData.transitionInfos[threadId];
 
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            for(Strand strand=0; strand<2; strand++) {
+                const OrientedReadId orientedReadId(readId, strand);
+                const auto journey = assemblyGraphJourneys[orientedReadId.getValue()];
+
+                for(uint64_t i=1; i<journey.size(); i++) {
+                    const auto& previous = journey[i-1];
+                    const auto& current = journey[i];
+                    SHASTA_ASSERT(previous.segmentId != current.segmentId);
+
+                    TransitionInfo transitionInfo;
+                    transitionInfo.segmentPair = make_pair(previous.segmentId, current.segmentId);
+                    transitionInfo.orientedReadId = orientedReadId;
+                    transitionInfo.position = i;
+                    transitionInfo.transition = Transition({
+                        previous.markerGraphJourneyEntries[1],
+                        current.markerGraphJourneyEntries[0]});
+                    transitionInfos.push_back(transitionInfo);
+                }
+            }
+        }
+    }
+
+    sort(transitionInfos.begin(), transitionInfos.end());
+}
+
+
+
+// Each task merges a pair of consecutive sorted vectors.
+void AssemblyGraph::findTransitionsMergeThreadFunction(size_t /* threadId */)
+{
+    FindTransitionsData& data = findTransitionsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            vector<TransitionInfo>& merged = data.mergedTransitionInfos[i];
+            vector<TransitionInfo>& x = data.transitionInfos[2 * i];
+            if(2 * i + 1 == data.transitionInfos.size()) {
+                merged.swap(x);
+            } else {
+                vector<TransitionInfo>& y = data.transitionInfos[2 * i + 1];
+                merged.resize(x.size() + y.size());
+                std::merge(x.begin(), x.end(), y.begin(), y.end(), merged.begin());
+                x.clear();
+                x.shrink_to_fit();
+                y.clear();
+                y.shrink_to_fit();
             }
         }
     }
@@ -582,20 +696,32 @@ void AssemblyGraph::findTransitions(std::map<SegmentPair, Transitions>& transiti
 
 
 void AssemblyGraph::createLinks(
-    const std::map<SegmentPair, Transitions>& transitionMap,
+    const vector<TransitionInfo>& transitionInfos,
     uint64_t minCoverage)
 {
     createNew(links, "Mode3-Links");
     createNew(transitions, "Mode3-Transitions");
-    for(const auto& p: transitionMap) {
-        const auto& transitionVector = p.second;
-        const uint64_t coverage = transitionVector.size();
+
+    // The transitions are sorted by SegmentPair,
+    // so we can loop over streaks with the same SegmentPair.
+    for(auto streakBegin=transitionInfos.begin(); streakBegin!=transitionInfos.end(); /* Increment later */) {
+        const SegmentPair& segmentPair = streakBegin->segmentPair;
+        auto streakEnd = streakBegin + 1;
+        while(streakEnd != transitionInfos.end() and streakEnd->segmentPair == segmentPair) {
+            ++streakEnd;
+        }
+
+        const uint64_t coverage = streakEnd - streakBegin;
         if(coverage >= minCoverage) {
-            const uint64_t segmentId0 = p.first.first;
-            const uint64_t segmentId1 = p.first.second;
-            links.push_back(Link(segmentId0, segmentId1));
-            transitions.appendVector(transitionVector);
+            links.push_back(Link(segmentPair.first, segmentPair.second));
+            transitions.appendVector();
+            for(auto it=streakBegin; it!=streakEnd; ++it) {
+                transitions.append(make_pair(it->orientedReadId, it->transition));
+            }
         }
+
+        // Prepare to process the next streak.
+        streakBegin = streakEnd;
     }
 
     // Store link separation.
@@ -681,7 +807,7 @@ AssemblyGraph::AssemblyGraph(
     computeSegmentCoverage();
 
     // Assembled sequence for each segment.
-    assembleSegments();
+    assembleSegments(threadCount);
 
     // Keep track of the segment and position each marker graph edge corresponds to.
     computeMarkerGraphEdgeTable(threadCount);
@@ -689,17 +815,17 @@ AssemblyGraph::AssemblyGraph(
     // Compute marker graph and assembly graph journeys of all oriented reads.
     // We permanently store only the assembly graph journeys.
     computeMarkerGraphJourneys(threadCount);
-    computeAssemblyGraphJourneys();
+    computeAssemblyGraphJourneys(threadCount);
     markerGraphJourneys.remove();
     computeAssemblyGraphJourneyInfos();
 
     // Find transitions from segment to segment in the marker graph
-    // journeys of all oriented reads, and store them keyed by the pair of segments.
-    std::map<SegmentPair, Transitions> transitionMap;
-    findTransitions(transitionMap);
+    // journeys of all oriented reads, sorted by the pair of segments.
+    vector<TransitionInfo> transitionInfos;
+    findTransitions(threadCount, transitionInfos);
 
     // Create a links between pairs of segments with a sufficient number of transitions.
-    createLinks(transitionMap, minLinkCoverage);
+    createLinks(transitionInfos, minLinkCoverage);
     createConnectivity();
     flagBackSegments();
 
@@ -712,6 +838,7 @@ AssemblyGraph::AssemblyGraph(
 string AssemblyGraph::largeDataName(const string& name) const
 {
     if(largeDataFileNamePrefix.empty()) {
+        MemoryMapped::anonymousName = name;
         return "";  // Anonymous;
     } else {
         return largeDataFileNamePrefix + name;
@@ -981,45 +1108,43 @@ void AssemblyGraph::getOrientedReadsOnSegment(
     uint64_t segmentId,
     SegmentOrientedReadInformation& information) const
 {
-    // A data structure that, for each oriented read we find,
-    // contains a sum of offsets and the number of marker graph vertices
-    // that contributed to the sum.
-    std::map<OrientedReadId, pair<uint64_t, int64_t>  > table;
-
-    // Loop over the marker graph path corresponding to this segment.
+    // Gather pairs (orientedReadId, offset sum) for all the marker intervals
+    // on the marker graph path of this segment.
+    // Each marker interval contributes the offsets of its two markers.
+    vector< pair<OrientedReadId, int64_t> > offsets;
     const span<const MarkerGraphEdgeId> path = markerGraphPaths[segmentId];
-    std::set<OrientedReadId> orientedReadIds;
     for(uint64_t position=0; position<path.size(); position++) {
         const MarkerGraphEdgeId& edgeId = path[position];
 
         // Loop over the marker intervals for this marker graph edge.
         const span<const MarkerInterval> markerIntervals = markerGraph.edgeMarkerIntervals[edgeId];
         for(const MarkerInterval& markerInterval: markerIntervals) {
-            const OrientedReadId orientedReadId = markerInterval.orientedReadId;
-
-            // Update our table for this oriented read.
-            auto it = table.find(orientedReadId);
-            if(it == table.end()) {
-                tie(it, ignore) = table.insert(make_pair(orientedReadId, make_pair(0ULL, 0LL)));
-            }
-            auto& p = it->second;
-            p.first += 2;
-            p.second += int32_t(position) - int32_t(markerInterval.ordinals[0]);
-            p.second += int32_t(position + 1) -int32_t(markerInterval.ordinals[1]);
+            int64_t offset = int32_t(position) - int32_t(markerInterval.ordinals[0]);
+            offset += int32_t(position + 1) -int32_t(markerInterval.ordinals[1]);
+            offsets.push_back(make_pair(markerInterval.orientedReadId, offset));
         }
     }
+    sort(offsets.begin(), offsets.end(), OrderPairsByFirstOnly<OrientedReadId, int64_t>());
 
 
 
-    // Store what we found.
+    // Store what we found, combining the offsets for each oriented read.
     information.infos.clear();
-    for(const auto& p: table) {
+    for(auto streakBegin=offsets.begin(); streakBegin!=offsets.end(); /* Increment later */) {
+        const OrientedReadId orientedReadId = streakBegin->first;
+        int64_t sum = 0;
+        auto streakEnd = streakBegin;
+        for(; streakEnd!=offsets.end() and streakEnd->first==orientedReadId; ++streakEnd) {
+            sum += streakEnd->second;
+        }
+        const uint64_t n = 2 * (streakEnd - streakBegin);
+
         SegmentOrientedReadInformation::Info info;
-        info.orientedReadId = p.first;
-        const uint64_t n = p.second.first;
-        const int64_t sum = p.second.second;
+        info.orientedReadId = orientedReadId;
         info.averageOffset = int32_t(std::round(double(sum) / double(n)));
         information.infos.push_back(info);
+
+        streakBegin = streakEnd;
     }
  }
 
@@ -1040,15 +1165,30 @@ void AssemblyGraph::estimateOffset(
     int64_t& offset,
     uint64_t& commonOrientedReadCount
     ) const
+{
+    estimateOffset(
+        span<const SegmentOrientedReadInformation::Info>(info0.infos),
+        span<const SegmentOrientedReadInformation::Info>(info1.infos),
+        offset, commonOrientedReadCount);
+}
+
+
+
+void AssemblyGraph::estimateOffset(
+    span<const SegmentOrientedReadInformation::Info> infos0,
+    span<const SegmentOrientedReadInformation::Info> infos1,
+    int64_t& offset,
+    uint64_t& commonOrientedReadCount
+    ) const
 {
     offset = 0;
     commonOrientedReadCount = 0;
 
     // Joint loop over common oriented reads in the two segments.
-    const auto begin0 = info0.infos.begin();
-    const auto begin1 = info1.infos.begin();
-    const auto end0 = info0.infos.end();
-    const auto end1 = info1.infos.end();
+    const auto begin0 = infos0.begin();
+    const auto begin1 = infos1.begin();
+    const auto end0 = infos0.end();
+    const auto end1 = infos1.end();
     auto it0 = begin0;
     auto it1 = begin1;
     while((it0 != end0) and (it1 != end1)) {
@@ -1088,17 +1228,34 @@ void AssemblyGraph::analyzeSegmentPair(
     const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
     SegmentPairInformation& info01
     ) const
+{
+    analyzeSegmentPair(segmentId0, segmentId1,
+        span<const SegmentOrientedReadInformation::Info>(info0.infos),
+        span<const SegmentOrientedReadInformation::Info>(info1.infos),
+        markers, info01);
+}
+
+
+
+void AssemblyGraph::analyzeSegmentPair(
+    uint64_t segmentId0,
+    uint64_t segmentId1,
+    span<const SegmentOrientedReadInformation::Info> infos0,
+    span<const SegmentOrientedReadInformation::Info> infos1,
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    SegmentPairInformation& info01
+    ) const
 {
     using boost::icl::discrete_interval;
     using boost::icl::intersects;
 
     // Store the number of oriented reads in each segment.
-    info01.totalCount[0] = info0.infos.size();
-    info01.totalCount[1] = info1.infos.size();
+    info01.totalCount[0] = infos0.size();
+    info01.totalCount[1] = infos1.size();
 
     // Use common oriented reads to estimate the offset between the two segments.
     // If there are no common oriented reads, stop here.
-    estimateOffset(info0, info1, info01.offset, info01.commonCount);
+    estimateOffset(infos0, infos1, info01.offset, info01.commonCount);
     if(info01.commonCount == 0) {
         return;
     }
@@ -1111,10 +1268,10 @@ void AssemblyGraph::analyzeSegmentPair(
     info01.shortCount = {0, 0};
 
     // Set up a joint loop over oriented reads in the two segments.
-    const auto begin0 = info0.infos.begin();
-    const auto begin1 = info1.infos.begin();
-    const auto end0 = info0.infos.end();
-    const auto end1 = info1.infos.end();
+    const auto begin0 = infos0.begin();
+    const auto begin1 = infos1.begin();
+    const auto end0 = infos0.end();
+    const auto end1 = infos1.end();
     auto it0 = begin0;
     auto it1 = begin1;
 
@@ -1194,22 +1351,44 @@ void AssemblyGraph::analyzeSegmentPair(
 
 
 
-// Gather oriented read information for each segment.
+// Gather oriented read information for each segment,
+// in parallel and in two passes.
+// Pass 1 computes the number of oriented reads on each segment,
+// and pass 2 computes the information again and stores it in place.
 void AssemblyGraph::storeSegmentOrientedReadInformation(size_t threadCount)
 {
     const uint64_t segmentCount = markerGraphPaths.size();
-    segmentOrientedReadInformation.resize(segmentCount);
+    createNew(segmentOrientedReadInformation, "tmp-mode3-SegmentOrientedReadInformation");
+
     const uint64_t batchSize = 10;
+    segmentOrientedReadInformation.beginPass1(segmentCount);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::storeSegmentOrientedReadInformationPass1, threadCount);
+    segmentOrientedReadInformation.beginPass2();
     setupLoadBalancing(segmentCount, batchSize);
-    runThreads(&AssemblyGraph::storeSegmentOrientedReadInformationThreadFunction, threadCount);
+    runThreads(&AssemblyGraph::storeSegmentOrientedReadInformationPass2, threadCount);
+    segmentOrientedReadInformation.endPass2(false);
 }
 
 
 
+void AssemblyGraph::storeSegmentOrientedReadInformationPass1(size_t threadId)
+{
+    storeSegmentOrientedReadInformationPass12(1);
+}
+
+
 
-// Gather oriented read information for each segment.
-void AssemblyGraph::storeSegmentOrientedReadInformationThreadFunction(size_t threadId)
+void AssemblyGraph::storeSegmentOrientedReadInformationPass2(size_t threadId)
 {
+    storeSegmentOrientedReadInformationPass12(2);
+}
+
+
+
+void AssemblyGraph::storeSegmentOrientedReadInformationPass12(uint64_t pass)
+{
+    SegmentOrientedReadInformation information;
 
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
@@ -1219,7 +1398,17 @@ void AssemblyGraph::storeSegmentOrientedReadInformationThreadFunction(size_t thr
         for(uint64_t segmentId=begin; segmentId!=end; ++segmentId) {
 
             // Get oriented read information for this segment.
-            getOrientedReadsOnSegment(segmentId, segmentOrientedReadInformation[segmentId]);
+            getOrientedReadsOnSegment(segmentId, information);
+
+            // Pass 1: store the number of oriented reads.
+            // Pass 2: store the information.
+            if(pass == 1) {
+                segmentOrientedReadInformation.incrementCount(segmentId, information.infos.size());
+            } else {
+                const auto v = segmentOrientedReadInformation[segmentId];
+                SHASTA_ASSERT(v.size() == information.infos.size());
+                copy(information.infos.begin(), information.infos.end(), v.begin());
+            }
         }
     }
 }
@@ -1320,8 +1509,7 @@ void AssemblyGraph::clusterSegments(size_t threadCount, uint64_t minClusterSize)
     // Clean up.
     clusterSegmentsData.threadPairs.clear();
     clusterSegmentsData.threadPairs.shrink_to_fit();
-    segmentOrientedReadInformation.clear();
-    segmentOrientedReadInformation.shrink_to_fit();
+    segmentOrientedReadInformation.remove();
 }
 
 
@@ -2531,7 +2719,7 @@ void AssemblyGraph::targetedBfs(
 
 
 // Assemble the assembly paths stored in the JaccardGraph.
-void AssemblyGraph::assembleJaccardGraphPaths()
+void AssemblyGraph::assembleJaccardGraphPaths(size_t threadCount)
 {
     const JaccardGraph& jaccardGraph = *jaccardGraphPointer;
     ofstream fasta("JaccardGraphPaths.fasta");
@@ -2540,7 +2728,7 @@ void AssemblyGraph::assembleJaccardGraphPaths()
     for(uint64_t clusterId=0; clusterId<jaccardGraph.assemblyPaths.size(); clusterId++) {
         const vector<uint64_t>& primarySegments = jaccardGraph.assemblyPaths[clusterId];
         AssemblyPath assemblyPath;
-        assembleJaccardGraphPath(primarySegments, assemblyPath);
+        assembleJaccardGraphPath(primarySegments, assemblyPath, threadCount);
 
         const auto& sequence = assemblyPath.rawSequence;
         totalSequenceAssembled += sequence.size();
@@ -2555,7 +2743,8 @@ void AssemblyGraph::assembleJaccardGraphPaths()
 
 void AssemblyGraph::assembleJaccardGraphPath(
     const vector<uint64_t>& primarySegments,
-    AssemblyPath& assemblyPath)
+    AssemblyPath& assemblyPath,
+    size_t threadCount)
 {
     SHASTA_ASSERT(primarySegments.size() >= 2);
 
@@ -2599,7 +2788,7 @@ void AssemblyGraph::assembleJaccardGraphPath(
     }
 
     // Assemble sequence for this path.
-    assemblyPath.assemble(*this, reads);
+    assemblyPath.assemble(*this, reads, threadCount);
 
 }
 
@@ -2715,15 +2904,45 @@ void AssemblyGraph::createDeBruijnGraph() const
 
 
 
-void AssemblyGraph::assembleSegments()
+// The segments are assembled in parallel, in order of decreasing
+// path length, so the longest ones don't end up last.
+// The assembled sequences and vertex offsets are then stored
+// in order of segment id.
+void AssemblyGraph::assembleSegments(size_t threadCount)
 {
+    const uint64_t segmentCount = markerGraphPaths.size();
+
+    vector< pair<uint64_t, uint64_t> > segmentsByPathLength;   // (path length, segmentId)
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        segmentsByPathLength.push_back(make_pair(markerGraphPaths.size(segmentId), segmentId));
+    }
+    sort(segmentsByPathLength.begin(), segmentsByPathLength.end(),
+        std::greater< pair<uint64_t, uint64_t> >());
+
+    vector< vector<Base> > sequences(segmentCount);
+    vector< vector<uint32_t> > vertexOffsets(segmentCount);
+    parallelFor(segmentCount, 16, threadCount,
+        [&](uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const uint64_t segmentId = segmentsByPathLength[i].second;
+                assembleSegment(segmentId, sequences[segmentId], vertexOffsets[segmentId]);
+            }
+        });
+
     createNew(segmentSequences, "Mode3-SegmentSequences");
     createNew(segmentVertexOffsets, "Mode3-SegmentVertexOffsets");
-    for(uint64_t segmentId=0; segmentId<markerGraphPaths.size(); segmentId++) {
-        assembleSegment(segmentId);
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        segmentSequences.appendVector(sequences[segmentId]);
+        segmentVertexOffsets.appendVector(vertexOffsets[segmentId]);
+        vector<Base>().swap(sequences[segmentId]);
+        vector<uint32_t>().swap(vertexOffsets[segmentId]);
     }
 }
-void AssemblyGraph::assembleSegment(uint64_t segmentId)
+void AssemblyGraph::assembleSegment(
+    uint64_t segmentId,
+    vector<Base>& sequence,
+    vector<uint32_t>& vertexOffsets) const
 {
     // Assemble it.
     AssembledSegment assembledSegment;
@@ -2737,10 +2956,9 @@ void AssemblyGraph::assembleSegment(uint64_t segmentId)
         false,
         assembledSegment);
 
-    // Store assembled sequence and vertex offsets.
-    segmentSequences.appendVector(assembledSegment.rawSequence);
-    segmentVertexOffsets.appendVector(assembledSegment.vertexOffsets);
-
+    // Return assembled sequence and vertex offsets.
+    sequence.swap(assembledSegment.rawSequence);
+    vertexOffsets.swap(assembledSegment.vertexOffsets);
 }
 
 
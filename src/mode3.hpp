@@ -226,8 +226,11 @@ public:
     // When writing to gfa, we skip the first and last k/2 bases.
     MemoryMapped::VectorOfVectors<Base, uint64_t> segmentSequences;
     MemoryMapped::VectorOfVectors<uint32_t, uint64_t> segmentVertexOffsets; // Filled in by assembleSegment.
-    void assembleSegments();
-    void assembleSegment(uint64_t segmentId);
+    void assembleSegments(size_t threadCount);
+    void assembleSegment(
+        uint64_t segmentId,
+        vector<Base>& sequence,
+        vector<uint32_t>& vertexOffsets) const;
 
     // Keep track of the segment and position each marker graph edge corresponds to.
     // For each marker graph edge, store in the marker graph edge table
@@ -255,7 +258,10 @@ public:
     // The assembly graph journeys of all oriented reads.
     // Indexed by OrientedReadId::getValue().
     MemoryMapped::VectorOfVectors<AssemblyGraphJourneyEntry, uint64_t> assemblyGraphJourneys;
-    void computeAssemblyGraphJourneys();
+    void computeAssemblyGraphJourneys(size_t threadCount);
+    void computeAssemblyGraphJourneysPass1(size_t threadId);
+    void computeAssemblyGraphJourneysPass2(size_t threadId);
+    void computeAssemblyGraphJourneysPass12(uint64_t pass);
     void computeAssemblyGraphJourney(
         const span<MarkerGraphJourneyEntry> markerGraphJourney,
         vector<AssemblyGraphJourneyEntry>& assemblyGraphJourney);
@@ -286,8 +292,44 @@ public:
 
     using SegmentPair = pair<uint64_t, uint64_t>;
     using Transitions = vector< pair<OrientedReadId, Transition> >;
-    std::map<SegmentPair, Transitions> transitionMap;
-    void findTransitions(std::map<SegmentPair, Transitions>& transitionMap);
+
+    // A transition of an oriented read from a segment to the next.
+    // The position is the position in the assembly graph journey
+    // of the oriented read of the second segment of the SegmentPair.
+    // Sorting them by segment pair, then oriented read and position
+    // groups together the transitions of each pair of segments.
+    class TransitionInfo {
+    public:
+        SegmentPair segmentPair;
+        OrientedReadId orientedReadId;
+        uint64_t position;
+        Transition transition;
+
+        bool operator<(const TransitionInfo& that) const
+        {
+            return
+                tie(segmentPair, orientedReadId, position) <
+                tie(that.segmentPair, that.orientedReadId, that.position);
+        }
+    };
+
+    // Find transitions from segment to segment in the assembly graph
+    // journeys of all oriented reads, sorted.
+    // Each thread finds and sorts the transitions of the oriented reads
+    // it processes, and these sorted vectors are then merged in parallel.
+    void findTransitions(size_t threadCount, vector<TransitionInfo>&);
+    void findTransitionsThreadFunction(size_t threadId);
+    void findTransitionsMergeThreadFunction(size_t threadId);
+    class FindTransitionsData {
+    public:
+
+        // The sorted vectors to be merged.
+        vector< vector<TransitionInfo> > transitionInfos;
+
+        // The result of a round of pairwise merges.
+        vector< vector<TransitionInfo> > mergedTransitionInfos;
+    };
+    FindTransitionsData findTransitionsData;
 
 
 
@@ -317,7 +359,7 @@ public:
     };
     MemoryMapped::Vector<Link> links;
     void createLinks(
-        const std::map<SegmentPair, Transitions>& transitionMap,
+        const vector<TransitionInfo>&,
         uint64_t minCoverage);
 
     // The transitions for each link.
@@ -446,11 +488,18 @@ public:
         uint64_t segmentId,
         SegmentOrientedReadInformation&) const;
 
-    // Oriented read information for each segment.
-    // This is only stored when needed.
-    vector<SegmentOrientedReadInformation> segmentOrientedReadInformation;
+    // Oriented read information for each segment, stored as a sparse
+    // segment-by-oriented-read matrix in compressed row format:
+    // row segmentId contains the SegmentOrientedReadInformation::Info
+    // for that segment, sorted by OrientedReadId.
+    // This is only stored when needed, so the information for each segment
+    // is computed only once and not once for each segment pair it is used in.
+    MemoryMapped::VectorOfVectors<SegmentOrientedReadInformation::Info, uint64_t>
+        segmentOrientedReadInformation;
     void storeSegmentOrientedReadInformation(size_t threadCount);
-    void storeSegmentOrientedReadInformationThreadFunction(size_t threadId);
+    void storeSegmentOrientedReadInformationPass1(size_t threadId);
+    void storeSegmentOrientedReadInformationPass2(size_t threadId);
+    void storeSegmentOrientedReadInformationPass12(uint64_t pass);
 
 
 
@@ -469,6 +518,12 @@ public:
         int64_t& offset,
         uint64_t& commonOrientedReadCount
         ) const;
+    void estimateOffset(
+        span<const SegmentOrientedReadInformation::Info> infos0,
+        span<const SegmentOrientedReadInformation::Info> infos1,
+        int64_t& offset,
+        uint64_t& commonOrientedReadCount
+        ) const;
 
 
 
@@ -482,6 +537,14 @@ public:
         const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
         SegmentPairInformation&
         ) const;
+    void analyzeSegmentPair(
+        uint64_t segmentId0,
+        uint64_t segmentId1,
+        span<const SegmentOrientedReadInformation::Info> infos0,
+        span<const SegmentOrientedReadInformation::Info> infos1,
+        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        SegmentPairInformation&
+        ) const;
 
     // Count the number of common oriented reads between a segment and a link,
     // without counting oriented reads that appear more than once on the
@@ -694,8 +757,8 @@ public:
         vector<JaccardGraphEdgeInfo>& edges);
 
     // Assemble the assembly paths stored in the JaccardGraph.
-    void assembleJaccardGraphPaths();
-    void assembleJaccardGraphPath(const vector<uint64_t>& primarySegments, AssemblyPath&);
+    void assembleJaccardGraphPaths(size_t threadCount);
+    void assembleJaccardGraphPath(const vector<uint64_t>& primarySegments, AssemblyPath&, size_t threadCount);
 
     // De Bruijn graph of the assembly graph journeys of all oriented reads.
     // Each assembly graph journey is interpreted as a sequence of segment ids.
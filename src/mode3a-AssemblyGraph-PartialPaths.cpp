@@ -333,7 +333,7 @@ void AssemblyGraph::computePartialPath2(
     SHASTA_ASSERT(q.second - q.first == 1);
     const uint64_t ivStart = q.first - verticesEncountered.begin();
     std::map<uint64_t, uint64_t> predecessorMap;
-    shasta::lengauer_tarjan_dominator_tree(
+    shasta::cooper_harvey_kennedy_dominator_tree(
         graph,
         ivStart,
         boost::make_assoc_property_map(predecessorMap));
@@ -428,7 +428,7 @@ void AssemblyGraph::computePartialPath2(
     // To compute the backward partial path, compute the backward dominator tree of the graph,
     // with the start vertex as the entrance.
     predecessorMap.clear();
-    shasta::lengauer_tarjan_dominator_tree(
+    shasta::cooper_harvey_kennedy_dominator_tree(
         boost::make_reverse_graph(graph),
         ivStart,
         boost::make_assoc_property_map(predecessorMap));
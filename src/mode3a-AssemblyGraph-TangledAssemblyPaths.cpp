@@ -7,6 +7,8 @@
 #include "globalMsa.hpp"
 #include "invalid.hpp"
 #include "Marker.hpp"
+#include "orderPairs.hpp"
+#include "parallelFor.hpp"
 #include "Reads.hpp"
 using namespace shasta;
 using namespace mode3a;
@@ -972,7 +974,7 @@ bool AssemblyGraph::SecondaryVerticesGraph::computeDominatorTreePath()
 
     // Compute the dominator tree with v0 as the entrance.
     std::map<vertex_descriptor, vertex_descriptor> predecessorMap;
-    shasta::lengauer_tarjan_dominator_tree(
+    shasta::cooper_harvey_kennedy_dominator_tree(
         graph,
         iv0,
         boost::make_assoc_property_map(predecessorMap));
@@ -1219,11 +1221,30 @@ void AssemblyGraph::createFromAssemblyPaths(
 
 
 
-void AssemblyGraph::assemble()
+void AssemblyGraph::assemble(uint64_t threadCount)
 {
+    // Assemble the paths in parallel, largest first for better load balancing.
+    // Each thread writes its debug output to a separate file.
+    vector< pair<uint64_t, uint64_t> > pathTable;
     for(uint64_t pathId=0; pathId<assemblyPaths.size(); pathId++) {
-        assemble(pathId);
-    }
+        pathTable.push_back({pathId, assemblyPaths[pathId]->primaryVertices.size()});
+    }
+    sort(pathTable.begin(), pathTable.end(), OrderPairsBySecondOnlyGreater<uint64_t, uint64_t>());
+
+    const size_t actualThreadCount = parallelForDetail::getThreadCount(pathTable.size(), 1, threadCount);
+    const uint64_t msaThreadCount = (actualThreadCount == 1) ? 0 : 1;
+    vector< unique_ptr<ofstream> > debugOut(actualThreadCount);
+    parallelForWithThreadId(pathTable.size(), 1, actualThreadCount,
+        [&](size_t threadId, uint64_t begin, uint64_t end)
+        {
+            if(not debugOut[threadId]) {
+                debugOut[threadId] = make_unique<ofstream>(
+                    debugOutputPrefix + "Assemble-Thread" + to_string(threadId) + ".txt");
+            }
+            for(uint64_t i=begin; i!=end; ++i) {
+                assemble(pathTable[i].first, *debugOut[threadId], msaThreadCount);
+            }
+        });
 
     ofstream fasta("mode3a-Assembly.fasta");
     for(uint64_t pathId=0; pathId<assemblyPaths.size(); pathId++) {
@@ -1240,16 +1261,19 @@ void AssemblyGraph::assemble()
 
 
 
-void AssemblyGraph::assemble(uint64_t assemblyPathId)
+void AssemblyGraph::assemble(
+    uint64_t assemblyPathId,
+    ostream& debugOut,
+    uint64_t msaThreadCount)
 {
     const AssemblyGraph& assemblyGraph = *this;
     AssemblyPath& assemblyPath = *assemblyPaths[assemblyPathId];
 
     const bool debug = true;
     if(debug) {
-        cout << "Assembling path " << assemblyPathId << " with " <<
+        debugOut << "Assembling path " << assemblyPathId << " with " <<
             assemblyPath.primaryVertices.size() << " primary vertices." << endl;
-        cout << "Path begins at " << vertexStringId(assemblyPath.primaryVertices.front()) <<
+        debugOut << "Path begins at " << vertexStringId(assemblyPath.primaryVertices.front()) <<
             " and ends at " << vertexStringId(assemblyPath.primaryVertices.back()) << endl;
     }
 
@@ -1303,7 +1327,7 @@ void AssemblyGraph::assemble(uint64_t assemblyPathId)
     }
 
     if(debug) {
-        cout << "The FlattenedAssemblyPath has " << flattenedAssemblyPath.segments.size() <<
+        debugOut << "The FlattenedAssemblyPath has " << flattenedAssemblyPath.segments.size() <<
             " segments." << endl;
     }
 
@@ -1311,10 +1335,10 @@ void AssemblyGraph::assemble(uint64_t assemblyPathId)
     // Assemble it.
     // This fills in the fields in the segments and links that
     // were not initialized here.
-    assemble(flattenedAssemblyPath, assemblyPath.assembledSequence);
+    assemble(flattenedAssemblyPath, assemblyPath.assembledSequence, debugOut, msaThreadCount);
 
     if(debug) {
-        cout << "Assembled sequence length is " << assemblyPath.assembledSequence.size() << endl;
+        debugOut << "Assembled sequence length is " << assemblyPath.assembledSequence.size() << endl;
     }
 }
 
@@ -1331,7 +1355,9 @@ AssemblyGraph::FlattenedAssemblyPathLink::FlattenedAssemblyPathLink(edge_descrip
 // as specified by the FlattenedAssemblyPath.
 void AssemblyGraph::assemble(
     FlattenedAssemblyPath& flattenedAssemblyPath,
-    vector<shasta::Base>& sequence)
+    vector<shasta::Base>& sequence,
+    ostream& debugOut,
+    uint64_t msaThreadCount)
 {
     const AssemblyGraph& assemblyGraph = *this;
     const bool debug = true;
@@ -1350,13 +1376,13 @@ void AssemblyGraph::assemble(
         const auto& nextSegment = flattenedAssemblyPath.segments[i+1];
 
         if(debug) {
-            cout << "Assembling link at position " << i <<
+            debugOut << "Assembling link at position " << i <<
                 " between vertices " << vertexStringId(previousSegment.v) <<
                 " and " << vertexStringId(nextSegment.v) << endl;
 
         }
 
-        assembleLink(link, previousSegment, nextSegment);
+        assembleLink(link, previousSegment, nextSegment, debugOut, msaThreadCount);
     }
 
     // Except for special cases (see below), the entire sequence of each link is
@@ -1428,7 +1454,9 @@ void AssemblyGraph::assemble(
 void AssemblyGraph::assembleLink(
     FlattenedAssemblyPathLink& link,
     const FlattenedAssemblyPathSegment& segment0,
-    const FlattenedAssemblyPathSegment& segment1
+    const FlattenedAssemblyPathSegment& segment1,
+    ostream& debugOut,
+    uint64_t msaThreadCount
 ) const
 {
     const AssemblyGraph& assemblyGraph = *this;
@@ -1459,7 +1487,7 @@ void AssemblyGraph::assembleLink(
     SHASTA_ASSERT(not transitions.empty());
 
     if(debug) {
-        cout << "Link assembly will use " << transitions.size() <<
+        debugOut << "Link assembly will use " << transitions.size() <<
             " oriented reads." << endl;
     }
 
@@ -1568,25 +1596,25 @@ void AssemblyGraph::assembleLink(
     }
 
     if(debug) {
-        cout << "MSA sequences with coverage:" << endl;
+        debugOut << "MSA sequences with coverage:" << endl;
         for(const auto& p: msaSequences) {
             const vector<Base>& sequence = p.first;
             const uint64_t coverage = p.second;
-            copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(cout));
-            cout << " " << coverage << endl;
+            copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(debugOut));
+            debugOut << " " << coverage << endl;
         }
     }
 
     // Compute the multiple sequence alignment.
     vector<Base> consensusSequence;
     const uint64_t maxLength = 10000;
-    globalMsa(msaSequences, maxLength, packedMarkerGraph.k, consensusSequence);
+    globalMsa(msaSequences, maxLength, packedMarkerGraph.k, msaThreadCount, consensusSequence);
 
     if(debug) {
-        cout << "Consensus sequence has length " << consensusSequence.size() << ":\n";
+        debugOut << "Consensus sequence has length " << consensusSequence.size() << ":\n";
         copy(consensusSequence.begin(), consensusSequence.end(),
-            ostream_iterator<Base>(cout));
-        cout << "\n";
+            ostream_iterator<Base>(debugOut));
+        debugOut << "\n";
     }
 
     // Compute the number of bases at the beginning of the consensus sequence
@@ -1603,7 +1631,7 @@ void AssemblyGraph::assembleLink(
         }
     }
     if(debug) {
-        cout << "Number of link consensus bases identical to previous segment " << leftIdentical << "\n";
+        debugOut << "Number of link consensus bases identical to previous segment " << leftIdentical << "\n";
     }
 
     // Compute the number of bases at the end of the consensus sequence
@@ -1624,7 +1652,7 @@ void AssemblyGraph::assembleLink(
         }
     }
     if(debug) {
-        cout << "Number of link consensus bases identical to next segment " << rightIdentical << "\n";
+        debugOut << "Number of link consensus bases identical to next segment " << rightIdentical << "\n";
     }
 
 
@@ -1670,23 +1698,23 @@ void AssemblyGraph::assembleLink(
 
 
     if(debug) {
-        cout << "After trimming sequence identical to adjacent segments, "
+        debugOut << "After trimming sequence identical to adjacent segments, "
             "consensus sequence has length " << consensusSequence.size() << ":\n";
         copy(consensusSequence.begin(), consensusSequence.end(),
-            ostream_iterator<Base>(cout));
-        cout << "\n";
-        cout << "Number of previous segment bases overridden by link consensus:" << link.leftOverride << "\n";
-        cout << "Number of next segment bases overridden by link consensus:" << link.rightOverride << "\n";
+            ostream_iterator<Base>(debugOut));
+        debugOut << "\n";
+        debugOut << "Number of previous segment bases overridden by link consensus:" << link.leftOverride << "\n";
+        debugOut << "Number of next segment bases overridden by link consensus:" << link.rightOverride << "\n";
 
 
-        cout << "Assembly of the path consisting of this link plus the adjacent segments:\n";
+        debugOut << "Assembly of the path consisting of this link plus the adjacent segments:\n";
         copy(leftSegmentSequence.begin(), leftSegmentSequence.end() - link.leftOverride,
-            ostream_iterator<Base>(cout));
+            ostream_iterator<Base>(debugOut));
         copy(consensusSequence.begin(), consensusSequence.end(),
-            ostream_iterator<Base>(cout));
+            ostream_iterator<Base>(debugOut));
         copy(rightSegmentSequence.begin()+ link.rightOverride, rightSegmentSequence.end(),
-            ostream_iterator<Base>(cout));
-        cout << "\n";
+            ostream_iterator<Base>(debugOut));
+        debugOut << "\n";
     }
 }
 
@@ -5,6 +5,7 @@
 #include "mode3a-PackedMarkerGraph.hpp"
 #include "deduplicate.hpp"
 #include "orderPairs.hpp"
+#include "parallelFor.hpp"
 #include "shastaLapack.hpp"
 using namespace shasta;
 using namespace mode3a;
@@ -17,6 +18,7 @@ using namespace mode3a;
 
 // Standard library.
 #include "fstream.hpp"
+#include <set>
 
 // Explicit instantiation.
 #include "MultithreadedObject.tpp"
@@ -59,11 +61,12 @@ void AssemblyGraph::createSegmentsAndJourneys()
         const OrientedReadId orientedReadId = OrientedReadId::fromValue(ReadId(i));
         const auto packedMarkerGraphJourney = packedMarkerGraph.journeys[i];
         auto& journey = journeys[i];
-        for(uint64_t position=0; position<packedMarkerGraphJourney.size(); position++) {
-            const uint64_t segmentId = packedMarkerGraphJourney[position].segmentId;
-            const vertex_descriptor v = verticesBySegment[segmentId].front();
+        journey.reserve(packedMarkerGraphJourney.size());
+        uint64_t position = 0;
+        for(const PackedMarkerGraph::JourneyStep& journeyStep: packedMarkerGraphJourney) {
+            const vertex_descriptor v = verticesBySegment[journeyStep.segmentId].front();
             journey.push_back(v);
-            assemblyGraph[v].journeyEntries.push_back({orientedReadId, position});
+            assemblyGraph[v].journeyEntries.push_back({orientedReadId, position++});
         }
     }
 }
@@ -320,33 +323,77 @@ void AssemblyGraph::writeGfa(const string& name, uint64_t minLinkCoverage) const
 
 void AssemblyGraph::simpleDetangle(
     uint64_t minLinkCoverage,
-    uint64_t minTangleCoverage)
+    uint64_t minTangleCoverage,
+    uint64_t threadCount)
 {
     AssemblyGraph& assemblyGraph = *this;
 
-    vector<vertex_descriptor> allVertices;
+    vector<vertex_descriptor> candidates;
     BGL_FORALL_VERTICES(v, assemblyGraph, AssemblyGraph) {
-        allVertices.push_back(v);
+        candidates.push_back(v);
     }
-    for(const vertex_descriptor v: allVertices) {
-        simpleDetangle(v, minLinkCoverage, minTangleCoverage);
+
+    // Work in rounds. In each round, the candidate vertices are
+    // evaluated in parallel without modifying the graph.
+    // The resulting plans are then committed serially, in candidate order.
+    // Committing a plan for v1 changes the journeys of the vertices
+    // adjacent to v1, so a plan for an adjacent vertex computed
+    // in the same round is stale. Those vertices are evaluated
+    // again in the next round.
+    vector<SimpleDetanglePlan> plans;
+    std::set<vertex_descriptor> modifiedVertices;
+    vector<vertex_descriptor> nextCandidates;
+    while(not candidates.empty()) {
+        plans.clear();
+        plans.resize(candidates.size());
+        parallelFor(candidates.size(), 64, threadCount,
+            [&](uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; ++i) {
+                    simpleDetangleEvaluate(candidates[i], minLinkCoverage, minTangleCoverage, plans[i]);
+                }
+            });
+
+        modifiedVertices.clear();
+        nextCandidates.clear();
+        for(uint64_t i=0; i<candidates.size(); i++) {
+            const vertex_descriptor v1 = candidates[i];
+            const SimpleDetanglePlan& plan = plans[i];
+            if(modifiedVertices.contains(v1)) {
+                nextCandidates.push_back(v1);
+                continue;
+            }
+            if(not plan.isActive) {
+                continue;
+            }
+            for(const auto& v02: plan.adjacentVertices) {
+                modifiedVertices.insert(v02.first);
+                modifiedVertices.insert(v02.second);
+            }
+            simpleDetangleCommit(v1, plan);
+        }
+        candidates.swap(nextCandidates);
     }
 }
 
 
 
-void AssemblyGraph::simpleDetangle(
+// Evaluate simple detangling of a vertex, without modifying the graph.
+// On return, plan.isActive is true if the vertex should be detangled.
+void AssemblyGraph::simpleDetangleEvaluate(
     vertex_descriptor v1,
     uint64_t minLinkCoverage,
-    uint64_t minTangleCoverage)
+    uint64_t minTangleCoverage,
+    SimpleDetanglePlan& plan) const
 {
     const bool debug = false;
 
-    AssemblyGraph& assemblyGraph = *this;
+    const AssemblyGraph& assemblyGraph = *this;
     const AssemblyGraphVertex& vertex1 = assemblyGraph[v1];
+    plan.isActive = false;
 
     // Find adjacent vertices by following the reads.
-    vector< pair<vertex_descriptor, vertex_descriptor> > adjacentVertices;
+    vector< pair<vertex_descriptor, vertex_descriptor> >& adjacentVertices = plan.adjacentVertices;
     findAdjacentVertices(v1, adjacentVertices);
 
     // Group them.
@@ -418,7 +465,8 @@ void AssemblyGraph::simpleDetangle(
     // These are called the "active pairs" here.
     // They are the ones for which map02 contains at least
     // minTangleCoverage entries.
-    vector< pair<vertex_descriptor, vertex_descriptor> > activePairs;
+    vector< pair<vertex_descriptor, vertex_descriptor> >& activePairs = plan.activePairs;
+    activePairs.clear();
     for(const auto& p: map02) {
         const auto& v02 = p.first;
         const vertex_descriptor v0 = v02.first;
@@ -427,8 +475,23 @@ void AssemblyGraph::simpleDetangle(
             activePairs.push_back(v02);
         }
     }
+    plan.isActive = true;
+}
 
 
+
+// Detangle a vertex using a plan computed by simpleDetangleEvaluate.
+void AssemblyGraph::simpleDetangleCommit(
+    vertex_descriptor v1,
+    const SimpleDetanglePlan& plan)
+{
+    const bool debug = false;
+
+    AssemblyGraph& assemblyGraph = *this;
+    const AssemblyGraphVertex& vertex1 = assemblyGraph[v1];
+    const auto& adjacentVertices = plan.adjacentVertices;
+    const auto& activePairs = plan.activePairs;
+
     // Each active pair generates a new vertex with the same segmentId as v1.
     vector<vertex_descriptor> newVertices;
     const uint64_t segmentId1 = vertex1.segmentId;
@@ -1050,7 +1113,7 @@ void AssemblyGraph::computeJaccardGraph(
 
     // Compute connected components so we can process them one at a time.
     vector< shared_ptr<JaccardGraph> > components;
-    jaccardGraph.computeConnectedComponents(minComponentSize, components);
+    jaccardGraph.computeConnectedComponents(minComponentSize, components, threadCount);
 
 
 
@@ -1223,12 +1286,22 @@ void AssemblyGraph::computeJaccardPairs(uint64_t threadCount, double minJaccard)
     runThreads(&AssemblyGraph::computeJaccardPairsThreadFunction, threadCount);
 
     // Consolidate the good pairs found by all threads.
-    computeJaccardGraphData.goodPairs.clear();
+    // Sort them by candidate pair index, so the order does not depend
+    // on the assignment of candidate pairs to threads,
+    // and the edges of the Jaccard graph are created in a deterministic order.
+    vector< pair<uint64_t, double> > goodPairs;
     for(uint64_t threadId=0; threadId<threadCount; threadId++) {
         const auto& v = computeJaccardGraphData.threadGoodPairs[threadId];
-        copy(v.begin(), v.end(), back_inserter(computeJaccardGraphData.goodPairs));
+        copy(v.begin(), v.end(), back_inserter(goodPairs));
     }
     computeJaccardGraphData.threadGoodPairs.clear();
+    sort(goodPairs.begin(), goodPairs.end(), OrderPairsByFirstOnly<uint64_t, double>());
+    computeJaccardGraphData.goodPairs.clear();
+    computeJaccardGraphData.goodPairs.reserve(goodPairs.size());
+    for(const auto& p: goodPairs) {
+        computeJaccardGraphData.goodPairs.push_back(
+            make_pair(computeJaccardGraphData.candidatePairs[p.first], p.second));
+    }
     cout << "Found " << computeJaccardGraphData.goodPairs.size() <<
         " good pairs for the Jaccard graph." << endl;
 }
@@ -1249,7 +1322,7 @@ void AssemblyGraph::computeJaccardPairsThreadFunction(uint64_t threadId)
             const auto& p = computeJaccardGraphData.candidatePairs[i];
             const double jaccard = computeJaccard(p.first, p.second, commonOrientedReadIds);
             if(jaccard >= minJaccard) {
-                computeJaccardGraphData.threadGoodPairs[threadId].push_back(make_pair(p, jaccard));
+                computeJaccardGraphData.threadGoodPairs[threadId].push_back(make_pair(i, jaccard));
             }
         }
     }
@@ -61,6 +61,11 @@ public:
 
     // The position in the journey for this oriented read.
     uint64_t position;
+
+    bool operator==(const JourneyEntry& that) const
+    {
+        return orientedReadId == that.orientedReadId and position == that.position;
+    }
 };
 
 
@@ -256,15 +261,27 @@ private:
 
     // Simple detangling, one vertex at a time, looking only
     // at immediate parent and children.
+    // Vertices are evaluated in parallel and detangled serially.
 public:
     void simpleDetangle(
         uint64_t minLinkCoverage,
-        uint64_t minTangleCoverage);
+        uint64_t minTangleCoverage,
+        uint64_t threadCount);
 private:
-    void simpleDetangle(
+    class SimpleDetanglePlan {
+    public:
+        bool isActive = false;
+        vector< pair<vertex_descriptor, vertex_descriptor> > adjacentVertices;
+        vector< pair<vertex_descriptor, vertex_descriptor> > activePairs;
+    };
+    void simpleDetangleEvaluate(
         vertex_descriptor,
         uint64_t minLinkCoverage,
-        uint64_t minTangleCoverage);
+        uint64_t minTangleCoverage,
+        SimpleDetanglePlan&) const;
+    void simpleDetangleCommit(
+        vertex_descriptor,
+        const SimpleDetanglePlan&);
 
     // Find the previous and next vertex for each JourneyEntry in a given vertex.
     // On return, adjacentVertices contains a pair of vertex descriptors for
@@ -525,15 +542,25 @@ public:
 
 
     // Use the AssemblyPaths to assemble sequence.
-    void assemble();
-    void assemble(uint64_t assemblyPathId);
+    // The paths are assembled in parallel. Debug output
+    // goes to one file per thread.
+    // If more than one thread is used, each MSA is computed single threaded.
+    void assemble(uint64_t threadCount);
+    void assemble(
+        uint64_t assemblyPathId,
+        ostream& debugOut,
+        uint64_t msaThreadCount);
     void assemble(
         FlattenedAssemblyPath&,
-        vector<shasta::Base>& sequence);
+        vector<shasta::Base>& sequence,
+        ostream& debugOut,
+        uint64_t msaThreadCount);
     void assembleLink(
         FlattenedAssemblyPathLink&,
         const FlattenedAssemblyPathSegment& previousSegment,
-        const FlattenedAssemblyPathSegment& nextSegment
+        const FlattenedAssemblyPathSegment& nextSegment,
+        ostream& debugOut,
+        uint64_t msaThreadCount
     ) const;
 
     // Find the Transitions to be used to assemble a link.
@@ -735,8 +762,9 @@ private:
         // The consolidated and deduplicated candidate pairs.
         vector<VertexPair> candidatePairs;
 
-        // The good pairs found by each thread.
-        vector< vector<pair<VertexPair, double> > > threadGoodPairs;
+        // The good pairs found by each thread, each stored
+        // with its index in candidatePairs.
+        vector< vector<pair<uint64_t, double> > > threadGoodPairs;
 
         // The consolidated and deduplicated good pairs.
         vector< pair<VertexPair, double> > goodPairs;
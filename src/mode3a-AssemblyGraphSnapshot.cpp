@@ -18,43 +18,126 @@ using namespace mode3a;
 // Standard library.
 #include "algorithm.hpp"
 #include "fstream.hpp"
+#include "memory.hpp"
 
 
 
 // This creates a snapshot of the AssemblyGraph in the current state.
+// If a parent snapshot is specified, this creates a delta snapshot.
 AssemblyGraphSnapshot::AssemblyGraphSnapshot(
     const AssemblyGraph& assemblyGraph,
     const string& name,
-    const MappedMemoryOwner& mappedMemoryOwner) :
+    const MappedMemoryOwner& mappedMemoryOwner,
+    const AssemblyGraphSnapshot* parent) :
     MappedMemoryOwner(mappedMemoryOwner),
     name(name),
     packedMarkerGraph(assemblyGraph.packedMarkerGraph)
 {
-    // Store the segments.
-    createNew(vertexVector, name + "-vertices");
-    createNew(vertexJourneyEntries, name + "-vertexJourneyEntries");
+    if(parent) {
+        SHASTA_ASSERT(parent->name != name);
+        parentName = parent->name;
+    }
+    storeParentName();
+
+    // Assign vertex ids. For a delta snapshot, each vertex keeps
+    // the id of the parent vertex with the same segmentId
+    // and segmentReplicaIndex, if possible.
+    vector<AssemblyGraph::vertex_descriptor> verticesById;
     std::map<AssemblyGraph::vertex_descriptor, uint64_t> vertexMap;
-    BGL_FORALL_VERTICES(v, assemblyGraph, AssemblyGraph) {
+    {
+        vector<AssemblyGraph::vertex_descriptor> assemblyGraphVertices;
+        vector<uint64_t> parentVertexIds;
+        BGL_FORALL_VERTICES(v, assemblyGraph, AssemblyGraph) {
+            const AssemblyGraphVertex& vertex = assemblyGraph[v];
+            assemblyGraphVertices.push_back(v);
+            parentVertexIds.push_back(parent ?
+                parent->getVertexId(vertex.segmentId, vertex.segmentReplicaIndex) :
+                invalid<uint64_t>);
+        }
+        vector<uint64_t> vertexIds;
+        assignIds(parentVertexIds, vertexIds);
+        verticesById.resize(assemblyGraphVertices.size());
+        for(uint64_t i=0; i<assemblyGraphVertices.size(); i++) {
+            verticesById[vertexIds[i]] = assemblyGraphVertices[i];
+            vertexMap.insert(make_pair(assemblyGraphVertices[i], vertexIds[i]));
+        }
+    }
+
+    // Assign edge ids. For a delta snapshot, each edge keeps the id
+    // of a parent edge between the same two vertices, if possible.
+    vector<AssemblyGraph::edge_descriptor> edgesById;
+    std::map<AssemblyGraph::edge_descriptor, uint64_t> edgeMap;
+    {
+        // The parent edges, keyed by the ids of their vertices in this snapshot.
+        // The edges for each key are stored in decreasing order of parent edge id.
+        std::map< pair<uint64_t, uint64_t>, vector<uint64_t> > parentEdgeTable;
+        if(parent) {
+            vector<uint64_t> vertexIdsFromParent(parent->vertexVector.size(), invalid<uint64_t>);
+            for(uint64_t vertexId=0; vertexId<verticesById.size(); vertexId++) {
+                const AssemblyGraphVertex& vertex = assemblyGraph[verticesById[vertexId]];
+                const uint64_t parentVertexId =
+                    parent->getVertexId(vertex.segmentId, vertex.segmentReplicaIndex);
+                if(parentVertexId != invalid<uint64_t>) {
+                    vertexIdsFromParent[parentVertexId] = vertexId;
+                }
+            }
+            for(uint64_t parentEdgeId=parent->edgeVector.size(); parentEdgeId>0; ) {
+                --parentEdgeId;
+                const Edge& parentEdge = parent->edgeVector[parentEdgeId];
+                const uint64_t vertexId0 = vertexIdsFromParent[parentEdge.vertexId0];
+                const uint64_t vertexId1 = vertexIdsFromParent[parentEdge.vertexId1];
+                if(vertexId0 != invalid<uint64_t> and vertexId1 != invalid<uint64_t>) {
+                    parentEdgeTable[make_pair(vertexId0, vertexId1)].push_back(parentEdgeId);
+                }
+            }
+        }
+
+        vector<AssemblyGraph::edge_descriptor> assemblyGraphEdges;
+        vector<uint64_t> parentEdgeIds;
+        BGL_FORALL_EDGES(e, assemblyGraph, AssemblyGraph) {
+            assemblyGraphEdges.push_back(e);
+            uint64_t parentEdgeId = invalid<uint64_t>;
+            const uint64_t vertexId0 = vertexMap[source(e, assemblyGraph)];
+            const uint64_t vertexId1 = vertexMap[target(e, assemblyGraph)];
+            auto it = parentEdgeTable.find(make_pair(vertexId0, vertexId1));
+            if(it != parentEdgeTable.end() and not it->second.empty()) {
+                parentEdgeId = it->second.back();
+                it->second.pop_back();
+            }
+            parentEdgeIds.push_back(parentEdgeId);
+        }
+        vector<uint64_t> edgeIds;
+        assignIds(parentEdgeIds, edgeIds);
+        edgesById.resize(assemblyGraphEdges.size());
+        for(uint64_t i=0; i<assemblyGraphEdges.size(); i++) {
+            edgesById[edgeIds[i]] = assemblyGraphEdges[i];
+            edgeMap.insert(make_pair(assemblyGraphEdges[i], edgeIds[i]));
+        }
+    }
+
+
+
+    // Store the segments.
+    createStorage(vertexVector, "-vertices");
+    createStorage(vertexJourneyEntries, "-vertexJourneyEntries");
+    for(const AssemblyGraph::vertex_descriptor v: verticesById) {
         const AssemblyGraphVertex& assemblyGraphVertex = assemblyGraph[v];
-        vertexMap.insert(make_pair(v, vertexVector.size()));
         vertexVector.push_back(Vertex(assemblyGraphVertex));
         vertexJourneyEntries.appendVector(assemblyGraphVertex.journeyEntries);
     }
 
     // Store the edges.
-    createNew(edgeVector, name + "-edges");
-    std::map<AssemblyGraph::edge_descriptor, uint64_t> edgeMap;
-    BGL_FORALL_EDGES(e, assemblyGraph, AssemblyGraph) {
+    createStorage(edgeVector, "-edges");
+    for(const AssemblyGraph::edge_descriptor e: edgesById) {
         const AssemblyGraph::vertex_descriptor v0 = source(e, assemblyGraph);
         const AssemblyGraph::vertex_descriptor v1 = target(e, assemblyGraph);
-        edgeMap.insert(make_pair(e, edgeVector.size()));
         edgeVector.push_back({vertexMap[v0], vertexMap[v1]});
     }
 
 
 
     // Copy the journeys to the snapshot.
-    createNew(journeys, name + "-journeys");
+    createStorage(journeys, "-journeys");
     for(uint64_t i=0; i<assemblyGraph.journeys.size(); i++) {
         const vector<AssemblyGraph::vertex_descriptor>& assemblyGraphJourney = assemblyGraph.journeys[i];
         journeys.appendVector();
@@ -71,15 +154,15 @@ AssemblyGraphSnapshot::AssemblyGraphSnapshot(
 
 
     // Compute connectivity.
-    createNew(edgesBySource, name + "-edgesBySource");
-    BGL_FORALL_VERTICES(v, assemblyGraph, AssemblyGraph) {
+    createStorage(edgesBySource, "-edgesBySource");
+    for(const AssemblyGraph::vertex_descriptor v: verticesById) {
         edgesBySource.appendVector();
         BGL_FORALL_OUTEDGES(v, e, assemblyGraph, AssemblyGraph) {
             edgesBySource.append(edgeMap[e]);
         }
     }
-    createNew(edgesByTarget, name + "-edgesByTarget");
-    BGL_FORALL_VERTICES(v, assemblyGraph, AssemblyGraph) {
+    createStorage(edgesByTarget, "-edgesByTarget");
+    for(const AssemblyGraph::vertex_descriptor v: verticesById) {
         edgesByTarget.appendVector();
         BGL_FORALL_INEDGES(v, e, assemblyGraph, AssemblyGraph) {
             edgesByTarget.append(edgeMap[e]);
@@ -90,7 +173,7 @@ AssemblyGraphSnapshot::AssemblyGraphSnapshot(
 
 
     // Store AssemblyPaths.
-    createNew(assemblyPaths, name + "-assemblyPaths");
+    createStorage(assemblyPaths, "-assemblyPaths");
     for(const auto& assemblyPathPointer: assemblyGraph.assemblyPaths) {
         const auto& assemblyPath = *assemblyPathPointer;
         assemblyPaths.appendVector();
@@ -120,6 +203,176 @@ AssemblyGraphSnapshot::AssemblyGraphSnapshot(
             }
         }
     }
+
+    // For a delta snapshot, store only the rows that differ from the parent.
+    // The vertex table is not stored. It is recreated when accessing the snapshot.
+    if(parent) {
+        storeDelta(parent->vertexVector, vertexVector, "-vertices");
+        storeDelta(parent->vertexJourneyEntries, vertexJourneyEntries, "-vertexJourneyEntries");
+        storeDelta(parent->edgeVector, edgeVector, "-edges");
+        storeDelta(parent->journeys, journeys, "-journeys");
+        storeDelta(parent->edgesBySource, edgesBySource, "-edgesBySource");
+        storeDelta(parent->edgesByTarget, edgesByTarget, "-edgesByTarget");
+        storeDelta(parent->assemblyPaths, assemblyPaths, "-assemblyPaths");
+    }
+}
+
+
+
+// Given, for each vertex or edge, the id of the corresponding
+// vertex or edge in the parent snapshot (or invalid<uint64_t> if none),
+// assign ids 0 through n-1, keeping the parent ids whenever possible.
+// The remaining ids are assigned in increasing order.
+// Without a parent, this assigns ids in order.
+void AssemblyGraphSnapshot::assignIds(
+    const vector<uint64_t>& parentIds,
+    vector<uint64_t>& ids)
+{
+    const uint64_t n = parentIds.size();
+    ids.assign(n, invalid<uint64_t>);
+    vector<bool> isUsed(n, false);
+    for(uint64_t i=0; i<n; i++) {
+        const uint64_t parentId = parentIds[i];
+        if(parentId < n) {
+            SHASTA_ASSERT(not isUsed[parentId]);
+            ids[i] = parentId;
+            isUsed[parentId] = true;
+        }
+    }
+
+    uint64_t nextId = 0;
+    for(uint64_t i=0; i<n; i++) {
+        if(ids[i] == invalid<uint64_t>) {
+            while(isUsed[nextId]) {
+                ++nextId;
+            }
+            ids[i] = nextId++;
+        }
+    }
+}
+
+
+
+void AssemblyGraphSnapshot::storeParentName()
+{
+    MemoryMapped::Vector<char> v;
+    createNew(v, name + "-parent");
+    for(const char c: parentName) {
+        v.push_back(c);
+    }
+}
+
+
+
+void AssemblyGraphSnapshot::accessParentName()
+{
+    MemoryMapped::Vector<char> v;
+    accessExistingReadOnly(v, name + "-parent");
+    parentName.assign(v.begin(), v.end());
+}
+
+
+
+template<class T> void AssemblyGraphSnapshot::createStorage(T& t, const string& suffix)
+{
+    if(isDelta()) {
+        MemoryMapped::anonymousName = name + suffix;
+        t.createNew("", largeDataPageSize);
+    } else {
+        createNew(t, name + suffix);
+    }
+}
+
+
+
+template<class T> void AssemblyGraphSnapshot::storeDelta(
+    const MemoryMapped::Vector<T>& parentVector,
+    const MemoryMapped::Vector<T>& v,
+    const string& suffix)
+{
+    MemoryMapped::Vector<uint64_t> changedRows;
+    MemoryMapped::Vector<T> rows;
+    createNew(changedRows, name + suffix + "-changedRows");
+    createNew(rows, name + suffix);
+
+    changedRows.push_back(v.size());
+    for(uint64_t i=0; i<v.size(); i++) {
+        if(i >= parentVector.size() or not (v[i] == parentVector[i])) {
+            changedRows.push_back(i);
+            rows.push_back(v[i]);
+        }
+    }
+}
+
+
+
+template<class T> void AssemblyGraphSnapshot::storeDelta(
+    const MemoryMapped::VectorOfVectors<T, uint64_t>& parentVector,
+    const MemoryMapped::VectorOfVectors<T, uint64_t>& v,
+    const string& suffix)
+{
+    MemoryMapped::Vector<uint64_t> changedRows;
+    MemoryMapped::VectorOfVectors<T, uint64_t> rows;
+    createNew(changedRows, name + suffix + "-changedRows");
+    createNew(rows, name + suffix);
+
+    changedRows.push_back(v.size());
+    for(uint64_t i=0; i<v.size(); i++) {
+        const span<const T> row = v[i];
+        if(i < parentVector.size()) {
+            const span<const T> parentRow = parentVector[i];
+            if(std::equal(row.begin(), row.end(), parentRow.begin(), parentRow.end())) {
+                continue;
+            }
+        }
+        changedRows.push_back(i);
+        rows.appendVector(row.begin(), row.end());
+    }
+}
+
+
+
+template<class T> void AssemblyGraphSnapshot::accessDelta(
+    const MemoryMapped::Vector<T>& parentVector,
+    MemoryMapped::Vector<T>& v,
+    const string& suffix)
+{
+    MemoryMapped::Vector<uint64_t> changedRows;
+    MemoryMapped::Vector<T> rows;
+    accessExistingReadOnly(changedRows, name + suffix + "-changedRows");
+    accessExistingReadOnly(rows, name + suffix);
+    SHASTA_ASSERT(changedRows.size() == rows.size() + 1);
+
+    const uint64_t n = changedRows[0];
+    createStorage(v, suffix);
+    v.resize(n);
+    std::copy(parentVector.begin(), parentVector.begin() + min(n, uint64_t(parentVector.size())), v.begin());
+    for(uint64_t j=0; j<rows.size(); j++) {
+        v[changedRows[j + 1]] = rows[j];
+    }
+}
+
+
+
+template<class T> void AssemblyGraphSnapshot::accessDelta(
+    const MemoryMapped::VectorOfVectors<T, uint64_t>& parentVector,
+    MemoryMapped::VectorOfVectors<T, uint64_t>& v,
+    const string& suffix)
+{
+    MemoryMapped::Vector<uint64_t> changedRows;
+    MemoryMapped::VectorOfVectors<T, uint64_t> rows;
+    accessExistingReadOnly(changedRows, name + suffix + "-changedRows");
+    accessExistingReadOnly(rows, name + suffix);
+    SHASTA_ASSERT(changedRows.size() == rows.size() + 1);
+
+    const uint64_t n = changedRows[0];
+    createStorage(v, suffix);
+    uint64_t j = 0;
+    for(uint64_t i=0; i<n; i++) {
+        const bool isChanged = (j < rows.size() and changedRows[j + 1] == i);
+        const span<const T> row = isChanged ? rows[j++] : parentVector[i];
+        v.appendVector(row.begin(), row.end());
+    }
 }
 
 
@@ -147,7 +400,7 @@ void AssemblyGraphSnapshot::createVertexTable(
     }
 
     // Now copy it to its permanent location.
-    createNew(vertexTable, name + "-vertexTable");
+    createStorage(vertexTable, "-vertexTable");
     for(const auto& v: tmpVertexTable) {
         vertexTable.appendVector(v);
     }
@@ -205,22 +458,47 @@ uint64_t AssemblyGraphSnapshot::getVertexId(
 
 
 // This accesses an existing snapshot.
+// If this is a delta snapshot and its parent was already accessed,
+// the parent can be passed in, so it does not need to be accessed again.
 AssemblyGraphSnapshot::AssemblyGraphSnapshot(
     const string& name,
     const MappedMemoryOwner& mappedMemoryOwner,
-    const PackedMarkerGraph& packedMarkerGraph) :
+    const PackedMarkerGraph& packedMarkerGraph,
+    const AssemblyGraphSnapshot* parent) :
     MappedMemoryOwner(mappedMemoryOwner),
     name(name),
     packedMarkerGraph(packedMarkerGraph)
 {
-    accessExistingReadOnly(vertexVector, name + "-vertices");
-    accessExistingReadOnly(edgeVector, name + "-edges");
-    accessExistingReadOnly(journeys, name + "-journeys");
-    accessExistingReadOnly(vertexJourneyEntries, name + "-vertexJourneyEntries");
-    accessExistingReadOnly(edgesBySource, name + "-edgesBySource");
-    accessExistingReadOnly(edgesByTarget, name + "-edgesByTarget");
-    accessExistingReadOnly(vertexTable, name + "-vertexTable");
-    accessExistingReadOnly(assemblyPaths, name + "-assemblyPaths");
+    accessParentName();
+
+    if(not isDelta()) {
+        accessExistingReadOnly(vertexVector, name + "-vertices");
+        accessExistingReadOnly(edgeVector, name + "-edges");
+        accessExistingReadOnly(journeys, name + "-journeys");
+        accessExistingReadOnly(vertexJourneyEntries, name + "-vertexJourneyEntries");
+        accessExistingReadOnly(edgesBySource, name + "-edgesBySource");
+        accessExistingReadOnly(edgesByTarget, name + "-edgesByTarget");
+        accessExistingReadOnly(vertexTable, name + "-vertexTable");
+        accessExistingReadOnly(assemblyPaths, name + "-assemblyPaths");
+        return;
+    }
+
+    // This is a delta snapshot. Access the parent, if it was not passed in.
+    shared_ptr<AssemblyGraphSnapshot> parentPointer;
+    if(not (parent and parent->name == parentName)) {
+        parentPointer = make_shared<AssemblyGraphSnapshot>(parentName, mappedMemoryOwner, packedMarkerGraph);
+        parent = parentPointer.get();
+    }
+
+    // Reconstruct the complete snapshot in memory.
+    accessDelta(parent->vertexVector, vertexVector, "-vertices");
+    accessDelta(parent->edgeVector, edgeVector, "-edges");
+    accessDelta(parent->journeys, journeys, "-journeys");
+    accessDelta(parent->vertexJourneyEntries, vertexJourneyEntries, "-vertexJourneyEntries");
+    accessDelta(parent->edgesBySource, edgesBySource, "-edgesBySource");
+    accessDelta(parent->edgesByTarget, edgesByTarget, "-edgesByTarget");
+    accessDelta(parent->assemblyPaths, assemblyPaths, "-assemblyPaths");
+    createVertexTable(packedMarkerGraph);
 }
 
 
@@ -5,6 +5,13 @@
 // snapshot of the mode3a::Assembly graph.
 // It is stored using MemoryMapped classes.
 
+// A snapshot can be created as a delta relative to a parent snapshot.
+// Vertex and edge ids are then kept the same as in the parent whenever possible,
+// and for each stored vector only the rows that differ from the parent are written.
+// When a delta snapshot is accessed, its parent is also accessed
+// (recursively, if the parent is itself a delta snapshot)
+// and the complete snapshot is reconstructed in memory.
+
 // Shasta.
 #include "mode3a-AssemblyGraph.hpp"
 #include "invalid.hpp"
@@ -16,6 +23,7 @@
 // Standard library.
 #include "cstdint.hpp"
 #include "string.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     namespace mode3a {
@@ -36,19 +44,31 @@ class shasta::mode3a::AssemblyGraphSnapshot :
 public:
 
     // This creates a snapshot of the AssemblyGraph in the current state.
+    // If a parent snapshot is specified, this creates a delta snapshot.
     AssemblyGraphSnapshot(
         const AssemblyGraph&,
         const string& name,
-        const MappedMemoryOwner& mappedMemoryOwner);
+        const MappedMemoryOwner& mappedMemoryOwner,
+        const AssemblyGraphSnapshot* parent = 0);
 
     // This accesses an existing snapshot.
+    // If this is a delta snapshot and its parent was already accessed,
+    // the parent can be passed in, so it does not need to be accessed again.
     AssemblyGraphSnapshot(
         const string& name,
         const MappedMemoryOwner& mappedMemoryOwner,
-        const PackedMarkerGraph& packedMarkerGraph);
+        const PackedMarkerGraph& packedMarkerGraph,
+        const AssemblyGraphSnapshot* parent = 0);
 
     const string name;
 
+    // The name of the parent snapshot, or empty if this is not a delta snapshot.
+    string parentName;
+    bool isDelta() const
+    {
+        return not parentName.empty();
+    }
+
     // The MarkerGraph and PackedMarkerGraph that this AssemblyGraphSnapshot refers to.
     const PackedMarkerGraph& packedMarkerGraph;
 
@@ -79,6 +99,17 @@ public:
         // store that information here.
         uint64_t packedAssemblyGraphVertexId = invalid<uint64_t>;
         uint64_t positionInPackedAssemblyGraph = invalid<uint64_t>;
+
+        bool operator==(const Vertex& that) const
+        {
+            return
+                segmentId == that.segmentId and
+                segmentReplicaIndex == that.segmentReplicaIndex and
+                pathId == that.pathId and
+                positionInPath == that.positionInPath and
+                packedAssemblyGraphVertexId == that.packedAssemblyGraphVertexId and
+                positionInPackedAssemblyGraph == that.positionInPackedAssemblyGraph;
+        }
     };
     MemoryMapped::Vector<Vertex> vertexVector;  // Can't call it vertices due to boost graph macros.
 
@@ -90,6 +121,10 @@ public:
     public:
         uint64_t vertexId0;
         uint64_t vertexId1;
+        bool operator==(const Edge& that) const
+        {
+            return vertexId0 == that.vertexId0 and vertexId1 == that.vertexId1;
+        }
     };
     MemoryMapped::Vector<Edge> edgeVector;  // Can't call it edges due to boost graph macros.
 
@@ -221,6 +256,10 @@ public:
     public:
         uint64_t vertexId;
         bool isPrimary;
+        bool operator==(const AssemblyPathEntry& that) const
+        {
+            return vertexId == that.vertexId and isPrimary == that.isPrimary;
+        }
     };
     MemoryMapped::VectorOfVectors<AssemblyPathEntry, uint64_t> assemblyPaths;
 
@@ -284,6 +323,46 @@ public:
         const SimpleAssemblyPath&,
         ostream& html
     ) const;
+
+
+
+private:
+
+    // Given, for each vertex or edge, the id of the corresponding
+    // vertex or edge in the parent snapshot (or invalid<uint64_t> if none),
+    // assign ids 0 through n-1, keeping the parent ids whenever possible.
+    static void assignIds(const vector<uint64_t>& parentIds, vector<uint64_t>& ids);
+
+    void storeParentName();
+    void accessParentName();
+
+    // Create one of the stored vectors.
+    // For a delta snapshot, this is not persistent:
+    // the rows that differ from the parent are stored separately by storeDelta.
+    template<class T> void createStorage(T&, const string& suffix);
+
+    // Support for delta snapshots. For each stored vector,
+    // name + suffix + "-changedRows" contains the number of rows,
+    // followed by the indexes of the rows that differ from the parent,
+    // and name + suffix contains those rows.
+    // accessDelta combines them with the parent to reconstruct
+    // the complete vector in memory.
+    template<class T> void storeDelta(
+        const MemoryMapped::Vector<T>& parentVector,
+        const MemoryMapped::Vector<T>&,
+        const string& suffix);
+    template<class T> void storeDelta(
+        const MemoryMapped::VectorOfVectors<T, uint64_t>& parentVector,
+        const MemoryMapped::VectorOfVectors<T, uint64_t>&,
+        const string& suffix);
+    template<class T> void accessDelta(
+        const MemoryMapped::Vector<T>& parentVector,
+        MemoryMapped::Vector<T>&,
+        const string& suffix);
+    template<class T> void accessDelta(
+        const MemoryMapped::VectorOfVectors<T, uint64_t>& parentVector,
+        MemoryMapped::VectorOfVectors<T, uint64_t>&,
+        const string& suffix);
 };
 
 #endif
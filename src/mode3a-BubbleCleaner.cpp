@@ -12,12 +12,18 @@ using namespace shasta;using namespace mode3a;
 #include <boost/graph/iteration_macros.hpp>
 
 // Standard library.
+#include "algorithm.hpp"
 #include "utility.hpp"
 
+// Explicit instantiation.
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<BubbleCleaner>;
+
 
 
 BubbleCleaner::BubbleCleaner(
     const PackedMarkerGraph& packedMarkerGraph) :
+    MultithreadedObject<BubbleCleaner>(*this),
     packedMarkerGraph(packedMarkerGraph)
 {
     BubbleCleaner& bubbleCleaner = *this;
@@ -84,6 +90,18 @@ void BubbleCleanerEdge::assembledSequence(
 
 
 
+uint64_t BubbleCleanerEdge::assembledSequenceLength(
+    const PackedMarkerGraph& packedMarkerGraph) const
+{
+    uint64_t length = 0;
+    for(const uint64_t segmentId: segments) {
+        length += packedMarkerGraph.segmentClippedSequence(segmentId).size();
+    }
+    return length;
+}
+
+
+
 
 
 // Get the vertex corresponding to a given marker graph vertex,
@@ -106,7 +124,7 @@ BubbleCleaner::vertex_descriptor BubbleCleaner::getVertex(uint64_t markerGraphVe
 
 // Given the initial PackedMarkerGraph, cleanup the bubbles
 // due to errors and store the result in a new PackedMarkerGraph.
-void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
+void BubbleCleaner::cleanup(MarkerGraph& markerGraph, uint64_t threadCount)
 {
     // The maximum period length that this will cleanup.
     // EXPOSE AFTER CODE STABILIZES?   ************
@@ -122,6 +140,30 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
         cout << "Found " << bubbles.size() << " bubbles." << endl;
     }
 
+    // Evaluate in parallel the bubbles we found.
+    // Bubbles created or modified during cleanup are evaluated
+    // again when we get to them.
+    std::map<VertexPair, BubbleInfo> bubbleInfos;
+    {
+        auto& data = evaluateBubblesData;
+        data.maxPeriod = maxPeriod;
+        data.bubbles.clear();
+        for(const auto& p: bubbles) {
+            data.bubbles.push_back(&p.second);
+        }
+        data.bubbleInfos.clear();
+        data.bubbleInfos.resize(data.bubbles.size());
+        setupLoadBalancing(data.bubbles.size(), 100);
+        runThreads(&BubbleCleaner::evaluateBubblesThreadFunction, threadCount);
+
+        uint64_t i = 0;
+        for(const auto& p: bubbles) {
+            bubbleInfos.insert(make_pair(p.first, std::move(data.bubbleInfos[i++])));
+        }
+        data.bubbles.clear();
+        data.bubbleInfos.clear();
+    }
+
 
 
     // Cleanup the bubbles we found.
@@ -141,9 +183,15 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
             SHASTA_ASSERT(target(e, bubbleCleaner) == v1);
         }
 
-        // Get the sequence of the branches.
-        vector< vector<Base> > sequences;
-        getBubbleSequences(bubble, sequences);
+        // Get the information for this bubble, computing it if necessary.
+        auto jt = bubbleInfos.find(it->first);
+        if(jt == bubbleInfos.end()) {
+            jt = bubbleInfos.insert(make_pair(it->first, BubbleInfo())).first;
+        }
+        BubbleInfo& bubbleInfo = jt->second;
+        if(bubbleInfo.branchCount != bubble.size()) {
+            evaluateBubble(bubble, maxPeriod, bubbleInfo);
+        }
 
         if(debug) {
             cout << "Working on a bubble with " << bubble.size() << " branches." << endl;
@@ -151,6 +199,8 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
                 bubbleCleaner[v0].markerGraphVertexId << " " <<
                 bubbleCleaner[v1].markerGraphVertexId << endl;
 
+            vector< vector<Base> > sequences;
+            getBubbleSequences(bubble, sequences);
             for(uint64_t i=0; i<bubble.size(); i++) {
                 const edge_descriptor e = bubble[i];
                 copy(sequences[i].begin(), sequences[i].end(), ostream_iterator<Base>(cout));
@@ -160,12 +210,9 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
 
         // See if the branches differ by a repeat count in a short repeat, with period
         // up to maxPeriod.
-        const uint64_t period = computeCopyNumberDifferencePeriod(sequences, maxPeriod);
+        const uint64_t period = bubbleInfo.period;
         if(period == 0) {
-            bubbles.erase(it);
-            continue;
-        }
-        if(period > maxPeriod) {
+            bubbleInfos.erase(jt);
             bubbles.erase(it);
             continue;
         }
@@ -174,16 +221,16 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
             cout << "This bubble describes copy number changes in a repeat of period " << period << endl;
         }
 
-        // Compute average edge coverage for the branches of this bubble.
-        vector<double> coverage(bubbles.size());
-        computeBubbleCoverage(bubble, coverage);
+        // Average edge coverage and sequence length for the branches of this bubble.
+        const vector<double>& coverage = bubbleInfo.coverage;
+        const vector<uint64_t>& sequenceLengths = bubbleInfo.sequenceLengths;
 
         if(debug) {
             for(uint64_t i=0; i<bubble.size(); i++) {
                 const edge_descriptor e = bubble[i];
                 if(debug) {
                     cout << bubbleCleaner[e].representation() <<
-                        " has length " << sequences[i].size() << " and coverage " << coverage[i] << endl;
+                        " has length " << sequenceLengths[i] << " and coverage " << coverage[i] << endl;
                 }
             }
         }
@@ -192,7 +239,7 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
         double sum = 0.;
         double sumCoverage = 0.;
         for(uint64_t i=0; i<bubble.size(); i++) {
-            sum += coverage[i] * double(sequences[i].size());
+            sum += coverage[i] * double(sequenceLengths[i]);
             sumCoverage += coverage[i];
         }
         const double weightedAverageLength = double(sum) / double(sumCoverage);
@@ -205,7 +252,7 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
         uint64_t iBest = invalid<uint64_t>;
         double bestDelta = 0.;
         for(uint64_t i=0; i<bubble.size(); i++) {
-            const double delta = fabs(double(sequences[i].size()) - weightedAverageLength);
+            const double delta = fabs(double(sequenceLengths[i]) - weightedAverageLength);
             if(i == 0 or delta < bestDelta) {
                 iBest = i;
                 bestDelta = delta;
@@ -280,6 +327,7 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
         }
 
         // Remove this bubble from our list.
+        bubbleInfos.erase(jt);
         bubbles.erase(it);
     }
 
@@ -287,6 +335,61 @@ void BubbleCleaner::cleanup(MarkerGraph& markerGraph)
 
 
 
+void BubbleCleaner::evaluateBubblesThreadFunction(uint64_t /* threadId */)
+{
+    auto& data = evaluateBubblesData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            evaluateBubble(*data.bubbles[i], data.maxPeriod, data.bubbleInfos[i]);
+        }
+    }
+}
+
+
+
+// Decide whether a bubble describes copy number differences
+// in a repeat of period up to maxPeriod.
+void BubbleCleaner::evaluateBubble(
+    const Bubble& bubble,
+    uint64_t maxPeriod,
+    BubbleInfo& bubbleInfo) const
+{
+    const BubbleCleaner& bubbleCleaner = *this;
+
+    bubbleInfo.branchCount = bubble.size();
+    bubbleInfo.period = 0;
+    bubbleInfo.coverage.clear();
+
+    // Get the sequence lengths of the branches.
+    bubbleInfo.sequenceLengths.resize(bubble.size());
+    for(uint64_t i=0; i<bubble.size(); i++) {
+        bubbleInfo.sequenceLengths[i] = bubbleCleaner[bubble[i]].assembledSequenceLength(packedMarkerGraph);
+    }
+
+    // Two branches with the same length cannot differ by copy number.
+    // In that case we don't need to assemble the branch sequences.
+    vector<uint64_t> sortedLengths = bubbleInfo.sequenceLengths;
+    sort(sortedLengths.begin(), sortedLengths.end());
+    if(std::adjacent_find(sortedLengths.begin(), sortedLengths.end()) != sortedLengths.end()) {
+        return;
+    }
+
+    // Get the sequence of the branches and compare them.
+    vector< vector<Base> > sequences;
+    getBubbleSequences(bubble, sequences);
+    const uint64_t period = computeCopyNumberDifferencePeriod(sequences, maxPeriod);
+    if(period == 0 or period > maxPeriod) {
+        return;
+    }
+    bubbleInfo.period = period;
+
+    computeBubbleCoverage(bubble, bubbleInfo.coverage);
+}
+
+
+
 // Compute average edge coverage for the branches of a bubble.
 void BubbleCleaner::computeBubbleCoverage(
     const Bubble& bubble,
@@ -3,10 +3,14 @@
 
 // See comments in mode3a.hpp.
 
+// Shasta.
+#include "MultithreadedObject.hpp"
+
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
 
 // Standard library.
+#include <map>
 #include "string.hpp"
 #include "utility.hpp"
 #include "vector.hpp"
@@ -23,6 +27,7 @@ namespace shasta {
 
         class PackedMarkerGraph;
     }
+    extern template class MultithreadedObject<mode3a::BubbleCleaner>;
 
     class Base;
     class MarkerGraph;
@@ -50,11 +55,16 @@ public:
 
     string representation() const;
     void assembledSequence(const PackedMarkerGraph&, vector<Base>&) const;
+
+    // The length of the assembled sequence, computed without assembling it.
+    uint64_t assembledSequenceLength(const PackedMarkerGraph&) const;
 };
 
 
 
-class shasta::mode3a::BubbleCleaner : public BubbleCleanerBaseClass {
+class shasta::mode3a::BubbleCleaner :
+    public BubbleCleanerBaseClass,
+    public MultithreadedObject<BubbleCleaner> {
 public:
 
     // Construct the BubbleCleaner from the PackedMarkerGraph.
@@ -63,7 +73,9 @@ public:
     // Clean up the bubbles causes by errors.
     // This flags marker graph edges of bubble branches
     // likely to be errors.
-    void cleanup(MarkerGraph&);
+    // The bubbles initially present are evaluated
+    // using threadCount threads.
+    void cleanup(MarkerGraph&, uint64_t threadCount);
 
 private:
 
@@ -96,6 +108,40 @@ private:
         const Bubble&,
         vector<double>&) const;
 
+    // Information computed for a bubble to decide whether
+    // it describes copy number differences in a short repeat.
+    class BubbleInfo {
+    public:
+
+        // The number of branches of the bubble when this was computed.
+        // Bubbles can acquire new branches during cleanup,
+        // and then the BubbleInfo must be recomputed.
+        uint64_t branchCount = 0;
+
+        // The period of the copy number difference, or 0 if
+        // the bubble does not describe a copy number difference.
+        uint64_t period = 0;
+
+        // The lengths of the assembled sequences of the branches.
+        vector<uint64_t> sequenceLengths;
+
+        // The average edge coverage of the branches.
+        // Only computed if period is not 0.
+        vector<double> coverage;
+    };
+    void evaluateBubble(const Bubble&, uint64_t maxPeriod, BubbleInfo&) const;
+
+    // Evaluate bubbles in parallel.
+    // Bubbles are independent, so each thread evaluates its own bubbles.
+    class EvaluateBubblesData {
+    public:
+        uint64_t maxPeriod;
+        vector<const Bubble*> bubbles;
+        vector<BubbleInfo> bubbleInfos;
+    };
+    EvaluateBubblesData evaluateBubblesData;
+    void evaluateBubblesThreadFunction(uint64_t threadId);
+
     // Given assembled sequences of the branches of a bubble,
     // figure out if this is a bubble caused by copy number
     // differences in repeats of period up to maxPeriod.
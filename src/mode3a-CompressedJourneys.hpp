@@ -0,0 +1,362 @@
+#ifndef SHASTA_MODE3A_COMPRESSED_JOURNEYS_HPP
+#define SHASTA_MODE3A_COMPRESSED_JOURNEYS_HPP
+
+// Compact storage of the journeys of the PackedMarkerGraph.
+
+// The journey of each oriented read is stored as a sequence of bytes.
+// It begins with the number of journey steps, as a variable length integer (LEB128).
+// The steps are grouped in blocks of blockSize steps.
+// If there is more than one block, this is followed by the block index,
+// which gives, as 4-byte little endian integers, the byte offset of the
+// beginning of each block except the first, relative to the beginning
+// of the encoded journey. The block index provides random access
+// to a step without decoding the preceding blocks.
+//
+// Each step is stored as 5 variable length integers:
+// - The segment id, as a zig-zag encoded difference from
+//   the segment id of the previous step.
+// - positions[0].
+// - positions[1] - positions[0], zig-zag encoded.
+// - ordinals[0] - the ordinals[1] of the previous step, zig-zag encoded.
+// - ordinals[1] - ordinals[0], zig-zag encoded.
+// The differences are computed within each block, so each block
+// can be decoded independently. For the first step of a block,
+// the previous segment id and ordinal are taken to be 0.
+
+// Shasta.
+#include "invalid.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "SHASTA_ASSERT.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include <bit>
+#include "cstdint.hpp"
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include "vector.hpp"
+
+namespace shasta {
+    namespace mode3a {
+        class JourneyStep;
+        class CompressedJourneys;
+    }
+}
+
+
+
+// Class used to store a detailed representation of the journeys.
+class shasta::mode3a::JourneyStep {
+public:
+    uint64_t segmentId = invalid<uint64_t>;
+
+    // The oriented read appears in a number of marker graph edges in this segment.
+    // We store information on the source vertex of the first of those edges
+    // and the target vertex of the last of those edges.
+    // For each of those two vertices, we store the position of the vertex
+    // in the segment and the ordinal of the oriented read in the vertex.
+    array<uint64_t, 2> positions;
+    array<uint32_t, 2> ordinals;
+
+};
+
+
+
+class shasta::mode3a::CompressedJourneys {
+public:
+
+    // The number of journey steps in each block.
+    static const uint64_t blockSize = 16;
+
+    void createNew(const string& name, size_t pageSize)
+    {
+        data.createNew(name, pageSize);
+    }
+    void accessExistingReadOnly(const string& name)
+    {
+        data.accessExistingReadOnly(name);
+    }
+    void remove()
+    {
+        data.remove();
+    }
+    bool isOpen() const
+    {
+        return data.isOpen();
+    }
+
+    // The number of journeys.
+    uint64_t size() const
+    {
+        return data.size();
+    }
+
+    // The number of bytes used by the encoded journeys.
+    uint64_t byteSize() const
+    {
+        return data.totalSize();
+    }
+
+    // Encode a journey.
+    static void encode(const vector<JourneyStep>&, vector<uint8_t>&);
+
+    // Add journeys encoded by encode.
+    void appendEncodedJourneys(const vector< vector<uint8_t> >& encodedJourneys)
+    {
+        data.appendVectors(encodedJourneys);
+    }
+
+    // Operator[] returns a lightweight object that gives access
+    // to the steps of a journey. Its operator[] uses the block index
+    // to decode a single step. Its iterators decode on the fly,
+    // so following an entire journey only requires a sequential scan
+    // of the encoded bytes.
+    class Range;
+    Range operator[](uint64_t i) const;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JourneyStep;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const JourneyStep*;
+        using reference = const JourneyStep&;
+
+        const_iterator() {}
+        const JourneyStep& operator*() const
+        {
+            return step;
+        }
+        const JourneyStep* operator->() const
+        {
+            return &step;
+        }
+        const_iterator& operator++()
+        {
+            ++position;
+            if(position < n) {
+                decodeStep(p, step, (position % blockSize) == 0);
+            }
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator it = *this;
+            ++(*this);
+            return it;
+        }
+        bool operator==(const const_iterator& that) const
+        {
+            return position == that.position;
+        }
+        bool operator!=(const const_iterator& that) const
+        {
+            return position != that.position;
+        }
+
+    private:
+        friend class Range;
+        const_iterator(const uint8_t* p, uint64_t n, uint64_t position) :
+            p(p), n(n), position(position)
+        {
+            if(position < n) {
+                decodeStep(this->p, step, true);
+            }
+        }
+
+        // The next byte to be read.
+        const uint8_t* p = 0;
+        uint64_t n = 0;
+        uint64_t position = 0;
+        JourneyStep step;
+    };
+
+    class Range {
+    public:
+        uint64_t size() const
+        {
+            return n;
+        }
+        bool empty() const
+        {
+            return n == 0;
+        }
+        const_iterator begin() const
+        {
+            return const_iterator(firstBlock, n, 0);
+        }
+        const_iterator end() const
+        {
+            return const_iterator(0, n, n);
+        }
+
+        // Access a step. This uses the block index to locate
+        // the block containing the requested step,
+        // then decodes the block up to that step.
+        JourneyStep operator[](uint64_t position) const;
+        JourneyStep front() const
+        {
+            return (*this)[0];
+        }
+        JourneyStep back() const
+        {
+            return (*this)[n - 1];
+        }
+
+        // Decode all the steps.
+        void get(vector<JourneyStep>& v) const
+        {
+            v.assign(begin(), end());
+        }
+
+    private:
+        friend class CompressedJourneys;
+        Range() {}
+
+        // The beginning of the encoded journey.
+        const uint8_t* p = 0;
+
+        // The beginning of the first block.
+        const uint8_t* firstBlock = 0;
+
+        uint64_t n = 0;
+    };
+
+private:
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t> data;
+
+    static_assert(std::endian::native == std::endian::little,
+        "CompressedJourneys requires a little endian architecture.");
+
+    // Variable length integers.
+    static void writeVarint(vector<uint8_t>& v, uint64_t x)
+    {
+        while(x >= 0x80) {
+            v.push_back(uint8_t(x | 0x80));
+            x >>= 7;
+        }
+        v.push_back(uint8_t(x));
+    }
+    static uint64_t readVarint(const uint8_t*& p)
+    {
+        uint64_t x = 0;
+        for(uint64_t shift=0; ; shift+=7) {
+            const uint8_t byte = *p++;
+            x |= uint64_t(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                return x;
+            }
+        }
+    }
+
+    static uint64_t zigZagEncode(uint64_t d)
+    {
+        return (d << 1) ^ (0 - (d >> 63));
+    }
+    static uint64_t zigZagDecode(uint64_t z)
+    {
+        return (z >> 1) ^ (0 - (z & 1));
+    }
+
+    static uint64_t blockCount(uint64_t n)
+    {
+        return (n + blockSize - 1) / blockSize;
+    }
+
+    // Decode a step, given the previous one.
+    // If this is the first step of a block, the previous one is ignored.
+    static void decodeStep(const uint8_t*& p, JourneyStep& step, bool isFirstInBlock)
+    {
+        const uint64_t previousSegmentId = isFirstInBlock ? 0 : step.segmentId;
+        const uint64_t previousOrdinal = isFirstInBlock ? 0 : step.ordinals[1];
+        step.segmentId = previousSegmentId + zigZagDecode(readVarint(p));
+        step.positions[0] = readVarint(p);
+        step.positions[1] = step.positions[0] + zigZagDecode(readVarint(p));
+        step.ordinals[0] = uint32_t(previousOrdinal + zigZagDecode(readVarint(p)));
+        step.ordinals[1] = uint32_t(step.ordinals[0] + zigZagDecode(readVarint(p)));
+    }
+};
+
+
+
+inline shasta::mode3a::CompressedJourneys::Range
+    shasta::mode3a::CompressedJourneys::operator[](uint64_t i) const
+{
+    Range range;
+    if(data.size(i) == 0) {
+        return range;
+    }
+    range.p = data.begin(i);
+    const uint8_t* q = range.p;
+    range.n = readVarint(q);
+    range.firstBlock = q + 4 * (blockCount(range.n) - 1);
+    return range;
+}
+
+
+
+inline shasta::mode3a::JourneyStep
+    shasta::mode3a::CompressedJourneys::Range::operator[](uint64_t position) const
+{
+    SHASTA_ASSERT(position < n);
+
+    // Locate the block containing this step.
+    const uint64_t blockId = position / blockSize;
+    const uint8_t* q = firstBlock;
+    if(blockId > 0) {
+        uint32_t offset;
+        std::memcpy(&offset, firstBlock - 4 * (blockCount(n) - blockId), sizeof(offset));
+        q = p + offset;
+    }
+
+    // Decode the block up to the requested step.
+    JourneyStep step;
+    const uint64_t stepCount = position % blockSize + 1;
+    for(uint64_t j=0; j<stepCount; j++) {
+        decodeStep(q, step, j == 0);
+    }
+    return step;
+}
+
+
+
+inline void shasta::mode3a::CompressedJourneys::encode(
+    const vector<JourneyStep>& journey,
+    vector<uint8_t>& v)
+{
+    v.clear();
+    const uint64_t n = journey.size();
+    if(n == 0) {
+        return;
+    }
+    writeVarint(v, n);
+
+    // Leave room for the block index. It is filled in below.
+    const uint64_t indexBegin = v.size();
+    v.resize(indexBegin + 4 * (blockCount(n) - 1));
+
+    uint64_t previousSegmentId = 0;
+    uint64_t previousOrdinal = 0;
+    for(uint64_t position=0; position<n; position++) {
+        if((position % blockSize) == 0) {
+            previousSegmentId = 0;
+            previousOrdinal = 0;
+            if(position > 0) {
+                SHASTA_ASSERT(v.size() <= std::numeric_limits<uint32_t>::max());
+                const uint32_t offset = uint32_t(v.size());
+                std::memcpy(v.data() + indexBegin + 4 * (position / blockSize - 1), &offset, sizeof(offset));
+            }
+        }
+        const JourneyStep& step = journey[position];
+        writeVarint(v, zigZagEncode(step.segmentId - previousSegmentId));
+        writeVarint(v, step.positions[0]);
+        writeVarint(v, zigZagEncode(step.positions[1] - step.positions[0]));
+        writeVarint(v, zigZagEncode(uint64_t(step.ordinals[0]) - previousOrdinal));
+        writeVarint(v, zigZagEncode(uint64_t(step.ordinals[1]) - uint64_t(step.ordinals[0])));
+        previousSegmentId = step.segmentId;
+        previousOrdinal = step.ordinals[1];
+    }
+}
+
+#endif
@@ -1,5 +1,6 @@
 // Shasta.
 #include "mode3a-JaccardGraph.hpp"
+#include "dset64-gccAtomic.hpp"
 #include "mode3a-AssemblyGraph.hpp"
 #include "mode3a-PackedMarkerGraph.hpp"
 #include "orderPairs.hpp"
@@ -17,9 +18,13 @@ using namespace mode3a;
 #include "fstream.hpp"
 #include <iomanip>
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<mode3a::JaccardGraph>;
+
 
 
 JaccardGraph::JaccardGraph(const AssemblyGraph& assemblyGraph) :
+    MultithreadedObject<JaccardGraph>(*this),
     assemblyGraph(assemblyGraph)
 {}
 
@@ -187,10 +192,14 @@ void JaccardGraph::writeGraphviz(ostream& dot, double minJaccard)
 // Compute large connected components.
 void JaccardGraph::computeConnectedComponents(
     uint64_t minComponentSize,
-    vector< shared_ptr<JaccardGraph> >& componentGraphs
+    vector< shared_ptr<JaccardGraph> >& componentGraphs,
+    uint64_t threadCount
 )
 {
     JaccardGraph& jaccardGraph = *this;
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
 
     // We cannot use boost::connected_components because it
     // only works for undirected graphs.
@@ -201,32 +210,39 @@ void JaccardGraph::computeConnectedComponents(
     BGL_FORALL_VERTICES(v, jaccardGraph, JaccardGraph) {
         vertexIndexMap.insert(make_pair(v, vertexIndex++));
     }
-    const uint64_t n = uint64_t(vertexMap.size());
-
-    // Initialize the disjoint sets data structure.
-    vector<uint64_t> rank(n);
-    vector<uint64_t> parent(n);
-    boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
-    for(uint64_t i=0; i<n; i++) {
-        disjointSets.make_set(i);
-    }
+    const uint64_t n = vertexIndex;
 
-    // Loop over all edges to compute connected components.
+    // Gather the vertex index pairs corresponding to the edges.
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    data.vertexIndexPairs.clear();
     BGL_FORALL_EDGES(e, jaccardGraph, JaccardGraph) {
         const vertex_descriptor v0 = source(e, jaccardGraph);
         const vertex_descriptor v1 = target(e, jaccardGraph);
-        const uint64_t iv0 = vertexIndexMap[v0];
-        const uint64_t iv1 = vertexIndexMap[v1];
-        disjointSets.union_set(iv0, iv1);
+        data.vertexIndexPairs.push_back({vertexIndexMap[v0], vertexIndexMap[v1]});
     }
 
+    // Compute connected components, in parallel.
+    vector<DisjointSets::Aint> disjointSetsData(n);
+    data.disjointSetsPointer = make_shared<DisjointSets>(disjointSetsData.data(), n);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(data.vertexIndexPairs.size(), batchSize);
+    runThreads(&JaccardGraph::computeConnectedComponentsThreadFunction1, threadCount);
+    data.componentIds.resize(n);
+    setupLoadBalancing(n, batchSize);
+    runThreads(&JaccardGraph::computeConnectedComponentsThreadFunction2, threadCount);
+    data.vertexIndexPairs.clear();
+    data.disjointSetsPointer = 0;
+
     // Gather the vertices in each connected component.
     vector< vector<vertex_descriptor> > components(n);
+    vector<uint64_t> lowestVertexIndex(n, invalid<uint64_t>);
     BGL_FORALL_VERTICES(v, jaccardGraph, JaccardGraph) {
         const uint64_t iv = vertexIndexMap[v];
-        const uint64_t componentId = disjointSets.find_set(iv);
+        const uint64_t componentId = data.componentIds[iv];
         components[componentId].push_back(v);
+        lowestVertexIndex[componentId] = min(lowestVertexIndex[componentId], iv);
     }
+    data.componentIds.clear();
 
 
 
@@ -235,14 +251,22 @@ void JaccardGraph::computeConnectedComponents(
     for(uint64_t componentId=0; componentId<n; componentId++) {
         const vector<vertex_descriptor>& component = components[componentId];
         const uint64_t componentSize = component.size();
-        if(componentSize >= minComponentSize) {
+        if(componentSize > 0 and componentSize >= minComponentSize) {
             componentTable.push_back(make_pair(componentId, componentSize));
         }
     }
 
     // Order the connected components by decreasing size.
+    // The component ids depend on the order of the parallel union-find operations,
+    // so components of the same size are ordered by their lowest vertex index.
     sort(componentTable.begin(), componentTable.end(),
-        OrderPairsBySecondOnlyGreater<uint64_t, uint64_t >());
+        [&lowestVertexIndex](const pair<uint64_t, uint64_t>& x, const pair<uint64_t, uint64_t>& y)
+        {
+            if(x.second != y.second) {
+                return x.second > y.second;
+            }
+            return lowestVertexIndex[x.first] < lowestVertexIndex[y.first];
+        });
 
     // Create a JaccardGraph for each of the connected components we want to keep.
     componentGraphs.clear();
@@ -296,6 +320,37 @@ void JaccardGraph::computeConnectedComponents(
 
 
 
+void JaccardGraph::computeConnectedComponentsThreadFunction1(uint64_t /* threadId */)
+{
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const auto& p = data.vertexIndexPairs[i];
+            disjointSets.unite(p.first, p.second);
+        }
+    }
+}
+
+
+
+void JaccardGraph::computeConnectedComponentsThreadFunction2(uint64_t /* threadId */)
+{
+    ComputeConnectedComponentsData& data = computeConnectedComponentsData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            data.componentIds[i] = disjointSets.find(i);
+        }
+    }
+}
+
+
+
 // Compute strongly connected components.
 void JaccardGraph::computeStronglyConnectedComponents(
     vector< vector<vertex_descriptor> >& strongComponents)
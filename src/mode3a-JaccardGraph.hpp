@@ -1,6 +1,9 @@
 #ifndef SHASTA_MODE3A_JACCARD_GRAPH_HPP
 #define SHASTA_MODE3A_JACCARD_GRAPH_HPP
 
+// Shasta.
+#include "MultithreadedObject.hpp"
+
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
 
@@ -9,6 +12,7 @@
 #include <map>
 #include "memory.hpp"
 #include "string.hpp"
+#include "utility.hpp"
 #include "vector.hpp"
 
 namespace shasta {
@@ -29,8 +33,11 @@ namespace shasta {
             boost::listS, boost::listS, boost::bidirectionalS,
             AssemblyGraphVertex, AssemblyGraphEdge>;
     }
+    extern template class MultithreadedObject<mode3a::JaccardGraph>;
 }
 
+class DisjointSets;
+
 
 
 class shasta::mode3a::JaccardGraphVertex {
@@ -61,7 +68,9 @@ public:
 
 
 
-class shasta::mode3a::JaccardGraph : public JaccardGraphBaseClass {
+class shasta::mode3a::JaccardGraph :
+    public JaccardGraphBaseClass,
+    public MultithreadedObject<JaccardGraph> {
 public:
 
     JaccardGraph(const AssemblyGraph& assemblyGraph);
@@ -82,10 +91,22 @@ public:
 
 
     // Compute large connected components.
+    // They are stored in order of decreasing size.
+    // The union-find operations run in parallel using the lock-free DisjointSets.
     void computeConnectedComponents(
         uint64_t minComponentSize,
-        vector< shared_ptr<JaccardGraph> >&
+        vector< shared_ptr<JaccardGraph> >&,
+        uint64_t threadCount
     );
+    class ComputeConnectedComponentsData {
+    public:
+        vector< pair<uint64_t, uint64_t> > vertexIndexPairs;
+        shared_ptr<DisjointSets> disjointSetsPointer;
+        vector<uint64_t> componentIds;
+    };
+    ComputeConnectedComponentsData computeConnectedComponentsData;
+    void computeConnectedComponentsThreadFunction1(uint64_t threadId);
+    void computeConnectedComponentsThreadFunction2(uint64_t threadId);
 
     // Compute strongly connected components.
     void computeStronglyConnectedComponents(
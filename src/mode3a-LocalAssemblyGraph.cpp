@@ -1,8 +1,10 @@
 // Shasta.
 #include "mode3a-LocalAssemblyGraph.hpp"
+#include "CanvasGraph.hpp"
 #include "computeLayout.hpp"
 #include "deduplicate.hpp"
 #include "html.hpp"
+#include "HttpResponseCache.hpp"
 #include "HttpServer.hpp"
 #include "invalid.hpp"
 #include "mode3a-AssemblyGraphSnapshot.hpp"
@@ -22,8 +24,10 @@ using namespace mode3a;
 #include <boost/graph/topology.hpp>
 
 // Standard library.
+#include <iomanip>
 #include <map>
 #include <queue>
+#include <sstream>
 #include "tuple.hpp"
 
 
@@ -483,22 +487,8 @@ void LocalAssemblyGraph::writeSvg(
 
 
     // If coloring one assembly path, gather the necessary information.
-    // Key = vertexId in the AssemblyGraphSnapshot.
-    // Value = (position, primary/secondary).
     std::map<uint64_t, pair<uint64_t, bool> > assemblyPathMap;
-    if(options.segmentColoring == "colorOneAssemblyPath") {
-        if(options.assemblyPathId >= assemblyGraphSnapshot.assemblyPaths.size()) {
-            throw runtime_error("Invalid assembly path id.");
-        }
-        const auto assemblyPath = assemblyGraphSnapshot.assemblyPaths[options.assemblyPathId];
-        for(uint64_t position=0; position<assemblyPath.size(); position++) {
-            const auto& pathEntry = assemblyPath[position];
-            assemblyPathMap.insert({
-                pathEntry.vertexId,
-                {position, pathEntry.isPrimary}
-            });
-        }
-    }
+    getAssemblyPathMap(options, assemblyPathMap);
 
 
 
@@ -537,9 +527,7 @@ void LocalAssemblyGraph::writeSvg(
         multiply_value(q2, controlPointDistance);
         add_point(q2, p2);
 
-        const double linkThickness =
-            options.minimumLinkThickness +
-            options.additionalLinkThicknessPerRead * double(assemblyGraphSnapshot.getEdgeCoverage(edgeId) - 1);
+        const double linkThickness = this->linkThickness(e, options);
 
         const string dash =
             assemblyGraphSnapshot.segmentsAreAdjacent(edgeId) ? "" :
@@ -577,23 +565,12 @@ void LocalAssemblyGraph::writeSvg(
 
 
 
-    // Some work vectors used below.
-    vector<OrientedReadId> orientedReadIds0;
-    vector<OrientedReadId> orientedReadIds1;
-    vector<OrientedReadId> unionOrientedReads;
-    vector<OrientedReadId> intersectionOrientedReads;
-
-
-
     // Write the segments.
     svg << "<g id='" << svgId << "-segments'>\n";
     BGL_FORALL_VERTICES(v, localAssemblyGraph, LocalAssemblyGraph) {
         const LocalAssemblyGraphVertex& localAssemblyGraphVertex = localAssemblyGraph[v];
         const AssemblyGraphSnapshot::Vertex& snapshotVertex =
             assemblyGraphSnapshot.vertexVector[localAssemblyGraphVertex.vertexId];
-        const uint64_t distance = localAssemblyGraph[v].distance;
-        const double averageEdgeCoverage =
-            assemblyGraphSnapshot.packedMarkerGraph.averageMarkerGraphEdgeCoverage(snapshotVertex.segmentId);
 
         // Get the positions of the ends of this segment.
         SHASTA_ASSERT(localAssemblyGraphVertex.position.size() >= 2);
@@ -615,71 +592,8 @@ void LocalAssemblyGraph::writeSvg(
 
 
         // Decide the color for this segment.
-        string color = "Green";
         double jaccard = invalid<double>;
-        if(distance == maxDistance) {
-            color = "LightGray";
-        } else {
-            if(options.segmentColoring == "random") {
-                color = randomSegmentColor(snapshotVertex.segmentId);
-            } else if(options.segmentColoring == "byTangledAssemblyPath") {
-                const uint64_t pathId = snapshotVertex.pathId;
-                if(pathId == invalid<uint64_t>) {
-                    color = "DimGrey";
-                } else {
-                    const uint32_t hue = MurmurHash2(&pathId, sizeof(pathId), options.coloringHashSeed) % 360;
-                    color = "hsl(" + to_string(hue) + ",100%, 50%)";
-                }
-            } else if(options.segmentColoring == "byPackedAssemblyGraphVertex") {
-                const uint64_t vertexId = snapshotVertex.packedAssemblyGraphVertexId;
-                if(vertexId == invalid<uint64_t>) {
-                    color = "DimGrey";
-                } else {
-                    const uint32_t hue = MurmurHash2(&vertexId, sizeof(vertexId), options.coloringHashSeed) % 360;
-                    color = "hsl(" + to_string(hue) + ",100%, 50%)";
-                }
-            } else if(options.segmentColoring == "colorOneAssemblyPath") {
-                auto it = assemblyPathMap.find(localAssemblyGraphVertex.vertexId);
-                if(it == assemblyPathMap.end()) {
-                    color = "DimGrey";
-                } else {
-                    const uint64_t position = it->second.first;
-                    const bool isPrimary = it->second.second;
-                    uint32_t H = uint32_t(120. * double(position) / double(assemblyPathMap.size()));
-                    if(not isPrimary) {
-                        H += 180;
-                    }
-                    const uint32_t S = 100;
-                    const uint32_t L = 50;
-                    color = "hsl(" + to_string(H) + "," + to_string(S) + "%, " + to_string(L) + "%)";
-                }
-            } else if(
-                options.segmentColoring == "byJaccard" or
-                options.segmentColoring  == "byCommonReads") {
-                jaccard = assemblyGraphSnapshot.jaccard(
-                    referenceVertexId,
-                    localAssemblyGraphVertex.vertexId,
-                    orientedReadIds0,
-                    orientedReadIds1,
-                    unionOrientedReads,
-                    intersectionOrientedReads);
-                if(intersectionOrientedReads.empty()) {
-                    color = "DimGrey";
-                } else {
-                    uint64_t hue = 0;
-                    if(options.segmentColoring == "byCommonReads") {
-                        // Normalize to the number of oriented reads in the reference segment.
-                        const double fraction = double(intersectionOrientedReads.size()) / double(orientedReadIds0.size());
-                        hue = uint64_t(std::round(fraction * 120.));
-                    } else if(options.segmentColoring == "byJaccard") {
-                        hue = uint64_t(std::round(jaccard * 120.));
-                    }
-                    color = "hsl(" + to_string(hue) + ",100%, 50%)";
-                }
-            } else {
-                SHASTA_ASSERT(0);
-            }
-        }
+        const string color = segmentColor(v, options, referenceVertexId, assemblyPathMap, jaccard);
 
 
 
@@ -699,12 +613,7 @@ void LocalAssemblyGraph::writeSvg(
             "</marker>\n"
             "</defs>\n";
 
-        const double thickness =
-            options.minimumSegmentThickness +
-            averageEdgeCoverage *
-            options.additionalSegmentThicknessPerUnitCoverage +
-            double(assemblyGraphSnapshot.vertexJourneyEntries[localAssemblyGraphVertex.vertexId].size()) *
-            options.additionalSegmentThicknessPerJourneyEntry;
+        const double thickness = segmentThickness(v, options);
 
         // Add this segment to the svg.
         const auto oldPrecision = svg.precision(1);
@@ -763,6 +672,235 @@ void LocalAssemblyGraph::writeSvg(
 
 
 
+// If coloring one assembly path, gather the necessary information.
+// Key = vertexId in the AssemblyGraphSnapshot.
+// Value = (position, primary/secondary).
+void LocalAssemblyGraph::getAssemblyPathMap(
+    const SvgOptions& options,
+    std::map<uint64_t, pair<uint64_t, bool> >& assemblyPathMap) const
+{
+    assemblyPathMap.clear();
+    if(options.segmentColoring == "colorOneAssemblyPath") {
+        if(options.assemblyPathId >= assemblyGraphSnapshot.assemblyPaths.size()) {
+            throw runtime_error("Invalid assembly path id.");
+        }
+        const auto assemblyPath = assemblyGraphSnapshot.assemblyPaths[options.assemblyPathId];
+        for(uint64_t position=0; position<assemblyPath.size(); position++) {
+            const auto& pathEntry = assemblyPath[position];
+            assemblyPathMap.insert({
+                pathEntry.vertexId,
+                {position, pathEntry.isPrimary}
+            });
+        }
+    }
+}
+
+
+
+double LocalAssemblyGraph::segmentThickness(
+    vertex_descriptor v,
+    const SvgOptions& options) const
+{
+    const LocalAssemblyGraph& localAssemblyGraph = *this;
+    const LocalAssemblyGraphVertex& localAssemblyGraphVertex = localAssemblyGraph[v];
+    const AssemblyGraphSnapshot::Vertex& snapshotVertex =
+        assemblyGraphSnapshot.vertexVector[localAssemblyGraphVertex.vertexId];
+    const double averageEdgeCoverage =
+        assemblyGraphSnapshot.packedMarkerGraph.averageMarkerGraphEdgeCoverage(snapshotVertex.segmentId);
+
+    return
+        options.minimumSegmentThickness +
+        averageEdgeCoverage *
+        options.additionalSegmentThicknessPerUnitCoverage +
+        double(assemblyGraphSnapshot.vertexJourneyEntries[localAssemblyGraphVertex.vertexId].size()) *
+        options.additionalSegmentThicknessPerJourneyEntry;
+}
+
+
+
+double LocalAssemblyGraph::linkThickness(
+    edge_descriptor e,
+    const SvgOptions& options) const
+{
+    const uint64_t edgeId = (*this)[e].edgeId;
+    return
+        options.minimumLinkThickness +
+        options.additionalLinkThicknessPerRead * double(assemblyGraphSnapshot.getEdgeCoverage(edgeId) - 1);
+}
+
+
+
+// Display using class CanvasGraph instead of svg.
+// Segments are displayed as straight lines with an arrow
+// and links as straight lines.
+void LocalAssemblyGraph::writeCanvas(
+    ostream& html,
+    const SvgOptions& options,
+    uint64_t snapshotIndex) const
+{
+    const LocalAssemblyGraph& localAssemblyGraph = *this;
+
+    // If necessary, get the vertex id of the reference vertex for segment coloring.
+    string message;
+    const uint64_t referenceVertexId = assemblyGraphSnapshot.getVertexId(
+        options.referenceSegmentId, options.referenceSegmentReplicaIndex, message);
+    if((options.segmentColoring != "random") and (referenceVertexId == invalid<uint64_t>)) {
+        html << "<br>Invalid combination " << options.referenceSegmentId << "." <<
+            options.referenceSegmentReplicaIndex <<
+            " of reference segment id and reference segment replicaIndex.<br>" << message;
+        return;
+    }
+    std::map<uint64_t, pair<uint64_t, bool> > assemblyPathMap;
+    getAssemblyPathMap(options, assemblyPathMap);
+
+    CanvasGraph canvasGraph;
+
+    // Write the links first, so they don't overwrite the segments.
+    BGL_FORALL_EDGES(e, localAssemblyGraph, LocalAssemblyGraph) {
+        const uint64_t edgeId =  localAssemblyGraph[e].edgeId; // In the AssemblyGraphSnapshot
+        const LocalAssemblyGraphVertex& vertex1 = localAssemblyGraph[source(e, localAssemblyGraph)];
+        const LocalAssemblyGraphVertex& vertex2 = localAssemblyGraph[target(e, localAssemblyGraph)];
+        SHASTA_ASSERT(vertex1.position.size() >= 2);
+        SHASTA_ASSERT(vertex2.position.size() >= 2);
+        const Point& p1 = vertex1.position.back();
+        const Point& p2 = vertex2.position.front();
+
+        canvasGraph.addLine(p1.x(), p1.y(), p2.x(), p2.y(),
+            linkThickness(e, options), "Black", false,
+            assemblyGraphSnapshot.vertexVector[vertex1.vertexId].stringId() + "->" +
+            assemblyGraphSnapshot.vertexVector[vertex2.vertexId].stringId() +
+            " coverage " + to_string(assemblyGraphSnapshot.getEdgeCoverage(edgeId)),
+            "exploreMode3aAssemblyGraphLink?snapshotIndex=" + to_string(snapshotIndex) + "&linkId=" + to_string(edgeId));
+    }
+
+    // Write the segments.
+    BGL_FORALL_VERTICES(v, localAssemblyGraph, LocalAssemblyGraph) {
+        const LocalAssemblyGraphVertex& localAssemblyGraphVertex = localAssemblyGraph[v];
+        const AssemblyGraphSnapshot::Vertex& snapshotVertex =
+            assemblyGraphSnapshot.vertexVector[localAssemblyGraphVertex.vertexId];
+        SHASTA_ASSERT(localAssemblyGraphVertex.position.size() >= 2);
+        const Point& p1 = localAssemblyGraphVertex.position.front();
+        const Point& p2 = localAssemblyGraphVertex.position.back();
+
+        double jaccard = invalid<double>;
+        const string color = segmentColor(v, options, referenceVertexId, assemblyPathMap, jaccard);
+
+        string title = snapshotVertex.stringId();
+        if(jaccard != invalid<double>) {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(2) << " " << jaccard;
+            title += s.str();
+        }
+        if(snapshotVertex.pathId != invalid<uint64_t>) {
+            title += " " + to_string(snapshotVertex.pathId) + ":" + to_string(snapshotVertex.positionInPath);
+        }
+        if(snapshotVertex.packedAssemblyGraphVertexId != invalid<uint64_t>) {
+            title += " P" + to_string(snapshotVertex.packedAssemblyGraphVertexId) +
+                ":" + to_string(snapshotVertex.positionInPackedAssemblyGraph);
+        }
+
+        canvasGraph.addLine(p1.x(), p1.y(), p2.x(), p2.y(),
+            segmentThickness(v, options), color, true, title,
+            "exploreMode3aAssemblyGraphSegment?snapshotIndex=" + to_string(snapshotIndex) +
+            "&segmentId=" + to_string(snapshotVertex.segmentId) +
+            "&segmentReplicaIndex=" + to_string(snapshotVertex.segmentReplicaIndex));
+    }
+
+    canvasGraph.write(html, uint64_t(options.sizePixels));
+}
+
+
+
+// Decide the color for a segment.
+// If coloring by Jaccard similarity, this also returns it.
+string LocalAssemblyGraph::segmentColor(
+    vertex_descriptor v,
+    const SvgOptions& options,
+    uint64_t referenceVertexId,
+    const std::map<uint64_t, pair<uint64_t, bool> >& assemblyPathMap,
+    double& jaccard) const
+{
+    const LocalAssemblyGraph& localAssemblyGraph = *this;
+    const LocalAssemblyGraphVertex& localAssemblyGraphVertex = localAssemblyGraph[v];
+    const AssemblyGraphSnapshot::Vertex& snapshotVertex =
+        assemblyGraphSnapshot.vertexVector[localAssemblyGraphVertex.vertexId];
+    const uint64_t distance = localAssemblyGraphVertex.distance;
+
+    vector<OrientedReadId> orientedReadIds0;
+    vector<OrientedReadId> orientedReadIds1;
+    vector<OrientedReadId> unionOrientedReads;
+    vector<OrientedReadId> intersectionOrientedReads;
+
+    string color = "Green";
+    jaccard = invalid<double>;
+    if(distance == maxDistance) {
+        color = "LightGray";
+    } else {
+        if(options.segmentColoring == "random") {
+            color = randomSegmentColor(snapshotVertex.segmentId);
+        } else if(options.segmentColoring == "byTangledAssemblyPath") {
+            const uint64_t pathId = snapshotVertex.pathId;
+            if(pathId == invalid<uint64_t>) {
+                color = "DimGrey";
+            } else {
+                const uint32_t hue = MurmurHash2(&pathId, sizeof(pathId), options.coloringHashSeed) % 360;
+                color = "hsl(" + to_string(hue) + ",100%, 50%)";
+            }
+        } else if(options.segmentColoring == "byPackedAssemblyGraphVertex") {
+            const uint64_t vertexId = snapshotVertex.packedAssemblyGraphVertexId;
+            if(vertexId == invalid<uint64_t>) {
+                color = "DimGrey";
+            } else {
+                const uint32_t hue = MurmurHash2(&vertexId, sizeof(vertexId), options.coloringHashSeed) % 360;
+                color = "hsl(" + to_string(hue) + ",100%, 50%)";
+            }
+        } else if(options.segmentColoring == "colorOneAssemblyPath") {
+            auto it = assemblyPathMap.find(localAssemblyGraphVertex.vertexId);
+            if(it == assemblyPathMap.end()) {
+                color = "DimGrey";
+            } else {
+                const uint64_t position = it->second.first;
+                const bool isPrimary = it->second.second;
+                uint32_t H = uint32_t(120. * double(position) / double(assemblyPathMap.size()));
+                if(not isPrimary) {
+                    H += 180;
+                }
+                const uint32_t S = 100;
+                const uint32_t L = 50;
+                color = "hsl(" + to_string(H) + "," + to_string(S) + "%, " + to_string(L) + "%)";
+            }
+        } else if(
+            options.segmentColoring == "byJaccard" or
+            options.segmentColoring  == "byCommonReads") {
+            jaccard = assemblyGraphSnapshot.jaccard(
+                referenceVertexId,
+                localAssemblyGraphVertex.vertexId,
+                orientedReadIds0,
+                orientedReadIds1,
+                unionOrientedReads,
+                intersectionOrientedReads);
+            if(intersectionOrientedReads.empty()) {
+                color = "DimGrey";
+            } else {
+                uint64_t hue = 0;
+                if(options.segmentColoring == "byCommonReads") {
+                    // Normalize to the number of oriented reads in the reference segment.
+                    const double fraction = double(intersectionOrientedReads.size()) / double(orientedReadIds0.size());
+                    hue = uint64_t(std::round(fraction * 120.));
+                } else if(options.segmentColoring == "byJaccard") {
+                    hue = uint64_t(std::round(jaccard * 120.));
+                }
+                color = "hsl(" + to_string(hue) + ",100%, 50%)";
+            }
+        } else {
+            SHASTA_ASSERT(0);
+        }
+    }
+    return color;
+}
+
+
+
 void LocalAssemblyGraph::computeLayout(
     const SvgOptions& options,
     double timeout)
@@ -1038,6 +1176,7 @@ LocalAssemblyGraph::SvgOptions::SvgOptions(const vector<string>& request)
     layoutMethod = layoutDefaultMethod;
 
     HttpServer::getParameterValue(request, "sizePixels", sizePixels);
+    HttpServer::getParameterValue(request, "displayMethod", displayMethod);
     HttpServer::getParameterValue(request, "layoutMethod", layoutMethod);
 
     // Segment length and thickness.
@@ -1083,6 +1222,20 @@ void LocalAssemblyGraph::SvgOptions::addFormRows(ostream& html)
         " value='" << sizePixels <<
         "'>"
 
+        "<tr>"
+        "<td>Display method"
+        "<td class=left>"
+        "<input type=radio name=displayMethod value=svg"
+        << (displayMethod=="svg" ? " checked=checked" : "") <<
+        ">Svg<br>"
+        "<input type=radio name=displayMethod value=canvas"
+        << (displayMethod=="canvas" ? " checked=checked" : "") <<
+        ">Canvas ";
+    writeInformationIcon(html, "Faster for large graphs. "
+        "Segments and links are displayed as straight lines "
+        "and the side panel is not available.");
+    html <<
+
         "<tr>"
         "<td>Layout method"
         "<td class=left>"
@@ -1247,16 +1400,19 @@ void LocalAssemblyGraph::writeDetailedHtml(ostream& html, double timeout, bool l
     runCommandWithTimeout(command, timeout,
         timeoutTriggered, signalOccurred, returnCode);
     if(signalOccurred) {
+        HttpResponseCache::doNotCache();
         html << "<p>Unable to compute graph layout: terminated by a signal. "
             "The failing Command was: <code>" << command << "</code>";
         return;
     }
     if(timeoutTriggered) {
+        HttpResponseCache::doNotCache();
         html << "<p>Timeout exceeded during graph layout computation. "
             "Increase the timeout or decrease the maximum distance to simplify the graph";
         return;
     }
     if(returnCode!=0 ) {
+        HttpResponseCache::doNotCache();
         html << "<p>Unable to compute graph layout: return code " << returnCode <<
             ". The failing Command was: <code>" << command << "</code>";
         return;
@@ -11,6 +11,7 @@
 #include <boost/graph/adjacency_list.hpp>
 
 // Standard library.
+#include <map>
 #include "iosfwd.hpp"
 #include "span.hpp"
 #include "string.hpp"
@@ -106,6 +107,9 @@ public:
         double sizePixels = 600.;
         string layoutMethod;
 
+        // "svg" or "canvas" (see class CanvasGraph).
+        string displayMethod = "svg";
+
 
 
         // Segment length and thickness.
@@ -155,6 +159,10 @@ public:
         ostream&,
         const SvgOptions&,
         uint64_t snapshotIndex) const;
+    void writeCanvas(
+        ostream&,
+        const SvgOptions&,
+        uint64_t snapshotIndex) const;
     void computeLayout(const SvgOptions&, double timeout);
     void computeSegmentTangents();
     void computeSegmentTangents(vertex_descriptor);
@@ -172,6 +180,19 @@ public:
     // All copies of a segment are alway displayed in the same color.
     static string randomSegmentColor(uint64_t segmentId);
 
+    // Functions used by writeSvg and writeCanvas.
+    void getAssemblyPathMap(
+        const SvgOptions&,
+        std::map<uint64_t, std::pair<uint64_t, bool> >& assemblyPathMap) const;
+    string segmentColor(
+        vertex_descriptor,
+        const SvgOptions&,
+        uint64_t referenceVertexId,
+        const std::map<uint64_t, std::pair<uint64_t, bool> >& assemblyPathMap,
+        double& jaccard) const;
+    double segmentThickness(vertex_descriptor, const SvgOptions&) const;
+    double linkThickness(edge_descriptor, const SvgOptions&) const;
+
 
 
     bool haveConsecutivePaths(
@@ -5,6 +5,7 @@
 #include "invalid.hpp"
 #include "MarkerGraph.hpp"
 #include "orderPairs.hpp"
+#include "ParallelWriter.hpp"
 using namespace shasta;
 using namespace mode3a;
 
@@ -251,7 +252,7 @@ void PackedMarkerGraph::accessSegmentSequences()
 
 
 
-void PackedMarkerGraph::writeGfa() const
+void PackedMarkerGraph::writeGfa(size_t threadCount) const
 {
     ofstream gfa(name + ".gfa");
     ofstream csv(name + ".csv");
@@ -260,14 +261,21 @@ void PackedMarkerGraph::writeGfa() const
     gfa << "H\tVN:Z:1.0\n";
     csv << "Segment,Sequence Length,Path Length,First marker graph vertex,Last marker graph vertex\n";
 
-    // Write the segments.
-    for(uint64_t segmentId=0; segmentId<segmentSequences.size(); segmentId++) {
-
+    // Write the segments to the gfa.
+    // They are formatted in parallel, then written in order.
+    ParallelWriter writer(gfa, threadCount);
+    writer.write(segmentSequences.size(), [&](uint64_t segmentId, string& s) {
         const auto sequence = segmentClippedSequence(segmentId);
-        gfa <<"S\t" << segmentId << "\t";
-        copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(gfa));
-        gfa << "\n";
+        s += "S\t" + to_string(segmentId) + "\t";
+        for(const Base b: sequence) {
+            s.push_back(b.character());
+        }
+        s += "\n";
+    });
 
+    // Write the segments to the csv.
+    for(uint64_t segmentId=0; segmentId<segmentSequences.size(); segmentId++) {
+        const auto sequence = segmentClippedSequence(segmentId);
         const auto path = segments[segmentId];
         csv << segmentId << ",";
         csv << sequence.size() << ",";
@@ -340,23 +348,21 @@ void PackedMarkerGraph::computeJourneys(uint64_t threadCount)
     data.markerGraphJourneys.endPass2(true, true);
 
     // For each oriented read, sort the journey pairs and use them to compute the journeys.
-    // The journeys are temporarily stored in data.detailedJourneys.
-    data.journeys.resize(orientedReadCount);
+    // The encoded journeys are temporarily stored in data.encodedJourneys.
+    data.encodedJourneys.resize(orientedReadCount);
     setupLoadBalancing(orientedReadCount, batchSize);
     runThreads(&PackedMarkerGraph::computeJourneysPass3ThreadFunction, threadCount);
 
     // We no longer need the marker graph journeys.
     data.markerGraphJourneys.remove();
 
-    // Copy the journeys to their permanent location in mapped memory.
+    // Copy the encoded journeys to their permanent location in mapped memory.
     createNew(journeys, name + "-Journeys");
-    for(const auto& detailedJourney: data.journeys) {
-        journeys.appendVector(detailedJourney);
-    }
+    journeys.appendEncodedJourneys(data.encodedJourneys);
 
     // We no longer need the temporary copy of the journeys.
-    data.journeys.clear();
-    data.journeys.shrink_to_fit();
+    data.encodedJourneys.clear();
+    data.encodedJourneys.shrink_to_fit();
 }
 
 
@@ -419,12 +425,13 @@ void PackedMarkerGraph::computeJourneysPass12ThreadFunction(uint64_t pass)
 
 
 // In pass 3 we use the journey pairs to compute journeys for each oriented read
-// and we store them temporarily in data.journeys.
+// and we store them encoded, temporarily, in data.encodedJourneys.
 void PackedMarkerGraph::computeJourneysPass3ThreadFunction(uint64_t threadId)
 {
     auto& data = computeJourneysData;
 
     // Loop over batches assigned to this thread.
+    vector<JourneyStep> journey;
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
 
@@ -436,7 +443,7 @@ void PackedMarkerGraph::computeJourneysPass3ThreadFunction(uint64_t threadId)
             sort(markerGraphJourney.begin(), markerGraphJourney.end());
 
             // Use the marker graph journey to compute the detailed journey for this read.
-            vector<JourneyStep>& journey = data.journeys[i];
+            journey.clear();
             JourneyStep journeyStep;
             for(uint64_t j=0; j<markerGraphJourney.size(); j++) {
                 const auto& markerGraphJourneyStep =  markerGraphJourney[j];
@@ -457,6 +464,8 @@ void PackedMarkerGraph::computeJourneysPass3ThreadFunction(uint64_t threadId)
                     journey.push_back(journeyStep);
                 }
             }
+
+            CompressedJourneys::encode(journey, data.encodedJourneys[i]);
         }
     }
 }
@@ -476,16 +485,17 @@ void PackedMarkerGraph::writeJourneys() const
 
         csv1 << orientedReadId << ",";
 
-        for(uint64_t position=0; position<journey.size(); position++) {
-            csv1 << journey[position].segmentId << ",";
+        uint64_t position = 0;
+        for(const JourneyStep& journeyStep: journey) {
+            csv1 << journeyStep.segmentId << ",";
 
             csv2 << orientedReadId << ",";
-            csv2 << position << ",";
-            csv2 << journey[position].segmentId << ",";
-            csv2 << journey[position].positions[0] << ",";
-            csv2 << journey[position].positions[1] << ",";
-            csv2 << journey[position].ordinals[0] << ",";
-            csv2 << journey[position].ordinals[1] << "\n";
+            csv2 << position++ << ",";
+            csv2 << journeyStep.segmentId << ",";
+            csv2 << journeyStep.positions[0] << ",";
+            csv2 << journeyStep.positions[1] << ",";
+            csv2 << journeyStep.ordinals[0] << ",";
+            csv2 << journeyStep.ordinals[1] << "\n";
         }
         csv1 << "\n";
     }
@@ -7,6 +7,7 @@
 #include "Base.hpp"
 #include "invalid.hpp"
 #include "MappedMemoryOwner.hpp"
+#include "mode3a-CompressedJourneys.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 #include "ReadId.hpp"
@@ -126,33 +127,27 @@ public:
     MemoryMapped::VectorOfVectors<uint64_t, uint64_t> linksByTarget;
     void createConnectivity();
 
-    void writeGfa() const;
+    // The gfa segments are formatted using threadCount threads
+    // (0 means all available hardware threads).
+    void writeGfa(size_t threadCount = 1) const;
 
     void remove();
 
 
 
     // Class used to store a detailed representation of the journeys.
-    class JourneyStep {
-    public:
-        uint64_t segmentId = invalid<uint64_t>;
-
-        // The oriented read appears in a number of marker graph edges in this segment.
-        // We store information on the source vertex of the first of those edges
-        // and the target vertex of the last of those edges.
-        // For each of those two vertices, we store the position of the vertex
-        // in the segment and the ordinal of the oriented read in the vertex.
-        array<uint64_t, 2> positions;
-        array<uint32_t, 2> ordinals;
-
-    };
+    // See mode3a-CompressedJourneys.hpp.
+    using JourneyStep = mode3a::JourneyStep;
 
 
 
     // The journey of an oriented read is the sequence of segments it encounters.
-    // For each segment we also store some additional information (see class JourneyStep above).
+    // For each segment we also store some additional information (see class JourneyStep).
     // Indexed by OrientedReadId::getValue().
-    MemoryMapped::VectorOfVectors<JourneyStep, uint64_t> journeys;
+    // The journeys are stored delta and variable length encoded
+    // (see mode3a-CompressedJourneys.hpp). To follow an entire journey,
+    // iterate over journeys[i], which decodes the steps sequentially.
+    CompressedJourneys journeys;
     void computeJourneys(uint64_t threadCount);
     class ComputeJourneysData {
     public:
@@ -177,8 +172,8 @@ public:
         };
         MemoryMapped::VectorOfVectors<MarkerGraphJourneyStep, uint64_t> markerGraphJourneys;
 
-        // More detailed representation of the journeys.
-        vector< vector<JourneyStep> > journeys;
+        // The encoded journeys.
+        vector< vector<uint8_t> > encodedJourneys;
 
     };
     ComputeJourneysData computeJourneysData;
@@ -77,13 +77,13 @@ Assembler::Assembler(
         packedMarkerGraph->links.size() << " links, and " <<
         packedMarkerGraph->totalSegmentLength() <<
         " bases of assembled sequence." << endl;
-    packedMarkerGraph->writeGfa();
+    packedMarkerGraph->writeGfa(threadCount);
 
     // Clean up the bubbles causes by errors.
     // This keeps one branch of each bubble.
     // The marker graph edges of the remaining branches are flagged as removed.
     BubbleCleaner cleaner(*packedMarkerGraph);
-    cleaner.cleanup(markerGraph);
+    cleaner.cleanup(markerGraph, threadCount);
     packedMarkerGraph->remove();
     packedMarkerGraph = 0;
 
@@ -96,7 +96,7 @@ Assembler::Assembler(
         packedMarkerGraph->totalSegmentLength() <<
         " bases of assembled sequence." << endl;
     packedMarkerGraph->writeSegments();
-    packedMarkerGraph->writeGfa();
+    packedMarkerGraph->writeGfa(threadCount);
 
     // For the final PackedMarkerGraph we also need to compute the oriented reads journeys.
     packedMarkerGraph->computeJourneys(threadCount);
@@ -106,10 +106,11 @@ Assembler::Assembler(
     shared_ptr<AssemblyGraph> assemblyGraph = make_shared<AssemblyGraph>(*packedMarkerGraph);
 
 #if 1
-    AssemblyGraphSnapshot snapshot(
+    // Later snapshots are stored as deltas relative to the previous one.
+    shared_ptr<AssemblyGraphSnapshot> snapshot = make_shared<AssemblyGraphSnapshot>(
         *assemblyGraph,
         "Mode3a-AssemblyGraphSnapshot-0", *this);
-    snapshot.write();
+    snapshot->write();
     /*
     assemblyGraph->computeJaccardGraph(
         threadCount,
@@ -138,13 +139,13 @@ Assembler::Assembler(
 
         // Find AssemblyPaths and assemble their sequence.
         assemblyGraph->computeAssemblyPaths(threadCount);
-        assemblyGraph->assemble();
+        assemblyGraph->assemble(threadCount);
 
         // Create a snapshot of the assembly graph.
-        AssemblyGraphSnapshot snapshot(
+        snapshot = make_shared<AssemblyGraphSnapshot>(
             *assemblyGraph,
-            "Mode3a-AssemblyGraphSnapshot-" + to_string(detangleIteration), *this);
-        snapshot.write();
+            "Mode3a-AssemblyGraphSnapshot-" + to_string(detangleIteration), *this, snapshot.get());
+        snapshot->write();
 
         // Create a new AssemblyGraph using the TangledAssemblyPaths.
         shared_ptr<AssemblyGraph> newAssemblyGraph =
@@ -193,10 +194,10 @@ Assembler::Assembler(
     cout << "The final AssemblyGraph has " <<
        num_vertices(*assemblyGraph) << " segments and " <<
        num_edges(*assemblyGraph) << " links." << endl;
-    AssemblyGraphSnapshot snapshot(
+    snapshot = make_shared<AssemblyGraphSnapshot>(
         *assemblyGraph,
-        "Mode3a-AssemblyGraphSnapshot-" + to_string(detangleIterationCount), *this);
-    snapshot.write();
+        "Mode3a-AssemblyGraphSnapshot-" + to_string(detangleIterationCount), *this, snapshot.get());
+    snapshot->write();
 #endif
 
 }
@@ -56,6 +56,9 @@ the Assembly graph. It uses MemoryMapped classes so it can be accessed
 later for use in the http server or the Python API.
 We store at least an initial snapshot immediately after creation
 and a final snapshot after detangling.
+Snapshots after the first are stored as deltas relative
+to the previous snapshot, so their cost is proportional
+to the amount of change.
 
 *******************************************************************************/
 
@@ -6,9 +6,11 @@
 #include "Assembler.hpp"
 #include "MarkerInterval.hpp"
 #include "SHASTA_ASSERT.hpp"
+#include "SlowItemTracer.hpp"
 using namespace shasta;
 using namespace mode3b;
 
+#include "chrono.hpp"
 #include <iostream.hpp>
 
 #include "MultithreadedObject.tpp"
@@ -114,7 +116,8 @@ AssemblyPath::AssemblyPath(
     const Assembler& assembler,
     const vector<MarkerGraphEdgeId>& primaryEdges,
     const vector<MarkerGraphEdgePairInfo>& infos,
-    uint64_t threadCount) :
+    uint64_t threadCount,
+    bool assemble) :
     MultithreadedObject<AssemblyPath>(*this),
     assembler(assembler),
     primaryEdges(primaryEdges)
@@ -128,6 +131,10 @@ AssemblyPath::AssemblyPath(
         steps.push_back(Step(info));
     }
 
+    if(not assemble) {
+        return;
+    }
+
     // Adjust the numbers of threads, if necessary.
     if(threadCount == 0) {
         threadCount = std::thread::hardware_concurrency();
@@ -149,8 +156,9 @@ void AssemblyPath::assembleSequential()
 
 
 
-void AssemblyPath::assembleStep(uint64_t i)
+void AssemblyPath::assembleStep(uint64_t i, SlowItemTracer* slowItems)
 {
+    const auto t0 = slowItems ? steady_clock::now() : steady_clock::time_point();
     const MarkerGraphEdgeId edgeIdA = primaryEdges[i];
     const MarkerGraphEdgeId edgeIdB = primaryEdges[i+1];
     // cout << "Assembling between primary edges " << edgeIdA << " " << edgeIdB << endl;
@@ -175,14 +183,36 @@ void AssemblyPath::assembleStep(uint64_t i)
         throw;
     }
 
+    if(slowItems) {
+        slowItems->record(i, seconds(steady_clock::now() - t0), {
+            edgeIdA,
+            edgeIdB,
+            uint64_t(max(int64_t(0), step.info.offsetInBases)),
+            step.sequence.size()});
+    }
+}
+
+
+
+vector<string> AssemblyPath::slowItemValueNames()
+{
+    return {"EdgeIdA", "EdgeIdB", "Estimated length", "Sequence length"};
 }
 
 
 
 void AssemblyPath::assembleParallel(uint64_t threadCount)
 {
+    if(slowItemTracingIsEnabled()) {
+        slowItems = make_shared<SlowItemTracer>(
+            "Assembly path steps", "Step", slowItemValueNames());
+    }
     setupLoadBalancing(steps.size(), 1);
     runThreads(&AssemblyPath::assembleThreadFunction, threadCount);
+    if(slowItems) {
+        slowItems->write();
+        slowItems.reset();
+    }
 }
 
 
@@ -192,7 +222,7 @@ void AssemblyPath::assembleThreadFunction(uint64_t threadId)
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
         for(uint64_t i=begin; i<end; ++i) {
-            assembleStep(i);
+            assembleStep(i, slowItems.get());
         }
     }
 }
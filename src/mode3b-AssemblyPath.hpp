@@ -6,6 +6,7 @@
 #include "shastaTypes.hpp"
 
 #include "iosfwd.hpp"
+#include "memory.hpp"
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -16,6 +17,7 @@ namespace shasta {
 
     class Assembler;
     class Base;
+    class SlowItemTracer;
 }
 
 
@@ -44,11 +46,36 @@ public:
 
     // Create the assembly path given n primary edges and
     // the n-1 MarkerGraphEdgePairInfo between consecutive primary edges.
+    // If assemble is false, the steps are not assembled.
+    // The caller is then responsible for calling assembleStep for all steps
+    // (possibly in parallel, and together with steps of other AssemblyPaths)
+    // before using the sequence.
     AssemblyPath(
         const Assembler&,
         const vector<MarkerGraphEdgeId>&,
         const vector<MarkerGraphEdgePairInfo>&,
-        uint64_t threadCount = 0);
+        uint64_t threadCount = 0,
+        bool assemble = true);
+
+    uint64_t stepCount() const
+    {
+        return steps.size();
+    }
+
+    // The estimated length of a step, in bases, as estimated
+    // by the MarkerGraphEdgePairInfo.
+    int64_t stepOffsetInBases(uint64_t i) const
+    {
+        return steps[i].info.offsetInBases;
+    }
+
+    // Assemble the sequence of the i-th Step.
+    // This can be called in parallel for distinct steps.
+    // If a SlowItemTracer is specified, the step is recorded in it.
+    void assembleStep(uint64_t i, SlowItemTracer* = 0);
+
+    // The names of the values recorded for each step in a SlowItemTracer.
+    static vector<string> slowItemValueNames();
 
     void getSequence(vector<Base>&) const;
     void writeFasta(ostream&, const string& name) const;
@@ -80,9 +107,9 @@ private:
 
     // Assemble the sequence of each Step.
     void assembleSequential();
-    void assembleStep(uint64_t i);
     void assembleParallel(uint64_t threadCount);
     void assembleThreadFunction(uint64_t threadId);
+    shared_ptr<SlowItemTracer> slowItems;
 };
 
 #endif
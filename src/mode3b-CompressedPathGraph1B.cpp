@@ -7,16 +7,16 @@
 #include "dominatorTree.hpp"
 #include "enumeratePaths.hpp"
 #include "findLinearChains.hpp"
+#include "MemoryMappedVector.hpp"
 #include "orderPairs.hpp"
+#include "setOperations.hpp"
+#include "SlowItemTracer.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
 using namespace mode3b;
 
 // Boost libraries.
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
 #include <boost/graph/filtered_graph.hpp>
-#include <boost/graph/adj_list_serialize.hpp>
 #include <boost/pending/disjoint_sets.hpp>
 
 // Standard library.
@@ -24,6 +24,9 @@ using namespace mode3b;
 #include <queue>
 #include "tuple.hpp"
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<CompressedPathGraph1B>;
+
 
 
 void GlobalPathGraph1::assemble2(
@@ -47,7 +50,7 @@ void GlobalPathGraph1::assemble2(
     GlobalPathGraph1 graph(assembler);
     graph.createVertices(minPrimaryCoverage, maxPrimaryCoverage);
     graph.computeOrientedReadJourneys();
-    graph.createEdges0(1, minEdgeCoverage, minCorrectedJaccard);
+    graph.createEdges0(1, minEdgeCoverage, minCorrectedJaccard, threadCount0);
 
     graph.createComponents(minCorrectedJaccard, minComponentSize);
 
@@ -123,8 +126,10 @@ CompressedPathGraph1B::CompressedPathGraph1B(
     const Assembler& assembler,
     uint64_t threadCount0,
     uint64_t threadCount1) :
+    MultithreadedObject<CompressedPathGraph1B>(*this),
     componentId(componentId),
-    assembler(assembler)
+    assembler(assembler),
+    threadCount0(threadCount0)
 {
     create(graph);
 
@@ -136,13 +141,15 @@ CompressedPathGraph1B::CompressedPathGraph1B(
 
 
 
-// Load it from a binary archive, then call run.
+// Load it from a snapshot created by save, then call run.
 CompressedPathGraph1B::CompressedPathGraph1B(
     const string& fileName,
     const Assembler& assembler,
     uint64_t threadCount0,
     uint64_t threadCount1) :
-    assembler(assembler)
+    MultithreadedObject<CompressedPathGraph1B>(*this),
+    assembler(assembler),
+    threadCount0(threadCount0)
 {
     load(fileName);
     run(threadCount0, threadCount1);
@@ -1308,12 +1315,15 @@ bool CompressedPathGraph1B::detangleVertices(
         allVertices.push_back(cv);
     }
 
+    computeCommonCountsForVertexDetangling();
+
     uint64_t detangledCount = 0;
     for(const vertex_descriptor cv: allVertices) {
         if(detangleVertex(cv, debug, detangleToleranceLow, detangleToleranceHigh)) {
             ++detangledCount;
         }
     }
+    clearCommonCounts();
 
     if(true) {
         cout << "Detangled " << detangledCount << " vertices." << endl;
@@ -1340,12 +1350,15 @@ bool CompressedPathGraph1B::detangleVerticesGeneral(
         allVertices.push_back(cv);
     }
 
+    computeCommonCountsForVertexDetangling();
+
     uint64_t detangledCount = 0;
     for(const vertex_descriptor cv: allVertices) {
         if(detangleVertexGeneral(cv, debug, detangleToleranceLow, detangleToleranceHigh)) {
             ++detangledCount;
         }
     }
+    clearCommonCounts();
 
     if(true) {
         cout << "Detangled " << detangledCount << " vertices." << endl;
@@ -1393,9 +1406,7 @@ void CompressedPathGraph1B::computeTangleMatrix(
                 assembler.markerGraph.reverseComplementEdge[markerGraphEdgeId0] == markerGraphEdgeId1) {
                 tangleMatrix[i0][i1] = 0;
             } else {
-                MarkerGraphEdgePairInfo info;
-                SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(markerGraphEdgeId0, markerGraphEdgeId1, info));
-                tangleMatrix[i0][i1] = info.common;
+                tangleMatrix[i0][i1] = getCommonCount(markerGraphEdgeId0, markerGraphEdgeId1);
             }
         }
     }
@@ -1403,6 +1414,152 @@ void CompressedPathGraph1B::computeTangleMatrix(
 
 
 
+// Compute in parallel the number of common oriented reads
+// for each of the given pairs of MarkerGraphEdgeIds.
+// The pairs are deduplicated and stored in commonCountPairs.
+void CompressedPathGraph1B::computeCommonCounts(
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> >& pairs)
+{
+    deduplicate(pairs);
+    commonCountPairs.swap(pairs);
+    commonCounts.clear();
+    commonCounts.resize(commonCountPairs.size());
+
+    const uint64_t batchSize = 100;
+    setupLoadBalancing(commonCountPairs.size(), batchSize);
+    runThreads(&CompressedPathGraph1B::computeCommonCountsThreadFunction,
+        threadCount0 == 0 ? std::thread::hardware_concurrency() : threadCount0);
+}
+
+
+
+void CompressedPathGraph1B::computeCommonCountsThreadFunction(uint64_t /* threadId */)
+{
+    MarkerGraphEdgePairInfo info;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            // If analyzeMarkerGraphEdgePair fails, leave the count invalid.
+            // If the pair is later needed, getCommonCount will then
+            // fail in the same way as without precomputation.
+            const auto& p = commonCountPairs[i];
+            if(assembler.analyzeMarkerGraphEdgePair(p.first, p.second, info)) {
+                commonCounts[i] = info.common;
+            } else {
+                commonCounts[i] = invalid<uint64_t>;
+            }
+        }
+    }
+}
+
+
+
+void CompressedPathGraph1B::clearCommonCounts()
+{
+    commonCountPairs.clear();
+    commonCountPairs.shrink_to_fit();
+    commonCounts.clear();
+    commonCounts.shrink_to_fit();
+}
+
+
+
+// Return the number of common oriented reads between two MarkerGraphEdgeIds,
+// using the precomputed value if available.
+uint64_t CompressedPathGraph1B::getCommonCount(
+    MarkerGraphEdgeId markerGraphEdgeId0,
+    MarkerGraphEdgeId markerGraphEdgeId1) const
+{
+    const auto p = make_pair(markerGraphEdgeId0, markerGraphEdgeId1);
+    const auto it = std::lower_bound(commonCountPairs.begin(), commonCountPairs.end(), p);
+    if(it != commonCountPairs.end() and *it == p) {
+        const uint64_t commonCount = commonCounts[it - commonCountPairs.begin()];
+        if(commonCount != invalid<uint64_t>) {
+            return commonCount;
+        }
+    }
+
+    MarkerGraphEdgePairInfo info;
+    SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(markerGraphEdgeId0, markerGraphEdgeId1, info));
+    return info.common;
+}
+
+
+
+// Add the pairs (MarkerGraphEdgeId0, MarkerGraphEdgeId1) that can appear
+// in a tangle matrix between the in-edges of cv0 and the out-edges of cv1.
+// This uses all chains of the last bubble of each in-edge
+// and of the first bubble of each out-edge, so it also covers
+// the generalized tangle matrix used by detangleVertexGeneral.
+void CompressedPathGraph1B::addCommonCountPairs(
+    vertex_descriptor cv0,
+    vertex_descriptor cv1,
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> >& pairs) const
+{
+    const CompressedPathGraph1B& cGraph = *this;
+
+    BGL_FORALL_INEDGES(cv0, ce0, cGraph, CompressedPathGraph1B) {
+        for(const Chain& chain0: cGraph[ce0].lastBubble()) {
+            if(chain0.size() < 2) {
+                continue;
+            }
+            const MarkerGraphEdgeId markerGraphEdgeId0 = chain0[chain0.size() - 2];
+            BGL_FORALL_OUTEDGES(cv1, ce1, cGraph, CompressedPathGraph1B) {
+                for(const Chain& chain1: cGraph[ce1].firstBubble()) {
+                    if(chain1.size() < 2) {
+                        continue;
+                    }
+                    pairs.push_back(make_pair(markerGraphEdgeId0, chain1[1]));
+                }
+            }
+        }
+    }
+}
+
+
+
+// The vertices that can be detangled are the ones with at least one in-edge,
+// at least one out-edge, and at least two in-edges or two out-edges.
+void CompressedPathGraph1B::computeCommonCountsForVertexDetangling()
+{
+    const CompressedPathGraph1B& cGraph = *this;
+
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> > pairs;
+    BGL_FORALL_VERTICES(cv, cGraph, CompressedPathGraph1B) {
+        const uint64_t inDegree = in_degree(cv, cGraph);
+        const uint64_t outDegree = out_degree(cv, cGraph);
+        if(inDegree == 0 or outDegree == 0 or (inDegree < 2 and outDegree < 2)) {
+            continue;
+        }
+        addCommonCountPairs(cv, cv, pairs);
+    }
+    computeCommonCounts(pairs);
+}
+
+
+
+// The edges cv0->cv1 that can be detangled are the ones
+// where cv0 has out-degree 1 and cv1 has in-degree 1.
+void CompressedPathGraph1B::computeCommonCountsForEdgeDetangling()
+{
+    const CompressedPathGraph1B& cGraph = *this;
+
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> > pairs;
+    BGL_FORALL_EDGES(ce, cGraph, CompressedPathGraph1B) {
+        const vertex_descriptor cv0 = source(ce, cGraph);
+        const vertex_descriptor cv1 = target(ce, cGraph);
+        if(out_degree(cv0, cGraph) != 1 or in_degree(cv1, cGraph) != 1) {
+            continue;
+        }
+        addCommonCountPairs(cv0, cv1, pairs);
+    }
+    computeCommonCounts(pairs);
+}
+
+
+
 #if 0
 // This works if the following is true:
 // - For all incoming edges (bubble chains) of cv, the last bubble is haploid.
@@ -1908,10 +2065,7 @@ bool CompressedPathGraph1B::detangleVertexGeneral(
 
         for(uint64_t i1=0; i1<outChains.size(); i1++) {
             const MarkerGraphEdgeId markerGraphEdgeId1 = outChains[i1].edgeId;
-
-            MarkerGraphEdgePairInfo info;
-            SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(markerGraphEdgeId0, markerGraphEdgeId1, info));
-            tangleMatrix[i0][i1] = info.common;
+            tangleMatrix[i0][i1] = getCommonCount(markerGraphEdgeId0, markerGraphEdgeId1);
         }
     }
 
@@ -2185,12 +2339,15 @@ bool CompressedPathGraph1B::detangleEdges(
         edgeMap.insert({cGraph[ce].id, ce});
     }
 
+    computeCommonCountsForEdgeDetangling();
+
     uint64_t detangleCount = 0;;
     for(auto it=edgeMap.begin(); it!=edgeMap.end(); /* Incremented safely by detangleEdgeStrict */) {
         if(detangleEdge(edgeMap, it, detangleToleranceLow, detangleToleranceHigh)) {
             ++detangleCount;
         }
     }
+    clearCommonCounts();
 
     if(true) {
         cout << "Detangled " << detangleCount << " edges." << endl;
@@ -3066,12 +3223,15 @@ bool CompressedPathGraph1B::detangleBackEdges(
         edgeMap.insert({cGraph[ce].id, ce});
     }
 
+    computeCommonCountsForEdgeDetangling();
+
     uint64_t detangleCount = 0;;
     for(auto it=edgeMap.begin(); it!=edgeMap.end(); /* Incremented safely by detangleEdgeStrict */) {
         if(detangleBackEdge(edgeMap, it, detangleToleranceLow, detangleToleranceHigh)) {
             ++detangleCount;
         }
     }
+    clearCommonCounts();
     cout << "Detangled " << detangleCount << " back edges." << endl;
 
     return detangleCount > 0;
@@ -3537,15 +3697,11 @@ void CompressedPathGraph1B::computeTangleMatrix(
     }
 
     // Now we can compute the tangle matrix.
-    vector<OrientedReadId> commonOrientedReads;
     for(uint64_t i0=0; i0<2; i0++) {
         for(uint64_t i1=0; i1<2; i1++) {
-            commonOrientedReads.clear();
-            set_intersection(
+            tangleMatrix[i0][i1] = intersectionSize(
                 orientedReadIdsIn[i0] .begin(), orientedReadIdsIn[i0] .end(),
-                orientedReadIdsOut[i1].begin(), orientedReadIdsOut[i1].end(),
-                back_inserter(commonOrientedReads));
-            tangleMatrix[i0][i1] = commonOrientedReads.size();
+                orientedReadIdsOut[i1].begin(), orientedReadIdsOut[i1].end());
         }
     }
 }
@@ -3568,12 +3724,7 @@ void CompressedPathGraph1B::gatherOrientedReadIdsAtEnd(
 
     orientedReadIds.clear();
     for(uint64_t i=first; i<=last; i++) {
-        const MarkerGraphEdgeId markerGraphEdgeId = chain[i];
-        const auto& markerIntervals =
-            assembler.markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-        for(const MarkerInterval& markerInterval: markerIntervals) {
-            orientedReadIds.push_back(markerInterval.orientedReadId);
-        }
+        assembler.markerGraph.appendEdgeOrientedReadIds(chain[i], orientedReadIds);
     }
     deduplicate(orientedReadIds);
 }
@@ -3596,12 +3747,7 @@ void CompressedPathGraph1B::gatherOrientedReadIdsAtBeginning(
 
     orientedReadIds.clear();
     for(uint64_t i=first; i<=last; i++) {
-        const MarkerGraphEdgeId markerGraphEdgeId = chain[i];
-        const auto& markerIntervals =
-            assembler.markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-        for(const MarkerInterval& markerInterval: markerIntervals) {
-            orientedReadIds.push_back(markerInterval.orientedReadId);
-        }
+        assembler.markerGraph.appendEdgeOrientedReadIds(chain[i], orientedReadIds);
     }
     deduplicate(orientedReadIds);
 }
@@ -4325,51 +4471,122 @@ void BubbleChain::compress()
 
 
 void CompressedPathGraph1B::assembleChains(
-    uint64_t threadCount0,
+    uint64_t /* threadCount0 */,
     uint64_t threadCount1)
 {
     CompressedPathGraph1B& cGraph = *this;
+    if(threadCount1 == 0) {
+        threadCount1 = std::thread::hardware_concurrency();
+    }
 
     ofstream csv("ChainsAssemblyDetails.csv");
     cout << timestamp << "Assembling sequence." << endl;
 
-    // ****** THIS SHOULD BE MADE MULTITHREADED USING threadCount0 threads.
+    // Gather all the chains, together with their names.
+    AssembleChainsData& data = assembleChainsData;
+    data.chains.clear();
+    vector<string> chainNames;
     BGL_FORALL_EDGES(ce, cGraph, CompressedPathGraph1B) {
         BubbleChain& bubbleChain = cGraph[ce];
         for(uint64_t positionInBubbleChain=0; positionInBubbleChain<bubbleChain.size();
             positionInBubbleChain++)  {
             Bubble& bubble = bubbleChain[positionInBubbleChain];
             for(uint64_t indexInBubble=0; indexInBubble<bubble.size(); indexInBubble++) {
-                Chain& chain = bubble[indexInBubble];
-                const string chainName = chainStringId(ce, positionInBubbleChain, indexInBubble);
-                assembleChain(chain, threadCount1, chainName, csv);
+                data.chains.push_back(&bubble[indexInBubble]);
+                chainNames.push_back(chainStringId(ce, positionInBubbleChain, indexInBubble));
             }
         }
     }
+
+    // Create an AssemblyPath for each chain, without assembling it.
+    data.assemblyPaths.clear();
+    data.assemblyPaths.resize(data.chains.size());
+    setupLoadBalancing(data.chains.size(), 1);
+    runThreads(&CompressedPathGraph1B::assembleChainsThreadFunction1, threadCount1);
+
+    // Gather the steps of all chains.
+    // Steps are independent of each other, so we assemble them
+    // all together, longest first, for better load balancing.
+    data.steps.clear();
+    for(uint64_t chainIndex=0; chainIndex<data.chains.size(); chainIndex++) {
+        const AssemblyPath& assemblyPath = *data.assemblyPaths[chainIndex];
+        for(uint64_t stepIndex=0; stepIndex<assemblyPath.stepCount(); stepIndex++) {
+            data.steps.push_back({chainIndex, stepIndex});
+        }
+    }
+    std::stable_sort(data.steps.begin(), data.steps.end(),
+        [&data](const pair<uint64_t, uint64_t>& x, const pair<uint64_t, uint64_t>& y)
+        {
+            return
+                data.assemblyPaths[x.first]->stepOffsetInBases(x.second) >
+                data.assemblyPaths[y.first]->stepOffsetInBases(y.second);
+        });
+    cout << timestamp << "Assembling " << data.steps.size() << " steps for " <<
+        data.chains.size() << " chains." << endl;
+    if(slowItemTracingIsEnabled()) {
+        data.slowItems = make_shared<SlowItemTracer>(
+            "Chain steps", "Step", AssemblyPath::slowItemValueNames());
+    }
+    setupLoadBalancing(data.steps.size(), 1);
+    runThreads(&CompressedPathGraph1B::assembleChainsThreadFunction2, threadCount1);
+    if(data.slowItems) {
+        data.slowItems->write();
+        data.slowItems.reset();
+    }
+
+    // Stitch together the sequence of each chain and write the details.
+    for(uint64_t chainIndex=0; chainIndex<data.chains.size(); chainIndex++) {
+        const AssemblyPath& assemblyPath = *data.assemblyPaths[chainIndex];
+        assemblyPath.getSequence(data.chains[chainIndex]->sequence);
+        assemblyPath.writeCsv(csv, chainNames[chainIndex]);
+    }
+
+    data.chains.clear();
+    data.assemblyPaths.clear();
+    data.steps.clear();
     cout << timestamp << "Done assembling sequence." << endl;
 }
 
 
 
-// Assemble sequence for a Chain.
-void CompressedPathGraph1B::assembleChain(
-    Chain& chain,
-    uint64_t threadCount1,
-    const string& chainName,
-    ostream& csv) const
+// Create the AssemblyPath for each chain, without assembling it.
+void CompressedPathGraph1B::assembleChainsThreadFunction1(uint64_t /* threadId */)
 {
+    AssembleChainsData& data = assembleChainsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t chainIndex=begin; chainIndex!=end; chainIndex++) {
+            const Chain& chain = *data.chains[chainIndex];
+
+            vector<MarkerGraphEdgePairInfo> infos(chain.size() - 1);
+            for(uint64_t i=0; i<infos.size(); i++) {
+                const MarkerGraphEdgeId edgeId0 = chain[i];
+                const MarkerGraphEdgeId edgeId1 = chain[i+1];
+                SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(
+                    edgeId0, edgeId1, infos[i]));
+            }
 
-    vector<MarkerGraphEdgePairInfo> infos(chain.size() - 1);
-    for(uint64_t i=0; i<infos.size(); i++) {
-        const MarkerGraphEdgeId edgeId0 = chain[i];
-        const MarkerGraphEdgeId edgeId1 = chain[i+1];
-        SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(
-            edgeId0, edgeId1, infos[i]));
+            data.assemblyPaths[chainIndex] =
+                make_shared<AssemblyPath>(assembler, chain, infos, 1, false);
+        }
     }
+}
 
-    AssemblyPath assemblyPath(assembler, chain, infos, threadCount1);
-    assemblyPath.getSequence(chain.sequence);
-    assemblyPath.writeCsv(csv, chainName);
+
+
+// Assemble the steps of all chains.
+void CompressedPathGraph1B::assembleChainsThreadFunction2(uint64_t /* threadId */)
+{
+    AssembleChainsData& data = assembleChainsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const auto& p = data.steps[i];
+            data.assemblyPaths[p.first]->assembleStep(p.second, data.slowItems.get());
+        }
+    }
 }
 
 
@@ -4589,18 +4806,126 @@ void CompressedPathGraph1B::connect(vertex_descriptor cv0, vertex_descriptor cv1
 
 void CompressedPathGraph1B::save(const string& fileName) const
 {
-    ofstream file(fileName);
-    boost::archive::binary_oarchive archive(file);
-    archive << *this;
+    const CompressedPathGraph1B& cGraph = *this;
+
+    // Number the vertices.
+    std::map<vertex_descriptor, uint64_t> vertexIndexMap;
+    vector<MarkerGraphEdgeId> vertexEdgeIds;
+    BGL_FORALL_VERTICES(cv, cGraph, CompressedPathGraph1B) {
+        vertexIndexMap.insert(make_pair(cv, vertexEdgeIds.size()));
+        vertexEdgeIds.push_back(cGraph[cv].edgeId);
+    }
+
+    // Gather the edges and the offset tables.
+    vector<uint64_t> edgeData;
+    vector<uint64_t> bubblesBegin(1, 0);
+    vector<uint64_t> chainsBegin(1, 0);
+    vector<uint64_t> markerGraphEdgeIdsBegin(1, 0);
+    vector<MarkerGraphEdgeId> markerGraphEdgeIds;
+    BGL_FORALL_EDGES(ce, cGraph, CompressedPathGraph1B) {
+        const BubbleChain& bubbleChain = cGraph[ce];
+        edgeData.push_back(vertexIndexMap[source(ce, cGraph)]);
+        edgeData.push_back(vertexIndexMap[target(ce, cGraph)]);
+        edgeData.push_back(cGraph[ce].id);
+        for(const Bubble& bubble: bubbleChain) {
+            for(const Chain& chain: bubble) {
+                markerGraphEdgeIds.insert(markerGraphEdgeIds.end(), chain.begin(), chain.end());
+                markerGraphEdgeIdsBegin.push_back(markerGraphEdgeIds.size());
+            }
+            chainsBegin.push_back(markerGraphEdgeIdsBegin.size() - 1);
+        }
+        bubblesBegin.push_back(chainsBegin.size() - 1);
+    }
+    const uint64_t vertexCount = vertexEdgeIds.size();
+    const uint64_t edgeCount = bubblesBegin.size() - 1;
+    const uint64_t bubbleCount = chainsBegin.size() - 1;
+    const uint64_t chainCount = markerGraphEdgeIdsBegin.size() - 1;
+
+    // Write everything to a single memory mapped vector.
+    MemoryMapped::Vector<uint64_t> snapshot;
+    snapshot.createNew(fileName, 4096);
+    snapshot.reserve(
+        snapshotHeaderSize + vertexCount + edgeData.size() +
+        bubblesBegin.size() + chainsBegin.size() + markerGraphEdgeIdsBegin.size() +
+        markerGraphEdgeIds.size());
+    for(const uint64_t x: {snapshotVersion, componentId, nextEdgeId,
+        vertexCount, edgeCount, bubbleCount, chainCount}) {
+        snapshot.push_back(x);
+    }
+    for(const vector<uint64_t>* v: {&vertexEdgeIds, &edgeData,
+        &bubblesBegin, &chainsBegin, &markerGraphEdgeIdsBegin, &markerGraphEdgeIds}) {
+        for(const uint64_t x: *v) {
+            snapshot.push_back(x);
+        }
+    }
+    snapshot.close();
 }
 
 
 
 void CompressedPathGraph1B::load(const string& fileName)
 {
-    ifstream file(fileName);
-    boost::archive::binary_iarchive archive(file);
-    archive >> *this;
+    CompressedPathGraph1B& cGraph = *this;
+    SHASTA_ASSERT(num_vertices(cGraph) == 0);
+
+    MemoryMapped::Vector<uint64_t> snapshot;
+    snapshot.accessExistingReadOnly(fileName);
+    if(snapshot.size() < snapshotHeaderSize or snapshot[0] != snapshotVersion) {
+        throw runtime_error("Invalid CompressedPathGraph1B snapshot " + fileName);
+    }
+    componentId = snapshot[1];
+    nextEdgeId = snapshot[2];
+    const uint64_t vertexCount = snapshot[3];
+    const uint64_t edgeCount = snapshot[4];
+    const uint64_t bubbleCount = snapshot[5];
+    const uint64_t chainCount = snapshot[6];
+
+    // Locate the arrays in the snapshot.
+    const uint64_t tablesSize = vertexCount + 3 * edgeCount + (edgeCount + 1) + (bubbleCount + 1) + (chainCount + 1);
+    if(snapshot.size() < snapshotHeaderSize + tablesSize) {
+        throw runtime_error("Invalid CompressedPathGraph1B snapshot " + fileName);
+    }
+    const uint64_t* vertexEdgeIds = snapshot.begin() + snapshotHeaderSize;
+    const uint64_t* edgeData = vertexEdgeIds + vertexCount;
+    const uint64_t* bubblesBegin = edgeData + 3 * edgeCount;
+    const uint64_t* chainsBegin = bubblesBegin + (edgeCount + 1);
+    const uint64_t* markerGraphEdgeIdsBegin = chainsBegin + (bubbleCount + 1);
+    const MarkerGraphEdgeId* markerGraphEdgeIds = markerGraphEdgeIdsBegin + (chainCount + 1);
+    if(snapshot.size() != snapshotHeaderSize + tablesSize + markerGraphEdgeIdsBegin[chainCount]) {
+        throw runtime_error("Invalid CompressedPathGraph1B snapshot " + fileName);
+    }
+
+    // Create the vertices.
+    vector<vertex_descriptor> vertexTable;
+    vertexTable.reserve(vertexCount);
+    for(uint64_t i=0; i<vertexCount; i++) {
+        const vertex_descriptor cv = add_vertex(cGraph);
+        cGraph[cv].edgeId = vertexEdgeIds[i];
+        vertexTable.push_back(cv);
+    }
+
+    // Create the edges.
+    for(uint64_t i=0; i<edgeCount; i++) {
+        const uint64_t* e = edgeData + 3 * i;
+        edge_descriptor ce;
+        tie(ce, ignore) = add_edge(vertexTable[e[0]], vertexTable[e[1]], cGraph);
+        CompressedPathGraph1BEdge& edge = cGraph[ce];
+        edge.id = e[2];
+
+        BubbleChain& bubbleChain = edge;
+        bubbleChain.resize(bubblesBegin[i + 1] - bubblesBegin[i]);
+        for(uint64_t j=0; j<bubbleChain.size(); j++) {
+            const uint64_t bubbleId = bubblesBegin[i] + j;
+            Bubble& bubble = bubbleChain[j];
+            bubble.resize(chainsBegin[bubbleId + 1] - chainsBegin[bubbleId]);
+            for(uint64_t k=0; k<bubble.size(); k++) {
+                const uint64_t chainId = chainsBegin[bubbleId] + k;
+                bubble[k].assign(
+                    markerGraphEdgeIds + markerGraphEdgeIdsBegin[chainId],
+                    markerGraphEdgeIds + markerGraphEdgeIdsBegin[chainId + 1]);
+            }
+        }
+    }
 }
 
 
@@ -4675,40 +5000,33 @@ void CompressedPathGraph1B::optimizeChain(
     };
     ChainGraph chainGraph;
 
-    class PathInspector {
+    // A path is better if it has a higher minimum number of common oriented reads
+    // over its edges (minCommonCount), or it has the same minCommonCount and is longer.
+    // A partial path dominates another one ending at the same vertex
+    // if it is not worse in either respect.
+    class PathScorer {
     public:
-        PathInspector(ChainGraph& chainGraph, bool debug) : chainGraph(chainGraph), debug(debug) {}
+        PathScorer(ChainGraph& chainGraph) : chainGraph(chainGraph) {}
         ChainGraph& chainGraph;
-        bool debug;
-        using Path = vector<ChainGraph::edge_descriptor>;
-        Path bestPath;
-        uint64_t bestPathMinCommonCount = 0;
-        void operator()(const Path& path)
-        {
-            // Compute the minimum number of common oriented reads over edges of this path.
-            uint64_t minCommonCount = invalid<uint64_t>;
-            for(const ChainGraph::edge_descriptor e: path) {
-                minCommonCount = min(minCommonCount, chainGraph[e].commonCount);
-            }
 
-            if(debug) {
-                cout << "Path with minCommonCount " << minCommonCount << ":";
-                for(const ChainGraph::edge_descriptor e: path) {
-                    cout << " " << source(e, chainGraph);
-                }
-                cout << " " << target(path.back(), chainGraph) << "\n";
-            }
-
-            // A Path is better if it has a higher minCommonCount or
-            // it has the same minCommonCount and is longer.
-            //
-            if( (minCommonCount >  bestPathMinCommonCount) or
-                (minCommonCount == bestPathMinCommonCount and path.size() > bestPath.size())) {
-                bestPath = path;
-                bestPathMinCommonCount = minCommonCount;
-            }
+        // minCommonCount and path length.
+        using Score = pair<uint64_t, uint64_t>;
+        Score initialScore() const
+        {
+            return {invalid<uint64_t>, 0};
+        }
+        Score extend(const Score& score, ChainGraph::edge_descriptor e) const
+        {
+            return {min(score.first, chainGraph[e].commonCount), score.second + 1};
+        }
+        bool isBetter(const Score& x, const Score& y) const
+        {
+            return (x.first > y.first) or (x.first == y.first and x.second > y.second);
+        }
+        bool dominates(const Score& x, const Score& y) const
+        {
+            return x.first >= y.first and x.second >= y.second;
         }
-
     };
 
     // Construct the initial ChainGraph.
@@ -4818,7 +5136,7 @@ void CompressedPathGraph1B::optimizeChain(
     // for the ChainGraph, with entrance at the beginning of the chain.
     // The unique path on that tree from the entrance to the exit
     // divides the graph in segments, and we can do path enumeration on one segment at a time.
-    shasta::lengauer_tarjan_dominator_tree(chainGraph, 0,
+    shasta::cooper_harvey_kennedy_dominator_tree(chainGraph, 0,
         boost::get(&ChainGraphVertex::immediateDominator, chainGraph));
 
     // The unique path on the dominator tree from the entrance to the exit.
@@ -4870,27 +5188,30 @@ void CompressedPathGraph1B::optimizeChain(
             }
         }
 
-        // If getting here, we have to do path enumeration.
+        // If getting here, we have to find the best path between v0 and v1.
+        // The ChainGraph is acyclic, so this can be done without enumerating all paths.
         if(debug) {
-            cout << "Starting path enumeration between " << v0 << " " << v1 << endl;
+            cout << "Looking for the best path between " << v0 << " " << v1 << endl;
         }
-
-        // Enumerate paths starting at v0 and ending at v1.
-        PathInspector pathInspector(chainGraph, debug);
-        enumeratePathsBetween(chainGraph, v0, v1, pathInspector);
+        vector< vector<ChainGraph::edge_descriptor> > bestPaths;
+        SHASTA_ASSERT(findBestPathsBetween(chainGraph, v0, v1, 1, PathScorer(chainGraph), bestPaths));
+        SHASTA_ASSERT(bestPaths.size() == 1);
+        const vector<ChainGraph::edge_descriptor>& bestPath = bestPaths.front();
 
         if(debug) {
-            if(debug) {
-                cout << "The best path has minCommonCount " << pathInspector.bestPathMinCommonCount << ":";
-                for(const ChainGraph::edge_descriptor e: pathInspector.bestPath) {
-                    cout << " " << source(e, chainGraph);
-                }
-                cout << " " << target(pathInspector.bestPath.back(), chainGraph) << "\n";
+            uint64_t bestPathMinCommonCount = invalid<uint64_t>;
+            for(const ChainGraph::edge_descriptor e: bestPath) {
+                bestPathMinCommonCount = min(bestPathMinCommonCount, chainGraph[e].commonCount);
+            }
+            cout << "The best path has minCommonCount " << bestPathMinCommonCount << ":";
+            for(const ChainGraph::edge_descriptor e: bestPath) {
+                cout << " " << source(e, chainGraph);
             }
+            cout << " " << target(bestPath.back(), chainGraph) << "\n";
         }
 
         // Mark as to be kept all edges on the best path.
-        for(const ChainGraph::edge_descriptor e: pathInspector.bestPath) {
+        for(const ChainGraph::edge_descriptor e: bestPath) {
             chainGraph[e].keep = true;
         }
     }
@@ -4,12 +4,12 @@
 // Shasta
 #include "Base.hpp"
 #include "invalid.hpp"
+#include "MultithreadedObject.hpp"
 #include "shastaTypes.hpp"
 #include "SHASTA_ASSERT.hpp"
 
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
-#include <boost/serialization/vector.hpp>
 
 // Standard library
 #include "array.hpp"
@@ -49,9 +49,11 @@ namespace shasta {
             CompressedPathGraph1BEdge>;
 
         class PathGraph1;
+        class AssemblyPath;
     }
     class Assembler;
     class OrientedReadId;
+    class SlowItemTracer;
 }
 
 
@@ -72,11 +74,6 @@ public:
         SHASTA_ASSERT(size() > 1);
         return (*this)[size() - 2];
     }
-
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & boost::serialization::base_object< vector<MarkerGraphEdgeId> >(*this);
-    }
 };
 
 
@@ -95,11 +92,6 @@ public:
     {
         return size() > 2;
     }
-
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & boost::serialization::base_object< vector<Chain> >(*this);
-    }
 };
 
 
@@ -151,11 +143,6 @@ public:
         }
         return markerGraphEdgeId;
     }
-
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & boost::serialization::base_object< vector<Bubble> >(*this);
-    }
 };
 
 
@@ -172,11 +159,6 @@ public:
     // The id of the Superbubble this vertex belongs to, if any.
     // Stored by class Superbubbles.
     uint64_t superbubbleId = invalid<uint64_t>;
-
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & edgeId;
-    }
 };
 
 
@@ -184,17 +166,13 @@ public:
 class shasta::mode3b::CompressedPathGraph1BEdge : public BubbleChain {
 public:
     uint64_t id = invalid<uint64_t>;
-
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & boost::serialization::base_object<BubbleChain>(*this);
-        ar & id;
-    }
 };
 
 
 
-class shasta::mode3b::CompressedPathGraph1B: public CompressedPathGraph1BBaseClass {
+class shasta::mode3b::CompressedPathGraph1B:
+    public CompressedPathGraph1BBaseClass,
+    public MultithreadedObject<CompressedPathGraph1B> {
 public:
 
     // Create from a PathGraph1, then call run.
@@ -205,7 +183,7 @@ public:
         uint64_t threadCount0,
         uint64_t threadCount1);
 
-    // Load it from a binary archive, then call run.
+    // Load it from a snapshot created by save, then call run.
     CompressedPathGraph1B(
         const string& fileName,
         const Assembler&,
@@ -216,16 +194,22 @@ private:
     // Information stored by the constructor.
     uint64_t componentId;
     const Assembler& assembler;
-
-    friend class boost::serialization::access;
-    template<class Archive> void serialize(Archive & ar, const unsigned int version)
-    {
-        ar & boost::serialization::base_object<CompressedPathGraph1BBaseClass>(*this);
-        ar & componentId;
-        ar & nextEdgeId;
-    }
+    uint64_t threadCount0;
+
+    // Save and load a snapshot of the graph, to facilitate debugging.
+    // The snapshot is a single memory mapped vector of uint64_t containing:
+    // - A header with the snapshot format version, componentId, nextEdgeId,
+    //   and the number of vertices, edges, bubbles, and chains.
+    // - The MarkerGraphEdgeId of each vertex.
+    // - For each edge, the indexes of its source and target vertices and its id.
+    // - Offset tables for the bubbles of each edge, the chains of each bubble,
+    //   and the MarkerGraphEdgeIds of each chain.
+    // - One contiguous array with the MarkerGraphEdgeIds of all chains.
+    // Loading maps the file and builds the graph directly from these arrays.
     void save(const string& fileName) const;
     void load(const string& fileName);
+    static const uint64_t snapshotVersion = 1;
+    static const uint64_t snapshotHeaderSize = 7;
 
     void run(
         uint64_t threadCount0,
@@ -281,6 +265,29 @@ private:
         bool setToZeroForComplementaryPairs
         ) const;
 
+    // The tangle matrix elements are numbers of common oriented reads
+    // between pairs of MarkerGraphEdgeIds. They only depend on the marker graph,
+    // so at the beginning of a detangling round we compute in parallel
+    // the ones that could be needed during the round, and store them here,
+    // sorted by MarkerGraphEdgeId pair. The detangling decisions
+    // are then made sequentially, but without having to recompute them.
+    // Pairs not found here are computed on the fly.
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> > commonCountPairs;
+    vector<uint64_t> commonCounts;
+    void computeCommonCounts(vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> >&);
+    void computeCommonCountsThreadFunction(uint64_t threadId);
+    void clearCommonCounts();
+    uint64_t getCommonCount(MarkerGraphEdgeId, MarkerGraphEdgeId) const;
+
+    // Compute in parallel the common counts that can be needed
+    // to detangle vertices or edges.
+    void computeCommonCountsForVertexDetangling();
+    void computeCommonCountsForEdgeDetangling();
+    void addCommonCountPairs(
+        vertex_descriptor cv0,
+        vertex_descriptor cv1,
+        vector< pair<MarkerGraphEdgeId, MarkerGraphEdgeId> >&) const;
+
     // Low level primitives used in detangling.
     // See the implementation for details.
     vertex_descriptor cloneAndTruncateAtEnd(edge_descriptor);
@@ -540,12 +547,25 @@ private:
         );
 
     // Sequence assembly.
+    // The assembly steps of all chains are assembled in parallel
+    // as a single pool of tasks, longest steps first,
+    // and then the sequence of each chain is stitched together in order.
     void assembleChains(uint64_t threadCount0, uint64_t threadCount1);
-    void assembleChain(
-        Chain&,
-        uint64_t threadCount1,
-        const string& chainName,
-        ostream& csv) const;
+    class AssembleChainsData {
+    public:
+        vector<Chain*> chains;
+        vector< shared_ptr<AssemblyPath> > assemblyPaths;
+
+        // The steps of all chains, as pairs(chain index, step index),
+        // in the order in which they are assembled.
+        vector< pair<uint64_t, uint64_t> > steps;
+
+        // Only used if slow item tracing is enabled.
+        shared_ptr<SlowItemTracer> slowItems;
+    };
+    AssembleChainsData assembleChainsData;
+    void assembleChainsThreadFunction1(uint64_t threadId);
+    void assembleChainsThreadFunction2(uint64_t threadId);
 
 
     // Output.
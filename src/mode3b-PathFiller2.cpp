@@ -205,12 +205,8 @@ void PathFiller2::gatherOrientedReads()
 {
     // Gather the OrientedReadIds that appear on edgeIdA or edgeIdB.
     vector<OrientedReadId> orientedReadIds;
-    for(const MarkerInterval& markerInterval: assembler.markerGraph.edgeMarkerIntervals[edgeIdA]) {
-        orientedReadIds.push_back(markerInterval.orientedReadId);
-    }
-    for(const MarkerInterval& markerInterval: assembler.markerGraph.edgeMarkerIntervals[edgeIdB]) {
-        orientedReadIds.push_back(markerInterval.orientedReadId);
-    }
+    assembler.markerGraph.appendEdgeOrientedReadIds(edgeIdA, orientedReadIds);
+    assembler.markerGraph.appendEdgeOrientedReadIds(edgeIdB, orientedReadIds);
     deduplicate(orientedReadIds);
 
     // Store the OrientedReadIds.
@@ -570,7 +570,7 @@ void PathFiller3::writeMarkers()
             kmer.write(html, k);
             html <<
                 "<td class=centered>" << markerInfo.disjointSetId <<
-                "<td class=centered>" << disjointSetsMap[markerInfo.disjointSetId].size();
+                "<td class=centered>" << disjointSetSize(markerInfo.disjointSetId);
         }
     }
 
@@ -907,20 +907,41 @@ void PathFiller3::alignAndDisjointSets(
         }
     }
 
-    // Fill in the disjoint sets map.
-    disjointSetsMap.clear();
+    // Store the markers of each disjoint set, using a counting sort.
+    // First, count the markers in each disjoint set.
+    disjointSetsBegin.assign(markerCount + 1, 0);
+    for(const OrientedReadInfo& info: orientedReadInfos) {
+        for(const MarkerInfo& markerInfo: info.markerInfos) {
+            ++disjointSetsBegin[markerInfo.disjointSetId + 1];
+        }
+    }
+    for(uint64_t disjointSetId=0; disjointSetId<markerCount; disjointSetId++) {
+        disjointSetsBegin[disjointSetId + 1] += disjointSetsBegin[disjointSetId];
+    }
+
+    // Then, store the markers. This uses disjointSetsBegin[disjointSetId]
+    // as the insertion point, so at the end disjointSetsBegin[disjointSetId]
+    // contains the end of disjoint set disjointSetId, and we have to shift it.
+    disjointSetsMarkers.resize(markerCount);
     for(uint64_t i=0; i<orientedReadInfos.size(); i++) {
         const OrientedReadInfo& info = orientedReadInfos[i];
         for(uint64_t j=0; j<info.markerInfos.size(); j++) {
             const MarkerInfo& markerInfo = info.markerInfos[j];
-            disjointSetsMap[markerInfo.disjointSetId].push_back({i, j});
+            disjointSetsMarkers[disjointSetsBegin[markerInfo.disjointSetId]++] = {i, j};
         }
     }
+    for(uint64_t disjointSetId=markerCount; disjointSetId>0; disjointSetId--) {
+        disjointSetsBegin[disjointSetId] = disjointSetsBegin[disjointSetId - 1];
+    }
+    disjointSetsBegin[0] = 0;
 
     // Histogram disjoint sets sizes.
     disjointSetsSizeHistogram.clear();
-    for(const auto& p: disjointSetsMap) {
-        const uint64_t disjointSetSize = p.second.size();
+    for(uint64_t disjointSetId=0; disjointSetId<markerCount; disjointSetId++) {
+        const uint64_t disjointSetSize = PathFiller3::disjointSetSize(disjointSetId);
+        if(disjointSetSize == 0) {
+            continue;
+        }
         if(disjointSetSize >= disjointSetsSizeHistogram.size()) {
             disjointSetsSizeHistogram.resize(disjointSetSize + 1, 0);
         }
@@ -1043,10 +1064,12 @@ uint64_t PathFiller3::createVertices(
 
     // Loop over disjoint sets that are large enough.
     // Also always include disjointSetIdA and disjointSetIdB.
-    for(const auto& p: disjointSetsMap) {
-        const uint64_t disjointSetId = p.first;
-        const auto& disjointSet = p.second;
-        if(disjointSet.size() >= minVertexCoverage or
+    for(uint64_t disjointSetId=0; disjointSetId<disjointSetsBegin.size()-1; disjointSetId++) {
+        const uint64_t disjointSetSize = PathFiller3::disjointSetSize(disjointSetId);
+        if(disjointSetSize == 0) {
+            continue;
+        }
+        if(disjointSetSize >= minVertexCoverage or
             disjointSetId==disjointSetIdA or
             disjointSetId==disjointSetIdB) {
 
@@ -1166,9 +1189,8 @@ void PathFiller3::writeGraphviz(ostream& s) const
     // Vertices.
     BGL_FORALL_VERTICES(v, graph, PathFiller3) {
         const uint64_t disjointSetId = graph[v].disjointSetId;
-        auto it = disjointSetsMap.find(disjointSetId);
-        SHASTA_ASSERT(it != disjointSetsMap.end());
-        const uint64_t coverage = it->second.size();
+        SHASTA_ASSERT(disjointSetId < disjointSetsBegin.size() - 1);
+        const uint64_t coverage = disjointSetSize(disjointSetId);
 
         const bool isA = (graph[v].disjointSetId == disjointSetIdA);
         const bool isB = (graph[v].disjointSetId == disjointSetIdB);
@@ -1457,8 +1479,33 @@ void PathFiller3::assembleAssemblyPathEdges(
 {
     const PathFiller3& graph = *this;
 
-    for(const edge_descriptor e: assemblyPath) {
-        assembleEdge(maxMsaLength, longMsaPolicy, e);
+    if(html and options.showAssemblyDetails) {
+
+        // Assemble one edge at a time, to keep the html output
+        // for each edge together.
+        for(const edge_descriptor e: assemblyPath) {
+            assembleEdge(maxMsaLength, longMsaPolicy, e);
+        }
+
+    } else {
+
+        // Gather the sequences for all edges, then compute
+        // all the required MSAs with a single call.
+        vector< vector< pair<vector<Base>, uint64_t> > > batch;
+        vector<edge_descriptor> batchEdges;
+        vector< pair<vector<Base>, uint64_t> > orientedReadSequences;
+        for(const edge_descriptor e: assemblyPath) {
+            if(gatherEdgeSequences(maxMsaLength, longMsaPolicy, e, orientedReadSequences)) {
+                batch.push_back(orientedReadSequences);
+                batchEdges.push_back(e);
+            }
+        }
+
+        vector< vector< vector<AlignedBase> > > alignments;
+        globalMsaSpoaBatch(batch, alignments);
+        for(uint64_t i=0; i<batch.size(); i++) {
+            storeEdgeConsensus(batchEdges[i], batch[i], alignments[i]);
+        }
     }
 
 
@@ -1511,6 +1558,22 @@ void PathFiller3::assembleEdge(
     uint64_t maxMsaLength,
     LongMsaPolicy longMsaPolicy,
     edge_descriptor e)
+{
+    vector< pair<vector<Base>, uint64_t> > orientedReadSequences;
+    if(gatherEdgeSequences(maxMsaLength, longMsaPolicy, e, orientedReadSequences)) {
+        vector< vector<AlignedBase> > alignment;
+        globalMsaSpoa(orientedReadSequences, alignment);
+        storeEdgeConsensus(e, orientedReadSequences, alignment);
+    }
+}
+
+
+
+bool PathFiller3::gatherEdgeSequences(
+    uint64_t maxMsaLength,
+    LongMsaPolicy longMsaPolicy,
+    edge_descriptor e,
+    vector< pair<vector<Base>, uint64_t> >& orientedReadSequences)
 {
     PathFiller3& graph = *this;
     PathFiller3Edge& edge = graph[e];
@@ -1530,7 +1593,7 @@ void PathFiller3::assembleEdge(
     // Gather the sequences of the contributing oriented reads.
     // Each sequence is stored with the number of distinct oriented reads that
     // have that sequence.
-    vector< pair<vector<Base>, uint64_t> > orientedReadSequences;
+    orientedReadSequences.clear();
 
     // Loop over marker intervals of this edge.
     vector<Base> orientedReadSequence;
@@ -1621,7 +1684,7 @@ void PathFiller3::assembleEdge(
         edge.consensusSequence = sequence;
         edge.consensusCoverage.clear();
         edge.consensusCoverage.resize(sequence.size(), coverage);
-        return;
+        return false;
     }
 
 
@@ -1656,9 +1719,18 @@ void PathFiller3::assembleEdge(
         }
     }
 
-    // Compute the MSA.
-    vector< vector<AlignedBase> > alignment;
-    globalMsaSpoa(orientedReadSequences, alignment);
+    return true;
+}
+
+
+
+void PathFiller3::storeEdgeConsensus(
+    edge_descriptor e,
+    const vector< pair<vector<Base>, uint64_t> >& orientedReadSequences,
+    const vector< vector<AlignedBase> >& alignment)
+{
+    PathFiller3& graph = *this;
+    PathFiller3Edge& edge = graph[e];
     SHASTA_ASSERT(alignment.size() == orientedReadSequences.size());
 
     // Compute coverage at each alignment position for each of the 5 AlignedBases.
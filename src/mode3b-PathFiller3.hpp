@@ -14,6 +14,8 @@
 #include <boost/graph/adjacency_list.hpp>
 
 // Standard library.
+#include <list>
+#include <memory_resource>
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -21,15 +23,19 @@
 
 namespace shasta {
     namespace mode3b {
+        template<class T> class PathFiller3Allocator;
+        class PathFiller3ListS;
         class PathFiller3Vertex;
         class PathFiller3Edge;
         class PathFiller3;
         using PathFiller3BaseClass = boost::adjacency_list<
-            boost::listS,
-            boost::listS,
+            PathFiller3ListS,
+            PathFiller3ListS,
             boost::bidirectionalS,
             PathFiller3Vertex,
-            PathFiller3Edge
+            PathFiller3Edge,
+            boost::no_property,
+            PathFiller3ListS
             >;
         class PathFiller3DisplayOptions;
         class PathFiller3MarkerIndexes;
@@ -39,6 +45,72 @@ namespace shasta {
 
 
 
+// A PathFiller3 is created for each assembly step, and its local marker graph
+// and disjoint sets make a large number of small allocations.
+// PathFiller3Allocator gets that memory from a pool owned by the current thread.
+// When a PathFiller3 is destroyed its memory goes back to the pool
+// and is reused by the next PathFiller3 created by the same thread,
+// without going back to the global heap.
+// This means that a PathFiller3 must be destroyed
+// by the same thread that created it.
+template<class T> class shasta::mode3b::PathFiller3Allocator {
+public:
+    using value_type = T;
+
+    PathFiller3Allocator() : memoryResource(threadMemoryResource()) {}
+    template<class U> PathFiller3Allocator(const PathFiller3Allocator<U>& that) :
+        memoryResource(that.memoryResource) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(memoryResource->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n)
+    {
+        memoryResource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template<class U> bool operator==(const PathFiller3Allocator<U>& that) const
+    {
+        return memoryResource == that.memoryResource;
+    }
+    template<class U> bool operator!=(const PathFiller3Allocator<U>& that) const
+    {
+        return memoryResource != that.memoryResource;
+    }
+
+private:
+    std::pmr::memory_resource* memoryResource;
+    template<class U> friend class PathFiller3Allocator;
+
+    // The pool of the current thread. It is never shared between threads,
+    // so it does not need locking.
+    static std::pmr::memory_resource* threadMemoryResource()
+    {
+        thread_local std::pmr::unsynchronized_pool_resource pool(
+            std::pmr::pool_options{0, 1024 * 1024});
+        return &pool;
+    }
+};
+
+
+
+// Boost graph container selector that uses a std::list with a PathFiller3Allocator.
+// It is used for the vertices and edges of the PathFiller3 local marker graph,
+// and otherwise behaves like boost::listS.
+class shasta::mode3b::PathFiller3ListS {};
+
+namespace boost {
+    template<class T> struct container_gen<shasta::mode3b::PathFiller3ListS, T> {
+        using type = std::list<T, shasta::mode3b::PathFiller3Allocator<T> >;
+    };
+    template<> struct parallel_edge_traits<shasta::mode3b::PathFiller3ListS> {
+        using type = allow_parallel_edge_tag;
+    };
+}
+
+
+
 class shasta::mode3b::PathFiller3DisplayOptions {
 public:
 
@@ -81,7 +153,10 @@ class shasta::mode3b::PathFiller3Edge {
 public:
 
     // Each marker interval is identified by the two markers.
-    vector< pair<PathFiller3MarkerIndexes, PathFiller3MarkerIndexes> > markerIntervals;
+    vector<
+        pair<PathFiller3MarkerIndexes, PathFiller3MarkerIndexes>,
+        PathFiller3Allocator< pair<PathFiller3MarkerIndexes, PathFiller3MarkerIndexes> >
+        > markerIntervals;
 
     uint64_t coverage() const
     {
@@ -259,8 +334,16 @@ private:
     // Each marker is stored as pair(i, j)
     // where i is the index of the OrientedReadInfo in orientedReadInfos
     // and j is the index of the MarkerInfo in orientedReadInfo.markerInfos.
-    // Keyed by the disjoint set id (the same also stored in each marker).
-    std::map<uint64_t, vector<PathFiller3MarkerIndexes> > disjointSetsMap;
+    // Disjoint set ids are marker ids, so the markers are stored contiguously,
+    // sorted by disjoint set id: the markers of a disjoint set are
+    // disjointSetsMarkers[disjointSetsBegin[disjointSetId], disjointSetsBegin[disjointSetId+1]).
+    // Some disjoint sets are empty because their id is not the id of any representative marker.
+    vector<uint64_t, PathFiller3Allocator<uint64_t> > disjointSetsBegin;
+    vector<PathFiller3MarkerIndexes, PathFiller3Allocator<PathFiller3MarkerIndexes> > disjointSetsMarkers;
+    uint64_t disjointSetSize(uint64_t disjointSetId) const
+    {
+        return disjointSetsBegin[disjointSetId + 1] - disjointSetsBegin[disjointSetId];
+    }
 
     vector<uint64_t> disjointSetsSizeHistogram;
 
@@ -310,6 +393,23 @@ private:
         LongMsaPolicy,
         edge_descriptor);
 
+    // The two halves of assembleEdge.
+    // gatherEdgeSequences gathers the distinct sequences of the oriented reads
+    // and returns true if an MSA is needed to compute the consensus.
+    // Otherwise, it stores the consensus in the edge.
+    // storeEdgeConsensus computes the consensus from the MSA.
+    // This allows assembleAssemblyPathEdges to compute
+    // all the MSAs of the assembly path with a single call to globalMsaSpoaBatch.
+    bool gatherEdgeSequences(
+        uint64_t maxMsaLength,
+        LongMsaPolicy,
+        edge_descriptor,
+        vector< pair<vector<Base>, uint64_t> >& orientedReadSequences);
+    void storeEdgeConsensus(
+        edge_descriptor,
+        const vector< pair<vector<Base>, uint64_t> >& orientedReadSequences,
+        const vector< vector<AlignedBase> >& alignment);
+
     // Graphviz output.
     void writeGraph() const;
     void writeGraph(const string& title);
@@ -76,6 +76,20 @@ PathFinder::PathFinder(
     MappedMemoryOwner(assembler),
     MultithreadedObject<PathFinder>(*this),
     assembler(assembler)
+{
+    const bool debug = true;
+    extendPath(startEdgeId, direction, primaryEdges, debug);
+}
+
+
+
+// Move from startEdgeId in the specified direction, with backtracking.
+// This only reads the Assembler and can be called concurrently.
+void PathFinder::extendPath(
+    MarkerGraphEdgeId startEdgeId,
+    uint64_t direction,
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> >& primaryEdges,
+    bool debug) const
 {
     SHASTA_ASSERT(direction < 2);
 
@@ -89,8 +103,6 @@ PathFinder::PathFinder(
 
     std::set<MarkerGraphEdgeId> forbiddenEdgeIds;
 
-    const bool debug = true;
-
 
 
     // To create the primary edges, move in the specified direction
@@ -116,7 +128,7 @@ PathFinder::PathFinder(
             edgeId, direction,
             minCoverage, maxCoverage,
             maxMarkerOffset, minCommonCount, minCorrectedJaccard,
-            forbiddenEdgeIds);
+            forbiddenEdgeIds, debug);
         const MarkerGraphEdgeId nextEdgeId = p.first;
 
         if(nextEdgeId == invalid<MarkerGraphEdgeId>) {
@@ -145,7 +157,9 @@ PathFinder::PathFinder(
             }
         }
     }
-    cout << "Found " << primaryEdges.size() + 1 << " primary edges including the starting edge." << endl;
+    if(debug) {
+        cout << "Found " << primaryEdges.size() + 1 << " primary edges including the starting edge." << endl;
+    }
 }
 
 
@@ -323,7 +337,8 @@ pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> PathFinder::findNextPrimaryEdge
     uint64_t maxMarkerOffset,
     uint64_t minCommonCount,
     double minCorrectedJaccard,
-    const std::set<MarkerGraphEdgeId>& forbiddedEdgeIds) const
+    const std::set<MarkerGraphEdgeId>& forbiddedEdgeIds,
+    bool debug) const
 {
     const MarkerGraph& markerGraph = assembler.markerGraph;
     const auto& markers = assembler.markers;
@@ -394,10 +409,12 @@ pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> PathFinder::findNextPrimaryEdge
                 (direction==0 and info.offsetInBases >= 0) or
                 (direction==1 and info.offsetInBases <= 0);
             if(hasConsistentOffset and info.common >= minCommonCount and correctedJaccard >= minCorrectedJaccard) {
-                cout << edgeId0 << " " << edgeId1 << ": base offset " <<
-                    info.offsetInBases << ", common " << info.common <<
-                    ", corrected jaccard " <<
-                    " " << info.correctedJaccard() << endl;
+                if(debug) {
+                    cout << edgeId0 << " " << edgeId1 << ": base offset " <<
+                        info.offsetInBases << ", common " << info.common <<
+                        ", corrected jaccard " <<
+                        " " << info.correctedJaccard() << endl;
+                }
                 return make_pair(edgeId1, info);
             }
         }
@@ -1154,3 +1171,290 @@ void PathFinder::Graph::writeGraphviz(
 
     out << "}\n";
 }
+
+
+
+// Parallel path finding.
+// All marker graph edges suitable to become primary edges are used as seeds.
+// The result is the same as if the seeds were processed serially
+// in order of increasing id, each seed generating a path
+// (using extendPath in both directions) unless it is already on
+// a path that was kept, and each path being truncated at the first
+// edge, in each direction, that is already on a path that was kept.
+//
+// To do this in parallel, the seeds are processed in rounds
+// of consecutive seed ids. During a round, the
+// threads compute the paths for the seeds of the round.
+// Each thread first claims its seed atomically, and then
+// all the edges of the path it computed.
+// A claim succeeds if the edge is not owned by a path that was kept
+// and is not claimed by a lower seed id, so conflicts are
+// always resolved in favor of the lowest seed id.
+// A seed that was already claimed when a thread gets to it is skipped.
+// At the end of the round, the paths are kept or discarded serially,
+// in order of increasing seed id. A seed that was skipped, but whose
+// path is needed because the path that claimed it was truncated,
+// has its path computed at that time.
+void PathFinder::findPrimaryPaths(uint64_t threadCount)
+{
+    // EXPOSE WHEN CODE STABILIZES.
+    const uint64_t minCoverage = 8;
+    const uint64_t maxCoverage = 35;
+    const uint64_t minPrimaryEdgeCount = 3;
+
+    const uint64_t edgeCount = assembler.markerGraph.edges.size();
+    cout << timestamp << "Finding primary paths using " << threadCount <<
+        " threads for " << edgeCount << " marker graph edges." << endl;
+
+    findPrimaryPathsData.minCoverage = minCoverage;
+    findPrimaryPathsData.maxCoverage = maxCoverage;
+
+    createNew(primaryEdgeOwner, "PathFinder-PrimaryEdgeOwner");
+    primaryEdgeOwner.resize(edgeCount);
+    fill(primaryEdgeOwner.begin(), primaryEdgeOwner.end(), invalid<uint64_t>);
+    primaryPaths.clear();
+
+    // Rounds must be large enough to keep all threads busy,
+    // but small enough that few paths are computed and then discarded.
+    const uint64_t roundSize = 1000 * threadCount;
+    const uint64_t batchSize = 10;
+    for(uint64_t roundBegin=0; roundBegin<edgeCount; roundBegin+=roundSize) {
+        const uint64_t roundEnd = min(edgeCount, roundBegin + roundSize);
+        if((roundBegin / roundSize) % 1000 == 0) {
+            cout << timestamp << roundBegin << "/" << edgeCount <<
+                ", " << primaryPaths.size() << " paths kept so far." << endl;
+        }
+
+        // Compute the paths of this round in parallel.
+        findPrimaryPathsData.roundBegin = roundBegin;
+        findPrimaryPathsData.roundPaths.clear();
+        findPrimaryPathsData.roundPaths.resize(roundEnd - roundBegin);
+        setupLoadBalancing(roundEnd - roundBegin, batchSize);
+        runThreads(&PathFinder::findPrimaryPathsThreadFunction, threadCount);
+
+        // Decide which paths to keep, in order of increasing seed id.
+        for(PrimaryPath& path: findPrimaryPathsData.roundPaths) {
+            if(path.isSeed) {
+                keepPrimaryPath(path, minPrimaryEdgeCount);
+            }
+        }
+
+        // Remove the claims that were not made permanent.
+        for(const PrimaryPath& path: findPrimaryPathsData.roundPaths) {
+            if(not path.wasComputed) {
+                continue;
+            }
+            for(const MarkerGraphEdgeId edgeId: path.primaryEdges) {
+                if(primaryEdgeOwner[edgeId] == path.seedEdgeId) {
+                    primaryEdgeOwner[edgeId] = invalid<uint64_t>;
+                }
+            }
+        }
+    }
+    findPrimaryPathsData.roundPaths.clear();
+    findPrimaryPathsData.roundPaths.shrink_to_fit();
+    primaryEdgeOwner.remove();
+
+    cout << timestamp << "Kept " << primaryPaths.size() << " primary paths." << endl;
+    writePrimaryPaths();
+}
+
+
+
+void PathFinder::findPrimaryPathsThreadFunction(uint64_t threadId)
+{
+    const uint64_t roundBegin = findPrimaryPathsData.roundBegin;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const MarkerGraphEdgeId seedEdgeId = roundBegin + i;
+            PrimaryPath& path = findPrimaryPathsData.roundPaths[i];
+            path.seedEdgeId = seedEdgeId;
+            path.isSeed = isPrimaryPathSeed(seedEdgeId);
+            if(not path.isSeed) {
+                continue;
+            }
+
+            // If the seed is already claimed by a lower seed id
+            // or on a path that was kept, skip it.
+            if(not claimPrimaryEdge(seedEdgeId, seedEdgeId)) {
+                continue;
+            }
+
+            // Compute the path and claim its edges.
+            // If a claim fails, the conflict will be resolved
+            // when deciding which paths to keep.
+            computePrimaryPath(seedEdgeId, path);
+            for(const MarkerGraphEdgeId edgeId: path.primaryEdges) {
+                claimPrimaryEdge(edgeId, seedEdgeId);
+            }
+        }
+    }
+}
+
+
+
+// Claim a marker graph edge for the path generated by a seed.
+// Returns true if the edge is now claimed by that seed.
+bool PathFinder::claimPrimaryEdge(MarkerGraphEdgeId edgeId, MarkerGraphEdgeId seedEdgeId)
+{
+    uint64_t& owner = primaryEdgeOwner[edgeId];
+    uint64_t currentOwner = __atomic_load_n(&owner, __ATOMIC_SEQ_CST);
+    while(true) {
+        if(currentOwner != invalid<uint64_t>) {
+            if((currentOwner & keptOwnerFlag) or (currentOwner <= seedEdgeId)) {
+                return currentOwner == seedEdgeId;
+            }
+        }
+
+        // On failure, this updates currentOwner, and we try again.
+        if(__atomic_compare_exchange_n(&owner, &currentOwner, seedEdgeId,
+            false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            return true;
+        }
+    }
+}
+
+
+
+// A marker graph edge can be used as a seed if its coverage is in
+// the range used by extendPath and it has no duplicate oriented reads.
+bool PathFinder::isPrimaryPathSeed(MarkerGraphEdgeId edgeId) const
+{
+    const MarkerGraph& markerGraph = assembler.markerGraph;
+
+    const uint64_t coverage = markerGraph.edgeCoverage(edgeId);
+    if(coverage < findPrimaryPathsData.minCoverage or coverage > findPrimaryPathsData.maxCoverage) {
+        return false;
+    }
+
+    const MarkerGraph::Edge& edge = markerGraph.edges[edgeId];
+    return not(
+        markerGraph.edgeHasDuplicateOrientedReadIds(edgeId) or
+        markerGraph.vertexHasDuplicateOrientedReadIds(edge.source, assembler.markers) or
+        markerGraph.vertexHasDuplicateOrientedReadIds(edge.target, assembler.markers));
+}
+
+
+
+// Compute the path generated by a seed, moving in both directions.
+void PathFinder::computePrimaryPath(MarkerGraphEdgeId seedEdgeId, PrimaryPath& path) const
+{
+    const bool debug = false;
+
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> > forwardPrimaryEdges;
+    extendPath(seedEdgeId, 0, forwardPrimaryEdges, debug);
+    vector< pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> > backwardPrimaryEdges;
+    extendPath(seedEdgeId, 1, backwardPrimaryEdges, debug);
+    reverse(backwardPrimaryEdges.begin(), backwardPrimaryEdges.end());
+
+    path.primaryEdges.clear();
+    path.infos.clear();
+    for(auto& p: backwardPrimaryEdges) {
+        p.second.reverse();
+        path.primaryEdges.push_back(p.first);
+        path.infos.push_back(p.second);
+    }
+    path.seedPosition = path.primaryEdges.size();
+    path.primaryEdges.push_back(seedEdgeId);
+    for(const auto& p: forwardPrimaryEdges) {
+        path.primaryEdges.push_back(p.first);
+        path.infos.push_back(p.second);
+    }
+    path.wasComputed = true;
+    SHASTA_ASSERT(path.primaryEdges.size() == path.infos.size() + 1);
+}
+
+
+
+// Decide whether to keep a path. This must be called serially,
+// in order of increasing seed id.
+void PathFinder::keepPrimaryPath(PrimaryPath& path, uint64_t minPrimaryEdgeCount)
+{
+    const MarkerGraphEdgeId seedEdgeId = path.seedEdgeId;
+    const auto isKept = [this](MarkerGraphEdgeId edgeId)
+    {
+        const uint64_t owner = primaryEdgeOwner[edgeId];
+        return (owner != invalid<uint64_t>) and (owner & keptOwnerFlag);
+    };
+
+    // If the seed is on a path that was kept, discard this path.
+    if(isKept(seedEdgeId)) {
+        return;
+    }
+
+    // If the path was not computed because its seed was claimed
+    // by a path that was discarded or truncated, compute it now.
+    if(not path.wasComputed) {
+        computePrimaryPath(seedEdgeId, path);
+    }
+
+    // Truncate the path at the first edge already on a path that was kept,
+    // in each direction. An edge that appears more than once
+    // also causes truncation.
+    std::set<MarkerGraphEdgeId> pathEdges = {seedEdgeId};
+    uint64_t end = path.seedPosition + 1;
+    for(; end<path.primaryEdges.size(); end++) {
+        const MarkerGraphEdgeId edgeId = path.primaryEdges[end];
+        if(isKept(edgeId) or not pathEdges.insert(edgeId).second) {
+            break;
+        }
+    }
+    uint64_t begin = path.seedPosition;
+    for(; begin>0; begin--) {
+        const MarkerGraphEdgeId edgeId = path.primaryEdges[begin - 1];
+        if(isKept(edgeId) or not pathEdges.insert(edgeId).second) {
+            break;
+        }
+    }
+    if(end - begin < minPrimaryEdgeCount) {
+        return;
+    }
+
+    // Keep it.
+    PrimaryPath keptPath;
+    keptPath.seedEdgeId = seedEdgeId;
+    keptPath.seedPosition = path.seedPosition - begin;
+    keptPath.primaryEdges.assign(path.primaryEdges.begin() + begin, path.primaryEdges.begin() + end);
+    keptPath.infos.assign(path.infos.begin() + begin, path.infos.begin() + (end - 1));
+    keptPath.isSeed = true;
+    keptPath.wasComputed = true;
+    for(const MarkerGraphEdgeId edgeId: keptPath.primaryEdges) {
+        primaryEdgeOwner[edgeId] = seedEdgeId | keptOwnerFlag;
+    }
+    primaryPaths.push_back(keptPath);
+}
+
+
+
+void PathFinder::writePrimaryPaths() const
+{
+    ofstream summaryCsv("PrimaryPaths.csv");
+    summaryCsv << "Path,Seed,Primary edges,Offset in bases\n";
+    ofstream detailsCsv("PrimaryPathsDetails.csv");
+    detailsCsv << "Path,Position,Primary edge,Offset in bases from previous\n";
+
+    for(uint64_t pathId=0; pathId<primaryPaths.size(); pathId++) {
+        const PrimaryPath& path = primaryPaths[pathId];
+
+        int64_t offset = 0;
+        for(const MarkerGraphEdgePairInfo& info: path.infos) {
+            offset += info.offsetInBases;
+        }
+        summaryCsv << pathId << ",";
+        summaryCsv << path.seedEdgeId << ",";
+        summaryCsv << path.primaryEdges.size() << ",";
+        summaryCsv << offset << "\n";
+
+        for(uint64_t position=0; position<path.primaryEdges.size(); position++) {
+            detailsCsv << pathId << ",";
+            detailsCsv << position << ",";
+            detailsCsv << path.primaryEdges[position] << ",";
+            if(position > 0) {
+                detailsCsv << path.infos[position - 1].offsetInBases;
+            }
+            detailsCsv << "\n";
+        }
+    }
+}
@@ -1,8 +1,10 @@
 #ifndef SHASTA_MODE3B_PATH_FINDER_HPP
 #define SHASTA_MODE3B_PATH_FINDER_HPP
 
+#include "invalid.hpp"
 #include "MappedMemoryOwner.hpp"
 #include "MarkerGraphEdgePairInfo.hpp"
+#include "MemoryMappedVector.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 #include "shastaTypes.hpp"
@@ -38,6 +40,11 @@ public:
 
     PathFinder(const Assembler&, uint64_t threadCount);
     PathFinder(const Assembler&);
+
+    // Find paths in parallel, using as seeds all marker graph edges
+    // suitable to become primary edges.
+    // See the comments before the implementation for more information.
+    void findPrimaryPaths(uint64_t threadCount);
 private:
 
     // Things we get from the constructor.
@@ -62,7 +69,16 @@ private:
         uint64_t maxMarkerOffset,
         uint64_t minCommonCount,
         double minCorrectedJaccard,
-        const std::set<MarkerGraphEdgeId>& forbiddedEdgeIds) const;
+        const std::set<MarkerGraphEdgeId>& forbiddedEdgeIds,
+        bool debug) const;
+
+    // Move from startEdgeId in the specified direction, with backtracking.
+    // Used by the first constructor and by findPrimaryPaths.
+    void extendPath(
+        MarkerGraphEdgeId startEdgeId,
+        uint64_t direction,
+        vector< pair<MarkerGraphEdgeId, MarkerGraphEdgePairInfo> >& primaryEdges,
+        bool debug) const;
 
 public:
     void findNextPrimaryEdges(
@@ -204,6 +220,55 @@ public:
         uint64_t maxCoverage;
     };
     CreateMarkerGraphEdgeTableData createMarkerGraphEdgeTableData;
+
+
+
+    // Data and functions used by findPrimaryPaths.
+    class PrimaryPath {
+    public:
+        MarkerGraphEdgeId seedEdgeId = invalid<MarkerGraphEdgeId>;
+
+        // The primary edges, in path order, including the seed.
+        vector<MarkerGraphEdgeId> primaryEdges;
+
+        // The MarkerGraphEdgePairInfos between consecutive primary edges.
+        vector<MarkerGraphEdgePairInfo> infos;
+
+        // The position of the seed in primaryEdges.
+        uint64_t seedPosition = 0;
+
+        // Set by findPrimaryPathsThreadFunction.
+        bool isSeed = false;
+        bool wasComputed = false;
+    };
+
+    // The paths that were kept, in order of increasing seed id.
+    vector<PrimaryPath> primaryPaths;
+
+    // For each marker graph edge, the seed of the path that owns it.
+    // The high bit is set if the owner is a path that was kept.
+    // Otherwise the owner is a tentative claim made by the threads
+    // during the current round, and lower seed ids win.
+    MemoryMapped::Vector<uint64_t> primaryEdgeOwner;
+    static const uint64_t keptOwnerFlag = 1ULL << 63;
+    bool claimPrimaryEdge(MarkerGraphEdgeId, MarkerGraphEdgeId seedEdgeId);
+
+    bool isPrimaryPathSeed(MarkerGraphEdgeId) const;
+    void computePrimaryPath(MarkerGraphEdgeId seedEdgeId, PrimaryPath&) const;
+    void keepPrimaryPath(PrimaryPath&, uint64_t minPrimaryEdgeCount);
+    void writePrimaryPaths() const;
+
+    void findPrimaryPathsThreadFunction(uint64_t threadId);
+    class FindPrimaryPathsData {
+    public:
+        uint64_t minCoverage;
+        uint64_t maxCoverage;
+
+        // The seeds of the current round, indexed by seedEdgeId - roundBegin.
+        uint64_t roundBegin;
+        vector<PrimaryPath> roundPaths;
+    };
+    FindPrimaryPathsData findPrimaryPathsData;
 };
 
 #endif
@@ -22,6 +22,9 @@ using namespace mode3b;
 #include "fstream.hpp"
 #include <queue>
 
+#include "MultithreadedObject.tpp"
+template class MultithreadedObject<GlobalPathGraph1>;
+
 
 
 void GlobalPathGraph1::assemble(
@@ -172,7 +175,7 @@ void GlobalPathGraph1::assemble1(
     GlobalPathGraph1 graph(assembler);
     graph.createVertices(minPrimaryCoverage, maxPrimaryCoverage);
     graph.computeOrientedReadJourneys();
-    graph.createEdges0(1, minEdgeCoverage, minCorrectedJaccard);
+    graph.createEdges0(1, minEdgeCoverage, minCorrectedJaccard, threadCount0);
 
     graph.createComponents(minCorrectedJaccard, minComponentSize);
 
@@ -252,7 +255,13 @@ void GlobalPathGraph1::assemble1(
 
 
 GlobalPathGraph1::GlobalPathGraph1(const Assembler& assembler) :
-    assembler(assembler)
+    MultithreadedObject<GlobalPathGraph1>(*this),
+    assembler(assembler),
+    lazyEdges(
+        assembler.markerGraph,
+        assembler.markers,
+        assembler.getReads(),
+        assembler.assemblerInfo->k)
 {
 #if 0
     // The code below was moved to GlobalPathGraph1::assemble.
@@ -519,10 +528,9 @@ bool GlobalPathGraph1::isBranchEdge(
     const MarkerGraphVertexId vertexId1 = edge.target;
 
     // Check outgoing edges of vertexId0.
-    const auto outgoingEdges0 = assembler.markerGraph.edgesBySource[vertexId0];
     uint64_t count0 = 0;
-    for(const MarkerGraphEdgeId edgeId0: outgoingEdges0) {
-        if(assembler.markerGraph.edgeCoverage(edgeId0) >= minEdgeCoverage) {
+    for(const MarkerGraphLazyEdges::Edge& edge0: *lazyEdges.getOutgoingEdges(vertexId0)) {
+        if(edge0.coverage() >= minEdgeCoverage) {
             ++count0;
         }
     }
@@ -531,10 +539,9 @@ bool GlobalPathGraph1::isBranchEdge(
     }
 
     // Check incoming edges of vertexId1.
-    const auto incomingEdges1 = assembler.markerGraph.edgesByTarget[vertexId1];
     uint64_t count1 = 0;
-    for(const MarkerGraphEdgeId edgeId1: incomingEdges1) {
-        if(assembler.markerGraph.edgeCoverage(edgeId1) >= minEdgeCoverage) {
+    for(const MarkerGraphLazyEdges::Edge& edge1: *lazyEdges.getIncomingEdges(vertexId1)) {
+        if(edge1.coverage() >= minEdgeCoverage) {
             ++count1;
         }
     }
@@ -655,57 +662,110 @@ void GlobalPathGraph1::computeOrientedReadJourneys()
 void GlobalPathGraph1::createEdges0(
     uint64_t maxDistanceInJourney,
     uint64_t minEdgeCoverage,
-    double minCorrectedJaccard)
+    double minCorrectedJaccard,
+    uint64_t threadCount)
 {
-    // Candidate edges are pairs of vertices that appear near each other
-    // in oriented read journeys.
-    vector< pair<uint64_t, uint64_t> > candidateEdges;
-    for(uint64_t i=0; i<orientedReadJourneys.size(); i++) {
-        const auto& journey = orientedReadJourneys[i];
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Store the parameters so all threads can see them.
+    createEdges0Data.maxDistanceInJourney = maxDistanceInJourney;
+    createEdges0Data.minEdgeCoverage = minEdgeCoverage;
+    createEdges0Data.minCorrectedJaccard = minCorrectedJaccard;
+
+    // Each thread processes batches of vertices and stores
+    // the edges it finds in its own vector.
+    auto& threadEdges = createEdges0Data.threadEdges;
+    threadEdges.clear();
+    threadEdges.resize(threadCount);
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(verticesVector.size(), batchSize);
+    runThreads(&GlobalPathGraph1::createEdges0ThreadFunction, threadCount);
+
+    // Gather the edges found by all threads.
+    edges.clear();
+    for(vector<GlobalPathGraph1Edge>& v: threadEdges) {
+        edges.insert(edges.end(), v.begin(), v.end());
+        v.clear();
+        v.shrink_to_fit();
+    }
+    threadEdges.clear();
 
-        for(uint64_t position0=0; position0 < journey.size(); position0++) {
-            for(uint64_t distance = 1; distance <= maxDistanceInJourney; distance++) {
-                const uint64_t position1 = position0 + distance;
-                if(position1 >= journey.size()) {
-                    break;
+    // Sort them by vertexId0, then vertexId1,
+    // so the result does not depend on the number of threads.
+    sort(edges.begin(), edges.end(),
+        [](const GlobalPathGraph1Edge& x, const GlobalPathGraph1Edge& y)
+        {
+            return make_pair(x.vertexId0, x.vertexId1) < make_pair(y.vertexId0, y.vertexId1);
+        });
+}
+
+
+
+// Candidate edges are pairs of vertices that appear near each other
+// in oriented read journeys. All the candidate edges starting at
+// a given vertex are found by following the journeys that visit it,
+// so each vertex can be processed independently.
+void GlobalPathGraph1::createEdges0ThreadFunction(uint64_t threadId)
+{
+    const uint64_t maxDistanceInJourney = createEdges0Data.maxDistanceInJourney;
+    const uint64_t minEdgeCoverage = createEdges0Data.minEdgeCoverage;
+    const double minCorrectedJaccard = createEdges0Data.minCorrectedJaccard;
+    vector<GlobalPathGraph1Edge>& threadEdges = createEdges0Data.threadEdges[threadId];
+
+    // Vectors reused for all vertices processed by this thread.
+    vector<uint64_t> candidateVertexIds1;
+    vector<uint64_t> coverage;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over vertices assigned to this batch.
+        for(uint64_t vertexId0=begin; vertexId0!=end; vertexId0++) {
+            const GlobalPathGraph1Vertex& vertex0 = verticesVector[vertexId0];
+
+            // Find the candidate edges starting at this vertex.
+            candidateVertexIds1.clear();
+            for(const auto& journeyInfoItem: vertex0.journeyInfoItems) {
+                const auto& journey = orientedReadJourneys[journeyInfoItem.orientedReadId.getValue()];
+                const uint64_t position0 = journeyInfoItem.positionInJourney;
+                for(uint64_t distance = 1; distance <= maxDistanceInJourney; distance++) {
+                    const uint64_t position1 = position0 + distance;
+                    if(position1 >= journey.size()) {
+                        break;
+                    }
+                    candidateVertexIds1.push_back(journey[position1].second);
                 }
-                candidateEdges.push_back({journey[position0].second, journey[position1].second});
             }
-        }
-    }
-    // cout << timestamp << "Found " << candidateEdges.size() << " candidate edges, including duplicates." << endl;
 
-    // Deduplicate the candidate edges and count the number of times
-    // each of them was found. Keep only the ones that occurred at least
-    // minEdgeCoverage times.
-    vector<uint64_t> coverage;
-    deduplicateAndCountWithThreshold(candidateEdges, coverage, minEdgeCoverage);
-    // cout << timestamp << "After deduplication, there are " << candidateEdges.size() << " candidate edges." << endl;
-    SHASTA_ASSERT(candidateEdges.size() == coverage.size());
-    candidateEdges.shrink_to_fit();
-    coverage.shrink_to_fit();
-
-    // For each candidate edge, compute correctedJaccard, and if high enough
-    // generate an edge.
-    edges.clear();
-    for(uint64_t i=0; i<candidateEdges.size(); i++) {
-        const uint64_t c = coverage[i];
-        SHASTA_ASSERT(c >= minEdgeCoverage);
-        const auto& p = candidateEdges[i];
-        const uint64_t vertexId0 = p.first;
-        const uint64_t vertexId1 = p.second;
-        GlobalPathGraph1Edge edge;
-        const MarkerGraphEdgeId edgeId0 = verticesVector[vertexId0].edgeId;
-        const MarkerGraphEdgeId edgeId1 = verticesVector[vertexId1].edgeId;
-        SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(edgeId0, edgeId1, edge.info));
-        if(edge.info.correctedJaccard() >= minCorrectedJaccard) {
-            edge.vertexId0 = vertexId0;
-            edge.vertexId1 = vertexId1;
-            edge.coverage = c;
-            edges.push_back(edge);
+            // Deduplicate the candidate edges and count the number of times
+            // each of them was found. Keep only the ones that occurred at least
+            // minEdgeCoverage times.
+            deduplicateAndCountWithThreshold(candidateVertexIds1, coverage, minEdgeCoverage);
+            SHASTA_ASSERT(candidateVertexIds1.size() == coverage.size());
+
+            // For each candidate edge, compute correctedJaccard, and if high enough
+            // generate an edge.
+            for(uint64_t i=0; i<candidateVertexIds1.size(); i++) {
+                const uint64_t c = coverage[i];
+                SHASTA_ASSERT(c >= minEdgeCoverage);
+                const uint64_t vertexId1 = candidateVertexIds1[i];
+                GlobalPathGraph1Edge edge;
+                const MarkerGraphEdgeId edgeId0 = vertex0.edgeId;
+                const MarkerGraphEdgeId edgeId1 = verticesVector[vertexId1].edgeId;
+                SHASTA_ASSERT(assembler.analyzeMarkerGraphEdgePair(edgeId0, edgeId1, edge.info));
+                if(edge.info.correctedJaccard() >= minCorrectedJaccard) {
+                    edge.vertexId0 = vertexId0;
+                    edge.vertexId1 = vertexId1;
+                    edge.coverage = c;
+                    threadEdges.push_back(edge);
+                }
+            }
         }
     }
-
 }
 
 
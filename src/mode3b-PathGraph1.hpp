@@ -19,6 +19,7 @@ A directed edge v0->v1 is generated if:
 // Shasta.
 #include "Base.hpp"
 #include "MarkerGraphEdgePairInfo.hpp"
+#include "MarkerGraphLazyEdges.hpp"
 #include "MultithreadedObject.hpp"
 #include "ReadId.hpp"
 #include "shastaTypes.hpp"
@@ -231,7 +232,8 @@ public:
 
 
 
-class shasta::mode3b::GlobalPathGraph1 {
+class shasta::mode3b::GlobalPathGraph1 :
+    public MultithreadedObject<GlobalPathGraph1> {
 public:
     static void assemble(
         const Assembler&,
@@ -257,10 +259,15 @@ private:
     // - Its source vertex has more than one outgoing edge with coverage at least minEdgeCoverage.
     // OR
     // - Its target vertex has more than one incoming edge with coverage at least minEdgeCoverage.
+    // The edges of the two vertices are obtained from lazyEdges,
+    // so this does not use edgesBySource and edgesByTarget.
     bool isBranchEdge(
         MarkerGraphEdgeId,
         uint64_t minEdgeCoverage) const;
 
+    // Edges near the primary edges, computed on demand.
+    MarkerGraphLazyEdges lazyEdges;
+
     // Each vertex corresponds to a primary marker graph edge.
     // Store them here.
     // The index in this table is the vertexId.
@@ -285,10 +292,25 @@ private:
     void computeOrientedReadJourneys();
 
     vector<GlobalPathGraph1Edge> edges;
+
+    // Create edges by following the oriented read journeys.
+    // A threadCount of 0 means use all available hardware threads.
     void createEdges0(
         uint64_t maxDistanceInJourney,
         uint64_t minEdgeCoverage,
-        double minCorrectedJaccard);
+        double minCorrectedJaccard,
+        uint64_t threadCount = 0);
+    void createEdges0ThreadFunction(uint64_t threadId);
+    class CreateEdges0Data {
+    public:
+        uint64_t maxDistanceInJourney;
+        uint64_t minEdgeCoverage;
+        double minCorrectedJaccard;
+
+        // The edges found by each thread.
+        vector< vector<GlobalPathGraph1Edge> > threadEdges;
+    };
+    CreateEdges0Data createEdges0Data;
     void createEdges1(
         uint64_t minEdgeCoverage,
         double minCorrectedJaccard);
@@ -0,0 +1,218 @@
+// Shasta.
+#include "objectStorage.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include "stdexcept.hpp"
+#include <thread>
+#include "vector.hpp"
+
+// Linux.
+#include <sys/wait.h>
+
+
+
+namespace shasta {
+    namespace {
+
+        // Quote a string for use as a single argument in a shell command.
+        string shellQuote(const string& s)
+        {
+            string quoted = "'";
+            for(const char c: s) {
+                if(c == '\'') {
+                    quoted += "'\\''";
+                } else {
+                    quoted += c;
+                }
+            }
+            quoted += "'";
+            return quoted;
+        }
+
+        // The curl command with the options common to all requests.
+        // Transient errors are retried by curl.
+        string curlCommand(const string& httpUrl)
+        {
+            return "curl --silent --show-error --fail --location --retry 3 " + shellQuote(httpUrl);
+        }
+
+        bool startsWith(const string& s, const string& prefix)
+        {
+            return s.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        // Download bytes [begin, end) into p.
+        bool readObjectPiece(const string& httpUrl, uint64_t begin, uint64_t end, char* p)
+        {
+            const string command = curlCommand(httpUrl) +
+                " --range " + to_string(begin) + "-" + to_string(end - 1);
+            FILE* pipe = ::popen(command.c_str(), "r");
+            if(not pipe) {
+                return false;
+            }
+
+            // Read one more byte than requested, to detect a server
+            // that ignored the range and is returning the entire object.
+            const uint64_t size = end - begin;
+            const uint64_t bytesRead = std::fread(p, 1, size, pipe);
+            char extra;
+            const bool tooLong = (bytesRead == size) and (std::fread(&extra, 1, 1, pipe) == 1);
+            const int status = ::pclose(pipe);
+
+            return
+                (bytesRead == size) and
+                (not tooLong) and
+                WIFEXITED(status) and
+                (WEXITSTATUS(status) == 0);
+        }
+    }
+}
+
+
+
+bool shasta::isObjectStorageUrl(const string& name)
+{
+    return
+        startsWith(name, "http://") or
+        startsWith(name, "https://") or
+        startsWith(name, "s3://") or
+        startsWith(name, "gs://");
+}
+
+
+
+string shasta::getObjectHttpUrl(const string& url)
+{
+    if(startsWith(url, "s3://") or startsWith(url, "gs://")) {
+        const uint64_t bucketBegin = 5;
+        const uint64_t slash = url.find('/', bucketBegin);
+        if(slash == string::npos or slash == bucketBegin or slash + 1 == url.size()) {
+            throw runtime_error("Invalid object storage URL " + url +
+                ". Expected " + url.substr(0, bucketBegin) + "bucket/key.");
+        }
+        const string bucket = url.substr(bucketBegin, slash - bucketBegin);
+        const string key = url.substr(slash + 1);
+
+        if(startsWith(url, "s3://")) {
+            return "https://" + bucket + ".s3.amazonaws.com/" + key;
+        } else {
+            return "https://storage.googleapis.com/" + bucket + "/" + key;
+        }
+    }
+
+    return url;
+}
+
+
+
+string shasta::getObjectPath(const string& url)
+{
+    return url.substr(0, url.find_first_of("?#"));
+}
+
+
+
+// Request the first byte of the object and use the Content-Range
+// header of the response, which also checks that the server
+// supports range requests. A HEAD request is not used because
+// presigned URLs are only valid for the method they were signed for.
+uint64_t shasta::getObjectSize(const string& httpUrl)
+{
+    const string command = curlCommand(httpUrl) +
+        " --range 0-0 --dump-header - --output /dev/null";
+    FILE* pipe = ::popen(command.c_str(), "r");
+    if(not pipe) {
+        throw runtime_error("Error running curl to access " + httpUrl);
+    }
+    string headers;
+    char buffer[4096];
+    uint64_t n;
+    while((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        headers.append(buffer, n);
+    }
+    const int status = ::pclose(pipe);
+    if(not WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+        throw runtime_error("Error accessing " + httpUrl +
+            ". Make sure curl is installed and the URL is accessible.");
+    }
+
+    // With redirects, there is a set of headers for each response,
+    // so use the last Content-Range header.
+    bool found = false;
+    uint64_t size = 0;
+    std::istringstream s(headers);
+    string line;
+    while(std::getline(s, line)) {
+        string lowerCaseLine = line;
+        for(char& c: lowerCaseLine) {
+            c = char(std::tolower(c));
+        }
+        if(not startsWith(lowerCaseLine, "content-range:")) {
+            continue;
+        }
+        const uint64_t slash = line.find('/');
+        if(slash == string::npos) {
+            continue;
+        }
+        try {
+            size = std::stoull(line.substr(slash + 1));
+            found = true;
+        } catch(...) {
+            // This happens for "bytes */*" (unknown size).
+        }
+    }
+    if(not found) {
+        throw runtime_error("The server for " + httpUrl +
+            " did not return the object size. Range requests are required.");
+    }
+    return size;
+}
+
+
+
+bool shasta::readObjectRange(
+    const string& httpUrl,
+    uint64_t begin,
+    uint64_t end,
+    char* p,
+    uint64_t pieceSize,
+    uint64_t connectionCount)
+{
+    if(end <= begin) {
+        return true;
+    }
+    const uint64_t pieceCount = (end - begin + pieceSize - 1) / pieceSize;
+    connectionCount = max(uint64_t(1), min(connectionCount, pieceCount));
+
+    // Each thread runs one curl process at a time
+    // and gets the pieces to download from a shared counter.
+    std::atomic<uint64_t> nextPiece = 0;
+    std::atomic<bool> success = true;
+    vector<std::thread> threads;
+    for(uint64_t i=0; i<connectionCount; i++) {
+        threads.push_back(std::thread([&]()
+        {
+            while(success) {
+                const uint64_t piece = nextPiece++;
+                if(piece >= pieceCount) {
+                    break;
+                }
+                const uint64_t pieceBegin = begin + piece * pieceSize;
+                const uint64_t pieceEnd = min(pieceBegin + pieceSize, end);
+                if(not readObjectPiece(httpUrl, pieceBegin, pieceEnd, p + (pieceBegin - begin))) {
+                    success = false;
+                }
+            }
+        }));
+    }
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+    return success;
+}
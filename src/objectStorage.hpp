@@ -0,0 +1,46 @@
+#ifndef SHASTA_OBJECT_STORAGE_HPP
+#define SHASTA_OBJECT_STORAGE_HPP
+
+// Reading input files directly from object storage or web servers.
+// Supported names are http:// and https:// URLs, plus s3://bucket/key
+// and gs://bucket/key, which are converted to the public https endpoints
+// of Amazon S3 and Google Cloud Storage.
+// Private objects can be accessed using presigned (signed) https URLs.
+
+// The transfers are done by curl processes using HTTP range requests,
+// so portions of an object can be downloaded over multiple
+// concurrent connections.
+
+#include "cstdint.hpp"
+#include "string.hpp"
+
+namespace shasta {
+
+    // Return true if the name is a URL supported by the functions below.
+    bool isObjectStorageUrl(const string&);
+
+    // Convert s3:// and gs:// URLs to https. Other URLs are returned unchanged.
+    string getObjectHttpUrl(const string&);
+
+    // Return the path portion of a URL, without the query string,
+    // so it can be used to deduce the file format from its extension.
+    string getObjectPath(const string&);
+
+    // Return the size in bytes of the object at an http or https URL.
+    // Throws if the server does not support range requests.
+    uint64_t getObjectSize(const string& httpUrl);
+
+    // Read bytes [begin, end) of the object at an http or https URL into p.
+    // The range is divided in pieces of at most pieceSize bytes,
+    // and up to connectionCount pieces are downloaded concurrently.
+    // Returns false if any piece could not be downloaded.
+    bool readObjectRange(
+        const string& httpUrl,
+        uint64_t begin,
+        uint64_t end,
+        char* p,
+        uint64_t pieceSize,
+        uint64_t connectionCount);
+}
+
+#endif
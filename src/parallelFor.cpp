@@ -0,0 +1,99 @@
+// Shasta.
+#include "parallelFor.hpp"
+#include "MultithreadedObject.hpp"
+#include "MultithreadedObject.tpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <thread>
+
+namespace shasta {
+    class ParallelFor;
+}
+
+
+
+// The MultithreadedObject that runs the loop body of parallelFor.
+class shasta::ParallelFor : public MultithreadedObject<ParallelFor> {
+public:
+    ParallelFor(const std::function<void(size_t threadId, uint64_t begin, uint64_t end)>& f) :
+        MultithreadedObject(*this), f(f) {}
+
+    void run(uint64_t n, uint64_t batchSize, size_t threadCount)
+    {
+        setupLoadBalancing(n, batchSize);
+        runThreads(&ParallelFor::threadFunction, threadCount);
+    }
+
+private:
+    const std::function<void(size_t threadId, uint64_t begin, uint64_t end)>& f;
+
+    void threadFunction(size_t threadId)
+    {
+        uint64_t begin, end;
+        while(getNextBatch(begin, end)) {
+            f(threadId, begin, end);
+        }
+    }
+};
+
+template class MultithreadedObject<ParallelFor>;
+
+
+
+// The number of threads to use. Zero if there is nothing to do.
+size_t shasta::parallelForDetail::getThreadCount(
+    uint64_t n,
+    uint64_t batchSize,
+    size_t threadCount)
+{
+    SHASTA_ASSERT(batchSize > 0);
+    if(threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    const uint64_t batchCount = (n + batchSize - 1) / batchSize;
+    return size_t(min(uint64_t(threadCount), batchCount));
+}
+
+
+
+size_t shasta::parallelForWithThreadId(
+    uint64_t n,
+    uint64_t batchSize,
+    size_t threadCount,
+    const std::function<void(size_t threadId, uint64_t begin, uint64_t end)>& f)
+{
+    threadCount = parallelForDetail::getThreadCount(n, batchSize, threadCount);
+    if(threadCount == 0) {
+        return 0;
+    }
+
+    // With a single thread, process the batches in the calling thread.
+    if(threadCount == 1) {
+        for(uint64_t begin=0; begin<n; begin+=batchSize) {
+            f(0, begin, min(n, begin + batchSize));
+        }
+        return 1;
+    }
+
+    ParallelFor parallelFor(f);
+    parallelFor.run(n, batchSize, threadCount);
+    return threadCount;
+}
+
+
+
+void shasta::parallelFor(
+    uint64_t n,
+    uint64_t batchSize,
+    size_t threadCount,
+    const std::function<void(uint64_t begin, uint64_t end)>& f)
+{
+    parallelForWithThreadId(n, batchSize, threadCount,
+        [&f](size_t, uint64_t begin, uint64_t end)
+        {
+            f(begin, end);
+        });
+}
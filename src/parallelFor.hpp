@@ -0,0 +1,174 @@
+#ifndef SHASTA_PARALLEL_FOR_HPP
+#define SHASTA_PARALLEL_FOR_HPP
+
+// Lambda based parallel loops.
+// They use MultithreadedObject (and therefore its persistent thread pool
+// and dynamic load balancing), but don't require writing a thread function
+// and a data class to pass state to it.
+
+// Usage pattern:
+//     parallelFor(n, batchSize, threadCount,
+//         [&](uint64_t begin, uint64_t end)
+//         {
+//             for(uint64_t i=begin; i!=end; i++) {
+//                 ...
+//             }
+//         });
+//
+//     const uint64_t sum = parallelReduce(n, batchSize, threadCount, uint64_t(0),
+//         [&](uint64_t& s, uint64_t begin, uint64_t end)
+//         {
+//             for(uint64_t i=begin; i!=end; i++) {
+//                 s += x[i];
+//             }
+//         },
+//         [](uint64_t& s, const uint64_t& t)
+//         {
+//             s += t;
+//         });
+//
+//     const vector<uint64_t> histogram = parallelHistogram(n, batchSize, threadCount,
+//         [&](uint64_t i)
+//         {
+//             return x[i];   // Or invalid<uint64_t> to not count item i.
+//         });
+
+// [0, n) is divided in batches of batchSize, which are dispensed
+// to the threads as with MultithreadedObject::setupLoadBalancing.
+// If threadCount is 0, all available hardware threads are used.
+// An exception in a thread terminates the process,
+// as for all MultithreadedObject thread functions.
+
+// Shasta.
+#include "invalid.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "cstddef.hpp"
+#include <functional>
+#include "vector.hpp"
+
+namespace shasta {
+
+    // Call f(begin, end) once for each batch.
+    void parallelFor(
+        uint64_t n,
+        uint64_t batchSize,
+        size_t threadCount,
+        const std::function<void(uint64_t begin, uint64_t end)>& f);
+
+    // Same as parallelFor, but also pass to f the id,
+    // in [0, threadCount), of the thread processing the batch.
+    // Returns the number of threads actually used, which can be less
+    // than threadCount if there are not enough batches.
+    size_t parallelForWithThreadId(
+        uint64_t n,
+        uint64_t batchSize,
+        size_t threadCount,
+        const std::function<void(size_t threadId, uint64_t begin, uint64_t end)>& f);
+
+    // Parallel reduction using one reducer object for each thread.
+    // Each reducer starts as a copy of initialValue,
+    // and f(reducer, begin, end) accumulates a batch into it.
+    // At the end, the reducers are combined, in order of thread id,
+    // using combine(Reducer&, const Reducer&), and the result is returned.
+    // Because batches are assigned to threads dynamically,
+    // combine should be associative and commutative
+    // for the result to be deterministic.
+    template<class Reducer, class F, class Combine> Reducer parallelReduce(
+        uint64_t n,
+        uint64_t batchSize,
+        size_t threadCount,
+        const Reducer& initialValue,
+        const F& f,
+        const Combine& combine);
+
+    // Parallel histogram of n items, using one histogram for each thread.
+    // f(i) returns the bin for item i, or invalid<uint64_t>
+    // if item i should not be counted.
+    // Each thread histogram grows as needed,
+    // and they are all added together at the end.
+    // The result does not depend on the number of threads.
+    template<class F> vector<uint64_t> parallelHistogram(
+        uint64_t n,
+        uint64_t batchSize,
+        size_t threadCount,
+        const F& f);
+
+    namespace parallelForDetail {
+        size_t getThreadCount(uint64_t n, uint64_t batchSize, size_t threadCount);
+
+        // Each reducer goes on its own cache lines
+        // to avoid false sharing between threads.
+        template<class Reducer> class alignas(64) PaddedReducer {
+        public:
+            Reducer reducer;
+            PaddedReducer(const Reducer& reducer) : reducer(reducer) {}
+        };
+    }
+}
+
+
+
+template<class Reducer, class F, class Combine> Reducer shasta::parallelReduce(
+    uint64_t n,
+    uint64_t batchSize,
+    size_t threadCount,
+    const Reducer& initialValue,
+    const F& f,
+    const Combine& combine)
+{
+    threadCount = parallelForDetail::getThreadCount(n, batchSize, threadCount);
+    if(threadCount == 0) {
+        return initialValue;
+    }
+
+    vector< parallelForDetail::PaddedReducer<Reducer> > reducers(
+        threadCount, parallelForDetail::PaddedReducer<Reducer>(initialValue));
+    parallelForWithThreadId(n, batchSize, threadCount,
+        [&](size_t threadId, uint64_t begin, uint64_t end)
+        {
+            f(reducers[threadId].reducer, begin, end);
+        });
+
+    Reducer result = std::move(reducers.front().reducer);
+    for(size_t threadId=1; threadId<threadCount; threadId++) {
+        combine(result, reducers[threadId].reducer);
+    }
+    return result;
+}
+
+
+
+template<class F> shasta::vector<uint64_t> shasta::parallelHistogram(
+    uint64_t n,
+    uint64_t batchSize,
+    size_t threadCount,
+    const F& f)
+{
+    return parallelReduce(n, batchSize, threadCount, vector<uint64_t>(),
+        [&](vector<uint64_t>& histogram, uint64_t begin, uint64_t end)
+        {
+            for(uint64_t i=begin; i!=end; i++) {
+                const uint64_t bin = f(i);
+                if(bin == invalid<uint64_t>) {
+                    continue;
+                }
+                if(bin >= histogram.size()) {
+                    histogram.resize(bin + 1, 0);
+                }
+                ++histogram[bin];
+            }
+        },
+        [](vector<uint64_t>& histogram, const vector<uint64_t>& threadHistogram)
+        {
+            if(threadHistogram.size() > histogram.size()) {
+                histogram.resize(threadHistogram.size(), 0);
+            }
+            for(uint64_t i=0; i<threadHistogram.size(); i++) {
+                histogram[i] += threadHistogram[i];
+            }
+        });
+}
+
+#endif
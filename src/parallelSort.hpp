@@ -0,0 +1,85 @@
+#ifndef SHASTA_PARALLEL_SORT_HPP
+#define SHASTA_PARALLEL_SORT_HPP
+
+// Parallel sort of a random access range.
+// The range is divided into one chunk per thread,
+// each chunk is sorted with std::sort,
+// and then adjacent chunks are merged, in parallel, with std::inplace_merge
+// until a single sorted range remains.
+// The sort is not stable. If threadCount is 0, all
+// available hardware threads are used.
+
+// Standard library.
+#include "algorithm.hpp"
+#include "cstdint.hpp"
+#include <functional>
+#include <iterator>
+#include <thread>
+#include "vector.hpp"
+
+namespace shasta {
+
+    template<class Iterator, class Compare> void parallelSort(
+        Iterator begin,
+        Iterator end,
+        Compare compare,
+        size_t threadCount)
+    {
+        if(threadCount == 0) {
+            threadCount = std::max(1U, std::thread::hardware_concurrency());
+        }
+
+        // For small ranges, or a single thread, just use std::sort.
+        const uint64_t n = uint64_t(end - begin);
+        const uint64_t minChunkSize = 10000;
+        threadCount = std::min(uint64_t(threadCount), n / minChunkSize);
+        if(threadCount < 2) {
+            std::sort(begin, end, compare);
+            return;
+        }
+
+        // Run f(i) for i in [0, count) using one thread for each i.
+        auto runInParallel = [](uint64_t count, const std::function<void(uint64_t)>& f)
+        {
+            vector<std::thread> threads;
+            for(uint64_t i=0; i<count; i++) {
+                threads.push_back(std::thread(f, i));
+            }
+            for(std::thread& thread: threads) {
+                thread.join();
+            }
+        };
+
+        // The boundaries of the chunks.
+        vector<Iterator> boundaries;
+        for(uint64_t i=0; i<=threadCount; i++) {
+            boundaries.push_back(begin + (i * n) / threadCount);
+        }
+
+        // Sort each chunk.
+        runInParallel(threadCount, [&](uint64_t i)
+        {
+            std::sort(boundaries[i], boundaries[i + 1], compare);
+        });
+
+        // Merge adjacent pairs of chunks until there is only one left.
+        while(boundaries.size() > 2) {
+            const uint64_t chunkCount = boundaries.size() - 1;
+            const uint64_t mergeCount = chunkCount / 2;
+            runInParallel(mergeCount, [&](uint64_t i)
+            {
+                std::inplace_merge(boundaries[2 * i], boundaries[2 * i + 1], boundaries[2 * i + 2], compare);
+            });
+
+            vector<Iterator> newBoundaries;
+            for(uint64_t i=0; i<chunkCount; i+=2) {
+                newBoundaries.push_back(boundaries[i]);
+            }
+            newBoundaries.push_back(boundaries.back());
+            boundaries.swap(newBoundaries);
+        }
+    }
+
+}
+
+#endif
@@ -2,14 +2,175 @@
 // for performance analysis but mostly uninteresting to users.
 
 #include "performanceLog.hpp"
+#include "timestamp.hpp"
+
+#include "algorithm.hpp"
+#include <cmath>
+#include <iomanip>
+#include "iostream.hpp"
+#include <mutex>
 
 namespace shasta {
     ofstream performanceLog;
+    ofstream performanceTrace;
+
+    // The innermost PerformanceSpan of each thread.
+    thread_local PerformanceSpan* currentPerformanceSpan = 0;
+
+    // A copy of the name and begin time of the innermost PerformanceSpan,
+    // for getCurrentPerformanceSpan.
+    std::mutex currentPerformanceSpanMutex;
+    string currentPerformanceSpanName;
+    std::chrono::steady_clock::time_point currentPerformanceSpanBeginTime;
+}
+
+
+
+void shasta::openPerformanceLog(const string& fileName, bool append)
+{
+    performanceLog.open(fileName, append ? std::ios::app : std::ios::out);
+}
+
+
+
+void shasta::openPerformanceTrace(const string& fileName, bool append)
+{
+    performanceTrace.open(fileName, append ? std::ios::app : std::ios::out);
+}
+
+
+
+shasta::PerformanceSpan::PerformanceSpan(const string& nameArgument) :
+    parent(currentPerformanceSpan)
+{
+    if(parent) {
+        name = parent->name + "/" + nameArgument;
+        depth = parent->depth + 1;
+    } else {
+        name = nameArgument;
+        depth = 0;
+    }
+    currentPerformanceSpan = this;
+
+    beginUsage = getResourceUsage();
+    if(hardwareCountersAreOpen()) {
+        beginCounters = readHardwareCounters();
+    }
+    if(parent) {
+        parent->peakResidentBytes = max(parent->peakResidentBytes, beginUsage.peakResidentBytes);
+    }
+    peakResidentBytes = resetPeakResidentBytes() ? 0 : beginUsage.peakResidentBytes;
+    beginTime = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(currentPerformanceSpanMutex);
+        currentPerformanceSpanName = name;
+        currentPerformanceSpanBeginTime = beginTime;
+    }
+    beginTimeSinceEpoch = 1.e-6 * double(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    performanceLog << timestamp << "Begin " << name << endl;
+}
+
+
+
+shasta::PerformanceSpan::~PerformanceSpan()
+{
+    const ResourceUsage endUsage = getResourceUsage();
+
+    // The hardware counters used during the span.
+    // Counters that are not available remain invalid.
+    HardwareCounters counters;
+    counters.values.fill(HardwareCounters::invalid);
+    if(hardwareCountersAreOpen()) {
+        const HardwareCounters endCounters = readHardwareCounters();
+        for(uint64_t i=0; i<HardwareCounters::counterCount; i++) {
+            if(beginCounters.values[i] != HardwareCounters::invalid and
+                endCounters.values[i] != HardwareCounters::invalid and
+                endCounters.values[i] >= beginCounters.values[i]) {
+                counters.values[i] = endCounters.values[i] - beginCounters.values[i];
+            }
+        }
+    }
+    const uint64_t instructionCount = counters.values[HardwareCounters::instructions];
+    const uint64_t cycleCount = counters.values[HardwareCounters::cycles];
+    const double wallSeconds = 1.e-9 * double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - beginTime).count());
+    peakResidentBytes = max(peakResidentBytes, endUsage.peakResidentBytes);
+
+    const double userSeconds = endUsage.userSeconds - beginUsage.userSeconds;
+    const double systemSeconds = endUsage.systemSeconds - beginUsage.systemSeconds;
+    const double cpuUtilization = (wallSeconds > 0.) ? (userSeconds + systemSeconds) / wallSeconds : 0.;
+
+    if(performanceTrace.is_open()) {
+        performanceTrace <<
+            "{\"name\":\"" << name << "\""
+            ",\"depth\":" << depth <<
+            std::fixed <<
+            ",\"beginTime\":" << std::setprecision(6) << beginTimeSinceEpoch <<
+            ",\"wallSeconds\":" << std::setprecision(3) << wallSeconds <<
+            ",\"userSeconds\":" << userSeconds <<
+            ",\"systemSeconds\":" << systemSeconds <<
+            ",\"cpuUtilization\":" << cpuUtilization <<
+            std::defaultfloat <<
+            ",\"peakResidentBytes\":" << peakResidentBytes <<
+            ",\"residentBytes\":" << endUsage.residentBytes <<
+            ",\"majorFaults\":" << endUsage.majorFaultCount - beginUsage.majorFaultCount <<
+            ",\"minorFaults\":" << endUsage.minorFaultCount - beginUsage.minorFaultCount <<
+            ",\"bytesRead\":" << endUsage.bytesRead - beginUsage.bytesRead <<
+            ",\"bytesWritten\":" << endUsage.bytesWritten - beginUsage.bytesWritten <<
+            ",\"threads\":" << endUsage.threadCount;
+        for(uint64_t i=0; i<HardwareCounters::counterCount; i++) {
+            if(counters.values[i] != HardwareCounters::invalid) {
+                performanceTrace << ",\"" << HardwareCounters::names[i] << "\":" << counters.values[i];
+            }
+        }
+        performanceTrace << "}" << endl;
+    }
+
+    performanceLog << timestamp << "End " << name << ": " <<
+        wallSeconds << " s elapsed, " <<
+        userSeconds + systemSeconds << " s CPU, peak resident memory " <<
+        std::round(10. * double(peakResidentBytes) / (1024. * 1024. * 1024.)) / 10. << " GiB.";
+
+    // Instructions per cycle, and the other counters per thousand instructions.
+    if(instructionCount != HardwareCounters::invalid and instructionCount > 0) {
+        if(cycleCount != HardwareCounters::invalid and cycleCount > 0) {
+            performanceLog << " IPC " << double(instructionCount) / double(cycleCount) << ".";
+        }
+        for(uint64_t i=HardwareCounters::llcMisses; i<HardwareCounters::counterCount; i++) {
+            if(counters.values[i] != HardwareCounters::invalid) {
+                performanceLog << " " << HardwareCounters::names[i] << " " <<
+                    1000. * double(counters.values[i]) / double(instructionCount) << "/kI.";
+            }
+        }
+    }
+    performanceLog << endl;
+
+    if(parent) {
+        parent->peakResidentBytes = max(parent->peakResidentBytes, peakResidentBytes);
+    }
+    currentPerformanceSpan = parent;
+    {
+        std::lock_guard<std::mutex> lock(currentPerformanceSpanMutex);
+        currentPerformanceSpanName = parent ? parent->name : string();
+        currentPerformanceSpanBeginTime = parent ? parent->beginTime : std::chrono::steady_clock::time_point();
+    }
+}
+
+
+
+std::string shasta::PerformanceSpan::currentName()
+{
+    return currentPerformanceSpan ? currentPerformanceSpan->name : std::string();
 }
 
 
 
-void shasta::openPerformanceLog(const string& fileName)
+void shasta::getCurrentPerformanceSpan(string& name, double& seconds)
 {
-    performanceLog.open(fileName);
+    std::lock_guard<std::mutex> lock(currentPerformanceSpanMutex);
+    name = currentPerformanceSpanName;
+    seconds = name.empty() ? 0. : 1.e-9 * double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - currentPerformanceSpanBeginTime).count());
 }
@@ -1,16 +1,72 @@
 #ifndef SHASTA_PERFORMANCE_LOG_HPP
 #define SHASTA_PERFORMANCE_LOG_HPP
 
+#include "platformDependent.hpp"
+
+#include <chrono>
 #include "fstream.hpp"
 #include "string.hpp"
 
 // The performance log is used to write messages that are useful
 // for performance analysis but mostly uninteresting to users.
 
+// The performance trace is a machine readable companion of the performance log.
+// It contains one line in JSON format for each PerformanceSpan,
+// with the resources used during that span.
+
 namespace shasta {
     extern ofstream performanceLog;
-    void openPerformanceLog(const string& fileName);
+    void openPerformanceLog(const string& fileName, bool append = false);
+
+    extern ofstream performanceTrace;
+    void openPerformanceTrace(const string& fileName, bool append = false);
+
+    class PerformanceSpan;
+
+    // Get the name of the innermost PerformanceSpan of the main thread,
+    // and the seconds elapsed since it began.
+    // Unlike PerformanceSpan::currentName, this can be called from any thread.
+    void getCurrentPerformanceSpan(string& name, double& seconds);
 }
 
 
+
+// Scoped measurement of the resources used by a stage of the computation.
+// On destruction, it writes a line to the performance trace (if open)
+// and a one line summary to the performance log.
+// Spans can be nested. The name of a nested span includes
+// the names of the enclosing spans, separated by "/".
+// Spans must be created and destroyed in LIFO order by the same thread,
+// normally the main thread. Resource usage is for the entire process,
+// including all threads.
+// If openHardwareCounters was called, the hardware performance
+// counters are also reported.
+class shasta::PerformanceSpan {
+public:
+    PerformanceSpan(const string& name);
+    ~PerformanceSpan();
+
+    PerformanceSpan(const PerformanceSpan&) = delete;
+    PerformanceSpan& operator=(const PerformanceSpan&) = delete;
+
+    // The full name of the innermost span of the calling thread,
+    // or an empty string if there is none.
+    static string currentName();
+
+private:
+    string name;
+    uint64_t depth;
+    PerformanceSpan* parent;
+
+    std::chrono::steady_clock::time_point beginTime;
+    double beginTimeSinceEpoch;
+    ResourceUsage beginUsage;
+    HardwareCounters beginCounters;
+
+    // The peak resident memory is reset at the beginning of each span.
+    // This keeps track of the peak resident memory before that,
+    // and of the peak resident memory of nested spans that already ended.
+    uint64_t peakResidentBytes;
+};
+
 #endif
@@ -1,6 +1,15 @@
 #include "platformDependent.hpp"
 #include <stdlib.h>
+#include "algorithm.hpp"
+#include "utility.hpp"
+#include <filesystem>
 #include "fstream.hpp"
+#include <sched.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
 
 // Return the path to a usable temporary directory, including the final "/".
 std::string shasta::tmpDirectory()
@@ -56,3 +65,320 @@ uint64_t shasta::getTotalPhysicalMemory()
     return 1024 * memoryKb;
 }
 
+
+
+// Get the physical memory available for new allocations, in bytes,
+// as estimated by the kernel. Returns 0 if this information is not available.
+uint64_t shasta::getAvailablePhysicalMemory()
+{
+    ifstream meminfo("/proc/meminfo");
+    string line;
+    while(std::getline(meminfo, line)) {
+        std::istringstream s(line);
+        string name;
+        uint64_t memoryKb = 0;
+        if((s >> name >> memoryKb) and name == "MemAvailable:") {
+            return 1024 * memoryKb;
+        }
+    }
+    return 0;
+}
+
+
+
+
+// Get resource usage of the current process.
+shasta::ResourceUsage shasta::getResourceUsage()
+{
+    ResourceUsage usage;
+
+    struct rusage r;
+    if(::getrusage(RUSAGE_SELF, &r) == 0) {
+        usage.userSeconds = double(r.ru_utime.tv_sec) + 1.e-6 * double(r.ru_utime.tv_usec);
+        usage.systemSeconds = double(r.ru_stime.tv_sec) + 1.e-6 * double(r.ru_stime.tv_usec);
+        usage.majorFaultCount = uint64_t(r.ru_majflt);
+        usage.minorFaultCount = uint64_t(r.ru_minflt);
+    }
+
+    {
+        ifstream status("/proc/self/status");
+        string line;
+        while(std::getline(status, line)) {
+            std::istringstream s(line);
+            string name;
+            uint64_t value = 0;
+            if(not (s >> name >> value)) {
+                continue;
+            }
+            if(name == "VmHWM:") {
+                usage.peakResidentBytes = 1024 * value;
+            } else if(name == "VmRSS:") {
+                usage.residentBytes = 1024 * value;
+            } else if(name == "Threads:") {
+                usage.threadCount = value;
+            }
+        }
+    }
+
+    {
+        ifstream io("/proc/self/io");
+        string line;
+        while(std::getline(io, line)) {
+            std::istringstream s(line);
+            string name;
+            uint64_t value = 0;
+            if(not (s >> name >> value)) {
+                continue;
+            }
+            if(name == "read_bytes:") {
+                usage.bytesRead = value;
+            } else if(name == "write_bytes:") {
+                usage.bytesWritten = value;
+            }
+        }
+    }
+
+    return usage;
+}
+
+
+
+// Reset the peak resident memory of the current process.
+// Writing 5 to /proc/self/clear_refs resets VmHWM.
+bool shasta::resetPeakResidentBytes()
+{
+    ofstream file("/proc/self/clear_refs");
+    file << "5" << std::flush;
+    return bool(file);
+}
+
+
+
+// The hardware performance counters. Each counter is opened separately,
+// in counting mode, with inherit set, so threads created after
+// openHardwareCounters are also counted. A read on the counter
+// of the main thread then returns the total for all those threads.
+// Counter groups cannot be used with inherit.
+const shasta::array<const char*, shasta::HardwareCounters::counterCount>
+    shasta::HardwareCounters::names = {
+    "cycles", "instructions", "llcMisses", "dtlbMisses", "branchMisses"};
+namespace shasta {
+    namespace {
+        array<int, HardwareCounters::counterCount> hardwareCounterFileDescriptors = {-1, -1, -1, -1, -1};
+        bool hardwareCountersOpen = false;
+    }
+}
+
+
+
+uint64_t shasta::openHardwareCounters()
+{
+    const array< pair<uint32_t, uint64_t>, HardwareCounters::counterCount> events = {
+        make_pair(uint32_t(PERF_TYPE_HARDWARE), uint64_t(PERF_COUNT_HW_CPU_CYCLES)),
+        make_pair(uint32_t(PERF_TYPE_HARDWARE), uint64_t(PERF_COUNT_HW_INSTRUCTIONS)),
+        make_pair(uint32_t(PERF_TYPE_HARDWARE), uint64_t(PERF_COUNT_HW_CACHE_MISSES)),
+        make_pair(uint32_t(PERF_TYPE_HW_CACHE), uint64_t(
+            PERF_COUNT_HW_CACHE_DTLB |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))),
+        make_pair(uint32_t(PERF_TYPE_HARDWARE), uint64_t(PERF_COUNT_HW_BRANCH_MISSES))
+    };
+
+    uint64_t openCount = 0;
+    for(uint64_t i=0; i<HardwareCounters::counterCount; i++) {
+        if(hardwareCounterFileDescriptors[i] >= 0) {
+            ++openCount;
+            continue;
+        }
+        struct perf_event_attr attr;
+        std::fill_n(reinterpret_cast<char*>(&attr), sizeof(attr), char(0));
+        attr.size = sizeof(attr);
+        attr.type = events[i].first;
+        attr.config = events[i].second;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+
+        // Only count user space, which is allowed with the
+        // default setting of /proc/sys/kernel/perf_event_paranoid.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        const long fileDescriptor = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if(fileDescriptor >= 0) {
+            hardwareCounterFileDescriptors[i] = int(fileDescriptor);
+            ++openCount;
+        }
+    }
+    hardwareCountersOpen = (openCount > 0);
+    return openCount;
+}
+
+
+
+bool shasta::hardwareCountersAreOpen()
+{
+    return hardwareCountersOpen;
+}
+
+
+
+shasta::HardwareCounters shasta::readHardwareCounters()
+{
+    HardwareCounters counters;
+    for(uint64_t i=0; i<HardwareCounters::counterCount; i++) {
+        counters.values[i] = HardwareCounters::invalid;
+        const int fileDescriptor = hardwareCounterFileDescriptors[i];
+        if(fileDescriptor < 0) {
+            continue;
+        }
+
+        // The value, the time enabled, and the time running.
+        array<uint64_t, 3> buffer;
+        if(::read(fileDescriptor, buffer.data(), sizeof(buffer)) != ssize_t(sizeof(buffer))) {
+            continue;
+        }
+        const uint64_t value = buffer[0];
+        const uint64_t timeEnabled = buffer[1];
+        const uint64_t timeRunning = buffer[2];
+        if(timeRunning == 0) {
+            counters.values[i] = 0;
+        } else if(timeRunning == timeEnabled) {
+            counters.values[i] = value;
+        } else {
+            counters.values[i] = uint64_t(double(value) * (double(timeEnabled) / double(timeRunning)));
+        }
+    }
+    return counters;
+}
+
+
+
+// Get a one line summary of transparent huge page usage.
+std::string shasta::getTransparentHugePageStatistics()
+{
+    std::ostringstream summary;
+
+    {
+        ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+        string line;
+        if(std::getline(file, line)) {
+            summary << "Transparent huge pages: " << line << ".";
+        }
+    }
+
+    {
+        ifstream file("/proc/self/smaps_rollup");
+        string line;
+        while(std::getline(file, line)) {
+            std::istringstream s(line);
+            string name;
+            uint64_t kb = 0;
+            if((s >> name >> kb) and name == "AnonHugePages:") {
+                summary << " AnonHugePages: " << kb << " kB.";
+                break;
+            }
+        }
+    }
+
+    for(const string name: {"pages_collapsed", "full_scans"}) {
+        ifstream file("/sys/kernel/mm/transparent_hugepage/khugepaged/" + name);
+        uint64_t value = 0;
+        if(file >> value) {
+            summary << " khugepaged " << name << ": " << value << ".";
+        }
+    }
+
+    return summary.str();
+}
+
+
+
+// Get the number of NUMA nodes. Returns 1 if this information
+// is not available.
+uint64_t shasta::getNumaNodeCount()
+{
+    uint64_t numaNodeCount = 0;
+    while(std::filesystem::exists(
+        "/sys/devices/system/node/node" + to_string(numaNodeCount))) {
+        ++numaNodeCount;
+    }
+    return std::max(numaNodeCount, uint64_t(1));
+}
+
+
+
+// Get the processors of the given NUMA node.
+// Returns an empty vector if this information is not available.
+std::vector<uint64_t> shasta::getNumaNodeProcessors(uint64_t numaNodeId)
+{
+    // Get the list of processors of this NUMA node.
+    // It is a comma separated list of processor ids or processor id ranges,
+    // for example "0-15,64-79".
+    vector<uint64_t> processors;
+    ifstream file("/sys/devices/system/node/node" + to_string(numaNodeId) + "/cpulist");
+    string cpuList;
+    if(not std::getline(file, cpuList)) {
+        return processors;
+    }
+
+    std::istringstream s(cpuList);
+    string token;
+    while(std::getline(s, token, ',')) {
+        if(token.empty()) {
+            continue;
+        }
+        const size_t dashPosition = token.find('-');
+        const uint64_t first = std::stoull(token.substr(0, dashPosition));
+        const uint64_t last = (dashPosition == string::npos) ?
+            first : std::stoull(token.substr(dashPosition + 1));
+        for(uint64_t cpu=first; cpu<=last and cpu<CPU_SETSIZE; cpu++) {
+            processors.push_back(cpu);
+        }
+    }
+    return processors;
+}
+
+
+
+// Restrict the calling thread to run on the processors of the given NUMA node.
+// Returns false if this could not be done.
+bool shasta::bindThreadToNumaNode(uint64_t numaNodeId)
+{
+    const vector<uint64_t> processors = getNumaNodeProcessors(numaNodeId);
+    if(processors.empty()) {
+        return false;
+    }
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for(const uint64_t cpu: processors) {
+        CPU_SET(cpu, &cpuSet);
+    }
+
+    // A pid of 0 refers to the calling thread.
+    return ::sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+}
+
+
+
+std::string shasta::getInstructionSetSummary()
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    std::string s;
+    if(__builtin_cpu_supports("avx512f")) {
+        s += " AVX-512";
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        s += " AVX2";
+    }
+    if(__builtin_cpu_supports("sse4.2")) {
+        s += " SSE4.2";
+    }
+    return s.empty() ? std::string("baseline x86-64") : s.substr(1);
+#elif defined(__aarch64__)
+    return "NEON";
+#else
+    return "unknown";
+#endif
+}
@@ -1,8 +1,10 @@
 #ifndef SHASTA_PLATFORM_DEPENDENT_HPP
 #define SHASTA_PLATFORM_DEPENDENT_HPP
 
+#include "array.hpp"
 #include "cstdint.hpp"
 #include "string.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     
@@ -17,6 +19,89 @@ namespace shasta {
 
     // Get total physical memory available, in bytes.
     uint64_t getTotalPhysicalMemory();
+
+    // Get the physical memory available for new allocations, in bytes,
+    // as estimated by the kernel. Returns 0 if this information is not available.
+    uint64_t getAvailablePhysicalMemory();
+
+    // Resource usage of the current process.
+    // Items that are not available are zero.
+    class ResourceUsage {
+    public:
+        double userSeconds = 0.;
+        double systemSeconds = 0.;
+        uint64_t peakResidentBytes = 0;     // Since start, or since the last resetPeakResidentBytes.
+        uint64_t residentBytes = 0;
+        uint64_t majorFaultCount = 0;
+        uint64_t minorFaultCount = 0;
+        uint64_t bytesRead = 0;             // From storage, including page faults on mapped files.
+        uint64_t bytesWritten = 0;          // To storage.
+        uint64_t threadCount = 0;
+    };
+    ResourceUsage getResourceUsage();
+
+    // Reset the peak resident memory of the current process
+    // to its current resident memory. Returns false if this could not be done.
+    bool resetPeakResidentBytes();
+
+    // Hardware performance counters, obtained via perf_event_open.
+    // Values are scaled to compensate for multiplexing of the counters.
+    // Counters that are not available are set to invalid.
+    class HardwareCounters {
+    public:
+        enum {cycles, instructions, llcMisses, dtlbMisses, branchMisses, counterCount};
+        static const array<const char*, counterCount> names;
+        static const uint64_t invalid = ~uint64_t(0);
+        array<uint64_t, counterCount> values;
+    };
+
+    // Open the hardware performance counters for the calling thread
+    // and all threads it creates afterwards, which are counted together.
+    // This must be called by the main thread before any threads are started.
+    // Returns the number of counters that could be opened.
+    uint64_t openHardwareCounters();
+    bool hardwareCountersAreOpen();
+
+    // Get the current values of the hardware performance counters
+    // opened by openHardwareCounters.
+    HardwareCounters readHardwareCounters();
+
+    // Get a one line summary of transparent huge page usage:
+    // the anonymous memory of the current process backed by transparent
+    // huge pages, and the khugepaged counters.
+    // Items that are not available are omitted.
+    string getTransparentHugePageStatistics();
+
+    // Get the number of NUMA nodes. Returns 1 if this information
+    // is not available.
+    uint64_t getNumaNodeCount();
+
+    // Get the processors of the given NUMA node.
+    // Returns an empty vector if this information is not available.
+    vector<uint64_t> getNumaNodeProcessors(uint64_t numaNodeId);
+
+    // Restrict the calling thread to run on the processors of the given NUMA node.
+    // Returns false if this could not be done.
+    bool bindThreadToNumaNode(uint64_t numaNodeId);
+
+    // Get a one line summary of the vector instruction sets
+    // supported by the processor, as used by SHASTA_TARGET_CLONES.
+    string getInstructionSetSummary();
 }
 
+
+
+// Function multiversioning for hot, vectorizable loops.
+// With gcc on x86_64, a function marked SHASTA_TARGET_CLONES is compiled
+// for AVX-512, AVX2, and the baseline instruction set, and the best version
+// for the processor in use is selected when the program is loaded,
+// so the same portable executable runs fast on different processors.
+// Elsewhere, or when building with -march=native (BUILD_NATIVE),
+// this does nothing. It must only be used on non-inline functions.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && !defined(SHASTA_NATIVE_BUILD)
+#define SHASTA_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SHASTA_TARGET_CLONES
+#endif
+
 #endif
@@ -0,0 +1,100 @@
+#ifndef SHASTA_RADIX_SORT_HPP
+#define SHASTA_RADIX_SORT_HPP
+
+// LSD radix sort of objects by an unsigned integer key,
+// using 8 bits per pass.
+// Like countingSort.hpp, this sorts by key only and
+// is stable, so objects with equal keys keep their original order.
+// Only the low keyBitCount bits of the keys are used, so the number
+// of passes is proportional to the number of significant bits.
+// For typical marker KmerIds (2k bits), this is faster than
+// a comparison sort for all but the smallest inputs.
+// Passes in which all keys have the same digit are skipped.
+// The caller provides a work area which can be reused
+// across calls to avoid memory allocation.
+
+#include "algorithm.hpp"
+#include "array.hpp"
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    template<class T, class GetKey> void radixSort(
+        T* begin,
+        T* end,
+        uint64_t keyBitCount,
+        GetKey getKey,
+        vector<T>& work);
+}
+
+
+
+template<class T, class GetKey> void shasta::radixSort(
+    T* begin,
+    T* end,
+    uint64_t keyBitCount,
+    GetKey getKey,
+    vector<T>& work)
+{
+    const uint64_t n = end - begin;
+    if(n < 2) {
+        return;
+    }
+
+    // For short inputs, insertion sort is faster.
+    if(n < 64) {
+        for(T* it=begin+1; it<end; ++it) {
+            T t = *it;
+            const uint64_t key = getKey(t);
+            T* jt = it;
+            for(; jt!=begin and getKey(*(jt-1)) > key; --jt) {
+                *jt = *(jt-1);
+            }
+            *jt = t;
+        }
+        return;
+    }
+
+    work.resize(n);
+    T* source = begin;
+    T* destination = work.data();
+    array<uint64_t, 256> count;
+
+    const uint64_t passCount = (keyBitCount + 7) / 8;
+    for(uint64_t pass=0; pass<passCount; pass++) {
+        const uint64_t shift = 8 * pass;
+
+        // Count occurrences of each digit.
+        std::fill(count.begin(), count.end(), 0);
+        for(uint64_t i=0; i<n; i++) {
+            ++count[(getKey(source[i]) >> shift) & 255];
+        }
+
+        // If all keys have the same digit, this pass does nothing.
+        if(count[(getKey(source[0]) >> shift) & 255] == n) {
+            continue;
+        }
+
+        // Convert the counts to starting positions.
+        uint64_t sum = 0;
+        for(uint64_t& c: count) {
+            const uint64_t c0 = c;
+            c = sum;
+            sum += c0;
+        }
+
+        // Scatter.
+        for(uint64_t i=0; i<n; i++) {
+            const T& t = source[i];
+            destination[count[(getKey(t) >> shift) & 255]++] = t;
+        }
+        std::swap(source, destination);
+    }
+
+    // If the result ended up in the work area, copy it back.
+    if(source != begin) {
+        std::copy(source, source + n, begin);
+    }
+}
+
+#endif
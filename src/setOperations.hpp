@@ -2,31 +2,76 @@
 #define SHASTA_SET_OPERATIONS_HPP
 
 
+#include "algorithm.hpp"
 #include "cstdint.hpp"
 
 
 namespace shasta {
 
+    // Given two sorted ranges without duplicate elements
+    // representing two sets, compute the size of their intersection,
+    // for the case where the first range is much shorter than the second one.
+    // Used by intersectionSize below.
+    template<class Iterator> uint64_t intersectionSizeSkewed(
+        Iterator begin0, Iterator end0,
+        Iterator begin1, Iterator end1)
+    {
+        uint64_t n = 0;
+        Iterator it1 = begin1;
+        for(Iterator it0=begin0; it0!=end0; ++it0) {
+            it1 = std::lower_bound(it1, end1, *it0);
+            if(it1 == end1) {
+                break;
+            }
+            if(*it1 == *it0) {
+                ++n;
+                ++it1;
+            }
+        }
+        return n;
+    }
+
+
+
     // Given two sorted ranges without duplicate elements
     // representing two sets, compute the size of
     // their intersection - that is, the number of common elements.
+    // The iterators must be random access iterators.
+    // If one of the two ranges is much shorter than the other,
+    // this looks up each element of the short range in the long one
+    // using binary searches. Otherwise, it uses a merge
+    // in which the advances of the two iterators are computed
+    // without branches, so the compiler can use conditional moves
+    // instead of branches that are hard to predict.
     template<class Iterator> uint64_t intersectionSize(
         Iterator begin0, Iterator end0,
         Iterator begin1, Iterator end1)
     {
+        const uint64_t size0 = end0 - begin0;
+        const uint64_t size1 = end1 - begin1;
+        if(size0 == 0 or size1 == 0) {
+            return 0;
+        }
+
+        // Very different sizes.
+        const uint64_t skewRatio = 32;
+        if(size0 * skewRatio < size1) {
+            return intersectionSizeSkewed(begin0, end0, begin1, end1);
+        }
+        if(size1 * skewRatio < size0) {
+            return intersectionSizeSkewed(begin1, end1, begin0, end0);
+        }
+
+        // Merge.
         uint64_t n = 0;
         Iterator it0 = begin0;
         Iterator it1 = begin1;
         while(it0!=end0 && it1!=end1) {
-            if(*it0 < *it1) {
-                ++it0;
-            } else if(*it1 < *it0) {
-                ++it1;
-            } else {
-                ++n;
-                ++it0;
-                ++it1;
-            }
+            const auto x0 = *it0;
+            const auto x1 = *it1;
+            n += (x0 == x1);
+            it0 += (x0 <= x1);
+            it1 += (x1 <= x0);
         }
         return n;
     }
@@ -0,0 +1,78 @@
+#ifndef SHASTA_SORTED_INTERSECTION_HPP
+#define SHASTA_SORTED_INTERSECTION_HPP
+
+// Intersection of two sorted sequences of distinct uint32_t values.
+// For each value present in both a and b, this stores
+// the pair of its positions in a and b, in increasing order.
+// The positions can be used to access other information
+// stored in parallel with a and b (for example, edge ids).
+
+// Standard library.
+#include "cstdint.hpp"
+#include "span.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace shasta {
+    inline void sortedIntersection(
+        span<const uint32_t> a,
+        span<const uint32_t> b,
+        vector< pair<uint32_t, uint32_t> >& positions);
+}
+
+
+
+inline void shasta::sortedIntersection(
+    span<const uint32_t> a,
+    span<const uint32_t> b,
+    vector< pair<uint32_t, uint32_t> >& positions)
+{
+    positions.clear();
+    const uint64_t na = a.size();
+    const uint64_t nb = b.size();
+    uint64_t i = 0;
+    uint64_t j = 0;
+
+#if defined(__SSE2__)
+    // SSE2 is always available on x86_64.
+    // For each value of a, skip blocks of 4 values of b that are all smaller,
+    // then compare it with the next block of 4 values of b in a single instruction.
+    // Ordering comparisons are done in scalar code, because SSE2
+    // only has signed 32-bit comparisons.
+    while(i<na and j+4<=nb) {
+        const uint32_t x = a[i];
+        if(b[j+3] < x) {
+            j += 4;
+            continue;
+        }
+        const __m128i vx = _mm_set1_epi32(int(x));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + j));
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(vx, vb)));
+        if(mask) {
+            const uint64_t k = j + uint64_t(__builtin_ctz(mask));
+            positions.push_back({uint32_t(i), uint32_t(k)});
+            j = k + 1;
+        }
+        ++i;
+    }
+#endif
+
+    // Scalar merge for the rest.
+    while(i<na and j<nb) {
+        if(a[i] < b[j]) {
+            ++i;
+        } else if(b[j] < a[i]) {
+            ++j;
+        } else {
+            positions.push_back({uint32_t(i), uint32_t(j)});
+            ++i;
+            ++j;
+        }
+    }
+}
+
+#endif
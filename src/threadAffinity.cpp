@@ -0,0 +1,149 @@
+// Shasta.
+#include "threadAffinity.hpp"
+#include "platformDependent.hpp"
+using namespace shasta;
+
+// Linux.
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Standard library.
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include "vector.hpp"
+
+
+
+namespace shasta {
+    namespace {
+
+        // The processors allowed to this process.
+        // They are obtained the first time this is called,
+        // normally from setupThreadAffinity, before any threads are pinned.
+        const cpu_set_t& getAllowedProcessors()
+        {
+            static const cpu_set_t allowedProcessors = []()
+            {
+                cpu_set_t processors;
+                CPU_ZERO(&processors);
+                if(::sched_getaffinity(0, sizeof(processors), &processors) != 0) {
+                    for(int processor=0; processor<int(std::thread::hardware_concurrency()); processor++) {
+                        CPU_SET(processor, &processors);
+                    }
+                }
+                return processors;
+            }();
+            return allowedProcessors;
+        }
+
+        // If not empty, thread i of the thread pool is pinned to
+        // processor pinningOrder[i % pinningOrder.size()].
+        vector<uint64_t> pinningOrder;
+    }
+}
+
+
+
+void shasta::setupThreadAffinity(const string& threadAffinity, const string& numa)
+{
+    if(not (threadAffinity == "none" or threadAffinity == "compact" or threadAffinity == "scatter")) {
+        throw runtime_error("Invalid value specified for --threadAffinity: " + threadAffinity +
+            ". Allowed values are none, compact, scatter.");
+    }
+    if(not (numa == "default" or numa == "interleave")) {
+        throw runtime_error("Invalid value specified for --numa: " + numa +
+            ". Allowed values are default, interleave.");
+    }
+
+    // Find the allowed processors on each NUMA node.
+    const cpu_set_t& allowedProcessors = getAllowedProcessors();
+    const uint64_t numaNodeCount = getNumaNodeCount();
+    vector< vector<uint64_t> > topology;
+    for(uint64_t numaNodeId=0; numaNodeId<numaNodeCount; numaNodeId++) {
+        vector<uint64_t> processors;
+        for(const uint64_t processor: getNumaNodeProcessors(numaNodeId)) {
+            if(CPU_ISSET(processor, &allowedProcessors)) {
+                processors.push_back(processor);
+            }
+        }
+        if(not processors.empty()) {
+            topology.push_back(processors);
+        }
+    }
+
+    // If the topology is not available, use a single node
+    // containing all allowed processors.
+    if(topology.empty()) {
+        topology.resize(1);
+        for(uint64_t processor=0; processor<CPU_SETSIZE; processor++) {
+            if(CPU_ISSET(processor, &allowedProcessors)) {
+                topology.front().push_back(processor);
+            }
+        }
+    }
+
+    // Compute the order in which threads of the pool are pinned.
+    pinningOrder.clear();
+    if(threadAffinity == "compact") {
+        for(const vector<uint64_t>& processors: topology) {
+            pinningOrder.insert(pinningOrder.end(), processors.begin(), processors.end());
+        }
+    } else if(threadAffinity == "scatter") {
+        for(uint64_t i=0; ; i++) {
+            bool done = true;
+            for(const vector<uint64_t>& processors: topology) {
+                if(i < processors.size()) {
+                    pinningOrder.push_back(processors[i]);
+                    done = false;
+                }
+            }
+            if(done) {
+                break;
+            }
+        }
+    }
+    if(not pinningOrder.empty()) {
+        cout << "Threads will be pinned to " << pinningOrder.size() << " processors on " <<
+            topology.size() << " NUMA nodes." << endl;
+    }
+
+    // Set the memory policy of the calling thread.
+    // It is inherited by all threads created after this point.
+    if(numa == "interleave" and numaNodeCount > 1) {
+        vector<unsigned long> nodeMask((numaNodeCount + 63) / 64, 0);
+        for(uint64_t numaNodeId=0; numaNodeId<numaNodeCount; numaNodeId++) {
+            nodeMask[numaNodeId / 64] |= (1UL << (numaNodeId % 64));
+        }
+        if(::syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, nodeMask.data(), numaNodeCount + 1) != 0) {
+            throw runtime_error("Error setting the NUMA memory policy.");
+        }
+        cout << "Memory will be interleaved across " << numaNodeCount << " NUMA nodes." << endl;
+    }
+}
+
+
+
+void shasta::setThreadPoolThreadAffinity(size_t threadId)
+{
+    if(pinningOrder.empty()) {
+        ::sched_setaffinity(0, sizeof(cpu_set_t), &getAllowedProcessors());
+    } else {
+        cpu_set_t processors;
+        CPU_ZERO(&processors);
+        CPU_SET(pinningOrder[threadId % pinningOrder.size()], &processors);
+        ::sched_setaffinity(0, sizeof(processors), &processors);
+    }
+}
+
+
+
+void shasta::unpinThread(std::thread& thread)
+{
+    if(pinningOrder.empty()) {
+        return;
+    }
+    ::pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &getAllowedProcessors());
+}
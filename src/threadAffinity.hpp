@@ -0,0 +1,42 @@
+#ifndef SHASTA_THREAD_AFFINITY_HPP
+#define SHASTA_THREAD_AFFINITY_HPP
+
+// Thread pinning and NUMA memory placement.
+// The NUMA topology is obtained from /sys/devices/system/node.
+// If that is not available, all processors are assumed
+// to be on a single NUMA node.
+
+#include "string.hpp"
+#include <thread>
+
+namespace shasta {
+
+    // Set up thread affinity and NUMA memory placement for this process.
+    // This must be called before any threads are started.
+    // Allowed values for threadAffinity:
+    // - none: threads are not pinned (the default).
+    // - compact: consecutive threads of the thread pool are pinned
+    //   to consecutive processors of the same NUMA node,
+    //   filling one node before moving to the next.
+    // - scatter: consecutive threads are pinned to processors
+    //   on different NUMA nodes, in round robin order.
+    // Allowed values for numa:
+    // - default: pages are allocated on the NUMA node of the thread
+    //   that first touches them (first touch).
+    // - interleave: pages are interleaved across all NUMA nodes.
+    void setupThreadAffinity(const string& threadAffinity, const string& numa);
+
+    // Set the affinity of the calling thread, which must be
+    // thread threadId of the persistent thread pool.
+    // The pool calls this when the thread starts and after each job,
+    // so any changes made by a thread function (for example
+    // via bindThreadToNumaNode) don't persist to the next job.
+    void setThreadPoolThreadAffinity(size_t threadId);
+
+    // Allow a thread to run on all processors available to the process.
+    // Used for threads that are not part of the thread pool, which would otherwise
+    // inherit the affinity of a pinned thread that created them.
+    void unpinThread(std::thread&);
+}
+
+#endif
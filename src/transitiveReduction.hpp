@@ -3,6 +3,7 @@
 
 // Shasta.
 #include "deduplicate.hpp"
+#include "SHASTA_ASSERT.hpp"
 
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
@@ -10,10 +11,15 @@
 #include <boost/graph/topological_sort.hpp>
 
 // Standard library.
+#include "algorithm.hpp"
+#include <atomic>
 #include "iterator.hpp"
+#include <limits>
 #include <map>
 #include <queue>
 #include <set>
+#include <thread>
+#include "utility.hpp"
 #include "vector.hpp"
 
 namespace shasta {
@@ -23,6 +29,10 @@ namespace shasta {
 
     // Less performant version without the above requirement.
     template<class Graph> void transitiveReductionAny(Graph&);
+
+    // Version for large graphs, with the same requirements as transitiveReduction.
+    // It processes weakly connected components in parallel.
+    template<class Graph> void transitiveReductionParallel(Graph&, size_t threadCount);
 }
 
 
@@ -260,4 +270,242 @@ template<class Graph> void shasta::transitiveReductionAny(Graph &graph)
 
 }
 
+
+
+// Transitive reduction of a large directed graph without cycles.
+// Class Graph has the same requirements as for transitiveReduction.
+// If the graph has cycles, this throws boost::not_a_dag.
+//
+// Instead of doing a BFS for each edge, this does a single sweep
+// of each weakly connected component in reverse topological order,
+// keeping track of the vertices reachable from each vertex.
+// To keep memory under control, reachability is not stored as
+// a full bit vector. Instead, the vertices of each component
+// are decomposed into chains (paths of the graph),
+// and the set of vertices reachable from a vertex v
+// is stored as a label containing, for each chain, the lowest position
+// in the chain reachable from v. Because all vertices of a chain
+// following a reachable vertex are also reachable,
+// this describes the reachable set exactly.
+//
+// When processing vertex v, its children are visited in increasing
+// topological order, and the labels of the children already visited
+// are merged (using an elementwise minimum, which the compiler vectorizes).
+// An edge v->c is redundant if c is already reachable
+// from the merged label, because any other path from v to c
+// goes through a child of v that precedes c in topological order.
+//
+// If a component has many chains, the chains are processed in blocks,
+// so the memory used for each component is bounded.
+// Each block requires a sweep of the component.
+template<class Graph> void shasta::transitiveReductionParallel(Graph& graph, size_t threadCount)
+{
+    using namespace boost;
+    using vertex_descriptor = typename Graph::vertex_descriptor;
+    using edge_descriptor = typename Graph::edge_descriptor;
+
+    // Check the Graph type.
+    static_assert(
+        std::is_same<typename Graph::out_edge_list_selector, listS>::value,
+        "shasta::transitiveReductionParallel requires an adjacency_list "
+        "with the first template argument set to boost::listS.");
+    static_assert(
+        std::is_same<typename Graph::vertex_list_selector, vecS>::value,
+        "shasta::transitiveReductionParallel requires an adjacency_list "
+        "with the second template argument set to boost::vecS.");
+    static_assert(
+        std::is_same<typename Graph::directed_selector, directedS>::value
+        or
+        std::is_same<typename Graph::directed_selector, bidirectionalS>::value,
+        "shasta::transitiveReductionParallel requires an adjacency_list "
+        "with the third template argument set to boost::directedS or boost::bidirectionalS.");
+
+    const uint64_t n = num_vertices(graph);
+    if(n < 2) {
+        return;
+    }
+    SHASTA_ASSERT(n < std::numeric_limits<uint32_t>::max());
+    if(threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    // The rank of each vertex in topological order.
+    vector<vertex_descriptor> sortedVertices;
+    topological_sort(graph, back_inserter(sortedVertices));
+    std::reverse(sortedVertices.begin(), sortedVertices.end());
+    vector<uint32_t> vertexRank(n);
+    for(uint64_t rank=0; rank<n; rank++) {
+        vertexRank[sortedVertices[rank]] = uint32_t(rank);
+    }
+
+    // Store the out-edges in compressed sparse row format,
+    // indexed by vertex rank, with the children of each vertex
+    // sorted by rank. The edge descriptors are stored in the same order.
+    vector<uint64_t> childrenBegin(n + 1, 0);
+    vector< pair<uint32_t, edge_descriptor> > children;
+    for(uint64_t rank=0; rank<n; rank++) {
+        childrenBegin[rank] = children.size();
+        BGL_FORALL_OUTEDGES_T(sortedVertices[rank], e, graph, Graph) {
+            children.push_back({vertexRank[target(e, graph)], e});
+        }
+        std::sort(children.begin() + childrenBegin[rank], children.end(),
+            [](const auto& x, const auto& y) {return x.first < y.first;});
+    }
+    childrenBegin[n] = children.size();
+
+    // Find weakly connected components, using a union-find
+    // with path halving. Vertices are identified by rank.
+    vector<uint32_t> parent(n);
+    for(uint64_t rank=0; rank<n; rank++) {
+        parent[rank] = uint32_t(rank);
+    }
+    auto findSet = [&parent](uint32_t x) {
+        while(parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+    for(uint64_t rank=0; rank<n; rank++) {
+        for(uint64_t i=childrenBegin[rank]; i!=childrenBegin[rank+1]; i++) {
+            const uint32_t x = findSet(uint32_t(rank));
+            const uint32_t y = findSet(children[i].first);
+            if(x != y) {
+                parent[std::max(x, y)] = std::min(x, y);
+            }
+        }
+    }
+
+    // Gather the vertices of each component, in topological order.
+    vector<uint32_t> componentId(n);
+    vector< vector<uint32_t> > components;
+    for(uint64_t rank=0; rank<n; rank++) {
+        const uint32_t root = findSet(uint32_t(rank));
+        if(root == rank) {
+            componentId[rank] = uint32_t(components.size());
+            components.emplace_back();
+        } else {
+            componentId[rank] = componentId[root];
+        }
+        components[componentId[rank]].push_back(uint32_t(rank));
+    }
+
+    // The index of each vertex in its component, indexed by rank.
+    // Because component vertices are in topological order, so are their indexes.
+    vector<uint32_t> localIndex(n);
+    for(const vector<uint32_t>& component: components) {
+        for(uint64_t i=0; i<component.size(); i++) {
+            localIndex[component[i]] = uint32_t(i);
+        }
+    }
+
+    // Process the largest components first, for better load balancing.
+    vector<uint64_t> componentOrder(components.size());
+    for(uint64_t i=0; i<components.size(); i++) {
+        componentOrder[i] = i;
+    }
+    std::sort(componentOrder.begin(), componentOrder.end(),
+        [&components](uint64_t x, uint64_t y) {return components[x].size() > components[y].size();});
+
+    // For each edge in the children vector, a flag set if
+    // the edge should be removed. Each edge is only accessed by the
+    // thread processing its component, so vector<bool> cannot be used.
+    vector<uint8_t> isRedundant(children.size(), 0);
+
+    // The maximum number of label entries for each component.
+    const uint64_t maxLabelSize = 1ULL << 24;
+    const uint32_t infinity = std::numeric_limits<uint32_t>::max();
+
+    auto processComponent = [&](const vector<uint32_t>& component)
+    {
+        const uint64_t m = component.size();
+        if(m < 2) {
+            return;
+        }
+
+        // Chain decomposition. Each vertex not yet in a chain starts a new chain,
+        // and extends it with its first child that is not yet in a chain.
+        vector<uint32_t> chain(m, infinity);
+        vector<uint32_t> position(m);
+        uint64_t chainCount = 0;
+        for(uint64_t i=0; i<m; i++) {
+            if(chain[i] == infinity) {
+                chain[i] = uint32_t(chainCount++);
+                position[i] = 0;
+            }
+            const uint32_t rank = component[i];
+            for(uint64_t j=childrenBegin[rank]; j!=childrenBegin[rank+1]; j++) {
+                const uint64_t k = localIndex[children[j].first];
+                if(chain[k] == infinity) {
+                    chain[k] = chain[i];
+                    position[k] = position[i] + 1;
+                    break;
+                }
+            }
+        }
+
+        // Process the chains in blocks.
+        const uint64_t blockSize = std::max(uint64_t(1), std::min(chainCount, maxLabelSize / m));
+        vector<uint32_t> labels;
+        vector<uint32_t> merged(blockSize);
+        for(uint64_t chainBegin=0; chainBegin<chainCount; chainBegin+=blockSize) {
+            const uint64_t chainEnd = std::min(chainCount, chainBegin + blockSize);
+            const uint64_t w = chainEnd - chainBegin;
+            labels.assign(m * w, infinity);
+
+            // Reverse topological sweep.
+            for(uint64_t i=m-1; ; i--) {
+                std::fill(merged.begin(), merged.begin() + w, infinity);
+                const uint32_t rank = component[i];
+                for(uint64_t j=childrenBegin[rank]; j!=childrenBegin[rank+1]; j++) {
+                    const uint64_t k = localIndex[children[j].first];
+                    const uint64_t c = chain[k];
+                    if(c >= chainBegin and c < chainEnd and merged[c - chainBegin] <= position[k]) {
+                        isRedundant[j] = 1;
+                    }
+                    const uint32_t* label = labels.data() + k * w;
+                    for(uint64_t l=0; l<w; l++) {
+                        merged[l] = std::min(merged[l], label[l]);
+                    }
+                }
+                std::copy(merged.begin(), merged.begin() + w, labels.begin() + i * w);
+                if(chain[i] >= chainBegin and chain[i] < chainEnd) {
+                    labels[i * w + (chain[i] - chainBegin)] = position[i];
+                }
+                if(i == 0) {
+                    break;
+                }
+            }
+        }
+    };
+
+    // Process the components in parallel.
+    std::atomic<uint64_t> nextComponent(0);
+    auto threadFunction = [&]()
+    {
+        while(true) {
+            const uint64_t i = nextComponent++;
+            if(i >= componentOrder.size()) {
+                break;
+            }
+            processComponent(components[componentOrder[i]]);
+        }
+    };
+    vector<std::thread> threads;
+    for(uint64_t threadId=1; threadId<threadCount; threadId++) {
+        threads.push_back(std::thread(threadFunction));
+    }
+    threadFunction();
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+    // Remove the redundant edges.
+    for(uint64_t i=0; i<children.size(); i++) {
+        if(isRedundant[i]) {
+            boost::remove_edge(children[i].second, graph);
+        }
+    }
+}
+
 #endif
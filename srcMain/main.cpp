@@ -7,13 +7,24 @@
 #include "Assembler.hpp"
 #include "AssemblerOptions.hpp"
 #include "AssemblyGraph.hpp"
+#include "AssemblyStage.hpp"
 #include "buildId.hpp"
+#include "computeLayout.hpp"
 #include "ConfigurationTable.hpp"
 #include "Coverage.hpp"
 #include "filesystem.hpp"
+#include "HttpResponseCache.hpp"
+#include "mappedCopy.hpp"
+#include "MetricsServer.hpp"
+#include "MurmurHash2.hpp"
+#include "objectStorage.hpp"
+#include "PerformanceComparison.hpp"
 #include "performanceLog.hpp"
 #include "Reads.hpp"
+#include "ResourceEstimate.hpp"
+#include "SlowItemTracer.hpp"
 #include "Tee.hpp"
+#include "threadAffinity.hpp"
 #include "timestamp.hpp"
 #include "platformDependent.hpp"
 #include "SimpleBayesianConsensusCaller.hpp"
@@ -29,7 +40,8 @@ namespace shasta {
         void assemble(
             Assembler&,
             const AssemblerOptions&,
-            vector<string> inputNames);
+            vector<string> inputNames,
+            const string& readStore);
 
         void mode0Assembly(
             Assembler&,
@@ -54,8 +66,32 @@ namespace shasta {
         void setupHugePages();
         void segmentFaultHandler(int);
 
+        // Checkpoints used by --resumeFrom.
+        // The assembly is divided in stages. When a stage completes,
+        // it stores in AssemblerInfo::checkpointHash a hash of the options
+        // used by that stage and all previous stages.
+        // When resuming, the first stage that did not complete,
+        // or that completed with different options, runs again,
+        // followed by all subsequent stages.
+        // The stages are defined in AssemblyStage.hpp.
+        array<uint64_t, assemblyStageCount> computeCheckpointHashes(
+            const AssemblerOptions&,
+            const vector<string>& inputNames,
+            const string& readStore);
+        uint64_t findFirstAssemblyStage(
+            const Assembler&,
+            const AssemblerOptions&,
+            const array<uint64_t, assemblyStageCount>& checkpointHashes);
+        void accessCompletedAssemblyStages(
+            Assembler&,
+            const AssemblerOptions&,
+            uint64_t firstStage,
+            uint32_t threadCount);
+
         // Functions that implement --command keywords
         void assemble(const AssemblerOptions&, int argumentCount, const char** arguments);
+        void assembleBatch(AssemblerOptions&, int argumentCount, const char** arguments);
+        void createReadStore(const AssemblerOptions&);
         void saveBinaryData(const AssemblerOptions&);
         void cleanupBinaryData(const AssemblerOptions&);
         void createBashCompletionScript(const AssemblerOptions&);
@@ -63,15 +99,24 @@ namespace shasta {
         void listConfigurations();
         void listConfiguration(const AssemblerOptions&);
         void explore(const AssemblerOptions&);
+        void estimateResources(const AssemblerOptions&);
+        void comparePerformance(const AssemblerOptions&);
+        void alignmentWorker(const AssemblerOptions&);
 
         const std::set<string> commands = {
+            "alignmentWorker",
             "assemble",
+            "assembleBatch",
             "cleanupBinaryData",
+            "comparePerformance",
             "createBashCompletionScript",
+            "createReadStore",
+            "estimateResources",
             "explore",
             "listCommands",
             "listConfiguration",
             "listConfigurations",
+            "rebuildReadGraph",
             "saveBinaryData"};
 
     }
@@ -86,8 +131,10 @@ using namespace shasta;
 #include  <boost/chrono/process_cpu_clocks.hpp>
 
 //  Linux.
+#include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -95,6 +142,8 @@ using namespace shasta;
 #include "chrono.hpp"
 #include "iostream.hpp"
 #include "iterator.hpp"
+#include <map>
+#include <sstream>
 #include "stdexcept.hpp"
 
 
@@ -164,6 +213,12 @@ void shasta::main::main(int argumentCount, const char** arguments)
     if(assemblerOptions.commandLineOnlyOptions.command == "assemble") {
         assemble(assemblerOptions, argumentCount, arguments);
         return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "assembleBatch") {
+        assembleBatch(assemblerOptions, argumentCount, arguments);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "createReadStore") {
+        createReadStore(assemblerOptions);
+        return;
     } else if(assemblerOptions.commandLineOnlyOptions.command == "cleanupBinaryData") {
         cleanupBinaryData(assemblerOptions);
         return;
@@ -173,6 +228,12 @@ void shasta::main::main(int argumentCount, const char** arguments)
     } else if(assemblerOptions.commandLineOnlyOptions.command == "explore") {
         explore(assemblerOptions);
         return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "estimateResources") {
+        estimateResources(assemblerOptions);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "comparePerformance") {
+        comparePerformance(assemblerOptions);
+        return;
     } else if(assemblerOptions.commandLineOnlyOptions.command == "createBashCompletionScript") {
         createBashCompletionScript(assemblerOptions);
         return;
@@ -185,6 +246,12 @@ void shasta::main::main(int argumentCount, const char** arguments)
     } else if(assemblerOptions.commandLineOnlyOptions.command == "listConfiguration") {
         listConfiguration(assemblerOptions);
         return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "rebuildReadGraph") {
+        assemble(assemblerOptions, argumentCount, arguments);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "alignmentWorker") {
+        alignmentWorker(assemblerOptions);
+        return;
     }
 
     // We already checked for a valid command above, so if we get here
@@ -195,12 +262,21 @@ void shasta::main::main(int argumentCount, const char** arguments)
 
 
 
-// Implementation of --command assemble.
+// Implementation of --command assemble and --command rebuildReadGraph.
+// --command rebuildReadGraph resumes an existing assembly
+// from the read graph stage, even if the options of the previous stages
+// changed. This can be used to apply new alignment thresholds
+// (see Assembler::createReadGraph) without recomputing the alignments.
+// Alignments discarded when they were computed cannot be recovered,
+// so only thresholds stricter than the ones used to compute
+// the alignments have an effect.
 void shasta::main::assemble(
     const AssemblerOptions& assemblerOptions,
     int argumentCount, const char** arguments)
 {
-    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "assemble");
+    SHASTA_ASSERT(
+        assemblerOptions.commandLineOnlyOptions.command == "assemble" or
+        assemblerOptions.commandLineOnlyOptions.command == "rebuildReadGraph");
 
 
     // Various checks for option validity.
@@ -231,11 +307,23 @@ void shasta::main::assemble(
             "Must be between 6 and 31");
     }
 
-    // Check that we have at least one input file.
-    if(assemblerOptions.commandLineOnlyOptions.inputFileNames.empty()) {
-        cout << assemblerOptions.allOptionsDescription << endl;
-        throw runtime_error("Specify at least one input file "
-            "using command line option \"--input\".");
+    // Check that we have at least one input file,
+    // unless the reads come from a read store.
+    const string& readStore = assemblerOptions.commandLineOnlyOptions.readStore;
+    if(readStore.empty()) {
+        if(assemblerOptions.commandLineOnlyOptions.inputFileNames.empty()) {
+            cout << assemblerOptions.allOptionsDescription << endl;
+            throw runtime_error("Specify at least one input file "
+                "using command line option \"--input\".");
+        }
+    } else {
+        if(not assemblerOptions.commandLineOnlyOptions.inputFileNames.empty()) {
+            throw runtime_error("Command line options \"--input\" and \"--readStore\" "
+                "cannot be used together.");
+        }
+        if(!std::filesystem::is_directory(readStore)) {
+            throw runtime_error("Read store not found: " + readStore);
+        }
     }
 
     // Check assemblerOptions.minHashOptions.version.
@@ -257,6 +345,15 @@ void shasta::main::assemble(
             );
     }
 
+    // Alignment workers access the binary data via the filesystem.
+    if(assemblerOptions.commandLineOnlyOptions.alignmentWorkerPort != 0) {
+        if(assemblerOptions.commandLineOnlyOptions.memoryMode != "filesystem" or
+            assemblerOptions.commandLineOnlyOptions.memoryBacking != "disk") {
+            throw runtime_error("--alignmentWorkerPort requires "
+                "--memoryMode filesystem and --memoryBacking disk.");
+        }
+    }
+
     // If coverage data was requested, memoryMode should be filesystem,
     // otherwise the coverage data cannot be accessed.
     if(assemblerOptions.assemblyOptions.storeCoverageData) {
@@ -298,7 +395,12 @@ void shasta::main::assemble(
     // Find absolute paths of the input files.
     // We will use them below after changing directory to the output directory.
     vector<string> inputFileAbsolutePaths;
+    // URLs are used unchanged and checked when the reads are loaded.
     for(const string& inputFileName: assemblerOptions.commandLineOnlyOptions.inputFileNames) {
+        if(isObjectStorageUrl(inputFileName)) {
+            inputFileAbsolutePaths.push_back(inputFileName);
+            continue;
+        }
         if(!std::filesystem::exists(inputFileName)) {
             throw runtime_error("Input file not found: " + inputFileName);
         }
@@ -307,13 +409,82 @@ void shasta::main::assemble(
         }
         inputFileAbsolutePaths.push_back(filesystem::getAbsolutePath(inputFileName));
     }
+    const string readStoreAbsolutePath =
+        readStore.empty() ? string() : filesystem::getAbsolutePath(readStore);
+
+    // If tiered placement of binary data was requested, get the names
+    // of the cold binary data. This is done before changing directory,
+    // so a relative path to the policy file can be used.
+    const string& memoryTiering = assemblerOptions.commandLineOnlyOptions.memoryTiering;
+    vector<string> coldDataNames;
+    if(not memoryTiering.empty()) {
+        if(assemblerOptions.commandLineOnlyOptions.memoryMode != "filesystem" or
+            (assemblerOptions.commandLineOnlyOptions.memoryBacking != "4K" and
+            assemblerOptions.commandLineOnlyOptions.memoryBacking != "2M")) {
+            throw runtime_error("--memoryTiering requires --memoryMode filesystem "
+                "and --memoryBacking 4K or 2M.");
+        }
+        if(memoryTiering == "default") {
+            coldDataNames = MappedMemoryOwner::defaultColdDataNames();
+        } else {
+            coldDataNames = MappedMemoryOwner::readColdDataNames(memoryTiering);
+        }
+    }
+
+    // If requested, estimate the memory needed and stop
+    // before doing any work if the assembly is not expected to fit.
+    if(assemblerOptions.commandLineOnlyOptions.memoryCheck) {
+        if(readStore.empty()) {
+            const ResourceEstimate resourceEstimate(assemblerOptions,
+                assemblerOptions.commandLineOnlyOptions.estimateSampleSize * 1024ULL * 1024ULL);
+            string recommendation;
+            const bool fits = resourceEstimate.check(recommendation);
+            cout << recommendation << endl;
+            if(not fits) {
+                resourceEstimate.write(cout);
+                throw runtime_error("The assembly is not expected to fit in the available resources. "
+                    "Use --command estimateResources for details, or omit --memoryCheck to assemble anyway.");
+            }
+        } else {
+            cout << "--memoryCheck is not supported with --readStore and was ignored." << endl;
+        }
+    }
 
 
 
+    // If resuming an interrupted assembly, the assembly directory
+    // must contain the binary data of that assembly.
+    const string& resumeFrom = assemblerOptions.commandLineOnlyOptions.resumeFrom;
+    const bool rebuildReadGraph = (assemblerOptions.commandLineOnlyOptions.command == "rebuildReadGraph");
+    if(rebuildReadGraph and not resumeFrom.empty()) {
+        throw runtime_error("--resumeFrom cannot be used with --command rebuildReadGraph.");
+    }
+    const bool resume = rebuildReadGraph or not resumeFrom.empty();
+    if(resume) {
+        if(not rebuildReadGraph and resumeFrom != "auto" and
+            (std::find(assemblyStageNames.begin(), assemblyStageNames.end(), resumeFrom) == assemblyStageNames.end()
+            or resumeFrom == assemblyStageNames.front())) {
+            throw runtime_error("Invalid value specified for --resumeFrom: " + resumeFrom +
+                "\nValid values are: auto, markers, alignmentCandidates, alignments, readGraph, assembly.");
+        }
+        if(assemblerOptions.commandLineOnlyOptions.memoryMode != "filesystem") {
+            throw runtime_error((rebuildReadGraph ? "--command rebuildReadGraph" : "--resumeFrom") +
+                string(" requires --memoryMode filesystem."));
+        }
+        const string infoFileName = assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/Data/Info";
+        if(not std::filesystem::exists(infoFileName)) {
+            throw runtime_error(infoFileName + " does not exist. "
+                "There is no interrupted assembly to resume in assembly directory " +
+                assemblerOptions.commandLineOnlyOptions.assemblyDirectory + ".");
+        }
+    }
+
     // Create the assembly directory. If it exists and is not empty then stop.
     bool exists = std::filesystem::exists(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
     bool isDir = std::filesystem::is_directory(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
-    if (exists) {
+    if(resume) {
+        // Already checked above.
+    } else if (exists) {
         if (!isDir) {
             throw runtime_error(
                 assemblerOptions.commandLineOnlyOptions.assemblyDirectory +
@@ -337,12 +508,16 @@ void shasta::main::assemble(
     std::filesystem::current_path(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
 
     // Open the performance log.
-    openPerformanceLog("performance.log");
-    performanceLog << timestamp << "Assembly begins." << endl;
+    // When resuming, the existing logs are appended to.
+    openPerformanceLog("performance.log", resume);
+    performanceLog << timestamp << (resume ? "Assembly resumes." : "Assembly begins.") << endl;
+    openPerformanceTrace("performance.jsonl", resume);
+    enableThreadStatistics(assemblerOptions.commandLineOnlyOptions.threadStatistics);
+    enableSlowItemTracing(assemblerOptions.commandLineOnlyOptions.slowItemCount);
 
     // Open stdout.log and "tee" (duplicate) stdout to it.
     if(not assemblerOptions.commandLineOnlyOptions.suppressStdoutLog) {
-        shastaLog.open("stdout.log");
+        shastaLog.open("stdout.log", resume ? std::ios::app : std::ios::out);
         tee.duplicate(cout, shastaLog);
     }
 
@@ -355,14 +530,62 @@ void shasta::main::assemble(
 
 
 
+    // Set up thread pinning and NUMA memory placement.
+    // This must be done before any threads are started.
+    setupThreadAffinity(
+        assemblerOptions.commandLineOnlyOptions.threadAffinity,
+        assemblerOptions.commandLineOnlyOptions.numa);
+
+    // Open the hardware performance counters.
+    // This also must be done before any threads are started,
+    // so all threads are counted.
+    if(assemblerOptions.commandLineOnlyOptions.hardwareCounters) {
+        const uint64_t counterCount = openHardwareCounters();
+        performanceLog << timestamp << "Opened " << counterCount << " of " <<
+            uint64_t(HardwareCounters::counterCount) << " hardware performance counters." << endl;
+        if(counterCount == 0) {
+            cout << "Hardware performance counters are not available and will not be used." << endl;
+        }
+    }
+
+    // Start the metrics server, if requested.
+    if(assemblerOptions.commandLineOnlyOptions.metricsPort != 0) {
+        MetricsServer::start(assemblerOptions.commandLineOnlyOptions.metricsPort);
+    }
+
+
+
     // Set up the run directory as required by the memoryMode and memoryBacking options.
+    // When resuming, the Data directory is already set up,
+    // and the page size is obtained from the existing binary data.
     size_t pageSize = 0;
     string dataDirectory;
-    setupRunDirectory(
-        assemblerOptions.commandLineOnlyOptions.memoryMode,
-        assemblerOptions.commandLineOnlyOptions.memoryBacking,
-        pageSize,
-        dataDirectory);
+    if(resume) {
+        dataDirectory = "Data/";
+
+        // Only files on hugetlbfs are pooled, so this has no effect
+        // if the Data directory is not backed by 2M pages.
+        MemoryMapped::useHugePagePool = true;
+        if(not memoryTiering.empty()) {
+            cout << "--memoryTiering is ignored when resuming. "
+                "The placement of binary data of the interrupted assembly is kept." << endl;
+        }
+    } else {
+        setupRunDirectory(
+            assemblerOptions.commandLineOnlyOptions.memoryMode,
+            assemblerOptions.commandLineOnlyOptions.memoryBacking,
+            pageSize,
+            dataDirectory);
+
+        // Set up tiered placement of binary data, if requested.
+        // The cold data go to a directory on disk.
+        if(not memoryTiering.empty()) {
+            MappedMemoryOwner::setupColdData(
+                MappedMemoryOwner::coldDataDirectoryName(dataDirectory), coldDataNames);
+            cout << coldDataNames.size() << " binary data structures will be placed in " <<
+                MappedMemoryOwner::coldDataFileNamePrefix << endl;
+        }
+    }
 
 
 
@@ -389,13 +612,17 @@ void shasta::main::assemble(
     }
 
     // Create the Assembler.
-    Assembler assembler(dataDirectory, true, assemblerOptions.readsOptions.representation, pageSize);
+    Assembler assembler(dataDirectory, not resume, assemblerOptions.readsOptions.representation, pageSize);
+    if(resume and assembler.assemblerInfo->readRepresentation != assemblerOptions.readsOptions.representation) {
+        throw runtime_error("--resumeFrom: the interrupted assembly used a different "
+            "value of --Reads.representation.");
+    }
     assembler.assemblerInfo->readGraphCreationMethod = assemblerOptions.readGraphOptions.creationMethod;
     assembler.assemblerInfo->assemblyMode = assemblerOptions.assemblyOptions.mode;
 
 
     // Run the assembly.
-    assemble(assembler, assemblerOptions, inputFileAbsolutePaths);
+    assemble(assembler, assemblerOptions, inputFileAbsolutePaths, readStoreAbsolutePath);
 
     // Final disclaimer message.
     if(assemblerOptions.commandLineOnlyOptions.memoryBacking != "2M" &&
@@ -419,6 +646,256 @@ void shasta::main::assemble(
 
 
 
+// Implementation of --command assembleBatch.
+// Assembles each of the samples listed in the --batchManifest file
+// in its own assembly directory, assemblyDirectory/sampleName.
+// Up to --batchConcurrency assemblies run at the same time,
+// and the --threads threads are divided among them.
+// Each assembly runs in a child process created by fork, which
+// gets a copy of the parsed options and runs --command assemble.
+// A separate process is needed for each assembly because an assembly
+// uses process-wide state: the current directory (the assembly directory),
+// the performance log, stdout.log, and the placement of binary data.
+// Samples are started in order of decreasing total input size,
+// each as soon as a previous one finishes, so the small assemblies
+// fill the gaps left by the large ones.
+// The output of each assembly goes to assemblyDirectory/sampleName.log,
+// and a summary of all assemblies to assemblyDirectory/BatchSummary.csv.
+void shasta::main::assembleBatch(
+    AssemblerOptions& assemblerOptions,
+    int argumentCount, const char** arguments)
+{
+    CommandLineOnlyOptions& options = assemblerOptions.commandLineOnlyOptions;
+    SHASTA_ASSERT(options.command == "assembleBatch");
+
+    // Check for options that cannot be used with assembleBatch.
+    if(options.batchManifest.empty()) {
+        throw runtime_error("--command assembleBatch requires --batchManifest.");
+    }
+    if(not options.inputFileNames.empty() or not options.readStore.empty()) {
+        throw runtime_error("--command assembleBatch gets the input files from --batchManifest. "
+            "Command line options \"--input\" and \"--readStore\" cannot be used.");
+    }
+    if(not options.resumeFrom.empty()) {
+        throw runtime_error("--resumeFrom cannot be used with --command assembleBatch.");
+    }
+    if(options.threadAffinity != "none") {
+        throw runtime_error("--threadAffinity cannot be used with --command assembleBatch.");
+    }
+    if(options.alignmentWorkerPort != 0) {
+        throw runtime_error("--alignmentWorkerPort cannot be used with --command assembleBatch.");
+    }
+    if(options.metricsPort != 0) {
+        throw runtime_error("--metricsPort cannot be used with --command assembleBatch.");
+    }
+
+    // Read the manifest.
+    class Sample {
+    public:
+        string name;
+        vector<string> inputFileNames;
+        uint64_t inputSize = 0;
+    };
+    vector<Sample> samples;
+    {
+        ifstream manifest(options.batchManifest);
+        if(not manifest) {
+            throw runtime_error("Error opening " + options.batchManifest);
+        }
+        std::set<string> sampleNames;
+        string line;
+        while(std::getline(manifest, line)) {
+            std::istringstream s(line);
+            Sample sample;
+            if(not (s >> sample.name) or sample.name[0] == '#') {
+                continue;
+            }
+            if(sample.name.find('/') != string::npos) {
+                throw runtime_error("Invalid sample name " + sample.name + " in " + options.batchManifest);
+            }
+            if(not sampleNames.insert(sample.name).second) {
+                throw runtime_error("Duplicate sample name " + sample.name + " in " + options.batchManifest);
+            }
+            string inputFileName;
+            while(s >> inputFileName) {
+                if(not std::filesystem::is_regular_file(inputFileName)) {
+                    throw runtime_error("Input file for sample " + sample.name +
+                        " not found or not a regular file: " + inputFileName);
+                }
+                sample.inputFileNames.push_back(filesystem::getAbsolutePath(inputFileName));
+                sample.inputSize += std::filesystem::file_size(inputFileName);
+            }
+            if(sample.inputFileNames.empty()) {
+                throw runtime_error("No input files specified for sample " + sample.name +
+                    " in " + options.batchManifest);
+            }
+            samples.push_back(sample);
+        }
+    }
+    if(samples.empty()) {
+        throw runtime_error("No samples found in " + options.batchManifest);
+    }
+
+    // Largest first.
+    std::stable_sort(samples.begin(), samples.end(),
+        [](const Sample& x, const Sample& y)
+        {
+            return x.inputSize > y.inputSize;
+        });
+
+    // Divide the threads among the concurrent assemblies.
+    uint64_t threadCount = options.threadCount;
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    uint64_t concurrency = options.batchConcurrency;
+    if(concurrency == 0) {
+        concurrency = max(uint64_t(1), threadCount / 8);
+    }
+    concurrency = min(concurrency, uint64_t(samples.size()));
+    const uint64_t threadsPerAssembly = max(uint64_t(1), threadCount / concurrency);
+
+    // Create the batch directory, if necessary.
+    // It can exist, but the assembly directories of the samples must not.
+    if(not std::filesystem::exists(options.assemblyDirectory)) {
+        SHASTA_ASSERT(std::filesystem::create_directory(options.assemblyDirectory));
+    } else if(not std::filesystem::is_directory(options.assemblyDirectory)) {
+        throw runtime_error(options.assemblyDirectory + " already exists and is not a directory.");
+    }
+    const string batchDirectory = filesystem::getAbsolutePath(options.assemblyDirectory);
+    for(const Sample& sample: samples) {
+        if(std::filesystem::exists(batchDirectory + "/" + sample.name)) {
+            throw runtime_error("Assembly directory " + batchDirectory + "/" + sample.name +
+                " already exists.");
+        }
+    }
+
+    cout << timestamp << "Assembling " << samples.size() << " samples with up to " <<
+        concurrency << " concurrent assemblies using " << threadsPerAssembly <<
+        " threads each." << endl;
+
+
+
+    // The child processes currently running, keyed by process id,
+    // with the index of the sample they are assembling.
+    std::map<pid_t, uint64_t> running;
+    vector<int> exitStatus(samples.size(), -1);
+    vector<double> elapsedSeconds(samples.size(), 0.);
+    vector<steady_clock::time_point> startTimes(samples.size());
+    uint64_t nextSample = 0;
+    uint64_t failedCount = 0;
+
+    while(nextSample < samples.size() or not running.empty()) {
+
+        // Start as many assemblies as allowed.
+        while(nextSample < samples.size() and running.size() < concurrency) {
+            const uint64_t i = nextSample++;
+            const Sample& sample = samples[i];
+            cout << timestamp << "Starting assembly of sample " << sample.name << endl;
+            startTimes[i] = steady_clock::now();
+
+            // Flush before forking, so the child does not write
+            // buffered output of the parent.
+            cout.flush();
+            const pid_t pid = ::fork();
+            if(pid == -1) {
+                throw runtime_error("Error " + to_string(errno) + " during fork: " + strerror(errno));
+            }
+
+            if(pid == 0) {
+
+                // This is the child process.
+                // Send its output to the log of this sample.
+                const string logFileName = batchDirectory + "/" + sample.name + ".log";
+                const int fileDescriptor = ::open(logFileName.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if(fileDescriptor == -1) {
+                    ::_exit(2);
+                }
+                ::dup2(fileDescriptor, STDOUT_FILENO);
+                ::dup2(fileDescriptor, STDERR_FILENO);
+                ::close(fileDescriptor);
+
+                // Run the assembly of this sample.
+                int returnCode = 0;
+                try {
+                    options.command = "assemble";
+                    options.inputFileNames = sample.inputFileNames;
+                    options.assemblyDirectory = batchDirectory + "/" + sample.name;
+                    options.threadCount = uint32_t(threadsPerAssembly);
+                    assemble(assemblerOptions, argumentCount, arguments);
+                } catch (const runtime_error& e) {
+                    cout << timestamp << e.what() << endl;
+                    returnCode = 2;
+                } catch (const std::bad_alloc& e) {
+                    cout << timestamp << e.what() << endl;
+                    cout << "Memory allocation failure." << endl;
+                    returnCode = 2;
+                } catch (const exception& e) {
+                    cout << timestamp << e.what() << endl;
+                    returnCode = 3;
+                } catch (...) {
+                    cout << timestamp << "Terminated after catching a non-standard exception." << endl;
+                    returnCode = 4;
+                }
+                ::exit(returnCode);
+            }
+
+            running.insert(make_pair(pid, i));
+        }
+
+        // Wait for one of the running assemblies to finish.
+        int status = 0;
+        const pid_t pid = ::waitpid(-1, &status, 0);
+        if(pid == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Error " + to_string(errno) + " during waitpid: " + strerror(errno));
+        }
+        const auto it = running.find(pid);
+        if(it == running.end()) {
+            continue;
+        }
+        const uint64_t i = it->second;
+        running.erase(it);
+        elapsedSeconds[i] = seconds(steady_clock::now() - startTimes[i]);
+        exitStatus[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if(exitStatus[i] == 0) {
+            cout << timestamp << "Assembly of sample " << samples[i].name <<
+                " completed in " << elapsedSeconds[i] << " s." << endl;
+        } else {
+            ++failedCount;
+            cout << timestamp << "Assembly of sample " << samples[i].name <<
+                " failed with status " << exitStatus[i] << ". See " <<
+                batchDirectory << "/" << samples[i].name << ".log" << endl;
+        }
+    }
+
+
+
+    // Write the summary.
+    {
+        ofstream csv(batchDirectory + "/BatchSummary.csv");
+        csv << "Sample,InputBytes,Threads,ExitStatus,ElapsedSeconds\n";
+        for(uint64_t i=0; i<samples.size(); i++) {
+            csv << samples[i].name << ",";
+            csv << samples[i].inputSize << ",";
+            csv << threadsPerAssembly << ",";
+            csv << exitStatus[i] << ",";
+            csv << elapsedSeconds[i] << "\n";
+        }
+    }
+
+    cout << timestamp << "Batch assembly ends. " << samples.size() - failedCount <<
+        " of " << samples.size() << " assemblies completed successfully. See " <<
+        batchDirectory << "/BatchSummary.csv" << endl;
+    if(failedCount > 0) {
+        throw runtime_error(to_string(failedCount) + " assemblies failed.");
+    }
+}
+
+
 // Set up the run directory as required by the memoryMode and memoryBacking options.
 void shasta::main::setupRunDirectory(
     const string& memoryMode,
@@ -444,6 +921,17 @@ void shasta::main::setupRunDirectory(
             dataDirectory = "";
             pageSize = 4096;
 
+        } else if(memoryBacking == "THP") {
+
+            // Anonymous memory on 4KB pages, with large mappings
+            // aligned and advised so the kernel can back them
+            // with transparent huge pages.
+            // This does not require root privilege.
+            dataDirectory = "";
+            pageSize = 4096;
+            MemoryMapped::useTransparentHugePages = true;
+            performanceLog << getTransparentHugePageStatistics() << endl;
+
         } else if(memoryBacking == "2M") {
 
             // Anonymous memory on 2MB pages.
@@ -456,7 +944,7 @@ void shasta::main::setupRunDirectory(
 
         } else {
             throw runtime_error("Invalid value specified for --memoryBacking: " + memoryBacking +
-                "\nValid values are: disk, 4K, 2M.");
+                "\nValid values are: disk, 4K, THP, 2M.");
         }
 
     } else if(memoryMode == "filesystem") {
@@ -468,6 +956,7 @@ void shasta::main::setupRunDirectory(
             SHASTA_ASSERT(std::filesystem::create_directory("Data"));
             dataDirectory = "Data/";
             pageSize = 4096;
+            MemoryMapped::preallocateFiles = true;
 
         } else if(memoryBacking == "4K") {
 
@@ -495,6 +984,7 @@ void shasta::main::setupRunDirectory(
             SHASTA_ASSERT(std::filesystem::create_directory("Data"));
             dataDirectory = "Data/";
             pageSize = 2 * 1024 * 1024;
+            MemoryMapped::useHugePagePool = true;
             const uid_t userId = ::getuid();
             const gid_t groupId = ::getgid();
             const string command = "sudo mount -t hugetlbfs -o pagesize=2M"
@@ -525,11 +1015,15 @@ void shasta::main::setupRunDirectory(
 // - The Data directory has already been created and set up, if necessary.
 // - The input file names are either absolute,
 //   or relative to the run directory, which is the current directory.
+// - If readStore is not empty, the input file names are empty
+//   and the reads are taken from that read store instead.
 void shasta::main::assemble(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
-    vector<string> inputFileNames)
+    vector<string> inputFileNames,
+    const string& readStore)
 {
+    const PerformanceSpan performanceSpan("assemble");
     const auto steadyClock0 = std::chrono::steady_clock::now();
     const auto userClock0 = boost::chrono::process_user_cpu_clock::now();
     const auto systemClock0 = boost::chrono::process_system_cpu_clock::now();
@@ -540,6 +1034,7 @@ void shasta::main::assemble(
         threadCount = std::thread::hardware_concurrency();
     }
     cout << "This assembly will use " << threadCount << " threads." << endl;
+    cout << "Vector instruction sets available: " << getInstructionSetSummary() << endl;
 
     // Set up the consensus caller.
     cout << "Setting up consensus caller " <<
@@ -548,209 +1043,415 @@ void shasta::main::assemble(
 
 
 
-    // Add reads from the specified input files.
-    performanceLog << timestamp << "Begin loading reads from " << inputFileNames.size() << " files." << endl;
-    const auto t0 = steady_clock::now();
-    for(const string& inputFileName: inputFileNames) {
+    // Find the first stage to run, which is the first stage for a new assembly.
+    // When resuming, access the binary data created by the stages that completed.
+    const auto checkpointHashes = computeCheckpointHashes(assemblerOptions, inputFileNames, readStore);
+    const uint64_t firstStage = findFirstAssemblyStage(assembler, assemblerOptions, checkpointHashes);
+    if(firstStage == assemblyStageCount) {
+        cout << "All stages of this assembly already completed, nothing done." << endl;
+        return;
+    }
+    if(firstStage > 0) {
+        cout << timestamp << "Resuming the assembly from stage " << assemblyStageNames[firstStage] << endl;
+        performanceLog << timestamp << "Resuming the assembly from stage " << assemblyStageNames[firstStage] << endl;
+        accessCompletedAssemblyStages(assembler, assemblerOptions, firstStage, threadCount);
+    }
 
-        assembler.addReads(
-            inputFileName,
-            assemblerOptions.readsOptions.minReadLength,
-            assemblerOptions.readsOptions.noCache,
-            threadCount);
+    // The checkpoints of the stages that will run are no longer valid.
+    for(uint64_t stage=firstStage; stage<assemblyStageCount; stage++) {
+        assembler.assemblerInfo->checkpointHash[stage] = 0;
     }
+    assembler.assemblerInfo->assemblyIsRunning = 1;
+    assembler.assemblerInfo->incrementStageGeneration();
+    assembler.assemblerInfo.syncToDisk();
+
+    // Set if markers are found while the reads are loaded.
+    bool findMarkersWhileLoadingReads = false;
 
-    if(assembler.getReads().readCount() == 0) {
-        throw runtime_error("There are no input reads.");
+    // Set if alignments are computed while LowHash is running,
+    // as part of the alignmentCandidates stage.
+    bool streamAlignmentCandidates = false;
+
+    auto runStage = [&](AssemblyStage stage)
+    {
+        return uint64_t(stage) >= firstStage;
+    };
+
+    // Binary data are released after the last stage that uses them,
+    // unless --keepDeadData was specified.
+    // With --memoryMode filesystem they are only closed, so they remain
+    // available to --command explore and --resumeFrom.
+    const bool releaseDeadData = not assemblerOptions.commandLineOnlyOptions.keepDeadData;
+    const bool removeDeadData = (assemblerOptions.commandLineOnlyOptions.memoryMode != "filesystem");
+    if(releaseDeadData) {
+        for(uint64_t stage=0; stage<firstStage; stage++) {
+            assembler.releaseDeadData(AssemblyStage(stage), removeDeadData);
+        }
     }
+    auto completeStage = [&](AssemblyStage stage)
+    {
+        // With --memoryBacking disk, make sure the binary data are on disk
+        // before recording the checkpoint.
+        if(assemblerOptions.commandLineOnlyOptions.memoryBacking == "disk") {
+            ::sync();
+        }
+        assembler.assemblerInfo->checkpointHash[uint64_t(stage)] = checkpointHashes[uint64_t(stage)];
+        assembler.assemblerInfo->incrementStageGeneration();
+        assembler.assemblerInfo.syncToDisk();
+        performanceLog << timestamp << "Assembly stage " <<
+            assemblyStageNames[uint64_t(stage)] << " completed." << endl;
+
+        // Release the binary data that are no longer needed.
+        if(releaseDeadData) {
+            assembler.releaseDeadData(stage, removeDeadData);
+        }
+        MemoryMapped::writeMemoryUsage(performanceLog);
+    };
+
+
+
+    if(runStage(AssemblyStage::reads)) {
+        const PerformanceSpan performanceSpan("reads");
+
+        // Add reads from the specified input files.
+        performanceLog << timestamp << "Begin loading reads from " << inputFileNames.size() << " files." << endl;
+        const auto t0 = steady_clock::now();
+        // If requested, use a length scan to adjust the read length cutoff
+        // for the desired coverage before the reads are stored.
+        // This is not done when using a read store.
+        const bool useLengthScan =
+            assemblerOptions.readsOptions.desiredCoverage > 0 and
+            assemblerOptions.readsOptions.lengthScan and
+            readStore.empty();
+        // If requested, find markers while loading the reads.
+        // This is only possible if the KmerChecker does not depend on the reads,
+        // and if the reads are not changed after loading.
+        findMarkersWhileLoadingReads =
+            assemblerOptions.kmersOptions.findMarkersWhileLoadingReads and
+            (assemblerOptions.kmersOptions.generationMethod == 0 or
+             assemblerOptions.kmersOptions.generationMethod == 3) and
+            readStore.empty() and
+            (assemblerOptions.readsOptions.desiredCoverage == 0 or useLengthScan);
+        if(assemblerOptions.kmersOptions.findMarkersWhileLoadingReads and not findMarkersWhileLoadingReads) {
+            cout << "Markers will not be found while loading reads "
+                "because this is not compatible with the options used." << endl;
+        }
+        if(findMarkersWhileLoadingReads) {
+            assembler.createKmerChecker(assemblerOptions.kmersOptions, threadCount);
+        }
 
+        if(readStore.empty()) {
+            assembler.addReads(
+                inputFileNames,
+                assemblerOptions.readsOptions.minReadLength,
+                useLengthScan ? assemblerOptions.readsOptions.desiredCoverage : 0,
+                assemblerOptions.readsOptions.noCache,
+                assemblerOptions.readsOptions.streamingChunkSize * 1024ULL * 1024ULL,
+                threadCount,
+                findMarkersWhileLoadingReads);
+        } else {
+            assembler.addReadsFromStore(
+                readStore,
+                assemblerOptions.readsOptions.minReadLength);
+        }
 
+        if(assembler.getReads().readCount() == 0) {
+            throw runtime_error("There are no input reads.");
+        }
 
-    // If requested, increase the read length cutoff
-    // to reduce coverage to the specified amount.
-    if (assemblerOptions.readsOptions.desiredCoverage > 0) {
-        // Write out the read length histogram using provided minReadLength.
-        assembler.histogramReadLength("ExtendedReadLengthHistogram.csv");
 
-        const auto newMinReadLength = assembler.adjustCoverageAndGetNewMinReadLength(
-            assemblerOptions.readsOptions.desiredCoverage);
 
-        const auto oldMinReadLength = uint64_t(assemblerOptions.readsOptions.minReadLength);
+        // If requested, increase the read length cutoff
+        // to reduce coverage to the specified amount.
+        // This is not necessary if it was already done by the length scan.
+        if (assemblerOptions.readsOptions.desiredCoverage > 0 and not useLengthScan) {
+            // Write out the read length histogram using provided minReadLength.
+            assembler.histogramReadLength("ExtendedReadLengthHistogram.csv");
 
-        if (newMinReadLength == 0ULL) {
-            throw runtime_error(
-                "With Reads.minReadLength " +
-                to_string(assemblerOptions.readsOptions.minReadLength) +
-                ", total available coverage is " +
-                to_string(assembler.getReads().getTotalBaseCount()) +
-                ", less than desired coverage " +
-                to_string(assemblerOptions.readsOptions.desiredCoverage) +
-                ". Try reducing Reads.minReadLength if appropriate or get more coverage."
-            );
-        }
+            const auto newMinReadLength = assembler.adjustCoverageAndGetNewMinReadLength(
+                assemblerOptions.readsOptions.desiredCoverage);
 
-        // Adjusting coverage should only ever reduce coverage if necessary.
-        SHASTA_ASSERT(newMinReadLength >= oldMinReadLength);
-    }
+            const auto oldMinReadLength = uint64_t(assemblerOptions.readsOptions.minReadLength);
 
-    assembler.computeReadIdsSortedByName();
-    assembler.histogramReadLength("ReadLengthHistogram.csv");
+            if (newMinReadLength == 0ULL) {
+                throw runtime_error(
+                    "With Reads.minReadLength " +
+                    to_string(assemblerOptions.readsOptions.minReadLength) +
+                    ", total available coverage is " +
+                    to_string(assembler.getReads().getTotalBaseCount()) +
+                    ", less than desired coverage " +
+                    to_string(assemblerOptions.readsOptions.desiredCoverage) +
+                    ". Try reducing Reads.minReadLength if appropriate or get more coverage."
+                );
+            }
 
-    const auto t1 = steady_clock::now();
-    performanceLog << timestamp << "Done loading reads from " << inputFileNames.size() << " files." << endl;
-    performanceLog << "Read loading took " << seconds(t1-t0) << "s." << endl;
+            // Adjusting coverage should only ever reduce coverage if necessary.
+            SHASTA_ASSERT(newMinReadLength >= oldMinReadLength);
+        }
 
-    // Find duplicate reads and handle them according to the setting
-    // of --Reads.handleDuplicates.
-    assembler.findDuplicateReads(assemblerOptions.readsOptions.handleDuplicates);
+        // If requested, store the repeat counts in compressed form.
+        if(assemblerOptions.readsOptions.compressRepeatCounts) {
+            assembler.compressReadRepeatCounts();
+        }
 
-    // Initialize the KmerChecker, which has the information needed
-    // to decide if a k-mer is a marker.
-    assembler.createKmerChecker(assemblerOptions.kmersOptions, threadCount);
+        assembler.computeReadIdsSortedByName(threadCount);
 
-    // Find the markers in the reads.
-    assembler.findMarkers(0);
+        // If requested, store the read names and meta data in compressed form.
+        // This uses the order by name computed above.
+        if(assemblerOptions.readsOptions.compressNames) {
+            assembler.compressReadNames();
+        }
 
-    // Gather marker KmerIds for all markers.
-    // They are used by LowHash and alignment computation.
-    // These will be kept until we are done computing alignments.
-    assembler.computeMarkerKmerIds(threadCount);
+        assembler.histogramReadLength("ReadLengthHistogram.csv");
 
-    // Flag palindromic reads.
-    // These will be excluded from further processing.
-    if(!assemblerOptions.readsOptions.palindromicReads.skipFlagging) {
-        assembler.flagPalindromicReads(
-            assemblerOptions.readsOptions.palindromicReads.maxSkip,
-            assemblerOptions.readsOptions.palindromicReads.maxDrift,
-            assemblerOptions.readsOptions.palindromicReads.maxMarkerFrequency,
-            assemblerOptions.readsOptions.palindromicReads.alignedFractionThreshold,
-            assemblerOptions.readsOptions.palindromicReads.nearDiagonalFractionThreshold,
-            assemblerOptions.readsOptions.palindromicReads.deltaThreshold,
-            threadCount);
-    }
+        const auto t1 = steady_clock::now();
+        performanceLog << timestamp << "Done loading reads from " << inputFileNames.size() << " files." << endl;
+        performanceLog << "Read loading took " << seconds(t1-t0) << "s." << endl;
 
-    // Find alignment candidates.
-    if(assemblerOptions.minHashOptions.allPairs) {
-        assembler.markAlignmentCandidatesAllPairs();
-    } else {
-        SHASTA_ASSERT(assemblerOptions.minHashOptions.version == 0); // Already checked for that.
-        assembler.findAlignmentCandidatesLowHash0(
-            assemblerOptions.minHashOptions.m,
-            assemblerOptions.minHashOptions.hashFraction,
-            assemblerOptions.minHashOptions.minHashIterationCount,
-            assemblerOptions.minHashOptions.alignmentCandidatesPerRead,
-            0,
-            assemblerOptions.minHashOptions.minBucketSize,
-            assemblerOptions.minHashOptions.maxBucketSize,
-            assemblerOptions.minHashOptions.minFrequency,
-            threadCount);
+        // Find duplicate reads and handle them according to the setting
+        // of --Reads.handleDuplicates.
+        assembler.findDuplicateReads(assemblerOptions.readsOptions.handleDuplicates, threadCount);
+
+        completeStage(AssemblyStage::reads);
     }
 
 
 
-    // Suppress alignment candidates where reads are close on the same channel.
-    if(assemblerOptions.alignOptions.sameChannelReadAlignmentSuppressDeltaThreshold > 0) {
-        assembler.suppressAlignmentCandidates(
-            assemblerOptions.alignOptions.sameChannelReadAlignmentSuppressDeltaThreshold,
-            threadCount);
+    if(runStage(AssemblyStage::markers)) {
+        const PerformanceSpan performanceSpan("markers");
+
+        // Initialize the KmerChecker, which has the information needed
+        // to decide if a k-mer is a marker.
+        // If markers were found while loading reads, this was already done.
+        if(not findMarkersWhileLoadingReads) {
+            assembler.createKmerChecker(assemblerOptions.kmersOptions, threadCount);
+        }
+
+        // Find the markers in the reads.
+        assembler.findMarkers(0);
+
+        completeStage(AssemblyStage::markers);
     }
 
 
-    // For http server and debugging/development purposes, generate an exhaustive table of candidates
-    assembler.computeCandidateTable();
 
+    if(runStage(AssemblyStage::alignmentCandidates)) {
+        const PerformanceSpan performanceSpan("alignmentCandidates");
 
-    // Compute alignments.
-    assembler.computeAlignments(
-        assemblerOptions.alignOptions,
-        threadCount);
+        // Gather marker KmerIds and positions for all markers.
+        // They are used by LowHash and alignment computation.
+        // These will be kept until we are done computing alignments.
+        // If --Kmers.recomputeMarkerKmerIds was specified,
+        // they are instead recomputed from the reads as needed.
+        if(not assemblerOptions.kmersOptions.recomputeMarkerKmerIds) {
+            assembler.computeMarkerKmerIds(threadCount);
+            assembler.computeMarkerPositions(threadCount);
+        }
 
-    // Marker KmerIds are freed here.
-    // They can always be recomputed from the reads when needed.
-    assembler.cleanupMarkerKmerIds();
-
-
-    // Create the read graph.
-    if(assemblerOptions.readGraphOptions.creationMethod == 0) {
-        assembler.createReadGraph(
-            assemblerOptions.readGraphOptions.maxAlignmentCount,
-            assemblerOptions.alignOptions.maxTrim);
-
-        // Actual alignment criteria are as specified in the command line options
-        // and/or configuration.
-        assembler.assemblerInfo->actualMinAlignedFraction = assemblerOptions.alignOptions.minAlignedFraction;
-        assembler.assemblerInfo->actualMinAlignedMarkerCount = assemblerOptions.alignOptions.minAlignedMarkerCount;
-        assembler.assemblerInfo->actualMaxDrift = assemblerOptions.alignOptions.maxDrift;
-        assembler.assemblerInfo->actualMaxSkip = assemblerOptions.alignOptions.maxSkip;
-        assembler.assemblerInfo->actualMaxTrim = assemblerOptions.alignOptions.maxTrim;
-
-
-    } else if(assemblerOptions.readGraphOptions.creationMethod == 2) {
-        assembler.createReadGraph2(
-            assemblerOptions.readGraphOptions.maxAlignmentCount,
-            assemblerOptions.readGraphOptions.markerCountPercentile,
-            assemblerOptions.readGraphOptions.alignedFractionPercentile,
-            assemblerOptions.readGraphOptions.maxSkipPercentile,
-            assemblerOptions.readGraphOptions.maxDriftPercentile,
-            assemblerOptions.readGraphOptions.maxTrimPercentile);
-    } else {
-        throw runtime_error("Invalid value for --ReadGraph.creationMethod.");
-    }
+        // Flag palindromic reads.
+        // These will be excluded from further processing.
+        if(!assemblerOptions.readsOptions.palindromicReads.skipFlagging) {
+            assembler.flagPalindromicReads(
+                assemblerOptions.readsOptions.palindromicReads.maxSkip,
+                assemblerOptions.readsOptions.palindromicReads.maxDrift,
+                assemblerOptions.readsOptions.palindromicReads.maxMarkerFrequency,
+                assemblerOptions.readsOptions.palindromicReads.alignedFractionThreshold,
+                assemblerOptions.readsOptions.palindromicReads.nearDiagonalFractionThreshold,
+                assemblerOptions.readsOptions.palindromicReads.deltaThreshold,
+                threadCount);
+        }
 
-    // Limited strand separation.
-    // If strict strand separation is requested, it is done later,
-    // after chimera detection.
-    if(assemblerOptions.readGraphOptions.strandSeparationMethod == 1) {
-        assembler.flagCrossStrandReadGraphEdges1(
-            assemblerOptions.readGraphOptions.crossStrandMaxDistance,
-            threadCount);
-    }
+        // If requested, compute alignments while LowHash is running.
+        // This is only possible if the candidates are not processed
+        // further before computing alignments.
+        streamAlignmentCandidates =
+            assemblerOptions.alignOptions.streamAlignmentCandidates and
+            not assemblerOptions.minHashOptions.allPairs and
+            assemblerOptions.minHashOptions.minHashIterationCount > 0 and
+            assemblerOptions.alignOptions.readSaturationAlignmentCount == 0 and
+            assemblerOptions.commandLineOnlyOptions.alignmentWorkerPort == 0 and
+            assemblerOptions.alignOptions.sameChannelReadAlignmentSuppressDeltaThreshold == 0;
+        if(assemblerOptions.alignOptions.streamAlignmentCandidates and not streamAlignmentCandidates) {
+            cout << "Option --Align.streamAlignmentCandidates ignored "
+                "because it is not compatible with other options in use." << endl;
+        }
 
-    // Flag chimeric reads.
-    assembler.flagChimericReads(assemblerOptions.readGraphOptions.maxChimericReadDistance, threadCount);
+        // Find alignment candidates.
+        if(assemblerOptions.minHashOptions.allPairs) {
+            assembler.markAlignmentCandidatesAllPairs();
+        } else if(streamAlignmentCandidates) {
+            SHASTA_ASSERT(assemblerOptions.minHashOptions.version == 0); // Already checked for that.
+            assembler.findAlignmentCandidatesLowHash0AndComputeAlignments(
+                assemblerOptions.minHashOptions.m,
+                assemblerOptions.minHashOptions.hashFraction,
+                assemblerOptions.minHashOptions.minHashIterationCount,
+                0,
+                assemblerOptions.minHashOptions.minBucketSize,
+                assemblerOptions.minHashOptions.maxBucketSize,
+                assemblerOptions.minHashOptions.minFrequency,
+                assemblerOptions.alignOptions,
+                threadCount);
+        } else {
+            SHASTA_ASSERT(assemblerOptions.minHashOptions.version == 0); // Already checked for that.
+            assembler.findAlignmentCandidatesLowHash0(
+                assemblerOptions.minHashOptions.m,
+                assemblerOptions.minHashOptions.hashFraction,
+                assemblerOptions.minHashOptions.minHashIterationCount,
+                assemblerOptions.minHashOptions.alignmentCandidatesPerRead,
+                0,
+                assemblerOptions.minHashOptions.minBucketSize,
+                assemblerOptions.minHashOptions.maxBucketSize,
+                assemblerOptions.minHashOptions.minFrequency,
+                threadCount);
+        }
+
+
+
+        // Suppress alignment candidates where reads are close on the same channel.
+        if(assemblerOptions.alignOptions.sameChannelReadAlignmentSuppressDeltaThreshold > 0) {
+            assembler.suppressAlignmentCandidates(
+                assemblerOptions.alignOptions.sameChannelReadAlignmentSuppressDeltaThreshold,
+                threadCount);
+        }
 
-    // Flag inconsistent alignments, if requested.
-    if(assemblerOptions.readGraphOptions.flagInconsistentAlignments) {
-        assembler.flagInconsistentAlignments(
-            assemblerOptions.readGraphOptions.flagInconsistentAlignmentsTriangleErrorThreshold,
-            assemblerOptions.readGraphOptions.flagInconsistentAlignmentsLeastSquareErrorThreshold,
-            assemblerOptions.readGraphOptions.flagInconsistentAlignmentsLeastSquareMaxDistance,
-            threadCount);
+
+        // For http server and debugging/development purposes, generate an exhaustive table of candidates
+        assembler.computeCandidateTable(threadCount);
+
+        completeStage(AssemblyStage::alignmentCandidates);
     }
 
-    // Strict strand separation.
-    if(assemblerOptions.readGraphOptions.strandSeparationMethod == 2) {
-        assembler.flagCrossStrandReadGraphEdges2();
+
+
+    if(runStage(AssemblyStage::alignments)) {
+        const PerformanceSpan performanceSpan("alignments");
+
+        // Compute alignments, unless this was already done
+        // in the alignmentCandidates stage.
+        if(not streamAlignmentCandidates) {
+            assembler.computeAlignments(
+                assemblerOptions.alignOptions,
+                threadCount,
+                assemblerOptions.commandLineOnlyOptions.alignmentWorkerPort);
+        }
+
+        // Marker KmerIds and positions are freed here.
+        // They can always be recomputed from the reads when needed.
+        assembler.cleanupMarkerKmerIds();
+        assembler.cleanupMarkerPositions();
+
+        completeStage(AssemblyStage::alignments);
     }
 
-    // Compute connected components of the read graph.
-    // These are currently not used.
-    // For strand separation method 2 this was already done
-    // in flagCrossStrandReadGraphEdges2.
-    if(assemblerOptions.readGraphOptions.strandSeparationMethod != 2) {
-        assembler.computeReadGraphConnectedComponents();
+
+
+    if(runStage(AssemblyStage::readGraph)) {
+        const PerformanceSpan performanceSpan("readGraph");
+
+        // Create the read graph.
+        if(assemblerOptions.readGraphOptions.creationMethod == 0) {
+
+            // Actual alignment criteria are as specified in the command line options
+            // and/or configuration.
+            assembler.assemblerInfo->actualMinAlignedFraction = assemblerOptions.alignOptions.minAlignedFraction;
+            assembler.assemblerInfo->actualMinAlignedMarkerCount = assemblerOptions.alignOptions.minAlignedMarkerCount;
+            assembler.assemblerInfo->actualMaxDrift = assemblerOptions.alignOptions.maxDrift;
+            assembler.assemblerInfo->actualMaxSkip = assemblerOptions.alignOptions.maxSkip;
+            assembler.assemblerInfo->actualMaxTrim = assemblerOptions.alignOptions.maxTrim;
+
+            // The alignments already satisfy these criteria, unless
+            // we are rebuilding the read graph with different alignment options.
+            assembler.createReadGraph(
+                assemblerOptions.readGraphOptions.maxAlignmentCount,
+                assemblerOptions.alignOptions.maxTrim,
+                threadCount,
+                assemblerOptions.commandLineOnlyOptions.command == "rebuildReadGraph");
+
+
+        } else if(assemblerOptions.readGraphOptions.creationMethod == 2) {
+            assembler.createReadGraph2(
+                assemblerOptions.readGraphOptions.maxAlignmentCount,
+                assemblerOptions.readGraphOptions.markerCountPercentile,
+                assemblerOptions.readGraphOptions.alignedFractionPercentile,
+                assemblerOptions.readGraphOptions.maxSkipPercentile,
+                assemblerOptions.readGraphOptions.maxDriftPercentile,
+                assemblerOptions.readGraphOptions.maxTrimPercentile,
+                threadCount);
+        } else {
+            throw runtime_error("Invalid value for --ReadGraph.creationMethod.");
+        }
+
+        // Limited strand separation.
+        // If strict strand separation is requested, it is done later,
+        // after chimera detection.
+        if(assemblerOptions.readGraphOptions.strandSeparationMethod == 1) {
+            assembler.flagCrossStrandReadGraphEdges1(
+                assemblerOptions.readGraphOptions.crossStrandMaxDistance,
+                threadCount);
+        }
+
+        // Flag chimeric reads.
+        assembler.flagChimericReads(assemblerOptions.readGraphOptions.maxChimericReadDistance, threadCount);
+
+        // Flag inconsistent alignments, if requested.
+        if(assemblerOptions.readGraphOptions.flagInconsistentAlignments) {
+            assembler.flagInconsistentAlignments(
+                assemblerOptions.readGraphOptions.flagInconsistentAlignmentsTriangleErrorThreshold,
+                assemblerOptions.readGraphOptions.flagInconsistentAlignmentsLeastSquareErrorThreshold,
+                assemblerOptions.readGraphOptions.flagInconsistentAlignmentsLeastSquareMaxDistance,
+                threadCount);
+        }
+
+        // Strict strand separation.
+        if(assemblerOptions.readGraphOptions.strandSeparationMethod == 2) {
+            assembler.flagCrossStrandReadGraphEdges2();
+        }
+
+        // Renumber the reads, if requested.
+        if(assemblerOptions.readGraphOptions.renumberReads) {
+            assembler.renumberReads(threadCount);
+        }
+
+        // Compute connected components of the read graph.
+        // These are currently not used.
+        // For strand separation method 2 this was already done
+        // in flagCrossStrandReadGraphEdges2.
+        if(assemblerOptions.readGraphOptions.strandSeparationMethod != 2) {
+            assembler.computeReadGraphConnectedComponents(threadCount);
+        }
+
+        completeStage(AssemblyStage::readGraph);
     }
 
 
 
-    // Do the rest of the assembly using the selected assembly mode.
-    switch(assemblerOptions.assemblyOptions.mode) {
-    case 0:
-        mode0Assembly(assembler, assemblerOptions, threadCount);
-        break;
-    case 2:
-        mode2Assembly(assembler, assemblerOptions, threadCount);
-        break;
-    case 3:
-        mode3Assembly(assembler, assemblerOptions, threadCount);
-        break;
-    default:
-        throw runtime_error("Invalid value specified for --Assembly.mode. "
-            "Valid values are 0 (haploid assembly) and 2 (phased diploid assembly), but " +
-            to_string(assemblerOptions.assemblyOptions.mode) +
-            " was specified.");
+    if(runStage(AssemblyStage::assembly)) {
+        const PerformanceSpan performanceSpan("assembly");
+
+        // Do the rest of the assembly using the selected assembly mode.
+        switch(assemblerOptions.assemblyOptions.mode) {
+        case 0:
+            mode0Assembly(assembler, assemblerOptions, threadCount);
+            break;
+        case 2:
+            mode2Assembly(assembler, assemblerOptions, threadCount);
+            break;
+        case 3:
+            mode3Assembly(assembler, assemblerOptions, threadCount);
+            break;
+        default:
+            throw runtime_error("Invalid value specified for --Assembly.mode. "
+                "Valid values are 0 (haploid assembly) and 2 (phased diploid assembly), but " +
+                to_string(assemblerOptions.assemblyOptions.mode) +
+                " was specified.");
+        }
+
+        completeStage(AssemblyStage::assembly);
     }
 
+    // Free the huge pages of the files released during the assembly.
+    MemoryMapped::freeHugePagePool();
+
 
     // Store elapsed time for assembly.
     const auto steadyClock1 = std::chrono::steady_clock::now();
@@ -774,6 +1475,8 @@ void shasta::main::assemble(
     assembler.assemblerInfo->threadCount = threadCount;
     assembler.assemblerInfo->virtualCpuCount = std::thread::hardware_concurrency();
     assembler.assemblerInfo->totalAvailableMemory = getTotalPhysicalMemory();
+    assembler.assemblerInfo->assemblyIsRunning = 0;
+    assembler.assemblerInfo->incrementStageGeneration();
 
     // Write a summary of read information.
     assembler.writeReadsSummary();
@@ -794,11 +1497,176 @@ void shasta::main::assemble(
     performanceLog << "Average CPU utilization: " << averageCpuUtilization << endl;
     performanceLog << "Peak Memory usage: " << peakMemoryUsage << " bytes = " <<
         int(std::round(double(peakMemoryUsage) / (1024. * 1024. * 1024.)) ) << " GiB" << endl;
+    if(MemoryMapped::useTransparentHugePages) {
+        performanceLog << getTransparentHugePageStatistics() << endl;
+    }
 
 }
 
 
 
+// Compute the hashes stored in AssemblerInfo::checkpointHash
+// when each stage of the assembly completes.
+// The hash for each stage covers the options used
+// by that stage and all previous stages.
+array<uint64_t, assemblyStageCount> shasta::main::computeCheckpointHashes(
+    const AssemblerOptions& assemblerOptions,
+    const vector<string>& inputNames,
+    const string& readStore)
+{
+    array<string, assemblyStageCount> stageOptions;
+    {
+        std::ostringstream s;
+        for(const string& inputName: inputNames) {
+            s << inputName << "\n";
+        }
+        s << readStore << "\n";
+        assemblerOptions.readsOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::reads)] = s.str();
+    }
+    {
+        std::ostringstream s;
+        assemblerOptions.kmersOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::markers)] = s.str();
+    }
+    {
+        std::ostringstream s;
+        assemblerOptions.minHashOptions.write(s);
+        assemblerOptions.alignOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::alignmentCandidates)] = s.str();
+    }
+    {
+        std::ostringstream s;
+        assemblerOptions.alignOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::alignments)] = s.str();
+    }
+    {
+        std::ostringstream s;
+        assemblerOptions.readGraphOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::readGraph)] = s.str();
+    }
+    {
+        std::ostringstream s;
+        assemblerOptions.write(s);
+        stageOptions[uint64_t(AssemblyStage::assembly)] = s.str();
+    }
+
+    array<uint64_t, assemblyStageCount> hashes;
+    uint64_t hash = 0;
+    for(uint64_t stage=0; stage<assemblyStageCount; stage++) {
+        const string& options = stageOptions[stage];
+        hash = MurmurHash64A(options.data(), int(options.size()), hash);
+
+        // Zero is reserved for stages that did not complete.
+        if(hash == 0) {
+            hash = 1;
+        }
+        hashes[stage] = hash;
+    }
+    return hashes;
+}
+
+
+
+// Find the first stage of the assembly that needs to run.
+// For a new assembly, this is always the first stage.
+// When resuming, this is the first stage that did not complete
+// or that completed with different options, or the stage
+// specified by --resumeFrom, if earlier.
+uint64_t shasta::main::findFirstAssemblyStage(
+    const Assembler& assembler,
+    const AssemblerOptions& assemblerOptions,
+    const array<uint64_t, assemblyStageCount>& checkpointHashes)
+{
+    // For --command rebuildReadGraph, always start from the read graph.
+    // The previous stages must have completed, possibly with different options.
+    if(assemblerOptions.commandLineOnlyOptions.command == "rebuildReadGraph") {
+        const uint64_t readGraphStage = uint64_t(AssemblyStage::readGraph);
+        for(uint64_t stage=0; stage<readGraphStage; stage++) {
+            if(assembler.assemblerInfo->checkpointHash[stage] == 0) {
+                throw runtime_error("--command rebuildReadGraph: assembly stage " +
+                    assemblyStageNames[stage] + " did not complete.");
+            }
+        }
+        return readGraphStage;
+    }
+
+    const string& resumeFrom = assemblerOptions.commandLineOnlyOptions.resumeFrom;
+    if(resumeFrom.empty()) {
+        return 0;
+    }
+
+    uint64_t firstStage = 0;
+    for(; firstStage<assemblyStageCount; firstStage++) {
+        const uint64_t storedHash = assembler.assemblerInfo->checkpointHash[firstStage];
+        if(storedHash != checkpointHashes[firstStage]) {
+            if(storedHash != 0) {
+                cout << "Assembly stage " << assemblyStageNames[firstStage] <<
+                    " completed with different options and will run again." << endl;
+            }
+            break;
+        }
+    }
+    if(resumeFrom != "auto") {
+        const uint64_t requestedStage = uint64_t(
+            std::find(assemblyStageNames.begin(), assemblyStageNames.end(), resumeFrom) -
+            assemblyStageNames.begin());
+        firstStage = min(firstStage, requestedStage);
+    }
+
+    // The reads are created in place and cannot be recreated in the existing
+    // binary data.
+    if(firstStage == 0) {
+        throw runtime_error("--resumeFrom: the first stage of the interrupted assembly "
+            "did not complete or used different options. "
+            "Start a new assembly instead.");
+    }
+    return firstStage;
+}
+
+
+
+// When resuming an assembly, access the binary data
+// created by the stages that completed, as required by the
+// stages that will run.
+void shasta::main::accessCompletedAssemblyStages(
+    Assembler& assembler,
+    const AssemblerOptions& assemblerOptions,
+    uint64_t firstStage,
+    uint32_t threadCount)
+{
+    // The reads are accessed by the Assembler constructor.
+
+    if(firstStage > uint64_t(AssemblyStage::markers)) {
+        assembler.accessKmerChecker();
+        assembler.accessMarkers();
+    }
+
+    if(firstStage > uint64_t(AssemblyStage::alignmentCandidates)) {
+        assembler.accessAlignmentCandidates();
+        assembler.accessAlignmentCandidateTable();
+
+        // The marker KmerIds are only kept until the alignments are computed,
+        // so if resuming from the alignments we have to recompute them.
+        if(firstStage == uint64_t(AssemblyStage::alignments) and
+            not assemblerOptions.kmersOptions.recomputeMarkerKmerIds) {
+            assembler.computeMarkerKmerIds(threadCount);
+            assembler.computeMarkerPositions(threadCount);
+        }
+    }
+
+    if(firstStage > uint64_t(AssemblyStage::alignments)) {
+        assembler.accessAlignmentDataReadWrite();
+        assembler.accessCompressedAlignments();
+    }
+
+    if(firstStage > uint64_t(AssemblyStage::readGraph)) {
+        assembler.accessReadGraphReadWrite();
+    }
+}
+
+
+
 void shasta::main::mode0Assembly(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
@@ -821,7 +1689,9 @@ void shasta::main::mode0Assembly(
                 assemblerOptions.markerGraphOptions.allowDuplicateMarkers,
                 assemblerOptions.markerGraphOptions.peakFinderMinAreaFraction,
                 assemblerOptions.markerGraphOptions.peakFinderAreaStartIndex,
-                threadCount);
+                threadCount,
+                assemblerOptions.markerGraphOptions.shardCount,
+        assemblerOptions.markerGraphOptions.externalMemoryBudget);
             assembler.findMarkerGraphReverseComplementVertices(threadCount);
             assembler.createMarkerGraphEdges(threadCount);
             assembler.findMarkerGraphReverseComplementEdges(threadCount);
@@ -831,8 +1701,9 @@ void shasta::main::mode0Assembly(
                 assemblerOptions.markerGraphOptions.maxDistance,
                 assemblerOptions.markerGraphOptions.edgeMarkerSkipThreshold);
             assembler.pruneMarkerGraphStrongSubgraph(
-                assemblerOptions.markerGraphOptions.pruneIterationCount);
-            assembler.createAssemblyGraphEdges();
+                assemblerOptions.markerGraphOptions.pruneIterationCount,
+                threadCount);
+            assembler.createAssemblyGraphEdges(threadCount);
             assembler.createAssemblyGraphVertices();
 
             // Recreate the read graph using pseudo-paths from this assembly.
@@ -848,7 +1719,8 @@ void shasta::main::mode0Assembly(
                 bridgeRemovalIteration<assemblerOptions.assemblyOptions.iterativeBridgeRemovalIterationCount;
                 bridgeRemovalIteration++) {
                 assembler.removeReadGraphBridges(
-                    assemblerOptions.assemblyOptions.iterativeBridgeRemovalMaxDistance);
+                    assemblerOptions.assemblyOptions.iterativeBridgeRemovalMaxDistance,
+                    threadCount);
             }
 
             // Remove the marker graph and assembly graph we created in the process.
@@ -874,7 +1746,9 @@ void shasta::main::mode0Assembly(
         assemblerOptions.markerGraphOptions.allowDuplicateMarkers,
         assemblerOptions.markerGraphOptions.peakFinderMinAreaFraction,
         assemblerOptions.markerGraphOptions.peakFinderAreaStartIndex,
-        threadCount);
+        threadCount,
+        assemblerOptions.markerGraphOptions.shardCount,
+        assemblerOptions.markerGraphOptions.externalMemoryBudget);
 
     // Find the reverse complement of each marker graph vertex.
     assembler.findMarkerGraphReverseComplementVertices(threadCount);
@@ -890,6 +1764,11 @@ void shasta::main::mode0Assembly(
             false, false);
     }
 
+    // Renumber marker graph vertices, if requested.
+    if(assemblerOptions.markerGraphOptions.renumberVertices) {
+        assembler.renumberMarkerGraphVertices(threadCount);
+    }
+
     // Create edges of the marker graph.
     assembler.createMarkerGraphEdges(threadCount);
     assembler.findMarkerGraphReverseComplementEdges(threadCount);
@@ -903,7 +1782,8 @@ void shasta::main::mode0Assembly(
 
     // Prune the marker graph.
     assembler.pruneMarkerGraphStrongSubgraph(
-        assemblerOptions.markerGraphOptions.pruneIterationCount);
+        assemblerOptions.markerGraphOptions.pruneIterationCount,
+        threadCount);
 
     // Compute marker graph coverage histogram.
     assembler.computeMarkerGraphCoverageHistogram();
@@ -914,7 +1794,7 @@ void shasta::main::mode0Assembly(
     assembler.simplifyMarkerGraph(assemblerOptions.markerGraphOptions.simplifyMaxLengthVector, false);
 
     // Create the assembly graph.
-    assembler.createAssemblyGraphEdges();
+    assembler.createAssemblyGraphEdges(threadCount);
     assembler.createAssemblyGraphVertices();
 
     // Remove low-coverage cross-edges from the assembly graph and
@@ -923,7 +1803,7 @@ void shasta::main::mode0Assembly(
         assembler.removeLowCoverageCrossEdges(
             uint32_t(assemblerOptions.markerGraphOptions.crossEdgeCoverageThreshold));
         assembler.assemblyGraphPointer->remove();
-        assembler.createAssemblyGraphEdges();
+        assembler.createAssemblyGraphEdges(threadCount);
         assembler.createAssemblyGraphVertices();
     }
 
@@ -934,12 +1814,13 @@ void shasta::main::mode0Assembly(
 
     // Detangle, if requested.
     if(assemblerOptions.assemblyOptions.detangleMethod == 1) {
-        assembler.detangle();
+        assembler.detangle(threadCount);
     } else if(assemblerOptions.assemblyOptions.detangleMethod == 2) {
         assembler.detangle2(
             assemblerOptions.assemblyOptions.detangleDiagonalReadCountMin,
             assemblerOptions.assemblyOptions.detangleOffDiagonalReadCountMax,
-            assemblerOptions.assemblyOptions.detangleOffDiagonalRatio
+            assemblerOptions.assemblyOptions.detangleOffDiagonalRatio,
+            threadCount
             );
     }
 
@@ -949,7 +1830,7 @@ void shasta::main::mode0Assembly(
         assembler.removeLowCoverageCrossEdges(
             uint32_t(assemblerOptions.markerGraphOptions.crossEdgeCoverageThreshold));
         assembler.assemblyGraphPointer->remove();
-        assembler.createAssemblyGraphEdges();
+        assembler.createAssemblyGraphEdges(threadCount);
         assembler.createAssemblyGraphVertices();
     }
 
@@ -979,10 +1860,11 @@ void shasta::main::mode0Assembly(
         assemblerOptions.assemblyOptions.storeCoverageDataCsvLengthThreshold);
     // assembler.findAssemblyGraphBubbles();
     assembler.computeAssemblyStatistics();
-    assembler.writeGfa1("Assembly.gfa");
-    assembler.writeGfa1BothStrands("Assembly-BothStrands.gfa");
+    const string extension = assemblerOptions.assemblyOptions.bgzfOutput ? ".gz" : "";
+    assembler.writeGfa1("Assembly.gfa" + extension, threadCount);
+    assembler.writeGfa1BothStrands("Assembly-BothStrands.gfa" + extension, threadCount);
     assembler.writeGfa1BothStrandsNoSequence("Assembly-BothStrands-NoSequence.gfa");
-    assembler.writeFasta("Assembly.fasta");
+    assembler.writeFasta("Assembly.fasta" + extension, threadCount);
 
     // If requested, write out the oriented reads that were used to assemble
     // each assembled segment.
@@ -1008,8 +1890,13 @@ void shasta::main::mode2Assembly(
         assemblerOptions.markerGraphOptions.allowDuplicateMarkers,
         assemblerOptions.markerGraphOptions.peakFinderMinAreaFraction,
         assemblerOptions.markerGraphOptions.peakFinderAreaStartIndex,
-        threadCount);
+        threadCount,
+        assemblerOptions.markerGraphOptions.shardCount,
+        assemblerOptions.markerGraphOptions.externalMemoryBudget);
     assembler.findMarkerGraphReverseComplementVertices(threadCount);
+    if(assemblerOptions.markerGraphOptions.renumberVertices) {
+        assembler.renumberMarkerGraphVertices(threadCount);
+    }
 
     // Create marker graph edges.
     // For assembly mode 1 we use createMarkerGraphEdgesStrict
@@ -1093,8 +1980,13 @@ void shasta::main::mode3Assembly(
         allowDuplicateMarkers,
         assemblerOptions.markerGraphOptions.peakFinderMinAreaFraction,
         assemblerOptions.markerGraphOptions.peakFinderAreaStartIndex,
-        threadCount);
+        threadCount,
+        assemblerOptions.markerGraphOptions.shardCount,
+        assemblerOptions.markerGraphOptions.externalMemoryBudget);
     assembler.findMarkerGraphReverseComplementVertices(threadCount);
+    if(assemblerOptions.markerGraphOptions.renumberVertices) {
+        assembler.renumberMarkerGraphVertices(threadCount);
+    }
 
     // Create marker graph edges.
     // For assembly mode 3 we use createMarkerGraphEdgesStrict
@@ -1188,17 +2080,122 @@ void shasta::main::saveBinaryData(
     }
 
     // Copy Data to DataOnDisk.
-    const string command = "cp -rp " + dataDirectory + " " + dataOnDiskDirectory;
-    const int errorCode = ::system(command.c_str());
-    if(errorCode != 0) {
-        throw runtime_error("Error " + to_string(errorCode) + ": " + strerror(errorCode) +
-            " running command:\n" + command);
-    }
+    // This uses reflinks if the filesystem supports them.
+    // If the assembly used --memoryTiering, the cold binary data
+    // are already on disk in ColdData and are not copied.
+    snapshotDirectory(dataDirectory, dataOnDiskDirectory);
     cout << "Binary data successfully saved." << endl;
 }
 
 
 
+// Implementation of --command createReadStore.
+// This loads the reads from the --input files into the binary
+// read store specified by --readStore, which can then be used
+// by any number of later assemblies.
+void shasta::main::createReadStore(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "createReadStore");
+
+    if(assemblerOptions.commandLineOnlyOptions.readStore.empty()) {
+        throw runtime_error("Specify the read store to be created "
+            "using command line option \"--readStore\".");
+    }
+    if(assemblerOptions.commandLineOnlyOptions.inputFileNames.empty()) {
+        throw runtime_error("Specify at least one input file "
+            "using command line option \"--input\".");
+    }
+    for(const string& inputFileName: assemblerOptions.commandLineOnlyOptions.inputFileNames) {
+        if(!std::filesystem::is_regular_file(inputFileName)) {
+            throw runtime_error("Input file not found or not a regular file: " + inputFileName);
+        }
+    }
+
+    uint32_t threadCount = assemblerOptions.commandLineOnlyOptions.threadCount;
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    cout << timestamp << "Creating read store " <<
+        assemblerOptions.commandLineOnlyOptions.readStore << endl;
+    Assembler::createReadStore(
+        assemblerOptions.commandLineOnlyOptions.inputFileNames,
+        assemblerOptions.commandLineOnlyOptions.readStore,
+        assemblerOptions.readsOptions.representation,
+        assemblerOptions.readsOptions.minReadLength,
+        assemblerOptions.readsOptions.noCache,
+        assemblerOptions.readsOptions.streamingChunkSize * 1024ULL * 1024ULL,
+        threadCount);
+    cout << timestamp << "Done creating read store." << endl;
+}
+
+
+
+// Implementation of --command estimateResources.
+// This estimates the memory needed by an assembly of the --input files
+// using the options specified, without running the assembly.
+void shasta::main::estimateResources(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "estimateResources");
+
+    cout << timestamp << "Estimating resources from a sample of the input files." << endl;
+    const ResourceEstimate resourceEstimate(assemblerOptions,
+        assemblerOptions.commandLineOnlyOptions.estimateSampleSize * 1024ULL * 1024ULL);
+    resourceEstimate.write(cout);
+
+    string recommendation;
+    resourceEstimate.check(recommendation);
+    cout << recommendation << endl;
+}
+
+
+
+// Implementation of --command comparePerformance.
+// This compares the resources used by each stage of the run in
+// --assemblyDirectory with those used by the run in --performanceBaseline,
+// as recorded in their performance traces (performance.jsonl),
+// and fails if any stage regressed by more than the tolerances.
+// The comparison of each metric is also written to
+// PerformanceComparison.csv in the current directory.
+void shasta::main::comparePerformance(
+    const AssemblerOptions& assemblerOptions)
+{
+    const CommandLineOnlyOptions& options = assemblerOptions.commandLineOnlyOptions;
+    SHASTA_ASSERT(options.command == "comparePerformance");
+    if(options.performanceBaseline.empty()) {
+        throw runtime_error("--command comparePerformance requires --performanceBaseline.");
+    }
+
+    PerformanceComparison::Tolerances tolerances;
+    tolerances.timeTolerance = options.performanceTimeTolerance;
+    tolerances.memoryTolerance = options.performanceMemoryTolerance;
+    tolerances.faultTolerance = options.performanceFaultTolerance;
+    tolerances.minSeconds = options.performanceMinSeconds;
+
+    cout << "Comparing the performance of " << options.assemblyDirectory <<
+        " with baseline " << options.performanceBaseline << "." << endl;
+    const PerformanceComparison comparison(
+        options.performanceBaseline,
+        options.assemblyDirectory,
+        tolerances);
+    comparison.write(cout);
+    {
+        ofstream csv("PerformanceComparison.csv");
+        comparison.writeCsv(csv);
+    }
+
+    const uint64_t regressionCount = comparison.regressionCount();
+    if(regressionCount > 0) {
+        throw runtime_error(to_string(regressionCount) +
+            " performance regressions found. See PerformanceComparison.csv.");
+    }
+    cout << "No performance regressions found. See PerformanceComparison.csv." << endl;
+}
+
+
+
 // Implementation of --command cleanupBinaryData.
 void shasta::main::cleanupBinaryData(
     const AssemblerOptions& assemblerOptions)
@@ -1214,26 +2211,68 @@ void shasta::main::cleanupBinaryData(
     }
 
     // Unmount it and remove it.
+    // For binary data on disk, the files are removed in parallel.
     ::system(("sudo umount " + dataDirectory).c_str());
-    const int errorCode = ::system(string("rm -rf " + dataDirectory).c_str());
-    if(errorCode != 0) {
-        throw runtime_error("Error " + to_string(errorCode) + ": " + strerror(errorCode) +
-            " removing " + dataDirectory);
+    const uint64_t threadCount = assemblerOptions.commandLineOnlyOptions.threadCount;
+    try {
+        if(std::filesystem::is_symlink(dataDirectory)) {
+            std::filesystem::remove(dataDirectory);
+        } else {
+            filesystem::removeDirectory(dataDirectory, threadCount);
+        }
+    } catch(const std::exception& e) {
+        throw runtime_error("Error removing " + dataDirectory + ": " + e.what());
     }
     cout << "Cleanup of " << dataDirectory << " successful." << endl;
 
     // If the DataOnDisk directory exists, create a symbolic link
     // Data->DataOnDisk.
+    // Otherwise, also remove the cold binary data, if any (--memoryTiering).
     const string dataOnDiskDirectory =
         assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/DataOnDisk";
+    const string coldDataDirectory =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/ColdData";
     if(std::filesystem::exists(dataOnDiskDirectory)) {
         std::filesystem::current_path(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
         const string command = "ln -s DataOnDisk Data";
         ::system(command.c_str());
+    } else if(std::filesystem::exists(coldDataDirectory)) {
+        filesystem::removeDirectory(coldDataDirectory, threadCount);
+        cout << "Cleanup of " << coldDataDirectory << " successful." << endl;
     }
 
 }
 
+// Implementation of --command alignmentWorker.
+// This computes alignments for an assembly running on another machine
+// with --alignmentWorkerPort, accessing its binary data via a shared filesystem.
+// To make sure the same alignment options are used, use
+// --config with the shasta.conf file in the assembly directory.
+void shasta::main::alignmentWorker(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "alignmentWorker");
+    if(assemblerOptions.commandLineOnlyOptions.alignmentCoordinator.empty()) {
+        throw runtime_error("--command alignmentWorker requires --alignmentCoordinator.");
+    }
+
+    // Go to the assembly directory.
+    std::filesystem::current_path(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
+    if(!std::filesystem::exists("Data")) {
+        throw runtime_error("Binary directory \"Data\" not available "
+        " in assembly directory " +
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + ".");
+    }
+
+    Assembler assembler("Data/", false, 1, 0);
+    assembler.runAlignmentWorker(
+        assemblerOptions.alignOptions,
+        assemblerOptions.commandLineOnlyOptions.alignmentCoordinator,
+        assemblerOptions.commandLineOnlyOptions.threadCount);
+}
+
+
+
 // Implementation of --command explore.
 void shasta::main::explore(
     const AssemblerOptions& assemblerOptions)
@@ -1251,6 +2290,13 @@ void shasta::main::explore(
         alignmentsPafFileAbsolutePath = filesystem::getAbsolutePath(assemblerOptions.commandLineOnlyOptions.alignmentsPafFile);
     }
 
+    // Same for the cache directory.
+    string cacheDirectoryAbsolutePath;
+    if(not assemblerOptions.commandLineOnlyOptions.exploreCacheDirectory.empty()) {
+        std::filesystem::create_directories(assemblerOptions.commandLineOnlyOptions.exploreCacheDirectory);
+        cacheDirectoryAbsolutePath = filesystem::getAbsolutePath(assemblerOptions.commandLineOnlyOptions.exploreCacheDirectory);
+    }
+
     // Go to the assembly directory.
     std::filesystem::current_path(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
 
@@ -1275,8 +2321,19 @@ void shasta::main::explore(
         assemblerOptions.assemblyOptions.consensusCaller << endl;
     assembler.setupConsensusCaller(assemblerOptions.assemblyOptions.consensusCaller);
 
-    // Access all available binary data.
-    assembler.accessAllSoft();
+    // Access the available binary data.
+    // Unless --exploreAccessAll is used, the data are accessed lazily,
+    // as needed by each request.
+    // If the assembly is still running, only access
+    // the data of the stages that already completed.
+    assembler.httpServerData.lazyAccess = not (
+        assemblerOptions.commandLineOnlyOptions.exploreAccessAll or
+        assemblerOptions.commandLineOnlyOptions.exploreNeighborhoodIndex);
+    if(assembler.assemblerInfo->assemblyIsRunning) {
+        assembler.accessCompletedStagesSoft();
+    } else if(not assembler.httpServerData.lazyAccess) {
+        assembler.accessAllSoft();
+    }
 
     string executablePath = filesystem::executablePath();
     // On Linux it will be something like - `/path/to/install_root/bin/shasta`
@@ -1297,6 +2354,21 @@ void shasta::main::explore(
         assembler.loadAlignmentsPafFile(alignmentsPafFileAbsolutePath);
     }
 
+    builtinLayoutMinVertexCount = assemblerOptions.commandLineOnlyOptions.exploreBuiltinLayoutThreshold;
+
+    // Create the marker graph neighborhood index, if requested.
+    if(assemblerOptions.commandLineOnlyOptions.exploreNeighborhoodIndex) {
+        assembler.createMarkerGraphNeighborhoodIndex(assemblerOptions.commandLineOnlyOptions.threadCount);
+    }
+
+    // Create the cache of rendered pages.
+    if(assemblerOptions.commandLineOnlyOptions.exploreCacheSize > 0 or
+        not cacheDirectoryAbsolutePath.empty()) {
+        assembler.httpServerData.responseCache = make_shared<HttpResponseCache>(
+            assemblerOptions.commandLineOnlyOptions.exploreCacheSize * 1024 * 1024,
+            cacheDirectoryAbsolutePath);
+    }
+
     // Start the http server.
     assembler.httpServerData.assemblerOptions = &assemblerOptions;
     bool localOnly;
@@ -1318,7 +2390,9 @@ void shasta::main::explore(
     assembler.explore(
         assemblerOptions.commandLineOnlyOptions.port,
         localOnly,
-        sameUserOnly);
+        sameUserOnly,
+        assemblerOptions.commandLineOnlyOptions.exploreThreadCount,
+        assemblerOptions.commandLineOnlyOptions.exploreTimeout);
 }
 
 